@@ -55,6 +55,18 @@ struct aesbs_xts_ctx {
 	struct AES_KEY	twkey;
 };
 
+/*
+ * Keep NEON enabled across the whole walk rather than toggling it for each
+ * step, so a request spanning several pages or scatterlist entries pays
+ * for kernel_neon_begin() and the VFP state save only once. The walk must
+ * not sleep while preemption is disabled.
+ */
+static void aesbs_neon_begin(struct blkcipher_desc *desc)
+{
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
+}
+
 static int aesbs_cbc_set_key(struct crypto_tfm *tfm, const u8 *in_key,
 			     unsigned int key_len)
 {
@@ -159,12 +171,16 @@ static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
 	blkcipher_walk_init(&walk, dst, src, nbytes);
 	err = blkcipher_walk_virt_block(desc, &walk, 8 * AES_BLOCK_SIZE);
 
-	while ((walk.nbytes / AES_BLOCK_SIZE) >= 8) {
-		kernel_neon_begin();
-		bsaes_cbc_encrypt(walk.src.virt.addr, walk.dst.virt.addr,
-				  walk.nbytes, &ctx->dec, walk.iv);
+	if ((walk.nbytes / AES_BLOCK_SIZE) >= 8) {
+		aesbs_neon_begin(desc);
+		do {
+			bsaes_cbc_encrypt(walk.src.virt.addr,
+					  walk.dst.virt.addr, walk.nbytes,
+					  &ctx->dec, walk.iv);
+			err = blkcipher_walk_done(desc, &walk,
+						  walk.nbytes % AES_BLOCK_SIZE);
+		} while ((walk.nbytes / AES_BLOCK_SIZE) >= 8);
 		kernel_neon_end();
-		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
 	while (walk.nbytes) {
 		u32 blocks = walk.nbytes / AES_BLOCK_SIZE;
@@ -218,6 +234,7 @@ static int aesbs_ctr_encrypt(struct blkcipher_desc *desc,
 	blkcipher_walk_init(&walk, dst, src, nbytes);
 	err = blkcipher_walk_virt_block(desc, &walk, 8 * AES_BLOCK_SIZE);
 
+	aesbs_neon_begin(desc);
 	while ((blocks = walk.nbytes / AES_BLOCK_SIZE)) {
 		u32 tail = walk.nbytes % AES_BLOCK_SIZE;
 		__be32 *ctr = (__be32 *)walk.iv;
@@ -228,11 +245,9 @@ static int aesbs_ctr_encrypt(struct blkcipher_desc *desc,
 			blocks = headroom + 1;
 			tail = walk.nbytes - blocks * AES_BLOCK_SIZE;
 		}
-		kernel_neon_begin();
 		bsaes_ctr32_encrypt_blocks(walk.src.virt.addr,
 					   walk.dst.virt.addr, blocks,
 					   &ctx->enc, walk.iv);
-		kernel_neon_end();
 		inc_be128_ctr(ctr, blocks);
 
 		nbytes -= blocks * AES_BLOCK_SIZE;
@@ -241,6 +256,7 @@ static int aesbs_ctr_encrypt(struct blkcipher_desc *desc,
 
 		err = blkcipher_walk_done(desc, &walk, tail);
 	}
+	kernel_neon_end();
 	if (walk.nbytes) {
 		u8 *tdst = walk.dst.virt.addr + blocks * AES_BLOCK_SIZE;
 		u8 *tsrc = walk.src.virt.addr + blocks * AES_BLOCK_SIZE;
@@ -269,13 +285,13 @@ static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	aesbs_neon_begin(desc);
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_encrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->enc, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
@@ -293,13 +309,13 @@ static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	aesbs_neon_begin(desc);
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_decrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->dec, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
@@ -0,0 +1,129 @@
+/*
+ * Accelerated CRC-T10DIF using ARMv8 vmull.p64 instructions
+ *
+ * Copyright 2017 NXP
+ *
+ * Based on arch/x86/crypto/crct10dif-pclmul_glue.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/crc-t10dif.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <crypto/internal/hash.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* below this the NEON context switch costs more than the table lookups */
+#define CRC_T10DIF_PMULL_MIN_LEN	64
+#define CRC_T10DIF_PMULL_CHUNK		16
+
+asmlinkage void crc_t10dif_pmull(u8 out[CRC_T10DIF_PMULL_CHUNK],
+				 const u8 *buf, size_t len, u16 crc);
+
+static u16 crct10dif_do(u16 crc, const u8 *data, unsigned int length)
+{
+	u8 rem[CRC_T10DIF_PMULL_CHUNK];
+	unsigned int l;
+
+	if (length >= CRC_T10DIF_PMULL_MIN_LEN && may_use_simd()) {
+		l = round_down(length, CRC_T10DIF_PMULL_CHUNK);
+
+		kernel_neon_begin();
+		crc_t10dif_pmull(rem, data, l, crc);
+		kernel_neon_end();
+
+		/* the folded remainder has the same CRC as the input */
+		crc = crc_t10dif_generic(0, rem, sizeof(rem));
+		data += l;
+		length -= l;
+	}
+
+	if (length)
+		crc = crc_t10dif_generic(crc, data, length);
+
+	return crc;
+}
+
+static int crct10dif_init(struct shash_desc *desc)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*crc = 0;
+	return 0;
+}
+
+static int crct10dif_update(struct shash_desc *desc, const u8 *data,
+			    unsigned int length)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*crc = crct10dif_do(*crc, data, length);
+	return 0;
+}
+
+static int crct10dif_final(struct shash_desc *desc, u8 *out)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*(u16 *)out = *crc;
+	return 0;
+}
+
+static int crct10dif_finup(struct shash_desc *desc, const u8 *data,
+			   unsigned int length, u8 *out)
+{
+	u16 *crc = shash_desc_ctx(desc);
+
+	*(u16 *)out = crct10dif_do(*crc, data, length);
+	return 0;
+}
+
+static int crct10dif_digest(struct shash_desc *desc, const u8 *data,
+			    unsigned int length, u8 *out)
+{
+	*(u16 *)out = crct10dif_do(0, data, length);
+	return 0;
+}
+
+static struct shash_alg crc_t10dif_alg = {
+	.digestsize		= CRC_T10DIF_DIGEST_SIZE,
+	.init			= crct10dif_init,
+	.update			= crct10dif_update,
+	.final			= crct10dif_final,
+	.finup			= crct10dif_finup,
+	.digest			= crct10dif_digest,
+	.descsize		= sizeof(u16),
+
+	.base.cra_name		= "crct10dif",
+	.base.cra_driver_name	= "crct10dif-arm-ce",
+	.base.cra_priority	= 200,
+	.base.cra_blocksize	= CRC_T10DIF_BLOCK_SIZE,
+	.base.cra_module	= THIS_MODULE,
+};
+
+static int __init crc_t10dif_mod_init(void)
+{
+	if (!(elf_hwcap2 & HWCAP2_PMULL))
+		return -ENODEV;
+
+	return crypto_register_shash(&crc_t10dif_alg);
+}
+
+static void __exit crc_t10dif_mod_exit(void)
+{
+	crypto_unregister_shash(&crc_t10dif_alg);
+}
+
+module_init(crc_t10dif_mod_init);
+module_exit(crc_t10dif_mod_exit);
+
+MODULE_DESCRIPTION("CRC-T10DIF using ARMv8 vmull.p64 instructions");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("crct10dif");
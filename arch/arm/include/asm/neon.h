@@ -8,10 +8,18 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/percpu.h>
 #include <asm/hwcap.h>
 
 #define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
 
+/*
+ * Set between kernel_neon_begin() and kernel_neon_end(), for code such as
+ * memcpy() that may be called from inside such a section and must not
+ * nest one of its own.
+ */
+DECLARE_PER_CPU(bool, kernel_neon_busy);
+
 #ifdef __ARM_NEON__
 
 /*
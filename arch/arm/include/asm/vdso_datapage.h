@@ -24,13 +24,18 @@
 
 #include <asm/page.h>
 
+/* where the high precision clocks read their counter from */
+#define VDSO_CLOCK_NONE		0	/* fall back to syscall */
+#define VDSO_CLOCK_CNTVCT	1	/* arch timer virtual counter */
+#define VDSO_CLOCK_MMIO		2	/* 32-bit counter in the page below */
+
 /* Try to be cache-friendly on systems that don't implement the
  * generic timer: fit the unconditionally updated fields in the first
  * 32 bytes.
  */
 struct vdso_data {
 	u32 seq_count;		/* sequence count - odd during updates */
-	u16 tk_is_cntvct;	/* fall back to syscall if false */
+	u16 clock_mode;		/* VDSO_CLOCK_* */
 	u16 cs_shift;		/* clocksource shift */
 	u32 xtime_coarse_sec;	/* coarse time */
 	u32 xtime_coarse_nsec;
@@ -46,6 +51,7 @@ struct vdso_data {
 	u64 xtime_clock_snsec;	/* CLOCK_REALTIME sub-ns base */
 	u32 tz_minuteswest;	/* timezone info for gettimeofday(2) */
 	u32 tz_dsttime;
+	u32 cs_mmio_offset;	/* VDSO_CLOCK_MMIO counter offset in its page */
 };
 
 union vdso_data_store {
@@ -18,6 +18,7 @@
  */
 
 #include <linux/cache.h>
+#include <linux/clocksource.h>
 #include <linux/elf.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
@@ -58,6 +59,37 @@ static struct vm_special_mapping vdso_text_mapping __ro_after_init = {
 	.name = "[vdso]",
 };
 
+/*
+ * Memory-mapped counter for platforms whose arch timer, if any, cannot be
+ * read from user space. Its page is mapped read-only and uncached right
+ * below the data page.
+ */
+static struct clocksource *vdso_mmio_cs __ro_after_init;
+static unsigned long vdso_mmio_pfn __ro_after_init;
+static u32 vdso_mmio_offset __ro_after_init;
+
+static int vdso_mmio_fault(const struct vm_special_mapping *sm,
+			   struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	int ret;
+
+	ret = vm_insert_pfn_prot(vma, (unsigned long)vmf->virtual_address,
+				 vdso_mmio_pfn,
+				 pgprot_noncached(vma->vm_page_prot));
+	if (ret && ret != -EBUSY)
+		return VM_FAULT_SIGBUS;
+
+	return VM_FAULT_NOPAGE;
+}
+
+static const struct vm_special_mapping vdso_mmio_mapping = {
+	.name = "[vvar_mmio]",
+	.fault = vdso_mmio_fault,
+};
+
+/* Pages below the text: the data page, and the counter page if any. */
+static unsigned int vdso_data_pages __ro_after_init = 1;
+
 struct elfinfo {
 	Elf32_Ehdr	*hdr;		/* ptr to ELF */
 	Elf32_Sym	*dynsym;	/* ptr to .dynsym section */
@@ -164,11 +196,11 @@ static void __init patch_vdso(void *ehdr)
 	einfo.dynsym = find_section(einfo.hdr, ".dynsym", &einfo.dynsymsize);
 	einfo.dynstr = find_section(einfo.hdr, ".dynstr", NULL);
 
-	/* If the virtual counter is absent or non-functional we don't
-	 * want programs to incur the slight additional overhead of
+	/* If there is no counter user space can read, we don't want
+	 * programs to incur the slight additional overhead of
 	 * dispatching through the VDSO only to fall back to syscalls.
 	 */
-	if (!cntvct_ok) {
+	if (!cntvct_ok && !vdso_mmio_cs) {
 		vdso_nullpatch_one(&einfo, "__vdso_gettimeofday");
 		vdso_nullpatch_one(&einfo, "__vdso_clock_gettime");
 	}
@@ -206,7 +238,12 @@ static int __init vdso_init(void)
 
 	vdso_text_mapping.pages = vdso_text_pagelist;
 
-	vdso_total_pages = 1; /* for the data/vvar page */
+	if (vdso_mmio_cs) {
+		vdso_data->cs_mmio_offset = vdso_mmio_offset;
+		vdso_data_pages++;
+	}
+
+	vdso_total_pages = vdso_data_pages; /* for the data/vvar pages */
 	vdso_total_pages += text_pages;
 
 	cntvct_ok = cntvct_functional();
@@ -217,6 +254,33 @@ static int __init vdso_init(void)
 }
 arch_initcall(vdso_init);
 
+/**
+ * arm_vdso_set_mmio_counter - let the vdso read a memory-mapped counter
+ * @cs: clocksource the counter belongs to
+ * @addr: physical address of the 32-bit, free running up counter
+ *
+ * The page holding the counter is mapped read-only into every process,
+ * so it must not hold registers that have side effects on reads or that
+ * should be kept from user space. To be called before arch initcalls.
+ */
+void __init arm_vdso_set_mmio_counter(struct clocksource *cs, phys_addr_t addr)
+{
+	vdso_mmio_cs = cs;
+	vdso_mmio_pfn = __phys_to_pfn(addr);
+	vdso_mmio_offset = addr & ~PAGE_MASK;
+}
+
+static int install_mmio(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	vma = _install_special_mapping(mm, addr, PAGE_SIZE,
+				       VM_READ | VM_MAYREAD | VM_IO | VM_PFNMAP,
+				       &vdso_mmio_mapping);
+
+	return PTR_ERR_OR_ZERO(vma);
+}
+
 static int install_vvar(struct mm_struct *mm, unsigned long addr)
 {
 	struct vm_area_struct *vma;
@@ -239,12 +303,18 @@ void arm_install_vdso(struct mm_struct *mm, unsigned long addr)
 	if (vdso_text_pagelist == NULL)
 		return;
 
+	if (vdso_mmio_cs) {
+		if (install_mmio(mm, addr))
+			return;
+		addr += PAGE_SIZE;
+	}
+
 	if (install_vvar(mm, addr))
 		return;
 
 	/* Account for vvar page. */
 	addr += PAGE_SIZE;
-	len = (vdso_total_pages - 1) << PAGE_SHIFT;
+	len = (vdso_total_pages - vdso_data_pages) << PAGE_SHIFT;
 
 	vma = _install_special_mapping(mm, addr, len,
 		VM_READ | VM_EXEC | VM_MAYREAD | VM_MAYWRITE | VM_MAYEXEC,
@@ -266,15 +336,16 @@ static void vdso_write_end(struct vdso_data *vdata)
 	++vdso_data->seq_count;
 }
 
-static bool tk_is_cntvct(const struct timekeeper *tk)
+static u16 tk_clock_mode(const struct timekeeper *tk)
 {
-	if (!IS_ENABLED(CONFIG_ARM_ARCH_TIMER))
-		return false;
+	if (IS_ENABLED(CONFIG_ARM_ARCH_TIMER) && cntvct_ok &&
+	    tk->tkr_mono.clock->archdata.vdso_direct)
+		return VDSO_CLOCK_CNTVCT;
 
-	if (!tk->tkr_mono.clock->archdata.vdso_direct)
-		return false;
+	if (vdso_mmio_cs && tk->tkr_mono.clock == vdso_mmio_cs)
+		return VDSO_CLOCK_MMIO;
 
-	return true;
+	return VDSO_CLOCK_NONE;
 }
 
 /**
@@ -282,8 +353,8 @@ static bool tk_is_cntvct(const struct timekeeper *tk)
  *
  * Increment the sequence counter, making it odd, indicating to
  * userspace that an update is in progress.  Update the fields used
- * for coarse clocks and, if the architected system timer is in use,
- * the fields used for high precision clocks.  Increment the sequence
+ * for coarse clocks and, if a user readable counter is in use, the
+ * fields used for high precision clocks.  Increment the sequence
  * counter again, making it even, indicating to userspace that the
  * update is finished.
  *
@@ -299,7 +370,7 @@ void update_vsyscall(struct timekeeper *tk)
 {
 	struct timespec64 *wtm = &tk->wall_to_monotonic;
 
-	if (!cntvct_ok) {
+	if (!cntvct_ok && !vdso_mmio_cs) {
 		/* The entry points have been zeroed, so there is no
 		 * point in updating the data page.
 		 */
@@ -308,14 +379,14 @@ void update_vsyscall(struct timekeeper *tk)
 
 	vdso_write_begin(vdso_data);
 
-	vdso_data->tk_is_cntvct			= tk_is_cntvct(tk);
+	vdso_data->clock_mode			= tk_clock_mode(tk);
 	vdso_data->xtime_coarse_sec		= tk->xtime_sec;
 	vdso_data->xtime_coarse_nsec		= (u32)(tk->tkr_mono.xtime_nsec >>
 							tk->tkr_mono.shift);
 	vdso_data->wtm_clock_sec		= wtm->tv_sec;
 	vdso_data->wtm_clock_nsec		= wtm->tv_nsec;
 
-	if (vdso_data->tk_is_cntvct) {
+	if (vdso_data->clock_mode != VDSO_CLOCK_NONE) {
 		vdso_data->cs_cycle_last	= tk->tkr_mono.cycle_last;
 		vdso_data->xtime_clock_sec	= tk->xtime_sec;
 		vdso_data->xtime_clock_snsec	= tk->tkr_mono.xtime_nsec;
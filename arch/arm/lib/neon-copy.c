@@ -0,0 +1,219 @@
+/*
+ *  linux/arch/arm/lib/neon-copy.c
+ *
+ *  NEON versions of memcpy(), memset(), __memzero() and copy_page() for
+ *  large buffers, overriding the weak LDM/STM implementations.
+ *
+ *  Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/gfp.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+#include <asm/simd.h>
+#include <asm/string.h>
+
+#undef memset
+
+/* below this the VFP state save in kernel_neon_begin() is not recovered */
+#define NEON_COPY_MIN		4096
+#define NEON_COPY_CHUNK		64
+
+#define NEON_BENCH_SIZE		(4 * PAGE_SIZE)
+#define NEON_BENCH_LOOPS	64
+
+asmlinkage void __neon_copy(void *dest, const void *src, size_t n);
+asmlinkage void __neon_set(void *s, int c, size_t n);
+
+asmlinkage void *__memcpy_std(void *dest, const void *src, size_t n);
+asmlinkage void *__memset_std(void *s, int c, size_t n);
+asmlinkage void __memzero_std(void *s, size_t n);
+asmlinkage void __copy_page_std(void *to, const void *from);
+
+static DEFINE_STATIC_KEY_FALSE(neon_memcpy);
+static DEFINE_STATIC_KEY_FALSE(neon_memset);
+static DEFINE_STATIC_KEY_FALSE(neon_copy_page);
+
+/*
+ * Kernel mode NEON does not nest, and we may well be called from inside
+ * someone else's section. Only the owner of this CPU can set the flag, so
+ * reading it while preemptible is fine.
+ */
+static inline bool neon_copy_ok(void)
+{
+	return may_use_simd() && !raw_cpu_read(kernel_neon_busy);
+}
+
+static void neon_set(void *s, int c, size_t n)
+{
+	size_t len = round_down(n, NEON_COPY_CHUNK);
+
+	kernel_neon_begin();
+	__neon_set(s, c, len);
+	kernel_neon_end();
+
+	if (n != len)
+		__memset_std(s + len, c, n - len);
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	size_t len;
+
+	if (n < NEON_COPY_MIN || !static_branch_unlikely(&neon_memcpy) ||
+	    !neon_copy_ok())
+		return __memcpy_std(dest, src, n);
+
+	len = round_down(n, NEON_COPY_CHUNK);
+
+	kernel_neon_begin();
+	__neon_copy(dest, src, len);
+	kernel_neon_end();
+
+	if (n != len)
+		__memcpy_std(dest + len, src + len, n - len);
+	return dest;
+}
+
+void *memset(void *s, int c, size_t n)
+{
+	if (n < NEON_COPY_MIN || !static_branch_unlikely(&neon_memset) ||
+	    !neon_copy_ok())
+		return __memset_std(s, c, n);
+
+	neon_set(s, c, n);
+	return s;
+}
+
+void __memzero(void *s, size_t n)
+{
+	if (n < NEON_COPY_MIN || !static_branch_unlikely(&neon_memset) ||
+	    !neon_copy_ok())
+		__memzero_std(s, n);
+	else
+		neon_set(s, 0, n);
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!static_branch_unlikely(&neon_copy_page) || !neon_copy_ok()) {
+		__copy_page_std(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__neon_copy(to, from, PAGE_SIZE);
+	kernel_neon_end();
+}
+
+/*
+ * Like lib/raid6, time both implementations once at boot on warm buffers
+ * and keep whichever is faster, in MB/s.
+ */
+static unsigned int __init neon_bench_mbps(u64 ns)
+{
+	return div64_u64((u64)NEON_BENCH_SIZE * NEON_BENCH_LOOPS * 1000,
+			 max_t(u64, ns, 1));
+}
+
+enum neon_bench_op { BENCH_MEMCPY, BENCH_MEMSET, BENCH_COPY_PAGE };
+
+static u64 __init neon_bench_run(enum neon_bench_op op, bool neon,
+				 void *dst, void *src)
+{
+	u64 t0;
+	int i, j;
+
+	preempt_disable();
+	t0 = local_clock();
+	for (i = 0; i < NEON_BENCH_LOOPS; i++) {
+		if (neon)
+			kernel_neon_begin();
+
+		switch (op) {
+		case BENCH_MEMCPY:
+			if (neon)
+				__neon_copy(dst, src, NEON_BENCH_SIZE);
+			else
+				__memcpy_std(dst, src, NEON_BENCH_SIZE);
+			break;
+		case BENCH_MEMSET:
+			if (neon)
+				__neon_set(dst, 0, NEON_BENCH_SIZE);
+			else
+				__memzero_std(dst, NEON_BENCH_SIZE);
+			break;
+		case BENCH_COPY_PAGE:
+			for (j = 0; j < NEON_BENCH_SIZE; j += PAGE_SIZE) {
+				if (neon)
+					__neon_copy(dst + j, src + j,
+						    PAGE_SIZE);
+				else
+					__copy_page_std(dst + j, src + j);
+			}
+			break;
+		}
+
+		if (neon)
+			kernel_neon_end();
+	}
+	t0 = local_clock() - t0;
+	preempt_enable();
+
+	return t0;
+}
+
+static bool __init neon_bench_pick(const char *name, enum neon_bench_op op,
+				   void *dst, void *src)
+{
+	unsigned int std, neon;
+
+	/* warm up the caches and TLB first */
+	neon_bench_run(op, false, dst, src);
+	std = neon_bench_mbps(neon_bench_run(op, false, dst, src));
+	neon = neon_bench_mbps(neon_bench_run(op, true, dst, src));
+
+	pr_info("neon-copy: %-9s ldm/stm %5u MB/s, neon %5u MB/s\n",
+		name, std, neon);
+	return neon > std;
+}
+
+static int __init neon_copy_init(void)
+{
+	unsigned int order = get_order(NEON_BENCH_SIZE);
+	struct page *pages;
+	void *src, *dst;
+
+	if (!cpu_has_neon())
+		return 0;
+
+	pages = alloc_pages(GFP_KERNEL, order + 1);
+	if (!pages)
+		return -ENOMEM;
+
+	src = page_address(pages);
+	dst = src + NEON_BENCH_SIZE;
+	__memset_std(src, 0x5a, NEON_BENCH_SIZE);
+
+	if (neon_bench_pick("memcpy", BENCH_MEMCPY, dst, src))
+		static_branch_enable(&neon_memcpy);
+	if (neon_bench_pick("memset", BENCH_MEMSET, dst, src))
+		static_branch_enable(&neon_memset);
+	if (neon_bench_pick("copy_page", BENCH_COPY_PAGE, dst, src))
+		static_branch_enable(&neon_copy_page);
+
+	__free_pages(pages, order + 1);
+	return 0;
+}
+late_initcall(neon_copy_init);
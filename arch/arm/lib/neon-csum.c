@@ -0,0 +1,161 @@
+/*
+ *  linux/arch/arm/lib/neon-csum.c
+ *
+ *  NEON csum_partial() and checksumming copies for large buffers,
+ *  overriding the weak ADCS implementations.
+ *
+ *  Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/preempt.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <net/checksum.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* also the benchmark size, so the switch is only made if it pays here */
+#define NEON_CSUM_MIN		1024
+#define NEON_CSUM_CHUNK		64
+#define NEON_CSUM_LOOPS		256
+
+asmlinkage u64 __csum_neon(const void *buf, size_t len);
+
+asmlinkage __wsum __csum_partial_std(const void *buff, int len, __wsum sum);
+asmlinkage __wsum __csum_partial_copy_nocheck_std(const void *src, void *dst,
+						  int len, __wsum sum);
+asmlinkage __wsum
+__csum_partial_copy_from_user_std(const void __user *src, void *dst, int len,
+				  __wsum sum, int *err_ptr);
+
+static DEFINE_STATIC_KEY_FALSE(neon_csum);
+
+/* see neon_copy_ok() in neon-copy.c */
+static inline bool neon_csum_ok(int len)
+{
+	return len >= NEON_CSUM_MIN && static_branch_unlikely(&neon_csum) &&
+	       may_use_simd() && !raw_cpu_read(kernel_neon_busy);
+}
+
+static __wsum neon_csum_partial(const void *buff, int len, __wsum wsum)
+{
+	int blen = round_down(len, NEON_CSUM_CHUNK);
+	u64 sum64;
+	u32 sum;
+
+	kernel_neon_begin();
+	sum64 = __csum_neon(buff, blen);
+	kernel_neon_end();
+
+	/* end around carry, twice as the first fold can carry again */
+	sum64 = (sum64 & 0xffffffff) + (sum64 >> 32);
+	sum = (sum64 & 0xffffffff) + (sum64 >> 32);
+	wsum = csum_add(wsum, (__force __wsum)sum);
+
+	/* blen is even, so the tail keeps the halfword pairing */
+	if (len != blen)
+		wsum = __csum_partial_std(buff + blen, len - blen, wsum);
+	return wsum;
+}
+
+__wsum csum_partial(const void *buff, int len, __wsum wsum)
+{
+	if (!neon_csum_ok(len))
+		return __csum_partial_std(buff, len, wsum);
+
+	return neon_csum_partial(buff, len, wsum);
+}
+
+/*
+ * The copying variants make two passes, the checksum then runs on the
+ * destination while it is still in the cache.
+ */
+__wsum csum_partial_copy_nocheck(const void *src, void *dst, int len,
+				 __wsum sum)
+{
+	if (!neon_csum_ok(len))
+		return __csum_partial_copy_nocheck_std(src, dst, len, sum);
+
+	memcpy(dst, src, len);
+	return neon_csum_partial(dst, len, sum);
+}
+
+__wsum csum_partial_copy_from_user(const void __user *src, void *dst,
+				   int len, __wsum sum, int *err_ptr)
+{
+	/*
+	 * On a fault let the ADCS version redo the copy, it knows how to
+	 * report it and zero the rest of dst.
+	 */
+	if (!neon_csum_ok(len) || __copy_from_user(dst, src, len))
+		return __csum_partial_copy_from_user_std(src, dst, len, sum,
+							 err_ptr);
+
+	return neon_csum_partial(dst, len, sum);
+}
+
+static u64 __init neon_csum_bench(bool neon, const void *buf)
+{
+	u64 t0;
+	int i;
+
+	preempt_disable();
+	t0 = local_clock();
+	for (i = 0; i < NEON_CSUM_LOOPS; i++) {
+		if (neon)
+			neon_csum_partial(buf, NEON_CSUM_MIN, 0);
+		else
+			__csum_partial_std(buf, NEON_CSUM_MIN, 0);
+	}
+	t0 = local_clock() - t0;
+	preempt_enable();
+
+	return div64_u64((u64)NEON_CSUM_MIN * NEON_CSUM_LOOPS * 1000,
+			 max_t(u64, t0, 1));
+}
+
+static int __init neon_csum_init(void)
+{
+	unsigned int std, neon;
+	u8 *buf;
+
+	if (!cpu_has_neon())
+		return 0;
+
+	buf = kmalloc(NEON_CSUM_MIN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	get_random_bytes(buf, NEON_CSUM_MIN);
+
+	/* both have to agree before NEON gets anywhere near the network */
+	if (csum_fold(neon_csum_partial(buf, NEON_CSUM_MIN - 2, 0)) !=
+	    csum_fold(__csum_partial_std(buf, NEON_CSUM_MIN - 2, 0))) {
+		pr_err("neon-csum: checksum mismatch, not using NEON\n");
+		goto out;
+	}
+
+	/* warm up the cache first */
+	neon_csum_bench(false, buf);
+	std = neon_csum_bench(false, buf);
+	neon = neon_csum_bench(true, buf);
+
+	pr_info("neon-csum: csum_partial adcs %5u MB/s, neon %5u MB/s\n",
+		std, neon);
+	if (neon > std)
+		static_branch_enable(&neon_csum);
+out:
+	kfree(buf);
+	return 0;
+}
+late_initcall(neon_csum_init);
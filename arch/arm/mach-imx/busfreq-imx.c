@@ -23,11 +23,13 @@
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
 #include <linux/delay.h>
+#include <linux/devfreq.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/of_fdt.h>
 #include <linux/platform_device.h>
+#include <linux/pm_qos.h>
 #include <linux/proc_fs.h>
 #include <linux/reboot.h>
 #include <linux/regulator/consumer.h>
@@ -36,6 +38,9 @@
 #include "hardware.h"
 #include "common.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/busfreq.h>
+
 #define LPAPM_CLK		24000000
 #define LOW_AUDIO_CLK		50000000
 #define HIGH_AUDIO_CLK		100000000
@@ -126,6 +131,8 @@ static struct clk *pll3_pfd1_540m_clk;
 
 static struct delayed_work low_bus_freq_handler;
 static struct delayed_work bus_freq_daemon;
+static struct work_struct bus_freq_raise_work;
+static DECLARE_WAIT_QUEUE_HEAD(bus_freq_wq);
 
 static RAW_NOTIFIER_HEAD(busfreq_notifier_chain);
 
@@ -653,6 +660,9 @@ static void exit_lpm_imx7d(void)
 
 static void reduce_bus_freq(void)
 {
+	int from = cur_bus_freq_mode;
+	ktime_t start = ktime_get();
+
 	if (cpu_is_imx6())
 		clk_prepare_enable(pll3_clk);
 
@@ -676,6 +686,10 @@ static void reduce_bus_freq(void)
 	if (cpu_is_imx6())
 		clk_disable_unprepare(pll3_clk);
 
+	trace_busfreq_transition(from, cur_bus_freq_mode,
+				 ktime_to_ns(ktime_sub(ktime_get(), start)));
+	wake_up_all(&bus_freq_wq);
+
 	if (audio_bus_freq_mode)
 		dev_dbg(busfreq_dev,
 			"Bus freq set to audio mode. Count: high %d, med %d, audio %d\n",
@@ -741,6 +755,9 @@ static inline void cancel_low_bus_freq_handler(void)
  */
 static int set_high_bus_freq(int high_bus_freq)
 {
+	ktime_t start;
+	int from;
+
 	if (bus_freq_scaling_initialized && bus_freq_scaling_is_active)
 		cancel_low_bus_freq_handler();
 
@@ -757,6 +774,9 @@ static int set_high_bus_freq(int high_bus_freq)
 	if (med_bus_freq_mode && !high_bus_freq)
 		return 0;
 
+	from = cur_bus_freq_mode;
+	start = ktime_get();
+
 	if (low_bus_freq_mode || ultra_low_bus_freq_mode)
 		busfreq_notify(LOW_BUSFREQ_EXIT);
 
@@ -781,6 +801,11 @@ static int set_high_bus_freq(int high_bus_freq)
 	if (cpu_is_imx6())
 		clk_disable_unprepare(pll3_clk);
 
+	trace_busfreq_transition(from, cur_bus_freq_mode,
+				 ktime_to_ns(ktime_sub(ktime_get(), start)));
+	busfreq_notify(HIGH_BUSFREQ_ENTER);
+	wake_up_all(&bus_freq_wq);
+
 	if (high_bus_freq_mode)
 		dev_dbg(busfreq_dev,
 			"Bus freq set to high mode. Count: high %d, med %d, audio %d\n",
@@ -793,14 +818,15 @@ static int set_high_bus_freq(int high_bus_freq)
 	return 0;
 }
 
-void request_bus_freq(enum bus_freq_mode mode)
+/*
+ * Account a request for @mode. Returns true if the bus may have to be
+ * raised to satisfy it, with bus_freq_mutex held by the caller.
+ */
+static bool __request_bus_freq(enum bus_freq_mode mode)
 {
-	mutex_lock(&bus_freq_mutex);
-
 	if (mode == BUS_FREQ_ULTRA_LOW) {
 		dev_dbg(busfreq_dev, "This mode cannot be requested!\n");
-		mutex_unlock(&bus_freq_mutex);
-		return;
+		return false;
 	}
 
 	if (mode == BUS_FREQ_HIGH)
@@ -813,35 +839,111 @@ void request_bus_freq(enum bus_freq_mode mode)
 		low_bus_count++;
 
 	if (busfreq_suspended || !bus_freq_scaling_initialized ||
-		!bus_freq_scaling_is_active) {
-		mutex_unlock(&bus_freq_mutex);
-		return;
-	}
+		!bus_freq_scaling_is_active)
+		return false;
 
 	cancel_low_bus_freq_handler();
 
+	return true;
+}
+
+static void raise_bus_freq(enum bus_freq_mode mode)
+{
 	if ((mode == BUS_FREQ_HIGH) && (!high_bus_freq_mode)) {
 		set_high_bus_freq(1);
-		mutex_unlock(&bus_freq_mutex);
 		return;
 	}
 
 	if ((mode == BUS_FREQ_MED) && (!high_bus_freq_mode) &&
 		(!med_bus_freq_mode)) {
 		set_high_bus_freq(0);
-		mutex_unlock(&bus_freq_mutex);
 		return;
 	}
 	if ((mode == BUS_FREQ_AUDIO) && (!high_bus_freq_mode) &&
-		(!med_bus_freq_mode) && (!audio_bus_freq_mode)) {
+		(!med_bus_freq_mode) && (!audio_bus_freq_mode))
 		set_low_bus_freq();
-		mutex_unlock(&bus_freq_mutex);
-		return;
-	}
+}
+
+static void bus_freq_raise_handler(struct work_struct *work)
+{
+	mutex_lock(&bus_freq_mutex);
+
+	if (busfreq_suspended || !bus_freq_scaling_initialized ||
+		!bus_freq_scaling_is_active)
+		goto out;
+
+	/* requests may have been released while the work was pending */
+	if (high_bus_count)
+		raise_bus_freq(BUS_FREQ_HIGH);
+	else if (med_bus_count)
+		raise_bus_freq(BUS_FREQ_MED);
+	else if (audio_bus_count)
+		raise_bus_freq(BUS_FREQ_AUDIO);
+out:
+	mutex_unlock(&bus_freq_mutex);
+}
+
+void request_bus_freq(enum bus_freq_mode mode)
+{
+	mutex_lock(&bus_freq_mutex);
+
+	if (__request_bus_freq(mode))
+		raise_bus_freq(mode);
+
 	mutex_unlock(&bus_freq_mutex);
 }
 EXPORT_SYMBOL(request_bus_freq);
 
+/*
+ * Same as request_bus_freq() but the frequency change, which parks all
+ * the other CPUs, is done from a work item instead of the caller's
+ * context. Use wait_for_bus_freq() or the HIGH_BUSFREQ_ENTER notifier
+ * if the caller needs to know when the requested mode is reached.
+ */
+void request_bus_freq_nowait(enum bus_freq_mode mode)
+{
+	mutex_lock(&bus_freq_mutex);
+
+	if (__request_bus_freq(mode))
+		schedule_work(&bus_freq_raise_work);
+
+	mutex_unlock(&bus_freq_mutex);
+}
+EXPORT_SYMBOL(request_bus_freq_nowait);
+
+static bool bus_freq_mode_reached(enum bus_freq_mode mode)
+{
+	if (busfreq_suspended || !bus_freq_scaling_initialized ||
+		!bus_freq_scaling_is_active)
+		return true;
+
+	switch (mode) {
+	case BUS_FREQ_HIGH:
+		return high_bus_freq_mode;
+	case BUS_FREQ_MED:
+		return high_bus_freq_mode || med_bus_freq_mode;
+	case BUS_FREQ_AUDIO:
+		return high_bus_freq_mode || med_bus_freq_mode ||
+			audio_bus_freq_mode;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Wait until the bus runs at least at @mode. Returns 0 once the mode is
+ * reached or -ETIMEDOUT after @timeout jiffies.
+ */
+int wait_for_bus_freq(enum bus_freq_mode mode, unsigned long timeout)
+{
+	if (!wait_event_timeout(bus_freq_wq, bus_freq_mode_reached(mode),
+				timeout))
+		return -ETIMEDOUT;
+
+	return 0;
+}
+EXPORT_SYMBOL(wait_for_bus_freq);
+
 void release_bus_freq(enum bus_freq_mode mode)
 {
 	mutex_lock(&bus_freq_mutex);
@@ -1072,6 +1174,139 @@ static struct notifier_block imx_busfreq_reboot_notifier = {
 static DEVICE_ATTR(enable, 0644, bus_freq_scaling_enable_show,
 			bus_freq_scaling_enable_store);
 
+#if IS_ENABLED(CONFIG_DEVFREQ_GOV_SIMPLE_ONDEMAND)
+/*
+ * DDR utilisation governor. The MMDC profiling counters are sampled by
+ * devfreq and, when the load calls for it, an extra BUS_FREQ_HIGH
+ * request is held on behalf of the CPU. Requests from drivers are left
+ * untouched, so they keep acting as a floor.
+ */
+static unsigned long busfreq_devfreq_table[2];
+static bool busfreq_devfreq_high;
+
+static struct devfreq_simple_ondemand_data busfreq_ondemand_data = {
+	.upthreshold = 60,
+	.downdifferential = 20,
+};
+
+static unsigned long busfreq_cur_rate(void)
+{
+	if (high_bus_freq_mode || med_bus_freq_mode)
+		return ddr_normal_rate;
+
+	return ddr_low_rate;
+}
+
+static int busfreq_devfreq_target(struct device *dev, unsigned long *freq,
+				  u32 flags)
+{
+	bool high = *freq > ddr_low_rate;
+
+	if (high && !busfreq_devfreq_high)
+		request_bus_freq(BUS_FREQ_HIGH);
+	else if (!high && busfreq_devfreq_high)
+		release_bus_freq(BUS_FREQ_HIGH);
+
+	busfreq_devfreq_high = high;
+	*freq = high ? ddr_normal_rate : ddr_low_rate;
+
+	return 0;
+}
+
+static int busfreq_devfreq_get_dev_status(struct device *dev,
+					  struct devfreq_dev_status *stat)
+{
+	u32 busy, total;
+
+	stat->current_frequency = busfreq_cur_rate();
+
+	/*
+	 * Without a valid sample (perf owns the counters, or the cycle
+	 * counter wrapped) report no load information, the governor then
+	 * picks the highest rate.
+	 */
+	if (imx_mmdc_get_utilisation(&busy, &total)) {
+		stat->busy_time = 0;
+		stat->total_time = 0;
+		return 0;
+	}
+
+	stat->busy_time = busy;
+	stat->total_time = total;
+
+	return 0;
+}
+
+static int busfreq_devfreq_get_cur_freq(struct device *dev,
+					unsigned long *freq)
+{
+	*freq = busfreq_cur_rate();
+
+	return 0;
+}
+
+static struct devfreq_dev_profile busfreq_devfreq_profile = {
+	.polling_ms	= 100,
+	.target		= busfreq_devfreq_target,
+	.get_dev_status	= busfreq_devfreq_get_dev_status,
+	.get_cur_freq	= busfreq_devfreq_get_cur_freq,
+	.freq_table	= busfreq_devfreq_table,
+	.max_state	= ARRAY_SIZE(busfreq_devfreq_table),
+};
+
+static void busfreq_devfreq_init(struct device *dev)
+{
+	struct devfreq *devfreq;
+	u32 busy, total;
+
+	/* i.MX7D DDRC has no utilisation counters, keep reference counting */
+	if (imx_mmdc_get_utilisation(&busy, &total) == -ENODEV)
+		return;
+
+	busfreq_devfreq_table[0] = ddr_low_rate;
+	busfreq_devfreq_table[1] = ddr_normal_rate;
+	busfreq_devfreq_profile.initial_freq = ddr_normal_rate;
+
+	devfreq = devm_devfreq_add_device(dev, &busfreq_devfreq_profile,
+					  "simple_ondemand",
+					  &busfreq_ondemand_data);
+	if (IS_ERR(devfreq))
+		dev_warn(dev, "failed to add devfreq device: %ld\n",
+			 PTR_ERR(devfreq));
+}
+#else
+static inline void busfreq_devfreq_init(struct device *dev) {}
+#endif
+
+/*
+ * Memory bandwidth votes, e.g. from the schedutil governor, arrive as a
+ * PM_QOS_MEMORY_BANDWIDTH sum in MB/s. When it exceeds what DDR can carry
+ * at the low rate (two transfers per clock on a 32-bit bus) a
+ * BUS_FREQ_HIGH request is held, like for any other high speed device.
+ */
+static bool busfreq_qos_high;
+static DEFINE_MUTEX(busfreq_qos_mutex);
+
+static int busfreq_qos_notify(struct notifier_block *nb,
+			      unsigned long mbps, void *data)
+{
+	bool high = mbps > ddr_low_rate / 1000000 * 8;
+
+	mutex_lock(&busfreq_qos_mutex);
+	if (high && !busfreq_qos_high)
+		request_bus_freq_nowait(BUS_FREQ_HIGH);
+	else if (!high && busfreq_qos_high)
+		release_bus_freq(BUS_FREQ_HIGH);
+	busfreq_qos_high = high;
+	mutex_unlock(&busfreq_qos_mutex);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block busfreq_qos_notifier = {
+	.notifier_call = busfreq_qos_notify,
+};
+
 /*!
  * This is the probe routine for the bus frequency driver.
  *
@@ -1248,6 +1483,7 @@ static int busfreq_probe(struct platform_device *pdev)
 
 	INIT_DELAYED_WORK(&low_bus_freq_handler, reduce_bus_freq_handler);
 	INIT_DELAYED_WORK(&bus_freq_daemon, bus_freq_daemon_handler);
+	INIT_WORK(&bus_freq_raise_work, bus_freq_raise_handler);
 	register_pm_notifier(&imx_bus_freq_pm_notifier);
 	register_reboot_notifier(&imx_busfreq_reboot_notifier);
 
@@ -1318,6 +1554,13 @@ static int busfreq_probe(struct platform_device *pdev)
 		dev_err(busfreq_dev, "Busfreq init of ddr controller failed\n");
 		return err;
 	}
+
+	busfreq_devfreq_init(busfreq_dev);
+	pm_qos_add_notifier(PM_QOS_MEMORY_BANDWIDTH, &busfreq_qos_notifier);
+	/* pick up the votes cast before the driver probed */
+	busfreq_qos_notify(&busfreq_qos_notifier,
+			   pm_qos_request(PM_QOS_MEMORY_BANDWIDTH), NULL);
+
 	return 0;
 }
 
@@ -43,6 +43,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/smp.h>
+#include <trace/events/busfreq.h>
 
 #include "hardware.h"
 #include "common.h"
@@ -255,6 +256,7 @@ int update_ddr_freq_imx_smp(int ddr_rate)
 {
 	int me = 0;
 	unsigned long ttbr1;
+	u64 parked;
 	bool dll_off = false;
 	int i;
 #ifdef CONFIG_SMP
@@ -289,6 +291,7 @@ int update_ddr_freq_imx_smp(int ddr_rate)
 
 	/* ensure that all Cores are in WFE. */
 	local_irq_disable();
+	parked = ktime_get_ns();
 
 #ifdef CONFIG_SMP
 	me = smp_processor_id();
@@ -370,6 +373,8 @@ int update_ddr_freq_imx_smp(int ddr_rate)
 
 	local_irq_enable();
 
+	trace_busfreq_ddr_update(ddr_rate, ktime_get_ns() - parked);
+
 	printk(KERN_DEBUG "Bus freq set to %d done! cpu=%d\n", ddr_rate, me);
 
 	return 0;
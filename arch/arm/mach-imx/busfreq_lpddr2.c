@@ -44,6 +44,7 @@
 #include <linux/sched.h>
 #include <linux/smp.h>
 #include <linux/slab.h>
+#include <trace/events/busfreq.h>
 
 #include "common.h"
 #include "hardware.h"
@@ -184,6 +185,7 @@ int init_mmdc_lpddr2_settings(struct platform_device *busfreq_pdev)
 int update_lpddr2_freq_smp(int ddr_rate)
 {
 	unsigned long ttbr1;
+	u64 parked;
 	int i, me = 0;
 #ifdef CONFIG_SMP
 	int cpu = 0;
@@ -206,6 +208,7 @@ int update_lpddr2_freq_smp(int ddr_rate)
 
 	/* ensure that all Cores are in WFE. */
 	local_irq_disable();
+	parked = ktime_get_ns();
 
 #ifdef CONFIG_SMP
 	me = smp_processor_id();
@@ -274,6 +277,8 @@ int update_lpddr2_freq_smp(int ddr_rate)
 
 	local_irq_enable();
 
+	trace_busfreq_ddr_update(ddr_rate, ktime_get_ns() - parked);
+
 	printk(KERN_DEBUG "Bus freq set to %d done! cpu=%d\n", ddr_rate, me);
 
 	return 0;
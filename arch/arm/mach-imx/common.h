@@ -173,9 +173,27 @@ int imx7ulp_set_lpm(enum imx7ulp_cpu_pwr_mode mode);
 #ifdef CONFIG_HAVE_IMX_MMDC
 int imx_mmdc_get_ddr_type(void);
 int imx_mmdc_get_lpddr2_2ch_mode(void);
+int imx_mmdc_get_utilisation(u32 *busy, u32 *total);
 #else
 static inline int imx_mmdc_get_ddr_type(void) { return 0; }
 static inline int imx_mmdc_get_lpddr2_2ch_mode(void) { return 0; }
+static inline int imx_mmdc_get_utilisation(u32 *busy, u32 *total)
+{
+	return -ENODEV;
+}
+#endif
+enum imx_pm_prof_point {
+	IMX_PM_PROF_ENTER,	/* platform suspend entry */
+	IMX_PM_PROF_SLEEP,	/* right before the low level suspend */
+	IMX_PM_PROF_WAKE,	/* back from the low level suspend */
+	IMX_PM_PROF_EXIT,	/* platform resume done */
+	IMX_PM_PROF_NR,
+};
+
+#ifdef CONFIG_IMX_PM_PROFILE
+void imx_pm_profile_mark(enum imx_pm_prof_point point);
+#else
+static inline void imx_pm_profile_mark(enum imx_pm_prof_point point) {}
 #endif
 #ifdef CONFIG_HAVE_IMX_DDRC
 int imx_ddrc_get_ddr_type(void);
@@ -6,7 +6,9 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/cpu.h>
 #include <linux/cpuidle.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <asm/cpuidle.h>
 
@@ -16,13 +18,60 @@
 #include "cpuidle.h"
 #include "hardware.h"
 
+#define WAIT_LAT_UPDATE_PERIOD	256
+
 static atomic_t master = ATOMIC_INIT(0);
 static DEFINE_SPINLOCK(master_lock);
 
+/*
+ * Software entry/exit cost of WAIT unclocked, measured on the CPU that
+ * actually gates the clocks.
+ */
+struct imx6q_wait_lat {
+	u64 entry_ns;
+	u64 exit_ns;
+	u32 entry_max_ns;
+	u32 exit_max_ns;
+	u32 count;
+};
+
+static DEFINE_PER_CPU(struct imx6q_wait_lat, imx6q_wait_lat);
+
+static void imx6q_wait_account(struct cpuidle_state *state, u32 entry_ns,
+			       u32 exit_ns)
+{
+	struct imx6q_wait_lat *lat = this_cpu_ptr(&imx6q_wait_lat);
+	unsigned int lat_us;
+
+	lat->entry_ns += entry_ns;
+	lat->exit_ns += exit_ns;
+	lat->entry_max_ns = max(lat->entry_max_ns, entry_ns);
+	lat->exit_max_ns = max(lat->exit_max_ns, exit_ns);
+
+	if (++lat->count % WAIT_LAT_UPDATE_PERIOD)
+		return;
+
+	/*
+	 * The static values also account for the hardware clock restart,
+	 * which cannot be observed from here, so only ever raise them.
+	 */
+	lat_us = DIV_ROUND_UP(lat->entry_max_ns + lat->exit_max_ns,
+			      NSEC_PER_USEC);
+	if (lat_us > state->exit_latency) {
+		WRITE_ONCE(state->exit_latency, lat_us);
+		WRITE_ONCE(state->target_residency, lat_us * 3 / 2);
+	}
+}
+
 static int imx6q_enter_wait(struct cpuidle_device *dev,
 			    struct cpuidle_driver *drv, int index)
 {
+	ktime_t start = ktime_get();
+
 	if (atomic_inc_return(&master) == num_online_cpus()) {
+		ktime_t idle_in, idle_out;
+		u32 entry_ns, exit_ns;
+
 		/*
 		 * With this lock, we prevent other cpu to exit and enter
 		 * this function again and become the master.
@@ -32,9 +81,14 @@ static int imx6q_enter_wait(struct cpuidle_device *dev,
 		imx6_set_lpm(WAIT_UNCLOCKED);
 		if (atomic_read(&master) != num_online_cpus())
 			imx6_set_lpm(WAIT_CLOCKED);
+		idle_in = ktime_get();
 		cpu_do_idle();
+		idle_out = ktime_get();
 		imx6_set_lpm(WAIT_CLOCKED);
 		spin_unlock(&master_lock);
+		entry_ns = ktime_to_ns(ktime_sub(idle_in, start));
+		exit_ns = ktime_to_ns(ktime_sub(ktime_get(), idle_out));
+		imx6q_wait_account(&drv->states[index], entry_ns, exit_ns);
 		goto done;
 	}
 
@@ -85,10 +139,72 @@ void imx6q_cpuidle_fec_irqs_unused(void)
 }
 EXPORT_SYMBOL_GPL(imx6q_cpuidle_fec_irqs_unused);
 
+static void imx6q_wait_lat_sum(struct imx6q_wait_lat *sum)
+{
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		struct imx6q_wait_lat *lat = per_cpu_ptr(&imx6q_wait_lat, cpu);
+
+		sum->entry_ns += lat->entry_ns;
+		sum->exit_ns += lat->exit_ns;
+		sum->entry_max_ns = max(sum->entry_max_ns, lat->entry_max_ns);
+		sum->exit_max_ns = max(sum->exit_max_ns, lat->exit_max_ns);
+		sum->count += lat->count;
+	}
+
+	if (sum->count) {
+		do_div(sum->entry_ns, sum->count);
+		do_div(sum->exit_ns, sum->count);
+	}
+}
+
+#define IMX6Q_WAIT_LAT_ATTR(_name, _field, _fmt)			\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct imx6q_wait_lat sum;					\
+									\
+	imx6q_wait_lat_sum(&sum);					\
+	return sprintf(buf, _fmt "\n", sum._field);			\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+IMX6Q_WAIT_LAT_ATTR(wait_count, count, "%u");
+IMX6Q_WAIT_LAT_ATTR(wait_entry_avg_ns, entry_ns, "%llu");
+IMX6Q_WAIT_LAT_ATTR(wait_entry_max_ns, entry_max_ns, "%u");
+IMX6Q_WAIT_LAT_ATTR(wait_exit_avg_ns, exit_ns, "%llu");
+IMX6Q_WAIT_LAT_ATTR(wait_exit_max_ns, exit_max_ns, "%u");
+
+static struct attribute *imx6q_cpuidle_attrs[] = {
+	&dev_attr_wait_count.attr,
+	&dev_attr_wait_entry_avg_ns.attr,
+	&dev_attr_wait_entry_max_ns.attr,
+	&dev_attr_wait_exit_avg_ns.attr,
+	&dev_attr_wait_exit_max_ns.attr,
+	NULL,
+};
+
+static const struct attribute_group imx6q_cpuidle_attr_group = {
+	.name = "imx6q_cpuidle",
+	.attrs = imx6q_cpuidle_attrs,
+};
+
 int __init imx6q_cpuidle_init(void)
 {
+	int ret;
+
 	/* Set INT_MEM_CLK_LPM bit to get a reliable WAIT mode support */
 	imx6_set_int_mem_clk_lpm(true);
 
-	return cpuidle_register(&imx6q_cpuidle_driver, NULL);
+	ret = cpuidle_register(&imx6q_cpuidle_driver, NULL);
+	if (ret)
+		return ret;
+
+	if (sysfs_create_group(&cpu_subsys.dev_root->kobj,
+			       &imx6q_cpuidle_attr_group))
+		pr_warn("imx6q_cpuidle: failed to create sysfs group\n");
+
+	return 0;
 }
@@ -12,6 +12,7 @@
 
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/imx_gpc.h>
 #include <linux/io.h>
 #include <linux/irq.h>
 #include <linux/irqchip.h>
@@ -20,8 +21,12 @@
 #include <linux/of_irq.h>
 #include <linux/platform_device.h>
 #include <linux/pm_domain.h>
+#include <linux/pm_runtime.h>
 #include <linux/regulator/consumer.h>
 #include <linux/irqchip/arm-gic.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+#include <linux/workqueue.h>
 #include "common.h"
 #include "hardware.h"
 
@@ -74,8 +79,25 @@
 /* for irq #150 and #151 */
 #define GPC_ENET_WAKEUP_IRQ_MASK        0xC00000
 
+/*
+ * Bookkeeping shared by the PU and display domains: power switch
+ * timing, delayed power off and the context retention notifier.
+ */
+struct gpc_pd_ctx {
+	int (*power_on)(struct generic_pm_domain *genpd);
+	int (*power_off)(struct generic_pm_domain *genpd);
+	struct blocking_notifier_head nh;
+	struct delayed_work off_work;
+	unsigned int off_delay_ms;
+	bool off_expired;
+	u32 on_count;
+	u32 last_on_us, max_on_us;
+	u32 last_off_us, max_off_us;
+};
+
 struct pu_domain {
 	struct generic_pm_domain base;
+	struct gpc_pd_ctx ctx;
 	struct regulator *reg;
 	struct clk *clk[GPC_CLK_MAX];
 	int num_clks;
@@ -83,6 +105,7 @@ struct pu_domain {
 
 struct disp_domain {
 	struct generic_pm_domain base;
+	struct gpc_pd_ctx ctx;
 	struct clk *clk[GPC_CLK_MAX];
 	int num_clks;
 };
@@ -95,6 +118,7 @@ static u32 gpc_mf_request_on[IMR_NUM];
 static DEFINE_SPINLOCK(gpc_lock);
 static struct notifier_block nb_pcie;
 static struct pu_domain imx6q_pu_domain;
+static struct disp_domain imx6s_display_domain;
 static bool pu_on;      /* keep always on i.mx6qp */
 static void _imx6q_pm_pu_power_off(struct generic_pm_domain *genpd);
 static void _imx6q_pm_pu_power_on(struct generic_pm_domain *genpd);
@@ -774,6 +798,133 @@ static int imx_pm_dispmix_off(struct generic_pm_domain *genpd)
 	return 0;
 }
 
+static struct gpc_pd_ctx *to_gpc_pd_ctx(struct generic_pm_domain *genpd)
+{
+	if (genpd == &imx6q_pu_domain.base)
+		return &imx6q_pu_domain.ctx;
+	if (genpd == &imx6s_display_domain.base)
+		return &imx6s_display_domain.ctx;
+	return NULL;
+}
+
+static void imx_gpc_pd_off_work(struct work_struct *work)
+{
+	struct gpc_pd_ctx *ctx = container_of(to_delayed_work(work),
+					      struct gpc_pd_ctx, off_work);
+	struct generic_pm_domain *genpd;
+
+	genpd = ctx == &imx6q_pu_domain.ctx ? &imx6q_pu_domain.base :
+					      &imx6s_display_domain.base;
+
+	ctx->off_expired = true;
+	queue_work(pm_wq, &genpd->power_off_work);
+}
+
+static int imx_gpc_pd_power_off(struct generic_pm_domain *genpd)
+{
+	struct gpc_pd_ctx *ctx = to_gpc_pd_ctx(genpd);
+	ktime_t start;
+	int ret;
+
+	/*
+	 * Keep the domain up for off_delay_ms after it went idle, so that
+	 * short idle periods do not cost a full power cycle and re-init.
+	 * System suspend cannot be deferred.
+	 */
+	if (ctx->off_delay_ms && !ctx->off_expired && !genpd->prepared_count) {
+		mod_delayed_work(system_wq, &ctx->off_work,
+				 msecs_to_jiffies(ctx->off_delay_ms));
+		return -EBUSY;
+	}
+	ctx->off_expired = false;
+
+	blocking_notifier_call_chain(&ctx->nh, IMX_GPC_PD_PRE_POWER_OFF, NULL);
+
+	start = ktime_get();
+	ret = ctx->power_off(genpd);
+	ctx->last_off_us = ktime_to_us(ktime_sub(ktime_get(), start));
+	ctx->max_off_us = max(ctx->max_off_us, ctx->last_off_us);
+
+	return ret;
+}
+
+static int imx_gpc_pd_power_on(struct generic_pm_domain *genpd)
+{
+	struct gpc_pd_ctx *ctx = to_gpc_pd_ctx(genpd);
+	ktime_t start;
+	int ret;
+
+	cancel_delayed_work(&ctx->off_work);
+	ctx->off_expired = false;
+
+	start = ktime_get();
+	ret = ctx->power_on(genpd);
+	if (ret)
+		return ret;
+	ctx->last_on_us = ktime_to_us(ktime_sub(ktime_get(), start));
+	ctx->max_on_us = max(ctx->max_on_us, ctx->last_on_us);
+	ctx->on_count++;
+
+	/* context of the devices in the domain is lost, let them restore */
+	blocking_notifier_call_chain(&ctx->nh, IMX_GPC_PD_POST_POWER_ON, NULL);
+
+	return 0;
+}
+
+/* a device of the domain resumed, restart the power off delay */
+static int imx_gpc_pd_dev_start(struct device *dev)
+{
+	struct gpc_pd_ctx *ctx = to_gpc_pd_ctx(pd_to_genpd(dev->pm_domain));
+
+	if (ctx->off_delay_ms) {
+		cancel_delayed_work(&ctx->off_work);
+		ctx->off_expired = false;
+	}
+
+	return 0;
+}
+
+static struct gpc_pd_ctx *imx_gpc_dev_to_pd_ctx(struct device *dev)
+{
+	if (!dev->pm_domain)
+		return NULL;
+
+	return to_gpc_pd_ctx(pd_to_genpd(dev->pm_domain));
+}
+
+/**
+ * imx_gpc_pd_register_notifier - get told when a GPC domain loses power
+ * @dev: device attached to the PU or display domain
+ * @nb: notifier called with IMX_GPC_PD_PRE_POWER_OFF before the domain
+ *	is gated and IMX_GPC_PD_POST_POWER_ON once it is powered again
+ *
+ * Drivers can save the minimal context they need before power off and
+ * restore it after power on. A runtime resume that was not preceded by
+ * IMX_GPC_PD_POST_POWER_ON found its context retained.
+ */
+int imx_gpc_pd_register_notifier(struct device *dev, struct notifier_block *nb)
+{
+	struct gpc_pd_ctx *ctx = imx_gpc_dev_to_pd_ctx(dev);
+
+	if (!ctx)
+		return -ENODEV;
+
+	return blocking_notifier_chain_register(&ctx->nh, nb);
+}
+EXPORT_SYMBOL_GPL(imx_gpc_pd_register_notifier);
+
+int imx_gpc_pd_unregister_notifier(struct device *dev,
+				   struct notifier_block *nb)
+{
+	struct gpc_pd_ctx *ctx = imx_gpc_dev_to_pd_ctx(dev);
+
+	if (!ctx)
+		return -ENODEV;
+
+	return blocking_notifier_chain_unregister(&ctx->nh, nb);
+}
+EXPORT_SYMBOL_GPL(imx_gpc_pd_unregister_notifier);
+
 static struct generic_pm_domain imx6q_arm_domain = {
 	.name = "ARM",
 };
@@ -781,8 +932,11 @@ static struct generic_pm_domain imx6q_arm_domain = {
 static struct pu_domain imx6q_pu_domain = {
 	.base = {
 		.name = "PU",
-		.power_off = imx6q_pm_pu_power_off,
-		.power_on = imx6q_pm_pu_power_on,
+		.power_off = imx_gpc_pd_power_off,
+		.power_on = imx_gpc_pd_power_on,
+		.dev_ops = {
+			.start = imx_gpc_pd_dev_start,
+		},
 		.states = {
 			[0] = {
 				.power_off_latency_ns = 25000,
@@ -791,16 +945,88 @@ static struct pu_domain imx6q_pu_domain = {
 		},
 		.state_count = 1,
 	},
+	.ctx = {
+		.power_off = imx6q_pm_pu_power_off,
+		.power_on = imx6q_pm_pu_power_on,
+		.nh = BLOCKING_NOTIFIER_INIT(imx6q_pu_domain.ctx.nh),
+	},
 };
 
 static struct disp_domain imx6s_display_domain = {
 	.base = {
 		.name = "DISPLAY",
+		.power_off = imx_gpc_pd_power_off,
+		.power_on = imx_gpc_pd_power_on,
+		.dev_ops = {
+			.start = imx_gpc_pd_dev_start,
+		},
+	},
+	.ctx = {
 		.power_off = imx_pm_dispmix_off,
 		.power_on = imx_pm_dispmix_on,
+		.nh = BLOCKING_NOTIFIER_INIT(imx6s_display_domain.ctx.nh),
 	},
 };
 
+#define GPC_PD_ATTR_RO(_pd, _name, _field)				\
+static ssize_t _pd##_##_name##_show(struct device *dev,		\
+				    struct device_attribute *attr,	\
+				    char *buf)				\
+{									\
+	return sprintf(buf, "%u\n", _field);				\
+}									\
+static DEVICE_ATTR_RO(_pd##_##_name)
+
+#define GPC_PD_ATTRS(_pd, _ctx)						\
+GPC_PD_ATTR_RO(_pd, power_on_count, (_ctx)->on_count);		\
+GPC_PD_ATTR_RO(_pd, last_power_on_us, (_ctx)->last_on_us);		\
+GPC_PD_ATTR_RO(_pd, max_power_on_us, (_ctx)->max_on_us);		\
+GPC_PD_ATTR_RO(_pd, last_power_off_us, (_ctx)->last_off_us);		\
+GPC_PD_ATTR_RO(_pd, max_power_off_us, (_ctx)->max_off_us);		\
+									\
+static ssize_t _pd##_power_off_delay_ms_show(struct device *dev,	\
+					     struct device_attribute *attr, \
+					     char *buf)			\
+{									\
+	return sprintf(buf, "%u\n", (_ctx)->off_delay_ms);		\
+}									\
+									\
+static ssize_t _pd##_power_off_delay_ms_store(struct device *dev,	\
+					      struct device_attribute *attr, \
+					      const char *buf, size_t count) \
+{									\
+	unsigned int val;						\
+									\
+	if (kstrtouint(buf, 0, &val))					\
+		return -EINVAL;						\
+	(_ctx)->off_delay_ms = val;					\
+	return count;							\
+}									\
+static DEVICE_ATTR_RW(_pd##_power_off_delay_ms)
+
+GPC_PD_ATTRS(pu, &imx6q_pu_domain.ctx);
+GPC_PD_ATTRS(disp, &imx6s_display_domain.ctx);
+
+static struct attribute *imx_gpc_pd_attrs[] = {
+	&dev_attr_pu_power_on_count.attr,
+	&dev_attr_pu_last_power_on_us.attr,
+	&dev_attr_pu_max_power_on_us.attr,
+	&dev_attr_pu_last_power_off_us.attr,
+	&dev_attr_pu_max_power_off_us.attr,
+	&dev_attr_pu_power_off_delay_ms.attr,
+	&dev_attr_disp_power_on_count.attr,
+	&dev_attr_disp_last_power_on_us.attr,
+	&dev_attr_disp_max_power_on_us.attr,
+	&dev_attr_disp_last_power_off_us.attr,
+	&dev_attr_disp_max_power_off_us.attr,
+	&dev_attr_disp_power_off_delay_ms.attr,
+	NULL,
+};
+
+static const struct attribute_group imx_gpc_pd_attr_group = {
+	.attrs = imx_gpc_pd_attrs,
+};
+
 static struct generic_pm_domain *imx_gpc_domains[] = {
 	&imx6q_arm_domain,
 	&imx6q_pu_domain.base,
@@ -854,6 +1080,14 @@ static int imx_gpc_genpd_init(struct device *dev, struct regulator *pu_reg)
 	}
 	imx6s_display_domain.num_clks = k;
 
+	INIT_DELAYED_WORK(&imx6q_pu_domain.ctx.off_work, imx_gpc_pd_off_work);
+	INIT_DELAYED_WORK(&imx6s_display_domain.ctx.off_work,
+			  imx_gpc_pd_off_work);
+	of_property_read_u32(dev->of_node, "fsl,pu-power-off-delay-ms",
+			     &imx6q_pu_domain.ctx.off_delay_ms);
+	of_property_read_u32(dev->of_node, "fsl,disp-power-off-delay-ms",
+			     &imx6s_display_domain.ctx.off_delay_ms);
+
 	is_off = IS_ENABLED(CONFIG_PM);
 	if (is_off && !(cpu_is_imx6q() &&
 		imx_get_soc_revision() == IMX_CHIP_REVISION_2_0)) {
@@ -933,6 +1167,10 @@ static int imx_gpc_probe(struct platform_device *pdev)
 	ret = imx_gpc_genpd_init(&pdev->dev, pu_reg);
 	if (ret)
 		return ret;
+
+	if (sysfs_create_group(&pdev->dev.kobj, &imx_gpc_pd_attr_group))
+		dev_warn(&pdev->dev, "failed to create power domain attributes\n");
+
 	dev_info(&pdev->dev, "Registered imx-gpc\n");
 
 	return 0;
@@ -36,6 +36,8 @@
 #define GPC_IMR1_CORE0		0x30
 #define GPC_IMR1_CORE1		0x40
 #define GPC_IMR1_M4		0x50
+#define GPC_IMR_CORE_OFFSET	(GPC_IMR1_CORE1 - GPC_IMR1_CORE0)
+#define GPC_NUM_A7_CORES	2
 #define GPC_SLOT0_CFG		0xb0
 #define GPC_PGC_CPU_MAPPING	0xec
 #define GPC_CPU_PGC_SW_PUP_REQ	0xf0
@@ -114,6 +116,8 @@ static u32 gpcv2_saved_imrs[IMR_NUM];
 static u32 gpcv2_saved_imrs_m4[IMR_NUM];
 static u32 gpcv2_mf_irqs[IMR_NUM];
 static u32 gpcv2_mf_request_on[IMR_NUM];
+/* A7 core whose IMR wakes up for the irq, follows the GIC affinity */
+static u8 gpcv2_irq_core[GPC_MAX_IRQS];
 static DEFINE_SPINLOCK(gpcv2_lock);
 static struct notifier_block nb_mipi, nb_pcie, nb_usb_hsic;
 
@@ -171,15 +175,23 @@ void imx_gpcv2_restore_all(void)
 		writel_relaxed(gpcv2_saved_imrs[i], reg_imr1 + i * 4);
 }
 
-void imx_gpcv2_hwirq_unmask(unsigned int hwirq)
+static void __iomem *imx_gpcv2_imr(unsigned int hwirq, unsigned int core)
 {
-	void __iomem *reg;
-	u32 val;
+	return gpc_base + GPC_IMR1_CORE0 + core * GPC_IMR_CORE_OFFSET +
+	       (hwirq / 32) * 4;
+}
 
-	reg = gpc_base + GPC_IMR1_CORE0 + (hwirq / 32) * 4;
-	val = readl_relaxed(reg);
-	val &= ~(1 << hwirq % 32);
-	writel_relaxed(val, reg);
+static void imx_gpcv2_hwirq_unmask_core(unsigned int hwirq,
+					unsigned int core)
+{
+	void __iomem *reg = imx_gpcv2_imr(hwirq, core);
+
+	writel_relaxed(readl_relaxed(reg) & ~(1 << hwirq % 32), reg);
+}
+
+void imx_gpcv2_hwirq_unmask(unsigned int hwirq)
+{
+	imx_gpcv2_hwirq_unmask_core(hwirq, gpcv2_irq_core[hwirq]);
 }
 
 void imx_gpcv2_hwirq_mask(unsigned int hwirq)
@@ -187,7 +199,7 @@ void imx_gpcv2_hwirq_mask(unsigned int hwirq)
 	void __iomem *reg;
 	u32 val;
 
-	reg = gpc_base + GPC_IMR1_CORE0 + (hwirq / 32) * 4;
+	reg = imx_gpcv2_imr(hwirq, gpcv2_irq_core[hwirq]);
 	val = readl_relaxed(reg);
 	val |= 1 << (hwirq % 32);
 	writel_relaxed(val, reg);
@@ -205,6 +217,45 @@ static void imx_gpcv2_irq_mask(struct irq_data *d)
 	irq_chip_mask_parent(d);
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Each A7 core has its own IMR, an unmasked irq only wakes up the core
+ * that the GIC routes it to. Move the IMR bit along with the affinity,
+ * the GPR interrupt (hwirq 0) is driven by the LPM code on CORE0.
+ */
+static int imx_gpcv2_irq_set_affinity(struct irq_data *d,
+				      const struct cpumask *dest, bool force)
+{
+	unsigned int hwirq = d->hwirq;
+	unsigned int old = gpcv2_irq_core[hwirq];
+	u32 mask = 1 << hwirq % 32;
+	unsigned int cpu;
+	u32 val;
+	int ret;
+
+	ret = irq_chip_set_affinity_parent(d, dest, force);
+	if (ret < 0 || !hwirq)
+		return ret;
+
+	/* same choice as the GIC driver */
+	if (force)
+		cpu = cpumask_first(dest);
+	else
+		cpu = cpumask_any_and(dest, cpu_online_mask);
+	if (cpu >= GPC_NUM_A7_CORES || cpu == old)
+		return ret;
+
+	val = readl_relaxed(imx_gpcv2_imr(hwirq, old));
+	if (!(val & mask)) {
+		imx_gpcv2_hwirq_unmask_core(hwirq, cpu);
+		writel_relaxed(val | mask, imx_gpcv2_imr(hwirq, old));
+	}
+	gpcv2_irq_core[hwirq] = cpu;
+
+	return ret;
+}
+#endif
+
 void imx_gpcv2_set_slot_ack(u32 index, enum imx_gpc_slot m_core,
 				bool mode, bool ack)
 {
@@ -661,7 +712,7 @@ static struct irq_chip imx_gpcv2_chip = {
 	.irq_retrigger		= irq_chip_retrigger_hierarchy,
 	.irq_set_wake		= imx_gpcv2_irq_set_wake,
 #ifdef CONFIG_SMP
-	.irq_set_affinity	= irq_chip_set_affinity_parent,
+	.irq_set_affinity	= imx_gpcv2_irq_set_affinity,
 #endif
 };
 
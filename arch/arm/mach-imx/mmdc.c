@@ -21,6 +21,7 @@
 #include <linux/of_device.h>
 #include <linux/perf_event.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 
 #include "common.h"
 
@@ -68,6 +69,12 @@
 static int ddr_type;
 static int lpddr2_2ch_mode;
 
+/* Profiling block shared between the perf PMU and the busfreq governor */
+static void __iomem *mmdc_prof_base;
+static u32 mmdc_prof_en;
+static atomic_t mmdc_perf_users = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(mmdc_prof_lock);
+
 struct fsl_mmdc_devtype_data {
 	unsigned int flags;
 };
@@ -385,6 +392,7 @@ static int mmdc_pmu_event_add(struct perf_event *event, int flags)
 
 	pmu_mmdc->mmdc_events[cfg] = event;
 	pmu_mmdc->active_events++;
+	atomic_inc(&mmdc_perf_users);
 
 	local64_set(&hwc->prev_count, mmdc_pmu_read_counter(pmu_mmdc, cfg));
 
@@ -414,6 +422,7 @@ static void mmdc_pmu_event_del(struct perf_event *event, int flags)
 
 	pmu_mmdc->mmdc_events[cfg] = NULL;
 	pmu_mmdc->active_events--;
+	atomic_dec(&mmdc_perf_users);
 
 	if (pmu_mmdc->active_events == 0)
 		hrtimer_cancel(&pmu_mmdc->hrtimer);
@@ -549,6 +558,9 @@ pmu_free:
 static int imx_mmdc_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
+	const struct of_device_id *of_id =
+		of_match_device(imx_mmdc_dt_ids, &pdev->dev);
+	const struct fsl_mmdc_devtype_data *data = of_id->data;
 	void __iomem *mmdc_base, *reg;
 	u32 val;
 	int timeout = 0x400;
@@ -582,9 +594,58 @@ static int imx_mmdc_probe(struct platform_device *pdev)
 		return -EBUSY;
 	}
 
+	/* Only the first controller is sampled for DDR utilisation */
+	if (!mmdc_prof_base) {
+		mmdc_prof_en = DBG_EN;
+		if (data->flags & MMDC_FLAG_PROFILE_SEL)
+			mmdc_prof_en |= PROFILE_SEL;
+		mmdc_prof_base = mmdc_base;
+	}
+
 	return imx_mmdc_perf_init(pdev, mmdc_base);
 }
 
+/*
+ * Return the busy and total cycle counts accumulated since the previous
+ * call and restart the profiling counters. Fails with -EBUSY while the
+ * perf PMU owns the counters and with -EOVERFLOW if the total cycle
+ * counter wrapped, in which case the caller should discard the sample.
+ */
+int imx_mmdc_get_utilisation(u32 *busy, u32 *total)
+{
+	void __iomem *reg;
+	unsigned long flags;
+	u32 val;
+
+	if (!mmdc_prof_base)
+		return -ENODEV;
+
+	spin_lock_irqsave(&mmdc_prof_lock, flags);
+
+	if (atomic_read(&mmdc_perf_users)) {
+		spin_unlock_irqrestore(&mmdc_prof_lock, flags);
+		return -EBUSY;
+	}
+
+	reg = mmdc_prof_base + MMDC_MADPCR0;
+	val = readl(reg);
+	writel(PRF_FRZ, reg);
+
+	*total = readl(mmdc_prof_base + MMDC_MADPSR0);
+	*busy = readl(mmdc_prof_base + MMDC_MADPSR1);
+
+	writel(DBG_RST, reg);
+	writel(mmdc_prof_en, reg);
+
+	spin_unlock_irqrestore(&mmdc_prof_lock, flags);
+
+	/* counters were not running yet, this is the first sample */
+	if (!(val & DBG_EN))
+		return -EAGAIN;
+
+	return (val & CYC_OVF) ? -EOVERFLOW : 0;
+}
+
 int imx_mmdc_get_ddr_type(void)
 {
 	return ddr_type;
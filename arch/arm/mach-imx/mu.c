@@ -12,6 +12,7 @@
 #include <linux/busfreq-imx.h>
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/imx_mu.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
@@ -376,13 +377,20 @@ static int imx_mu_probe(struct platform_device *pdev)
 	}
 
 	INIT_DELAYED_WORK(&mu_work, mu_work_handler);
+
+	/*
+	 * The other channels are handed out through the mailbox. Without it
+	 * only rpmsg is lost, the low power handshake keeps working.
+	 */
+	imx_mu_mbox_register(dev, mu_base, irq);
+
 	/* bit0 of MX7ULP_MU_CR used to let m4 to know MU is ready now */
 	if (cpu_is_imx7ulp())
 		writel_relaxed(readl_relaxed(mu_base + MX7ULP_MU_CR) |
-			BIT(0) | BIT(26) | BIT(27), mu_base + MX7ULP_MU_CR);
+			BIT(0) | BIT(27), mu_base + MX7ULP_MU_CR);
 	else
 		writel_relaxed(readl_relaxed(mu_base + MU_ACR) |
-			BIT(26) | BIT(27), mu_base + MU_ACR);
+			BIT(27), mu_base + MU_ACR);
 
 	pr_info("MU is ready for cross core communication!\n");
 
@@ -408,7 +416,8 @@ static int mu_resume(struct device *dev)
 		return 0;
 
 	writel_relaxed(readl_relaxed(mu_base + MX7ULP_MU_CR) |
-			BIT(0) | BIT(26) | BIT(27), mu_base + MX7ULP_MU_CR);
+			BIT(0) | BIT(27), mu_base + MX7ULP_MU_CR);
+	imx_mu_mbox_resume();
 
 	return 0;
 }
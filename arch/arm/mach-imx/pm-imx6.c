@@ -878,6 +878,7 @@ static int imx6q_pm_enter(suspend_state_t state)
 		imx6_set_lpm(WAIT_CLOCKED);
 		break;
 	case PM_SUSPEND_MEM:
+		imx_pm_profile_mark(IMX_PM_PROF_ENTER);
 		if (!of_machine_is_compatible("digi,ccimx6"))
 			imx6_set_lpm(STOP_POWER_OFF);
 		else
@@ -921,7 +922,9 @@ static int imx6q_pm_enter(suspend_state_t state)
 		}
 
 		/* Zzz ... */
+		imx_pm_profile_mark(IMX_PM_PROF_SLEEP);
 		cpu_suspend(0, imx6q_suspend_finish);
+		imx_pm_profile_mark(IMX_PM_PROF_WAKE);
 
 		if (cpu_is_imx6sx() && imx_gpc_is_mf_mix_off()) {
 			writel_relaxed(ccm_ccgr4, ccm_base + CCGR4);
@@ -944,6 +947,7 @@ static int imx6q_pm_enter(suspend_state_t state)
 		imx6q_enable_wb(false);
 		imx6_set_int_mem_clk_lpm(true);
 		imx6_set_lpm(WAIT_CLOCKED);
+		imx_pm_profile_mark(IMX_PM_PROF_EXIT);
 		break;
 	default:
 		return -EINVAL;
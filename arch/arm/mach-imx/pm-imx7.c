@@ -732,6 +732,7 @@ static int imx7_pm_enter(suspend_state_t state)
 		imx_gpcv2_post_resume();
 		break;
 	case PM_SUSPEND_MEM:
+		imx_pm_profile_mark(IMX_PM_PROF_ENTER);
 		imx_anatop_pre_suspend();
 		imx_gpcv2_pre_suspend(true);
 		if (imx_gpcv2_is_mf_mix_off()) {
@@ -769,7 +770,9 @@ static int imx7_pm_enter(suspend_state_t state)
 		}
 
 		/* Zzz ... */
+		imx_pm_profile_mark(IMX_PM_PROF_SLEEP);
 		cpu_suspend(0, imx7_suspend_finish);
+		imx_pm_profile_mark(IMX_PM_PROF_WAKE);
 
 		if (imx7_pm_is_resume_from_lpsr()) {
 			imx7_console_io_restore();
@@ -811,6 +814,7 @@ static int imx7_pm_enter(suspend_state_t state)
 		imx7_pm_set_lpsr_resume_addr(0);
 		imx_anatop_post_resume();
 		imx_gpcv2_post_resume();
+		imx_pm_profile_mark(IMX_PM_PROF_EXIT);
 		break;
 	default:
 		return -EINVAL;
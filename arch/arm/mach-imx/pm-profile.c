@@ -0,0 +1,413 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * Suspend/resume latency profiler.
+ *
+ * Accumulates, over any number of suspend cycles:
+ * - the duration of each device PM callback, per device and direction,
+ *   from the device_pm_callback_{start,end} tracepoints;
+ * - the duration of each core suspend/resume phase, from the
+ *   suspend_resume tracepoint;
+ * - the i.MX specific parts of the suspend entry, which run with the
+ *   clocksources suspended and are thus timed with the delay timer;
+ * - the total resume latency, from the wakeup to the processes being
+ *   thawed.
+ *
+ * Results are in /sys/kernel/debug/imx_pm_profile/, writing to "reset"
+ * clears them.
+ */
+
+#include <linux/clocksource.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/hashtable.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/syscore_ops.h>
+#include <linux/timex.h>
+#include <trace/events/power.h>
+
+#include "common.h"
+
+/* bucket n counts durations in [2^(n-1), 2^n) us, the last one the rest */
+#define PM_PROF_BUCKETS		20
+#define PM_PROF_NAME_LEN	32
+#define PM_PROF_HASH_BITS	6
+
+struct pm_prof_hist {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 last_ns;
+	u32 bucket[PM_PROF_BUCKETS];
+};
+
+struct pm_prof_phase {
+	struct list_head node;
+	const char *name;
+	u64 start_ns;
+	struct pm_prof_hist hist;
+};
+
+struct pm_prof_dev {
+	struct hlist_node node;
+	struct device *dev;
+	char name[PM_PROF_NAME_LEN];
+	u64 start_ns;
+	bool resume;
+	struct pm_prof_hist suspend;
+	struct pm_prof_hist resume_hist;
+};
+
+static DEFINE_SPINLOCK(pm_prof_lock);
+static DEFINE_HASHTABLE(pm_prof_devs, PM_PROF_HASH_BITS);
+static LIST_HEAD(pm_prof_phases);
+
+/* i.MX suspend entry timestamps, in delay timer cycles */
+static unsigned long pm_prof_cycles[IMX_PM_PROF_NR];
+static u32 pm_prof_mult, pm_prof_shift;
+
+static struct pm_prof_phase pm_prof_save = { .name = "imx_save" };
+static struct pm_prof_phase pm_prof_restore = { .name = "imx_restore" };
+static struct pm_prof_phase pm_prof_resume = { .name = "resume_total" };
+static u64 pm_prof_restore_ns;
+
+static void pm_prof_hist_add(struct pm_prof_hist *hist, u64 ns)
+{
+	unsigned int i;
+
+	i = min_t(unsigned int, fls64(div_u64(ns, NSEC_PER_USEC)),
+		  PM_PROF_BUCKETS - 1);
+	hist->bucket[i]++;
+	hist->count++;
+	hist->total_ns += ns;
+	hist->last_ns = ns;
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+}
+
+/* called with pm_prof_lock held */
+static struct pm_prof_phase *pm_prof_get_phase(const char *name)
+{
+	struct pm_prof_phase *phase;
+
+	list_for_each_entry(phase, &pm_prof_phases, node)
+		if (!strcmp(phase->name, name))
+			return phase;
+
+	phase = kzalloc(sizeof(*phase), GFP_ATOMIC);
+	if (!phase)
+		return NULL;
+
+	/* the action strings are constants from the core */
+	phase->name = name;
+	list_add_tail(&phase->node, &pm_prof_phases);
+
+	return phase;
+}
+
+/* called with pm_prof_lock held */
+static struct pm_prof_dev *pm_prof_get_dev(struct device *dev, bool create)
+{
+	struct pm_prof_dev *pd;
+
+	hash_for_each_possible(pm_prof_devs, pd, node, (unsigned long)dev)
+		if (pd->dev == dev && !strncmp(pd->name, dev_name(dev),
+					       PM_PROF_NAME_LEN - 1))
+			return pd;
+
+	if (!create)
+		return NULL;
+
+	pd = kzalloc(sizeof(*pd), GFP_ATOMIC);
+	if (!pd)
+		return NULL;
+
+	pd->dev = dev;
+	strlcpy(pd->name, dev_name(dev), sizeof(pd->name));
+	hash_add(pm_prof_devs, &pd->node, (unsigned long)dev);
+
+	return pd;
+}
+
+static void pm_prof_callback_start(void *data, struct device *dev,
+				   const char *pm_ops, int event)
+{
+	struct pm_prof_dev *pd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pm_prof_lock, flags);
+	pd = pm_prof_get_dev(dev, true);
+	if (pd) {
+		pd->resume = event & (PM_EVENT_RESUME | PM_EVENT_THAW |
+				      PM_EVENT_RESTORE | PM_EVENT_RECOVER);
+		pd->start_ns = local_clock();
+	}
+	spin_unlock_irqrestore(&pm_prof_lock, flags);
+}
+
+static void pm_prof_callback_end(void *data, struct device *dev, int error)
+{
+	u64 now = local_clock();
+	struct pm_prof_dev *pd;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pm_prof_lock, flags);
+	pd = pm_prof_get_dev(dev, false);
+	if (pd && pd->start_ns) {
+		pm_prof_hist_add(pd->resume ? &pd->resume_hist : &pd->suspend,
+				 now - pd->start_ns);
+		pd->start_ns = 0;
+	}
+	spin_unlock_irqrestore(&pm_prof_lock, flags);
+}
+
+static void pm_prof_suspend_resume(void *data, const char *action, int val,
+				   bool start)
+{
+	u64 now = local_clock();
+	struct pm_prof_phase *phase;
+	unsigned long flags;
+
+	/*
+	 * CPU_ON/CPU_OFF come once per CPU and are covered by the hotplug
+	 * phases. machine_suspend runs with sched_clock suspended, the
+	 * imx_save/imx_restore phases time it instead.
+	 */
+	if (!strcmp(action, "CPU_ON") || !strcmp(action, "CPU_OFF") ||
+	    !strcmp(action, "machine_suspend"))
+		return;
+
+	spin_lock_irqsave(&pm_prof_lock, flags);
+	phase = pm_prof_get_phase(action);
+	if (phase) {
+		if (start) {
+			phase->start_ns = now;
+		} else if (phase->start_ns) {
+			pm_prof_hist_add(&phase->hist, now - phase->start_ns);
+			phase->start_ns = 0;
+		}
+	}
+
+	/* userspace runs again, the resume is over */
+	if (!start && pm_prof_resume.start_ns &&
+	    !strcmp(action, "thaw_processes")) {
+		pm_prof_hist_add(&pm_prof_resume.hist, pm_prof_restore_ns +
+				 now - pm_prof_resume.start_ns);
+		pm_prof_resume.start_ns = 0;
+		pm_prof_restore_ns = 0;
+	}
+	spin_unlock_irqrestore(&pm_prof_lock, flags);
+}
+
+static u64 pm_prof_cycles_to_ns(enum imx_pm_prof_point from,
+				enum imx_pm_prof_point to)
+{
+	unsigned long delta = pm_prof_cycles[to] - pm_prof_cycles[from];
+
+	return ((u64)delta * pm_prof_mult) >> pm_prof_shift;
+}
+
+/*
+ * Called by the platform suspend code around the low level suspend.
+ * The clocksources are suspended by then, so use the delay timer.
+ */
+void imx_pm_profile_mark(enum imx_pm_prof_point point)
+{
+	unsigned long flags;
+
+	if (!pm_prof_mult || read_current_timer(&pm_prof_cycles[point]))
+		return;
+
+	if (point != IMX_PM_PROF_EXIT)
+		return;
+
+	spin_lock_irqsave(&pm_prof_lock, flags);
+	pm_prof_hist_add(&pm_prof_save.hist,
+		pm_prof_cycles_to_ns(IMX_PM_PROF_ENTER, IMX_PM_PROF_SLEEP));
+	pm_prof_restore_ns = pm_prof_cycles_to_ns(IMX_PM_PROF_WAKE,
+						  IMX_PM_PROF_EXIT);
+	pm_prof_hist_add(&pm_prof_restore.hist, pm_prof_restore_ns);
+	spin_unlock_irqrestore(&pm_prof_lock, flags);
+}
+
+/* registered after sched_clock's, so local_clock() runs again here */
+static void pm_prof_syscore_resume(void)
+{
+	pm_prof_resume.start_ns = local_clock();
+}
+
+static struct syscore_ops pm_prof_syscore_ops = {
+	.resume = pm_prof_syscore_resume,
+};
+
+static void pm_prof_show_hist(struct seq_file *m, const char *name,
+			      struct pm_prof_hist *hist)
+{
+	int i;
+
+	if (!hist->count)
+		return;
+
+	seq_printf(m, "%-24s %8llu %10llu %10llu %10llu ", name,
+		   hist->count,
+		   div64_u64(hist->total_ns, hist->count * NSEC_PER_USEC),
+		   div_u64(hist->max_ns, NSEC_PER_USEC),
+		   div_u64(hist->last_ns, NSEC_PER_USEC));
+	for (i = 0; i < PM_PROF_BUCKETS; i++)
+		seq_printf(m, " %u", hist->bucket[i]);
+	seq_putc(m, '\n');
+}
+
+static int pm_prof_phases_show(struct seq_file *m, void *v)
+{
+	struct pm_prof_phase *phase;
+
+	seq_printf(m, "%-24s %8s %10s %10s %10s  histogram (log2 us)\n",
+		   "phase", "count", "avg_us", "max_us", "last_us");
+
+	spin_lock_irq(&pm_prof_lock);
+	pm_prof_show_hist(m, pm_prof_resume.name, &pm_prof_resume.hist);
+	pm_prof_show_hist(m, pm_prof_save.name, &pm_prof_save.hist);
+	pm_prof_show_hist(m, pm_prof_restore.name, &pm_prof_restore.hist);
+	list_for_each_entry(phase, &pm_prof_phases, node)
+		pm_prof_show_hist(m, phase->name, &phase->hist);
+	spin_unlock_irq(&pm_prof_lock);
+
+	return 0;
+}
+
+static int pm_prof_devices_show(struct seq_file *m, void *v)
+{
+	struct pm_prof_dev *pd;
+	int bkt;
+
+	seq_printf(m, "%-24s %8s %10s %10s %10s  histogram (log2 us)\n",
+		   "device", "count", "avg_us", "max_us", "last_us");
+
+	spin_lock_irq(&pm_prof_lock);
+	hash_for_each(pm_prof_devs, bkt, pd, node) {
+		seq_printf(m, "%s\n", pd->name);
+		pm_prof_show_hist(m, "  suspend", &pd->suspend);
+		pm_prof_show_hist(m, "  resume", &pd->resume_hist);
+	}
+	spin_unlock_irq(&pm_prof_lock);
+
+	return 0;
+}
+
+static int pm_prof_phases_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_prof_phases_show, NULL);
+}
+
+static int pm_prof_devices_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_prof_devices_show, NULL);
+}
+
+static const struct file_operations pm_prof_phases_fops = {
+	.open		= pm_prof_phases_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations pm_prof_devices_fops = {
+	.open		= pm_prof_devices_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t pm_prof_reset_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct pm_prof_phase *phase, *tmp;
+	struct pm_prof_dev *pd;
+	struct hlist_node *n;
+	LIST_HEAD(phases);
+	HLIST_HEAD(devs);
+	int bkt;
+
+	spin_lock_irq(&pm_prof_lock);
+	list_splice_init(&pm_prof_phases, &phases);
+	hash_for_each_safe(pm_prof_devs, bkt, n, pd, node) {
+		hash_del(&pd->node);
+		hlist_add_head(&pd->node, &devs);
+	}
+	memset(&pm_prof_save.hist, 0, sizeof(pm_prof_save.hist));
+	memset(&pm_prof_restore.hist, 0, sizeof(pm_prof_restore.hist));
+	memset(&pm_prof_resume.hist, 0, sizeof(pm_prof_resume.hist));
+	spin_unlock_irq(&pm_prof_lock);
+
+	list_for_each_entry_safe(phase, tmp, &phases, node)
+		kfree(phase);
+	hlist_for_each_entry_safe(pd, n, &devs, node)
+		kfree(pd);
+
+	return count;
+}
+
+static const struct file_operations pm_prof_reset_fops = {
+	.write		= pm_prof_reset_write,
+	.llseek		= noop_llseek,
+};
+
+/* the delay timer rate is not exported, measure it against sched_clock */
+static void __init pm_prof_calibrate(void)
+{
+	unsigned long c0, c1;
+	u64 t0, t1, hz;
+
+	if (read_current_timer(&c0))
+		return;
+	t0 = local_clock();
+	msleep(20);
+	read_current_timer(&c1);
+	t1 = local_clock();
+
+	hz = div64_u64((u64)(c1 - c0) * NSEC_PER_SEC, t1 - t0);
+	if (!hz)
+		return;
+
+	clocks_calc_mult_shift(&pm_prof_mult, &pm_prof_shift, hz,
+			       NSEC_PER_SEC, 10);
+}
+
+static int __init imx_pm_profile_init(void)
+{
+	struct dentry *dir;
+
+	pm_prof_calibrate();
+
+	dir = debugfs_create_dir("imx_pm_profile", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("phases", 0444, dir, NULL, &pm_prof_phases_fops);
+	debugfs_create_file("devices", 0444, dir, NULL,
+			    &pm_prof_devices_fops);
+	debugfs_create_file("reset", 0200, dir, NULL, &pm_prof_reset_fops);
+
+	register_syscore_ops(&pm_prof_syscore_ops);
+	register_trace_device_pm_callback_start(pm_prof_callback_start, NULL);
+	register_trace_device_pm_callback_end(pm_prof_callback_end, NULL);
+	register_trace_suspend_resume(pm_prof_suspend_resume, NULL);
+
+	return 0;
+}
+late_initcall(imx_pm_profile_init);
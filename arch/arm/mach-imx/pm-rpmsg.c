@@ -27,6 +27,8 @@
 #include <linux/virtio.h>
 
 #define RPMSG_TIMEOUT 1000
+/* most acks are back well within this, spin for them before sleeping */
+#define RPMSG_POLL_US 100
 
 #define PM_RPMSG_TYPE		0
 #define HEATBEAT_RPMSG_TYPE	2
@@ -87,9 +89,18 @@ static int pm_send_message(struct pm_rpmsg_data *msg,
 
 	reinit_completion(&info->cmd_complete);
 
+	if (ack)
+		imx_rpmsg_poll_begin();
+
 	err = rpmsg_send(info->rpdev->ept, (void *)msg,
 			    sizeof(struct pm_rpmsg_data));
 
+	if (ack) {
+		if (!err)
+			imx_rpmsg_poll(&info->cmd_complete, RPMSG_POLL_US);
+		imx_rpmsg_poll_end();
+	}
+
 	if (err) {
 		dev_err(&info->rpdev->dev, "rpmsg_send failed: %d\n", err);
 		goto err_out;
@@ -10,6 +10,7 @@
  * http://www.gnu.org/copyleft/gpl.html
  */
 
+#include <linux/imx_src.h>
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/of.h>
@@ -30,6 +31,11 @@
 #define BP_SRC_SCR_SW_IPU2_RST		12
 #define BP_SRC_SCR_CORE1_RST		14
 #define BP_SRC_SCR_CORE1_ENABLE		22
+/* below is for i.MX6SX */
+#define BP_SRC_SCR_SW_M4C_RST		3
+#define BP_SRC_SCR_SW_M4C_NON_SCLR_RST	4
+#define BP_SRC_SCR_SW_M4P_RST		12
+#define BP_SRC_SCR_M4_ENABLE		22
 /* below is for i.MX7D */
 #define SRC_GPR1_V2			0x074
 #define SRC_A7RCR0			0x004
@@ -38,6 +44,10 @@
 
 #define BP_SRC_A7RCR0_A7_CORE_RESET0   0
 #define BP_SRC_A7RCR1_A7_CORE1_ENABLE  1
+#define BP_SRC_M4RCR_SW_M4C_NON_SCLR_RST	0
+#define BP_SRC_M4RCR_SW_M4C_RST		1
+#define BP_SRC_M4RCR_SW_M4P_RST		2
+#define BP_SRC_M4RCR_ENABLE_M4		3
 
 static void __iomem *src_base;
 static DEFINE_SPINLOCK(src_lock);
@@ -56,6 +66,50 @@ bool imx_src_is_m4_enabled(void)
 	return m4_is_enabled;
 }
 
+/*
+ * Hold the M4 core in reset, or release it so that it boots from the
+ * vector table at the start of its TCML.
+ */
+int imx_src_m4_run(bool run)
+{
+	u32 reg, val, enable, core_rst, non_sclr_rst, platform_rst;
+
+	if (!src_base)
+		return -ENODEV;
+
+	if (cpu_is_imx7d()) {
+		reg = SRC_M4RCR;
+		enable = 1 << BP_SRC_M4RCR_ENABLE_M4;
+		core_rst = 1 << BP_SRC_M4RCR_SW_M4C_RST;
+		non_sclr_rst = 1 << BP_SRC_M4RCR_SW_M4C_NON_SCLR_RST;
+		platform_rst = 1 << BP_SRC_M4RCR_SW_M4P_RST;
+	} else if (cpu_is_imx6sx()) {
+		reg = SRC_SCR;
+		enable = 1 << BP_SRC_SCR_M4_ENABLE;
+		core_rst = 1 << BP_SRC_SCR_SW_M4C_RST;
+		non_sclr_rst = 1 << BP_SRC_SCR_SW_M4C_NON_SCLR_RST;
+		platform_rst = 1 << BP_SRC_SCR_SW_M4P_RST;
+	} else {
+		return -ENODEV;
+	}
+
+	spin_lock(&src_lock);
+	val = readl_relaxed(src_base + reg);
+	val |= enable;
+	if (run) {
+		/* release the non self-clearing reset, pulse the others */
+		val &= ~non_sclr_rst;
+		val |= core_rst | platform_rst;
+	} else {
+		val |= core_rst | non_sclr_rst;
+	}
+	writel_relaxed(val, src_base + reg);
+	m4_is_enabled = run;
+	spin_unlock(&src_lock);
+
+	return 0;
+}
+
 static int imx_src_reset_module(struct reset_controller_dev *rcdev,
 		unsigned long sw_reset_idx)
 {
@@ -9,6 +9,7 @@
  */
 
 #include <linux/bitops.h>
+#include <linux/bpf.h>
 #include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/filter.h>
@@ -16,6 +17,7 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/if_vlan.h>
+#include <linux/math64.h>
 
 #include <asm/cacheflush.h>
 #include <asm/hwcap.h>
@@ -1067,6 +1069,1091 @@ out:
 	return;
 }
 
+#if __LINUX_ARM_ARCH__ >= 7 && !defined(CONFIG_CPU_BIG_ENDIAN)
+
+/*
+ * eBPF JIT, ARMv7 little endian only.
+ *
+ * eBPF registers are 64 bit wide, each one is a lo:hi pair of ARM registers
+ * or of words in a scratch area at the bottom of the stack frame:
+ *
+ * R0		r4:r5	return value
+ * R1		r6:r7	first helper argument, ctx on entry
+ * R6		r8:r9	callee saved, ctx for LD_ABS/LD_IND
+ * R2-R5, R7-R9, AX	stack slots
+ * FP		sp + EBPF_FP_OFF, read only
+ *
+ * r0-r3 stage operands and helper arguments, ip and lr are scratch and r10
+ * holds the tail call count. None of the eBPF registers lives in a register
+ * clobbered by a call. R3-R5 sit at the bottom of the frame, where AAPCS
+ * expects the third to fifth u64 argument of a helper, so a helper call
+ * only has to load R1 and R2 into r0-r3.
+ *
+ * The prologue has a fixed length and every program has the same frame, so
+ * a tail call can jump right behind the prologue of the next program.
+ */
+
+#define EBPF_SLOT_R3		0
+#define EBPF_SLOT_R4		8
+#define EBPF_SLOT_R5		16
+#define EBPF_SLOT_R2		24
+#define EBPF_SLOT_R7		32
+#define EBPF_SLOT_R8		40
+#define EBPF_SLOT_R9		48
+#define EBPF_SLOT_AX		56
+#define EBPF_SCRATCH_SIZE	64
+
+/* top of the eBPF stack, right above the scratch area */
+#define EBPF_FP_OFF		(EBPF_SCRATCH_SIZE + MAX_BPF_STACK)
+
+#define EBPF_CALLEE_REGS	((1 << ARM_R4) | (1 << ARM_R5) | \
+				 (1 << ARM_R6) | (1 << ARM_R7) | \
+				 (1 << ARM_R8) | (1 << ARM_R9) | (1 << ARM_R10))
+#define EBPF_TCC		ARM_R10
+
+#ifdef CONFIG_FRAME_POINTER
+/* r4-r10, fp, ip, lr and pc are pushed, keep sp 8 byte aligned */
+#define EBPF_FRAME_SIZE		(EBPF_FP_OFF + 4)
+#else
+#define EBPF_FRAME_SIZE		EBPF_FP_OFF
+#endif
+
+/* register halves >= 16 are words of the scratch area */
+#define EBPF_STK(off)		(16 + (off) / 4)
+#define EBPF_STK_OFF(r)		(((r) - 16) * 4)
+#define EBPF_FP_LO		(16 + EBPF_SCRATCH_SIZE / 4)
+#define EBPF_FP_HI		(EBPF_FP_LO + 1)
+
+#define EBPF_STK_REG(slot)	{ EBPF_STK(slot), EBPF_STK((slot) + 4) }
+
+static const u8 ebpf2a32[][2] = {
+	[BPF_REG_0]	= { ARM_R4, ARM_R5 },
+	[BPF_REG_1]	= { ARM_R6, ARM_R7 },
+	[BPF_REG_2]	= EBPF_STK_REG(EBPF_SLOT_R2),
+	[BPF_REG_3]	= EBPF_STK_REG(EBPF_SLOT_R3),
+	[BPF_REG_4]	= EBPF_STK_REG(EBPF_SLOT_R4),
+	[BPF_REG_5]	= EBPF_STK_REG(EBPF_SLOT_R5),
+	[BPF_REG_6]	= { ARM_R8, ARM_R9 },
+	[BPF_REG_7]	= EBPF_STK_REG(EBPF_SLOT_R7),
+	[BPF_REG_8]	= EBPF_STK_REG(EBPF_SLOT_R8),
+	[BPF_REG_9]	= EBPF_STK_REG(EBPF_SLOT_R9),
+	[BPF_REG_FP]	= { EBPF_FP_LO, EBPF_FP_HI },
+	[BPF_REG_AX]	= EBPF_STK_REG(EBPF_SLOT_AX),
+};
+
+static u64 jit_udiv64(u64 dividend, u64 divisor)
+{
+	return div64_u64(dividend, divisor);
+}
+
+static u64 jit_umod64(u64 dividend, u64 divisor)
+{
+	u64 rem;
+
+	div64_u64_rem(dividend, divisor, &rem);
+	return rem;
+}
+
+static inline bool ebpf_is_stacked(u8 r)
+{
+	return r >= 16;
+}
+
+/* rd = rn + imm, with ip as scratch when imm is no imm8m */
+static void ebpf_add_i(u8 rd, u8 rn, u32 imm, struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(imm);
+
+	if (imm12 >= 0) {
+		emit(ARM_ADD_I(rd, rn, imm12), ctx);
+	} else {
+		emit_mov_i(ARM_IP, imm, ctx);
+		emit(ARM_ADD_R(rd, rn, ARM_IP), ctx);
+	}
+}
+
+/* Make half @r of an eBPF register readable, loading it into @tmp */
+static u8 ebpf_get(u8 r, u8 tmp, struct jit_ctx *ctx)
+{
+	if (r == EBPF_FP_LO) {
+		ebpf_add_i(tmp, ARM_SP, EBPF_FP_OFF, ctx);
+		return tmp;
+	}
+	if (r == EBPF_FP_HI) {
+		emit(ARM_MOV_I(tmp, 0), ctx);
+		return tmp;
+	}
+	if (ebpf_is_stacked(r)) {
+		emit(ARM_LDR_I(tmp, ARM_SP, EBPF_STK_OFF(r)), ctx);
+		return tmp;
+	}
+
+	return r;
+}
+
+/* Register to compute a new value of half @r in */
+static inline u8 ebpf_dst(u8 r, u8 tmp)
+{
+	return ebpf_is_stacked(r) ? tmp : r;
+}
+
+/* Write back half @r, computed into @rd as returned by ebpf_dst() */
+static void ebpf_put(u8 r, u8 rd, struct jit_ctx *ctx)
+{
+	if (ebpf_is_stacked(r))
+		emit(ARM_STR_I(rd, ARM_SP, EBPF_STK_OFF(r)), ctx);
+	else if (r != rd)
+		emit(ARM_MOV_R(r, rd), ctx);
+}
+
+static void ebpf_put_i(u8 r, u32 val, struct jit_ctx *ctx)
+{
+	u8 rd = ebpf_dst(r, ARM_IP);
+
+	emit_mov_i(rd, val, ctx);
+	ebpf_put(r, rd, ctx);
+}
+
+/*
+ * Base register for a memory access through eBPF register half @r. Offsets
+ * beyond @max, which the load/store cannot encode, are folded into ip.
+ */
+static u8 ebpf_mem_base(u8 r, s32 *off, s32 max, struct jit_ctx *ctx)
+{
+	u8 rn;
+
+	if (r == EBPF_FP_LO) {
+		rn = ARM_SP;
+		*off += EBPF_FP_OFF;
+	} else {
+		rn = ebpf_get(r, ARM_IP, ctx);
+	}
+
+	if (*off < -max || *off > max) {
+		emit_mov_i(ARM_LR, *off, ctx);
+		emit(ARM_ADD_R(ARM_IP, rn, ARM_LR), ctx);
+		rn = ARM_IP;
+		*off = 0;
+	}
+
+	return rn;
+}
+
+static inline s32 ebpf_mem_max(u8 size)
+{
+	switch (size) {
+	case BPF_H:
+		return 0xff;
+	case BPF_DW:
+		return 0xfff - 4;
+	default:
+		return 0xfff;
+	}
+}
+
+/* Load or store a byte, halfword or word at rn + off */
+static void ebpf_ldst(u8 size, bool load, u8 rt, u8 rn, s32 off,
+		      struct jit_ctx *ctx)
+{
+	u32 imm = off < 0 ? -off : off;
+	u32 inst;
+
+	switch (size) {
+	case BPF_B:
+		inst = load ? ARM_INST_LDRB_I : ARM_INST_STRB_I;
+		break;
+	case BPF_H:
+		inst = load ? ARM_INST_LDRH_I : ARM_INST_STRH_I;
+		imm = (imm & 0xf0) << 4 | (imm & 0x0f);
+		break;
+	default:
+		inst = load ? ARM_INST_LDR_I : ARM_INST_STR_I;
+		break;
+	}
+
+	if (off < 0)
+		inst &= ~ARM_INST_LDST__U;
+
+	emit(inst | rt << 12 | rn << 16 | imm, ctx);
+}
+
+/* Leave the program with R0 = 0 if the flags match @cond */
+static void ebpf_ret0(u8 cond, struct jit_ctx *ctx)
+{
+	const u8 *r0 = ebpf2a32[BPF_REG_0];
+
+	_emit(cond, ARM_MOV_I(r0[0], 0), ctx);
+	_emit(cond, ARM_MOV_I(r0[1], 0), ctx);
+	_emit(cond, ARM_B(b_imm(ctx->skf->len, ctx)), ctx);
+}
+
+static void ebpf_call(u32 func, struct jit_ctx *ctx)
+{
+	emit_mov_i(ARM_IP, func, ctx);
+	emit_blx_r(ARM_IP, ctx);
+}
+
+static void build_ebpf_prologue(struct jit_ctx *ctx)
+{
+	const u8 *r1 = ebpf2a32[BPF_REG_1];
+
+#ifdef CONFIG_FRAME_POINTER
+	emit(ARM_MOV_R(ARM_IP, ARM_SP), ctx);
+	emit(ARM_PUSH(EBPF_CALLEE_REGS | (1 << ARM_FP) | (1 << ARM_IP) |
+		      (1 << ARM_LR) | (1 << ARM_PC)), ctx);
+	emit(ARM_SUB_I(ARM_FP, ARM_IP, 4), ctx);
+#else
+	emit(ARM_PUSH(EBPF_CALLEE_REGS | (1 << ARM_LR)), ctx);
+#endif
+	emit_mov_i(ARM_IP, EBPF_FRAME_SIZE, ctx);
+	emit(ARM_SUB_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+
+	emit(ARM_MOV_I(EBPF_TCC, 0), ctx);
+
+	/* R1 = ctx */
+	emit(ARM_MOV_R(r1[0], ARM_R0), ctx);
+	emit(ARM_MOV_I(r1[1], 0), ctx);
+}
+
+static void build_ebpf_epilogue(struct jit_ctx *ctx)
+{
+	const u8 *r0 = ebpf2a32[BPF_REG_0];
+
+	emit(ARM_MOV_R(ARM_R0, r0[0]), ctx);
+
+	emit_mov_i(ARM_IP, EBPF_FRAME_SIZE, ctx);
+	emit(ARM_ADD_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+
+#ifdef CONFIG_FRAME_POINTER
+	/* the first instruction of the prologue was: mov ip, sp */
+	emit(ARM_LDM(ARM_SP, EBPF_CALLEE_REGS | (1 << ARM_FP) |
+		     (1 << ARM_SP) | (1 << ARM_PC)), ctx);
+#else
+	emit(ARM_POP(EBPF_CALLEE_REGS | (1 << ARM_PC)), ctx);
+#endif
+}
+
+/* 64 bit shift of dl:dh by the amount in rs into tl:th */
+static void ebpf_shift64_r(u8 op, u8 tl, u8 th, u8 dl, u8 dh, u8 rs,
+			   struct jit_ctx *ctx)
+{
+	/*
+	 * Register specified shifts use the bottom byte of rs and shift
+	 * by 32 or more yield 0, so either the n - 32 or the 32 - n part
+	 * drops out.
+	 */
+	switch (op) {
+	case BPF_LSH:
+		emit(ARM_SUB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_RSB_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSR_R(ARM_LR, dl, ARM_LR), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, dl, SRTYPE_LSL, ARM_IP), ctx);
+		emit(ARM_ORR_SR(th, ARM_LR, dh, SRTYPE_LSL, rs), ctx);
+		emit(ARM_LSL_R(tl, dl, rs), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_SUB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_RSB_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSL_R(ARM_LR, dh, ARM_LR), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, dh, SRTYPE_LSR, ARM_IP), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, dl, SRTYPE_LSR, rs), ctx);
+		emit(ARM_LSR_R(th, dh, rs), ctx);
+		emit(ARM_MOV_R(tl, ARM_LR), ctx);
+		break;
+	case BPF_ARSH:
+		/* an arithmetic shift by 32 or more does not yield 0 */
+		emit(ARM_RSB_I(ARM_IP, rs, 32), ctx);
+		emit(ARM_SUBS_I(ARM_LR, rs, 32), ctx);
+		emit(ARM_LSL_R(ARM_IP, dh, ARM_IP), ctx);
+		emit(ARM_ORR_SR(ARM_IP, ARM_IP, dl, SRTYPE_LSR, rs), ctx);
+		_emit(ARM_COND_PL,
+		      ARM_ORR_SR(ARM_IP, ARM_IP, dh, SRTYPE_ASR, ARM_LR), ctx);
+		emit(ARM_ASR_R(th, dh, rs), ctx);
+		emit(ARM_MOV_R(tl, ARM_IP), ctx);
+		break;
+	}
+}
+
+/* 64 bit shift of dl:dh by 1 <= n <= 63 into tl:th */
+static void ebpf_shift64_i(u8 op, u8 tl, u8 th, u8 dl, u8 dh, u32 n,
+			   struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_LSH:
+		if (n < 32) {
+			emit(ARM_LSL_I(ARM_IP, dh, n), ctx);
+			emit(ARM_ORR_S(th, ARM_IP, dl, SRTYPE_LSR, 32 - n),
+			     ctx);
+			emit(ARM_LSL_I(tl, dl, n), ctx);
+		} else {
+			emit(ARM_LSL_I(th, dl, n - 32), ctx);
+			emit(ARM_MOV_I(tl, 0), ctx);
+		}
+		break;
+	case BPF_RSH:
+		if (n < 32) {
+			emit(ARM_LSR_I(ARM_IP, dl, n), ctx);
+			emit(ARM_ORR_S(tl, ARM_IP, dh, SRTYPE_LSL, 32 - n),
+			     ctx);
+			emit(ARM_LSR_I(th, dh, n), ctx);
+		} else if (n == 32) {
+			emit(ARM_MOV_R(tl, dh), ctx);
+			emit(ARM_MOV_I(th, 0), ctx);
+		} else {
+			emit(ARM_LSR_I(tl, dh, n - 32), ctx);
+			emit(ARM_MOV_I(th, 0), ctx);
+		}
+		break;
+	case BPF_ARSH:
+		if (n < 32) {
+			emit(ARM_LSR_I(ARM_IP, dl, n), ctx);
+			emit(ARM_ORR_S(tl, ARM_IP, dh, SRTYPE_LSL, 32 - n),
+			     ctx);
+			emit(ARM_ASR_I(th, dh, n), ctx);
+		} else if (n == 32) {
+			emit(ARM_MOV_R(tl, dh), ctx);
+			emit(ARM_ASR_I(th, dh, 31), ctx);
+		} else {
+			emit(ARM_ASR_I(tl, dh, n - 32), ctx);
+			emit(ARM_ASR_I(th, dh, 31), ctx);
+		}
+		break;
+	}
+}
+
+static inline bool ebpf_is_shift_k(const struct bpf_insn *insn)
+{
+	switch (BPF_OP(insn->code)) {
+	case BPF_LSH:
+	case BPF_RSH:
+	case BPF_ARSH:
+		return BPF_SRC(insn->code) == BPF_K;
+	default:
+		return false;
+	}
+}
+
+static void ebpf_alu(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	const bool is64 = BPF_CLASS(insn->code) == BPF_ALU64;
+	const u8 op = BPF_OP(insn->code);
+	u8 dl, dh, sl, sh, tl, th;
+
+	/*
+	 * K operands become a sign extended X operand in r2:r3, shifts and
+	 * negation use the immediate directly.
+	 */
+	if (op == BPF_NEG || ebpf_is_shift_k(insn)) {
+		sl = ARM_R2;
+		sh = ARM_R3;
+	} else if (BPF_SRC(insn->code) == BPF_K) {
+		sl = ARM_R2;
+		sh = ARM_R3;
+		emit_mov_i(sl, insn->imm, ctx);
+		if (is64)
+			emit_mov_i(sh, insn->imm < 0 ? ~0U : 0, ctx);
+	} else {
+		sl = ebpf_get(src[0], ARM_R2, ctx);
+		sh = is64 ? ebpf_get(src[1], ARM_R3, ctx) : ARM_R3;
+	}
+
+	tl = ebpf_dst(dst[0], ARM_R0);
+	th = ebpf_dst(dst[1], ARM_R1);
+
+	if (op == BPF_MOV) {
+		ebpf_put(dst[0], sl, ctx);
+		if (is64)
+			ebpf_put(dst[1], sh, ctx);
+		else
+			ebpf_put_i(dst[1], 0, ctx);
+		return;
+	}
+
+	dl = ebpf_get(dst[0], ARM_R0, ctx);
+	dh = is64 ? ebpf_get(dst[1], ARM_R1, ctx) : ARM_R1;
+
+	switch (op) {
+	case BPF_ADD:
+		if (is64) {
+			emit(ARM_ADDS_R(tl, dl, sl), ctx);
+			emit(ARM_ADC_R(th, dh, sh), ctx);
+		} else {
+			emit(ARM_ADD_R(tl, dl, sl), ctx);
+		}
+		break;
+	case BPF_SUB:
+		if (is64) {
+			emit(ARM_SUBS_R(tl, dl, sl), ctx);
+			emit(ARM_SBC_R(th, dh, sh), ctx);
+		} else {
+			emit(ARM_SUB_R(tl, dl, sl), ctx);
+		}
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(tl, dl, sl), ctx);
+		if (is64)
+			emit(ARM_AND_R(th, dh, sh), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(tl, dl, sl), ctx);
+		if (is64)
+			emit(ARM_ORR_R(th, dh, sh), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(tl, dl, sl), ctx);
+		if (is64)
+			emit(ARM_EOR_R(th, dh, sh), ctx);
+		break;
+	case BPF_MUL:
+		if (is64) {
+			/* lo * lo, plus both cross products into hi */
+			emit(ARM_MUL(ARM_IP, dl, sh), ctx);
+			emit(ARM_MLA(ARM_IP, dh, sl, ARM_IP), ctx);
+			emit(ARM_UMULL(tl, ARM_LR, dl, sl), ctx);
+			emit(ARM_ADD_R(th, ARM_LR, ARM_IP), ctx);
+		} else {
+			emit(ARM_MUL(tl, dl, sl), ctx);
+		}
+		break;
+	case BPF_NEG:
+		if (is64) {
+			emit(ARM_RSBS_I(tl, dl, 0), ctx);
+			emit(ARM_RSC_I(th, dh, 0), ctx);
+		} else {
+			emit(ARM_RSB_I(tl, dl, 0), ctx);
+		}
+		break;
+	case BPF_LSH:
+	case BPF_RSH:
+	case BPF_ARSH:
+		if (is64 && BPF_SRC(insn->code) == BPF_K) {
+			if (insn->imm)
+				ebpf_shift64_i(op, tl, th, dl, dh, insn->imm,
+					       ctx);
+			else
+				tl = dl, th = dh;
+		} else if (is64) {
+			ebpf_shift64_r(op, tl, th, dl, dh, sl, ctx);
+		} else if (BPF_SRC(insn->code) == BPF_K) {
+			if (!insn->imm)
+				tl = dl;
+			else if (op == BPF_LSH)
+				emit(ARM_LSL_I(tl, dl, insn->imm), ctx);
+			else
+				emit(ARM_LSR_I(tl, dl, insn->imm), ctx);
+		} else {
+			if (op == BPF_LSH)
+				emit(ARM_LSL_R(tl, dl, sl), ctx);
+			else
+				emit(ARM_LSR_R(tl, dl, sl), ctx);
+		}
+		break;
+	case BPF_DIV:
+	case BPF_MOD:
+		/* the verifier rejects a zero K divisor */
+		if (BPF_SRC(insn->code) == BPF_X) {
+			if (is64)
+				emit(ARM_ORRS_R(ARM_IP, sl, sh), ctx);
+			else
+				emit(ARM_CMP_I(sl, 0), ctx);
+			ebpf_ret0(ARM_COND_EQ, ctx);
+		}
+
+		if (!is64 && (elf_hwcap & HWCAP_IDIVA)) {
+			if (op == BPF_DIV) {
+				emit(ARM_UDIV(tl, dl, sl), ctx);
+			} else {
+				emit(ARM_UDIV(ARM_IP, dl, sl), ctx);
+				emit(ARM_MLS(tl, sl, ARM_IP, dl), ctx);
+			}
+			break;
+		}
+
+		/* no eBPF register lives in r0-r3, ip or lr */
+		if (is64) {
+			if (sl != ARM_R2)
+				emit(ARM_MOV_R(ARM_R2, sl), ctx);
+			if (sh != ARM_R3)
+				emit(ARM_MOV_R(ARM_R3, sh), ctx);
+			if (dh != ARM_R1)
+				emit(ARM_MOV_R(ARM_R1, dh), ctx);
+		} else {
+			emit(ARM_MOV_R(ARM_R1, sl), ctx);
+		}
+		if (dl != ARM_R0)
+			emit(ARM_MOV_R(ARM_R0, dl), ctx);
+
+		if (is64)
+			ebpf_call(op == BPF_DIV ? (u32)jit_udiv64 :
+				  (u32)jit_umod64, ctx);
+		else
+			ebpf_call(op == BPF_DIV ? (u32)jit_udiv :
+				  (u32)jit_mod, ctx);
+
+		tl = ARM_R0;
+		th = ARM_R1;
+		break;
+	}
+
+	ebpf_put(dst[0], tl, ctx);
+	if (is64)
+		ebpf_put(dst[1], th, ctx);
+	else
+		ebpf_put_i(dst[1], 0, ctx);
+}
+
+static void ebpf_end(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	u8 dl, dh, tl, th;
+
+	dl = ebpf_get(dst[0], ARM_R0, ctx);
+	tl = ebpf_dst(dst[0], ARM_R0);
+
+	if (BPF_SRC(insn->code) == BPF_FROM_LE) {
+		switch (insn->imm) {
+		case 16:
+			emit(ARM_LSL_I(tl, dl, 16), ctx);
+			emit(ARM_LSR_I(tl, tl, 16), ctx);
+			/* fall through */
+		case 32:
+			ebpf_put(dst[0], tl, ctx);
+			ebpf_put_i(dst[1], 0, ctx);
+			break;
+		}
+		return;
+	}
+
+	switch (insn->imm) {
+	case 16:
+		emit(ARM_REV(tl, dl), ctx);
+		emit(ARM_LSR_I(tl, tl, 16), ctx);
+		ebpf_put(dst[0], tl, ctx);
+		ebpf_put_i(dst[1], 0, ctx);
+		break;
+	case 32:
+		emit(ARM_REV(tl, dl), ctx);
+		ebpf_put(dst[0], tl, ctx);
+		ebpf_put_i(dst[1], 0, ctx);
+		break;
+	case 64:
+		dh = ebpf_get(dst[1], ARM_R1, ctx);
+		th = ebpf_dst(dst[1], ARM_R1);
+		emit(ARM_REV(ARM_IP, dl), ctx);
+		emit(ARM_REV(tl, dh), ctx);
+		emit(ARM_MOV_R(th, ARM_IP), ctx);
+		ebpf_put(dst[0], tl, ctx);
+		ebpf_put(dst[1], th, ctx);
+		break;
+	}
+}
+
+static void ebpf_ldx(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	const u8 size = BPF_SIZE(insn->code);
+	u8 rn, tl, th;
+	s32 off = insn->off;
+
+	rn = ebpf_mem_base(src[0], &off, ebpf_mem_max(size), ctx);
+	tl = ebpf_dst(dst[0], ARM_R0);
+	th = ebpf_dst(dst[1], ARM_R1);
+
+	if (size != BPF_DW) {
+		ebpf_ldst(size, true, tl, rn, off, ctx);
+		ebpf_put(dst[0], tl, ctx);
+		ebpf_put_i(dst[1], 0, ctx);
+		return;
+	}
+
+	/* do not overwrite the base before the second load */
+	if (tl == rn) {
+		ebpf_ldst(BPF_W, true, th, rn, off + 4, ctx);
+		ebpf_ldst(BPF_W, true, tl, rn, off, ctx);
+	} else {
+		ebpf_ldst(BPF_W, true, tl, rn, off, ctx);
+		ebpf_ldst(BPF_W, true, th, rn, off + 4, ctx);
+	}
+	ebpf_put(dst[0], tl, ctx);
+	ebpf_put(dst[1], th, ctx);
+}
+
+static void ebpf_st(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	const u8 size = BPF_SIZE(insn->code);
+	u8 rn, sl, sh;
+	s32 off = insn->off;
+
+	if (BPF_CLASS(insn->code) == BPF_ST) {
+		sl = ARM_R2;
+		sh = ARM_R3;
+		emit_mov_i(sl, insn->imm, ctx);
+		if (size == BPF_DW)
+			emit_mov_i(sh, insn->imm < 0 ? ~0U : 0, ctx);
+	} else {
+		sl = ebpf_get(src[0], ARM_R2, ctx);
+		sh = size == BPF_DW ? ebpf_get(src[1], ARM_R3, ctx) : ARM_R3;
+	}
+
+	rn = ebpf_mem_base(dst[0], &off, ebpf_mem_max(size), ctx);
+
+	if (size == BPF_DW) {
+		ebpf_ldst(BPF_W, false, sl, rn, off, ctx);
+		ebpf_ldst(BPF_W, false, sh, rn, off + 4, ctx);
+	} else {
+		ebpf_ldst(size, false, sl, rn, off, ctx);
+	}
+}
+
+static void ebpf_xadd(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	u8 rn, sl, sh;
+	s32 off = insn->off;
+
+	sl = ebpf_get(src[0], ARM_R2, ctx);
+	/* exclusive loads take no offset */
+	rn = ebpf_mem_base(dst[0], &off, 0, ctx);
+
+	if (BPF_SIZE(insn->code) == BPF_W) {
+		emit(ARM_LDREX(ARM_R0, rn), ctx);
+		emit(ARM_ADD_R(ARM_R0, ARM_R0, sl), ctx);
+		emit(ARM_STREX(ARM_R1, ARM_R0, rn), ctx);
+		emit(ARM_CMP_I(ARM_R1, 0), ctx);
+		/* back to the ldrex, pc reads 8 bytes ahead */
+		_emit(ARM_COND_NE, ARM_B(-6), ctx);
+	} else {
+		sh = ebpf_get(src[1], ARM_R3, ctx);
+		emit(ARM_LDREXD(ARM_R0, rn), ctx);
+		emit(ARM_ADDS_R(ARM_R0, ARM_R0, sl), ctx);
+		emit(ARM_ADC_R(ARM_R1, ARM_R1, sh), ctx);
+		emit(ARM_STREXD(ARM_LR, ARM_R0, rn), ctx);
+		emit(ARM_CMP_I(ARM_LR, 0), ctx);
+		_emit(ARM_COND_NE, ARM_B(-7), ctx);
+	}
+}
+
+static void ebpf_jmp(const struct bpf_insn *insn, int i, struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	u32 target = b_imm(i + insn->off + 1, ctx);
+	u8 dl, dh, sl, sh, cond;
+
+	if (BPF_SRC(insn->code) == BPF_K) {
+		sl = ARM_R2;
+		sh = ARM_R3;
+		emit_mov_i(sl, insn->imm, ctx);
+		emit_mov_i(sh, insn->imm < 0 ? ~0U : 0, ctx);
+	} else {
+		sl = ebpf_get(src[0], ARM_R2, ctx);
+		sh = ebpf_get(src[1], ARM_R3, ctx);
+	}
+	dl = ebpf_get(dst[0], ARM_R0, ctx);
+	dh = ebpf_get(dst[1], ARM_R1, ctx);
+
+	switch (BPF_OP(insn->code)) {
+	case BPF_JEQ:
+	case BPF_JNE:
+	case BPF_JGT:
+	case BPF_JGE:
+		/* unsigned: hi decides unless equal, then lo */
+		emit(ARM_CMP_R(dh, sh), ctx);
+		_emit(ARM_COND_EQ, ARM_CMP_R(dl, sl), ctx);
+		break;
+	case BPF_JSGT:
+		/* dst > src iff src - dst < 0 */
+		emit(ARM_CMP_R(sl, dl), ctx);
+		emit(ARM_SBCS_R(ARM_IP, sh, dh), ctx);
+		break;
+	case BPF_JSGE:
+		emit(ARM_CMP_R(dl, sl), ctx);
+		emit(ARM_SBCS_R(ARM_IP, dh, sh), ctx);
+		break;
+	case BPF_JSET:
+		emit(ARM_AND_R(ARM_IP, dl, sl), ctx);
+		emit(ARM_AND_R(ARM_LR, dh, sh), ctx);
+		emit(ARM_ORRS_R(ARM_IP, ARM_IP, ARM_LR), ctx);
+		break;
+	}
+
+	switch (BPF_OP(insn->code)) {
+	case BPF_JEQ:
+		cond = ARM_COND_EQ;
+		break;
+	case BPF_JGT:
+		cond = ARM_COND_HI;
+		break;
+	case BPF_JGE:
+		cond = ARM_COND_CS;
+		break;
+	case BPF_JSGT:
+		cond = ARM_COND_LT;
+		break;
+	case BPF_JSGE:
+		cond = ARM_COND_GE;
+		break;
+	default:	/* BPF_JNE, BPF_JSET */
+		cond = ARM_COND_NE;
+		break;
+	}
+
+	_emit(cond, ARM_B(target), ctx);
+}
+
+static void ebpf_helper_call(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 *r0 = ebpf2a32[BPF_REG_0];
+	const u8 *r1 = ebpf2a32[BPF_REG_1];
+	const u8 *r2 = ebpf2a32[BPF_REG_2];
+	u8 rd;
+
+	/* R3-R5 already are the stacked arguments */
+	rd = ebpf_get(r1[0], ARM_R0, ctx);
+	if (rd != ARM_R0)
+		emit(ARM_MOV_R(ARM_R0, rd), ctx);
+	rd = ebpf_get(r1[1], ARM_R1, ctx);
+	if (rd != ARM_R1)
+		emit(ARM_MOV_R(ARM_R1, rd), ctx);
+	rd = ebpf_get(r2[0], ARM_R2, ctx);
+	if (rd != ARM_R2)
+		emit(ARM_MOV_R(ARM_R2, rd), ctx);
+	rd = ebpf_get(r2[1], ARM_R3, ctx);
+	if (rd != ARM_R3)
+		emit(ARM_MOV_R(ARM_R3, rd), ctx);
+
+	ebpf_call((u32)__bpf_call_base + insn->imm, ctx);
+
+	ebpf_put(r0[0], ARM_R0, ctx);
+	ebpf_put(r0[1], ARM_R1, ctx);
+}
+
+/*
+ * R2 is the prog array, R3 the index and R1 still holds ctx. On any
+ * failure execution continues with the next instruction.
+ */
+static void ebpf_tail_call(int i, struct jit_ctx *ctx)
+{
+	const u8 *r2 = ebpf2a32[BPF_REG_2];
+	const u8 *r3 = ebpf2a32[BPF_REG_3];
+	u32 out;
+	u8 map, idx, idx_hi;
+
+	map = ebpf_get(r2[0], ARM_R0, ctx);
+	idx = ebpf_get(r3[0], ARM_R1, ctx);
+	idx_hi = ebpf_get(r3[1], ARM_R2, ctx);
+
+	/* if (index >= array->map.max_entries) goto out */
+	emit(ARM_LDR_I(ARM_IP, map, offsetof(struct bpf_array,
+					     map.max_entries)), ctx);
+	emit(ARM_CMP_I(idx_hi, 0), ctx);
+	out = b_imm(i + 1, ctx);
+	_emit(ARM_COND_NE, ARM_B(out), ctx);
+	emit(ARM_CMP_R(idx, ARM_IP), ctx);
+	out = b_imm(i + 1, ctx);
+	_emit(ARM_COND_CS, ARM_B(out), ctx);
+
+	/* if (tail_call_cnt++ > MAX_TAIL_CALL_CNT) goto out */
+	emit(ARM_CMP_I(EBPF_TCC, MAX_TAIL_CALL_CNT), ctx);
+	out = b_imm(i + 1, ctx);
+	_emit(ARM_COND_HI, ARM_B(out), ctx);
+	emit(ARM_ADD_I(EBPF_TCC, EBPF_TCC, 1), ctx);
+
+	/* prog = array->ptrs[index]; if (!prog) goto out */
+	ebpf_add_i(ARM_LR, map, offsetof(struct bpf_array, ptrs), ctx);
+	emit(ARM_LDR_R_SI(ARM_IP, ARM_LR, idx, SRTYPE_LSL, 2), ctx);
+	emit(ARM_CMP_I(ARM_IP, 0), ctx);
+	out = b_imm(i + 1, ctx);
+	_emit(ARM_COND_EQ, ARM_B(out), ctx);
+
+	/* goto *(prog->bpf_func + prologue_size) */
+	emit(ARM_LDR_I(ARM_IP, ARM_IP, offsetof(struct bpf_prog, bpf_func)),
+	     ctx);
+	emit(ARM_ADD_I(ARM_IP, ARM_IP, imm8m(ctx->prologue_bytes)), ctx);
+	emit(ARM_BX(ARM_IP), ctx);
+}
+
+static void ebpf_ld_skb(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	void *load_func[] = {jit_get_skb_b, jit_get_skb_h, jit_get_skb_w};
+	const u8 *r0 = ebpf2a32[BPF_REG_0];
+	const u8 *r6 = ebpf2a32[BPF_REG_6];
+	const u8 *src = ebpf2a32[insn->src_reg];
+	unsigned int load_order;
+	u8 rd;
+
+	switch (BPF_SIZE(insn->code)) {
+	case BPF_B:
+		load_order = 0;
+		break;
+	case BPF_H:
+		load_order = 1;
+		break;
+	default:
+		load_order = 2;
+		break;
+	}
+
+	/* r1 = offset, r0 = skb */
+	if (BPF_MODE(insn->code) == BPF_IND) {
+		rd = ebpf_get(src[0], ARM_R1, ctx);
+		emit_mov_i(ARM_IP, insn->imm, ctx);
+		emit(ARM_ADD_R(ARM_R1, rd, ARM_IP), ctx);
+	} else {
+		emit_mov_i(ARM_R1, insn->imm, ctx);
+	}
+	rd = ebpf_get(r6[0], ARM_R0, ctx);
+	if (rd != ARM_R0)
+		emit(ARM_MOV_R(ARM_R0, rd), ctx);
+
+	/* the error is returned in the high word */
+	ebpf_call((u32)load_func[load_order], ctx);
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	ebpf_ret0(ARM_COND_NE, ctx);
+
+	ebpf_put(r0[0], ARM_R0, ctx);
+	ebpf_put_i(r0[1], 0, ctx);
+}
+
+/* Returns the number of eBPF instructions consumed, or < 0 */
+static int build_ebpf_insn(const struct bpf_insn *insn, int i,
+			   struct jit_ctx *ctx)
+{
+	const u8 *dst = ebpf2a32[insn->dst_reg];
+
+	switch (insn->code) {
+	case BPF_ALU | BPF_MOV | BPF_X:
+	case BPF_ALU | BPF_MOV | BPF_K:
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+	case BPF_ALU | BPF_ADD | BPF_X:
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+	case BPF_ALU | BPF_SUB | BPF_X:
+	case BPF_ALU | BPF_SUB | BPF_K:
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+	case BPF_ALU | BPF_AND | BPF_X:
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU64 | BPF_AND | BPF_X:
+	case BPF_ALU64 | BPF_AND | BPF_K:
+	case BPF_ALU | BPF_OR | BPF_X:
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU64 | BPF_OR | BPF_X:
+	case BPF_ALU64 | BPF_OR | BPF_K:
+	case BPF_ALU | BPF_XOR | BPF_X:
+	case BPF_ALU | BPF_XOR | BPF_K:
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+	case BPF_ALU | BPF_MUL | BPF_X:
+	case BPF_ALU | BPF_MUL | BPF_K:
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+	case BPF_ALU | BPF_MOD | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+	case BPF_ALU | BPF_LSH | BPF_X:
+	case BPF_ALU | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+	case BPF_ALU | BPF_RSH | BPF_X:
+	case BPF_ALU | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+	case BPF_ALU | BPF_NEG:
+	case BPF_ALU64 | BPF_NEG:
+		ebpf_alu(insn, ctx);
+		break;
+	case BPF_ALU | BPF_END | BPF_FROM_LE:
+	case BPF_ALU | BPF_END | BPF_FROM_BE:
+		ebpf_end(insn, ctx);
+		break;
+	case BPF_LD | BPF_IMM | BPF_DW:
+		ebpf_put_i(dst[0], insn[0].imm, ctx);
+		ebpf_put_i(dst[1], insn[1].imm, ctx);
+		return 2;
+	case BPF_LDX | BPF_MEM | BPF_B:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		ebpf_ldx(insn, ctx);
+		break;
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_DW:
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		ebpf_st(insn, ctx);
+		break;
+	case BPF_STX | BPF_XADD | BPF_W:
+	case BPF_STX | BPF_XADD | BPF_DW:
+		ebpf_xadd(insn, ctx);
+		break;
+	case BPF_LD | BPF_ABS | BPF_B:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_IND | BPF_B:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_W:
+		ebpf_ld_skb(insn, ctx);
+		break;
+	case BPF_JMP | BPF_JA:
+		emit(ARM_B(b_imm(i + insn->off + 1, ctx)), ctx);
+		break;
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSET | BPF_X:
+	case BPF_JMP | BPF_JSET | BPF_K:
+		ebpf_jmp(insn, i, ctx);
+		break;
+	case BPF_JMP | BPF_CALL:
+		ebpf_helper_call(insn, ctx);
+		break;
+	case BPF_JMP | BPF_CALL | BPF_X:
+		ebpf_tail_call(i, ctx);
+		break;
+	case BPF_JMP | BPF_EXIT:
+		if (i != ctx->skf->len - 1)
+			emit(ARM_B(b_imm(ctx->skf->len, ctx)), ctx);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 1;
+}
+
+static int build_ebpf_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->skf;
+	int i, n;
+
+	for (i = 0; i < prog->len; i += n) {
+		/* compute offsets only during the first pass */
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx * 4;
+
+		n = build_ebpf_insn(&prog->insnsi[i], i, ctx);
+		if (n < 0)
+			return n;
+
+		/* the second half of a ld_imm64 is no branch target */
+		if (n > 1 && ctx->target == NULL)
+			ctx->offsets[i + 1] = ctx->idx * 4;
+	}
+
+	if (ctx->target == NULL)
+		ctx->offsets[i] = ctx->idx * 4;
+
+	return 0;
+}
+
+struct bpf_prog *bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_prog *tmp, *orig_prog = prog;
+	struct bpf_binary_header *header;
+	bool tmp_blinded = false;
+	unsigned int image_size;
+	struct jit_ctx ctx;
+	u8 *image_ptr;
+
+	if (!bpf_jit_enable)
+		return orig_prog;
+
+	/*
+	 * If blinding was requested and we failed during blinding, we must
+	 * fall back to the interpreter.
+	 */
+	tmp = bpf_jit_blind_constants(prog);
+	if (IS_ERR(tmp))
+		return orig_prog;
+	if (tmp != prog) {
+		tmp_blinded = true;
+		prog = tmp;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.skf = prog;
+
+	ctx.offsets = kcalloc(prog->len + 1, sizeof(*ctx.offsets), GFP_KERNEL);
+	if (ctx.offsets == NULL) {
+		prog = orig_prog;
+		goto out;
+	}
+
+	/* fake pass to size the prologue, the body and the epilogue */
+	build_ebpf_prologue(&ctx);
+	ctx.prologue_bytes = ctx.idx * 4;
+	ctx.idx = 0;
+	if (build_ebpf_body(&ctx)) {
+		prog = orig_prog;
+		goto out_offsets;
+	}
+	build_ebpf_epilogue(&ctx);
+
+	image_size = ctx.prologue_bytes + ctx.idx * 4;
+	header = bpf_jit_binary_alloc(image_size, &image_ptr, 4,
+				      jit_fill_hole);
+	if (header == NULL) {
+		prog = orig_prog;
+		goto out_offsets;
+	}
+
+	ctx.target = (u32 *)image_ptr;
+	ctx.idx = 0;
+
+	build_ebpf_prologue(&ctx);
+	build_ebpf_body(&ctx);
+	build_ebpf_epilogue(&ctx);
+
+	flush_icache_range((u32)header, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		/* there are 2 passes here */
+		bpf_jit_dump(prog->len, image_size, 2, ctx.target);
+
+	set_memory_ro((unsigned long)header, header->pages);
+	prog->bpf_func = (void *)ctx.target;
+	prog->jited = 1;
+
+out_offsets:
+	kfree(ctx.offsets);
+out:
+	if (tmp_blinded)
+		bpf_jit_prog_release_other(prog, prog == orig_prog ?
+					   tmp : orig_prog);
+	return prog;
+}
+
+#endif /* __LINUX_ARM_ARCH__ >= 7 && !CONFIG_CPU_BIG_ENDIAN */
+
 void bpf_jit_free(struct bpf_prog *fp)
 {
 	unsigned long addr = (unsigned long)fp->bpf_func & PAGE_MASK;
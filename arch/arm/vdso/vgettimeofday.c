@@ -115,7 +115,20 @@ static notrace int do_monotonic_coarse(struct timespec *ts,
 	return 0;
 }
 
+static notrace u64 vdso_read_counter(struct vdso_data *vdata)
+{
+	const u32 *mmio;
+
 #ifdef CONFIG_ARM_ARCH_TIMER
+	if (vdata->clock_mode == VDSO_CLOCK_CNTVCT)
+		return arch_counter_get_cntvct();
+#endif
+
+	/* the counter page is mapped read-only right below the data page */
+	mmio = (const void *)vdata - PAGE_SIZE + vdata->cs_mmio_offset;
+
+	return ACCESS_ONCE(*mmio);
+}
 
 static notrace u64 get_ns(struct vdso_data *vdata)
 {
@@ -123,7 +136,7 @@ static notrace u64 get_ns(struct vdso_data *vdata)
 	u64 cycle_now;
 	u64 nsec;
 
-	cycle_now = arch_counter_get_cntvct();
+	cycle_now = vdso_read_counter(vdata);
 
 	cycle_delta = (cycle_now - vdata->cs_cycle_last) & vdata->cs_mask;
 
@@ -141,7 +154,7 @@ static notrace int do_realtime(struct timespec *ts, struct vdso_data *vdata)
 	do {
 		seq = vdso_read_begin(vdata);
 
-		if (!vdata->tk_is_cntvct)
+		if (vdata->clock_mode == VDSO_CLOCK_NONE)
 			return -1;
 
 		ts->tv_sec = vdata->xtime_clock_sec;
@@ -164,7 +177,7 @@ static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
 	do {
 		seq = vdso_read_begin(vdata);
 
-		if (!vdata->tk_is_cntvct)
+		if (vdata->clock_mode == VDSO_CLOCK_NONE)
 			return -1;
 
 		ts->tv_sec = vdata->xtime_clock_sec;
@@ -182,20 +195,6 @@ static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
 	return 0;
 }
 
-#else /* CONFIG_ARM_ARCH_TIMER */
-
-static notrace int do_realtime(struct timespec *ts, struct vdso_data *vdata)
-{
-	return -1;
-}
-
-static notrace int do_monotonic(struct timespec *ts, struct vdso_data *vdata)
-{
-	return -1;
-}
-
-#endif /* CONFIG_ARM_ARCH_TIMER */
-
 notrace int __vdso_clock_gettime(clockid_t clkid, struct timespec *ts)
 {
 	struct vdso_data *vdata;
@@ -406,7 +406,7 @@ static void __blk_drain_queue(struct request_queue *q, bool drain_all)
 		 * The caller might be trying to drain @q before its
 		 * elevator is initialized.
 		 */
-		if (q->elevator)
+		if (q->elevator && !q->mq_ops)
 			elv_drain_elevator(q);
 
 		blkcg_drain_queue(q);
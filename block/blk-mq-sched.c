@@ -0,0 +1,120 @@
+/*
+ * blk-mq I/O scheduler glue. Requests keep the tag they were allocated
+ * with and are held by the scheduler until the hardware queue runs and
+ * asks it for the next one to issue.
+ *
+ * Copyright 2017 NXP
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <linux/blk-mq.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+
+bool __blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio)
+{
+	struct elevator_queue *e = q->elevator;
+	struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	bool ret = false;
+
+	if (hctx->flags & BLK_MQ_F_SHOULD_MERGE) {
+		ret = e->type->mq_ops.bio_merge(hctx, bio);
+		if (ret)
+			ctx->rq_merged++;
+	}
+
+	blk_mq_put_ctx(ctx);
+	return ret;
+}
+
+/*
+ * Requests that are part of a flush sequence belong to the flush state
+ * machine, and those inserted at the head have already been picked for
+ * dispatch once. Neither goes back through the scheduler.
+ */
+static bool blk_mq_sched_bypass_insert(struct blk_mq_hw_ctx *hctx,
+				       struct request *rq, bool at_head)
+{
+	if (!at_head && !(rq->cmd_flags & REQ_FLUSH_SEQ))
+		return false;
+
+	spin_lock(&hctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &hctx->dispatch);
+	else
+		list_add_tail(&rq->queuelist, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+
+	return true;
+}
+
+void blk_mq_sched_insert_request(struct request *rq, bool at_head,
+				 bool run_queue, bool async)
+{
+	struct request_queue *q = rq->q;
+	struct elevator_queue *e = q->elevator;
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, rq->mq_ctx->cpu);
+
+	trace_block_rq_insert(q, rq);
+
+	if (!blk_mq_sched_bypass_insert(hctx, rq, at_head)) {
+		LIST_HEAD(list);
+
+		list_add(&rq->queuelist, &list);
+		e->type->mq_ops.insert_requests(hctx, &list, at_head);
+	}
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+}
+
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct list_head *list, bool run_queue_async)
+{
+	struct elevator_queue *e = hctx->queue->elevator;
+	struct request *rq;
+
+	list_for_each_entry(rq, list, queuelist)
+		trace_block_rq_insert(hctx->queue, rq);
+
+	e->type->mq_ops.insert_requests(hctx, list, false);
+	blk_mq_run_hw_queue(hctx, run_queue_async);
+}
+
+/*
+ * Wait for anything still running the hardware queues before the
+ * scheduler is swapped. The queue must be frozen already, so no request
+ * can be queued or completed meanwhile and restart the queues.
+ */
+void blk_mq_sched_quiesce(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	blk_mq_stop_hw_queues(q);
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		cancel_work_sync(&hctx->run_work);
+		cancel_delayed_work_sync(&hctx->delay_work);
+	}
+
+	/* direct runs from the submitter have preemption disabled */
+	synchronize_sched();
+}
+
+/*
+ * Set up the default scheduler of a new queue. Should that fail, the
+ * queue simply runs without one.
+ */
+void blk_mq_sched_init(struct request_queue *q)
+{
+	mutex_lock(&q->sysfs_lock);
+	elevator_init(q, NULL);
+	mutex_unlock(&q->sysfs_lock);
+}
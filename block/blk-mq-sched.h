@@ -0,0 +1,35 @@
+#ifndef BLK_MQ_SCHED_H
+#define BLK_MQ_SCHED_H
+
+#include <linux/elevator.h>
+
+#include "blk-mq.h"
+
+bool __blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio);
+void blk_mq_sched_insert_request(struct request *rq, bool at_head,
+				 bool run_queue, bool async);
+void blk_mq_sched_insert_requests(struct blk_mq_hw_ctx *hctx,
+				  struct list_head *list, bool run_queue_async);
+void blk_mq_sched_quiesce(struct request_queue *q);
+void blk_mq_sched_init(struct request_queue *q);
+
+static inline bool
+blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio)
+{
+	struct elevator_queue *e = q->elevator;
+
+	if (!e || !e->type->mq_ops.bio_merge || blk_queue_nomerges(q) ||
+	    !bio_mergeable(bio))
+		return false;
+
+	return __blk_mq_sched_bio_merge(q, bio);
+}
+
+static inline bool blk_mq_sched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct elevator_queue *e = hctx->queue->elevator;
+
+	return e && e->type->mq_ops.has_work(hctx);
+}
+
+#endif
@@ -21,6 +21,22 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/*
+ * While a cgroup with a low limit is below it, cgroups without one are
+ * held at this floor so that they can still make progress.
+ */
+#define MIN_THROTL_BPS (320 * 1024)
+#define MIN_THROTL_IOPS (10)
+
+/* default idle thresholds between completion and next submission, in us */
+#define DFL_IDLE_THRESHOLD_SSD (1000L)
+#define DFL_IDLE_THRESHOLD_HD (100L * 1000)
+#define MAX_IDLE_TIME (5L * 1000 * 1000)
+#define DFL_LATENCY_TARGET (-1L)
+
+/* request size buckets for the baseline latency, 4k to 1M */
+#define LATENCY_BUCKET_SIZE 9
+
 static struct blkcg_policy blkcg_policy_throtl;
 
 /* A workqueue to queue throttle related work */
@@ -55,6 +71,12 @@ struct throtl_qnode {
 	struct throtl_grp	*tg;		/* tg this qnode belongs to */
 };
 
+enum {
+	LIMIT_LOW,
+	LIMIT_MAX,
+	LIMIT_CNT,
+};
+
 struct throtl_service_queue {
 	struct throtl_service_queue *parent_sq;	/* the parent service_queue */
 
@@ -119,20 +141,53 @@ struct throtl_grp {
 	/* are there any throtl rules between this group and td? */
 	bool has_rules[2];
 
-	/* bytes per second rate limits */
-	uint64_t bps[2];
-
-	/* IOPS limits */
-	unsigned int iops[2];
+	/*
+	 * Bytes per second and IOPS limits, as configured.  The max limits
+	 * are -1 when unlimited, the low limits 0 when not set.  Use
+	 * tg_bps_limit() and tg_iops_limit() for the limit in effect.
+	 */
+	uint64_t bps[2][LIMIT_CNT];
+	unsigned int iops[2][LIMIT_CNT];
 
 	/* Number of bytes disptached in current slice */
 	uint64_t bytes_disp[2];
 	/* Number of bio's dispatched in current slice */
 	unsigned int io_disp[2];
 
+	/* dispatched since last_check_time, to compare against low limits */
+	uint64_t last_bytes_disp[2];
+	unsigned int last_io_disp[2];
+	unsigned long last_check_time;
+
+	/* last time the group was found at or above its low limit */
+	unsigned long last_low_overflow_time[2];
+
 	/* When did we start a new slice */
 	unsigned long slice_start[2];
 	unsigned long slice_end[2];
+
+	/* idle detection, all times in us */
+	unsigned long last_finish_time;
+	unsigned long checked_last_finish_time;
+	unsigned long avg_idletime;
+	unsigned long idletime_threshold;
+
+	/* latency target in us on top of the baseline, and how it's met */
+	unsigned long latency_target;
+	unsigned int bio_cnt;
+	unsigned int bad_bio_cnt;
+	unsigned long bio_cnt_reset_time;
+};
+
+/* We measure latency for request size from <= 4k to >= 1M */
+struct latency_bucket {
+	unsigned long total_latency; /* us */
+	int samples;
+};
+
+struct avg_latency_bucket {
+	unsigned long latency; /* us */
+	bool valid;
 };
 
 struct throtl_data
@@ -147,6 +202,23 @@ struct throtl_data
 
 	/* Work for dispatching throttled bios */
 	struct work_struct dispatch_work;
+
+	/*
+	 * Which limits are in effect.  LIMIT_LOW while some group with a
+	 * low limit hasn't reached it, LIMIT_MAX otherwise.
+	 */
+	unsigned int limit_index;
+	bool limit_valid[LIMIT_CNT];
+
+	unsigned long low_upgrade_time;
+	unsigned long low_downgrade_time;
+	/* how far groups may go beyond their low limit after an upgrade */
+	unsigned int scale;
+
+	/* baseline latency per request size, sampled in LIMIT_LOW */
+	struct avg_latency_bucket avg_buckets[LATENCY_BUCKET_SIZE];
+	struct latency_bucket __percpu *latency_buckets;
+	unsigned long last_calculate_time;
 };
 
 static void throtl_pending_timer_fn(unsigned long arg);
@@ -224,6 +296,64 @@ static struct throtl_data *sq_to_td(struct throtl_service_queue *sq)
 	}								\
 } while (0)
 
+static uint64_t throtl_adjusted_limit(uint64_t low, struct throtl_data *td)
+{
+	/* arbitrary value to avoid too big scale */
+	if (td->scale < 4096 && time_after_eq(jiffies,
+	    td->low_upgrade_time + td->scale * throtl_slice))
+		td->scale = (jiffies - td->low_upgrade_time) / throtl_slice;
+
+	return low + (low >> 1) * td->scale;
+}
+
+/*
+ * In LIMIT_LOW a group is held at its low limit, or at the minimum if it
+ * has none for @rw.  In LIMIT_MAX groups with a low limit grow towards
+ * their max gradually, so that a group pushed below its low limit again
+ * gets noticed before the others have taken the whole device.
+ */
+static uint64_t tg_bps_limit(struct throtl_grp *tg, int rw)
+{
+	struct blkcg_gq *blkg = tg_to_blkg(tg);
+	uint64_t low = tg->bps[rw][LIMIT_LOW];
+	uint64_t max = tg->bps[rw][LIMIT_MAX];
+
+	if (tg->td->limit_index == LIMIT_LOW) {
+		if (low)
+			return min(low, max);
+		/* root, intermediate node or limited by iops */
+		if (!blkg->parent || !list_empty(&blkg->blkcg->css.children) ||
+		    tg->iops[rw][LIMIT_LOW])
+			return max;
+		return min_t(uint64_t, MIN_THROTL_BPS, max);
+	}
+
+	if (low && low < max)
+		return min(max, throtl_adjusted_limit(low, tg->td));
+	return max;
+}
+
+static unsigned int tg_iops_limit(struct throtl_grp *tg, int rw)
+{
+	struct blkcg_gq *blkg = tg_to_blkg(tg);
+	unsigned int low = tg->iops[rw][LIMIT_LOW];
+	unsigned int max = tg->iops[rw][LIMIT_MAX];
+
+	if (tg->td->limit_index == LIMIT_LOW) {
+		if (low)
+			return min(low, max);
+		/* root, intermediate node or limited by bps */
+		if (!blkg->parent || !list_empty(&blkg->blkcg->css.children) ||
+		    tg->bps[rw][LIMIT_LOW])
+			return max;
+		return min_t(unsigned int, MIN_THROTL_IOPS, max);
+	}
+
+	if (low && low < max)
+		return min_t(uint64_t, max, throtl_adjusted_limit(low, tg->td));
+	return max;
+}
+
 static void throtl_qnode_init(struct throtl_qnode *qn, struct throtl_grp *tg)
 {
 	INIT_LIST_HEAD(&qn->node);
@@ -334,10 +464,12 @@ static struct blkg_policy_data *throtl_pd_alloc(gfp_t gfp, int node)
 	}
 
 	RB_CLEAR_NODE(&tg->rb_node);
-	tg->bps[READ] = -1;
-	tg->bps[WRITE] = -1;
-	tg->iops[READ] = -1;
-	tg->iops[WRITE] = -1;
+	tg->bps[READ][LIMIT_MAX] = -1;
+	tg->bps[WRITE][LIMIT_MAX] = -1;
+	tg->iops[READ][LIMIT_MAX] = -1;
+	tg->iops[WRITE][LIMIT_MAX] = -1;
+
+	tg->latency_target = DFL_LATENCY_TARGET;
 
 	return &tg->pd;
 }
@@ -366,6 +498,9 @@ static void throtl_pd_init(struct blkg_policy_data *pd)
 	if (cgroup_subsys_on_dfl(io_cgrp_subsys) && blkg->parent)
 		sq->parent_sq = &blkg_to_tg(blkg->parent)->service_queue;
 	tg->td = td;
+
+	tg->idletime_threshold = blk_queue_nonrot(td->queue) ?
+		DFL_IDLE_THRESHOLD_SSD : DFL_IDLE_THRESHOLD_HD;
 }
 
 /*
@@ -380,9 +515,48 @@ static void tg_update_has_rules(struct throtl_grp *tg)
 
 	for (rw = READ; rw <= WRITE; rw++)
 		tg->has_rules[rw] = (parent_tg && parent_tg->has_rules[rw]) ||
-				    (tg->bps[rw] != -1 || tg->iops[rw] != -1);
+				    (tg_bps_limit(tg, rw) != -1 ||
+				     tg_iops_limit(tg, rw) != -1);
+}
+
+/* Recompute has_rules[] everywhere after the limits in effect changed */
+static void throtl_update_all_rules(struct throtl_data *td)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_pre(blkg, pos_css, td->queue->root_blkg)
+		tg_update_has_rules(blkg_to_tg(blkg));
+	rcu_read_unlock();
+}
+
+static bool tg_has_low_limit(struct throtl_grp *tg)
+{
+	return tg->bps[READ][LIMIT_LOW] || tg->bps[WRITE][LIMIT_LOW] ||
+	       tg->iops[READ][LIMIT_LOW] || tg->iops[WRITE][LIMIT_LOW];
+}
+
+static void blk_throtl_update_limit_valid(struct throtl_data *td)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+	bool low_valid = false;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		if (tg_has_low_limit(blkg_to_tg(blkg))) {
+			low_valid = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	td->limit_valid[LIMIT_LOW] = low_valid;
 }
 
+static void throtl_upgrade_state(struct throtl_data *td);
+
 static void throtl_pd_online(struct blkg_policy_data *pd)
 {
 	/*
@@ -392,6 +566,22 @@ static void throtl_pd_online(struct blkg_policy_data *pd)
 	tg_update_has_rules(pd_to_tg(pd));
 }
 
+static void throtl_pd_offline(struct blkg_policy_data *pd)
+{
+	struct throtl_grp *tg = pd_to_tg(pd);
+
+	tg->bps[READ][LIMIT_LOW] = 0;
+	tg->bps[WRITE][LIMIT_LOW] = 0;
+	tg->iops[READ][LIMIT_LOW] = 0;
+	tg->iops[WRITE][LIMIT_LOW] = 0;
+
+	blk_throtl_update_limit_valid(tg->td);
+
+	/* the last group with a low limit is gone, stop throttling others */
+	if (!tg->td->limit_valid[tg->td->limit_index])
+		throtl_upgrade_state(tg->td);
+}
+
 static void throtl_pd_free(struct blkg_policy_data *pd)
 {
 	struct throtl_grp *tg = pd_to_tg(pd);
@@ -632,11 +822,11 @@ static inline void throtl_trim_slice(struct throtl_grp *tg, bool rw)
 
 	if (!nr_slices)
 		return;
-	tmp = tg->bps[rw] * throtl_slice * nr_slices;
+	tmp = tg_bps_limit(tg, rw) * throtl_slice * nr_slices;
 	do_div(tmp, HZ);
 	bytes_trim = tmp;
 
-	io_trim = (tg->iops[rw] * throtl_slice * nr_slices)/HZ;
+	io_trim = (tg_iops_limit(tg, rw) * throtl_slice * nr_slices) / HZ;
 
 	if (!bytes_trim && !io_trim)
 		return;
@@ -663,6 +853,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 				  unsigned long *wait)
 {
 	bool rw = bio_data_dir(bio);
+	unsigned int iops_limit = tg_iops_limit(tg, rw);
 	unsigned int io_allowed;
 	unsigned long jiffy_elapsed, jiffy_wait, jiffy_elapsed_rnd;
 	u64 tmp;
@@ -682,7 +873,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	 * have been trimmed.
 	 */
 
-	tmp = (u64)tg->iops[rw] * jiffy_elapsed_rnd;
+	tmp = (u64)iops_limit * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 
 	if (tmp > UINT_MAX)
@@ -697,7 +888,7 @@ static bool tg_with_in_iops_limit(struct throtl_grp *tg, struct bio *bio,
 	}
 
 	/* Calc approx time to dispatch */
-	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg->iops[rw] + 1;
+	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ) / iops_limit + 1;
 
 	if (jiffy_wait > jiffy_elapsed)
 		jiffy_wait = jiffy_wait - jiffy_elapsed;
@@ -713,6 +904,7 @@ static bool tg_with_in_bps_limit(struct throtl_grp *tg, struct bio *bio,
 				 unsigned long *wait)
 {
 	bool rw = bio_data_dir(bio);
+	u64 bps_limit = tg_bps_limit(tg, rw);
 	u64 bytes_allowed, extra_bytes, tmp;
 	unsigned long jiffy_elapsed, jiffy_wait, jiffy_elapsed_rnd;
 
@@ -724,7 +916,7 @@ static bool tg_with_in_bps_limit(struct throtl_grp *tg, struct bio *bio,
 
 	jiffy_elapsed_rnd = roundup(jiffy_elapsed_rnd, throtl_slice);
 
-	tmp = tg->bps[rw] * jiffy_elapsed_rnd;
+	tmp = bps_limit * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 	bytes_allowed = tmp;
 
@@ -736,7 +928,7 @@ static bool tg_with_in_bps_limit(struct throtl_grp *tg, struct bio *bio,
 
 	/* Calc approx time to dispatch */
 	extra_bytes = tg->bytes_disp[rw] + bio->bi_iter.bi_size - bytes_allowed;
-	jiffy_wait = div64_u64(extra_bytes * HZ, tg->bps[rw]);
+	jiffy_wait = div64_u64(extra_bytes * HZ, bps_limit);
 
 	if (!jiffy_wait)
 		jiffy_wait = 1;
@@ -771,7 +963,7 @@ static bool tg_may_dispatch(struct throtl_grp *tg, struct bio *bio,
 	       bio != throtl_peek_queued(&tg->service_queue.queued[rw]));
 
 	/* If tg->bps = -1, then BW is unlimited */
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1) {
+	if (tg_bps_limit(tg, rw) == -1 && tg_iops_limit(tg, rw) == -1) {
 		if (wait)
 			*wait = 0;
 		return true;
@@ -816,6 +1008,8 @@ static void throtl_charge_bio(struct throtl_grp *tg, struct bio *bio)
 	/* Charge the bio to the group */
 	tg->bytes_disp[rw] += bio->bi_iter.bi_size;
 	tg->io_disp[rw]++;
+	tg->last_bytes_disp[rw] += bio->bi_iter.bi_size;
+	tg->last_io_disp[rw]++;
 
 	/*
 	 * REQ_THROTTLED is used to prevent the same bio to be throttled
@@ -997,6 +1191,284 @@ static int throtl_select_dispatch(struct throtl_service_queue *parent_sq)
 	return nr_disp;
 }
 
+static unsigned long __tg_last_low_overflow_time(struct throtl_grp *tg)
+{
+	unsigned long rtime = jiffies, wtime = jiffies;
+
+	if (tg->bps[READ][LIMIT_LOW] || tg->iops[READ][LIMIT_LOW])
+		rtime = tg->last_low_overflow_time[READ];
+	if (tg->bps[WRITE][LIMIT_LOW] || tg->iops[WRITE][LIMIT_LOW])
+		wtime = tg->last_low_overflow_time[WRITE];
+	return min(rtime, wtime);
+}
+
+/* tg should not be an intermediate node */
+static unsigned long tg_last_low_overflow_time(struct throtl_grp *tg)
+{
+	struct throtl_service_queue *parent_sq;
+	struct throtl_grp *parent = tg;
+	unsigned long ret = __tg_last_low_overflow_time(tg);
+
+	while (true) {
+		parent_sq = parent->service_queue.parent_sq;
+		parent = sq_to_tg(parent_sq);
+		if (!parent)
+			break;
+
+		/*
+		 * A parent without low limit always reaches it, its overflow
+		 * time is useless for the children.
+		 */
+		if (!tg_has_low_limit(parent))
+			continue;
+		if (time_after(__tg_last_low_overflow_time(parent), ret))
+			ret = __tg_last_low_overflow_time(parent);
+	}
+	return ret;
+}
+
+/*
+ * A group is idle if it hasn't completed any I/O for a while, if it
+ * thinks longer than its idle threshold between a completion and the
+ * next submission, or if its I/O latency comfortably meets its target.
+ * Either way, holding the others back wouldn't help it.
+ */
+static bool throtl_tg_is_idle(struct throtl_grp *tg)
+{
+	unsigned long now = ktime_get_ns() >> 10;
+	unsigned long time;
+
+	time = min_t(unsigned long, MAX_IDLE_TIME, 4 * tg->idletime_threshold);
+	return now - tg->last_finish_time > time ||
+	       tg->avg_idletime > tg->idletime_threshold ||
+	       (tg->latency_target != DFL_LATENCY_TARGET && tg->bio_cnt &&
+		tg->bad_bio_cnt * 5 < tg->bio_cnt);
+}
+
+static bool throtl_tg_can_upgrade(struct throtl_grp *tg)
+{
+	struct throtl_service_queue *sq = &tg->service_queue;
+	bool read_limit, write_limit;
+
+	/*
+	 * if cgroup reaches low limit (if low limit is 0, the cgroup always
+	 * reaches), it's ok to upgrade to next limit
+	 */
+	read_limit = tg->bps[READ][LIMIT_LOW] || tg->iops[READ][LIMIT_LOW];
+	write_limit = tg->bps[WRITE][LIMIT_LOW] || tg->iops[WRITE][LIMIT_LOW];
+	if (!read_limit && !write_limit)
+		return true;
+	if (read_limit && sq->nr_queued[READ] &&
+	    (!write_limit || sq->nr_queued[WRITE]))
+		return true;
+	if (write_limit && sq->nr_queued[WRITE] &&
+	    (!read_limit || sq->nr_queued[READ]))
+		return true;
+
+	if (time_after_eq(jiffies,
+			  tg_last_low_overflow_time(tg) + throtl_slice) &&
+	    throtl_tg_is_idle(tg))
+		return true;
+	return false;
+}
+
+static bool throtl_hierarchy_can_upgrade(struct throtl_grp *tg)
+{
+	while (true) {
+		if (throtl_tg_can_upgrade(tg))
+			return true;
+		tg = sq_to_tg(tg->service_queue.parent_sq);
+		if (!tg || !tg_to_blkg(tg)->parent)
+			return false;
+	}
+	return false;
+}
+
+/*
+ * Every leaf group other than @this_tg has to be at its low limit or
+ * idle before the max limits may take over again.
+ */
+static bool throtl_can_upgrade(struct throtl_data *td,
+			       struct throtl_grp *this_tg)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+
+	if (td->limit_index != LIMIT_LOW)
+		return false;
+
+	if (time_before(jiffies, td->low_downgrade_time + throtl_slice))
+		return false;
+
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+
+		if (tg == this_tg)
+			continue;
+		if (!list_empty(&tg_to_blkg(tg)->blkcg->css.children))
+			continue;
+		if (!throtl_hierarchy_can_upgrade(tg)) {
+			rcu_read_unlock();
+			return false;
+		}
+	}
+	rcu_read_unlock();
+	return true;
+}
+
+static void throtl_upgrade_state(struct throtl_data *td)
+{
+	struct cgroup_subsys_state *pos_css;
+	struct blkcg_gq *blkg;
+
+	throtl_log(&td->service_queue, "upgrade to max");
+	td->limit_index = LIMIT_MAX;
+	td->low_upgrade_time = jiffies;
+	td->scale = 0;
+
+	throtl_update_all_rules(td);
+
+	/* the limits just went up, let the queued groups go earlier */
+	rcu_read_lock();
+	blkg_for_each_descendant_post(blkg, pos_css, td->queue->root_blkg) {
+		struct throtl_grp *tg = blkg_to_tg(blkg);
+		struct throtl_service_queue *sq = &tg->service_queue;
+
+		if (tg->flags & THROTL_TG_PENDING) {
+			tg_update_disptime(tg);
+			throtl_schedule_next_dispatch(sq->parent_sq, true);
+		}
+	}
+	rcu_read_unlock();
+}
+
+static void throtl_downgrade_state(struct throtl_data *td, int new)
+{
+	/* first give up what was gained since the upgrade, one half a time */
+	td->scale /= 2;
+
+	throtl_log(&td->service_queue, "downgrade, scale %d", td->scale);
+	if (td->scale) {
+		td->low_upgrade_time = jiffies - td->scale * throtl_slice;
+		return;
+	}
+
+	td->limit_index = new;
+	td->low_downgrade_time = jiffies;
+
+	throtl_update_all_rules(td);
+}
+
+static bool throtl_tg_can_downgrade(struct throtl_grp *tg)
+{
+	struct throtl_data *td = tg->td;
+	unsigned long now = jiffies;
+
+	/*
+	 * Below its low limit for a whole slice while still busy, the
+	 * other groups have to be throttled again.
+	 */
+	if (time_after_eq(now, td->low_upgrade_time + throtl_slice) &&
+	    time_after_eq(now, tg_last_low_overflow_time(tg) + throtl_slice) &&
+	    (!throtl_tg_is_idle(tg) ||
+	     !list_empty(&tg_to_blkg(tg)->blkcg->css.children)))
+		return true;
+	return false;
+}
+
+static bool throtl_hierarchy_can_downgrade(struct throtl_grp *tg)
+{
+	while (true) {
+		if (!throtl_tg_can_downgrade(tg))
+			return false;
+		tg = sq_to_tg(tg->service_queue.parent_sq);
+		if (!tg || !tg_to_blkg(tg)->parent)
+			break;
+	}
+	return true;
+}
+
+static void throtl_downgrade_check(struct throtl_grp *tg)
+{
+	uint64_t bps;
+	unsigned int iops;
+	unsigned long elapsed_time;
+	unsigned long now = jiffies;
+
+	if (tg->td->limit_index != LIMIT_MAX ||
+	    !tg->td->limit_valid[LIMIT_LOW])
+		return;
+	if (!list_empty(&tg_to_blkg(tg)->blkcg->css.children))
+		return;
+	if (time_after(tg->last_check_time + throtl_slice, now))
+		return;
+
+	elapsed_time = now - tg->last_check_time;
+	tg->last_check_time = now;
+
+	if (time_before(now, tg_last_low_overflow_time(tg) + throtl_slice))
+		return;
+
+	if (tg->bps[READ][LIMIT_LOW]) {
+		bps = tg->last_bytes_disp[READ] * HZ;
+		do_div(bps, elapsed_time);
+		if (bps >= tg->bps[READ][LIMIT_LOW])
+			tg->last_low_overflow_time[READ] = now;
+	}
+
+	if (tg->bps[WRITE][LIMIT_LOW]) {
+		bps = tg->last_bytes_disp[WRITE] * HZ;
+		do_div(bps, elapsed_time);
+		if (bps >= tg->bps[WRITE][LIMIT_LOW])
+			tg->last_low_overflow_time[WRITE] = now;
+	}
+
+	if (tg->iops[READ][LIMIT_LOW]) {
+		iops = tg->last_io_disp[READ] * HZ / elapsed_time;
+		if (iops >= tg->iops[READ][LIMIT_LOW])
+			tg->last_low_overflow_time[READ] = now;
+	}
+
+	if (tg->iops[WRITE][LIMIT_LOW]) {
+		iops = tg->last_io_disp[WRITE] * HZ / elapsed_time;
+		if (iops >= tg->iops[WRITE][LIMIT_LOW])
+			tg->last_low_overflow_time[WRITE] = now;
+	}
+
+	/*
+	 * If cgroup is below low limit, consider downgrade and throttle other
+	 * cgroups
+	 */
+	if (throtl_hierarchy_can_downgrade(tg))
+		throtl_downgrade_state(tg->td, LIMIT_LOW);
+
+	tg->last_bytes_disp[READ] = 0;
+	tg->last_bytes_disp[WRITE] = 0;
+	tg->last_io_disp[READ] = 0;
+	tg->last_io_disp[WRITE] = 0;
+}
+
+static void throtl_upgrade_check(struct throtl_grp *tg)
+{
+	unsigned long now = jiffies;
+
+	if (tg->td->limit_index != LIMIT_LOW)
+		return;
+
+	if (time_after(tg->last_check_time + throtl_slice, now))
+		return;
+
+	tg->last_check_time = now;
+
+	if (!time_after_eq(now,
+	     __tg_last_low_overflow_time(tg) + throtl_slice))
+		return;
+
+	if (throtl_can_upgrade(tg->td, NULL))
+		throtl_upgrade_state(tg->td);
+}
+
 /**
  * throtl_pending_timer_fn - timer function for service_queue->pending_timer
  * @arg: the throtl_service_queue being serviced
@@ -1023,6 +1495,9 @@ static void throtl_pending_timer_fn(unsigned long arg)
 	int ret;
 
 	spin_lock_irq(q->queue_lock);
+	if (throtl_can_upgrade(td, NULL))
+		throtl_upgrade_state(td);
+
 again:
 	parent_sq = sq->parent_sq;
 	dispatched = false;
@@ -1140,7 +1615,7 @@ static int tg_print_conf_uint(struct seq_file *sf, void *v)
 	return 0;
 }
 
-static void tg_conf_updated(struct throtl_grp *tg)
+static void tg_conf_updated(struct throtl_grp *tg, bool global)
 {
 	struct throtl_service_queue *sq = &tg->service_queue;
 	struct cgroup_subsys_state *pos_css;
@@ -1148,17 +1623,19 @@ static void tg_conf_updated(struct throtl_grp *tg)
 
 	throtl_log(&tg->service_queue,
 		   "limit change rbps=%llu wbps=%llu riops=%u wiops=%u",
-		   tg->bps[READ], tg->bps[WRITE],
-		   tg->iops[READ], tg->iops[WRITE]);
+		   tg_bps_limit(tg, READ), tg_bps_limit(tg, WRITE),
+		   tg_iops_limit(tg, READ), tg_iops_limit(tg, WRITE));
 
 	/*
 	 * Update has_rules[] flags for the updated tg's subtree.  A tg is
 	 * considered to have rules if either the tg itself or any of its
 	 * ancestors has rules.  This identifies groups without any
 	 * restrictions in the whole hierarchy and allows them to bypass
-	 * blk-throttle.
+	 * blk-throttle.  A change of low limits can switch the limits in
+	 * effect for every group, @global then covers the whole tree.
 	 */
-	blkg_for_each_descendant_pre(blkg, pos_css, tg_to_blkg(tg))
+	blkg_for_each_descendant_pre(blkg, pos_css,
+			global ? tg->td->queue->root_blkg : tg_to_blkg(tg))
 		tg_update_has_rules(blkg_to_tg(blkg));
 
 	/*
@@ -1204,7 +1681,7 @@ static ssize_t tg_set_conf(struct kernfs_open_file *of,
 	else
 		*(unsigned int *)((void *)tg + of_cft(of)->private) = v;
 
-	tg_conf_updated(tg);
+	tg_conf_updated(tg, false);
 	ret = 0;
 out_finish:
 	blkg_conf_finish(&ctx);
@@ -1226,25 +1703,25 @@ static ssize_t tg_set_conf_uint(struct kernfs_open_file *of,
 static struct cftype throtl_legacy_files[] = {
 	{
 		.name = "throttle.read_bps_device",
-		.private = offsetof(struct throtl_grp, bps[READ]),
+		.private = offsetof(struct throtl_grp, bps[READ][LIMIT_MAX]),
 		.seq_show = tg_print_conf_u64,
 		.write = tg_set_conf_u64,
 	},
 	{
 		.name = "throttle.write_bps_device",
-		.private = offsetof(struct throtl_grp, bps[WRITE]),
+		.private = offsetof(struct throtl_grp, bps[WRITE][LIMIT_MAX]),
 		.seq_show = tg_print_conf_u64,
 		.write = tg_set_conf_u64,
 	},
 	{
 		.name = "throttle.read_iops_device",
-		.private = offsetof(struct throtl_grp, iops[READ]),
+		.private = offsetof(struct throtl_grp, iops[READ][LIMIT_MAX]),
 		.seq_show = tg_print_conf_uint,
 		.write = tg_set_conf_uint,
 	},
 	{
 		.name = "throttle.write_iops_device",
-		.private = offsetof(struct throtl_grp, iops[WRITE]),
+		.private = offsetof(struct throtl_grp, iops[WRITE][LIMIT_MAX]),
 		.seq_show = tg_print_conf_uint,
 		.write = tg_set_conf_uint,
 	},
@@ -1261,59 +1738,97 @@ static struct cftype throtl_legacy_files[] = {
 	{ }	/* terminate */
 };
 
-static u64 tg_prfill_max(struct seq_file *sf, struct blkg_policy_data *pd,
-			 int off)
+static u64 tg_prfill_limit(struct seq_file *sf, struct blkg_policy_data *pd,
+			   int off)
 {
 	struct throtl_grp *tg = pd_to_tg(pd);
 	const char *dname = blkg_dev_name(pd->blkg);
 	char bufs[4][21] = { "max", "max", "max", "max" };
+	u64 bps_dft;
+	unsigned int iops_dft;
+	char idle_time[26] = "";
+	char latency_time[26] = "";
 
 	if (!dname)
 		return 0;
-	if (tg->bps[READ] == -1 && tg->bps[WRITE] == -1 &&
-	    tg->iops[READ] == -1 && tg->iops[WRITE] == -1)
+
+	if (off == LIMIT_LOW) {
+		bps_dft = 0;
+		iops_dft = 0;
+	} else {
+		bps_dft = -1;
+		iops_dft = -1;
+	}
+
+	if (tg->bps[READ][off] == bps_dft &&
+	    tg->bps[WRITE][off] == bps_dft &&
+	    tg->iops[READ][off] == iops_dft &&
+	    tg->iops[WRITE][off] == iops_dft &&
+	    (off != LIMIT_LOW ||
+	     (tg->latency_target == DFL_LATENCY_TARGET &&
+	      tg->idletime_threshold == (blk_queue_nonrot(tg->td->queue) ?
+			DFL_IDLE_THRESHOLD_SSD : DFL_IDLE_THRESHOLD_HD))))
 		return 0;
 
-	if (tg->bps[READ] != -1)
-		snprintf(bufs[0], sizeof(bufs[0]), "%llu", tg->bps[READ]);
-	if (tg->bps[WRITE] != -1)
-		snprintf(bufs[1], sizeof(bufs[1]), "%llu", tg->bps[WRITE]);
-	if (tg->iops[READ] != -1)
-		snprintf(bufs[2], sizeof(bufs[2]), "%u", tg->iops[READ]);
-	if (tg->iops[WRITE] != -1)
-		snprintf(bufs[3], sizeof(bufs[3]), "%u", tg->iops[WRITE]);
-
-	seq_printf(sf, "%s rbps=%s wbps=%s riops=%s wiops=%s\n",
-		   dname, bufs[0], bufs[1], bufs[2], bufs[3]);
+	if (tg->bps[READ][off] != -1)
+		snprintf(bufs[0], sizeof(bufs[0]), "%llu", tg->bps[READ][off]);
+	if (tg->bps[WRITE][off] != -1)
+		snprintf(bufs[1], sizeof(bufs[1]), "%llu", tg->bps[WRITE][off]);
+	if (tg->iops[READ][off] != -1)
+		snprintf(bufs[2], sizeof(bufs[2]), "%u", tg->iops[READ][off]);
+	if (tg->iops[WRITE][off] != -1)
+		snprintf(bufs[3], sizeof(bufs[3]), "%u", tg->iops[WRITE][off]);
+
+	if (off == LIMIT_LOW) {
+		snprintf(idle_time, sizeof(idle_time), " idle=%lu",
+			 tg->idletime_threshold);
+		if (tg->latency_target == DFL_LATENCY_TARGET)
+			strcpy(latency_time, " latency=max");
+		else
+			snprintf(latency_time, sizeof(latency_time),
+				 " latency=%lu", tg->latency_target);
+	}
+
+	seq_printf(sf, "%s rbps=%s wbps=%s riops=%s wiops=%s%s%s\n",
+		   dname, bufs[0], bufs[1], bufs[2], bufs[3], idle_time,
+		   latency_time);
 	return 0;
 }
 
-static int tg_print_max(struct seq_file *sf, void *v)
+static int tg_print_limit(struct seq_file *sf, void *v)
 {
-	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), tg_prfill_max,
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), tg_prfill_limit,
 			  &blkcg_policy_throtl, seq_cft(sf)->private, false);
 	return 0;
 }
 
-static ssize_t tg_set_max(struct kernfs_open_file *of,
-			  char *buf, size_t nbytes, loff_t off)
+static ssize_t tg_set_limit(struct kernfs_open_file *of,
+			    char *buf, size_t nbytes, loff_t off)
 {
 	struct blkcg *blkcg = css_to_blkcg(of_css(of));
 	struct blkg_conf_ctx ctx;
 	struct throtl_grp *tg;
+	struct throtl_data *td;
 	u64 v[4];
+	unsigned long idle_time;
+	unsigned long latency_time;
 	int ret;
+	int index = of_cft(of)->private;
 
 	ret = blkg_conf_prep(blkcg, &blkcg_policy_throtl, buf, &ctx);
 	if (ret)
 		return ret;
 
 	tg = blkg_to_tg(ctx.blkg);
+	td = tg->td;
+
+	v[0] = tg->bps[READ][index];
+	v[1] = tg->bps[WRITE][index];
+	v[2] = tg->iops[READ][index];
+	v[3] = tg->iops[WRITE][index];
 
-	v[0] = tg->bps[READ];
-	v[1] = tg->bps[WRITE];
-	v[2] = tg->iops[READ];
-	v[3] = tg->iops[WRITE];
+	idle_time = tg->idletime_threshold;
+	latency_time = tg->latency_target;
 
 	while (true) {
 		char tok[27];	/* wiops=18446744073709551616 */
@@ -1333,8 +1848,9 @@ static ssize_t tg_set_max(struct kernfs_open_file *of,
 		if (!p || (sscanf(p, "%llu", &val) != 1 && strcmp(p, "max")))
 			goto out_finish;
 
+		/* a max limit can't be zero, a low limit of zero is none */
 		ret = -ERANGE;
-		if (!val)
+		if (!val && index == LIMIT_MAX)
 			goto out_finish;
 
 		ret = -EINVAL;
@@ -1346,16 +1862,35 @@ static ssize_t tg_set_max(struct kernfs_open_file *of,
 			v[2] = min_t(u64, val, UINT_MAX);
 		else if (!strcmp(tok, "wiops"))
 			v[3] = min_t(u64, val, UINT_MAX);
+		else if (index == LIMIT_LOW && !strcmp(tok, "idle"))
+			idle_time = min_t(u64, val, ULONG_MAX);
+		else if (index == LIMIT_LOW && !strcmp(tok, "latency"))
+			latency_time = min_t(u64, val, ULONG_MAX);
 		else
 			goto out_finish;
 	}
 
-	tg->bps[READ] = v[0];
-	tg->bps[WRITE] = v[1];
-	tg->iops[READ] = v[2];
-	tg->iops[WRITE] = v[3];
+	tg->bps[READ][index] = v[0];
+	tg->bps[WRITE][index] = v[1];
+	tg->iops[READ][index] = v[2];
+	tg->iops[WRITE][index] = v[3];
 
-	tg_conf_updated(tg);
+	if (index == LIMIT_LOW) {
+		tg->idletime_threshold = idle_time;
+		tg->latency_target = latency_time;
+
+		/*
+		 * Start with the low limits in effect, the groups that don't
+		 * need the bandwidth will hand it back soon enough.
+		 */
+		blk_throtl_update_limit_valid(td);
+		if (td->limit_valid[LIMIT_LOW])
+			td->limit_index = LIMIT_LOW;
+		else
+			td->limit_index = LIMIT_MAX;
+	}
+
+	tg_conf_updated(tg, index == LIMIT_LOW);
 	ret = 0;
 out_finish:
 	blkg_conf_finish(&ctx);
@@ -1363,11 +1898,21 @@ out_finish:
 }
 
 static struct cftype throtl_files[] = {
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	{
+		.name = "low",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = tg_print_limit,
+		.write = tg_set_limit,
+		.private = LIMIT_LOW,
+	},
+#endif
 	{
 		.name = "max",
 		.flags = CFTYPE_NOT_ON_ROOT,
-		.seq_show = tg_print_max,
-		.write = tg_set_max,
+		.seq_show = tg_print_limit,
+		.write = tg_set_limit,
+		.private = LIMIT_MAX,
 	},
 	{ }	/* terminate */
 };
@@ -1386,9 +1931,165 @@ static struct blkcg_policy blkcg_policy_throtl = {
 	.pd_alloc_fn		= throtl_pd_alloc,
 	.pd_init_fn		= throtl_pd_init,
 	.pd_online_fn		= throtl_pd_online,
+	.pd_offline_fn		= throtl_pd_offline,
 	.pd_free_fn		= throtl_pd_free,
 };
 
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+static int request_bucket_index(sector_t sectors)
+{
+	int order = order_base_2(sectors);
+
+	/* 4k is order 3 in sectors */
+	return clamp_t(int, order - 3, 0, LATENCY_BUCKET_SIZE - 1);
+}
+
+/*
+ * Fold the latency samples collected since the last run into the
+ * baseline per request size, at most once a second.
+ */
+static void throtl_update_latency_buckets(struct throtl_data *td)
+{
+	unsigned long last_latency = 0;
+	int i, cpu;
+
+	if (time_before(jiffies, td->last_calculate_time + HZ))
+		return;
+	td->last_calculate_time = jiffies;
+
+	for (i = 0; i < LATENCY_BUCKET_SIZE; i++) {
+		unsigned long latency = 0;
+		int samples = 0;
+
+		for_each_possible_cpu(cpu) {
+			struct latency_bucket *bucket;
+
+			bucket = per_cpu_ptr(td->latency_buckets, cpu);
+			latency += bucket[i].total_latency;
+			samples += bucket[i].samples;
+			bucket[i].total_latency = 0;
+			bucket[i].samples = 0;
+		}
+
+		if (samples >= 32) {
+			latency /= samples;
+			if (td->avg_buckets[i].valid)
+				latency = (td->avg_buckets[i].latency * 7 +
+					   latency) >> 3;
+			td->avg_buckets[i].latency = latency;
+			td->avg_buckets[i].valid = true;
+		}
+
+		/* larger requests never get a smaller baseline */
+		if (td->avg_buckets[i].latency < last_latency)
+			td->avg_buckets[i].latency = last_latency;
+		last_latency = td->avg_buckets[i].latency;
+	}
+
+	throtl_log(&td->service_queue, "latency baseline 4k=%lu 64k=%lu",
+		   td->avg_buckets[0].latency, td->avg_buckets[4].latency);
+}
+
+/*
+ * Time the bio from here to its completion for @tg.  Submitting after a
+ * completion also ends a think time of @tg, which feeds idle detection.
+ */
+static void blk_throtl_assoc_bio(struct throtl_grp *tg, struct bio *bio)
+{
+	unsigned long now = ktime_get_ns() >> 10;
+
+	if (bio->bi_cg_private)
+		blkg_put(tg_to_blkg(bio->bi_cg_private));
+	bio->bi_cg_private = tg;
+	blkg_get(tg_to_blkg(tg));
+	bio->bi_issue_time = ktime_get_ns();
+	bio->bi_issue_sectors = bio_sectors(bio);
+
+	if (!tg->last_finish_time ||
+	    tg->last_finish_time == tg->checked_last_finish_time ||
+	    now <= tg->last_finish_time)
+		return;
+
+	tg->avg_idletime = (tg->avg_idletime * 7 + now -
+			    tg->last_finish_time) >> 3;
+	tg->checked_last_finish_time = tg->last_finish_time;
+}
+
+void blk_throtl_bio_endio(struct bio *bio)
+{
+	struct throtl_grp *tg = bio->bi_cg_private;
+	unsigned long finish_time, start_time, lat;
+
+	if (!tg)
+		return;
+	bio->bi_cg_private = NULL;
+
+	finish_time = ktime_get_ns() >> 10;
+	tg->last_finish_time = finish_time;
+
+	start_time = bio->bi_issue_time >> 10;
+	if (!bio->bi_issue_time || finish_time <= start_time)
+		goto out;
+
+	lat = finish_time - start_time;
+
+	/* the device only carries the low limits, a good time to sample */
+	if (tg->td->limit_index == LIMIT_LOW) {
+		struct latency_bucket *bucket;
+		int index = request_bucket_index(bio->bi_issue_sectors);
+
+		bucket = get_cpu_ptr(tg->td->latency_buckets);
+		bucket[index].total_latency += lat;
+		bucket[index].samples++;
+		put_cpu_ptr(tg->td->latency_buckets);
+	}
+
+	if (tg->latency_target != DFL_LATENCY_TARGET) {
+		int index = request_bucket_index(bio->bi_issue_sectors);
+		unsigned long threshold;
+
+		threshold = tg->td->avg_buckets[index].latency +
+			    tg->latency_target;
+		if (lat > threshold)
+			tg->bad_bio_cnt++;
+		/*
+		 * Not race free, could get wrong count, which means cgroups
+		 * will be throttled
+		 */
+		tg->bio_cnt++;
+	}
+
+	if (time_after(jiffies, tg->bio_cnt_reset_time) || tg->bio_cnt > 1024) {
+		tg->bio_cnt_reset_time = jiffies + HZ;
+		tg->bio_cnt /= 2;
+		tg->bad_bio_cnt /= 2;
+	}
+out:
+	blkg_put(tg_to_blkg(tg));
+}
+
+static int throtl_alloc_latency_buckets(struct throtl_data *td)
+{
+	td->latency_buckets = __alloc_percpu(sizeof(struct latency_bucket) *
+		LATENCY_BUCKET_SIZE, __alignof__(u64));
+	return td->latency_buckets ? 0 : -ENOMEM;
+}
+
+static void throtl_free_latency_buckets(struct throtl_data *td)
+{
+	free_percpu(td->latency_buckets);
+}
+#else
+static inline void throtl_update_latency_buckets(struct throtl_data *td) { }
+static inline void blk_throtl_assoc_bio(struct throtl_grp *tg,
+					struct bio *bio) { }
+static inline int throtl_alloc_latency_buckets(struct throtl_data *td)
+{
+	return 0;
+}
+static inline void throtl_free_latency_buckets(struct throtl_data *td) { }
+#endif
+
 bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 		    struct bio *bio)
 {
@@ -1397,6 +2098,7 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	struct throtl_service_queue *sq;
 	bool rw = bio_data_dir(bio);
 	bool throttled = false;
+	struct throtl_data *td = tg->td;
 
 	WARN_ON_ONCE(!rcu_read_lock_held());
 
@@ -1409,16 +2111,33 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	if (unlikely(blk_queue_bypass(q)))
 		goto out_unlock;
 
+	/* idle and latency tracking only matter while low limits exist */
+	if (td->limit_valid[LIMIT_LOW]) {
+		throtl_update_latency_buckets(td);
+		blk_throtl_assoc_bio(tg, bio);
+	}
+
 	sq = &tg->service_queue;
 
+again:
 	while (true) {
+		if (tg->last_low_overflow_time[rw] == 0)
+			tg->last_low_overflow_time[rw] = jiffies;
+		throtl_downgrade_check(tg);
+		throtl_upgrade_check(tg);
 		/* throtl is FIFO - if bios are already queued, should queue */
 		if (sq->nr_queued[rw])
 			break;
 
 		/* if above limits, break to queue */
-		if (!tg_may_dispatch(tg, bio, NULL))
+		if (!tg_may_dispatch(tg, bio, NULL)) {
+			tg->last_low_overflow_time[rw] = jiffies;
+			if (throtl_can_upgrade(td, tg)) {
+				throtl_upgrade_state(td);
+				goto again;
+			}
 			break;
+		}
 
 		/* within limits, let's charge and dispatch directly */
 		throtl_charge_bio(tg, bio);
@@ -1451,10 +2170,12 @@ bool blk_throtl_bio(struct request_queue *q, struct blkcg_gq *blkg,
 	/* out-of-limit, queue to @tg */
 	throtl_log(sq, "[%c] bio. bdisp=%llu sz=%u bps=%llu iodisp=%u iops=%u queued=%d/%d",
 		   rw == READ ? 'R' : 'W',
-		   tg->bytes_disp[rw], bio->bi_iter.bi_size, tg->bps[rw],
-		   tg->io_disp[rw], tg->iops[rw],
+		   tg->bytes_disp[rw], bio->bi_iter.bi_size,
+		   tg_bps_limit(tg, rw), tg->io_disp[rw], tg_iops_limit(tg, rw),
 		   sq->nr_queued[READ], sq->nr_queued[WRITE]);
 
+	tg->last_low_overflow_time[rw] = jiffies;
+
 	bio_associate_current(bio);
 	tg->td->nr_queued[rw]++;
 	throtl_add_bio_tg(bio, qn, tg);
@@ -1481,6 +2202,12 @@ out:
 	 */
 	if (!throttled)
 		bio->bi_opf &= ~REQ_THROTTLED;
+
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	/* time spent throttled isn't device latency */
+	if (throttled)
+		bio->bi_issue_time = 0;
+#endif
 	return throttled;
 }
 
@@ -1557,16 +2284,28 @@ int blk_throtl_init(struct request_queue *q)
 	if (!td)
 		return -ENOMEM;
 
+	if (throtl_alloc_latency_buckets(td)) {
+		kfree(td);
+		return -ENOMEM;
+	}
+
 	INIT_WORK(&td->dispatch_work, blk_throtl_dispatch_work_fn);
 	throtl_service_queue_init(&td->service_queue);
 
 	q->td = td;
 	td->queue = q;
 
+	td->limit_valid[LIMIT_MAX] = true;
+	td->limit_index = LIMIT_MAX;
+	td->low_upgrade_time = jiffies;
+	td->low_downgrade_time = jiffies;
+
 	/* activate policy */
 	ret = blkcg_activate_policy(q, &blkcg_policy_throtl);
-	if (ret)
+	if (ret) {
+		throtl_free_latency_buckets(td);
 		kfree(td);
+	}
 	return ret;
 }
 
@@ -1575,6 +2314,7 @@ void blk_throtl_exit(struct request_queue *q)
 	BUG_ON(!q->td);
 	throtl_shutdown_wq(q);
 	blkcg_deactivate_policy(q, &blkcg_policy_throtl);
+	throtl_free_latency_buckets(q->td);
 	kfree(q->td);
 }
 
@@ -33,6 +33,8 @@ static const int cfq_slice_async_rq = 2;
 static u64 cfq_slice_idle = NSEC_PER_SEC / 125;
 static u64 cfq_group_idle = NSEC_PER_SEC / 125;
 static const u64 cfq_target_latency = (u64)NSEC_PER_SEC * 3/10; /* 300 ms */
+/* write completion latency async dispatch is throttled to in flash mode */
+static const u64 cfq_flash_write_latency = NSEC_PER_SEC / 50;
 static const int cfq_hist_divisor = 4;
 
 /*
@@ -191,6 +193,12 @@ struct cfqg_stats {
 	struct blkg_rwstat		queued;
 	/* total disk time and nr sectors dispatched by this group */
 	struct blkg_stat		time;
+	/* flash mode: idle windows not armed for sequential writers */
+	struct blkg_stat		flash_idle_skipped;
+	/* flash mode: async dispatches held back by the write latency */
+	struct blkg_stat		flash_async_throttled;
+	/* flash mode: times this group was moved ahead for its reads */
+	struct blkg_stat		flash_read_boosted;
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	/* time not charged to this cgroup */
 	struct blkg_stat		unaccounted_time;
@@ -222,6 +230,8 @@ struct cfq_group_data {
 
 	unsigned int weight;
 	unsigned int leaf_weight;
+	/* foreground group, its reads jump ahead in flash mode */
+	unsigned int read_boost;
 };
 
 /* This is per cgroup per device grouping structure */
@@ -387,6 +397,15 @@ struct cfq_data {
 	u64 cfq_slice_idle;
 	u64 cfq_group_idle;
 	u64 cfq_target_latency;
+	unsigned int cfq_flash_mode;
+	u64 cfq_flash_write_latency;
+
+	/*
+	 * flash mode: average write completion latency and the async
+	 * dispatch depth derived from it
+	 */
+	u64 flash_write_lat;
+	unsigned int flash_async_depth;
 
 	/*
 	 * Fallback dummy cfqq for extreme OOM conditions
@@ -426,6 +445,7 @@ enum cfqq_state_flags {
 	CFQ_CFQQ_FLAG_split_coop,	/* shared cfqq will be splitted */
 	CFQ_CFQQ_FLAG_deep,		/* sync cfqq experienced large depth */
 	CFQ_CFQQ_FLAG_wait_busy,	/* Waiting for next request */
+	CFQ_CFQQ_FLAG_seq_write,	/* last request continued a write */
 };
 
 #define CFQ_CFQQ_FNS(name)						\
@@ -455,6 +475,7 @@ CFQ_CFQQ_FNS(coop);
 CFQ_CFQQ_FNS(split_coop);
 CFQ_CFQQ_FNS(deep);
 CFQ_CFQQ_FNS(wait_busy);
+CFQ_CFQQ_FNS(seq_write);
 #undef CFQ_CFQQ_FNS
 
 #if defined(CONFIG_CFQ_GROUP_IOSCHED) && defined(CONFIG_DEBUG_BLK_CGROUP)
@@ -653,6 +674,13 @@ static inline void cfqg_put(struct cfq_group *cfqg)
 	return blkg_put(cfqg_to_blkg(cfqg));
 }
 
+static inline bool cfqg_read_boost(struct cfq_group *cfqg)
+{
+	struct cfq_group_data *cgd = blkcg_to_cfqgd(cfqg_to_blkg(cfqg)->blkcg);
+
+	return cgd && cgd->read_boost;
+}
+
 #define cfq_log_cfqq(cfqd, cfqq, fmt, args...)	do {			\
 	char __pbuf[128];						\
 									\
@@ -700,6 +728,21 @@ static inline void cfqg_stats_update_io_merged(struct cfq_group *cfqg, int op,
 	blkg_rwstat_add(&cfqg->stats.merged, op, op_flags, 1);
 }
 
+static inline void cfqg_stats_update_idle_skip(struct cfq_group *cfqg)
+{
+	blkg_stat_add(&cfqg->stats.flash_idle_skipped, 1);
+}
+
+static inline void cfqg_stats_update_async_throttle(struct cfq_group *cfqg)
+{
+	blkg_stat_add(&cfqg->stats.flash_async_throttled, 1);
+}
+
+static inline void cfqg_stats_update_read_boost(struct cfq_group *cfqg)
+{
+	blkg_stat_add(&cfqg->stats.flash_read_boosted, 1);
+}
+
 static inline void cfqg_stats_update_completion(struct cfq_group *cfqg,
 			uint64_t start_time, uint64_t io_start_time, int op,
 			int op_flags)
@@ -723,6 +766,9 @@ static void cfqg_stats_reset(struct cfqg_stats *stats)
 	blkg_rwstat_reset(&stats->service_time);
 	blkg_rwstat_reset(&stats->wait_time);
 	blkg_stat_reset(&stats->time);
+	blkg_stat_reset(&stats->flash_idle_skipped);
+	blkg_stat_reset(&stats->flash_async_throttled);
+	blkg_stat_reset(&stats->flash_read_boosted);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	blkg_stat_reset(&stats->unaccounted_time);
 	blkg_stat_reset(&stats->avg_queue_size_sum);
@@ -742,6 +788,10 @@ static void cfqg_stats_add_aux(struct cfqg_stats *to, struct cfqg_stats *from)
 	blkg_rwstat_add_aux(&to->service_time, &from->service_time);
 	blkg_rwstat_add_aux(&to->wait_time, &from->wait_time);
 	blkg_stat_add_aux(&from->time, &from->time);
+	blkg_stat_add_aux(&to->flash_idle_skipped, &from->flash_idle_skipped);
+	blkg_stat_add_aux(&to->flash_async_throttled,
+			  &from->flash_async_throttled);
+	blkg_stat_add_aux(&to->flash_read_boosted, &from->flash_read_boosted);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	blkg_stat_add_aux(&to->unaccounted_time, &from->unaccounted_time);
 	blkg_stat_add_aux(&to->avg_queue_size_sum, &from->avg_queue_size_sum);
@@ -781,6 +831,7 @@ static inline bool cfqg_is_descendant(struct cfq_group *cfqg,
 }
 static inline void cfqg_get(struct cfq_group *cfqg) { }
 static inline void cfqg_put(struct cfq_group *cfqg) { }
+static inline bool cfqg_read_boost(struct cfq_group *cfqg) { return false; }
 
 #define cfq_log_cfqq(cfqd, cfqq, fmt, args...)	\
 	blk_add_trace_msg((cfqd)->queue, "cfq%d%c%c " fmt, (cfqq)->pid,	\
@@ -797,6 +848,9 @@ static inline void cfqg_stats_update_io_remove(struct cfq_group *cfqg, int op,
 			int op_flags) { }
 static inline void cfqg_stats_update_io_merged(struct cfq_group *cfqg, int op,
 			int op_flags) { }
+static inline void cfqg_stats_update_idle_skip(struct cfq_group *cfqg) { }
+static inline void cfqg_stats_update_async_throttle(struct cfq_group *cfqg) { }
+static inline void cfqg_stats_update_read_boost(struct cfq_group *cfqg) { }
 static inline void cfqg_stats_update_completion(struct cfq_group *cfqg,
 			uint64_t start_time, uint64_t io_start_time, int op,
 			int op_flags) { }
@@ -1397,9 +1451,12 @@ cfq_group_notify_queue_add(struct cfq_data *cfqd, struct cfq_group *cfqg)
 	 * Currently put the group at the end. Later implement something
 	 * so that groups get lesser vtime based on their weights, so that
 	 * if group does not loose all if it was not continuously backlogged.
+	 * A foreground group in flash mode starts at the front instead.
 	 */
 	n = rb_last(&st->rb);
-	if (n) {
+	if (cfqd->cfq_flash_mode && cfqg_read_boost(cfqg))
+		cfqg->vdisktime = st->min_vdisktime;
+	else if (n) {
 		__cfqg = rb_entry_cfqg(n);
 		cfqg->vdisktime = __cfqg->vdisktime +
 			cfq_get_cfqg_vdisktime_delay(cfqd);
@@ -1459,6 +1516,25 @@ cfq_group_notify_queue_del(struct cfq_data *cfqd, struct cfq_group *cfqg)
 	cfqg_stats_update_dequeue(cfqg);
 }
 
+/*
+ * Move a busy group ahead of every other group so that it is served
+ * next. Used in flash mode for the reads of a foreground group.
+ */
+static void cfq_group_boost(struct cfq_data *cfqd, struct cfq_group *cfqg)
+{
+	struct cfq_rb_root *st = &cfqd->grp_service_tree;
+
+	if (RB_EMPTY_NODE(&cfqg->rb_node))
+		return;
+
+	cfq_group_service_tree_del(st, cfqg);
+	cfqg->vdisktime = st->min_vdisktime - 1;
+	cfq_group_service_tree_add(st, cfqg);
+
+	cfq_log_cfqg(cfqd, cfqg, "boost: min_vt=%llu", st->min_vdisktime);
+	cfqg_stats_update_read_boost(cfqg);
+}
+
 static inline u64 cfq_cfqq_slice_usage(struct cfq_queue *cfqq,
 				       u64 *unaccounted_time)
 {
@@ -1569,6 +1645,9 @@ static void cfqg_stats_exit(struct cfqg_stats *stats)
 	blkg_rwstat_exit(&stats->wait_time);
 	blkg_rwstat_exit(&stats->queued);
 	blkg_stat_exit(&stats->time);
+	blkg_stat_exit(&stats->flash_idle_skipped);
+	blkg_stat_exit(&stats->flash_async_throttled);
+	blkg_stat_exit(&stats->flash_read_boosted);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	blkg_stat_exit(&stats->unaccounted_time);
 	blkg_stat_exit(&stats->avg_queue_size_sum);
@@ -1586,7 +1665,10 @@ static int cfqg_stats_init(struct cfqg_stats *stats, gfp_t gfp)
 	    blkg_rwstat_init(&stats->service_time, gfp) ||
 	    blkg_rwstat_init(&stats->wait_time, gfp) ||
 	    blkg_rwstat_init(&stats->queued, gfp) ||
-	    blkg_stat_init(&stats->time, gfp))
+	    blkg_stat_init(&stats->time, gfp) ||
+	    blkg_stat_init(&stats->flash_idle_skipped, gfp) ||
+	    blkg_stat_init(&stats->flash_async_throttled, gfp) ||
+	    blkg_stat_init(&stats->flash_read_boosted, gfp))
 		goto err;
 
 #ifdef CONFIG_DEBUG_BLK_CGROUP
@@ -1912,6 +1994,39 @@ static int cfq_set_leaf_weight(struct cgroup_subsys_state *css,
 	return __cfq_set_weight(css, val, false, false, true);
 }
 
+static int cfq_print_read_boost(struct seq_file *sf, void *v)
+{
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct cfq_group_data *cgd = blkcg_to_cfqgd(blkcg);
+	unsigned int val = 0;
+
+	if (cgd)
+		val = cgd->read_boost;
+
+	seq_printf(sf, "%u\n", val);
+	return 0;
+}
+
+static int cfq_set_read_boost(struct cgroup_subsys_state *css,
+			      struct cftype *cft, u64 val)
+{
+	struct blkcg *blkcg = css_to_blkcg(css);
+	struct cfq_group_data *cfqgd;
+	int ret = 0;
+
+	if (val > 1)
+		return -EINVAL;
+
+	spin_lock_irq(&blkcg->lock);
+	cfqgd = blkcg_to_cfqgd(blkcg);
+	if (cfqgd)
+		cfqgd->read_boost = val;
+	else
+		ret = -EINVAL;
+	spin_unlock_irq(&blkcg->lock);
+	return ret;
+}
+
 static int cfqg_print_stat(struct seq_file *sf, void *v)
 {
 	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_stat,
@@ -2057,6 +2172,12 @@ static struct cftype cfq_blkcg_legacy_files[] = {
 		.seq_show = cfq_print_leaf_weight,
 		.write_u64 = cfq_set_leaf_weight,
 	},
+	{
+		.name = "read_boost",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cfq_print_read_boost,
+		.write_u64 = cfq_set_read_boost,
+	},
 
 	/* statistics, covers only the tasks in the cfqg */
 	{
@@ -2098,6 +2219,22 @@ static struct cftype cfq_blkcg_legacy_files[] = {
 		.private = offsetof(struct cfq_group, stats.queued),
 		.seq_show = cfqg_print_rwstat,
 	},
+	{
+		.name = "flash_idle_skipped",
+		.private = offsetof(struct cfq_group, stats.flash_idle_skipped),
+		.seq_show = cfqg_print_stat,
+	},
+	{
+		.name = "flash_async_throttled",
+		.private = offsetof(struct cfq_group,
+				    stats.flash_async_throttled),
+		.seq_show = cfqg_print_stat,
+	},
+	{
+		.name = "flash_read_boosted",
+		.private = offsetof(struct cfq_group, stats.flash_read_boosted),
+		.seq_show = cfqg_print_stat,
+	},
 
 	/* the same statictics which cover the cfqg and its descendants */
 	{
@@ -2211,6 +2348,12 @@ static struct cftype cfq_blkcg_files[] = {
 		.seq_show = cfq_print_weight_on_dfl,
 		.write = cfq_set_weight_on_dfl,
 	},
+	{
+		.name = "read_boost",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cfq_print_read_boost,
+		.write_u64 = cfq_set_read_boost,
+	},
 	{ }	/* terminate */
 };
 
@@ -2922,6 +3065,10 @@ static bool cfq_should_idle(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	if (wl_class == IDLE_WORKLOAD)
 		return false;
 
+	/* Nor for sequential writers on flash, there is no head to keep */
+	if (cfqd->cfq_flash_mode && cfq_cfqq_seq_write(cfqq))
+		return false;
+
 	/* We do for queues that were marked with idle window flag. */
 	if (cfq_cfqq_idle_window(cfqq) &&
 	   !(blk_queue_nonrot(cfqd->queue) && cfqd->hw_tag))
@@ -2957,6 +3104,16 @@ static void cfq_arm_slice_timer(struct cfq_data *cfqd)
 	WARN_ON(!RB_EMPTY_ROOT(&cfqq->sort_list));
 	WARN_ON(cfq_cfqq_slice_new(cfqq));
 
+	/*
+	 * Flash device and a sequential writer: neither queue nor group
+	 * idling buys anything, hand the device to the next queue.
+	 */
+	if (cfqd->cfq_flash_mode && cfq_cfqq_seq_write(cfqq)) {
+		cfqg_stats_update_idle_skip(cfqq->cfqg);
+		cfq_log_cfqq(cfqd, cfqq, "Not idling. flash seq write");
+		return;
+	}
+
 	/*
 	 * idle is disabled, either manually or by past process history
 	 */
@@ -3510,6 +3667,18 @@ static bool cfq_may_dispatch(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 			max_dispatch = depth;
 	}
 
+	/*
+	 * In flash mode the async depth also follows the measured write
+	 * latency, so a burst of writeback can't build up a queue inside
+	 * the device that the next read has to wait behind.
+	 */
+	if (!cfq_cfqq_sync(cfqq) && cfqd->cfq_flash_mode &&
+	    cfqd->flash_async_depth < max_dispatch) {
+		max_dispatch = cfqd->flash_async_depth;
+		if (cfqq->dispatched >= max_dispatch)
+			cfqg_stats_update_async_throttle(cfqq->cfqg);
+	}
+
 	/*
 	 * If we're below the current max, allow a dispatch
 	 */
@@ -4012,6 +4181,14 @@ cfq_should_preempt(struct cfq_data *cfqd, struct cfq_queue *new_cfqq,
 	if (rq_is_sync(rq) && !cfq_cfqq_sync(cfqq) && !cfq_cfqq_must_dispatch(cfqq))
 		return true;
 
+	/*
+	 * In flash mode, reads of a foreground group preempt everybody
+	 * else. There is no seek to lose by switching queues.
+	 */
+	if (cfqd->cfq_flash_mode && rq_is_sync(rq) && rq_data_dir(rq) == READ &&
+	    cfqg_read_boost(new_cfqq->cfqg) && !cfqg_read_boost(cfqq->cfqg))
+		return true;
+
 	/*
 	 * Treat ancestors of current cgroup the same way as current cgroup.
 	 * For anybody else we disallow preemption to guarantee service
@@ -4078,6 +4255,13 @@ static void cfq_preempt_queue(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	if (old_type != cfqq_type(cfqq))
 		cfqq->cfqg->saved_wl_slice = 0;
 
+	/*
+	 * A foreground group has to come first on the group service tree
+	 * as well, or the preemption would only reorder its own queues.
+	 */
+	if (cfqd->cfq_flash_mode && cfqg_read_boost(cfqq->cfqg))
+		cfq_group_boost(cfqd, cfqq->cfqg);
+
 	/*
 	 * Put the new queue at the front of the of the current list,
 	 * so we know that it will be selected next.
@@ -4104,6 +4288,12 @@ cfq_rq_enqueued(struct cfq_data *cfqd, struct cfq_queue *cfqq,
 	if (rq->cmd_flags & REQ_PRIO)
 		cfqq->prio_pending++;
 
+	if (rq_data_dir(rq) == WRITE &&
+	    cfqq->last_request_pos == blk_rq_pos(rq))
+		cfq_mark_cfqq_seq_write(cfqq);
+	else
+		cfq_clear_cfqq_seq_write(cfqq);
+
 	cfq_update_io_thinktime(cfqd, cfqq, cic);
 	cfq_update_io_seektime(cfqd, cfqq, rq);
 	cfq_update_idle_window(cfqd, cfqq, cic);
@@ -4235,6 +4425,37 @@ static bool cfq_should_wait_busy(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	return false;
 }
 
+/*
+ * Flash mode: keep a running average of how long writes take in the
+ * device and move the async dispatch depth one step at a time to keep
+ * that average below cfq_flash_write_latency.
+ */
+static void cfq_update_flash_async_depth(struct cfq_data *cfqd,
+					 struct request *rq)
+{
+	u64 io_start = rq_io_start_time_ns(rq);
+	u64 now = sched_clock();
+	u64 lat;
+
+	/* dispatch time is only recorded with blk-cgroup */
+	if (!io_start || !time_after64(now, io_start))
+		return;
+
+	lat = now - io_start;
+	if (cfqd->flash_write_lat)
+		cfqd->flash_write_lat = (7 * cfqd->flash_write_lat + lat) >> 3;
+	else
+		cfqd->flash_write_lat = lat;
+
+	if (cfqd->flash_write_lat > cfqd->cfq_flash_write_latency) {
+		if (cfqd->flash_async_depth > 1)
+			cfqd->flash_async_depth--;
+	} else if (cfqd->flash_write_lat < cfqd->cfq_flash_write_latency / 2) {
+		if (cfqd->flash_async_depth < cfqd->cfq_quantum)
+			cfqd->flash_async_depth++;
+	}
+}
+
 static void cfq_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct cfq_queue *cfqq = RQ_CFQQ(rq);
@@ -4258,6 +4479,9 @@ static void cfq_completed_request(struct request_queue *q, struct request *rq)
 
 	cfqd->rq_in_flight[cfq_cfqq_sync(cfqq)]--;
 
+	if (cfqd->cfq_flash_mode && rq_data_dir(rq) == WRITE)
+		cfq_update_flash_async_depth(cfqd, rq);
+
 	if (sync) {
 		struct cfq_rb_root *st;
 
@@ -4682,6 +4906,8 @@ static int cfq_init_queue(struct request_queue *q, struct elevator_type *e)
 	cfqd->cfq_slice_idle = cfq_slice_idle;
 	cfqd->cfq_group_idle = cfq_group_idle;
 	cfqd->cfq_latency = 1;
+	cfqd->cfq_flash_write_latency = cfq_flash_write_latency;
+	cfqd->flash_async_depth = cfq_quantum;
 	cfqd->hw_tag = -1;
 	/*
 	 * we optimistically start assuming sync ops weren't delayed in last
@@ -4747,6 +4973,8 @@ SHOW_FUNCTION(cfq_slice_async_show, cfqd->cfq_slice[0], 1);
 SHOW_FUNCTION(cfq_slice_async_rq_show, cfqd->cfq_slice_async_rq, 0);
 SHOW_FUNCTION(cfq_low_latency_show, cfqd->cfq_latency, 0);
 SHOW_FUNCTION(cfq_target_latency_show, cfqd->cfq_target_latency, 1);
+SHOW_FUNCTION(cfq_flash_mode_show, cfqd->cfq_flash_mode, 0);
+SHOW_FUNCTION(cfq_flash_write_latency_show, cfqd->cfq_flash_write_latency, 1);
 #undef SHOW_FUNCTION
 
 #define USEC_SHOW_FUNCTION(__FUNC, __VAR)				\
@@ -4762,6 +4990,8 @@ USEC_SHOW_FUNCTION(cfq_group_idle_us_show, cfqd->cfq_group_idle);
 USEC_SHOW_FUNCTION(cfq_slice_sync_us_show, cfqd->cfq_slice[1]);
 USEC_SHOW_FUNCTION(cfq_slice_async_us_show, cfqd->cfq_slice[0]);
 USEC_SHOW_FUNCTION(cfq_target_latency_us_show, cfqd->cfq_target_latency);
+USEC_SHOW_FUNCTION(cfq_flash_write_latency_us_show,
+		   cfqd->cfq_flash_write_latency);
 #undef USEC_SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -4796,6 +5026,9 @@ STORE_FUNCTION(cfq_slice_async_rq_store, &cfqd->cfq_slice_async_rq, 1,
 		UINT_MAX, 0);
 STORE_FUNCTION(cfq_low_latency_store, &cfqd->cfq_latency, 0, 1, 0);
 STORE_FUNCTION(cfq_target_latency_store, &cfqd->cfq_target_latency, 1, UINT_MAX, 1);
+STORE_FUNCTION(cfq_flash_mode_store, &cfqd->cfq_flash_mode, 0, 1, 0);
+STORE_FUNCTION(cfq_flash_write_latency_store, &cfqd->cfq_flash_write_latency,
+		1, UINT_MAX, 1);
 #undef STORE_FUNCTION
 
 #define USEC_STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -4816,6 +5049,8 @@ USEC_STORE_FUNCTION(cfq_group_idle_us_store, &cfqd->cfq_group_idle, 0, UINT_MAX)
 USEC_STORE_FUNCTION(cfq_slice_sync_us_store, &cfqd->cfq_slice[1], 1, UINT_MAX);
 USEC_STORE_FUNCTION(cfq_slice_async_us_store, &cfqd->cfq_slice[0], 1, UINT_MAX);
 USEC_STORE_FUNCTION(cfq_target_latency_us_store, &cfqd->cfq_target_latency, 1, UINT_MAX);
+USEC_STORE_FUNCTION(cfq_flash_write_latency_us_store,
+		    &cfqd->cfq_flash_write_latency, 1, UINT_MAX);
 #undef USEC_STORE_FUNCTION
 
 #define CFQ_ATTR(name) \
@@ -4839,6 +5074,9 @@ static struct elv_fs_entry cfq_attrs[] = {
 	CFQ_ATTR(low_latency),
 	CFQ_ATTR(target_latency),
 	CFQ_ATTR(target_latency_us),
+	CFQ_ATTR(flash_mode),
+	CFQ_ATTR(flash_write_latency),
+	CFQ_ATTR(flash_write_latency_us),
 	__ATTR_NULL
 };
 
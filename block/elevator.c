@@ -25,6 +25,7 @@
 #include <linux/kernel.h>
 #include <linux/fs.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/elevator.h>
 #include <linux/bio.h>
 #include <linux/module.h>
@@ -40,6 +41,7 @@
 #include <trace/events/block.h>
 
 #include "blk.h"
+#include "blk-mq-sched.h"
 
 static DEFINE_SPINLOCK(elv_list_lock);
 static LIST_HEAD(elv_list);
@@ -212,6 +214,23 @@ int elevator_init(struct request_queue *q, char *name)
 		if (!e)
 			printk(KERN_ERR "I/O scheduler %s not found\n",
 							chosen_elevator);
+		else if (e->uses_mq != !!q->mq_ops) {
+			elevator_put(e);
+			e = NULL;
+		}
+	}
+
+	/*
+	 * A single hardware queue usually fronts a device with little
+	 * internal parallelism, where reads suffer most behind a deep
+	 * write queue.  Give those mq-deadline, everything else "none".
+	 */
+	if (!e && q->mq_ops) {
+		if (q->nr_hw_queues != 1)
+			return 0;
+		e = elevator_get("mq-deadline", false);
+		if (!e)
+			return 0;
 	}
 
 	if (!e) {
@@ -224,7 +243,15 @@ int elevator_init(struct request_queue *q, char *name)
 		}
 	}
 
-	err = e->ops.elevator_init_fn(q, e);
+	if (e->uses_mq != !!q->mq_ops) {
+		elevator_put(e);
+		return -EINVAL;
+	}
+
+	if (e->uses_mq)
+		err = e->mq_ops.init_sched(q, e);
+	else
+		err = e->ops.elevator_init_fn(q, e);
 	if (err)
 		elevator_put(e);
 	return err;
@@ -234,7 +261,10 @@ EXPORT_SYMBOL(elevator_init);
 void elevator_exit(struct elevator_queue *e)
 {
 	mutex_lock(&e->sysfs_lock);
-	if (e->type->ops.elevator_exit_fn)
+	if (e->type->uses_mq) {
+		if (e->type->mq_ops.exit_sched)
+			e->type->mq_ops.exit_sched(e);
+	} else if (e->type->ops.elevator_exit_fn)
 		e->type->ops.elevator_exit_fn(e);
 	mutex_unlock(&e->sysfs_lock);
 
@@ -248,13 +278,13 @@ static inline void __elv_rqhash_del(struct request *rq)
 	rq->cmd_flags &= ~REQ_HASHED;
 }
 
-static void elv_rqhash_del(struct request_queue *q, struct request *rq)
+void elv_rqhash_del(struct request_queue *q, struct request *rq)
 {
 	if (ELV_ON_HASH(rq))
 		__elv_rqhash_del(rq);
 }
 
-static void elv_rqhash_add(struct request_queue *q, struct request *rq)
+void elv_rqhash_add(struct request_queue *q, struct request *rq)
 {
 	struct elevator_queue *e = q->elevator;
 
@@ -263,13 +293,13 @@ static void elv_rqhash_add(struct request_queue *q, struct request *rq)
 	rq->cmd_flags |= REQ_HASHED;
 }
 
-static void elv_rqhash_reposition(struct request_queue *q, struct request *rq)
+void elv_rqhash_reposition(struct request_queue *q, struct request *rq)
 {
 	__elv_rqhash_del(rq);
 	elv_rqhash_add(q, rq);
 }
 
-static struct request *elv_rqhash_find(struct request_queue *q, sector_t offset)
+struct request *elv_rqhash_find(struct request_queue *q, sector_t offset)
 {
 	struct elevator_queue *e = q->elevator;
 	struct hlist_node *next;
@@ -943,6 +973,56 @@ fail_init:
 	return err;
 }
 
+/*
+ * blk-mq variant of elevator_switch().  A frozen queue holds no requests,
+ * so the old scheduler can go before the new one is set up.  If that
+ * fails the queue is left running without a scheduler.
+ */
+static int elevator_switch_mq(struct request_queue *q,
+			      struct elevator_type *new_e)
+{
+	struct elevator_queue *old = q->elevator;
+	bool registered = old ? old->registered : q->kobj.state_in_sysfs;
+	int err = 0;
+
+	blk_mq_freeze_queue(q);
+	blk_mq_sched_quiesce(q);
+
+	if (old) {
+		if (registered)
+			elv_unregister_queue(q);
+		elevator_exit(old);
+		q->elevator = NULL;
+	}
+
+	if (!new_e)
+		goto out;
+
+	err = new_e->mq_ops.init_sched(q, new_e);
+	if (err) {
+		elevator_put(new_e);
+		goto out;
+	}
+
+	if (registered) {
+		err = elv_register_queue(q);
+		if (err) {
+			elevator_exit(q->elevator);
+			q->elevator = NULL;
+		}
+	}
+
+out:
+	blk_mq_start_stopped_hw_queues(q, true);
+	blk_mq_unfreeze_queue(q);
+
+	blk_add_trace_msg(q, "elv switch: %s",
+			  q->elevator ? q->elevator->type->elevator_name :
+			  "none");
+
+	return err;
+}
+
 /*
  * Switch this queue to the given IO scheduler.
  */
@@ -951,21 +1031,37 @@ static int __elevator_change(struct request_queue *q, const char *name)
 	char elevator_name[ELV_NAME_MAX];
 	struct elevator_type *e;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return -ENXIO;
 
 	strlcpy(elevator_name, name, sizeof(elevator_name));
+
+	if (q->mq_ops && !strcmp(strstrip(elevator_name), "none")) {
+		if (!q->elevator)
+			return 0;
+		return elevator_switch_mq(q, NULL);
+	}
+
 	e = elevator_get(strstrip(elevator_name), true);
 	if (!e) {
 		printk(KERN_ERR "elevator: type %s not found\n", elevator_name);
 		return -EINVAL;
 	}
 
-	if (!strcmp(elevator_name, q->elevator->type->elevator_name)) {
+	if (e->uses_mq != !!q->mq_ops) {
+		elevator_put(e);
+		return -EINVAL;
+	}
+
+	if (q->elevator &&
+	    !strcmp(elevator_name, q->elevator->type->elevator_name)) {
 		elevator_put(e);
 		return 0;
 	}
 
+	if (q->mq_ops)
+		return elevator_switch_mq(q, e);
+
 	return elevator_switch(q, e);
 }
 
@@ -987,7 +1083,7 @@ ssize_t elv_iosched_store(struct request_queue *q, const char *name,
 {
 	int ret;
 
-	if (!q->elevator)
+	if (!q->elevator && !q->mq_ops)
 		return count;
 
 	ret = __elevator_change(q, name);
@@ -1005,20 +1101,25 @@ ssize_t elv_iosched_show(struct request_queue *q, char *name)
 	struct elevator_type *__e;
 	int len = 0;
 
-	if (!q->elevator || !blk_queue_stackable(q))
+	if (!q->mq_ops && (!q->elevator || !blk_queue_stackable(q)))
 		return sprintf(name, "none\n");
 
-	elv = e->type;
+	elv = e ? e->type : NULL;
 
 	spin_lock(&elv_list_lock);
 	list_for_each_entry(__e, &elv_list, list) {
-		if (!strcmp(elv->elevator_name, __e->elevator_name))
+		if (__e->uses_mq != !!q->mq_ops)
+			continue;
+		if (elv && !strcmp(elv->elevator_name, __e->elevator_name))
 			len += sprintf(name+len, "[%s] ", elv->elevator_name);
 		else
 			len += sprintf(name+len, "%s ", __e->elevator_name);
 	}
 	spin_unlock(&elv_list_lock);
 
+	if (q->mq_ops)
+		len += sprintf(name+len, elv ? "none" : "[none]");
+
 	len += sprintf(len+name, "\n");
 	return len;
 }
@@ -0,0 +1,284 @@
+/*
+ * Synchronous Compression operations
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/crypto.h>
+#include <linux/vmalloc.h>
+#include <crypto/algapi.h>
+#include <linux/cryptouser.h>
+#include <net/netlink.h>
+#include <crypto/scatterwalk.h>
+#include <crypto/internal/acompress.h>
+#include <crypto/internal/scompress.h>
+#include "internal.h"
+
+static const struct crypto_type crypto_scomp_type;
+
+/*
+ * The scatterlists of a request are linearised into per-CPU buffers, which
+ * only exist while some acomp transform sits on top of an scomp algorithm.
+ */
+struct scomp_scratch {
+	void *src;
+	void *dst;
+};
+
+static struct scomp_scratch __percpu *scomp_scratch;
+static unsigned int scomp_scratch_users;
+static DEFINE_MUTEX(scomp_lock);
+
+#ifdef CONFIG_NET
+static int crypto_scomp_report(struct sk_buff *skb, struct crypto_alg *alg)
+{
+	struct crypto_report_comp rscomp;
+
+	strncpy(rscomp.type, "scomp", sizeof(rscomp.type));
+
+	if (nla_put(skb, CRYPTOCFGA_REPORT_COMPRESS,
+		    sizeof(struct crypto_report_comp), &rscomp))
+		goto nla_put_failure;
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+#else
+static int crypto_scomp_report(struct sk_buff *skb, struct crypto_alg *alg)
+{
+	return -ENOSYS;
+}
+#endif
+
+static void crypto_scomp_show(struct seq_file *m, struct crypto_alg *alg)
+	__attribute__ ((unused));
+
+static void crypto_scomp_show(struct seq_file *m, struct crypto_alg *alg)
+{
+	seq_puts(m, "type         : scomp\n");
+}
+
+static int crypto_scomp_init_tfm(struct crypto_tfm *tfm)
+{
+	return 0;
+}
+
+static void crypto_scomp_free_scratch(void)
+{
+	struct scomp_scratch *scratch;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		scratch = per_cpu_ptr(scomp_scratch, cpu);
+		vfree(scratch->src);
+		vfree(scratch->dst);
+	}
+	free_percpu(scomp_scratch);
+	scomp_scratch = NULL;
+}
+
+static int crypto_scomp_get_scratch(void)
+{
+	struct scomp_scratch *scratch;
+	int cpu;
+	int err = 0;
+
+	mutex_lock(&scomp_lock);
+	if (scomp_scratch_users++)
+		goto out;
+
+	scomp_scratch = alloc_percpu(struct scomp_scratch);
+	if (!scomp_scratch)
+		goto nomem;
+
+	for_each_possible_cpu(cpu) {
+		scratch = per_cpu_ptr(scomp_scratch, cpu);
+		scratch->src = vmalloc_node(SCOMP_SCRATCH_SIZE,
+					    cpu_to_node(cpu));
+		scratch->dst = vmalloc_node(SCOMP_SCRATCH_SIZE,
+					    cpu_to_node(cpu));
+		if (!scratch->src || !scratch->dst)
+			goto nomem;
+	}
+	goto out;
+
+nomem:
+	if (scomp_scratch)
+		crypto_scomp_free_scratch();
+	scomp_scratch_users--;
+	err = -ENOMEM;
+out:
+	mutex_unlock(&scomp_lock);
+	return err;
+}
+
+static void crypto_scomp_put_scratch(void)
+{
+	mutex_lock(&scomp_lock);
+	if (!--scomp_scratch_users)
+		crypto_scomp_free_scratch();
+	mutex_unlock(&scomp_lock);
+}
+
+static const struct crypto_type crypto_scomp_type = {
+	.extsize = crypto_alg_extsize,
+	.init_tfm = crypto_scomp_init_tfm,
+#ifdef CONFIG_PROC_FS
+	.show = crypto_scomp_show,
+#endif
+	.report = crypto_scomp_report,
+	.maskclear = ~CRYPTO_ALG_TYPE_MASK,
+	.maskset = CRYPTO_ALG_TYPE_MASK,
+	.type = CRYPTO_ALG_TYPE_SCOMPRESS,
+	.tfmsize = offsetof(struct crypto_scomp, base),
+};
+
+static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
+{
+	struct crypto_acomp *tfm = crypto_acomp_reqtfm(req);
+	void **tfm_ctx = acomp_tfm_ctx(tfm);
+	struct crypto_scomp *scomp = *tfm_ctx;
+	void **ctx = acomp_request_ctx(req);
+	struct scomp_scratch *scratch;
+	unsigned int dlen;
+	int ret;
+
+	if (!req->src || !req->slen || req->slen > SCOMP_SCRATCH_SIZE)
+		return -EINVAL;
+
+	if (!req->dst || !req->dlen)
+		return -EINVAL;
+
+	dlen = min_t(unsigned int, req->dlen, SCOMP_SCRATCH_SIZE);
+
+	scratch = get_cpu_ptr(scomp_scratch);
+	scatterwalk_map_and_copy(scratch->src, req->src, 0, req->slen, 0);
+	if (dir)
+		ret = crypto_scomp_compress(scomp, scratch->src, req->slen,
+					    scratch->dst, &dlen, *ctx);
+	else
+		ret = crypto_scomp_decompress(scomp, scratch->src, req->slen,
+					      scratch->dst, &dlen, *ctx);
+	if (!ret) {
+		scatterwalk_map_and_copy(scratch->dst, req->dst, 0, dlen, 1);
+		req->dlen = dlen;
+	}
+	put_cpu_ptr(scomp_scratch);
+
+	return ret;
+}
+
+static int scomp_acomp_compress(struct acomp_req *req)
+{
+	return scomp_acomp_comp_decomp(req, 1);
+}
+
+static int scomp_acomp_decompress(struct acomp_req *req)
+{
+	return scomp_acomp_comp_decomp(req, 0);
+}
+
+static void crypto_exit_scomp_ops_async(struct crypto_tfm *tfm)
+{
+	struct crypto_scomp **ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_scomp(*ctx);
+	crypto_scomp_put_scratch();
+}
+
+int crypto_init_scomp_ops_async(struct crypto_tfm *tfm)
+{
+	struct crypto_alg *calg = tfm->__crt_alg;
+	struct crypto_acomp *crt = __crypto_acomp_tfm(tfm);
+	struct crypto_scomp **ctx = crypto_tfm_ctx(tfm);
+	struct crypto_scomp *scomp;
+	int err;
+
+	err = crypto_scomp_get_scratch();
+	if (err)
+		return err;
+
+	if (!crypto_mod_get(calg)) {
+		crypto_scomp_put_scratch();
+		return -EAGAIN;
+	}
+
+	scomp = crypto_create_tfm(calg, &crypto_scomp_type);
+	if (IS_ERR(scomp)) {
+		crypto_mod_put(calg);
+		crypto_scomp_put_scratch();
+		return PTR_ERR(scomp);
+	}
+
+	*ctx = scomp;
+	tfm->exit = crypto_exit_scomp_ops_async;
+
+	crt->compress = scomp_acomp_compress;
+	crt->decompress = scomp_acomp_decompress;
+	crt->reqsize = sizeof(void *);
+
+	return 0;
+}
+
+struct acomp_req *crypto_acomp_scomp_alloc_ctx(struct acomp_req *req)
+{
+	struct crypto_acomp *acomp = crypto_acomp_reqtfm(req);
+	struct crypto_tfm *tfm = crypto_acomp_tfm(acomp);
+	struct crypto_scomp **tfm_ctx = crypto_tfm_ctx(tfm);
+	struct crypto_scomp *scomp = *tfm_ctx;
+	void *ctx;
+
+	ctx = crypto_scomp_alloc_ctx(scomp);
+	if (IS_ERR(ctx)) {
+		kfree(req);
+		return NULL;
+	}
+
+	*req->__ctx = ctx;
+
+	return req;
+}
+
+void crypto_acomp_scomp_free_ctx(struct acomp_req *req)
+{
+	struct crypto_acomp *acomp = crypto_acomp_reqtfm(req);
+	struct crypto_tfm *tfm = crypto_acomp_tfm(acomp);
+	struct crypto_scomp **tfm_ctx = crypto_tfm_ctx(tfm);
+	struct crypto_scomp *scomp = *tfm_ctx;
+	void *ctx = *req->__ctx;
+
+	if (ctx)
+		crypto_scomp_free_ctx(scomp, ctx);
+}
+
+int crypto_register_scomp(struct scomp_alg *alg)
+{
+	struct crypto_alg *base = &alg->base;
+
+	base->cra_type = &crypto_scomp_type;
+	base->cra_flags &= ~CRYPTO_ALG_TYPE_MASK;
+	base->cra_flags |= CRYPTO_ALG_TYPE_SCOMPRESS;
+
+	return crypto_register_alg(base);
+}
+EXPORT_SYMBOL_GPL(crypto_register_scomp);
+
+void crypto_unregister_scomp(struct scomp_alg *alg)
+{
+	crypto_unregister_alg(&alg->base);
+}
+EXPORT_SYMBOL_GPL(crypto_unregister_scomp);
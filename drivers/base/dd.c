@@ -23,8 +23,12 @@
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/async.h>
+#include <linux/bsearch.h>
+#include <linux/of.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -177,6 +181,125 @@ static void driver_deferred_probe_trigger(void)
 	schedule_work(&deferred_probe_work);
 }
 
+/*
+ * Most devices defer for a supplier they name in DT: clocks, dmas,
+ * power-domains, *-supply, pinctrl-*... When a device binds, the pending
+ * devices whose nodes contain a phandle of its node or of a node below it
+ * are retried right away. Everything else is retried in one batch
+ * DEFERRED_PROBE_BATCH_MS later, instead of the whole pending list after
+ * every single bind. A stray match only costs an early retry.
+ */
+#define DEFERRED_PROBE_BATCH_MS	50
+
+static void deferred_probe_batch_func(struct work_struct *work)
+{
+	driver_deferred_probe_trigger();
+}
+static DECLARE_DELAYED_WORK(deferred_probe_batch_work,
+			    deferred_probe_batch_func);
+
+static int deferred_phandle_cmp(const void *a, const void *b)
+{
+	u32 pa = *(const u32 *)a, pb = *(const u32 *)b;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+/* count, and store in @ph unless NULL, the phandles of @np and below */
+static int deferred_collect_phandles(struct device_node *np, u32 *ph, int n)
+{
+	struct device_node *child;
+
+	if (np->phandle) {
+		if (ph)
+			ph[n] = np->phandle;
+		n++;
+	}
+
+	for_each_child_of_node(np, child)
+		n = deferred_collect_phandles(child, ph, n);
+
+	return n;
+}
+
+static bool deferred_refers_to(struct device_node *np, const u32 *ph, int n)
+{
+	struct device_node *child;
+	struct property *prop;
+
+	for_each_property_of_node(np, prop) {
+		const __be32 *cell = prop->value;
+		int i;
+
+		if (prop->length % sizeof(*cell))
+			continue;
+
+		for (i = 0; i < prop->length / sizeof(*cell); i++) {
+			u32 v = be32_to_cpup(cell + i);
+
+			if (v && bsearch(&v, ph, n, sizeof(*ph),
+					 deferred_phandle_cmp))
+				return true;
+		}
+	}
+
+	for_each_child_of_node(np, child) {
+		if (deferred_refers_to(child, ph, n)) {
+			of_node_put(child);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * driver_deferred_probe_trigger_for() - Re-probe the consumers of a device
+ * @supplier: device which just got bound
+ */
+static void driver_deferred_probe_trigger_for(struct device *supplier)
+{
+	struct device_private *private, *tmp;
+	u32 *ph = NULL;
+	int n;
+
+	if (!driver_deferred_probe_enable)
+		return;
+
+	if (!supplier->of_node) {
+		driver_deferred_probe_trigger();
+		return;
+	}
+
+	n = deferred_collect_phandles(supplier->of_node, NULL, 0);
+	if (n) {
+		ph = kmalloc_array(n, sizeof(*ph), GFP_KERNEL);
+		if (!ph) {
+			driver_deferred_probe_trigger();
+			return;
+		}
+		deferred_collect_phandles(supplier->of_node, ph, 0);
+		sort(ph, n, sizeof(*ph), deferred_phandle_cmp, NULL);
+	}
+
+	mutex_lock(&deferred_probe_mutex);
+	atomic_inc(&deferred_trigger_count);
+	list_for_each_entry_safe(private, tmp, &deferred_probe_pending_list,
+				 deferred_probe) {
+		struct device_node *np = private->device->of_node;
+
+		if (!np || (n && deferred_refers_to(np, ph, n)))
+			list_move_tail(&private->deferred_probe,
+				       &deferred_probe_active_list);
+	}
+	mutex_unlock(&deferred_probe_mutex);
+	kfree(ph);
+
+	schedule_work(&deferred_probe_work);
+	schedule_delayed_work(&deferred_probe_batch_work,
+			      msecs_to_jiffies(DEFERRED_PROBE_BATCH_MS));
+}
+
 /**
  * device_block_probing() - Block/defere device's probes
  *
@@ -214,6 +337,10 @@ static int deferred_probe_initcall(void)
 	driver_deferred_probe_trigger();
 	/* Sort as many dependencies as possible before exiting initcalls */
 	flush_work(&deferred_probe_work);
+	while (delayed_work_pending(&deferred_probe_batch_work)) {
+		flush_delayed_work(&deferred_probe_batch_work);
+		flush_work(&deferred_probe_work);
+	}
 	return 0;
 }
 late_initcall(deferred_probe_initcall);
@@ -252,7 +379,7 @@ static void driver_bound(struct device *dev)
 	 * kick off retrying all pending devices
 	 */
 	driver_deferred_probe_del(dev);
-	driver_deferred_probe_trigger();
+	driver_deferred_probe_trigger_for(dev);
 
 	if (dev->bus)
 		blocking_notifier_call_chain(&dev->bus->p->bus_notifier,
@@ -521,6 +648,23 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	return ret;
 }
 
+#define ASYNC_DRV_NAMES_MAX_LEN	256
+static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
+
+/*
+ * driver_async_probe=<name>[,<name>...] makes the named drivers probe
+ * asynchronously, without touching the drivers themselves.
+ */
+static int __init save_async_options(char *buf)
+{
+	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
+		pr_warn("Too long list of driver names for 'driver_async_probe'!\n");
+
+	strlcpy(async_probe_drv_names, buf, ASYNC_DRV_NAMES_MAX_LEN);
+	return 0;
+}
+__setup("driver_async_probe=", save_async_options);
+
 bool driver_allows_async_probing(struct device_driver *drv)
 {
 	switch (drv->probe_type) {
@@ -531,6 +675,9 @@ bool driver_allows_async_probing(struct device_driver *drv)
 		return false;
 
 	default:
+		if (parse_option_str(async_probe_drv_names, drv->name))
+			return true;
+
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
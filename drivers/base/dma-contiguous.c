@@ -27,6 +27,13 @@
 #include <linux/sizes.h>
 #include <linux/dma-contiguous.h>
 #include <linux/cma.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #ifdef CONFIG_CMA_SIZE_MBYTES
 #define CMA_SIZE_MBYTES CONFIG_CMA_SIZE_MBYTES
@@ -178,6 +185,233 @@ int __init dma_contiguous_reserve_area(phys_addr_t size, phys_addr_t base,
 	return 0;
 }
 
+/*
+ * Pre-migrated reserve for the default area.
+ *
+ * A large allocation from an area full of movable page cache has to
+ * migrate all of it first, which can take a second for a frame pool.
+ * With reserve_mb set, a background work keeps that much of the default
+ * area allocated in CMA_RESERVE_CHUNK pieces, so the migration happens
+ * ahead of time. A large allocation hands the reserve back right before
+ * cma_alloc() looks for a free range, and the reserve is refilled once
+ * allocations have been quiet for CMA_RESERVE_REFILL_MS.
+ */
+#define CMA_RESERVE_CHUNK	(SZ_1M >> PAGE_SHIFT)
+#define CMA_RESERVE_REFILL_MS	2000
+
+struct cma_reserve_chunk {
+	struct list_head	list;
+	struct page		*pages;
+};
+
+static unsigned int cma_reserve_mb;
+static unsigned long cma_reserve_pages;
+static unsigned long cma_reserve_refills;
+static unsigned int cma_reserve_gen;
+static bool cma_reserve_ready;
+static LIST_HEAD(cma_reserve_list);
+static DEFINE_MUTEX(cma_reserve_lock);
+
+static void cma_reserve_fill(struct work_struct *work);
+static DECLARE_DELAYED_WORK(cma_reserve_work, cma_reserve_fill);
+
+static void cma_reserve_fill(struct work_struct *work)
+{
+	struct cma *cma = dma_contiguous_default_area;
+	unsigned long target = (unsigned long)READ_ONCE(cma_reserve_mb) *
+			       (SZ_1M >> PAGE_SHIFT);
+	struct cma_reserve_chunk *chunk;
+	unsigned int gen;
+
+	mutex_lock(&cma_reserve_lock);
+	gen = cma_reserve_gen;
+	cma_reserve_refills++;
+
+	while (cma_reserve_pages > target) {
+		chunk = list_last_entry(&cma_reserve_list,
+					struct cma_reserve_chunk, list);
+		list_del(&chunk->list);
+		cma_reserve_pages -= CMA_RESERVE_CHUNK;
+		cma_release(cma, chunk->pages, CMA_RESERVE_CHUNK);
+		kfree(chunk);
+	}
+
+	while (cma_reserve_pages < target) {
+		/* let allocations through while this chunk is migrated */
+		mutex_unlock(&cma_reserve_lock);
+
+		chunk = kmalloc(sizeof(*chunk), GFP_KERNEL);
+		if (!chunk)
+			return;
+
+		chunk->pages = cma_alloc(cma, CMA_RESERVE_CHUNK, 0);
+		if (!chunk->pages) {
+			kfree(chunk);
+			return;
+		}
+
+		mutex_lock(&cma_reserve_lock);
+		if (gen != cma_reserve_gen) {
+			/* drained meanwhile, a later run refills */
+			cma_release(cma, chunk->pages, CMA_RESERVE_CHUNK);
+			kfree(chunk);
+			break;
+		}
+		list_add_tail(&chunk->list, &cma_reserve_list);
+		cma_reserve_pages += CMA_RESERVE_CHUNK;
+	}
+	mutex_unlock(&cma_reserve_lock);
+}
+
+static void cma_reserve_schedule(unsigned long delay)
+{
+	if (READ_ONCE(cma_reserve_ready))
+		mod_delayed_work(system_unbound_wq, &cma_reserve_work, delay);
+}
+
+static void cma_reserve_drain(void)
+{
+	struct cma_reserve_chunk *chunk, *tmp;
+	LIST_HEAD(list);
+
+	mutex_lock(&cma_reserve_lock);
+	list_splice_init(&cma_reserve_list, &list);
+	cma_reserve_pages = 0;
+	cma_reserve_gen++;
+	mutex_unlock(&cma_reserve_lock);
+
+	list_for_each_entry_safe(chunk, tmp, &list, list) {
+		cma_release(dma_contiguous_default_area, chunk->pages,
+			    CMA_RESERVE_CHUNK);
+		kfree(chunk);
+	}
+}
+
+static int cma_reserve_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret)
+		cma_reserve_schedule(0);
+
+	return ret;
+}
+
+static const struct kernel_param_ops cma_reserve_ops = {
+	.set	= cma_reserve_set,
+	.get	= param_get_uint,
+};
+
+module_param_cb(reserve_mb, &cma_reserve_ops, &cma_reserve_mb, 0644);
+MODULE_PARM_DESC(reserve_mb, "MiB of the default CMA area kept migrated");
+
+#ifdef CONFIG_DEBUG_FS
+struct cma_dev_stats {
+	struct list_head	list;
+	const char		*name;
+	unsigned long		allocs;
+	unsigned long		fails;
+	unsigned long		pages;
+	u64			total_ns;
+	u64			max_ns;
+};
+
+static LIST_HEAD(cma_stats_list);
+static DEFINE_MUTEX(cma_stats_lock);
+
+static void dma_contiguous_account(struct device *dev, size_t count,
+				   bool ok, u64 ns)
+{
+	const char *name = dev ? dev_name(dev) : "(none)";
+	struct cma_dev_stats *s;
+
+	mutex_lock(&cma_stats_lock);
+	list_for_each_entry(s, &cma_stats_list, list)
+		if (!strcmp(s->name, name))
+			goto found;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		goto out;
+	s->name = kstrdup(name, GFP_KERNEL);
+	if (!s->name) {
+		kfree(s);
+		goto out;
+	}
+	list_add_tail(&s->list, &cma_stats_list);
+found:
+	if (ok) {
+		s->allocs++;
+		s->pages += count;
+	} else {
+		s->fails++;
+	}
+	s->total_ns += ns;
+	s->max_ns = max(s->max_ns, ns);
+out:
+	mutex_unlock(&cma_stats_lock);
+}
+
+static int dma_contiguous_stats_show(struct seq_file *m, void *v)
+{
+	struct cma_dev_stats *s;
+	unsigned long calls;
+
+	seq_printf(m, "reserve: %lu of %u MiB, %lu refills\n",
+		   cma_reserve_pages >> (20 - PAGE_SHIFT),
+		   READ_ONCE(cma_reserve_mb), cma_reserve_refills);
+	seq_printf(m, "%-24s %8s %8s %10s %10s %10s\n", "device", "allocs",
+		   "fails", "pages", "avg_us", "max_us");
+
+	mutex_lock(&cma_stats_lock);
+	list_for_each_entry(s, &cma_stats_list, list) {
+		calls = s->allocs + s->fails;
+		seq_printf(m, "%-24s %8lu %8lu %10lu %10llu %10llu\n",
+			   s->name, s->allocs, s->fails, s->pages,
+			   div_u64(div_u64(s->total_ns, NSEC_PER_USEC), calls),
+			   div_u64(s->max_ns, NSEC_PER_USEC));
+	}
+	mutex_unlock(&cma_stats_lock);
+
+	return 0;
+}
+
+static int dma_contiguous_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dma_contiguous_stats_show, NULL);
+}
+
+static const struct file_operations dma_contiguous_stats_fops = {
+	.open		= dma_contiguous_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init dma_contiguous_debugfs_init(void)
+{
+	debugfs_create_file("dma_contiguous", 0444, NULL, NULL,
+			    &dma_contiguous_stats_fops);
+}
+#else
+static inline void dma_contiguous_account(struct device *dev, size_t count,
+					  bool ok, u64 ns) { }
+static inline void dma_contiguous_debugfs_init(void) { }
+#endif
+
+static int __init dma_contiguous_late_init(void)
+{
+	dma_contiguous_debugfs_init();
+
+	if (dma_contiguous_default_area) {
+		WRITE_ONCE(cma_reserve_ready, true);
+		cma_reserve_schedule(0);
+	}
+
+	return 0;
+}
+late_initcall(dma_contiguous_late_init);
+
 /**
  * dma_alloc_from_contiguous() - allocate pages from contiguous area
  * @dev:   Pointer to device for which the allocation is performed.
@@ -192,10 +426,27 @@ int __init dma_contiguous_reserve_area(phys_addr_t size, phys_addr_t base,
 struct page *dma_alloc_from_contiguous(struct device *dev, size_t count,
 				       unsigned int align)
 {
+	struct cma *cma = dev_get_cma_area(dev);
+	bool reserve = cma == dma_contiguous_default_area &&
+		       count >= CMA_RESERVE_CHUNK;
+	ktime_t start = ktime_get();
+	struct page *page;
+
 	if (align > CONFIG_CMA_ALIGNMENT)
 		align = CONFIG_CMA_ALIGNMENT;
 
-	return cma_alloc(dev_get_cma_area(dev), count, align);
+	if (reserve)
+		cma_reserve_drain();
+
+	page = cma_alloc(cma, count, align);
+
+	dma_contiguous_account(dev, count, page,
+			       ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+	if (reserve && READ_ONCE(cma_reserve_mb))
+		cma_reserve_schedule(msecs_to_jiffies(CMA_RESERVE_REFILL_MS));
+
+	return page;
 }
 
 /**
@@ -97,6 +97,9 @@ enum {
 	FW_STATUS_ABORT,
 };
 
+#define is_fw_load_aborted(buf)	\
+	test_bit(FW_STATUS_ABORT, &(buf)->status)
+
 static int loading_timeout = 60;	/* In seconds */
 
 static inline long firmware_loading_timeout(void)
@@ -314,6 +317,18 @@ static void fw_finish_direct_load(struct device *device,
 	mutex_unlock(&fw_lock);
 }
 
+/*
+ * Somebody else may be waiting for the same image in
+ * sync_cached_firmware_buf(), do not leave them behind on failure.
+ */
+static void fw_abort_direct_load(struct firmware_buf *buf)
+{
+	mutex_lock(&fw_lock);
+	set_bit(FW_STATUS_ABORT, &buf->status);
+	complete_all(&buf->completion);
+	mutex_unlock(&fw_lock);
+}
+
 static int
 fw_get_filesystem_firmware(struct device *device, struct firmware_buf *buf)
 {
@@ -496,9 +511,6 @@ static void fw_load_abort(struct firmware_priv *fw_priv)
 	fw_priv->buf = NULL;
 }
 
-#define is_fw_load_aborted(buf)	\
-	test_bit(FW_STATUS_ABORT, &(buf)->status)
-
 static LIST_HEAD(pending_fw_head);
 
 /* reboot notifier for avoid deadlock with usermode_lock */
@@ -1016,9 +1028,6 @@ fw_load_from_user_helper(struct firmware *firmware, const char *name,
 	return -ENOENT;
 }
 
-/* No abort during direct loading */
-#define is_fw_load_aborted(buf) false
-
 #ifdef CONFIG_PM_SLEEP
 static inline void kill_requests_without_uevent(void) { }
 #endif
@@ -1185,6 +1194,8 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 
 	if (!ret)
 		ret = assign_firmware_buf(fw, device, opt_flags);
+	else
+		fw_abort_direct_load(fw->priv);
 
 	usermodehelper_read_unlock();
 
@@ -1389,6 +1400,89 @@ request_firmware_nowait(
 }
 EXPORT_SYMBOL(request_firmware_nowait);
 
+#ifdef CONFIG_FW_LOADER
+/*
+ * Boot time preloading: the images listed in firmware_class.preload are
+ * read from the initramfs in parallel before the drivers probe. A driver
+ * asking for one of them joins the load in flight or finds the image in
+ * fw_cache instead of reading the file itself. The images are held for
+ * preload_hold seconds.
+ */
+struct fw_preload {
+	struct list_head list;
+	const struct firmware *fw;
+	char name[];
+};
+
+static char fw_preload_para[256];
+module_param_string(preload, fw_preload_para, sizeof(fw_preload_para), 0444);
+MODULE_PARM_DESC(preload, "comma separated firmware images loaded at boot");
+
+static unsigned int fw_preload_hold = 60;
+module_param_named(preload_hold, fw_preload_hold, uint, 0644);
+MODULE_PARM_DESC(preload_hold, "seconds preloaded firmware stays cached");
+
+static ASYNC_DOMAIN_EXCLUSIVE(fw_preload_domain);
+static LIST_HEAD(fw_preload_list);
+
+static void fw_preload_one(void *data, async_cookie_t cookie)
+{
+	struct fw_preload *p = data;
+
+	if (_request_firmware(&p->fw, p->name, NULL, NULL, 0,
+			      FW_OPT_NOCACHE | FW_OPT_NO_WARN))
+		pr_warn("firmware: preloading %s failed\n", p->name);
+}
+
+static void fw_preload_release(struct work_struct *work)
+{
+	struct fw_preload *p, *tmp;
+
+	async_synchronize_full_domain(&fw_preload_domain);
+
+	list_for_each_entry_safe(p, tmp, &fw_preload_list, list) {
+		release_firmware(p->fw);
+		list_del(&p->list);
+		kfree(p);
+	}
+}
+
+static DECLARE_DELAYED_WORK(fw_preload_work, fw_preload_release);
+
+static int __init fw_preload_init(void)
+{
+	char *names, *cur, *name;
+	struct fw_preload *p;
+
+	if (!fw_preload_para[0])
+		return 0;
+
+	names = kstrdup(fw_preload_para, GFP_KERNEL);
+	if (!names)
+		return -ENOMEM;
+
+	cur = names;
+	while ((name = strsep(&cur, ",")) != NULL) {
+		if (!*name)
+			continue;
+
+		p = kzalloc(sizeof(*p) + strlen(name) + 1, GFP_KERNEL);
+		if (!p)
+			break;
+		strcpy(p->name, name);
+		list_add_tail(&p->list, &fw_preload_list);
+		async_schedule_domain(fw_preload_one, p, &fw_preload_domain);
+	}
+	kfree(names);
+
+	schedule_delayed_work(&fw_preload_work,
+			      msecs_to_jiffies(fw_preload_hold * MSEC_PER_SEC));
+	return 0;
+}
+/* same level as populate_rootfs(), which is linked first */
+rootfs_initcall(fw_preload_init);
+#endif
+
 #ifdef CONFIG_PM_SLEEP
 static ASYNC_DOMAIN_EXCLUSIVE(fw_cache_domain);
 
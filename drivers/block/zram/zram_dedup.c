@@ -0,0 +1,212 @@
+/*
+ * Deduplication of compressed zram pages
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ *
+ * Stored objects are hashed by a checksum of their uncompressed data
+ * into per-bucket rbtrees. A page whose checksum matches is compared
+ * against the decompressed candidate and, when identical, shares its
+ * zsmalloc object instead of being compressed and stored again.
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/crc32.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+#include "zram_dedup.h"
+
+/* one bucket per 1K pages, but no less than 1K buckets */
+#define ZRAM_HASH_SHIFT		10
+#define ZRAM_HASH_SIZE_MIN	(1 << 10)
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return crc32_le(~0, mem, PAGE_SIZE);
+}
+
+static inline struct zram_hash *zram_dedup_hash(struct zram_meta *meta,
+						u32 checksum)
+{
+	return &meta->hash[checksum % meta->hash_size];
+}
+
+void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
+				u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry;
+
+	new->checksum = checksum;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		entry = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < entry->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+
+	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_insert_color(&new->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+				unsigned char *mem)
+{
+	struct zs_pool *mem_pool = zram->meta->mem_pool;
+	struct zcomp_strm *zstrm;
+	unsigned char *cmem;
+	bool match = false;
+
+	cmem = zs_map_object(mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE) {
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		if (!zcomp_decompress(zstrm, cmem, entry->len, zstrm->buffer))
+			match = !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+		zcomp_stream_put(zram->comp);
+	}
+	zs_unmap_object(mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look up an object holding the same data as @mem and take a reference
+ * on it. The checksum is handed back so a miss can insert the new object
+ * without hashing the page again.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 *checksum)
+{
+	struct zram_hash *hash;
+	struct zram_entry *entry = NULL, *tmp;
+	struct rb_node *rb_node;
+
+	*checksum = zram_dedup_checksum(mem);
+	hash = zram_dedup_hash(zram->meta, *checksum);
+
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		tmp = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (*checksum == tmp->checksum) {
+			entry = tmp;
+			break;
+		}
+
+		if (*checksum < tmp->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+
+	if (!entry)
+		goto out;
+
+	/* walk back to the left-most entry with the same checksum */
+	while ((rb_node = rb_prev(&entry->rb_node))) {
+		tmp = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (tmp->checksum != *checksum)
+			break;
+		entry = tmp;
+	}
+
+	for (;;) {
+		if (zram_dedup_match(zram, entry, mem)) {
+			entry->refcount++;
+			atomic64_add(entry->len, &zram->stats.dup_data_size);
+			spin_unlock(&hash->lock);
+			return entry;
+		}
+
+		rb_node = rb_next(&entry->rb_node);
+		if (!rb_node)
+			break;
+
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (entry->checksum != *checksum)
+			break;
+	}
+out:
+	spin_unlock(&hash->lock);
+
+	return NULL;
+}
+
+/*
+ * Drop a reference to @entry, returns true if it was the last one and
+ * the object has to be freed by the caller.
+ */
+bool zram_dedup_put_entry(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, entry->checksum);
+	bool last;
+
+	spin_lock(&hash->lock);
+	last = !--entry->refcount;
+	if (!last)
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+	else if (!RB_EMPTY_NODE(&entry->rb_node))
+		rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	return last;
+}
+
+int zram_dedup_init(struct zram_meta *meta, size_t num_pages)
+{
+	size_t i;
+
+	meta->hash_size = max_t(size_t, ZRAM_HASH_SIZE_MIN,
+				num_pages >> ZRAM_HASH_SHIFT);
+	meta->hash = vzalloc(meta->hash_size * sizeof(struct zram_hash));
+	if (!meta->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < meta->hash_size; i++) {
+		spin_lock_init(&meta->hash[i].lock);
+		meta->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+/* Free every object still stored, each one is in the hash exactly once */
+void zram_dedup_fini(struct zram_meta *meta)
+{
+	struct zram_entry *entry, *n;
+	size_t i;
+
+	if (!meta->hash)
+		return;
+
+	for (i = 0; i < meta->hash_size; i++) {
+		rbtree_postorder_for_each_entry_safe(entry, n,
+				&meta->hash[i].rb_root, rb_node) {
+			zs_free(meta->mem_pool, entry->handle);
+			kfree(entry);
+		}
+	}
+
+	vfree(meta->hash);
+	meta->hash = NULL;
+}
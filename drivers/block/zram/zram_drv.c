@@ -19,6 +19,7 @@
 #include <linux/kernel.h>
 #include <linux/bio.h>
 #include <linux/bitops.h>
+#include <linux/cpumask.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 #include <linux/device.h>
@@ -31,14 +32,17 @@
 #include <linux/err.h>
 #include <linux/idr.h>
 #include <linux/sysfs.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
+#include "zram_dedup.h"
 
 static DEFINE_IDR(zram_index_idr);
 /* idr index must be protected */
 static DEFINE_MUTEX(zram_index_mutex);
 
 static int zram_major;
+static struct workqueue_struct *zram_async_wq;
 static const char *default_compressor = "lzo";
 
 /* Module params (documentation at end) */
@@ -166,31 +170,48 @@ static inline void update_used_max(struct zram *zram,
 	} while (old_max != cur_max);
 }
 
-static bool page_zero_filled(void *ptr)
+static inline void zram_fill_page(char *ptr, unsigned long len,
+					unsigned long value)
+{
+	unsigned long *page = (unsigned long *)ptr;
+	unsigned long i;
+
+	WARN_ON_ONCE(!IS_ALIGNED(len, sizeof(unsigned long)));
+
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+	} else {
+		for (i = 0; i < len / sizeof(*page); i++)
+			page[i] = value;
+	}
+}
+
+static bool page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (val != page[pos])
 			return false;
 	}
 
+	*element = val;
+
 	return true;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -347,6 +368,27 @@ static ssize_t comp_algorithm_show(struct device *dev,
 	return sz;
 }
 
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(zram->async_write));
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	WRITE_ONCE(zram->async_write, val);
+	return len;
+}
+
 static ssize_t comp_algorithm_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -433,14 +475,16 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
-			(u64)atomic64_read(&zram->stats.zero_pages),
-			pool_stats.pages_compacted);
+			(u64)atomic64_read(&zram->stats.same_pages),
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -472,9 +516,444 @@ ZRAM_ATTR_RO(failed_reads);
 ZRAM_ATTR_RO(failed_writes);
 ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
-ZRAM_ATTR_RO(zero_pages);
 ZRAM_ATTR_RO(compr_data_size);
 
+/* zero_pages now counts every same element filled page */
+static ssize_t zero_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	deprecated_attr_warn("zero_pages");
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+		(u64)atomic64_read(&zram->stats.same_pages));
+}
+static DEVICE_ATTR_RO(zero_pages);
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+static DEVICE_ATTR_RW(use_dedup);
+#endif
+
+/*
+ * Without deduplication an entry is nothing but the zsmalloc handle, so
+ * only the dedup case pays for the extra allocation.
+ */
+static struct zram_entry *zram_entry_alloc(struct zram *zram,
+					unsigned int len, gfp_t flags)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_entry *entry;
+	unsigned long handle;
+
+	handle = zs_malloc(meta->mem_pool, len, flags);
+	if (!handle)
+		return NULL;
+
+	if (!zram_dedup_enabled(meta))
+		return (struct zram_entry *)handle;
+
+	entry = kmalloc(sizeof(*entry),
+			flags & ~(__GFP_HIGHMEM | __GFP_MOVABLE));
+	if (!entry) {
+		zs_free(meta->mem_pool, handle);
+		return NULL;
+	}
+
+	RB_CLEAR_NODE(&entry->rb_node);
+	entry->len = len;
+	entry->checksum = 0;
+	entry->refcount = 1;
+	entry->handle = handle;
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+
+	return entry;
+}
+
+static inline unsigned long zram_entry_handle(struct zram *zram,
+					struct zram_entry *entry)
+{
+	if (zram_dedup_enabled(zram->meta))
+		return entry->handle;
+
+	return (unsigned long)entry;
+}
+
+static void zram_entry_free(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (!zram_dedup_enabled(meta)) {
+		zs_free(meta->mem_pool, (unsigned long)entry);
+		return;
+	}
+
+	if (!zram_dedup_put_entry(zram, entry))
+		return;
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static inline bool zram_wb_enabled(struct zram *zram)
+{
+	return zram->backing_dev;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	struct block_device *bdev;
+
+	if (!zram_wb_enabled(zram))
+		return;
+
+	bdev = zram->bdev;
+	if (zram->old_block_size)
+		set_blocksize(bdev, zram->old_block_size);
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	/* hope filp_close flush all of IO */
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->old_block_size = 0;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	if (!zram_wb_enabled(zram)) {
+		memcpy(buf, "none\n", 5);
+		up_read(&zram->init_lock);
+		return 5;
+	}
+
+	p = file_path(zram->backing_dev, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	size_t sz;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct address_space *mapping;
+	unsigned int old_block_size = 0;
+	unsigned long nr_pages, *bitmap = NULL;
+	struct block_device *bdev = NULL;
+	int err;
+	struct zram *zram = dev_to_zram(dev);
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR|O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	mapping = backing_dev->f_mapping;
+	inode = mapping->host;
+
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+
+	kfree(file_name);
+
+	return err;
+}
+
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	/* skip 0 bit to confuse an empty table entry */
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx == zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static void zram_page_end_io(struct bio *bio)
+{
+	struct page *page = bio->bi_io_vec[0].bv_page;
+
+	page_endio(page, op_is_write(bio_op(bio)), bio->bi_error);
+	bio_put(bio);
+}
+
+/*
+ * Submit a full page I/O to the backing device. With a parent bio the
+ * request is chained to it so the parent completes only once this one
+ * has; without one (rw_page) the page is ended from the completion.
+ */
+static int zram_bdev_rw_async(struct zram *zram, struct bio_vec *bvec,
+			      unsigned long entry, struct bio *parent,
+			      int op)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, bvec->bv_page, bvec->bv_len, bvec->bv_offset)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	if (!parent) {
+		bio_set_op_attrs(bio, op, op == REQ_OP_WRITE ? REQ_SYNC : 0);
+		bio->bi_end_io = zram_page_end_io;
+	} else {
+		bio->bi_opf = parent->bi_opf;
+		bio_chain(bio, parent);
+	}
+
+	submit_bio(bio);
+	if (op == REQ_OP_WRITE)
+		atomic64_inc(&zram->stats.bd_writes);
+	else
+		atomic64_inc(&zram->stats.bd_reads);
+	return 1;
+}
+
+static int zram_bdev_rw_sync(struct zram *zram, struct page *page,
+			     unsigned long entry, int op)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = entry * (PAGE_SIZE >> 9);
+	bio->bi_bdev = zram->bdev;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+	bio_set_op_attrs(bio, op, REQ_SYNC);
+
+	ret = submit_bio_wait(bio);
+	bio_put(bio);
+	if (op == REQ_OP_WRITE)
+		atomic64_inc(&zram->stats.bd_writes);
+	else
+		atomic64_inc(&zram->stats.bd_reads);
+	return ret;
+}
+
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long entry;
+	struct page *page;
+	int ret;
+};
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+
+	zw->ret = zram_bdev_rw_sync(zw->zram, zw->page, zw->entry,
+				    REQ_OP_READ);
+}
+
+/*
+ * Block layer want one ->make_request_fn to be active at a time so if we
+ * wait for a bio we submitted from our own make_request context it never
+ * gets dispatched. Push the synchronous read out to a worker instead.
+ */
+static int read_from_bdev_sync(struct zram *zram, char *mem,
+			       unsigned long entry)
+{
+	struct zram_work work;
+
+	work.page = alloc_page(GFP_NOIO);
+	if (!work.page)
+		return -ENOMEM;
+
+	work.zram = zram;
+	work.entry = entry;
+
+	INIT_WORK_ONSTACK(&work.work, zram_sync_read);
+	queue_work(system_unbound_wq, &work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+
+	if (!work.ret)
+		memcpy(mem, page_address(work.page), PAGE_SIZE);
+	__free_page(work.page);
+	return work.ret;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#else
+static inline bool zram_wb_enabled(struct zram *zram) { return false; }
+static inline void reset_bdev(struct zram *zram) {}
+static inline unsigned long alloc_block_bdev(struct zram *zram) { return 0; }
+static inline void free_block_bdev(struct zram *zram,
+				   unsigned long blk_idx) {}
+
+static inline int zram_bdev_rw_async(struct zram *zram, struct bio_vec *bvec,
+				     unsigned long entry, struct bio *parent,
+				     int op)
+{
+	return -EIO;
+}
+
+static inline int read_from_bdev_sync(struct zram *zram, char *mem,
+				      unsigned long entry)
+{
+	return -EIO;
+}
+#endif
+
 static inline bool zram_meta_get(struct zram *zram)
 {
 	if (atomic_inc_not_zero(&zram->refcount))
@@ -493,24 +972,30 @@ static void zram_meta_free(struct zram_meta *meta, u64 disksize)
 	size_t index;
 
 	/* Free all pages that are still in this zram device */
-	for (index = 0; index < num_pages; index++) {
-		unsigned long handle = meta->table[index].handle;
+	for (index = 0; !zram_dedup_enabled(meta) && index < num_pages;
+	     index++) {
+		struct zram_entry *entry = meta->table[index].entry;
 
-		if (!handle)
+		/* written back blocks go away with the backing device */
+		if (!entry || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		zs_free(meta->mem_pool, (unsigned long)entry);
 	}
+	/* shared entries are freed once, through the dedup hash */
+	zram_dedup_fini(meta);
 
 	zs_destroy_pool(meta->mem_pool);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(char *pool_name, u64 disksize)
+static struct zram_meta *zram_meta_alloc(char *pool_name, u64 disksize,
+					  bool use_dedup)
 {
 	size_t num_pages;
-	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
+	struct zram_meta *meta = kzalloc(sizeof(*meta), GFP_KERNEL);
 
 	if (!meta)
 		return NULL;
@@ -528,8 +1013,13 @@ static struct zram_meta *zram_meta_alloc(char *pool_name, u64 disksize)
 		goto out_error;
 	}
 
+	if (use_dedup && zram_dedup_init(meta, num_pages))
+		goto out_destroy_pool;
+
 	return meta;
 
+out_destroy_pool:
+	zs_destroy_pool(meta->mem_pool);
 out_error:
 	vfree(meta->table);
 	kfree(meta);
@@ -544,27 +1034,40 @@ out_error:
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	struct zram_entry *entry = meta->table[index].entry;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
-			atomic64_dec(&zram->stats.zero_pages);
-		}
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, meta->table[index].element);
+		atomic64_dec(&zram->stats.pages_stored);
+		meta->table[index].element = 0;
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = 0;
+		atomic64_dec(&zram->stats.same_pages);
+		return;
+	}
+
+	if (unlikely(!entry))
+		return;
+
+	zram_entry_free(zram, entry);
 
 	atomic64_sub(zram_get_obj_size(meta, index),
 			&zram->stats.compr_data_size);
 	atomic64_dec(&zram->stats.pages_stored);
 
-	meta->table[index].handle = 0;
+	meta->table[index].entry = NULL;
 	zram_set_obj_size(meta, index, 0);
 }
 
@@ -573,19 +1076,30 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
+	struct zram_entry *entry;
 	unsigned long handle;
 	unsigned int size;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	handle = meta->table[index].handle;
+	entry = meta->table[index].entry;
 	size = zram_get_obj_size(meta, index);
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].element;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return read_from_bdev_sync(zram, mem, blk_idx);
+	}
+
+	if (!entry || zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].element;
+
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		memset(mem, 0, PAGE_SIZE);
+		zram_fill_page(mem, PAGE_SIZE, element);
 		return 0;
 	}
 
+	handle = zram_entry_handle(zram, entry);
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE) {
 		memcpy(mem, cmem, PAGE_SIZE);
@@ -608,7 +1122,7 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 }
 
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
-			  u32 index, int offset)
+			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
 	struct page *page;
@@ -617,10 +1131,21 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	page = bvec->bv_page;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_WB) && !is_partial_io(bvec)) {
+		unsigned long blk_idx = meta->table[index].element;
+
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		return zram_bdev_rw_async(zram, bvec, blk_idx, bio,
+					  REQ_OP_READ);
+	}
+
+	if (unlikely(!meta->table[index].entry) ||
+			zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].element;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		handle_same_page(bvec, element);
 		return 0;
 	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
@@ -657,17 +1182,52 @@ out_cleanup:
 	return ret;
 }
 
+/*
+ * Store an incompressible page on the backing device and keep only its
+ * block index. Returns 1 once the write is submitted, it completes along
+ * with @bio (or ends the page itself when there is no parent bio).
+ */
+static int zram_write_to_bdev(struct zram *zram, struct bio_vec *bvec,
+			      u32 index, struct bio *bio)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	int ret;
+
+	blk_idx = alloc_block_bdev(zram);
+	if (!blk_idx)
+		return -ENOSPC;
+
+	ret = zram_bdev_rw_async(zram, bvec, blk_idx, bio, REQ_OP_WRITE);
+	if (ret != 1) {
+		free_block_bdev(zram, blk_idx);
+		return ret;
+	}
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_free_page(zram, index);
+	zram_set_flag(meta, index, ZRAM_WB);
+	meta->table[index].element = blk_idx;
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	atomic64_inc(&zram->stats.pages_stored);
+	return 1;
+}
+
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
-			   int offset)
+			   int offset, struct bio *bio)
 {
 	int ret = 0;
 	unsigned int clen;
-	unsigned long handle = 0;
+	struct zram_entry *entry = NULL;
+	unsigned long handle, element;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
 	struct zcomp_strm *zstrm = NULL;
 	unsigned long alloced_pages;
+	bool allow_wb = true;
+	u32 checksum = 0;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -696,20 +1256,32 @@ compress_again:
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (user_mem)
 			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		atomic64_inc(&zram->stats.same_pages);
 		ret = 0;
 		goto out;
 	}
 
+	/* a handle from the slow path means the lookup already missed */
+	if (zram_dedup_enabled(meta) && !entry) {
+		entry = zram_dedup_find(zram, uncmem, &checksum);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			clen = entry->len;
+			goto found_dup;
+		}
+	}
+
 	zstrm = zcomp_stream_get(zram->comp);
 	ret = zcomp_compress(zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
@@ -725,6 +1297,17 @@ compress_again:
 
 	src = zstrm->buffer;
 	if (unlikely(clen > max_zpage_size)) {
+		if (zram_wb_enabled(zram) && allow_wb && !entry &&
+		    !is_partial_io(bvec)) {
+			zcomp_stream_put(zram->comp);
+			zstrm = NULL;
+			ret = zram_write_to_bdev(zram, bvec, index, bio);
+			if (ret == 1)
+				goto out;
+			/* backing device is full, keep the page in memory */
+			allow_wb = false;
+			goto compress_again;
+		}
 		clen = PAGE_SIZE;
 		if (is_partial_io(bvec))
 			src = uncmem;
@@ -743,22 +1326,22 @@ compress_again:
 	 * if we have a 'non-null' handle here then we are coming
 	 * from the slow path and handle has already been allocated.
 	 */
-	if (!handle)
-		handle = zs_malloc(meta->mem_pool, clen,
+	if (!entry)
+		entry = zram_entry_alloc(zram, clen,
 				__GFP_KSWAPD_RECLAIM |
 				__GFP_NOWARN |
 				__GFP_HIGHMEM |
 				__GFP_MOVABLE);
-	if (!handle) {
+	if (!entry) {
 		zcomp_stream_put(zram->comp);
 		zstrm = NULL;
 
 		atomic64_inc(&zram->stats.writestall);
 
-		handle = zs_malloc(meta->mem_pool, clen,
+		entry = zram_entry_alloc(zram, clen,
 				GFP_NOIO | __GFP_HIGHMEM |
 				__GFP_MOVABLE);
-		if (handle)
+		if (entry)
 			goto compress_again;
 
 		pr_err("Error allocating memory for compressed page: %u, size=%u\n",
@@ -771,11 +1354,12 @@ compress_again:
 	update_used_max(zram, alloced_pages);
 
 	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
-		zs_free(meta->mem_pool, handle);
+		zram_entry_free(zram, entry);
 		ret = -ENOMEM;
 		goto out;
 	}
 
+	handle = zram_entry_handle(zram, entry);
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
 
 	if ((clen == PAGE_SIZE) && !is_partial_io(bvec)) {
@@ -790,6 +1374,10 @@ compress_again:
 	zstrm = NULL;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (zram_dedup_enabled(meta))
+		zram_dedup_insert(zram, entry, checksum);
+
+found_dup:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -797,8 +1385,10 @@ compress_again:
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 	zram_free_page(zram, index);
 
-	meta->table[index].handle = handle;
+	meta->table[index].entry = entry;
 	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
@@ -812,6 +1402,142 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	struct zram_meta *meta;
+	unsigned long index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	for (index = 0; index < nr_pages; index++) {
+		/* only pages held in zsmalloc are worth writing back */
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (meta->table[index].entry &&
+		    !zram_test_flag(meta, index, ZRAM_SAME) &&
+		    !zram_test_flag(meta, index, ZRAM_WB) &&
+		    !zram_test_flag(meta, index, ZRAM_UNDER_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Write back idle (or incompressible) pages to the backing device. The
+ * data is copied out of zsmalloc without the slot lock held, so any access
+ * in the meantime clears ZRAM_IDLE and the written block is dropped again.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index, blk_idx = 0;
+	struct zram_meta *meta;
+	struct page *page;
+	ssize_t ret;
+	int flag;
+
+	if (sysfs_streq(buf, "idle"))
+		flag = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		flag = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram_wb_enabled(zram)) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	meta = zram->meta;
+	ret = len;
+	for (index = 0; index < nr_pages; index++) {
+		if (!blk_idx) {
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!meta->table[index].entry ||
+		    zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB) ||
+		    zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+		    !zram_test_flag(meta, index, flag)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		/* huge pages are tracked for access through ZRAM_IDLE too */
+		zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		if (zram_decompress_page(zram, page_address(page), index) ||
+		    zram_bdev_rw_sync(zram, page, blk_idx, REQ_OP_WRITE)) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			zram_clear_flag(meta, index, ZRAM_IDLE);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+		/* accessed or freed meanwhile, reuse the block for the next */
+		if (!zram_test_flag(meta, index, ZRAM_IDLE)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].element = blk_idx;
+		blk_idx = 0;
+		atomic64_inc(&zram->stats.pages_stored);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+
+	if (blk_idx)
+		free_block_bdev(zram, blk_idx);
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -852,7 +1578,7 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 }
 
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
-			int offset, bool is_write)
+			int offset, bool is_write, struct bio *bio)
 {
 	unsigned long start_time = jiffies;
 	int rw_acct = is_write ? REQ_OP_WRITE : REQ_OP_READ;
@@ -863,15 +1589,15 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	if (!is_write) {
 		atomic64_inc(&zram->stats.num_reads);
-		ret = zram_bvec_read(zram, bvec, index, offset);
+		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 	} else {
 		atomic64_inc(&zram->stats.num_writes);
-		ret = zram_bvec_write(zram, bvec, index, offset);
+		ret = zram_bvec_write(zram, bvec, index, offset, bio);
 	}
 
 	generic_end_io_acct(rw_acct, &zram->disk->part0, start_time);
 
-	if (unlikely(ret)) {
+	if (unlikely(ret < 0)) {
 		if (!is_write)
 			atomic64_inc(&zram->stats.failed_reads);
 		else
@@ -881,6 +1607,120 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+/*
+ * Asynchronous writes: the pages of a write bio are split in runs, one per
+ * online CPU, and compressed by per-CPU workers so a large writeback from
+ * kswapd uses every compression stream instead of only the local one. The
+ * bio completes once the last run is stored.
+ */
+struct zram_async_work {
+	struct work_struct work;
+	struct zram_async_batch *batch;
+	unsigned int start;
+	unsigned int end;
+};
+
+struct zram_async_batch {
+	struct zram *zram;
+	struct bio *bio;
+	u32 index;
+	atomic_t pending;
+	int error;
+	struct bio_vec *bvec;
+	struct zram_async_work works[];
+};
+
+static void zram_async_write_work(struct work_struct *work)
+{
+	struct zram_async_work *aw = container_of(work, typeof(*aw), work);
+	struct zram_async_batch *batch = aw->batch;
+	struct zram *zram = batch->zram;
+	struct bio *bio = batch->bio;
+	unsigned int i;
+
+	for (i = aw->start; i < aw->end; i++) {
+		if (zram_bvec_rw(zram, &batch->bvec[i], batch->index + i, 0,
+				 true, bio) < 0)
+			batch->error = -EIO;
+	}
+
+	if (!atomic_dec_and_test(&batch->pending))
+		return;
+
+	zram_meta_put(zram);
+	if (batch->error)
+		bio_io_error(bio);
+	else
+		bio_endio(bio);
+	kfree(batch);
+}
+
+/*
+ * Hand a write bio made of whole pages over to the workers. Returns false
+ * when the bio has to be handled synchronously by the caller.
+ */
+static bool zram_async_write(struct zram *zram, struct bio *bio, u32 index,
+			     int offset)
+{
+	unsigned int nr_pages, nr_works, i = 0;
+	struct zram_async_batch *batch;
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+	int cpu;
+
+	if (!READ_ONCE(zram->async_write) || offset ||
+	    !IS_ALIGNED(bio->bi_iter.bi_size, PAGE_SIZE))
+		return false;
+
+	nr_pages = bio->bi_iter.bi_size >> PAGE_SHIFT;
+	nr_works = min(nr_pages, num_online_cpus());
+	if (nr_works < 2)
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_offset || bvec.bv_len != PAGE_SIZE)
+			return false;
+	}
+
+	/* under reclaim, fall back to the synchronous path rather than wait */
+	batch = kmalloc(sizeof(*batch) +
+			nr_works * sizeof(struct zram_async_work) +
+			nr_pages * sizeof(struct bio_vec),
+			GFP_NOIO | __GFP_NOWARN);
+	if (!batch)
+		return false;
+
+	batch->zram = zram;
+	batch->bio = bio;
+	batch->index = index;
+	batch->error = 0;
+	batch->bvec = (struct bio_vec *)&batch->works[nr_works];
+	atomic_set(&batch->pending, nr_works);
+
+	bio_for_each_segment(bvec, bio, iter)
+		batch->bvec[i++] = bvec;
+
+	/* the caller's reference is dropped as soon as we return */
+	atomic_inc(&zram->refcount);
+
+	cpu = raw_smp_processor_id();
+	for (i = 0; i < nr_works; i++) {
+		struct zram_async_work *aw = &batch->works[i];
+
+		aw->batch = batch;
+		aw->start = i * nr_pages / nr_works;
+		aw->end = (i + 1) * nr_pages / nr_works;
+		INIT_WORK(&aw->work, zram_async_write_work);
+		queue_work_on(cpu, zram_async_wq, &aw->work);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	return true;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset;
@@ -898,6 +1738,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		return;
 	}
 
+	if (op_is_write(bio_op(bio)) &&
+	    zram_async_write(zram, bio, index, offset))
+		return;
+
 	bio_for_each_segment(bvec, bio, iter) {
 		int max_transfer_size = PAGE_SIZE - offset;
 
@@ -913,17 +1757,17 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			bv.bv_offset = bvec.bv_offset;
 
 			if (zram_bvec_rw(zram, &bv, index, offset,
-					 op_is_write(bio_op(bio))) < 0)
+					 op_is_write(bio_op(bio)), bio) < 0)
 				goto out;
 
 			bv.bv_len = bvec.bv_len - max_transfer_size;
 			bv.bv_offset += max_transfer_size;
 			if (zram_bvec_rw(zram, &bv, index + 1, 0,
-					 op_is_write(bio_op(bio))) < 0)
+					 op_is_write(bio_op(bio)), bio) < 0)
 				goto out;
 		} else
 			if (zram_bvec_rw(zram, &bvec, index, offset,
-					 op_is_write(bio_op(bio))) < 0)
+					 op_is_write(bio_op(bio)), bio) < 0)
 				goto out;
 
 		update_position(&index, &offset, &bvec);
@@ -1004,7 +1848,7 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	bv.bv_len = PAGE_SIZE;
 	bv.bv_offset = 0;
 
-	err = zram_bvec_rw(zram, &bv, index, offset, is_write);
+	err = zram_bvec_rw(zram, &bv, index, offset, is_write, NULL);
 put_zram:
 	zram_meta_put(zram);
 out:
@@ -1016,8 +1860,15 @@ out:
 	 * bio->bi_end_io does things to handle the error
 	 * (e.g., SetPageError, set_page_dirty and extra works).
 	 */
-	if (err == 0)
+	switch (err) {
+	case 0:
 		page_endio(page, is_write, 0);
+		break;
+	case 1:
+		/* the backing device ends the page on completion */
+		err = 0;
+		break;
+	}
 	return err;
 }
 
@@ -1057,6 +1908,7 @@ static void zram_reset_device(struct zram *zram)
 
 	set_capacity(zram->disk, 0);
 	part_stat_set_all(&zram->disk->part0, 0);
+	reset_bdev(zram);
 
 	up_write(&zram->init_lock);
 	/* I/O operation under all of CPU are done so let's free */
@@ -1078,7 +1930,8 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(zram->disk->disk_name, disksize);
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize,
+			       zram->use_dedup);
 	if (!meta)
 		return -ENOMEM;
 
@@ -1193,6 +2046,13 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(async_write);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(writeback);
+static DEVICE_ATTR_RO(bd_stat);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -1213,6 +2073,16 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_async_write.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
 	&dev_attr_debug_stat.attr,
@@ -1452,9 +2322,15 @@ static int __init zram_init(void)
 {
 	int ret;
 
+	zram_async_wq = alloc_workqueue("zram_async",
+					WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!zram_async_wq)
+		return -ENOMEM;
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
+		destroy_workqueue(zram_async_wq);
 		return ret;
 	}
 
@@ -1462,6 +2338,7 @@ static int __init zram_init(void)
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
+		destroy_workqueue(zram_async_wq);
 		return -EBUSY;
 	}
 
@@ -1478,12 +2355,14 @@ static int __init zram_init(void)
 
 out_error:
 	destroy_devices();
+	destroy_workqueue(zram_async_wq);
 	return ret;
 }
 
 static void __exit zram_exit(void)
 {
 	destroy_devices();
+	destroy_workqueue(zram_async_wq);
 }
 
 module_init(zram_init);
@@ -89,7 +89,7 @@ struct clk_hw *clk_hw_register_fixed_factor(struct device *dev,
 
 	init.name = name;
 	init.ops = &clk_fixed_factor_ops;
-	init.flags = flags | CLK_IS_BASIC;
+	init.flags = flags | CLK_IS_BASIC | CLK_FIXED_RATIO;
 	init.parent_names = &parent_name;
 	init.num_parents = 1;
 
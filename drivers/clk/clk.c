@@ -58,6 +58,8 @@ struct clk_core {
 	struct clk_core		*new_child;
 	unsigned long		flags;
 	bool			orphan;
+	/* rate never changes, clk_get_rate() can skip the prepare lock */
+	bool			rate_fixed;
 	unsigned int		enable_count;
 	unsigned int		prepare_count;
 	unsigned long		min_rate;
@@ -577,10 +579,19 @@ static int clk_core_prepare_lock(struct clk_core *core)
  */
 int clk_prepare(struct clk *clk)
 {
+	bool trace = trace_clk_prepare_latency_enabled();
+	u64 start = trace ? local_clock() : 0;
+	int ret;
+
 	if (!clk)
 		return 0;
 
-	return clk_core_prepare_lock(clk->core);
+	ret = clk_core_prepare_lock(clk->core);
+
+	if (trace)
+		trace_clk_prepare_latency(clk->core, local_clock() - start);
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(clk_prepare);
 
@@ -702,10 +713,19 @@ static int clk_core_enable_lock(struct clk_core *core)
  */
 int clk_enable(struct clk *clk)
 {
+	bool trace = trace_clk_enable_latency_enabled();
+	u64 start = trace ? local_clock() : 0;
+	int ret;
+
 	if (!clk)
 		return 0;
 
-	return clk_core_enable_lock(clk->core);
+	ret = clk_core_enable_lock(clk->core);
+
+	if (trace)
+		trace_clk_enable_latency(clk->core, local_clock() - start);
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(clk_enable);
 
@@ -1083,6 +1103,12 @@ static unsigned long clk_core_get_rate(struct clk_core *core)
 {
 	unsigned long rate;
 
+	/* nothing to serialize against */
+	if (core && READ_ONCE(core->rate_fixed)) {
+		smp_rmb(); /* Pairs with clk_core_update_rate_fixed */
+		return READ_ONCE(core->rate);
+	}
+
 	clk_prepare_lock();
 
 	if (core && (core->flags & CLK_GET_RATE_NOCACHE))
@@ -1101,6 +1127,7 @@ static unsigned long clk_core_get_rate(struct clk_core *core)
  * Simply returns the cached rate of the clk, unless CLK_GET_RATE_NOCACHE flag
  * is set, which means a recalc_rate will be issued.
  * If clk is NULL then returns 0.
+ * Does not take the prepare lock if the rate of the clk can never change.
  */
 unsigned long clk_get_rate(struct clk *clk)
 {
@@ -1134,11 +1161,51 @@ static void clk_core_update_orphan_status(struct clk_core *core, bool is_orphan)
 	struct clk_core *child;
 
 	core->orphan = is_orphan;
+	/* back under the lock before the rate goes to 0 */
+	if (is_orphan)
+		WRITE_ONCE(core->rate_fixed, false);
 
 	hlist_for_each_entry(child, &core->children, child_node)
 		clk_core_update_orphan_status(child, is_orphan);
 }
 
+/*
+ * The rate of @core can never change if it is a fixed function of the rate
+ * of its parent, and that one can never change either.  Rates are cached,
+ * so a clk without .recalc_rate and without .set_parent simply passes on
+ * its parent's.
+ */
+static bool clk_core_rate_is_fixed(struct clk_core *core)
+{
+	if (core->orphan || core->flags & CLK_GET_RATE_NOCACHE)
+		return false;
+
+	if (core->ops->set_parent)
+		return false;
+
+	if (core->ops->recalc_rate && !(core->flags & CLK_FIXED_RATIO))
+		return false;
+
+	return !core->parent || core->parent->rate_fixed;
+}
+
+/*
+ * Update whether @core and its children can have their rate read locklessly.
+ * Must be called with the rates up to date.
+ */
+static void clk_core_update_rate_fixed(struct clk_core *core)
+{
+	struct clk_core *child;
+	bool fixed = clk_core_rate_is_fixed(core);
+
+	if (fixed)
+		smp_wmb(); /* Pairs with smp_rmb in clk_core_get_rate */
+	WRITE_ONCE(core->rate_fixed, fixed);
+
+	hlist_for_each_entry(child, &core->children, child_node)
+		clk_core_update_rate_fixed(child);
+}
+
 static void clk_reparent(struct clk_core *core, struct clk_core *new_parent)
 {
 	bool was_orphan = core->orphan;
@@ -1619,6 +1686,8 @@ static int clk_core_set_rate_nolock(struct clk_core *core,
  */
 int clk_set_rate(struct clk *clk, unsigned long rate)
 {
+	bool trace = trace_clk_set_rate_latency_enabled();
+	u64 start = trace ? local_clock() : 0;
 	int ret;
 
 	if (!clk)
@@ -1631,6 +1700,9 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 
 	clk_prepare_unlock();
 
+	if (trace)
+		trace_clk_set_rate_latency(clk->core, local_clock() - start);
+
 	return ret;
 }
 EXPORT_SYMBOL_GPL(clk_set_rate);
@@ -2436,6 +2508,7 @@ static int __clk_core_init(struct clk_core *core)
 	else
 		rate = 0;
 	core->rate = core->req_rate = rate;
+	clk_core_update_rate_fixed(core);
 
 	/*
 	 * walk the list of orphan clocks and reparent any that newly finds a
@@ -2453,6 +2526,7 @@ static int __clk_core_init(struct clk_core *core)
 			__clk_set_parent_after(orphan, parent, NULL);
 			__clk_recalc_accuracies(orphan);
 			__clk_recalc_rates(orphan, 0);
+			clk_core_update_rate_fixed(orphan);
 		}
 	}
 
@@ -33,6 +33,7 @@
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <soc/imx/timer.h>
+#include <asm/vdso.h>
 
 /*
  * There are 4 versions of the timer hardware on Freescale MXC hardware.
@@ -74,11 +75,15 @@
 #define V2_TCMP			0x10
 
 #define V2_TIMER_RATE_OSC_DIV8	3000000
+#define V2_TIMER_RATE_OSC	24000000
 
 struct imx_timer {
 	enum imx_gpt_type type;
 	void __iomem *base;
+	phys_addr_t pbase;
 	int irq;
+	/* counter rate, clk_per unless the 24M prescaler is bypassed */
+	unsigned long rate;
 	struct clk *clk_per;
 	struct clk *clk_ipg;
 	const struct imx_gpt_data *gpt;
@@ -164,9 +169,22 @@ static unsigned long imx_read_current_timer(void)
 	return readl_relaxed(sched_clock_reg);
 }
 
+static cycle_t mxc_clocksource_read(struct clocksource *cs)
+{
+	return readl_relaxed(sched_clock_reg);
+}
+
+static struct clocksource mxc_clocksource = {
+	.name	= "mxc_timer1",
+	.rating	= 200,
+	.read	= mxc_clocksource_read,
+	.mask	= CLOCKSOURCE_MASK(32),
+	.flags	= CLOCK_SOURCE_IS_CONTINUOUS,
+};
+
 static int __init mxc_clocksource_init(struct imx_timer *imxtm)
 {
-	unsigned int c = clk_get_rate(imxtm->clk_per);
+	unsigned int c = imxtm->rate;
 	void __iomem *reg = imxtm->base + imxtm->gpt->reg_tcn;
 
 	imx_delay_timer.read_current_timer = &imx_read_current_timer;
@@ -176,8 +194,17 @@ static int __init mxc_clocksource_init(struct imx_timer *imxtm)
 	sched_clock_reg = reg;
 
 	sched_clock_register(mxc_read_sched_clock, 32, c);
-	return clocksource_mmio_init(reg, "mxc_timer1", c, 200, 32,
-			clocksource_mmio_readl_up);
+
+	/*
+	 * Nothing in the GPT page has read side effects, so it can be handed
+	 * to user space for clock_gettime() without a syscall on parts where
+	 * the arch timer is absent or not readable from there.
+	 */
+	if (imxtm->pbase)
+		arm_vdso_set_mmio_counter(&mxc_clocksource,
+					  imxtm->pbase + imxtm->gpt->reg_tcn);
+
+	return clocksource_register_hz(&mxc_clocksource, c);
 }
 
 /* clock event */
@@ -313,8 +340,7 @@ static int __init mxc_clockevent_init(struct imx_timer *imxtm)
 	ced->rating = 200;
 	ced->cpumask = cpumask_of(0);
 	ced->irq = imxtm->irq;
-	clockevents_config_and_register(ced, clk_get_rate(imxtm->clk_per),
-					0xff, 0xfffffffe);
+	clockevents_config_and_register(ced, imxtm->rate, 0xff, 0xfffffffe);
 
 	act->name = "i.MX Timer Tick";
 	act->flags = IRQF_TIMER | IRQF_IRQPOLL;
@@ -353,9 +379,13 @@ static void imx6dl_gpt_setup_tctl(struct imx_timer *imxtm)
 	tctl_val = V2_TCTL_FRR | V2_TCTL_WAITEN | MXC_TCTL_TEN;
 	if (clk_get_rate(imxtm->clk_per) == V2_TIMER_RATE_OSC_DIV8) {
 		tctl_val |= V2_TCTL_CLK_OSC_DIV8;
-		/* 24 / 8 = 3 MHz */
-		writel_relaxed(7 << V2_TPRER_PRE24M, imxtm->base + MXC_TPRER);
+		/*
+		 * Count the crystal undivided: 24 MHz is as stable as 3 MHz,
+		 * it is not scaled with the buses, and gives 42ns resolution.
+		 */
+		writel_relaxed(0, imxtm->base + MXC_TPRER);
 		tctl_val |= V2_TCTL_24MEN;
+		imxtm->rate = V2_TIMER_RATE_OSC;
 	} else {
 		tctl_val |= V2_TCTL_CLK_PER;
 	}
@@ -437,6 +467,7 @@ static int __init _mxc_timer_init(struct imx_timer *imxtm)
 		clk_prepare_enable(imxtm->clk_ipg);
 
 	clk_prepare_enable(imxtm->clk_per);
+	imxtm->rate = clk_get_rate(imxtm->clk_per);
 
 	/*
 	 * Initialise to a known state (all timers off, and timing reset)
@@ -467,6 +498,7 @@ void __init mxc_timer_init(unsigned long pbase, int irq, enum imx_gpt_type type)
 
 	imxtm->base = ioremap(pbase, SZ_4K);
 	BUG_ON(!imxtm->base);
+	imxtm->pbase = pbase;
 
 	imxtm->type = type;
 	imxtm->irq = irq;
@@ -478,6 +510,7 @@ static int __init mxc_timer_init_dt(struct device_node *np,  enum imx_gpt_type t
 {
 	struct imx_timer *imxtm;
 	static int initialized;
+	struct resource res;
 	int ret;
 
 	/* Support one instance only */
@@ -492,6 +525,9 @@ static int __init mxc_timer_init_dt(struct device_node *np,  enum imx_gpt_type t
 	if (!imxtm->base)
 		return -ENXIO;
 
+	if (!of_address_to_resource(np, 0, &res))
+		imxtm->pbase = res.start;
+
 	imxtm->irq = irq_of_parse_and_map(np, 0);
 	if (imxtm->irq <= 0)
 		return -EINVAL;
@@ -12,6 +12,7 @@
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
 #include <linux/err.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/of.h>
@@ -54,19 +55,71 @@ static struct cpufreq_frequency_table *freq_table;
 static unsigned int transition_latency;
 static struct mutex set_cpufreq_lock;
 static u32 *imx6_soc_volt;
+static u32 *imx6_arm_volt;
 static u32 soc_opp_count;
+/* last voltages programmed, so unchanged rails can be skipped */
+static unsigned long arm_volt_cur;
+static u32 soc_volt_cur;
 static bool ignore_dc_reg;
 static bool low_power_run_support;
 
+static int imx6q_set_soc_volt(u32 volt)
+{
+	int ret;
+
+	if (volt == soc_volt_cur)
+		return 0;
+
+	if (!IS_ERR(pu_reg)) {
+		ret = regulator_set_voltage_tol(pu_reg, volt, 0);
+		if (ret) {
+			dev_err(cpu_dev, "failed to scale vddpu: %d\n", ret);
+			return ret;
+		}
+	}
+	ret = regulator_set_voltage_tol(soc_reg, volt, 0);
+	if (ret) {
+		dev_err(cpu_dev, "failed to scale vddsoc: %d\n", ret);
+		return ret;
+	}
+
+	soc_volt_cur = volt;
+	if (soc_reg == arm_reg)
+		arm_volt_cur = volt;
+	if (soc_reg == arm_reg)
+		soc_volt_cur = volt;
+	return 0;
+}
+
+static int imx6q_set_arm_volt(unsigned long volt)
+{
+	int ret;
+
+	if (volt == arm_volt_cur)
+		return 0;
+
+	ret = regulator_set_voltage_tol(arm_reg, volt, 0);
+	if (ret) {
+		dev_err(cpu_dev, "failed to scale vddarm: %d\n", ret);
+		return ret;
+	}
+
+	arm_volt_cur = volt;
+	return 0;
+}
+
 static int imx6q_set_target(struct cpufreq_policy *policy, unsigned int index)
 {
-	struct dev_pm_opp *opp;
 	unsigned long freq_hz, volt, volt_old;
 	unsigned int old_freq, new_freq;
+	ktime_t start;
+	u32 latency;
 	int ret;
 
 	mutex_lock(&set_cpufreq_lock);
 
+	start = ktime_get();
+
 	new_freq = freq_table[index].frequency;
 	freq_hz = new_freq * 1000;
 	old_freq = policy->cur;
@@ -82,18 +135,8 @@ static int imx6q_set_target(struct cpufreq_policy *policy, unsigned int index)
 		return 0;
 	};
 
-	rcu_read_lock();
-	opp = dev_pm_opp_find_freq_ceil(cpu_dev, &freq_hz);
-	if (IS_ERR(opp)) {
-		rcu_read_unlock();
-		dev_err(cpu_dev, "failed to find OPP for %ld\n", freq_hz);
-		mutex_unlock(&set_cpufreq_lock);
-		return PTR_ERR(opp);
-	}
-
-	volt = dev_pm_opp_get_voltage(opp);
-	rcu_read_unlock();
-	volt_old = regulator_get_voltage(arm_reg);
+	volt = imx6_arm_volt[index];
+	volt_old = arm_volt_cur;
 
 	dev_dbg(cpu_dev, "%u MHz, %ld mV --> %u MHz, %ld mV\n",
 		old_freq / 1000, volt_old / 1000,
@@ -111,24 +154,10 @@ static int imx6q_set_target(struct cpufreq_policy *policy, unsigned int index)
 
 	/* scaling up?  scale voltage before frequency */
 	if (new_freq > old_freq) {
-		if (!IS_ERR(pu_reg)) {
-			ret = regulator_set_voltage_tol(pu_reg, imx6_soc_volt[index], 0);
-			if (ret) {
-				dev_err(cpu_dev, "failed to scale vddpu up: %d\n", ret);
-				mutex_unlock(&set_cpufreq_lock);
-				return ret;
-			}
-		}
-		ret = regulator_set_voltage_tol(soc_reg, imx6_soc_volt[index], 0);
+		ret = imx6q_set_soc_volt(imx6_soc_volt[index]);
+		if (!ret)
+			ret = imx6q_set_arm_volt(volt);
 		if (ret) {
-			dev_err(cpu_dev, "failed to scale vddsoc up: %d\n", ret);
-			mutex_unlock(&set_cpufreq_lock);
-			return ret;
-		}
-		ret = regulator_set_voltage_tol(arm_reg, volt, 0);
-		if (ret) {
-			dev_err(cpu_dev,
-				"failed to scale vddarm up: %d\n", ret);
 			mutex_unlock(&set_cpufreq_lock);
 			return ret;
 		}
@@ -191,31 +220,15 @@ static int imx6q_set_target(struct cpufreq_policy *policy, unsigned int index)
 	ret = clk_set_rate(arm_clk, new_freq * 1000);
 	if (ret) {
 		dev_err(cpu_dev, "failed to set clock rate: %d\n", ret);
-		regulator_set_voltage_tol(arm_reg, volt_old, 0);
+		imx6q_set_arm_volt(volt_old);
 		mutex_unlock(&set_cpufreq_lock);
 		return ret;
 	}
 
-	/* scaling down?  scale voltage after frequency */
+	/* scaling down?  scale voltage after frequency, failure is harmless */
 	if (new_freq < old_freq) {
-		ret = regulator_set_voltage_tol(arm_reg, volt, 0);
-		if (ret) {
-			dev_warn(cpu_dev,
-				 "failed to scale vddarm down: %d\n", ret);
-			ret = 0;
-		}
-		ret = regulator_set_voltage_tol(soc_reg, imx6_soc_volt[index], 0);
-		if (ret) {
-			dev_warn(cpu_dev, "failed to scale vddsoc down: %d\n", ret);
-			ret = 0;
-		}
-		if (!IS_ERR(pu_reg)) {
-			ret = regulator_set_voltage_tol(pu_reg, imx6_soc_volt[index], 0);
-			if (ret) {
-				dev_warn(cpu_dev, "failed to scale vddpu down: %d\n", ret);
-				ret = 0;
-			}
-		}
+		imx6q_set_arm_volt(volt);
+		imx6q_set_soc_volt(imx6_soc_volt[index]);
 	}
 	/*
 	 * If CPU is dropped to the lowest level, release the need
@@ -228,6 +241,18 @@ static int imx6q_set_target(struct cpufreq_policy *policy, unsigned int index)
 		release_bus_freq(BUS_FREQ_HIGH);
 	}
 
+	/*
+	 * Keep the advertised latency in line with what transitions really
+	 * cost, governors derive their rate limits from it.
+	 */
+	latency = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (policy->cpuinfo.transition_latency != CPUFREQ_ETERNAL &&
+	    latency > policy->cpuinfo.transition_latency) {
+		dev_dbg(cpu_dev, "transition latency raised to %u ns\n",
+			latency);
+		policy->cpuinfo.transition_latency = latency;
+	}
+
 	mutex_unlock(&set_cpufreq_lock);
 	return 0;
 }
@@ -438,6 +463,28 @@ static int imx6q_cpufreq_probe(struct platform_device *pdev)
 		goto free_freq_table;
 	}
 
+	/* Look the arm voltage of each setpoint up once, not per transition */
+	imx6_arm_volt = kcalloc(num, sizeof(*imx6_arm_volt), GFP_KERNEL);
+	if (!imx6_arm_volt) {
+		ret = -ENOMEM;
+		goto free_freq_table;
+	}
+
+	rcu_read_lock();
+	for (j = 0; j < num; j++) {
+		opp = dev_pm_opp_find_freq_exact(cpu_dev,
+				freq_table[j].frequency * 1000, true);
+		if (IS_ERR(opp)) {
+			rcu_read_unlock();
+			dev_err(cpu_dev, "failed to find OPP for %u kHz\n",
+				freq_table[j].frequency);
+			ret = PTR_ERR(opp);
+			goto free_freq_table;
+		}
+		imx6_arm_volt[j] = dev_pm_opp_get_voltage(opp);
+	}
+	rcu_read_unlock();
+
 	prop = of_find_property(np, "fsl,soc-operating-points", NULL);
 	if (!prop || !prop->value)
 		goto soc_opp_out;
@@ -485,20 +532,30 @@ soc_opp_out:
 			imx6_soc_volt[num - 1] = PU_SOC_VOLTAGE_HIGH;
 	}
 
+	arm_volt_cur = regulator_get_voltage(arm_reg);
+	soc_volt_cur = regulator_get_voltage(soc_reg);
+
 	if (of_property_read_u32(np, "clock-latency", &transition_latency))
 		transition_latency = CPUFREQ_ETERNAL;
 
 	/*
 	 * Calculate the ramp time for max voltage change in the
-	 * VDDSOC and VDDPU regulators.
+	 * VDDSOC and VDDPU regulators. They are only touched when the
+	 * soc setpoint differs, and not at all when soc shares the arm rail.
 	 */
-	ret = regulator_set_voltage_time(soc_reg, imx6_soc_volt[0], imx6_soc_volt[num - 1]);
-	if (ret > 0)
-		transition_latency += ret * 1000;
-	if (!IS_ERR(pu_reg)) {
-		ret = regulator_set_voltage_time(pu_reg, imx6_soc_volt[0], imx6_soc_volt[num - 1]);
+	if (transition_latency != CPUFREQ_ETERNAL && soc_reg != arm_reg &&
+	    imx6_soc_volt[0] != imx6_soc_volt[num - 1]) {
+		min_volt = imx6_soc_volt[0];
+		max_volt = imx6_soc_volt[num - 1];
+		ret = regulator_set_voltage_time(soc_reg, min_volt, max_volt);
 		if (ret > 0)
 			transition_latency += ret * 1000;
+		if (!IS_ERR(pu_reg)) {
+			ret = regulator_set_voltage_time(pu_reg, min_volt,
+							 max_volt);
+			if (ret > 0)
+				transition_latency += ret * 1000;
+		}
 	}
 
 	/*
@@ -506,16 +563,10 @@ soc_opp_out:
 	 * freq_table initialised from OPP is therefore sorted in the
 	 * same order.
 	 */
-	rcu_read_lock();
-	opp = dev_pm_opp_find_freq_exact(cpu_dev,
-				  freq_table[0].frequency * 1000, true);
-	min_volt = dev_pm_opp_get_voltage(opp);
-	opp = dev_pm_opp_find_freq_exact(cpu_dev,
-				  freq_table[--num].frequency * 1000, true);
-	max_volt = dev_pm_opp_get_voltage(opp);
-	rcu_read_unlock();
+	min_volt = imx6_arm_volt[0];
+	max_volt = imx6_arm_volt[num - 1];
 	ret = regulator_set_voltage_time(arm_reg, min_volt, max_volt);
-	if (ret > 0)
+	if (ret > 0 && transition_latency != CPUFREQ_ETERNAL)
 		transition_latency += ret * 1000;
 
 	mutex_init(&set_cpufreq_lock);
@@ -533,6 +584,7 @@ soc_opp_out:
 	return 0;
 
 free_freq_table:
+	kfree(imx6_arm_volt);
 	kfree(imx6_soc_volt);
 	dev_pm_opp_free_cpufreq_table(cpu_dev, &freq_table);
 out_free_opp:
@@ -575,6 +627,7 @@ put_clk:
 static int imx6q_cpufreq_remove(struct platform_device *pdev)
 {
 	cpufreq_unregister_driver(&imx6q_cpufreq_driver);
+	kfree(imx6_arm_volt);
 	kfree(imx6_soc_volt);
 	dev_pm_opp_free_cpufreq_table(cpu_dev, &freq_table);
 	if (free_opp)
@@ -0,0 +1,68 @@
+/*
+ * CAAM job ring tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ */
+
+#if !defined(__CAAM_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __CAAM_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM caam
+
+/*
+ * @desc is the bus address of the job descriptor, which pairs an enqueue
+ * with its completion. @depth is the number of jobs in flight on the ring
+ * and @bklog the number waiting for room on it.
+ */
+DECLARE_EVENT_CLASS(caam_jr_job,
+	TP_PROTO(struct device *dev, int ridx, dma_addr_t desc, int depth,
+		 int bklog, u32 status),
+	TP_ARGS(dev, ridx, desc, depth, bklog, status),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(int, ridx)
+		__field(u64, desc)
+		__field(int, depth)
+		__field(int, bklog)
+		__field(u32, status)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->ridx = ridx;
+		__entry->desc = desc;
+		__entry->depth = depth;
+		__entry->bklog = bklog;
+		__entry->status = status;
+	),
+	TP_printk("%s: ring=%d desc=0x%llx depth=%d bklog=%d status=0x%08x",
+		  __get_str(name), __entry->ridx, __entry->desc,
+		  __entry->depth, __entry->bklog, __entry->status)
+);
+
+DEFINE_EVENT(caam_jr_job, caam_jr_enqueue,
+	TP_PROTO(struct device *dev, int ridx, dma_addr_t desc, int depth,
+		 int bklog, u32 status),
+	TP_ARGS(dev, ridx, desc, depth, bklog, status)
+);
+
+DEFINE_EVENT(caam_jr_job, caam_jr_done,
+	TP_PROTO(struct device *dev, int ridx, dma_addr_t desc, int depth,
+		 int bklog, u32 status),
+	TP_ARGS(dev, ridx, desc, depth, bklog, status)
+);
+
+#endif /* __CAAM_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE caam_trace
+#include <trace/define_trace.h>
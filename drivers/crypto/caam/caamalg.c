@@ -105,6 +105,30 @@
 #define DESC_MAX_USED_BYTES		(CAAM_DESC_BYTES_MAX - DESC_JOB_IO_LEN)
 #define DESC_MAX_USED_LEN		(DESC_MAX_USED_BYTES / CAAM_CMD_SZ)
 
+/*
+ * Extended descriptors that fit in CAAM_EDESC_POOL_BYTES (the edesc, its
+ * job descriptor and about 20 S/G entries) come from a per-tfm pool of
+ * buffers that stay DMA mapped, so the common path neither allocates nor
+ * maps the S/G table.
+ */
+#define CAAM_EDESC_POOL_BYTES		512
+#define CAAM_EDESC_POOL_DEPTH		32
+
+/*
+ * Requests shorter than these many bytes are handed to a software
+ * fallback tfm, for which the CPU beats the job ring round trip.
+ * 0 sends everything to CAAM.
+ */
+static unsigned int ablkcipher_fallback_len = 128;
+module_param(ablkcipher_fallback_len, uint, 0644);
+MODULE_PARM_DESC(ablkcipher_fallback_len,
+		 "Use software for ablkcipher requests below this many bytes");
+
+static unsigned int aead_fallback_len = 128;
+module_param(aead_fallback_len, uint, 0644);
+MODULE_PARM_DESC(aead_fallback_len,
+		 "Use software for AEAD requests below this many bytes");
+
 #ifdef DEBUG
 /* for print_hex_dumps with line references */
 #define debug(format, arg...) printk(format, arg)
@@ -155,6 +179,7 @@ struct caam_alg_entry {
 	int alg_op;
 	bool rfc3686;
 	bool geniv;
+	bool fallback;
 };
 
 struct caam_aead_alg {
@@ -232,8 +257,222 @@ struct caam_ctx {
 	unsigned int split_key_len;
 	unsigned int split_key_pad_len;
 	unsigned int authsize;
+	spinlock_t edesc_lock;		/* edesc_pool lock */
+	struct list_head edesc_pool;	/* idle, mapped edesc buffers */
+	unsigned int edesc_pool_cnt;
+	struct crypto_skcipher *sk_fallback;
+	struct crypto_aead *aead_fallback;
 };
 
+struct caam_edesc_buf {
+	struct list_head node;
+	dma_addr_t dma;			/* mapping of data[] */
+	u8 data[0] ____cacheline_aligned;
+};
+
+static struct kmem_cache *caam_edesc_cache;
+
+static int ablkcipher_fallback_setkey(struct crypto_ablkcipher *ablkcipher,
+				      const u8 *key, unsigned int keylen)
+{
+	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
+	int ret;
+
+	if (!ctx->sk_fallback)
+		return 0;
+
+	crypto_skcipher_clear_flags(ctx->sk_fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_skcipher_set_flags(ctx->sk_fallback,
+				  crypto_ablkcipher_get_flags(ablkcipher) &
+				  CRYPTO_TFM_REQ_MASK);
+	ret = crypto_skcipher_setkey(ctx->sk_fallback, key, keylen);
+	if (ret)
+		crypto_ablkcipher_set_flags(ablkcipher,
+				crypto_skcipher_get_flags(ctx->sk_fallback) &
+				CRYPTO_TFM_RES_MASK);
+
+	return ret;
+}
+
+static bool ablkcipher_use_fallback(struct ablkcipher_request *req)
+{
+	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
+	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
+
+	return ctx->sk_fallback &&
+	       req->nbytes < READ_ONCE(ablkcipher_fallback_len);
+}
+
+static int ablkcipher_fallback_crypt(struct ablkcipher_request *req,
+				     bool encrypt)
+{
+	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
+	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
+	SKCIPHER_REQUEST_ON_STACK(subreq, ctx->sk_fallback);
+	int ret;
+
+	skcipher_request_set_tfm(subreq, ctx->sk_fallback);
+	skcipher_request_set_callback(subreq, req->base.flags, NULL, NULL);
+	skcipher_request_set_crypt(subreq, req->src, req->dst, req->nbytes,
+				   req->info);
+	if (encrypt)
+		ret = crypto_skcipher_encrypt(subreq);
+	else
+		ret = crypto_skcipher_decrypt(subreq);
+	skcipher_request_zero(subreq);
+
+	return ret;
+}
+
+static int aead_fallback_setkey(struct crypto_aead *aead, const u8 *key,
+				unsigned int keylen)
+{
+	struct caam_ctx *ctx = crypto_aead_ctx(aead);
+	int ret;
+
+	if (!ctx->aead_fallback)
+		return 0;
+
+	crypto_aead_clear_flags(ctx->aead_fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(ctx->aead_fallback, crypto_aead_get_flags(aead) &
+			      CRYPTO_TFM_REQ_MASK);
+	ret = crypto_aead_setkey(ctx->aead_fallback, key, keylen);
+	if (ret)
+		crypto_aead_set_flags(aead,
+				crypto_aead_get_flags(ctx->aead_fallback) &
+				CRYPTO_TFM_RES_MASK);
+
+	return ret;
+}
+
+static int aead_fallback_setauthsize(struct crypto_aead *aead,
+				     unsigned int authsize)
+{
+	struct caam_ctx *ctx = crypto_aead_ctx(aead);
+
+	if (!ctx->aead_fallback)
+		return 0;
+
+	return crypto_aead_setauthsize(ctx->aead_fallback, authsize);
+}
+
+static bool aead_use_fallback(struct aead_request *req)
+{
+	struct caam_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+
+	return ctx->aead_fallback &&
+	       req->assoclen + req->cryptlen < READ_ONCE(aead_fallback_len);
+}
+
+/* The fallback is synchronous, its request lives in our request context */
+static int aead_fallback_crypt(struct aead_request *req, bool encrypt)
+{
+	struct caam_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	struct aead_request *subreq = aead_request_ctx(req);
+
+	aead_request_set_tfm(subreq, ctx->aead_fallback);
+	aead_request_set_callback(subreq, req->base.flags, req->base.complete,
+				  req->base.data);
+	aead_request_set_crypt(subreq, req->src, req->dst, req->cryptlen,
+			       req->iv);
+	aead_request_set_ad(subreq, req->assoclen);
+
+	return encrypt ? crypto_aead_encrypt(subreq) :
+			 crypto_aead_decrypt(subreq);
+}
+
+/*
+ * Allocate a zeroed extended descriptor of @size bytes. *@pool_dma is
+ * the bus address of the returned buffer if it comes from the pool, 0
+ * if it was allocated on its own.
+ */
+static void *caam_edesc_zalloc(struct caam_ctx *ctx, size_t size, gfp_t flags,
+			       dma_addr_t *pool_dma)
+{
+	struct caam_edesc_buf *buf = NULL;
+
+	*pool_dma = 0;
+	if (!caam_edesc_cache || size > CAAM_EDESC_POOL_BYTES)
+		return kzalloc(size, GFP_DMA | flags);
+
+	spin_lock_bh(&ctx->edesc_lock);
+	if (!list_empty(&ctx->edesc_pool)) {
+		buf = list_first_entry(&ctx->edesc_pool, struct caam_edesc_buf,
+				       node);
+		list_del(&buf->node);
+		ctx->edesc_pool_cnt--;
+	}
+	spin_unlock_bh(&ctx->edesc_lock);
+
+	if (!buf) {
+		buf = kmem_cache_alloc(caam_edesc_cache, flags);
+		if (!buf)
+			return NULL;
+
+		buf->dma = dma_map_single(ctx->jrdev, buf->data,
+					  CAAM_EDESC_POOL_BYTES, DMA_TO_DEVICE);
+		if (dma_mapping_error(ctx->jrdev, buf->dma)) {
+			kmem_cache_free(caam_edesc_cache, buf);
+			return kzalloc(size, GFP_DMA | flags);
+		}
+	}
+
+	memset(buf->data, 0, size);
+	*pool_dma = buf->dma;
+
+	return buf->data;
+}
+
+static void caam_edesc_free(struct caam_ctx *ctx, void *edesc,
+			    dma_addr_t pool_dma)
+{
+	struct caam_edesc_buf *buf;
+
+	if (!pool_dma) {
+		kfree(edesc);
+		return;
+	}
+
+	buf = container_of(edesc, struct caam_edesc_buf, data[0]);
+
+	spin_lock_bh(&ctx->edesc_lock);
+	if (ctx->edesc_pool_cnt < CAAM_EDESC_POOL_DEPTH) {
+		list_add(&buf->node, &ctx->edesc_pool);
+		ctx->edesc_pool_cnt++;
+		buf = NULL;
+	}
+	spin_unlock_bh(&ctx->edesc_lock);
+
+	if (buf) {
+		dma_unmap_single(ctx->jrdev, buf->dma, CAAM_EDESC_POOL_BYTES,
+				 DMA_TO_DEVICE);
+		kmem_cache_free(caam_edesc_cache, buf);
+	}
+}
+
+/*
+ * Make the S/G table of an extended descriptor visible to CAAM. Pooled
+ * buffers are already mapped and only need their table written back.
+ */
+static int caam_edesc_map_sg(struct device *jrdev, struct caam_ctx *ctx,
+			     void *edesc, dma_addr_t pool_dma,
+			     struct sec4_sg_entry *sec4_sg, int sec4_sg_bytes,
+			     dma_addr_t *sec4_sg_dma)
+{
+	unsigned long off = (void *)sec4_sg - edesc;
+
+	if (pool_dma) {
+		dma_sync_single_range_for_device(ctx->jrdev, pool_dma, off,
+						 sec4_sg_bytes, DMA_TO_DEVICE);
+		*sec4_sg_dma = pool_dma + off;
+		return 0;
+	}
+
+	*sec4_sg_dma = dma_map_single(jrdev, sec4_sg, sec4_sg_bytes,
+				      DMA_TO_DEVICE);
+	return dma_mapping_error(jrdev, *sec4_sg_dma) ? -ENOMEM : 0;
+}
+
 static void append_key_aead(u32 *desc, struct caam_ctx *ctx,
 			    int keys_fit_inline, bool is_rfc3686)
 {
@@ -968,6 +1207,11 @@ static int gcm_set_sh_desc(struct crypto_aead *aead)
 static int gcm_setauthsize(struct crypto_aead *authenc, unsigned int authsize)
 {
 	struct caam_ctx *ctx = crypto_aead_ctx(authenc);
+	int ret;
+
+	ret = aead_fallback_setauthsize(authenc, authsize);
+	if (ret)
+		return ret;
 
 	ctx->authsize = authsize;
 	gcm_set_sh_desc(authenc);
@@ -1141,6 +1385,11 @@ static int rfc4106_setauthsize(struct crypto_aead *authenc,
 			       unsigned int authsize)
 {
 	struct caam_ctx *ctx = crypto_aead_ctx(authenc);
+	int ret;
+
+	ret = aead_fallback_setauthsize(authenc, authsize);
+	if (ret)
+		return ret;
 
 	ctx->authsize = authsize;
 	rfc4106_set_sh_desc(authenc);
@@ -1318,6 +1567,11 @@ static int rfc4543_setauthsize(struct crypto_aead *authenc,
 			       unsigned int authsize)
 {
 	struct caam_ctx *ctx = crypto_aead_ctx(authenc);
+	int ret;
+
+	ret = aead_fallback_setauthsize(authenc, authsize);
+	if (ret)
+		return ret;
 
 	ctx->authsize = authsize;
 	rfc4543_set_sh_desc(authenc);
@@ -1410,6 +1664,10 @@ static int gcm_setkey(struct crypto_aead *aead,
 		       DUMP_PREFIX_ADDRESS, 16, 4, key, keylen, 1);
 #endif
 
+	ret = aead_fallback_setkey(aead, key, keylen);
+	if (ret)
+		return ret;
+
 	memcpy(ctx->key, key, keylen);
 	ctx->key_dma = dma_map_single(jrdev, ctx->key, keylen,
 				      DMA_TO_DEVICE);
@@ -1443,6 +1701,10 @@ static int rfc4106_setkey(struct crypto_aead *aead,
 		       DUMP_PREFIX_ADDRESS, 16, 4, key, keylen, 1);
 #endif
 
+	ret = aead_fallback_setkey(aead, key, keylen);
+	if (ret)
+		return ret;
+
 	memcpy(ctx->key, key, keylen);
 
 	/*
@@ -1482,6 +1744,10 @@ static int rfc4543_setkey(struct crypto_aead *aead,
 		       DUMP_PREFIX_ADDRESS, 16, 4, key, keylen, 1);
 #endif
 
+	ret = aead_fallback_setkey(aead, key, keylen);
+	if (ret)
+		return ret;
+
 	memcpy(ctx->key, key, keylen);
 
 	/*
@@ -1529,6 +1795,10 @@ static int ablkcipher_setkey(struct crypto_ablkcipher *ablkcipher,
 	print_hex_dump(KERN_ERR, "key in @"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, key, keylen, 1);
 #endif
+	ret = ablkcipher_fallback_setkey(ablkcipher, key, keylen);
+	if (ret)
+		return ret;
+
 	/*
 	 * AES-CTR needs to load IV in CONTEXT1 reg
 	 * at an offset of 128bits (16bytes)
@@ -1792,6 +2062,7 @@ static int xts_ablkcipher_setkey(struct crypto_ablkcipher *ablkcipher,
 	struct device *jrdev = ctx->jrdev;
 	u32 *key_jump_cmd, *desc;
 	__be64 sector_size = cpu_to_be64(512);
+	int ret;
 
 	if (keylen != 2 * AES_MIN_KEY_SIZE  && keylen != 2 * AES_MAX_KEY_SIZE) {
 		crypto_ablkcipher_set_flags(ablkcipher,
@@ -1800,6 +2071,10 @@ static int xts_ablkcipher_setkey(struct crypto_ablkcipher *ablkcipher,
 		return -EINVAL;
 	}
 
+	ret = ablkcipher_fallback_setkey(ablkcipher, key, keylen);
+	if (ret)
+		return ret;
+
 	memcpy(ctx->key, key, keylen);
 	ctx->key_dma = dma_map_single(jrdev, ctx->key, keylen, DMA_TO_DEVICE);
 	if (dma_mapping_error(jrdev, ctx->key_dma)) {
@@ -1914,6 +2189,8 @@ static int xts_ablkcipher_setkey(struct crypto_ablkcipher *ablkcipher,
  * @desc: h/w descriptor (variable length; must not exceed MAX_CAAM_DESCSIZE)
  * @sec4_sg_bytes: length of dma mapped sec4_sg space
  * @sec4_sg_dma: bus physical mapped address of h/w link table
+ * @bklog: job ring backlog entry, used while the ring is full
+ * @pool_dma: bus address of the edesc if it comes from the tfm pool
  * @hw_desc: the h/w job descriptor followed by any referenced link tables
  */
 struct aead_edesc {
@@ -1924,6 +2201,8 @@ struct aead_edesc {
 	int sec4_sg_bytes;
 	dma_addr_t sec4_sg_dma;
 	struct sec4_sg_entry *sec4_sg;
+	struct caam_jr_bklog_entry bklog;
+	dma_addr_t pool_dma;
 	u32 hw_desc[];
 };
 
@@ -1935,6 +2214,8 @@ struct aead_edesc {
  * @desc: h/w descriptor (variable length; must not exceed MAX_CAAM_DESCSIZE)
  * @sec4_sg_bytes: length of dma mapped sec4_sg space
  * @sec4_sg_dma: bus physical mapped address of h/w link table
+ * @bklog: job ring backlog entry, used while the ring is full
+ * @pool_dma: bus address of the edesc if it comes from the tfm pool
  * @hw_desc: the h/w job descriptor followed by any referenced link tables
  */
 struct ablkcipher_edesc {
@@ -1944,6 +2225,8 @@ struct ablkcipher_edesc {
 	int sec4_sg_bytes;
 	dma_addr_t sec4_sg_dma;
 	struct sec4_sg_entry *sec4_sg;
+	struct caam_jr_bklog_entry bklog;
+	dma_addr_t pool_dma;
 	u32 hw_desc[0];
 };
 
@@ -1973,7 +2256,8 @@ static void aead_unmap(struct device *dev,
 {
 	caam_unmap(dev, req->src, req->dst,
 		   edesc->src_nents, edesc->dst_nents, 0, 0,
-		   edesc->sec4_sg_dma, edesc->sec4_sg_bytes);
+		   edesc->sec4_sg_dma,
+		   edesc->pool_dma ? 0 : edesc->sec4_sg_bytes);
 }
 
 static void ablkcipher_unmap(struct device *dev,
@@ -1986,13 +2270,15 @@ static void ablkcipher_unmap(struct device *dev,
 	caam_unmap(dev, req->src, req->dst,
 		   edesc->src_nents, edesc->dst_nents,
 		   edesc->iv_dma, ivsize,
-		   edesc->sec4_sg_dma, edesc->sec4_sg_bytes);
+		   edesc->sec4_sg_dma,
+		   edesc->pool_dma ? 0 : edesc->sec4_sg_bytes);
 }
 
 static void aead_encrypt_done(struct device *jrdev, u32 *desc, u32 err,
 				   void *context)
 {
 	struct aead_request *req = context;
+	struct caam_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
 	struct aead_edesc *edesc;
 
 #ifdef DEBUG
@@ -2006,7 +2292,7 @@ static void aead_encrypt_done(struct device *jrdev, u32 *desc, u32 err,
 
 	aead_unmap(jrdev, edesc, req);
 
-	kfree(edesc);
+	caam_edesc_free(ctx, edesc, edesc->pool_dma);
 
 	aead_request_complete(req, err);
 }
@@ -2015,6 +2301,7 @@ static void aead_decrypt_done(struct device *jrdev, u32 *desc, u32 err,
 				   void *context)
 {
 	struct aead_request *req = context;
+	struct caam_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
 	struct aead_edesc *edesc;
 
 #ifdef DEBUG
@@ -2034,7 +2321,7 @@ static void aead_decrypt_done(struct device *jrdev, u32 *desc, u32 err,
 	if ((err & JRSTA_CCBERR_ERRID_MASK) == JRSTA_CCBERR_ERRID_ICVCHK)
 		err = -EBADMSG;
 
-	kfree(edesc);
+	caam_edesc_free(ctx, edesc, edesc->pool_dma);
 
 	aead_request_complete(req, err);
 }
@@ -2078,7 +2365,7 @@ static void ablkcipher_encrypt_done(struct device *jrdev, u32 *desc, u32 err,
 	scatterwalk_map_and_copy(req->info, req->dst, req->nbytes - ivsize,
 				 ivsize, 0);
 
-	kfree(edesc);
+	caam_edesc_free(ctx, edesc, edesc->pool_dma);
 
 	/* Pass IV along for cbc */
 	if ((ctx->class1_alg_type & OP_ALG_AAI_MASK) == OP_ALG_AAI_CBC) {
@@ -2095,6 +2382,7 @@ static void ablkcipher_decrypt_done(struct device *jrdev, u32 *desc, u32 err,
 	struct ablkcipher_request *req = context;
 	struct ablkcipher_edesc *edesc;
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
+	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
 	int ivsize = crypto_ablkcipher_ivsize(ablkcipher);
 
 #ifdef DEBUG
@@ -2124,7 +2412,7 @@ static void ablkcipher_decrypt_done(struct device *jrdev, u32 *desc, u32 err,
 	scatterwalk_map_and_copy(req->info, req->src, req->nbytes - ivsize,
 				 ivsize, 0);
 
-	kfree(edesc);
+	caam_edesc_free(ctx, edesc, edesc->pool_dma);
 
 	ablkcipher_request_complete(req, err);
 }
@@ -2372,17 +2660,18 @@ static void init_ablkcipher_giv_job(u32 *sh_desc, dma_addr_t ptr,
 /*
  * allocate and map the aead extended descriptor
  */
-static struct aead_edesc *aead_edesc_alloc(struct aead_request *req,
+static struct aead_edesc *aead_edesc_alloc(struct device *jrdev,
+					   struct aead_request *req,
 					   int desc_bytes, bool *all_contig_ptr,
 					   bool encrypt)
 {
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct caam_ctx *ctx = crypto_aead_ctx(aead);
-	struct device *jrdev = ctx->jrdev;
 	gfp_t flags = (req->base.flags & (CRYPTO_TFM_REQ_MAY_BACKLOG |
 		       CRYPTO_TFM_REQ_MAY_SLEEP)) ? GFP_KERNEL : GFP_ATOMIC;
 	int src_nents, dst_nents = 0;
 	struct aead_edesc *edesc;
+	dma_addr_t pool_dma;
 	int sgc;
 	bool all_contig = true;
 	int sec4_sg_index, sec4_sg_len = 0, sec4_sg_bytes;
@@ -2411,19 +2700,20 @@ static struct aead_edesc *aead_edesc_alloc(struct aead_request *req,
 	sec4_sg_bytes = sec4_sg_len * sizeof(struct sec4_sg_entry);
 
 	/* allocate space for base edesc and hw desc commands, link tables */
-	edesc = kzalloc(sizeof(*edesc) + desc_bytes + sec4_sg_bytes,
-			GFP_DMA | flags);
+	edesc = caam_edesc_zalloc(ctx, sizeof(*edesc) + desc_bytes +
+				  sec4_sg_bytes, flags, &pool_dma);
 	if (!edesc) {
 		dev_err(jrdev, "could not allocate extended descriptor\n");
 		return ERR_PTR(-ENOMEM);
 	}
+	edesc->pool_dma = pool_dma;
 
 	if (likely(req->src == req->dst)) {
 		sgc = dma_map_sg(jrdev, req->src, src_nents ? : 1,
 				 DMA_BIDIRECTIONAL);
 		if (unlikely(!sgc)) {
 			dev_err(jrdev, "unable to map source\n");
-			kfree(edesc);
+			caam_edesc_free(ctx, edesc, edesc->pool_dma);
 			return ERR_PTR(-ENOMEM);
 		}
 	} else {
@@ -2431,7 +2721,7 @@ static struct aead_edesc *aead_edesc_alloc(struct aead_request *req,
 				 DMA_TO_DEVICE);
 		if (unlikely(!sgc)) {
 			dev_err(jrdev, "unable to map source\n");
-			kfree(edesc);
+			caam_edesc_free(ctx, edesc, edesc->pool_dma);
 			return ERR_PTR(-ENOMEM);
 		}
 
@@ -2441,7 +2731,7 @@ static struct aead_edesc *aead_edesc_alloc(struct aead_request *req,
 			dev_err(jrdev, "unable to map destination\n");
 			dma_unmap_sg(jrdev, req->src, src_nents ? : 1,
 				     DMA_TO_DEVICE);
-			kfree(edesc);
+			caam_edesc_free(ctx, edesc, edesc->pool_dma);
 			return ERR_PTR(-ENOMEM);
 		}
 	}
@@ -2466,12 +2756,11 @@ static struct aead_edesc *aead_edesc_alloc(struct aead_request *req,
 	if (!sec4_sg_bytes)
 		return edesc;
 
-	edesc->sec4_sg_dma = dma_map_single(jrdev, edesc->sec4_sg,
-					    sec4_sg_bytes, DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, edesc->sec4_sg_dma)) {
+	if (caam_edesc_map_sg(jrdev, ctx, edesc, pool_dma, edesc->sec4_sg,
+			      sec4_sg_bytes, &edesc->sec4_sg_dma)) {
 		dev_err(jrdev, "unable to map S/G table\n");
 		aead_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 		return ERR_PTR(-ENOMEM);
 	}
 
@@ -2485,13 +2774,17 @@ static int gcm_encrypt(struct aead_request *req)
 	struct aead_edesc *edesc;
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct caam_ctx *ctx = crypto_aead_ctx(aead);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool all_contig;
 	u32 *desc;
 	int ret = 0;
 
+	if (aead_use_fallback(req))
+		return aead_fallback_crypt(req, true);
+
 	/* allocate extended descriptor */
-	edesc = aead_edesc_alloc(req, GCM_DESC_JOB_IO_LEN, &all_contig, true);
+	edesc = aead_edesc_alloc(jrdev, req, GCM_DESC_JOB_IO_LEN, &all_contig,
+				 true);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
 
@@ -2504,12 +2797,13 @@ static int gcm_encrypt(struct aead_request *req)
 #endif
 
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, aead_encrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, aead_encrypt_done, req,
+				    &edesc->bklog, &req->base);
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		aead_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2528,13 +2822,13 @@ static int aead_encrypt(struct aead_request *req)
 	struct aead_edesc *edesc;
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct caam_ctx *ctx = crypto_aead_ctx(aead);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool all_contig;
 	u32 *desc;
 	int ret = 0;
 
 	/* allocate extended descriptor */
-	edesc = aead_edesc_alloc(req, AUTHENC_DESC_JOB_IO_LEN,
+	edesc = aead_edesc_alloc(jrdev, req, AUTHENC_DESC_JOB_IO_LEN,
 				 &all_contig, true);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
@@ -2548,12 +2842,13 @@ static int aead_encrypt(struct aead_request *req)
 #endif
 
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, aead_encrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, aead_encrypt_done, req,
+				    &edesc->bklog, &req->base);
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		aead_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2564,13 +2859,17 @@ static int gcm_decrypt(struct aead_request *req)
 	struct aead_edesc *edesc;
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct caam_ctx *ctx = crypto_aead_ctx(aead);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool all_contig;
 	u32 *desc;
 	int ret = 0;
 
+	if (aead_use_fallback(req))
+		return aead_fallback_crypt(req, false);
+
 	/* allocate extended descriptor */
-	edesc = aead_edesc_alloc(req, GCM_DESC_JOB_IO_LEN, &all_contig, false);
+	edesc = aead_edesc_alloc(jrdev, req, GCM_DESC_JOB_IO_LEN, &all_contig,
+				 false);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
 
@@ -2583,12 +2882,13 @@ static int gcm_decrypt(struct aead_request *req)
 #endif
 
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, aead_decrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, aead_decrypt_done, req,
+				    &edesc->bklog, &req->base);
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		aead_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2607,7 +2907,7 @@ static int aead_decrypt(struct aead_request *req)
 	struct aead_edesc *edesc;
 	struct crypto_aead *aead = crypto_aead_reqtfm(req);
 	struct caam_ctx *ctx = crypto_aead_ctx(aead);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool all_contig;
 	u32 *desc;
 	int ret = 0;
@@ -2621,7 +2921,7 @@ static int aead_decrypt(struct aead_request *req)
 #endif
 
 	/* allocate extended descriptor */
-	edesc = aead_edesc_alloc(req, AUTHENC_DESC_JOB_IO_LEN,
+	edesc = aead_edesc_alloc(jrdev, req, AUTHENC_DESC_JOB_IO_LEN,
 				 &all_contig, false);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
@@ -2635,12 +2935,13 @@ static int aead_decrypt(struct aead_request *req)
 #endif
 
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, aead_decrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, aead_decrypt_done, req,
+				    &edesc->bklog, &req->base);
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		aead_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2649,18 +2950,18 @@ static int aead_decrypt(struct aead_request *req)
 /*
  * allocate and map the ablkcipher extended descriptor for ablkcipher
  */
-static struct ablkcipher_edesc *ablkcipher_edesc_alloc(struct ablkcipher_request
+static struct ablkcipher_edesc *ablkcipher_edesc_alloc(struct device *jrdev,
+						       struct ablkcipher_request
 						       *req, int desc_bytes,
 						       bool *iv_contig_out)
 {
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
 	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
-	struct device *jrdev = ctx->jrdev;
 	gfp_t flags = (req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP) ?
 		       GFP_KERNEL : GFP_ATOMIC;
 	int src_nents, dst_nents = 0, sec4_sg_bytes;
 	struct ablkcipher_edesc *edesc;
-	dma_addr_t iv_dma = 0;
+	dma_addr_t iv_dma = 0, pool_dma;
 	bool iv_contig = false;
 	int sgc;
 	int ivsize = crypto_ablkcipher_ivsize(ablkcipher);
@@ -2707,12 +3008,13 @@ static struct ablkcipher_edesc *ablkcipher_edesc_alloc(struct ablkcipher_request
 			sizeof(struct sec4_sg_entry);
 
 	/* allocate space for base edesc and hw desc commands, link tables */
-	edesc = kzalloc(sizeof(*edesc) + desc_bytes + sec4_sg_bytes,
-			GFP_DMA | flags);
+	edesc = caam_edesc_zalloc(ctx, sizeof(*edesc) + desc_bytes +
+				  sec4_sg_bytes, flags, &pool_dma);
 	if (!edesc) {
 		dev_err(jrdev, "could not allocate extended descriptor\n");
 		return ERR_PTR(-ENOMEM);
 	}
+	edesc->pool_dma = pool_dma;
 
 	edesc->src_nents = src_nents;
 	edesc->dst_nents = dst_nents;
@@ -2733,10 +3035,10 @@ static struct ablkcipher_edesc *ablkcipher_edesc_alloc(struct ablkcipher_request
 			edesc->sec4_sg + sec4_sg_index, 0);
 	}
 
-	edesc->sec4_sg_dma = dma_map_single(jrdev, edesc->sec4_sg,
-					    sec4_sg_bytes, DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, edesc->sec4_sg_dma)) {
+	if (caam_edesc_map_sg(jrdev, ctx, edesc, pool_dma, edesc->sec4_sg,
+			      sec4_sg_bytes, &edesc->sec4_sg_dma)) {
 		dev_err(jrdev, "unable to map S/G table\n");
+		caam_edesc_free(ctx, edesc, pool_dma);
 		return ERR_PTR(-ENOMEM);
 	}
 
@@ -2757,13 +3059,16 @@ static int ablkcipher_encrypt(struct ablkcipher_request *req)
 	struct ablkcipher_edesc *edesc;
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
 	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool iv_contig;
 	u32 *desc;
 	int ret = 0;
 
+	if (ablkcipher_use_fallback(req))
+		return ablkcipher_fallback_crypt(req, true);
+
 	/* allocate extended descriptor */
-	edesc = ablkcipher_edesc_alloc(req, DESC_JOB_IO_LEN *
+	edesc = ablkcipher_edesc_alloc(jrdev, req, DESC_JOB_IO_LEN *
 				       CAAM_CMD_SZ, &iv_contig);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
@@ -2777,13 +3082,14 @@ static int ablkcipher_encrypt(struct ablkcipher_request *req)
 		       desc_bytes(edesc->hw_desc), 1);
 #endif
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, ablkcipher_encrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, ablkcipher_encrypt_done, req,
+				    &edesc->bklog, &req->base);
 
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		ablkcipher_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2794,13 +3100,16 @@ static int ablkcipher_decrypt(struct ablkcipher_request *req)
 	struct ablkcipher_edesc *edesc;
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
 	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool iv_contig;
 	u32 *desc;
 	int ret = 0;
 
+	if (ablkcipher_use_fallback(req))
+		return ablkcipher_fallback_crypt(req, false);
+
 	/* allocate extended descriptor */
-	edesc = ablkcipher_edesc_alloc(req, DESC_JOB_IO_LEN *
+	edesc = ablkcipher_edesc_alloc(jrdev, req, DESC_JOB_IO_LEN *
 				       CAAM_CMD_SZ, &iv_contig);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
@@ -2815,12 +3124,13 @@ static int ablkcipher_decrypt(struct ablkcipher_request *req)
 		       desc_bytes(edesc->hw_desc), 1);
 #endif
 
-	ret = caam_jr_enqueue(jrdev, desc, ablkcipher_decrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, ablkcipher_decrypt_done, req,
+				    &edesc->bklog, &req->base);
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		ablkcipher_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2831,6 +3141,7 @@ static int ablkcipher_decrypt(struct ablkcipher_request *req)
  * for ablkcipher givencrypt
  */
 static struct ablkcipher_edesc *ablkcipher_giv_edesc_alloc(
+				struct device *jrdev,
 				struct skcipher_givcrypt_request *greq,
 				int desc_bytes,
 				bool *iv_contig_out)
@@ -2838,13 +3149,12 @@ static struct ablkcipher_edesc *ablkcipher_giv_edesc_alloc(
 	struct ablkcipher_request *req = &greq->creq;
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
 	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
-	struct device *jrdev = ctx->jrdev;
 	gfp_t flags = (req->base.flags & (CRYPTO_TFM_REQ_MAY_BACKLOG |
 					  CRYPTO_TFM_REQ_MAY_SLEEP)) ?
 		       GFP_KERNEL : GFP_ATOMIC;
 	int src_nents, dst_nents = 0, sec4_sg_bytes;
 	struct ablkcipher_edesc *edesc;
-	dma_addr_t iv_dma = 0;
+	dma_addr_t iv_dma = 0, pool_dma;
 	bool iv_contig = false;
 	int sgc;
 	int ivsize = crypto_ablkcipher_ivsize(ablkcipher);
@@ -2883,12 +3193,13 @@ static struct ablkcipher_edesc *ablkcipher_giv_edesc_alloc(
 			sizeof(struct sec4_sg_entry);
 
 	/* allocate space for base edesc and hw desc commands, link tables */
-	edesc = kzalloc(sizeof(*edesc) + desc_bytes + sec4_sg_bytes,
-			GFP_DMA | flags);
+	edesc = caam_edesc_zalloc(ctx, sizeof(*edesc) + desc_bytes +
+				  sec4_sg_bytes, flags, &pool_dma);
 	if (!edesc) {
 		dev_err(jrdev, "could not allocate extended descriptor\n");
 		return ERR_PTR(-ENOMEM);
 	}
+	edesc->pool_dma = pool_dma;
 
 	edesc->src_nents = src_nents;
 	edesc->dst_nents = dst_nents;
@@ -2910,10 +3221,10 @@ static struct ablkcipher_edesc *ablkcipher_giv_edesc_alloc(
 				   edesc->sec4_sg + sec4_sg_index, 0);
 	}
 
-	edesc->sec4_sg_dma = dma_map_single(jrdev, edesc->sec4_sg,
-					    sec4_sg_bytes, DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, edesc->sec4_sg_dma)) {
+	if (caam_edesc_map_sg(jrdev, ctx, edesc, pool_dma, edesc->sec4_sg,
+			      sec4_sg_bytes, &edesc->sec4_sg_dma)) {
 		dev_err(jrdev, "unable to map S/G table\n");
+		caam_edesc_free(ctx, edesc, pool_dma);
 		return ERR_PTR(-ENOMEM);
 	}
 	edesc->iv_dma = iv_dma;
@@ -2935,13 +3246,13 @@ static int ablkcipher_givencrypt(struct skcipher_givcrypt_request *creq)
 	struct ablkcipher_edesc *edesc;
 	struct crypto_ablkcipher *ablkcipher = crypto_ablkcipher_reqtfm(req);
 	struct caam_ctx *ctx = crypto_ablkcipher_ctx(ablkcipher);
-	struct device *jrdev = ctx->jrdev;
+	struct device *jrdev = caam_jr_pick(ctx->jrdev);
 	bool iv_contig;
 	u32 *desc;
 	int ret = 0;
 
 	/* allocate extended descriptor */
-	edesc = ablkcipher_giv_edesc_alloc(creq, DESC_JOB_IO_LEN *
+	edesc = ablkcipher_giv_edesc_alloc(jrdev, creq, DESC_JOB_IO_LEN *
 				       CAAM_CMD_SZ, &iv_contig);
 	if (IS_ERR(edesc))
 		return PTR_ERR(edesc);
@@ -2956,13 +3267,14 @@ static int ablkcipher_givencrypt(struct skcipher_givcrypt_request *creq)
 		       desc_bytes(edesc->hw_desc), 1);
 #endif
 	desc = edesc->hw_desc;
-	ret = caam_jr_enqueue(jrdev, desc, ablkcipher_encrypt_done, req);
+	ret = caam_jr_enqueue_bklog(jrdev, desc, ablkcipher_encrypt_done, req,
+				    &edesc->bklog, &req->base);
 
 	if (!ret) {
 		ret = -EINPROGRESS;
-	} else {
+	} else if (!caam_jr_backlogged(ret, &req->base)) {
 		ablkcipher_unmap(jrdev, edesc, req);
-		kfree(edesc);
+		caam_edesc_free(ctx, edesc, edesc->pool_dma);
 	}
 
 	return ret;
@@ -2981,6 +3293,7 @@ struct caam_alg_template {
 	u32 class1_alg_type;
 	u32 class2_alg_type;
 	u32 alg_op;
+	bool fallback;
 };
 
 static struct caam_alg_template driver_algs[] = {
@@ -3001,6 +3314,7 @@ static struct caam_alg_template driver_algs[] = {
 			.ivsize = AES_BLOCK_SIZE,
 			},
 		.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_CBC,
+		.fallback = true,
 	},
 	{
 		.name = "ecb(aes)",
@@ -3017,6 +3331,7 @@ static struct caam_alg_template driver_algs[] = {
 			.ivsize = AES_BLOCK_SIZE,
 			},
 		.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_ECB,
+		.fallback = true,
 	},
 	{
 		.name = "cbc(des3_ede)",
@@ -3099,6 +3414,7 @@ static struct caam_alg_template driver_algs[] = {
 			.ivsize = AES_BLOCK_SIZE,
 			},
 		.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_CTR_MOD128,
+		.fallback = true,
 	},
 	{
 		.name = "rfc3686(ctr(aes))",
@@ -3118,6 +3434,7 @@ static struct caam_alg_template driver_algs[] = {
 			.ivsize = CTR_RFC3686_IV_SIZE,
 			},
 		.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_CTR_MOD128,
+		.fallback = true,
 	},
 	{
 		.name = "xts(aes)",
@@ -3134,6 +3451,7 @@ static struct caam_alg_template driver_algs[] = {
 			.ivsize = AES_BLOCK_SIZE,
 			},
 		.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_XTS,
+		.fallback = true,
 	},
 	{
 		.name = "ecb(arc4)",
@@ -3171,6 +3489,7 @@ static struct caam_aead_alg driver_aeads[] = {
 		},
 		.caam = {
 			.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_GCM,
+			.fallback = true,
 		},
 	},
 	{
@@ -3189,6 +3508,7 @@ static struct caam_aead_alg driver_aeads[] = {
 		},
 		.caam = {
 			.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_GCM,
+			.fallback = true,
 		},
 	},
 	/* Galois Counter Mode */
@@ -3208,6 +3528,7 @@ static struct caam_aead_alg driver_aeads[] = {
 		},
 		.caam = {
 			.class1_alg_type = OP_ALG_ALGSEL_AES | OP_ALG_AAI_GCM,
+			.fallback = true,
 		},
 	},
 	/* single-pass ipsec_esp descriptor */
@@ -4503,6 +4824,10 @@ static int caam_init_common(struct caam_ctx *ctx, struct caam_alg_entry *caam)
 		return PTR_ERR(ctx->jrdev);
 	}
 
+	spin_lock_init(&ctx->edesc_lock);
+	INIT_LIST_HEAD(&ctx->edesc_pool);
+	ctx->edesc_pool_cnt = 0;
+
 	/* copy descriptor header template value */
 	ctx->class1_alg_type = OP_TYPE_CLASS1_ALG | caam->class1_alg_type;
 	ctx->class2_alg_type = OP_TYPE_CLASS2_ALG | caam->class2_alg_type;
@@ -4517,8 +4842,20 @@ static int caam_cra_init(struct crypto_tfm *tfm)
 	struct caam_crypto_alg *caam_alg =
 		 container_of(alg, struct caam_crypto_alg, crypto_alg);
 	struct caam_ctx *ctx = crypto_tfm_ctx(tfm);
+	int ret;
+
+	ret = caam_init_common(ctx, &caam_alg->caam);
+	if (ret || !caam_alg->caam.fallback)
+		return ret;
 
-	return caam_init_common(ctx, &caam_alg->caam);
+	/* Without a software implementation everything goes to CAAM */
+	ctx->sk_fallback = crypto_alloc_skcipher(crypto_tfm_alg_name(tfm), 0,
+						 CRYPTO_ALG_ASYNC |
+						 CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->sk_fallback))
+		ctx->sk_fallback = NULL;
+
+	return 0;
 }
 
 static int caam_aead_init(struct crypto_aead *tfm)
@@ -4527,12 +4864,36 @@ static int caam_aead_init(struct crypto_aead *tfm)
 	struct caam_aead_alg *caam_alg =
 		 container_of(alg, struct caam_aead_alg, aead);
 	struct caam_ctx *ctx = crypto_aead_ctx(tfm);
+	int ret;
+
+	ret = caam_init_common(ctx, &caam_alg->caam);
+	if (ret || !caam_alg->caam.fallback)
+		return ret;
+
+	ctx->aead_fallback = crypto_alloc_aead(alg->base.cra_name, 0,
+					       CRYPTO_ALG_ASYNC |
+					       CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->aead_fallback)) {
+		ctx->aead_fallback = NULL;
+		return 0;
+	}
+
+	crypto_aead_set_reqsize(tfm, sizeof(struct aead_request) +
+				crypto_aead_reqsize(ctx->aead_fallback));
 
-	return caam_init_common(ctx, &caam_alg->caam);
+	return 0;
 }
 
 static void caam_exit_common(struct caam_ctx *ctx)
 {
+	struct caam_edesc_buf *buf, *tmp;
+
+	list_for_each_entry_safe(buf, tmp, &ctx->edesc_pool, node) {
+		dma_unmap_single(ctx->jrdev, buf->dma, CAAM_EDESC_POOL_BYTES,
+				 DMA_TO_DEVICE);
+		kmem_cache_free(caam_edesc_cache, buf);
+	}
+
 	if (ctx->sh_desc_enc_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_enc_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_enc_dma,
@@ -4557,12 +4918,20 @@ static void caam_exit_common(struct caam_ctx *ctx)
 
 static void caam_cra_exit(struct crypto_tfm *tfm)
 {
-	caam_exit_common(crypto_tfm_ctx(tfm));
+	struct caam_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (ctx->sk_fallback)
+		crypto_free_skcipher(ctx->sk_fallback);
+	caam_exit_common(ctx);
 }
 
 static void caam_aead_exit(struct crypto_aead *tfm)
 {
-	caam_exit_common(crypto_aead_ctx(tfm));
+	struct caam_ctx *ctx = crypto_aead_ctx(tfm);
+
+	if (ctx->aead_fallback)
+		crypto_free_aead(ctx->aead_fallback);
+	caam_exit_common(ctx);
 }
 
 static void __exit caam_algapi_exit(void)
@@ -4603,6 +4972,8 @@ skip_ecb_ziv:
 			crypto_unregister_aead(&t_alg->aead);
 	}
 
+	kmem_cache_destroy(caam_edesc_cache);
+
 	if (!alg_list.next)
 		return;
 
@@ -4657,6 +5028,7 @@ static struct caam_crypto_alg *caam_alg_alloc(struct caam_alg_template
 	t_alg->caam.class1_alg_type = template->class1_alg_type;
 	t_alg->caam.class2_alg_type = template->class2_alg_type;
 	t_alg->caam.alg_op = template->alg_op;
+	t_alg->caam.fallback = template->fallback;
 
 	return t_alg;
 }
@@ -4713,6 +5085,13 @@ static int __init caam_algapi_init(void)
 	if (!ecb_zero_iv)
 		return -ENOMEM;
 
+	/* without the cache every edesc is simply kzalloc'ed */
+	caam_edesc_cache = kmem_cache_create("caam_edesc",
+					     sizeof(struct caam_edesc_buf) +
+					     CAAM_EDESC_POOL_BYTES, 0,
+					     SLAB_HWCACHE_ALIGN |
+					     SLAB_CACHE_DMA, NULL);
+
 	ecb_ziv_dma = dma_map_single(ctrldev, ecb_zero_iv, AES_BLOCK_SIZE,
 				      DMA_TO_DEVICE);
 	if (dma_mapping_error(ctrldev, ecb_ziv_dma)) {
@@ -63,6 +63,7 @@
 #include "sg_sw_sec4.h"
 #include "key_gen.h"
 #include <linux/string.h>
+#include <linux/fsl/caam.h>
 
 #define CAAM_CRA_PRIORITY		3000
 
@@ -88,6 +89,15 @@
 #define HASH_MSG_LEN			8
 #define MAX_CTX_LEN			(HASH_MSG_LEN + SHA512_DIGEST_SIZE)
 
+/*
+ * One-shot digests shorter than this many bytes are computed by a
+ * software fallback tfm. 0 sends everything to CAAM.
+ */
+static unsigned int ahash_fallback_len = 256;
+module_param(ahash_fallback_len, uint, 0644);
+MODULE_PARM_DESC(ahash_fallback_len,
+		 "Use software for digest requests below this many bytes");
+
 #ifdef DEBUG
 /* for print_hex_dumps with line references */
 #define debug(format, arg...) printk(format, arg)
@@ -114,11 +124,14 @@ struct caam_hash_ctx {
 	u32 alg_type;
 	u32 alg_op;
 	u8 key[CAAM_MAX_HASH_KEY_SIZE];
-	dma_addr_t key_dma;
 	int ctx_len;
 	unsigned int key_len;
 	unsigned int split_key_len;
 	unsigned int split_key_pad_len;
+	u8 key_in[CAAM_MAX_HASH_KEY_SIZE];	/* last HMAC key set */
+	unsigned int key_in_len;
+	bool key_cached;
+	struct crypto_ahash *fallback;
 };
 
 /* ahash state */
@@ -387,6 +400,42 @@ static inline void axcbc_data_to_out(u32 *desc, u32 op, u32 state,
 	axcbc_append_load_str(desc, digestsize);
 }
 
+/*
+ * Shared descriptors are mapped once for the lifetime of the tfm; setkey
+ * only rewrites them in place and syncs them for the device.
+ */
+static int caam_hash_map_sh_desc(struct caam_hash_ctx *ctx)
+{
+	u32 *desc[] = { ctx->sh_desc_update, ctx->sh_desc_update_first,
+			ctx->sh_desc_fin, ctx->sh_desc_digest,
+			ctx->sh_desc_finup };
+	dma_addr_t *dma[] = { &ctx->sh_desc_update_dma,
+			      &ctx->sh_desc_update_first_dma,
+			      &ctx->sh_desc_fin_dma, &ctx->sh_desc_digest_dma,
+			      &ctx->sh_desc_finup_dma };
+	struct device *jrdev = ctx->jrdev;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(desc); i++) {
+		*dma[i] = dma_map_single(jrdev, desc[i],
+					 sizeof(ctx->sh_desc_update),
+					 DMA_TO_DEVICE);
+		if (dma_mapping_error(jrdev, *dma[i])) {
+			dev_err(jrdev, "unable to map shared descriptor\n");
+			*dma[i] = 0;
+			while (--i >= 0) {
+				dma_unmap_single(jrdev, *dma[i],
+						 sizeof(ctx->sh_desc_update),
+						 DMA_TO_DEVICE);
+				*dma[i] = 0;
+			}
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
 static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 {
 	struct caam_hash_ctx *ctx = crypto_ahash_ctx(ahash);
@@ -414,12 +463,8 @@ static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 	/* Load data and write to result or context */
 	ahash_append_load_str(desc, ctx->ctx_len);
 
-	ctx->sh_desc_update_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-						 DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_update_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_update_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR,
 		       "ahash update shdesc@"__stringify(__LINE__)": ",
@@ -432,13 +477,8 @@ static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 	ahash_data_to_out(desc, have_key | ctx->alg_type, OP_ALG_AS_INIT,
 			  ctx->ctx_len, ctx);
 
-	ctx->sh_desc_update_first_dma = dma_map_single(jrdev, desc,
-						       desc_bytes(desc),
-						       DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_update_first_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_update_first_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR,
 		       "ahash update first shdesc@"__stringify(__LINE__)": ",
@@ -451,12 +491,8 @@ static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 	ahash_ctx_data_to_out(desc, have_key | ctx->alg_type,
 			      OP_ALG_AS_FINALIZE, digestsize, ctx);
 
-	ctx->sh_desc_fin_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-					      DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_fin_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_fin_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash final shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc,
@@ -469,12 +505,8 @@ static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 	ahash_ctx_data_to_out(desc, have_key | ctx->alg_type,
 			      OP_ALG_AS_FINALIZE, digestsize, ctx);
 
-	ctx->sh_desc_finup_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-						DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_finup_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_finup_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash finup shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc,
@@ -487,13 +519,8 @@ static int ahash_set_sh_desc(struct crypto_ahash *ahash)
 	ahash_data_to_out(desc, have_key | ctx->alg_type, OP_ALG_AS_INITFINAL,
 			  digestsize, ctx);
 
-	ctx->sh_desc_digest_dma = dma_map_single(jrdev, desc,
-						 desc_bytes(desc),
-						 DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_digest_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_digest_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR,
 		       "ahash digest shdesc@"__stringify(__LINE__)": ",
@@ -528,12 +555,8 @@ static int axcbc_set_sh_desc(struct crypto_ahash *ahash)
 	/* Load data and write to result or context */
 	axcbc_append_load_str(desc, ctx->ctx_len);
 
-	ctx->sh_desc_update_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-						 DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_update_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_update_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash update shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc, desc_bytes(desc), 1);
@@ -545,19 +568,12 @@ static int axcbc_set_sh_desc(struct crypto_ahash *ahash)
 	axcbc_data_to_out(desc, have_key | ctx->alg_type, OP_ALG_AS_INIT,
 			  ctx->ctx_len, ctx);
 
-	ctx->sh_desc_update_first_dma = dma_map_single(jrdev, desc,
-						       desc_bytes(desc),
-						       DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_update_first_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_update_first_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash update first shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc, desc_bytes(desc), 1);
 #endif
-	dma_sync_single_for_device(jrdev, ctx->sh_desc_update_first_dma,
-				   desc_bytes(desc), DMA_TO_DEVICE);
 
 	/* ahash_final shared descriptor */
 	desc = ctx->sh_desc_fin;
@@ -565,19 +581,13 @@ static int axcbc_set_sh_desc(struct crypto_ahash *ahash)
 	axcbc_ctx_data_to_out(desc, have_key | ctx->alg_type,
 			      OP_ALG_AS_FINALIZE, digestsize, ctx);
 
-	ctx->sh_desc_fin_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-					      DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_fin_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_fin_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash final shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc,
 		       desc_bytes(desc), 1);
 #endif
-	dma_sync_single_for_device(jrdev, ctx->sh_desc_fin_dma,
-				   desc_bytes(desc), DMA_TO_DEVICE);
 
 	/* ahash_finup shared descriptor */
 	desc = ctx->sh_desc_finup;
@@ -585,19 +595,13 @@ static int axcbc_set_sh_desc(struct crypto_ahash *ahash)
 	axcbc_ctx_data_to_out(desc, have_key | ctx->alg_type,
 			      OP_ALG_AS_FINALIZE, digestsize, ctx);
 
-	ctx->sh_desc_finup_dma = dma_map_single(jrdev, desc, desc_bytes(desc),
-						DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_finup_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_finup_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash finup shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc,
 		       desc_bytes(desc), 1);
 #endif
-	dma_sync_single_for_device(jrdev, ctx->sh_desc_finup_dma,
-				   desc_bytes(desc), DMA_TO_DEVICE);
 
 	/* ahash_digest shared descriptor */
 	desc = ctx->sh_desc_digest;
@@ -605,20 +609,13 @@ static int axcbc_set_sh_desc(struct crypto_ahash *ahash)
 	axcbc_data_to_out(desc, have_key | ctx->alg_type, OP_ALG_AS_INITFINAL,
 			  digestsize, ctx);
 
-	ctx->sh_desc_digest_dma = dma_map_single(jrdev, desc,
-						 desc_bytes(desc),
-						 DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->sh_desc_digest_dma)) {
-		dev_err(jrdev, "unable to map shared descriptor\n");
-		return -ENOMEM;
-	}
+	dma_sync_single_for_device(jrdev, ctx->sh_desc_digest_dma,
+				   desc_bytes(desc), DMA_TO_DEVICE);
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ahash digest shdesc@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc,
 		       desc_bytes(desc), 1);
 #endif
-	dma_sync_single_for_device(jrdev, ctx->sh_desc_digest_dma,
-				   desc_bytes(desc), DMA_TO_DEVICE);
 
 	return 0;
 }
@@ -712,9 +709,10 @@ static int ahash_setkey(struct crypto_ahash *ahash,
 	/* Sizes for MDHA pads (*not* keys): MD5, SHA1, 224, 256, 384, 512 */
 	static const u8 mdpadlen[] = { 16, 20, 32, 32, 64, 64 };
 	struct caam_hash_ctx *ctx = crypto_ahash_ctx(ahash);
-	struct device *jrdev = ctx->jrdev;
 	int blocksize = crypto_tfm_alg_blocksize(&ahash->base);
 	int digestsize = crypto_ahash_digestsize(ahash);
+	const u8 *orig_key = key;
+	unsigned int orig_keylen = keylen;
 	int ret;
 	u8 *hashed_key = NULL;
 
@@ -722,6 +720,21 @@ static int ahash_setkey(struct crypto_ahash *ahash,
 	printk(KERN_ERR "keylen %d\n", keylen);
 #endif
 
+	/*
+	 * Users such as IMA and dm-verity set the same key over and over;
+	 * the split key and shared descriptors built for it are still good.
+	 */
+	if (ctx->key_cached && keylen == ctx->key_in_len &&
+	    !crypto_memneq(key, ctx->key_in, keylen))
+		return 0;
+	ctx->key_cached = false;
+
+	if (ctx->fallback) {
+		ret = crypto_ahash_setkey(ctx->fallback, key, keylen);
+		if (ret)
+			return ret;
+	}
+
 	if (keylen > blocksize) {
 		hashed_key = kmalloc_array(digestsize,
 					   sizeof(*hashed_key),
@@ -751,13 +764,6 @@ static int ahash_setkey(struct crypto_ahash *ahash,
 	if (ret)
 		goto bad_free_key;
 
-	ctx->key_dma = dma_map_single(jrdev, ctx->key, ctx->split_key_pad_len,
-				      DMA_TO_DEVICE);
-	if (dma_mapping_error(jrdev, ctx->key_dma)) {
-		dev_err(jrdev, "unable to map key i/o memory\n");
-		ret = -ENOMEM;
-		goto error_free_key;
-	}
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "ctx.key@"__stringify(__LINE__)": ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, ctx->key,
@@ -765,11 +771,11 @@ static int ahash_setkey(struct crypto_ahash *ahash,
 #endif
 
 	ret = ahash_set_sh_desc(ahash);
-	if (ret) {
-		dma_unmap_single(jrdev, ctx->key_dma, ctx->split_key_pad_len,
-				 DMA_TO_DEVICE);
+	if (!ret && orig_keylen <= sizeof(ctx->key_in)) {
+		memcpy(ctx->key_in, orig_key, orig_keylen);
+		ctx->key_in_len = orig_keylen;
+		ctx->key_cached = true;
 	}
- error_free_key:
 	kfree(hashed_key);
 	return ret;
  bad_free_key:
@@ -1347,7 +1353,24 @@ static int ahash_finup_ctx(struct ahash_request *req)
 	return ret;
 }
 
-static int ahash_digest(struct ahash_request *req)
+static int ahash_digest_fallback(struct ahash_request *req)
+{
+	struct crypto_ahash *ahash = crypto_ahash_reqtfm(req);
+	struct caam_hash_ctx *ctx = crypto_ahash_ctx(ahash);
+	AHASH_REQUEST_ON_STACK(subreq, ctx->fallback);
+	int ret;
+
+	ahash_request_set_tfm(subreq, ctx->fallback);
+	ahash_request_set_callback(subreq, req->base.flags, NULL, NULL);
+	ahash_request_set_crypt(subreq, req->src, req->result, req->nbytes);
+	ret = crypto_ahash_digest(subreq);
+	ahash_request_zero(subreq);
+
+	return ret;
+}
+
+/* Build the job descriptor of a one-shot digest */
+static struct ahash_edesc *ahash_digest_edesc(struct ahash_request *req)
 {
 	struct crypto_ahash *ahash = crypto_ahash_reqtfm(req);
 	struct caam_hash_ctx *ctx = crypto_ahash_ctx(ahash);
@@ -1363,7 +1386,7 @@ static int ahash_digest(struct ahash_request *req)
 	src_nents = sg_nents_for_len(req->src, req->nbytes);
 	if (src_nents < 0) {
 		dev_err(jrdev, "Invalid number of src SG.\n");
-		return src_nents;
+		return ERR_PTR(src_nents);
 	}
 
 	if (src_nents) {
@@ -1371,7 +1394,7 @@ static int ahash_digest(struct ahash_request *req)
 					  DMA_TO_DEVICE);
 		if (!mapped_nents) {
 			dev_err(jrdev, "unable to map source for DMA\n");
-			return -ENOMEM;
+			return ERR_PTR(-ENOMEM);
 		}
 	} else {
 		mapped_nents = 0;
@@ -1383,7 +1406,7 @@ static int ahash_digest(struct ahash_request *req)
 				  flags);
 	if (!edesc) {
 		dma_unmap_sg(jrdev, req->src, src_nents, DMA_TO_DEVICE);
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 	}
 
 	edesc->src_nents = src_nents;
@@ -1393,7 +1416,7 @@ static int ahash_digest(struct ahash_request *req)
 	if (ret) {
 		ahash_unmap(jrdev, edesc, req, digestsize);
 		kfree(edesc);
-		return ret;
+		return ERR_PTR(ret);
 	}
 
 	desc = edesc->hw_desc;
@@ -1404,7 +1427,7 @@ static int ahash_digest(struct ahash_request *req)
 		dev_err(jrdev, "unable to map dst\n");
 		ahash_unmap(jrdev, edesc, req, digestsize);
 		kfree(edesc);
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 	}
 
 #ifdef DEBUG
@@ -1412,7 +1435,26 @@ static int ahash_digest(struct ahash_request *req)
 		       DUMP_PREFIX_ADDRESS, 16, 4, desc, desc_bytes(desc), 1);
 #endif
 
-	ret = caam_jr_enqueue(jrdev, desc, ahash_done, req);
+	return edesc;
+}
+
+static int ahash_digest(struct ahash_request *req)
+{
+	struct crypto_ahash *ahash = crypto_ahash_reqtfm(req);
+	struct caam_hash_ctx *ctx = crypto_ahash_ctx(ahash);
+	struct device *jrdev = ctx->jrdev;
+	int digestsize = crypto_ahash_digestsize(ahash);
+	struct ahash_edesc *edesc;
+	int ret;
+
+	if (ctx->fallback && req->nbytes < READ_ONCE(ahash_fallback_len))
+		return ahash_digest_fallback(req);
+
+	edesc = ahash_digest_edesc(req);
+	if (IS_ERR(edesc))
+		return PTR_ERR(edesc);
+
+	ret = caam_jr_enqueue(jrdev, edesc->hw_desc, ahash_done, req);
 	if (!ret) {
 		ret = -EINPROGRESS;
 	} else {
@@ -1423,6 +1465,79 @@ static int ahash_digest(struct ahash_request *req)
 	return ret;
 }
 
+static int caam_hash_cra_init(struct crypto_tfm *tfm);
+
+/**
+ * caam_ahash_digest_batch() - one-shot digests submitted as one batch
+ * @reqs:  requests, all on the same tfm of a CAAM ahash algorithm
+ * @nreqs: number of requests
+ *
+ * Builds the job descriptors of all requests and hands them to the job
+ * ring with a single doorbell write, e.g. for the data blocks of one
+ * dm-verity bio. Returns -EINPROGRESS once all requests are queued, each
+ * then completes through its own callback. On any other return value none
+ * of the requests was queued and the caller should use
+ * crypto_ahash_digest() on each; -EBUSY means the ring was too full.
+ */
+int caam_ahash_digest_batch(struct ahash_request **reqs, unsigned int nreqs)
+{
+	struct crypto_ahash *ahash;
+	struct caam_hash_ctx *ctx;
+	struct caam_jr_bklog_entry *jobs;
+	struct ahash_edesc *edesc;
+	int digestsize;
+	unsigned int i;
+	int ret = 0;
+
+	if (!nreqs)
+		return -EINVAL;
+
+	ahash = crypto_ahash_reqtfm(reqs[0]);
+	if (crypto_ahash_tfm(ahash)->__crt_alg->cra_init != caam_hash_cra_init)
+		return -ENODEV;
+
+	ctx = crypto_ahash_ctx(ahash);
+	digestsize = crypto_ahash_digestsize(ahash);
+
+	jobs = kcalloc(nreqs, sizeof(*jobs), GFP_ATOMIC);
+	if (!jobs)
+		return -ENOMEM;
+
+	for (i = 0; i < nreqs; i++) {
+		if (crypto_ahash_reqtfm(reqs[i]) != ahash) {
+			ret = -EINVAL;
+			break;
+		}
+
+		edesc = ahash_digest_edesc(reqs[i]);
+		if (IS_ERR(edesc)) {
+			ret = PTR_ERR(edesc);
+			break;
+		}
+
+		jobs[i].desc = edesc->hw_desc;
+		jobs[i].cbk = ahash_done;
+		jobs[i].cbkarg = reqs[i];
+	}
+
+	if (!ret)
+		ret = caam_jr_enqueue_batch(ctx->jrdev, jobs, nreqs);
+
+	if (ret) {
+		while (i-- > 0) {
+			edesc = container_of(jobs[i].desc, struct ahash_edesc,
+					     hw_desc[0]);
+			ahash_unmap(ctx->jrdev, edesc, reqs[i], digestsize);
+			kfree(edesc);
+		}
+	}
+
+	kfree(jobs);
+
+	return ret ? ret : -EINPROGRESS;
+}
+EXPORT_SYMBOL(caam_ahash_digest_batch);
+
 /* submit ahash final if it the first job descriptor */
 static int ahash_final_no_ctx(struct ahash_request *req)
 {
@@ -2091,6 +2206,7 @@ static int caam_hash_cra_init(struct crypto_tfm *tfm)
 					 HASH_MSG_LEN + SHA256_DIGEST_SIZE,
 					 HASH_MSG_LEN + 64,
 					 HASH_MSG_LEN + SHA512_DIGEST_SIZE };
+	int ret;
 
 	/*
 	 * Get a Job ring from Job Ring driver to ensure in-order
@@ -2110,7 +2226,25 @@ static int caam_hash_cra_init(struct crypto_tfm *tfm)
 
 	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
 				 sizeof(struct caam_hash_state));
-	return ahash_set_sh_desc(ahash);
+
+	ret = caam_hash_map_sh_desc(ctx);
+	if (ret) {
+		caam_jr_free(ctx->jrdev);
+		return ret;
+	}
+
+	ret = ahash_set_sh_desc(ahash);
+	if (ret)
+		return ret;
+
+	/* Without a software implementation everything goes to CAAM */
+	ctx->fallback = crypto_alloc_ahash(crypto_tfm_alg_name(tfm), 0,
+					   CRYPTO_ALG_ASYNC |
+					   CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		ctx->fallback = NULL;
+
+	return 0;
 }
 
 static int caam_axcbc_cra_init(struct crypto_tfm *tfm)
@@ -2143,6 +2277,12 @@ static int caam_axcbc_cra_init(struct crypto_tfm *tfm)
 	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
 				 sizeof(struct caam_hash_state));
 
+	ret = caam_hash_map_sh_desc(ctx);
+	if (ret) {
+		caam_jr_free(ctx->jrdev);
+		return ret;
+	}
+
 	ret = axcbc_set_sh_desc(ahash);
 
 	return ret;
@@ -2155,27 +2295,29 @@ static void caam_hash_cra_exit(struct crypto_tfm *tfm)
 	if (ctx->sh_desc_update_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_update_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_update_dma,
-				 desc_bytes(ctx->sh_desc_update),
+				 sizeof(ctx->sh_desc_update),
 				 DMA_TO_DEVICE);
 	if (ctx->sh_desc_update_first_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_update_first_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_update_first_dma,
-				 desc_bytes(ctx->sh_desc_update_first),
+				 sizeof(ctx->sh_desc_update_first),
 				 DMA_TO_DEVICE);
 	if (ctx->sh_desc_fin_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_fin_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_fin_dma,
-				 desc_bytes(ctx->sh_desc_fin), DMA_TO_DEVICE);
+				 sizeof(ctx->sh_desc_fin), DMA_TO_DEVICE);
 	if (ctx->sh_desc_digest_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_digest_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_digest_dma,
-				 desc_bytes(ctx->sh_desc_digest),
+				 sizeof(ctx->sh_desc_digest),
 				 DMA_TO_DEVICE);
 	if (ctx->sh_desc_finup_dma &&
 	    !dma_mapping_error(ctx->jrdev, ctx->sh_desc_finup_dma))
 		dma_unmap_single(ctx->jrdev, ctx->sh_desc_finup_dma,
-				 desc_bytes(ctx->sh_desc_finup), DMA_TO_DEVICE);
+				 sizeof(ctx->sh_desc_finup), DMA_TO_DEVICE);
 
+	if (ctx->fallback)
+		crypto_free_ahash(ctx->fallback);
 	caam_jr_free(ctx->jrdev);
 }
 
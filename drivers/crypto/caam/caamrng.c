@@ -26,14 +26,22 @@
  * | (output buffer)   |
  * ---------------------
  *
- * The SharedDesc never changes, and each job descriptor points to one of two
- * buffers for each device, from which the data will be copied into the
- * requested destination
+ * The SharedDesc never changes, and each job descriptor points to one of
+ * rng_bufs buffers for each device, from which the data will be copied into
+ * the requested destination. A buffer is refilled as soon as it has been
+ * drained, so up to rng_bufs - 1 full buffers are ready for a reader.
+ *
+ * The same buffers back both the hwrng and a crypto_rng ("stdrng",
+ * "rng-caam"), so kernel users can pull large amounts of random data
+ * without going through hwrng's small reads.
  */
 
 #include <linux/hw_random.h>
 #include <linux/completion.h>
 #include <linux/atomic.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <crypto/internal/rng.h>
 
 #include "compat.h"
 
@@ -54,6 +62,13 @@
 #define DESC_JOB_O_LEN			(CAAM_CMD_SZ * 2 + CAAM_PTR_SZ * 2)
 #define DESC_RNG_LEN			(4 * CAAM_CMD_SZ)
 
+#define RNG_BUFS_MIN			2
+#define RNG_BUFS_MAX			8
+
+static unsigned int rng_bufs = 4;
+module_param(rng_bufs, uint, 0444);
+MODULE_PARM_DESC(rng_bufs, "Number of prefetched random buffers (2-8)");
+
 /* Buffer, its dma address and lock */
 struct buf_data {
 	u8 buf[RN_BUF_SIZE] ____cacheline_aligned;
@@ -73,7 +88,10 @@ struct caam_rng_ctx {
 	u32 sh_desc[DESC_RNG_LEN];
 	unsigned int cur_buf_idx;
 	int current_buf;
-	struct buf_data bufs[2];
+	unsigned int nbufs;
+	struct mutex lock;		/* readers and refill_work */
+	struct delayed_work refill_work; /* resubmits after a full ring */
+	struct buf_data *bufs[RNG_BUFS_MAX];
 };
 
 static struct caam_rng_ctx *rng_ctx;
@@ -91,12 +109,14 @@ static inline void rng_unmap_buf(struct device *jrdev, struct buf_data *bd)
 static inline void rng_unmap_ctx(struct caam_rng_ctx *ctx)
 {
 	struct device *jrdev = ctx->jrdev;
+	int i;
 
 	if (ctx->sh_desc_dma)
 		dma_unmap_single(jrdev, ctx->sh_desc_dma,
 				 desc_bytes(ctx->sh_desc), DMA_TO_DEVICE);
-	rng_unmap_buf(jrdev, &ctx->bufs[0]);
-	rng_unmap_buf(jrdev, &ctx->bufs[1]);
+	for (i = 0; i < ctx->nbufs; i++)
+		if (ctx->bufs[i])
+			rng_unmap_buf(jrdev, ctx->bufs[i]);
 }
 
 static void rng_done(struct device *jrdev, u32 *desc, u32 err, void *context)
@@ -109,40 +129,60 @@ static void rng_done(struct device *jrdev, u32 *desc, u32 err, void *context)
 	if (err)
 		caam_jr_strstatus(jrdev, err);
 
+	/* Buffer refilled, invalidate cache before anyone reads it */
+	dma_sync_single_for_cpu(jrdev, bd->addr, RN_BUF_SIZE, DMA_FROM_DEVICE);
+
 	atomic_set(&bd->empty, BUF_NOT_EMPTY);
 	complete(&bd->filled);
 
-	/* Buffer refilled, invalidate cache */
-	dma_sync_single_for_cpu(jrdev, bd->addr, RN_BUF_SIZE, DMA_FROM_DEVICE);
-
 #ifdef DEBUG
 	print_hex_dump(KERN_ERR, "rng refreshed buf@: ",
 		       DUMP_PREFIX_ADDRESS, 16, 4, bd->buf, RN_BUF_SIZE, 1);
 #endif
 }
 
-static inline int submit_job(struct caam_rng_ctx *ctx, int to_current)
+/* Start refilling buffer @buf_id, ctx->lock held */
+static inline int submit_job(struct caam_rng_ctx *ctx, int buf_id)
 {
-	struct buf_data *bd = &ctx->bufs[!(to_current ^ ctx->current_buf)];
+	struct buf_data *bd = ctx->bufs[buf_id];
 	struct device *jrdev = ctx->jrdev;
 	u32 *desc = bd->hw_desc;
 	int err;
 
-	dev_dbg(jrdev, "submitting job %d\n", !(to_current ^ ctx->current_buf));
+	dev_dbg(jrdev, "submitting job %d\n", buf_id);
 	init_completion(&bd->filled);
 	err = caam_jr_enqueue(jrdev, desc, rng_done, ctx);
-	if (err)
+	if (err) {
 		complete(&bd->filled); /* don't wait on failed job*/
-	else
+		schedule_delayed_work(&ctx->refill_work, 1);
+	} else {
 		atomic_inc(&bd->empty); /* note if pending */
+	}
 
 	return err;
 }
 
-static int caam_read(struct hwrng *rng, void *data, size_t max, bool wait)
+static void caam_rng_refill(struct work_struct *work)
 {
-	struct caam_rng_ctx *ctx = rng_ctx;
-	struct buf_data *bd = &ctx->bufs[ctx->current_buf];
+	struct caam_rng_ctx *ctx = container_of(to_delayed_work(work),
+						struct caam_rng_ctx,
+						refill_work);
+	int i;
+
+	mutex_lock(&ctx->lock);
+	for (i = 0; i < ctx->nbufs; i++) {
+		if (atomic_read(&ctx->bufs[i]->empty) == BUF_EMPTY &&
+		    submit_job(ctx, i))
+			break;
+	}
+	mutex_unlock(&ctx->lock);
+}
+
+/* Copy out up to @max bytes of random data, ctx->lock held */
+static int __caam_read(struct caam_rng_ctx *ctx, void *data, size_t max,
+		       bool wait)
+{
+	struct buf_data *bd = ctx->bufs[ctx->current_buf];
 	int next_buf_idx, copied_idx;
 	int err;
 
@@ -181,15 +221,57 @@ static int caam_read(struct hwrng *rng, void *data, size_t max, bool wait)
 	atomic_set(&bd->empty, BUF_EMPTY);
 
 	/* ...refill... */
-	submit_job(ctx, 1);
+	submit_job(ctx, ctx->current_buf);
 
 	/* and use next buffer */
-	ctx->current_buf = !ctx->current_buf;
+	ctx->current_buf = (ctx->current_buf + 1) % ctx->nbufs;
 	dev_dbg(ctx->jrdev, "switched to buffer %d\n", ctx->current_buf);
 
 	/* since there already is some data read, don't wait */
-	return copied_idx + caam_read(rng, data + copied_idx,
-				      max - copied_idx, false);
+	return copied_idx + __caam_read(ctx, data + copied_idx,
+					max - copied_idx, false);
+}
+
+static int caam_read(struct hwrng *rng, void *data, size_t max, bool wait)
+{
+	struct caam_rng_ctx *ctx = rng_ctx;
+	int ret;
+
+	mutex_lock(&ctx->lock);
+	ret = __caam_read(ctx, data, max, wait);
+	mutex_unlock(&ctx->lock);
+
+	return ret;
+}
+
+static int caam_rng_generate(struct crypto_rng *tfm, const u8 *src,
+			     unsigned int slen, u8 *dst, unsigned int dlen)
+{
+	struct caam_rng_ctx *ctx = rng_ctx;
+	int ret = 0;
+	int len;
+
+	mutex_lock(&ctx->lock);
+	while (dlen) {
+		len = __caam_read(ctx, dst, dlen, true);
+		if (!len) {
+			/* ring full, refill_work will retry the job */
+			ret = -EAGAIN;
+			break;
+		}
+		dst += len;
+		dlen -= len;
+	}
+	mutex_unlock(&ctx->lock);
+
+	return ret;
+}
+
+/* The RNG is seeded by its own TRNG, there is nothing to mix in */
+static int caam_rng_seed(struct crypto_rng *tfm, const u8 *seed,
+			 unsigned int slen)
+{
+	return 0;
 }
 
 static inline int rng_create_sh_desc(struct caam_rng_ctx *ctx)
@@ -227,7 +309,7 @@ static inline int rng_create_sh_desc(struct caam_rng_ctx *ctx)
 static inline int rng_create_job_desc(struct caam_rng_ctx *ctx, int buf_id)
 {
 	struct device *jrdev = ctx->jrdev;
-	struct buf_data *bd = &ctx->bufs[buf_id];
+	struct buf_data *bd = ctx->bufs[buf_id];
 	u32 *desc = bd->hw_desc;
 	int sh_len = desc_len(ctx->sh_desc);
 
@@ -248,18 +330,27 @@ static inline int rng_create_job_desc(struct caam_rng_ctx *ctx, int buf_id)
 	return 0;
 }
 
-static void caam_cleanup(struct hwrng *rng)
+/*
+ * The buffers are shared with the crypto_rng, so they are only torn down
+ * on module exit, not from the hwrng cleanup hook.
+ */
+static void caam_cleanup(struct caam_rng_ctx *ctx)
 {
 	int i;
 	struct buf_data *bd;
 
-	for (i = 0; i < 2; i++) {
-		bd = &rng_ctx->bufs[i];
-		if (atomic_read(&bd->empty) == BUF_PENDING)
+	cancel_delayed_work_sync(&ctx->refill_work);
+
+	for (i = 0; i < ctx->nbufs; i++) {
+		bd = ctx->bufs[i];
+		if (bd && atomic_read(&bd->empty) == BUF_PENDING)
 			wait_for_completion(&bd->filled);
 	}
 
-	rng_unmap_ctx(rng_ctx);
+	rng_unmap_ctx(ctx);
+
+	for (i = 0; i < ctx->nbufs; i++)
+		kfree(ctx->bufs[i]);
 }
 
 #ifdef CONFIG_CRYPTO_DEV_FSL_CAAM_RNG_TEST
@@ -307,15 +398,22 @@ static void self_test(struct hwrng *rng)
 
 static int caam_init_buf(struct caam_rng_ctx *ctx, int buf_id)
 {
-	struct buf_data *bd = &ctx->bufs[buf_id];
+	struct buf_data *bd;
 	int err;
 
+	bd = kzalloc(sizeof(*bd), GFP_KERNEL | GFP_DMA);
+	if (!bd)
+		return -ENOMEM;
+	ctx->bufs[buf_id] = bd;
+
 	err = rng_create_job_desc(ctx, buf_id);
 	if (err)
 		return err;
 
 	atomic_set(&bd->empty, BUF_EMPTY);
-	submit_job(ctx, buf_id == ctx->current_buf);
+	mutex_lock(&ctx->lock);
+	submit_job(ctx, buf_id);
+	mutex_unlock(&ctx->lock);
 	wait_for_completion(&bd->filled);
 
 	return 0;
@@ -324,8 +422,13 @@ static int caam_init_buf(struct caam_rng_ctx *ctx, int buf_id)
 static int caam_init_rng(struct caam_rng_ctx *ctx, struct device *jrdev)
 {
 	int err;
+	int i;
 
 	ctx->jrdev = jrdev;
+	ctx->nbufs = clamp_t(unsigned int, rng_bufs, RNG_BUFS_MIN,
+			     RNG_BUFS_MAX);
+	mutex_init(&ctx->lock);
+	INIT_DELAYED_WORK(&ctx->refill_work, caam_rng_refill);
 
 	err = rng_create_sh_desc(ctx);
 	if (err)
@@ -334,28 +437,43 @@ static int caam_init_rng(struct caam_rng_ctx *ctx, struct device *jrdev)
 	ctx->current_buf = 0;
 	ctx->cur_buf_idx = 0;
 
-	err = caam_init_buf(ctx, 0);
-	if (err)
-		return err;
-
-	err = caam_init_buf(ctx, 1);
-	if (err)
-		return err;
+	for (i = 0; i < ctx->nbufs; i++) {
+		err = caam_init_buf(ctx, i);
+		if (err) {
+			caam_cleanup(ctx);
+			return err;
+		}
+	}
 
 	return 0;
 }
 
 static struct hwrng caam_rng = {
 	.name		= "rng-caam",
-	.cleanup	= caam_cleanup,
 	.read		= caam_read,
 	.quality	= 1024,
 };
 
+static struct rng_alg caam_rng_alg = {
+	.generate		= caam_rng_generate,
+	.seed			= caam_rng_seed,
+	.seedsize		= 0,
+	.base			= {
+		.cra_name		= "stdrng",
+		.cra_driver_name	= "rng-caam",
+		/* below the DRBGs, which remain the default stdrng */
+		.cra_priority		= 100,
+		.cra_ctxsize		= 0,
+		.cra_module		= THIS_MODULE,
+	},
+};
+
 static void __exit caam_rng_exit(void)
 {
-	caam_jr_free(rng_ctx->jrdev);
+	crypto_unregister_rng(&caam_rng_alg);
 	hwrng_unregister(&caam_rng);
+	caam_cleanup(rng_ctx);
+	caam_jr_free(rng_ctx->jrdev);
 	kfree(rng_ctx);
 }
 
@@ -401,7 +519,7 @@ static int __init caam_rng_init(void)
 		pr_err("Job Ring Device allocation for transform failed\n");
 		return PTR_ERR(dev);
 	}
-	rng_ctx = kmalloc(sizeof(*rng_ctx), GFP_DMA);
+	rng_ctx = kzalloc(sizeof(*rng_ctx), GFP_KERNEL | GFP_DMA);
 	if (!rng_ctx) {
 		err = -ENOMEM;
 		goto free_caam_alloc;
@@ -418,9 +536,21 @@ static int __init caam_rng_init(void)
 	self_test(&caam_rng);
 #endif
 
-	dev_info(dev, "registering rng-caam\n");
-	return hwrng_register(&caam_rng);
+	dev_info(dev, "registering rng-caam with %u buffers\n", rng_ctx->nbufs);
+	err = hwrng_register(&caam_rng);
+	if (err)
+		goto free_rng;
+
+	err = crypto_register_rng(&caam_rng_alg);
+	if (err) {
+		hwrng_unregister(&caam_rng);
+		goto free_rng;
+	}
+
+	return 0;
 
+free_rng:
+	caam_cleanup(rng_ctx);
 free_rng_ctx:
 	kfree(rng_ctx);
 free_caam_alloc:
@@ -324,6 +324,7 @@ static int caam_remove(struct platform_device *pdev)
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove_recursive(ctrlpriv->dfs_root);
 #endif
+	caam_pmu_exit(ctrlpriv);
 
 	/* Unmap controller region */
 	iounmap(ctrl);
@@ -851,6 +852,9 @@ static int caam_probe(struct platform_device *pdev)
 	dev_info(dev, "job rings = %d, qi = %d\n",
 		 ctrlpriv->total_jobrs, ctrlpriv->qi_present);
 
+	/* Controller-level performance monitor counters, through perf */
+	caam_pmu_init(ctrlpriv);
+
 #ifdef CONFIG_DEBUG_FS
 	/*
 	 * FIXME: needs better naming distinction, as some amalgamation of
@@ -53,6 +53,9 @@ struct caam_drv_private_jr {
 	int inp_ring_write_index;	/* Input index "tail" */
 	int head;			/* entinfo (s/w ring) head index */
 	dma_addr_t *inpring;	/* Base of input ring, alloc DMA-safe */
+	struct list_head bklog;	/* Jobs waiting for ring space, inplock */
+	int bklog_cnt;		/* Number of jobs on bklog */
+	int db_pending;		/* Jobs in the ring not yet announced */
 	spinlock_t outlock ____cacheline_aligned; /* Output ring index lock */
 	int out_ring_read_index;	/* Output index "tail" */
 	int tail;			/* entinfo (s/w ring) tail index */
@@ -104,6 +107,10 @@ struct caam_drv_private {
 	struct clk *caam_aclk;
 	struct clk *caam_emi_slow;
 
+#ifdef CONFIG_PERF_EVENTS
+	struct caam_pmu *pmu;	/* perf view of the performance counters */
+#endif
+
 	/*
 	 * debugfs entries for developer view into driver/device
 	 * variables at runtime.
@@ -123,4 +130,18 @@ struct caam_drv_private {
 
 void caam_jr_algapi_init(struct device *dev);
 void caam_jr_algapi_remove(struct device *dev);
+
+#ifdef CONFIG_PERF_EVENTS
+int caam_pmu_init(struct caam_drv_private *ctrlpriv);
+void caam_pmu_exit(struct caam_drv_private *ctrlpriv);
+#else
+static inline int caam_pmu_init(struct caam_drv_private *ctrlpriv)
+{
+	return 0;
+}
+
+static inline void caam_pmu_exit(struct caam_drv_private *ctrlpriv)
+{
+}
+#endif
 #endif /* INTERN_H */
@@ -7,6 +7,7 @@
 
 #include <linux/of_irq.h>
 #include <linux/of_address.h>
+#include <linux/rculist.h>
 
 #include "compat.h"
 #include "regs.h"
@@ -14,6 +15,9 @@
 #include "desc.h"
 #include "intern.h"
 
+#define CREATE_TRACE_POINTS
+#include "caam_trace.h"
+
 struct jr_driver_data {
 	/* List of Physical JobR's with the Driver */
 	struct list_head	jr_list;
@@ -22,6 +26,16 @@ struct jr_driver_data {
 
 static struct jr_driver_data driver_data;
 
+static bool jr_dispatch = true;
+module_param(jr_dispatch, bool, 0644);
+MODULE_PARM_DESC(jr_dispatch,
+		 "Spread requests of a tfm over all job rings (default: on)");
+
+static int jr_doorbell_batch = 8;
+module_param(jr_doorbell_batch, int, 0644);
+MODULE_PARM_DESC(jr_doorbell_batch,
+		 "Jobs held back while a ring is busy before CAAM is told (default: 8, 1: off)");
+
 static int caam_reset_hw_jr(struct device *dev)
 {
 	struct caam_drv_private_jr *jrp = dev_get_drvdata(dev);
@@ -74,6 +88,7 @@ static int caam_jr_shutdown(struct device *dev)
 	ret = caam_reset_hw_jr(dev);
 
 	/* Release interrupt */
+	irq_set_affinity_hint(jrp->irq, NULL);
 	free_irq(jrp->irq, dev);
 
 	/* Free rings */
@@ -107,8 +122,10 @@ static int caam_jr_remove(struct platform_device *pdev)
 
 	/* Remove the node from Physical JobR list maintained by driver */
 	spin_lock(&driver_data.jr_alloc_lock);
-	list_del(&jrpriv->list_node);
+	list_del_rcu(&jrpriv->list_node);
 	spin_unlock(&driver_data.jr_alloc_lock);
+	/* wait for caam_jr_pick() walkers */
+	synchronize_rcu();
 
 	/* Release ring */
 	ret = caam_jr_shutdown(jrdev);
@@ -153,6 +170,129 @@ static irqreturn_t caam_jr_interrupt(int irq, void *st_dev)
 	return IRQ_WAKE_THREAD;
 }
 
+/* Number of jobs the input ring can take right now */
+static int caam_jr_ring_space(struct caam_drv_private_jr *jrp)
+{
+	int head = jrp->head;
+	int tail = ACCESS_ONCE(jrp->tail);
+
+	return min_t(int, rd_reg32(&jrp->rregs->inpring_avail),
+		     CIRC_SPACE(head, tail, JOBR_DEPTH));
+}
+
+static bool caam_jr_ring_full(struct caam_drv_private_jr *jrp)
+{
+	return caam_jr_ring_space(jrp) <= 0;
+}
+
+/*
+ * Post an already mapped job to the input ring, inplock held. CAAM only
+ * sees it after caam_jr_ring_doorbell().
+ */
+static void caam_jr_add_job(struct caam_drv_private_jr *jrp, u32 *desc,
+			    dma_addr_t desc_dma, int desc_size,
+			    void (*cbk)(struct device *dev, u32 *desc,
+					u32 status, void *areq),
+			    void *areq)
+{
+	struct caam_jrentry_info *head_entry;
+	int head = jrp->head;
+
+	head_entry = &jrp->entinfo[head];
+	head_entry->desc_addr_virt = desc;
+	head_entry->desc_size = desc_size;
+	head_entry->callbk = (void *)cbk;
+	head_entry->cbkarg = areq;
+	head_entry->desc_addr_dma = desc_dma;
+
+	jrp->inpring[jrp->inp_ring_write_index] = cpu_to_caam_dma(desc_dma);
+
+	/*
+	 * Guarantee that the descriptor's DMA address has been written to
+	 * the next slot in the ring before the write index is updated, since
+	 * other cores may update this index independently.
+	 */
+	smp_wmb();
+
+	jrp->inp_ring_write_index = (jrp->inp_ring_write_index + 1) &
+				    (JOBR_DEPTH - 1);
+	jrp->head = (head + 1) & (JOBR_DEPTH - 1);
+
+	trace_caam_jr_enqueue(jrp->dev, jrp->ridx, desc_dma,
+			      CIRC_CNT(jrp->head, READ_ONCE(jrp->tail),
+				       JOBR_DEPTH),
+			      jrp->bklog_cnt, 0);
+}
+
+/* Tell CAAM about @njobs jobs added to the input ring, inplock held */
+static void caam_jr_ring_doorbell(struct caam_drv_private_jr *jrp, int njobs)
+{
+	/*
+	 * Ensure that all job information has been written before
+	 * notifying CAAM that new jobs were added to the input ring.
+	 */
+	wmb();
+
+	wr_reg32(&jrp->rregs->inpring_jobadd, njobs);
+}
+
+/*
+ * Announce @njobs jobs just added to the input ring, inplock held. While
+ * CAAM still has announced jobs to run, new ones are held back until
+ * jr_doorbell_batch of them have gathered or the completion thread
+ * flushes them, so a burst of requests costs one register write.
+ */
+static void caam_jr_kick(struct caam_drv_private_jr *jrp, int njobs)
+{
+	int inflight;
+
+	jrp->db_pending += njobs;
+	inflight = CIRC_CNT(jrp->head, READ_ONCE(jrp->tail), JOBR_DEPTH) -
+		   jrp->db_pending;
+
+	if (inflight > 0 && jrp->db_pending < READ_ONCE(jr_doorbell_batch))
+		return;
+
+	caam_jr_ring_doorbell(jrp, jrp->db_pending);
+	jrp->db_pending = 0;
+}
+
+/*
+ * Move backlogged jobs into the input ring as far as it has room, announce
+ * them along with any held back jobs, then tell their owners the requests
+ * are now in progress.
+ */
+static void caam_jr_dequeue_bklog(struct caam_drv_private_jr *jrp)
+{
+	struct caam_jr_bklog_entry *bklog, *tmp;
+	LIST_HEAD(moved);
+	int space, njobs = 0;
+
+	spin_lock_bh(&jrp->inplock);
+	space = caam_jr_ring_space(jrp);
+	while (!list_empty(&jrp->bklog) && njobs < space) {
+		bklog = list_first_entry(&jrp->bklog,
+					 struct caam_jr_bklog_entry, list);
+		list_move_tail(&bklog->list, &moved);
+		jrp->bklog_cnt--;
+		caam_jr_add_job(jrp, bklog->desc, bklog->desc_dma,
+				bklog->desc_size, bklog->cbk, bklog->cbkarg);
+		njobs++;
+	}
+	njobs += jrp->db_pending;
+	jrp->db_pending = 0;
+	if (njobs)
+		caam_jr_ring_doorbell(jrp, njobs);
+	spin_unlock_bh(&jrp->inplock);
+
+	/*
+	 * Completions are only run from this thread, so none of the moved
+	 * jobs can have finished (and freed its entry) yet.
+	 */
+	list_for_each_entry_safe(bklog, tmp, &moved, list)
+		bklog->req->complete(bklog->req, -EINPROGRESS);
+}
+
 static irqreturn_t caam_jr_threadirq(int irq, void *st_dev)
 {
 	int hw_idx, sw_idx, i, head, tail;
@@ -160,8 +300,16 @@ static irqreturn_t caam_jr_threadirq(int irq, void *st_dev)
 	struct caam_drv_private_jr *jrp = dev_get_drvdata(dev);
 	void (*usercall)(struct device *dev, u32 *desc, u32 status, void *arg);
 	u32 *userdesc, userstatus;
+	dma_addr_t userdma;
 	void *userarg;
 
+	/*
+	 * Run the callbacks like a NAPI poll: with BHs off, packets that
+	 * users such as IPsec hand to the stack are gathered and handled in
+	 * one softirq pass once the ring has been drained.
+	 */
+	local_bh_disable();
+
 	while (rd_reg32(&jrp->rregs->outring_used)) {
 
 		head = ACCESS_ONCE(jrp->head);
@@ -194,6 +342,7 @@ static irqreturn_t caam_jr_threadirq(int irq, void *st_dev)
 		userarg = jrp->entinfo[sw_idx].cbkarg;
 		userdesc = jrp->entinfo[sw_idx].desc_addr_virt;
 		userstatus = caam32_to_cpu(jrp->outring[hw_idx].jrstatus);
+		userdma = caam_dma_to_cpu(jrp->outring[hw_idx].desc);
 
 		/*
 		 * Make sure all information from the job has been obtained
@@ -224,10 +373,27 @@ static irqreturn_t caam_jr_threadirq(int irq, void *st_dev)
 
 		spin_unlock(&jrp->outlock);
 
+		trace_caam_jr_done(dev, jrp->ridx, userdma,
+				   CIRC_CNT(head, tail, JOBR_DEPTH),
+				   READ_ONCE(jrp->bklog_cnt), userstatus);
+
 		/* Finally, execute user's callback */
 		usercall(dev, userdesc, userstatus, userarg);
+
+		/* refill the slot we just freed, announce held back jobs */
+		if (!list_empty(&jrp->bklog) || READ_ONCE(jrp->db_pending))
+			caam_jr_dequeue_bklog(jrp);
 	}
 
+	/*
+	 * Catch requests backlogged or held back while the last jobs
+	 * completed. This takes inplock after the tail update above, so a
+	 * job held back against a stale tail is always announced here.
+	 */
+	caam_jr_dequeue_bklog(jrp);
+
+	local_bh_enable();
+
 	/* reenable / unmask IRQs */
 	clrsetbits_32(&jrp->rregs->rconfig_lo, JRCFG_IMSK, 0);
 
@@ -274,6 +440,47 @@ struct device *caam_jr_alloc(void)
 }
 EXPORT_SYMBOL(caam_jr_alloc);
 
+/* Jobs in flight or waiting on a ring, sampled without locking */
+static int caam_jr_load(struct caam_drv_private_jr *jrp)
+{
+	return CIRC_CNT(READ_ONCE(jrp->head), READ_ONCE(jrp->tail),
+			JOBR_DEPTH) + READ_ONCE(jrp->bklog_cnt);
+}
+
+/**
+ * caam_jr_pick() - Pick the job ring to run a single request on.
+ * @dev     - job ring allocated to the tfm by caam_jr_alloc().
+ *
+ * Returns the least occupied job ring, @dev on ties, so that one busy
+ * tfm does not keep a single ring hot while the others idle. All job
+ * rings sit behind the same controller, so descriptors mapped for @dev
+ * are valid on any of them; per-request buffers must be mapped for the
+ * returned ring.
+ **/
+struct device *caam_jr_pick(struct device *dev)
+{
+	struct caam_drv_private_jr *jrp = dev_get_drvdata(dev);
+	struct caam_drv_private_jr *jrpriv, *best = jrp;
+	int load, min_load;
+
+	min_load = caam_jr_load(jrp);
+	if (!jr_dispatch || !min_load)
+		return dev;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(jrpriv, &driver_data.jr_list, list_node) {
+		load = caam_jr_load(jrpriv);
+		if (load < min_load) {
+			min_load = load;
+			best = jrpriv;
+		}
+	}
+	rcu_read_unlock();
+
+	return best->dev;
+}
+EXPORT_SYMBOL(caam_jr_pick);
+
 /**
  * caam_jr_free() - Free the Job Ring
  * @rdev     - points to the dev that identifies the Job ring to
@@ -318,10 +525,36 @@ int caam_jr_enqueue(struct device *dev, u32 *desc,
 		    void (*cbk)(struct device *dev, u32 *desc,
 				u32 status, void *areq),
 		    void *areq)
+{
+	return caam_jr_enqueue_bklog(dev, desc, cbk, areq, NULL, NULL);
+}
+EXPORT_SYMBOL(caam_jr_enqueue);
+
+/**
+ * caam_jr_enqueue_bklog() - Enqueue a job descriptor head on behalf of a
+ * crypto request, honouring CRYPTO_TFM_REQ_MAY_BACKLOG.
+ * @dev:   device of the job ring to be used.
+ * @desc:  job descriptor, as for caam_jr_enqueue().
+ * @cbk:   completion callback, as for caam_jr_enqueue().
+ * @areq:  user argument for @cbk.
+ * @bklog: storage for the backlog entry, must live until @cbk runs.
+ * @req:   crypto request the job belongs to, or NULL if it never
+ *         backlogs.
+ *
+ * Returns 0 if the job is in the ring, -EIO if it cannot map the
+ * descriptor and -EBUSY if the ring is full. For a request that may
+ * backlog, -EBUSY means the job has been queued in software instead;
+ * it is moved to the ring as slots free up and @req is then completed
+ * with -EINPROGRESS, followed by the normal completion through @cbk.
+ **/
+int caam_jr_enqueue_bklog(struct device *dev, u32 *desc,
+			  void (*cbk)(struct device *dev, u32 *desc,
+				      u32 status, void *areq),
+			  void *areq, struct caam_jr_bklog_entry *bklog,
+			  struct crypto_async_request *req)
 {
 	struct caam_drv_private_jr *jrp = dev_get_drvdata(dev);
-	struct caam_jrentry_info *head_entry;
-	int head, tail, desc_size;
+	int desc_size;
 	dma_addr_t desc_dma;
 
 	desc_size = (caam32_to_cpu(*desc) & HDR_JD_LENGTH_MASK) * sizeof(u32);
@@ -333,49 +566,91 @@ int caam_jr_enqueue(struct device *dev, u32 *desc,
 
 	spin_lock_bh(&jrp->inplock);
 
-	head = jrp->head;
-	tail = ACCESS_ONCE(jrp->tail);
+	/* keep backlogged requests ahead of new ones */
+	if (!list_empty(&jrp->bklog) || caam_jr_ring_full(jrp)) {
+		if (req && (req->flags & CRYPTO_TFM_REQ_MAY_BACKLOG)) {
+			bklog->desc = desc;
+			bklog->desc_dma = desc_dma;
+			bklog->desc_size = desc_size;
+			bklog->cbk = cbk;
+			bklog->cbkarg = areq;
+			bklog->req = req;
+			list_add_tail(&bklog->list, &jrp->bklog);
+			jrp->bklog_cnt++;
+			spin_unlock_bh(&jrp->inplock);
+			return -EBUSY;
+		}
 
-	if (!rd_reg32(&jrp->rregs->inpring_avail) ||
-	    CIRC_SPACE(head, tail, JOBR_DEPTH) <= 0) {
 		spin_unlock_bh(&jrp->inplock);
 		dma_unmap_single(dev, desc_dma, desc_size, DMA_TO_DEVICE);
 		return -EBUSY;
 	}
 
-	head_entry = &jrp->entinfo[head];
-	head_entry->desc_addr_virt = desc;
-	head_entry->desc_size = desc_size;
-	head_entry->callbk = (void *)cbk;
-	head_entry->cbkarg = areq;
-	head_entry->desc_addr_dma = desc_dma;
+	caam_jr_add_job(jrp, desc, desc_dma, desc_size, cbk, areq);
+	caam_jr_kick(jrp, 1);
 
-	jrp->inpring[jrp->inp_ring_write_index] = cpu_to_caam_dma(desc_dma);
+	spin_unlock_bh(&jrp->inplock);
 
-	/*
-	 * Guarantee that the descriptor's DMA address has been written to
-	 * the next slot in the ring before the write index is updated, since
-	 * other cores may update this index independently.
-	 */
-	smp_wmb();
+	return 0;
+}
+EXPORT_SYMBOL(caam_jr_enqueue_bklog);
 
-	jrp->inp_ring_write_index = (jrp->inp_ring_write_index + 1) &
-				    (JOBR_DEPTH - 1);
-	jrp->head = (head + 1) & (JOBR_DEPTH - 1);
+/**
+ * caam_jr_enqueue_batch() - Enqueue several job descriptors with a single
+ * doorbell write.
+ * @dev:   device of the job ring to be used.
+ * @jobs:  the jobs; desc, cbk and cbkarg of each entry must be set, the
+ *         rest is filled in here. The array may be freed on return.
+ * @njobs: number of entries in @jobs.
+ *
+ * Returns 0 if all jobs are in the ring, -EIO if a descriptor cannot be
+ * mapped and -EBUSY if the ring has no room for all of them. Nothing is
+ * enqueued on error; batches never go to the software backlog.
+ **/
+int caam_jr_enqueue_batch(struct device *dev, struct caam_jr_bklog_entry *jobs,
+			  int njobs)
+{
+	struct caam_drv_private_jr *jrp = dev_get_drvdata(dev);
+	int i, ret = 0;
+
+	for (i = 0; i < njobs; i++) {
+		jobs[i].desc_size = (caam32_to_cpu(*jobs[i].desc) &
+				     HDR_JD_LENGTH_MASK) * sizeof(u32);
+		jobs[i].desc_dma = dma_map_single(dev, jobs[i].desc,
+						  jobs[i].desc_size,
+						  DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, jobs[i].desc_dma)) {
+			dev_err(dev, "%s: can't map jobdesc\n", __func__);
+			ret = -EIO;
+			goto unmap;
+		}
+	}
 
-	/*
-	 * Ensure that all job information has been written before
-	 * notifying CAAM that a new job was added to the input ring.
-	 */
-	wmb();
+	spin_lock_bh(&jrp->inplock);
 
-	wr_reg32(&jrp->rregs->inpring_jobadd, 1);
+	if (!list_empty(&jrp->bklog) || caam_jr_ring_space(jrp) < njobs) {
+		spin_unlock_bh(&jrp->inplock);
+		ret = -EBUSY;
+		goto unmap;
+	}
+
+	for (i = 0; i < njobs; i++)
+		caam_jr_add_job(jrp, jobs[i].desc, jobs[i].desc_dma,
+				jobs[i].desc_size, jobs[i].cbk,
+				jobs[i].cbkarg);
+	caam_jr_kick(jrp, njobs);
 
 	spin_unlock_bh(&jrp->inplock);
 
 	return 0;
+
+unmap:
+	while (--i >= 0)
+		dma_unmap_single(dev, jobs[i].desc_dma, jobs[i].desc_size,
+				 DMA_TO_DEVICE);
+	return ret;
 }
-EXPORT_SYMBOL(caam_jr_enqueue);
+EXPORT_SYMBOL(caam_jr_enqueue_batch);
 
 /*
  * Init JobR independent of platform property detection
@@ -398,6 +673,11 @@ static int caam_jr_init(struct device *dev)
 		goto out_kill_deq;
 	}
 
+	/* give every ring, and its threaded handler, a core of its own */
+	irq_set_affinity_hint(jrp->irq,
+			      get_cpu_mask(cpumask_local_spread(jrp->ridx,
+								NUMA_NO_NODE)));
+
 	error = caam_reset_hw_jr(dev);
 	if (error)
 		goto out_free_irq;
@@ -435,6 +715,9 @@ static int caam_jr_init(struct device *dev)
 
 	spin_lock_init(&jrp->inplock);
 	spin_lock_init(&jrp->outlock);
+	INIT_LIST_HEAD(&jrp->bklog);
+	jrp->bklog_cnt = 0;
+	jrp->db_pending = 0;
 
 	/* Select interrupt coalescing parameters */
 	clrsetbits_32(&jrp->rregs->rconfig_lo, 0, JOBR_INTC |
@@ -451,6 +734,7 @@ out_free_inpring:
 			  jrp->inpring, inpbusaddr);
 	dev_err(dev, "can't allocate job rings for %d\n", jrp->ridx);
 out_free_irq:
+	irq_set_affinity_hint(jrp->irq, NULL);
 	free_irq(jrp->irq, dev);
 out_kill_deq:
 	return error;
@@ -515,7 +799,7 @@ static int caam_jr_probe(struct platform_device *pdev)
 
 	jrpriv->dev = jrdev;
 	spin_lock(&driver_data.jr_alloc_lock);
-	list_add_tail(&jrpriv->list_node, &driver_data.jr_list);
+	list_add_tail_rcu(&jrpriv->list_node, &driver_data.jr_list);
 	spin_unlock(&driver_data.jr_alloc_lock);
 
 	atomic_set(&jrpriv->tfm_count, 0);
@@ -523,6 +807,9 @@ static int caam_jr_probe(struct platform_device *pdev)
 	device_init_wakeup(&pdev->dev, 1);
 	device_set_wakeup_enable(&pdev->dev, false);
 
+	/* job rings are children of the controller, which resumes first */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 }
 
@@ -7,12 +7,45 @@
 #ifndef JR_H
 #define JR_H
 
+#include <linux/crypto.h>
+#include <linux/list.h>
+
+/*
+ * Software backlog entry for a job that found the input ring full,
+ * embedded by the caller in its per-request extended descriptor. Also
+ * describes one job of a caam_jr_enqueue_batch() call.
+ */
+struct caam_jr_bklog_entry {
+	struct list_head list;
+	u32 *desc;
+	dma_addr_t desc_dma;
+	int desc_size;
+	void (*cbk)(struct device *dev, u32 *desc, u32 status, void *areq);
+	void *cbkarg;
+	struct crypto_async_request *req;
+};
+
 /* Prototypes for backend-level services exposed to APIs */
 struct device *caam_jr_alloc(void);
+struct device *caam_jr_pick(struct device *dev);
 void caam_jr_free(struct device *rdev);
 int caam_jr_enqueue(struct device *dev, u32 *desc,
 		    void (*cbk)(struct device *dev, u32 *desc, u32 status,
 				void *areq),
 		    void *areq);
+int caam_jr_enqueue_bklog(struct device *dev, u32 *desc,
+			  void (*cbk)(struct device *dev, u32 *desc,
+				      u32 status, void *areq),
+			  void *areq, struct caam_jr_bklog_entry *bklog,
+			  struct crypto_async_request *req);
+int caam_jr_enqueue_batch(struct device *dev, struct caam_jr_bklog_entry *jobs,
+			  int njobs);
+
+/* Whether caam_jr_enqueue_bklog() kept the job in the software backlog */
+static inline bool caam_jr_backlogged(int ret,
+				      struct crypto_async_request *req)
+{
+	return ret == -EBUSY && (req->flags & CRYPTO_TFM_REQ_MAY_BACKLOG);
+}
 
 #endif /* JR_H */
@@ -0,0 +1,336 @@
+/*
+ * CAAM performance monitor counters exported through perf
+ *
+ * Copyright 2017 NXP
+ *
+ * The performance monitor block holds free running 64-bit counters of
+ * the requests dequeued by the DECOs and of the bytes they processed.
+ * They never wrap in practice and raise no interrupt, so events simply
+ * sample them on start, read and stop.
+ */
+
+#include <linux/cpuhotplug.h>
+#include <linux/idr.h>
+#include <linux/perf_event.h>
+
+#include "compat.h"
+#include "regs.h"
+#include "intern.h"
+
+#define CAAM_PMU_REQ_DEQUEUED	0x0
+#define CAAM_PMU_OB_ENC_REQ	0x1
+#define CAAM_PMU_IB_DEC_REQ	0x2
+#define CAAM_PMU_OB_ENC_BYTES	0x3
+#define CAAM_PMU_OB_PROT_BYTES	0x4
+#define CAAM_PMU_IB_DEC_BYTES	0x5
+#define CAAM_PMU_IB_VALID_BYTES	0x6
+#define CAAM_PMU_NUM_COUNTERS	7
+
+#define to_caam_pmu(p) container_of(p, struct caam_pmu, pmu)
+
+struct caam_pmu {
+	struct pmu pmu;
+	struct caam_perfmon __iomem *perfmon;
+	struct device *dev;
+	cpumask_t cpu;
+	struct hlist_node node;
+	int id;
+};
+
+static enum cpuhp_state cpuhp_caam_pmu_state;
+static DEFINE_IDA(caam_pmu_ida);
+
+PMU_EVENT_ATTR_STRING(requests-dequeued, caam_pmu_req_dequeued, "event=0x00")
+PMU_EVENT_ATTR_STRING(ob-encrypt-requests, caam_pmu_ob_enc_req, "event=0x01")
+PMU_EVENT_ATTR_STRING(ib-decrypt-requests, caam_pmu_ib_dec_req, "event=0x02")
+PMU_EVENT_ATTR_STRING(ob-encrypt-bytes, caam_pmu_ob_enc_bytes, "event=0x03")
+PMU_EVENT_ATTR_STRING(ob-protect-bytes, caam_pmu_ob_prot_bytes, "event=0x04")
+PMU_EVENT_ATTR_STRING(ib-decrypt-bytes, caam_pmu_ib_dec_bytes, "event=0x05")
+PMU_EVENT_ATTR_STRING(ib-validate-bytes, caam_pmu_ib_valid_bytes,
+		      "event=0x06")
+
+static ssize_t caam_pmu_cpumask_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct caam_pmu *pmu_caam = to_caam_pmu(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf, &pmu_caam->cpu);
+}
+
+static struct device_attribute caam_pmu_cpumask_attr =
+	__ATTR(cpumask, 0444, caam_pmu_cpumask_show, NULL);
+
+static struct attribute *caam_pmu_cpumask_attrs[] = {
+	&caam_pmu_cpumask_attr.attr,
+	NULL,
+};
+
+static struct attribute_group caam_pmu_cpumask_attr_group = {
+	.attrs = caam_pmu_cpumask_attrs,
+};
+
+static struct attribute *caam_pmu_events_attrs[] = {
+	&caam_pmu_req_dequeued.attr.attr,
+	&caam_pmu_ob_enc_req.attr.attr,
+	&caam_pmu_ib_dec_req.attr.attr,
+	&caam_pmu_ob_enc_bytes.attr.attr,
+	&caam_pmu_ob_prot_bytes.attr.attr,
+	&caam_pmu_ib_dec_bytes.attr.attr,
+	&caam_pmu_ib_valid_bytes.attr.attr,
+	NULL,
+};
+
+static struct attribute_group caam_pmu_events_attr_group = {
+	.name = "events",
+	.attrs = caam_pmu_events_attrs,
+};
+
+PMU_FORMAT_ATTR(event, "config:0-63");
+
+static struct attribute *caam_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	NULL,
+};
+
+static struct attribute_group caam_pmu_format_attr_group = {
+	.name = "format",
+	.attrs = caam_pmu_format_attrs,
+};
+
+static const struct attribute_group *caam_pmu_attr_groups[] = {
+	&caam_pmu_events_attr_group,
+	&caam_pmu_format_attr_group,
+	&caam_pmu_cpumask_attr_group,
+	NULL,
+};
+
+static u64 caam_pmu_read_counter(struct caam_pmu *pmu_caam, int cfg)
+{
+	/* the counters are laid out in event order, starting at PC_REQ_DEQ */
+	return rd_reg64(&pmu_caam->perfmon->req_dequeued + cfg);
+}
+
+static int caam_pmu_offline_cpu(unsigned int cpu, struct hlist_node *node)
+{
+	struct caam_pmu *pmu_caam = hlist_entry_safe(node, struct caam_pmu,
+						     node);
+	int target;
+
+	if (!cpumask_test_and_clear_cpu(cpu, &pmu_caam->cpu))
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&pmu_caam->pmu, cpu, target);
+	cpumask_set_cpu(target, &pmu_caam->cpu);
+
+	return 0;
+}
+
+/*
+ * The counters are free running and shared, so any number of events may
+ * use the same one. A group is valid as long as it only mixes our own
+ * events with software ones.
+ */
+static bool caam_pmu_group_is_valid(struct perf_event *event)
+{
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+
+	if (leader->pmu != event->pmu && !is_software_event(leader))
+		return false;
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (sibling->pmu != event->pmu && !is_software_event(sibling))
+			return false;
+	}
+
+	return true;
+}
+
+static int caam_pmu_event_init(struct perf_event *event)
+{
+	struct caam_pmu *pmu_caam = to_caam_pmu(event->pmu);
+	u64 cfg = event->attr.config;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+
+	if (event->cpu < 0) {
+		dev_warn(pmu_caam->dev, "Can't provide per-task data!\n");
+		return -EOPNOTSUPP;
+	}
+
+	if (event->attr.exclude_user ||
+	    event->attr.exclude_kernel ||
+	    event->attr.exclude_hv ||
+	    event->attr.exclude_idle ||
+	    event->attr.exclude_host ||
+	    event->attr.exclude_guest)
+		return -EINVAL;
+
+	if (cfg >= CAAM_PMU_NUM_COUNTERS)
+		return -EINVAL;
+
+	if (!caam_pmu_group_is_valid(event))
+		return -EINVAL;
+
+	event->cpu = cpumask_first(&pmu_caam->cpu);
+	return 0;
+}
+
+static void caam_pmu_event_update(struct perf_event *event)
+{
+	struct caam_pmu *pmu_caam = to_caam_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev_raw_count, new_raw_count;
+
+	do {
+		prev_raw_count = local64_read(&hwc->prev_count);
+		new_raw_count = caam_pmu_read_counter(pmu_caam,
+						      event->attr.config);
+	} while (local64_cmpxchg(&hwc->prev_count, prev_raw_count,
+				 new_raw_count) != prev_raw_count);
+
+	local64_add(new_raw_count - prev_raw_count, &event->count);
+}
+
+static void caam_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct caam_pmu *pmu_caam = to_caam_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	local64_set(&hwc->prev_count,
+		    caam_pmu_read_counter(pmu_caam, event->attr.config));
+	hwc->state = 0;
+}
+
+static void caam_pmu_event_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	caam_pmu_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int caam_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		caam_pmu_event_start(event, flags);
+
+	return 0;
+}
+
+static void caam_pmu_event_del(struct perf_event *event, int flags)
+{
+	caam_pmu_event_stop(event, PERF_EF_UPDATE);
+}
+
+/**
+ * caam_pmu_init() - register the "caam" perf PMU for a controller.
+ * Failing to do so only loses the counters, so callers may carry on.
+ * @ctrlpriv: controller whose performance monitor registers are used
+ */
+int caam_pmu_init(struct caam_drv_private *ctrlpriv)
+{
+	struct device *dev = &ctrlpriv->pdev->dev;
+	struct caam_pmu *pmu_caam;
+	char *name;
+	int ret;
+
+	pmu_caam = kzalloc(sizeof(*pmu_caam), GFP_KERNEL);
+	if (!pmu_caam)
+		return -ENOMEM;
+
+	/* The first instance registers the hotplug state */
+	if (!cpuhp_caam_pmu_state) {
+		ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN,
+					      "perf/caam:online", NULL,
+					      caam_pmu_offline_cpu);
+		if (ret < 0)
+			goto pmu_free;
+		cpuhp_caam_pmu_state = ret;
+	}
+
+	*pmu_caam = (struct caam_pmu) {
+		.pmu = (struct pmu) {
+			.task_ctx_nr    = perf_invalid_context,
+			.attr_groups    = caam_pmu_attr_groups,
+			.event_init     = caam_pmu_event_init,
+			.add            = caam_pmu_event_add,
+			.del            = caam_pmu_event_del,
+			.start          = caam_pmu_event_start,
+			.stop           = caam_pmu_event_stop,
+			.read           = caam_pmu_event_update,
+		},
+		.perfmon = (struct caam_perfmon __iomem *)
+			   &ctrlpriv->ctrl->perfmon,
+		.dev = dev,
+	};
+
+	pmu_caam->id = ida_simple_get(&caam_pmu_ida, 0, 0, GFP_KERNEL);
+	if (pmu_caam->id < 0) {
+		ret = pmu_caam->id;
+		goto pmu_free;
+	}
+
+	if (pmu_caam->id == 0)
+		name = "caam";
+	else
+		name = devm_kasprintf(dev, GFP_KERNEL, "caam%d",
+				      pmu_caam->id);
+	if (!name) {
+		ret = -ENOMEM;
+		goto put_id;
+	}
+
+	cpumask_set_cpu(raw_smp_processor_id(), &pmu_caam->cpu);
+	ctrlpriv->pmu = pmu_caam;
+
+	cpuhp_state_add_instance_nocalls(cpuhp_caam_pmu_state,
+					 &pmu_caam->node);
+
+	ret = perf_pmu_register(&pmu_caam->pmu, name, -1);
+	if (ret)
+		goto remove_instance;
+
+	return 0;
+
+remove_instance:
+	cpuhp_state_remove_instance_nocalls(cpuhp_caam_pmu_state,
+					    &pmu_caam->node);
+	ctrlpriv->pmu = NULL;
+put_id:
+	ida_simple_remove(&caam_pmu_ida, pmu_caam->id);
+pmu_free:
+	kfree(pmu_caam);
+	dev_warn(dev, "CAAM perf PMU failed (%d), disabled\n", ret);
+	return ret;
+}
+
+void caam_pmu_exit(struct caam_drv_private *ctrlpriv)
+{
+	struct caam_pmu *pmu_caam = ctrlpriv->pmu;
+
+	if (!pmu_caam)
+		return;
+
+	perf_pmu_unregister(&pmu_caam->pmu);
+	cpuhp_state_remove_instance_nocalls(cpuhp_caam_pmu_state,
+					    &pmu_caam->node);
+	ida_simple_remove(&caam_pmu_ida, pmu_caam->id);
+	kfree(pmu_caam);
+	ctrlpriv->pmu = NULL;
+}
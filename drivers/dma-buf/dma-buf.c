@@ -254,11 +254,34 @@ out:
 	return events;
 }
 
+static int dma_buf_sync_direction(u64 flags, enum dma_data_direction *dir)
+{
+	if (flags & ~DMA_BUF_SYNC_VALID_FLAGS_MASK)
+		return -EINVAL;
+
+	switch (flags & DMA_BUF_SYNC_RW) {
+	case DMA_BUF_SYNC_READ:
+		*dir = DMA_FROM_DEVICE;
+		break;
+	case DMA_BUF_SYNC_WRITE:
+		*dir = DMA_TO_DEVICE;
+		break;
+	case DMA_BUF_SYNC_RW:
+		*dir = DMA_BIDIRECTIONAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static long dma_buf_ioctl(struct file *file,
 			  unsigned int cmd, unsigned long arg)
 {
 	struct dma_buf *dmabuf;
 	struct dma_buf_sync sync;
+	struct dma_buf_sync_partial partial;
 	enum dma_data_direction direction;
 	int ret;
 
@@ -269,28 +292,39 @@ static long dma_buf_ioctl(struct file *file,
 		if (copy_from_user(&sync, (void __user *) arg, sizeof(sync)))
 			return -EFAULT;
 
-		if (sync.flags & ~DMA_BUF_SYNC_VALID_FLAGS_MASK)
-			return -EINVAL;
-
-		switch (sync.flags & DMA_BUF_SYNC_RW) {
-		case DMA_BUF_SYNC_READ:
-			direction = DMA_FROM_DEVICE;
-			break;
-		case DMA_BUF_SYNC_WRITE:
-			direction = DMA_TO_DEVICE;
-			break;
-		case DMA_BUF_SYNC_RW:
-			direction = DMA_BIDIRECTIONAL;
-			break;
-		default:
-			return -EINVAL;
-		}
+		ret = dma_buf_sync_direction(sync.flags, &direction);
+		if (ret)
+			return ret;
 
 		if (sync.flags & DMA_BUF_SYNC_END)
 			ret = dma_buf_end_cpu_access(dmabuf, direction);
 		else
 			ret = dma_buf_begin_cpu_access(dmabuf, direction);
 
+		return ret;
+	case DMA_BUF_IOCTL_SYNC_PARTIAL:
+		if (copy_from_user(&partial, (void __user *) arg,
+				   sizeof(partial)))
+			return -EFAULT;
+
+		ret = dma_buf_sync_direction(partial.flags, &direction);
+		if (ret)
+			return ret;
+
+		if (!partial.len || partial.offset > dmabuf->size ||
+		    partial.len > dmabuf->size - partial.offset)
+			return -EINVAL;
+
+		if (partial.flags & DMA_BUF_SYNC_END)
+			ret = dma_buf_end_cpu_access_partial(dmabuf, direction,
+							     partial.offset,
+							     partial.len);
+		else
+			ret = dma_buf_begin_cpu_access_partial(dmabuf,
+							       direction,
+							       partial.offset,
+							       partial.len);
+
 		return ret;
 	default:
 		return -ENOTTY;
@@ -662,6 +696,68 @@ int dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 }
 EXPORT_SYMBOL_GPL(dma_buf_end_cpu_access);
 
+/**
+ * dma_buf_begin_cpu_access_partial - dma_buf_begin_cpu_access() limited to a
+ * byte range of the buffer. Exporters without begin_cpu_access_partial get
+ * a begin_cpu_access call for the whole buffer.
+ * @dmabuf:	[in]	buffer to prepare cpu access for.
+ * @direction:	[in]	direction of cpu access.
+ * @offset:	[in]	start of the range in bytes.
+ * @len:	[in]	length of the range in bytes.
+ *
+ * Can return negative error values, returns 0 on success.
+ */
+int dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+				     enum dma_data_direction direction,
+				     unsigned int offset, unsigned int len)
+{
+	int ret = 0;
+
+	if (WARN_ON(!dmabuf))
+		return -EINVAL;
+
+	if (dmabuf->ops->begin_cpu_access_partial)
+		ret = dmabuf->ops->begin_cpu_access_partial(dmabuf, direction,
+							    offset, len);
+	else if (dmabuf->ops->begin_cpu_access)
+		ret = dmabuf->ops->begin_cpu_access(dmabuf, direction);
+
+	if (ret == 0)
+		ret = __dma_buf_begin_cpu_access(dmabuf, direction);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(dma_buf_begin_cpu_access_partial);
+
+/**
+ * dma_buf_end_cpu_access_partial - dma_buf_end_cpu_access() limited to a
+ * byte range of the buffer. Exporters without end_cpu_access_partial get
+ * an end_cpu_access call for the whole buffer.
+ * @dmabuf:	[in]	buffer to complete cpu access for.
+ * @direction:	[in]	direction of cpu access.
+ * @offset:	[in]	start of the range in bytes.
+ * @len:	[in]	length of the range in bytes.
+ *
+ * Can return negative error values, returns 0 on success.
+ */
+int dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+				   enum dma_data_direction direction,
+				   unsigned int offset, unsigned int len)
+{
+	int ret = 0;
+
+	WARN_ON(!dmabuf);
+
+	if (dmabuf->ops->end_cpu_access_partial)
+		ret = dmabuf->ops->end_cpu_access_partial(dmabuf, direction,
+							  offset, len);
+	else if (dmabuf->ops->end_cpu_access)
+		ret = dmabuf->ops->end_cpu_access(dmabuf, direction);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(dma_buf_end_cpu_access_partial);
+
 /**
  * dma_buf_kmap_atomic - Map a page of the buffer object into kernel address
  * space. The same restrictions as for kmap_atomic and friends apply.
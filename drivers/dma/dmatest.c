@@ -56,10 +56,20 @@ module_param(sg_buffers, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(sg_buffers,
 		"Number of scatter gather buffers (default: 1)");
 
+static unsigned int sg_seg_size;
+module_param(sg_seg_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(sg_seg_size,
+		"Length of each scatter gather segment (default: random)");
+
 static unsigned int dmatest;
 module_param(dmatest, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(dmatest,
-		"dmatest 0-memcpy 1-slave_sg (default: 0)");
+		"dmatest 0-memcpy 1-slave_sg 2-cyclic (default: 0)");
+
+static unsigned int cyclic_periods = 4;
+module_param(cyclic_periods, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(cyclic_periods,
+		"Number of periods in the cyclic test buffer (default: 4)");
 
 static unsigned int xor_sources = 3;
 module_param(xor_sources, uint, S_IRUGO | S_IWUSR);
@@ -92,6 +102,8 @@ MODULE_PARM_DESC(verbose, "Enable \"success\" result messages (default: off)");
  * @threads_per_chan:	number of threads to start per channel
  * @max_channels:	maximum number of channels to use
  * @iterations:		iterations before stopping test
+ * @sg_seg_size:	length of each sg segment, 0 for random
+ * @cyclic_periods:	number of periods in the cyclic buffer
  * @xor_sources:	number of xor source buffers
  * @pq_sources:		number of p+q source buffers
  * @timeout:		transfer timeout in msec, -1 for infinite timeout
@@ -103,6 +115,8 @@ struct dmatest_params {
 	unsigned int	threads_per_chan;
 	unsigned int	max_channels;
 	unsigned int	iterations;
+	unsigned int	sg_seg_size;
+	unsigned int	cyclic_periods;
 	unsigned int	xor_sources;
 	unsigned int	pq_sources;
 	int		timeout;
@@ -330,16 +344,52 @@ static unsigned int dmatest_verify(u8 **bufs, unsigned int start,
 struct dmatest_done {
 	bool			done;
 	wait_queue_head_t	*wait;
+	ktime_t			stamp;
 };
 
 static void dmatest_callback(void *arg)
 {
 	struct dmatest_done *done = arg;
 
+	done->stamp = ktime_get();
 	done->done = true;
 	wake_up_all(done->wait);
 }
 
+/* running latency statistics, in nanoseconds */
+struct dmatest_lat {
+	u64			total;
+	u64			min;
+	u64			max;
+	unsigned int		count;
+};
+
+static void dmatest_lat_add(struct dmatest_lat *lat, ktime_t diff)
+{
+	u64 ns = ktime_to_ns(diff);
+
+	if (!lat->count || ns < lat->min)
+		lat->min = ns;
+	if (ns > lat->max)
+		lat->max = ns;
+	lat->total += ns;
+	lat->count++;
+}
+
+static unsigned long long dmatest_lat_avg(struct dmatest_lat *lat)
+{
+	if (!lat->count)
+		return 0;
+	return div_u64(lat->total, lat->count);
+}
+
+static void dmatest_lat_show(const char *name, struct dmatest_lat *lat)
+{
+	pr_info("%s: %s latency min %llu avg %llu max %llu ns (%u samples)\n",
+		current->comm, name, lat->count ? lat->min : 0,
+		dmatest_lat_avg(lat), lat->max, lat->count);
+}
+
 static unsigned int min_odd(unsigned int x, unsigned int y)
 {
 	unsigned int val = min(x, y);
@@ -426,11 +476,14 @@ static int dmatest_func(void *data)
 	int			src_cnt;
 	int			dst_cnt;
 	int			i;
-	ktime_t			ktime, start, diff;
+	ktime_t			ktime, start, diff, issued;
 	ktime_t			filltime = ktime_set(0, 0);
 	ktime_t			comparetime = ktime_set(0, 0);
 	s64			runtime = 0;
 	unsigned long long	total_len = 0;
+	struct dmatest_lat	prep_lat = { 0 };
+	struct dmatest_lat	issue_lat = { 0 };
+	struct dmatest_lat	complete_lat = { 0 };
 
 	set_freezable();
 
@@ -518,7 +571,9 @@ static int dmatest_func(void *data)
 			break;
 		}
 
-		if (params->noverify)
+		if (thread->type == DMA_SG && params->sg_seg_size)
+			len = min(params->sg_seg_size, params->buf_size);
+		else if (params->noverify)
 			len = params->buf_size;
 		else
 			len = dmatest_random() % params->buf_size + 1;
@@ -606,6 +661,7 @@ static int dmatest_func(void *data)
 			sg_dma_len(&rx_sg[i]) = len;
 		}
 
+		start = ktime_get();
 		if (thread->type == DMA_MEMCPY)
 			tx = dev->device_prep_dma_memcpy(chan,
 							 dsts[0] + dst_off,
@@ -636,10 +692,12 @@ static int dmatest_func(void *data)
 			failed_tests++;
 			continue;
 		}
+		dmatest_lat_add(&prep_lat, ktime_sub(ktime_get(), start));
 
 		done.done = false;
 		tx->callback = dmatest_callback;
 		tx->callback_param = &done;
+		start = ktime_get();
 		cookie = tx->tx_submit(tx);
 
 		if (dma_submit_error(cookie)) {
@@ -651,6 +709,8 @@ static int dmatest_func(void *data)
 			continue;
 		}
 		dma_async_issue_pending(chan);
+		issued = ktime_get();
+		dmatest_lat_add(&issue_lat, ktime_sub(issued, start));
 
 		wait_event_freezable_timeout(done_wait, done.done,
 					     msecs_to_jiffies(params->timeout));
@@ -683,6 +743,7 @@ static int dmatest_func(void *data)
 		}
 
 		dmaengine_unmap_put(um);
+		dmatest_lat_add(&complete_lat, ktime_sub(done.stamp, issued));
 
 		if (params->noverify) {
 			verbose_result("test passed", total_tests, src_off,
@@ -745,6 +806,11 @@ err_thread_type:
 		current->comm, total_tests, failed_tests,
 		dmatest_persec(runtime, total_tests),
 		dmatest_KBs(runtime, total_len), ret);
+	if (prep_lat.count) {
+		dmatest_lat_show("prep", &prep_lat);
+		dmatest_lat_show("issue", &issue_lat);
+		dmatest_lat_show("complete", &complete_lat);
+	}
 
 	/* terminate all transfers on specified channels */
 	if (ret)
@@ -756,6 +822,176 @@ err_thread_type:
 	return ret;
 }
 
+struct dmatest_cyclic {
+	wait_queue_head_t	*wait;
+	ktime_t			last;
+	unsigned int		count;
+	struct dmatest_lat	first;
+	struct dmatest_lat	period;
+};
+
+static void dmatest_cyclic_callback(void *arg)
+{
+	struct dmatest_cyclic *cyc = arg;
+	ktime_t now = ktime_get();
+
+	if (cyc->count)
+		dmatest_lat_add(&cyc->period, ktime_sub(now, cyc->last));
+	else
+		dmatest_lat_add(&cyc->first, ktime_sub(now, cyc->last));
+	cyc->last = now;
+	WRITE_ONCE(cyc->count, cyc->count + 1);
+	wake_up_all(cyc->wait);
+}
+
+/*
+ * Cyclic benchmark: a single buffer split in cyclic_periods periods is
+ * streamed into a fixed memory location until 'iterations' period
+ * interrupts have been seen. There is no peripheral pacing the
+ * transfer, so the period-to-period interval is the time the engine
+ * needs to move one period plus the interrupt and callback latency of
+ * the driver; the spread between min and max is the latency jitter.
+ */
+static int dmatest_cyclic_func(void *data)
+{
+	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(done_wait);
+	struct dmatest_thread	*thread = data;
+	struct dmatest_cyclic	cyc = { .wait = &done_wait };
+	struct dmatest_params	*params;
+	struct dma_slave_config	config = { 0 };
+	struct dma_async_tx_descriptor *tx;
+	struct dma_chan		*chan;
+	struct device		*dma_dev;
+	struct dmatest_lat	prep_lat = { 0 };
+	unsigned int		periods, period_len, buf_len, seen;
+	unsigned int		failed_tests = 0;
+	dma_addr_t		src_dma, dst_dma;
+	dma_cookie_t		cookie;
+	ktime_t			ktime, start;
+	s64			runtime = 0;
+	u8			*src, *dst;
+	int			ret;
+
+	set_freezable();
+
+	smp_rmb();
+	params = &thread->info->params;
+	chan = thread->chan;
+	dma_dev = chan->device->dev;
+
+	periods = params->cyclic_periods ? params->cyclic_periods : 1;
+	period_len = (params->buf_size / periods) & ~3;
+	buf_len = period_len * periods;
+	if (!period_len) {
+		pr_err("%u-byte buffer too small for %u periods\n",
+		       params->buf_size, periods);
+		ret = -EINVAL;
+		goto err_alloc;
+	}
+
+	ret = -ENOMEM;
+	src = kmalloc(buf_len, GFP_KERNEL);
+	if (!src)
+		goto err_alloc;
+	dst = kmalloc(period_len, GFP_KERNEL);
+	if (!dst)
+		goto err_dst;
+
+	src_dma = dma_map_single(dma_dev, src, buf_len, DMA_TO_DEVICE);
+	ret = dma_mapping_error(dma_dev, src_dma);
+	if (ret)
+		goto err_src_map;
+	dst_dma = dma_map_single(dma_dev, dst, period_len, DMA_FROM_DEVICE);
+	ret = dma_mapping_error(dma_dev, dst_dma);
+	if (ret)
+		goto err_dst_map;
+
+	config.direction = DMA_MEM_TO_DEV;
+	config.dst_addr = dst_dma;
+	config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	config.dst_maxburst = 1;
+	config.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	config.src_maxburst = 1;
+	ret = dmaengine_slave_config(chan, &config);
+	if (ret) {
+		pr_err("%s: slave config error (%d)\n", current->comm, ret);
+		goto err_config;
+	}
+
+	set_user_nice(current, 10);
+
+	start = ktime_get();
+	tx = dmaengine_prep_dma_cyclic(chan, src_dma, buf_len, period_len,
+				       DMA_MEM_TO_DEV, DMA_PREP_INTERRUPT);
+	if (!tx) {
+		pr_err("%s: cyclic prep error\n", current->comm);
+		ret = -EIO;
+		goto err_config;
+	}
+	dmatest_lat_add(&prep_lat, ktime_sub(ktime_get(), start));
+
+	tx->callback = dmatest_cyclic_callback;
+	tx->callback_param = &cyc;
+	cookie = dmaengine_submit(tx);
+	if (dma_submit_error(cookie)) {
+		pr_err("%s: cyclic submit error\n", current->comm);
+		ret = -EIO;
+		goto err_config;
+	}
+
+	ktime = cyc.last = ktime_get();
+	dma_async_issue_pending(chan);
+
+	seen = 0;
+	while (!kthread_should_stop()
+	       && !(params->iterations && seen >= params->iterations)) {
+		wait_event_freezable_timeout(done_wait,
+				READ_ONCE(cyc.count) != seen ||
+				kthread_should_stop(),
+				msecs_to_jiffies(params->timeout));
+		if (READ_ONCE(cyc.count) == seen) {
+			if (kthread_should_stop())
+				break;
+			pr_warn("%s: period #%u timed out\n",
+				current->comm, seen + 1);
+			failed_tests++;
+			break;
+		}
+		seen = READ_ONCE(cyc.count);
+	}
+
+	/* no callback may run once this returns, cyc is ours again */
+	dmaengine_terminate_sync(chan);
+	runtime = ktime_to_us(ktime_sub(ktime_get(), ktime));
+	seen = cyc.count;
+
+	pr_info("%s: summary %u periods, %u failures %llu periods/s %llu KB/s (%d)\n",
+		current->comm, seen, failed_tests,
+		dmatest_persec(runtime, seen),
+		dmatest_KBs(runtime, (unsigned long long)seen * period_len),
+		ret);
+	dmatest_lat_show("prep", &prep_lat);
+	dmatest_lat_show("first period", &cyc.first);
+	dmatest_lat_show("period", &cyc.period);
+
+err_config:
+	dma_unmap_single(dma_dev, dst_dma, period_len, DMA_FROM_DEVICE);
+err_dst_map:
+	dma_unmap_single(dma_dev, src_dma, buf_len, DMA_TO_DEVICE);
+err_src_map:
+	kfree(dst);
+err_dst:
+	kfree(src);
+err_alloc:
+	if (ret)
+		pr_info("%s: cyclic test failed (%d)\n", current->comm, ret);
+
+	thread->done = true;
+	wake_up(&thread_wait);
+
+	return ret;
+}
+
 static void dmatest_cleanup_channel(struct dmatest_chan *dtc)
 {
 	struct dmatest_thread	*thread;
@@ -794,6 +1030,8 @@ static int dmatest_add_threads(struct dmatest_info *info,
 		op = "xor";
 	else if (type == DMA_PQ)
 		op = "pq";
+	else if (type == DMA_CYCLIC)
+		op = "cyclic";
 	else
 		return -EINVAL;
 
@@ -808,8 +1046,9 @@ static int dmatest_add_threads(struct dmatest_info *info,
 		thread->chan = dtc->chan;
 		thread->type = type;
 		smp_wmb();
-		thread->task = kthread_create(dmatest_func, thread, "%s-%s%u",
-				dma_chan_name(chan), op, i);
+		thread->task = kthread_create(type == DMA_CYCLIC ?
+				dmatest_cyclic_func : dmatest_func,
+				thread, "%s-%s%u", dma_chan_name(chan), op, i);
 		if (IS_ERR(thread->task)) {
 			pr_warn("Failed to create thread %s-%s%u\n",
 				dma_chan_name(chan), op, i);
@@ -857,6 +1096,13 @@ static int dmatest_add_channel(struct dmatest_info *info,
 		}
 	}
 
+	if (dma_has_cap(DMA_CYCLIC, dma_dev->cap_mask)) {
+		if (dmatest == 2) {
+			cnt = dmatest_add_threads(info, dtc, DMA_CYCLIC);
+			thread_count += cnt > 0 ? cnt : 0;
+		}
+	}
+
 	if (dma_has_cap(DMA_XOR, dma_dev->cap_mask)) {
 		cnt = dmatest_add_threads(info, dtc, DMA_XOR);
 		thread_count += cnt > 0 ? cnt : 0;
@@ -922,6 +1168,8 @@ static void run_threaded_test(struct dmatest_info *info)
 	params->threads_per_chan = threads_per_chan;
 	params->max_channels = max_channels;
 	params->iterations = iterations;
+	params->sg_seg_size = sg_seg_size;
+	params->cyclic_periods = cyclic_periods;
 	params->xor_sources = xor_sources;
 	params->pq_sources = pq_sources;
 	params->timeout = timeout;
@@ -931,6 +1179,9 @@ static void run_threaded_test(struct dmatest_info *info)
 	request_channels(info, DMA_XOR);
 	request_channels(info, DMA_SG);
 	request_channels(info, DMA_PQ);
+	/* cyclic channels are slave channels, only grab them on request */
+	if (dmatest == 2)
+		request_channels(info, DMA_CYCLIC);
 }
 
 static void stop_threaded_test(struct dmatest_info *info)
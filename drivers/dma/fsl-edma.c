@@ -27,6 +27,7 @@
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/of_dma.h>
+#include <linux/dma/fsl-edma.h>
 
 #include "virt-dma.h"
 
@@ -106,6 +107,7 @@
 #define EDMA_TCD_CSR_E_LINK		BIT(5)
 #define EDMA_TCD_CSR_ACTIVE		BIT(6)
 #define EDMA_TCD_CSR_DONE		BIT(7)
+#define EDMA_TCD_CSR_MAJORLINKCH(x)	(((x) & 0x1F) << 8)
 
 #define EDMAMUX_CHCFG_DIS		0x0
 #define EDMAMUX_CHCFG_ENBL		0x80
@@ -168,12 +170,18 @@ struct fsl_edma_chan {
 	struct dma_pool			*tcd_pool;
 	char				chan_name[16];
 	u32				chn_real_count;
+	/* last descriptor of the chain the hardware runs through */
+	struct fsl_edma_desc		*tail;
+	/* channel started on each major loop completion, -1 for none */
+	int				link_ch;
 };
 
 struct fsl_edma_desc {
 	struct virt_dma_desc		vdesc;
 	struct fsl_edma_chan		*echan;
 	bool				iscyclic;
+	/* the next descriptor is chained in hardware through E_SG */
+	bool				hw_linked;
 	unsigned int			n_tcds;
 	struct fsl_edma_sw_tcd		tcd[];
 };
@@ -270,6 +278,15 @@ static u32 edma_readl(struct fsl_edma_engine *edma, void __iomem *addr)
 		return ioread32(addr);
 }
 
+static u16 edma_readw(struct fsl_edma_engine *edma, void __iomem *addr)
+{
+	/* swap the reg offset for these in big-endian mode */
+	if (edma->big_endian)
+		return ioread16be((void __iomem *)((unsigned long)addr ^ 0x2));
+	else
+		return ioread16(addr);
+}
+
 static void edma_writeb(struct fsl_edma_engine *edma, u8 val, void __iomem *addr)
 {
 	/* swap the reg offset for these in big-endian mode */
@@ -376,6 +393,7 @@ static int fsl_edma_terminate_all(struct dma_chan *chan)
 	spin_lock_irqsave(&fsl_chan->vchan.lock, flags);
 	fsl_edma_disable_request(fsl_chan);
 	fsl_chan->edesc = NULL;
+	fsl_chan->tail = NULL;
 	fsl_chan->idle = true;
 	vchan_get_all_descriptors(&fsl_chan->vchan, &head);
 	spin_unlock_irqrestore(&fsl_chan->vchan.lock, flags);
@@ -584,6 +602,45 @@ void fsl_edma_fill_tcd(struct fsl_edma_hw_tcd *tcd, u32 src, u32 dst,
 	tcd->csr = cpu_to_le16(csr);
 }
 
+static void fsl_edma_set_major_link(struct fsl_edma_chan *fsl_chan,
+				    struct fsl_edma_hw_tcd *tcd)
+{
+	u16 csr;
+
+	if (fsl_chan->link_ch < 0)
+		return;
+
+	csr = le16_to_cpu(tcd->csr);
+	csr |= EDMA_TCD_CSR_E_LINK;
+	csr |= EDMA_TCD_CSR_MAJORLINKCH(fsl_chan->link_ch);
+	tcd->csr = cpu_to_le16(csr);
+}
+
+/**
+ * fsl_edma_link_channel - start a channel on each major loop completion
+ * @chan: channel whose major loops trigger @link
+ * @link: channel to trigger, or NULL to drop the link
+ *
+ * Both channels must belong to the same eDMA instance. The link applies
+ * to descriptors prepared on @chan after this call, so a ping-pong pair
+ * can hand over to each other without a round trip through the CPU.
+ */
+int fsl_edma_link_channel(struct dma_chan *chan, struct dma_chan *link)
+{
+	struct fsl_edma_chan *fsl_chan;
+
+	if (strcmp(chan->device->dev->driver->name, "fsl-edma"))
+		return -EINVAL;
+	if (link && (link->device != chan->device || link == chan))
+		return -EINVAL;
+
+	fsl_chan = to_fsl_edma_chan(chan);
+	fsl_chan->link_ch = link ? link->chan_id : -1;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(fsl_edma_link_channel);
+
 static struct fsl_edma_desc *fsl_edma_alloc_desc(struct fsl_edma_chan *fsl_chan,
 		int sg_len)
 {
@@ -660,6 +717,7 @@ static struct dma_async_tx_descriptor *fsl_edma_prep_dma_cyclic(
 		fsl_edma_fill_tcd(fsl_desc->tcd[i].vtcd, src_addr, dst_addr,
 				  fsl_chan->fsc.attr, soff, nbytes, 0, iter,
 				  iter, doff, last_sg, true, false, true);
+		fsl_edma_set_major_link(fsl_chan, fsl_desc->tcd[i].vtcd);
 		dma_buf_next += period_len;
 	}
 
@@ -717,6 +775,7 @@ static struct dma_async_tx_descriptor *fsl_edma_prep_slave_sg(
 					  nbytes, 0, iter, iter, doff, last_sg,
 					  true, true, false);
 		}
+		fsl_edma_set_major_link(fsl_chan, fsl_desc->tcd[i].vtcd);
 	}
 
 	return vchan_tx_prep(&fsl_chan->vchan, &fsl_desc->vdesc, flags);
@@ -730,12 +789,123 @@ static void fsl_edma_xfer_desc(struct fsl_edma_chan *fsl_chan)
 	if (!vdesc)
 		return;
 	fsl_chan->edesc = to_fsl_edma_desc(vdesc);
+	fsl_chan->tail = fsl_chan->edesc;
 	fsl_edma_set_tcd_regs(fsl_chan, fsl_chan->edesc->tcd[0].vtcd);
 	fsl_edma_enable_request(fsl_chan);
 	fsl_chan->status = DMA_IN_PROGRESS;
 	fsl_chan->idle = false;
 }
 
+/*
+ * Chain @next behind @prev, the current end of the hardware chain, so
+ * the engine loads it through E_SG without software re-arming the
+ * channel. The in-memory TCD covers the case the engine has not fetched
+ * the last TCD of @prev yet; if it already runs it, the live registers
+ * are patched and the E_SG read-back tells whether we were in time.
+ */
+static bool fsl_edma_link_desc(struct fsl_edma_chan *fsl_chan,
+			       struct fsl_edma_desc *prev,
+			       struct fsl_edma_desc *next)
+{
+	struct fsl_edma_engine *edma = fsl_chan->edma;
+	void __iomem *addr = edma->membase;
+	u32 ch = fsl_chan->vchan.chan.chan_id;
+	struct fsl_edma_hw_tcd *last = prev->tcd[prev->n_tcds - 1].vtcd;
+	u16 csr;
+
+	csr = le16_to_cpu(last->csr);
+	csr &= ~EDMA_TCD_CSR_D_REQ;
+	csr |= EDMA_TCD_CSR_E_SG;
+	last->dlast_sga = cpu_to_le32(next->tcd[0].ptcd);
+	/* the engine must not see E_SG before the new link address */
+	wmb();
+	last->csr = cpu_to_le16(csr);
+	/* publish the TCD before sampling what the engine has loaded */
+	wmb();
+
+	/* only the chain end runs with E_SG clear */
+	csr = edma_readw(edma, addr + EDMA_TCD_CSR(ch));
+	if (!(csr & EDMA_TCD_CSR_E_SG)) {
+		if (csr & EDMA_TCD_CSR_DONE)
+			return false;
+
+		edma_writel(edma, next->tcd[0].ptcd,
+			    addr + EDMA_TCD_DLAST_SGA(ch));
+		csr &= ~EDMA_TCD_CSR_D_REQ;
+		edma_writew(edma, csr | EDMA_TCD_CSR_E_SG,
+			    addr + EDMA_TCD_CSR(ch));
+		csr = edma_readw(edma, addr + EDMA_TCD_CSR(ch));
+		if (!(csr & EDMA_TCD_CSR_E_SG))
+			return false;
+	}
+
+	prev->hw_linked = true;
+	return true;
+}
+
+static void fsl_edma_link_pending(struct fsl_edma_chan *fsl_chan)
+{
+	struct fsl_edma_desc *next;
+
+	if (!fsl_chan->tail || fsl_chan->tail->iscyclic)
+		return;
+
+	next = fsl_chan->tail;
+	list_for_each_entry_continue(next, &fsl_chan->vchan.desc_issued,
+				     vdesc.node) {
+		if (next->iscyclic ||
+		    !fsl_edma_link_desc(fsl_chan, fsl_chan->tail, next))
+			break;
+		fsl_chan->tail = next;
+	}
+}
+
+/*
+ * Tell whether the engine has finished @edesc. A descriptor chained to
+ * its successor is done once the live link address no longer points
+ * inside it; the end of the chain is done when the channel is DONE.
+ */
+static bool fsl_edma_desc_hw_done(struct fsl_edma_chan *fsl_chan,
+				  struct fsl_edma_desc *edesc)
+{
+	void __iomem *addr = fsl_chan->edma->membase;
+	u32 ch = fsl_chan->vchan.chan.chan_id;
+	struct fsl_edma_hw_tcd *last = edesc->tcd[edesc->n_tcds - 1].vtcd;
+	u32 dlast;
+	int i;
+
+	if (!edesc->hw_linked)
+		return edma_readw(fsl_chan->edma, addr + EDMA_TCD_CSR(ch)) &
+			EDMA_TCD_CSR_DONE;
+
+	dlast = edma_readl(fsl_chan->edma, addr + EDMA_TCD_DLAST_SGA(ch));
+	for (i = 1; i < edesc->n_tcds; i++)
+		if (dlast == edesc->tcd[i].ptcd)
+			return false;
+
+	return dlast != le32_to_cpu(last->dlast_sga);
+}
+
+static void fsl_edma_complete_desc(struct fsl_edma_chan *fsl_chan)
+{
+	struct fsl_edma_desc *edesc = fsl_chan->edesc;
+
+	list_del(&edesc->vdesc.node);
+	vchan_cookie_complete(&edesc->vdesc);
+
+	if (edesc->hw_linked) {
+		/* already running, nothing to re-arm */
+		fsl_chan->edesc =
+			to_fsl_edma_desc(vchan_next_desc(&fsl_chan->vchan));
+		return;
+	}
+
+	fsl_chan->edesc = NULL;
+	fsl_chan->tail = NULL;
+	fsl_chan->status = DMA_COMPLETE;
+	fsl_chan->idle = true;
+}
+
 static void fsl_edma_get_realcnt(struct fsl_edma_chan *fsl_chan)
 {
 	fsl_chan->chn_real_count = fsl_edma_desc_residue(fsl_chan, NULL, true);
@@ -762,13 +932,22 @@ static irqreturn_t fsl_edma_tx_handler(int irq, void *dev_id)
 			fsl_chan = &fsl_edma->chans[ch];
 
 			spin_lock(&fsl_chan->vchan.lock);
+			if (!fsl_chan->edesc) {
+				spin_unlock(&fsl_chan->vchan.lock);
+				continue;
+			}
+
 			if (!fsl_chan->edesc->iscyclic) {
-				fsl_edma_get_realcnt(fsl_chan);
-				list_del(&fsl_chan->edesc->vdesc.node);
-				vchan_cookie_complete(&fsl_chan->edesc->vdesc);
-				fsl_chan->edesc = NULL;
-				fsl_chan->status = DMA_COMPLETE;
-				fsl_chan->idle = true;
+				/*
+				 * Interrupts of back-to-back chained
+				 * descriptors may have merged into one.
+				 */
+				while (fsl_chan->edesc &&
+				       fsl_edma_desc_hw_done(fsl_chan,
+							     fsl_chan->edesc)) {
+					fsl_edma_get_realcnt(fsl_chan);
+					fsl_edma_complete_desc(fsl_chan);
+				}
 			} else {
 				vchan_cyclic_callback(&fsl_chan->edesc->vdesc);
 			}
@@ -825,8 +1004,11 @@ static void fsl_edma_issue_pending(struct dma_chan *chan)
 		return;
 	}
 
-	if (vchan_issue_pending(&fsl_chan->vchan) && !fsl_chan->edesc)
-		fsl_edma_xfer_desc(fsl_chan);
+	if (vchan_issue_pending(&fsl_chan->vchan)) {
+		if (!fsl_chan->edesc)
+			fsl_edma_xfer_desc(fsl_chan);
+		fsl_edma_link_pending(fsl_chan);
+	}
 
 	spin_unlock_irqrestore(&fsl_chan->vchan.lock, flags);
 }
@@ -883,6 +1065,8 @@ static void fsl_edma_free_chan_resources(struct dma_chan *chan)
 	fsl_edma_disable_request(fsl_chan);
 	fsl_edma_chan_mux(fsl_chan, 0, false);
 	fsl_chan->edesc = NULL;
+	fsl_chan->tail = NULL;
+	fsl_chan->link_ch = -1;
 	vchan_get_all_descriptors(&fsl_chan->vchan, &head);
 	spin_unlock_irqrestore(&fsl_chan->vchan.lock, flags);
 
@@ -1096,6 +1280,7 @@ static int fsl_edma_probe(struct platform_device *pdev)
 		fsl_chan->edma = fsl_edma;
 		fsl_chan->pm_state = RUNNING;
 		fsl_chan->slave_id = 0;
+		fsl_chan->link_ch = -1;
 		fsl_chan->idle = true;
 		fsl_chan->vchan.desc_free = fsl_edma_free_desc;
 		vchan_init(&fsl_chan->vchan, &fsl_edma->dma_dev);
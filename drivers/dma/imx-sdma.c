@@ -18,6 +18,7 @@
  */
 
 #include <linux/init.h>
+#include <linux/debugfs.h>
 #include <linux/iopoll.h>
 #include <linux/module.h>
 #include <linux/types.h>
@@ -28,6 +29,7 @@
 #include <linux/delay.h>
 #include <linux/sched.h>
 #include <linux/semaphore.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
 #include <linux/device.h>
 #include <linux/genalloc.h>
@@ -303,8 +305,24 @@ struct sdma_desc {
 	unsigned int			buf_ptail;
 	struct sdma_channel		*sdmac;
 	struct sdma_buffer_descriptor	*bd;
+	unsigned int			period_bds;
+	bool				no_period_irq;
+	ktime_t				issue_stamp;
+	ktime_t				irq_stamp;
 };
 
+/*
+ * Cyclic transfers split each period over up to this many BDs, only the
+ * last of which interrupts, so that the residue moves within a period.
+ * Without DMA_PREP_INTERRUPT the BDs ending each half of the buffer are
+ * the only ones to interrupt, just to hand the BDs back to the engine,
+ * and no callback is made.
+ */
+#define SDMA_CYCLIC_PERIOD_BDS	4
+
+/* IRQ to callback latencies, bucket n counts those below 2^n us */
+#define SDMA_LAT_BUCKETS	16
+
 /**
  * struct sdma_channel - housekeeping for a SDMA channel
  *
@@ -319,6 +337,13 @@ struct sdma_desc {
  * @buf_ptail		ID of the previous buffer that was processed
  * @num_bd		max NUM_BD. number of descriptors currently handling
  * @bd_iram		flag indicating the memory location of buffer descriptor
+ * @direct_complete	complete descriptors from the interrupt handler rather
+ *			than the virt-dma tasklet
+ * @lat_hist		histogram of the IRQ to callback latencies
+ * @priority		current priority of the channel in the SDMA scheduler
+ * @queue_ns		total time descriptors waited from issue to start
+ * @queue_max_ns	longest such wait
+ * @queue_count		number of descriptors started
  */
 struct sdma_channel {
 	struct virt_dma_chan		vc;
@@ -349,10 +374,37 @@ struct sdma_channel {
 	bool				src_dualfifo;
 	bool				dst_dualfifo;
 	struct dma_pool			*bd_pool;
+	bool				direct_complete;
+	unsigned long			lat_hist[SDMA_LAT_BUCKETS];
+	unsigned int			priority;
+	u64				queue_ns;
+	u64				queue_max_ns;
+	unsigned long			queue_count;
 };
 
 #define IMX_DMA_SG_LOOP		BIT(0)
 
+/* Flags in the optional fourth cell of a DT dma specifier */
+#define SDMA_DT_FLAG_DIRECT_COMPLETE	BIT(0)
+
+/*
+ * Once a slave channel has been requested, dmaengine makes the whole device
+ * private, so the memcpy channels offered to async_tx and other public users
+ * sit on a dma_device of their own.  Copies shorter than memcpy_threshold
+ * are refused there, async_memcpy() and friends then do them on the CPU.
+ */
+#define SDMA_MAX_MEMCPY_CHANNELS	4
+
+static unsigned int memcpy_channels;
+module_param(memcpy_channels, uint, 0444);
+MODULE_PARM_DESC(memcpy_channels,
+		 "Channels set aside as public memcpy engine (default: 0)");
+
+static unsigned int memcpy_threshold = 4096;
+module_param(memcpy_threshold, uint, 0644);
+MODULE_PARM_DESC(memcpy_threshold,
+		 "Shortest copy offloaded by the public memcpy engine (default: 4096)");
+
 #define MAX_DMA_CHANNELS 32
 #define MXC_SDMA_DEFAULT_PRIORITY 1
 #define MXC_SDMA_MIN_PRIORITY 1
@@ -424,6 +476,14 @@ struct sdma_engine {
 	bool				bd0_iram;
 	struct sdma_buffer_descriptor	*bd0;
 	bool				suspend_off;
+	/* RAM scripts of the loaded firmware, to restore them on resume */
+	void				*ram_code;
+	u32				ram_code_size;
+	u32				ram_code_addr;
+	struct dentry			*debugfs;
+	/* public memcpy engine for async_tx, see memcpy_channels */
+	struct dma_device		memcpy_device;
+	bool				memcpy_registered;
 };
 
 static struct sdma_driver_data sdma_imx31 = {
@@ -742,7 +802,16 @@ static void sdma_event_disable(struct sdma_channel *sdmac, unsigned int event)
 	writel_relaxed(val, sdma->regs + chnenbl);
 }
 
-static void sdma_update_channel_loop(struct sdma_channel *sdmac)
+static void sdma_account_latency(struct sdma_channel *sdmac, ktime_t stamp)
+{
+	s64 us = ktime_us_delta(ktime_get(), stamp);
+	int bucket = us > 0 ? fls64(us) : 0;
+
+	sdmac->lat_hist[min(bucket, SDMA_LAT_BUCKETS - 1)]++;
+}
+
+static void sdma_update_channel_loop(struct sdma_channel *sdmac,
+				     ktime_t stamp)
 {
 	struct sdma_buffer_descriptor *bd;
 	struct sdma_desc *desc = sdmac->desc;
@@ -771,13 +840,20 @@ static void sdma_update_channel_loop(struct sdma_channel *sdmac)
 		*/
 
 		sdmac->chn_real_count = bd->mode.count;
+		this_cpu_add(sdmac->vc.chan.local->bytes_transferred,
+			     bd->mode.count);
 		bd->mode.status |= BD_DONE;
-		bd->mode.count = sdmac->period_len;
+		bd->mode.count = sdmac->period_len / desc->period_bds;
 		desc->buf_ptail = desc->buf_tail;
 		desc->buf_tail = (desc->buf_tail + 1) % desc->num_bd;
 
 		if (error)
 			sdmac->status = old_status;
+
+		/* Only the last BD of a period completes it */
+		if (desc->buf_tail % desc->period_bds || desc->no_period_irq)
+			continue;
+
 		/*
 		* The callback is called from the interrupt context in order
 		* to reduce latency and to avoid the risk of altering the
@@ -785,6 +861,7 @@ static void sdma_update_channel_loop(struct sdma_channel *sdmac)
 		* executed.
                 */
 		spin_unlock(&sdmac->vc.lock);
+		sdma_account_latency(sdmac, stamp);
 		dmaengine_desc_get_callback_invoke(&desc->vd.tx, NULL);
 		spin_lock(&sdmac->vc.lock);
 	}
@@ -808,15 +885,49 @@ static void mxc_sdma_handle_channel_normal(struct sdma_channel *data)
 		 sdmac->chn_real_count += bd->mode.count;
 	}
 
+	this_cpu_inc(sdmac->vc.chan.local->memcpy_count);
+	this_cpu_add(sdmac->vc.chan.local->bytes_transferred,
+		     sdmac->chn_real_count);
+
 	if (error)
 		sdmac->status = DMA_ERROR;
 	else
 		sdmac->status = DMA_COMPLETE;
 }
 
+/*
+ * Complete a descriptor from the interrupt handler, sparing low latency
+ * clients the trip through the virt-dma tasklet, which may be held up
+ * behind other softirq work.  Called and returns with vc.lock held but
+ * drops it around the callback.
+ */
+static void sdma_complete_direct(struct sdma_channel *sdmac,
+				 struct sdma_desc *desc, ktime_t stamp)
+{
+	struct dmaengine_desc_callback cb;
+	bool reuse = dmaengine_desc_test_reuse(&desc->vd.tx);
+
+	dma_cookie_complete(&desc->vd.tx);
+	dmaengine_desc_get_callback(&desc->vd.tx, &cb);
+	if (reuse)
+		list_add(&desc->vd.node, &sdmac->vc.desc_allocated);
+
+	/* Get the next transfer going before running the callback */
+	sdma_start_desc(sdmac);
+	spin_unlock(&sdmac->vc.lock);
+
+	if (!reuse)
+		sdmac->vc.desc_free(&desc->vd);
+
+	sdma_account_latency(sdmac, stamp);
+	dmaengine_desc_callback_invoke(&cb, NULL);
+	spin_lock(&sdmac->vc.lock);
+}
+
 static irqreturn_t sdma_int_handler(int irq, void *dev_id)
 {
 	struct sdma_engine *sdma = dev_id;
+	ktime_t stamp = ktime_get();
 	unsigned long stat;
 
 	stat = readl_relaxed(sdma->regs + SDMA_H_INTR);
@@ -834,15 +945,21 @@ static irqreturn_t sdma_int_handler(int irq, void *dev_id)
 		if (desc) {
 			if (sdmac->flags & IMX_DMA_SG_LOOP) {
 				if (sdmac->peripheral_type != IMX_DMATYPE_HDMI)
-					sdma_update_channel_loop(sdmac);
+					sdma_update_channel_loop(sdmac, stamp);
 				else
 					vchan_cyclic_callback(&desc->vd);
 			} else {
 				mxc_sdma_handle_channel_normal(sdmac);
-				vchan_cookie_complete(&desc->vd);
 				if (!list_empty(&sdmac->pending))
 					list_del(&desc->node);
-				sdma_start_desc(sdmac);
+				if (sdmac->direct_complete) {
+					sdma_complete_direct(sdmac, desc,
+							     stamp);
+				} else {
+					desc->irq_stamp = stamp;
+					vchan_cookie_complete(&desc->vd);
+					sdma_start_desc(sdmac);
+				}
 			}
 		}
 		__clear_bit(channel, &stat);
@@ -1184,10 +1301,42 @@ static int sdma_set_channel_priority(struct sdma_channel *sdmac,
 	}
 
 	writel_relaxed(priority, sdma->regs + SDMA_CHNPRI_0 + 4 * channel);
+	sdmac->priority = priority;
 
 	return 0;
 }
 
+/**
+ * imx_sdma_set_priority - change the priority of a channel at runtime
+ * @chan:	SDMA channel, as obtained from dma_request_channel() and friends
+ * @priority:	MXC_SDMA_MIN_PRIORITY (1) to MXC_SDMA_MAX_PRIORITY (7)
+ *
+ * The SDMA core always runs the pending channel of highest priority and
+ * round robins between channels of equal priority, so this lets latency
+ * sensitive clients keep ahead of bulk ones whatever their DT setting.
+ * The priority is set again from the client data when the channel is next
+ * allocated.
+ */
+int imx_sdma_set_priority(struct dma_chan *chan, unsigned int priority)
+{
+	struct sdma_channel *sdmac;
+	int ret;
+
+	if (strcmp(chan->device->dev->driver->name, "imx-sdma"))
+		return -EINVAL;
+
+	sdmac = to_sdma_chan(chan);
+	ret = clk_enable(sdmac->sdma->clk_ipg);
+	if (ret)
+		return ret;
+
+	ret = sdma_set_channel_priority(sdmac, priority);
+	clk_disable(sdmac->sdma->clk_ipg);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(imx_sdma_set_priority);
+
 static int sdma_alloc_bd(struct sdma_desc *desc)
 {
 	u32 bd_size = desc->num_bd * sizeof(struct sdma_buffer_descriptor);
@@ -1268,6 +1417,15 @@ static void sdma_desc_free(struct virt_dma_desc *vd)
 {
 	struct sdma_desc *desc = container_of(vd, struct sdma_desc, vd);
 	if (desc) {
+		/* async_tx users hand over their mappings and dependencies */
+		dma_descriptor_unmap(&vd->tx);
+		dma_run_dependencies(&vd->tx);
+		/*
+		 * Completed descriptors are freed by the virt-dma tasklet
+		 * right before their callback is run.
+		 */
+		if (desc->irq_stamp.tv64)
+			sdma_account_latency(desc->sdmac, desc->irq_stamp);
 		sdma_free_bd(desc);
 		kfree(desc);
 	}
@@ -1367,6 +1525,7 @@ static int sdma_alloc_chan_resources(struct dma_chan *chan)
 		default_data.peripheral_type = IMX_DMATYPE_MEMORY;
 		default_data.dma_request = 0;
 		default_data.dma_request2 = 0;
+		default_data.direct_complete = false;
 		data = &default_data;
 
 		sdma_config_ownership(sdmac, false, true, false);
@@ -1392,6 +1551,11 @@ static int sdma_alloc_chan_resources(struct dma_chan *chan)
 	sdmac->event_id1 = data->dma_request2;
 	sdmac->src_dualfifo = data->src_dualfifo;
 	sdmac->dst_dualfifo = data->dst_dualfifo;
+	sdmac->direct_complete = data->direct_complete;
+	memset(sdmac->lat_hist, 0, sizeof(sdmac->lat_hist));
+	sdmac->queue_ns = 0;
+	sdmac->queue_max_ns = 0;
+	sdmac->queue_count = 0;
 
 	ret = sdma_set_channel_priority(sdmac, prio);
 	if (ret)
@@ -1452,6 +1616,7 @@ static struct sdma_desc *sdma_transfer_init(struct sdma_channel *sdmac,
 
 	desc->sdmac = sdmac;
 	desc->num_bd = bds;
+	desc->period_bds = 1;
 	INIT_LIST_HEAD(&desc->node);
 
 	if (sdma_alloc_bd(desc))
@@ -1562,6 +1727,16 @@ err_out:
  * dst_sg node no smaller than src_sg. To simply things, please use the same
  * size of dst_sg as src_sg.
  */
+static struct dma_async_tx_descriptor *sdma_prep_public_memcpy(
+		struct dma_chan *chan, dma_addr_t dma_dst,
+		dma_addr_t dma_src, size_t len, unsigned long flags)
+{
+	if (len < READ_ONCE(memcpy_threshold))
+		return NULL;
+
+	return sdma_prep_memcpy(chan, dma_dst, dma_src, len, flags);
+}
+
 static struct dma_async_tx_descriptor *sdma_prep_sg(
 		struct dma_chan *chan,
 		struct scatterlist *dst_sg, unsigned int dst_nents,
@@ -1664,6 +1839,20 @@ static struct dma_async_tx_descriptor *sdma_prep_slave_sg(
 	return sdma_prep_sg(chan, NULL, 0, sgl, sg_len, direction, flags);
 }
 
+static unsigned int sdma_cyclic_period_bds(struct sdma_channel *sdmac,
+					   size_t period_len,
+					   unsigned int num_periods)
+{
+	unsigned int width = sdmac->word_size ? sdmac->word_size : 1;
+	unsigned int n = SDMA_CYCLIC_PERIOD_BDS;
+
+	while (n > 1 && (num_periods * n > NUM_BD ||
+			 period_len % (n * width)))
+		n >>= 1;
+
+	return n;
+}
+
 static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 		struct dma_chan *chan, dma_addr_t dma_addr, size_t buf_len,
 		size_t period_len, enum dma_transfer_direction direction,
@@ -1675,15 +1864,29 @@ static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 	int i = 0, buf = 0;
 	int num_periods = 0;
 	struct sdma_desc *desc;
+	unsigned int period_bds = 1;
+	size_t bd_len;
 
 	dev_dbg(sdma->dev, "%s channel: %d\n", __func__, channel);
 
 	if (sdmac->peripheral_type != IMX_DMATYPE_HDMI)
 		num_periods = buf_len / period_len;
+	/*
+	 * UART RX reports partial periods from chn_count on its own and
+	 * wants each BD to be a period.
+	 */
+	if (sdmac->peripheral_type != IMX_DMATYPE_UART)
+		period_bds = sdma_cyclic_period_bds(sdmac, period_len,
+						    num_periods);
+	bd_len = period_len / period_bds;
+
 	/* Now allocate and setup the descriptor. */
-	desc = sdma_transfer_init(sdmac, direction, num_periods);
+	desc = sdma_transfer_init(sdmac, direction, num_periods * period_bds);
 	if (!desc)
 		goto err_out;
+	desc->period_bds = period_bds;
+	desc->no_period_irq = !(flags & DMA_PREP_INTERRUPT) &&
+			      direction != DMA_DEV_TO_DEV;
 
 	sdmac->period_len = period_len;
 	sdmac->flags |= IMX_DMA_SG_LOOP;
@@ -1711,7 +1914,7 @@ static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 
 		bd->buffer_addr = dma_addr;
 
-		bd->mode.count = period_len;
+		bd->mode.count = bd_len;
 
 		if (sdmac->word_size > DMA_SLAVE_BUSWIDTH_4_BYTES)
 			goto err_bd_out;
@@ -1720,19 +1923,25 @@ static struct dma_async_tx_descriptor *sdma_prep_dma_cyclic(
 		else
 			bd->mode.command = sdmac->word_size;
 
-		param = BD_DONE | BD_EXTD | BD_CONT | BD_INTR;
-		if (i + 1 == num_periods)
+		param = BD_DONE | BD_EXTD | BD_CONT;
+		if (desc->no_period_irq) {
+			if (i + 1 == desc->num_bd / 2 || i + 1 == desc->num_bd)
+				param |= BD_INTR;
+		} else if ((i + 1) % period_bds == 0) {
+			param |= BD_INTR;
+		}
+		if (i + 1 == desc->num_bd)
 			param |= BD_WRAP;
 
-		dev_dbg(sdma->dev, "entry %d: count: %d dma: %pad %s%s\n",
-				i, period_len, &dma_addr,
+		dev_dbg(sdma->dev, "entry %d: count: %zu dma: %pad %s%s\n",
+				i, bd_len, &dma_addr,
 				param & BD_WRAP ? "wrap" : "",
 				param & BD_INTR ? " intr" : "");
 
 		bd->mode.status = param;
 
-		dma_addr += period_len;
-		buf += period_len;
+		dma_addr += bd_len;
+		buf += bd_len;
 
 		i++;
 	}
@@ -1783,9 +1992,32 @@ static void sdma_wait_tasklet(struct dma_chan *chan)
 {
 	struct sdma_channel *sdmac = to_sdma_chan(chan);
 
+	/* Cyclic and direct callbacks run from the interrupt handler */
+	synchronize_irq(sdmac->sdma->irq);
 	tasklet_kill(&sdmac->vc.task);
 }
 
+/*
+ * The engine clears BD_DONE as it finishes each BD, the interrupt handler
+ * sets it again when it hands the BD back.  The first BD from buf_tail on
+ * still marked done is the one in progress.
+ */
+static u32 sdma_cyclic_residue(struct sdma_channel *sdmac,
+			       struct sdma_desc *desc)
+{
+	unsigned int bd_len = sdmac->period_len / desc->period_bds;
+	unsigned int i = desc->buf_tail;
+	unsigned int n;
+
+	for (n = 0; n < desc->num_bd; n++) {
+		if (desc->bd[i].mode.status & BD_DONE)
+			break;
+		i = (i + 1) % desc->num_bd;
+	}
+
+	return (desc->num_bd - i) * bd_len;
+}
+
 static enum dma_status sdma_tx_status(struct dma_chan *chan,
 				      dma_cookie_t cookie,
 				      struct dma_tx_state *txstate)
@@ -1813,8 +2045,7 @@ static enum dma_status sdma_tx_status(struct dma_chan *chan,
 	if (vd) {
 		if ((sdmac->flags & IMX_DMA_SG_LOOP)) {
 			if (sdmac->peripheral_type != IMX_DMATYPE_UART)
-				residue = (desc->num_bd - desc->buf_ptail) *
-					   sdmac->period_len - sdmac->chn_real_count;
+				residue = sdma_cyclic_residue(sdmac, desc);
 			else
 				residue = sdmac->chn_count - sdmac->chn_real_count;
 		} else
@@ -1831,6 +2062,16 @@ static enum dma_status sdma_tx_status(struct dma_chan *chan,
 	return ret;
 }
 
+static void sdma_account_queued(struct sdma_channel *sdmac,
+				struct sdma_desc *desc)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), desc->issue_stamp));
+
+	sdmac->queue_ns += ns;
+	sdmac->queue_max_ns = max(sdmac->queue_max_ns, ns);
+	sdmac->queue_count++;
+}
+
 static void sdma_start_desc(struct sdma_channel *sdmac)
 {
 	struct virt_dma_desc *vd = vchan_next_desc(&sdmac->vc);
@@ -1843,6 +2084,7 @@ static void sdma_start_desc(struct sdma_channel *sdmac)
 		return;
 	}
 	sdmac->desc = desc = to_sdma_desc(&vd->tx);
+	sdma_account_queued(sdmac, desc);
 	/*
 	 * Do not delete the node in desc_issued list in cyclic mode, otherwise
 	 * the desc alloced will never be freed in vchan_dma_desc_free_list
@@ -1859,9 +2101,13 @@ static void sdma_start_desc(struct sdma_channel *sdmac)
 static void sdma_issue_pending(struct dma_chan *chan)
 {
 	struct sdma_channel *sdmac = to_sdma_chan(chan);
+	ktime_t now = ktime_get();
+	struct virt_dma_desc *vd;
 	unsigned long flags;
 
 	spin_lock_irqsave(&sdmac->vc.lock, flags);
+	list_for_each_entry(vd, &sdmac->vc.desc_submitted, node)
+		to_sdma_desc(&vd->tx)->issue_stamp = now;
 	if (vchan_issue_pending(&sdmac->vc) && !sdmac->desc)
 		sdma_start_desc(sdmac);
 	spin_unlock_irqrestore(&sdmac->vc.lock, flags);
@@ -1942,6 +2188,14 @@ static void sdma_load_firmware(const struct firmware *fw, void *context)
 
 	sdma_add_scripts(sdma, addr);
 
+	/* Keep the checked image so resume needn't go back to the loader */
+	sdma->ram_code = devm_kmemdup(sdma->dev, ram_code,
+				      header->ram_code_size, GFP_KERNEL);
+	if (sdma->ram_code) {
+		sdma->ram_code_size = header->ram_code_size;
+		sdma->ram_code_addr = addr->ram_code_start_addr;
+	}
+
 	dev_info(sdma->dev, "loaded firmware %d.%d\n",
 			header->version_major,
 			header->version_minor);
@@ -2019,8 +2273,18 @@ out:
 static int sdma_get_firmware(struct sdma_engine *sdma,
 		const char *fw_name)
 {
+	const struct firmware *fw;
 	int ret;
 
+	/*
+	 * A firmware built into the kernel or present on the initramfs is
+	 * loaded right away, so clients needn't wait for the scripts.
+	 */
+	if (!request_firmware_direct(&fw, fw_name, sdma->dev)) {
+		sdma_load_firmware(fw, sdma);
+		return 0;
+	}
+
 	ret = request_firmware_nowait(THIS_MODULE,
 			FW_ACTION_HOTPLUG, fw_name, sdma->dev,
 			GFP_KERNEL, sdma, sdma_load_firmware);
@@ -2125,7 +2389,7 @@ static struct dma_chan *sdma_xlate(struct of_phandle_args *dma_spec,
 	dma_cap_mask_t mask = sdma->dma_device.cap_mask;
 	struct imx_dma_data data;
 
-	if (dma_spec->args_count != 3)
+	if (dma_spec->args_count != 3 && dma_spec->args_count != 4)
 		return NULL;
 
 	memset(&data, 0, sizeof(data));
@@ -2133,10 +2397,143 @@ static struct dma_chan *sdma_xlate(struct of_phandle_args *dma_spec,
 	data.dma_request = dma_spec->args[0];
 	data.peripheral_type = dma_spec->args[1];
 	data.priority = dma_spec->args[2];
+	/* Optional fourth cell, flags */
+	if (dma_spec->args_count == 4)
+		data.direct_complete = dma_spec->args[3] &
+				       SDMA_DT_FLAG_DIRECT_COMPLETE;
 
 	return dma_request_channel(mask, sdma_filter_fn, &data);
 }
 
+static ssize_t sdma_priority_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct dma_chan *chan = container_of(dev, struct dma_chan_dev,
+					     device)->chan;
+
+	return sprintf(buf, "%u\n", to_sdma_chan(chan)->priority);
+}
+
+static ssize_t sdma_priority_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct dma_chan *chan = container_of(dev, struct dma_chan_dev,
+					     device)->chan;
+	unsigned int priority;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &priority);
+	if (ret)
+		return ret;
+
+	ret = imx_sdma_set_priority(chan, priority);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(sdma_priority);
+
+/* Let the priority be tuned per channel from /sys/class/dma/dma*chan* */
+static void sdma_init_sysfs(struct sdma_engine *sdma)
+{
+	int i;
+
+	for (i = 1; i < MAX_DMA_CHANNELS; i++) {
+		struct dma_chan *chan = &sdma->channel[i].vc.chan;
+
+		if (chan->dev &&
+		    device_create_file(&chan->dev->device,
+				       &dev_attr_sdma_priority))
+			dev_warn(sdma->dev, "channel %d: no priority attribute\n",
+				 i);
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int sdma_debugfs_show(struct seq_file *s, void *data)
+{
+	struct sdma_engine *sdma = s->private;
+	int i, j;
+
+	/* Channel 0 only ever runs the internal channel 0 scripts */
+	for (i = 1; i < MAX_DMA_CHANNELS; i++) {
+		struct sdma_channel *sdmac = &sdma->channel[i];
+
+		if (!sdmac->bd_pool)
+			continue;
+
+		seq_printf(s, "channel %d: %s completion, IRQ to callback:\n",
+			   i, sdmac->direct_complete ? "direct" : "tasklet");
+		for (j = 0; j < SDMA_LAT_BUCKETS - 1; j++)
+			seq_printf(s, "\t< %6lu us: %lu\n", 1UL << j,
+				   sdmac->lat_hist[j]);
+		seq_printf(s, "\t>= %5lu us: %lu\n", 1UL << j,
+			   sdmac->lat_hist[j]);
+		seq_printf(s, "\tpriority %u, issue to start: avg %llu us, max %llu us\n",
+			   sdmac->priority,
+			   sdmac->queue_count ?
+			   div_u64(div_u64(sdmac->queue_ns,
+					   sdmac->queue_count),
+				   NSEC_PER_USEC) : 0,
+			   div_u64(sdmac->queue_max_ns, NSEC_PER_USEC));
+	}
+
+	return 0;
+}
+
+static int sdma_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdma_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations sdma_debugfs_operations = {
+	.open		= sdma_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void sdma_init_debugfs(struct sdma_engine *sdma)
+{
+	sdma->debugfs = debugfs_create_file(dev_name(sdma->dev), 0444,
+					    NULL, sdma,
+					    &sdma_debugfs_operations);
+}
+#else
+static inline void sdma_init_debugfs(struct sdma_engine *sdma)
+{
+}
+#endif
+
+static void sdma_register_memcpy(struct sdma_engine *sdma)
+{
+	struct dma_device *dd = &sdma->memcpy_device;
+
+	dma_cap_set(DMA_MEMCPY, dd->cap_mask);
+	dma_cap_set(DMA_SG, dd->cap_mask);
+
+	dd->dev = sdma->dev;
+	dd->device_alloc_chan_resources = sdma_alloc_chan_resources;
+	dd->device_free_chan_resources = sdma_free_chan_resources;
+	dd->device_tx_status = sdma_tx_status;
+	dd->device_synchronize = sdma_wait_tasklet;
+	dd->device_terminate_all = sdma_terminate_all;
+	dd->device_prep_dma_memcpy = sdma_prep_public_memcpy;
+	dd->device_prep_dma_sg = sdma_prep_memcpy_sg;
+	dd->device_issue_pending = sdma_issue_pending;
+	dd->residue_granularity = DMA_RESIDUE_GRANULARITY_BURST;
+	dd->copy_align = sdma->dma_device.copy_align;
+
+	if (dma_async_device_register(dd)) {
+		dev_warn(sdma->dev, "unable to register memcpy channels\n");
+		return;
+	}
+
+	sdma->memcpy_registered = true;
+	dev_info(sdma->dev, "%u channels offered for public memcpy\n",
+		 memcpy_channels);
+}
+
 static int sdma_probe(struct platform_device *pdev)
 {
 	const struct of_device_id *of_id =
@@ -2218,6 +2615,9 @@ static int sdma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_MEMCPY, sdma->dma_device.cap_mask);
 
 	INIT_LIST_HEAD(&sdma->dma_device.channels);
+	INIT_LIST_HEAD(&sdma->memcpy_device.channels);
+	memcpy_channels = min_t(unsigned int, memcpy_channels,
+				SDMA_MAX_MEMCPY_CHANNELS);
 	/* Initialize channel parameters */
 	for (i = 0; i < MAX_DMA_CHANNELS; i++) {
 		struct sdma_channel *sdmac = &sdma->channel[i];
@@ -2233,8 +2633,11 @@ static int sdma_probe(struct platform_device *pdev)
 		 * Add the channel to the DMAC list. Do not add channel 0 though
 		 * because we need it internally in the SDMA driver. This also means
 		 * that channel 0 in dmaengine counting matches sdma channel 1.
+		 * The last memcpy_channels channels go to the memcpy device.
 		 */
-		if (i)
+		if (i >= MAX_DMA_CHANNELS - memcpy_channels)
+			vchan_init(&sdmac->vc, &sdma->memcpy_device);
+		else if (i)
 			vchan_init(&sdmac->vc, &sdma->dma_device);
 	}
 
@@ -2309,6 +2712,14 @@ static int sdma_probe(struct platform_device *pdev)
 		goto err_init;
 	}
 
+	/*
+	 * Reloading the scripts may take a while. The clients only use the
+	 * engine from their normal resume callbacks, which all run after
+	 * the late phase sdma_resume() completed, so it may run alongside
+	 * the other late phase devices.
+	 */
+	device_enable_async_suspend(&pdev->dev);
+
 	if (np) {
 		ret = of_dma_controller_register(np, sdma_xlate, sdma);
 		if (ret) {
@@ -2325,6 +2736,12 @@ static int sdma_probe(struct platform_device *pdev)
 		of_node_put(spba_bus);
 	}
 
+	if (memcpy_channels)
+		sdma_register_memcpy(sdma);
+
+	sdma_init_sysfs(sdma);
+	sdma_init_debugfs(sdma);
+
 	return 0;
 
 err_register:
@@ -2339,7 +2756,10 @@ static int sdma_remove(struct platform_device *pdev)
 	struct sdma_engine *sdma = platform_get_drvdata(pdev);
 	int i;
 
+	debugfs_remove(sdma->debugfs);
 	devm_free_irq(&pdev->dev, sdma->irq, sdma);
+	if (sdma->memcpy_registered)
+		dma_async_device_unregister(&sdma->memcpy_device);
 	dma_async_device_unregister(&sdma->dma_device);
 	kfree(sdma->script_addrs);
 	/* Kill the tasklet */
@@ -2434,10 +2854,19 @@ static int sdma_resume(struct device *dev)
 	/* prepare priority for channel0 to start */
 	sdma_set_channel_priority(&sdma->channel[0], MXC_SDMA_DEFAULT_PRIORITY);
 
-	ret = sdma_get_firmware(sdma, sdma->fw_name);
-	if (ret) {
-		dev_warn(&pdev->dev, "failed to get firware\n");
-		return ret;
+	/*
+	 * The script RAM went down with the mix, put it back from the copy
+	 * of the firmware.  Without one the ROM scripts are in use, or the
+	 * firmware is still on its way and loads itself.
+	 */
+	if (sdma->ram_code) {
+		ret = sdma_load_script(sdma, sdma->ram_code,
+				       sdma->ram_code_size,
+				       sdma->ram_code_addr);
+		if (ret) {
+			dev_err(sdma->dev, "restore scripts error!\n");
+			return ret;
+		}
 	}
 
 	ret = sdma_save_restore_context(sdma, false);
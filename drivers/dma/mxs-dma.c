@@ -105,7 +105,20 @@ struct mxs_dma_ccw {
 };
 
 #define CCW_BLOCK_SIZE	(4 * PAGE_SIZE)
-#define NUM_CCW	(int)(CCW_BLOCK_SIZE / sizeof(struct mxs_dma_ccw))
+
+/*
+ * A channel starts with CCW_BLOCK_SIZE worth of CCWs, and its block is
+ * doubled, up to this many times, when a longer chain is prepared.  The
+ * blocks outgrown may still be fetched from by a running chain and are
+ * only freed with the channel.
+ */
+#define MXS_DMA_MAX_CCW_ORDER	4
+
+struct mxs_dma_ccw_block {
+	struct mxs_dma_ccw		*ccw;
+	dma_addr_t			phys;
+	size_t				size;
+};
 
 struct mxs_dma_chan {
 	struct mxs_dma_engine		*mxs_dma;
@@ -115,10 +128,15 @@ struct mxs_dma_chan {
 	unsigned int			chan_irq;
 	struct mxs_dma_ccw		*ccw;
 	dma_addr_t			ccw_phys;
+	size_t				ccw_size;
+	int				ccw_num;
+	struct mxs_dma_ccw_block	ccw_old[MXS_DMA_MAX_CCW_ORDER];
+	int				ccw_old_num;
 	int				desc_count;
 	enum dma_status			status;
 	unsigned int			flags;
 	bool				reset;
+	bool				busy;
 #define MXS_DMA_SG_LOOP			(1 << 0)
 #define MXS_DMA_USE_SEMAPHORE		(1 << 1)
 };
@@ -257,6 +275,7 @@ static void mxs_dma_reset_chan(struct dma_chan *chan)
 	}
 
 	mxs_chan->status = DMA_COMPLETE;
+	mxs_chan->busy = false;
 }
 
 static void mxs_dma_enable_chan(struct dma_chan *chan)
@@ -280,6 +299,7 @@ static void mxs_dma_enable_chan(struct dma_chan *chan)
 		writel(1, mxs_dma->base + HW_APBHX_CHn_SEMA(mxs_dma, chan_id));
 	}
 	mxs_chan->reset = false;
+	mxs_chan->busy = true;
 }
 
 static void mxs_dma_disable_chan(struct dma_chan *chan)
@@ -287,6 +307,7 @@ static void mxs_dma_disable_chan(struct dma_chan *chan)
 	struct mxs_dma_chan *mxs_chan = to_mxs_dma_chan(chan);
 
 	mxs_chan->status = DMA_COMPLETE;
+	mxs_chan->busy = false;
 }
 
 static int mxs_dma_pause_chan(struct dma_chan *chan)
@@ -407,6 +428,7 @@ static irqreturn_t mxs_dma_int_handler(int irq, void *dev_id)
 					HW_APBHX_CHn_SEMA(mxs_dma, chan));
 		} else {
 			mxs_chan->status = DMA_COMPLETE;
+			mxs_chan->busy = false;
 		}
 	}
 
@@ -435,6 +457,9 @@ static int mxs_dma_alloc_chan_resources(struct dma_chan *chan)
 		ret = -ENOMEM;
 		goto err_alloc;
 	}
+	mxs_chan->ccw_size = CCW_BLOCK_SIZE;
+	mxs_chan->ccw_num = CCW_BLOCK_SIZE / sizeof(struct mxs_dma_ccw);
+	mxs_chan->ccw_old_num = 0;
 
 	ret = request_irq(mxs_chan->chan_irq, mxs_dma_int_handler,
 			  0, "mxs-dma", mxs_dma);
@@ -481,8 +506,15 @@ static void mxs_dma_free_chan_resources(struct dma_chan *chan)
 
 	free_irq(mxs_chan->chan_irq, mxs_dma);
 
-	dma_free_coherent(mxs_dma->dma_device.dev, CCW_BLOCK_SIZE,
+	dma_free_coherent(mxs_dma->dma_device.dev, mxs_chan->ccw_size,
 			mxs_chan->ccw, mxs_chan->ccw_phys);
+	while (mxs_chan->ccw_old_num) {
+		struct mxs_dma_ccw_block *old =
+			&mxs_chan->ccw_old[--mxs_chan->ccw_old_num];
+
+		dma_free_coherent(mxs_dma->dma_device.dev, old->size,
+				  old->ccw, old->phys);
+	}
 
 	if (mxs_dma->dev_id == IMX7D_DMA)
 		clk_disable_unprepare(mxs_dma->clk_io);
@@ -490,6 +522,61 @@ static void mxs_dma_free_chan_resources(struct dma_chan *chan)
 	clk_disable_unprepare(mxs_dma->clk);
 }
 
+/*
+ * Make room for a chain of num CCWs, keeping the first keep ones of the
+ * chain being prepared.  Their links into the old block are moved over.
+ */
+static int mxs_dma_grow_ccw(struct mxs_dma_chan *mxs_chan, int num, int keep)
+{
+	struct mxs_dma_engine *mxs_dma = mxs_chan->mxs_dma;
+	struct mxs_dma_ccw_block *old;
+	struct mxs_dma_ccw *ccw;
+	dma_addr_t phys;
+	size_t size = mxs_chan->ccw_size;
+	int i;
+
+	if (num <= mxs_chan->ccw_num)
+		return 0;
+
+	/* A running chain can't be moved */
+	if (keep && mxs_chan->busy)
+		return -EBUSY;
+
+	while (size / sizeof(*ccw) < num)
+		size <<= 1;
+
+	if (size > CCW_BLOCK_SIZE << MXS_DMA_MAX_CCW_ORDER ||
+	    mxs_chan->ccw_old_num == MXS_DMA_MAX_CCW_ORDER)
+		return -EINVAL;
+
+	/* prep callbacks may be called from atomic context */
+	ccw = dma_zalloc_coherent(mxs_dma->dma_device.dev, size, &phys,
+				  GFP_NOWAIT);
+	if (!ccw)
+		return -ENOMEM;
+
+	memcpy(ccw, mxs_chan->ccw, keep * sizeof(*ccw));
+	for (i = 0; i < keep; i++) {
+		u32 next = ccw[i].next;
+
+		if (next >= mxs_chan->ccw_phys &&
+		    next < mxs_chan->ccw_phys + mxs_chan->ccw_size)
+			ccw[i].next = next - mxs_chan->ccw_phys + phys;
+	}
+
+	old = &mxs_chan->ccw_old[mxs_chan->ccw_old_num++];
+	old->ccw = mxs_chan->ccw;
+	old->phys = mxs_chan->ccw_phys;
+	old->size = mxs_chan->ccw_size;
+
+	mxs_chan->ccw = ccw;
+	mxs_chan->ccw_phys = phys;
+	mxs_chan->ccw_size = size;
+	mxs_chan->ccw_num = size / sizeof(*ccw);
+
+	return 0;
+}
+
 /*
  * How to use the flags for ->device_prep_slave_sg() :
  *    [1] If there is only one DMA command in the DMA chain, the code should be:
@@ -529,10 +616,11 @@ static struct dma_async_tx_descriptor *mxs_dma_prep_slave_sg(
 	if (mxs_chan->status == DMA_IN_PROGRESS && !append)
 		return NULL;
 
-	if (sg_len + (append ? idx : 0) > NUM_CCW) {
+	if (mxs_dma_grow_ccw(mxs_chan, sg_len + (append ? idx : 0),
+			     append ? idx : 0)) {
 		dev_err(mxs_dma->dma_device.dev,
 				"maximum number of sg exceeded: %d > %d\n",
-				sg_len, NUM_CCW);
+				sg_len, mxs_chan->ccw_num);
 		goto err_out;
 	}
 
@@ -627,10 +715,10 @@ static struct dma_async_tx_descriptor *mxs_dma_prep_dma_cyclic(
 	mxs_chan->flags |= MXS_DMA_SG_LOOP;
 	mxs_chan->flags |= MXS_DMA_USE_SEMAPHORE;
 
-	if (num_periods > NUM_CCW) {
+	if (mxs_dma_grow_ccw(mxs_chan, num_periods, 0)) {
 		dev_err(mxs_dma->dma_device.dev,
 				"maximum number of sg exceeded: %d > %d\n",
-				num_periods, NUM_CCW);
+				num_periods, mxs_chan->ccw_num);
 		goto err_out;
 	}
 
@@ -25,6 +25,8 @@
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
+#include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/pxp_device.h>
@@ -35,6 +37,8 @@
 
 static struct pxp_buffer_hash bufhash;
 static struct pxp_irq_info irq_info[NR_PXP_VIRT_CHANNEL];
+static DECLARE_WAIT_QUEUE_HEAD(pxp_poll_waitq);
+static struct device *pxp_dev;
 
 static int pxp_ht_create(struct pxp_buffer_hash *hash, int order)
 {
@@ -249,6 +253,73 @@ static void pxp_free_dma_buffer(struct pxp_buf_obj *obj)
 	}
 }
 
+static int pxp_import_dma_buffer(struct pxp_buf_obj *obj, int fd)
+{
+	struct scatterlist *sg;
+	dma_addr_t next;
+	int i, ret;
+
+	obj->dmabuf = dma_buf_get(fd);
+	if (IS_ERR(obj->dmabuf))
+		return PTR_ERR(obj->dmabuf);
+
+	obj->attach = dma_buf_attach(obj->dmabuf, pxp_dev);
+	if (IS_ERR(obj->attach)) {
+		ret = PTR_ERR(obj->attach);
+		goto err_put;
+	}
+
+	obj->sgt = dma_buf_map_attachment(obj->attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(obj->sgt)) {
+		ret = PTR_ERR(obj->sgt);
+		goto err_detach;
+	}
+
+	/* the PxP has no scatter-gather, the buffer must be one block */
+	next = sg_dma_address(obj->sgt->sgl);
+	for_each_sg(obj->sgt->sgl, sg, obj->sgt->nents, i) {
+		if (sg_dma_address(sg) != next) {
+			pr_err("%s: dma-buf is not contiguous\n", __func__);
+			ret = -EINVAL;
+			goto err_unmap;
+		}
+		next += sg_dma_len(sg);
+	}
+
+	obj->offset = sg_dma_address(obj->sgt->sgl);
+	obj->size = obj->dmabuf->size;
+
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment(obj->attach, obj->sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(obj->dmabuf, obj->attach);
+err_put:
+	dma_buf_put(obj->dmabuf);
+	obj->dmabuf = NULL;
+	return ret;
+}
+
+static void pxp_release_dma_buffer(struct pxp_buf_obj *obj)
+{
+	dma_buf_unmap_attachment(obj->attach, obj->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(obj->dmabuf, obj->attach);
+	dma_buf_put(obj->dmabuf);
+}
+
+/* imported buffers are mapped by their exporter, not through bufhash */
+static void pxp_buffer_object_destroy(struct pxp_buf_obj *obj)
+{
+	if (obj->dmabuf) {
+		pxp_release_dma_buffer(obj);
+	} else {
+		pxp_ht_remove_item(&bufhash, obj);
+		pxp_free_dma_buffer(obj);
+	}
+	kfree(obj);
+}
+
 static int
 pxp_buffer_object_free(int id, void *ptr, void *data)
 {
@@ -260,9 +331,7 @@ pxp_buffer_object_free(int id, void *ptr, void *data)
 	if (ret < 0)
 		return ret;
 
-	pxp_ht_remove_item(&bufhash, obj);
-	pxp_free_dma_buffer(obj);
-	kfree(obj);
+	pxp_buffer_object_destroy(obj);
 
 	return 0;
 }
@@ -313,38 +382,20 @@ static void pxp_dma_done(void *arg)
 	irq_info[chan_id].hist_status = tx_desc->hist_status;
 
 	wake_up(&(irq_info[chan_id].waitq));
+	wake_up(&pxp_poll_waitq);
 }
 
-static int pxp_ioc_config_chan(struct pxp_file *priv, unsigned long arg)
+static int pxp_config_chan(struct pxp_chan_obj *obj,
+			   struct pxp_config_data *pxp_conf)
 {
 	struct scatterlist *sg;
 	struct pxp_tx_desc *desc;
 	struct dma_async_tx_descriptor *txd;
-	struct pxp_config_data *pxp_conf;
 	dma_cookie_t cookie;
-	int handle, chan_id;
+	int chan_id;
 	struct dma_chan *chan;
-	struct pxp_chan_obj *obj;
-	int i = 0, j = 0, k = 0, m = 0, length, ret, sg_len;
+	int i = 0, j = 0, k = 0, m = 0, length, sg_len;
 
-	pxp_conf = kzalloc(sizeof(*pxp_conf), GFP_KERNEL);
-	if (!pxp_conf)
-		return -ENOMEM;
-
-	ret = copy_from_user(pxp_conf,
-			     (struct pxp_config_data *)arg,
-			     sizeof(struct pxp_config_data));
-	if (ret) {
-		kfree(pxp_conf);
-		return -EFAULT;
-	}
-
-	handle = pxp_conf->handle;
-	obj = pxp_channel_object_lookup(priv, handle);
-	if (!obj) {
-		kfree(pxp_conf);
-		return -EINVAL;
-	}
 	chan = obj->chan;
 	chan_id = chan->chan_id;
 
@@ -357,10 +408,8 @@ static int pxp_ioc_config_chan(struct pxp_file *priv, unsigned long arg)
 		sg_len += 4;
 
 	sg = kmalloc(sizeof(*sg) * sg_len, GFP_KERNEL);
-	if (!sg) {
-		kfree(pxp_conf);
+	if (!sg)
 		return -ENOMEM;
-	}
 
 	sg_init_table(sg, sg_len);
 
@@ -371,7 +420,6 @@ static int pxp_ioc_config_chan(struct pxp_file *priv, unsigned long arg)
 						 NULL);
 	if (!txd) {
 		pr_err("Error preparing a DMA transaction descriptor.\n");
-		kfree(pxp_conf);
 		kfree(sg);
 		return -EIO;
 	}
@@ -494,19 +542,125 @@ static int pxp_ioc_config_chan(struct pxp_file *priv, unsigned long arg)
 	cookie = txd->tx_submit(txd);
 	if (cookie < 0) {
 		pr_err("Error tx_submit\n");
-		kfree(pxp_conf);
 		kfree(sg);
 		return -EIO;
 	}
 
 	atomic_inc(&irq_info[chan_id].irq_pending);
+	atomic_set(&obj->submitted, 1);
 
-	kfree(pxp_conf);
 	kfree(sg);
 
 	return 0;
 }
 
+static int pxp_ioc_config_chan(struct pxp_file *priv, unsigned long arg)
+{
+	struct pxp_config_data *pxp_conf;
+	struct pxp_chan_obj *obj;
+	int ret;
+
+	pxp_conf = kzalloc(sizeof(*pxp_conf), GFP_KERNEL);
+	if (!pxp_conf)
+		return -ENOMEM;
+
+	ret = copy_from_user(pxp_conf,
+			     (struct pxp_config_data *)arg,
+			     sizeof(struct pxp_config_data));
+	if (ret) {
+		kfree(pxp_conf);
+		return -EFAULT;
+	}
+
+	obj = pxp_channel_object_lookup(priv, pxp_conf->handle);
+	if (!obj) {
+		kfree(pxp_conf);
+		return -EINVAL;
+	}
+
+	ret = pxp_config_chan(obj, pxp_conf);
+	kfree(pxp_conf);
+
+	return ret;
+}
+
+/*
+ * Queue every configuration of the batch on one channel and start it
+ * once. Whatever got queued before a failure is still started, so the
+ * pending count drains and the caller can wait for it as usual.
+ */
+static int pxp_ioc_submit_batch(struct pxp_file *priv, unsigned long arg)
+{
+	struct pxp_config_data __user *uconf;
+	struct pxp_config_data *pxp_conf;
+	struct pxp_batch_data batch;
+	struct pxp_chan_obj *obj;
+	int i, ret = 0;
+
+	if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+		return -EFAULT;
+
+	if (!batch.num || batch.num > PXP_BATCH_MAX)
+		return -EINVAL;
+
+	obj = pxp_channel_object_lookup(priv, batch.handle);
+	if (!obj)
+		return -EINVAL;
+
+	pxp_conf = kmalloc(sizeof(*pxp_conf), GFP_KERNEL);
+	if (!pxp_conf)
+		return -ENOMEM;
+
+	uconf = (struct pxp_config_data __user *)(uintptr_t)batch.configs;
+	for (i = 0; i < batch.num; i++) {
+		if (copy_from_user(pxp_conf, &uconf[i], sizeof(*pxp_conf))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = pxp_config_chan(obj, pxp_conf);
+		if (ret)
+			break;
+	}
+
+	if (i)
+		dma_async_issue_pending(obj->chan);
+
+	kfree(pxp_conf);
+
+	return ret;
+}
+
+static int pxp_poll_chan(int id, void *ptr, void *data)
+{
+	struct pxp_chan_obj *obj = ptr;
+	int chan_id = obj->chan->chan_id;
+
+	/* a non-zero return stops the walk: one idle channel is enough */
+	return atomic_read(&obj->submitted) &&
+	       atomic_read(&irq_info[chan_id].irq_pending) == 0;
+}
+
+/*
+ * The device is readable once a channel of this file has finished the
+ * work queued on it. WAIT4CMPLT then returns without blocking and
+ * collects the histogram status, which rearms the channel for poll().
+ */
+static unsigned int pxp_device_poll(struct file *filp, poll_table *wait)
+{
+	struct pxp_file *priv = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &pxp_poll_waitq, wait);
+
+	spin_lock(&priv->channel_lock);
+	if (idr_for_each(&priv->channel_idr, pxp_poll_chan, NULL))
+		mask = POLLIN | POLLRDNORM;
+	spin_unlock(&priv->channel_lock);
+
+	return mask;
+}
+
 static int pxp_device_open(struct inode *inode, struct file *filp)
 {
 	struct pxp_file *priv;
@@ -671,6 +825,16 @@ static long pxp_device_ioctl(struct file *filp,
 			if (ret)
 				return ret;
 
+			break;
+		}
+	case PXP_IOC_SUBMIT_BATCH:
+		{
+			int ret;
+
+			ret = pxp_ioc_submit_batch(file_priv, arg);
+			if (ret)
+				return ret;
+
 			break;
 		}
 	case PXP_IOC_START_CHAN:
@@ -758,9 +922,46 @@ static long pxp_device_ioctl(struct file *filp,
 			if (ret)
 				return ret;
 
-			pxp_ht_remove_item(&bufhash, obj);
-			pxp_free_dma_buffer(obj);
-			kfree(obj);
+			pxp_buffer_object_destroy(obj);
+
+			break;
+		}
+	case PXP_IOC_IMPORT_DMABUF:
+		{
+			struct pxp_dmabuf_desc desc;
+			struct pxp_buf_obj *obj;
+
+			if (copy_from_user(&desc, (void __user *)arg,
+					   sizeof(desc)))
+				return -EFAULT;
+
+			obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+			if (!obj)
+				return -ENOMEM;
+
+			ret = pxp_import_dma_buffer(obj, desc.fd);
+			if (ret) {
+				kfree(obj);
+				return ret;
+			}
+
+			ret = pxp_buffer_handle_create(file_priv, obj, &obj->handle);
+			if (ret) {
+				pxp_release_dma_buffer(obj);
+				kfree(obj);
+				return ret;
+			}
+			desc.handle = obj->handle;
+			desc.size = obj->size;
+			desc.phys_addr = obj->offset;
+
+			if (copy_to_user((void __user *)arg, &desc,
+					 sizeof(desc))) {
+				pxp_buffer_handle_delete(file_priv, desc.handle);
+				pxp_release_dma_buffer(obj);
+				kfree(obj);
+				return -EFAULT;
+			}
 
 			break;
 		}
@@ -780,6 +981,10 @@ static long pxp_device_ioctl(struct file *filp,
 			if (!obj)
 				return -EINVAL;
 
+			/* imports are synced through DMA_BUF_IOCTL_SYNC */
+			if (obj->dmabuf)
+				break;
+
 			switch (flush.type) {
 			case CACHE_CLEAN:
 				dma_sync_single_for_device(NULL, obj->offset,
@@ -827,6 +1032,7 @@ static long pxp_device_ioctl(struct file *filp,
 				return -ERESTARTSYS;
 
 			chan_handle.hist_status = irq_info[chan_id].hist_status;
+			atomic_set(&obj->submitted, 0);
 			ret = copy_to_user((struct pxp_chan_handle *)arg,
 					   &chan_handle,
 					   sizeof(struct pxp_chan_handle));
@@ -846,6 +1052,7 @@ static const struct file_operations pxp_device_fops = {
 	.release = pxp_device_release,
 	.unlocked_ioctl = pxp_device_ioctl,
 	.mmap = pxp_device_mmap,
+	.poll = pxp_device_poll,
 };
 
 static struct miscdevice pxp_device_miscdev = {
@@ -854,10 +1061,12 @@ static struct miscdevice pxp_device_miscdev = {
 	.fops = &pxp_device_fops,
 };
 
-int register_pxp_device(void)
+int register_pxp_device(struct device *dev)
 {
 	int ret;
 
+	pxp_dev = dev;
+
 	ret = misc_register(&pxp_device_miscdev);
 	if (ret)
 		return ret;
@@ -1765,7 +1765,7 @@ static int pxp_probe(struct platform_device *pdev)
 		goto exit;
 	}
 
-	register_pxp_device();
+	register_pxp_device(pxp->dev);
 
 	pm_runtime_enable(pxp->dev);
 
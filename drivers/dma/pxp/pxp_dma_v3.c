@@ -932,6 +932,7 @@ static __attribute__((aligned (1024*4))) unsigned int bit4_dither_data_8x8[64]={
 static void pxp_dithering_configure(struct pxps *pxp);
 static void pxp_dithering_configure_v3p(struct pxps *pxp);
 static void pxp_dithering_process(struct pxps *pxp);
+static void pxp_dithering_setup(struct pxps *pxp);
 static void pxp_wfe_a_process(struct pxps *pxp);
 static void pxp_wfe_a_process_v3p(struct pxps *pxp);
 static void pxp_wfe_a_configure(struct pxps *pxp);
@@ -3494,21 +3495,13 @@ config:
 	return 0;
 }
 
-/**
- * pxp_config() - configure PxP for a processing task
- * @pxps:	PXP context.
- * @pxp_chan:	PXP channel.
- * @return:	0 on success or negative error code on failure.
- */
-static int pxp_config(struct pxps *pxp, struct pxp_channel *pxp_chan)
+static int pxp_config_op(struct pxps *pxp, uint32_t op_type)
 {
 	int ret = 0;
-	struct pxp_task_info *task = &pxp->task;
-	struct pxp_op_info *op = &task->op_info;
 	struct pxp_config_data *pxp_conf_data = &pxp->pxp_conf_state;
 	struct pxp_proc_data *proc_data = &pxp_conf_data->proc_data;
 
-	switch (op->op_type) {
+	switch (op_type) {
 	case PXP_OP_TYPE_2D:
 		pxp_writel(0xffffffff, HW_PXP_OUT_AS_ULC);
 		pxp_writel(0x0, HW_PXP_OUT_AS_LRC);
@@ -3569,6 +3562,80 @@ static int pxp_config(struct pxps *pxp, struct pxp_channel *pxp_chan)
 	return ret;
 }
 
+/*
+ * On v3p the dither engine sits between mux12 and the output store, so
+ * a 2D result can be dithered on its way out instead of being written
+ * back and fetched again by a separate dither operation.
+ */
+static int pxp_2d_dither_config(struct pxps *pxp)
+{
+	struct pxp_pixmap *output = &pxp->task.output[0];
+	u32 out_lrc;
+	int ret;
+
+	if (!pxp_is_v3p(pxp) || output->format != PXP_PIX_FMT_GREY) {
+		dev_err(pxp->dev, "unsupport inline dithering\n");
+		return -EINVAL;
+	}
+
+	ret = pxp_config_op(pxp, PXP_OP_TYPE_2D);
+	if (ret)
+		return ret;
+
+	pxp_dithering_setup(pxp);
+
+	out_lrc = __raw_readl(pxp->base + HW_PXP_OUT_LRC);
+	__raw_writel(BF_PXP_DITHER_STORE_SIZE_CH0_OUT_WIDTH(
+			(out_lrc & BM_PXP_OUT_LRC_X) >> BP_PXP_OUT_LRC_X) |
+		BF_PXP_DITHER_STORE_SIZE_CH0_OUT_HEIGHT(
+			(out_lrc & BM_PXP_OUT_LRC_Y) >> BP_PXP_OUT_LRC_Y),
+		pxp->base + HW_PXP_DITHER_STORE_SIZE_CH0);
+
+	/* mux14 input 0 is the dither engine */
+	__raw_writel(BF_PXP_DATA_PATH_CTRL0_MUX14_SEL(1),
+			pxp->base + HW_PXP_DATA_PATH_CTRL0_CLR);
+	__raw_writel(BM_PXP_CTRL_ENABLE_DITHER, pxp->base + HW_PXP_CTRL_SET);
+
+	return 0;
+}
+
+/**
+ * pxp_config() - configure PxP for a processing task
+ * @pxps:	PXP context.
+ * @pxp_chan:	PXP channel.
+ * @return:	0 on success or negative error code on failure.
+ */
+static int pxp_config(struct pxps *pxp, struct pxp_channel *pxp_chan)
+{
+	struct pxp_op_info *op = &pxp->task.op_info;
+	uint32_t stages = op->op_type, stage;
+	int ret;
+
+	if (stages == (PXP_OP_TYPE_2D | PXP_OP_TYPE_DITHER))
+		return pxp_2d_dither_config(pxp);
+
+	/* v3p dithering starts the engine as soon as it is configured */
+	if (pxp_is_v3p(pxp) && (stages & PXP_OP_TYPE_DITHER) &&
+	    (stages & ~PXP_OP_TYPE_DITHER)) {
+		dev_err(pxp->dev, "unsupport dither handshake on v3p\n");
+		return -EINVAL;
+	}
+
+	/*
+	 * Handshaked stages are configured upstream first; pxp_start2()
+	 * then links them so that the whole chain runs in one pass.
+	 */
+	while (stages) {
+		stage = stages & -stages;
+		ret = pxp_config_op(pxp, stage);
+		if (ret)
+			return ret;
+		stages &= ~stage;
+	}
+
+	return 0;
+}
+
 static void pxp_clk_enable(struct pxps *pxp)
 {
 	mutex_lock(&pxp->clk_mutex);
@@ -3690,6 +3757,7 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 	struct pxp_pixmap *input, *output;
 	int i = 0, ret;
 	bool combine_enable = false;
+	bool dither_inline;
 
 	memset(&pxp->pxp_conf_state.s0_param, 0,  sizeof(struct pxp_layer_param));
 	memset(&pxp->pxp_conf_state.out_param, 0,  sizeof(struct pxp_layer_param));
@@ -3745,7 +3813,7 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 				memcpy(&pxp->pxp_conf_state.dither_store_param[1],
 				       &child->layer_param.processing_param,
 				       sizeof(struct pxp_layer_param));
-			op->op_type = PXP_OP_TYPE_DITHER;
+			op->op_type |= PXP_OP_TYPE_DITHER;
 		}
 
 		if (proc_data->engine_enable & PXP_ENABLE_WFE_A) {
@@ -3765,7 +3833,7 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 				memcpy(&pxp->pxp_conf_state.wfe_a_store_param[1],
 				       &child->layer_param.processing_param,
 				       sizeof(struct pxp_layer_param));
-			op->op_type = PXP_OP_TYPE_WFE_A;
+			op->op_type |= PXP_OP_TYPE_WFE_A;
 		}
 
 		if (proc_data->engine_enable & PXP_ENABLE_WFE_B) {
@@ -3785,12 +3853,22 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 				memcpy(&pxp->pxp_conf_state.wfe_b_store_param[1],
 				       &child->layer_param.processing_param,
 				       sizeof(struct pxp_layer_param));
-			op->op_type = PXP_OP_TYPE_WFE_B;
+			op->op_type |= PXP_OP_TYPE_WFE_B;
 		}
 
 		i++;
 	}
 
+	/* without handshake only the last engine of the job runs */
+	if (op->op_type && !(proc_data->engine_enable & PXP_ENABLE_HANDSHAKE))
+		op->op_type = 1 << (fls(op->op_type) - 1);
+
+	dither_inline = (proc_data->engine_enable &
+			 (PXP_ENABLE_PS_AS_OUT | PXP_ENABLE_DITHER)) ==
+			(PXP_ENABLE_PS_AS_OUT | PXP_ENABLE_DITHER);
+	if (dither_inline)
+		op->op_type = 0;
+
 	if (!op->op_type) {
 		op->op_type = PXP_OP_TYPE_2D;
 
@@ -3869,6 +3947,9 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 		output->crop.height = proc_data->drect.height;
 	}
 
+	if (dither_inline)
+		op->op_type |= PXP_OP_TYPE_DITHER;
+
 	pr_debug("%s:%d S0 w/h %d/%d paddr %08x\n", __func__, __LINE__,
 		 pxp->pxp_conf_state.s0_param.width,
 		 pxp->pxp_conf_state.s0_param.height,
@@ -3924,7 +4005,9 @@ static int pxpdma_dostart_work(struct pxps *pxp)
 		return -EINVAL;
 	}
 
-	if (proc_data->working_mode & PXP_MODE_STANDARD) {
+	if (pxp->task.op_info.op_type == (PXP_OP_TYPE_2D | PXP_OP_TYPE_DITHER))
+		pxp_start(pxp);
+	else if (proc_data->working_mode & PXP_MODE_STANDARD) {
 		if(!pxp_is_v3p(pxp) || !(proc_data->engine_enable & PXP_ENABLE_DITHER))
 			pxp_start2(pxp);
 	} else
@@ -6969,14 +7052,19 @@ static void pxp_set_final_lut_data(struct pxps *pxp)
 }
 
 static void pxp_dithering_process(struct pxps *pxp)
+{
+	if (pxp->devdata && pxp->devdata->pxp_dithering_configure)
+		pxp->devdata->pxp_dithering_configure(pxp);
+
+	pxp_dithering_setup(pxp);
+}
+
+static void pxp_dithering_setup(struct pxps *pxp)
 {
 	struct pxp_config_data *pxp_conf = &pxp->pxp_conf_state;
 	struct pxp_proc_data *proc_data = &pxp_conf->proc_data;
 	u32 val = 0;
 
-	if (pxp->devdata && pxp->devdata->pxp_dithering_configure)
-		pxp->devdata->pxp_dithering_configure(pxp);
-
 	if (pxp_is_v3(pxp))
 		val = BF_PXP_DITHER_CTRL_ENABLE0            (1) |
 		      BF_PXP_DITHER_CTRL_ENABLE1            (0) |
@@ -7985,7 +8073,7 @@ static int pxp_probe(struct platform_device *pdev)
 #ifdef	CONFIG_MXC_FPGA_M4_TEST
 	pxp_config_m4(pdev);
 #endif
-	register_pxp_device();
+	register_pxp_device(pxp->dev);
 	pm_runtime_enable(pxp->dev);
 
 	dma_alloc_coherent(NULL, PAGE_ALIGN(1920 * 1088 * 4),
@@ -2781,9 +2781,10 @@ EXPORT_SYMBOL(drm_atomic_helper_connector_set_property);
  *
  * Provides a default page flip implementation using the atomic driver interface.
  *
- * Note that for now so called async page flips (i.e. updates which are not
- * synchronized to vblank) are not supported, since the atomic interfaces have
- * no provisions for this yet.
+ * So called async page flips (i.e. updates which are not synchronized to
+ * vblank) are only accepted if the driver sets
+ * &drm_mode_config.async_page_flip, and are flagged in
+ * &drm_crtc_state.async_flip for the driver to act upon.
  *
  * Returns:
  * Returns 0 on success, negative errno numbers on failure.
@@ -2799,7 +2800,8 @@ int drm_atomic_helper_page_flip(struct drm_crtc *crtc,
 	struct drm_crtc_state *crtc_state;
 	int ret = 0;
 
-	if (flags & DRM_MODE_PAGE_FLIP_ASYNC)
+	if ((flags & DRM_MODE_PAGE_FLIP_ASYNC) &&
+	    !plane->dev->mode_config.async_page_flip)
 		return -EINVAL;
 
 	state = drm_atomic_state_alloc(plane->dev);
@@ -2814,6 +2816,7 @@ retry:
 		goto fail;
 	}
 	crtc_state->event = event;
+	crtc_state->async_flip = flags & DRM_MODE_PAGE_FLIP_ASYNC;
 
 	plane_state = drm_atomic_get_plane_state(state, plane);
 	if (IS_ERR(plane_state)) {
@@ -3030,6 +3033,7 @@ void __drm_atomic_helper_crtc_duplicate_state(struct drm_crtc *crtc,
 	state->color_mgmt_changed = false;
 	state->zpos_changed = false;
 	state->event = NULL;
+	state->async_flip = false;
 }
 EXPORT_SYMBOL(__drm_atomic_helper_crtc_duplicate_state);
 
@@ -3166,6 +3170,9 @@ void __drm_atomic_helper_plane_destroy_state(struct drm_plane_state *state)
 {
 	if (state->fb)
 		drm_framebuffer_unreference(state->fb);
+
+	if (state->fence)
+		fence_put(state->fence);
 }
 EXPORT_SYMBOL(__drm_atomic_helper_plane_destroy_state);
 
@@ -379,12 +379,58 @@ static int drm_gem_dmabuf_mmap(struct dma_buf *dma_buf,
 	return dev->driver->gem_prime_mmap(obj, vma);
 }
 
+static int drm_gem_dmabuf_begin_cpu_access_partial(struct dma_buf *dma_buf,
+						   enum dma_data_direction dir,
+						   unsigned int offset,
+						   unsigned int len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+	struct drm_device *dev = obj->dev;
+
+	if (!dev->driver->gem_prime_begin_cpu_access)
+		return 0;
+
+	return dev->driver->gem_prime_begin_cpu_access(obj, dir, offset, len);
+}
+
+static int drm_gem_dmabuf_end_cpu_access_partial(struct dma_buf *dma_buf,
+						 enum dma_data_direction dir,
+						 unsigned int offset,
+						 unsigned int len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+	struct drm_device *dev = obj->dev;
+
+	if (!dev->driver->gem_prime_end_cpu_access)
+		return 0;
+
+	return dev->driver->gem_prime_end_cpu_access(obj, dir, offset, len);
+}
+
+static int drm_gem_dmabuf_begin_cpu_access(struct dma_buf *dma_buf,
+					   enum dma_data_direction dir)
+{
+	return drm_gem_dmabuf_begin_cpu_access_partial(dma_buf, dir, 0,
+						       dma_buf->size);
+}
+
+static int drm_gem_dmabuf_end_cpu_access(struct dma_buf *dma_buf,
+					 enum dma_data_direction dir)
+{
+	return drm_gem_dmabuf_end_cpu_access_partial(dma_buf, dir, 0,
+						     dma_buf->size);
+}
+
 static const struct dma_buf_ops drm_gem_prime_dmabuf_ops =  {
 	.attach = drm_gem_map_attach,
 	.detach = drm_gem_map_detach,
 	.map_dma_buf = drm_gem_map_dma_buf,
 	.unmap_dma_buf = drm_gem_unmap_dma_buf,
 	.release = drm_gem_dmabuf_release,
+	.begin_cpu_access = drm_gem_dmabuf_begin_cpu_access,
+	.end_cpu_access = drm_gem_dmabuf_end_cpu_access,
+	.begin_cpu_access_partial = drm_gem_dmabuf_begin_cpu_access_partial,
+	.end_cpu_access_partial = drm_gem_dmabuf_end_cpu_access_partial,
 	.kmap = drm_gem_dmabuf_kmap,
 	.kmap_atomic = drm_gem_dmabuf_kmap_atomic,
 	.kunmap = drm_gem_dmabuf_kunmap,
@@ -409,6 +455,8 @@ static const struct dma_buf_ops drm_gem_prime_dmabuf_ops =  {
  *  * @gem_prime_vmap: vmap a buffer exported by your driver
  *  * @gem_prime_vunmap: vunmap a buffer exported by your driver
  *  * @gem_prime_mmap (optional): mmap a buffer exported by your driver
+ *  * @gem_prime_begin_cpu_access, @gem_prime_end_cpu_access (optional): cache
+ *    maintenance for a byte range of a buffer exported by your driver
  *
  * Import callback:
  *
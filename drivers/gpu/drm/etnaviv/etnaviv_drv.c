@@ -120,9 +120,15 @@ static void etnaviv_preclose(struct drm_device *dev, struct drm_file *file)
 		struct etnaviv_gpu *gpu = priv->gpu[i];
 
 		if (gpu) {
+			struct etnaviv_cmdbuf *cmdbuf;
+
 			mutex_lock(&gpu->lock);
 			if (gpu->lastctx == ctx)
 				gpu->lastctx = NULL;
+			/* queued buffers may outlive the file */
+			list_for_each_entry(cmdbuf, &gpu->queue_list, node)
+				if (cmdbuf->ctx == ctx)
+					cmdbuf->ctx = NULL;
 			mutex_unlock(&gpu->lock);
 		}
 	}
@@ -505,6 +511,8 @@ static struct drm_driver etnaviv_drm_driver = {
 	.gem_prime_import_sg_table = etnaviv_gem_prime_import_sg_table,
 	.gem_prime_vmap     = etnaviv_gem_prime_vmap,
 	.gem_prime_vunmap   = etnaviv_gem_prime_vunmap,
+	.gem_prime_begin_cpu_access = etnaviv_gem_prime_begin_cpu_access,
+	.gem_prime_end_cpu_access = etnaviv_gem_prime_end_cpu_access,
 #ifdef CONFIG_DEBUG_FS
 	.debugfs_init       = etnaviv_debugfs_init,
 	.debugfs_cleanup    = etnaviv_debugfs_cleanup,
@@ -581,9 +589,15 @@ static void etnaviv_unbind(struct device *dev)
 {
 	struct drm_device *drm = dev_get_drvdata(dev);
 	struct etnaviv_drm_private *priv = drm->dev_private;
+	unsigned int i;
 
 	drm_dev_unregister(drm);
 
+	/* cancel queued submits while retire_work can still run */
+	for (i = 0; i < ETNA_MAX_PIPES; i++)
+		if (priv->gpu[i])
+			etnaviv_gpu_queue_fini(priv->gpu[i]);
+
 	flush_workqueue(priv->wq);
 	destroy_workqueue(priv->wq);
 
@@ -82,10 +82,19 @@ struct drm_gem_object *etnaviv_gem_prime_import_sg_table(struct drm_device *dev,
 	struct dma_buf_attachment *attach, struct sg_table *sg);
 int etnaviv_gem_prime_pin(struct drm_gem_object *obj);
 void etnaviv_gem_prime_unpin(struct drm_gem_object *obj);
+int etnaviv_gem_prime_begin_cpu_access(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len);
+int etnaviv_gem_prime_end_cpu_access(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len);
 void *etnaviv_gem_vmap(struct drm_gem_object *obj);
 int etnaviv_gem_cpu_prep(struct drm_gem_object *obj, u32 op,
 		struct timespec *timeout);
 int etnaviv_gem_cpu_fini(struct drm_gem_object *obj);
+void etnaviv_gem_sync_range(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len, bool for_cpu);
 void etnaviv_gem_free_object(struct drm_gem_object *obj);
 int etnaviv_gem_new_handle(struct drm_device *dev, struct drm_file *file,
 		u32 size, u32 flags, u32 *handle);
@@ -461,6 +461,40 @@ int etnaviv_gem_cpu_fini(struct drm_gem_object *obj)
 	return 0;
 }
 
+/* cache maintenance of a cached bo, limited to [offset, offset + len) */
+void etnaviv_gem_sync_range(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len, bool for_cpu)
+{
+	struct etnaviv_gem_object *etnaviv_obj = to_etnaviv_bo(obj);
+	struct device *dev = obj->dev->dev;
+	unsigned int start = 0, end = offset + len;
+	struct scatterlist *sg;
+	int i;
+
+	if (!(etnaviv_obj->flags & ETNA_BO_CACHED) || !etnaviv_obj->sgt ||
+	    dir == DMA_NONE)
+		return;
+
+	for_each_sg(etnaviv_obj->sgt->sgl, sg, etnaviv_obj->sgt->nents, i) {
+		unsigned int from = max(start, offset);
+		unsigned int to = min(start + sg_dma_len(sg), end);
+		dma_addr_t addr = sg_dma_address(sg) + from - start;
+
+		start += sg_dma_len(sg);
+		if (from >= to)
+			continue;
+
+		if (for_cpu)
+			dma_sync_single_for_cpu(dev, addr, to - from, dir);
+		else
+			dma_sync_single_for_device(dev, addr, to - from, dir);
+
+		if (start >= end)
+			break;
+	}
+}
+
 int etnaviv_gem_wait_bo(struct etnaviv_gpu *gpu, struct drm_gem_object *obj,
 	struct timespec *timeout)
 {
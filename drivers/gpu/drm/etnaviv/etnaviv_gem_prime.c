@@ -62,6 +62,26 @@ void etnaviv_gem_prime_unpin(struct drm_gem_object *obj)
 	}
 }
 
+int etnaviv_gem_prime_begin_cpu_access(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len)
+{
+	if (!obj->import_attach)
+		etnaviv_gem_sync_range(obj, dir, offset, len, true);
+
+	return 0;
+}
+
+int etnaviv_gem_prime_end_cpu_access(struct drm_gem_object *obj,
+		enum dma_data_direction dir, unsigned int offset,
+		unsigned int len)
+{
+	if (!obj->import_attach)
+		etnaviv_gem_sync_range(obj, dir, offset, len, false);
+
+	return 0;
+}
+
 static void etnaviv_gem_prime_release(struct etnaviv_gem_object *etnaviv_obj)
 {
 	if (etnaviv_obj->vaddr)
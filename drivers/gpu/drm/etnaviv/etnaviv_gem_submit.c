@@ -15,6 +15,7 @@
  */
 
 #include <linux/reservation.h>
+#include <linux/sync_file.h>
 #include "etnaviv_drv.h"
 #include "etnaviv_gpu.h"
 #include "etnaviv_gem.h"
@@ -41,6 +42,8 @@ static struct etnaviv_gem_submit *submit_create(struct drm_device *dev,
 
 		/* initially, until copy_from_user() and bo lookup succeeds: */
 		submit->nr_bos = 0;
+		submit->out_fence = NULL;
+		submit->flags = 0;
 
 		ww_acquire_init(&submit->ticket, &reservation_ww_class);
 	}
@@ -160,16 +163,24 @@ fail:
 	return ret;
 }
 
-static int submit_fence_sync(const struct etnaviv_gem_submit *submit)
+static int submit_fence_sync(const struct etnaviv_gem_submit *submit,
+	struct etnaviv_cmdbuf *cmdbuf)
 {
-	unsigned int context = submit->gpu->fence_context;
 	int i, ret = 0;
 
 	for (i = 0; i < submit->nr_bos; i++) {
 		struct etnaviv_gem_object *etnaviv_obj = submit->bos[i].obj;
 		bool write = submit->bos[i].flags & ETNA_SUBMIT_BO_WRITE;
 
-		ret = etnaviv_gpu_fence_sync_obj(etnaviv_obj, context, write);
+		if (submit->flags & ETNA_SUBMIT_NO_IMPLICIT) {
+			/* still need room to publish our fence */
+			if (!write)
+				ret = reservation_object_reserve_shared(
+							etnaviv_obj->resv);
+		} else {
+			ret = etnaviv_gpu_fence_sync_obj(etnaviv_obj, cmdbuf,
+							 write);
+		}
 		if (ret)
 			break;
 	}
@@ -289,6 +300,8 @@ static void submit_cleanup(struct etnaviv_gem_submit *submit)
 	}
 
 	ww_acquire_fini(&submit->ticket);
+	if (submit->out_fence)
+		fence_put(submit->out_fence);
 	kfree(submit);
 }
 
@@ -302,6 +315,9 @@ int etnaviv_ioctl_gem_submit(struct drm_device *dev, void *data,
 	struct etnaviv_gem_submit *submit;
 	struct etnaviv_cmdbuf *cmdbuf;
 	struct etnaviv_gpu *gpu;
+	struct sync_file *sync_file;
+	struct fence *in_fence;
+	int out_fence_fd = -1;
 	void *stream;
 	int ret;
 
@@ -325,6 +341,11 @@ int etnaviv_ioctl_gem_submit(struct drm_device *dev, void *data,
 		return -EINVAL;
 	}
 
+	if (args->flags & ~ETNA_SUBMIT_FLAGS) {
+		DRM_ERROR("invalid flags: 0x%x\n", args->flags);
+		return -EINVAL;
+	}
+
 	/*
 	 * Copy the command submission and bo array to kernel space in
 	 * one go, and do this outside of any locks.
@@ -363,12 +384,35 @@ int etnaviv_ioctl_gem_submit(struct drm_device *dev, void *data,
 		goto err_submit_cmds;
 	}
 
+	if (args->flags & ETNA_SUBMIT_FENCE_FD_IN) {
+		in_fence = sync_file_get_fence(args->fence_fd);
+		if (!in_fence) {
+			ret = -EINVAL;
+			goto err_submit_cmds;
+		}
+
+		ret = etnaviv_cmdbuf_add_dep(cmdbuf, in_fence);
+		fence_put(in_fence);
+		if (ret)
+			goto err_submit_cmds;
+	}
+
+	if (args->flags & ETNA_SUBMIT_FENCE_FD_OUT) {
+		out_fence_fd = get_unused_fd_flags(O_CLOEXEC);
+		if (out_fence_fd < 0) {
+			ret = out_fence_fd;
+			goto err_submit_cmds;
+		}
+	}
+
 	submit = submit_create(dev, gpu, args->nr_bos);
 	if (!submit) {
 		ret = -ENOMEM;
 		goto err_submit_cmds;
 	}
 
+	submit->flags = args->flags;
+
 	ret = submit_lookup_objects(submit, file, bos, args->nr_bos);
 	if (ret)
 		goto err_submit_objects;
@@ -383,7 +427,7 @@ int etnaviv_ioctl_gem_submit(struct drm_device *dev, void *data,
 		goto err_submit_objects;
 	}
 
-	ret = submit_fence_sync(submit);
+	ret = submit_fence_sync(submit, cmdbuf);
 	if (ret)
 		goto err_submit_objects;
 
@@ -400,11 +444,24 @@ int etnaviv_ioctl_gem_submit(struct drm_device *dev, void *data,
 	cmdbuf->user_size = ALIGN(args->stream_size, 8);
 
 	ret = etnaviv_gpu_submit(gpu, submit, cmdbuf);
-	if (ret == 0)
-		cmdbuf = NULL;
+	if (ret)
+		goto out;
 
+	cmdbuf = NULL;
 	args->fence = submit->fence;
 
+	if (args->flags & ETNA_SUBMIT_FENCE_FD_OUT) {
+		/* the submit is queued already, only the fd is lost */
+		sync_file = sync_file_create(submit->out_fence);
+		if (!sync_file) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		fd_install(out_fence_fd, sync_file->file);
+		args->fence_fd = out_fence_fd;
+		out_fence_fd = -1;
+	}
+
 out:
 	submit_unpin_objects(submit);
 
@@ -420,6 +477,8 @@ err_submit_objects:
 	submit_cleanup(submit);
 
 err_submit_cmds:
+	if (out_fence_fd >= 0)
+		put_unused_fd(out_fence_fd);
 	/* if we still own the cmdbuf */
 	if (cmdbuf)
 		etnaviv_gpu_cmdbuf_free(cmdbuf);
@@ -14,10 +14,12 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/busfreq-imx.h>
 #include <linux/component.h>
 #include <linux/fence.h>
 #include <linux/moduleparam.h>
 #include <linux/of_device.h>
+#include <linux/pm_opp.h>
 #include "etnaviv_dump.h"
 #include "etnaviv_gpu.h"
 #include "etnaviv_gem.h"
@@ -131,6 +133,8 @@ int etnaviv_gpu_get_param(struct etnaviv_gpu *gpu, u32 param, u64 *value)
 }
 
 
+#define etnaviv_is_model(gpu, mod) \
+	((gpu)->identity.model == chipModel_##mod)
 #define etnaviv_is_model_rev(gpu, mod, rev) \
 	((gpu)->identity.model == chipModel_##mod && \
 	 (gpu)->identity.revision == rev)
@@ -597,6 +601,214 @@ static void etnaviv_gpu_hw_init(struct etnaviv_gpu *gpu)
 			     prefetch);
 }
 
+/*
+ * Frequency scaling:
+ *
+ * The core clock is scaled through devfreq between the OPPs given in DT.
+ * Load is taken from the HI profile cycle counters, which are sampled on
+ * every devfreq poll and before the clocks are gated, so cycles run between
+ * a poll and a runtime suspend are not lost. A deep in-flight queue reports
+ * the GPU as fully busy, as the FE is then never starved of work and a low
+ * clock directly adds latency to every queued submit.
+ */
+#define ETNAVIV_DEVFREQ_POLL_MS		50
+#define ETNAVIV_DEVFREQ_QUEUE_BOOST	3
+
+static void etnaviv_gpu_busfreq(struct etnaviv_gpu *gpu, bool high)
+{
+#ifdef CONFIG_ARCH_MXC
+	if (gpu->devfreq.busfreq_high == high)
+		return;
+
+	if (high)
+		request_bus_freq(BUS_FREQ_HIGH);
+	else
+		release_bus_freq(BUS_FREQ_HIGH);
+
+	gpu->devfreq.busfreq_high = high;
+#endif
+}
+
+/* GPU must be powered, start restarts counting after the clocks were gated */
+static void etnaviv_gpu_sample_cycles(struct etnaviv_gpu *gpu, bool start)
+{
+	struct etnaviv_gpu_devfreq *df = &gpu->devfreq;
+	u32 total, idle, dtotal, didle;
+	unsigned long flags;
+
+	/* these cores count total cycles in the MC, idle cycles in the HI */
+	if (etnaviv_is_model(gpu, GC880) || etnaviv_is_model(gpu, GC2000) ||
+	    etnaviv_is_model(gpu, GC2100)) {
+		total = gpu_read(gpu, VIVS_MC_PROFILE_CYCLE_COUNTER);
+		idle = gpu_read(gpu, VIVS_HI_PROFILE_TOTAL_CYCLES);
+	} else {
+		total = gpu_read(gpu, VIVS_HI_PROFILE_TOTAL_CYCLES);
+		idle = gpu_read(gpu, VIVS_HI_PROFILE_IDLE_CYCLES);
+	}
+
+	spin_lock_irqsave(&df->lock, flags);
+	if (!start) {
+		dtotal = total - df->total_cycles;
+		didle = idle - df->idle_cycles;
+		if (dtotal > didle)
+			df->busy_cycles += dtotal - didle;
+	}
+	df->total_cycles = total;
+	df->idle_cycles = idle;
+	spin_unlock_irqrestore(&df->lock, flags);
+}
+
+#ifdef CONFIG_PM_DEVFREQ
+static int etnaviv_gpu_devfreq_target(struct device *dev, unsigned long *freq,
+				      u32 flags)
+{
+	struct etnaviv_gpu *gpu = dev_get_drvdata(dev);
+	struct etnaviv_gpu_devfreq *df = &gpu->devfreq;
+	struct dev_pm_opp *opp;
+	unsigned long rate;
+	int ret;
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, freq, flags);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		return PTR_ERR(opp);
+	}
+	rate = dev_pm_opp_get_freq(opp);
+	rcu_read_unlock();
+
+	if (rate == clk_get_rate(gpu->clk_core)) {
+		*freq = rate;
+		return 0;
+	}
+
+	ret = clk_set_rate(gpu->clk_core, rate);
+	if (ret) {
+		dev_err(dev, "failed to set core clock to %lu: %d\n",
+			rate, ret);
+		return ret;
+	}
+
+	if (gpu->clk_shader && df->rate_shader)
+		clk_set_rate(gpu->clk_shader,
+			     div_u64((u64)df->rate_shader * rate,
+				     df->rate_core));
+
+	*freq = clk_get_rate(gpu->clk_core);
+
+	return 0;
+}
+
+static int etnaviv_gpu_devfreq_get_dev_status(struct device *dev,
+					      struct devfreq_dev_status *stat)
+{
+	struct etnaviv_gpu *gpu = dev_get_drvdata(dev);
+	struct etnaviv_gpu_devfreq *df = &gpu->devfreq;
+	unsigned long flags, mhz;
+	ktime_t now;
+	u64 busy;
+
+	/* only touch the hardware if it is powered anyway */
+	if (pm_runtime_get_if_in_use(gpu->dev) > 0) {
+		etnaviv_gpu_sample_cycles(gpu, false);
+		pm_runtime_put_autosuspend(gpu->dev);
+	}
+
+	now = ktime_get();
+
+	spin_lock_irqsave(&df->lock, flags);
+	busy = df->busy_cycles;
+	df->busy_cycles = 0;
+	stat->total_time = ktime_us_delta(now, df->time);
+	df->time = now;
+	spin_unlock_irqrestore(&df->lock, flags);
+
+	stat->current_frequency = clk_get_rate(gpu->clk_core);
+
+	mhz = stat->current_frequency / USEC_PER_SEC;
+	if (mhz)
+		busy = div_u64(busy, mhz);
+	stat->busy_time = min_t(u64, busy, stat->total_time);
+
+	if (gpu->active_fence - gpu->completed_fence >=
+	    ETNAVIV_DEVFREQ_QUEUE_BOOST)
+		stat->busy_time = stat->total_time;
+
+	return 0;
+}
+
+static int etnaviv_gpu_devfreq_get_cur_freq(struct device *dev,
+					    unsigned long *freq)
+{
+	struct etnaviv_gpu *gpu = dev_get_drvdata(dev);
+
+	*freq = clk_get_rate(gpu->clk_core);
+
+	return 0;
+}
+
+static void etnaviv_gpu_devfreq_init(struct etnaviv_gpu *gpu)
+{
+	struct etnaviv_gpu_devfreq *df = &gpu->devfreq;
+	struct devfreq_dev_profile *profile = &df->profile;
+	int ret;
+
+	if (!gpu->clk_core)
+		return;
+
+	ret = dev_pm_opp_of_add_table(gpu->dev);
+	if (ret) {
+		dev_dbg(gpu->dev, "no OPP table, frequency scaling disabled\n");
+		return;
+	}
+
+	df->rate_core = clk_get_rate(gpu->clk_core);
+	if (gpu->clk_shader)
+		df->rate_shader = clk_get_rate(gpu->clk_shader);
+	df->time = ktime_get();
+
+	profile->initial_freq = df->rate_core;
+	profile->polling_ms = ETNAVIV_DEVFREQ_POLL_MS;
+	profile->target = etnaviv_gpu_devfreq_target;
+	profile->get_dev_status = etnaviv_gpu_devfreq_get_dev_status;
+	profile->get_cur_freq = etnaviv_gpu_devfreq_get_cur_freq;
+
+	df->devfreq = devfreq_add_device(gpu->dev, profile, "simple_ondemand",
+					 NULL);
+	if (IS_ERR(df->devfreq)) {
+		dev_warn(gpu->dev, "failed to add devfreq device: %ld\n",
+			 PTR_ERR(df->devfreq));
+		df->devfreq = NULL;
+		dev_pm_opp_of_remove_table(gpu->dev);
+	}
+}
+
+static void etnaviv_gpu_devfreq_fini(struct etnaviv_gpu *gpu)
+{
+	struct etnaviv_gpu_devfreq *df = &gpu->devfreq;
+
+	if (!df->devfreq)
+		return;
+
+	devfreq_remove_device(df->devfreq);
+	df->devfreq = NULL;
+	dev_pm_opp_of_remove_table(gpu->dev);
+
+	/* leave the clocks as they were found */
+	clk_set_rate(gpu->clk_core, df->rate_core);
+	if (gpu->clk_shader && df->rate_shader)
+		clk_set_rate(gpu->clk_shader, df->rate_shader);
+}
+#else
+static inline void etnaviv_gpu_devfreq_init(struct etnaviv_gpu *gpu)
+{
+}
+
+static inline void etnaviv_gpu_devfreq_fini(struct etnaviv_gpu *gpu)
+{
+}
+#endif
+
 int etnaviv_gpu_init(struct etnaviv_gpu *gpu)
 {
 	int ret, i;
@@ -684,6 +896,9 @@ int etnaviv_gpu_init(struct etnaviv_gpu *gpu)
 	gpu->exec_state = -1;
 	mutex_unlock(&gpu->lock);
 
+	etnaviv_gpu_sample_cycles(gpu, true);
+	etnaviv_gpu_devfreq_init(gpu);
+
 	pm_runtime_mark_last_busy(gpu->dev);
 	pm_runtime_put_autosuspend(gpu->dev);
 
@@ -1016,8 +1231,12 @@ static struct fence *etnaviv_gpu_fence_alloc(struct etnaviv_gpu *gpu)
 	return &f->base;
 }
 
+/*
+ * Collect the fences of other contexts the BO has to wait for as
+ * dependencies of cmdbuf, instead of waiting for them here.
+ */
 int etnaviv_gpu_fence_sync_obj(struct etnaviv_gem_object *etnaviv_obj,
-	unsigned int context, bool exclusive)
+	struct etnaviv_cmdbuf *cmdbuf, bool exclusive)
 {
 	struct reservation_object *robj = etnaviv_obj->resv;
 	struct reservation_object_list *fobj;
@@ -1036,10 +1255,10 @@ int etnaviv_gpu_fence_sync_obj(struct etnaviv_gem_object *etnaviv_obj,
 	 */
 	fobj = reservation_object_get_list(robj);
 	if (!fobj || fobj->shared_count == 0) {
-		/* Wait on any existing exclusive fence which isn't our own */
+		/* Depend on any existing exclusive fence which isn't our own */
 		fence = reservation_object_get_excl(robj);
-		if (fence && fence->context != context) {
-			ret = fence_wait(fence, true);
+		if (fence) {
+			ret = etnaviv_cmdbuf_add_dep(cmdbuf, fence);
 			if (ret)
 				return ret;
 		}
@@ -1051,11 +1270,9 @@ int etnaviv_gpu_fence_sync_obj(struct etnaviv_gem_object *etnaviv_obj,
 	for (i = 0; i < fobj->shared_count; i++) {
 		fence = rcu_dereference_protected(fobj->shared[i],
 						reservation_object_held(robj));
-		if (fence->context != context) {
-			ret = fence_wait(fence, true);
-			if (ret)
-				return ret;
-		}
+		ret = etnaviv_cmdbuf_add_dep(cmdbuf, fence);
+		if (ret)
+			return ret;
 	}
 
 	return 0;
@@ -1113,6 +1330,106 @@ static void event_free(struct etnaviv_gpu *gpu, unsigned int event)
  * Cmdstream submission/retirement:
  */
 
+/*
+ * Command buffers are written to the ring in fence order by queue_worker,
+ * once the fences they depend on have signalled.  Keeping fence order equal
+ * to ring order is what lets completed_fence/retired_fence describe
+ * progress with a single seqno, so a blocked buffer also holds back the
+ * ones queued after it on the same GPU.
+ */
+/*
+ * The queue work may sleep for a free event, which the hang recovery on
+ * the driver workqueue is what frees, so it runs on its own.
+ */
+static void etnaviv_gpu_kick_queue(struct etnaviv_gpu *gpu)
+{
+	queue_work(system_unbound_wq, &gpu->queue_work);
+}
+
+static void etnaviv_fence_dep_cb(struct fence *fence, struct fence_cb *cb)
+{
+	struct etnaviv_fence_dep *dep =
+		container_of(cb, struct etnaviv_fence_dep, cb);
+
+	etnaviv_gpu_kick_queue(dep->gpu);
+}
+
+int etnaviv_cmdbuf_add_dep(struct etnaviv_cmdbuf *cmdbuf, struct fence *fence)
+{
+	struct etnaviv_fence_dep *deps;
+	unsigned int i;
+
+	/* ring order already takes care of our own fences */
+	if (fence->context == cmdbuf->gpu->fence_context ||
+	    fence_is_signaled(fence))
+		return 0;
+
+	for (i = 0; i < cmdbuf->nr_deps; i++)
+		if (cmdbuf->deps[i].fence == fence)
+			return 0;
+
+	if (cmdbuf->nr_deps == cmdbuf->max_deps) {
+		unsigned int max = max(4U, 2 * cmdbuf->max_deps);
+
+		deps = krealloc(cmdbuf->deps, max * sizeof(*deps), GFP_KERNEL);
+		if (!deps)
+			return -ENOMEM;
+
+		cmdbuf->deps = deps;
+		cmdbuf->max_deps = max;
+	}
+
+	deps = &cmdbuf->deps[cmdbuf->nr_deps++];
+	deps->fence = fence_get(fence);
+	deps->gpu = cmdbuf->gpu;
+	deps->armed = false;
+
+	return 0;
+}
+
+/* called with gpu->lock held, arms a callback on the first pending fence */
+static bool etnaviv_cmdbuf_deps_signaled(struct etnaviv_cmdbuf *cmdbuf)
+{
+	unsigned int i;
+
+	for (i = 0; i < cmdbuf->nr_deps; i++) {
+		struct etnaviv_fence_dep *dep = &cmdbuf->deps[i];
+
+		if (fence_is_signaled(dep->fence))
+			continue;
+
+		if (dep->armed)
+			return false;
+
+		if (!fence_add_callback(dep->fence, &dep->cb,
+					etnaviv_fence_dep_cb)) {
+			dep->armed = true;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void etnaviv_cmdbuf_put_deps(struct etnaviv_cmdbuf *cmdbuf)
+{
+	unsigned int i;
+
+	for (i = 0; i < cmdbuf->nr_deps; i++) {
+		struct etnaviv_fence_dep *dep = &cmdbuf->deps[i];
+
+		/* also waits for a callback running on another CPU */
+		if (dep->armed)
+			fence_remove_callback(dep->fence, &dep->cb);
+		fence_put(dep->fence);
+	}
+
+	kfree(cmdbuf->deps);
+	cmdbuf->deps = NULL;
+	cmdbuf->nr_deps = 0;
+	cmdbuf->max_deps = 0;
+}
+
 struct etnaviv_cmdbuf *etnaviv_gpu_cmdbuf_new(struct etnaviv_gpu *gpu, u32 size,
 	size_t nr_bos)
 {
@@ -1142,6 +1459,7 @@ struct etnaviv_cmdbuf *etnaviv_gpu_cmdbuf_new(struct etnaviv_gpu *gpu, u32 size,
 
 void etnaviv_gpu_cmdbuf_free(struct etnaviv_cmdbuf *cmdbuf)
 {
+	etnaviv_cmdbuf_put_deps(cmdbuf);
 	etnaviv_iommu_put_cmdbuf_va(cmdbuf->gpu, cmdbuf);
 	dma_free_wc(cmdbuf->gpu->dev, cmdbuf->size, cmdbuf->vaddr,
 		    cmdbuf->paddr);
@@ -1271,17 +1589,55 @@ void etnaviv_gpu_pm_put(struct etnaviv_gpu *gpu)
 	pm_runtime_put_autosuspend(gpu->dev);
 }
 
-/* add bo's to gpu's ring, and kick gpu: */
-int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
-	struct etnaviv_gem_submit *submit, struct etnaviv_cmdbuf *cmdbuf)
+/*
+ * Complete a buffer that never made it to the ring.  It goes through the
+ * active list like any other, so retire_worker drops its mappings and the
+ * PM reference.  Must not run concurrently with queue_worker.
+ */
+static void etnaviv_gpu_cancel_cmdbuf(struct etnaviv_gpu *gpu,
+	struct etnaviv_cmdbuf *cmdbuf, int error)
 {
-	struct fence *fence;
-	unsigned int event, i;
+	struct fence *fence = cmdbuf->fence;
+	struct fence *last = NULL;
+
+	/*
+	 * Advancing completed_fence past buffers still on the ring would
+	 * make their fences look signalled, so let those finish first.
+	 */
+	mutex_lock(&gpu->lock);
+	if (!list_empty(&gpu->active_cmd_list))
+		last = fence_get(list_last_entry(&gpu->active_cmd_list,
+						 struct etnaviv_cmdbuf,
+						 node)->fence);
+	mutex_unlock(&gpu->lock);
+
+	if (last) {
+		fence_wait(last, false);
+		fence_put(last);
+	}
+
+	mutex_lock(&gpu->lock);
+	gpu->active_fence = fence->seqno;
+	if (fence_after(fence->seqno, gpu->completed_fence))
+		gpu->completed_fence = fence->seqno;
+	list_add_tail(&cmdbuf->node, &gpu->active_cmd_list);
+	pm_runtime_get_noresume(gpu->dev);
+	mutex_unlock(&gpu->lock);
+
+	fence->status = error;
+	fence_signal(fence);
+}
+
+/* add the cmdbuf to gpu's ring, and kick gpu: */
+static void etnaviv_gpu_exec(struct etnaviv_gpu *gpu,
+	struct etnaviv_cmdbuf *cmdbuf)
+{
+	unsigned int event;
 	int ret;
 
 	ret = etnaviv_gpu_pm_get_sync(gpu);
 	if (ret < 0)
-		return ret;
+		goto out_pm_put;
 
 	/*
 	 * TODO
@@ -1301,18 +1657,11 @@ int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
 
 	mutex_lock(&gpu->lock);
 
-	fence = etnaviv_gpu_fence_alloc(gpu);
-	if (!fence) {
-		event_free(gpu, event);
-		ret = -ENOMEM;
-		goto out_unlock;
-	}
-
-	gpu->event[event].fence = fence;
-	submit->fence = fence->seqno;
-	gpu->active_fence = submit->fence;
+	gpu->event[event].fence = cmdbuf->fence;
+	gpu->active_fence = cmdbuf->fence->seqno;
 
-	if (gpu->lastctx != cmdbuf->ctx) {
+	/* a NULL context belongs to a file closed while the buffer queued */
+	if (!cmdbuf->ctx || gpu->lastctx != cmdbuf->ctx) {
 		gpu->mmu->need_flush = true;
 		gpu->switch_context = true;
 		gpu->lastctx = cmdbuf->ctx;
@@ -1320,12 +1669,86 @@ int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
 
 	etnaviv_buffer_queue(gpu, event, cmdbuf);
 
-	cmdbuf->fence = fence;
 	list_add_tail(&cmdbuf->node, &gpu->active_cmd_list);
 
 	/* We're committed to adding this command buffer, hold a PM reference */
 	pm_runtime_get_noresume(gpu->dev);
 
+	hangcheck_timer_reset(gpu);
+	ret = 0;
+
+	mutex_unlock(&gpu->lock);
+
+out_pm_put:
+	etnaviv_gpu_pm_put(gpu);
+
+	if (ret) {
+		etnaviv_gpu_cancel_cmdbuf(gpu, cmdbuf, ret);
+		etnaviv_queue_work(gpu->drm, &gpu->retire_work);
+	}
+}
+
+static void queue_worker(struct work_struct *work)
+{
+	struct etnaviv_gpu *gpu = container_of(work, struct etnaviv_gpu,
+					       queue_work);
+	struct etnaviv_cmdbuf *cmdbuf;
+
+	do {
+		mutex_lock(&gpu->lock);
+		cmdbuf = list_first_entry_or_null(&gpu->queue_list,
+						  struct etnaviv_cmdbuf, node);
+		if (cmdbuf && etnaviv_cmdbuf_deps_signaled(cmdbuf))
+			list_del(&cmdbuf->node);
+		else
+			cmdbuf = NULL;
+		mutex_unlock(&gpu->lock);
+
+		/* only this work writes the ring, so order is kept unlocked */
+		if (cmdbuf)
+			etnaviv_gpu_exec(gpu, cmdbuf);
+	} while (cmdbuf);
+}
+
+/*
+ * Cancel everything still waiting for dependencies.  Called on unbind
+ * while the driver workqueue still runs retire_work.
+ */
+void etnaviv_gpu_queue_fini(struct etnaviv_gpu *gpu)
+{
+	struct etnaviv_cmdbuf *cmdbuf, *tmp;
+	LIST_HEAD(list);
+
+	mutex_lock(&gpu->lock);
+	list_splice_init(&gpu->queue_list, &list);
+	mutex_unlock(&gpu->lock);
+
+	list_for_each_entry(cmdbuf, &list, node)
+		etnaviv_cmdbuf_put_deps(cmdbuf);
+
+	cancel_work_sync(&gpu->queue_work);
+
+	list_for_each_entry_safe(cmdbuf, tmp, &list, node) {
+		list_del(&cmdbuf->node);
+		etnaviv_gpu_cancel_cmdbuf(gpu, cmdbuf, -ECANCELED);
+	}
+
+	flush_work(&gpu->retire_work);
+	retire_worker(&gpu->retire_work);
+}
+
+/*
+ * Queue a command buffer.  Mappings move from the submit to the cmdbuf,
+ * the new fence is published in the BOs' reservation objects right away so
+ * later submits and other devices order against it, and a reference to it
+ * is returned in submit->out_fence.
+ */
+int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
+	struct etnaviv_gem_submit *submit, struct etnaviv_cmdbuf *cmdbuf)
+{
+	struct fence *fence;
+	unsigned int i;
+
 	for (i = 0; i < submit->nr_bos; i++) {
 		struct etnaviv_gem_object *etnaviv_obj = submit->bos[i].obj;
 
@@ -1333,6 +1756,34 @@ int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
 		etnaviv_gem_mapping_reference(submit->bos[i].mapping);
 		cmdbuf->bo_map[i] = submit->bos[i].mapping;
 		atomic_inc(&etnaviv_obj->gpu_active);
+	}
+	cmdbuf->nr_bos = submit->nr_bos;
+
+	mutex_lock(&gpu->lock);
+
+	fence = etnaviv_gpu_fence_alloc(gpu);
+	if (!fence) {
+		mutex_unlock(&gpu->lock);
+
+		for (i = 0; i < cmdbuf->nr_bos; i++) {
+			atomic_dec(&cmdbuf->bo_map[i]->object->gpu_active);
+			etnaviv_gem_mapping_unreference(cmdbuf->bo_map[i]);
+		}
+		cmdbuf->nr_bos = 0;
+
+		return -ENOMEM;
+	}
+
+	cmdbuf->fence = fence;
+	submit->fence = fence->seqno;
+	submit->out_fence = fence_get(fence);
+
+	list_add_tail(&cmdbuf->node, &gpu->queue_list);
+
+	mutex_unlock(&gpu->lock);
+
+	for (i = 0; i < submit->nr_bos; i++) {
+		struct etnaviv_gem_object *etnaviv_obj = submit->bos[i].obj;
 
 		if (submit->bos[i].flags & ETNA_SUBMIT_BO_WRITE)
 			reservation_object_add_excl_fence(etnaviv_obj->resv,
@@ -1341,17 +1792,10 @@ int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
 			reservation_object_add_shared_fence(etnaviv_obj->resv,
 							    fence);
 	}
-	cmdbuf->nr_bos = submit->nr_bos;
-	hangcheck_timer_reset(gpu);
-	ret = 0;
-
-out_unlock:
-	mutex_unlock(&gpu->lock);
 
-out_pm_put:
-	etnaviv_gpu_pm_put(gpu);
+	etnaviv_gpu_kick_queue(gpu);
 
-	return ret;
+	return 0;
 }
 
 /*
@@ -1558,7 +2002,9 @@ static int etnaviv_gpu_bind(struct device *dev, struct device *master,
 	spin_lock_init(&gpu->fence_spinlock);
 
 	INIT_LIST_HEAD(&gpu->active_cmd_list);
+	INIT_LIST_HEAD(&gpu->queue_list);
 	INIT_WORK(&gpu->retire_work, retire_worker);
+	INIT_WORK(&gpu->queue_work, queue_worker);
 	INIT_WORK(&gpu->recover_work, recover_worker);
 	init_waitqueue_head(&gpu->fence_event);
 
@@ -1582,6 +2028,8 @@ static void etnaviv_gpu_unbind(struct device *dev, struct device *master,
 
 	hangcheck_disable(gpu);
 
+	etnaviv_gpu_devfreq_fini(gpu);
+
 #ifdef CONFIG_PM
 	pm_runtime_get_sync(gpu->dev);
 	pm_runtime_put_sync_suspend(gpu->dev);
@@ -1626,6 +2074,7 @@ static int etnaviv_gpu_platform_probe(struct platform_device *pdev)
 
 	gpu->dev = &pdev->dev;
 	mutex_init(&gpu->lock);
+	spin_lock_init(&gpu->devfreq.lock);
 
 	/* Map registers: */
 	gpu->mmio = etnaviv_ioremap(pdev, NULL, dev_name(gpu->dev));
@@ -1695,6 +2144,7 @@ static int etnaviv_gpu_rpm_suspend(struct device *dev)
 {
 	struct etnaviv_gpu *gpu = dev_get_drvdata(dev);
 	u32 idle, mask;
+	int ret;
 
 	/* If we have outstanding fences, we're not idle */
 	if (gpu->completed_fence != gpu->active_fence)
@@ -1706,7 +2156,13 @@ static int etnaviv_gpu_rpm_suspend(struct device *dev)
 	if (idle != mask)
 		return -EBUSY;
 
-	return etnaviv_gpu_hw_suspend(gpu);
+	if (gpu->buffer)
+		etnaviv_gpu_sample_cycles(gpu, false);
+
+	ret = etnaviv_gpu_hw_suspend(gpu);
+	etnaviv_gpu_busfreq(gpu, false);
+
+	return ret;
 }
 
 static int etnaviv_gpu_rpm_resume(struct device *dev)
@@ -1714,20 +2170,28 @@ static int etnaviv_gpu_rpm_resume(struct device *dev)
 	struct etnaviv_gpu *gpu = dev_get_drvdata(dev);
 	int ret;
 
+	etnaviv_gpu_busfreq(gpu, true);
+
 	ret = etnaviv_gpu_clk_enable(gpu);
 	if (ret)
-		return ret;
+		goto release_busfreq;
 
 	/* Re-initialise the basic hardware state */
 	if (gpu->drm && gpu->buffer) {
 		ret = etnaviv_gpu_hw_resume(gpu);
 		if (ret) {
 			etnaviv_gpu_clk_disable(gpu);
-			return ret;
+			goto release_busfreq;
 		}
+
+		etnaviv_gpu_sample_cycles(gpu, true);
 	}
 
 	return 0;
+
+release_busfreq:
+	etnaviv_gpu_busfreq(gpu, false);
+	return ret;
 }
 #endif
 
@@ -18,6 +18,8 @@
 #define __ETNAVIV_GPU_H__
 
 #include <linux/clk.h>
+#include <linux/devfreq.h>
+#include <linux/fence.h>
 #include <linux/regulator/consumer.h>
 
 #include "etnaviv_drv.h"
@@ -94,6 +96,30 @@ struct etnaviv_event {
 
 struct etnaviv_cmdbuf;
 
+/* fence a queued cmdbuf waits for before it is written to the ring */
+struct etnaviv_fence_dep {
+	struct fence *fence;
+	struct fence_cb cb;
+	struct etnaviv_gpu *gpu;
+	bool armed;
+};
+
+struct etnaviv_gpu_devfreq {
+	struct devfreq *devfreq;
+	struct devfreq_dev_profile profile;
+	/* protects the counter snapshot and busy_cycles */
+	spinlock_t lock;
+	u32 total_cycles;
+	u32 idle_cycles;
+	/* busy cycles since the last devfreq poll */
+	u64 busy_cycles;
+	ktime_t time;
+	/* rates at probe, the shader clock is scaled along with the core */
+	unsigned long rate_core;
+	unsigned long rate_shader;
+	bool busfreq_high;
+};
+
 struct etnaviv_gpu {
 	struct drm_device *drm;
 	struct device *dev;
@@ -117,6 +143,13 @@ struct etnaviv_gpu {
 	/* list of currently in-flight command buffers */
 	struct list_head active_cmd_list;
 
+	/*
+	 * command buffers waiting for their dependencies, in fence order.
+	 * Fed to the ring by queue_work, protected by lock.
+	 */
+	struct list_head queue_list;
+	struct work_struct queue_work;
+
 	u32 idle_mask;
 
 	/* Fencing support */
@@ -141,6 +174,9 @@ struct etnaviv_gpu {
 	struct clk *clk_core;
 	struct clk *clk_shader;
 
+	/* Frequency scaling: */
+	struct etnaviv_gpu_devfreq devfreq;
+
 	/* Hang Detction: */
 #define DRM_ETNAVIV_HANGCHECK_PERIOD 500 /* in ms */
 #define DRM_ETNAVIV_HANGCHECK_JIFFIES msecs_to_jiffies(DRM_ETNAVIV_HANGCHECK_PERIOD)
@@ -166,8 +202,12 @@ struct etnaviv_cmdbuf {
 	struct fence *fence;
 	/* target exec state */
 	u32 exec_state;
-	/* per GPU in-flight list */
+	/* per GPU queue, then in-flight list */
 	struct list_head node;
+	/* fences to wait for before the buffer is written to the ring */
+	struct etnaviv_fence_dep *deps;
+	unsigned int nr_deps;
+	unsigned int max_deps;
 	/* BOs attached to this command buffer */
 	unsigned int nr_bos;
 	struct etnaviv_vram_mapping *bo_map[0];
@@ -202,7 +242,8 @@ int etnaviv_gpu_debugfs(struct etnaviv_gpu *gpu, struct seq_file *m);
 #endif
 
 int etnaviv_gpu_fence_sync_obj(struct etnaviv_gem_object *etnaviv_obj,
-	unsigned int context, bool exclusive);
+	struct etnaviv_cmdbuf *cmdbuf, bool exclusive);
+int etnaviv_cmdbuf_add_dep(struct etnaviv_cmdbuf *cmdbuf, struct fence *fence);
 
 void etnaviv_gpu_retire(struct etnaviv_gpu *gpu);
 int etnaviv_gpu_wait_fence_interruptible(struct etnaviv_gpu *gpu,
@@ -214,6 +255,7 @@ int etnaviv_gpu_submit(struct etnaviv_gpu *gpu,
 struct etnaviv_cmdbuf *etnaviv_gpu_cmdbuf_new(struct etnaviv_gpu *gpu,
 					      u32 size, size_t nr_bos);
 void etnaviv_gpu_cmdbuf_free(struct etnaviv_cmdbuf *cmdbuf);
+void etnaviv_gpu_queue_fini(struct etnaviv_gpu *gpu);
 int etnaviv_gpu_pm_get_sync(struct etnaviv_gpu *gpu);
 void etnaviv_gpu_pm_put(struct etnaviv_gpu *gpu);
 int etnaviv_gpu_wait_idle(struct etnaviv_gpu *gpu, unsigned int timeout_ms);
@@ -50,6 +50,7 @@ struct imx_drm_device {
 struct imx_drm_crtc {
 	struct drm_crtc				*crtc;
 	struct imx_drm_crtc_helper_funcs	imx_drm_helper_funcs;
+	struct workqueue_struct			*commit_wq;
 };
 
 #if IS_ENABLED(CONFIG_DRM_FBDEV_EMULATION)
@@ -130,7 +131,9 @@ static void imx_drm_output_poll_changed(struct drm_device *drm)
 static int imx_drm_atomic_check(struct drm_device *dev,
 				struct drm_atomic_state *state)
 {
-	int ret;
+	struct drm_crtc_state *crtc_state;
+	struct drm_crtc *crtc;
+	int i, ret;
 
 	ret = drm_atomic_helper_check_modeset(dev, state);
 	if (ret)
@@ -148,9 +151,85 @@ static int imx_drm_atomic_check(struct drm_device *dev,
 	if (ret)
 		return ret;
 
+	/* async flips can only swap framebuffers of an unchanged layout */
+	for_each_crtc_in_state(state, crtc, crtc_state, i) {
+		if (crtc_state->async_flip &&
+		    drm_atomic_crtc_needs_modeset(crtc_state))
+			return -EINVAL;
+	}
+
 	return ret;
 }
 
+static void imx_drm_atomic_commit_tail(struct drm_atomic_state *state)
+{
+	struct drm_device *dev = state->dev;
+	struct drm_crtc_state *old_crtc_state;
+	struct drm_crtc *crtc;
+	bool async = true;
+	int i;
+
+	drm_atomic_helper_commit_modeset_disables(dev, state);
+
+	drm_atomic_helper_commit_planes(dev, state,
+				DRM_PLANE_COMMIT_ACTIVE_ONLY |
+				DRM_PLANE_COMMIT_NO_DISABLE_AFTER_MODESET);
+
+	drm_atomic_helper_commit_modeset_enables(dev, state);
+
+	drm_atomic_helper_commit_hw_done(state);
+
+	for_each_crtc_in_state(state, crtc, old_crtc_state, i)
+		async &= crtc->state->async_flip;
+
+	if (!async)
+		drm_atomic_helper_wait_for_vblanks(dev, state);
+
+	drm_atomic_helper_cleanup_planes(dev, state);
+}
+
+static void imx_drm_commit_work(struct work_struct *work)
+{
+	struct drm_atomic_state *state = container_of(work,
+						      struct drm_atomic_state,
+						      commit_work);
+	struct drm_device *dev = state->dev;
+
+	drm_atomic_helper_wait_for_dependencies(state);
+
+	drm_atomic_helper_wait_for_fences(dev, state, false);
+
+	imx_drm_atomic_commit_tail(state);
+
+	drm_atomic_helper_commit_cleanup_done(state);
+
+	drm_atomic_state_free(state);
+}
+
+/*
+ * Nonblocking commits are run on an ordered workqueue of the first CRTC
+ * they touch. Updates of one output thus complete in submission order,
+ * while each output waits for its own vblanks only.
+ */
+static struct workqueue_struct *
+imx_drm_commit_wq(struct drm_atomic_state *state)
+{
+	struct imx_drm_device *imxdrm = state->dev->dev_private;
+	struct drm_crtc_state *crtc_state;
+	struct drm_crtc *crtc;
+	int i;
+
+	for_each_crtc_in_state(state, crtc, crtc_state, i) {
+		struct imx_drm_crtc *imx_drm_crtc =
+			imxdrm->crtc[drm_crtc_index(crtc)];
+
+		if (imx_drm_crtc)
+			return imx_drm_crtc->commit_wq;
+	}
+
+	return system_unbound_wq;
+}
+
 static int imx_drm_atomic_commit(struct drm_device *dev,
 				 struct drm_atomic_state *state,
 				 bool nonblock)
@@ -158,13 +237,21 @@ static int imx_drm_atomic_commit(struct drm_device *dev,
 	struct drm_plane_state *plane_state;
 	struct drm_plane *plane;
 	struct dma_buf *dma_buf;
-	int i;
+	int i, ret;
+
+	ret = drm_atomic_helper_setup_commit(state, nonblock);
+	if (ret)
+		return ret;
 
 	/*
-	 * If the plane fb has an dma-buf attached, fish out the exclusive
-	 * fence for the atomic helper to wait on.
+	 * If the plane fb has an dma-buf attached and userspace didn't pass
+	 * an explicit IN_FENCE_FD, fish out the exclusive fence for the
+	 * commit to wait on.
 	 */
 	for_each_plane_in_state(state, plane, plane_state, i) {
+		if (plane_state->fence)
+			continue;
+
 		if ((plane->state->fb != plane_state->fb) && plane_state->fb) {
 			dma_buf = drm_fb_cma_get_gem_obj(plane_state->fb,
 							 0)->base.dma_buf;
@@ -175,37 +262,35 @@ static int imx_drm_atomic_commit(struct drm_device *dev,
 		}
 	}
 
-	return drm_atomic_helper_commit(dev, state, nonblock);
-}
-
-static const struct drm_mode_config_funcs imx_drm_mode_config_funcs = {
-	.fb_create = drm_fb_cma_create,
-	.output_poll_changed = imx_drm_output_poll_changed,
-	.atomic_check = imx_drm_atomic_check,
-	.atomic_commit = imx_drm_atomic_commit,
-};
-
-static void imx_drm_atomic_commit_tail(struct drm_atomic_state *state)
-{
-	struct drm_device *dev = state->dev;
-
-	drm_atomic_helper_commit_modeset_disables(dev, state);
+	INIT_WORK(&state->commit_work, imx_drm_commit_work);
 
-	drm_atomic_helper_commit_planes(dev, state,
-				DRM_PLANE_COMMIT_ACTIVE_ONLY |
-				DRM_PLANE_COMMIT_NO_DISABLE_AFTER_MODESET);
+	ret = drm_atomic_helper_prepare_planes(dev, state);
+	if (ret)
+		return ret;
 
-	drm_atomic_helper_commit_modeset_enables(dev, state);
+	if (!nonblock) {
+		ret = drm_atomic_helper_wait_for_fences(dev, state, true);
+		if (ret) {
+			drm_atomic_helper_cleanup_planes(dev, state);
+			return ret;
+		}
+	}
 
-	drm_atomic_helper_commit_hw_done(state);
+	drm_atomic_helper_swap_state(state, true);
 
-	drm_atomic_helper_wait_for_vblanks(dev, state);
+	if (nonblock)
+		queue_work(imx_drm_commit_wq(state), &state->commit_work);
+	else
+		imx_drm_commit_work(&state->commit_work);
 
-	drm_atomic_helper_cleanup_planes(dev, state);
+	return 0;
 }
 
-static struct drm_mode_config_helper_funcs imx_drm_mode_config_helpers = {
-	.atomic_commit_tail = imx_drm_atomic_commit_tail,
+static const struct drm_mode_config_funcs imx_drm_mode_config_funcs = {
+	.fb_create = drm_fb_cma_create,
+	.output_poll_changed = imx_drm_output_poll_changed,
+	.atomic_check = imx_drm_atomic_check,
+	.atomic_commit = imx_drm_atomic_commit,
 };
 
 /*
@@ -233,6 +318,13 @@ int imx_drm_add_crtc(struct drm_device *drm, struct drm_crtc *crtc,
 	if (!imx_drm_crtc)
 		return -ENOMEM;
 
+	imx_drm_crtc->commit_wq = alloc_ordered_workqueue("imx-drm-crtc%u", 0,
+							  imxdrm->pipes);
+	if (!imx_drm_crtc->commit_wq) {
+		kfree(imx_drm_crtc);
+		return -ENOMEM;
+	}
+
 	imx_drm_crtc->imx_drm_helper_funcs = *imx_drm_helper_funcs;
 	imx_drm_crtc->crtc = crtc;
 
@@ -264,6 +356,7 @@ int imx_drm_remove_crtc(struct imx_drm_crtc *imx_drm_crtc)
 
 	imxdrm->crtc[pipe] = NULL;
 
+	destroy_workqueue(imx_drm_crtc->commit_wq);
 	kfree(imx_drm_crtc);
 
 	return 0;
@@ -390,7 +483,8 @@ static int imx_drm_bind(struct device *dev)
 	drm->mode_config.max_width = 4096;
 	drm->mode_config.max_height = 4096;
 	drm->mode_config.funcs = &imx_drm_mode_config_funcs;
-	drm->mode_config.helper_private = &imx_drm_mode_config_helpers;
+	drm->mode_config.allow_fb_modifiers = true;
+	drm->mode_config.async_page_flip = true;
 
 	drm_mode_config_init(drm);
 
@@ -30,6 +30,9 @@
 #include "imx-drm.h"
 #include "ipuv3-plane.h"
 
+#define CREATE_TRACE_POINTS
+#include "ipuv3_crtc_trace.h"
+
 #define DRIVER_DESC		"i.MX IPUv3 Graphics"
 
 struct ipu_crtc {
@@ -147,6 +150,9 @@ static irqreturn_t ipu_irq_handler(int irq, void *dev_id)
 {
 	struct ipu_crtc *ipu_crtc = dev_id;
 
+	trace_imx_crtc_vblank(dev_name(ipu_crtc->dev),
+			      drm_crtc_index(&ipu_crtc->base),
+			      drm_crtc_vblank_count(&ipu_crtc->base));
 	drm_crtc_handle_vblank(&ipu_crtc->base);
 
 	return IRQ_HANDLED;
@@ -190,6 +196,10 @@ static void ipu_crtc_atomic_begin(struct drm_crtc *crtc,
 {
 	drm_crtc_vblank_on(crtc);
 
+	/* async flips are completed in ->atomic_flush() */
+	if (crtc->state->async_flip)
+		return;
+
 	spin_lock_irq(&crtc->dev->event_lock);
 	if (crtc->state->event) {
 		WARN_ON(drm_crtc_vblank_get(crtc));
@@ -199,6 +209,37 @@ static void ipu_crtc_atomic_begin(struct drm_crtc *crtc,
 	spin_unlock_irq(&crtc->dev->event_lock);
 }
 
+/*
+ * An async flip only rewrites the address of the idle IDMAC buffer, which
+ * the hardware picks up at the next frame start. The flip is complete as
+ * far as the client is concerned as soon as that is done, so the event
+ * and any out-fence are signalled right away instead of on vblank.
+ */
+static void ipu_crtc_atomic_flush(struct drm_crtc *crtc,
+				  struct drm_crtc_state *old_crtc_state)
+{
+	struct drm_framebuffer *fb = crtc->primary->state->fb;
+	struct drm_gem_cma_object *cma_obj;
+
+	if (trace_imx_crtc_buf_queue_enabled() && fb) {
+		cma_obj = drm_fb_cma_get_gem_obj(fb, 0);
+		trace_imx_crtc_buf_queue(dev_name(to_ipu_crtc(crtc)->dev),
+					 drm_crtc_index(crtc),
+					 cma_obj->paddr + fb->offsets[0],
+					 crtc->state->async_flip);
+	}
+
+	if (!crtc->state->async_flip)
+		return;
+
+	spin_lock_irq(&crtc->dev->event_lock);
+	if (crtc->state->event) {
+		drm_crtc_send_vblank_event(crtc, crtc->state->event);
+		crtc->state->event = NULL;
+	}
+	spin_unlock_irq(&crtc->dev->event_lock);
+}
+
 static void ipu_crtc_mode_set_nofb(struct drm_crtc *crtc)
 {
 	struct drm_device *dev = crtc->dev;
@@ -257,6 +298,7 @@ static const struct drm_crtc_helper_funcs ipu_helper_funcs = {
 	.mode_set_nofb = ipu_crtc_mode_set_nofb,
 	.atomic_check = ipu_crtc_atomic_check,
 	.atomic_begin = ipu_crtc_atomic_begin,
+	.atomic_flush = ipu_crtc_atomic_flush,
 	.atomic_disable = ipu_crtc_atomic_disable,
 	.enable = ipu_crtc_enable,
 };
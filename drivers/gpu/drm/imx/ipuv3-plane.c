@@ -53,6 +53,19 @@ static const uint32_t ipu_plane_formats[] = {
 	DRM_FORMAT_RGB565,
 };
 
+/* Vivante tiled framebuffers can only be scanned out through the PRE/PRG */
+static inline bool ipu_plane_state_is_tiled(struct drm_plane_state *state)
+{
+	return state->fb->modifier[0] != DRM_FORMAT_MOD_NONE;
+}
+
+/* Scaled overlays are resized and converted to RGB by the IC on the way */
+static inline bool ipu_plane_state_is_scaled(struct drm_plane_state *state)
+{
+	return state->src_w >> 16 != state->crtc_w ||
+	       state->src_h >> 16 != state->crtc_h;
+}
+
 int ipu_plane_irq(struct ipu_plane *ipu_plane)
 {
 	return ipu_idmac_channel_irq(ipu_plane->ipu, ipu_plane->ipu_ch,
@@ -68,6 +81,10 @@ drm_plane_state_to_eba(struct drm_plane_state *state)
 	cma_obj = drm_fb_cma_get_gem_obj(fb, 0);
 	BUG_ON(!cma_obj);
 
+	/* the PRE applies the source offset to tiled buffers itself */
+	if (ipu_plane_state_is_tiled(state))
+		return cma_obj->paddr + fb->offsets[0];
+
 	return cma_obj->paddr + fb->offsets[0] +
 	       fb->pitches[0] * (state->src_y >> 16) +
 	       (fb->bits_per_pixel >> 3) * (state->src_x >> 16);
@@ -109,11 +126,20 @@ static void ipu_plane_atomic_set_base(struct ipu_plane *ipu_plane)
 	struct drm_plane_state *state = plane->state;
 	struct drm_crtc_state *crtc_state = state->crtc->state;
 	struct drm_framebuffer *fb = state->fb;
+	struct ipuv3_channel *ch;
 	unsigned long eba, ubo, vbo;
 	int active;
 
 	eba = drm_plane_state_to_eba(state);
 
+	/* with the IC in the path, the framebuffer is fetched by its input */
+	ch = ipu_plane->ic_enabled ? ipu_plane->ic_in : ipu_plane->ipu_ch;
+
+	if (ipu_plane->prg_enabled) {
+		ipu_prg_channel_update(ipu_plane->ipu_ch, eba);
+		return;
+	}
+
 	switch (fb->pixel_format) {
 	case DRM_FORMAT_YUV420:
 	case DRM_FORMAT_YVU420:
@@ -132,11 +158,11 @@ static void ipu_plane_atomic_set_base(struct ipu_plane *ipu_plane)
 		vbo = drm_plane_state_to_vbo(state);
 
 		if (fb->pixel_format == DRM_FORMAT_YUV420)
-			ipu_cpmem_set_yuv_planar_full(ipu_plane->ipu_ch,
-						      fb->pitches[1], ubo, vbo);
+			ipu_cpmem_set_yuv_planar_full(ch, fb->pitches[1],
+						      ubo, vbo);
 		else
-			ipu_cpmem_set_yuv_planar_full(ipu_plane->ipu_ch,
-						      fb->pitches[1], vbo, ubo);
+			ipu_cpmem_set_yuv_planar_full(ch, fb->pitches[1],
+						      vbo, ubo);
 
 		dev_dbg(ipu_plane->base.dev->dev,
 			"phy = %lu %lu %lu, x = %d, y = %d", eba, ubo, vbo,
@@ -150,17 +176,61 @@ static void ipu_plane_atomic_set_base(struct ipu_plane *ipu_plane)
 	}
 
 	if (!drm_atomic_crtc_needs_modeset(crtc_state)) {
-		active = ipu_idmac_get_current_buffer(ipu_plane->ipu_ch);
-		ipu_cpmem_set_buffer(ipu_plane->ipu_ch, !active, eba);
-		ipu_idmac_select_buffer(ipu_plane->ipu_ch, !active);
+		active = ipu_idmac_get_current_buffer(ch);
+		ipu_cpmem_set_buffer(ch, !active, eba);
+		ipu_idmac_select_buffer(ch, !active);
 	} else {
-		ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 0, eba);
-		ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 1, eba);
+		ipu_cpmem_set_buffer(ch, 0, eba);
+		ipu_cpmem_set_buffer(ch, 1, eba);
 	}
 }
 
+static void ipu_plane_put_ic(struct ipu_plane *ipu_plane)
+{
+	if (!IS_ERR_OR_NULL(ipu_plane->ic_out))
+		ipu_idmac_put(ipu_plane->ic_out);
+	if (!IS_ERR_OR_NULL(ipu_plane->ic_in))
+		ipu_idmac_put(ipu_plane->ic_in);
+	if (!IS_ERR_OR_NULL(ipu_plane->ic))
+		ipu_ic_put(ipu_plane->ic);
+	ipu_plane->ic_out = NULL;
+	ipu_plane->ic_in = NULL;
+	ipu_plane->ic = NULL;
+}
+
+/*
+ * Only the foreground plane can be scaled: the PRP viewfinder output is
+ * linked to the DP sync flow 1 input in the FSU. If the task is already
+ * claimed by someone else, the overlay stays unscaled.
+ */
+static void ipu_plane_get_ic(struct ipu_plane *ipu_plane)
+{
+	struct ipu_soc *ipu = ipu_plane->ipu;
+
+	if (ipu_plane->dma != IPUV3_CHANNEL_MEM_FG_SYNC)
+		return;
+
+	ipu_plane->ic = ipu_ic_get(ipu, IC_TASK_VIEWFINDER);
+	if (IS_ERR(ipu_plane->ic))
+		goto err_out;
+
+	ipu_plane->ic_in = ipu_idmac_get(ipu, IPUV3_CHANNEL_MEM_IC_PRP_VF);
+	if (IS_ERR(ipu_plane->ic_in))
+		goto err_out;
+
+	ipu_plane->ic_out = ipu_idmac_get(ipu, IPUV3_CHANNEL_IC_PRP_VF_MEM);
+	if (IS_ERR(ipu_plane->ic_out))
+		goto err_out;
+
+	return;
+err_out:
+	DRM_DEBUG_KMS("IC viewfinder task busy, overlay scaling disabled\n");
+	ipu_plane_put_ic(ipu_plane);
+}
+
 void ipu_plane_put_resources(struct ipu_plane *ipu_plane)
 {
+	ipu_plane_put_ic(ipu_plane);
 	if (!IS_ERR_OR_NULL(ipu_plane->dp))
 		ipu_dp_put(ipu_plane->dp);
 	if (!IS_ERR_OR_NULL(ipu_plane->dmfc))
@@ -196,6 +266,8 @@ int ipu_plane_get_resources(struct ipu_plane *ipu_plane)
 		}
 	}
 
+	ipu_plane_get_ic(ipu_plane);
+
 	return 0;
 err_out:
 	ipu_plane_put_resources(ipu_plane);
@@ -227,6 +299,20 @@ static int ipu_disable_plane(struct drm_plane *plane)
 	ipu_dmfc_disable_channel(ipu_plane->dmfc);
 	if (ipu_plane->dp)
 		ipu_dp_disable(ipu_plane->ipu);
+	if (ipu_plane->prg_enabled) {
+		ipu_prg_channel_disable(ipu_plane->ipu_ch);
+		ipu_plane->prg_enabled = false;
+	}
+	if (ipu_plane->ic_enabled) {
+		ipu_ic_task_disable(ipu_plane->ic);
+		ipu_idmac_disable_channel(ipu_plane->ic_in);
+		ipu_idmac_disable_channel(ipu_plane->ic_out);
+		ipu_idmac_unlink(ipu_plane->ic_out, ipu_plane->ipu_ch);
+		ipu_ic_disable(ipu_plane->ic);
+		dma_free_wc(plane->dev->dev, ipu_plane->ic_buf_size,
+			    ipu_plane->ic_buf_virt, ipu_plane->ic_buf_phys);
+		ipu_plane->ic_enabled = false;
+	}
 
 	return 0;
 }
@@ -253,6 +339,7 @@ static const struct drm_plane_funcs ipu_plane_funcs = {
 static int ipu_plane_atomic_check(struct drm_plane *plane,
 				  struct drm_plane_state *state)
 {
+	struct ipu_plane *ipu_plane = to_ipu_plane(plane);
 	struct drm_plane_state *old_state = plane->state;
 	struct drm_crtc_state *crtc_state;
 	struct device *dev = plane->dev->dev;
@@ -277,10 +364,23 @@ static int ipu_plane_atomic_check(struct drm_plane *plane,
 	if (!crtc_state->enable)
 		return -EINVAL;
 
-	/* no scaling */
-	if (state->src_w >> 16 != state->crtc_w ||
-	    state->src_h >> 16 != state->crtc_h)
-		return -EINVAL;
+	/*
+	 * Scaling needs the IC: at most 4:1 downscaling, 1024 output pixels
+	 * per line and column, and no tiled input since the IC can't read
+	 * through the PRE.
+	 */
+	if (ipu_plane_state_is_scaled(state)) {
+		if (!ipu_plane->ic || ipu_plane_state_is_tiled(state))
+			return -EINVAL;
+
+		if (state->crtc_w > 1024 || state->crtc_h > 1024 ||
+		    state->src_w >> 16 > 4096 || state->src_h >> 16 > 4096)
+			return -EINVAL;
+
+		if (state->src_w >> 16 > 4 * state->crtc_w ||
+		    state->src_h >> 16 > 4 * state->crtc_h)
+			return -EINVAL;
+	}
 
 	switch (plane->type) {
 	case DRM_PLANE_TYPE_PRIMARY:
@@ -322,9 +422,38 @@ static int ipu_plane_atomic_check(struct drm_plane *plane,
 	 */
 	if (old_fb && (state->src_w != old_state->src_w ||
 			      state->src_h != old_state->src_h ||
-			      fb->pixel_format != old_fb->pixel_format))
+			      fb->pixel_format != old_fb->pixel_format ||
+			      fb->modifier[0] != old_fb->modifier[0]))
+		crtc_state->mode_changed = true;
+
+	/* the IC resizing coefficients and output buffers are set at enable */
+	if (old_fb && (ipu_plane_state_is_scaled(state) ||
+		       ipu_plane_state_is_scaled(old_state)) &&
+	    (state->crtc_w != old_state->crtc_w ||
+	     state->crtc_h != old_state->crtc_h))
 		crtc_state->mode_changed = true;
 
+	if (ipu_plane_state_is_tiled(state)) {
+		unsigned int x = state->src_x >> 16;
+
+		if (!ipu_prg_format_supported(ipu_plane->ipu, fb->pixel_format,
+					      fb->modifier[0]))
+			return -EINVAL;
+
+		if (state->src_w >> 16 > IPU_PRE_MAX_WIDTH)
+			return -EINVAL;
+
+		/* the IDMAC fetches the resolved lines at an 8 byte offset */
+		if (((x % IPU_PRE_BLOCK_WIDTH) * (fb->bits_per_pixel >> 3)) &
+		    0x7)
+			return -EINVAL;
+
+		/* panning moves the PRE window, so it can't be a plain flip */
+		if (old_fb && (state->src_x != old_state->src_x ||
+			       state->src_y != old_state->src_y))
+			crtc_state->mode_changed = true;
+	}
+
 	eba = drm_plane_state_to_eba(state);
 
 	if (eba & 0x7)
@@ -394,6 +523,117 @@ static void ipu_plane_atomic_disable(struct drm_plane *plane,
 	ipu_disable_plane(plane);
 }
 
+static void ipu_plane_ic_idma_init(struct ipu_plane *ipu_plane,
+				   struct ipuv3_channel *ch,
+				   u32 width, u32 height)
+{
+	int burst_size = (width % 16) ? 8 : 16;
+
+	ipu_cpmem_set_burstsize(ch, burst_size);
+	ipu_ic_task_idma_init(ipu_plane->ic, ch, width, height, burst_size,
+			      IPU_ROTATE_NONE);
+	ipu_idmac_set_double_buffer(ch, 1);
+}
+
+/*
+ * Scaled overlays are fetched by the PRP viewfinder task, resized and
+ * converted to RGB, and written into a pair of frames the foreground
+ * channel scans out. The FSU link hands each frame to the display as
+ * soon as the IC has finished it, so every flip costs a single IC pass
+ * and nothing else has to copy or schedule the intermediate frame.
+ */
+static void ipu_plane_ic_enable(struct ipu_plane *ipu_plane)
+{
+	struct drm_plane *plane = &ipu_plane->base;
+	struct drm_plane_state *state = plane->state;
+	struct drm_framebuffer *fb = state->fb;
+	unsigned int src_w = state->src_w >> 16;
+	unsigned int src_h = state->src_h >> 16;
+	unsigned int stride = state->crtc_w * 4;
+	size_t frame_size = stride * state->crtc_h;
+	int ret;
+
+	ipu_plane->ic_buf_size = 2 * frame_size;
+	ipu_plane->ic_buf_virt = dma_alloc_wc(plane->dev->dev,
+					      ipu_plane->ic_buf_size,
+					      &ipu_plane->ic_buf_phys,
+					      GFP_KERNEL);
+	if (!ipu_plane->ic_buf_virt) {
+		DRM_ERROR("failed to allocate IC output buffers\n");
+		return;
+	}
+
+	ret = ipu_ic_task_init(ipu_plane->ic, src_w, src_h,
+			       state->crtc_w, state->crtc_h,
+			       ipu_drm_fourcc_to_colorspace(fb->pixel_format),
+			       IPUV3_COLORSPACE_RGB);
+	if (ret) {
+		DRM_ERROR("failed to set up IC task: %d\n", ret);
+		goto err_free;
+	}
+
+	ret = ipu_idmac_link(ipu_plane->ic_out, ipu_plane->ipu_ch);
+	if (ret) {
+		DRM_ERROR("failed to link IC to DP: %d\n", ret);
+		goto err_free;
+	}
+
+	ipu_plane->ic_enabled = true;
+
+	ipu_dp_setup_channel(ipu_plane->dp, IPUV3_COLORSPACE_RGB,
+			     IPUV3_COLORSPACE_UNKNOWN);
+	ipu_dp_set_window_pos(ipu_plane->dp, state->crtc_x, state->crtc_y);
+	ipu_dp_set_global_alpha(ipu_plane->dp, true, 0, true);
+	ipu_dmfc_config_wait4eot(ipu_plane->dmfc, state->crtc_w);
+
+	/* IC input: the framebuffer */
+	ipu_cpmem_zero(ipu_plane->ic_in);
+	ipu_cpmem_set_resolution(ipu_plane->ic_in, src_w, src_h);
+	ipu_cpmem_set_fmt(ipu_plane->ic_in, fb->pixel_format);
+	ipu_cpmem_set_stride(ipu_plane->ic_in, fb->pitches[0]);
+	ipu_plane_ic_idma_init(ipu_plane, ipu_plane->ic_in, src_w, src_h);
+	ipu_plane_atomic_set_base(ipu_plane);
+
+	/* IC output and DP input: the intermediate frames */
+	ipu_cpmem_zero(ipu_plane->ic_out);
+	ipu_cpmem_set_resolution(ipu_plane->ic_out, state->crtc_w,
+				 state->crtc_h);
+	ipu_cpmem_set_fmt(ipu_plane->ic_out, DRM_FORMAT_XRGB8888);
+	ipu_cpmem_set_stride(ipu_plane->ic_out, stride);
+	ipu_cpmem_set_buffer(ipu_plane->ic_out, 0, ipu_plane->ic_buf_phys);
+	ipu_cpmem_set_buffer(ipu_plane->ic_out, 1,
+			     ipu_plane->ic_buf_phys + frame_size);
+	ipu_plane_ic_idma_init(ipu_plane, ipu_plane->ic_out, state->crtc_w,
+			       state->crtc_h);
+
+	ipu_cpmem_zero(ipu_plane->ipu_ch);
+	ipu_cpmem_set_resolution(ipu_plane->ipu_ch, state->crtc_w,
+				 state->crtc_h);
+	ipu_cpmem_set_fmt(ipu_plane->ipu_ch, DRM_FORMAT_XRGB8888);
+	ipu_cpmem_set_stride(ipu_plane->ipu_ch, stride);
+	ipu_cpmem_set_high_priority(ipu_plane->ipu_ch);
+	ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 0, ipu_plane->ic_buf_phys);
+	ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 1,
+			     ipu_plane->ic_buf_phys + frame_size);
+	ipu_idmac_set_double_buffer(ipu_plane->ipu_ch, 1);
+
+	ipu_ic_enable(ipu_plane->ic);
+	ipu_idmac_enable_channel(ipu_plane->ic_out);
+	ipu_idmac_enable_channel(ipu_plane->ic_in);
+	ipu_ic_task_enable(ipu_plane->ic);
+	ipu_plane_enable(ipu_plane);
+
+	/* convert the first frame, later ones are kicked off by flips */
+	ipu_idmac_select_buffer(ipu_plane->ic_out, 0);
+	ipu_idmac_select_buffer(ipu_plane->ic_out, 1);
+	ipu_idmac_select_buffer(ipu_plane->ic_in, 0);
+
+	return;
+err_free:
+	dma_free_wc(plane->dev->dev, ipu_plane->ic_buf_size,
+		    ipu_plane->ic_buf_virt, ipu_plane->ic_buf_phys);
+}
+
 static void ipu_plane_atomic_update(struct drm_plane *plane,
 				    struct drm_plane_state *old_state)
 {
@@ -410,6 +650,11 @@ static void ipu_plane_atomic_update(struct drm_plane *plane,
 		}
 	}
 
+	if (ipu_plane_state_is_scaled(state)) {
+		ipu_plane_ic_enable(ipu_plane);
+		return;
+	}
+
 	switch (ipu_plane->dp_flow) {
 	case IPU_DP_FLOW_SYNC_BG:
 		ipu_dp_setup_channel(ipu_plane->dp,
@@ -450,8 +695,34 @@ static void ipu_plane_atomic_update(struct drm_plane *plane,
 	ipu_cpmem_set_fmt(ipu_plane->ipu_ch, state->fb->pixel_format);
 	ipu_cpmem_set_high_priority(ipu_plane->ipu_ch);
 	ipu_idmac_set_double_buffer(ipu_plane->ipu_ch, 1);
-	ipu_cpmem_set_stride(ipu_plane->ipu_ch, state->fb->pitches[0]);
-	ipu_plane_atomic_set_base(ipu_plane);
+
+	if (ipu_plane_state_is_tiled(state)) {
+		unsigned long eba;
+		unsigned int stride;
+		int ret;
+
+		ret = ipu_prg_channel_configure(ipu_plane->ipu_ch, 1,
+				state->src_w >> 16, state->src_h >> 16,
+				state->src_x >> 16, state->src_y >> 16,
+				state->fb->pitches[0],
+				state->fb->bits_per_pixel >> 3,
+				state->fb->modifier[0],
+				drm_plane_state_to_eba(state), &eba, &stride);
+		if (ret) {
+			DRM_ERROR("failed to configure PRG: %d\n", ret);
+			return;
+		}
+		ipu_plane->prg_enabled = true;
+
+		/* scan out the lines the PRE resolves into OCRAM */
+		ipu_cpmem_set_axi_id(ipu_plane->ipu_ch, 1);
+		ipu_cpmem_set_stride(ipu_plane->ipu_ch, stride);
+		ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 0, eba);
+		ipu_cpmem_set_buffer(ipu_plane->ipu_ch, 1, eba);
+	} else {
+		ipu_cpmem_set_stride(ipu_plane->ipu_ch, state->fb->pitches[0]);
+		ipu_plane_atomic_set_base(ipu_plane);
+	}
 	ipu_plane_enable(ipu_plane);
 }
 
@@ -12,6 +12,7 @@ struct drm_framebuffer;
 struct ipuv3_channel;
 struct dmfc_channel;
 struct ipu_dp;
+struct ipu_ic;
 
 struct ipu_plane {
 	struct drm_plane	base;
@@ -23,6 +24,17 @@ struct ipu_plane {
 
 	int			dma;
 	int			dp_flow;
+
+	bool			prg_enabled;
+
+	/* PRP viewfinder task scaling the overlay on its way to the DP */
+	struct ipu_ic		*ic;
+	struct ipuv3_channel	*ic_in;
+	struct ipuv3_channel	*ic_out;
+	void			*ic_buf_virt;
+	dma_addr_t		ic_buf_phys;
+	size_t			ic_buf_size;
+	bool			ic_enabled;
 };
 
 struct ipu_plane *ipu_plane_init(struct drm_device *dev, struct ipu_soc *ipu,
@@ -0,0 +1,71 @@
+/*
+ * i.MX IPUv3 DRM CRTC tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * Part of the imx_media trace system shared with the V4L2 capture, VPU and
+ * IPU device drivers. Framebuffers are named by the DMA address of their
+ * first plane, which for an imported dma-buf is the address the producer
+ * traced.
+ */
+
+#if !defined(__IPUV3_CRTC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __IPUV3_CRTC_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM imx_media
+
+/* A commit on the primary plane is flushed to the hardware */
+TRACE_EVENT(imx_crtc_buf_queue,
+	TP_PROTO(const char *dev, unsigned int crtc, dma_addr_t addr,
+		 bool async),
+	TP_ARGS(dev, crtc, addr, async),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(unsigned int, crtc)
+		__field(u64, addr)
+		__field(bool, async)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->crtc = crtc;
+		__entry->addr = addr;
+		__entry->async = async;
+	),
+	TP_printk("%s: crtc=%u addr=0x%08llx%s", __get_str(dev),
+		  __entry->crtc, __entry->addr,
+		  __entry->async ? " async" : "")
+);
+
+/* Frame start, the buffer queued before it is shown from now on */
+TRACE_EVENT(imx_crtc_vblank,
+	TP_PROTO(const char *dev, unsigned int crtc, u32 seq),
+	TP_ARGS(dev, crtc, seq),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(unsigned int, crtc)
+		__field(u32, seq)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->crtc = crtc;
+		__entry->seq = seq;
+	),
+	TP_printk("%s: crtc=%u seq=%u", __get_str(dev), __entry->crtc,
+		  __entry->seq)
+);
+
+#endif /* __IPUV3_CRTC_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ipuv3_crtc_trace
+#include <trace/define_trace.h>
@@ -756,6 +756,11 @@ static const struct fsu_link_info fsu_link_info[] = {
 			  FS_PRPVF_DEST_SEL_MASK, FS_PRPVF_DEST_SEL_IRT_VF },
 		.sink = { IPUV3_CHANNEL_MEM_ROT_VF, IPU_FS_PROC_FLOW1,
 			  FS_PRPVF_ROT_SRC_SEL_MASK, FS_PRPVF_ROT_SRC_SEL_VF },
+	}, {
+		.src =  { IPUV3_CHANNEL_IC_PRP_VF_MEM, IPU_FS_PROC_FLOW2,
+			  FS_PRPVF_DEST_SEL_MASK, FS_PRPVF_DEST_SEL_DP_SYNC1 },
+		.sink = { IPUV3_CHANNEL_MEM_FG_SYNC, IPU_FS_DISP_FLOW1,
+			  FS_DP_SYNC1_SRC_SEL_MASK, FS_DP_SYNC1_SRC_SEL_PRPVF },
 	}, {
 		.src =  { IPUV3_CHANNEL_IC_PP_MEM, IPU_FS_PROC_FLOW2,
 			  FS_PP_DEST_SEL_MASK, FS_PP_DEST_SEL_IRT_PP },
@@ -1397,6 +1402,10 @@ static int ipu_probe(struct platform_device *pdev)
 	ipu->ipu_type = devtype->type;
 	ipu->id = of_alias_get_id(np, "ipu");
 
+	ipu->prg_priv = ipu_prg_lookup_by_id(ipu->id);
+	if (IS_ERR(ipu->prg_priv))
+		return PTR_ERR(ipu->prg_priv);
+
 	spin_lock_init(&ipu->lock);
 	mutex_init(&ipu->channel_lock);
 
@@ -1521,7 +1530,23 @@ static struct platform_driver imx_ipu_driver = {
 	.remove = ipu_remove,
 };
 
-module_platform_driver(imx_ipu_driver);
+static struct platform_driver * const drivers[] = {
+	&ipu_pre_drv,
+	&ipu_prg_drv,
+	&imx_ipu_driver,
+};
+
+static int __init imx_ipu_init(void)
+{
+	return platform_register_drivers(drivers, ARRAY_SIZE(drivers));
+}
+module_init(imx_ipu_init);
+
+static void __exit imx_ipu_exit(void)
+{
+	platform_unregister_drivers(drivers, ARRAY_SIZE(drivers));
+}
+module_exit(imx_ipu_exit);
 
 MODULE_ALIAS("platform:imx-ipuv3");
 MODULE_DESCRIPTION("i.MX IPU v3 driver");
@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2017 NXP
+ *
+ * i.MX6QP Prefetch Resolve Engine (PRE)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/genalloc.h>
+#include <linux/io.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <drm/drm_fourcc.h>
+#include <video/imx-ipu-v3.h>
+
+#include "ipu-prv.h"
+
+#define IPU_PRE_CTRL				0x000
+#define IPU_PRE_CTRL_SET			0x004
+#define IPU_PRE_CTRL_CLR			0x008
+#define IPU_PRE_CTRL_ENABLE			(1 << 0)
+#define IPU_PRE_CTRL_BLOCK_EN			(1 << 1)
+#define IPU_PRE_CTRL_BLOCK_16			(1 << 2)
+#define IPU_PRE_CTRL_SDW_UPDATE			(1 << 4)
+#define IPU_PRE_CTRL_EN_REPEAT			(1 << 28)
+#define IPU_PRE_CTRL_TPR_RESET_SEL		(1 << 29)
+#define IPU_PRE_CTRL_CLKGATE			(1 << 30)
+#define IPU_PRE_CTRL_SFTRST			(1 << 31)
+
+#define IPU_PRE_IRQ_MASK			0x010
+
+#define IPU_PRE_CUR_BUF				0x030
+#define IPU_PRE_NEXT_BUF			0x040
+#define IPU_PRE_U_BUF_OFFSET			0x050
+#define IPU_PRE_V_BUF_OFFSET			0x060
+
+#define IPU_PRE_TPR_CTRL			0x070
+#define IPU_PRE_TPR_CTRL_TILE_FORMAT_MASK	0xff
+#define IPU_PRE_TPR_CTRL_TILE_FORMAT_16_BIT	(1 << 0)
+#define IPU_PRE_TPR_CTRL_TILE_FORMAT_SINGLE_BUF	(1 << 5)
+#define IPU_PRE_TPR_CTRL_TILE_FORMAT_SUPER_TILED (1 << 6)
+
+#define IPU_PRE_PREFETCH_ENG_CTRL		0x080
+#define IPU_PRE_PREF_ENG_CTRL_PREFETCH_EN	(1 << 0)
+#define IPU_PRE_PREF_ENG_CTRL_RD_NUM_BYTES(v)	(((v) & 0x7) << 1)
+#define IPU_PRE_PREF_ENG_CTRL_INPUT_ACTIVE_BPP(v) (((v) & 0x3) << 4)
+#define IPU_PRE_PREF_ENG_CTRL_INPUT_PIXEL_FORMAT(v) (((v) & 0x7) << 8)
+#define IPU_PRE_PREF_ENG_CTRL_SHIFT_BYPASS	(1 << 11)
+#define IPU_PRE_PREF_ENG_CTRL_TPR_COOR_OFFSET_EN (1 << 15)
+
+#define IPU_PRE_PREFETCH_ENG_INPUT_SIZE		0x0a0
+#define IPU_PRE_PREFETCH_ENG_OUTPUT_SIZE_ULC	0x0b0
+#define IPU_PRE_PREFETCH_ENG_PITCH		0x0d0
+#define IPU_PRE_PREFETCH_ENG_SHIFT_OFFSET	0x0e0
+#define IPU_PRE_PREFETCH_ENG_SHIFT_WIDTH	0x0f0
+#define IPU_PRE_PREFETCH_ENG_INTERLACE_OFFSET	0x100
+
+#define IPU_PRE_STORE_ENG_CTRL			0x110
+#define IPU_PRE_STORE_ENG_CTRL_STORE_EN		(1 << 0)
+#define IPU_PRE_STORE_ENG_CTRL_WR_NUM_BYTES(v)	(((v) & 0x7) << 1)
+#define IPU_PRE_STORE_ENG_CTRL_OUTPUT_ACTIVE_BPP(v) (((v) & 0x3) << 4)
+
+#define IPU_PRE_STORE_ENG_STATUS		0x120
+#define IPU_PRE_STORE_ENG_STATUS_STORE_BLOCK_Y_SHIFT 16
+#define IPU_PRE_STORE_ENG_STATUS_STORE_BLOCK_Y_MASK 0x3fff
+
+#define IPU_PRE_STORE_ENG_SIZE			0x130
+#define IPU_PRE_STORE_ENG_PITCH			0x140
+#define IPU_PRE_STORE_ENG_ADDR			0x150
+
+#define IPU_PRE_SIZE(w, h)			(((h) << 16) | (w))
+
+/* lines of output the store engine double buffer holds */
+#define IPU_PRE_NUM_SCANLINES			8
+
+struct ipu_pre {
+	struct list_head	list;
+	struct device		*dev;
+	int			id;
+
+	void __iomem		*regs;
+	struct clk		*clk_axi;
+	struct gen_pool		*iram;
+
+	dma_addr_t		buffer_paddr;
+	void			*buffer_virt;
+	size_t			buffer_size;
+	bool			in_use;
+
+	unsigned int		safe_window_end;
+	unsigned int		last_bufaddr;
+};
+
+static DEFINE_MUTEX(ipu_pre_list_mutex);
+static LIST_HEAD(ipu_pre_list);
+
+struct ipu_pre *ipu_pre_lookup_by_id(int id)
+{
+	struct ipu_pre *pre;
+
+	mutex_lock(&ipu_pre_list_mutex);
+	list_for_each_entry(pre, &ipu_pre_list, list) {
+		if (pre->id == id) {
+			mutex_unlock(&ipu_pre_list_mutex);
+			return pre;
+		}
+	}
+	mutex_unlock(&ipu_pre_list_mutex);
+
+	return NULL;
+}
+
+int ipu_pre_get(struct ipu_pre *pre)
+{
+	int ret;
+
+	mutex_lock(&ipu_pre_list_mutex);
+	if (pre->in_use) {
+		mutex_unlock(&ipu_pre_list_mutex);
+		return -EBUSY;
+	}
+
+	ret = clk_prepare_enable(pre->clk_axi);
+	if (ret) {
+		mutex_unlock(&ipu_pre_list_mutex);
+		return ret;
+	}
+
+	/* first get the engine out of reset and remove clock gating */
+	writel(IPU_PRE_CTRL_SFTRST | IPU_PRE_CTRL_CLKGATE,
+	       pre->regs + IPU_PRE_CTRL_CLR);
+	pre->in_use = true;
+	mutex_unlock(&ipu_pre_list_mutex);
+
+	return 0;
+}
+
+void ipu_pre_put(struct ipu_pre *pre)
+{
+	mutex_lock(&ipu_pre_list_mutex);
+	if (!pre->in_use) {
+		mutex_unlock(&ipu_pre_list_mutex);
+		return;
+	}
+
+	writel(IPU_PRE_CTRL_ENABLE, pre->regs + IPU_PRE_CTRL_CLR);
+	writel(IPU_PRE_CTRL_SDW_UPDATE, pre->regs + IPU_PRE_CTRL_SET);
+	writel(IPU_PRE_CTRL_SFTRST, pre->regs + IPU_PRE_CTRL_SET);
+
+	clk_disable_unprepare(pre->clk_axi);
+	pre->in_use = false;
+	mutex_unlock(&ipu_pre_list_mutex);
+}
+
+u32 ipu_pre_get_baddr(struct ipu_pre *pre)
+{
+	return (u32)pre->buffer_paddr;
+}
+
+/*
+ * Resolve a tiled framebuffer into the store engine double buffer in OCRAM.
+ * The prefetch window starts at the resolve block holding (x, y) and is
+ * widened to whole blocks; the PRG skips what lies in front of the visible
+ * area. Returns the pitch of the resolved scanlines, or 0 if the window does
+ * not fit into the double buffer.
+ */
+unsigned int ipu_pre_configure(struct ipu_pre *pre, unsigned int width,
+			       unsigned int height, unsigned int x,
+			       unsigned int y, unsigned int stride,
+			       unsigned int cpp, u64 modifier,
+			       unsigned int bufaddr)
+{
+	unsigned int active_width, active_height, store_pitch;
+	u32 active_bpp = ilog2(cpp);
+	u32 val;
+
+	active_width = ALIGN(width + x % IPU_PRE_BLOCK_WIDTH,
+			     IPU_PRE_BLOCK_WIDTH);
+	active_height = ALIGN(height + y % IPU_PRE_BLOCK_HEIGHT,
+			      IPU_PRE_BLOCK_HEIGHT);
+	store_pitch = active_width * cpp;
+
+	if (store_pitch * IPU_PRE_NUM_SCANLINES > pre->buffer_size)
+		return 0;
+
+	/*
+	 * Control register updates are only safe while the store engine is
+	 * outside the first and the last block row (ERR009624).
+	 */
+	pre->safe_window_end = active_height / IPU_PRE_BLOCK_HEIGHT - 1;
+
+	writel(bufaddr, pre->regs + IPU_PRE_CUR_BUF);
+	writel(bufaddr, pre->regs + IPU_PRE_NEXT_BUF);
+	writel(0, pre->regs + IPU_PRE_U_BUF_OFFSET);
+	writel(0, pre->regs + IPU_PRE_V_BUF_OFFSET);
+	pre->last_bufaddr = bufaddr;
+
+	/* only the single buffer tile layouts are supported */
+	val = IPU_PRE_TPR_CTRL_TILE_FORMAT_SINGLE_BUF;
+	if (modifier == DRM_FORMAT_MOD_VIVANTE_SUPER_TILED)
+		val |= IPU_PRE_TPR_CTRL_TILE_FORMAT_SUPER_TILED;
+	if (cpp == 2)
+		val |= IPU_PRE_TPR_CTRL_TILE_FORMAT_16_BIT;
+	writel(val, pre->regs + IPU_PRE_TPR_CTRL);
+
+	writel(IPU_PRE_SIZE(active_width, active_height),
+	       pre->regs + IPU_PRE_PREFETCH_ENG_INPUT_SIZE);
+	writel(IPU_PRE_SIZE(rounddown(x, IPU_PRE_BLOCK_WIDTH),
+			    rounddown(y, IPU_PRE_BLOCK_HEIGHT)),
+	       pre->regs + IPU_PRE_PREFETCH_ENG_OUTPUT_SIZE_ULC);
+	writel(stride, pre->regs + IPU_PRE_PREFETCH_ENG_PITCH);
+	writel(0, pre->regs + IPU_PRE_PREFETCH_ENG_SHIFT_OFFSET);
+	writel(0, pre->regs + IPU_PRE_PREFETCH_ENG_SHIFT_WIDTH);
+	writel(0, pre->regs + IPU_PRE_PREFETCH_ENG_INTERLACE_OFFSET);
+
+	val = IPU_PRE_PREF_ENG_CTRL_INPUT_PIXEL_FORMAT(0) |
+	      IPU_PRE_PREF_ENG_CTRL_INPUT_ACTIVE_BPP(active_bpp) |
+	      IPU_PRE_PREF_ENG_CTRL_RD_NUM_BYTES(4) |
+	      IPU_PRE_PREF_ENG_CTRL_SHIFT_BYPASS |
+	      IPU_PRE_PREF_ENG_CTRL_TPR_COOR_OFFSET_EN |
+	      IPU_PRE_PREF_ENG_CTRL_PREFETCH_EN;
+	writel(val, pre->regs + IPU_PRE_PREFETCH_ENG_CTRL);
+
+	writel(IPU_PRE_SIZE(active_width, active_height),
+	       pre->regs + IPU_PRE_STORE_ENG_SIZE);
+	writel(store_pitch, pre->regs + IPU_PRE_STORE_ENG_PITCH);
+	writel(pre->buffer_paddr, pre->regs + IPU_PRE_STORE_ENG_ADDR);
+
+	val = IPU_PRE_STORE_ENG_CTRL_OUTPUT_ACTIVE_BPP(active_bpp) |
+	      IPU_PRE_STORE_ENG_CTRL_WR_NUM_BYTES(3) |
+	      IPU_PRE_STORE_ENG_CTRL_STORE_EN;
+	writel(val, pre->regs + IPU_PRE_STORE_ENG_CTRL);
+
+	if (active_width % 32)
+		writel(IPU_PRE_CTRL_BLOCK_16, pre->regs + IPU_PRE_CTRL_SET);
+	else
+		writel(IPU_PRE_CTRL_BLOCK_16, pre->regs + IPU_PRE_CTRL_CLR);
+
+	writel(IPU_PRE_CTRL_TPR_RESET_SEL | IPU_PRE_CTRL_EN_REPEAT |
+	       IPU_PRE_CTRL_BLOCK_EN | IPU_PRE_CTRL_SDW_UPDATE |
+	       IPU_PRE_CTRL_ENABLE, pre->regs + IPU_PRE_CTRL_SET);
+
+	return store_pitch;
+}
+
+/* Latch a new framebuffer address at the next frame start. */
+void ipu_pre_update(struct ipu_pre *pre, unsigned int bufaddr)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(5);
+	unsigned short current_yblock;
+	u32 val;
+
+	if (bufaddr == pre->last_bufaddr)
+		return;
+
+	writel(bufaddr, pre->regs + IPU_PRE_NEXT_BUF);
+	pre->last_bufaddr = bufaddr;
+
+	do {
+		if (time_after(jiffies, timeout)) {
+			dev_warn(pre->dev, "timeout waiting for PRE safe window\n");
+			return;
+		}
+
+		val = readl(pre->regs + IPU_PRE_STORE_ENG_STATUS);
+		current_yblock =
+			(val >> IPU_PRE_STORE_ENG_STATUS_STORE_BLOCK_Y_SHIFT) &
+			IPU_PRE_STORE_ENG_STATUS_STORE_BLOCK_Y_MASK;
+	} while (current_yblock == 0 ||
+		 current_yblock >= pre->safe_window_end);
+
+	writel(IPU_PRE_CTRL_SDW_UPDATE, pre->regs + IPU_PRE_CTRL_SET);
+}
+
+static int ipu_pre_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct resource *res;
+	struct ipu_pre *pre;
+	int ret;
+
+	pre = devm_kzalloc(dev, sizeof(*pre), GFP_KERNEL);
+	if (!pre)
+		return -ENOMEM;
+
+	pre->id = of_alias_get_id(dev->of_node, "pre");
+	if (pre->id < 0) {
+		dev_err(dev, "failed to get PRE id\n");
+		return pre->id;
+	}
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	pre->regs = devm_ioremap_resource(dev, res);
+	if (IS_ERR(pre->regs))
+		return PTR_ERR(pre->regs);
+
+	pre->clk_axi = devm_clk_get(dev, NULL);
+	if (IS_ERR(pre->clk_axi))
+		return PTR_ERR(pre->clk_axi);
+
+	pre->iram = of_gen_pool_get(dev->of_node, "ocram", 0);
+	if (!pre->iram)
+		return -EPROBE_DEFER;
+
+	/*
+	 * Allocate IRAM buffer with maximum size. This could be made dynamic,
+	 * but as there is no other user of this IRAM region and we can fit all
+	 * max sized buffers into it, there is no need yet.
+	 */
+	pre->buffer_size = (IPU_PRE_MAX_WIDTH + 2 * IPU_PRE_BLOCK_WIDTH) *
+			   IPU_PRE_NUM_SCANLINES * 4;
+	pre->buffer_virt = gen_pool_dma_alloc(pre->iram, pre->buffer_size,
+					      &pre->buffer_paddr);
+	if (!pre->buffer_virt)
+		return -ENOMEM;
+
+	/* leave the engine in reset with the interrupts masked */
+	ret = clk_prepare_enable(pre->clk_axi);
+	if (ret) {
+		gen_pool_free(pre->iram, (unsigned long)pre->buffer_virt,
+			      pre->buffer_size);
+		return ret;
+	}
+	writel(IPU_PRE_CTRL_SFTRST | IPU_PRE_CTRL_CLKGATE,
+	       pre->regs + IPU_PRE_CTRL_CLR);
+	writel(0, pre->regs + IPU_PRE_IRQ_MASK);
+	writel(IPU_PRE_CTRL_SFTRST, pre->regs + IPU_PRE_CTRL_SET);
+	clk_disable_unprepare(pre->clk_axi);
+
+	pre->dev = dev;
+	platform_set_drvdata(pdev, pre);
+
+	mutex_lock(&ipu_pre_list_mutex);
+	list_add(&pre->list, &ipu_pre_list);
+	mutex_unlock(&ipu_pre_list_mutex);
+
+	return 0;
+}
+
+static int ipu_pre_remove(struct platform_device *pdev)
+{
+	struct ipu_pre *pre = platform_get_drvdata(pdev);
+
+	mutex_lock(&ipu_pre_list_mutex);
+	list_del(&pre->list);
+	mutex_unlock(&ipu_pre_list_mutex);
+
+	gen_pool_free(pre->iram, (unsigned long)pre->buffer_virt,
+		      pre->buffer_size);
+
+	return 0;
+}
+
+static const struct of_device_id ipu_pre_dt_ids[] = {
+	{ .compatible = "fsl,imx6q-pre", },
+	{ /* sentinel */ },
+};
+
+struct platform_driver ipu_pre_drv = {
+	.probe		= ipu_pre_probe,
+	.remove		= ipu_pre_remove,
+	.driver		= {
+		.name	= "imx-ipu-pre",
+		.of_match_table = ipu_pre_dt_ids,
+	},
+};
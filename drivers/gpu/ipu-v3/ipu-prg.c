@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2017 NXP
+ *
+ * i.MX6QP Prefetch Resolve Gasket (PRG)
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/iopoll.h>
+#include <linux/list.h>
+#include <linux/mfd/syscon.h>
+#include <linux/mfd/syscon/imx6q-iomuxc-gpr.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/platform_device.h>
+#include <linux/regmap.h>
+#include <drm/drm_fourcc.h>
+#include <video/imx-ipu-v3.h>
+
+#include "ipu-prv.h"
+
+#define IPU_PRG_CTRL				0x00
+#define IPU_PRG_CTRL_BYPASS(i)			(1 << (i))
+#define IPU_PRG_CTRL_SOFT_ARID_MASK		0x3
+#define IPU_PRG_CTRL_SOFT_ARID_SHIFT(i)		(8 + (i) * 2)
+#define IPU_PRG_CTRL_SOFT_ARID(i, v)		(((v) & 0x3) << (8 + 2 * (i)))
+#define IPU_PRG_CTRL_SO(i)			(1 << (16 + (i)))
+#define IPU_PRG_CTRL_VFLIP(i)			(1 << (19 + (i)))
+#define IPU_PRG_CTRL_BLOCK_MODE(i)		(1 << (22 + (i)))
+#define IPU_PRG_CTRL_CNT_LOAD_EN(i)		(1 << (25 + (i)))
+#define IPU_PRG_CTRL_CNT_LOAD_EN_MASK		(0x7 << 25)
+#define IPU_PRG_CTRL_SHADOW_EN			(1 << 31)
+
+#define IPU_PRG_STATUS				0x04
+#define IPU_PRG_STATUS_BUFFER0_READY(i)		(1 << ((i) * 2))
+#define IPU_PRG_STATUS_BUFFER1_READY(i)		(1 << ((i) * 2 + 1))
+
+#define IPU_PRG_REG_UPDATE			0x0c
+#define IPU_PRG_REG_UPDATE_REG_UPDATE		(1 << 0)
+
+#define IPU_PRG_STRIDE(i)			(0x10 + (i) * 0x4)
+#define IPU_PRG_STRIDE_STRIDE_MASK		0x3fff
+
+#define IPU_PRG_CROP_LINE			0x1c
+#define IPU_PRG_CROP_LINE_NUM(i, v)		(((v) & 0xf) << ((i) * 4))
+#define IPU_PRG_CROP_LINE_MASK(i)		(0xf << ((i) * 4))
+
+#define IPU_PRG_THD				0x20
+
+#define IPU_PRG_BADDR(i)			(0x24 + (i) * 0x4)
+
+#define IPU_PRG_OFFSET(i)			(0x30 + (i) * 0x4)
+
+#define IPU_PRG_ILO(i)				(0x3c + (i) * 0x4)
+
+#define IPU_PRG_HEIGHT(i)			(0x48 + (i) * 0x4)
+#define IPU_PRG_HEIGHT_PRE_HEIGHT_MASK		0xfff
+#define IPU_PRG_HEIGHT_PRE_HEIGHT_SHIFT		0
+#define IPU_PRG_HEIGHT_IPU_HEIGHT_MASK		0xfff
+#define IPU_PRG_HEIGHT_IPU_HEIGHT_SHIFT		16
+
+#define IPU_PRG_NUM_CHANNELS			3
+
+struct ipu_prg_channel {
+	bool			enabled;
+	struct ipu_pre		*pre;
+	int			pre_id;
+};
+
+struct ipu_prg {
+	struct list_head	list;
+	struct device		*dev;
+	int			id;
+
+	void __iomem		*regs;
+	struct clk		*clk_apb, *clk_axi;
+	struct regmap		*iomuxc_gpr;
+	u32			addr_thd;
+
+	struct ipu_prg_channel	chan[IPU_PRG_NUM_CHANNELS];
+};
+
+static DEFINE_MUTEX(ipu_prg_list_mutex);
+static LIST_HEAD(ipu_prg_list);
+
+/*
+ * Returns NULL if the IPU has no PRG in front of it, or -EPROBE_DEFER while
+ * its PRG is described in the device tree but not probed yet.
+ */
+struct ipu_prg *ipu_prg_lookup_by_id(int id)
+{
+	struct device_node *np;
+	struct ipu_prg *prg;
+
+	mutex_lock(&ipu_prg_list_mutex);
+	list_for_each_entry(prg, &ipu_prg_list, list) {
+		if (prg->id == id) {
+			mutex_unlock(&ipu_prg_list_mutex);
+			return prg;
+		}
+	}
+	mutex_unlock(&ipu_prg_list_mutex);
+
+	for_each_compatible_node(np, NULL, "fsl,imx6q-prg") {
+		if (of_device_is_available(np) &&
+		    of_alias_get_id(np, "prg") == id) {
+			of_node_put(np);
+			return ERR_PTR(-EPROBE_DEFER);
+		}
+	}
+
+	return NULL;
+}
+
+bool ipu_prg_present(struct ipu_soc *ipu)
+{
+	return !!ipu->prg_priv;
+}
+EXPORT_SYMBOL_GPL(ipu_prg_present);
+
+bool ipu_prg_format_supported(struct ipu_soc *ipu, u32 format, u64 modifier)
+{
+	if (!ipu->prg_priv)
+		return false;
+
+	if (modifier != DRM_FORMAT_MOD_VIVANTE_TILED &&
+	    modifier != DRM_FORMAT_MOD_VIVANTE_SUPER_TILED)
+		return false;
+
+	/* the resolve engine handles 16 and 32 bit packed RGB only */
+	switch (format) {
+	case DRM_FORMAT_RGB565:
+	case DRM_FORMAT_ARGB8888:
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ABGR8888:
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_RGBA8888:
+	case DRM_FORMAT_RGBX8888:
+	case DRM_FORMAT_BGRA8888:
+		return true;
+	default:
+		return false;
+	}
+}
+EXPORT_SYMBOL_GPL(ipu_prg_format_supported);
+
+static int ipu_prg_ipu_to_prg_chan(int ipu_chan)
+{
+	switch (ipu_chan) {
+	case IPUV3_CHANNEL_MEM_BG_SYNC:
+		return 0;
+	case IPUV3_CHANNEL_MEM_FG_SYNC:
+		return 1;
+	case IPUV3_CHANNEL_MEM_DC_SYNC:
+		return 2;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * PRE0 and PRE3 are hardwired to the background channel of IPU1 and IPU2.
+ * PRE1 and PRE2 are routed to the remaining channels through GPR5; each IPU
+ * gets one of them for its foreground channel so display planes never have
+ * to compete for an engine.
+ */
+static int ipu_prg_chan_to_pre_id(struct ipu_prg *prg, int prg_chan)
+{
+	if (prg_chan == 0)
+		return prg->id ? 3 : 0;
+	if (prg_chan == 1)
+		return prg->id ? 2 : 1;
+	return prg->id ? 1 : 2;
+}
+
+static void ipu_prg_route_pre(struct ipu_prg *prg, int prg_chan, int pre_id)
+{
+	unsigned int shift, other_shift, mux, other;
+
+	if (prg_chan == 0)
+		return;
+
+	shift = pre_id == 1 ? IMX6Q_GPR5_PRE_PRG_SEL0_SHIFT :
+			      IMX6Q_GPR5_PRE_PRG_SEL1_SHIFT;
+	other_shift = pre_id == 1 ? IMX6Q_GPR5_PRE_PRG_SEL1_SHIFT :
+				    IMX6Q_GPR5_PRE_PRG_SEL0_SHIFT;
+	mux = (prg_chan - 1) + (prg->id << 1);
+
+	mutex_lock(&ipu_prg_list_mutex);
+	regmap_update_bits(prg->iomuxc_gpr, IOMUXC_GPR5, 0x3 << shift,
+			   mux << shift);
+
+	/*
+	 * PRE1 and PRE2 must not select the same PRG channel, even if one of
+	 * them is idle.
+	 */
+	regmap_read(prg->iomuxc_gpr, IOMUXC_GPR5, &other);
+	if (((other >> other_shift) & 0x3) == mux)
+		regmap_update_bits(prg->iomuxc_gpr, IOMUXC_GPR5,
+				   0x3 << other_shift,
+				   (mux ^ 0x1) << other_shift);
+	mutex_unlock(&ipu_prg_list_mutex);
+}
+
+static void ipu_prg_reg_update(struct ipu_prg *prg)
+{
+	u32 val;
+
+	val = readl(prg->regs + IPU_PRG_CTRL);
+	val |= IPU_PRG_CTRL_SHADOW_EN;
+	writel(val, prg->regs + IPU_PRG_CTRL);
+
+	writel(IPU_PRG_REG_UPDATE_REG_UPDATE, prg->regs + IPU_PRG_REG_UPDATE);
+}
+
+void ipu_prg_channel_disable(struct ipuv3_channel *ipu_chan)
+{
+	int prg_chan = ipu_prg_ipu_to_prg_chan(ipu_chan->num);
+	struct ipu_prg *prg = ipu_chan->ipu->prg_priv;
+	struct ipu_prg_channel *chan;
+	u32 val;
+
+	if (!prg || prg_chan < 0)
+		return;
+
+	chan = &prg->chan[prg_chan];
+	if (!chan->enabled)
+		return;
+
+	val = readl(prg->regs + IPU_PRG_CTRL);
+	val &= ~IPU_PRG_CTRL_CNT_LOAD_EN_MASK;
+	val |= IPU_PRG_CTRL_CNT_LOAD_EN(prg_chan) |
+	       IPU_PRG_CTRL_BYPASS(prg_chan);
+	writel(val, prg->regs + IPU_PRG_CTRL);
+	ipu_prg_reg_update(prg);
+
+	ipu_pre_put(chan->pre);
+
+	clk_disable_unprepare(prg->clk_apb);
+	clk_disable_unprepare(prg->clk_axi);
+
+	chan->enabled = false;
+}
+EXPORT_SYMBOL_GPL(ipu_prg_channel_disable);
+
+/*
+ * Route an IDMAC channel through its PRE so that it scans out a tiled
+ * framebuffer at bufaddr, cropped to width x height at (x, y). On success the
+ * address and stride the channel has to fetch from are returned through
+ * eba and ipu_stride.
+ */
+int ipu_prg_channel_configure(struct ipuv3_channel *ipu_chan,
+			      unsigned int axi_id, unsigned int width,
+			      unsigned int height, unsigned int x,
+			      unsigned int y, unsigned int stride,
+			      unsigned int cpp, u64 modifier,
+			      unsigned long bufaddr, unsigned long *eba,
+			      unsigned int *ipu_stride)
+{
+	int prg_chan = ipu_prg_ipu_to_prg_chan(ipu_chan->num);
+	struct ipu_prg *prg = ipu_chan->ipu->prg_priv;
+	unsigned int pre_height, crop_line, pitch, offset;
+	struct ipu_prg_channel *chan;
+	u32 val;
+	int ret;
+
+	if (!prg || prg_chan < 0)
+		return -EINVAL;
+
+	chan = &prg->chan[prg_chan];
+
+	if (chan->enabled)
+		ipu_prg_channel_disable(ipu_chan);
+
+	if (!chan->pre) {
+		chan->pre = ipu_pre_lookup_by_id(chan->pre_id);
+		if (!chan->pre)
+			return -ENODEV;
+	}
+
+	ret = ipu_pre_get(chan->pre);
+	if (ret)
+		return ret;
+
+	ret = clk_prepare_enable(prg->clk_axi);
+	if (ret)
+		goto err_pre;
+	ret = clk_prepare_enable(prg->clk_apb);
+	if (ret)
+		goto err_axi;
+
+	ipu_prg_route_pre(prg, prg_chan, chan->pre_id);
+
+	pitch = ipu_pre_configure(chan->pre, width, height, x, y, stride,
+				  cpp, modifier, bufaddr);
+	if (!pitch) {
+		ret = -EINVAL;
+		goto err_apb;
+	}
+
+	pre_height = ALIGN(height + y % IPU_PRE_BLOCK_HEIGHT,
+			   IPU_PRE_BLOCK_HEIGHT);
+	crop_line = y % IPU_PRE_BLOCK_HEIGHT;
+	offset = crop_line * pitch + (x % IPU_PRE_BLOCK_WIDTH) * cpp;
+
+	/* clear all load enables so the other channels are left alone */
+	val = readl(prg->regs + IPU_PRG_CTRL);
+	val &= ~(IPU_PRG_CTRL_CNT_LOAD_EN_MASK | IPU_PRG_CTRL_SO(prg_chan) |
+		 IPU_PRG_CTRL_VFLIP(prg_chan) | IPU_PRG_CTRL_BYPASS(prg_chan) |
+		 (IPU_PRG_CTRL_SOFT_ARID_MASK <<
+		  IPU_PRG_CTRL_SOFT_ARID_SHIFT(prg_chan)));
+	val |= IPU_PRG_CTRL_CNT_LOAD_EN(prg_chan) |
+	       IPU_PRG_CTRL_SOFT_ARID(prg_chan, axi_id) |
+	       IPU_PRG_CTRL_BLOCK_MODE(prg_chan);
+	writel(val, prg->regs + IPU_PRG_CTRL);
+
+	writel((pitch - 1) & IPU_PRG_STRIDE_STRIDE_MASK,
+	       prg->regs + IPU_PRG_STRIDE(prg_chan));
+
+	val = ((pre_height - 1) << IPU_PRG_HEIGHT_PRE_HEIGHT_SHIFT) |
+	      ((height - 1) << IPU_PRG_HEIGHT_IPU_HEIGHT_SHIFT);
+	writel(val, prg->regs + IPU_PRG_HEIGHT(prg_chan));
+
+	writel(0, prg->regs + IPU_PRG_ILO(prg_chan));
+
+	val = readl(prg->regs + IPU_PRG_CROP_LINE);
+	val &= ~IPU_PRG_CROP_LINE_MASK(prg_chan);
+	val |= IPU_PRG_CROP_LINE_NUM(prg_chan, crop_line);
+	writel(val, prg->regs + IPU_PRG_CROP_LINE);
+
+	writel(ipu_pre_get_baddr(chan->pre),
+	       prg->regs + IPU_PRG_BADDR(prg_chan));
+	writel(offset, prg->regs + IPU_PRG_OFFSET(prg_chan));
+	writel(prg->addr_thd, prg->regs + IPU_PRG_THD);
+
+	ipu_prg_reg_update(prg);
+
+	/* wait for both double buffers to be filled */
+	readl_poll_timeout(prg->regs + IPU_PRG_STATUS, val,
+			   (val & IPU_PRG_STATUS_BUFFER0_READY(prg_chan)) &&
+			   (val & IPU_PRG_STATUS_BUFFER1_READY(prg_chan)),
+			   5, 1000);
+
+	chan->enabled = true;
+
+	*eba = ipu_pre_get_baddr(chan->pre) + offset;
+	*ipu_stride = pitch;
+
+	return 0;
+
+err_apb:
+	clk_disable_unprepare(prg->clk_apb);
+err_axi:
+	clk_disable_unprepare(prg->clk_axi);
+err_pre:
+	ipu_pre_put(chan->pre);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ipu_prg_channel_configure);
+
+/* Flip a configured channel to another framebuffer of the same layout. */
+void ipu_prg_channel_update(struct ipuv3_channel *ipu_chan,
+			    unsigned long bufaddr)
+{
+	int prg_chan = ipu_prg_ipu_to_prg_chan(ipu_chan->num);
+	struct ipu_prg *prg = ipu_chan->ipu->prg_priv;
+
+	if (!prg || prg_chan < 0 || !prg->chan[prg_chan].enabled)
+		return;
+
+	ipu_pre_update(prg->chan[prg_chan].pre, bufaddr);
+}
+EXPORT_SYMBOL_GPL(ipu_prg_channel_update);
+
+static int ipu_prg_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *memory;
+	struct resource *res;
+	struct ipu_prg *prg;
+	int i, ret;
+
+	prg = devm_kzalloc(dev, sizeof(*prg), GFP_KERNEL);
+	if (!prg)
+		return -ENOMEM;
+
+	prg->id = of_alias_get_id(dev->of_node, "prg");
+	if (prg->id < 0) {
+		dev_err(dev, "failed to get PRG id\n");
+		return prg->id;
+	}
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	prg->regs = devm_ioremap_resource(dev, res);
+	if (IS_ERR(prg->regs))
+		return PTR_ERR(prg->regs);
+
+	prg->clk_apb = devm_clk_get(dev, "apb");
+	if (IS_ERR(prg->clk_apb))
+		return PTR_ERR(prg->clk_apb);
+
+	prg->clk_axi = devm_clk_get(dev, "axi");
+	if (IS_ERR(prg->clk_axi))
+		return PTR_ERR(prg->clk_axi);
+
+	prg->iomuxc_gpr = syscon_regmap_lookup_by_phandle(dev->of_node, "gpr");
+	if (IS_ERR(prg->iomuxc_gpr))
+		return PTR_ERR(prg->iomuxc_gpr);
+
+	/* the PRG address threshold is the base of the reserved region */
+	memory = of_parse_phandle(dev->of_node, "memory-region", 0);
+	if (!memory)
+		return -ENODEV;
+
+	prg->addr_thd = of_translate_address(memory,
+				of_get_address(memory, 0, NULL, NULL));
+	of_node_put(memory);
+
+	for (i = 0; i < IPU_PRG_NUM_CHANNELS; i++)
+		prg->chan[i].pre_id = ipu_prg_chan_to_pre_id(prg, i);
+
+	/* put all channels into bypass until they are configured */
+	ret = clk_prepare_enable(prg->clk_apb);
+	if (ret)
+		return ret;
+	writel(IPU_PRG_CTRL_BYPASS(0) | IPU_PRG_CTRL_BYPASS(1) |
+	       IPU_PRG_CTRL_BYPASS(2), prg->regs + IPU_PRG_CTRL);
+	ipu_prg_reg_update(prg);
+	clk_disable_unprepare(prg->clk_apb);
+
+	prg->dev = dev;
+	platform_set_drvdata(pdev, prg);
+
+	mutex_lock(&ipu_prg_list_mutex);
+	list_add(&prg->list, &ipu_prg_list);
+	mutex_unlock(&ipu_prg_list_mutex);
+
+	return 0;
+}
+
+static int ipu_prg_remove(struct platform_device *pdev)
+{
+	struct ipu_prg *prg = platform_get_drvdata(pdev);
+
+	mutex_lock(&ipu_prg_list_mutex);
+	list_del(&prg->list);
+	mutex_unlock(&ipu_prg_list_mutex);
+
+	return 0;
+}
+
+static const struct of_device_id ipu_prg_dt_ids[] = {
+	{ .compatible = "fsl,imx6q-prg", },
+	{ /* sentinel */ },
+};
+
+struct platform_driver ipu_prg_drv = {
+	.probe		= ipu_prg_probe,
+	.remove		= ipu_prg_remove,
+	.driver		= {
+		.name	= "imx-ipu-prg",
+		.of_match_table = ipu_prg_dt_ids,
+	},
+};
@@ -16,6 +16,8 @@
 #define __IPU_PRV_H__
 
 struct ipu_soc;
+struct ipu_pre;
+struct ipu_prg;
 
 #include <linux/types.h>
 #include <linux/device.h>
@@ -95,6 +97,7 @@ struct ipu_soc;
 #define FS_PRP_ENC_DEST_SEL_IRT_ENC		(0x1 << 0)
 #define FS_PRPVF_DEST_SEL_MASK		(0xf << 4)
 #define FS_PRPVF_DEST_SEL_IRT_VF		(0x1 << 4)
+#define FS_PRPVF_DEST_SEL_DP_SYNC1		(0xa << 4)
 #define FS_PRPVF_ROT_DEST_SEL_MASK	(0xf << 8)
 #define FS_PP_DEST_SEL_MASK		(0xf << 12)
 #define FS_PP_DEST_SEL_IRT_PP			(0x3 << 12)
@@ -102,6 +105,10 @@ struct ipu_soc;
 #define FS_PRPENC_ROT_DEST_SEL_MASK	(0xf << 20)
 #define FS_PRP_DEST_SEL_MASK		(0xf << 24)
 
+/* FS_DISP_FLOW1 */
+#define FS_DP_SYNC1_SRC_SEL_MASK	(0xf << 4)
+#define FS_DP_SYNC1_SRC_SEL_PRPVF		(0x5 << 4)
+
 #define IPU_DI0_COUNTER_RELEASE			(1 << 24)
 #define IPU_DI1_COUNTER_RELEASE			(1 << 25)
 
@@ -202,6 +209,7 @@ struct ipu_soc {
 	struct ipu_vdi          *vdi_priv;
 	struct ipu_image_convert_priv *image_convert_priv;
 	struct ipu_smfc_priv	*smfc_priv;
+	struct ipu_prg		*prg_priv;
 };
 
 static inline u32 ipu_idmac_read(struct ipu_soc *ipu, unsigned offset)
@@ -217,6 +225,22 @@ static inline void ipu_idmac_write(struct ipu_soc *ipu, u32 value,
 
 void ipu_srm_dp_sync_update(struct ipu_soc *ipu);
 
+struct ipu_pre *ipu_pre_lookup_by_id(int id);
+int ipu_pre_get(struct ipu_pre *pre);
+void ipu_pre_put(struct ipu_pre *pre);
+u32 ipu_pre_get_baddr(struct ipu_pre *pre);
+unsigned int ipu_pre_configure(struct ipu_pre *pre, unsigned int width,
+			       unsigned int height, unsigned int x,
+			       unsigned int y, unsigned int stride,
+			       unsigned int cpp, u64 modifier,
+			       unsigned int bufaddr);
+void ipu_pre_update(struct ipu_pre *pre, unsigned int bufaddr);
+
+struct ipu_prg *ipu_prg_lookup_by_id(int id);
+
+extern struct platform_driver ipu_pre_drv;
+extern struct platform_driver ipu_prg_drv;
+
 int ipu_module_enable(struct ipu_soc *ipu, u32 mask);
 int ipu_module_disable(struct ipu_soc *ipu, u32 mask);
 
@@ -18,6 +18,8 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/i2c.h>
@@ -38,6 +40,7 @@
 #define LPI2C_MCR	0x10	/* i2c contrl register */
 #define LPI2C_MSR	0x14	/* i2c status register */
 #define LPI2C_MIER	0x18	/* i2c interrupt enable */
+#define LPI2C_MDER	0x1C	/* i2c DMA enable */
 #define LPI2C_MCFGR0	0x20	/* i2c master configuration */
 #define LPI2C_MCFGR1	0x24	/* i2c master configuration */
 #define LPI2C_MCFGR2	0x28	/* i2c master configuration */
@@ -76,6 +79,8 @@
 #define MIER_RDIE	BIT(1)
 #define MIER_SDIE	BIT(9)
 #define MIER_NDIE	BIT(10)
+#define MDER_TDDE	BIT(0)
+#define MDER_RDDE	BIT(1)
 #define MCFGR1_AUTOSTOP	BIT(8)
 #define MCFGR1_IGNACK	BIT(9)
 #define MRDR_RXEMPTY	BIT(14)
@@ -83,8 +88,8 @@
 #define I2C_CLK_RATIO	2
 #define CHUNK_DATA	256
 
-#define LPI2C_RX_FIFOSIZE	4
-#define LPI2C_TX_FIFOSIZE	4
+#define LPI2C_DMA_THRESHOLD	16
+#define LPI2C_DMA_TIMEOUT	500	/* ms, on top of the bus time */
 
 #define LPI2C_DEFAULT_RATE	200000
 #define STARDARD_MAX_BITRATE	400000
@@ -118,7 +123,13 @@ struct lpi2c_imx_struct {
 	unsigned int		delivered;
 	unsigned int		block_data;
 	unsigned int		bitrate;
+	unsigned int		txfifosize;
+	unsigned int		rxfifosize;
 	enum lpi2c_imx_mode	mode;
+
+	resource_size_t		phy_addr;
+	struct dma_chan		*chan_tx;
+	struct dma_chan		*chan_rx;
 };
 
 static void lpi2c_imx_intctrl(struct lpi2c_imx_struct *lpi2c_imx,
@@ -346,19 +357,24 @@ static int lpi2c_imx_txfifo_empty(struct lpi2c_imx_struct *lpi2c_imx)
 
 static void lpi2c_imx_set_tx_watermark(struct lpi2c_imx_struct *lpi2c_imx)
 {
-	writel(LPI2C_TX_FIFOSIZE >> 1, lpi2c_imx->base + LPI2C_MFCR);
+	writel(lpi2c_imx->txfifosize >> 1, lpi2c_imx->base + LPI2C_MFCR);
 }
 
+/*
+ * RDF is raised once the RX FIFO holds more than RXWATER words. Ask for
+ * half a FIFO per interrupt, but never more than what the receive command
+ * currently being executed will still clock in, or the last bytes of a
+ * chunk would never raise the flag.
+ */
 static void lpi2c_imx_set_rx_watermark(struct lpi2c_imx_struct *lpi2c_imx)
 {
-	unsigned int temp, remaining;
+	unsigned int temp, remaining, chunk;
 
 	remaining = lpi2c_imx->msglen - lpi2c_imx->delivered;
+	chunk = CHUNK_DATA - (lpi2c_imx->delivered & (CHUNK_DATA - 1));
 
-	if (remaining > (LPI2C_RX_FIFOSIZE >> 1))
-		temp = LPI2C_RX_FIFOSIZE >> 1;
-	else
-		temp = 0;
+	temp = min3(remaining, chunk, lpi2c_imx->rxfifosize >> 1);
+	temp = temp ? temp - 1 : 0;
 
 	writel(temp << 16, lpi2c_imx->base + LPI2C_MFCR);
 }
@@ -369,7 +385,7 @@ static void lpi2c_imx_write_txfifo(struct lpi2c_imx_struct *lpi2c_imx)
 
 	txcnt = readl(lpi2c_imx->base + LPI2C_MFSR) & 0xff;
 
-	while (txcnt < LPI2C_TX_FIFOSIZE) {
+	while (txcnt < lpi2c_imx->txfifosize) {
 		if (lpi2c_imx->delivered == lpi2c_imx->msglen)
 			break;
 
@@ -455,6 +471,183 @@ static void lpi2c_imx_read(struct lpi2c_imx_struct *lpi2c_imx,
 	lpi2c_imx_intctrl(lpi2c_imx, MIER_RDIE | MIER_NDIE);
 }
 
+static bool lpi2c_imx_can_dma(struct lpi2c_imx_struct *lpi2c_imx,
+			      struct i2c_msg *msgs)
+{
+	if (!lpi2c_imx->chan_tx)
+		return false;
+
+	return msgs->len >= LPI2C_DMA_THRESHOLD &&
+	       !(msgs->flags & I2C_M_RECV_LEN);
+}
+
+static int lpi2c_imx_dma_config(struct dma_chan *chan, dma_addr_t addr,
+				enum dma_transfer_direction dir,
+				enum dma_slave_buswidth width)
+{
+	struct dma_slave_config sconfig = {};
+
+	sconfig.direction = dir;
+	if (dir == DMA_MEM_TO_DEV) {
+		sconfig.dst_addr = addr;
+		sconfig.dst_addr_width = width;
+		sconfig.dst_maxburst = 1;
+	} else {
+		sconfig.src_addr = addr;
+		sconfig.src_addr_width = width;
+		sconfig.src_maxburst = 1;
+	}
+
+	return dmaengine_slave_config(chan, &sconfig);
+}
+
+static void lpi2c_imx_dma_callback(void *arg)
+{
+	struct lpi2c_imx_struct *lpi2c_imx = arg;
+
+	complete(&lpi2c_imx->complete);
+}
+
+static int lpi2c_imx_dma_submit(struct dma_chan *chan, dma_addr_t buf,
+				size_t len, enum dma_transfer_direction dir,
+				struct lpi2c_imx_struct *lpi2c_imx)
+{
+	struct dma_async_tx_descriptor *desc;
+
+	desc = dmaengine_prep_slave_single(chan, buf, len, dir,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc)
+		return -EINVAL;
+
+	if (lpi2c_imx) {
+		desc->callback = lpi2c_imx_dma_callback;
+		desc->callback_param = lpi2c_imx;
+	}
+
+	if (dma_submit_error(dmaengine_submit(desc)))
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Data bytes go through MTDR/MRDR with the TX and RX channels. A write is
+ * a plain byte stream, since an 8-bit access to MTDR queues a TRAN_DATA
+ * command. A read also needs one RECV_DATA command per CHUNK_DATA bytes
+ * in the TX FIFO, so those are fed by the TX channel as 16-bit words while
+ * the RX channel drains the data. Completion comes from the channel that
+ * carries the payload; NACK is still reported by the interrupt.
+ */
+static int lpi2c_imx_dma_xfer(struct lpi2c_imx_struct *lpi2c_imx,
+			      struct i2c_msg *msgs)
+{
+	struct device *dev = &lpi2c_imx->adapter.dev;
+	bool read = msgs->flags & I2C_M_RD;
+	struct dma_chan *chan = read ? lpi2c_imx->chan_rx : lpi2c_imx->chan_tx;
+	struct device *chan_dev = chan->device->dev;
+	struct device *tx_dev = lpi2c_imx->chan_tx->device->dev;
+	enum dma_data_direction data_dir;
+	dma_addr_t dma_buf, cmd_dma = 0;
+	unsigned int i, cmd_num = 0;
+	unsigned long timeout;
+	u16 *cmd_buf = NULL;
+	int ret;
+
+	data_dir = read ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+	ret = lpi2c_imx_dma_config(lpi2c_imx->chan_tx,
+				   lpi2c_imx->phy_addr + LPI2C_MTDR,
+				   DMA_MEM_TO_DEV, read ?
+				   DMA_SLAVE_BUSWIDTH_2_BYTES :
+				   DMA_SLAVE_BUSWIDTH_1_BYTE);
+	if (ret)
+		return ret;
+
+	if (read) {
+		cmd_num = DIV_ROUND_UP(msgs->len, CHUNK_DATA);
+		cmd_buf = kcalloc(cmd_num, sizeof(*cmd_buf), GFP_KERNEL);
+		if (!cmd_buf)
+			return -ENOMEM;
+
+		for (i = 0; i < cmd_num; i++) {
+			unsigned int len = min_t(unsigned int, CHUNK_DATA,
+						 msgs->len - i * CHUNK_DATA);
+
+			cmd_buf[i] = (RECV_DATA << 8) | (len - 1);
+		}
+
+		cmd_dma = dma_map_single(tx_dev, cmd_buf,
+					 cmd_num * sizeof(*cmd_buf),
+					 DMA_TO_DEVICE);
+		if (dma_mapping_error(tx_dev, cmd_dma)) {
+			dev_err(dev, "DMA mapping failed\n");
+			ret = -EINVAL;
+			goto out_free;
+		}
+	}
+
+	dma_buf = dma_map_single(chan_dev, msgs->buf, msgs->len, data_dir);
+	if (dma_mapping_error(chan_dev, dma_buf)) {
+		dev_err(dev, "DMA mapping failed\n");
+		ret = -EINVAL;
+		goto out_unmap_cmd;
+	}
+
+	ret = lpi2c_imx_dma_submit(chan, dma_buf, msgs->len, read ?
+				   DMA_DEV_TO_MEM : DMA_MEM_TO_DEV, lpi2c_imx);
+	if (!ret && read)
+		ret = lpi2c_imx_dma_submit(lpi2c_imx->chan_tx, cmd_dma,
+					   cmd_num * sizeof(*cmd_buf),
+					   DMA_MEM_TO_DEV, NULL);
+	if (ret) {
+		dev_err(dev, "DMA submit failed\n");
+		goto out_terminate;
+	}
+
+	/* RX request on every byte, TX request while the FIFO is half empty */
+	writel(lpi2c_imx->txfifosize >> 1, lpi2c_imx->base + LPI2C_MFCR);
+
+	dma_async_issue_pending(chan);
+	if (read)
+		dma_async_issue_pending(lpi2c_imx->chan_tx);
+
+	writel(read ? MDER_RDDE | MDER_TDDE : MDER_TDDE,
+	       lpi2c_imx->base + LPI2C_MDER);
+	lpi2c_imx_intctrl(lpi2c_imx, MIER_NDIE);
+
+	/* 9 clocks per byte, twice over for clock stretching */
+	timeout = DIV_ROUND_UP(msgs->len * 9 * 2 * MSEC_PER_SEC,
+			       lpi2c_imx->bitrate) + LPI2C_DMA_TIMEOUT;
+	timeout = wait_for_completion_timeout(&lpi2c_imx->complete,
+					      msecs_to_jiffies(timeout));
+
+	lpi2c_imx_intctrl(lpi2c_imx, 0);
+	writel(0, lpi2c_imx->base + LPI2C_MDER);
+
+	if (!timeout) {
+		dev_dbg(dev, "DMA transfer timeout\n");
+		ret = -ETIMEDOUT;
+	} else if (readl(lpi2c_imx->base + LPI2C_MSR) & MSR_NDF) {
+		ret = -EIO;
+	}
+
+out_terminate:
+	if (ret) {
+		dmaengine_terminate_all(chan);
+		if (read)
+			dmaengine_terminate_all(lpi2c_imx->chan_tx);
+	}
+	dma_unmap_single(chan_dev, dma_buf, msgs->len, data_dir);
+out_unmap_cmd:
+	if (read)
+		dma_unmap_single(tx_dev, cmd_dma, cmd_num * sizeof(*cmd_buf),
+				 DMA_TO_DEVICE);
+out_free:
+	kfree(cmd_buf);
+
+	return ret;
+}
+
 static int lpi2c_imx_xfer(struct i2c_adapter *adapter,
 			  struct i2c_msg *msgs, int num)
 {
@@ -479,14 +672,20 @@ static int lpi2c_imx_xfer(struct i2c_adapter *adapter,
 		lpi2c_imx->msglen = msgs[i].len;
 		init_completion(&lpi2c_imx->complete);
 
-		if (msgs[i].flags & I2C_M_RD)
-			lpi2c_imx_read(lpi2c_imx, &msgs[i]);
-		else
-			lpi2c_imx_write(lpi2c_imx, &msgs[i]);
+		if (lpi2c_imx_can_dma(lpi2c_imx, &msgs[i])) {
+			result = lpi2c_imx_dma_xfer(lpi2c_imx, &msgs[i]);
+			if (result)
+				goto stop;
+		} else {
+			if (msgs[i].flags & I2C_M_RD)
+				lpi2c_imx_read(lpi2c_imx, &msgs[i]);
+			else
+				lpi2c_imx_write(lpi2c_imx, &msgs[i]);
 
-		result = lpi2c_imx_msg_complete(lpi2c_imx);
-		if (result)
-			goto stop;
+			result = lpi2c_imx_msg_complete(lpi2c_imx);
+			if (result)
+				goto stop;
+		}
 
 		if (!(msgs[i].flags & I2C_M_RD)) {
 			result = lpi2c_imx_txfifo_empty(lpi2c_imx);
@@ -545,6 +744,59 @@ static struct i2c_algorithm lpi2c_imx_algo = {
 	.functionality	= lpi2c_imx_func,
 };
 
+static void lpi2c_imx_dma_request(struct lpi2c_imx_struct *lpi2c_imx,
+				  struct device *dev)
+{
+	int ret;
+
+	lpi2c_imx->chan_tx = dma_request_slave_channel(dev, "tx");
+	if (!lpi2c_imx->chan_tx) {
+		dev_dbg(dev, "can't request DMA tx channel\n");
+		goto fail;
+	}
+
+	lpi2c_imx->chan_rx = dma_request_slave_channel(dev, "rx");
+	if (!lpi2c_imx->chan_rx) {
+		dev_dbg(dev, "can't request DMA rx channel\n");
+		goto fail_tx;
+	}
+
+	ret = lpi2c_imx_dma_config(lpi2c_imx->chan_rx,
+				   lpi2c_imx->phy_addr + LPI2C_MRDR,
+				   DMA_DEV_TO_MEM, DMA_SLAVE_BUSWIDTH_1_BYTE);
+	if (ret) {
+		dev_dbg(dev, "can't configure rx channel\n");
+		goto fail_rx;
+	}
+
+	dev_info(dev, "using %s (tx) and %s (rx) for DMA transfers\n",
+		 dma_chan_name(lpi2c_imx->chan_tx),
+		 dma_chan_name(lpi2c_imx->chan_rx));
+
+	return;
+
+fail_rx:
+	dma_release_channel(lpi2c_imx->chan_rx);
+	lpi2c_imx->chan_rx = NULL;
+fail_tx:
+	dma_release_channel(lpi2c_imx->chan_tx);
+	lpi2c_imx->chan_tx = NULL;
+fail:
+	dev_info(dev, "can't use DMA, using PIO instead.\n");
+}
+
+static void lpi2c_imx_dma_free(struct lpi2c_imx_struct *lpi2c_imx)
+{
+	if (!lpi2c_imx->chan_tx)
+		return;
+
+	dma_release_channel(lpi2c_imx->chan_tx);
+	lpi2c_imx->chan_tx = NULL;
+
+	dma_release_channel(lpi2c_imx->chan_rx);
+	lpi2c_imx->chan_rx = NULL;
+}
+
 static const struct of_device_id lpi2c_imx_of_match[] = {
 	{ .compatible = "fsl,imx7ulp-lpi2c" },
 	{ },
@@ -555,6 +807,7 @@ static int lpi2c_imx_probe(struct platform_device *pdev)
 {
 	struct lpi2c_imx_struct *lpi2c_imx;
 	struct resource *res;
+	unsigned int temp;
 	int irq, ret;
 
 	lpi2c_imx = devm_kzalloc(&pdev->dev, sizeof(*lpi2c_imx), GFP_KERNEL);
@@ -565,6 +818,7 @@ static int lpi2c_imx_probe(struct platform_device *pdev)
 	lpi2c_imx->base = devm_ioremap_resource(&pdev->dev, res);
 	if (IS_ERR(lpi2c_imx->base))
 		return PTR_ERR(lpi2c_imx->base);
+	lpi2c_imx->phy_addr = res->start;
 
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0) {
@@ -600,21 +854,30 @@ static int lpi2c_imx_probe(struct platform_device *pdev)
 	i2c_set_adapdata(&lpi2c_imx->adapter, lpi2c_imx);
 	platform_set_drvdata(pdev, lpi2c_imx);
 
-	ret = clk_prepare(lpi2c_imx->clk);
+	ret = clk_prepare_enable(lpi2c_imx->clk);
 	if (ret) {
 		dev_err(&pdev->dev, "clk prepare failed %d\n", ret);
 		return ret;
 	}
 
+	/* MTXFIFO and MRXFIFO hold log2 of the FIFO depths */
+	temp = readl(lpi2c_imx->base + LPI2C_PARAM);
+	lpi2c_imx->txfifosize = 1 << (temp & 0x0f);
+	lpi2c_imx->rxfifosize = 1 << ((temp >> 8) & 0x0f);
+	clk_disable(lpi2c_imx->clk);
+
+	lpi2c_imx_dma_request(lpi2c_imx, &pdev->dev);
+
 	ret = i2c_add_adapter(&lpi2c_imx->adapter);
 	if (ret)
-		goto clk_unprepare;
+		goto dma_free;
 
 	dev_info(&lpi2c_imx->adapter.dev, "LPI2C adapter registered\n");
 
 	return 0;
 
-clk_unprepare:
+dma_free:
+	lpi2c_imx_dma_free(lpi2c_imx);
 	clk_unprepare(lpi2c_imx->clk);
 
 	return ret;
@@ -626,6 +889,7 @@ static int lpi2c_imx_remove(struct platform_device *pdev)
 
 	i2c_del_adapter(&lpi2c_imx->adapter);
 
+	lpi2c_imx_dma_free(lpi2c_imx);
 	clk_unprepare(lpi2c_imx->clk);
 
 	return 0;
@@ -20,8 +20,12 @@
 #include <linux/regulator/consumer.h>
 
 #include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
 #include <linux/iio/driver.h>
 #include <linux/iio/sysfs.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 
 /* ADC register */
 #define IMX7D_REG_ADC_CH_A_CFG1			0x00
@@ -57,6 +61,7 @@
 #define IMX7D_REG_ADC_CH_CFG2_AVG_NUM_8				(0x1 << 12)
 #define IMX7D_REG_ADC_CH_CFG2_AVG_NUM_16			(0x2 << 12)
 #define IMX7D_REG_ADC_CH_CFG2_AVG_NUM_32			(0x3 << 12)
+#define IMX7D_REG_ADC_CH_CFG2_AVG_NUM_MASK			(0x3 << 12)
 
 #define IMX7D_REG_ADC_TIMER_UNIT_PRE_DIV_4			(0x0 << 29)
 #define IMX7D_REG_ADC_TIMER_UNIT_PRE_DIV_8			(0x1 << 29)
@@ -122,6 +127,8 @@ struct imx7d_adc {
 	struct imx7d_adc_feature adc_feature;
 
 	struct completion completion;
+	/* 16 channels plus the aligned timestamp */
+	u16 buffer[20];
 };
 
 struct imx7d_adc_analogue_core_clk {
@@ -149,7 +156,14 @@ static const struct imx7d_adc_analogue_core_clk imx7d_adc_analogue_clk[] = {
 	.channel = (_idx),					\
 	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),		\
 	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE) |	\
-				BIT(IIO_CHAN_INFO_SAMP_FREQ),	\
+				BIT(IIO_CHAN_INFO_SAMP_FREQ) |	\
+				BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO), \
+	.scan_index = (_idx),					\
+	.scan_type = {						\
+		.sign = 'u',					\
+		.realbits = 12,					\
+		.storagebits = 16,				\
+	},							\
 }
 
 static const struct iio_chan_spec imx7d_adc_iio_channels[] = {
@@ -169,6 +183,7 @@ static const struct iio_chan_spec imx7d_adc_iio_channels[] = {
 	IMX7D_ADC_CHAN(13),
 	IMX7D_ADC_CHAN(14),
 	IMX7D_ADC_CHAN(15),
+	IIO_CHAN_SOFT_TIMESTAMP(16),
 };
 
 static const u32 imx7d_adc_average_num[] = {
@@ -263,6 +278,7 @@ static void imx7d_adc_channel_set(struct imx7d_adc *info)
 	cfg2 = readl(info->regs + IMX7D_EACH_CHANNEL_REG_OFFSET * channel +
 		     IMX7D_REG_ADC_CHANNEL_CFG2_BASE);
 
+	cfg2 &= ~IMX7D_REG_ADC_CH_CFG2_AVG_NUM_MASK;
 	cfg2 |= imx7d_adc_average_num[info->adc_feature.avg_num];
 
 	/*
@@ -302,6 +318,11 @@ static int imx7d_adc_read_raw(struct iio_dev *indio_dev,
 	switch (mask) {
 	case IIO_CHAN_INFO_RAW:
 		mutex_lock(&indio_dev->mlock);
+		if (iio_buffer_enabled(indio_dev)) {
+			mutex_unlock(&indio_dev->mlock);
+			return -EBUSY;
+		}
+
 		reinit_completion(&info->completion);
 
 		channel = chan->channel & 0x03;
@@ -333,6 +354,49 @@ static int imx7d_adc_read_raw(struct iio_dev *indio_dev,
 		*val = imx7d_adc_get_sample_rate(info);
 		return IIO_VAL_INT;
 
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		if (info->adc_feature.average_en)
+			*val = 4 << info->adc_feature.avg_num;
+		else
+			*val = 1;
+		return IIO_VAL_INT;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+static int imx7d_adc_write_raw(struct iio_dev *indio_dev,
+			struct iio_chan_spec const *chan,
+			int val,
+			int val2,
+			long mask)
+{
+	struct imx7d_adc *info = iio_priv(indio_dev);
+	int ret = 0;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		/* applied by imx7d_adc_channel_set() on the next conversion */
+		mutex_lock(&indio_dev->mlock);
+		switch (val) {
+		case 1:
+			info->adc_feature.average_en = false;
+			break;
+		case 4:
+		case 8:
+		case 16:
+		case 32:
+			info->adc_feature.avg_num = ilog2(val) - 2;
+			info->adc_feature.average_en = true;
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+		mutex_unlock(&indio_dev->mlock);
+		return ret;
+
 	default:
 		return -EINVAL;
 	}
@@ -397,6 +461,40 @@ static irqreturn_t imx7d_adc_isr(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+static irqreturn_t imx7d_adc_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct imx7d_adc *info = iio_priv(indio_dev);
+	int i, j = 0;
+	long ret;
+
+	/* one conversion per enabled channel, each completes in the isr */
+	for_each_set_bit(i, indio_dev->active_scan_mask,
+			 indio_dev->masklength) {
+		reinit_completion(&info->completion);
+
+		info->channel = indio_dev->channels[i].channel & 0x03;
+		imx7d_adc_channel_set(info);
+
+		ret = wait_for_completion_timeout(&info->completion,
+						  IMX7D_ADC_TIMEOUT);
+		if (!ret) {
+			dev_err(info->dev, "conversion timed out\n");
+			goto out;
+		}
+
+		info->buffer[j++] = info->value;
+	}
+
+	iio_push_to_buffers_with_timestamp(indio_dev, info->buffer,
+					   pf->timestamp);
+out:
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
 static int imx7d_adc_reg_access(struct iio_dev *indio_dev,
 			unsigned reg, unsigned writeval,
 			unsigned *readval)
@@ -414,6 +512,7 @@ static int imx7d_adc_reg_access(struct iio_dev *indio_dev,
 static const struct iio_info imx7d_adc_iio_info = {
 	.driver_module = THIS_MODULE,
 	.read_raw = &imx7d_adc_read_raw,
+	.write_raw = &imx7d_adc_write_raw,
 	.debugfs_reg_access = &imx7d_adc_reg_access,
 };
 
@@ -518,15 +617,25 @@ static int imx7d_adc_probe(struct platform_device *pdev)
 	imx7d_adc_feature_config(info);
 	imx7d_adc_hw_init(info);
 
+	ret = iio_triggered_buffer_setup(indio_dev, &iio_pollfunc_store_time,
+					 &imx7d_adc_trigger_handler, NULL);
+	if (ret < 0) {
+		imx7d_adc_power_down(info);
+		dev_err(&pdev->dev, "Couldn't initialise the buffer\n");
+		goto error_iio_device_register;
+	}
+
 	ret = iio_device_register(indio_dev);
 	if (ret) {
 		imx7d_adc_power_down(info);
 		dev_err(&pdev->dev, "Couldn't register the device.\n");
-		goto error_iio_device_register;
+		goto error_adc_buffer_init;
 	}
 
 	return 0;
 
+error_adc_buffer_init:
+	iio_triggered_buffer_cleanup(indio_dev);
 error_iio_device_register:
 	clk_disable_unprepare(info->clk);
 error_adc_clk_enable:
@@ -541,6 +650,7 @@ static int imx7d_adc_remove(struct platform_device *pdev)
 	struct imx7d_adc *info = iio_priv(indio_dev);
 
 	iio_device_unregister(indio_dev);
+	iio_triggered_buffer_cleanup(indio_dev);
 
 	imx7d_adc_power_down(info);
 
@@ -27,6 +27,8 @@
 #include <linux/io.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
 #include <linux/of.h>
 #include <linux/of_irq.h>
 #include <linux/regulator/consumer.h>
@@ -106,6 +108,11 @@
 
 #define DEFAULT_SAMPLE_TIME		1000
 
+/* ring of R0 reads, one callback per period */
+#define VF610_ADC_DMA_BUFFER_SZ		(4 * PAGE_SIZE)
+#define VF610_ADC_DMA_PERIOD_SZ		(VF610_ADC_DMA_BUFFER_SZ / 4)
+#define VF610_ADC_DMA_SAMPLES		(VF610_ADC_DMA_BUFFER_SZ / sizeof(u32))
+
 /* V at 25°C of 696 mV */
 #define VF610_VTEMP25_3V0		950
 /* V at 25°C of 699 mV */
@@ -181,6 +188,15 @@ struct vf610_adc {
 
 	struct completion completion;
 	u16 buffer[8];
+
+	/* continuous sampling into the buffer without a trigger */
+	struct dma_chan *dma_chan;
+	u32 *rx_buf;
+	dma_addr_t rx_dma_buf;
+	dma_cookie_t cookie;
+	unsigned int buf_pos;
+	bool dma_residue;
+	resource_size_t regs_phys;
 };
 
 static const u32 vf610_hw_avgs[] = { 1, 4, 8, 16, 32 };
@@ -515,7 +531,8 @@ static const struct iio_chan_spec_ext_info vf610_ext_info[] = {
 	.channel = (_idx),					\
 	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),		\
 	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE) |	\
-				BIT(IIO_CHAN_INFO_SAMP_FREQ),	\
+				BIT(IIO_CHAN_INFO_SAMP_FREQ) |	\
+				BIT(IIO_CHAN_INFO_OVERSAMPLING_RATIO), \
 	.ext_info = vf610_ext_info,				\
 	.scan_index = (_idx),			\
 	.scan_type = {					\
@@ -698,6 +715,10 @@ static int vf610_read_raw(struct iio_dev *indio_dev,
 		*val2 = 0;
 		return IIO_VAL_INT;
 
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		*val = vf610_hw_avgs[info->adc_feature.sample_rate];
+		return IIO_VAL_INT;
+
 	default:
 		break;
 	}
@@ -726,6 +747,16 @@ static int vf610_write_raw(struct iio_dev *indio_dev,
 			}
 		break;
 
+	case IIO_CHAN_INFO_OVERSAMPLING_RATIO:
+		/* the hardware averaging behind sampling_frequency */
+		for (i = 0; i < ARRAY_SIZE(vf610_hw_avgs); i++)
+			if (val == vf610_hw_avgs[i]) {
+				info->adc_feature.sample_rate = i;
+				vf610_adc_sample_set(info);
+				return 0;
+			}
+		break;
+
 	default:
 		break;
 	}
@@ -733,26 +764,138 @@ static int vf610_write_raw(struct iio_dev *indio_dev,
 	return -EINVAL;
 }
 
+static void vf610_adc_dma_callback(void *data)
+{
+	struct iio_dev *indio_dev = data;
+	struct vf610_adc *info = iio_priv(indio_dev);
+	u32 mask = BIT(info->adc_feature.res_mode) - 1;
+	struct dma_tx_state state;
+	unsigned int pos;
+	s64 timestamp;
+
+	timestamp = iio_get_time_ns(indio_dev);
+
+	if (info->dma_residue) {
+		dmaengine_tx_status(info->dma_chan, info->cookie, &state);
+		pos = (VF610_ADC_DMA_BUFFER_SZ - state.residue) / sizeof(u32);
+	} else {
+		pos = info->buf_pos + VF610_ADC_DMA_PERIOD_SZ / sizeof(u32);
+	}
+	pos %= VF610_ADC_DMA_SAMPLES;
+
+	/* one timestamp per period, the rate is fixed by the hardware */
+	while (info->buf_pos != pos) {
+		info->buffer[0] = info->rx_buf[info->buf_pos] & mask;
+		iio_push_to_buffers_with_timestamp(indio_dev, info->buffer,
+						   timestamp);
+		info->buf_pos = (info->buf_pos + 1) % VF610_ADC_DMA_SAMPLES;
+	}
+}
+
+static int vf610_adc_dma_start(struct iio_dev *indio_dev)
+{
+	struct vf610_adc *info = iio_priv(indio_dev);
+	struct dma_async_tx_descriptor *desc;
+	int ret;
+
+	info->buf_pos = 0;
+
+	desc = dmaengine_prep_dma_cyclic(info->dma_chan, info->rx_dma_buf,
+					 VF610_ADC_DMA_BUFFER_SZ,
+					 VF610_ADC_DMA_PERIOD_SZ,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	desc->callback = vf610_adc_dma_callback;
+	desc->callback_param = indio_dev;
+
+	info->cookie = dmaengine_submit(desc);
+	ret = dma_submit_error(info->cookie);
+	if (ret) {
+		dmaengine_terminate_async(info->dma_chan);
+		return ret;
+	}
+
+	dma_async_issue_pending(info->dma_chan);
+
+	return 0;
+}
+
+static int vf610_adc_dma_init(struct vf610_adc *info)
+{
+	struct dma_slave_config config = {
+		.direction = DMA_DEV_TO_MEM,
+		.src_addr = info->regs_phys + VF610_REG_ADC_R0,
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES,
+		.src_maxburst = 1,
+	};
+	struct dma_slave_caps caps;
+	int ret;
+
+	ret = dmaengine_slave_config(info->dma_chan, &config);
+	if (ret)
+		return ret;
+
+	if (!dma_get_slave_caps(info->dma_chan, &caps))
+		info->dma_residue = caps.residue_granularity !=
+				    DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+
+	info->rx_buf = dma_alloc_coherent(info->dev, VF610_ADC_DMA_BUFFER_SZ,
+					  &info->rx_dma_buf, GFP_KERNEL);
+	if (!info->rx_buf)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void vf610_adc_dma_free(struct vf610_adc *info)
+{
+	if (!info->dma_chan)
+		return;
+
+	if (info->rx_buf)
+		dma_free_coherent(info->dev, VF610_ADC_DMA_BUFFER_SZ,
+				  info->rx_buf, info->rx_dma_buf);
+	dma_release_channel(info->dma_chan);
+	info->dma_chan = NULL;
+}
+
+static bool vf610_adc_use_dma(struct iio_dev *indio_dev)
+{
+	struct vf610_adc *info = iio_priv(indio_dev);
+
+	return info->dma_chan &&
+	       indio_dev->currentmode == INDIO_BUFFER_SOFTWARE;
+}
+
 static int vf610_adc_buffer_postenable(struct iio_dev *indio_dev)
 {
 	struct vf610_adc *info = iio_priv(indio_dev);
+	bool dma = vf610_adc_use_dma(indio_dev);
 	unsigned int channel;
 	int ret;
 	int val;
 
-	ret = iio_triggered_buffer_postenable(indio_dev);
+	if (dma)
+		ret = vf610_adc_dma_start(indio_dev);
+	else
+		ret = iio_triggered_buffer_postenable(indio_dev);
 	if (ret)
 		return ret;
 
 	val = readl(info->regs + VF610_REG_ADC_GC);
 	val |= VF610_ADC_ADCON;
+	if (dma)
+		val |= VF610_ADC_DMAEN;
 	writel(val, info->regs + VF610_REG_ADC_GC);
 
 	channel = find_first_bit(indio_dev->active_scan_mask,
 						indio_dev->masklength);
 
 	val = VF610_ADC_ADCHC(channel);
-	val |= VF610_ADC_AIEN;
+	if (!dma)
+		val |= VF610_ADC_AIEN;
 
 	writel(val, info->regs + VF610_REG_ADC_HC0);
 
@@ -766,7 +909,7 @@ static int vf610_adc_buffer_predisable(struct iio_dev *indio_dev)
 	int val;
 
 	val = readl(info->regs + VF610_REG_ADC_GC);
-	val &= ~VF610_ADC_ADCON;
+	val &= ~(VF610_ADC_ADCON | VF610_ADC_DMAEN);
 	writel(val, info->regs + VF610_REG_ADC_GC);
 
 	hc_cfg |= VF610_ADC_CONV_DISABLE;
@@ -774,6 +917,11 @@ static int vf610_adc_buffer_predisable(struct iio_dev *indio_dev)
 
 	writel(hc_cfg, info->regs + VF610_REG_ADC_HC0);
 
+	if (vf610_adc_use_dma(indio_dev)) {
+		dmaengine_terminate_sync(info->dma_chan);
+		return 0;
+	}
+
 	return iio_triggered_buffer_predisable(indio_dev);
 }
 
@@ -846,6 +994,7 @@ static int vf610_adc_probe(struct platform_device *pdev)
 	info->regs = devm_ioremap_resource(&pdev->dev, mem);
 	if (IS_ERR(info->regs))
 		return PTR_ERR(info->regs);
+	info->regs_phys = mem->start;
 
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0) {
@@ -950,6 +1099,18 @@ static int vf610_adc_probe(struct platform_device *pdev)
 		goto error_iio_device_register;
 	}
 
+	/* without a trigger the buffer is filled by DMA, if there is one */
+	info->dma_chan = dma_request_slave_channel(&pdev->dev, "rx");
+	if (info->dma_chan) {
+		ret = vf610_adc_dma_init(info);
+		if (ret) {
+			dev_warn(&pdev->dev, "DMA init failed, using irq\n");
+			vf610_adc_dma_free(info);
+		} else {
+			indio_dev->modes |= INDIO_BUFFER_SOFTWARE;
+		}
+	}
+
 	ret = iio_device_register(indio_dev);
 	if (ret) {
 		dev_err(&pdev->dev, "Couldn't register the device.\n");
@@ -959,6 +1120,7 @@ static int vf610_adc_probe(struct platform_device *pdev)
 	return 0;
 
 error_adc_buffer_init:
+	vf610_adc_dma_free(info);
 	iio_triggered_buffer_cleanup(indio_dev);
 error_iio_device_register:
 	clk_disable_unprepare(info->clk);
@@ -974,6 +1136,7 @@ static int vf610_adc_remove(struct platform_device *pdev)
 	struct vf610_adc *info = iio_priv(indio_dev);
 
 	iio_device_unregister(indio_dev);
+	vf610_adc_dma_free(info);
 	iio_triggered_buffer_cleanup(indio_dev);
 	regulator_disable(info->vref);
 	clk_disable_unprepare(info->clk);
@@ -13,6 +13,8 @@
 #include <linux/module.h>
 #include <linux/gpio/consumer.h>
 #include <linux/input.h>
+#include <linux/input/mt.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
@@ -32,6 +34,9 @@
 #define ADC_CLK_DIV_8		(0x03 << 5)
 #define ADC_SHORT_SAMPLE_MODE	(0x0 << 4)
 #define ADC_HARDWARE_TRIGGER	(0x1 << 13)
+#define ADC_AVGE		(0x1 << 5)
+#define ADC_AVGS_MASK		(0x3 << 14)
+#define ADC_AVGS_SHIFT		14
 #define SELECT_CHANNEL_4	0x04
 #define SELECT_CHANNEL_1	0x01
 #define DISABLE_CONVERSION_INT	(0x0 << 7)
@@ -70,7 +75,9 @@
 #define MEASURE_INT_EN		0x1
 #define MEASURE_SIG_EN		0x1
 #define VALID_SIG_EN		(0x1 << 8)
-#define DE_GLITCH_2		(0x2 << 29)
+#define DE_GLITCH_SHIFT		29
+#define DE_GLITCH_DEF		0x2
+#define DE_GLITCH_MAX		0x3
 #define START_SENSE		(0x1 << 12)
 #define TSC_DISABLE		(0x1 << 16)
 #define DETECT_MODE		0x2
@@ -86,6 +93,9 @@ struct imx6ul_tsc {
 
 	int measure_delay_time;
 	int pre_charge_time;
+	bool average_enable;
+	u32 average_select;
+	u32 de_glitch;
 
 	struct completion completion;
 };
@@ -108,6 +118,9 @@ static int imx6ul_adc_init(struct imx6ul_tsc *tsc)
 	adc_cfg |= ADC_12BIT_MODE | ADC_IPG_CLK;
 	adc_cfg |= ADC_CLK_DIV_8 | ADC_SHORT_SAMPLE_MODE;
 	adc_cfg &= ~ADC_HARDWARE_TRIGGER;
+	adc_cfg &= ~ADC_AVGS_MASK;
+	if (tsc->average_enable)
+		adc_cfg |= tsc->average_select << ADC_AVGS_SHIFT;
 	writel(adc_cfg, tsc->adc_regs + REG_ADC_CFG);
 
 	/* enable calibration interrupt */
@@ -118,6 +131,11 @@ static int imx6ul_adc_init(struct imx6ul_tsc *tsc)
 	/* start ADC calibration */
 	adc_gc = readl(tsc->adc_regs + REG_ADC_GC);
 	adc_gc |= ADC_CAL;
+	/* every measurement is averaged in hardware, no extra interrupts */
+	if (tsc->average_enable)
+		adc_gc |= ADC_AVGE;
+	else
+		adc_gc &= ~ADC_AVGE;
 	writel(adc_gc, tsc->adc_regs + REG_ADC_GC);
 
 	timeout = wait_for_completion_timeout
@@ -180,7 +198,8 @@ static void imx6ul_tsc_set(struct imx6ul_tsc *tsc)
 	basic_setting |= DETECT_4_WIRE_MODE | AUTO_MEASURE;
 	writel(basic_setting, tsc->tsc_regs + REG_TSC_BASIC_SETING);
 
-	writel(DE_GLITCH_2, tsc->tsc_regs + REG_TSC_DEBUG_MODE2);
+	writel(tsc->de_glitch << DE_GLITCH_SHIFT,
+	       tsc->tsc_regs + REG_TSC_DEBUG_MODE2);
 
 	writel(tsc->pre_charge_time, tsc->tsc_regs + REG_TSC_PRE_CHARGE_TIME);
 	writel(MEASURE_INT_EN, tsc->tsc_regs + REG_TSC_INT_EN);
@@ -230,11 +249,12 @@ static bool tsc_wait_detect_mode(struct imx6ul_tsc *tsc)
 	int state_machine;
 	int debug_mode2;
 
+	/* poll finely, this sits between every sample and its report */
 	do {
 		if (time_after(jiffies, timeout))
 			return false;
 
-		usleep_range(200, 400);
+		usleep_range(50, 100);
 		debug_mode2 = readl(tsc->tsc_regs + REG_TSC_DEBUG_MODE2);
 		state_machine = (debug_mode2 >> 20) & 0x7;
 	} while (state_machine != DETECT_MODE);
@@ -271,15 +291,19 @@ static irqreturn_t tsc_irq_fn(int irq, void *dev_id)
 		 * In detect mode, we can get the xnur gpio value,
 		 * otherwise assume contact is stiull active.
 		 */
+		input_mt_slot(tsc->input, 0);
 		if (!tsc_wait_detect_mode(tsc) ||
 		    gpiod_get_value_cansleep(tsc->xnur_gpio)) {
-			input_report_key(tsc->input, BTN_TOUCH, 1);
-			input_report_abs(tsc->input, ABS_X, x);
-			input_report_abs(tsc->input, ABS_Y, y);
+			input_mt_report_slot_state(tsc->input,
+						   MT_TOOL_FINGER, true);
+			input_report_abs(tsc->input, ABS_MT_POSITION_X, x);
+			input_report_abs(tsc->input, ABS_MT_POSITION_Y, y);
 		} else {
-			input_report_key(tsc->input, BTN_TOUCH, 0);
+			input_mt_report_slot_state(tsc->input,
+						   MT_TOOL_FINGER, false);
 		}
 
+		input_mt_sync_frame(tsc->input);
 		input_sync(tsc->input);
 	}
 
@@ -343,6 +367,7 @@ static int imx6ul_tsc_probe(struct platform_device *pdev)
 	struct input_dev *input_dev;
 	struct resource *tsc_mem;
 	struct resource *adc_mem;
+	u32 average_samples;
 	int err;
 	int tsc_irq;
 	int adc_irq;
@@ -361,9 +386,13 @@ static int imx6ul_tsc_probe(struct platform_device *pdev)
 	input_dev->open = imx6ul_tsc_open;
 	input_dev->close = imx6ul_tsc_close;
 
-	input_set_capability(input_dev, EV_KEY, BTN_TOUCH);
-	input_set_abs_params(input_dev, ABS_X, 0, 0xFFF, 0, 0);
-	input_set_abs_params(input_dev, ABS_Y, 0, 0xFFF, 0, 0);
+	input_set_abs_params(input_dev, ABS_MT_POSITION_X, 0, 0xFFF, 0, 0);
+	input_set_abs_params(input_dev, ABS_MT_POSITION_Y, 0, 0xFFF, 0, 0);
+
+	/* BTN_TOUCH, ABS_X and ABS_Y come from the pointer emulation */
+	err = input_mt_init_slots(input_dev, 1, INPUT_MT_DIRECT);
+	if (err)
+		return err;
 
 	input_set_drvdata(input_dev, tsc);
 
@@ -450,6 +479,34 @@ static int imx6ul_tsc_probe(struct platform_device *pdev)
 	if (err)
 		tsc->pre_charge_time = 0xfff;
 
+	err = of_property_read_u32(np, "touchscreen-average-samples",
+				   &average_samples);
+	if (err)
+		average_samples = 1;
+
+	switch (average_samples) {
+	case 1:
+		tsc->average_enable = false;
+		tsc->average_select = 0;
+		break;
+	case 4:
+	case 8:
+	case 16:
+	case 32:
+		tsc->average_enable = true;
+		tsc->average_select = ilog2(average_samples) - 2;
+		break;
+	default:
+		dev_err(&pdev->dev,
+			"touchscreen-average-samples (%u) must be 1, 4, 8, 16 or 32\n",
+			average_samples);
+		return -EINVAL;
+	}
+
+	err = of_property_read_u32(np, "fsl,de-glitch", &tsc->de_glitch);
+	if (err || tsc->de_glitch > DE_GLITCH_MAX)
+		tsc->de_glitch = DE_GLITCH_DEF;
+
 	err = input_register_device(tsc->input);
 	if (err) {
 		dev_err(&pdev->dev,
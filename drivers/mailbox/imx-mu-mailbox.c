@@ -0,0 +1,529 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Mailbox controller for the Messaging Unit shared with the Cortex-M4.
+ *
+ * The MU has four transmit/receive register pairs and four general purpose
+ * interrupts in each direction. Each register pair is a TXRX channel that
+ * carries one word per message, each general purpose interrupt is a GP
+ * doorbell channel. The MU platform device in mach-imx owns the block and
+ * keeps data channel 0 for its low power mode handshake.
+ *
+ * A channel switched to busy-poll mode masks its interrupts: the sender
+ * spins on the TE flag and the receiver pulls data with
+ * mbox_client_peek_data(), so a short exchange with the M4 takes no
+ * interrupt and no context switch in either direction.
+ *
+ * Doorbells rung in interrupt mode are latched and written out by a
+ * tasklet, so a burst of them costs one ACR write and one interrupt on
+ * the M4. Ringing a doorbell the M4 has not acknowledged yet is merged
+ * into the pending request by the hardware.
+ */
+
+#include <linux/bitops.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/imx_mu.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/iopoll.h>
+#include <linux/kernel.h>
+#include <linux/mailbox_client.h>
+#include <linux/mailbox_controller.h>
+#include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+/* the four data channels, then the four doorbells */
+#define IMX_MU_CHANS		(MU_TR_COUNT * 2)
+/* how long a polling sender waits for the M4 to read the last word */
+#define IMX_MU_POLL_TIMEOUT_US	10
+
+struct imx_mu_chan {
+	unsigned int type;
+	unsigned int idx;
+	bool poll;
+};
+
+struct imx_mu_mbox {
+	struct mbox_controller mbox;
+	void __iomem *base;
+	u32 tr;
+	u32 rr;
+	u32 sr;
+	u32 cr;
+	/* serializes the ACR updates and the receive register reads */
+	spinlock_t lock;
+	/* ACR enable bits of the bound channels */
+	u32 owned;
+	/* RIE and GIE bits to restore on resume, channels in interrupt mode */
+	u32 ier;
+	/* GIR bits latched for the next ACR write */
+	u32 gir_pending;
+	/* channels whose last transmission completed, one bit per channel */
+	unsigned long tick;
+	struct tasklet_struct tasklet;
+	struct mbox_chan chans[IMX_MU_CHANS];
+	struct imx_mu_chan con_priv[IMX_MU_CHANS];
+};
+
+static struct imx_mu_mbox *imx_mu_mbox;
+
+static inline struct imx_mu_mbox *to_imx_mu_mbox(struct mbox_controller *mbox)
+{
+	return container_of(mbox, struct imx_mu_mbox, mbox);
+}
+
+/* The enable bits of a channel, with the status bits at the same positions */
+static u32 imx_mu_mbox_bits(struct imx_mu_chan *cp)
+{
+	if (cp->type == IMX_MU_TYPE_GP)
+		return MU_CR_GIE0_MASK1 >> cp->idx;
+
+	return (MU_CR_RIE0_MASK1 | MU_CR_TIE0_MASK1) >> cp->idx;
+}
+
+static u32 imx_mu_mbox_rx_bit(struct imx_mu_chan *cp)
+{
+	if (cp->type == IMX_MU_TYPE_GP)
+		return MU_CR_GIE0_MASK1 >> cp->idx;
+
+	return MU_CR_RIE0_MASK1 >> cp->idx;
+}
+
+/*
+ * GIRn read back as set while the M4 has not acknowledged them yet, write
+ * them back and it would see the request a second time. Call with the lock.
+ */
+static void imx_mu_mbox_update_cr(struct imx_mu_mbox *mu, u32 set, u32 clr)
+{
+	u32 cr = readl_relaxed(mu->base + mu->cr);
+
+	cr &= ~(MU_CR_GIRn_MASK1 | MU_CR_NMI_MASK1 | clr);
+	writel_relaxed(cr | set, mu->base + mu->cr);
+}
+
+/* Takes a received word, or acknowledges a doorbell, if one is there */
+static bool imx_mu_mbox_fetch(struct imx_mu_mbox *mu, struct imx_mu_chan *cp,
+			      u32 *val)
+{
+	unsigned long flags;
+	bool ret = false;
+	u32 sr;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	sr = readl_relaxed(mu->base + mu->sr);
+	if (cp->type == IMX_MU_TYPE_GP) {
+		if (sr & (MU_SR_GIP0_MASK1 >> cp->idx)) {
+			/* GIPn are write one to clear */
+			writel_relaxed(MU_SR_GIP0_MASK1 >> cp->idx,
+				       mu->base + mu->sr);
+			ret = true;
+		}
+	} else if (sr & (MU_SR_RF0_MASK1 >> cp->idx)) {
+		*val = readl_relaxed(mu->base + mu->rr + cp->idx * 4);
+		ret = true;
+	}
+	spin_unlock_irqrestore(&mu->lock, flags);
+
+	return ret;
+}
+
+static void imx_mu_mbox_tasklet(unsigned long data)
+{
+	struct imx_mu_mbox *mu = (struct imx_mu_mbox *)data;
+	unsigned long flags, tick;
+	int i;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	if (mu->gir_pending) {
+		imx_mu_mbox_update_cr(mu, mu->gir_pending, 0);
+		mu->gir_pending = 0;
+	}
+	tick = mu->tick;
+	mu->tick = 0;
+	spin_unlock_irqrestore(&mu->lock, flags);
+
+	for_each_set_bit(i, &tick, IMX_MU_CHANS)
+		mbox_chan_txdone(&mu->chans[i], 0);
+}
+
+static irqreturn_t imx_mu_mbox_isr(int irq, void *dev_id)
+{
+	struct imx_mu_mbox *mu = dev_id;
+	irqreturn_t ret = IRQ_NONE;
+	unsigned long flags;
+	u32 pending, val;
+	int i;
+
+	pending = readl_relaxed(mu->base + mu->sr) &
+		  readl_relaxed(mu->base + mu->cr) & mu->owned;
+	if (!pending)
+		return IRQ_NONE;
+
+	for (i = 0; i < IMX_MU_CHANS; i++) {
+		struct mbox_chan *chan = &mu->chans[i];
+		struct imx_mu_chan *cp = chan->con_priv;
+		u32 bits = pending & imx_mu_mbox_bits(cp);
+
+		if (!bits)
+			continue;
+
+		ret = IRQ_HANDLED;
+
+		if ((bits & imx_mu_mbox_rx_bit(cp)) &&
+		    imx_mu_mbox_fetch(mu, cp, &val))
+			mbox_chan_received_data(chan,
+				cp->type == IMX_MU_TYPE_GP ? NULL : &val);
+
+		/* TE and TIE are at the same position */
+		if (bits & (MU_CR_TIE0_MASK1 >> cp->idx)) {
+			spin_lock_irqsave(&mu->lock, flags);
+			imx_mu_mbox_update_cr(mu, 0, bits & MU_CR_TIEn_MASK1);
+			spin_unlock_irqrestore(&mu->lock, flags);
+			mbox_chan_txdone(chan, 0);
+		}
+	}
+
+	return ret;
+}
+
+static int imx_mu_mbox_send_data(struct mbox_chan *chan, void *data)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	u32 te = MU_SR_TE0_MASK1 >> cp->idx;
+	unsigned long flags;
+	u32 sr;
+
+	if (cp->type == IMX_MU_TYPE_GP) {
+		u32 gir = MU_CR_GIR0_MASK1 >> cp->idx;
+
+		spin_lock_irqsave(&mu->lock, flags);
+		if (cp->poll)
+			imx_mu_mbox_update_cr(mu, gir, 0);
+		else
+			mu->gir_pending |= gir;
+		mu->tick |= BIT(chan - mu->chans);
+		spin_unlock_irqrestore(&mu->lock, flags);
+		tasklet_schedule(&mu->tasklet);
+		return 0;
+	}
+
+	if (cp->poll)
+		readl_poll_timeout_atomic(mu->base + mu->sr, sr, sr & te, 0,
+					  IMX_MU_POLL_TIMEOUT_US);
+	else
+		sr = readl_relaxed(mu->base + mu->sr);
+
+	spin_lock_irqsave(&mu->lock, flags);
+	if (!(sr & te)) {
+		/* the M4 still has the last word, resubmit once it takes it */
+		imx_mu_mbox_update_cr(mu, MU_CR_TIE0_MASK1 >> cp->idx, 0);
+		spin_unlock_irqrestore(&mu->lock, flags);
+		return -EBUSY;
+	}
+
+	writel_relaxed(*(u32 *)data, mu->base + mu->tr + cp->idx * 4);
+	if (cp->poll)
+		mu->tick |= BIT(chan - mu->chans);
+	else
+		imx_mu_mbox_update_cr(mu, MU_CR_TIE0_MASK1 >> cp->idx, 0);
+	spin_unlock_irqrestore(&mu->lock, flags);
+
+	if (cp->poll)
+		tasklet_schedule(&mu->tasklet);
+
+	return 0;
+}
+
+static bool imx_mu_mbox_peek_data(struct mbox_chan *chan)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	u32 val;
+
+	/* in interrupt mode the data is on its way to the client already */
+	if (!cp->poll || !imx_mu_mbox_fetch(mu, cp, &val))
+		return false;
+
+	mbox_chan_received_data(chan, cp->type == IMX_MU_TYPE_GP ? NULL : &val);
+
+	return true;
+}
+
+static int imx_mu_mbox_startup(struct mbox_chan *chan)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	cp->poll = false;
+	mu->owned |= imx_mu_mbox_bits(cp);
+	mu->ier |= imx_mu_mbox_rx_bit(cp);
+	imx_mu_mbox_update_cr(mu, imx_mu_mbox_rx_bit(cp), 0);
+	spin_unlock_irqrestore(&mu->lock, flags);
+
+	return 0;
+}
+
+static void imx_mu_mbox_shutdown(struct mbox_chan *chan)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	mu->owned &= ~imx_mu_mbox_bits(cp);
+	mu->ier &= ~imx_mu_mbox_rx_bit(cp);
+	if (cp->type == IMX_MU_TYPE_GP)
+		mu->gir_pending &= ~(MU_CR_GIR0_MASK1 >> cp->idx);
+	mu->tick &= ~BIT(chan - mu->chans);
+	imx_mu_mbox_update_cr(mu, 0, imx_mu_mbox_bits(cp));
+	spin_unlock_irqrestore(&mu->lock, flags);
+}
+
+static const struct mbox_chan_ops imx_mu_mbox_ops = {
+	.send_data = imx_mu_mbox_send_data,
+	.startup = imx_mu_mbox_startup,
+	.shutdown = imx_mu_mbox_shutdown,
+	.peek_data = imx_mu_mbox_peek_data,
+};
+
+static struct mbox_chan *imx_mu_mbox_chan(struct imx_mu_mbox *mu,
+					  unsigned int type, unsigned int idx)
+{
+	if (type > IMX_MU_TYPE_GP || idx >= MU_TR_COUNT)
+		return ERR_PTR(-EINVAL);
+
+	/* the low power mode handshake reads RR0 itself */
+	if (type == IMX_MU_TYPE_TXRX && idx == 0)
+		return ERR_PTR(-EBUSY);
+
+	return &mu->chans[type * MU_TR_COUNT + idx];
+}
+
+/* #mbox-cells = <2>: the channel type and the register or interrupt index */
+static struct mbox_chan *imx_mu_mbox_xlate(struct mbox_controller *mbox,
+					   const struct of_phandle_args *sp)
+{
+	if (sp->args_count != 2)
+		return ERR_PTR(-EINVAL);
+
+	return imx_mu_mbox_chan(to_imx_mu_mbox(mbox), sp->args[0],
+				sp->args[1]);
+}
+
+/**
+ * imx_mu_mbox_request_channel - bind a client to an MU channel
+ * @cl: the client, with its rx_callback set
+ * @type: IMX_MU_TYPE_TXRX or IMX_MU_TYPE_GP
+ * @idx: index of the register pair or of the general purpose interrupt
+ *
+ * For clients whose device tree node has no "mboxes" property. The channel
+ * starts in interrupt mode.
+ *
+ * Return: the channel, or an ERR_PTR. -EPROBE_DEFER until the MU is probed.
+ */
+struct mbox_chan *imx_mu_mbox_request_channel(struct mbox_client *cl,
+					      unsigned int type,
+					      unsigned int idx)
+{
+	struct imx_mu_mbox *mu = imx_mu_mbox;
+	struct mbox_chan *chan;
+	unsigned long flags;
+	int ret;
+
+	if (!mu)
+		return ERR_PTR(-EPROBE_DEFER);
+
+	chan = imx_mu_mbox_chan(mu, type, idx);
+	if (IS_ERR(chan))
+		return chan;
+
+	if (chan->cl) {
+		dev_err(mu->mbox.dev, "channel %u.%u is busy\n", type, idx);
+		return ERR_PTR(-EBUSY);
+	}
+
+	spin_lock_irqsave(&chan->lock, flags);
+	chan->msg_free = 0;
+	chan->msg_count = 0;
+	chan->active_req = NULL;
+	chan->cl = cl;
+	init_completion(&chan->tx_complete);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	ret = imx_mu_mbox_startup(chan);
+	if (ret) {
+		imx_mu_mbox_free_channel(chan);
+		return ERR_PTR(ret);
+	}
+
+	return chan;
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_request_channel);
+
+/**
+ * imx_mu_mbox_free_channel - release a channel
+ * @chan: channel from imx_mu_mbox_request_channel()
+ */
+void imx_mu_mbox_free_channel(struct mbox_chan *chan)
+{
+	unsigned long flags;
+
+	if (!chan || !chan->cl)
+		return;
+
+	imx_mu_mbox_shutdown(chan);
+
+	spin_lock_irqsave(&chan->lock, flags);
+	chan->cl = NULL;
+	chan->active_req = NULL;
+	spin_unlock_irqrestore(&chan->lock, flags);
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_free_channel);
+
+/**
+ * imx_mu_mbox_set_poll - switch a channel between interrupts and busy-polling
+ * @chan: the channel
+ * @poll: true to mask the receive interrupt and spin on transmit
+ *
+ * In poll mode received data is only delivered from mbox_client_peek_data(),
+ * which the client calls in a loop while it expects a reply, and
+ * mbox_send_message() spins for up to IMX_MU_POLL_TIMEOUT_US on a word the
+ * M4 has not read yet before falling back to the transmit interrupt.
+ */
+void imx_mu_mbox_set_poll(struct mbox_chan *chan, bool poll)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	u32 rx = imx_mu_mbox_rx_bit(cp);
+	unsigned long flags;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	cp->poll = poll;
+	if (poll) {
+		mu->ier &= ~rx;
+		imx_mu_mbox_update_cr(mu, 0, rx);
+	} else {
+		mu->ier |= rx;
+		imx_mu_mbox_update_cr(mu, rx, 0);
+	}
+	spin_unlock_irqrestore(&mu->lock, flags);
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_set_poll);
+
+/**
+ * imx_mu_mbox_tx_pending - whether the M4 has yet to see the last message
+ * @chan: a TXRX channel
+ *
+ * True while messages are queued on the channel or the last word written
+ * is still in the transmit register, so a client can skip sending the
+ * same notification twice.
+ */
+bool imx_mu_mbox_tx_pending(struct mbox_chan *chan)
+{
+	struct imx_mu_mbox *mu = to_imx_mu_mbox(chan->mbox);
+	struct imx_mu_chan *cp = chan->con_priv;
+	u32 te = MU_SR_TE0_MASK1 >> cp->idx;
+	unsigned long flags;
+	bool ret;
+
+	/* keeps msg_submit() from moving a message to the register meanwhile */
+	spin_lock_irqsave(&chan->lock, flags);
+	ret = chan->msg_count || !(readl_relaxed(mu->base + mu->sr) & te);
+	spin_unlock_irqrestore(&chan->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_tx_pending);
+
+/**
+ * imx_mu_mbox_resume - restore the interrupt enables after a power loss
+ *
+ * For the MU owner to call from its resume handler on parts that lose the
+ * MU state in low power modes.
+ */
+void imx_mu_mbox_resume(void)
+{
+	struct imx_mu_mbox *mu = imx_mu_mbox;
+	unsigned long flags;
+
+	if (!mu)
+		return;
+
+	spin_lock_irqsave(&mu->lock, flags);
+	imx_mu_mbox_update_cr(mu, mu->ier, 0);
+	spin_unlock_irqrestore(&mu->lock, flags);
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_resume);
+
+/**
+ * imx_mu_mbox_register - register the MU as a mailbox controller
+ * @dev: the MU platform device
+ * @base: the mapped MU registers
+ * @irq: the MU interrupt on the A core side, shared with the owner
+ */
+int imx_mu_mbox_register(struct device *dev, void __iomem *base, int irq)
+{
+	struct imx_mu_mbox *mu;
+	int i, ret;
+
+	mu = devm_kzalloc(dev, sizeof(*mu), GFP_KERNEL);
+	if (!mu)
+		return -ENOMEM;
+
+	mu->base = base;
+	if ((readl_relaxed(base) >> 16) == MU_VER_ID_V10) {
+		mu->tr = MU_V10_ATR0_OFFSET1;
+		mu->rr = MU_V10_ARR0_OFFSET1;
+		mu->sr = MU_V10_ASR_OFFSET1;
+		mu->cr = MU_V10_ACR_OFFSET1;
+	} else {
+		mu->tr = MU_ATR0_OFFSET1;
+		mu->rr = MU_ARR0_OFFSET1;
+		mu->sr = MU_ASR_OFFSET1;
+		mu->cr = MU_ACR_OFFSET1;
+	}
+	spin_lock_init(&mu->lock);
+	tasklet_init(&mu->tasklet, imx_mu_mbox_tasklet, (unsigned long)mu);
+
+	for (i = 0; i < IMX_MU_CHANS; i++) {
+		mu->con_priv[i].type = i / MU_TR_COUNT;
+		mu->con_priv[i].idx = i % MU_TR_COUNT;
+		mu->chans[i].con_priv = &mu->con_priv[i];
+	}
+
+	mu->mbox.dev = dev;
+	mu->mbox.ops = &imx_mu_mbox_ops;
+	mu->mbox.chans = mu->chans;
+	mu->mbox.num_chans = IMX_MU_CHANS;
+	mu->mbox.txdone_irq = true;
+	mu->mbox.of_xlate = imx_mu_mbox_xlate;
+
+	ret = devm_request_irq(dev, irq, imx_mu_mbox_isr,
+			       IRQF_EARLY_RESUME | IRQF_SHARED, "imx-mu-mbox",
+			       mu);
+	if (ret) {
+		dev_err(dev, "failed to request mailbox irq %d: %d\n", irq,
+			ret);
+		return ret;
+	}
+
+	ret = mbox_controller_register(&mu->mbox);
+	if (ret) {
+		dev_err(dev, "failed to register mailbox: %d\n", ret);
+		return ret;
+	}
+
+	imx_mu_mbox = mu;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(imx_mu_mbox_register);
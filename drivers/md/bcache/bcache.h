@@ -337,6 +337,17 @@ struct cached_dev {
 
 	struct keybuf		writeback_keys;
 
+	/*
+	 * Writes to the backing device are issued in the order read_dirty()
+	 * picked their keys; this is the sequence number of the next one.
+	 */
+	atomic_t		writeback_sequence_next;
+	struct closure_waitlist	writeback_ordering_wait;
+
+	/* Writes to the backing device and the time they took */
+	atomic_long_t		writeback_writes;
+	atomic64_t		writeback_write_ns;
+
 	/* For tracking sequential IO */
 #define RECENT_IO_BITS	7
 #define RECENT_IO	(1 << RECENT_IO_BITS)
@@ -359,6 +370,7 @@ struct cached_dev {
 	unsigned		writeback_running:1;
 	unsigned char		writeback_percent;
 	unsigned		writeback_delay;
+	unsigned		writeback_batch_sectors;
 
 	uint64_t		writeback_rate_target;
 	int64_t			writeback_rate_proportional;
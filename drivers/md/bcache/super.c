@@ -1123,6 +1123,18 @@ static int cached_dev_init(struct cached_dev *dc, unsigned block_size)
 		dc->partial_stripes_expensive =
 			q->limits.raid_partial_stripes_expensive;
 
+	/*
+	 * SD cards and eMMC rewrite a whole erase block for any partial write
+	 * to it, much like a RAID stripe: track dirty data per erase block and
+	 * write it back a block at a time.
+	 */
+	if (!dc->disk.stripe_size && blk_queue_nonrot(q) &&
+	    q->limits.discard_granularity > PAGE_SIZE &&
+	    is_power_of_2(q->limits.discard_granularity)) {
+		dc->disk.stripe_size = q->limits.discard_granularity >> 9;
+		dc->partial_stripes_expensive = 1;
+	}
+
 	ret = bcache_device_init(&dc->disk, block_size,
 			 dc->bdev->bd_part->nr_sects - dc->sb.data_offset);
 	if (ret)
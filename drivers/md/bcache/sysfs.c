@@ -83,6 +83,9 @@ rw_attribute(writeback_rate_update_seconds);
 rw_attribute(writeback_rate_d_term);
 rw_attribute(writeback_rate_p_term_inverse);
 read_attribute(writeback_rate_debug);
+rw_attribute(writeback_batch_size);
+read_attribute(writeback_writes);
+read_attribute(writeback_write_latency_us);
 
 read_attribute(stripe_size);
 read_attribute(partial_stripes_expensive);
@@ -132,6 +135,17 @@ SHOW(__bch_cached_dev)
 	var_print(writeback_rate_d_term);
 	var_print(writeback_rate_p_term_inverse);
 
+	sysfs_hprint(writeback_batch_size, dc->writeback_batch_sectors << 9);
+	sysfs_print(writeback_writes, atomic_long_read(&dc->writeback_writes));
+
+	if (attr == &sysfs_writeback_write_latency_us) {
+		u64 writes = atomic_long_read(&dc->writeback_writes);
+		u64 ns = atomic64_read(&dc->writeback_write_ns);
+
+		return sprintf(buf, "%llu\n", writes
+			       ? div64_u64(ns, writes * NSEC_PER_USEC) : 0);
+	}
+
 	if (attr == &sysfs_writeback_rate_debug) {
 		char rate[20];
 		char dirty[20];
@@ -215,6 +229,14 @@ STORE(__cached_dev)
 	d_strtoul(writeback_rate_d_term);
 	d_strtoul_nonzero(writeback_rate_p_term_inverse);
 
+	if (attr == &sysfs_writeback_batch_size) {
+		unsigned bytes;
+
+		strtoi_h_or_return(buf, bytes);
+		dc->writeback_batch_sectors = bytes >> 9;
+		return size;
+	}
+
 	d_strtoi_h(sequential_cutoff);
 	d_strtoi_h(readahead);
 
@@ -321,6 +343,9 @@ static struct attribute *bch_cached_dev_files[] = {
 	&sysfs_writeback_rate_d_term,
 	&sysfs_writeback_rate_p_term_inverse,
 	&sysfs_writeback_rate_debug,
+	&sysfs_writeback_batch_size,
+	&sysfs_writeback_writes,
+	&sysfs_writeback_write_latency_us,
 	&sysfs_dirty_data,
 	&sysfs_stripe_size,
 	&sysfs_partial_stripes_expensive,
@@ -99,6 +99,8 @@ static unsigned writeback_delay(struct cached_dev *dc, unsigned sectors)
 struct dirty_io {
 	struct closure		cl;
 	struct cached_dev	*dc;
+	unsigned		sequence;
+	uint64_t		start_time;
 	struct bio		bio;
 };
 
@@ -130,6 +132,9 @@ static void write_dirty_finish(struct closure *cl)
 	struct keybuf_key *w = io->bio.bi_private;
 	struct cached_dev *dc = io->dc;
 
+	atomic64_add(local_clock() - io->start_time, &dc->writeback_write_ns);
+	atomic_long_inc(&dc->writeback_writes);
+
 	bio_free_pages(&io->bio);
 
 	/* This is kind of a dumb way of signalling errors. */
@@ -178,16 +183,37 @@ static void write_dirty(struct closure *cl)
 {
 	struct dirty_io *io = container_of(cl, struct dirty_io, cl);
 	struct keybuf_key *w = io->bio.bi_private;
+	struct cached_dev *dc = io->dc;
+
+	/*
+	 * Reads from the cache complete in any order; issue the writes in
+	 * the order read_dirty() picked the keys, so that contiguous dirty
+	 * data reaches the backing device as one sequential stream.
+	 */
+	if (atomic_read(&dc->writeback_sequence_next) != io->sequence) {
+		closure_wait(&dc->writeback_ordering_wait, cl);
+
+		/* Our turn may have come before we got on the wait list */
+		if (atomic_read(&dc->writeback_sequence_next) == io->sequence)
+			closure_wake_up(&dc->writeback_ordering_wait);
+
+		continue_at(cl, write_dirty, dc->writeback_write_wq);
+		return;
+	}
 
 	dirty_init(w);
 	bio_set_op_attrs(&io->bio, REQ_OP_WRITE, 0);
 	io->bio.bi_iter.bi_sector = KEY_START(&w->key);
-	io->bio.bi_bdev		= io->dc->bdev;
+	io->bio.bi_bdev		= dc->bdev;
 	io->bio.bi_end_io	= dirty_endio;
 
+	io->start_time = local_clock();
 	closure_bio_submit(&io->bio, cl);
 
-	continue_at(cl, write_dirty_finish, io->dc->writeback_write_wq);
+	atomic_inc(&dc->writeback_sequence_next);
+	closure_wake_up(&dc->writeback_ordering_wait);
+
+	continue_at(cl, write_dirty_finish, dc->writeback_write_wq);
 }
 
 static void read_dirty_endio(struct bio *bio)
@@ -210,13 +236,33 @@ static void read_dirty_submit(struct closure *cl)
 	continue_at(cl, write_dirty, io->dc->writeback_write_wq);
 }
 
+/*
+ * With a batch size set, writeback only pauses for the rate limit when it
+ * moves on to another batch - typically an erase block of the backing
+ * device - so each batch is written in one burst instead of trickling in.
+ */
+static bool writeback_new_batch(struct cached_dev *dc, sector_t offset)
+{
+	sector_t last = dc->last_read - 1;
+
+	if (!dc->writeback_batch_sectors)
+		return false;
+
+	sector_div(last, dc->writeback_batch_sectors);
+	sector_div(offset, dc->writeback_batch_sectors);
+
+	return last != offset;
+}
+
 static void read_dirty(struct cached_dev *dc)
 {
 	unsigned delay = 0;
+	unsigned sequence = 0;
 	struct keybuf_key *w;
 	struct dirty_io *io;
 	struct closure cl;
 
+	atomic_set(&dc->writeback_sequence_next, sequence);
 	closure_init_stack(&cl);
 
 	/*
@@ -233,7 +279,9 @@ static void read_dirty(struct cached_dev *dc)
 		BUG_ON(ptr_stale(dc->disk.c, &w->key, 0));
 
 		if (KEY_START(&w->key) != dc->last_read ||
-		    jiffies_to_msecs(delay) > 50)
+		    (dc->writeback_batch_sectors
+		     ? writeback_new_batch(dc, KEY_START(&w->key))
+		     : jiffies_to_msecs(delay) > 50))
 			while (!kthread_should_stop() && delay)
 				delay = schedule_timeout_interruptible(delay);
 
@@ -247,6 +295,7 @@ static void read_dirty(struct cached_dev *dc)
 
 		w->private	= io;
 		io->dc		= dc;
+		io->sequence	= sequence++;
 
 		dirty_init(w);
 		bio_set_op_attrs(&io->bio, REQ_OP_READ, 0);
@@ -496,9 +545,20 @@ void bch_sectors_dirty_init(struct bcache_device *d)
 	d->sectors_dirty_last = bcache_dev_sectors_dirty(d);
 }
 
+/*
+ * Every writeback IO holds a copy of its dirty extent in memory: allow 64 of
+ * them per GB of RAM, but at least 8.
+ */
+static unsigned writeback_in_flight_max(void)
+{
+	unsigned long mb = totalram_pages >> (20 - PAGE_SHIFT);
+
+	return clamp_t(unsigned long, mb / 16, 8, 64);
+}
+
 void bch_cached_dev_writeback_init(struct cached_dev *dc)
 {
-	sema_init(&dc->in_flight, 64);
+	sema_init(&dc->in_flight, writeback_in_flight_max());
 	init_rwsem(&dc->writeback_lock);
 	bch_keybuf_init(&dc->writeback_keys);
 
@@ -507,6 +567,8 @@ void bch_cached_dev_writeback_init(struct cached_dev *dc)
 	dc->writeback_percent		= 10;
 	dc->writeback_delay		= 30;
 	dc->writeback_rate.rate		= 1024;
+	dc->writeback_batch_sectors	= dc->partial_stripes_expensive
+		? dc->disk.stripe_size : 0;
 
 	dc->writeback_rate_update_seconds = 5;
 	dc->writeback_rate_d_term	= 30;
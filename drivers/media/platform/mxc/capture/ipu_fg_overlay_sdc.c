@@ -141,8 +141,7 @@ static int csi_enc_setup(cam_data *cam)
 	ipu_channel_t chan = (cam->csi == 0) ? CSI_MEM0 : CSI_MEM1;
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
+	int vc;
 #endif
 
 	CAMERA_TRACE("In csi_enc_setup\n");
@@ -178,16 +177,14 @@ static int csi_enc_setup(cam_data *cam)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
+			vc = mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi);
 
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id) {
+			if (vc >= 0) {
 				params.csi_mem.mipi_en = true;
-				params.csi_mem.mipi_vc =
-				mipi_csi2_get_virtual_channel(mipi_csi2_info);
+				params.csi_mem.mipi_vc = vc;
 				params.csi_mem.mipi_id =
-				mipi_csi2_get_datatype(mipi_csi2_info);
+				mipi_csi2_get_vc_datatype(mipi_csi2_info, vc);
 
 				mipi_csi2_pixelclk_enable(mipi_csi2_info);
 			} else {
@@ -457,8 +454,6 @@ static int foreground_stop(void *private)
 
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
 #endif
 
 	if (cam->overlay_active == false)
@@ -501,11 +496,8 @@ static int foreground_stop(void *private)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
-
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id)
+			if (mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi) >= 0)
 				mipi_csi2_pixelclk_disable(mipi_csi2_info);
 		}
 	}
@@ -73,8 +73,7 @@ static int prp_enc_setup(cam_data *cam)
 	dma_addr_t dummy = cam->dummy_frame.buffer.m.offset;
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
+	int vc;
 #endif
 
 	CAMERA_TRACE("In prp_enc_setup\n");
@@ -139,16 +138,14 @@ static int prp_enc_setup(cam_data *cam)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
+			vc = mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi);
 
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id) {
+			if (vc >= 0) {
 				enc.csi_prp_enc_mem.mipi_en = true;
-				enc.csi_prp_enc_mem.mipi_vc =
-				mipi_csi2_get_virtual_channel(mipi_csi2_info);
+				enc.csi_prp_enc_mem.mipi_vc = vc;
 				enc.csi_prp_enc_mem.mipi_id =
-				mipi_csi2_get_datatype(mipi_csi2_info);
+				mipi_csi2_get_vc_datatype(mipi_csi2_info, vc);
 
 				mipi_csi2_pixelclk_enable(mipi_csi2_info);
 			} else {
@@ -433,8 +430,6 @@ static int prp_enc_disabling_tasks(void *private)
 	int err = 0;
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
 #endif
 
 	if (cam->rotation >= IPU_ROTATE_90_RIGHT) {
@@ -462,11 +457,8 @@ static int prp_enc_disabling_tasks(void *private)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
-
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id)
+			if (mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi) >= 0)
 				mipi_csi2_pixelclk_disable(mipi_csi2_info);
 		}
 	}
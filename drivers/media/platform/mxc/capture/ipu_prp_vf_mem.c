@@ -0,0 +1,357 @@
+/*
+ * Copyright 2017 NXP
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*!
+ * @file ipu_prp_vf_mem.c
+ *
+ * @brief IPU Use case for PRP-VF to memory
+ *
+ * Second capture path of a CSI. The IC pre-processor scales the same
+ * CSI frames for its ENC and VF outputs independently, so a capture
+ * node using this path runs next to one using PRP-ENC with its own
+ * resolution and format.
+ *
+ * @ingroup IPU
+ */
+
+#include <linux/module.h>
+#include <linux/dma-mapping.h>
+#include <linux/platform_device.h>
+#include <linux/ipu.h>
+#include <linux/mipi_csi2.h>
+#include "mxc_v4l2_capture.h"
+#include "ipu_prp_sw.h"
+
+/*
+ * Function definitions
+ */
+
+/*!
+ * IPU VF callback function.
+ *
+ * @param irq       int irq line
+ * @param dev_id    void * device id
+ *
+ * @return status   IRQ_HANDLED for handled
+ */
+static irqreturn_t prp_vf_mem_callback(int irq, void *dev_id)
+{
+	cam_data *cam = (cam_data *) dev_id;
+
+	if (cam->enc_callback == NULL)
+		return IRQ_HANDLED;
+
+	cam->enc_callback(irq, dev_id);
+
+	return IRQ_HANDLED;
+}
+
+/*!
+ * PrpVF to memory channel setup function
+ *
+ * @param cam       struct cam_data * mxc capture instance
+ *
+ * @return  status
+ */
+static int prp_vf_mem_setup(cam_data *cam)
+{
+	ipu_channel_params_t vf;
+	int err = 0;
+	dma_addr_t dummy = cam->dummy_frame.buffer.m.offset;
+#ifdef CONFIG_MXC_MIPI_CSI2
+	void *mipi_csi2_info;
+	int vc;
+#endif
+
+	if (cam->rotation >= IPU_ROTATE_90_RIGHT) {
+		pr_err("ERROR: v4l2 capture: PRP VF path cannot rotate\n");
+		return -EINVAL;
+	}
+
+	memset(&vf, 0, sizeof(ipu_channel_params_t));
+
+	ipu_csi_get_window_size(cam->ipu, &vf.csi_prp_vf_mem.in_width,
+				&vf.csi_prp_vf_mem.in_height, cam->csi);
+
+	vf.csi_prp_vf_mem.in_pixel_fmt = IPU_PIX_FMT_UYVY;
+	vf.csi_prp_vf_mem.out_width = cam->v2f.fmt.pix.width;
+	vf.csi_prp_vf_mem.out_height = cam->v2f.fmt.pix.height;
+	vf.csi_prp_vf_mem.csi = cam->csi;
+
+	if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_YUV420) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_YUV420P;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_YVU420) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_YVU420P;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_YUV422P) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_YUV422P;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_YUYV) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_YUYV;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_UYVY) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_UYVY;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_NV12) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_NV12;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_BGR24) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_BGR24;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_RGB24) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_RGB24;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_RGB565) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_RGB565;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_BGR32) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_BGR32;
+	} else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_RGB32) {
+		vf.csi_prp_vf_mem.out_pixel_fmt = IPU_PIX_FMT_RGB32;
+	} else {
+		pr_err("ERROR: v4l2 capture: format not supported\n");
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_MXC_MIPI_CSI2
+	mipi_csi2_info = mipi_csi2_get_info();
+
+	if (mipi_csi2_info && mipi_csi2_get_status(mipi_csi2_info)) {
+		vc = mipi_csi2_get_vc_bind(mipi_csi2_info,
+					   cam->ipu_id, cam->csi);
+
+		if (vc >= 0) {
+			vf.csi_prp_vf_mem.mipi_en = true;
+			vf.csi_prp_vf_mem.mipi_vc = vc;
+			vf.csi_prp_vf_mem.mipi_id =
+				mipi_csi2_get_vc_datatype(mipi_csi2_info, vc);
+
+			mipi_csi2_pixelclk_enable(mipi_csi2_info);
+		}
+	}
+#endif
+
+	err = ipu_init_channel(cam->ipu, CSI_PRP_VF_MEM, &vf);
+	if (err != 0) {
+		pr_err("ERROR: v4l2 capture: ipu_init_channel %d\n", err);
+		return err;
+	}
+
+	err = ipu_init_channel_buffer(cam->ipu, CSI_PRP_VF_MEM,
+				      IPU_OUTPUT_BUFFER,
+				      vf.csi_prp_vf_mem.out_pixel_fmt,
+				      vf.csi_prp_vf_mem.out_width,
+				      vf.csi_prp_vf_mem.out_height,
+				      cam->v2f.fmt.pix.bytesperline /
+				      bytes_per_pixel(vf.csi_prp_vf_mem.
+						      out_pixel_fmt),
+				      cam->rotation,
+				      dummy, dummy, 0,
+				      cam->offset.u_offset,
+				      cam->offset.v_offset);
+	if (err != 0) {
+		pr_err("ERROR: v4l2 capture: CSI_PRP_VF_MEM output buffer\n");
+		return err;
+	}
+
+	err = ipu_enable_channel(cam->ipu, CSI_PRP_VF_MEM);
+	if (err < 0)
+		pr_err("ERROR: v4l2 capture: enable CSI_PRP_VF_MEM\n");
+
+	return err;
+}
+
+/*!
+ * function to update physical buffer address for the VF IDMA channel
+ *
+ * @param private     pointer to cam_data structure
+ * @param eba         physical buffer address for the VF IDMA channel
+ *
+ * @return  status
+ */
+static int prp_vf_mem_eba_update(void *private, dma_addr_t eba)
+{
+	int err = 0;
+	cam_data *cam = (cam_data *) private;
+	struct ipu_soc *ipu = cam->ipu;
+	int *buffer_num = &cam->ping_pong_csi;
+
+	pr_debug("eba %x\n", eba);
+	err = ipu_update_channel_buffer(ipu, CSI_PRP_VF_MEM,
+					IPU_OUTPUT_BUFFER, *buffer_num, eba);
+	if (err != 0) {
+		ipu_clear_buffer_ready(ipu, CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER,
+				       *buffer_num);
+		err = ipu_update_channel_buffer(ipu, CSI_PRP_VF_MEM,
+						IPU_OUTPUT_BUFFER,
+						*buffer_num, eba);
+		if (err != 0) {
+			pr_err("ERROR: v4l2 capture: fail to update buf%d\n",
+			       *buffer_num);
+			return err;
+		}
+	}
+
+	ipu_select_buffer(ipu, CSI_PRP_VF_MEM, IPU_OUTPUT_BUFFER, *buffer_num);
+
+	*buffer_num = (*buffer_num == 0) ? 1 : 0;
+	return 0;
+}
+
+/*!
+ * Enable VF to memory task
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  status
+ */
+static int prp_vf_mem_enabling_tasks(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+	int err = 0;
+
+	cam->dummy_frame.vaddress = dma_alloc_coherent(0,
+			       PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage),
+			       &cam->dummy_frame.paddress,
+			       GFP_DMA | GFP_KERNEL);
+	if (cam->dummy_frame.vaddress == 0) {
+		pr_err("ERROR: v4l2 capture: Allocate dummy frame failed.\n");
+		return -ENOBUFS;
+	}
+	cam->dummy_frame.buffer.type = V4L2_BUF_TYPE_PRIVATE;
+	cam->dummy_frame.buffer.length =
+	    PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage);
+	cam->dummy_frame.buffer.m.offset = cam->dummy_frame.paddress;
+
+	err = ipu_request_irq(cam->ipu, IPU_IRQ_PRP_VF_OUT_EOF,
+			      prp_vf_mem_callback, 0, "Mxc Camera", cam);
+	if (err != 0) {
+		pr_err("ERROR: v4l2 capture: Error registering VF irq\n");
+		return err;
+	}
+
+	err = prp_vf_mem_setup(cam);
+	if (err != 0)
+		pr_err("ERROR: v4l2 capture: prp_vf_mem_setup %d\n", err);
+
+	return err;
+}
+
+/*!
+ * Disable VF to memory task
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  int
+ */
+static int prp_vf_mem_disabling_tasks(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+	int err = 0;
+#ifdef CONFIG_MXC_MIPI_CSI2
+	void *mipi_csi2_info;
+#endif
+
+	err = ipu_disable_channel(cam->ipu, CSI_PRP_VF_MEM, true);
+	ipu_uninit_channel(cam->ipu, CSI_PRP_VF_MEM);
+
+	if (cam->dummy_frame.vaddress != 0) {
+		dma_free_coherent(0, cam->dummy_frame.buffer.length,
+				  cam->dummy_frame.vaddress,
+				  cam->dummy_frame.paddress);
+		cam->dummy_frame.vaddress = 0;
+	}
+
+#ifdef CONFIG_MXC_MIPI_CSI2
+	mipi_csi2_info = mipi_csi2_get_info();
+
+	if (mipi_csi2_info && mipi_csi2_get_status(mipi_csi2_info)) {
+		if (mipi_csi2_get_vc_bind(mipi_csi2_info,
+					  cam->ipu_id, cam->csi) >= 0)
+			mipi_csi2_pixelclk_disable(mipi_csi2_info);
+	}
+#endif
+
+	return err;
+}
+
+/*!
+ * Enable csi
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  status
+ */
+static int prp_vf_mem_enable_csi(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+
+	return ipu_enable_csi(cam->ipu, cam->csi);
+}
+
+/*!
+ * Disable csi
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  status
+ */
+static int prp_vf_mem_disable_csi(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+
+	/* free the eof irq first, disabling csi waits for idmac eof */
+	ipu_free_irq(cam->ipu, IPU_IRQ_PRP_VF_OUT_EOF, cam);
+
+	return ipu_disable_csi(cam->ipu, cam->csi);
+}
+
+/*!
+ * function to select PRP-VF to memory as the working path
+ *
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  int
+ */
+int prp_vf_mem_select(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+
+	if (!cam)
+		return -EIO;
+
+	cam->enc_update_eba = prp_vf_mem_eba_update;
+	cam->enc_enable = prp_vf_mem_enabling_tasks;
+	cam->enc_disable = prp_vf_mem_disabling_tasks;
+	cam->enc_enable_csi = prp_vf_mem_enable_csi;
+	cam->enc_disable_csi = prp_vf_mem_disable_csi;
+
+	return 0;
+}
+EXPORT_SYMBOL(prp_vf_mem_select);
+
+/*!
+ * function to de-select PRP-VF to memory as the working path
+ *
+ * @param private       struct cam_data * mxc capture instance
+ *
+ * @return  int
+ */
+int prp_vf_mem_deselect(void *private)
+{
+	cam_data *cam = (cam_data *) private;
+
+	if (!cam)
+		return -EIO;
+
+	cam->enc_update_eba = NULL;
+	cam->enc_enable = NULL;
+	cam->enc_disable = NULL;
+	cam->enc_enable_csi = NULL;
+	cam->enc_disable_csi = NULL;
+
+	return 0;
+}
+EXPORT_SYMBOL(prp_vf_mem_deselect);
+
+MODULE_AUTHOR("Freescale Semiconductor, Inc.");
+MODULE_DESCRIPTION("IPU PRP VF to memory Driver");
+MODULE_LICENSE("GPL");
@@ -80,8 +80,7 @@ static int prpvf_start(void *private)
 	short *tmp, color;
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
+	int vc;
 #endif
 
 	if (!cam) {
@@ -174,16 +173,14 @@ static int prpvf_start(void *private)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
+			vc = mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi);
 
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id) {
+			if (vc >= 0) {
 				vf.csi_prp_vf_mem.mipi_en = true;
-				vf.csi_prp_vf_mem.mipi_vc =
-				mipi_csi2_get_virtual_channel(mipi_csi2_info);
+				vf.csi_prp_vf_mem.mipi_vc = vc;
 				vf.csi_prp_vf_mem.mipi_id =
-				mipi_csi2_get_datatype(mipi_csi2_info);
+				mipi_csi2_get_vc_datatype(mipi_csi2_info, vc);
 
 				mipi_csi2_pixelclk_enable(mipi_csi2_info);
 			} else {
@@ -396,8 +393,6 @@ static int prpvf_stop(void *private)
 	struct fb_var_screeninfo fbvar;
 #ifdef CONFIG_MXC_MIPI_CSI2
 	void *mipi_csi2_info;
-	int ipu_id;
-	int csi_id;
 #endif
 
 	if (cam->overlay_active == false)
@@ -447,11 +442,8 @@ static int prpvf_stop(void *private)
 
 	if (mipi_csi2_info) {
 		if (mipi_csi2_get_status(mipi_csi2_info)) {
-			ipu_id = mipi_csi2_get_bind_ipu(mipi_csi2_info);
-			csi_id = mipi_csi2_get_bind_csi(mipi_csi2_info);
-
-			if (cam->ipu == ipu_get_soc(ipu_id)
-				&& cam->csi == csi_id)
+			if (mipi_csi2_get_vc_bind(mipi_csi2_info,
+						cam->ipu_id, cam->csi) >= 0)
 				mipi_csi2_pixelclk_disable(mipi_csi2_info);
 		}
 	}
@@ -33,6 +33,8 @@
 #include <linux/types.h>
 #include <linux/fb.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
+#include <linux/kref.h>
 #include <linux/delay.h>
 #include <linux/mxcfb.h>
 #include <linux/of_device.h>
@@ -44,6 +46,15 @@
 #include "mxc_v4l2_capture.h"
 #include "ipu_prp_sw.h"
 
+#define CREATE_TRACE_POINTS
+#include "mxc_v4l2_capture_trace.h"
+
+/* The device node names the capture stage in the traces */
+static inline const char *mxc_cam_name(cam_data *cam)
+{
+	return video_device_node_name(cam->video_dev);
+}
+
 #define init_MUTEX(sem)         sema_init(sem, 1)
 
 static struct platform_device_id imx_v4l2_devtype[] = {
@@ -71,6 +82,10 @@ MODULE_DEVICE_TABLE(of, mxc_v4l2_dt_ids);
 
 static int video_nr = -1;
 
+/* all capture nodes, vf_mem nodes look up their primary node here */
+static LIST_HEAD(mxc_cam_list);
+static DEFINE_MUTEX(mxc_cam_list_lock);
+
 /*! This data is used for the output to the display. */
 #define MXC_V4L2_CAPTURE_NUM_OUTPUTS	6
 #define MXC_V4L2_CAPTURE_NUM_INPUTS	2
@@ -229,6 +244,48 @@ static struct v4l2_int_master mxc_v4l2_master = {
  * Functions for handling Frame buffers.
  **************************************************************************/
 
+/*
+ * Memory of an exported MMAP frame. The frame and every dma-buf exported
+ * from it hold a reference, so the memory outlives a REQBUFS or close
+ * while the buffer is still in use by an importer.
+ */
+struct mxc_v4l_frame_mem {
+	struct kref ref;
+	void *vaddress;
+	dma_addr_t paddress;
+	size_t size;
+};
+
+static void mxc_frame_mem_release(struct kref *ref)
+{
+	struct mxc_v4l_frame_mem *mem =
+		container_of(ref, struct mxc_v4l_frame_mem, ref);
+
+	dma_free_coherent(0, mem->size, mem->vaddress, mem->paddress);
+	kfree(mem);
+}
+
+/*!
+ * Drop a V4L2_MEMORY_DMABUF import of a frame
+ *
+ * @param frame    Structure mxc_v4l_frame *
+ *
+ * @return none
+ */
+static void mxc_v4l2_release_dmabuf(struct mxc_v4l_frame *frame)
+{
+	if (!frame->dmabuf)
+		return;
+
+	dma_buf_unmap_attachment(frame->attach, frame->sgt, DMA_FROM_DEVICE);
+	dma_buf_detach(frame->dmabuf, frame->attach);
+	dma_buf_put(frame->dmabuf);
+	frame->dmabuf = NULL;
+	frame->attach = NULL;
+	frame->sgt = NULL;
+	frame->paddress = 0;
+}
+
 /*!
  * Free frame buffers
  *
@@ -243,7 +300,14 @@ static int mxc_free_frame_buf(cam_data *cam)
 	pr_debug("MVC: In mxc_free_frame_buf\n");
 
 	for (i = 0; i < FRAME_NUM; i++) {
-		if (cam->frame[i].vaddress != 0) {
+		mxc_v4l2_release_dmabuf(&cam->frame[i]);
+
+		if (cam->frame[i].mem) {
+			kref_put(&cam->frame[i].mem->ref,
+				 mxc_frame_mem_release);
+			cam->frame[i].mem = NULL;
+			cam->frame[i].vaddress = 0;
+		} else if (cam->frame[i].vaddress != 0) {
 			dma_free_coherent(0, cam->frame[i].buffer.length,
 					  cam->frame[i].vaddress,
 					  cam->frame[i].paddress);
@@ -368,6 +432,242 @@ static int mxc_v4l2_prepare_bufs(cam_data *cam, struct v4l2_buffer *buf)
 	return 0;
 }
 
+/*!
+ * Set up frames for V4L2_MEMORY_DMABUF, the buffers are attached on QBUF
+ *
+ * @param cam      Structure cam_data*
+ * @param count    int number of buffers
+ *
+ * @return none
+ */
+static void mxc_v4l2_init_dmabuf_frames(cam_data *cam, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		memset(&cam->frame[i].buffer, 0,
+		       sizeof(cam->frame[i].buffer));
+		cam->frame[i].buffer.index = i;
+		cam->frame[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
+		cam->frame[i].buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		cam->frame[i].buffer.memory = V4L2_MEMORY_DMABUF;
+		cam->frame[i].buffer.m.fd = -1;
+		cam->frame[i].index = i;
+	}
+}
+
+/*!
+ * Attach the dma-buf passed to QBUF to a frame. The IPU has no IOMMU,
+ * so the buffer has to be a single contiguous range.
+ *
+ * @param cam      Structure cam_data*
+ * @param frame    Structure mxc_v4l_frame *
+ * @param fd       int dma-buf file descriptor
+ *
+ * @return status  0 success, EINVAL unusable buffer.
+ */
+static int mxc_v4l2_import_dmabuf(cam_data *cam, struct mxc_v4l_frame *frame,
+				  int fd)
+{
+	struct device *dev = cam->video_dev->v4l2_dev->dev;
+	struct dma_buf *dmabuf;
+	int ret;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	if (dmabuf->size < cam->v2f.fmt.pix.sizeimage) {
+		pr_err("ERROR: v4l2 capture: dma-buf too small\n");
+		dma_buf_put(dmabuf);
+		return -EINVAL;
+	}
+
+	/* same buffer as last time, keep the mapping */
+	if (dmabuf == frame->dmabuf) {
+		dma_buf_put(dmabuf);
+		frame->buffer.m.fd = fd;
+		return 0;
+	}
+
+	mxc_v4l2_release_dmabuf(frame);
+
+	frame->attach = dma_buf_attach(dmabuf, dev);
+	if (IS_ERR(frame->attach)) {
+		ret = PTR_ERR(frame->attach);
+		goto err_put;
+	}
+
+	frame->sgt = dma_buf_map_attachment(frame->attach, DMA_FROM_DEVICE);
+	if (IS_ERR(frame->sgt)) {
+		ret = PTR_ERR(frame->sgt);
+		goto err_detach;
+	}
+
+	if (frame->sgt->nents != 1) {
+		pr_err("ERROR: v4l2 capture: dma-buf is not contiguous\n");
+		ret = -EINVAL;
+		goto err_unmap;
+	}
+
+	frame->dmabuf = dmabuf;
+	frame->paddress = sg_dma_address(frame->sgt->sgl);
+	frame->buffer.length = dmabuf->size;
+	frame->buffer.m.fd = fd;
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment(frame->attach, frame->sgt, DMA_FROM_DEVICE);
+err_detach:
+	dma_buf_detach(dmabuf, frame->attach);
+err_put:
+	frame->attach = NULL;
+	frame->sgt = NULL;
+	dma_buf_put(dmabuf);
+	return ret;
+}
+
+static struct sg_table *mxc_dmabuf_map(struct dma_buf_attachment *attach,
+				       enum dma_data_direction dir)
+{
+	struct mxc_v4l_frame_mem *mem = attach->dmabuf->priv;
+	struct sg_table *sgt;
+	int ret;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(sgt, 1, GFP_KERNEL);
+	if (ret)
+		goto err_free;
+
+	sg_set_page(sgt->sgl, pfn_to_page(PFN_DOWN(mem->paddress)),
+		    mem->size, 0);
+
+	/* coherent memory, nothing to sync */
+	if (!dma_map_sg_attrs(attach->dev, sgt->sgl, sgt->nents, dir,
+			      DMA_ATTR_SKIP_CPU_SYNC)) {
+		ret = -ENOMEM;
+		goto err_table;
+	}
+
+	return sgt;
+
+err_table:
+	sg_free_table(sgt);
+err_free:
+	kfree(sgt);
+	return ERR_PTR(ret);
+}
+
+static void mxc_dmabuf_unmap(struct dma_buf_attachment *attach,
+			     struct sg_table *sgt,
+			     enum dma_data_direction dir)
+{
+	dma_unmap_sg_attrs(attach->dev, sgt->sgl, sgt->nents, dir,
+			   DMA_ATTR_SKIP_CPU_SYNC);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static void mxc_dmabuf_release(struct dma_buf *dmabuf)
+{
+	struct mxc_v4l_frame_mem *mem = dmabuf->priv;
+
+	kref_put(&mem->ref, mxc_frame_mem_release);
+}
+
+static void *mxc_dmabuf_kmap(struct dma_buf *dmabuf, unsigned long page_num)
+{
+	struct mxc_v4l_frame_mem *mem = dmabuf->priv;
+
+	return mem->vaddress + page_num * PAGE_SIZE;
+}
+
+static int mxc_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct mxc_v4l_frame_mem *mem = dmabuf->priv;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff + PFN_DOWN(size) > PFN_UP(mem->size))
+		return -EINVAL;
+
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	return remap_pfn_range(vma, vma->vm_start,
+			       PFN_DOWN(mem->paddress) + vma->vm_pgoff,
+			       size, vma->vm_page_prot);
+}
+
+static const struct dma_buf_ops mxc_dmabuf_ops = {
+	.map_dma_buf = mxc_dmabuf_map,
+	.unmap_dma_buf = mxc_dmabuf_unmap,
+	.release = mxc_dmabuf_release,
+	.kmap_atomic = mxc_dmabuf_kmap,
+	.kmap = mxc_dmabuf_kmap,
+	.mmap = mxc_dmabuf_mmap,
+};
+
+/*!
+ * Export a MMAP frame as dma-buf, VIDIOC_EXPBUF
+ *
+ * @param cam      Structure cam_data*
+ * @param eb       Structure v4l2_exportbuffer *
+ *
+ * @return status  0 success, EINVAL no such buffer.
+ */
+static int mxc_v4l2_expbuf(cam_data *cam, struct v4l2_exportbuffer *eb)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct mxc_v4l_frame *frame;
+	struct mxc_v4l_frame_mem *mem;
+	struct dma_buf *dmabuf;
+	int fd;
+
+	if (eb->type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+	    eb->index >= FRAME_NUM || eb->plane ||
+	    (eb->flags & ~(O_ACCMODE | O_CLOEXEC)))
+		return -EINVAL;
+
+	frame = &cam->frame[eb->index];
+	if (frame->buffer.memory != V4L2_MEMORY_MMAP || !frame->vaddress)
+		return -EINVAL;
+
+	if (!frame->mem) {
+		mem = kzalloc(sizeof(*mem), GFP_KERNEL);
+		if (!mem)
+			return -ENOMEM;
+
+		kref_init(&mem->ref);
+		mem->vaddress = frame->vaddress;
+		mem->paddress = frame->paddress;
+		mem->size = frame->buffer.length;
+		frame->mem = mem;
+	}
+	mem = frame->mem;
+
+	exp_info.ops = &mxc_dmabuf_ops;
+	exp_info.size = mem->size;
+	exp_info.flags = eb->flags & O_ACCMODE;
+	exp_info.priv = mem;
+
+	kref_get(&mem->ref);
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		kref_put(&mem->ref, mxc_frame_mem_release);
+		return PTR_ERR(dmabuf);
+	}
+
+	fd = dma_buf_fd(dmabuf, eb->flags & O_CLOEXEC);
+	if (fd < 0) {
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	eb->fd = fd;
+	return 0;
+}
+
 /***************************************************************************
  * Functions for handling the video stream.
  **************************************************************************/
@@ -441,6 +741,14 @@ static int mxc_streamon(cam_data *cam)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_MXC_IPU_PRP_VF_SDC
+	/* PRP VF is either the preview of the primary node or ours */
+	if (cam->vf_mem && cam->primary->overlay_on) {
+		pr_err("ERROR: v4l2 capture: PRP VF is used for preview\n");
+		return -EBUSY;
+	}
+#endif
+
 	cam->capture_pid = current->pid;
 
 	if (cam->overlay_on == true)
@@ -461,14 +769,18 @@ static int mxc_streamon(cam_data *cam)
 		list_del(cam->ready_q.next);
 		list_add_tail(&frame->queue, &cam->working_q);
 		frame->ipu_buf_num = cam->ping_pong_csi;
-		err = cam->enc_update_eba(cam, frame->buffer.m.offset);
+		err = cam->enc_update_eba(cam, frame->paddress);
+		trace_imx_capture_hw_start(mxc_cam_name(cam), frame->index,
+					   frame->paddress);
 
 		frame =
 		    list_entry(cam->ready_q.next, struct mxc_v4l_frame, queue);
 		list_del(cam->ready_q.next);
 		list_add_tail(&frame->queue, &cam->working_q);
 		frame->ipu_buf_num = cam->ping_pong_csi;
-		err |= cam->enc_update_eba(cam, frame->buffer.m.offset);
+		err |= cam->enc_update_eba(cam, frame->paddress);
+		trace_imx_capture_hw_start(mxc_cam_name(cam), frame->index,
+					   frame->paddress);
 		spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
 	} else {
 		spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
@@ -694,6 +1006,13 @@ static int start_preview(cam_data *cam)
 
 	pr_debug("MVC: start_preview\n");
 
+#ifdef CONFIG_MXC_IPU_PRP_VF_SDC
+	if (cam->companion && cam->companion->capture_on) {
+		pr_err("ERROR: v4l2 capture: PRP VF is used for capture\n");
+		return -EBUSY;
+	}
+#endif
+
 	if (cam->v4l2_fb.flags == V4L2_FBUF_FLAG_OVERLAY)
 	#ifdef CONFIG_MXC_IPU_PRP_VF_SDC
 		err = prp_vf_sdc_select(cam);
@@ -1600,6 +1919,9 @@ static int mxc_v4l_dqueue(cam_data *cam, struct v4l2_buffer *buf)
 	buf->field = cam->frame[frame->index].buffer.field;
 	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
 
+	trace_imx_capture_buf_dequeue(mxc_cam_name(cam), frame->index,
+				      frame->paddress);
+
 	up(&cam->busy_lock);
 	return retval;
 }
@@ -1612,11 +1934,180 @@ static int mxc_v4l_dqueue(cam_data *cam, struct v4l2_buffer *buf)
  * @return  status    0 success, ENODEV invalid device instance,
  *                    ENODEV timeout, ERESTARTSYS interrupted by user
  */
-static int mxc_v4l_open(struct file *file)
+/*!
+ * Configure the CSI for the sensor and power the sensor up
+ *
+ * @param cam      structure cam_data * owning the sensor
+ *
+ * @return none
+ */
+static void mxc_v4l_sensor_on(cam_data *cam)
 {
 	struct v4l2_ifparm ifparm;
 	struct v4l2_format cam_fmt;
 	ipu_csi_signal_cfg_t csi_param;
+	struct sensor_data *sensor = cam->sensor->priv;
+
+	vidioc_int_g_ifparm(cam->sensor, &ifparm);
+
+	csi_param.sens_clksrc = 0;
+
+	csi_param.clk_mode = 0;
+	csi_param.data_pol = 0;
+	csi_param.ext_vsync = 0;
+
+	csi_param.pack_tight = 0;
+	csi_param.force_eof = 0;
+	csi_param.data_en_pol = 0;
+
+	csi_param.mclk = ifparm.u.bt656.clock_curr;
+
+	csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
+
+	if (ifparm.u.bt656.mode
+			== V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT)
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+	else if (ifparm.u.bt656.mode
+			== V4L2_IF_TYPE_BT656_MODE_NOBT_10BIT)
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_10;
+	else
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+
+
+	csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
+	csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
+
+	csi_param.csi = cam->csi;
+
+	cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
+
+	/* Reset the sizes.  Needed to prevent carryover of last
+	 * operation.*/
+	cam->crop_bounds.top = cam->crop_bounds.left = 0;
+	cam->crop_bounds.width = cam_fmt.fmt.pix.width;
+	cam->crop_bounds.height = cam_fmt.fmt.pix.height;
+
+	/* This also is the max crop size for this device. */
+	cam->crop_defrect.top = cam->crop_defrect.left = 0;
+	cam->crop_defrect.width = cam_fmt.fmt.pix.width;
+	cam->crop_defrect.height = cam_fmt.fmt.pix.height;
+
+	/* At this point, this is also the current image size. */
+	cam->crop_current.top = cam->crop_current.left = 0;
+	cam->crop_current.width = cam_fmt.fmt.pix.width;
+	cam->crop_current.height = cam_fmt.fmt.pix.height;
+
+	pr_debug("End of %s: v2f pix widthxheight %d x %d\n",
+		__func__,
+		cam->v2f.fmt.pix.width, cam->v2f.fmt.pix.height);
+	pr_debug("End of %s: crop_bounds widthxheight %d x %d\n",
+		__func__,
+		cam->crop_bounds.width, cam->crop_bounds.height);
+	pr_debug("End of %s: crop_defrect widthxheight %d x %d\n",
+		__func__,
+		cam->crop_defrect.width, cam->crop_defrect.height);
+	pr_debug("End of %s: crop_current widthxheight %d x %d\n",
+		__func__,
+		cam->crop_current.width, cam->crop_current.height);
+
+	csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
+	pr_debug("On Open: Input to ipu size is %d x %d\n",
+			cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
+	ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
+				cam->crop_current.height,
+				cam->csi);
+	ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
+				cam->crop_current.top,
+				cam->csi);
+	ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
+				cam->crop_bounds.height,
+				cam_fmt.fmt.pix.pixelformat,
+				csi_param);
+	clk_prepare_enable(sensor->sensor_clk);
+	vidioc_int_s_power(cam->sensor, 1);
+	vidioc_int_init(cam->sensor);
+	vidioc_int_dev_init(cam->sensor);
+}
+
+/*!
+ * Power the sensor down
+ *
+ * @param cam      structure cam_data * owning the sensor
+ *
+ * @return none
+ */
+static void mxc_v4l_sensor_off(cam_data *cam)
+{
+	struct sensor_data *sensor = cam->sensor->priv;
+
+	vidioc_int_s_power(cam->sensor, 0);
+	clk_disable_unprepare(sensor->sensor_clk);
+}
+
+/*!
+ * Find the primary node whose CSI and sensor a vf_mem node captures
+ * from, and take a sensor reference on it
+ *
+ * @param cam      structure cam_data * of the vf_mem node
+ *
+ * @return status  0 success, EAGAIN primary or sensor not found
+ */
+static int mxc_v4l_get_primary(cam_data *cam)
+{
+	cam_data *c, *primary = NULL;
+
+	mutex_lock(&mxc_cam_list_lock);
+	list_for_each_entry(c, &mxc_cam_list, node) {
+		if (c != cam && !c->vf_mem && c->sensor &&
+		    c->ipu_id == cam->ipu_id && c->csi == cam->csi) {
+			primary = c;
+			break;
+		}
+	}
+	if (primary) {
+		cam->primary = primary;
+		primary->companion = cam;
+	}
+	mutex_unlock(&mxc_cam_list_lock);
+
+	if (!primary) {
+		pr_err("ERROR: v4l2 capture: no primary node for vf_mem\n");
+		return -EAGAIN;
+	}
+
+	down(&primary->busy_lock);
+	if (primary->sensor_users++ == 0)
+		mxc_v4l_sensor_on(primary);
+	cam->sensor = primary->sensor;
+	cam->device_type = primary->device_type;
+	cam->crop_bounds = primary->crop_bounds;
+	cam->crop_defrect = primary->crop_defrect;
+	cam->crop_current = primary->crop_current;
+	up(&primary->busy_lock);
+
+	return 0;
+}
+
+/*!
+ * Drop the sensor reference a vf_mem node holds on its primary node
+ *
+ * @param cam      structure cam_data * of the vf_mem node
+ *
+ * @return none
+ */
+static void mxc_v4l_put_primary(cam_data *cam)
+{
+	cam_data *primary = cam->primary;
+
+	down(&primary->busy_lock);
+	if (--primary->sensor_users == 0)
+		mxc_v4l_sensor_off(primary);
+	up(&primary->busy_lock);
+}
+
+static int mxc_v4l_open(struct file *file)
+{
 	struct video_device *dev = video_devdata(file);
 	cam_data *cam = video_get_drvdata(dev);
 	int err = 0;
@@ -1631,17 +2122,20 @@ static int mxc_v4l_open(struct file *file)
 		return -EBADF;
 	}
 
-	if (cam->sensor == NULL ||
-	    cam->sensor->type != v4l2_int_type_slave) {
-		pr_err("ERROR: v4l2 capture: slave not found!\n");
-		return -EAGAIN;
-	}
+	/* a vf_mem node borrows the sensor of its primary node on open */
+	if (!cam->vf_mem) {
+		if (cam->sensor == NULL ||
+		    cam->sensor->type != v4l2_int_type_slave) {
+			pr_err("ERROR: v4l2 capture: slave not found!\n");
+			return -EAGAIN;
+		}
 
-	sensor = cam->sensor->priv;
-	if (!sensor) {
-		pr_err("%s: Internal error, sensor_data is not found!\n",
-		       __func__);
-		return -EBADF;
+		sensor = cam->sensor->priv;
+		if (!sensor) {
+			pr_err("%s: Internal error, sensor_data is not found!\n",
+			       __func__);
+			return -EBADF;
+		}
 	}
 
 	down(&cam->busy_lock);
@@ -1653,7 +2147,19 @@ static int mxc_v4l_open(struct file *file)
 		wait_event_interruptible(cam->power_queue,
 					 cam->low_power == false);
 
-		if (strcmp(mxc_capture_inputs[cam->current_input].name,
+		if (cam->vf_mem) {
+#if IS_ENABLED(CONFIG_MXC_IPU_PRP_VF_MEM)
+			err = prp_vf_mem_select(cam);
+#else
+			err = -ENODEV;
+#endif
+			if (!err)
+				err = mxc_v4l_get_primary(cam);
+			if (err) {
+				cam->open_count--;
+				goto oops;
+			}
+		} else if (strcmp(mxc_capture_inputs[cam->current_input].name,
 			   "CSI MEM") == 0) {
 #if defined(CONFIG_MXC_IPU_CSI_ENC) || defined(CONFIG_MXC_IPU_CSI_ENC_MODULE)
 			err = csi_enc_select(cam);
@@ -1670,86 +2176,8 @@ static int mxc_v4l_open(struct file *file)
 		INIT_LIST_HEAD(&cam->working_q);
 		INIT_LIST_HEAD(&cam->done_q);
 
-		vidioc_int_g_ifparm(cam->sensor, &ifparm);
-
-		csi_param.sens_clksrc = 0;
-
-		csi_param.clk_mode = 0;
-		csi_param.data_pol = 0;
-		csi_param.ext_vsync = 0;
-
-		csi_param.pack_tight = 0;
-		csi_param.force_eof = 0;
-		csi_param.data_en_pol = 0;
-
-		csi_param.mclk = ifparm.u.bt656.clock_curr;
-
-		csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
-
-		if (ifparm.u.bt656.mode
-				== V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT)
-			csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
-		else if (ifparm.u.bt656.mode
-				== V4L2_IF_TYPE_BT656_MODE_NOBT_10BIT)
-			csi_param.data_width = IPU_CSI_DATA_WIDTH_10;
-		else
-			csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
-
-
-		csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
-		csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
-
-		csi_param.csi = cam->csi;
-
-		cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
-
-		/* Reset the sizes.  Needed to prevent carryover of last
-		 * operation.*/
-		cam->crop_bounds.top = cam->crop_bounds.left = 0;
-		cam->crop_bounds.width = cam_fmt.fmt.pix.width;
-		cam->crop_bounds.height = cam_fmt.fmt.pix.height;
-
-		/* This also is the max crop size for this device. */
-		cam->crop_defrect.top = cam->crop_defrect.left = 0;
-		cam->crop_defrect.width = cam_fmt.fmt.pix.width;
-		cam->crop_defrect.height = cam_fmt.fmt.pix.height;
-
-		/* At this point, this is also the current image size. */
-		cam->crop_current.top = cam->crop_current.left = 0;
-		cam->crop_current.width = cam_fmt.fmt.pix.width;
-		cam->crop_current.height = cam_fmt.fmt.pix.height;
-
-		pr_debug("End of %s: v2f pix widthxheight %d x %d\n",
-			__func__,
-			cam->v2f.fmt.pix.width, cam->v2f.fmt.pix.height);
-		pr_debug("End of %s: crop_bounds widthxheight %d x %d\n",
-			__func__,
-			cam->crop_bounds.width, cam->crop_bounds.height);
-		pr_debug("End of %s: crop_defrect widthxheight %d x %d\n",
-			__func__,
-			cam->crop_defrect.width, cam->crop_defrect.height);
-		pr_debug("End of %s: crop_current widthxheight %d x %d\n",
-			__func__,
-			cam->crop_current.width, cam->crop_current.height);
-
-		csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
-		pr_debug("On Open: Input to ipu size is %d x %d\n",
-				cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
-		ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
-					cam->crop_current.height,
-					cam->csi);
-		ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
-					cam->crop_current.top,
-					cam->csi);
-		ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
-					cam->crop_bounds.height,
-					cam_fmt.fmt.pix.pixelformat,
-					csi_param);
-		clk_prepare_enable(sensor->sensor_clk);
-		vidioc_int_s_power(cam->sensor, 1);
-		vidioc_int_init(cam->sensor);
-		vidioc_int_dev_init(cam->sensor);
+		if (!cam->vf_mem && cam->sensor_users++ == 0)
+			mxc_v4l_sensor_on(cam);
 	}
 
 	file->private_data = dev;
@@ -1806,13 +2234,19 @@ static int mxc_v4l_close(struct file *file)
 	}
 
 	if (--cam->open_count == 0) {
-		vidioc_int_s_power(cam->sensor, 0);
-		clk_disable_unprepare(sensor->sensor_clk);
+		if (cam->vf_mem)
+			mxc_v4l_put_primary(cam);
+		else if (--cam->sensor_users == 0)
+			mxc_v4l_sensor_off(cam);
 		wait_event_interruptible(cam->power_queue,
 					 cam->low_power == false);
 		pr_debug("mxc_v4l_close: release resource\n");
 
-		if (strcmp(mxc_capture_inputs[cam->current_input].name,
+		if (cam->vf_mem) {
+#if IS_ENABLED(CONFIG_MXC_IPU_PRP_VF_MEM)
+			err |= prp_vf_mem_deselect(cam);
+#endif
+		} else if (strcmp(mxc_capture_inputs[cam->current_input].name,
 			   "CSI MEM") == 0) {
 #if defined(CONFIG_MXC_IPU_CSI_ENC) || defined(CONFIG_MXC_IPU_CSI_ENC_MODULE)
 			err |= csi_enc_deselect(cam);
@@ -1955,6 +2389,20 @@ static long mxc_v4l_do_ioctl(struct file *file,
 		if (down_interruptible(&cam->busy_lock))
 			return -EBUSY;
 
+	/* the CSI, the sensor and the VF path belong to the primary node */
+	if (cam->vf_mem) {
+		switch (ioctlnr) {
+		case VIDIOC_S_PARM:
+		case VIDIOC_S_CROP:
+		case VIDIOC_S_STD:
+		case VIDIOC_S_INPUT:
+		case VIDIOC_S_FBUF:
+		case VIDIOC_OVERLAY:
+			up(&cam->busy_lock);
+			return -EBUSY;
+		}
+	}
+
 	switch (ioctlnr) {
 	/*!
 	 * V4l2 VIDIOC_QUERYCAP ioctl
@@ -2028,10 +2476,25 @@ static long mxc_v4l_do_ioctl(struct file *file,
 		if (req->memory & V4L2_MEMORY_MMAP) {
 			mxc_free_frame_buf(cam);
 			retval = mxc_allocate_frame_buf(cam, req->count);
+		} else if (req->memory == V4L2_MEMORY_DMABUF) {
+			mxc_free_frame_buf(cam);
+			mxc_v4l2_init_dmabuf_frames(cam, req->count);
 		}
 		break;
 	}
 
+	/*!
+	 * V4l2 VIDIOC_EXPBUF ioctl
+	 */
+	case VIDIOC_EXPBUF: {
+		pr_debug("   case VIDIOC_EXPBUF\n");
+
+		down(&cam->param_lock);
+		retval = mxc_v4l2_expbuf(cam, arg);
+		up(&cam->param_lock);
+		break;
+	}
+
 	/*!
 	 * V4l2 VIDIOC_QUERYBUF ioctl
 	 */
@@ -2073,6 +2536,29 @@ static long mxc_v4l_do_ioctl(struct file *file,
 		int index = buf->index;
 		pr_debug("   case VIDIOC_QBUF\n");
 
+		if (index < 0 || index >= FRAME_NUM) {
+			retval = -EINVAL;
+			break;
+		}
+
+		if (buf->memory == V4L2_MEMORY_DMABUF) {
+			if (cam->frame[index].buffer.memory !=
+			    V4L2_MEMORY_DMABUF ||
+			    (cam->frame[index].buffer.flags &
+			     V4L2_BUF_FLAG_QUEUED)) {
+				retval = -EINVAL;
+				break;
+			}
+
+			down(&cam->param_lock);
+			retval = mxc_v4l2_import_dmabuf(cam,
+							&cam->frame[index],
+							buf->m.fd);
+			up(&cam->param_lock);
+			if (retval)
+				break;
+		}
+
 		spin_lock_irqsave(&cam->queue_int_lock, lock_flags);
 		if ((cam->frame[index].buffer.flags & 0x7) ==
 		    V4L2_BUF_FLAG_MAPPED) {
@@ -2080,6 +2566,8 @@ static long mxc_v4l_do_ioctl(struct file *file,
 			    V4L2_BUF_FLAG_QUEUED;
 			list_add_tail(&cam->frame[index].queue,
 				      &cam->ready_q);
+			trace_imx_capture_buf_queue(mxc_cam_name(cam), index,
+						cam->frame[index].paddress);
 		} else if (cam->frame[index].buffer.
 			   flags & V4L2_BUF_FLAG_QUEUED) {
 			pr_err("ERROR: v4l2 capture: VIDIOC_QBUF: "
@@ -2627,6 +3115,9 @@ static void camera_callback(u32 mask, void *dev)
 			/* Added to the done queue */
 			list_del(cam->working_q.next);
 			list_add_tail(&done_frame->queue, &cam->done_q);
+			trace_imx_capture_hw_done(mxc_cam_name(cam),
+						  done_frame->index,
+						  done_frame->paddress);
 
 			/* Wake up the queue */
 			cam->enc_counter++;
@@ -2644,11 +3135,14 @@ next:
 		if (cam->enc_update_eba)
 			if (cam->enc_update_eba(
 				cam,
-				ready_frame->buffer.m.offset) == 0) {
+				ready_frame->paddress) == 0) {
 				list_del(cam->ready_q.next);
 				list_add_tail(&ready_frame->queue,
 					      &cam->working_q);
 				ready_frame->ipu_buf_num = cam->local_buf_num;
+				trace_imx_capture_hw_start(mxc_cam_name(cam),
+						ready_frame->index,
+						ready_frame->paddress);
 			}
 	} else {
 		if (cam->enc_update_eba)
@@ -2797,6 +3291,7 @@ static int init_camera_struct(cam_data *cam, struct platform_device *pdev)
 	cam->ipu_id = ipu_id;
 	cam->csi = csi_id;
 	cam->mclk_source = mclk_source;
+	cam->vf_mem = of_property_read_bool(np, "vf_mem");
 	cam->mclk_on[cam->mclk_source] = false;
 
 	cam->enc_callback = camera_callback;
@@ -2877,6 +3372,10 @@ static int mxc_v4l2_probe(struct platform_device *pdev)
 
 	pdev->dev.release = camera_platform_release;
 
+	mutex_lock(&mxc_cam_list_lock);
+	list_add_tail(&cam->node, &mxc_cam_list);
+	mutex_unlock(&mxc_cam_list_lock);
+
 	/* Set up the v4l2 device and register it*/
 	cam->self->priv = cam;
 	v4l2_int_device_register(cam->self);
@@ -2921,11 +3420,19 @@ static int mxc_v4l2_probe(struct platform_device *pdev)
 static int mxc_v4l2_remove(struct platform_device *pdev)
 {
 	cam_data *cam = (cam_data *)platform_get_drvdata(pdev);
-	if (cam->open_count) {
+	if (cam->open_count || cam->sensor_users) {
 		pr_err("ERROR: v4l2 capture:camera open "
 			"-- setting ops to NULL\n");
 		return -EBUSY;
 	} else {
+		mutex_lock(&mxc_cam_list_lock);
+		list_del(&cam->node);
+		if (cam->companion)
+			cam->companion->primary = NULL;
+		if (cam->primary)
+			cam->primary->companion = NULL;
+		mutex_unlock(&mxc_cam_list_lock);
+
 		struct v4l2_device *v4l2_dev = cam->video_dev->v4l2_dev;
 		device_remove_file(&cam->video_dev->dev,
 			&dev_attr_fsl_v4l2_capture_property);
@@ -2979,7 +3486,7 @@ static int mxc_v4l2_suspend(struct platform_device *pdev, pm_message_t state)
 	if (cam->capture_on == true)
 		mxc_enc_disable(cam);
 
-	if (cam->sensor && cam->open_count) {
+	if (cam->sensor && cam->sensor_users) {
 		if (cam->mclk_on[cam->mclk_source]) {
 			ipu_csi_enable_mclk_if(cam->ipu, CSI_MCLK_I2C,
 					       cam->mclk_source,
@@ -3017,7 +3524,7 @@ static int mxc_v4l2_resume(struct platform_device *pdev)
 	cam->low_power = false;
 	wake_up_interruptible(&cam->power_queue);
 
-	if (cam->sensor && cam->open_count) {
+	if (cam->sensor && cam->sensor_users) {
 		vidioc_int_s_power(cam->sensor, 1);
 
 		if (!cam->mclk_on[cam->mclk_source]) {
@@ -3077,6 +3584,10 @@ static int mxc_v4l2_master_attach(struct v4l2_int_device *slave)
 		return -1;
 	}
 
+	/* leave the sensor to the primary node of this CSI */
+	if (cam->vf_mem)
+		return -1;
+
 	if (sdata->ipu_id != cam->ipu_id) {
 		pr_debug("%s: ipu doesn't match\n", __func__);
 		return -1;
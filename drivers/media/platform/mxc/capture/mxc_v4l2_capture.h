@@ -65,6 +65,13 @@ struct mxc_v4l_frame {
 		int ipu_buf_num;
 		int csi_buf_num;
 	};
+
+	/* set once the MMAP buffer has been exported as dma-buf */
+	struct mxc_v4l_frame_mem *mem;
+	/* V4L2_MEMORY_DMABUF import */
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
 };
 
 /* Only for old version.  Will go away soon. */
@@ -221,6 +228,17 @@ typedef struct _cam_data {
 	struct v4l2_int_device *sensor;
 	struct v4l2_int_device *self;
 	int sensor_index;
+	/* opens of this node and its companion that need the sensor on */
+	int sensor_users;
+
+	/*
+	 * A vf_mem node captures through PRP VF from the CSI and sensor
+	 * of its primary node, which captures through PRP ENC.
+	 */
+	bool vf_mem;
+	struct _cam_data *primary;
+	struct _cam_data *companion;
+	struct list_head node;
 	void *ipu;
 	void *csi_soc;
 	enum imx_v4l2_devtype devtype;
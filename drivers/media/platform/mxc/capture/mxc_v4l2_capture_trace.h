@@ -0,0 +1,71 @@
+/*
+ * i.MX V4L2 capture driver tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * Part of the imx_media trace system shared with the VPU, IPU device and
+ * DRM CRTC drivers. Buffers are named by their DMA address, which is what
+ * every stage of the pipeline is handed.
+ */
+
+#if !defined(__MXC_V4L2_CAPTURE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __MXC_V4L2_CAPTURE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM imx_media
+
+DECLARE_EVENT_CLASS(imx_capture_buf,
+	TP_PROTO(const char *dev, int index, dma_addr_t addr),
+	TP_ARGS(dev, index, addr),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(int, index)
+		__field(u64, addr)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->index = index;
+		__entry->addr = addr;
+	),
+	TP_printk("%s: index=%d addr=0x%08llx", __get_str(dev),
+		  __entry->index, __entry->addr)
+);
+
+/* VIDIOC_QBUF */
+DEFINE_EVENT(imx_capture_buf, imx_capture_buf_queue,
+	TP_PROTO(const char *dev, int index, dma_addr_t addr),
+	TP_ARGS(dev, index, addr)
+);
+
+/* VIDIOC_DQBUF */
+DEFINE_EVENT(imx_capture_buf, imx_capture_buf_dequeue,
+	TP_PROTO(const char *dev, int index, dma_addr_t addr),
+	TP_ARGS(dev, index, addr)
+);
+
+/* The buffer is set as the next one the CSI/IC writes into */
+DEFINE_EVENT(imx_capture_buf, imx_capture_hw_start,
+	TP_PROTO(const char *dev, int index, dma_addr_t addr),
+	TP_ARGS(dev, index, addr)
+);
+
+/* End of frame, the buffer is filled */
+DEFINE_EVENT(imx_capture_buf, imx_capture_hw_done,
+	TP_PROTO(const char *dev, int index, dma_addr_t addr),
+	TP_ARGS(dev, index, addr)
+);
+
+#endif /* __MXC_V4L2_CAPTURE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mxc_v4l2_capture_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * V4L2 mem2mem device on top of the IPUv3 image converter, queued through
+ * the same task interface as /dev/mxc_ipu.
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/ipu.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/workqueue.h>
+
+#include "mxc_m2m.h"
+
+#define DRIVER_NAME		"mxc-ipu-m2m"
+
+#define IPU_M2M_MAX_W		4096
+#define IPU_M2M_MAX_H		4096
+
+/* IPU_PIX_FMT_* codes are the V4L2 fourccs for these */
+#define IPU_M2M_FMT(_fourcc, _depth, _planar)			\
+	{							\
+		.fourcc	= _fourcc,				\
+		.hw_fmt	= _fourcc,				\
+		.depth	= _depth,				\
+		.planar	= _planar,				\
+		.types	= MXC_M2M_SRC | MXC_M2M_DST,		\
+	}
+
+static const struct mxc_m2m_fmt ipu_m2m_formats[] = {
+	IPU_M2M_FMT(V4L2_PIX_FMT_YUYV, 16, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_UYVY, 16, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_NV12, 12, true),
+	IPU_M2M_FMT(V4L2_PIX_FMT_NV16, 16, true),
+	IPU_M2M_FMT(V4L2_PIX_FMT_YUV420, 12, true),
+	IPU_M2M_FMT(V4L2_PIX_FMT_YVU420, 12, true),
+	IPU_M2M_FMT(V4L2_PIX_FMT_YUV422P, 16, true),
+	IPU_M2M_FMT(V4L2_PIX_FMT_RGB565, 16, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_RGB24, 24, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_BGR24, 24, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_RGB32, 32, false),
+	IPU_M2M_FMT(V4L2_PIX_FMT_BGR32, 32, false),
+};
+
+struct ipu_m2m {
+	struct mxc_m2m_dev	m2m;
+	struct work_struct	work;
+	struct mxc_m2m_ctx	*ctx;
+	struct ipu_task		task;
+};
+
+static struct platform_device *ipu_m2m_pdev;
+
+static void ipu_m2m_fill_task(struct mxc_m2m_ctx *ctx, struct ipu_task *task)
+{
+	struct mxc_m2m_q_data *src = &ctx->q_data[MXC_M2M_Q_SRC];
+	struct mxc_m2m_q_data *dst = &ctx->q_data[MXC_M2M_Q_DST];
+	u8 rot = 0;
+
+	memset(task, 0, sizeof(*task));
+
+	task->input.width = src->width;
+	task->input.height = src->height;
+	task->input.format = src->fmt->hw_fmt;
+	task->input.crop.w = src->width;
+	task->input.crop.h = src->height;
+
+	/*
+	 * 90 degree steps on top of the flips: bit 0 vflip, bit 1 hflip,
+	 * both is 180, bit 2 a clockwise quarter turn done last.
+	 */
+	if (ctx->rotate >= 180)
+		rot = IPU_ROTATE_180;
+	if (ctx->hflip)
+		rot ^= IPU_ROTATE_HORIZ_FLIP;
+	if (ctx->vflip)
+		rot ^= IPU_ROTATE_VERT_FLIP;
+	if (ctx->rotate % 180)
+		rot |= IPU_ROTATE_90_RIGHT;
+
+	task->output.width = dst->width;
+	task->output.height = dst->height;
+	task->output.format = dst->fmt->hw_fmt;
+	task->output.rotate = rot;
+	task->output.crop.w = dst->width;
+	task->output.crop.h = dst->height;
+
+	task->priority = IPU_TASK_PRIORITY_NORMAL;
+	task->task_id = IPU_TASK_ID_ANY;
+	task->timeout = 1000;
+}
+
+static int ipu_m2m_check(struct mxc_m2m_ctx *ctx)
+{
+	struct ipu_task task;
+	int ret;
+
+	ipu_m2m_fill_task(ctx, &task);
+	ret = ipu_check_task(&task);
+	if (ret >= IPU_CHECK_ERR_MIN) {
+		v4l2_dbg(1, 0, &ctx->m2m->v4l2_dev,
+			 "conversion not supported: %d\n", ret);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int ipu_m2m_run(struct mxc_m2m_ctx *ctx, dma_addr_t src,
+		       dma_addr_t dst)
+{
+	struct ipu_m2m *ipu = container_of(ctx->m2m, struct ipu_m2m, m2m);
+
+	ipu_m2m_fill_task(ctx, &ipu->task);
+	ipu->task.input.paddr = src;
+	ipu->task.output.paddr = dst;
+	ipu->ctx = ctx;
+
+	/* ipu_queue_task() waits for the conversion to end */
+	schedule_work(&ipu->work);
+
+	return 0;
+}
+
+static void ipu_m2m_work(struct work_struct *work)
+{
+	struct ipu_m2m *ipu = container_of(work, struct ipu_m2m, work);
+	int ret;
+
+	ret = ipu_queue_task(&ipu->task);
+	if (ret)
+		v4l2_err(&ipu->m2m.v4l2_dev, "task failed: %d\n", ret);
+
+	mxc_m2m_job_done(ipu->ctx, ret);
+}
+
+static const struct mxc_m2m_ops ipu_m2m_ops = {
+	.check	= ipu_m2m_check,
+	.run	= ipu_m2m_run,
+};
+
+static int ipu_m2m_probe(struct platform_device *pdev)
+{
+	struct ipu_m2m *ipu;
+	int ret;
+
+	ipu = devm_kzalloc(&pdev->dev, sizeof(*ipu), GFP_KERNEL);
+	if (!ipu)
+		return -ENOMEM;
+
+	INIT_WORK(&ipu->work, ipu_m2m_work);
+	ipu->m2m.dma_dev = &pdev->dev;
+	ipu->m2m.formats = ipu_m2m_formats;
+	ipu->m2m.num_formats = ARRAY_SIZE(ipu_m2m_formats);
+	ipu->m2m.max_width = IPU_M2M_MAX_W;
+	ipu->m2m.max_height = IPU_M2M_MAX_H;
+	ipu->m2m.ops = &ipu_m2m_ops;
+
+	ret = mxc_m2m_register(&ipu->m2m, &pdev->dev, DRIVER_NAME);
+	if (ret)
+		return ret;
+
+	platform_set_drvdata(pdev, ipu);
+
+	return 0;
+}
+
+static int ipu_m2m_remove(struct platform_device *pdev)
+{
+	struct ipu_m2m *ipu = platform_get_drvdata(pdev);
+
+	mxc_m2m_unregister(&ipu->m2m);
+	flush_work(&ipu->work);
+
+	return 0;
+}
+
+static struct platform_driver ipu_m2m_driver = {
+	.driver = {
+		.name = DRIVER_NAME,
+	},
+	.probe = ipu_m2m_probe,
+	.remove = ipu_m2m_remove,
+};
+
+static int __init ipu_m2m_init(void)
+{
+	struct platform_device_info info = {
+		.name = DRIVER_NAME,
+		.id = PLATFORM_DEVID_NONE,
+		.dma_mask = DMA_BIT_MASK(32),
+	};
+	int ret;
+
+	ret = platform_driver_register(&ipu_m2m_driver);
+	if (ret)
+		return ret;
+
+	/* the converter has no node of its own, it is a client of the IPU */
+	ipu_m2m_pdev = platform_device_register_full(&info);
+	if (IS_ERR(ipu_m2m_pdev)) {
+		platform_driver_unregister(&ipu_m2m_driver);
+		return PTR_ERR(ipu_m2m_pdev);
+	}
+
+	return 0;
+}
+
+static void __exit ipu_m2m_exit(void)
+{
+	platform_device_unregister(ipu_m2m_pdev);
+	platform_driver_unregister(&ipu_m2m_driver);
+}
+
+module_init(ipu_m2m_init);
+module_exit(ipu_m2m_exit);
+
+MODULE_DESCRIPTION("i.MX IPUv3 V4L2 mem2mem scaler and colour converter");
+MODULE_AUTHOR("NXP Semiconductor");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,569 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <media/v4l2-event.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-dma-contig.h>
+
+#include "mxc_m2m.h"
+
+#define MXC_M2M_MIN_W		16
+#define MXC_M2M_MIN_H		16
+#define MXC_M2M_DEF_W		640
+#define MXC_M2M_DEF_H		480
+
+static inline struct mxc_m2m_ctx *file_to_ctx(struct file *file)
+{
+	return container_of(file->private_data, struct mxc_m2m_ctx, fh);
+}
+
+static const struct mxc_m2m_fmt *mxc_m2m_find_fmt(struct mxc_m2m_dev *m2m,
+						  u32 fourcc, u32 types)
+{
+	unsigned int i;
+
+	for (i = 0; i < m2m->num_formats; i++)
+		if ((m2m->formats[i].types & types) &&
+		    (!fourcc || m2m->formats[i].fourcc == fourcc))
+			return &m2m->formats[i];
+
+	return NULL;
+}
+
+static inline u32 mxc_m2m_types(enum v4l2_buf_type type)
+{
+	return V4L2_TYPE_IS_OUTPUT(type) ? MXC_M2M_SRC : MXC_M2M_DST;
+}
+
+static struct mxc_m2m_q_data *mxc_m2m_q_data(struct mxc_m2m_ctx *ctx,
+					     enum v4l2_buf_type type)
+{
+	return &ctx->q_data[V4L2_TYPE_IS_OUTPUT(type) ?
+			    MXC_M2M_Q_SRC : MXC_M2M_Q_DST];
+}
+
+static void mxc_m2m_fill_pix(const struct mxc_m2m_fmt *fmt,
+			     struct v4l2_pix_format *pix)
+{
+	if (fmt->planar)
+		pix->bytesperline = pix->width;
+	else
+		pix->bytesperline = pix->width * fmt->depth / 8;
+	pix->sizeimage = pix->width * pix->height * fmt->depth / 8;
+}
+
+static int mxc_m2m_querycap(struct file *file, void *priv,
+			    struct v4l2_capability *cap)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_dev *m2m = ctx->m2m;
+
+	strlcpy(cap->driver, m2m->v4l2_dev.name, sizeof(cap->driver));
+	strlcpy(cap->card, m2m->vfd.name, sizeof(cap->card));
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s",
+		 m2m->v4l2_dev.name);
+
+	return 0;
+}
+
+static int mxc_m2m_enum_fmt(struct file *file, void *priv,
+			    struct v4l2_fmtdesc *f)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_dev *m2m = ctx->m2m;
+	u32 types = mxc_m2m_types(f->type);
+	unsigned int i, num = 0;
+
+	for (i = 0; i < m2m->num_formats; i++) {
+		if (!(m2m->formats[i].types & types))
+			continue;
+		if (num++ == f->index) {
+			f->pixelformat = m2m->formats[i].fourcc;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int mxc_m2m_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_q_data *q_data = mxc_m2m_q_data(ctx, f->type);
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+
+	pix->width = q_data->width;
+	pix->height = q_data->height;
+	pix->pixelformat = q_data->fmt->fourcc;
+	pix->field = V4L2_FIELD_NONE;
+	pix->bytesperline = q_data->bytesperline;
+	pix->sizeimage = q_data->sizeimage;
+	pix->colorspace = ctx->colorspace;
+
+	return 0;
+}
+
+static int mxc_m2m_try_fmt(struct file *file, void *priv,
+			   struct v4l2_format *f)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_dev *m2m = ctx->m2m;
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+	u32 types = mxc_m2m_types(f->type);
+	const struct mxc_m2m_fmt *fmt;
+
+	fmt = mxc_m2m_find_fmt(m2m, pix->pixelformat, types);
+	if (!fmt)
+		fmt = mxc_m2m_find_fmt(m2m, 0, types);
+
+	pix->pixelformat = fmt->fourcc;
+	pix->field = V4L2_FIELD_NONE;
+	v4l_bound_align_image(&pix->width, MXC_M2M_MIN_W, m2m->max_width, 3,
+			      &pix->height, MXC_M2M_MIN_H, m2m->max_height, 1,
+			      0);
+	mxc_m2m_fill_pix(fmt, pix);
+
+	/* the colorspace is set by the source and passed through */
+	if (V4L2_TYPE_IS_OUTPUT(f->type)) {
+		if (pix->colorspace == V4L2_COLORSPACE_DEFAULT)
+			pix->colorspace = V4L2_COLORSPACE_REC709;
+	} else {
+		pix->colorspace = ctx->colorspace;
+	}
+
+	return 0;
+}
+
+static int mxc_m2m_s_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_q_data *q_data = mxc_m2m_q_data(ctx, f->type);
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+	struct vb2_queue *vq;
+	int ret;
+
+	vq = v4l2_m2m_get_vq(ctx->fh.m2m_ctx, f->type);
+	if (vb2_is_busy(vq))
+		return -EBUSY;
+
+	ret = mxc_m2m_try_fmt(file, priv, f);
+	if (ret)
+		return ret;
+
+	q_data->fmt = mxc_m2m_find_fmt(ctx->m2m, pix->pixelformat,
+				       mxc_m2m_types(f->type));
+	q_data->width = pix->width;
+	q_data->height = pix->height;
+	q_data->bytesperline = pix->bytesperline;
+	q_data->sizeimage = pix->sizeimage;
+
+	if (V4L2_TYPE_IS_OUTPUT(f->type))
+		ctx->colorspace = pix->colorspace;
+
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops mxc_m2m_ioctl_ops = {
+	.vidioc_querycap		= mxc_m2m_querycap,
+
+	.vidioc_enum_fmt_vid_cap	= mxc_m2m_enum_fmt,
+	.vidioc_g_fmt_vid_cap		= mxc_m2m_g_fmt,
+	.vidioc_try_fmt_vid_cap		= mxc_m2m_try_fmt,
+	.vidioc_s_fmt_vid_cap		= mxc_m2m_s_fmt,
+
+	.vidioc_enum_fmt_vid_out	= mxc_m2m_enum_fmt,
+	.vidioc_g_fmt_vid_out		= mxc_m2m_g_fmt,
+	.vidioc_try_fmt_vid_out		= mxc_m2m_try_fmt,
+	.vidioc_s_fmt_vid_out		= mxc_m2m_s_fmt,
+
+	.vidioc_reqbufs			= v4l2_m2m_ioctl_reqbufs,
+	.vidioc_querybuf		= v4l2_m2m_ioctl_querybuf,
+	.vidioc_qbuf			= v4l2_m2m_ioctl_qbuf,
+	.vidioc_dqbuf			= v4l2_m2m_ioctl_dqbuf,
+	.vidioc_prepare_buf		= v4l2_m2m_ioctl_prepare_buf,
+	.vidioc_create_bufs		= v4l2_m2m_ioctl_create_bufs,
+	.vidioc_expbuf			= v4l2_m2m_ioctl_expbuf,
+
+	.vidioc_streamon		= v4l2_m2m_ioctl_streamon,
+	.vidioc_streamoff		= v4l2_m2m_ioctl_streamoff,
+
+	.vidioc_subscribe_event		= v4l2_ctrl_subscribe_event,
+	.vidioc_unsubscribe_event	= v4l2_event_unsubscribe,
+};
+
+static int mxc_m2m_queue_setup(struct vb2_queue *vq, unsigned int *nbuffers,
+			       unsigned int *nplanes, unsigned int sizes[],
+			       struct device *alloc_devs[])
+{
+	struct mxc_m2m_ctx *ctx = vb2_get_drv_priv(vq);
+	struct mxc_m2m_q_data *q_data = mxc_m2m_q_data(ctx, vq->type);
+
+	if (*nplanes)
+		return sizes[0] < q_data->sizeimage ? -EINVAL : 0;
+
+	*nplanes = 1;
+	sizes[0] = q_data->sizeimage;
+
+	return 0;
+}
+
+static int mxc_m2m_buf_prepare(struct vb2_buffer *vb)
+{
+	struct mxc_m2m_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+	struct mxc_m2m_q_data *q_data = mxc_m2m_q_data(ctx, vb->type);
+
+	if (vb2_plane_size(vb, 0) < q_data->sizeimage)
+		return -EINVAL;
+
+	if (!V4L2_TYPE_IS_OUTPUT(vb->type))
+		vb2_set_plane_payload(vb, 0, q_data->sizeimage);
+
+	return 0;
+}
+
+static void mxc_m2m_buf_queue(struct vb2_buffer *vb)
+{
+	struct mxc_m2m_ctx *ctx = vb2_get_drv_priv(vb->vb2_queue);
+
+	v4l2_m2m_buf_queue(ctx->fh.m2m_ctx, to_vb2_v4l2_buffer(vb));
+}
+
+static void mxc_m2m_return_bufs(struct mxc_m2m_ctx *ctx, u32 type,
+				enum vb2_buffer_state state)
+{
+	struct vb2_v4l2_buffer *vbuf;
+
+	for (;;) {
+		if (V4L2_TYPE_IS_OUTPUT(type))
+			vbuf = v4l2_m2m_src_buf_remove(ctx->fh.m2m_ctx);
+		else
+			vbuf = v4l2_m2m_dst_buf_remove(ctx->fh.m2m_ctx);
+		if (!vbuf)
+			break;
+		v4l2_m2m_buf_done(vbuf, state);
+	}
+}
+
+static int mxc_m2m_start_streaming(struct vb2_queue *q, unsigned int count)
+{
+	struct mxc_m2m_ctx *ctx = vb2_get_drv_priv(q);
+	int ret;
+
+	ret = ctx->m2m->ops->check(ctx);
+	if (ret) {
+		mxc_m2m_return_bufs(ctx, q->type, VB2_BUF_STATE_QUEUED);
+		return ret;
+	}
+
+	mxc_m2m_q_data(ctx, q->type)->sequence = 0;
+
+	return 0;
+}
+
+static void mxc_m2m_stop_streaming(struct vb2_queue *q)
+{
+	struct mxc_m2m_ctx *ctx = vb2_get_drv_priv(q);
+
+	mxc_m2m_return_bufs(ctx, q->type, VB2_BUF_STATE_ERROR);
+}
+
+static const struct vb2_ops mxc_m2m_qops = {
+	.queue_setup		= mxc_m2m_queue_setup,
+	.buf_prepare		= mxc_m2m_buf_prepare,
+	.buf_queue		= mxc_m2m_buf_queue,
+	.start_streaming	= mxc_m2m_start_streaming,
+	.stop_streaming		= mxc_m2m_stop_streaming,
+	.wait_prepare		= vb2_ops_wait_prepare,
+	.wait_finish		= vb2_ops_wait_finish,
+};
+
+static int mxc_m2m_queue_init(void *priv, struct vb2_queue *src_vq,
+			      struct vb2_queue *dst_vq)
+{
+	struct mxc_m2m_ctx *ctx = priv;
+	int ret;
+
+	src_vq->type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	src_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
+	src_vq->drv_priv = ctx;
+	src_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	src_vq->ops = &mxc_m2m_qops;
+	src_vq->mem_ops = &vb2_dma_contig_memops;
+	src_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	src_vq->lock = &ctx->m2m->mutex;
+	src_vq->dev = ctx->m2m->dma_dev;
+
+	ret = vb2_queue_init(src_vq);
+	if (ret)
+		return ret;
+
+	dst_vq->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	dst_vq->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
+	dst_vq->drv_priv = ctx;
+	dst_vq->buf_struct_size = sizeof(struct v4l2_m2m_buffer);
+	dst_vq->ops = &mxc_m2m_qops;
+	dst_vq->mem_ops = &vb2_dma_contig_memops;
+	dst_vq->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	dst_vq->lock = &ctx->m2m->mutex;
+	dst_vq->dev = ctx->m2m->dma_dev;
+
+	return vb2_queue_init(dst_vq);
+}
+
+static int mxc_m2m_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct mxc_m2m_ctx *ctx =
+		container_of(ctrl->handler, struct mxc_m2m_ctx, hdl);
+
+	switch (ctrl->id) {
+	case V4L2_CID_HFLIP:
+		ctx->hflip = ctrl->val;
+		break;
+	case V4L2_CID_VFLIP:
+		ctx->vflip = ctrl->val;
+		break;
+	case V4L2_CID_ROTATE:
+		ctx->rotate = ctrl->val;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops mxc_m2m_ctrl_ops = {
+	.s_ctrl = mxc_m2m_s_ctrl,
+};
+
+static void mxc_m2m_init_q_data(struct mxc_m2m_ctx *ctx, int idx, u32 types)
+{
+	struct mxc_m2m_q_data *q_data = &ctx->q_data[idx];
+	struct v4l2_pix_format pix = {
+		.width = MXC_M2M_DEF_W,
+		.height = MXC_M2M_DEF_H,
+	};
+
+	q_data->fmt = mxc_m2m_find_fmt(ctx->m2m, 0, types);
+	mxc_m2m_fill_pix(q_data->fmt, &pix);
+	q_data->width = pix.width;
+	q_data->height = pix.height;
+	q_data->bytesperline = pix.bytesperline;
+	q_data->sizeimage = pix.sizeimage;
+}
+
+static int mxc_m2m_open(struct file *file)
+{
+	struct mxc_m2m_dev *m2m = video_drvdata(file);
+	struct mxc_m2m_ctx *ctx;
+	int ret;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	if (mutex_lock_interruptible(&m2m->mutex)) {
+		kfree(ctx);
+		return -ERESTARTSYS;
+	}
+
+	v4l2_fh_init(&ctx->fh, video_devdata(file));
+	file->private_data = &ctx->fh;
+	ctx->m2m = m2m;
+	ctx->colorspace = V4L2_COLORSPACE_REC709;
+	mxc_m2m_init_q_data(ctx, MXC_M2M_Q_SRC, MXC_M2M_SRC);
+	mxc_m2m_init_q_data(ctx, MXC_M2M_Q_DST, MXC_M2M_DST);
+
+	v4l2_ctrl_handler_init(&ctx->hdl, 3);
+	v4l2_ctrl_new_std(&ctx->hdl, &mxc_m2m_ctrl_ops, V4L2_CID_HFLIP,
+			  0, 1, 1, 0);
+	v4l2_ctrl_new_std(&ctx->hdl, &mxc_m2m_ctrl_ops, V4L2_CID_VFLIP,
+			  0, 1, 1, 0);
+	v4l2_ctrl_new_std(&ctx->hdl, &mxc_m2m_ctrl_ops, V4L2_CID_ROTATE,
+			  0, 270, 90, 0);
+	if (ctx->hdl.error) {
+		ret = ctx->hdl.error;
+		goto err_hdl;
+	}
+	ctx->fh.ctrl_handler = &ctx->hdl;
+	v4l2_ctrl_handler_setup(&ctx->hdl);
+
+	ctx->fh.m2m_ctx = v4l2_m2m_ctx_init(m2m->m2m_dev, ctx,
+					    mxc_m2m_queue_init);
+	if (IS_ERR(ctx->fh.m2m_ctx)) {
+		ret = PTR_ERR(ctx->fh.m2m_ctx);
+		goto err_hdl;
+	}
+
+	v4l2_fh_add(&ctx->fh);
+	mutex_unlock(&m2m->mutex);
+
+	return 0;
+
+err_hdl:
+	v4l2_ctrl_handler_free(&ctx->hdl);
+	v4l2_fh_exit(&ctx->fh);
+	mutex_unlock(&m2m->mutex);
+	kfree(ctx);
+	return ret;
+}
+
+static int mxc_m2m_release(struct file *file)
+{
+	struct mxc_m2m_ctx *ctx = file_to_ctx(file);
+	struct mxc_m2m_dev *m2m = ctx->m2m;
+
+	mutex_lock(&m2m->mutex);
+	v4l2_m2m_ctx_release(ctx->fh.m2m_ctx);
+	mutex_unlock(&m2m->mutex);
+
+	v4l2_fh_del(&ctx->fh);
+	v4l2_fh_exit(&ctx->fh);
+	v4l2_ctrl_handler_free(&ctx->hdl);
+	kfree(ctx);
+
+	return 0;
+}
+
+static const struct v4l2_file_operations mxc_m2m_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mxc_m2m_open,
+	.release	= mxc_m2m_release,
+	.poll		= v4l2_m2m_fop_poll,
+	.unlocked_ioctl	= video_ioctl2,
+	.mmap		= v4l2_m2m_fop_mmap,
+};
+
+static void mxc_m2m_device_run(void *priv)
+{
+	struct mxc_m2m_ctx *ctx = priv;
+	struct vb2_v4l2_buffer *src, *dst;
+	int ret;
+
+	src = v4l2_m2m_next_src_buf(ctx->fh.m2m_ctx);
+	dst = v4l2_m2m_next_dst_buf(ctx->fh.m2m_ctx);
+
+	ret = ctx->m2m->ops->run(ctx,
+			vb2_dma_contig_plane_dma_addr(&src->vb2_buf, 0),
+			vb2_dma_contig_plane_dma_addr(&dst->vb2_buf, 0));
+	if (ret)
+		mxc_m2m_job_done(ctx, ret);
+}
+
+static void mxc_m2m_job_abort(void *priv)
+{
+	/* a conversion is short and always completes, nothing to cut short */
+}
+
+static const struct v4l2_m2m_ops mxc_m2m_ops = {
+	.device_run	= mxc_m2m_device_run,
+	.job_abort	= mxc_m2m_job_abort,
+};
+
+/**
+ * mxc_m2m_job_done() - finish the conversion started by ops->run()
+ * @ctx: context the conversion was run for
+ * @err: 0 on success, or a negative error code
+ *
+ * May be called from interrupt context.
+ */
+void mxc_m2m_job_done(struct mxc_m2m_ctx *ctx, int err)
+{
+	enum vb2_buffer_state state = err ? VB2_BUF_STATE_ERROR :
+					    VB2_BUF_STATE_DONE;
+	struct vb2_v4l2_buffer *src, *dst;
+
+	src = v4l2_m2m_src_buf_remove(ctx->fh.m2m_ctx);
+	dst = v4l2_m2m_dst_buf_remove(ctx->fh.m2m_ctx);
+
+	dst->vb2_buf.timestamp = src->vb2_buf.timestamp;
+	dst->timecode = src->timecode;
+	dst->field = V4L2_FIELD_NONE;
+	dst->flags &= ~(V4L2_BUF_FLAG_TSTAMP_SRC_MASK |
+			V4L2_BUF_FLAG_TIMECODE);
+	dst->flags |= src->flags & (V4L2_BUF_FLAG_TSTAMP_SRC_MASK |
+				    V4L2_BUF_FLAG_TIMECODE);
+	src->sequence = ctx->q_data[MXC_M2M_Q_SRC].sequence++;
+	dst->sequence = ctx->q_data[MXC_M2M_Q_DST].sequence++;
+
+	v4l2_m2m_buf_done(src, state);
+	v4l2_m2m_buf_done(dst, state);
+	v4l2_m2m_job_finish(ctx->m2m->m2m_dev, ctx->fh.m2m_ctx);
+}
+EXPORT_SYMBOL_GPL(mxc_m2m_job_done);
+
+/**
+ * mxc_m2m_register() - register a mem2mem video device for an engine
+ * @m2m: device with formats, limits, ops and dma_dev filled in
+ * @dev: parent device
+ * @name: driver and video device name
+ */
+int mxc_m2m_register(struct mxc_m2m_dev *m2m, struct device *dev,
+		     const char *name)
+{
+	struct video_device *vfd = &m2m->vfd;
+	int ret;
+
+	mutex_init(&m2m->mutex);
+
+	ret = v4l2_device_register(dev, &m2m->v4l2_dev);
+	if (ret)
+		return ret;
+	strlcpy(m2m->v4l2_dev.name, name, sizeof(m2m->v4l2_dev.name));
+
+	m2m->m2m_dev = v4l2_m2m_init(&mxc_m2m_ops);
+	if (IS_ERR(m2m->m2m_dev)) {
+		ret = PTR_ERR(m2m->m2m_dev);
+		goto err_v4l2;
+	}
+
+	strlcpy(vfd->name, name, sizeof(vfd->name));
+	vfd->fops = &mxc_m2m_fops;
+	vfd->ioctl_ops = &mxc_m2m_ioctl_ops;
+	vfd->release = video_device_release_empty;
+	vfd->lock = &m2m->mutex;
+	vfd->v4l2_dev = &m2m->v4l2_dev;
+	vfd->vfl_dir = VFL_DIR_M2M;
+	vfd->device_caps = V4L2_CAP_VIDEO_M2M | V4L2_CAP_STREAMING;
+	video_set_drvdata(vfd, m2m);
+
+	ret = video_register_device(vfd, VFL_TYPE_GRABBER, -1);
+	if (ret)
+		goto err_m2m;
+
+	v4l2_info(&m2m->v4l2_dev, "registered as /dev/video%d\n", vfd->num);
+
+	return 0;
+
+err_m2m:
+	v4l2_m2m_release(m2m->m2m_dev);
+err_v4l2:
+	v4l2_device_unregister(&m2m->v4l2_dev);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(mxc_m2m_register);
+
+void mxc_m2m_unregister(struct mxc_m2m_dev *m2m)
+{
+	video_unregister_device(&m2m->vfd);
+	v4l2_m2m_release(m2m->m2m_dev);
+	v4l2_device_unregister(&m2m->v4l2_dev);
+}
+EXPORT_SYMBOL_GPL(mxc_m2m_unregister);
+
+MODULE_DESCRIPTION("i.MX V4L2 mem2mem scaler and colour converter core");
+MODULE_AUTHOR("NXP Semiconductor");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Common V4L2 mem2mem plumbing for the i.MX scaling and colour conversion
+ * engines. The engine drivers only describe their formats and limits and
+ * run one conversion at a time between two contiguous buffers.
+ */
+
+#ifndef __MXC_M2M_H__
+#define __MXC_M2M_H__
+
+#include <linux/mutex.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-fh.h>
+#include <media/v4l2-mem2mem.h>
+
+/* the format can be converted from (output queue) or to (capture queue) */
+#define MXC_M2M_SRC		(1 << 0)
+#define MXC_M2M_DST		(1 << 1)
+
+struct mxc_m2m_fmt {
+	u32	fourcc;
+	/* engine's own code for the format */
+	u32	hw_fmt;
+	/* bits per pixel, over all planes */
+	u8	depth;
+	/* planar and semi-planar formats have a luma stride of width */
+	bool	planar;
+	u32	types;
+};
+
+enum {
+	MXC_M2M_Q_SRC = 0,
+	MXC_M2M_Q_DST = 1,
+};
+
+struct mxc_m2m_q_data {
+	const struct mxc_m2m_fmt	*fmt;
+	unsigned int			width;
+	unsigned int			height;
+	unsigned int			bytesperline;
+	unsigned int			sizeimage;
+	unsigned int			sequence;
+};
+
+struct mxc_m2m_dev;
+
+struct mxc_m2m_ctx {
+	struct v4l2_fh			fh;
+	struct mxc_m2m_dev		*m2m;
+	struct v4l2_ctrl_handler	hdl;
+	struct mxc_m2m_q_data		q_data[2];
+	enum v4l2_colorspace		colorspace;
+	/* degrees, a multiple of 90 */
+	int				rotate;
+	bool				hflip;
+	bool				vflip;
+};
+
+struct mxc_m2m_ops {
+	/* tell whether the engine can do the context's conversion */
+	int (*check)(struct mxc_m2m_ctx *ctx);
+	/* start a conversion, and report its end with mxc_m2m_job_done() */
+	int (*run)(struct mxc_m2m_ctx *ctx, dma_addr_t src, dma_addr_t dst);
+};
+
+struct mxc_m2m_dev {
+	struct v4l2_device		v4l2_dev;
+	struct video_device		vfd;
+	struct v4l2_m2m_dev		*m2m_dev;
+	/* serializes the ioctls and the queues */
+	struct mutex			mutex;
+	/* device whose DMA buffers are allocated or imported for */
+	struct device			*dma_dev;
+
+	const struct mxc_m2m_fmt	*formats;
+	unsigned int			num_formats;
+	unsigned int			max_width;
+	unsigned int			max_height;
+	const struct mxc_m2m_ops	*ops;
+};
+
+int mxc_m2m_register(struct mxc_m2m_dev *m2m, struct device *dev,
+		     const char *name);
+void mxc_m2m_unregister(struct mxc_m2m_dev *m2m);
+void mxc_m2m_job_done(struct mxc_m2m_ctx *ctx, int err);
+
+#endif
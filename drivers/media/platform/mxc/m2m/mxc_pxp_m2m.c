@@ -0,0 +1,282 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * V4L2 mem2mem device on top of the PXP, driven through its dmaengine
+ * channel like the PXP V4L2 output driver and /dev/pxp_device.
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/module.h>
+#include <linux/platform_data/dma-imx.h>
+#include <linux/platform_device.h>
+#include <linux/pxp_dma.h>
+#include <linux/scatterlist.h>
+
+#include "mxc_m2m.h"
+
+#define DRIVER_NAME		"mxc-pxp-m2m"
+
+#define PXP_M2M_MAX_W		4096
+#define PXP_M2M_MAX_H		4096
+/* the scaler does not go below 1/16 */
+#define PXP_M2M_MAX_DOWNSCALE	16
+
+#define PXP_M2M_FMT(_fourcc, _hw_fmt, _depth, _planar, _types)	\
+	{							\
+		.fourcc	= _fourcc,				\
+		.hw_fmt	= _hw_fmt,				\
+		.depth	= _depth,				\
+		.planar	= _planar,				\
+		.types	= _types,				\
+	}
+
+#define SRC		MXC_M2M_SRC
+#define DST		MXC_M2M_DST
+
+static const struct mxc_m2m_fmt pxp_m2m_formats[] = {
+	PXP_M2M_FMT(V4L2_PIX_FMT_RGB565, PXP_PIX_FMT_RGB565, 16, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_RGB555, PXP_PIX_FMT_RGB555, 16, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_XRGB32, PXP_PIX_FMT_XRGB32, 32, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_RGB32, PXP_PIX_FMT_XRGB32, 32, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_RGB24, PXP_PIX_FMT_RGB24, 24, false, DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_UYVY, PXP_PIX_FMT_UYVY, 16, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_VYUY, PXP_PIX_FMT_VYUY, 16, false,
+		    SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_YUYV, PXP_PIX_FMT_YUYV, 16, false, SRC),
+	PXP_M2M_FMT(V4L2_PIX_FMT_YVYU, PXP_PIX_FMT_YVYU, 16, false, SRC),
+	PXP_M2M_FMT(V4L2_PIX_FMT_NV12, PXP_PIX_FMT_NV12, 12, true, SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_NV21, PXP_PIX_FMT_NV21, 12, true, SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_NV16, PXP_PIX_FMT_NV16, 16, true, SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_NV61, PXP_PIX_FMT_NV61, 16, true, SRC | DST),
+	PXP_M2M_FMT(V4L2_PIX_FMT_YUV420, PXP_PIX_FMT_YUV420P, 12, true, SRC),
+	PXP_M2M_FMT(V4L2_PIX_FMT_YVU420, PXP_PIX_FMT_YVU420P, 12, true, SRC),
+	PXP_M2M_FMT(V4L2_PIX_FMT_YUV422P, PXP_PIX_FMT_YUV422P, 16, true, SRC),
+	PXP_M2M_FMT(V4L2_PIX_FMT_GREY, PXP_PIX_FMT_GREY, 8, false, SRC | DST),
+};
+
+struct pxp_m2m {
+	struct mxc_m2m_dev	m2m;
+	struct dma_chan		*chan;
+	struct mxc_m2m_ctx	*ctx;
+};
+
+static struct platform_device *pxp_m2m_pdev;
+
+static int pxp_m2m_check(struct mxc_m2m_ctx *ctx)
+{
+	struct mxc_m2m_q_data *src = &ctx->q_data[MXC_M2M_Q_SRC];
+	struct mxc_m2m_q_data *dst = &ctx->q_data[MXC_M2M_Q_DST];
+	unsigned int w = dst->width, h = dst->height;
+
+	/* the output size is given after rotation */
+	if (ctx->rotate % 180)
+		swap(w, h);
+
+	if (src->width > w * PXP_M2M_MAX_DOWNSCALE ||
+	    src->height > h * PXP_M2M_MAX_DOWNSCALE) {
+		v4l2_dbg(1, 0, &ctx->m2m->v4l2_dev,
+			 "%ux%u to %ux%u is beyond the scaler\n",
+			 src->width, src->height, w, h);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void pxp_m2m_dma_done(void *arg)
+{
+	struct pxp_m2m *pxp = arg;
+
+	mxc_m2m_job_done(pxp->ctx, 0);
+}
+
+static void pxp_m2m_fill_layer(struct pxp_layer_param *layer,
+			       struct mxc_m2m_q_data *q_data, dma_addr_t paddr)
+{
+	memset(layer, 0, sizeof(*layer));
+	layer->width = q_data->width;
+	layer->height = q_data->height;
+	layer->stride = q_data->width;
+	layer->pixel_fmt = q_data->fmt->hw_fmt;
+	layer->color_key = -1;
+	layer->paddr = paddr;
+}
+
+static int pxp_m2m_run(struct mxc_m2m_ctx *ctx, dma_addr_t src,
+		       dma_addr_t dst)
+{
+	struct pxp_m2m *pxp = container_of(ctx->m2m, struct pxp_m2m, m2m);
+	struct mxc_m2m_q_data *s_data = &ctx->q_data[MXC_M2M_Q_SRC];
+	struct mxc_m2m_q_data *d_data = &ctx->q_data[MXC_M2M_Q_DST];
+	struct dma_async_tx_descriptor *txd;
+	struct pxp_proc_data *proc_data;
+	struct pxp_tx_desc *desc;
+	struct scatterlist sg[3];
+	dma_cookie_t cookie;
+
+	/* S0, output and overlay; the addresses go in the descriptors */
+	sg_init_table(sg, 3);
+	txd = pxp->chan->device->device_prep_slave_sg(pxp->chan, sg, 3,
+						      DMA_TO_DEVICE,
+						      DMA_PREP_INTERRUPT,
+						      NULL);
+	if (!txd)
+		return -EIO;
+
+	txd->callback = pxp_m2m_dma_done;
+	txd->callback_param = pxp;
+
+	desc = to_tx_desc(txd);
+	proc_data = &desc->proc_data;
+	memset(proc_data, 0, sizeof(*proc_data));
+	proc_data->srect.width = s_data->width;
+	proc_data->srect.height = s_data->height;
+	proc_data->drect.width = d_data->width;
+	proc_data->drect.height = d_data->height;
+	proc_data->rotate = ctx->rotate;
+	proc_data->hflip = ctx->hflip;
+	proc_data->vflip = ctx->vflip;
+	if (ctx->rotate % 180)
+		proc_data->scaling = s_data->width != d_data->height ||
+				     s_data->height != d_data->width;
+	else
+		proc_data->scaling = s_data->width != d_data->width ||
+				     s_data->height != d_data->height;
+	proc_data->lut_transform = PXP_LUT_NONE;
+	pxp_m2m_fill_layer(&desc->layer_param.s0_param, s_data, src);
+
+	desc = desc->next;
+	pxp_m2m_fill_layer(&desc->layer_param.out_param, d_data, dst);
+
+	/* no overlay */
+	desc = desc->next;
+	memset(&desc->layer_param.ol_param, 0,
+	       sizeof(desc->layer_param.ol_param));
+
+	pxp->ctx = ctx;
+	cookie = txd->tx_submit(txd);
+	if (cookie < 0)
+		return cookie;
+
+	dma_async_issue_pending(pxp->chan);
+
+	return 0;
+}
+
+static const struct mxc_m2m_ops pxp_m2m_ops = {
+	.check	= pxp_m2m_check,
+	.run	= pxp_m2m_run,
+};
+
+static bool pxp_m2m_chan_filter(struct dma_chan *chan, void *arg)
+{
+	return imx_dma_is_pxp(chan);
+}
+
+static int pxp_m2m_probe(struct platform_device *pdev)
+{
+	struct pxp_m2m *pxp;
+	dma_cap_mask_t mask;
+	int ret;
+
+	pxp = devm_kzalloc(&pdev->dev, sizeof(*pxp), GFP_KERNEL);
+	if (!pxp)
+		return -ENOMEM;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_SLAVE, mask);
+	dma_cap_set(DMA_PRIVATE, mask);
+	pxp->chan = dma_request_channel(mask, pxp_m2m_chan_filter, NULL);
+	if (!pxp->chan)
+		return -EPROBE_DEFER;
+
+	/* buffers are fetched by the PXP itself */
+	pxp->m2m.dma_dev = pxp->chan->device->dev;
+	pxp->m2m.formats = pxp_m2m_formats;
+	pxp->m2m.num_formats = ARRAY_SIZE(pxp_m2m_formats);
+	pxp->m2m.max_width = PXP_M2M_MAX_W;
+	pxp->m2m.max_height = PXP_M2M_MAX_H;
+	pxp->m2m.ops = &pxp_m2m_ops;
+
+	ret = mxc_m2m_register(&pxp->m2m, &pdev->dev, DRIVER_NAME);
+	if (ret) {
+		dma_release_channel(pxp->chan);
+		return ret;
+	}
+
+	platform_set_drvdata(pdev, pxp);
+
+	return 0;
+}
+
+static int pxp_m2m_remove(struct platform_device *pdev)
+{
+	struct pxp_m2m *pxp = platform_get_drvdata(pdev);
+
+	mxc_m2m_unregister(&pxp->m2m);
+	dma_release_channel(pxp->chan);
+
+	return 0;
+}
+
+static struct platform_driver pxp_m2m_driver = {
+	.driver = {
+		.name = DRIVER_NAME,
+	},
+	.probe = pxp_m2m_probe,
+	.remove = pxp_m2m_remove,
+};
+
+static int __init pxp_m2m_init(void)
+{
+	struct platform_device_info info = {
+		.name = DRIVER_NAME,
+		.id = PLATFORM_DEVID_NONE,
+		.dma_mask = DMA_BIT_MASK(32),
+	};
+	int ret;
+
+	ret = platform_driver_register(&pxp_m2m_driver);
+	if (ret)
+		return ret;
+
+	/* a client of the PXP dmaengine driver, it has no node of its own */
+	pxp_m2m_pdev = platform_device_register_full(&info);
+	if (IS_ERR(pxp_m2m_pdev)) {
+		platform_driver_unregister(&pxp_m2m_driver);
+		return PTR_ERR(pxp_m2m_pdev);
+	}
+
+	return 0;
+}
+
+static void __exit pxp_m2m_exit(void)
+{
+	platform_device_unregister(pxp_m2m_pdev);
+	platform_driver_unregister(&pxp_m2m_driver);
+}
+
+module_init(pxp_m2m_init);
+module_exit(pxp_m2m_exit);
+
+MODULE_DESCRIPTION("i.MX PXP V4L2 mem2mem scaler and colour converter");
+MODULE_AUTHOR("NXP Semiconductor");
+MODULE_LICENSE("GPL");
@@ -295,6 +295,19 @@ struct mx6s_csi_mux {
 	u8 req_bit;
 };
 
+/* frame loss accounting, reset on every stream start */
+struct mx6s_csi_stats {
+	u64	frames;		/* returned to user space */
+	u32	drop_nobuf;	/* no queued buffer, written to discard */
+	u32	drop_late;	/* irq served after both FB1/FB2 completed */
+	u32	drop_missed;	/* gap in the sensor frame interval */
+	u32	rx_overflow;
+	u32	hresp_err;
+	u32	addr_ch_err;
+	u64	last_drop_ns;
+	u64	last_frame_ns;
+};
+
 struct mx6s_csi_dev {
 	struct device		*dev;
 	struct video_device *vdev;
@@ -323,6 +336,8 @@ struct mx6s_csi_dev {
 	u32 mbus_code;
 
 	unsigned int frame_count;
+	u64 frame_interval_ns;
+	struct mx6s_csi_stats stats;
 
 	struct list_head	capture;
 	struct list_head	active_bufs;
@@ -874,6 +889,28 @@ static int mx6s_configure_csi(struct mx6s_csi_dev *csi_dev)
 	return 0;
 }
 
+/*
+ * The sensor's nominal frame interval lets the irq handler tell a late
+ * interrupt from frames the CSI never reported, so that sequence
+ * numbers keep counting real frames.
+ */
+static void mx6s_csi_get_frame_interval(struct mx6s_csi_dev *csi_dev)
+{
+	struct v4l2_streamparm parm = {
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+	};
+	struct v4l2_fract *tpf = &parm.parm.capture.timeperframe;
+
+	csi_dev->frame_interval_ns = 0;
+	if (v4l2_subdev_call(csi_dev->sd, video, g_parm, &parm) < 0)
+		return;
+
+	if (tpf->numerator && tpf->denominator)
+		csi_dev->frame_interval_ns =
+			div_u64((u64)tpf->numerator * NSEC_PER_SEC,
+				tpf->denominator);
+}
+
 static int mx6s_start_streaming(struct vb2_queue *vq, unsigned int count)
 {
 	struct mx6s_csi_dev *csi_dev = vb2_get_drv_priv(vq);
@@ -885,6 +922,8 @@ static int mx6s_start_streaming(struct vb2_queue *vq, unsigned int count)
 	if (count < 2)
 		return -ENOBUFS;
 
+	mx6s_csi_get_frame_interval(csi_dev);
+
 	/*
 	 * I didn't manage to properly enable/disable
 	 * a per frame basis during running transfers,
@@ -902,6 +941,9 @@ static int mx6s_start_streaming(struct vb2_queue *vq, unsigned int count)
 
 	spin_lock_irqsave(&csi_dev->slock, flags);
 
+	csi_dev->frame_count = 0;
+	memset(&csi_dev->stats, 0, sizeof(csi_dev->stats));
+
 	csi_dev->buf_discard[0].discard = true;
 	list_add_tail(&csi_dev->buf_discard[0].queue,
 		      &csi_dev->discard);
@@ -987,11 +1029,34 @@ static struct vb2_ops mx6s_videobuf_ops = {
 	.stop_streaming	 = mx6s_stop_streaming,
 };
 
+/*
+ * Account for frames the sensor sent but the CSI never reported, from
+ * the gap between two consecutive frame done interrupts.
+ */
+static void mx6s_csi_check_interval(struct mx6s_csi_dev *csi_dev, u64 ts)
+{
+	struct mx6s_csi_stats *stats = &csi_dev->stats;
+	u64 interval = csi_dev->frame_interval_ns;
+	u64 delta;
+	u32 missed;
+
+	if (interval && stats->last_frame_ns) {
+		delta = ts - stats->last_frame_ns;
+		if (delta > interval + interval / 2) {
+			missed = div64_u64(delta + interval / 2, interval) - 1;
+			stats->drop_missed += missed;
+			stats->last_drop_ns = ts;
+			csi_dev->frame_count += missed;
+		}
+	}
+	stats->last_frame_ns = ts;
+}
+
 static void mx6s_csi_frame_done(struct mx6s_csi_dev *csi_dev,
-		int bufnum, bool err)
+		int bufnum, bool err, u64 ts)
 {
-	struct mx6s_buf_internal *ibuf;
-	struct mx6s_buffer *buf;
+	struct mx6s_buf_internal *ibuf, *next;
+	struct mx6s_buffer *buf = NULL;
 	struct vb2_buffer *vb;
 	unsigned long phys;
 
@@ -1004,6 +1069,8 @@ static void mx6s_csi_frame_done(struct mx6s_csi_dev *csi_dev,
 		 * Just return it to the discard queue.
 		 */
 		list_move_tail(csi_dev->active_bufs.next, &csi_dev->discard);
+		csi_dev->stats.drop_nobuf++;
+		csi_dev->stats.last_drop_ns = ts;
 	} else {
 		buf = mx6s_ibuf_to_buf(ibuf);
 
@@ -1020,53 +1087,60 @@ static void mx6s_csi_frame_done(struct mx6s_csi_dev *csi_dev,
 					csi_read(csi_dev, CSI_CSIDMASA_FB1));
 			}
 		}
-		dev_dbg(csi_dev->dev, "%s (vb=0x%p) 0x%p %lu\n", __func__, vb,
-				vb2_plane_vaddr(vb, 0),
-				vb2_get_plane_payload(vb, 0));
 
 		list_del_init(&buf->internal.queue);
-		vb->timestamp =ktime_get_ns();
-		to_vb2_v4l2_buffer(vb)->sequence = csi_dev->frame_count;
-		if (err)
-			vb2_buffer_done(vb, VB2_BUF_STATE_ERROR);
-		else
-			vb2_buffer_done(vb, VB2_BUF_STATE_DONE);
 	}
 
-	csi_dev->frame_count++;
+	/*
+	 * Hand the next buffer to the DMA before completing this one, the
+	 * CSI is already filling the other FB and this address has to be
+	 * in place by the time it switches back.
+	 */
+	if (!list_empty(&csi_dev->capture)) {
+		next = list_first_entry(&csi_dev->capture,
+					struct mx6s_buf_internal, queue);
+		next->bufnum = bufnum;
+		list_move_tail(csi_dev->capture.next, &csi_dev->active_bufs);
 
-	/* Config discard buffer to active_bufs */
-	if (list_empty(&csi_dev->capture)) {
-		if (list_empty(&csi_dev->discard)) {
-			dev_warn(csi_dev->dev,
-					"%s: trying to access empty discard list\n",
-					__func__);
-			return;
-		}
+		vb = &mx6s_ibuf_to_buf(next)->vb.vb2_buf;
+		vb->state = VB2_BUF_STATE_ACTIVE;
 
-		ibuf = list_first_entry(&csi_dev->discard,
+		phys = vb2_dma_contig_plane_dma_addr(vb, 0);
+		mx6s_update_csi_buf(csi_dev, phys, bufnum);
+	} else if (!list_empty(&csi_dev->discard)) {
+		/* Config discard buffer to active_bufs */
+		next = list_first_entry(&csi_dev->discard,
 					struct mx6s_buf_internal, queue);
-		ibuf->bufnum = bufnum;
-
+		next->bufnum = bufnum;
 		list_move_tail(csi_dev->discard.next, &csi_dev->active_bufs);
 
 		mx6s_update_csi_buf(csi_dev,
 					csi_dev->discard_buffer_dma, bufnum);
-		return;
+	} else {
+		dev_warn(csi_dev->dev,
+				"%s: trying to access empty discard list\n",
+				__func__);
 	}
 
-	buf = list_first_entry(&csi_dev->capture, struct mx6s_buffer,
-			       internal.queue);
-
-	buf->internal.bufnum = bufnum;
+	mx6s_csi_check_interval(csi_dev, ts);
 
-	list_move_tail(csi_dev->capture.next, &csi_dev->active_bufs);
+	if (buf) {
+		vb = &buf->vb.vb2_buf;
+		dev_dbg(csi_dev->dev, "%s (vb=0x%p) 0x%p %lu\n", __func__, vb,
+				vb2_plane_vaddr(vb, 0),
+				vb2_get_plane_payload(vb, 0));
 
-	vb = &buf->vb.vb2_buf;
-	vb->state = VB2_BUF_STATE_ACTIVE;
+		vb->timestamp = ts;
+		to_vb2_v4l2_buffer(vb)->sequence = csi_dev->frame_count;
+		if (err) {
+			vb2_buffer_done(vb, VB2_BUF_STATE_ERROR);
+		} else {
+			vb2_buffer_done(vb, VB2_BUF_STATE_DONE);
+			csi_dev->stats.frames++;
+		}
+	}
 
-	phys = vb2_dma_contig_plane_dma_addr(vb, 0);
-	mx6s_update_csi_buf(csi_dev, phys, bufnum);
+	csi_dev->frame_count++;
 }
 
 static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
@@ -1074,6 +1148,7 @@ static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
 	struct mx6s_csi_dev *csi_dev =  data;
 	unsigned long status;
 	u32 cr3, cr18;
+	u64 ts = ktime_get_ns();
 
 	spin_lock(&csi_dev->slock);
 
@@ -1091,6 +1166,8 @@ static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
 
 	if (status & BIT_RFF_OR_INT) {
 		dev_warn(csi_dev->dev, "%s Rx fifo overflow\n", __func__);
+		csi_dev->stats.rx_overflow++;
+		csi_dev->stats.last_drop_ns = ts;
 		if (*csi_dev->rx_fifo_rst)
 			csi_error_recovery(csi_dev);
 	}
@@ -1098,6 +1175,8 @@ static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
 	if (status & BIT_HRESP_ERR_INT) {
 		dev_warn(csi_dev->dev, "%s Hresponse error detected\n",
 			__func__);
+		csi_dev->stats.hresp_err++;
+		csi_dev->stats.last_drop_ns = ts;
 		csi_error_recovery(csi_dev);
 	}
 
@@ -1116,6 +1195,8 @@ static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
 		cr18 |= BIT_CSI_ENABLE;
 		csi_write(csi_dev, cr18, CSI_CSICR18);
 
+		csi_dev->stats.addr_ch_err++;
+		csi_dev->stats.last_drop_ns = ts;
 		pr_debug("base address switching Change Err.\n");
 	}
 
@@ -1129,10 +1210,14 @@ static irqreturn_t mx6s_csi_irq_handler(int irq, void *data)
 		 * new base address.
 		 * PDM TKT230775 */
 		pr_debug("Skip two frames\n");
+		csi_dev->stats.drop_late += 2;
+		csi_dev->stats.last_drop_ns = ts;
+		csi_dev->stats.last_frame_ns = ts;
+		csi_dev->frame_count += 2;
 	} else if (status & BIT_DMA_TSF_DONE_FB1) {
-		mx6s_csi_frame_done(csi_dev, 0, false);
+		mx6s_csi_frame_done(csi_dev, 0, false, ts);
 	} else if (status & BIT_DMA_TSF_DONE_FB2) {
-		mx6s_csi_frame_done(csi_dev, 1, false);
+		mx6s_csi_frame_done(csi_dev, 1, false, ts);
 	}
 
 	spin_unlock(&csi_dev->slock);
@@ -1777,6 +1862,36 @@ static int mx6sx_register_subdevs(struct mx6s_csi_dev *csi_dev)
 	return ret;
 }
 
+static ssize_t frame_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct v4l2_device *v4l2_dev = dev_get_drvdata(dev);
+	struct mx6s_csi_dev *csi_dev =
+		container_of(v4l2_dev, struct mx6s_csi_dev, v4l2_dev);
+	struct mx6s_csi_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&csi_dev->slock, flags);
+	stats = csi_dev->stats;
+	spin_unlock_irqrestore(&csi_dev->slock, flags);
+
+	return sprintf(buf,
+		       "frames: %llu\n"
+		       "interval_ns: %llu\n"
+		       "drop_nobuf: %u\n"
+		       "drop_late: %u\n"
+		       "drop_missed: %u\n"
+		       "rx_overflow: %u\n"
+		       "hresp_err: %u\n"
+		       "addr_ch_err: %u\n"
+		       "last_drop_ns: %llu\n",
+		       stats.frames, csi_dev->frame_interval_ns,
+		       stats.drop_nobuf, stats.drop_late, stats.drop_missed,
+		       stats.rx_overflow, stats.hresp_err, stats.addr_ch_err,
+		       stats.last_drop_ns);
+}
+static DEVICE_ATTR_RO(frame_stats);
+
 static int mx6s_csi_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -1901,6 +2016,9 @@ static int mx6s_csi_probe(struct platform_device *pdev)
 		  "capture device registered as /dev/video%d\n",
 		  csi_dev->vdev->num);
 
+	if (device_create_file(dev, &dev_attr_frame_stats))
+		dev_warn(dev, "failed to create frame_stats attribute\n");
+
 	pm_runtime_enable(csi_dev->dev);
 	return 0;
 
@@ -1917,6 +2035,7 @@ static int mx6s_csi_remove(struct platform_device *pdev)
 	struct mx6s_csi_dev *csi_dev =
 				container_of(v4l2_dev, struct mx6s_csi_dev, v4l2_dev);
 
+	device_remove_file(&pdev->dev, &dev_attr_frame_stats);
 	v4l2_async_notifier_unregister(&csi_dev->subdev_notifier);
 
 	video_unregister_device(csi_dev->vdev);
@@ -1 +1,4 @@
 int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req);
+int mmc_blk_cqe_issue_rq(struct mmc_queue *mq, struct request *req);
+void mmc_blk_cqe_complete_rq(struct mmc_queue *mq, struct request *req);
+void mmc_blk_cqe_recovery(struct mmc_queue *mq);
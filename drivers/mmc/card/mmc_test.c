@@ -23,6 +23,9 @@
 #include <linux/uaccess.h>
 #include <linux/seq_file.h>
 #include <linux/module.h>
+#include <linux/pm_runtime.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -2544,6 +2547,688 @@ static int mmc_test_cmds_during_write_cmd23_nonblock(struct mmc_test_card *test)
 	return mmc_test_cmds_during_tfr(test, 1, 1, 1);
 }
 
+/*
+ * Random 4 KiB I/O, optionally several requests deep through the command
+ * queue engine, with every request timed for the latency percentiles.
+ */
+#define MMC_TEST_RND_IO_SZ	4096
+#define MMC_TEST_RND_IO_SECS	10
+#define MMC_TEST_MAX_QD		32
+/* Requests timed one by one; those after still count towards the IOPS */
+#define MMC_TEST_LAT_SAMPLES	(64 * 1024)
+#define MMC_TEST_CQE_TIMEOUT_MS	2000
+
+static unsigned int queue_depth = MMC_TEST_MAX_QD;
+module_param(queue_depth, uint, 0644);
+MODULE_PARM_DESC(queue_depth,
+		 "Requests kept in flight by the queued random I/O test");
+
+static unsigned int read_percent = 70;
+module_param(read_percent, uint, 0644);
+MODULE_PARM_DESC(read_percent, "Share of reads in the mixed random I/O tests");
+
+struct mmc_test_rnd_io;
+
+/**
+ * struct mmc_test_rnd_slot - one request of a random I/O test.
+ * @mrq: CQE request
+ * @data: data of @mrq
+ * @sg: single entry scatterlist over @page
+ * @page: transfer buffer
+ * @start: when the request was started
+ * @io: test the slot belongs to
+ */
+struct mmc_test_rnd_slot {
+	struct mmc_request mrq;
+	struct mmc_data data;
+	struct scatterlist sg;
+	struct page *page;
+	ktime_t start;
+	struct mmc_test_rnd_io *io;
+};
+
+/**
+ * struct mmc_test_rnd_io - random I/O test state.
+ * @read_pct: share of reads, in percent
+ * @depth: number of requests kept in flight
+ * @reads: completed reads
+ * @writes: completed writes
+ * @lat: request latencies in microseconds
+ * @nlat: number of entries in @lat
+ * @done: bitmap of slots whose CQE request completed
+ * @recovery: the CQE asked for recovery
+ * @wq: woken on completion and on @recovery
+ * @slot: requests, one per tag
+ */
+struct mmc_test_rnd_io {
+	unsigned int read_pct;
+	unsigned int depth;
+	unsigned int reads;
+	unsigned int writes;
+	u32 *lat;
+	unsigned int nlat;
+	unsigned long done;
+	bool recovery;
+	wait_queue_head_t wq;
+	struct mmc_test_rnd_slot slot[MMC_TEST_MAX_QD];
+};
+
+static int mmc_test_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 mmc_test_lat_pct(const u32 *lat, unsigned int n,
+			    unsigned int permille)
+{
+	return lat[(n - 1) * permille / 1000];
+}
+
+/*
+ * Print the latency percentiles of n samples, sorting them in place.
+ */
+static void mmc_test_print_lat(struct mmc_test_card *test, const char *what,
+			       u32 *lat, unsigned int n)
+{
+	if (!n)
+		return;
+
+	sort(lat, n, sizeof(*lat), mmc_test_cmp_u32, NULL);
+
+	pr_info("%s: %s latency: min %u us, p50 %u us, p90 %u us, "
+		"p99 %u us, p99.9 %u us, max %u us\n",
+		mmc_hostname(test->card->host), what, lat[0],
+		mmc_test_lat_pct(lat, n, 500), mmc_test_lat_pct(lat, n, 900),
+		mmc_test_lat_pct(lat, n, 990), mmc_test_lat_pct(lat, n, 999),
+		lat[n - 1]);
+}
+
+/*
+ * Print and save the rate of count transfers of sz bytes each.
+ */
+static void mmc_test_print_iops(struct mmc_test_card *test, const char *what,
+				unsigned int count, unsigned int sz,
+				struct timespec *ts1, struct timespec *ts2)
+{
+	unsigned int rate, iops;
+	struct timespec ts;
+
+	ts = timespec_sub(*ts2, *ts1);
+
+	rate = mmc_test_rate((uint64_t)count * sz, &ts);
+	iops = mmc_test_rate(count * 100, &ts); /* I/O ops per sec x 100 */
+
+	pr_info("%s: %s: %u x %u KiB took %lu.%09lu seconds "
+		"(%u kB/s, %u KiB/s, %u.%02u IOPS)\n",
+		mmc_hostname(test->card->host), what, count, sz >> 10,
+		(unsigned long)ts.tv_sec, (unsigned long)ts.tv_nsec,
+		rate / 1000, rate / 1024, iops / 100, iops % 100);
+
+	mmc_test_save_transfer_result(test, count, sz >> 9, ts, rate, iops);
+}
+
+/*
+ * A random 4 KiB aligned address in the second quarter of the card.
+ */
+static unsigned int mmc_test_rnd_io_addr(struct mmc_test_card *test)
+{
+	unsigned int ssz = MMC_TEST_RND_IO_SZ >> 9;
+	unsigned int rnd_addr = mmc_test_capacity(test->card) / 4;
+	unsigned int pref_erase = max(test->card->pref_erase, ssz);
+
+	rnd_addr &= ~(ssz - 1);
+
+	return rnd_addr + pref_erase * mmc_test_rnd_num(rnd_addr / pref_erase) +
+	       ssz * mmc_test_rnd_num(pref_erase / ssz);
+}
+
+static void mmc_test_rnd_io_account(struct mmc_test_rnd_io *io,
+				    struct mmc_test_rnd_slot *slot, int write)
+{
+	if (io->nlat < MMC_TEST_LAT_SAMPLES)
+		io->lat[io->nlat++] = ktime_us_delta(ktime_get(), slot->start);
+
+	if (write)
+		io->writes++;
+	else
+		io->reads++;
+}
+
+static int mmc_test_rnd_io_sync(struct mmc_test_card *test,
+				struct mmc_test_rnd_io *io,
+				struct timespec *ts1, struct timespec *ts2)
+{
+	struct mmc_test_rnd_slot *slot = &io->slot[0];
+	struct timespec ts;
+	int write, ret;
+
+	getnstimeofday(ts1);
+	do {
+		write = mmc_test_rnd_num(100) >= io->read_pct;
+		slot->start = ktime_get();
+		ret = mmc_test_simple_transfer(test, &slot->sg, 1,
+					       mmc_test_rnd_io_addr(test),
+					       MMC_TEST_RND_IO_SZ >> 9, 512,
+					       write);
+		if (ret)
+			return ret;
+		mmc_test_rnd_io_account(io, slot, write);
+
+		getnstimeofday(ts2);
+		ts = timespec_sub(*ts2, *ts1);
+	} while (ts.tv_sec < MMC_TEST_RND_IO_SECS);
+
+	return 0;
+}
+
+static void mmc_test_rnd_io_req_done(struct mmc_request *mrq)
+{
+	struct mmc_test_rnd_slot *slot = container_of(mrq,
+						      struct mmc_test_rnd_slot,
+						      mrq);
+
+	set_bit(mrq->tag, &slot->io->done);
+	wake_up(&slot->io->wq);
+}
+
+static void mmc_test_rnd_io_recovery_notifier(struct mmc_request *mrq)
+{
+	struct mmc_test_rnd_slot *slot = container_of(mrq,
+						      struct mmc_test_rnd_slot,
+						      mrq);
+
+	slot->io->recovery = true;
+	wake_up(&slot->io->wq);
+}
+
+static int mmc_test_rnd_io_start(struct mmc_test_card *test,
+				 struct mmc_test_rnd_slot *slot, int tag)
+{
+	struct mmc_card *card = test->card;
+	struct mmc_data *data = &slot->data;
+
+	memset(&slot->mrq, 0, sizeof(slot->mrq));
+	memset(data, 0, sizeof(*data));
+
+	data->blk_addr = mmc_test_rnd_io_addr(test);
+	if (!mmc_card_blockaddr(card))
+		data->blk_addr <<= 9;
+	data->blksz = 512;
+	data->blocks = MMC_TEST_RND_IO_SZ >> 9;
+	if (mmc_test_rnd_num(100) < slot->io->read_pct)
+		data->flags = MMC_DATA_READ;
+	else
+		data->flags = MMC_DATA_WRITE;
+	data->sg = &slot->sg;
+	data->sg_len = 1;
+	mmc_set_data_timeout(data, card);
+
+	slot->mrq.tag = tag;
+	slot->mrq.data = data;
+	slot->mrq.done = mmc_test_rnd_io_req_done;
+	slot->mrq.recovery_notifier = mmc_test_rnd_io_recovery_notifier;
+	slot->start = ktime_get();
+
+	return mmc_cqe_start_req(card->host, &slot->mrq);
+}
+
+static int mmc_test_rnd_io_cqe(struct mmc_test_card *test,
+			       struct mmc_test_rnd_io *io,
+			       struct timespec *ts1, struct timespec *ts2)
+{
+	struct mmc_host *host = test->card->host;
+	unsigned int in_flight = 0, tag;
+	bool stop = false, recovered = false;
+	struct mmc_test_rnd_slot *slot;
+	unsigned long done;
+	struct timespec ts;
+	int ret = 0, err;
+
+	/* Re-tuning is only possible while the CQE holds no requests */
+	host->retune_now = host->need_retune && !host->hold_retune;
+
+	getnstimeofday(ts1);
+	for (tag = 0; tag < io->depth; tag++) {
+		ret = mmc_test_rnd_io_start(test, &io->slot[tag], tag);
+		if (ret) {
+			stop = true;
+			break;
+		}
+		in_flight++;
+	}
+
+	while (in_flight) {
+		if (!wait_event_timeout(io->wq, io->done || io->recovery,
+				msecs_to_jiffies(MMC_TEST_CQE_TIMEOUT_MS)) ||
+		    io->recovery) {
+			if (recovered) {
+				pr_info("%s: %u requests lost after CQE recovery\n",
+					mmc_hostname(host), in_flight);
+				return -ETIMEDOUT;
+			}
+			/* Completes every request still queued */
+			mmc_cqe_recovery(host);
+			recovered = true;
+			ret = ret ? ret : -EIO;
+			stop = true;
+		}
+
+		done = xchg(&io->done, 0);
+		for_each_set_bit(tag, &done, io->depth) {
+			slot = &io->slot[tag];
+			mmc_cqe_post_req(host, &slot->mrq);
+			in_flight--;
+
+			if (slot->data.error) {
+				ret = ret ? ret : slot->data.error;
+				stop = true;
+				continue;
+			}
+			mmc_test_rnd_io_account(io, slot,
+					slot->data.flags & MMC_DATA_WRITE);
+
+			getnstimeofday(ts2);
+			ts = timespec_sub(*ts2, *ts1);
+			if (stop || ts.tv_sec >= MMC_TEST_RND_IO_SECS) {
+				stop = true;
+				continue;
+			}
+
+			err = mmc_test_rnd_io_start(test, slot, tag);
+			if (err) {
+				ret = ret ? ret : err;
+				stop = true;
+				continue;
+			}
+			in_flight++;
+		}
+	}
+	getnstimeofday(ts2);
+
+	return ret;
+}
+
+static int mmc_test_rnd_io(struct mmc_test_card *test, unsigned int read_pct,
+			   bool queued)
+{
+	struct mmc_host *host = test->card->host;
+	unsigned int order = get_order(MMC_TEST_RND_IO_SZ), i;
+	struct mmc_test_rnd_io *io;
+	struct timespec ts1, ts2;
+	char what[64];
+	int ret;
+
+	if (queued && !host->cqe_enabled) {
+		pr_info("%s: Command queue engine not in use\n",
+			mmc_hostname(host));
+		return RESULT_UNSUP_HOST;
+	}
+
+	io = kzalloc(sizeof(*io), GFP_KERNEL);
+	if (!io)
+		return -ENOMEM;
+
+	io->lat = vmalloc(MMC_TEST_LAT_SAMPLES * sizeof(*io->lat));
+	if (!io->lat) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	io->read_pct = min(read_pct, 100U);
+	io->depth = 1;
+	if (queued)
+		io->depth = clamp_t(unsigned int, min_t(unsigned int,
+				    host->cqe_qdepth,
+				    test->card->ext_csd.cmdq_depth),
+				    1, min(queue_depth, MMC_TEST_MAX_QD));
+	init_waitqueue_head(&io->wq);
+
+	for (i = 0; i < io->depth; i++) {
+		io->slot[i].io = io;
+		io->slot[i].page = alloc_pages(GFP_KERNEL, order);
+		if (!io->slot[i].page) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+		sg_init_table(&io->slot[i].sg, 1);
+		sg_set_page(&io->slot[i].sg, io->slot[i].page,
+			    MMC_TEST_RND_IO_SZ, 0);
+	}
+
+	if (queued)
+		ret = mmc_test_rnd_io_cqe(test, io, &ts1, &ts2);
+	else
+		ret = mmc_test_rnd_io_sync(test, io, &ts1, &ts2);
+	if (ret)
+		goto out_free;
+
+	pr_info("%s: Random 4 KiB I/O at queue depth %u: %u reads, %u writes\n",
+		mmc_hostname(host), io->depth, io->reads, io->writes);
+	snprintf(what, sizeof(what), "%u%% reads", io->read_pct);
+	mmc_test_print_iops(test, what, io->reads + io->writes,
+			    MMC_TEST_RND_IO_SZ, &ts1, &ts2);
+	mmc_test_print_lat(test, "Request", io->lat, io->nlat);
+
+out_free:
+	for (i = 0; i < io->depth; i++)
+		if (io->slot[i].page)
+			__free_pages(io->slot[i].page, order);
+	vfree(io->lat);
+	kfree(io);
+
+	return ret;
+}
+
+/*
+ * Random 4k read IOPS and latency.
+ */
+static int mmc_test_rnd_4k_read_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_io(test, 100, false);
+}
+
+/*
+ * Random 4k write IOPS and latency.
+ */
+static int mmc_test_rnd_4k_write_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_io(test, 0, false);
+}
+
+/*
+ * Random 4k mixed read/write IOPS and latency.
+ */
+static int mmc_test_rnd_4k_mixed_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_io(test, read_percent, false);
+}
+
+/*
+ * Random 4k mixed read/write, queue_depth requests deep through the CQE.
+ */
+static int mmc_test_rnd_4k_mixed_queued_perf(struct mmc_test_card *test)
+{
+	return mmc_test_rnd_io(test, read_percent, true);
+}
+
+/* Packed command header fields */
+#define MMC_TEST_PACKED_VER	0x01
+#define MMC_TEST_PACKED_WR	0x02
+#define MMC_TEST_PACKED_MAX	8
+#define MMC_TEST_PACKED_ROUNDS	256
+
+/*
+ * Write with Set Block Count (CMD23), sbc_arg adding its flags.
+ */
+static int mmc_test_sbc_write(struct mmc_test_card *test,
+			      struct scatterlist *sg, unsigned int dev_addr,
+			      unsigned int blocks, u32 sbc_arg)
+{
+	struct mmc_request mrq = {0};
+	struct mmc_command sbc = {0};
+	struct mmc_command cmd = {0};
+	struct mmc_command stop = {0};
+	struct mmc_data data = {0};
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mrq.stop = &stop;
+
+	mmc_test_prepare_mrq(test, &mrq, sg, 1, dev_addr, blocks, 512, 1);
+	if (!mrq.sbc)
+		return RESULT_UNSUP_HOST;
+	sbc.arg |= sbc_arg;
+
+	mmc_wait_for_req(test->card->host, &mrq);
+
+	mmc_test_wait_busy(test);
+
+	return mmc_test_check_result(test, &mrq);
+}
+
+/*
+ * Small random writes packed into one command, against the same writes
+ * issued one by one.
+ */
+static int mmc_test_packed_write_perf(struct mmc_test_card *test)
+{
+	struct mmc_card *card = test->card;
+	struct mmc_host *host = card->host;
+	unsigned int ssz = MMC_TEST_RND_IO_SZ >> 9;
+	unsigned int addr[MMC_TEST_PACKED_MAX];
+	unsigned int n, i, j, len, max, next;
+	struct timespec ts1, ts2;
+	struct scatterlist sg;
+	int packed, ret = 0;
+	__le32 *hdr;
+	u8 *buf;
+
+	if (!mmc_card_mmc(card) || card->ext_csd.max_packed_writes < 2 ||
+	    mmc_large_sector(card))
+		return RESULT_UNSUP_CARD;
+
+	if (!mmc_host_cmd23(host))
+		return RESULT_UNSUP_HOST;
+
+	/* The header and the entries go in one segment */
+	max = min3(host->max_req_size, host->max_seg_size,
+		   host->max_blk_count << 9);
+	n = min_t(unsigned int, card->ext_csd.max_packed_writes,
+		  MMC_TEST_PACKED_MAX);
+	while (n >= 2 && 512 + n * MMC_TEST_RND_IO_SZ > max)
+		n--;
+	if (n < 2)
+		return RESULT_UNSUP_HOST;
+
+	len = 512 + n * MMC_TEST_RND_IO_SZ;
+	buf = kzalloc(len, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	hdr = (__le32 *)buf;
+
+	/* Both runs write the same addresses */
+	next = rnd_next;
+	for (packed = 1; packed >= 0; packed--) {
+		rnd_next = next;
+		getnstimeofday(&ts1);
+		for (i = 0; i < MMC_TEST_PACKED_ROUNDS; i++) {
+			for (j = 0; j < n; j++)
+				addr[j] = mmc_test_rnd_io_addr(test);
+
+			if (!packed) {
+				for (j = 0; j < n && !ret; j++) {
+					sg_init_one(&sg, buf + 512 +
+						    j * MMC_TEST_RND_IO_SZ,
+						    MMC_TEST_RND_IO_SZ);
+					ret = mmc_test_sbc_write(test, &sg,
+								 addr[j], ssz,
+								 0);
+				}
+				if (ret)
+					goto out_free;
+				continue;
+			}
+
+			memset(hdr, 0, 512);
+			hdr[0] = cpu_to_le32(n << 16 | MMC_TEST_PACKED_WR << 8 |
+					     MMC_TEST_PACKED_VER);
+			for (j = 0; j < n; j++) {
+				hdr[(j + 1) * 2] = cpu_to_le32(ssz);
+				hdr[(j + 1) * 2 + 1] =
+					cpu_to_le32(mmc_card_blockaddr(card) ?
+						    addr[j] : addr[j] << 9);
+			}
+
+			sg_init_one(&sg, buf, len);
+			ret = mmc_test_sbc_write(test, &sg, addr[0], len >> 9,
+						 MMC_CMD23_ARG_PACKED);
+			if (ret)
+				goto out_free;
+		}
+		getnstimeofday(&ts2);
+
+		mmc_test_print_iops(test, packed ? "Packed writes" :
+				    "Separate writes",
+				    MMC_TEST_PACKED_ROUNDS * n, MMC_TEST_RND_IO_SZ,
+				    &ts1, &ts2);
+	}
+
+	pr_info("%s: %u writes per packed command\n", mmc_hostname(host), n);
+
+out_free:
+	kfree(buf);
+
+	return ret;
+}
+
+/**
+ * struct mmc_test_bus_mode - bus speed mode forced for a run.
+ * @name: name of the mode
+ * @need: card types of which the card must support one
+ * @keep: card types left for mmc_select_timing() to pick from
+ * @timing: resulting bus timing
+ */
+struct mmc_test_bus_mode {
+	const char *name;
+	unsigned int need;
+	unsigned int keep;
+	unsigned char timing;
+};
+
+static const struct mmc_test_bus_mode mmc_test_bus_modes[] = {
+	{ "HS400ES", EXT_CSD_CARD_TYPE_HS400ES, ~0U, MMC_TIMING_MMC_HS400 },
+	{ "HS400", EXT_CSD_CARD_TYPE_HS400, ~EXT_CSD_CARD_TYPE_HS400ES,
+	  MMC_TIMING_MMC_HS400 },
+	{ "HS200", EXT_CSD_CARD_TYPE_HS200,
+	  EXT_CSD_CARD_TYPE_HS200 | EXT_CSD_CARD_TYPE_HS,
+	  MMC_TIMING_MMC_HS200 },
+	{ "DDR52", EXT_CSD_CARD_TYPE_DDR_52,
+	  EXT_CSD_CARD_TYPE_DDR_52 | EXT_CSD_CARD_TYPE_HS,
+	  MMC_TIMING_MMC_DDR52 },
+	{ "HS", EXT_CSD_CARD_TYPE_HS, EXT_CSD_CARD_TYPE_HS, MMC_TIMING_MMC_HS },
+};
+
+/*
+ * Sequential and random read performance in each bus speed mode the card
+ * and host share, switched by re-initializing the card with only the types
+ * up to that mode left available.
+ */
+static int mmc_test_bus_mode_perf(struct mmc_test_card *test)
+{
+	struct mmc_card *card = test->card;
+	struct mmc_host *host = card->host;
+	unsigned int avail = card->mmc_avail_type, i;
+	const struct mmc_test_bus_mode *mode;
+	int ret = 0, err;
+
+	if (!mmc_card_mmc(card))
+		return RESULT_UNSUP_CARD;
+
+	for (i = 0; i < ARRAY_SIZE(mmc_test_bus_modes) && !ret; i++) {
+		mode = &mmc_test_bus_modes[i];
+		if (!(avail & mode->need))
+			continue;
+
+		card->mmc_avail_type = avail & mode->keep;
+		ret = mmc_hw_reset(host);
+		if (ret == -EOPNOTSUPP) {
+			ret = RESULT_UNSUP_HOST;
+			break;
+		}
+		if (ret)
+			break;
+
+		if (host->ios.timing != mode->timing ||
+		    !mmc_card_hs400es(card) != !(mode->need &
+						  EXT_CSD_CARD_TYPE_HS400ES)) {
+			pr_info("%s: %s not selected, timing %u\n",
+				mmc_hostname(host), mode->name,
+				host->ios.timing);
+			continue;
+		}
+
+		pr_info("%s: Bus mode %s at %u Hz\n", mmc_hostname(host),
+			mode->name, host->ios.clock);
+
+		ret = mmc_test_seq_perf(test, 0, 64 * 1024 * 1024, 0);
+		if (!ret)
+			ret = mmc_test_rnd_io(test, 100, false);
+	}
+
+	/* Back to the mode the card was set up in */
+	card->mmc_avail_type = avail;
+	err = mmc_hw_reset(host);
+	if (err && err != -EOPNOTSUPP && !ret)
+		ret = err;
+
+	return ret;
+}
+
+#define MMC_TEST_RPM_CYCLES	32
+
+/*
+ * Runtime suspend the host controller then time its resume and the first
+ * request after it, which includes any re-tuning that the resume left
+ * pending.
+ */
+static int mmc_test_rpm_resume_perf(struct mmc_test_card *test)
+{
+	struct mmc_host *host = test->card->host;
+	struct device *dev = mmc_dev(host);
+	unsigned int ssz = MMC_TEST_RND_IO_SZ >> 9, i, retunes = 0;
+	u32 resume[MMC_TEST_RPM_CYCLES], first[MMC_TEST_RPM_CYCLES];
+	struct scatterlist sg;
+	bool suspended;
+	ktime_t t;
+	int ret;
+
+	if (!pm_runtime_enabled(dev))
+		return RESULT_UNSUP_HOST;
+
+	/* Reference figures without runtime PM in between */
+	ret = mmc_test_rnd_io(test, 100, false);
+	if (ret)
+		return ret;
+
+	sg_init_one(&sg, test->buffer, MMC_TEST_RND_IO_SZ);
+
+	for (i = 0; i < MMC_TEST_RPM_CYCLES; i++) {
+		mmc_release_host(host);
+		pm_runtime_suspend(dev);
+		suspended = pm_runtime_suspended(dev);
+		t = ktime_get();
+		mmc_claim_host(host);
+		resume[i] = ktime_us_delta(ktime_get(), t);
+
+		if (!suspended) {
+			pr_info("%s: Host controller did not runtime suspend\n",
+				mmc_hostname(host));
+			return RESULT_UNSUP_HOST;
+		}
+
+		retunes += host->need_retune;
+
+		t = ktime_get();
+		ret = mmc_test_simple_transfer(test, &sg, 1,
+					       mmc_test_rnd_io_addr(test),
+					       ssz, 512, 0);
+		first[i] = ktime_us_delta(ktime_get(), t);
+		if (ret)
+			return ret;
+	}
+
+	pr_info("%s: %u of %u runtime resumes left a re-tune pending\n",
+		mmc_hostname(host), retunes, MMC_TEST_RPM_CYCLES);
+	mmc_test_print_lat(test, "Runtime resume", resume, MMC_TEST_RPM_CYCLES);
+	mmc_test_print_lat(test, "First read after resume", first,
+			   MMC_TEST_RPM_CYCLES);
+
+	return 0;
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -2913,6 +3598,54 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.run = mmc_test_cmds_during_write_cmd23_nonblock,
 		.cleanup = mmc_test_area_cleanup,
 	},
+	{
+		.name = "Random 4k read IOPS and latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_read_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4k write IOPS and latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4k mixed read/write IOPS and latency",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_mixed_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random 4k mixed read/write IOPS and latency, queued",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rnd_4k_mixed_queued_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Packed vs separate random 4k writes",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_packed_write_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Read performance in each bus speed mode",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_bus_mode_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Read latency after runtime resume",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_rpm_resume_perf,
+		.cleanup = mmc_test_area_cleanup,
+	},
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
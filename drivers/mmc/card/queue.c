@@ -12,8 +12,7 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/blkdev.h>
-#include <linux/freezer.h>
-#include <linux/kthread.h>
+#include <linux/blk-mq.h>
 #include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
 
@@ -26,138 +25,351 @@
 #define MMC_QUEUE_BOUNCESZ	65536
 
 /*
- * Prepare a MMC request. This just filters out odd stuff.
+ * Requests the block layer may have allocated to the queue. Only two are
+ * in the hands of the host at a time, the others wait to be merged into.
  */
-static int mmc_prep_request(struct request_queue *q, struct request *req)
+#define MMC_QUEUE_DEPTH		64
+
+static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
 {
-	struct mmc_queue *mq = q->queuedata;
+	struct scatterlist *sg;
 
-	/*
-	 * We only like normal block requests and discards.
-	 */
+	sg = kmalloc(sizeof(struct scatterlist)*sg_len, GFP_KERNEL);
+	if (!sg)
+		*err = -ENOMEM;
+	else {
+		*err = 0;
+		sg_init_table(sg, sg_len);
+	}
+
+	return sg;
+}
+
+/*
+ * Filter out odd stuff: we only like normal block requests and discards.
+ */
+static bool mmc_queue_valid_request(struct mmc_queue *mq, struct request *req)
+{
 	if (req->cmd_type != REQ_TYPE_FS && req_op(req) != REQ_OP_DISCARD &&
 	    req_op(req) != REQ_OP_SECURE_ERASE) {
 		blk_dump_rq_flags(req, "MMC bad request");
-		return BLKPREP_KILL;
+		return false;
 	}
 
-	if (mq && (mmc_card_removed(mq->card) || mmc_access_rpmb(mq)))
-		return BLKPREP_KILL;
+	return !mmc_card_removed(mq->card) && !mmc_access_rpmb(mq);
+}
 
-	req->cmd_flags |= REQ_DONTPREP;
+/*
+ * Issue a request, or complete the one in flight if @req is NULL. This keeps
+ * the two-deep pipeline of mmc_blk_issue_rq(): the current request is started
+ * before waiting for the previous one. Called with @mq->issue_sem held.
+ */
+static void mmc_queue_issue(struct mmc_queue *mq, struct request *req)
+{
+	bool req_is_special = mmc_req_is_special(req);
+
+	/* Let nested claims from within the request path match our context */
+	mq->ctx.task = current;
+	mq->mqrq_cur->req = req;
+	mmc_blk_issue_rq(mq, req);
+	mq->ctx.task = NULL;
+
+	if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
+		/* Waiting for the last request was cut short by a new one */
+		mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
+		return;
+	}
+
+	/*
+	 * Current request becomes previous request and vice versa. In case of
+	 * special requests, current request has been finished. Do not assign
+	 * it to previous request.
+	 */
+	if (req_is_special)
+		mq->mqrq_cur->req = NULL;
 
-	return BLKPREP_OK;
+	mq->mqrq_prev->brq.mrq.data = NULL;
+	mq->mqrq_prev->req = NULL;
+	swap(mq->mqrq_prev, mq->mqrq_cur);
 }
 
-static int mmc_queue_thread(void *d)
+/*
+ * Complete the request left in flight when the hardware queue ran empty. A
+ * new request interrupts the wait, see mmc_queue_rq().
+ */
+static void mmc_queue_drain_work(struct work_struct *work)
 {
-	struct mmc_queue *mq = d;
-	struct request_queue *q = mq->queue;
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    drain_work);
 
-	current->flags |= PF_MEMALLOC;
+	down(&mq->issue_sem);
+	if (mq->mqrq_prev->req)
+		mmc_queue_issue(mq, NULL);
+	up(&mq->issue_sem);
+}
 
-	down(&mq->thread_sem);
-	do {
-		struct request *req = NULL;
+static int mmc_queue_rq(struct blk_mq_hw_ctx *hctx,
+			const struct blk_mq_queue_data *bd)
+{
+	struct mmc_queue *mq = hctx->queue->queuedata;
+	struct request *req = bd->rq;
+	struct mmc_context_info *cntx;
+	unsigned long flags;
 
-		spin_lock_irq(q->queue_lock);
-		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
-		mq->mqrq_cur->req = req;
-		spin_unlock_irq(q->queue_lock);
+	blk_mq_start_request(req);
 
-		if (req || mq->mqrq_prev->req) {
-			bool req_is_special = mmc_req_is_special(req);
+	if (!mq || !mmc_queue_valid_request(mq, req)) {
+		req->cmd_flags |= REQ_QUIET;
+		blk_mq_end_request(req, -EIO);
+		return BLK_MQ_RQ_QUEUE_OK;
+	}
 
-			set_current_state(TASK_RUNNING);
-			mmc_blk_issue_rq(mq, req);
-			cond_resched();
-			if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
-				mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
-				continue; /* fetch again */
-			}
+	/*
+	 * If the drain work is blocked on the previous request to complete,
+	 * wake it up so that this request gets started right away.
+	 */
+	cntx = &mq->card->host->context_info;
+	spin_lock_irqsave(&cntx->lock, flags);
+	if (cntx->is_waiting_last_req) {
+		cntx->is_new_req = true;
+		wake_up_interruptible(&cntx->wait);
+	}
+	spin_unlock_irqrestore(&cntx->lock, flags);
 
-			/*
-			 * Current request becomes previous request
-			 * and vice versa.
-			 * In case of special requests, current request
-			 * has been finished. Do not assign it to previous
-			 * request.
-			 */
-			if (req_is_special)
-				mq->mqrq_cur->req = NULL;
-
-			mq->mqrq_prev->brq.mrq.data = NULL;
-			mq->mqrq_prev->req = NULL;
-			swap(mq->mqrq_prev, mq->mqrq_cur);
-		} else {
-			if (kthread_should_stop()) {
-				set_current_state(TASK_RUNNING);
-				break;
-			}
-			up(&mq->thread_sem);
-			schedule();
-			down(&mq->thread_sem);
-		}
-	} while (1);
-	up(&mq->thread_sem);
+	down(&mq->issue_sem);
+	mmc_queue_issue(mq, req);
+	if (bd->last && mq->mqrq_prev->req)
+		kblockd_schedule_work(&mq->drain_work);
+	up(&mq->issue_sem);
 
-	return 0;
+	return BLK_MQ_RQ_QUEUE_OK;
 }
 
+static struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_queue_rq,
+};
+
 /*
- * Generic MMC request handler.  This is called for any queue on a
- * particular host.  When the host is not busy, we look for a request
- * on any queue on this host, and attempt to issue it.  This may
- * not be the queue we were asked to process.
+ * Command queue engine mode. Reads and writes are handed to the CQE, up to
+ * its queue depth, and complete out of order. The host stays claimed by the
+ * queue context while any of them is in flight. Anything else is issued
+ * through mmc_blk_issue_rq() once the CQE has gone idle.
  */
-static void mmc_request_fn(struct request_queue *q)
+static void mmc_cqe_schedule_recovery(struct mmc_queue *mq)
 {
-	struct mmc_queue *mq = q->queuedata;
-	struct request *req;
 	unsigned long flags;
-	struct mmc_context_info *cntx;
 
-	if (!mq) {
-		while ((req = blk_fetch_request(q)) != NULL) {
-			req->cmd_flags |= REQ_QUIET;
-			__blk_end_request_all(req, -EIO);
-		}
-		return;
+	spin_lock_irqsave(&mq->cqe_lock, flags);
+	if (!mq->cqe_recovery_needed) {
+		mq->cqe_recovery_needed = true;
+		kblockd_schedule_work(&mq->cqe_recovery_work);
 	}
+	spin_unlock_irqrestore(&mq->cqe_lock, flags);
+}
 
-	cntx = &mq->card->host->context_info;
-	if (!mq->mqrq_cur->req && mq->mqrq_prev->req) {
-		/*
-		 * New MMC request arrived when MMC thread may be
-		 * blocked on the previous request to be complete
-		 * with no current request fetched
-		 */
-		spin_lock_irqsave(&cntx->lock, flags);
-		if (cntx->is_waiting_last_req) {
-			cntx->is_new_req = true;
-			wake_up_interruptible(&cntx->wait);
-		}
-		spin_unlock_irqrestore(&cntx->lock, flags);
-	} else if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
-		wake_up_process(mq->thread);
+void mmc_cqe_recovery_notifier(struct mmc_request *mrq)
+{
+	struct mmc_queue_req *mqrq = container_of(mrq, struct mmc_queue_req,
+						  brq.mrq);
+
+	mmc_cqe_schedule_recovery(mqrq->req->q->queuedata);
 }
 
-static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
+/* Called with @mq->issue_sem held */
+static void mmc_queue_cqe_recovery(struct mmc_queue *mq)
 {
-	struct scatterlist *sg;
+	unsigned long flags;
 
-	sg = kmalloc(sizeof(struct scatterlist)*sg_len, GFP_KERNEL);
-	if (!sg)
-		*err = -ENOMEM;
-	else {
-		*err = 0;
-		sg_init_table(sg, sg_len);
+	mmc_get_card_ctx(mq->card, &mq->ctx);
+	mq->ctx.task = current;
+	mmc_blk_cqe_recovery(mq);
+	mq->ctx.task = NULL;
+
+	spin_lock_irqsave(&mq->cqe_lock, flags);
+	mq->cqe_recovery_needed = false;
+	spin_unlock_irqrestore(&mq->cqe_lock, flags);
+
+	mmc_put_card(mq->card);
+}
+
+static void mmc_cqe_recovery_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    cqe_recovery_work);
+
+	down(&mq->issue_sem);
+	if (mq->cqe_recovery_needed)
+		mmc_queue_cqe_recovery(mq);
+	up(&mq->issue_sem);
+
+	if (!(mq->flags & MMC_QUEUE_SUSPENDED))
+		blk_mq_start_stopped_hw_queues(mq->queue, true);
+}
+
+/*
+ * Wait for the requests the CQE holds to complete, recovering it if that
+ * fails. Called with @mq->issue_sem held.
+ */
+static void mmc_queue_cqe_wait_for_idle(struct mmc_queue *mq)
+{
+	struct mmc_host *host = mq->card->host;
+
+	if (host->cqe_ops->cqe_wait_for_idle(host) || mq->cqe_recovery_needed)
+		mmc_queue_cqe_recovery(mq);
+}
+
+static int mmc_cqe_queue_rq(struct blk_mq_hw_ctx *hctx,
+			    const struct blk_mq_queue_data *bd)
+{
+	struct mmc_queue *mq = hctx->queue->queuedata;
+	struct request *req = bd->rq;
+	struct mmc_card *card;
+	struct mmc_host *host;
+	bool first;
+	int err;
+
+	if (!mq || !mmc_queue_valid_request(mq, req)) {
+		blk_mq_start_request(req);
+		req->cmd_flags |= REQ_QUIET;
+		blk_mq_end_request(req, -EIO);
+		return BLK_MQ_RQ_QUEUE_OK;
 	}
 
-	return sg;
+	card = mq->card;
+	host = card->host;
+
+	down(&mq->issue_sem);
+
+	if (!mmc_cqe_can_issue(req)) {
+		blk_mq_start_request(req);
+		mmc_queue_cqe_wait_for_idle(mq);
+		mmc_queue_issue(mq, req);
+		while (mq->mqrq_prev->req)
+			mmc_queue_issue(mq, NULL);
+		up(&mq->issue_sem);
+		return BLK_MQ_RQ_QUEUE_OK;
+	}
+
+	spin_lock_irq(&mq->cqe_lock);
+	if (mq->cqe_recovery_needed) {
+		spin_unlock_irq(&mq->cqe_lock);
+		up(&mq->issue_sem);
+		blk_mq_stop_hw_queue(hctx);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+	first = !mq->cqe_in_flight++;
+	spin_unlock_irq(&mq->cqe_lock);
+
+	if (first)
+		mmc_get_card_ctx(card, &mq->ctx);
+
+	/* Re-tuning is only possible while the CQE holds no requests */
+	host->retune_now = first && host->need_retune && !host->hold_retune;
+
+	blk_mq_start_request(req);
+	err = mmc_blk_cqe_issue_rq(mq, req);
+	if (err == -EBUSY) {
+		spin_lock_irq(&mq->cqe_lock);
+		mq->cqe_in_flight--;
+		spin_unlock_irq(&mq->cqe_lock);
+		if (first)
+			mmc_put_card(card);
+		up(&mq->issue_sem);
+		/* Restarted on the next completion or after recovery */
+		blk_mq_stop_hw_queue(hctx);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+	if (err)
+		goto out_err;
+
+	up(&mq->issue_sem);
+	return BLK_MQ_RQ_QUEUE_OK;
+
+out_err:
+	spin_lock_irq(&mq->cqe_lock);
+	first = !--mq->cqe_in_flight;
+	spin_unlock_irq(&mq->cqe_lock);
+	if (first)
+		mmc_put_card(card);
+	up(&mq->issue_sem);
+	blk_mq_end_request(req, err);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static void mmc_cqe_complete(struct request *req)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+	unsigned long flags;
+	bool put_card;
+
+	mmc_blk_cqe_complete_rq(mq, req);
+
+	spin_lock_irqsave(&mq->cqe_lock, flags);
+	put_card = !--mq->cqe_in_flight;
+	spin_unlock_irqrestore(&mq->cqe_lock, flags);
+
+	if (put_card)
+		mmc_put_card(mq->card);
+
+	if (!(mq->flags & MMC_QUEUE_SUSPENDED))
+		blk_mq_start_stopped_hw_queues(mq->queue, true);
 }
 
+static enum blk_eh_timer_return mmc_cqe_timed_out(struct request *req,
+						  bool reserved)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+	struct mmc_host *host;
+	bool recovery_needed = false;
+
+	/* Requests issued outside of the CQE complete synchronously */
+	if (!mq || !mmc_cqe_can_issue(req))
+		return BLK_EH_RESET_TIMER;
+
+	host = mq->card->host;
+	if (!host->cqe_ops->cqe_timeout(host, &mqrq->brq.mrq,
+					&recovery_needed))
+		/* The request completed while the timer fired */
+		return BLK_EH_HANDLED;
+
+	if (recovery_needed)
+		mmc_cqe_schedule_recovery(mq);
+
+	return BLK_EH_RESET_TIMER;
+}
+
+static int mmc_cqe_init_request(void *data, struct request *req,
+				unsigned int hctx_idx, unsigned int request_idx,
+				unsigned int numa_node)
+{
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+	struct mmc_queue *mq = data;
+	int ret;
+
+	mqrq->sg = mmc_alloc_sg(mq->card->host->max_segs, &ret);
+
+	return ret;
+}
+
+static void mmc_cqe_exit_request(void *data, struct request *req,
+				 unsigned int hctx_idx,
+				 unsigned int request_idx)
+{
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+
+	kfree(mqrq->sg);
+	mqrq->sg = NULL;
+}
+
+static struct blk_mq_ops mmc_cqe_mq_ops = {
+	.queue_rq	= mmc_cqe_queue_rq,
+	.complete	= mmc_cqe_complete,
+	.timeout	= mmc_cqe_timed_out,
+	.init_request	= mmc_cqe_init_request,
+	.exit_request	= mmc_cqe_exit_request,
+};
+
 static void mmc_queue_setup_discard(struct request_queue *q,
 				    struct mmc_card *card)
 {
@@ -183,13 +395,13 @@ static void mmc_queue_setup_discard(struct request_queue *q,
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
  * @card: mmc card to attach this queue
- * @lock: queue lock
  * @subname: partition subname
  *
- * Initialise a MMC card request queue.
+ * Initialise a MMC card request queue. Requests are issued from the
+ * blk-mq hardware queue context, which may sleep.
  */
 int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
-		   spinlock_t *lock, const char *subname)
+		   const char *subname)
 {
 	struct mmc_host *host = card->host;
 	u64 limit = BLK_BOUNCE_HIGH;
@@ -201,15 +413,37 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		limit = (u64)dma_max_pfn(mmc_dev(host)) << PAGE_SHIFT;
 
 	mq->card = card;
-	mq->queue = blk_init_queue(mmc_request_fn, lock);
-	if (!mq->queue)
-		return -ENOMEM;
+	mq->use_cqe = host->cqe_enabled;
+
+	memset(&mq->tag_set, 0, sizeof(mq->tag_set));
+	if (mq->use_cqe) {
+		mq->tag_set.ops = &mmc_cqe_mq_ops;
+		mq->tag_set.queue_depth = min_t(int, host->cqe_qdepth,
+						card->ext_csd.cmdq_depth);
+		mq->tag_set.cmd_size = sizeof(struct mmc_queue_req);
+		mq->tag_set.driver_data = mq;
+	} else {
+		mq->tag_set.ops = &mmc_mq_ops;
+		mq->tag_set.queue_depth = MMC_QUEUE_DEPTH;
+	}
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_SG_MERGE |
+			    BLK_MQ_F_BLOCKING;
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret)
+		return ret;
+
+	mq->queue = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(mq->queue)) {
+		ret = PTR_ERR(mq->queue);
+		goto free_tag_set;
+	}
 
 	mq->mqrq_cur = mqrq_cur;
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
 
-	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, mq->queue);
 	if (mmc_can_erase(card))
@@ -289,24 +523,19 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 			goto cleanup_queue;
 	}
 
-	sema_init(&mq->thread_sem, 1);
-
-	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
-		host->index, subname ? subname : "");
-
-	if (IS_ERR(mq->thread)) {
-		ret = PTR_ERR(mq->thread);
-		goto free_bounce_sg;
-	}
+	sema_init(&mq->issue_sem, 1);
+	INIT_WORK(&mq->drain_work, mmc_queue_drain_work);
+	spin_lock_init(&mq->cqe_lock);
+	INIT_WORK(&mq->cqe_recovery_work, mmc_cqe_recovery_work);
 
 	return 0;
- free_bounce_sg:
+
+ cleanup_queue:
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
 	kfree(mqrq_prev->bounce_sg);
 	mqrq_prev->bounce_sg = NULL;
 
- cleanup_queue:
 	kfree(mqrq_cur->sg);
 	mqrq_cur->sg = NULL;
 	kfree(mqrq_cur->bounce_buf);
@@ -318,27 +547,29 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mqrq_prev->bounce_buf = NULL;
 
 	blk_cleanup_queue(mq->queue);
+ free_tag_set:
+	blk_mq_free_tag_set(&mq->tag_set);
 	return ret;
 }
 
 void mmc_cleanup_queue(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 	struct mmc_queue_req *mqrq_cur = mq->mqrq_cur;
 	struct mmc_queue_req *mqrq_prev = mq->mqrq_prev;
 
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
-	/* Then terminate our worker thread */
-	kthread_stop(mq->thread);
-
-	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
+	/*
+	 * Wait for the requests in flight, the drain work completes the last
+	 * one. Any request coming after this is failed by mmc_queue_rq().
+	 */
+	blk_mq_freeze_queue(q);
 	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+	blk_mq_unfreeze_queue(q);
+	cancel_work_sync(&mq->drain_work);
+	cancel_work_sync(&mq->cqe_recovery_work);
 
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
@@ -362,70 +593,37 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
 
-int mmc_packed_init(struct mmc_queue *mq, struct mmc_card *card)
-{
-	struct mmc_queue_req *mqrq_cur = &mq->mqrq[0];
-	struct mmc_queue_req *mqrq_prev = &mq->mqrq[1];
-	int ret = 0;
-
-
-	mqrq_cur->packed = kzalloc(sizeof(struct mmc_packed), GFP_KERNEL);
-	if (!mqrq_cur->packed) {
-		pr_warn("%s: unable to allocate packed cmd for mqrq_cur\n",
-			mmc_card_name(card));
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	mqrq_prev->packed = kzalloc(sizeof(struct mmc_packed), GFP_KERNEL);
-	if (!mqrq_prev->packed) {
-		pr_warn("%s: unable to allocate packed cmd for mqrq_prev\n",
-			mmc_card_name(card));
-		kfree(mqrq_cur->packed);
-		mqrq_cur->packed = NULL;
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	INIT_LIST_HEAD(&mqrq_cur->packed->list);
-	INIT_LIST_HEAD(&mqrq_prev->packed->list);
-
-out:
-	return ret;
-}
-
-void mmc_packed_clean(struct mmc_queue *mq)
+/**
+ * mmc_free_queue - free the tag set of a released MMC queue
+ * @mq: MMC queue whose request queue has been cleaned up
+ */
+void mmc_free_queue(struct mmc_queue *mq)
 {
-	struct mmc_queue_req *mqrq_cur = &mq->mqrq[0];
-	struct mmc_queue_req *mqrq_prev = &mq->mqrq[1];
-
-	kfree(mqrq_cur->packed);
-	mqrq_cur->packed = NULL;
-	kfree(mqrq_prev->packed);
-	mqrq_prev->packed = NULL;
+	blk_mq_free_tag_set(&mq->tag_set);
 }
 
 /**
  * mmc_queue_suspend - suspend a MMC request queue
  * @mq: MMC queue to suspend
  *
- * Stop the block request queue, and wait for our thread to
- * complete any outstanding requests.  This ensures that we
- * won't suspend while a request is being processed.
+ * Stop the block request queue, and complete any outstanding
+ * request.  This ensures that we won't suspend while a request
+ * is being processed.
  */
 void mmc_queue_suspend(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 
 	if (!(mq->flags & MMC_QUEUE_SUSPENDED)) {
 		mq->flags |= MMC_QUEUE_SUSPENDED;
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_stop_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		blk_mq_stop_hw_queues(q);
 
-		down(&mq->thread_sem);
+		down(&mq->issue_sem);
+		if (mq->use_cqe)
+			mmc_queue_cqe_wait_for_idle(mq);
+		while (mq->mqrq_prev->req)
+			mmc_queue_issue(mq, NULL);
 	}
 }
 
@@ -436,54 +634,16 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 void mmc_queue_resume(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 
 	if (mq->flags & MMC_QUEUE_SUSPENDED) {
 		mq->flags &= ~MMC_QUEUE_SUSPENDED;
 
-		up(&mq->thread_sem);
+		up(&mq->issue_sem);
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_start_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		blk_mq_start_stopped_hw_queues(q, true);
 	}
 }
 
-static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
-					    struct mmc_packed *packed,
-					    struct scatterlist *sg,
-					    enum mmc_packed_type cmd_type)
-{
-	struct scatterlist *__sg = sg;
-	unsigned int sg_len = 0;
-	struct request *req;
-
-	if (mmc_packed_wr(cmd_type)) {
-		unsigned int hdr_sz = mmc_large_sector(mq->card) ? 4096 : 512;
-		unsigned int max_seg_sz = queue_max_segment_size(mq->queue);
-		unsigned int len, remain, offset = 0;
-		u8 *buf = (u8 *)packed->cmd_hdr;
-
-		remain = hdr_sz;
-		do {
-			len = min(remain, max_seg_sz);
-			sg_set_buf(__sg, buf + offset, len);
-			offset += len;
-			remain -= len;
-			sg_unmark_end(__sg++);
-			sg_len++;
-		} while (remain);
-	}
-
-	list_for_each_entry(req, &packed->list, queuelist) {
-		sg_len += blk_rq_map_sg(mq->queue, req, __sg);
-		__sg = sg + (sg_len - 1);
-		sg_unmark_end(__sg++);
-	}
-	sg_mark_end(sg + (sg_len - 1));
-	return sg_len;
-}
-
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -492,26 +652,14 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 	unsigned int sg_len;
 	size_t buflen;
 	struct scatterlist *sg;
-	enum mmc_packed_type cmd_type;
 	int i;
 
-	cmd_type = mqrq->cmd_type;
-
-	if (!mqrq->bounce_buf) {
-		if (mmc_packed_cmd(cmd_type))
-			return mmc_queue_packed_map_sg(mq, mqrq->packed,
-						       mqrq->sg, cmd_type);
-		else
-			return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
-	}
+	if (!mqrq->bounce_buf)
+		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
 	BUG_ON(!mqrq->bounce_sg);
 
-	if (mmc_packed_cmd(cmd_type))
-		sg_len = mmc_queue_packed_map_sg(mq, mqrq->packed,
-						 mqrq->bounce_sg, cmd_type);
-	else
-		sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
+	sg_len = blk_rq_map_sg(mq->queue, mqrq->req, mqrq->bounce_sg);
 
 	mqrq->bounce_sg_len = sg_len;
 
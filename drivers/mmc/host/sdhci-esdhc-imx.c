@@ -30,8 +30,10 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/platform_data/mmc-esdhc-imx.h>
 #include <linux/pm_runtime.h>
+#include <linux/thermal.h>
 #include "sdhci-pltfm.h"
 #include "sdhci-esdhc.h"
+#include "cqhci.h"
 
 #define ESDHC_SYS_CTRL_DTOCV_MASK	0x0f
 #define	ESDHC_CTRL_D3CD			0x08
@@ -66,6 +68,8 @@
 #define  ESDHC_TUNE_CTRL_STEP		1
 #define  ESDHC_TUNE_CTRL_MIN		0
 #define  ESDHC_TUNE_CTRL_MAX		((1 << 7) - 1)
+#define  ESDHC_TUNE_CTRL_DLY_CELL_SHIFT	8
+#define  ESDHC_TUNE_CTRL_TAP_SEL_SHIFT	24
 
 /* strobe dll register */
 #define ESDHC_STROBE_DLL_CTRL		0x70
@@ -156,6 +160,18 @@
 #define ESDHC_FLAG_BUSFREQ		BIT(12)
 /* need request pmqos during low power */
 #define ESDHC_FLAG_PMQOS		BIT(13)
+/* The IP has the eMMC 5.1 command queue engine */
+#define ESDHC_FLAG_CQHCI		BIT(14)
+
+/* The CQHCI registers follow the SDHCI ones */
+#define ESDHC_CQHCI_ADDR_OFFSET		0x100
+
+/*
+ * A cached tuning delay is no longer trusted once the SoC temperature has
+ * moved this far (in millicelsius) from where it was tuned.
+ */
+#define ESDHC_TUNING_TEMP_DELTA		20000
+#define ESDHC_TUNING_THERMAL_ZONE	"imx_thermal_zone"
 
 /* A higher clock ferquency than this rate requires strobell dll control */
 #define ESDHC_STROBE_DLL_CLK_FREQ	100000000
@@ -232,6 +248,13 @@ static struct esdhc_soc_data usdhc_imx7ulp_data = {
 			| ESDHC_FLAG_PMQOS,
 };
 
+static struct esdhc_soc_data usdhc_imx8qm_data = {
+	.flags = ESDHC_FLAG_USDHC | ESDHC_FLAG_STD_TUNING
+			| ESDHC_FLAG_HAVE_CAP1 | ESDHC_FLAG_HS200
+			| ESDHC_FLAG_HS400 | ESDHC_FLAG_STATE_LOST_IN_LPMODE
+			| ESDHC_FLAG_CQHCI,
+};
+
 struct pltfm_imx_data {
 	u32 scratchpad;
 	struct pinctrl *pinctrl;
@@ -250,6 +273,12 @@ struct pltfm_imx_data {
 	} multiblock_status;
 	u32 is_ddr;
 	struct pm_qos_request pm_qos_req;
+	/* last good tuning delay of the current card, per timing mode */
+	u32 tuning_delay[MMC_TIMING_MMC_HS400 + 1];
+	unsigned long tuning_valid;
+	int tuning_temp;
+	struct thermal_zone_device *tz;
+	bool retune_pending;
 };
 
 static const struct platform_device_id imx_esdhc_devtype[] = {
@@ -279,6 +308,7 @@ static const struct of_device_id imx_esdhc_dt_ids[] = {
 	{ .compatible = "fsl,imx6ull-usdhc", .data = &usdhc_imx6ull_data, },
 	{ .compatible = "fsl,imx7d-usdhc", .data = &usdhc_imx7d_data, },
 	{ .compatible = "fsl,imx7ulp-usdhc", .data = &usdhc_imx7ulp_data, },
+	{ .compatible = "fsl,imx8qm-usdhc", .data = &usdhc_imx8qm_data, },
 	{ /* sentinel */ }
 };
 MODULE_DEVICE_TABLE(of, imx_esdhc_dt_ids);
@@ -958,7 +988,7 @@ static void esdhc_reset_tuning(struct sdhci_host *host)
 {
 	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
 	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
-	u16 ctrl;
+	u32 ctrl;
 
 	/* Rest the tuning circurt */
 	if (esdhc_is_usdhc(imx_data)) {
@@ -972,10 +1002,141 @@ static void esdhc_reset_tuning(struct sdhci_host *host)
 			ctrl = readl(host->ioaddr + SDHCI_ACMD12_ERR);
 			ctrl &= ~ESDHC_MIX_CTRL_SMPCLK_SEL;
 			writel(ctrl, host->ioaddr + SDHCI_ACMD12_ERR);
+			/* undo esdhc_restore_tuning() */
+			ctrl = readl(host->ioaddr + ESDHC_MIX_CTRL);
+			ctrl &= ~ESDHC_MIX_CTRL_SMPCLK_SEL;
+			ctrl &= ~ESDHC_MIX_CTRL_FBCLK_SEL;
+			writel(ctrl, host->ioaddr + ESDHC_MIX_CTRL);
+			ctrl = readl(host->ioaddr + ESDHC_TUNING_CTRL);
+			ctrl |= ESDHC_STD_TUNING_EN;
+			writel(ctrl, host->ioaddr + ESDHC_TUNING_CTRL);
 		}
 	}
 }
 
+/* HS400 keeps the delay tuned in HS200 mode */
+static unsigned char esdhc_tuning_timing(struct mmc_host *mmc)
+{
+	if (mmc->ios.timing == MMC_TIMING_MMC_HS400)
+		return MMC_TIMING_MMC_HS200;
+	return mmc->ios.timing;
+}
+
+static int esdhc_tuning_temp(struct pltfm_imx_data *imx_data, int *temp)
+{
+	struct thermal_zone_device *tz;
+
+	if (!imx_data->tz) {
+		tz = thermal_zone_get_zone_by_name(ESDHC_TUNING_THERMAL_ZONE);
+		if (IS_ERR(tz))
+			return PTR_ERR(tz);
+		imx_data->tz = tz;
+	}
+
+	return thermal_zone_get_temp(imx_data->tz, temp);
+}
+
+static void esdhc_save_tuning(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	unsigned char timing = esdhc_tuning_timing(host->mmc);
+	u32 reg = readl(host->ioaddr + ESDHC_TUNE_CTRL_STATUS);
+
+	/* standard tuning reports the delay it settled on in TAP_SEL_PRE */
+	if (imx_data->socdata->flags & ESDHC_FLAG_STD_TUNING)
+		reg >>= ESDHC_TUNE_CTRL_TAP_SEL_SHIFT;
+	else
+		reg >>= ESDHC_TUNE_CTRL_DLY_CELL_SHIFT;
+
+	if (esdhc_tuning_temp(imx_data, &imx_data->tuning_temp))
+		imx_data->tuning_temp = 0;
+	imx_data->tuning_delay[timing] = reg & ESDHC_TUNE_CTRL_MAX;
+	imx_data->tuning_valid |= BIT(timing);
+}
+
+/* Whether the current timing has a delay that can be used as it is */
+static bool esdhc_tuning_is_cached(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	unsigned char timing = esdhc_tuning_timing(host->mmc);
+	int temp;
+
+	if (!(imx_data->tuning_valid & BIT(timing)))
+		return false;
+
+	if (!esdhc_tuning_temp(imx_data, &temp) &&
+	    abs(temp - imx_data->tuning_temp) > ESDHC_TUNING_TEMP_DELTA) {
+		imx_data->tuning_valid = 0;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Program the cached delay by the manual tuning method. For standard tuning
+ * that means turning the tuning engine off until esdhc_reset_tuning().
+ */
+static void esdhc_restore_tuning(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	unsigned char timing = esdhc_tuning_timing(host->mmc);
+	u32 reg;
+
+	if (imx_data->socdata->flags & ESDHC_FLAG_STD_TUNING) {
+		reg = readl(host->ioaddr + ESDHC_TUNING_CTRL);
+		reg &= ~ESDHC_STD_TUNING_EN;
+		writel(reg, host->ioaddr + ESDHC_TUNING_CTRL);
+	}
+
+	reg = readl(host->ioaddr + ESDHC_MIX_CTRL);
+	reg |= ESDHC_MIX_CTRL_SMPCLK_SEL | ESDHC_MIX_CTRL_FBCLK_SEL;
+	writel(reg, host->ioaddr + ESDHC_MIX_CTRL);
+	writel(imx_data->tuning_delay[timing] << ESDHC_TUNE_CTRL_DLY_CELL_SHIFT,
+	       host->ioaddr + ESDHC_TUNE_CTRL_STATUS);
+
+	if (imx_data->socdata->flags & ESDHC_FLAG_MAN_TUNING)
+		esdhc_post_tuning(host);
+
+	dev_dbg(mmc_dev(host->mmc), "restored tuning delay 0x%x\n",
+		imx_data->tuning_delay[timing]);
+}
+
+/*
+ * Re-initialising a card tuned before, e.g. after runtime PM powered it
+ * off, first tries the delay that worked last time. Re-tuning asked for by
+ * the core, on CRC errors or periodically, always runs the full sequence.
+ */
+static int esdhc_execute_tuning(struct mmc_host *mmc, u32 opcode)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	int err;
+
+	/* a new card */
+	if (!mmc->card)
+		imx_data->tuning_valid = 0;
+
+	if (!mmc->doing_retune && mmc->card && esdhc_tuning_is_cached(host)) {
+		esdhc_restore_tuning(host);
+		if (!mmc_send_tuning(mmc, opcode, NULL))
+			return 0;
+	}
+
+	esdhc_reset_tuning(host);
+	err = sdhci_execute_tuning(mmc, opcode);
+	if (err)
+		imx_data->tuning_valid &= ~BIT(esdhc_tuning_timing(mmc));
+	else
+		esdhc_save_tuning(host);
+
+	return err;
+}
+
 static void esdhc_set_uhs_signaling(struct sdhci_host *host, unsigned timing)
 {
 	u32 m;
@@ -1057,6 +1218,19 @@ static void esdhc_set_timeout(struct sdhci_host *host, struct mmc_command *cmd)
 			SDHCI_TIMEOUT_CONTROL);
 }
 
+static u32 esdhc_cqhci_irq(struct sdhci_host *host, u32 intmask)
+{
+	int cmd_error = 0;
+	int data_error = 0;
+
+	if (!sdhci_cqe_irq(host, intmask, &cmd_error, &data_error))
+		return intmask;
+
+	cqhci_irq(host->mmc, intmask, cmd_error, data_error);
+
+	return 0;
+}
+
 static struct sdhci_ops sdhci_esdhc_ops = {
 	.read_l = esdhc_readl_le,
 	.read_w = esdhc_readw_le,
@@ -1073,6 +1247,7 @@ static struct sdhci_ops sdhci_esdhc_ops = {
 	.set_bus_width = esdhc_pltfm_set_bus_width,
 	.set_uhs_signaling = esdhc_set_uhs_signaling,
 	.reset = esdhc_reset,
+	.irq = esdhc_cqhci_irq,
 };
 
 static const struct sdhci_pltfm_data sdhci_esdhc_imx_pdata = {
@@ -1083,6 +1258,64 @@ static const struct sdhci_pltfm_data sdhci_esdhc_imx_pdata = {
 	.ops = &sdhci_esdhc_ops,
 };
 
+static void esdhc_cqe_enable(struct mmc_host *mmc)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct cqhci_host *cq_host = mmc->cqe_private;
+	u32 reg;
+	u16 mode;
+	int count = 10;
+
+	/*
+	 * CQE gets stuck if it sees Buffer Read Enable bit set, which can be
+	 * the case after tuning, so ensure the buffer is drained.
+	 */
+	reg = sdhci_readl(host, SDHCI_PRESENT_STATE);
+	while (reg & SDHCI_DATA_AVAILABLE) {
+		sdhci_readl(host, SDHCI_BUFFER);
+		reg = sdhci_readl(host, SDHCI_PRESENT_STATE);
+		if (count-- == 0) {
+			dev_warn(mmc_dev(host->mmc),
+				"CQE may get stuck because the Buffer Read Enable bit is set\n");
+			break;
+		}
+		mdelay(1);
+	}
+
+	/*
+	 * Runtime resume resets the whole controller, which also clears the
+	 * DMAEN and BCEN bits of ESDHC_MIX_CTRL, so set them again here.
+	 */
+	mode = sdhci_readw(host, SDHCI_TRANSFER_MODE);
+	if (host->flags & SDHCI_REQ_USE_DMA)
+		mode |= SDHCI_TRNS_DMA;
+	if (!(host->quirks2 & SDHCI_QUIRK2_SUPPORT_SINGLE))
+		mode |= SDHCI_TRNS_BLK_CNT_EN;
+	sdhci_writew(host, mode, SDHCI_TRANSFER_MODE);
+
+	/*
+	 * The controller reset does not touch the CQHCI side, so clear the
+	 * HALT bit or the first request after system resume gets stuck.
+	 */
+	cqhci_writel(cq_host, 0, CQHCI_CTL);
+	if (cqhci_readl(cq_host, CQHCI_CTL) & CQHCI_HALT)
+		dev_err(mmc_dev(host->mmc),
+			"failed to exit halt state when enable CQE\n");
+
+	sdhci_cqe_enable(mmc);
+}
+
+static void esdhc_sdhci_dumpregs(struct mmc_host *mmc)
+{
+	sdhci_dumpregs(mmc_priv(mmc));
+}
+
+static const struct cqhci_host_ops esdhc_cqhci_ops = {
+	.enable		= esdhc_cqe_enable,
+	.disable	= sdhci_cqe_disable,
+	.dumpregs	= esdhc_sdhci_dumpregs,
+};
+
 static void sdhci_esdhc_imx_hwinit(struct sdhci_host *host)
 {
 	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
@@ -1287,6 +1520,7 @@ static int sdhci_esdhc_imx_probe(struct platform_device *pdev)
 			of_match_device(imx_esdhc_dt_ids, &pdev->dev);
 	struct sdhci_pltfm_host *pltfm_host;
 	struct sdhci_host *host;
+	struct cqhci_host *cq_host;
 	int err;
 	struct pltfm_imx_data *imx_data;
 
@@ -1367,12 +1601,33 @@ static int sdhci_esdhc_imx_probe(struct platform_device *pdev)
 		sdhci_esdhc_ops.platform_execute_tuning =
 					esdhc_executing_tuning;
 
+	if (imx_data->socdata->flags &
+	    (ESDHC_FLAG_MAN_TUNING | ESDHC_FLAG_STD_TUNING))
+		host->mmc_host_ops.execute_tuning = esdhc_execute_tuning;
+
 	if (imx_data->socdata->flags & ESDHC_FLAG_ERR004536)
 		host->quirks |= SDHCI_QUIRK_BROKEN_ADMA;
 
 	if (imx_data->socdata->flags & ESDHC_FLAG_HS400)
 		host->quirks2 |= SDHCI_QUIRK2_CAPS_BIT63_FOR_HS400;
 
+	if (imx_data->socdata->flags & ESDHC_FLAG_CQHCI) {
+		host->mmc->caps2 |= MMC_CAP2_CQE;
+		cq_host = devm_kzalloc(&pdev->dev, sizeof(*cq_host),
+				       GFP_KERNEL);
+		if (!cq_host) {
+			err = -ENOMEM;
+			goto disable_clk;
+		}
+
+		cq_host->mmio = host->ioaddr + ESDHC_CQHCI_ADDR_OFFSET;
+		cq_host->ops = &esdhc_cqhci_ops;
+
+		err = cqhci_init(cq_host, host->mmc, false);
+		if (err)
+			goto disable_clk;
+	}
+
 	if (of_id)
 		err = sdhci_esdhc_imx_probe_dt(pdev, host, imx_data);
 	else
@@ -1394,6 +1649,9 @@ static int sdhci_esdhc_imx_probe(struct platform_device *pdev)
 	pm_suspend_ignore_children(&pdev->dev, 1);
 	pm_runtime_enable(&pdev->dev);
 
+	/* the card, its only dependent, is a descendant and waits for us */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 
 disable_clk:
@@ -1455,6 +1713,12 @@ static int sdhci_esdhc_suspend(struct device *dev)
 		mmc_retune_needed(host->mmc);
 	}
 
+	if (host->mmc->caps2 & MMC_CAP2_CQE) {
+		ret = cqhci_suspend(host->mmc);
+		if (ret)
+			return ret;
+	}
+
 	ret = sdhci_suspend_host(host);
 
 	pinctrl_pm_select_sleep_state(dev);
@@ -1473,7 +1737,13 @@ static int sdhci_esdhc_resume(struct device *dev)
 	sdhci_esdhc_imx_hwinit(host);
 
 	ret = sdhci_resume_host(host);
+	if (ret)
+		goto out;
 
+	if (host->mmc->caps2 & MMC_CAP2_CQE)
+		ret = cqhci_resume(host->mmc);
+
+out:
 #ifdef CONFIG_PM
 	pm_runtime_mark_last_busy(host->mmc->parent);
 	pm_runtime_put_autosuspend(host->mmc->parent);
@@ -1491,6 +1761,15 @@ static int sdhci_esdhc_runtime_suspend(struct device *dev)
 	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
 	int ret;
 
+	if (host->mmc->caps2 & MMC_CAP2_CQE) {
+		ret = cqhci_suspend(host->mmc);
+		if (ret)
+			return ret;
+	}
+
+	/* the tuning is restored on resume, see sdhci_esdhc_runtime_resume() */
+	imx_data->retune_pending = host->mmc->need_retune;
+
 	ret = sdhci_runtime_suspend_host(host);
 
 	if (!sdhci_sdio_irq_enabled(host)) {
@@ -1513,6 +1792,7 @@ static int sdhci_esdhc_runtime_resume(struct device *dev)
 	struct sdhci_host *host = dev_get_drvdata(dev);
 	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
 	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	int err;
 
 	if (imx_data->socdata->flags & ESDHC_FLAG_BUSFREQ)
 		request_bus_freq(BUS_FREQ_HIGH);
@@ -1527,7 +1807,25 @@ static int sdhci_esdhc_runtime_resume(struct device *dev)
 	}
 	clk_prepare_enable(imx_data->clk_ahb);
 
-	return sdhci_runtime_resume_host(host);
+	err = sdhci_runtime_resume_host(host);
+	if (err)
+		return err;
+
+	/*
+	 * Put the last good tuning delay straight back instead of re-tuning
+	 * at the next request, unless the temperature changed or a re-tune
+	 * was already due before suspend, e.g. after a CRC error.
+	 */
+	if (host->mmc->card && !imx_data->retune_pending &&
+	    esdhc_tuning_is_cached(host)) {
+		esdhc_restore_tuning(host);
+		host->mmc->need_retune = 0;
+	}
+
+	if (host->mmc->caps2 & MMC_CAP2_CQE)
+		err = cqhci_resume(host->mmc);
+
+	return err;
 }
 #endif
 
@@ -1540,6 +1838,7 @@ static const struct dev_pm_ops sdhci_esdhc_pmops = {
 static struct platform_driver sdhci_esdhc_imx_driver = {
 	.driver		= {
 		.name	= "sdhci-esdhc-imx",
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = imx_esdhc_dt_ids,
 		.pm	= &sdhci_esdhc_pmops,
 	},
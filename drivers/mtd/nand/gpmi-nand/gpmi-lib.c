@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/pm_runtime.h>
 #include <linux/debugfs.h>
+#include <linux/of.h>
 
 
 #include "gpmi-nand.h"
@@ -960,9 +961,79 @@ static void gpmi_compute_edo_timing(struct gpmi_nand_data *this,
 	delay  = (((t_rea + c - t_rp) * 8) * 10) / rp;
 	delay = (delay + 5) / 10;
 
+	/* A calibrated or configured delay beats the datasheet one */
+	if (this->rdn_delay >= 0)
+		delay = this->rdn_delay;
+
 	hw->sample_delay_factor = delay;
 }
 
+/* Read the ONFI parameter page back at the current timings */
+static bool gpmi_edo_read_ok(struct gpmi_nand_data *this, u8 *buf)
+{
+	struct nand_chip *nand = &this->nand;
+	struct mtd_info *mtd = nand_to_mtd(nand);
+	size_t len = sizeof(nand->onfi_params);
+	bool ok;
+
+	/* Let the gpmi_begin() apply the new RDN_DELAY. */
+	this->flags &= ~GPMI_TIMING_INIT_OK;
+
+	nand->select_chip(mtd, 0);
+	nand->cmdfunc(mtd, NAND_CMD_PARAM, 0, -1);
+	nand->read_buf(mtd, buf, len);
+	ok = !memcmp(buf, &nand->onfi_params, len);
+	nand->select_chip(mtd, -1);
+
+	return ok;
+}
+
+/*
+ * The computed RDN_DELAY only holds for datasheet tREA and nominal board
+ * delays. Sweep all the delays, reading the ONFI parameter page that
+ * nand_scan_ident() got at safe timings, and keep the middle of the widest
+ * window which reads it back correctly twice.
+ */
+static int gpmi_edo_calibrate(struct gpmi_nand_data *this)
+{
+	struct timing_threshod *nfc = &timing_default_threshold;
+	int best_start = 0, best_len = 0, start = 0, len = 0;
+	unsigned int delay;
+	u8 *buf;
+
+	buf = kmalloc(sizeof(this->nand.onfi_params), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (delay = 0; delay <= nfc->max_sample_delay_factor; delay++) {
+		this->rdn_delay = delay;
+		if (gpmi_edo_read_ok(this, buf) &&
+		    gpmi_edo_read_ok(this, buf)) {
+			if (!len++)
+				start = delay;
+			if (len > best_len) {
+				best_start = start;
+				best_len = len;
+			}
+		} else {
+			len = 0;
+		}
+	}
+	kfree(buf);
+
+	this->flags &= ~GPMI_TIMING_INIT_OK;
+	if (!best_len) {
+		this->rdn_delay = -1;
+		return -EIO;
+	}
+
+	this->rdn_delay = best_start + best_len / 2;
+	dev_info(this->dev, "EDO mode %d calibrated, RDN_DELAY %d (%d-%d ok)\n",
+		 this->timing_mode, this->rdn_delay, best_start,
+		 best_start + best_len - 1);
+	return 0;
+}
+
 static int enable_edo_mode(struct gpmi_nand_data *this, int mode)
 {
 	struct resources  *r = &this->resources;
@@ -1030,17 +1101,39 @@ int gpmi_extra_init(struct gpmi_nand_data *this)
 	/* Enable the asynchronous EDO feature. */
 	if ((GPMI_IS_MX6(this) || GPMI_IS_MX7(this))
 			&& chip->onfi_version) {
-		int mode = onfi_get_async_timing_mode(chip);
+		int modes = onfi_get_async_timing_mode(chip);
+		bool preset;
+		u32 delay;
+		int mode;
+		int ret;
+
+		/* A RDN_DELAY saved from an earlier calibration */
+		preset = !of_property_read_u32(this->dev->of_node,
+					       "fsl,rdn-delay", &delay);
+		if (preset)
+			this->rdn_delay = delay;
 
-		/* We only support the timing mode 4 and mode 5. */
-		if (mode & ONFI_TIMING_MODE_5)
-			mode = 5;
-		else if (mode & ONFI_TIMING_MODE_4)
-			mode = 4;
-		else
-			return 0;
+		/*
+		 * We only support the timing mode 4 and mode 5. Fall back to
+		 * mode 4 if no delay reads mode 5 reliably.
+		 */
+		for (mode = 5; mode >= 4; mode--) {
+			if (!(modes & (ONFI_TIMING_MODE_0 << mode)))
+				continue;
+
+			ret = enable_edo_mode(this, mode);
+			if (ret)
+				return ret;
+
+			if (preset || !gpmi_edo_calibrate(this))
+				return 0;
+		}
 
-		return enable_edo_mode(this, mode);
+		if (this->flags & GPMI_ASYNC_EDO_ENABLED) {
+			dev_warn(this->dev, "EDO calibration failed, disabled\n");
+			this->flags &= ~(GPMI_ASYNC_EDO_ENABLED |
+					 GPMI_TIMING_INIT_OK);
+		}
 	}
 	return 0;
 }
@@ -1287,6 +1380,37 @@ int gpmi_read_data(struct gpmi_nand_data *this)
 	return start_dma_without_bch_irq(this, desc);
 }
 
+/*
+ * Let the DMA engine watch the ready/busy line and sleep until it
+ * interrupts, instead of polling it from the CPU for the program or
+ * erase time.
+ */
+int gpmi_wait_ready(struct gpmi_nand_data *this)
+{
+	struct dma_async_tx_descriptor *desc;
+	struct dma_chan *channel = get_dma_chan(this);
+	int chip = this->current_chip;
+	u32 pio[2];
+
+	pio[0] = BF_GPMI_CTRL0_COMMAND_MODE(
+				BV_GPMI_CTRL0_COMMAND_MODE__WAIT_FOR_READY)
+		| BM_GPMI_CTRL0_WORD_LENGTH
+		| BF_GPMI_CTRL0_CS(chip, this)
+		| BF_GPMI_CTRL0_LOCK_CS(LOCK_CS_ENABLE, this)
+		| BF_GPMI_CTRL0_ADDRESS(BV_GPMI_CTRL0_ADDRESS__NAND_DATA)
+		| BF_GPMI_CTRL0_XFER_COUNT(0);
+	pio[1] = 0;
+	desc = dmaengine_prep_slave_sg(channel,
+				(struct scatterlist *)pio, ARRAY_SIZE(pio),
+				DMA_TRANS_NONE,
+				DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc)
+		return -EINVAL;
+
+	set_dma_type(this, DMA_FOR_WAIT_READY);
+	return start_dma_without_bch_irq(this, desc);
+}
+
 int gpmi_send_page(struct gpmi_nand_data *this,
 			dma_addr_t payload, dma_addr_t auxiliary)
 {
@@ -665,6 +665,9 @@ static void dma_irq_callback(void *param)
 		/* We have to wait the BCH interrupt to finish. */
 		break;
 
+	case DMA_FOR_WAIT_READY:
+		break;
+
 	default:
 		dev_err(this->dev, "in wrong DMA operation.\n");
 	}
@@ -1143,6 +1146,36 @@ static int gpmi_dev_ready(struct mtd_info *mtd)
 	return gpmi_is_ready(this, this->current_chip);
 }
 
+/*
+ * Program and erase take hundreds of microseconds to milliseconds, which
+ * nand_wait() would spend polling the ready/busy line. Sleep on the DMA
+ * interrupt instead so the CPU is free for other work meanwhile.
+ */
+static int gpmi_waitfunc(struct mtd_info *mtd, struct nand_chip *chip)
+{
+	struct gpmi_nand_data *this = nand_get_controller_data(chip);
+	unsigned long timeo = jiffies + msecs_to_jiffies(400);
+
+	/* let the chip take R/B# low first (tWB) */
+	ndelay(100);
+
+	if (in_interrupt() || oops_in_progress ||
+	    gpmi_wait_ready(this) < 0) {
+		/* Fall back to polling, as nand_wait() does */
+		while (!gpmi_is_ready(this, this->current_chip)) {
+			if (time_after(jiffies, timeo))
+				break;
+			if (!in_interrupt() && !oops_in_progress)
+				cond_resched();
+			else
+				udelay(10);
+		}
+	}
+
+	chip->cmdfunc(mtd, NAND_CMD_STATUS, -1, -1);
+	return chip->read_byte(mtd);
+}
+
 static void gpmi_select_chip(struct mtd_info *mtd, int chipnr)
 {
 	struct nand_chip *chip = mtd_to_nand(mtd);
@@ -2294,12 +2327,15 @@ static int gpmi_nand_init(struct gpmi_nand_data *this)
 	chip->select_chip	= gpmi_select_chip;
 	chip->cmd_ctrl		= gpmi_cmd_ctrl;
 	chip->dev_ready		= gpmi_dev_ready;
+	chip->waitfunc		= gpmi_waitfunc;
 	chip->read_byte		= gpmi_read_byte;
 	chip->read_buf		= gpmi_read_buf;
 	chip->write_buf		= gpmi_write_buf;
 	chip->badblock_pattern	= &gpmi_bbt_descr;
 	chip->block_markbad	= gpmi_block_markbad;
 	chip->options		|= NAND_NO_SUBPAGE_WRITE;
+	/* The BCH read chain only transfers data, it can follow cache reads */
+	chip->options		|= NAND_CACHE_READ;
 
 	/* Set up swap_block_mark, must be set before the gpmi_set_geometry() */
 	this->swap_block_mark = !GPMI_IS_MX23(this);
@@ -2388,6 +2424,22 @@ static const struct of_device_id gpmi_nand_id_table[] = {
 };
 MODULE_DEVICE_TABLE(of, gpmi_nand_id_table);
 
+/*
+ * The EDO RDN_DELAY in use, -1 when EDO is off. Copy it into the
+ * "fsl,rdn-delay" property to skip the calibration on the next boots.
+ */
+static ssize_t rdn_delay_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct gpmi_nand_data *this = dev_get_drvdata(dev);
+
+	if (!(this->flags & GPMI_ASYNC_EDO_ENABLED))
+		return sprintf(buf, "-1\n");
+
+	return sprintf(buf, "%d\n", this->rdn_delay);
+}
+static DEVICE_ATTR_RO(rdn_delay);
+
 static int gpmi_nand_probe(struct platform_device *pdev)
 {
 	struct gpmi_nand_data *this;
@@ -2409,6 +2461,7 @@ static int gpmi_nand_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, this);
 	this->pdev  = pdev;
 	this->dev   = &pdev->dev;
+	this->rdn_delay = -1;
 
 	ret = acquire_resources(this);
 	if (ret)
@@ -2426,6 +2479,9 @@ static int gpmi_nand_probe(struct platform_device *pdev)
 	if (ret)
 		goto exit_nfc_init;
 
+	if (device_create_file(this->dev, &dev_attr_rdn_delay))
+		dev_warn(this->dev, "failed to create rdn_delay attribute\n");
+
 	dev_info(this->dev, "driver registered.\n");
 
 	return 0;
@@ -2441,6 +2497,7 @@ static int gpmi_nand_remove(struct platform_device *pdev)
 {
 	struct gpmi_nand_data *this = platform_get_drvdata(pdev);
 
+	device_remove_file(this->dev, &dev_attr_rdn_delay);
 	gpmi_nand_exit(this);
 	pm_runtime_disable(this->dev);
 	release_resources(this);
@@ -87,7 +87,8 @@ enum dma_ops_type {
 	DMA_FOR_READ_DATA,
 	DMA_FOR_WRITE_DATA,
 	DMA_FOR_READ_ECC_PAGE,
-	DMA_FOR_WRITE_ECC_PAGE
+	DMA_FOR_WRITE_ECC_PAGE,
+	DMA_FOR_WAIT_READY
 };
 
 /**
@@ -157,6 +158,7 @@ struct gpmi_nand_data {
 	/* Flash Hardware */
 	struct nand_timing	timing;
 	int			timing_mode;
+	int			rdn_delay; /* EDO RDN_DELAY, -1: computed */
 
 	/* BCH */
 	struct bch_geometry	bch_geometry;
@@ -297,6 +299,7 @@ extern int gpmi_send_command(struct gpmi_nand_data *);
 extern void gpmi_begin(struct gpmi_nand_data *);
 extern void gpmi_end(struct gpmi_nand_data *);
 extern int gpmi_read_data(struct gpmi_nand_data *);
+extern int gpmi_wait_ready(struct gpmi_nand_data *);
 extern int gpmi_send_data(struct gpmi_nand_data *);
 extern int gpmi_send_page(struct gpmi_nand_data *,
 			dma_addr_t payload, dma_addr_t auxiliary);
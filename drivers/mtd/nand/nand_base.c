@@ -1964,6 +1964,61 @@ static int nand_setup_read_retry(struct mtd_info *mtd, int retry_mode)
 	return chip->setup_read_retry(mtd, retry_mode);
 }
 
+/**
+ * nand_cache_read_last - [INTERN] Last page of a cache read sequence
+ * @mtd: MTD device structure
+ * @realpage: page about to be read with NAND_CMD_READ0
+ * @col: column of the read in @realpage
+ * @readlen: number of bytes left to read, starting at @col
+ * @subpage: a partial last page would go through ecc.read_subpage()
+ *
+ * Returns the last page that can be read from the cache register while
+ * the array loads the next one, or -1 when the read is too short to be
+ * worth pipelining. The sequence never leaves the current block.
+ */
+static int nand_cache_read_last(struct mtd_info *mtd, int realpage, int col,
+				uint32_t readlen, bool subpage)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+	int ppb = 1 << (chip->phys_erase_shift - chip->page_shift);
+	int last;
+
+	last = realpage + ((col + readlen - 1) >> chip->page_shift);
+
+	/* Subpage reads move the column, keep them out of the sequence */
+	if (subpage && ((col + readlen) & (mtd->writesize - 1)))
+		last--;
+
+	last = min(last, realpage | (ppb - 1));
+	if (last <= realpage)
+		return -1;
+
+	/* Pages of the sequence must all come from the chip */
+	if (chip->pagebuf > realpage && chip->pagebuf <= last)
+		chip->pagebuf = -1;
+
+	return last;
+}
+
+/**
+ * nand_cache_read_end - [INTERN] Stop a cache read sequence early
+ * @mtd: MTD device structure
+ * @realpage: page just read from the cache register
+ * @cache_last: last page of the sequence, reset to -1
+ *
+ * The array is still busy loading the page after @realpage; let it finish
+ * and leave cache read mode before any other command is issued.
+ */
+static void nand_cache_read_end(struct mtd_info *mtd, int realpage,
+				int *cache_last)
+{
+	struct nand_chip *chip = mtd_to_nand(mtd);
+
+	if (realpage < *cache_last)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+	*cache_last = -1;
+}
+
 /**
  * nand_do_read_ops - [INTERN] Read data with ECC
  * @mtd: MTD device structure
@@ -1987,6 +2042,8 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	bool subpage;
+	int cache_last = -1;
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -2021,8 +2078,31 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 				pr_debug("%s: using read bounce buffer for buf@%p\n",
 						 __func__, buf);
 
+			subpage = ops->mode != MTD_OPS_RAW &&
+				  NAND_HAS_SUBPAGE_READ(chip) && !oob;
 read_retry:
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			if (realpage <= cache_last) {
+				/*
+				 * The previous command moved this page to the
+				 * cache register, keep the array busy with the
+				 * next one while this one is transferred.
+				 */
+				chip->cmdfunc(mtd, realpage < cache_last ?
+					      NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+			} else {
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+
+				if (NAND_HAS_CACHE_READ(chip) && !retry_mode &&
+				    (aligned || !subpage))
+					cache_last = nand_cache_read_last(mtd,
+							realpage, col, readlen,
+							subpage);
+				if (realpage < cache_last)
+					chip->cmdfunc(mtd,
+						      NAND_CMD_READCACHESEQ,
+						      -1, -1);
+			}
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -2032,8 +2112,7 @@ read_retry:
 				ret = chip->ecc.read_page_raw(mtd, chip, bufpoi,
 							      oob_required,
 							      page);
-			else if (!aligned && NAND_HAS_SUBPAGE_READ(chip) &&
-				 !oob)
+			else if (!aligned && subpage)
 				ret = chip->ecc.read_subpage(mtd, chip,
 							col, bytes, bufpoi,
 							page);
@@ -2083,6 +2162,9 @@ read_retry:
 
 			if (mtd->ecc_stats.failed - ecc_failures) {
 				if (retry_mode + 1 < chip->read_retries) {
+					/* No retry mode change mid-sequence */
+					nand_cache_read_end(mtd, realpage,
+							    &cache_last);
 					retry_mode++;
 					ret = nand_setup_read_retry(mtd,
 							retry_mode);
@@ -2132,6 +2214,7 @@ read_retry:
 			chip->select_chip(mtd, chipnr);
 		}
 	}
+	nand_cache_read_end(mtd, realpage, &cache_last);
 	chip->select_chip(mtd, -1);
 
 	ops->retlen = ops->len - (size_t) readlen;
@@ -4823,6 +4906,12 @@ int nand_scan_tail(struct mtd_info *mtd)
 	/* Invalidate the pagebuffer reference */
 	chip->pagebuf = -1;
 
+	/* Read cache commands are optional, only use them when advertised */
+	if (NAND_HAS_CACHE_READ(chip) &&
+	    (!(onfi_opt_cmd(chip) & ONFI_OPT_CMD_READ_CACHE) ||
+	     chip->options & NAND_NEED_READRDY))
+		chip->options &= ~NAND_CACHE_READ;
+
 	/* Large page NAND with SOFT_ECC should support subpage reads */
 	switch (ecc->mode) {
 	case NAND_ECC_SOFT:
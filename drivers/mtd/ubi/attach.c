@@ -87,6 +87,7 @@
 #include <linux/crc32.h>
 #include <linux/math64.h>
 #include <linux/random.h>
+#include <linux/workqueue.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -940,30 +941,84 @@ static bool vol_ignored(int vol_id)
 }
 
 /**
- * scan_peb - scan and process UBI headers of a PEB.
+ * struct ubi_peb_hdrs - UBI headers of a PEB, as read from the flash.
+ * @pnum: the physical eraseblock number
+ * @bad: what 'ubi_io_is_bad()' returned
+ * @ec_err: what 'ubi_io_read_ec_hdr()' returned
+ * @vid_err: what 'ubi_io_read_vid_hdr()' returned, if it had to be called
+ * @ech: the EC header
+ * @vidh: the VID header
+ *
+ * Reading the headers is separate from processing them, so that the reads
+ * can run in parallel while the processing keeps the PEB order.
+ */
+struct ubi_peb_hdrs {
+	int pnum;
+	int bad;
+	int ec_err;
+	int vid_err;
+	struct ubi_ec_hdr ech;
+	struct ubi_vid_hdr vidh;
+};
+
+/**
+ * read_peb_hdrs - read the UBI headers of a PEB.
  * @ubi: UBI device description object
- * @ai: attaching information
  * @pnum: the physical eraseblock number
+ * @ech: I/O buffer for the EC header
+ * @vidb: I/O buffer for the VID header
+ * @hdrs: where to store the headers and the read results
+ *
+ * The VID header is only read if the EC header says the PEB is not empty.
+ */
+static void read_peb_hdrs(struct ubi_device *ubi, int pnum,
+			  struct ubi_ec_hdr *ech, struct ubi_vid_io_buf *vidb,
+			  struct ubi_peb_hdrs *hdrs)
+{
+	hdrs->pnum = pnum;
+	hdrs->ec_err = 0;
+	hdrs->vid_err = 0;
+
+	hdrs->bad = ubi_io_is_bad(ubi, pnum);
+	if (hdrs->bad)
+		return;
+
+	hdrs->ec_err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	if (hdrs->ec_err < 0 || hdrs->ec_err == UBI_IO_FF ||
+	    hdrs->ec_err == UBI_IO_FF_BITFLIPS)
+		return;
+	memcpy(&hdrs->ech, ech, UBI_EC_HDR_SIZE);
+
+	hdrs->vid_err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	if (hdrs->vid_err >= 0)
+		memcpy(&hdrs->vidh, ubi_get_vid_hdr(vidb), UBI_VID_HDR_SIZE);
+}
+
+/**
+ * process_peb - process UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @ai: attaching information
+ * @hdrs: the headers, as read by 'read_peb_hdrs()'
  * @fast: true if we're scanning for a Fastmap
  *
- * This function reads UBI headers of PEB @pnum, checks them, and adds
+ * This function checks the UBI headers of PEB @hdrs->pnum, and adds
  * information about this PEB to the corresponding list or RB-tree in the
  * "attaching info" structure. Returns zero if the physical eraseblock was
  * successfully handled and a negative error code in case of failure.
  */
-static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		    int pnum, bool fast)
+static int process_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		       struct ubi_peb_hdrs *hdrs, bool fast)
 {
-	struct ubi_ec_hdr *ech = ai->ech;
-	struct ubi_vid_io_buf *vidb = ai->vidb;
-	struct ubi_vid_hdr *vidh = ubi_get_vid_hdr(vidb);
+	struct ubi_ec_hdr *ech = &hdrs->ech;
+	struct ubi_vid_hdr *vidh = &hdrs->vidh;
+	int pnum = hdrs->pnum;
 	long long ec;
 	int err, bitflips = 0, vol_id = -1, ec_err = 0;
 
 	dbg_bld("scan PEB %d", pnum);
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
+	err = hdrs->bad;
 	if (err < 0)
 		return err;
 	else if (err) {
@@ -971,7 +1026,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	err = hdrs->ec_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1054,7 +1109,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	err = hdrs->vid_err;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1205,6 +1260,188 @@ adjust_mean_ec:
 	return 0;
 }
 
+/**
+ * scan_peb - scan and process UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @ai: attaching information
+ * @pnum: the physical eraseblock number
+ * @fast: true if we're scanning for a Fastmap
+ *
+ * This function reads UBI headers of PEB @pnum, checks them, and adds
+ * information about this PEB to the corresponding list or RB-tree in the
+ * "attaching info" structure. Returns zero if the physical eraseblock was
+ * successfully handled and a negative error code in case of failure.
+ */
+static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		    int pnum, bool fast)
+{
+	struct ubi_peb_hdrs hdrs;
+
+	read_peb_hdrs(ubi, pnum, ai->ech, ai->vidb, &hdrs);
+	return process_peb(ubi, ai, &hdrs, fast);
+}
+
+/*
+ * Number of PEBs whose headers are read in parallel while the previous
+ * batch is processed.
+ */
+#define SCAN_BATCH 64
+
+/**
+ * struct scan_batch - a batch of PEBs read by the scan workers.
+ * @hdrs: headers of the PEBs of the batch
+ * @first: first PEB of the batch
+ * @count: number of PEBs in the batch
+ * @next: next index in @hdrs for a worker to read
+ * @pending: number of workers still reading the batch
+ * @done: completed when the last worker is done
+ */
+struct scan_batch {
+	struct ubi_peb_hdrs hdrs[SCAN_BATCH];
+	int first;
+	int count;
+	atomic_t next;
+	atomic_t pending;
+	struct completion done;
+};
+
+/**
+ * struct scan_worker - a scan worker and its I/O buffers.
+ * @work: the work item
+ * @ubi: UBI device description object
+ * @batch: the batch being read
+ * @ech: I/O buffer for EC headers
+ * @vidb: I/O buffer for VID headers
+ */
+struct scan_worker {
+	struct work_struct work;
+	struct ubi_device *ubi;
+	struct scan_batch *batch;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_io_buf *vidb;
+};
+
+static void scan_worker_fn(struct work_struct *work)
+{
+	struct scan_worker *w = container_of(work, struct scan_worker, work);
+	struct scan_batch *batch = w->batch;
+	int i;
+
+	while ((i = atomic_inc_return(&batch->next) - 1) < batch->count)
+		read_peb_hdrs(w->ubi, batch->first + i, w->ech, w->vidb,
+			      &batch->hdrs[i]);
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static void scan_batch_start(struct workqueue_struct *wq,
+			     struct scan_worker *workers, int nr_workers,
+			     struct scan_batch *batch, int first, int count)
+{
+	int i;
+
+	batch->first = first;
+	batch->count = count;
+	atomic_set(&batch->next, 0);
+	atomic_set(&batch->pending, nr_workers);
+	reinit_completion(&batch->done);
+
+	for (i = 0; i < nr_workers; i++) {
+		workers[i].batch = batch;
+		queue_work(wq, &workers[i].work);
+	}
+}
+
+/**
+ * scan_peb_range - scan PEBs with parallel header reads.
+ * @ubi: UBI device description object
+ * @ai: attaching information
+ * @start: first PEB to scan
+ *
+ * The EC and VID headers of the next batch of PEBs are read by
+ * %ubi_scan_threads workers while the current batch is processed in PEB
+ * order, so the attach information ends up exactly as with a sequential
+ * scan. Returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+static int scan_peb_range(struct ubi_device *ubi, struct ubi_attach_info *ai,
+			  int start)
+{
+	int nr_workers = min_t(int, ubi_scan_threads,
+			       num_online_cpus());
+	struct workqueue_struct *wq;
+	struct scan_worker *workers;
+	struct scan_batch *batch;
+	int i, err = -ENOMEM, pnum, cur = 0;
+
+	workers = kcalloc(nr_workers, sizeof(*workers), GFP_KERNEL);
+	batch = kcalloc(2, sizeof(*batch), GFP_KERNEL);
+	if (!workers || !batch)
+		goto out_free;
+
+	for (i = 0; i < nr_workers; i++) {
+		INIT_WORK(&workers[i].work, scan_worker_fn);
+		workers[i].ubi = ubi;
+		workers[i].ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		workers[i].vidb = ubi_alloc_vid_buf(ubi, GFP_KERNEL);
+		if (!workers[i].ech || !workers[i].vidb)
+			goto out_free;
+	}
+	init_completion(&batch[0].done);
+	init_completion(&batch[1].done);
+
+	wq = alloc_workqueue("ubi_scan%d", WQ_UNBOUND, nr_workers,
+			     ubi->ubi_num);
+	if (!wq)
+		goto out_free;
+
+	err = 0;
+	pnum = start;
+	scan_batch_start(wq, workers, nr_workers, &batch[cur], pnum,
+			 min(SCAN_BATCH, ubi->peb_count - pnum));
+
+	while (pnum < ubi->peb_count) {
+		struct scan_batch *b = &batch[cur];
+
+		wait_for_completion(&b->done);
+		pnum += b->count;
+
+		/* Read ahead while this batch is processed */
+		cur ^= 1;
+		if (pnum < ubi->peb_count) {
+			int count = min(SCAN_BATCH, ubi->peb_count - pnum);
+
+			scan_batch_start(wq, workers, nr_workers, &batch[cur],
+					 pnum, count);
+		}
+
+		for (i = 0; i < b->count; i++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", b->first + i);
+			err = process_peb(ubi, ai, &b->hdrs[i], false);
+			if (err < 0)
+				break;
+		}
+		if (err < 0)
+			break;
+	}
+
+	destroy_workqueue(wq);
+
+out_free:
+	if (workers) {
+		for (i = 0; i < nr_workers; i++) {
+			ubi_free_vid_buf(workers[i].vidb);
+			kfree(workers[i].ech);
+		}
+	}
+	kfree(batch);
+	kfree(workers);
+	return err;
+}
+
 /**
  * late_analysis - analyze the overall situation with PEB.
  * @ubi: UBI device description object
@@ -1401,13 +1638,19 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!ai->vidb)
 		goto out_ech;
 
-	for (pnum = start; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
-
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, false);
+	if (ubi_scan_threads > 1 && num_online_cpus() > 1) {
+		err = scan_peb_range(ubi, ai, start);
 		if (err < 0)
 			goto out_vidh;
+	} else {
+		for (pnum = start; pnum < ubi->peb_count; pnum++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", pnum);
+			err = scan_peb(ubi, ai, pnum, false);
+			if (err < 0)
+				goto out_vidh;
+		}
 	}
 
 	ubi_msg(ubi, "scanning is finished");
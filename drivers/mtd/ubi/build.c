@@ -82,8 +82,14 @@ static struct mtd_dev_param __initdata mtd_dev_param[UBI_MAX_DEVICES];
 /* UBI module parameter to enable fastmap automatically on non-fastmap images */
 static bool fm_autoconvert;
 static bool fm_debug;
+/* Fastmap pool sizes overriding the default and on-flash ones, if not zero */
+static int fm_pool_size;
+static int fm_wl_pool_size;
 #endif
 
+/* Number of threads reading PEB headers when attaching by scanning */
+int ubi_scan_threads = 4;
+
 /* Slab cache for wear-leveling entries */
 struct kmem_cache *ubi_wl_entry_slab;
 
@@ -125,6 +131,9 @@ struct class ubi_class = {
 
 static ssize_t dev_attribute_show(struct device *dev,
 				  struct device_attribute *attr, char *buf);
+static ssize_t dev_attribute_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count);
 
 /* UBI device attributes (correspond to files in '/<sysfs>/class/ubi/ubiX') */
 static struct device_attribute dev_eraseblock_size =
@@ -151,6 +160,18 @@ static struct device_attribute dev_mtd_num =
 	__ATTR(mtd_num, S_IRUGO, dev_attribute_show, NULL);
 static struct device_attribute dev_ro_mode =
 	__ATTR(ro_mode, S_IRUGO, dev_attribute_show, NULL);
+static struct device_attribute dev_bgt_idle_ms =
+	__ATTR(bgt_idle_ms, 0644, dev_attribute_show, dev_attribute_store);
+static struct device_attribute dev_bgt_wl_interval_ms =
+	__ATTR(bgt_wl_interval_ms, 0644, dev_attribute_show,
+	       dev_attribute_store);
+static struct device_attribute dev_bgt_max_defer_ms =
+	__ATTR(bgt_max_defer_ms, 0644, dev_attribute_show,
+	       dev_attribute_store);
+static struct device_attribute dev_bgt_deferred_erase =
+	__ATTR(bgt_deferred_erase, 0444, dev_attribute_show, NULL);
+static struct device_attribute dev_bgt_deferred_wl =
+	__ATTR(bgt_deferred_wl, 0444, dev_attribute_show, NULL);
 
 /**
  * ubi_volume_notify - send a volume change notification.
@@ -389,6 +410,16 @@ static ssize_t dev_attribute_show(struct device *dev,
 		ret = sprintf(buf, "%d\n", ubi->mtd->index);
 	else if (attr == &dev_ro_mode)
 		ret = sprintf(buf, "%d\n", ubi->ro_mode);
+	else if (attr == &dev_bgt_idle_ms)
+		ret = sprintf(buf, "%u\n", ubi->bgt_idle_ms);
+	else if (attr == &dev_bgt_wl_interval_ms)
+		ret = sprintf(buf, "%u\n", ubi->bgt_wl_interval_ms);
+	else if (attr == &dev_bgt_max_defer_ms)
+		ret = sprintf(buf, "%u\n", ubi->bgt_max_defer_ms);
+	else if (attr == &dev_bgt_deferred_erase)
+		ret = sprintf(buf, "%lu\n", ubi->bgt_deferred_erase);
+	else if (attr == &dev_bgt_deferred_wl)
+		ret = sprintf(buf, "%lu\n", ubi->bgt_deferred_wl);
 	else
 		ret = -EINVAL;
 
@@ -396,6 +427,43 @@ static ssize_t dev_attribute_show(struct device *dev,
 	return ret;
 }
 
+/* "Store" method for files in '/<sysfs>/class/ubi/ubiX/' */
+static ssize_t dev_attribute_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct ubi_device *ubi;
+	unsigned int val;
+	ssize_t ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	/* See the comment in 'dev_attribute_show()' */
+	ubi = container_of(dev, struct ubi_device, dev);
+	ubi = ubi_get_device(ubi->ubi_num);
+	if (!ubi)
+		return -ENODEV;
+
+	ret = count;
+	if (attr == &dev_bgt_idle_ms)
+		WRITE_ONCE(ubi->bgt_idle_ms, val);
+	else if (attr == &dev_bgt_wl_interval_ms)
+		WRITE_ONCE(ubi->bgt_wl_interval_ms, val);
+	else if (attr == &dev_bgt_max_defer_ms)
+		WRITE_ONCE(ubi->bgt_max_defer_ms, val);
+	else
+		ret = -EINVAL;
+
+	/* Let the background thread re-evaluate what it deferred */
+	if (ret > 0 && ubi->thread_enabled)
+		wake_up_process(ubi->bgt_thread);
+
+	ubi_put_device(ubi);
+	return ret;
+}
+
 static struct attribute *ubi_dev_attrs[] = {
 	&dev_eraseblock_size.attr,
 	&dev_avail_eraseblocks.attr,
@@ -409,6 +477,11 @@ static struct attribute *ubi_dev_attrs[] = {
 	&dev_bgt_enabled.attr,
 	&dev_mtd_num.attr,
 	&dev_ro_mode.attr,
+	&dev_bgt_idle_ms.attr,
+	&dev_bgt_wl_interval_ms.attr,
+	&dev_bgt_max_defer_ms.attr,
+	&dev_bgt_deferred_erase.attr,
+	&dev_bgt_deferred_wl.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(ubi_dev);
@@ -986,6 +1059,27 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 		goto out_free;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/*
+	 * Larger pools mean fewer fastmap writes, at the cost of more PEBs to
+	 * scan when attaching. The new sizes are used from the next refill.
+	 */
+	if (fm_pool_size || fm_wl_pool_size) {
+		spin_lock(&ubi->wl_lock);
+		if (fm_pool_size)
+			ubi->fm_pool.max_size = clamp(fm_pool_size,
+						      UBI_FM_MIN_POOL_SIZE,
+						      UBI_FM_MAX_POOL_SIZE);
+		if (fm_wl_pool_size)
+			ubi->fm_wl_pool.max_size = clamp(fm_wl_pool_size,
+							 UBI_FM_MIN_POOL_SIZE,
+							 UBI_FM_MAX_POOL_SIZE);
+		spin_unlock(&ubi->wl_lock);
+		ubi_msg(ubi, "fastmap pool size set to %d, WL pool size %d",
+			ubi->fm_pool.max_size, ubi->fm_wl_pool.max_size);
+	}
+#endif
+
 	if (ubi->autoresize_vol_id != -1) {
 		err = autoresize(ubi, ubi->autoresize_vol_id);
 		if (err)
@@ -1484,11 +1578,17 @@ MODULE_PARM_DESC(mtd, "MTD devices to attach. Parameter format: mtd=<name|num|pa
 		      "Example 3: mtd=/dev/mtd1,0,25 - attach MTD device /dev/mtd1 using default VID header offset and reserve 25*nand_size_in_blocks/1024 erase blocks for bad block handling.\n"
 		      "Example 4: mtd=/dev/mtd1,0,0,5 - attach MTD device /dev/mtd1 to UBI 5 and using default values for the other fields.\n"
 		      "\t(e.g. if the NAND *chipset* has 4096 PEB, 100 will be reserved for this UBI device).");
+module_param_named(scan_threads, ubi_scan_threads, int, 0644);
+MODULE_PARM_DESC(scan_threads, "Number of threads reading PEB headers in parallel when attaching by scanning (default: 4, 1 to scan sequentially).");
 #ifdef CONFIG_MTD_UBI_FASTMAP
 module_param(fm_autoconvert, bool, 0644);
 MODULE_PARM_DESC(fm_autoconvert, "Set this parameter to enable fastmap automatically on images without a fastmap.");
 module_param(fm_debug, bool, 0);
 MODULE_PARM_DESC(fm_debug, "Set this parameter to enable fastmap debugging by default. Warning, this will make fastmap slow!");
+module_param(fm_pool_size, int, 0644);
+MODULE_PARM_DESC(fm_pool_size, "Maximum number of PEBs in the fastmap user pool, from 8 to 256 (default: 5% of the PEBs, or the size stored in the fastmap).");
+module_param(fm_wl_pool_size, int, 0644);
+MODULE_PARM_DESC(fm_wl_pool_size, "Maximum number of PEBs in the fastmap WL pool, from 8 to 256 (default: half the user pool, or the size stored in the fastmap).");
 #endif
 MODULE_VERSION(__stringify(UBI_VERSION));
 MODULE_DESCRIPTION("UBI - Unsorted Block Images");
@@ -248,6 +248,19 @@ again:
 	ubi_assert(pool->used < pool->size);
 	ret = pool->pebs[pool->used++];
 	prot_queue_add(ubi, ubi->lookuptbl[ret]);
+
+	/*
+	 * Write the next fastmap from the work queue when the pool is almost
+	 * empty, instead of stalling the writer which finds it empty. Only do
+	 * so if the last refill filled the pool, otherwise free PEBs are short
+	 * and an early refill would just mean more fastmap writes.
+	 */
+	if (!ubi->fm_disabled && pool->size == pool->max_size &&
+	    pool->size - pool->used <= pool->max_size / 8 &&
+	    !ubi->fm_work_scheduled) {
+		ubi->fm_work_scheduled = 1;
+		schedule_work(&ubi->fm_work);
+	}
 	spin_unlock(&ubi->wl_lock);
 out:
 	return ret;
@@ -520,6 +520,18 @@ struct ubi_debug_info {
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @fg_io: number of foreground read and write requests in flight
+ * @fg_io_last: jiffies at which the last foreground request finished
+ * @wl_last: jiffies at which the background thread last started a
+ *	     wear-leveling move
+ * @bgt_idle_ms: how long the device has to be idle before the background
+ *		 thread does deferrable works (0 to never defer them)
+ * @bgt_wl_interval_ms: minimum time between two wear-leveling moves done by
+ *			the background thread
+ * @bgt_max_defer_ms: maximum time a work may be deferred
+ * @bgt_deferred_erase: count of erasures the background thread deferred
+ * @bgt_deferred_wl: count of wear-leveling moves the background thread
+ *		     deferred
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -624,6 +636,14 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+	atomic_t fg_io;
+	unsigned long fg_io_last;
+	unsigned long wl_last;
+	unsigned int bgt_idle_ms;
+	unsigned int bgt_wl_interval_ms;
+	unsigned int bgt_max_defer_ms;
+	unsigned long bgt_deferred_erase;
+	unsigned long bgt_deferred_wl;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -820,6 +840,7 @@ extern const struct file_operations ubi_vol_cdev_operations;
 extern struct class ubi_class;
 extern struct mutex ubi_devices_mutex;
 extern struct blocking_notifier_head ubi_notifiers;
+extern int ubi_scan_threads;
 
 /* attach.c */
 struct ubi_ainf_peb *ubi_alloc_aeb(struct ubi_attach_info *ai, int pnum,
@@ -1157,6 +1178,28 @@ static inline void ubi_ro_mode(struct ubi_device *ubi)
 	}
 }
 
+/**
+ * ubi_fg_io_start - account the start of a foreground I/O request.
+ * @ubi: UBI device description object
+ *
+ * The background thread defers its works while foreground requests are in
+ * flight, see 'ubi_thread()'.
+ */
+static inline void ubi_fg_io_start(struct ubi_device *ubi)
+{
+	atomic_inc(&ubi->fg_io);
+}
+
+/**
+ * ubi_fg_io_end - account the end of a foreground I/O request.
+ * @ubi: UBI device description object
+ */
+static inline void ubi_fg_io_end(struct ubi_device *ubi)
+{
+	WRITE_ONCE(ubi->fg_io_last, jiffies);
+	atomic_dec(&ubi->fg_io);
+}
+
 /**
  * vol_id2idx - get table index by volume ID.
  * @ubi: UBI device description object
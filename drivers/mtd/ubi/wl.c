@@ -135,6 +135,17 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * Below this number of free physical eraseblocks the background thread never
+ * defers its works, as foreground writes would soon have to wait for them.
+ */
+#define WL_BGT_FREE_LOW 16
+
+/* Default background thread scheduling parameters, in milliseconds */
+#define WL_BGT_IDLE_MS 50
+#define WL_BGT_WL_INTERVAL_MS 100
+#define WL_BGT_MAX_DEFER_MS 2000
+
 static int self_check_ec(struct ubi_device *ubi, int pnum, int ec);
 static int self_check_in_wl_tree(const struct ubi_device *ubi,
 				 struct ubi_wl_entry *e, struct rb_root *root);
@@ -1451,6 +1462,58 @@ static void tree_destroy(struct ubi_device *ubi, struct rb_root *root)
 	}
 }
 
+/**
+ * bgt_defer - find out whether the background thread should defer a work.
+ * @ubi: UBI device description object
+ * @wrk: the work at the head of the queue
+ * @since: jiffies at which @wrk was first deferred
+ *
+ * Erasures and wear-leveling moves are deferred while foreground I/O is in
+ * flight or finished less than @ubi->bgt_idle_ms ago, and wear-leveling moves
+ * are spaced by at least @ubi->bgt_wl_interval_ms. Nothing is deferred when
+ * free PEBs run low, for fastmap anchors, or for longer than
+ * @ubi->bgt_max_defer_ms. Note, works done by 'produce_free_peb()' on behalf
+ * of a waiting writer never go through here.
+ *
+ * Returns how many jiffies to wait, or zero if @wrk has to be done now. Has
+ * to be called with @ubi->wl_lock held.
+ */
+static unsigned long bgt_defer(struct ubi_device *ubi, struct ubi_work *wrk,
+			       unsigned long since)
+{
+	unsigned long now = jiffies, until = now, deadline;
+	unsigned int idle = READ_ONCE(ubi->bgt_idle_ms);
+
+	if (ubi->free_count < WL_BGT_FREE_LOW || wrk->anchor)
+		return 0;
+
+	deadline = since + msecs_to_jiffies(READ_ONCE(ubi->bgt_max_defer_ms));
+	if (time_after_eq(now, deadline))
+		return 0;
+
+	if (idle) {
+		if (atomic_read(&ubi->fg_io))
+			until = now + msecs_to_jiffies(idle);
+		else
+			until = READ_ONCE(ubi->fg_io_last) +
+				msecs_to_jiffies(idle);
+	}
+
+	if (wrk->func == wear_leveling_worker) {
+		unsigned long next = ubi->wl_last +
+			msecs_to_jiffies(READ_ONCE(ubi->bgt_wl_interval_ms));
+
+		if (time_after(next, until))
+			until = next;
+	}
+
+	if (!time_after(until, now))
+		return 0;
+	if (time_after(until, deadline))
+		until = deadline;
+	return until - now;
+}
+
 /**
  * ubi_thread - UBI background thread.
  * @u: the UBI device description object pointer
@@ -1459,12 +1522,16 @@ int ubi_thread(void *u)
 {
 	int failures = 0;
 	struct ubi_device *ubi = u;
+	struct ubi_work *deferred = NULL;
+	unsigned long deferred_since = 0;
 
 	ubi_msg(ubi, "background thread \"%s\" started, PID %d",
 		ubi->bgt_name, task_pid_nr(current));
 
 	set_freezable();
 	for (;;) {
+		struct ubi_work *wrk;
+		unsigned long delay;
 		int err;
 
 		if (kthread_should_stop())
@@ -1481,6 +1548,27 @@ int ubi_thread(void *u)
 			schedule();
 			continue;
 		}
+
+		wrk = list_first_entry(&ubi->works, struct ubi_work, list);
+		if (wrk != deferred)
+			deferred_since = jiffies;
+		delay = bgt_defer(ubi, wrk, deferred_since);
+		if (delay) {
+			if (wrk != deferred) {
+				if (wrk->func == wear_leveling_worker)
+					ubi->bgt_deferred_wl += 1;
+				else
+					ubi->bgt_deferred_erase += 1;
+				deferred = wrk;
+			}
+			set_current_state(TASK_INTERRUPTIBLE);
+			spin_unlock(&ubi->wl_lock);
+			schedule_timeout(delay);
+			continue;
+		}
+		deferred = NULL;
+		if (wrk->func == wear_leveling_worker)
+			ubi->wl_last = jiffies;
 		spin_unlock(&ubi->wl_lock);
 
 		err = do_work(ubi);
@@ -1548,6 +1636,11 @@ int ubi_wl_init(struct ubi_device *ubi, struct ubi_attach_info *ai)
 	spin_lock_init(&ubi->wl_lock);
 	mutex_init(&ubi->move_mutex);
 	init_rwsem(&ubi->work_sem);
+	atomic_set(&ubi->fg_io, 0);
+	ubi->fg_io_last = ubi->wl_last = jiffies;
+	ubi->bgt_idle_ms = WL_BGT_IDLE_MS;
+	ubi->bgt_wl_interval_ms = WL_BGT_WL_INTERVAL_MS;
+	ubi->bgt_max_defer_ms = WL_BGT_MAX_DEFER_MS;
 	ubi->max_ec = ai->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
 
@@ -659,8 +659,6 @@ static void asrc_input_dma_callback(void *data)
 			DMA_MEM_TO_DEV);
 
 	complete(&params->input_complete);
-
-	schedule_work(&params->task_output_work);
 }
 
 static void asrc_output_dma_callback(void *data)
@@ -673,6 +671,13 @@ static void asrc_output_dma_callback(void *data)
 	complete(&params->output_complete);
 }
 
+static void asrc_drain_dma_callback(void *data)
+{
+	struct asrc_pair_params *params = (struct asrc_pair_params *)data;
+
+	complete(&params->output_complete);
+}
+
 static unsigned int asrc_get_output_FIFO_size(enum asrc_pair_index index)
 {
 	u32 val;
@@ -693,20 +698,25 @@ static u32 asrc_read_one_from_output_FIFO(enum asrc_pair_index index)
 	return val;
 }
 
+/* Append what is left in the output FIFO to the last period buffer */
 static void asrc_read_output_FIFO(struct asrc_pair_params *params)
 {
-	u32 *reg24 = params->output_last_period.dma_vaddr;
-	u16 *reg16 = params->output_last_period.dma_vaddr;
+	struct dma_block *last = &params->output_last_period;
+	u32 *reg24 = last->dma_vaddr + last->length;
+	u16 *reg16 = last->dma_vaddr + last->length;
 	enum asrc_pair_index index = params->index;
-	u32 i, j, reg, size, t_size;
+	u32 i, j, reg, size, t_size, frame_size;
 	bool bit24 = false;
 
 	if (params->output_word_width == ASRC_WIDTH_24_BIT)
 		bit24 = true;
 
-	t_size = 0;
+	frame_size = params->channel_nums * (bit24 ? 4 : 2);
+	t_size = last->length / frame_size;
 	do {
 		size = asrc_get_output_FIFO_size(index);
+		if (size > params->last_period_sample - t_size)
+			size = params->last_period_sample - t_size;
 		for (i = 0; i < size; i++) {
 			for (j = 0; j < params->channel_nums; j++) {
 				reg = asrc_read_one_from_output_FIFO(index);
@@ -722,37 +732,66 @@ static void asrc_read_output_FIFO(struct asrc_pair_params *params)
 		t_size += size;
 	} while (size);
 
-	if (t_size > params->last_period_sample)
-		t_size = params->last_period_sample;
-
-	params->output_last_period.length = t_size * params->channel_nums * 2;
-	if (bit24)
-		params->output_last_period.length *= 2;
+	last->length = t_size * frame_size;
 }
 
-static void asrc_output_task_worker(struct work_struct *w)
+/*
+ * Fetch the tail of a conversion once the main output DMA is done.
+ * Whole watermark bursts still in the output FIFO are moved by a short
+ * DMA transfer into the coherent last period buffer; only what is left
+ * below the output watermark, which raises no DMA request, is read by
+ * the CPU.
+ */
+static int asrc_drain_output(struct asrc_pair_params *params)
 {
-	struct asrc_pair_params *params =
-		container_of(w, struct asrc_pair_params, task_output_work);
+	struct dma_block *last = &params->output_last_period;
+	struct dma_chan *chan = params->output_dma_channel;
 	enum asrc_pair_index index = params->index;
+	struct completion *done = &params->output_complete;
+	struct dma_async_tx_descriptor *desc;
+	u32 frames, frame_size;
 	unsigned long lock_flags;
 
-	if (!wait_for_completion_interruptible_timeout(&params->output_complete, HZ / 10)) {
-		pair_err("output dma task timeout\n");
-		return;
-	}
-
-	init_completion(&params->output_complete);
-
 	spin_lock_irqsave(&pair_lock, lock_flags);
 	if (!params->pair_hold) {
 		spin_unlock_irqrestore(&pair_lock, lock_flags);
-		return;
+		return -EFAULT;
 	}
-	asrc_read_output_FIFO(params);
 	spin_unlock_irqrestore(&pair_lock, lock_flags);
 
-	complete(&params->lastperiod_complete);
+	last->length = 0;
+	frame_size = params->channel_nums *
+		(params->output_word_width == ASRC_WIDTH_24_BIT ? 4 : 2);
+
+	frames = min(asrc_get_output_FIFO_size(index),
+		     params->last_period_sample);
+	frames -= frames % params->output_wm;
+
+	if (frames) {
+		desc = dmaengine_prep_slave_single(chan, last->dma_paddr,
+				frames * frame_size, DMA_DEV_TO_MEM,
+				DMA_PREP_INTERRUPT);
+		if (desc) {
+			desc->callback = asrc_drain_dma_callback;
+			desc->callback_param = params;
+
+			reinit_completion(done);
+			dmaengine_submit(desc);
+			dma_async_issue_pending(chan);
+
+			if (wait_for_completion_timeout(done,
+							msecs_to_jiffies(10)))
+				last->length = frames * frame_size;
+			else
+				dmaengine_terminate_all(chan);
+		}
+		if (!last->length)
+			pair_dbg("last period dma failed, draining by cpu\n");
+	}
+
+	asrc_read_output_FIFO(params);
+
+	return 0;
 }
 
 static void mxc_free_dma_buf(struct asrc_pair_params *params)
@@ -1027,6 +1066,7 @@ int mxc_asrc_process_io_buffer(struct asrc_pair_params *params,
 	struct completion *complete;
 	void __user *buf_vaddr;
 	void *dma_vaddr;
+	int ret;
 
 	if (in) {
 		dma_vaddr = params->input_dma_total.dma_vaddr;
@@ -1038,12 +1078,12 @@ int mxc_asrc_process_io_buffer(struct asrc_pair_params *params,
 		dma_vaddr = params->output_dma_total.dma_vaddr;
 		dma_len = params->output_dma_total.length;
 		buf_len = &pbuf->output_buffer_length;
-		complete = &params->lastperiod_complete;
+		complete = &params->output_complete;
 		buf_vaddr = (void __user *)pbuf->output_buffer_vaddr;
 	}
 
 	if (!wait_for_completion_interruptible_timeout(complete, 10 * HZ)) {
-		pair_err("%s task timeout\n", in ? "input dma" : "last period");
+		pair_err("%sput dma task timeout\n", in ? "in" : "out");
 		return -ETIME;
 	} else if (signal_pending(current)) {
 		pair_err("%sput task forcibly aborted\n", in ? "in" : "out");
@@ -1056,6 +1096,10 @@ int mxc_asrc_process_io_buffer(struct asrc_pair_params *params,
 
 	/* Only output need return data to user space */
 	if (!in) {
+		ret = asrc_drain_output(params);
+		if (ret)
+			return ret;
+
 		if (copy_to_user(buf_vaddr, dma_vaddr, dma_len))
 			return -EFAULT;
 
@@ -1150,7 +1194,7 @@ static void asrc_polling_debug(struct asrc_pair_params *params)
 			DMA_DEV_TO_MEM);
 
 	complete(&params->input_complete);
-	complete(&params->lastperiod_complete);
+	complete(&params->output_complete);
 }
 #else
 static void mxc_asrc_submit_dma(struct asrc_pair_params *params)
@@ -1288,10 +1332,6 @@ static long asrc_ioctl_config_pair(struct asrc_pair_params *params,
 
 	init_completion(&params->input_complete);
 	init_completion(&params->output_complete);
-	init_completion(&params->lastperiod_complete);
-
-	/* Add work struct to receive last period of output data */
-	INIT_WORK(&params->task_output_work, asrc_output_task_worker);
 
 	ret = copy_to_user(user, &config, sizeof(config));
 	if (ret) {
@@ -1445,7 +1485,6 @@ static long asrc_ioctl_flush(struct asrc_pair_params *params,
 	enum asrc_pair_index index = params->index;
 	init_completion(&params->input_complete);
 	init_completion(&params->output_complete);
-	init_completion(&params->lastperiod_complete);
 
 	/* Release DMA and request again */
 	dma_release_channel(params->input_dma_channel);
@@ -1548,7 +1587,6 @@ static int mxc_asrc_close(struct inode *inode, struct file *file)
 
 		complete(&params->input_complete);
 		complete(&params->output_complete);
-		complete(&params->lastperiod_complete);
 	}
 
 	if (params->pair_hold) {
@@ -435,6 +435,22 @@ _DmabufPhysical(
     return gcvSTATUS_OK;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
+static gceSTATUS
+_DmabufReservation(
+    IN gckALLOCATOR Allocator,
+    IN PLINUX_MDL Mdl,
+    OUT struct reservation_object ** Resv
+    )
+{
+    gcsDMABUF *buf_desc = Mdl->priv;
+
+    *Resv = buf_desc->dmabuf->resv;
+
+    return *Resv ? gcvSTATUS_OK : gcvSTATUS_NOT_SUPPORTED;
+}
+#endif
+
 /* Default allocator operations. */
 static gcsALLOCATOR_OPERATIONS DmabufAllocatorOperations =
 {
@@ -446,6 +462,9 @@ static gcsALLOCATOR_OPERATIONS DmabufAllocatorOperations =
     .UnmapKernel        = _DmabufUnmapKernel,
     .Cache              = _DmabufCache,
     .Physical           = _DmabufPhysical,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
+    .Reservation        = _DmabufReservation,
+#endif
 };
 
 extern void
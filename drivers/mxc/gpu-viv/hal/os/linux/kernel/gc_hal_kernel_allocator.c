@@ -65,6 +65,7 @@
 #include <linux/anon_inodes.h>
 #endif
 #include <linux/file.h>
+#include <linux/shrinker.h>
 
 #include "gc_hal_kernel_allocator_array.h"
 #include "gc_hal_kernel_platform.h"
@@ -73,11 +74,48 @@
 
 #define gcdDISCRETE_PAGES 0
 
+/*
+ * Freed pages are kept in pools by order and handed out again without the
+ * cache flush a fresh page needs, as only uncached mappings touched them
+ * meanwhile. Pages which were mapped cacheable are not pooled. A shrinker
+ * gives pooled pages back under memory pressure.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 12, 0) && !gcdNONPAGED_MEMORY_CACHEABLE
+#define gcdPAGE_POOL 1
+#else
+#define gcdPAGE_POOL 0
+#endif
+
+/* Highest order of contiguous allocations which are pooled. */
+#define gcdPAGE_POOL_MAX_ORDER  4
+
+/* Pages kept in all pools together. */
+#define gcdPAGE_POOL_LIMIT      4096
+
+typedef struct _gcsPAGE_POOL
+{
+    /* Free blocks, linked by page->lru of their first page. */
+    struct list_head        blocks;
+    gctUINT32               count;
+
+    gctUINT32               hits;
+    gctUINT32               misses;
+}
+gcsPAGE_POOL;
+
 typedef struct _gcsDEFAULT_PRIV * gcsDEFAULT_PRIV_PTR;
 typedef struct _gcsDEFAULT_PRIV
 {
     gctUINT32 low;
     gctUINT32 high;
+
+#if gcdPAGE_POOL
+    spinlock_t              poolLock;
+    gcsPAGE_POOL            pool[gcdPAGE_POOL_MAX_ORDER + 1];
+    gctUINT32               poolPages;
+    gctUINT32               poolShrunk;
+    struct shrinker         shrinker;
+#endif
 }
 gcsDEFAULT_PRIV;
 
@@ -104,9 +142,307 @@ typedef struct _gcsDEFAULT_MDL_PRIV
     gcsPLATFORM *           platform;
 
     gctBOOL                 contiguous;
+
+    /* Has been mapped cacheable, so can't be pooled. */
+    gctBOOL                 mappedCacheable;
 }
 gcsDEFAULT_MDL_PRIV;
 
+/******************************************************************************\
+******************************** Page Pools ************************************
+\******************************************************************************/
+
+#if gcdPAGE_POOL
+static struct page *
+_PoolTake(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctUINT32 Order
+    )
+{
+    gcsPAGE_POOL *pool = &Priv->pool[Order];
+    struct page *page = gcvNULL;
+
+    spin_lock(&Priv->poolLock);
+
+    if (pool->count)
+    {
+        page = list_first_entry(&pool->blocks, struct page, lru);
+        list_del(&page->lru);
+
+        pool->count--;
+        Priv->poolPages -= 1 << Order;
+    }
+
+    spin_unlock(&Priv->poolLock);
+
+    return page;
+}
+
+static gctBOOL
+_PoolPut(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN struct page * Page,
+    IN gctUINT32 Order,
+    IN gctBOOL Exact
+    )
+{
+    gcsPAGE_POOL *pool = &Priv->pool[Order];
+    gctBOOL pooled = gcvFALSE;
+
+    spin_lock(&Priv->poolLock);
+
+    if (Priv->poolPages + (1 << Order) <= gcdPAGE_POOL_LIMIT)
+    {
+        /* Remember how the block has to be freed eventually. */
+        set_page_private(Page, Exact);
+        list_add(&Page->lru, &pool->blocks);
+
+        pool->count++;
+        Priv->poolPages += 1 << Order;
+        pooled = gcvTRUE;
+    }
+
+    spin_unlock(&Priv->poolLock);
+
+    return pooled;
+}
+
+static void
+_PoolAccount(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctUINT32 Order,
+    IN gctUINT32 Hits,
+    IN gctUINT32 Misses
+    )
+{
+    spin_lock(&Priv->poolLock);
+    Priv->pool[Order].hits += Hits;
+    Priv->pool[Order].misses += Misses;
+    spin_unlock(&Priv->poolLock);
+}
+
+static void
+_PoolFreeBlock(
+    IN struct page * Page,
+    IN gctUINT32 Order
+    )
+{
+    if (page_private(Page))
+    {
+        set_page_private(Page, 0);
+        free_pages_exact(page_address(Page), PAGE_SIZE << Order);
+    }
+    else
+    {
+        __free_pages(Page, Order);
+    }
+}
+
+/* Pool order of a contiguous allocation, -1 if it is not pooled. */
+static gctINT
+_PoolOrder(
+    IN gctSIZE_T NumPages
+    )
+{
+    gctINT order = get_order(NumPages << PAGE_SHIFT);
+
+    if ((1UL << order) != NumPages || order > gcdPAGE_POOL_MAX_ORDER)
+    {
+        return -1;
+    }
+
+    return order;
+}
+
+static gctBOOL
+_PoolTakeContiguous(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctSIZE_T NumPages,
+    IN gcsDEFAULT_MDL_PRIV_PTR MdlPriv
+    )
+{
+    gctINT order = _PoolOrder(NumPages);
+    struct page *page;
+
+    if (order < 0)
+    {
+        return gcvFALSE;
+    }
+
+    page = _PoolTake(Priv, order);
+
+    _PoolAccount(Priv, order, page ? 1 : 0, page ? 0 : 1);
+
+    if (!page)
+    {
+        return gcvFALSE;
+    }
+
+    MdlPriv->u.contiguousPages = page;
+    MdlPriv->exact = page_private(page);
+    set_page_private(page, 0);
+
+    return gcvTRUE;
+}
+
+static gctBOOL
+_PoolPutContiguous(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN PLINUX_MDL Mdl
+    )
+{
+    gcsDEFAULT_MDL_PRIV_PTR mdlPriv = Mdl->priv;
+    gctINT order = _PoolOrder(Mdl->numPages);
+
+    if (order < 0 || mdlPriv->mappedCacheable)
+    {
+        return gcvFALSE;
+    }
+
+    return _PoolPut(Priv, mdlPriv->u.contiguousPages, order, mdlPriv->exact);
+}
+
+static unsigned long
+_PoolShrinkCount(
+    struct shrinker *Shrinker,
+    struct shrink_control *Sc
+    )
+{
+    gcsDEFAULT_PRIV_PTR priv =
+        container_of(Shrinker, gcsDEFAULT_PRIV, shrinker);
+
+    return priv->poolPages;
+}
+
+static unsigned long
+_PoolShrinkScan(
+    struct shrinker *Shrinker,
+    struct shrink_control *Sc
+    )
+{
+    gcsDEFAULT_PRIV_PTR priv =
+        container_of(Shrinker, gcsDEFAULT_PRIV, shrinker);
+    unsigned long freed = 0;
+    struct page *page;
+    gctINT order;
+
+    /* Large blocks first, they are the hardest for the system to find. */
+    for (order = gcdPAGE_POOL_MAX_ORDER;
+         order >= 0 && freed < Sc->nr_to_scan;
+         order--)
+    {
+        while (freed < Sc->nr_to_scan && (page = _PoolTake(priv, order)))
+        {
+            _PoolFreeBlock(page, order);
+            freed += 1 << order;
+        }
+    }
+
+    spin_lock(&priv->poolLock);
+    priv->poolShrunk += freed;
+    spin_unlock(&priv->poolLock);
+
+    return freed ? freed : SHRINK_STOP;
+}
+
+static void
+_PoolInit(
+    IN gcsDEFAULT_PRIV_PTR Priv
+    )
+{
+    gctINT order;
+
+    spin_lock_init(&Priv->poolLock);
+
+    for (order = 0; order <= gcdPAGE_POOL_MAX_ORDER; order++)
+    {
+        INIT_LIST_HEAD(&Priv->pool[order].blocks);
+    }
+
+    Priv->shrinker.count_objects = _PoolShrinkCount;
+    Priv->shrinker.scan_objects  = _PoolShrinkScan;
+    Priv->shrinker.seeks         = DEFAULT_SEEKS;
+
+    if (register_shrinker(&Priv->shrinker))
+    {
+        /* Don't pool anything which could not be given back. */
+        Priv->shrinker.count_objects = gcvNULL;
+        Priv->poolPages = gcdPAGE_POOL_LIMIT;
+    }
+}
+
+static void
+_PoolDeinit(
+    IN gcsDEFAULT_PRIV_PTR Priv
+    )
+{
+    struct page *page;
+    gctINT order;
+
+    if (Priv->shrinker.count_objects)
+    {
+        unregister_shrinker(&Priv->shrinker);
+    }
+
+    for (order = 0; order <= gcdPAGE_POOL_MAX_ORDER; order++)
+    {
+        while ((page = _PoolTake(Priv, order)))
+        {
+            _PoolFreeBlock(page, order);
+        }
+    }
+}
+#else
+static inline struct page *
+_PoolTake(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctUINT32 Order
+    )
+{
+    return gcvNULL;
+}
+
+static inline gctBOOL
+_PoolPut(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN struct page * Page,
+    IN gctUINT32 Order,
+    IN gctBOOL Exact
+    )
+{
+    return gcvFALSE;
+}
+
+static inline void
+_PoolAccount(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctUINT32 Order,
+    IN gctUINT32 Hits,
+    IN gctUINT32 Misses
+    )
+{
+}
+
+static inline gctBOOL
+_PoolTakeContiguous(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctSIZE_T NumPages,
+    IN gcsDEFAULT_MDL_PRIV_PTR MdlPriv
+    )
+{
+    return gcvFALSE;
+}
+
+static inline gctBOOL
+_PoolPutContiguous(
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN PLINUX_MDL Mdl
+    )
+{
+    return gcvFALSE;
+}
+#endif
+
 /******************************************************************************\
 ************************** Default Allocator Debugfs ***************************
 \******************************************************************************/
@@ -123,9 +459,44 @@ int gc_usage_show(struct seq_file* m, void* data)
     return 0;
 }
 
+#if gcdPAGE_POOL
+int gc_pool_show(struct seq_file* m, void* data)
+{
+    gcsINFO_NODE *node = m->private;
+    gckALLOCATOR Allocator = node->device;
+    gcsDEFAULT_PRIV_PTR priv = Allocator->privateData;
+    gcsPAGE_POOL pool[gcdPAGE_POOL_MAX_ORDER + 1];
+    gctUINT32 pages, shrunk;
+    gctINT order;
+
+    spin_lock(&priv->poolLock);
+    memcpy(pool, priv->pool, sizeof(pool));
+    pages = priv->poolPages;
+    shrunk = priv->poolShrunk;
+    spin_unlock(&priv->poolLock);
+
+    seq_puts(m, "order   blocks       hits     misses\n");
+
+    for (order = 0; order <= gcdPAGE_POOL_MAX_ORDER; order++)
+    {
+        seq_printf(m, "%5d %8u %10u %10u\n",
+                   order, pool[order].count,
+                   pool[order].hits, pool[order].misses);
+    }
+
+    seq_printf(m, "\nTotal %u pages pooled, limit %u, %u pages shrunk\n",
+               pages, gcdPAGE_POOL_LIMIT, shrunk);
+
+    return 0;
+}
+#endif
+
 static gcsINFO InfoList[] =
 {
     {"lowHighUsage", gc_usage_show},
+#if gcdPAGE_POOL
+    {"pagePool", gc_pool_show},
+#endif
 };
 
 static void
@@ -191,6 +562,7 @@ _NonContiguousToPhys(
 
 static void
 _NonContiguousFree(
+    IN gcsDEFAULT_PRIV_PTR Priv,
     IN struct page ** Pages,
     IN gctUINT32 NumPages
     )
@@ -203,7 +575,11 @@ _NonContiguousFree(
 
     for (i = 0; i < NumPages; i++)
     {
-        __free_page(Pages[i]);
+        /* Keep the page for reuse if a pool is given and has room. */
+        if (!Priv || !_PoolPut(Priv, Pages[i], 0, gcvFALSE))
+        {
+            __free_page(Pages[i]);
+        }
     }
 
     if (is_vmalloc_addr(Pages))
@@ -220,7 +596,9 @@ _NonContiguousFree(
 
 static struct page **
 _NonContiguousAlloc(
-    IN gctUINT32 NumPages
+    IN gcsDEFAULT_PRIV_PTR Priv,
+    IN gctUINT32 NumPages,
+    OUT gctUINT32 * Pooled
     )
 {
     struct page ** pages;
@@ -257,13 +635,29 @@ _NonContiguousAlloc(
         }
     }
 
+    /* Pooled pages come first, they need no cache flush. */
     for (i = 0; i < NumPages; i++)
+    {
+        p = _PoolTake(Priv, 0);
+
+        if (!p)
+        {
+            break;
+        }
+
+        pages[i] = p;
+    }
+
+    *Pooled = i;
+    _PoolAccount(Priv, 0, *Pooled, NumPages - *Pooled);
+
+    for (; i < NumPages; i++)
     {
         p = alloc_page(GFP_KERNEL | __GFP_HIGHMEM | gcdNOWARN);
 
         if (!p)
         {
-            _NonContiguousFree(pages, i);
+            _NonContiguousFree(gcvNULL, pages, i);
             gcmkFOOTER_NO();
             return gcvNULL;
         }
@@ -284,7 +678,7 @@ _NonContiguousAlloc(
 
                 if (!p)
                 {
-                    _NonContiguousFree(pages, i);
+                    _NonContiguousFree(gcvNULL, pages, i);
                     gcmkFOOTER_NO();
                     return gcvNULL;
                 }
@@ -512,6 +906,7 @@ _DefaultAlloc(
 {
     gceSTATUS status;
     gctUINT i;
+    gctUINT32 pooled = 0;
     gctBOOL contiguous = Flags & gcvALLOC_FLAG_CONTIGUOUS;
 #ifdef gcdSYS_FREE_MEMORY_LIMIT
     struct sysinfo temsysinfo;
@@ -544,12 +939,22 @@ _DefaultAlloc(
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)
         void *addr = NULL;
+#endif
+
+        if (_PoolTakeContiguous(priv, NumPages, mdlPriv))
+        {
+            pooled = NumPages;
+        }
 
-        addr = alloc_pages_exact(bytes, GFP_KERNEL | gcdNOWARN | __GFP_NORETRY);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)
+        if (mdlPriv->u.contiguousPages == gcvNULL)
+        {
+            addr = alloc_pages_exact(bytes, GFP_KERNEL | gcdNOWARN | __GFP_NORETRY);
 
-        mdlPriv->u.contiguousPages = addr ? virt_to_page(addr) : gcvNULL;
+            mdlPriv->u.contiguousPages = addr ? virt_to_page(addr) : gcvNULL;
 
-        mdlPriv->exact = gcvTRUE;
+            mdlPriv->exact = gcvTRUE;
+        }
 #endif
 
         if (mdlPriv->u.contiguousPages == gcvNULL)
@@ -577,7 +982,8 @@ _DefaultAlloc(
     }
     else
     {
-        mdlPriv->u.nonContiguousPages = _NonContiguousAlloc(NumPages);
+        mdlPriv->u.nonContiguousPages =
+            _NonContiguousAlloc(priv, NumPages, &pooled);
 
         if (mdlPriv->u.nonContiguousPages == gcvNULL)
         {
@@ -607,29 +1013,36 @@ _DefaultAlloc(
 
         if (PageHighMem(page))
         {
+            /* Pooled pages have been flushed already. */
+            if (i >= pooled)
+            {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 37)
-            void *vaddr = kmap_atomic(page);
+                void *vaddr = kmap_atomic(page);
 #else
-            void *vaddr = kmap_atomic(page, KM_USER0);
+                void *vaddr = kmap_atomic(page, KM_USER0);
 #endif
 
-            gcmkVERIFY_OK(gckOS_CacheFlush(
-                Allocator->os, _GetProcessID(), gcvNULL, phys, vaddr, PAGE_SIZE
-                ));
+                gcmkVERIFY_OK(gckOS_CacheFlush(
+                    Allocator->os, _GetProcessID(), gcvNULL, phys, vaddr, PAGE_SIZE
+                    ));
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 37)
-            kunmap_atomic(vaddr);
+                kunmap_atomic(vaddr);
 #else
-            kunmap_atomic(vaddr, KM_USER0);
+                kunmap_atomic(vaddr, KM_USER0);
 #endif
+            }
 
             priv->high += PAGE_SIZE;
         }
         else
         {
-            gcmkVERIFY_OK(gckOS_CacheFlush(
-                Allocator->os, _GetProcessID(), gcvNULL, phys, page_address(page), PAGE_SIZE
-                ));
+            if (i >= pooled)
+            {
+                gcmkVERIFY_OK(gckOS_CacheFlush(
+                    Allocator->os, _GetProcessID(), gcvNULL, phys, page_address(page), PAGE_SIZE
+                    ));
+            }
 
             priv->low += PAGE_SIZE;
         }
@@ -698,20 +1111,25 @@ _DefaultFree(
 
     if (Mdl->contiguous)
     {
+        if (_PoolPutContiguous(priv, Mdl))
+        {
+            /* Kept for reuse. */
+        }
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)
-        if (mdlPriv->exact == gcvTRUE)
+        else if (mdlPriv->exact == gcvTRUE)
         {
             free_pages_exact(page_address(mdlPriv->u.contiguousPages), Mdl->numPages * PAGE_SIZE);
         }
-        else
 #endif
+        else
         {
             __free_pages(mdlPriv->u.contiguousPages, get_order(Mdl->numPages * PAGE_SIZE));
         }
     }
     else
     {
-        _NonContiguousFree(mdlPriv->u.nonContiguousPages, Mdl->numPages);
+        _NonContiguousFree(mdlPriv->mappedCacheable ? gcvNULL : priv,
+                           mdlPriv->u.nonContiguousPages, Mdl->numPages);
     }
 
     if (mdlPriv->file != gcvNULL)
@@ -742,6 +1160,11 @@ _DefaultMapUser(
     /* mdlPriv->cacheable must be used under protection of mdl->mapMutex. */
     mdlPriv->cacheable = Cacheable;
 
+    if (Cacheable)
+    {
+        mdlPriv->mappedCacheable = gcvTRUE;
+    }
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 4, 0)
     userLogical = (gctSTRING)vm_mmap(mdlPriv->file,
                     0L,
@@ -910,6 +1333,18 @@ _DefaultAllocatorDestructor(
     kfree(PrivateData);
 }
 
+static void
+_DefaultPrivDestructor(
+    IN void* PrivateData
+    )
+{
+#if gcdPAGE_POOL
+    _PoolDeinit(PrivateData);
+#endif
+
+    kfree(PrivateData);
+}
+
 /* Default allocator operations. */
 gcsALLOCATOR_OPERATIONS DefaultAllocatorOperations = {
     .Alloc              = _DefaultAlloc,
@@ -943,9 +1378,13 @@ _DefaultAlloctorInit(
         gcmkONERROR(gcvSTATUS_OUT_OF_MEMORY);
     }
 
+#if gcdPAGE_POOL
+    _PoolInit(priv);
+#endif
+
     /* Register private data. */
     allocator->privateData = priv;
-    allocator->privateDataDestructor = _DefaultAllocatorDestructor;
+    allocator->privateDataDestructor = _DefaultPrivDestructor;
 
     allocator->debugfsInit = _DefaultAllocatorDebugfsInit;
     allocator->debugfsCleanup = _DefaultAllocatorDebugfsCleanup;
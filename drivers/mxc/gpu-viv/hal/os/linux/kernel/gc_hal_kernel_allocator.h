@@ -58,6 +58,8 @@
 
 #include "gc_hal_kernel_linux.h"
 
+struct reservation_object;
+
 typedef struct _gcsALLOCATOR * gckALLOCATOR;
 typedef struct _gcsATTACH_DESC * gcsATTACH_DESC_PTR;
 
@@ -323,6 +325,31 @@ typedef struct _gcsALLOCATOR_OPERATIONS
         IN gcsATTACH_DESC_PTR Desc,
         OUT PLINUX_MDL Mdl
         );
+
+    /**************************************************************************
+    **
+    ** Reservation
+    **
+    ** Get the reservation object of memory shared with other devices, so
+    ** that GPU access can be fenced against theirs. Optional.
+    **
+    ** INPUT:
+    **      gckALLOCATOR Allocator
+    **          Pointer to an gckALLOCATOER object.
+    **
+    **      PLINUX_MDL Mdl
+    **          Pointer to a Mdl object.
+    **
+    ** OUTPUT:
+    **      struct reservation_object ** Resv
+    **          Reservation object of the memory.
+    **
+    */
+    gceSTATUS (*Reservation)(
+        IN gckALLOCATOR Allocator,
+        IN PLINUX_MDL Mdl,
+        OUT struct reservation_object ** Resv
+        );
 }
 gcsALLOCATOR_OPERATIONS;
 
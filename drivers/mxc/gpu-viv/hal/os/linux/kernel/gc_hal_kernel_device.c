@@ -58,6 +58,7 @@
 #include <linux/seq_file.h>
 #include <linux/mman.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 
 #define _GC_OBJ_ZONE    gcvZONE_DEVICE
 
@@ -561,6 +562,123 @@ _DumpState(
     IN gckKERNEL Kernel
     );
 
+/*******************************************************************************
+**
+** Show memory usage of each process in one line.
+**
+**  Contiguous, Virtual: Video memory used in gcvPOOL_CONTIGUOUS/VIRTUAL.
+**  NonPaged: Non paged memory used.
+**  CmdBufs: Command buffers allocated.
+*/
+static int
+gc_process_usage_show(struct seq_file *m, void *data)
+{
+    gcsINFO_NODE *node = m->private;
+    gckGALDEVICE device = node->device;
+    gckKERNEL kernel = _GetValidKernel(device);
+    gcsDATABASE_PTR database;
+    gcsDATABASE_RECORD_PTR record;
+    gctUINT cmdBufs;
+    gctINT i, j;
+    char name[24];
+
+    seq_printf(m, "%-8s %-16s %12s %12s %12s %8s\n",
+               "PID", "NAME", "Contiguous", "Virtual", "NonPaged", "CmdBufs");
+
+    /* Acquire the database mutex. */
+    gcmkVERIFY_OK(
+        gckOS_AcquireMutex(kernel->os, kernel->db->dbMutex, gcvINFINITE));
+
+    /* Walk the databases. */
+    for (i = 0; i < gcmCOUNTOF(kernel->db->db); ++i)
+    {
+        for (database = kernel->db->db[i];
+             database != gcvNULL;
+             database = database->next)
+        {
+            cmdBufs = 0;
+
+            for (j = 0; j < gcmCOUNTOF(database->list); j++)
+            {
+                for (record = database->list[j];
+                     record != gcvNULL;
+                     record = record->next)
+                {
+                    if (record->type == gcvDB_COMMAND_BUFFER)
+                    {
+                        cmdBufs++;
+                    }
+                }
+            }
+
+            gcmkVERIFY_OK(gckOS_GetProcessNameByPid(
+                database->processID, gcmSIZEOF(name), name));
+
+            seq_printf(m, "%-8d %-16s %12llu %12llu %12llu %8u\n",
+                       database->processID, name,
+                       database->vidMemPool[gcvPOOL_CONTIGUOUS].bytes,
+                       database->vidMemPool[gcvPOOL_VIRTUAL].bytes,
+                       database->nonPaged.bytes,
+                       cmdBufs);
+        }
+    }
+
+    /* Release the database mutex. */
+    gcmkVERIFY_OK(gckOS_ReleaseMutex(kernel->os, kernel->db->dbMutex));
+
+    return 0;
+}
+
+/*******************************************************************************
+**
+** Show GPU load since the last read.
+**
+** Meant to be polled by a devfreq style governor at its own interval.
+**
+**  Load: Busy share of the clocked cycles, scaled by the share of time the
+**        clock was on, in percent.
+**  Busy: Cycles the GPU was not idle.
+**  Total: Cycles the GPU clock ran.
+**  On: Time the GPU clock was on.
+**  Window: Time since the last read.
+*/
+static int
+gc_load_show(struct seq_file *m, void *data)
+{
+    gcsINFO_NODE *node = m->private;
+    gckGALDEVICE device = node->device;
+    gctUINT64 busy, total, on, window, load;
+    gctINT i;
+
+    for (i = 0; i < gcdMAX_GPU_COUNT; i++)
+    {
+        if (device->kernels[i] == gcvNULL)
+        {
+            continue;
+        }
+
+        gcmkVERIFY_OK(
+            gckOS_QueryGPULoad(device->os, i, &busy, &total, &on, &window));
+
+        load = 0;
+
+        if (total && window)
+        {
+            load = div64_u64(div64_u64(busy * 100, total) * min(on, window),
+                             window);
+        }
+
+        seq_printf(m, "GPU[%d]:\n", i);
+        seq_printf(m, "    Load:   %llu %%\n", load);
+        seq_printf(m, "    Busy:   %llu cycles\n", busy);
+        seq_printf(m, "    Total:  %llu cycles\n", total);
+        seq_printf(m, "    On:     %llu ns\n", on);
+        seq_printf(m, "    Window: %llu ns\n", window);
+    }
+
+    return 0;
+}
+
 /*******************************************************************************
 **
 ** Show PM state timer.
@@ -679,6 +797,8 @@ static gcsINFO InfoList[] =
     {"clients", gc_clients_show},
     {"meminfo", gc_meminfo_show},
     {"idle", gc_idle_show},
+    {"usage", gc_process_usage_show},
+    {"load", gc_load_show},
     {"database", gc_db_show},
     {"version", gc_version_show},
     {"vidmem", gc_vidmem_show, gc_vidmem_write},
@@ -191,6 +191,27 @@ typedef struct _gcsINTEGER_DB
 }
 gcsINTEGER_DB;
 
+typedef struct _gcsGPU_LOAD
+{
+    /* Cycle counter registers, picked by chip model on first sample. */
+    gctUINT32                   totalReg;
+    gctUINT32                   idleReg;
+
+    /* Cycle counters at the last sample. */
+    gctUINT32                   lastTotal;
+    gctUINT32                   lastIdle;
+
+    /* Accumulated since the last query. */
+    gctUINT64                   busyCycles;
+    gctUINT64                   totalCycles;
+    gctUINT64                   onNs;
+
+    /* Time of the last sample and of the last query. */
+    ktime_t                     sampleStamp;
+    ktime_t                     queryStamp;
+}
+gcsGPU_LOAD;
+
 struct _gckOS
 {
     /* Object. */
@@ -242,6 +263,12 @@ struct _gckOS
 
     /* IOMMU. */
     gckIOMMU                    iommu;
+
+    /* GPU load accounting. */
+    gcsGPU_LOAD                 load[gcdMAX_GPU_COUNT];
+
+    /* Keeps the 32 bit cycle counters from wrapping between samples. */
+    struct delayed_work         loadWork;
 };
 
 typedef struct _gcsSIGNAL * gcsSIGNAL_PTR;
@@ -291,6 +318,36 @@ gckOS_FreeAllocators(
     gckOS Os
     );
 
+gceSTATUS
+gckOS_QueryGPULoad(
+    IN gckOS Os,
+    IN gceCORE Core,
+    OUT gctUINT64 * BusyCycles,
+    OUT gctUINT64 * TotalCycles,
+    OUT gctUINT64 * OnNs,
+    OUT gctUINT64 * WindowNs
+    );
+
+#if gcdANDROID_NATIVE_FENCE_SYNC && LINUX_VERSION_CODE >= KERNEL_VERSION(4,9,0)
+gceSTATUS
+gckOS_AttachReservationFence(
+    IN gckOS Os,
+    IN gctHANDLE Timeline,
+    IN gctPHYS_ADDR Physical,
+    IN gctSIGNAL Signal,
+    IN gctBOOL Write
+    );
+
+gceSTATUS
+gckOS_WaitReservationFence(
+    IN gckOS Os,
+    IN gctHANDLE Timeline,
+    IN gctPHYS_ADDR Physical,
+    IN gctBOOL Write,
+    IN gctUINT32 Timeout
+    );
+#endif
+
 gceSTATUS
 _ConvertLogical2Physical(
     IN gckOS Os,
@@ -586,6 +586,188 @@ _AllowAccess(
     return gcvTRUE;
 }
 
+/*******************************************************************************
+**
+**  GPU load accounting.
+**
+**  The profiling counters of the GPU count total and idle cycles while its
+**  clock runs.  They are sampled when the clock is turned on and off, and
+**  periodically in between so the 32 bit counters never wrap unnoticed.
+**
+**  GC880/GC2000/GC2100 count total cycles in the memory controller and idle
+**  cycles in the register other cores use for total cycles.
+*/
+#define gcdLOAD_CHIP_MODEL          0x00020
+#define gcdLOAD_TOTAL_CYCLES        0x00078
+#define gcdLOAD_IDLE_CYCLES         0x0007C
+#define gcdLOAD_MC_TOTAL_CYCLES     0x00438
+#define gcdLOAD_SAMPLE_PERIOD       1000
+
+/* Called with registerAccessLocks[Core] held and the external clock on. */
+static void
+_SampleLoad(
+    IN gckOS Os,
+    IN gceCORE Core,
+    IN gctBOOL Start
+    )
+{
+    gcsGPU_LOAD * load = &Os->load[Core];
+    gctUINT8 * base = (gctUINT8 *)Os->device->registerBases[Core];
+    ktime_t now = ktime_get();
+    gctUINT32 total, idle;
+    gctUINT32 deltaTotal, deltaIdle;
+
+    if (base == gcvNULL
+     || Os->device->requestedRegisterMemSizes[Core] <= gcdLOAD_MC_TOTAL_CYCLES)
+    {
+        return;
+    }
+
+    /* Counters stop while the internal clock is off, do not count it. */
+    if ((readl(base + 0x0) & 0x3) == 0x3)
+    {
+        load->sampleStamp = now;
+        return;
+    }
+
+    if (load->totalReg == 0)
+    {
+        gctUINT32 model = readl(base + gcdLOAD_CHIP_MODEL);
+
+        if (model == 0x880 || model == 0x2000 || model == 0x2100)
+        {
+            load->totalReg = gcdLOAD_MC_TOTAL_CYCLES;
+            load->idleReg  = gcdLOAD_TOTAL_CYCLES;
+        }
+        else
+        {
+            load->totalReg = gcdLOAD_TOTAL_CYCLES;
+            load->idleReg  = gcdLOAD_IDLE_CYCLES;
+        }
+
+        /* No baseline yet. */
+        Start = gcvTRUE;
+    }
+
+    total = readl(base + load->totalReg);
+    idle  = readl(base + load->idleReg);
+
+    if (!Start)
+    {
+        deltaTotal = total - load->lastTotal;
+        deltaIdle  = idle - load->lastIdle;
+
+        load->totalCycles += deltaTotal;
+        load->busyCycles  += deltaTotal > deltaIdle ? deltaTotal - deltaIdle : 0;
+        load->onNs        += ktime_to_ns(ktime_sub(now, load->sampleStamp));
+    }
+
+    load->lastTotal   = total;
+    load->lastIdle    = idle;
+    load->sampleStamp = now;
+}
+
+static void
+_LoadWork(
+    struct work_struct * Work
+    )
+{
+    gckOS os = container_of(Work, struct _gckOS, loadWork.work);
+    gctINT i;
+
+    for (i = 0; i < gcdMAX_GPU_COUNT; i++)
+    {
+        mutex_lock(&os->registerAccessLocks[i]);
+
+        if (os->clockStates[i])
+        {
+            _SampleLoad(os, i, gcvFALSE);
+        }
+
+        mutex_unlock(&os->registerAccessLocks[i]);
+    }
+
+    queue_delayed_work(os->workqueue, &os->loadWork,
+                       msecs_to_jiffies(gcdLOAD_SAMPLE_PERIOD));
+}
+
+/*******************************************************************************
+**
+**  gckOS_QueryGPULoad
+**
+**  Query the GPU load accumulated since the previous query.
+**
+**  INPUT:
+**
+**      gckOS Os
+**          Pointer to a gckOS object.
+**
+**      gceCORE Core
+**          GPU to query.
+**
+**  OUTPUT:
+**
+**      gctUINT64 * BusyCycles
+**          Cycles the GPU was not idle.
+**
+**      gctUINT64 * TotalCycles
+**          Cycles the GPU clock ran.
+**
+**      gctUINT64 * OnNs
+**          Time the GPU clock was on.
+**
+**      gctUINT64 * WindowNs
+**          Time since the previous query.
+*/
+gceSTATUS
+gckOS_QueryGPULoad(
+    IN gckOS Os,
+    IN gceCORE Core,
+    OUT gctUINT64 * BusyCycles,
+    OUT gctUINT64 * TotalCycles,
+    OUT gctUINT64 * OnNs,
+    OUT gctUINT64 * WindowNs
+    )
+{
+    gcsGPU_LOAD * load;
+    ktime_t now;
+
+    gcmkHEADER_ARG("Os=0x%X Core=%d", Os, Core);
+    gcmkVERIFY_OBJECT(Os, gcvOBJ_OS);
+
+    if (Core >= gcdMAX_GPU_COUNT)
+    {
+        gcmkFOOTER_NO();
+        return gcvSTATUS_INVALID_ARGUMENT;
+    }
+
+    load = &Os->load[Core];
+
+    mutex_lock(&Os->registerAccessLocks[Core]);
+
+    if (Os->clockStates[Core])
+    {
+        _SampleLoad(Os, Core, gcvFALSE);
+    }
+
+    now = ktime_get();
+
+    *BusyCycles  = load->busyCycles;
+    *TotalCycles = load->totalCycles;
+    *OnNs        = load->onNs;
+    *WindowNs    = ktime_to_ns(ktime_sub(now, load->queryStamp));
+
+    load->busyCycles  = 0;
+    load->totalCycles = 0;
+    load->onNs        = 0;
+    load->queryStamp  = now;
+
+    mutex_unlock(&Os->registerAccessLocks[Core]);
+
+    gcmkFOOTER_NO();
+    return gcvSTATUS_OK;
+}
+
 static gceSTATUS
 _ShrinkMemory(
     IN gckOS Os
@@ -710,8 +892,15 @@ gckOS_Construct(
     for (i = 0; i < gcdMAX_GPU_COUNT; i++)
     {
         mutex_init(&os->registerAccessLocks[i]);
+
+        os->load[i].queryStamp = ktime_get();
     }
 
+    INIT_DELAYED_WORK(&os->loadWork, _LoadWork);
+
+    queue_delayed_work(os->workqueue, &os->loadWork,
+                       msecs_to_jiffies(gcdLOAD_SAMPLE_PERIOD));
+
     gckOS_ImportAllocators(os);
 
 #ifdef CONFIG_IOMMU_SUPPORT
@@ -787,6 +976,9 @@ gckOS_Destroy(
      * Destroy the signal manager.
      */
 
+    /* Stop load sampling. */
+    cancel_delayed_work_sync(&Os->loadWork);
+
     /* Wait for all works done. */
     flush_workqueue(Os->workqueue);
 
@@ -5356,11 +5548,23 @@ gckOS_SetGPUPower(
     {
         mutex_lock(&Os->registerAccessLocks[Core]);
 
+        if (Clock == gcvFALSE)
+        {
+            /* Account the cycles run until now. */
+            _SampleLoad(Os, Core, gcvFALSE);
+        }
+
         if (platform && platform->ops->setClock)
         {
             gcmkVERIFY_OK(platform->ops->setClock(platform, Core, Clock));
         }
 
+        if (Clock == gcvTRUE)
+        {
+            /* Start a new baseline, counters may have been reset. */
+            _SampleLoad(Os, Core, gcvTRUE);
+        }
+
         Os->clockStates[Core] = Clock;
 
         mutex_unlock(&Os->registerAccessLocks[Core]);
@@ -7408,6 +7612,236 @@ OnError:
     return status;
 }
 
+static gceSTATUS
+_GetReservation(
+    IN gctPHYS_ADDR Physical,
+    OUT struct reservation_object ** Resv
+    )
+{
+    PLINUX_MDL mdl = (PLINUX_MDL) Physical;
+    gckALLOCATOR allocator = mdl->allocator;
+
+    if (!allocator || !allocator->ops->Reservation)
+    {
+        return gcvSTATUS_NOT_SUPPORTED;
+    }
+
+    return allocator->ops->Reservation(allocator, mdl, Resv);
+}
+
+/*******************************************************************************
+**
+**  gckOS_AttachReservationFence
+**
+**  Attach the fence of a signal to video memory shared through dma-buf, so
+**  that other devices using the buffer wait for the GPU instead of the CPU
+**  waiting for them. Memory which is not shared is left alone.
+**
+**  INPUT:
+**
+**      gckOS Os
+**          Pointer to an gckOS object.
+**
+**      gctHANDLE Timeline
+**          Sync timeline of the GPU core.
+**
+**      gctPHYS_ADDR Physical
+**          Video memory accessed by the commit.
+**
+**      gctSIGNAL Signal
+**          Signal triggered when the commit has completed.
+**
+**      gctBOOL Write
+**          gcvTRUE for an exclusive (write) fence, gcvFALSE for a shared one.
+**
+**  OUTPUT:
+**
+**      Nothing.
+*/
+gceSTATUS
+gckOS_AttachReservationFence(
+    IN gckOS Os,
+    IN gctHANDLE Timeline,
+    IN gctPHYS_ADDR Physical,
+    IN gctSIGNAL Signal,
+    IN gctBOOL Write
+    )
+{
+    struct viv_sync_timeline *timeline;
+    struct reservation_object *resv;
+    struct fence *fence;
+    gcsSIGNAL_PTR signal;
+    gceSTATUS status = gcvSTATUS_OK;
+
+    gcmkHEADER_ARG("Os=0x%X Physical=0x%X Signal=0x%X Write=%d",
+                   Os, Physical, Signal, Write);
+
+    if (gcmIS_ERROR(_GetReservation(Physical, &resv)))
+    {
+        /* Not shared with other devices. */
+        gcmkFOOTER_NO();
+        return gcvSTATUS_OK;
+    }
+
+    timeline = (struct viv_sync_timeline *) Timeline;
+
+    gcmkONERROR(
+        _QueryIntegerId(&Os->signalDB,
+                        (gctUINT32)(gctUINTPTR_T)Signal,
+                        (gctPOINTER)&signal));
+
+    fence = viv_fence_get(timeline, signal);
+
+    if (!fence)
+    {
+        gcmkONERROR(gcvSTATUS_OUT_OF_MEMORY);
+    }
+
+    ww_mutex_lock(&resv->lock, NULL);
+
+    if (Write)
+    {
+        reservation_object_add_excl_fence(resv, fence);
+    }
+    else if (!reservation_object_reserve_shared(resv))
+    {
+        reservation_object_add_shared_fence(resv, fence);
+    }
+    else
+    {
+        status = gcvSTATUS_OUT_OF_MEMORY;
+    }
+
+    ww_mutex_unlock(&resv->lock);
+
+    fence_put(fence);
+
+OnError:
+    gcmkFOOTER();
+    return status;
+}
+
+static gceSTATUS
+_WaitForeignFence(
+    IN struct viv_sync_timeline *Timeline,
+    IN struct fence *Fence,
+    IN OUT unsigned long *Timeout
+    )
+{
+    signed long ret;
+
+    /* The GPU executes fences of its own timeline in order. */
+    if (Fence->context == Timeline->context || fence_is_signaled(Fence))
+    {
+        return gcvSTATUS_OK;
+    }
+
+    ret = fence_wait_timeout(Fence, 1, *Timeout);
+
+    if (ret == -ERESTARTSYS)
+    {
+        return gcvSTATUS_INTERRUPTED;
+    }
+    else if (ret <= 0)
+    {
+        return gcvSTATUS_TIMEOUT;
+    }
+
+    *Timeout = ret;
+    return gcvSTATUS_OK;
+}
+
+/*******************************************************************************
+**
+**  gckOS_WaitReservationFence
+**
+**  Wait for other devices to be done with video memory shared through
+**  dma-buf before the GPU accesses it. Reading waits for the last writer,
+**  writing waits for the readers too. Memory which is not shared returns
+**  immediately.
+**
+**  INPUT:
+**
+**      gckOS Os
+**          Pointer to an gckOS object.
+**
+**      gctHANDLE Timeline
+**          Sync timeline of the GPU core.
+**
+**      gctPHYS_ADDR Physical
+**          Video memory accessed by the commit.
+**
+**      gctBOOL Write
+**          gcvTRUE if the GPU writes the memory.
+**
+**      gctUINT32 Timeout
+**          Timeout in milliseconds, or gcvINFINITE.
+**
+**  OUTPUT:
+**
+**      Nothing.
+*/
+gceSTATUS
+gckOS_WaitReservationFence(
+    IN gckOS Os,
+    IN gctHANDLE Timeline,
+    IN gctPHYS_ADDR Physical,
+    IN gctBOOL Write,
+    IN gctUINT32 Timeout
+    )
+{
+    struct viv_sync_timeline *timeline;
+    struct reservation_object *resv;
+    struct fence *excl = NULL;
+    struct fence **shared = NULL;
+    unsigned int count = 0;
+    unsigned int i;
+    unsigned long timeout;
+    gceSTATUS status = gcvSTATUS_OK;
+
+    gcmkHEADER_ARG("Os=0x%X Physical=0x%X Write=%d Timeout=%u",
+                   Os, Physical, Write, Timeout);
+
+    if (gcmIS_ERROR(_GetReservation(Physical, &resv)))
+    {
+        /* Not shared with other devices. */
+        gcmkFOOTER_NO();
+        return gcvSTATUS_OK;
+    }
+
+    timeline = (struct viv_sync_timeline *) Timeline;
+
+    if (reservation_object_get_fences_rcu(resv, &excl, &count, &shared))
+    {
+        gcmkONERROR(gcvSTATUS_OUT_OF_MEMORY);
+    }
+
+    timeout = (Timeout == gcvINFINITE) ? MAX_SCHEDULE_TIMEOUT
+                                       : msecs_to_jiffies(Timeout);
+
+    if (excl)
+    {
+        status = _WaitForeignFence(timeline, excl, &timeout);
+        fence_put(excl);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (Write && gcmIS_SUCCESS(status))
+        {
+            status = _WaitForeignFence(timeline, shared[i], &timeout);
+        }
+
+        fence_put(shared[i]);
+    }
+
+    kfree(shared);
+
+OnError:
+    gcmkFOOTER();
+    return status;
+}
+
 #  endif /* v4.9.0 */
 #endif
 
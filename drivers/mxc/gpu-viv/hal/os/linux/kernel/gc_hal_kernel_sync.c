@@ -376,6 +376,35 @@ struct fence * viv_fence_create(struct viv_sync_timeline *timeline,
     return (struct fence*)fence;
 }
 
+struct fence * viv_fence_get(struct viv_sync_timeline *timeline,
+                    gcsSIGNAL *signal)
+{
+    struct fence *fence;
+
+    /*
+     * A signal only keeps one fence to signal, so share it rather than
+     * orphan the fence a sync_file may already be waiting on.
+     */
+#ifdef gcdRT_KERNEL
+    raw_spin_lock_irq(&signal->obj.wait.lock);
+#else
+    spin_lock_irq(&signal->obj.wait.lock);
+#endif
+
+    fence = fence_get(signal->fence);
+
+#ifdef gcdRT_KERNEL
+    raw_spin_unlock_irq(&signal->obj.wait.lock);
+#else
+    spin_unlock_irq(&signal->obj.wait.lock);
+#endif
+
+    if (fence)
+        return fence;
+
+    return viv_fence_create(timeline, signal);
+}
+
 #endif /* v4.9.0 */
 
 #endif
@@ -103,6 +103,7 @@ struct sync_pt * viv_sync_pt_create(struct viv_sync_timeline *obj,
 #include <linux/sync_file.h>
 #include <linux/fence.h>
 #include <linux/fence-array.h>
+#include <linux/reservation.h>
 
 #include <gc_hal.h>
 #include <gc_hal_base.h>
@@ -141,6 +142,10 @@ void viv_sync_timeline_destroy(struct viv_sync_timeline *timeline);
 struct fence * viv_fence_create(struct viv_sync_timeline *timeline,
                     gcsSIGNAL *signal);
 
+/* Get the fence of signal, create one if there is none yet. */
+struct fence * viv_fence_get(struct viv_sync_timeline *timeline,
+                    gcsSIGNAL *signal);
+
 #endif /* v4.9.0 */
 
 #endif /* __gc_hal_kernel_sync_h_ */
@@ -117,6 +117,10 @@ extern int unregister_thermal_notifier(struct notifier_block *nb);
 #define REG_THERMAL_NOTIFIER(a) register_thermal_notifier(a);
 #define UNREG_THERMAL_NOTIFIER(a) unregister_thermal_notifier(a);
 #endif
+
+#ifndef DEVICE_COOLING_MAX_STATE
+#define DEVICE_COOLING_MAX_STATE 1
+#endif
 #endif
 
 #ifndef gcdFSL_CONTIGUOUS_SIZE
@@ -306,10 +310,21 @@ static int thermal_hot_pm_notify(struct notifier_block *nb, unsigned long event,
 
     if (event && !bAlreadyTooHot) {
         gckHARDWARE_GetFscaleValue(hardware,&orgFscale,&minFscale, &maxFscale);
-        gckHARDWARE_SetFscaleValue(hardware, minFscale);
         bAlreadyTooHot = gcvTRUE;
-        gckOS_Print("System is too hot. GPU3D will work at %d/64 clock.\n", minFscale);
-    } else if (!event && bAlreadyTooHot) {
+    }
+
+    if (event) {
+        /* Step down towards minFscale, the deepest cooling state runs at minFscale. */
+        gctUINT fscale = minFscale;
+
+        if (event < DEVICE_COOLING_MAX_STATE && orgFscale > minFscale)
+        {
+            fscale = orgFscale - (orgFscale - minFscale) * event / DEVICE_COOLING_MAX_STATE;
+        }
+
+        gckHARDWARE_SetFscaleValue(hardware, fscale);
+        gckOS_Print("System is too hot. GPU3D will work at %d/64 clock.\n", fscale);
+    } else if (bAlreadyTooHot) {
         gckHARDWARE_SetFscaleValue(hardware, orgFscale);
         gckOS_Print("Hot alarm is canceled. GPU3D clock will return to %d/64\n", orgFscale);
         bAlreadyTooHot = gcvFALSE;
@@ -21,6 +21,7 @@
 #include <linux/clk.h>
 #include <linux/cpumask.h>
 #include <linux/delay.h>
+#include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/init.h>
@@ -47,6 +48,9 @@
 #include "ipu_regs.h"
 #include "vdoa.h"
 
+#define CREATE_TRACE_POINTS
+#include "ipu_device_trace.h"
+
 #define CHECK_RETCODE(cont, str, err, label, ret)			\
 do {									\
 	if (cont) {							\
@@ -291,6 +295,8 @@ struct ipu_task_entry {
 
 	struct list_head node;
 	struct list_head split_list;
+	u8 priority;
+	bool vdi_busy;
 	struct ipu_soc *ipu;
 	struct device *dev;
 	struct task_set set;
@@ -339,23 +345,54 @@ struct ipu_thread_data {
 	u32	is_vdoa;
 };
 
+/*
+ * Every file handle (and the in-kernel ipu_queue_task() users) gets its own
+ * queue per task priority. The task threads serve high priority tasks
+ * first and rotate through the clients within a priority, so one client
+ * with a deep queue of slow tasks can't starve everybody else.
+ */
+#define IPU_TASK_PRIO_NUM	(IPU_TASK_PRIORITY_HIGH + 1)
+
+struct ipu_task_client {
+	struct list_head node;
+	struct list_head tasks[IPU_TASK_PRIO_NUM];
+	struct list_head imports;
+	struct mutex import_lock;
+};
+
+/*
+ * A dma-buf imported by a client stays attached and mapped until it is
+ * released or the file is closed, so queueing a task on it costs nothing
+ * more than on an IPU_ALLOC buffer.
+ */
+struct ipu_dmabuf_import {
+	struct list_head node;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	dma_addr_t paddr;
+};
+
 struct ipu_alloc_list {
 	struct list_head list;
 	dma_addr_t phy_addr;
 	void *cpu_addr;
 	u32 size;
 	void *file_index;
+	struct kref ref;	/* the list and every exported dma-buf */
 };
 
 static LIST_HEAD(ipu_alloc_list);
 static DEFINE_MUTEX(ipu_alloc_lock);
 static struct ipu_channel_tabel	ipu_ch_tbl;
 static LIST_HEAD(ipu_task_list);
+static LIST_HEAD(ipu_client_list);
 static DEFINE_SPINLOCK(ipu_task_list_lock);
+static struct ipu_task_client ipu_kernel_client;
+static atomic_t vdi_busy_cnt;
 static DECLARE_WAIT_QUEUE_HEAD(thread_waitq);
 static DECLARE_WAIT_QUEUE_HEAD(res_waitq);
 static atomic_t req_cnt;
-static atomic_t file_index = ATOMIC_INIT(1);
 static int major;
 static int max_ipu_no;
 static int thread_id;
@@ -1211,10 +1248,131 @@ done:
 	return ret;
 }
 
+/*
+ * check_task() only looks at the geometry and formats of a task, never at
+ * its buffers, and video pipelines queue the same conversion over and over
+ * with just new addresses. The outcome of prepare_task() is therefore kept
+ * for the last few task layouts, keyed by the task with every address
+ * cleared. Split child tasks go through here as well, so the stripe layout
+ * of a repeated split task is not recomputed either.
+ */
+#define PREP_CACHE_SIZE	8
+
+struct prep_cache_key {
+	struct ipu_input input;
+	struct ipu_output output;
+	struct ipu_overlay overlay;
+	bool overlay_en;
+	int timeout;
+};
+
+struct prep_cache_entry {
+	struct prep_cache_key key;
+	bool valid;
+	int ret;
+	u8 task_id;
+	int timeout;
+	struct ipu_input input;
+	struct ipu_output output;
+	struct ipu_overlay overlay;
+	struct task_set set;
+};
+
+static struct prep_cache_entry prep_cache[PREP_CACHE_SIZE];
+static unsigned int prep_cache_next;
+static DEFINE_MUTEX(prep_cache_lock);
+
+static void prep_cache_make_key(struct ipu_task_entry *t,
+				struct prep_cache_key *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->input = t->input;
+	key->input.paddr = 0;
+	key->input.paddr_n = 0;
+	key->output = t->output;
+	key->output.paddr = 0;
+	key->overlay_en = t->overlay_en;
+	if (t->overlay_en) {
+		key->overlay = t->overlay;
+		key->overlay.paddr = 0;
+		key->overlay.alpha.loc_alp_paddr = 0;
+	}
+	key->timeout = t->timeout;
+}
+
+/* write the cached layout into @t, keeping its own buffer addresses */
+static void prep_cache_apply(struct prep_cache_entry *e,
+			     struct ipu_task_entry *t)
+{
+	dma_addr_t in = t->input.paddr, in_n = t->input.paddr_n;
+	dma_addr_t out = t->output.paddr;
+	dma_addr_t ov = t->overlay.paddr;
+	dma_addr_t alpha = t->overlay.alpha.loc_alp_paddr;
+
+	t->input = e->input;
+	t->input.paddr = in;
+	t->input.paddr_n = in_n;
+	t->output = e->output;
+	t->output.paddr = out;
+	if (t->overlay_en) {
+		t->overlay = e->overlay;
+		t->overlay.paddr = ov;
+		t->overlay.alpha.loc_alp_paddr = alpha;
+	}
+	t->task_id = e->task_id;
+	t->timeout = e->timeout;
+	t->set = e->set;
+}
+
+static int prep_cache_lookup(struct prep_cache_key *key,
+			     struct ipu_task_entry *t)
+{
+	int i, ret = -ENOENT;
+
+	mutex_lock(&prep_cache_lock);
+	for (i = 0; i < PREP_CACHE_SIZE; i++) {
+		struct prep_cache_entry *e = &prep_cache[i];
+
+		if (e->valid && !memcmp(&e->key, key, sizeof(*key))) {
+			prep_cache_apply(e, t);
+			ret = e->ret;
+			break;
+		}
+	}
+	mutex_unlock(&prep_cache_lock);
+
+	return ret;
+}
+
+static void prep_cache_store(struct prep_cache_key *key,
+			     struct ipu_task_entry *t, int ret)
+{
+	struct prep_cache_entry *e;
+
+	mutex_lock(&prep_cache_lock);
+	e = &prep_cache[prep_cache_next++ % PREP_CACHE_SIZE];
+	e->key = *key;
+	e->ret = ret;
+	e->task_id = t->task_id;
+	e->timeout = t->timeout;
+	e->input = t->input;
+	e->output = t->output;
+	e->overlay = t->overlay;
+	e->set = t->set;
+	e->valid = true;
+	mutex_unlock(&prep_cache_lock);
+}
+
 static int prepare_task(struct ipu_task_entry *t)
 {
+	struct prep_cache_key key;
 	int ret = 0;
 
+	prep_cache_make_key(t, &key);
+	ret = prep_cache_lookup(&key, t);
+	if (ret >= 0)
+		return ret;
+
 	ret = check_task(t);
 	if (ret > IPU_CHECK_ERR_MIN)
 		return -EINVAL;
@@ -1242,6 +1400,8 @@ static int prepare_task(struct ipu_task_entry *t)
 
 	dump_task_info(t);
 
+	prep_cache_store(&key, t, ret);
+
 	return ret;
 }
 
@@ -1464,6 +1624,10 @@ static struct ipu_task_entry *create_task_entry(struct ipu_task *task)
 		tsk->timeout = task->timeout;
 	else
 		tsk->timeout = DEF_TIMEOUT_MS;
+	if (task->priority == IPU_TASK_PRIORITY_HIGH)
+		tsk->priority = IPU_TASK_PRIORITY_HIGH;
+	else
+		tsk->priority = IPU_TASK_PRIORITY_NORMAL;
 
 	return tsk;
 }
@@ -2395,6 +2559,9 @@ static irqreturn_t task_irq_handler(int irq, void *dev_id)
 	struct ipu_task_entry *prev_tsk = dev_id;
 
 	CHECK_PERF(&prev_tsk->ts_inirq);
+	trace_imx_ipu_hw_done(dev_name(prev_tsk->dev), prev_tsk->ipu_id,
+			      prev_tsk->task_no, prev_tsk->input.paddr,
+			      prev_tsk->output.paddr);
 	complete(&prev_tsk->irq_comp);
 	dev_dbg(prev_tsk->dev, "[0x%p] no-0x%x in-irq!",
 				 prev_tsk, prev_tsk->task_no);
@@ -2954,6 +3121,8 @@ static void do_task(struct ipu_task_entry *t)
 				STATE_VDOA_IRQ_TIMEOUT, chan_rel, ret);
 	}
 
+	trace_imx_ipu_hw_start(dev_name(t->dev), t->ipu_id, t->task_no,
+			       t->input.paddr, t->output.paddr);
 	CHECK_PERF(&t->ts_waitirq);
 	ret = wait_for_completion_timeout(&t->irq_comp,
 				 msecs_to_jiffies(t->timeout - DEF_DELAY_MS));
@@ -3185,34 +3354,81 @@ out:
 	return;
 }
 
+/*
+ * Pick the head task of the next client in line, highest priority first.
+ * There is only one VDI per IPU, so a deinterlace task is passed over
+ * while all of them are busy if some other task can run right away.
+ * Called with ipu_task_list_lock held.
+ */
+static struct ipu_task_entry *pick_client_task(void)
+{
+	struct ipu_task_client *client, *fb_client = NULL;
+	struct ipu_task_entry *tsk, *fallback = NULL;
+	int prio;
+
+	for (prio = IPU_TASK_PRIO_NUM - 1; prio >= 0; prio--) {
+		list_for_each_entry(client, &ipu_client_list, node) {
+			if (list_empty(&client->tasks[prio]))
+				continue;
+
+			tsk = list_first_entry(&client->tasks[prio],
+					       struct ipu_task_entry, node);
+			if ((tsk->set.mode & VDI_MODE) &&
+			    atomic_read(&vdi_busy_cnt) >= max_ipu_no) {
+				if (!fallback) {
+					fallback = tsk;
+					fb_client = client;
+				}
+				continue;
+			}
+
+			goto found;
+		}
+
+		if (fallback) {
+			tsk = fallback;
+			client = fb_client;
+			goto found;
+		}
+	}
+
+	return NULL;
+
+found:
+	/* the client goes to the back of the line */
+	list_move_tail(&client->node, &ipu_client_list);
+	return tsk;
+}
+
 static inline int find_task(struct ipu_task_entry **t, int thread_id)
 {
-	int found;
 	unsigned long flags;
 	struct ipu_task_entry *tsk;
 	struct list_head *task_list = &ipu_task_list;
 
 	*t = NULL;
 	spin_lock_irqsave(&ipu_task_list_lock, flags);
-	found = !list_empty(task_list);
-	if (found) {
+	/* split child tasks are served before anything else */
+	if (!list_empty(task_list))
 		tsk = list_first_entry(task_list, struct ipu_task_entry, node);
-		if (tsk->task_in_list) {
-			list_del(&tsk->node);
-			tsk->task_in_list = 0;
-			*t = tsk;
-			kref_get(&tsk->refcount);
-			dev_dbg(tsk->dev,
-			"thread_id:%d,[0x%p] task_no:0x%x,mode:0x%x list_del\n",
-			thread_id, tsk, tsk->task_no, tsk->set.mode);
-		} else
-			dev_err(tsk->dev,
-			"thread_id:%d,task_no:0x%x,mode:0x%x not on list_del\n",
-			thread_id, tsk->task_no, tsk->set.mode);
+	else
+		tsk = pick_client_task();
+	if (tsk) {
+		list_del(&tsk->node);
+		tsk->task_in_list = 0;
+		*t = tsk;
+		kref_get(&tsk->refcount);
+		if (!tsk->parent && (tsk->set.mode & VDI_MODE)) {
+			tsk->vdi_busy = true;
+			atomic_inc(&vdi_busy_cnt);
+		}
+		dev_dbg(tsk->dev,
+		"thread_id:%d,[0x%p] task_no:0x%x,mode:0x%x list_del\n",
+		thread_id, tsk, tsk->task_no, tsk->set.mode);
 	}
 	spin_unlock_irqrestore(&ipu_task_list_lock, flags);
 
-	return found;
+	return tsk != NULL;
 }
 
 static int ipu_task_thread(void *argv)
@@ -3328,6 +3544,9 @@ static int ipu_task_thread(void *argv)
 		if (split_parent && !split_fail)
 			wait_split_task_complete(tsk, sp_task, size);
 
+		if (tsk->vdi_busy)
+			atomic_dec(&vdi_busy_cnt);
+
 		if (!split_child) {
 			atomic_inc(&tsk->done);
 			wake_up(&tsk->task_waitq);
@@ -3374,22 +3593,22 @@ int ipu_check_task(struct ipu_task *task)
 }
 EXPORT_SYMBOL_GPL(ipu_check_task);
 
-int ipu_queue_task(struct ipu_task *task)
+static struct ipu_task_entry *ipu_task_create(struct ipu_task *task)
 {
 	struct ipu_task_entry *tsk;
-	unsigned long flags;
 	int ret;
-	u32 tmp_task_no;
-	DECLARE_PERF_VAR;
 
 	tsk = create_task_entry(task);
 	if (IS_ERR(tsk))
-		return PTR_ERR(tsk);
+		return tsk;
 
 	CHECK_PERF(&tsk->ts_queue);
 	ret = prepare_task(tsk);
-	if (ret < 0)
-		goto done;
+	if (ret < 0) {
+		dev_err(tsk->dev, "ERR: ipu_queue_task err:%d\n", ret);
+		kref_put(&tsk->refcount, task_mem_free);
+		return ERR_PTR(ret);
+	}
 
 	if (need_split(tsk)) {
 		CHECK_PERF(&tsk->ts_dotask);
@@ -3398,17 +3617,35 @@ int ipu_queue_task(struct ipu_task *task)
 		CHECK_PERF(&tsk->ts_wakeup);
 	}
 
+	return tsk;
+}
+
+static void ipu_task_submit(struct ipu_task_client *client,
+			    struct ipu_task_entry *tsk)
+{
+	unsigned long flags;
+	u32 tmp_task_no;
+
 	/* task_no last four bits for split task type*/
 	tmp_task_no = atomic_inc_return(&frame_no);
 	tsk->task_no = tmp_task_no << 4;
 	init_waitqueue_head(&tsk->task_waitq);
 
 	spin_lock_irqsave(&ipu_task_list_lock, flags);
-	list_add_tail(&tsk->node, &ipu_task_list);
+	list_add_tail(&tsk->node, &client->tasks[tsk->priority]);
 	tsk->task_in_list = 1;
 	dev_dbg(tsk->dev, "[0x%p,no-0x%x] list_add_tail\n", tsk, tsk->task_no);
 	spin_unlock_irqrestore(&ipu_task_list_lock, flags);
+	trace_imx_ipu_task_queue(dev_name(tsk->dev), tsk->ipu_id, tsk->task_no,
+				 tsk->input.paddr, tsk->output.paddr);
 	wake_up_interruptible(&thread_waitq);
+}
+
+static int ipu_task_wait(struct ipu_task_entry *tsk)
+{
+	unsigned long flags;
+	int ret;
+	DECLARE_PERF_VAR;
 
 	ret = wait_event_timeout(tsk->task_waitq, atomic_read(&tsk->done),
 						msecs_to_jiffies(tsk->timeout));
@@ -3456,20 +3693,360 @@ int ipu_queue_task(struct ipu_task *task)
 			+ ts_frame_max.tv_sec * USEC_PER_SEC,
 			ts_frame_avg, atomic_read(&frame_cnt));
 #endif
-done:
 	if (ret < 0)
 		dev_err(tsk->dev, "ERR: no-0x%x,ipu_queue_task err:%d\n",
 				tsk->task_no, ret);
 
+	trace_imx_ipu_task_dequeue(dev_name(tsk->dev), tsk->task_no,
+				   tsk->input.paddr, tsk->output.paddr, ret);
+
+	return ret;
+}
+
+static int ipu_client_queue_task(struct ipu_task_client *client,
+				 struct ipu_task *task)
+{
+	struct ipu_task_entry *tsk;
+	int ret;
+
+	tsk = ipu_task_create(task);
+	if (IS_ERR(tsk))
+		return PTR_ERR(tsk);
+
+	ipu_task_submit(client, tsk);
+	ret = ipu_task_wait(tsk);
+
 	kref_put(&tsk->refcount, task_mem_free);
 
 	return ret;
 }
+
+/*
+ * All tasks of a batch are checked before any of them is queued, so a
+ * batch is either rejected as a whole or run as a whole. Once queued the
+ * tasks are spread over all task threads and the caller only sleeps once
+ * for the whole batch; the first failure is reported.
+ */
+static int ipu_client_queue_batch(struct ipu_task_client *client,
+				  struct ipu_task *tasks, u32 num)
+{
+	struct ipu_task_entry **tsk;
+	int i, err, ret = 0;
+
+	tsk = kcalloc(num, sizeof(*tsk), GFP_KERNEL);
+	if (!tsk)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		tsk[i] = ipu_task_create(&tasks[i]);
+		if (IS_ERR(tsk[i])) {
+			ret = PTR_ERR(tsk[i]);
+			while (--i >= 0)
+				kref_put(&tsk[i]->refcount, task_mem_free);
+			goto out;
+		}
+	}
+
+	for (i = 0; i < num; i++)
+		ipu_task_submit(client, tsk[i]);
+
+	for (i = 0; i < num; i++) {
+		err = ipu_task_wait(tsk[i]);
+		if (err && !ret)
+			ret = err;
+		kref_put(&tsk[i]->refcount, task_mem_free);
+	}
+
+out:
+	kfree(tsk);
+	return ret;
+}
+
+int ipu_queue_task(struct ipu_task *task)
+{
+	return ipu_client_queue_task(&ipu_kernel_client, task);
+}
 EXPORT_SYMBOL_GPL(ipu_queue_task);
 
+static void ipu_alloc_free(struct kref *ref)
+{
+	struct ipu_alloc_list *mem =
+			container_of(ref, struct ipu_alloc_list, ref);
+
+	dma_free_coherent(ipu_dev, mem->size, mem->cpu_addr, mem->phy_addr);
+	kfree(mem);
+}
+
+static struct sg_table *ipu_dmabuf_map(struct dma_buf_attachment *attach,
+				       enum dma_data_direction dir)
+{
+	struct ipu_alloc_list *mem = attach->dmabuf->priv;
+	struct sg_table *sgt;
+	int ret;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	ret = dma_get_sgtable(ipu_dev, sgt, mem->cpu_addr, mem->phy_addr,
+			      mem->size);
+	if (ret < 0)
+		goto err_free;
+
+	if (!dma_map_sg(attach->dev, sgt->sgl, sgt->nents, dir)) {
+		ret = -ENOMEM;
+		goto err_table;
+	}
+
+	return sgt;
+
+err_table:
+	sg_free_table(sgt);
+err_free:
+	kfree(sgt);
+	return ERR_PTR(ret);
+}
+
+static void ipu_dmabuf_unmap(struct dma_buf_attachment *attach,
+			     struct sg_table *sgt,
+			     enum dma_data_direction dir)
+{
+	dma_unmap_sg(attach->dev, sgt->sgl, sgt->nents, dir);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static void ipu_dmabuf_release(struct dma_buf *dmabuf)
+{
+	struct ipu_alloc_list *mem = dmabuf->priv;
+
+	kref_put(&mem->ref, ipu_alloc_free);
+}
+
+static void *ipu_dmabuf_kmap(struct dma_buf *dmabuf, unsigned long page_num)
+{
+	struct ipu_alloc_list *mem = dmabuf->priv;
+
+	return mem->cpu_addr + page_num * PAGE_SIZE;
+}
+
+static int ipu_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct ipu_alloc_list *mem = dmabuf->priv;
+
+	return dma_mmap_coherent(ipu_dev, vma, mem->cpu_addr, mem->phy_addr,
+				 mem->size);
+}
+
+static const struct dma_buf_ops ipu_dmabuf_ops = {
+	.map_dma_buf = ipu_dmabuf_map,
+	.unmap_dma_buf = ipu_dmabuf_unmap,
+	.release = ipu_dmabuf_release,
+	.kmap_atomic = ipu_dmabuf_kmap,
+	.kmap = ipu_dmabuf_kmap,
+	.mmap = ipu_dmabuf_mmap,
+};
+
+static int ipu_alloc_export(struct ipu_task_client *client,
+			    struct ipu_dmabuf *buf)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct ipu_alloc_list *mem;
+	struct dma_buf *dmabuf;
+	int fd;
+
+	mutex_lock(&ipu_alloc_lock);
+	list_for_each_entry(mem, &ipu_alloc_list, list) {
+		if (mem->phy_addr == buf->paddr &&
+		    mem->file_index == client) {
+			kref_get(&mem->ref);
+			goto found;
+		}
+	}
+	mutex_unlock(&ipu_alloc_lock);
+	return -EINVAL;
+
+found:
+	mutex_unlock(&ipu_alloc_lock);
+
+	exp_info.ops = &ipu_dmabuf_ops;
+	exp_info.size = mem->size;
+	exp_info.flags = O_RDWR;
+	exp_info.priv = mem;
+
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		kref_put(&mem->ref, ipu_alloc_free);
+		return PTR_ERR(dmabuf);
+	}
+
+	fd = dma_buf_fd(dmabuf, O_CLOEXEC);
+	if (fd < 0) {
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	buf->fd = fd;
+	return 0;
+}
+
+/* the IPU has no MMU, so an imported buffer has to be contiguous */
+static bool ipu_sgt_is_contiguous(struct sg_table *sgt)
+{
+	struct scatterlist *s;
+	dma_addr_t next = sg_dma_address(sgt->sgl);
+	int i;
+
+	for_each_sg(sgt->sgl, s, sgt->nents, i) {
+		if (sg_dma_address(s) != next)
+			return false;
+		next += sg_dma_len(s);
+	}
+
+	return true;
+}
+
+static void ipu_dmabuf_import_free(struct ipu_dmabuf_import *imp)
+{
+	dma_buf_unmap_attachment(imp->attach, imp->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(imp->dmabuf, imp->attach);
+	dma_buf_put(imp->dmabuf);
+	kfree(imp);
+}
+
+/*
+ * Imports are looked up by dma-buf rather than by fd number, so a buffer
+ * passed again, even through a dup()ed or re-received fd, resolves to the
+ * cached mapping.
+ */
+static int ipu_client_import(struct ipu_task_client *client,
+			     struct ipu_dmabuf *buf)
+{
+	struct ipu_dmabuf_import *imp;
+	struct dma_buf *dmabuf;
+	int ret = 0;
+
+	dmabuf = dma_buf_get(buf->fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	mutex_lock(&client->import_lock);
+	list_for_each_entry(imp, &client->imports, node) {
+		if (imp->dmabuf == dmabuf) {
+			dma_buf_put(dmabuf);
+			goto out;
+		}
+	}
+
+	imp = kzalloc(sizeof(*imp), GFP_KERNEL);
+	if (!imp) {
+		ret = -ENOMEM;
+		goto err_put;
+	}
+	imp->dmabuf = dmabuf;
+
+	imp->attach = dma_buf_attach(dmabuf, ipu_dev);
+	if (IS_ERR(imp->attach)) {
+		ret = PTR_ERR(imp->attach);
+		goto err_free;
+	}
+
+	imp->sgt = dma_buf_map_attachment(imp->attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(imp->sgt)) {
+		ret = PTR_ERR(imp->sgt);
+		goto err_detach;
+	}
+
+	if (!ipu_sgt_is_contiguous(imp->sgt)) {
+		dev_dbg(ipu_dev, "dma-buf fd %d is not contiguous\n", buf->fd);
+		ret = -EINVAL;
+		goto err_unmap;
+	}
+
+	imp->paddr = sg_dma_address(imp->sgt->sgl);
+	list_add(&imp->node, &client->imports);
+out:
+	buf->paddr = imp->paddr;
+	mutex_unlock(&client->import_lock);
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment(imp->attach, imp->sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(dmabuf, imp->attach);
+err_free:
+	kfree(imp);
+err_put:
+	dma_buf_put(dmabuf);
+	mutex_unlock(&client->import_lock);
+	return ret;
+}
+
+static int ipu_client_release_import(struct ipu_task_client *client,
+				     struct ipu_dmabuf *buf)
+{
+	struct ipu_dmabuf_import *imp;
+	struct dma_buf *dmabuf;
+	int ret = -EINVAL;
+
+	dmabuf = dma_buf_get(buf->fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	mutex_lock(&client->import_lock);
+	list_for_each_entry(imp, &client->imports, node) {
+		if (imp->dmabuf == dmabuf) {
+			list_del(&imp->node);
+			ipu_dmabuf_import_free(imp);
+			ret = 0;
+			break;
+		}
+	}
+	mutex_unlock(&client->import_lock);
+
+	dma_buf_put(dmabuf);
+	return ret;
+}
+
+static void ipu_client_init(struct ipu_task_client *client)
+{
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < IPU_TASK_PRIO_NUM; i++)
+		INIT_LIST_HEAD(&client->tasks[i]);
+	INIT_LIST_HEAD(&client->imports);
+	mutex_init(&client->import_lock);
+
+	spin_lock_irqsave(&ipu_task_list_lock, flags);
+	list_add_tail(&client->node, &ipu_client_list);
+	spin_unlock_irqrestore(&ipu_task_list_lock, flags);
+}
+
+static void ipu_client_exit(struct ipu_task_client *client)
+{
+	struct ipu_dmabuf_import *imp, *n;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ipu_task_list_lock, flags);
+	list_del(&client->node);
+	spin_unlock_irqrestore(&ipu_task_list_lock, flags);
+
+	list_for_each_entry_safe(imp, n, &client->imports, node)
+		ipu_dmabuf_import_free(imp);
+}
+
 static int mxc_ipu_open(struct inode *inode, struct file *file)
 {
-	file->private_data = (void *)atomic_inc_return(&file_index);
+	struct ipu_task_client *client;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return -ENOMEM;
+
+	ipu_client_init(client);
+	/* also identifies the IPU_ALLOC buffers owned by this file */
+	file->private_data = client;
 	return 0;
 }
 
@@ -3502,7 +4079,29 @@ static long mxc_ipu_ioctl(struct file *file,
 					(&task, (struct ipu_task *) arg,
 					 sizeof(struct ipu_task)))
 				return -EFAULT;
-			ret = ipu_queue_task(&task);
+			ret = ipu_client_queue_task(file->private_data, &task);
+			break;
+		}
+	case IPU_QUEUE_TASK_BATCH:
+		{
+			struct ipu_task_batch batch;
+			struct ipu_task *tasks;
+
+			if (copy_from_user(&batch, argp, sizeof(batch)))
+				return -EFAULT;
+
+			if (!batch.num || batch.num > IPU_TASK_BATCH_MAX ||
+			    batch.reserved)
+				return -EINVAL;
+
+			tasks = memdup_user(u64_to_user_ptr(batch.tasks),
+					    batch.num * sizeof(*tasks));
+			if (IS_ERR(tasks))
+				return PTR_ERR(tasks);
+
+			ret = ipu_client_queue_batch(file->private_data, tasks,
+						     batch.num);
+			kfree(tasks);
 			break;
 		}
 	case IPU_ALLOC:
@@ -3520,6 +4119,7 @@ static long mxc_ipu_ioctl(struct file *file,
 			}
 
 			mem->size = PAGE_ALIGN(size);
+			kref_init(&mem->ref);
 
 			mem->cpu_addr = dma_alloc_coherent(ipu_dev, size,
 							   &mem->phy_addr,
@@ -3563,22 +4163,48 @@ static long mxc_ipu_ioctl(struct file *file,
 			list_for_each_entry(mem, &ipu_alloc_list, list) {
 				if (mem->phy_addr == offset) {
 					list_del(&mem->list);
-					dma_free_coherent(ipu_dev,
-							  mem->size,
-							  mem->cpu_addr,
-							  mem->phy_addr);
-					kfree(mem);
+					dev_dbg(ipu_dev,
+						"free %d bytes @ 0x%08X\n",
+						mem->size, mem->phy_addr);
+					/* exported dma-bufs keep it alive */
+					kref_put(&mem->ref, ipu_alloc_free);
 					ret = 0;
 					break;
 				}
 			}
 			mutex_unlock(&ipu_alloc_lock);
-			if (0 == ret)
-				dev_dbg(ipu_dev, "free %d bytes @ 0x%08X\n",
-					mem->size, mem->phy_addr);
 
 			break;
 		}
+	case IPU_EXPORT_DMABUF:
+	case IPU_IMPORT_DMABUF:
+	case IPU_RELEASE_DMABUF:
+		{
+			struct ipu_dmabuf buf;
+
+			if (copy_from_user(&buf, argp, sizeof(buf)))
+				return -EFAULT;
+
+			if (buf.flags)
+				return -EINVAL;
+
+			if (cmd == IPU_EXPORT_DMABUF)
+				ret = ipu_alloc_export(file->private_data,
+						       &buf);
+			else if (cmd == IPU_IMPORT_DMABUF)
+				ret = ipu_client_import(file->private_data,
+							&buf);
+			else
+				ret = ipu_client_release_import(
+						file->private_data, &buf);
+			if (ret)
+				return ret;
+
+			if (cmd != IPU_RELEASE_DMABUF &&
+			    copy_to_user(argp, &buf, sizeof(buf)))
+				return -EFAULT;
+			break;
+		}
 	default:
 		break;
 	}
@@ -3629,17 +4255,15 @@ static int mxc_ipu_release(struct inode *inode, struct file *file)
 		if ((mem->cpu_addr != 0) &&
 			(file->private_data == mem->file_index)) {
 			list_del(&mem->list);
-			dma_free_coherent(ipu_dev,
-					  mem->size,
-					  mem->cpu_addr,
-					  mem->phy_addr);
 			dev_dbg(ipu_dev, "rel-free %d bytes @ 0x%08X\n",
 				mem->size, mem->phy_addr);
-			kfree(mem);
+			kref_put(&mem->ref, ipu_alloc_free);
 		}
 	}
 	mutex_unlock(&ipu_alloc_lock);
-	atomic_dec(&file_index);
+
+	ipu_client_exit(file->private_data);
+	kfree(file->private_data);
 
 	return 0;
 }
@@ -3683,6 +4307,7 @@ int register_ipu_device(struct ipu_soc *ipu, int id)
 		ipu_dev->coherent_dma_mask = DMA_BIT_MASK(32);
 
 		mutex_init(&ipu_ch_tbl.lock);
+		ipu_client_init(&ipu_kernel_client);
 	}
 	max_ipu_no = ++id;
 	ipu->rot_dma[0].size = 0;
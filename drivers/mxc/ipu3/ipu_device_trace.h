@@ -0,0 +1,101 @@
+/*
+ * i.MX IPUv3 device (mem2mem task) tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * Part of the imx_media trace system shared with the V4L2 capture, VPU and
+ * DRM CRTC drivers. Tasks are named by task_no, their buffers by the DMA
+ * address of the input and output frames. A split task traces each of its
+ * stripes as a task of its own, the stripe number in the low four bits of
+ * task_no.
+ */
+
+#if !defined(__IPU_DEVICE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __IPU_DEVICE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM imx_media
+
+DECLARE_EVENT_CLASS(imx_ipu_task,
+	TP_PROTO(const char *dev, u8 ipu_id, u32 task_no, dma_addr_t in,
+		 dma_addr_t out),
+	TP_ARGS(dev, ipu_id, task_no, in, out),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(int, ipu_id)
+		__field(u32, task_no)
+		__field(u64, in)
+		__field(u64, out)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		/* -1 until the task is bound to an IPU */
+		__entry->ipu_id = (s8)ipu_id;
+		__entry->task_no = task_no;
+		__entry->in = in;
+		__entry->out = out;
+	),
+	TP_printk("%s: ipu=%d task_no=0x%x in=0x%08llx out=0x%08llx",
+		  __get_str(dev), __entry->ipu_id, __entry->task_no,
+		  __entry->in, __entry->out)
+);
+
+/* IPU_QUEUE_TASK or ipu_queue_task() */
+DEFINE_EVENT(imx_ipu_task, imx_ipu_task_queue,
+	TP_PROTO(const char *dev, u8 ipu_id, u32 task_no, dma_addr_t in,
+		 dma_addr_t out),
+	TP_ARGS(dev, ipu_id, task_no, in, out)
+);
+
+/* The channels are enabled and the buffers selected */
+DEFINE_EVENT(imx_ipu_task, imx_ipu_hw_start,
+	TP_PROTO(const char *dev, u8 ipu_id, u32 task_no, dma_addr_t in,
+		 dma_addr_t out),
+	TP_ARGS(dev, ipu_id, task_no, in, out)
+);
+
+/* End of frame interrupt of the output channel */
+DEFINE_EVENT(imx_ipu_task, imx_ipu_hw_done,
+	TP_PROTO(const char *dev, u8 ipu_id, u32 task_no, dma_addr_t in,
+		 dma_addr_t out),
+	TP_ARGS(dev, ipu_id, task_no, in, out)
+);
+
+/* The caller of IPU_QUEUE_TASK is woken up */
+TRACE_EVENT(imx_ipu_task_dequeue,
+	TP_PROTO(const char *dev, u32 task_no, dma_addr_t in, dma_addr_t out,
+		 int ret),
+	TP_ARGS(dev, task_no, in, out, ret),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(u32, task_no)
+		__field(u64, in)
+		__field(u64, out)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->task_no = task_no;
+		__entry->in = in;
+		__entry->out = out;
+		__entry->ret = ret;
+	),
+	TP_printk("%s: task_no=0x%x in=0x%08llx out=0x%08llx ret=%d",
+		  __get_str(dev), __entry->task_no, __entry->in,
+		  __entry->out, __entry->ret)
+);
+
+#endif /* __IPU_DEVICE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ipu_device_trace
+#include <trace/define_trace.h>
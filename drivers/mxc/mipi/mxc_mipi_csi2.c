@@ -165,8 +165,12 @@ unsigned int mipi_csi2_set_datatype(struct mipi_csi2_info *info,
 {
 	unsigned int dtype;
 
+	unsigned int vc;
+
 	_mipi_csi2_lock(info);
 	info->datatype = datatype;
+	for (vc = 0; vc < MIPI_CSI2_MAX_VC; vc++)
+		info->vc_datatype[vc] = datatype;
 	dtype = info->datatype;
 	_mipi_csi2_unlock(info);
 
@@ -192,6 +196,80 @@ unsigned int mipi_csi2_get_datatype(struct mipi_csi2_info *info)
 }
 EXPORT_SYMBOL(mipi_csi2_get_datatype);
 
+/*!
+ * This function is called to get the virtual channel routed to an IPU CSI.
+ *
+ * @param	info		mipi csi2 handle
+ * @param	ipu_id		ipu num
+ * @param	csi_id		csi num of that ipu
+ * @return      Returns virtual channel num or -ENODEV if none is bound
+ */
+int mipi_csi2_get_vc_bind(struct mipi_csi2_info *info,
+				int ipu_id, unsigned int csi_id)
+{
+	int vc, ret = -ENODEV;
+
+	_mipi_csi2_lock(info);
+	for (vc = 0; vc < MIPI_CSI2_MAX_VC; vc++) {
+		if (info->vc_ipu[vc] == ipu_id && info->vc_csi[vc] == csi_id) {
+			ret = vc;
+			break;
+		}
+	}
+	_mipi_csi2_unlock(info);
+
+	return ret;
+}
+EXPORT_SYMBOL(mipi_csi2_get_vc_bind);
+
+/*!
+ * This function is called to set the data type of one virtual channel.
+ *
+ * @param	info		mipi csi2 handle
+ * @param	vc		virtual channel num
+ * @param	datatype	mipi data type
+ * @return      Returns setted value
+ */
+unsigned int mipi_csi2_set_vc_datatype(struct mipi_csi2_info *info,
+				unsigned int vc, unsigned int datatype)
+{
+	unsigned int dtype;
+
+	if (vc >= MIPI_CSI2_MAX_VC)
+		return 0;
+
+	_mipi_csi2_lock(info);
+	info->vc_datatype[vc] = datatype;
+	dtype = info->vc_datatype[vc];
+	_mipi_csi2_unlock(info);
+
+	return dtype;
+}
+EXPORT_SYMBOL(mipi_csi2_set_vc_datatype);
+
+/*!
+ * This function is called to get the data type of one virtual channel.
+ *
+ * @param	info		mipi csi2 handle
+ * @param	vc		virtual channel num
+ * @return      Returns mipi data type
+ */
+unsigned int mipi_csi2_get_vc_datatype(struct mipi_csi2_info *info,
+				unsigned int vc)
+{
+	unsigned int dtype;
+
+	if (vc >= MIPI_CSI2_MAX_VC)
+		return 0;
+
+	_mipi_csi2_lock(info);
+	dtype = info->vc_datatype[vc];
+	_mipi_csi2_unlock(info);
+
+	return dtype;
+}
+EXPORT_SYMBOL(mipi_csi2_get_vc_datatype);
+
 /*!
  * This function is called to get mipi csi2 dphy status.
  *
@@ -254,7 +332,17 @@ EXPORT_SYMBOL(mipi_csi2_get_error2);
  */
 int mipi_csi2_pixelclk_enable(struct mipi_csi2_info *info)
 {
-	return clk_prepare_enable(info->pixel_clk);
+	int ret;
+
+	ret = clk_prepare_enable(info->pixel_clk);
+	if (ret)
+		return ret;
+
+	_mipi_csi2_lock(info);
+	info->pixelclk_users++;
+	_mipi_csi2_unlock(info);
+
+	return 0;
 }
 EXPORT_SYMBOL(mipi_csi2_pixelclk_enable);
 
@@ -266,12 +354,19 @@ EXPORT_SYMBOL(mipi_csi2_pixelclk_enable);
  */
 void mipi_csi2_pixelclk_disable(struct mipi_csi2_info *info)
 {
+	_mipi_csi2_lock(info);
+	if (info->pixelclk_users)
+		info->pixelclk_users--;
+	_mipi_csi2_unlock(info);
+
 	clk_disable_unprepare(info->pixel_clk);
 }
 EXPORT_SYMBOL(mipi_csi2_pixelclk_disable);
 
 /*!
  * This function is called to power on mipi csi2.
+ * The link is shared by all virtual channels, so it is not reset while
+ * any of them is still being captured.
  *
  * @param	info		mipi csi2 hander
  * @return      Returns 0 on success or negative error code on fail
@@ -280,6 +375,12 @@ int mipi_csi2_reset(struct mipi_csi2_info *info)
 {
 	_mipi_csi2_lock(info);
 
+	if (info->pixelclk_users) {
+		mipi_dbg("mipi csi2 busy, skip reset!\n");
+		_mipi_csi2_unlock(info);
+		return -EBUSY;
+	}
+
 	mipi_csi2_write(info, 0x0, MIPI_CSI2_PHY_SHUTDOWNZ);
 	mipi_csi2_write(info, 0x0, MIPI_CSI2_DPHY_RSTZ);
 	mipi_csi2_write(info, 0x0, MIPI_CSI2_CSI2_RESETN);
@@ -366,6 +467,70 @@ unsigned int mipi_csi2_get_virtual_channel(struct mipi_csi2_info *info)
 }
 EXPORT_SYMBOL(mipi_csi2_get_virtual_channel);
 
+/*
+ * Route each virtual channel to an IPU CSI. The optional "vc_bind"
+ * property holds <vc ipu_id csi_id> triplets so that several streams
+ * of one link are captured at once; without it only v_channel is
+ * routed, to ipu_id/csi_id.
+ */
+static int mipi_csi2_parse_vc_bind(struct platform_device *pdev,
+				   struct mipi_csi2_info *info)
+{
+	struct device_node *np = pdev->dev.of_node;
+	u32 vc, ipu_id, csi_id;
+	int i, j, n;
+
+	for (i = 0; i < MIPI_CSI2_MAX_VC; i++) {
+		info->vc_ipu[i] = -1;
+		info->vc_csi[i] = 0;
+		info->vc_datatype[i] = 0;
+	}
+	info->datatype = 0;
+	info->pixelclk_users = 0;
+
+	n = of_property_count_u32_elems(np, "vc_bind");
+	if (n < 0) {
+		info->vc_ipu[info->v_channel] = info->ipu_id;
+		info->vc_csi[info->v_channel] = info->csi_id;
+		return 0;
+	}
+
+	if (n == 0 || n % 3 || n / 3 > MIPI_CSI2_MAX_VC) {
+		dev_err(&pdev->dev, "invalid vc_bind size %d\n", n);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < n; i += 3) {
+		of_property_read_u32_index(np, "vc_bind", i, &vc);
+		of_property_read_u32_index(np, "vc_bind", i + 1, &ipu_id);
+		of_property_read_u32_index(np, "vc_bind", i + 2, &csi_id);
+
+		if (vc >= MIPI_CSI2_MAX_VC || ipu_id > 1 || csi_id > 1 ||
+		    info->vc_ipu[vc] >= 0) {
+			dev_err(&pdev->dev, "invalid vc_bind entry %d\n",
+				i / 3);
+			return -EINVAL;
+		}
+
+		for (j = 0; j < MIPI_CSI2_MAX_VC; j++) {
+			if (info->vc_ipu[j] == ipu_id &&
+			    info->vc_csi[j] == csi_id) {
+				dev_err(&pdev->dev,
+					"ipu%u csi%u bound to vc%d and vc%u\n",
+					ipu_id, csi_id, j, vc);
+				return -EINVAL;
+			}
+		}
+
+		info->vc_ipu[vc] = ipu_id;
+		info->vc_csi[vc] = csi_id;
+		dev_dbg(&pdev->dev, "vc%u -> ipu%u csi%u\n",
+			vc, ipu_id, csi_id);
+	}
+
+	return 0;
+}
+
 /**
  * This function is called by the driver framework to initialize the MIPI CSI2
  * device.
@@ -421,6 +586,10 @@ static int mipi_csi2_probe(struct platform_device *pdev)
 		goto err;
 	}
 
+	ret = mipi_csi2_parse_vc_bind(pdev, gmipi_csi2);
+	if (ret)
+		goto err;
+
 	/* initialize mutex */
 	mutex_init(&gmipi_csi2->mutex_lock);
 
@@ -34,6 +34,11 @@ struct mipi_csi2_info {
 	unsigned int	v_channel;
 	unsigned int	lanes;
 	unsigned int	datatype;
+	/* per virtual channel routing, vc_ipu[vc] < 0 if unbound */
+	int		vc_ipu[MIPI_CSI2_MAX_VC];
+	unsigned int	vc_csi[MIPI_CSI2_MAX_VC];
+	unsigned int	vc_datatype[MIPI_CSI2_MAX_VC];
+	unsigned int	pixelclk_users;
 	struct clk	*cfg_clk;
 	struct clk	*dphy_clk;
 	struct clk	*pixel_clk;
@@ -28,6 +28,8 @@
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mxc_mlb.h>
 #include <linux/of.h>
@@ -272,7 +274,9 @@
 #define TX_CHANNEL		0
 #define RX_CHANNEL		1
 
-#define TRANS_RING_NODES	(1 << 3)
+#define TRANS_RING_NODES	(1 << 4)
+#define TRANS_RING_NODES_MIN	(1 << 1)
+#define TRANS_RING_NODES_MAX	(1 << 6)
 #define MLB_QUIRK_MLB150	(1 << 0)
 
 enum MLB_CTYPE {
@@ -299,8 +303,10 @@ enum MLB_INDEX {
 };
 
 struct mlb_ringbuf {
-	s8 *virt_bufs[TRANS_RING_NODES];
-	u32 phy_addrs[TRANS_RING_NODES];
+	s8 *virt_bufs[TRANS_RING_NODES_MAX];
+	u32 phy_addrs[TRANS_RING_NODES_MAX];
+	/* ring depth, a power of two */
+	s32 nodes;
 	s32 head;
 	s32 tail;
 	s32 unit_size;
@@ -362,6 +368,8 @@ struct mlb_dev_info {
 	u32 adt_buf_dep;
 	/* Buffer size to hold data */
 	u32 buf_size;
+	/* buffers to complete before waking up readers and writers */
+	u32 batch;
 };
 
 struct mlb_data {
@@ -549,6 +557,10 @@ static struct mlb_dev_info mlb_devinfo[MLB_MINOR_DEVICES] = {
 
 static void __iomem *mlb_base;
 
+static int ring_nodes = TRANS_RING_NODES;
+module_param(ring_nodes, int, 0644);
+MODULE_PARM_DESC(ring_nodes, "Buffers per rx/tx ring, taken at open (2-64)");
+
 DEFINE_SPINLOCK(ctr_lock);
 
 #ifdef DEBUG
@@ -1518,7 +1530,7 @@ static s32 mlb150_trans_complete_check(struct mlb_dev_info *pdevinfo)
 
 	while (timeout--) {
 		read_lock(&tx_rbuf->rb_lock);
-		if (!CIRC_CNT(tx_rbuf->head, tx_rbuf->tail, TRANS_RING_NODES)) {
+		if (!CIRC_CNT(tx_rbuf->head, tx_rbuf->tail, tx_rbuf->nodes)) {
 			read_unlock(&tx_rbuf->rb_lock);
 			break;
 		} else
@@ -1533,7 +1545,7 @@ static s32 mlb150_trans_complete_check(struct mlb_dev_info *pdevinfo)
 	timeout = 1024;
 	while (timeout--) {
 		read_lock(&rx_rbuf->rb_lock);
-		if (!CIRC_CNT(rx_rbuf->head, rx_rbuf->tail, TRANS_RING_NODES)) {
+		if (!CIRC_CNT(rx_rbuf->head, rx_rbuf->tail, rx_rbuf->nodes)) {
 			read_unlock(&rx_rbuf->rb_lock);
 			break;
 		} else
@@ -1659,11 +1671,11 @@ static void mlb_rx_isr(s32 ctype, u32 ahb_ch, struct mlb_dev_info *pdevinfo)
 
 	read_lock(&rx_rbuf->rb_lock);
 
-	head = (rx_rbuf->head + 1) & (TRANS_RING_NODES - 1);
+	head = (rx_rbuf->head + 1) & (rx_rbuf->nodes - 1);
 	tail = ACCESS_ONCE(rx_rbuf->tail);
 	read_unlock(&rx_rbuf->rb_lock);
 
-	if (CIRC_SPACE(head, tail, TRANS_RING_NODES) >= 1) {
+	if (CIRC_SPACE(head, tail, rx_rbuf->nodes) >= 1) {
 		rx_buf_ptr = rx_rbuf->phy_addrs[head];
 
 		/* commit the item before incrementing the head */
@@ -1673,8 +1685,9 @@ static void mlb_rx_isr(s32 ctype, u32 ahb_ch, struct mlb_dev_info *pdevinfo)
 		rx_rbuf->head = head;
 		write_unlock(&rx_rbuf->rb_lock);
 
-		/* wake up the reader */
-		wake_up_interruptible(&pdevinfo->rx_wq);
+		/* wake up the reader once a batch is ready */
+		if (CIRC_CNT(head, tail, rx_rbuf->nodes) >= pdevinfo->batch)
+			wake_up_interruptible(&pdevinfo->rx_wq);
 	} else {
 		rx_buf_ptr = rx_rbuf->phy_addrs[head];
 		pr_debug("drop RX package, due to no space, (%d,%d)\n",
@@ -1695,7 +1708,7 @@ static void mlb_tx_isr(s32 ctype, u32 ahb_ch, struct mlb_dev_info *pdevinfo)
 	read_lock(&tx_rbuf->rb_lock);
 
 	head = ACCESS_ONCE(tx_rbuf->head);
-	tail = (tx_rbuf->tail + 1) & (TRANS_RING_NODES - 1);
+	tail = (tx_rbuf->tail + 1) & (tx_rbuf->nodes - 1);
 	read_unlock(&tx_rbuf->rb_lock);
 
 	smp_mb();
@@ -1703,15 +1716,16 @@ static void mlb_tx_isr(s32 ctype, u32 ahb_ch, struct mlb_dev_info *pdevinfo)
 	tx_rbuf->tail = tail;
 	write_unlock(&tx_rbuf->rb_lock);
 
+	if (CIRC_SPACE(head, tail, tx_rbuf->nodes) >= pdevinfo->batch)
+		wake_up_interruptible(&pdevinfo->tx_wq);
+
 	/* check the current tx buffer is available or not */
-	if (CIRC_CNT(head, tail, TRANS_RING_NODES) >= 1) {
+	if (CIRC_CNT(head, tail, tx_rbuf->nodes) >= 1) {
 		/* read index before reading contents at that index */
 		smp_read_barrier_depends();
 
 		tx_buf_ptr = tx_rbuf->phy_addrs[tail];
 
-		wake_up_interruptible(&pdevinfo->tx_wq);
-
 		adt_sts = mlb150_dev_get_adt_sts(ahb_ch);
 		/*  Set ADT for TX */
 		mlb150_dev_pipo_next(ahb_ch, ctype, adt_sts, tx_buf_ptr);
@@ -1919,7 +1933,8 @@ static irqreturn_t mlb_isr(int irq, void *dev_id)
 
 static int mxc_mlb150_open(struct inode *inode, struct file *filp)
 {
-	int minor, ring_buf_size, buf_size, j, ret;
+	int minor, ring_buf_size, buf_size, nodes, j, ret;
+	struct genpool_data_align page_align = { .align = PAGE_SIZE };
 	void __iomem *buf_addr;
 	ulong phy_addr;
 	struct mlb_dev_info *pdevinfo = NULL;
@@ -1948,9 +1963,16 @@ static int mxc_mlb150_open(struct inode *inode, struct file *filp)
 	pdevinfo = &mlb_devinfo[minor];
 	pchinfo = &pdevinfo->channels[TX_CHANNEL];
 
+	nodes = roundup_pow_of_two(clamp_t(int, ring_nodes,
+			TRANS_RING_NODES_MIN, TRANS_RING_NODES_MAX));
+	pdevinfo->rx_rbuf.nodes = pdevinfo->tx_rbuf.nodes = nodes;
+	pdevinfo->batch = 1;
+
+	/* page aligned and sized, so the rings can be mapped to user space */
 	ring_buf_size = pdevinfo->buf_size;
-	buf_size = ring_buf_size * (TRANS_RING_NODES * 2);
-	buf_addr = (void __iomem *)gen_pool_alloc(drvdata->iram_pool, buf_size);
+	buf_size = PAGE_ALIGN(ring_buf_size * (nodes * 2));
+	buf_addr = (void __iomem *)gen_pool_alloc_algo(drvdata->iram_pool,
+			buf_size, gen_pool_first_fit_align, &page_align);
 	if (buf_addr == NULL) {
 		ret = -ENOMEM;
 		pr_err("can not alloc rx/tx buffers: %d\n", buf_size);
@@ -1966,7 +1988,7 @@ static int mxc_mlb150_open(struct inode *inode, struct file *filp)
 
 	memset(buf_addr, 0, buf_size);
 
-	for (j = 0; j < (TRANS_RING_NODES);
+	for (j = 0; j < nodes;
 		++j, buf_addr += ring_buf_size, phy_addr += ring_buf_size) {
 		pdevinfo->rx_rbuf.virt_bufs[j] = buf_addr;
 		pdevinfo->rx_rbuf.phy_addrs[j] = phy_addr;
@@ -1975,7 +1997,7 @@ static int mxc_mlb150_open(struct inode *inode, struct file *filp)
 	}
 	pdevinfo->rx_rbuf.unit_size = ring_buf_size;
 	pdevinfo->rx_rbuf.total_size = buf_size;
-	for (j = 0; j < (TRANS_RING_NODES);
+	for (j = 0; j < nodes;
 		++j, buf_addr += ring_buf_size, phy_addr += ring_buf_size) {
 		pdevinfo->tx_rbuf.virt_bufs[j] = buf_addr;
 		pdevinfo->tx_rbuf.phy_addrs[j] = phy_addr;
@@ -2037,6 +2059,28 @@ static int mxc_mlb150_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/*
+ * Hand the tx buffer at @tail to the hardware, when the ring was idle.
+ */
+static void mlb150_tx_start(struct mlb_dev_info *pdevinfo, int tail)
+{
+	struct mlb_ringbuf *tx_rbuf = &pdevinfo->tx_rbuf;
+	u32 tx_buf_ptr, ahb_ch;
+	s32 adt_sts;
+	u32 ctype = pdevinfo->channel_type;
+
+	/* read index before reading contents at that index */
+	smp_read_barrier_depends();
+
+	tx_buf_ptr = tx_rbuf->phy_addrs[tail];
+
+	ahb_ch = pdevinfo->channels[TX_CHANNEL].cl;
+	adt_sts = mlb150_dev_get_adt_sts(ahb_ch);
+
+	/*  Set ADT for TX */
+	mlb150_dev_pipo_next(ahb_ch, ctype, adt_sts, tx_buf_ptr);
+}
+
 static long mxc_mlb150_ioctl(struct file *filp,
 			 unsigned int cmd, unsigned long arg)
 {
@@ -2241,6 +2285,114 @@ static long mxc_mlb150_ioctl(struct file *filp,
 			break;
 		}
 
+	case MLB_GET_RING_INFO:
+		{
+			struct mlb_ring_info info = {
+				.nodes = pdevinfo->rx_rbuf.nodes,
+				.unit_size = pdevinfo->rx_rbuf.unit_size,
+				.buf_len = pdevinfo->adt_buf_dep,
+				.rx_offset = 0,
+				.tx_offset = pdevinfo->rx_rbuf.nodes *
+						pdevinfo->rx_rbuf.unit_size,
+				.map_size = drvdata->iram_size,
+			};
+
+			if (copy_to_user(argp, &info, sizeof(info)))
+				return -EFAULT;
+			break;
+		}
+
+	case MLB_SET_BATCH:
+		{
+			unsigned int batch;
+
+			if (copy_from_user(&batch, argp, sizeof(batch)))
+				return -EFAULT;
+			if (!batch || batch >= pdevinfo->rx_rbuf.nodes)
+				return -EINVAL;
+			pdevinfo->batch = batch;
+			break;
+		}
+
+	case MLB_RX_ACQUIRE:
+	case MLB_TX_ACQUIRE:
+		{
+			struct mlb_ringbuf *rbuf = cmd == MLB_RX_ACQUIRE ?
+				&pdevinfo->rx_rbuf : &pdevinfo->tx_rbuf;
+			struct mlb_ring_span span;
+
+			read_lock_irqsave(&rbuf->rb_lock, flags);
+			if (cmd == MLB_RX_ACQUIRE) {
+				span.index = rbuf->tail;
+				span.count = CIRC_CNT(rbuf->head, rbuf->tail,
+						      rbuf->nodes);
+			} else {
+				span.index = rbuf->head;
+				span.count = CIRC_SPACE(rbuf->head, rbuf->tail,
+							rbuf->nodes);
+			}
+			read_unlock_irqrestore(&rbuf->rb_lock, flags);
+
+			/* read index before reading contents at that index */
+			smp_rmb();
+
+			if (copy_to_user(argp, &span, sizeof(span)))
+				return -EFAULT;
+			break;
+		}
+
+	case MLB_RX_RELEASE:
+		{
+			struct mlb_ringbuf *rx_rbuf = &pdevinfo->rx_rbuf;
+			unsigned int count;
+
+			if (copy_from_user(&count, argp, sizeof(count)))
+				return -EFAULT;
+
+			/* finish reading the buffers before giving them back */
+			smp_mb();
+
+			write_lock_irqsave(&rx_rbuf->rb_lock, flags);
+			if (count > CIRC_CNT(rx_rbuf->head, rx_rbuf->tail,
+					     rx_rbuf->nodes)) {
+				write_unlock_irqrestore(&rx_rbuf->rb_lock,
+							flags);
+				return -EINVAL;
+			}
+			rx_rbuf->tail = (rx_rbuf->tail + count) &
+					(rx_rbuf->nodes - 1);
+			write_unlock_irqrestore(&rx_rbuf->rb_lock, flags);
+			break;
+		}
+
+	case MLB_TX_COMMIT:
+		{
+			struct mlb_ringbuf *tx_rbuf = &pdevinfo->tx_rbuf;
+			unsigned int count;
+			int head, tail;
+
+			if (copy_from_user(&count, argp, sizeof(count)))
+				return -EFAULT;
+
+			/* the buffers were filled through the mapping */
+			wmb();
+
+			write_lock_irqsave(&tx_rbuf->rb_lock, flags);
+			head = tx_rbuf->head;
+			tail = tx_rbuf->tail;
+			if (count > CIRC_SPACE(head, tail, tx_rbuf->nodes)) {
+				write_unlock_irqrestore(&tx_rbuf->rb_lock,
+							flags);
+				return -EINVAL;
+			}
+			tx_rbuf->head = (head + count) & (tx_rbuf->nodes - 1);
+			write_unlock_irqrestore(&tx_rbuf->rb_lock, flags);
+
+			if (count && !CIRC_CNT(head, tail, tx_rbuf->nodes))
+				mlb150_tx_start(pdevinfo, tail);
+			break;
+		}
+
 	case MLB_IRQ_DISABLE:
 		{
 			disable_irq(drvdata->irq_mlb);
@@ -2283,7 +2435,7 @@ static ssize_t mxc_mlb150_read(struct file *filp, char __user *buf,
 	read_unlock_irqrestore(&rx_rbuf->rb_lock, flags);
 
 	/* check the current rx buffer is available or not */
-	if (0 == CIRC_CNT(head, tail, TRANS_RING_NODES)) {
+	if (0 == CIRC_CNT(head, tail, rx_rbuf->nodes)) {
 
 		if (filp->f_flags & O_NONBLOCK)
 			return -EAGAIN;
@@ -2297,7 +2449,7 @@ static ssize_t mxc_mlb150_read(struct file *filp, char __user *buf,
 
 				read_lock_irqsave(&rx_rbuf->rb_lock, flags);
 				if (CIRC_CNT(rx_rbuf->head, rx_rbuf->tail,
-						TRANS_RING_NODES) > 0) {
+						rx_rbuf->nodes) > 0) {
 					read_unlock_irqrestore(&rx_rbuf->rb_lock,
 								flags);
 					break;
@@ -2337,7 +2489,7 @@ static ssize_t mxc_mlb150_read(struct file *filp, char __user *buf,
 	smp_mb();
 
 	write_lock_irqsave(&rx_rbuf->rb_lock, flags);
-	rx_rbuf->tail = (tail + 1) & (TRANS_RING_NODES - 1);
+	rx_rbuf->tail = (tail + 1) & (rx_rbuf->nodes - 1);
 	write_unlock_irqrestore(&rx_rbuf->rb_lock, flags);
 
 	*f_pos = 0;
@@ -2380,7 +2532,7 @@ static ssize_t mxc_mlb150_write(struct file *filp, const char __user *buf,
 	tail = ACCESS_ONCE(tx_rbuf->tail);
 	read_unlock_irqrestore(&tx_rbuf->rb_lock, flags);
 
-	if (0 == CIRC_SPACE(head, tail, TRANS_RING_NODES)) {
+	if (0 == CIRC_SPACE(head, tail, tx_rbuf->nodes)) {
 		if (filp->f_flags & O_NONBLOCK)
 			return -EAGAIN;
 		do {
@@ -2392,7 +2544,7 @@ static ssize_t mxc_mlb150_write(struct file *filp, const char __user *buf,
 
 				read_lock_irqsave(&tx_rbuf->rb_lock, flags);
 				if (CIRC_SPACE(tx_rbuf->head, tx_rbuf->tail,
-							TRANS_RING_NODES) > 0) {
+							tx_rbuf->nodes) > 0) {
 					read_unlock_irqrestore(&tx_rbuf->rb_lock,
 							flags);
 					break;
@@ -2419,25 +2571,11 @@ static ssize_t mxc_mlb150_write(struct file *filp, const char __user *buf,
 
 	write_lock_irqsave(&tx_rbuf->rb_lock, flags);
 	smp_wmb();
-	tx_rbuf->head = (head + 1) & (TRANS_RING_NODES - 1);
+	tx_rbuf->head = (head + 1) & (tx_rbuf->nodes - 1);
 	write_unlock_irqrestore(&tx_rbuf->rb_lock, flags);
 
-	if (0 == CIRC_CNT(head, tail, TRANS_RING_NODES)) {
-		u32 tx_buf_ptr, ahb_ch;
-		s32 adt_sts;
-		u32 ctype = pdevinfo->channel_type;
-
-		/* read index before reading contents at that index */
-		smp_read_barrier_depends();
-
-		tx_buf_ptr = tx_rbuf->phy_addrs[tail];
-
-		ahb_ch = pdevinfo->channels[TX_CHANNEL].cl;
-		adt_sts = mlb150_dev_get_adt_sts(ahb_ch);
-
-		/*  Set ADT for TX */
-		mlb150_dev_pipo_next(ahb_ch, ctype, adt_sts, tx_buf_ptr);
-	}
+	if (0 == CIRC_CNT(head, tail, tx_rbuf->nodes))
+		mlb150_tx_start(pdevinfo, tail);
 
 	ret = count;
 out:
@@ -2468,7 +2606,7 @@ static unsigned int mxc_mlb150_poll(struct file *filp,
 	read_unlock_irqrestore(&tx_rbuf->rb_lock, flags);
 
 	/* check the tx buffer is avaiable or not */
-	if (CIRC_SPACE(head, tail, TRANS_RING_NODES) >= 1)
+	if (CIRC_SPACE(head, tail, tx_rbuf->nodes) >= pdevinfo->batch)
 		ret |= POLLOUT | POLLWRNORM;
 
 	read_lock_irqsave(&rx_rbuf->rb_lock, flags);
@@ -2477,7 +2615,7 @@ static unsigned int mxc_mlb150_poll(struct file *filp,
 	read_unlock_irqrestore(&rx_rbuf->rb_lock, flags);
 
 	/* check the rx buffer filled or not */
-	if (CIRC_CNT(head, tail, TRANS_RING_NODES) >= 1)
+	if (CIRC_CNT(head, tail, rx_rbuf->nodes) >= pdevinfo->batch)
 		ret |= POLLIN | POLLRDNORM;
 
 
@@ -2488,6 +2626,26 @@ static unsigned int mxc_mlb150_poll(struct file *filp,
 	return ret;
 }
 
+/*
+ * Map both rings, rx first, so that buffers can be consumed and filled in
+ * place. The layout is reported by MLB_GET_RING_INFO.
+ */
+static int mxc_mlb150_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct mlb_data *drvdata = filp->private_data;
+	struct mlb_dev_info *pdevinfo = drvdata->devinfo;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || size > drvdata->iram_size)
+		return -EINVAL;
+
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       pdevinfo->rbuf_base_phy >> PAGE_SHIFT,
+			       size, vma->vm_page_prot);
+}
+
 /*
  * char dev file operations structure
  */
@@ -2498,6 +2656,7 @@ static const struct file_operations mxc_mlb150_fops = {
 	.release = mxc_mlb150_release,
 	.unlocked_ioctl = mxc_mlb150_ioctl,
 	.poll = mxc_mlb150_poll,
+	.mmap = mxc_mlb150_mmap,
 	.read = mxc_mlb150_read,
 	.write = mxc_mlb150_write,
 };
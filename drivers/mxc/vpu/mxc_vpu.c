@@ -27,6 +27,9 @@
 #include <linux/platform_device.h>
 #include <linux/kdev_t.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
+#include <linux/kref.h>
+#include <linux/math64.h>
 #include <linux/wait.h>
 #include <linux/list.h>
 #include <linux/clk.h>
@@ -74,6 +77,9 @@
 #include <asm/sizes.h>
 #endif
 
+#define CREATE_TRACE_POINTS
+#include "mxc_vpu_trace.h"
+
 /* Define one new pgprot which combined uncached and XN(never executable) */
 #define pgprot_noncachedxn(prot) \
 	__pgprot_modify(prot, L_PTE_MT_MASK, L_PTE_MT_UNCACHED | L_PTE_XN)
@@ -85,10 +91,61 @@ struct vpu_priv {
 	struct mutex lock;
 };
 
-/* To track the allocated memory buffer */
+/*
+ * Per open file state. VPU_IOC_LOCK_DEV hands the VPU from one instance
+ * to the next in request order, so an instance unlocking at the end of
+ * a frame queues up behind all the others that are already waiting.
+ */
+struct vpu_instance {
+	struct list_head list;
+};
+
+struct vpu_sched {
+	spinlock_t lock;
+	struct vpu_instance *owner;
+	struct list_head waiters;
+	wait_queue_head_t wq;
+};
+
+/*
+ * VPU_IOC_CLKGATE_SETTING only takes and drops a hold on the clock. The
+ * clock itself is gated idle_ms after the last hold is dropped, so
+ * back to back frames keep it running. Power stays on while the device
+ * is open, gating the clock alone keeps the firmware context.
+ */
+struct vpu_clk_gate {
+	struct mutex lock;
+	struct delayed_work work;
+	unsigned int users;
+	bool on;
+	unsigned int idle_ms;
+	ktime_t busy_start;
+	/* statistics */
+	u64 busy_ns;
+	u64 powerup_ns;
+	u64 powerup_max_ns;
+	u32 powerups;
+	u32 warm_holds;
+};
+
+/*
+ * To track the allocated memory buffer. The list holds one reference
+ * and every dma-buf exported from the buffer holds another one.
+ */
 struct memalloc_record {
 	struct list_head list;
 	struct vpu_mem_desc mem;
+	struct kref ref;
+};
+
+/* To track the imported dma-buf */
+struct dmabuf_record {
+	struct list_head list;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	dma_addr_t phy_addr;
+	u32 size;
 };
 
 struct iram_setting {
@@ -102,11 +159,16 @@ static u32 iram_base;
 #endif
 
 static LIST_HEAD(head);
+static LIST_HEAD(import_head);
 
 static int vpu_major;
-static int vpu_clk_usercount;
 static struct class *vpu_class;
 static struct vpu_priv vpu_data;
+static struct vpu_sched vpu_sched = {
+	.lock = __SPIN_LOCK_UNLOCKED(vpu_sched.lock),
+	.waiters = LIST_HEAD_INIT(vpu_sched.waiters),
+	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(vpu_sched.wq),
+};
 static u8 open_count;
 static struct clk *vpu_clk;
 static struct vpu_mem_desc bitwork_mem = { 0 };
@@ -150,7 +212,9 @@ static unsigned int pc_before_suspend;
 static struct regulator *vpu_regulator;
 #endif
 #endif
-static atomic_t clk_cnt_from_ioc = ATOMIC_INIT(0);
+static struct vpu_clk_gate vpu_gate = {
+	.idle_ms = 10,
+};
 
 #define	READ_REG(x)		readl_relaxed(vpu_base + x)
 #define	WRITE_REG(val, x)	writel_relaxed(val, vpu_base + x)
@@ -287,25 +351,424 @@ static void vpu_free_dma_buffer(struct vpu_mem_desc *mem)
  * Private function to free buffers
  * @return status  0 success.
  */
+static void vpu_memalloc_release(struct kref *ref)
+{
+	struct memalloc_record *rec =
+		container_of(ref, struct memalloc_record, ref);
+
+	vpu_free_dma_buffer(&rec->mem);
+	dev_dbg(vpu_dev, "[FREE] freed paddr=0x%08X\n", rec->mem.phy_addr);
+	kfree(rec);
+}
+
+static void vpu_dmabuf_release_import(struct dmabuf_record *rec)
+{
+	trace_imx_vpu_buf_release(dev_name(vpu_dev), rec->phy_addr, rec->size);
+	dma_buf_unmap_attachment(rec->attach, rec->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(rec->dmabuf, rec->attach);
+	dma_buf_put(rec->dmabuf);
+	list_del(&rec->list);
+	kfree(rec);
+}
+
 static int vpu_free_buffers(void)
 {
 	struct memalloc_record *rec, *n;
-	struct vpu_mem_desc mem;
+	struct dmabuf_record *drec, *dn;
 
 	list_for_each_entry_safe(rec, n, &head, list) {
-		mem = rec->mem;
-		if (mem.cpu_addr != 0) {
-			vpu_free_dma_buffer(&mem);
-			dev_dbg(vpu_dev, "[FREE] freed paddr=0x%08X\n", mem.phy_addr);
-			/* delete from list */
+		if (rec->mem.cpu_addr != 0) {
+			/* exported dma-bufs keep their own reference */
 			list_del(&rec->list);
-			kfree(rec);
+			kref_put(&rec->ref, vpu_memalloc_release);
 		}
 	}
 
+	list_for_each_entry_safe(drec, dn, &import_head, list)
+		vpu_dmabuf_release_import(drec);
+
 	return 0;
 }
 
+/*
+ * dma-buf exporter for VPU_IOC_PHYMEM_ALLOC buffers. The buffers come from
+ * dma_alloc_coherent() and are physically contiguous, so importers get a
+ * single entry table and no cache maintenance is needed.
+ */
+static struct sg_table *vpu_dmabuf_map(struct dma_buf_attachment *attach,
+				       enum dma_data_direction dir)
+{
+	struct memalloc_record *rec = attach->dmabuf->priv;
+	struct sg_table *sgt;
+	int ret;
+
+	sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(sgt, 1, GFP_KERNEL);
+	if (ret)
+		goto err_free;
+
+	sg_set_page(sgt->sgl, pfn_to_page(PFN_DOWN(rec->mem.phy_addr)),
+		    PAGE_ALIGN(rec->mem.size), 0);
+
+	if (!dma_map_sg_attrs(attach->dev, sgt->sgl, sgt->nents, dir,
+			      DMA_ATTR_SKIP_CPU_SYNC)) {
+		ret = -ENOMEM;
+		goto err_table;
+	}
+
+	return sgt;
+
+err_table:
+	sg_free_table(sgt);
+err_free:
+	kfree(sgt);
+	return ERR_PTR(ret);
+}
+
+static void vpu_dmabuf_unmap(struct dma_buf_attachment *attach,
+			     struct sg_table *sgt,
+			     enum dma_data_direction dir)
+{
+	dma_unmap_sg_attrs(attach->dev, sgt->sgl, sgt->nents, dir,
+			   DMA_ATTR_SKIP_CPU_SYNC);
+	sg_free_table(sgt);
+	kfree(sgt);
+}
+
+static void vpu_dmabuf_release(struct dma_buf *dmabuf)
+{
+	struct memalloc_record *rec = dmabuf->priv;
+
+	kref_put(&rec->ref, vpu_memalloc_release);
+}
+
+static void *vpu_dmabuf_kmap(struct dma_buf *dmabuf, unsigned long page_num)
+{
+	struct memalloc_record *rec = dmabuf->priv;
+
+	return (void *)rec->mem.cpu_addr + page_num * PAGE_SIZE;
+}
+
+static int vpu_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct memalloc_record *rec = dmabuf->priv;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff + PFN_DOWN(size) > PFN_UP(rec->mem.size))
+		return -EINVAL;
+
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	return remap_pfn_range(vma, vma->vm_start,
+			       PFN_DOWN(rec->mem.phy_addr) + vma->vm_pgoff,
+			       size, vma->vm_page_prot);
+}
+
+static const struct dma_buf_ops vpu_dmabuf_ops = {
+	.map_dma_buf = vpu_dmabuf_map,
+	.unmap_dma_buf = vpu_dmabuf_unmap,
+	.release = vpu_dmabuf_release,
+	.kmap_atomic = vpu_dmabuf_kmap,
+	.kmap = vpu_dmabuf_kmap,
+	.mmap = vpu_dmabuf_mmap,
+};
+
+/*!
+ * Private function to export an allocated buffer as dma-buf
+ * @return fd on success or negative error code on error
+ */
+static int vpu_dmabuf_export(struct vpu_dmabuf_desc *desc)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct memalloc_record *rec, *found = NULL;
+	struct dma_buf *dmabuf;
+	int fd;
+
+	mutex_lock(&vpu_data.lock);
+	list_for_each_entry(rec, &head, list) {
+		if (rec->mem.phy_addr == desc->phy_addr) {
+			found = rec;
+			kref_get(&found->ref);
+			break;
+		}
+	}
+	mutex_unlock(&vpu_data.lock);
+
+	if (!found)
+		return -EINVAL;
+
+	exp_info.ops = &vpu_dmabuf_ops;
+	exp_info.size = PAGE_ALIGN(found->mem.size);
+	exp_info.flags = O_RDWR;
+	exp_info.priv = found;
+
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		kref_put(&found->ref, vpu_memalloc_release);
+		return PTR_ERR(dmabuf);
+	}
+
+	/* from here on the dma-buf release drops the reference */
+	fd = dma_buf_fd(dmabuf, O_CLOEXEC);
+	if (fd < 0) {
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	desc->size = found->mem.size;
+	return fd;
+}
+
+/*!
+ * Private function to import a dma-buf. The VPU has no IOMMU, so only
+ * buffers that map to a single contiguous range are accepted.
+ * @return status  0 success.
+ */
+static int vpu_dmabuf_import(struct vpu_dmabuf_desc *desc)
+{
+	struct dmabuf_record *rec;
+	int ret;
+
+	rec = kzalloc(sizeof(*rec), GFP_KERNEL);
+	if (!rec)
+		return -ENOMEM;
+
+	rec->dmabuf = dma_buf_get(desc->fd);
+	if (IS_ERR(rec->dmabuf)) {
+		ret = PTR_ERR(rec->dmabuf);
+		goto err_free;
+	}
+
+	rec->attach = dma_buf_attach(rec->dmabuf, vpu_dev);
+	if (IS_ERR(rec->attach)) {
+		ret = PTR_ERR(rec->attach);
+		goto err_put;
+	}
+
+	rec->sgt = dma_buf_map_attachment(rec->attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(rec->sgt)) {
+		ret = PTR_ERR(rec->sgt);
+		goto err_detach;
+	}
+
+	if (rec->sgt->nents != 1) {
+		dev_err(vpu_dev, "[IMPORT] dma-buf is not contiguous\n");
+		ret = -EINVAL;
+		goto err_unmap;
+	}
+
+	rec->phy_addr = sg_dma_address(rec->sgt->sgl);
+	rec->size = rec->dmabuf->size;
+	desc->phy_addr = rec->phy_addr;
+	desc->size = rec->size;
+
+	mutex_lock(&vpu_data.lock);
+	list_add(&rec->list, &import_head);
+	mutex_unlock(&vpu_data.lock);
+
+	trace_imx_vpu_buf_import(dev_name(vpu_dev), rec->phy_addr, rec->size);
+
+	dev_dbg(vpu_dev, "[IMPORT] fd %d paddr=0x%08X size=0x%x\n",
+		desc->fd, rec->phy_addr, rec->size);
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment(rec->attach, rec->sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(rec->dmabuf, rec->attach);
+err_put:
+	dma_buf_put(rec->dmabuf);
+err_free:
+	kfree(rec);
+	return ret;
+}
+
+/*!
+ * Private function to wait until the VPU is handed to this instance
+ * @return status  0 success.
+ */
+static int vpu_sched_lock(struct vpu_instance *inst)
+{
+	int ret;
+
+	spin_lock(&vpu_sched.lock);
+	if (vpu_sched.owner == inst) {
+		spin_unlock(&vpu_sched.lock);
+		return 0;
+	}
+	if (!vpu_sched.owner)
+		vpu_sched.owner = inst;
+	else
+		list_add_tail(&inst->list, &vpu_sched.waiters);
+	spin_unlock(&vpu_sched.lock);
+
+	ret = wait_event_killable(vpu_sched.wq,
+				  READ_ONCE(vpu_sched.owner) == inst);
+	if (ret) {
+		spin_lock(&vpu_sched.lock);
+		/* granted while dying, the release hands it on */
+		if (vpu_sched.owner == inst)
+			ret = 0;
+		else
+			list_del_init(&inst->list);
+		spin_unlock(&vpu_sched.lock);
+	}
+
+	return ret;
+}
+
+/*!
+ * Private function to pass the VPU on to the longest waiting instance,
+ * or to stop waiting for it when the instance does not own it
+ */
+static void vpu_sched_unlock(struct vpu_instance *inst)
+{
+	struct vpu_instance *next;
+
+	spin_lock(&vpu_sched.lock);
+	if (vpu_sched.owner == inst) {
+		next = list_first_entry_or_null(&vpu_sched.waiters,
+						struct vpu_instance, list);
+		if (next)
+			list_del_init(&next->list);
+		vpu_sched.owner = next;
+		wake_up_all(&vpu_sched.wq);
+	} else if (!list_empty(&inst->list)) {
+		list_del_init(&inst->list);
+	}
+	spin_unlock(&vpu_sched.lock);
+}
+
+static void vpu_clk_gate_work(struct work_struct *work)
+{
+	mutex_lock(&vpu_gate.lock);
+	if (!vpu_gate.users && vpu_gate.on) {
+		clk_disable(vpu_clk);
+		clk_unprepare(vpu_clk);
+		vpu_gate.on = false;
+	}
+	mutex_unlock(&vpu_gate.lock);
+}
+
+/*!
+ * Private function to take a clock hold, ungating the clock if needed
+ */
+static void vpu_clk_hold(void)
+{
+	ktime_t start;
+	u64 delta;
+
+	mutex_lock(&vpu_gate.lock);
+	if (vpu_gate.users++) {
+		mutex_unlock(&vpu_gate.lock);
+		return;
+	}
+
+	/* the work rechecks users, it is fine if it still runs */
+	cancel_delayed_work(&vpu_gate.work);
+	if (vpu_gate.on) {
+		vpu_gate.warm_holds++;
+	} else {
+		start = ktime_get();
+		clk_prepare(vpu_clk);
+		clk_enable(vpu_clk);
+		delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+		vpu_gate.on = true;
+		vpu_gate.powerups++;
+		vpu_gate.powerup_ns += delta;
+		vpu_gate.powerup_max_ns = max(vpu_gate.powerup_max_ns, delta);
+	}
+	vpu_gate.busy_start = ktime_get();
+	mutex_unlock(&vpu_gate.lock);
+}
+
+/*!
+ * Private function to drop a clock hold, the clock is gated once idle
+ */
+static void vpu_clk_unhold(void)
+{
+	mutex_lock(&vpu_gate.lock);
+	if (vpu_gate.users && !--vpu_gate.users) {
+		vpu_gate.busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							  vpu_gate.busy_start));
+		schedule_delayed_work(&vpu_gate.work,
+				      msecs_to_jiffies(vpu_gate.idle_ms));
+	}
+	mutex_unlock(&vpu_gate.lock);
+}
+
+/*!
+ * Private function to drop all clock holds and gate the clock now
+ */
+static void vpu_clk_gate_reset(void)
+{
+	cancel_delayed_work_sync(&vpu_gate.work);
+
+	mutex_lock(&vpu_gate.lock);
+	vpu_gate.users = 0;
+	if (vpu_gate.on) {
+		clk_disable(vpu_clk);
+		clk_unprepare(vpu_clk);
+		vpu_gate.on = false;
+	}
+	mutex_unlock(&vpu_gate.lock);
+}
+
+static ssize_t clk_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	ssize_t len;
+
+	mutex_lock(&vpu_gate.lock);
+	len = scnprintf(buf, PAGE_SIZE,
+			"on: %d\nholds: %u\npowerups: %u\nwarm_holds: %u\n"
+			"powerup_avg_ns: %llu\npowerup_max_ns: %llu\n"
+			"busy_ns: %llu\n",
+			vpu_gate.on, vpu_gate.users, vpu_gate.powerups,
+			vpu_gate.warm_holds,
+			vpu_gate.powerups ?
+			div_u64(vpu_gate.powerup_ns, vpu_gate.powerups) : 0,
+			vpu_gate.powerup_max_ns, vpu_gate.busy_ns);
+	mutex_unlock(&vpu_gate.lock);
+
+	return len;
+}
+static DEVICE_ATTR_RO(clk_stats);
+
+static ssize_t clk_idle_ms_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", vpu_gate.idle_ms);
+}
+
+static ssize_t clk_idle_ms_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	vpu_gate.idle_ms = val;
+	return count;
+}
+static DEVICE_ATTR_RW(clk_idle_ms);
+
+static struct attribute *vpu_attrs[] = {
+	&dev_attr_clk_stats.attr,
+	&dev_attr_clk_idle_ms.attr,
+	NULL
+};
+
+static const struct attribute_group vpu_attr_group = {
+	.attrs = vpu_attrs,
+};
+
 static inline void vpu_worker_callback(struct work_struct *w)
 {
 	struct vpu_priv *dev = container_of(w, struct vpu_priv,
@@ -334,6 +797,7 @@ static irqreturn_t vpu_ipi_irq_handler(int irq, void *dev_id)
 	unsigned long reg;
 
 	reg = READ_REG(BIT_INT_REASON);
+	trace_imx_vpu_hw_done(dev_name(vpu_dev), false, reg);
 	if (reg & 0x8)
 		codec_done = 1;
 	WRITE_REG(0x1, BIT_INT_CLEAR);
@@ -353,6 +817,7 @@ static irqreturn_t vpu_jpu_irq_handler(int irq, void *dev_id)
 	unsigned long reg;
 
 	reg = READ_REG(MJPEG_PIC_STATUS_REG);
+	trace_imx_vpu_hw_done(dev_name(vpu_dev), true, reg);
 	if (reg & 0x3)
 		codec_done = 1;
 
@@ -386,6 +851,12 @@ bool vpu_is_valid_phy_memory(u32 paddr)
  */
 static int vpu_open(struct inode *inode, struct file *filp)
 {
+	struct vpu_instance *inst;
+
+	inst = kzalloc(sizeof(*inst), GFP_KERNEL);
+	if (!inst)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&inst->list);
 
 	mutex_lock(&vpu_data.lock);
 
@@ -402,7 +873,7 @@ static int vpu_open(struct inode *inode, struct file *filp)
 #endif
 	}
 
-	filp->private_data = (void *)(&vpu_data);
+	filp->private_data = inst;
 	mutex_unlock(&vpu_data.lock);
 	return 0;
 }
@@ -425,6 +896,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 			rec = kzalloc(sizeof(*rec), GFP_KERNEL);
 			if (!rec)
 				return -ENOMEM;
+			kref_init(&rec->ref);
 
 			ret = copy_from_user(&(rec->mem),
 					     (struct vpu_mem_desc *)arg,
@@ -460,7 +932,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 		}
 	case VPU_IOC_PHYMEM_FREE:
 		{
-			struct memalloc_record *rec, *n;
+			struct memalloc_record *rec, *found = NULL;
 			struct vpu_mem_desc vpu_mem;
 
 			ret = copy_from_user(&vpu_mem,
@@ -471,20 +943,24 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 
 			dev_dbg(vpu_dev, "[FREE] mem freed cpu_addr = 0x%x\n",
 				 vpu_mem.cpu_addr);
-			if ((void *)vpu_mem.cpu_addr != NULL)
-				vpu_free_dma_buffer(&vpu_mem);
 
 			mutex_lock(&vpu_data.lock);
-			list_for_each_entry_safe(rec, n, &head, list) {
+			list_for_each_entry(rec, &head, list) {
 				if (rec->mem.cpu_addr == vpu_mem.cpu_addr) {
 					/* delete from list */
 					list_del(&rec->list);
-					kfree(rec);
+					found = rec;
 					break;
 				}
 			}
 			mutex_unlock(&vpu_data.lock);
 
+			/* exported buffers are freed with their last dma-buf */
+			if (found)
+				kref_put(&found->ref, vpu_memalloc_release);
+			else if ((void *)vpu_mem.cpu_addr != NULL)
+				vpu_free_dma_buffer(&vpu_mem);
+
 			break;
 		}
 	case VPU_IOC_WAIT4INT:
@@ -500,6 +976,7 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				ret = -ERESTARTSYS;
 			} else
 				irq_status = 0;
+			trace_imx_vpu_wait_done(dev_name(vpu_dev), ret);
 			break;
 		}
 	case VPU_IOC_IRAM_SETTING:
@@ -519,13 +996,10 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				return -EFAULT;
 
 			if (clkgate_en) {
-				clk_prepare(vpu_clk);
-				clk_enable(vpu_clk);
-				atomic_inc(&clk_cnt_from_ioc);
+				vpu_clk_hold();
+				trace_imx_vpu_hw_start(dev_name(vpu_dev));
 			} else {
-				clk_disable(vpu_clk);
-				clk_unprepare(vpu_clk);
-				atomic_dec(&clk_cnt_from_ioc);
+				vpu_clk_unhold();
 			}
 
 			break;
@@ -675,12 +1149,68 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
 				return -EFAULT;
 
 			if (lock_en)
-				mutex_lock(&vpu_data.lock);
+				ret = vpu_sched_lock(filp->private_data);
 			else
-				mutex_unlock(&vpu_data.lock);
+				vpu_sched_unlock(filp->private_data);
 
 			break;
 		}
+	case VPU_IOC_PHYMEM_EXPORT:
+		{
+			struct vpu_dmabuf_desc desc;
+
+			if (copy_from_user(&desc, (void __user *)arg,
+					   sizeof(desc)))
+				return -EFAULT;
+
+			desc.fd = vpu_dmabuf_export(&desc);
+			if (desc.fd < 0)
+				return desc.fd;
+
+			/* the fd is installed already, userspace owns it now */
+			if (copy_to_user((void __user *)arg, &desc,
+					 sizeof(desc)))
+				ret = -EFAULT;
+			break;
+		}
+	case VPU_IOC_DMABUF_IMPORT:
+		{
+			struct vpu_dmabuf_desc desc;
+
+			if (copy_from_user(&desc, (void __user *)arg,
+					   sizeof(desc)))
+				return -EFAULT;
+
+			ret = vpu_dmabuf_import(&desc);
+			if (ret)
+				break;
+
+			if (copy_to_user((void __user *)arg, &desc,
+					 sizeof(desc)))
+				ret = -EFAULT;
+			break;
+		}
+	case VPU_IOC_DMABUF_RELEASE:
+		{
+			struct dmabuf_record *rec, *n;
+			struct vpu_dmabuf_desc desc;
+
+			if (copy_from_user(&desc, (void __user *)arg,
+					   sizeof(desc)))
+				return -EFAULT;
+
+			ret = -EINVAL;
+			mutex_lock(&vpu_data.lock);
+			list_for_each_entry_safe(rec, n, &import_head, list) {
+				if (rec->phy_addr == desc.phy_addr) {
+					vpu_dmabuf_release_import(rec);
+					ret = 0;
+					break;
+				}
+			}
+			mutex_unlock(&vpu_data.lock);
+			break;
+		}
 	default:
 		{
 			dev_err(vpu_dev, "No such IOCTL, cmd is %d\n", cmd);
@@ -697,9 +1227,13 @@ static long vpu_ioctl(struct file *filp, u_int cmd,
  */
 static int vpu_release(struct inode *inode, struct file *filp)
 {
-	int i;
+	struct vpu_instance *inst = filp->private_data;
 	unsigned long timeout;
 
+	/* do not leave the other instances waiting on a closed one */
+	vpu_sched_unlock(inst);
+	kfree(inst);
+
 	mutex_lock(&vpu_data.lock);
 
 	if (open_count > 0 && !(--open_count)) {
@@ -773,12 +1307,7 @@ static int vpu_release(struct inode *inode, struct file *filp)
 		vfree((void *)vshare_mem.cpu_addr);
 		vshare_mem.cpu_addr = 0;
 
-		vpu_clk_usercount = atomic_read(&clk_cnt_from_ioc);
-		for (i = 0; i < vpu_clk_usercount; i++) {
-			clk_disable(vpu_clk);
-			clk_unprepare(vpu_clk);
-			atomic_dec(&clk_cnt_from_ioc);
-		}
+		vpu_clk_gate_reset();
 
 		vpu_power_up(false);
 	}
@@ -793,8 +1322,7 @@ static int vpu_release(struct inode *inode, struct file *filp)
  */
 static int vpu_fasync(int fd, struct file *filp, int mode)
 {
-	struct vpu_priv *dev = (struct vpu_priv *)filp->private_data;
-	return fasync_helper(fd, filp, mode, &dev->async_queue);
+	return fasync_helper(fd, filp, mode, &vpu_data.async_queue);
 }
 
 /*!
@@ -1018,6 +1546,11 @@ static int vpu_dev_probe(struct platform_device *pdev)
 	vpu_data.workqueue = create_workqueue("vpu_wq");
 	INIT_WORK(&vpu_data.work, vpu_worker_callback);
 	mutex_init(&vpu_data.lock);
+	mutex_init(&vpu_gate.lock);
+	INIT_DELAYED_WORK(&vpu_gate.work, vpu_clk_gate_work);
+
+	if (sysfs_create_group(&pdev->dev.kobj, &vpu_attr_group))
+		dev_warn(vpu_dev, "failed to create sysfs attributes\n");
 	dev_info(vpu_dev, "VPU initialized\n");
 	goto out;
 
@@ -1034,6 +1567,8 @@ out:
 
 static int vpu_dev_remove(struct platform_device *pdev)
 {
+	sysfs_remove_group(&pdev->dev.kobj, &vpu_attr_group);
+	cancel_delayed_work_sync(&vpu_gate.work);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 5, 0)
 	pm_runtime_disable(&pdev->dev);
 #endif
@@ -1103,11 +1638,13 @@ static int vpu_suspend(struct platform_device *pdev, pm_message_t state)
 		clk_unprepare(vpu_clk);
 
 		/* Make sure clock is disabled before suspend */
-		vpu_clk_usercount = atomic_read(&clk_cnt_from_ioc);
-		for (i = 0; i < vpu_clk_usercount; i++) {
+		cancel_delayed_work_sync(&vpu_gate.work);
+		mutex_lock(&vpu_gate.lock);
+		if (vpu_gate.on) {
 			clk_disable(vpu_clk);
 			clk_unprepare(vpu_clk);
 		}
+		mutex_unlock(&vpu_gate.lock);
 
 		if (cpu_is_mx53()) {
 			mutex_unlock(&vpu_data.lock);
@@ -1233,11 +1770,15 @@ static int vpu_resume(struct platform_device *pdev)
 		}
 
 recover_clk:
-		/* Recover vpu clock */
-		for (i = 0; i < vpu_clk_usercount; i++) {
+		/* Recover vpu clock, an idle one is gated right away */
+		mutex_lock(&vpu_gate.lock);
+		if (vpu_gate.on) {
 			clk_prepare(vpu_clk);
 			clk_enable(vpu_clk);
+			if (!vpu_gate.users)
+				schedule_delayed_work(&vpu_gate.work, 0);
 		}
+		mutex_unlock(&vpu_gate.lock);
 	}
 
 	mutex_unlock(&vpu_data.lock);
@@ -1253,7 +1794,8 @@ static int vpu_runtime_suspend(struct device *dev)
 
 static int vpu_runtime_resume(struct device *dev)
 {
-	request_bus_freq(BUS_FREQ_HIGH);
+	/* decoding can start while the DDR rate is still being raised */
+	request_bus_freq_nowait(BUS_FREQ_HIGH);
 	return 0;
 }
 
@@ -0,0 +1,105 @@
+/*
+ * i.MX VPU driver tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ *
+ * Part of the imx_media trace system shared with the V4L2 capture, IPU
+ * device and DRM CRTC drivers. The VPU library runs the codec through the
+ * mapped registers, so the kernel only sees the buffers it imports, the
+ * clock hold the library takes around each command, and the interrupts.
+ */
+
+#if !defined(__MXC_VPU_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __MXC_VPU_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM imx_media
+
+DECLARE_EVENT_CLASS(imx_vpu_buf,
+	TP_PROTO(const char *dev, dma_addr_t addr, u32 size),
+	TP_ARGS(dev, addr, size),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(u64, addr)
+		__field(u32, size)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->addr = addr;
+		__entry->size = size;
+	),
+	TP_printk("%s: addr=0x%08llx size=%u", __get_str(dev),
+		  __entry->addr, __entry->size)
+);
+
+/* VPU_IOC_DMABUF_IMPORT, the buffer is now usable as a frame buffer */
+DEFINE_EVENT(imx_vpu_buf, imx_vpu_buf_import,
+	TP_PROTO(const char *dev, dma_addr_t addr, u32 size),
+	TP_ARGS(dev, addr, size)
+);
+
+DEFINE_EVENT(imx_vpu_buf, imx_vpu_buf_release,
+	TP_PROTO(const char *dev, dma_addr_t addr, u32 size),
+	TP_ARGS(dev, addr, size)
+);
+
+/* VPU_IOC_CLKGATE_SETTING on, taken right before a command is run */
+TRACE_EVENT(imx_vpu_hw_start,
+	TP_PROTO(const char *dev),
+	TP_ARGS(dev),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+	),
+	TP_printk("%s", __get_str(dev))
+);
+
+/* BIT_INT_REASON or, for the JPU, MJPEG_PIC_STATUS_REG */
+TRACE_EVENT(imx_vpu_hw_done,
+	TP_PROTO(const char *dev, bool jpu, u32 status),
+	TP_ARGS(dev, jpu, status),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(bool, jpu)
+		__field(u32, status)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->jpu = jpu;
+		__entry->status = status;
+	),
+	TP_printk("%s: %s status=0x%x", __get_str(dev),
+		  __entry->jpu ? "jpu" : "bit", __entry->status)
+);
+
+/* VPU_IOC_WAIT4INT returns, the library learns the command finished */
+TRACE_EVENT(imx_vpu_wait_done,
+	TP_PROTO(const char *dev, int ret),
+	TP_ARGS(dev, ret),
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->ret = ret;
+	),
+	TP_printk("%s: ret=%d", __get_str(dev), __entry->ret)
+);
+
+#endif /* __MXC_VPU_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mxc_vpu_trace
+#include <trace/define_trace.h>
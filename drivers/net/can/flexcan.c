@@ -47,6 +47,8 @@
 
 /* 8 for RX fifo and 2 error handling */
 #define FLEXCAN_NAPI_WEIGHT		(8 + 2)
+/* RX mailboxes are read out in the IRQ handler, NAPI only delivers */
+#define FLEXCAN_NAPI_WEIGHT_OFF_TIMESTAMP	NAPI_POLL_WEIGHT
 
 /* FLEXCAN module configuration register (CANMCR) bits */
 #define FLEXCAN_MCR_MDIS		BIT(31)
@@ -67,6 +69,7 @@
 #define FLEXCAN_MCR_BCC			BIT(16)
 #define FLEXCAN_MCR_LPRIO_EN		BIT(13)
 #define FLEXCAN_MCR_AEN			BIT(12)
+#define FLEXCAN_MCR_FDEN		BIT(11)
 #define FLEXCAN_MCR_MAXMB(x)		((x) & 0x7f)
 #define FLEXCAN_MCR_IDAM_A		(0x0 << 8)
 #define FLEXCAN_MCR_IDAM_B		(0x1 << 8)
@@ -105,6 +108,30 @@
 #define FLEXCAN_CTRL2_MRP		BIT(18)
 #define FLEXCAN_CTRL2_RRS		BIT(17)
 #define FLEXCAN_CTRL2_EACEN		BIT(16)
+#define FLEXCAN_CTRL2_ISOCANFDEN	BIT(12)
+
+/* FLEXCAN CAN bit timing register (CBT) bits */
+#define FLEXCAN_CBT_BTF			BIT(31)
+#define FLEXCAN_CBT_EPRESDIV(x)		(((x) & 0x3ff) << 21)
+#define FLEXCAN_CBT_ERJW(x)		(((x) & 0x1f) << 16)
+#define FLEXCAN_CBT_EPROPSEG(x)		(((x) & 0x3f) << 10)
+#define FLEXCAN_CBT_EPSEG1(x)		(((x) & 0x1f) << 5)
+#define FLEXCAN_CBT_EPSEG2(x)		((x) & 0x1f)
+
+/* FLEXCAN FD control register (FDCTRL) bits */
+#define FLEXCAN_FDCTRL_FDRATE		BIT(31)
+#define FLEXCAN_FDCTRL_MBDSR1(x)	(((x) & 0x3) << 19)
+#define FLEXCAN_FDCTRL_MBDSR0(x)	(((x) & 0x3) << 16)
+#define FLEXCAN_FDCTRL_MBDSR_64		0x3
+#define FLEXCAN_FDCTRL_TDCEN		BIT(15)
+#define FLEXCAN_FDCTRL_TDCOFF(x)	(((x) & 0x1f) << 8)
+
+/* FLEXCAN FD bit timing register (FDCBT) bits */
+#define FLEXCAN_FDCBT_FPRESDIV(x)	(((x) & 0x3ff) << 20)
+#define FLEXCAN_FDCBT_FRJW(x)		(((x) & 0x07) << 16)
+#define FLEXCAN_FDCBT_FPROPSEG(x)	(((x) & 0x1f) << 10)
+#define FLEXCAN_FDCBT_FPSEG1(x)		(((x) & 0x07) << 5)
+#define FLEXCAN_FDCBT_FPSEG2(x)		((x) & 0x07)
 
 /* FLEXCAN memory error control register (MECR) bits */
 #define FLEXCAN_MECR_ECRWRDIS		BIT(31)
@@ -155,7 +182,19 @@
 /* Errata ERR005829 step7: Reserve first valid MB */
 #define FLEXCAN_TX_BUF_RESERVED		8
 #define FLEXCAN_TX_BUF_ID		9
+/* Mailbox layout when offloading by timestamp:
+ * MB0 reserved (ERR005829), then the RX mailboxes, the TX mailboxes
+ * at the top; i.e. MB1..55 RX, MB56..63 TX with 8 byte payloads and
+ * MB1..11 RX, MB12..13 TX with 64 byte CAN FD payloads.
+ */
+#define FLEXCAN_TX_BUF_RESERVED_OFF_TIMESTAMP	0
+#define FLEXCAN_RX_MB_OFF_TIMESTAMP_FIRST	1
+#define FLEXCAN_TX_MB_OFF_TIMESTAMP_NUM		8
+#define FLEXCAN_TX_MB_FD_NUM			2
+/* frames queued by the IRQ handler but not yet delivered by NAPI */
+#define FLEXCAN_RX_QUEUE_MAX		256
 #define FLEXCAN_IFLAG_BUF(x)		BIT(x)
+#define FLEXCAN_IFLAG_MB(x)		BIT_ULL(x)
 #define FLEXCAN_IFLAG_RX_FIFO_OVERFLOW	BIT(7)
 #define FLEXCAN_IFLAG_RX_FIFO_WARN	BIT(6)
 #define FLEXCAN_IFLAG_RX_FIFO_AVAILABLE	BIT(5)
@@ -164,6 +203,8 @@
 	 FLEXCAN_IFLAG_BUF(FLEXCAN_TX_BUF_ID))
 
 /* FLEXCAN message buffers */
+#define FLEXCAN_MB_CODE_MASK		(0xf << 24)
+#define FLEXCAN_MB_CODE_RX_BUSY_BIT	(0x1 << 24)
 #define FLEXCAN_MB_CODE_RX_INACTIVE	(0x0 << 24)
 #define FLEXCAN_MB_CODE_RX_EMPTY	(0x4 << 24)
 #define FLEXCAN_MB_CODE_RX_FULL		(0x2 << 24)
@@ -175,6 +216,9 @@
 #define FLEXCAN_MB_CODE_TX_DATA		(0xc << 24)
 #define FLEXCAN_MB_CODE_TX_TANSWER	(0xe << 24)
 
+#define FLEXCAN_MB_CNT_EDL		BIT(31)
+#define FLEXCAN_MB_CNT_BRS		BIT(30)
+#define FLEXCAN_MB_CNT_ESI		BIT(29)
 #define FLEXCAN_MB_CNT_SRR		BIT(22)
 #define FLEXCAN_MB_CNT_IDE		BIT(21)
 #define FLEXCAN_MB_CNT_RTR		BIT(20)
@@ -200,12 +244,14 @@
 #define FLEXCAN_QUIRK_BROKEN_ERR_STATE	BIT(1) /* [TR]WRN_INT not connected */
 #define FLEXCAN_QUIRK_DISABLE_RXFG	BIT(2) /* Disable RX FIFO Global mask */
 #define FLEXCAN_QUIRK_DISABLE_MECR	BIT(3) /* Disble Memory error detection */
+#define FLEXCAN_QUIRK_USE_OFF_TIMESTAMP	BIT(4) /* Use timestamp offloading */
+#define FLEXCAN_QUIRK_SUPPORT_FD	BIT(5) /* Supports CAN FD mode */
 
 /* Structure of the message buffer */
 struct flexcan_mb {
 	u32 can_ctrl;
 	u32 can_id;
-	u32 data[2];
+	u32 data[];
 };
 
 /* Structure of the hardware registers */
@@ -230,8 +276,9 @@ struct flexcan_regs {
 	u32 crcr;		/* 0x44 */
 	u32 rxfgmask;		/* 0x48 */
 	u32 rxfir;		/* 0x4c */
-	u32 _reserved3[12];	/* 0x50 */
-	struct flexcan_mb mb[64];	/* 0x80 */
+	u32 cbt;		/* 0x50 */
+	u32 _reserved3[11];	/* 0x54 */
+	u8 mb[2][512];		/* 0x80 */
 	/* FIFO-mode:
 	 *			MB
 	 * 0x080...0x08f	0	RX message buffer
@@ -241,6 +288,10 @@ struct flexcan_regs {
 	 * 0x0e0...0x2df	6-7..37	8..128 entry ID table
 	 *				size conf'ed via ctrl2::RFFN
 	 *				(mx6, vf610)
+	 * Mailbox-mode:
+	 *  two 512 byte blocks, each with as many MBs of
+	 *  sizeof(struct flexcan_mb) + payload as fit,
+	 *  see flexcan_get_mb()
 	 */
 	u32 _reserved4[408];
 	u32 mecr;		/* 0xae0 */
@@ -251,6 +302,10 @@ struct flexcan_regs {
 	u32 rerrdr;		/* 0xaf4 */
 	u32 rerrsynr;		/* 0xaf8 */
 	u32 errsr;		/* 0xafc */
+	u32 _reserved5[64];	/* 0xb00 */
+	u32 fdctrl;		/* 0xc00 */
+	u32 fdcbt;		/* 0xc04 */
+	u32 fdcrc;		/* 0xc08 */
 };
 
 struct flexcan_devtype_data {
@@ -271,6 +326,26 @@ struct flexcan_priv {
 	struct flexcan_regs __iomem *regs;
 	u32 reg_esr;
 	u32 reg_ctrl_default;
+	u32 reg_imask1_default;
+	u32 reg_imask2_default;
+
+	/* mailbox layout, see FLEXCAN_QUIRK_USE_OFF_TIMESTAMP */
+	u8 mb_size;
+	u8 mb_count;
+	u8 tx_mb_reserved;
+	u8 tx_mb_first;
+	u8 tx_mb_num;
+	u8 rx_mb_first;
+	u8 rx_mb_last;
+	u64 rx_mask;
+	u64 tx_mask;
+
+	/* free running, next TX mailbox is tx_mb_first + tx_next % tx_mb_num */
+	unsigned int tx_next;
+	unsigned int tx_echo;
+
+	/* RX frames read out by the IRQ handler, in timestamp order */
+	struct sk_buff_head rx_queue;
 
 	struct clk *clk_ipg;
 	struct clk *clk_per;
@@ -289,11 +364,22 @@ static struct flexcan_devtype_data fsl_p1010_devtype_data = {
 static struct flexcan_devtype_data fsl_imx28_devtype_data;
 
 static struct flexcan_devtype_data fsl_imx6q_devtype_data = {
-	.quirks = FLEXCAN_QUIRK_DISABLE_RXFG,
+	.quirks = FLEXCAN_QUIRK_DISABLE_RXFG | FLEXCAN_QUIRK_USE_OFF_TIMESTAMP,
+};
+
+static struct flexcan_devtype_data fsl_imx8qm_devtype_data = {
+	.quirks = FLEXCAN_QUIRK_DISABLE_RXFG | FLEXCAN_QUIRK_USE_OFF_TIMESTAMP |
+		FLEXCAN_QUIRK_SUPPORT_FD,
 };
 
 static struct flexcan_devtype_data fsl_vf610_devtype_data = {
-	.quirks = FLEXCAN_QUIRK_DISABLE_RXFG | FLEXCAN_QUIRK_DISABLE_MECR,
+	.quirks = FLEXCAN_QUIRK_DISABLE_RXFG | FLEXCAN_QUIRK_DISABLE_MECR |
+		FLEXCAN_QUIRK_USE_OFF_TIMESTAMP,
+};
+
+/* Private data of the RX skbs while sorting them by timestamp */
+struct flexcan_skb_cb {
+	u32 timestamp;
 };
 
 static const struct can_bittiming_const flexcan_bittiming_const = {
@@ -308,6 +394,31 @@ static const struct can_bittiming_const flexcan_bittiming_const = {
 	.brp_inc = 1,
 };
 
+/* nominal bit timing through CBT, for cores with CAN FD support */
+static const struct can_bittiming_const flexcan_fd_bittiming_const = {
+	.name = DRV_NAME,
+	.tseg1_min = 2,
+	.tseg1_max = 96,
+	.tseg2_min = 2,
+	.tseg2_max = 32,
+	.sjw_max = 16,
+	.brp_min = 1,
+	.brp_max = 1024,
+	.brp_inc = 1,
+};
+
+static const struct can_bittiming_const flexcan_fd_data_bittiming_const = {
+	.name = DRV_NAME,
+	.tseg1_min = 2,
+	.tseg1_max = 39,
+	.tseg2_min = 2,
+	.tseg2_max = 8,
+	.sjw_max = 4,
+	.brp_min = 1,
+	.brp_max = 1024,
+	.brp_inc = 1,
+};
+
 /* Abstract off the read/write for arm versus ppc. This
  * assumes that PPC uses big-endian registers and everything
  * else uses little-endian registers, independent of CPU
@@ -335,6 +446,44 @@ static inline void flexcan_write(u32 val, void __iomem *addr)
 }
 #endif
 
+static inline bool flexcan_use_off_timestamp(const struct flexcan_priv *priv)
+{
+	return priv->devtype_data->quirks & FLEXCAN_QUIRK_USE_OFF_TIMESTAMP;
+}
+
+static inline u64 flexcan_read_reg_iflag(const struct flexcan_priv *priv)
+{
+	struct flexcan_regs __iomem *regs = priv->regs;
+	u64 reg_iflag = flexcan_read(&regs->iflag1);
+
+	if (flexcan_use_off_timestamp(priv))
+		reg_iflag |= (u64)flexcan_read(&regs->iflag2) << 32;
+
+	return reg_iflag;
+}
+
+static struct flexcan_mb __iomem *
+flexcan_get_mb(const struct flexcan_priv *priv, unsigned int n)
+{
+	unsigned int bank_size = sizeof(priv->regs->mb[0]) / priv->mb_size;
+	unsigned int bank = n / bank_size;
+
+	return (struct flexcan_mb __iomem *)
+		&priv->regs->mb[bank][priv->mb_size * (n % bank_size)];
+}
+
+/* IFLAG bits are write-1-to-clear */
+static inline void flexcan_clear_reg_iflag(const struct flexcan_priv *priv,
+					   u64 reg_iflag)
+{
+	struct flexcan_regs __iomem *regs = priv->regs;
+
+	if (lower_32_bits(reg_iflag))
+		flexcan_write(lower_32_bits(reg_iflag), &regs->iflag1);
+	if (upper_32_bits(reg_iflag))
+		flexcan_write(upper_32_bits(reg_iflag), &regs->iflag2);
+}
+
 static inline void flexcan_enter_stop_mode(struct flexcan_priv *priv)
 {
 	/* enable stop request */
@@ -519,49 +668,66 @@ static int flexcan_get_berr_counter(const struct net_device *dev,
 
 static int flexcan_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
-	const struct flexcan_priv *priv = netdev_priv(dev);
-	struct flexcan_regs __iomem *regs = priv->regs;
-	struct can_frame *cf = (struct can_frame *)skb->data;
+	struct flexcan_priv *priv = netdev_priv(dev);
+	struct canfd_frame *cfd = (struct canfd_frame *)skb->data;
+	struct flexcan_mb __iomem *mb;
+	unsigned int idx;
 	u32 can_id;
 	u32 data;
-	u32 ctrl = FLEXCAN_MB_CODE_TX_DATA | (cf->can_dlc << 16);
+	u32 ctrl = FLEXCAN_MB_CODE_TX_DATA | (can_len2dlc(cfd->len) << 16);
+	int i;
 
 	if (can_dropped_invalid_skb(dev, skb))
 		return NETDEV_TX_OK;
 
-	netif_stop_queue(dev);
+	idx = priv->tx_next % priv->tx_mb_num;
+	mb = flexcan_get_mb(priv, priv->tx_mb_first + idx);
 
-	if (cf->can_id & CAN_EFF_FLAG) {
-		can_id = cf->can_id & CAN_EFF_MASK;
+	if (cfd->can_id & CAN_EFF_FLAG) {
+		can_id = cfd->can_id & CAN_EFF_MASK;
 		ctrl |= FLEXCAN_MB_CNT_IDE | FLEXCAN_MB_CNT_SRR;
 	} else {
-		can_id = (cf->can_id & CAN_SFF_MASK) << 18;
+		can_id = (cfd->can_id & CAN_SFF_MASK) << 18;
 	}
 
-	if (cf->can_id & CAN_RTR_FLAG)
+	if (can_is_canfd_skb(skb)) {
+		ctrl |= FLEXCAN_MB_CNT_EDL;
+		if (cfd->flags & CANFD_BRS)
+			ctrl |= FLEXCAN_MB_CNT_BRS;
+	} else if (cfd->can_id & CAN_RTR_FLAG) {
 		ctrl |= FLEXCAN_MB_CNT_RTR;
-
-	if (cf->can_dlc > 0) {
-		data = be32_to_cpup((__be32 *)&cf->data[0]);
-		flexcan_write(data, &regs->mb[FLEXCAN_TX_BUF_ID].data[0]);
 	}
-	if (cf->can_dlc > 3) {
-		data = be32_to_cpup((__be32 *)&cf->data[4]);
-		flexcan_write(data, &regs->mb[FLEXCAN_TX_BUF_ID].data[1]);
+
+	for (i = 0; i < cfd->len; i += sizeof(u32)) {
+		data = be32_to_cpup((__be32 *)&cfd->data[i]);
+		flexcan_write(data, &mb->data[i / sizeof(u32)]);
 	}
 
-	can_put_echo_skb(skb, dev, 0);
+	can_put_echo_skb(skb, dev, idx);
+	priv->tx_next++;
 
-	flexcan_write(can_id, &regs->mb[FLEXCAN_TX_BUF_ID].can_id);
-	flexcan_write(ctrl, &regs->mb[FLEXCAN_TX_BUF_ID].can_ctrl);
+	flexcan_write(can_id, &mb->can_id);
+	flexcan_write(ctrl, &mb->can_ctrl);
 
 	/* Errata ERR005829 step8:
 	 * Write twice INACTIVE(0x8) code to first MB.
 	 */
 	flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
-		      &regs->mb[FLEXCAN_TX_BUF_RESERVED].can_ctrl);
+		      &flexcan_get_mb(priv, priv->tx_mb_reserved)->can_ctrl);
 	flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
-		      &regs->mb[FLEXCAN_TX_BUF_RESERVED].can_ctrl);
+		      &flexcan_get_mb(priv, priv->tx_mb_reserved)->can_ctrl);
+
+	/* With CTRL[LBUF] the lowest numbered pending mailbox is sent
+	 * first, so only wrap around to the first TX mailbox once all
+	 * of them are done to keep the frames in order on the bus.
+	 */
+	if (!(priv->tx_next % priv->tx_mb_num)) {
+		netif_stop_queue(dev);
+		/* pairs with the tx_echo update in flexcan_irq() */
+		smp_mb();
+		if (priv->tx_echo == priv->tx_next)
+			netif_wake_queue(dev);
+	}
 
 	return NETDEV_TX_OK;
 }
@@ -676,27 +842,47 @@ static int flexcan_poll_state(struct net_device *dev, u32 reg_esr)
 	return 1;
 }
 
-static void flexcan_read_fifo(const struct net_device *dev,
-			      struct can_frame *cf)
+/* struct can_frame and struct canfd_frame share the layout up to the
+ * data, so classic frames are read through a canfd_frame, too.
+ */
+static void flexcan_read_mb(struct flexcan_mb __iomem *mb, u32 reg_ctrl,
+			    struct canfd_frame *cfd)
 {
-	const struct flexcan_priv *priv = netdev_priv(dev);
-	struct flexcan_regs __iomem *regs = priv->regs;
-	struct flexcan_mb __iomem *mb = &regs->mb[0];
-	u32 reg_ctrl, reg_id;
+	u32 reg_id;
+	int i;
 
-	reg_ctrl = flexcan_read(&mb->can_ctrl);
 	reg_id = flexcan_read(&mb->can_id);
 	if (reg_ctrl & FLEXCAN_MB_CNT_IDE)
-		cf->can_id = ((reg_id >> 0) & CAN_EFF_MASK) | CAN_EFF_FLAG;
+		cfd->can_id = ((reg_id >> 0) & CAN_EFF_MASK) | CAN_EFF_FLAG;
 	else
-		cf->can_id = (reg_id >> 18) & CAN_SFF_MASK;
+		cfd->can_id = (reg_id >> 18) & CAN_SFF_MASK;
+
+	if (reg_ctrl & FLEXCAN_MB_CNT_EDL) {
+		cfd->len = can_dlc2len((reg_ctrl >> 16) & 0xf);
+		if (reg_ctrl & FLEXCAN_MB_CNT_BRS)
+			cfd->flags |= CANFD_BRS;
+		if (reg_ctrl & FLEXCAN_MB_CNT_ESI)
+			cfd->flags |= CANFD_ESI;
+	} else {
+		if (reg_ctrl & FLEXCAN_MB_CNT_RTR)
+			cfd->can_id |= CAN_RTR_FLAG;
+		cfd->len = get_can_dlc((reg_ctrl >> 16) & 0xf);
+	}
+
+	for (i = 0; i < cfd->len; i += sizeof(u32))
+		*(__be32 *)(cfd->data + i) =
+			cpu_to_be32(flexcan_read(&mb->data[i / sizeof(u32)]));
+}
 
-	if (reg_ctrl & FLEXCAN_MB_CNT_RTR)
-		cf->can_id |= CAN_RTR_FLAG;
-	cf->can_dlc = get_can_dlc((reg_ctrl >> 16) & 0xf);
+static void flexcan_read_fifo(const struct net_device *dev,
+			      struct can_frame *cf)
+{
+	const struct flexcan_priv *priv = netdev_priv(dev);
+	struct flexcan_regs __iomem *regs = priv->regs;
+	struct flexcan_mb __iomem *mb = flexcan_get_mb(priv, 0);
 
-	*(__be32 *)(cf->data + 0) = cpu_to_be32(flexcan_read(&mb->data[0]));
-	*(__be32 *)(cf->data + 4) = cpu_to_be32(flexcan_read(&mb->data[1]));
+	flexcan_read_mb(mb, flexcan_read(&mb->can_ctrl),
+			(struct canfd_frame *)cf);
 
 	/* mark as read */
 	flexcan_write(FLEXCAN_IFLAG_RX_FIFO_AVAILABLE, &regs->iflag1);
@@ -726,11 +912,125 @@ static int flexcan_read_frame(struct net_device *dev)
 	return 1;
 }
 
+static inline struct flexcan_skb_cb *flexcan_get_skb_cb(struct sk_buff *skb)
+{
+	BUILD_BUG_ON(sizeof(struct flexcan_skb_cb) > sizeof(skb->cb));
+
+	return (struct flexcan_skb_cb *)skb->cb;
+}
+
+/* The core stores a frame in the lowest numbered free mailbox, so
+ * once some mailboxes have been read out the mailbox number no longer
+ * says anything about the reception order. Insert by timestamp instead,
+ * the 16 bit free running timer is shifted up so that the wrap around is
+ * handled by the unsigned arithmetic.
+ */
+static void flexcan_queue_sorted(struct sk_buff_head *head,
+				 struct sk_buff *new)
+{
+	struct sk_buff *pos, *insert = NULL;
+	u32 ts = flexcan_get_skb_cb(new)->timestamp;
+
+	skb_queue_reverse_walk(head, pos) {
+		if ((s32)(ts - flexcan_get_skb_cb(pos)->timestamp) >= 0) {
+			insert = pos;
+			break;
+		}
+	}
+
+	if (insert)
+		__skb_queue_after(head, insert, new);
+	else
+		__skb_queue_head(head, new);
+}
+
+static void flexcan_read_mailbox(struct net_device *dev, unsigned int n,
+				 struct sk_buff_head *queue)
+{
+	struct flexcan_priv *priv = netdev_priv(dev);
+	struct flexcan_regs __iomem *regs = priv->regs;
+	struct flexcan_mb __iomem *mb = flexcan_get_mb(priv, n);
+	struct net_device_stats *stats = &dev->stats;
+	struct canfd_frame *cfd;
+	struct sk_buff *skb;
+	u32 reg_ctrl, code;
+
+	/* reading the control word locks the mailbox */
+	reg_ctrl = flexcan_read(&mb->can_ctrl);
+	code = reg_ctrl & FLEXCAN_MB_CODE_MASK;
+
+	/* still being filled, retry on the next pass */
+	if (code & FLEXCAN_MB_CODE_RX_BUSY_BIT)
+		return;
+
+	if (code == FLEXCAN_MB_CODE_RX_OVERRUN) {
+		stats->rx_over_errors++;
+		stats->rx_errors++;
+	}
+
+	if (code == FLEXCAN_MB_CODE_RX_FULL ||
+	    code == FLEXCAN_MB_CODE_RX_OVERRUN) {
+		if (skb_queue_len(&priv->rx_queue) + skb_queue_len(queue) >=
+		    FLEXCAN_RX_QUEUE_MAX)
+			skb = NULL;
+		else if (reg_ctrl & FLEXCAN_MB_CNT_EDL)
+			skb = alloc_canfd_skb(dev, &cfd);
+		else
+			skb = alloc_can_skb(dev, (struct can_frame **)&cfd);
+
+		if (likely(skb)) {
+			flexcan_read_mb(mb, reg_ctrl, cfd);
+			flexcan_get_skb_cb(skb)->timestamp =
+				FLEXCAN_MB_CNT_TIMESTAMP(reg_ctrl) << 16;
+			flexcan_queue_sorted(queue, skb);
+		} else {
+			stats->rx_dropped++;
+		}
+	}
+
+	/* mark as read, reading the timer unlocks the mailbox */
+	flexcan_clear_reg_iflag(priv, FLEXCAN_IFLAG_MB(n));
+	flexcan_read(&regs->timer);
+}
+
+/* Empty the RX mailboxes right in the IRQ handler so that they are
+ * available again as soon as possible, NAPI delivers the frames later.
+ */
+static void flexcan_irq_rx_offload(struct net_device *dev)
+{
+	struct flexcan_priv *priv = netdev_priv(dev);
+	struct sk_buff_head queue;
+	unsigned int i;
+	u64 pending;
+
+	__skb_queue_head_init(&queue);
+
+	pending = flexcan_read_reg_iflag(priv) & priv->rx_mask;
+	while (pending) {
+		for (i = priv->rx_mb_first; i <= priv->rx_mb_last; i++) {
+			if (pending & FLEXCAN_IFLAG_MB(i))
+				flexcan_read_mailbox(dev, i, &queue);
+		}
+		pending = flexcan_read_reg_iflag(priv) & priv->rx_mask;
+	}
+
+	if (skb_queue_empty(&queue))
+		return;
+
+	spin_lock(&priv->rx_queue.lock);
+	skb_queue_splice_tail(&queue, &priv->rx_queue);
+	spin_unlock(&priv->rx_queue.lock);
+
+	napi_schedule(&priv->napi);
+}
+
 static int flexcan_poll(struct napi_struct *napi, int quota)
 {
 	struct net_device *dev = napi->dev;
-	const struct flexcan_priv *priv = netdev_priv(dev);
+	struct flexcan_priv *priv = netdev_priv(dev);
 	struct flexcan_regs __iomem *regs = priv->regs;
+	struct net_device_stats *stats = &dev->stats;
+	struct sk_buff *skb;
 	u32 reg_iflag1, reg_esr;
 	int work_done = 0;
 
@@ -742,12 +1042,28 @@ static int flexcan_poll(struct napi_struct *napi, int quota)
 	/* handle state changes */
 	work_done += flexcan_poll_state(dev, reg_esr);
 
-	/* handle RX-FIFO */
-	reg_iflag1 = flexcan_read(&regs->iflag1);
-	while (reg_iflag1 & FLEXCAN_IFLAG_RX_FIFO_AVAILABLE &&
-	       work_done < quota) {
-		work_done += flexcan_read_frame(dev);
+	if (flexcan_use_off_timestamp(priv)) {
+		/* deliver the mailboxes read out by the IRQ handler */
+		while (work_done < quota &&
+		       (skb = skb_dequeue(&priv->rx_queue))) {
+			struct canfd_frame *cfd;
+
+			cfd = (struct canfd_frame *)skb->data;
+			stats->rx_packets++;
+			stats->rx_bytes += cfd->len;
+			netif_receive_skb(skb);
+
+			can_led_event(dev, CAN_LED_EVENT_RX);
+			work_done++;
+		}
+	} else {
+		/* handle RX-FIFO */
 		reg_iflag1 = flexcan_read(&regs->iflag1);
+		while (reg_iflag1 & FLEXCAN_IFLAG_RX_FIFO_AVAILABLE &&
+		       work_done < quota) {
+			work_done += flexcan_read_frame(dev);
+			reg_iflag1 = flexcan_read(&regs->iflag1);
+		}
 	}
 
 	/* report bus errors */
@@ -757,8 +1073,12 @@ static int flexcan_poll(struct napi_struct *napi, int quota)
 	if (work_done < quota) {
 		napi_complete(napi);
 		/* enable IRQs */
-		flexcan_write(FLEXCAN_IFLAG_DEFAULT, &regs->imask1);
+		flexcan_write(priv->reg_imask1_default, &regs->imask1);
 		flexcan_write(priv->reg_ctrl_default, &regs->ctrl);
+
+		/* the IRQ handler queued frames while we were completing */
+		if (!skb_queue_empty(&priv->rx_queue))
+			napi_reschedule(napi);
 	}
 
 	return work_done;
@@ -770,9 +1090,11 @@ static irqreturn_t flexcan_irq(int irq, void *dev_id)
 	struct net_device_stats *stats = &dev->stats;
 	struct flexcan_priv *priv = netdev_priv(dev);
 	struct flexcan_regs __iomem *regs = priv->regs;
-	u32 reg_iflag1, reg_esr;
+	bool tx_done = false;
+	u64 reg_iflag;
+	u32 reg_esr;
 
-	reg_iflag1 = flexcan_read(&regs->iflag1);
+	reg_iflag = flexcan_read_reg_iflag(priv);
 	reg_esr = flexcan_read(&regs->esr);
 
 	/* ACK all bus error and state change IRQ sources */
@@ -782,48 +1104,142 @@ static irqreturn_t flexcan_irq(int irq, void *dev_id)
 	if (reg_esr & FLEXCAN_ESR_WAK_INT)
 		flexcan_exit_stop_mode(priv);
 
+	if (flexcan_use_off_timestamp(priv) && (reg_iflag & priv->rx_mask))
+		flexcan_irq_rx_offload(dev);
+
 	/* schedule NAPI in case of:
-	 * - rx IRQ
+	 * - rx IRQ (FIFO mode)
 	 * - state change IRQ
 	 * - bus error IRQ and bus error reporting is activated
 	 */
-	if ((reg_iflag1 & FLEXCAN_IFLAG_RX_FIFO_AVAILABLE) ||
+	if ((!flexcan_use_off_timestamp(priv) &&
+	     (reg_iflag & FLEXCAN_IFLAG_RX_FIFO_AVAILABLE)) ||
 	    (reg_esr & FLEXCAN_ESR_ERR_STATE) ||
 	    flexcan_has_and_handle_berr(priv, reg_esr)) {
 		/* The error bits are cleared on read,
 		 * save them for later use.
 		 */
 		priv->reg_esr = reg_esr & FLEXCAN_ESR_ERR_BUS;
-		flexcan_write(FLEXCAN_IFLAG_DEFAULT &
-			      ~FLEXCAN_IFLAG_RX_FIFO_AVAILABLE, &regs->imask1);
+		if (!flexcan_use_off_timestamp(priv))
+			flexcan_write(priv->reg_imask1_default &
+				      ~FLEXCAN_IFLAG_RX_FIFO_AVAILABLE,
+				      &regs->imask1);
 		flexcan_write(priv->reg_ctrl_default & ~FLEXCAN_CTRL_ERR_ALL,
 			      &regs->ctrl);
 		napi_schedule(&priv->napi);
 	}
 
 	/* FIFO overflow */
-	if (reg_iflag1 & FLEXCAN_IFLAG_RX_FIFO_OVERFLOW) {
+	if (!flexcan_use_off_timestamp(priv) &&
+	    (reg_iflag & FLEXCAN_IFLAG_RX_FIFO_OVERFLOW)) {
 		flexcan_write(FLEXCAN_IFLAG_RX_FIFO_OVERFLOW, &regs->iflag1);
 		dev->stats.rx_over_errors++;
 		dev->stats.rx_errors++;
 	}
 
-	/* transmission complete interrupt */
-	if (reg_iflag1 & (1 << FLEXCAN_TX_BUF_ID)) {
-		stats->tx_bytes += can_get_echo_skb(dev, 0);
+	/* transmission complete interrupt, mailboxes finish in order */
+	while (priv->tx_echo != priv->tx_next) {
+		unsigned int idx = priv->tx_echo % priv->tx_mb_num;
+		unsigned int n = priv->tx_mb_first + idx;
+
+		if (!(reg_iflag & FLEXCAN_IFLAG_MB(n)))
+			break;
+
+		stats->tx_bytes += can_get_echo_skb(dev, idx);
 		stats->tx_packets++;
 		can_led_event(dev, CAN_LED_EVENT_TX);
 
 		/* after sending a RTR frame MB is in RX mode */
 		flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
-			      &regs->mb[FLEXCAN_TX_BUF_ID].can_ctrl);
-		flexcan_write((1 << FLEXCAN_TX_BUF_ID), &regs->iflag1);
-		netif_wake_queue(dev);
+			      &flexcan_get_mb(priv, n)->can_ctrl);
+		flexcan_clear_reg_iflag(priv, FLEXCAN_IFLAG_MB(n));
+		priv->tx_echo++;
+		tx_done = true;
 	}
 
+	/* pairs with the wrap around check in flexcan_start_xmit() */
+	smp_mb();
+	if (tx_done && priv->tx_echo == priv->tx_next)
+		netif_wake_queue(dev);
+
 	return IRQ_HANDLED;
 }
 
+/* Nominal and, in CAN FD mode, data phase bit timing of the cores
+ * with FLEXCAN_QUIRK_SUPPORT_FD. CBT[BTF] makes the core ignore the
+ * timing fields in CTRL.
+ */
+static void flexcan_set_bittiming_cbt(struct net_device *dev)
+{
+	const struct flexcan_priv *priv = netdev_priv(dev);
+	const struct can_bittiming *bt = &priv->can.bittiming;
+	const struct can_bittiming *dbt = &priv->can.data_bittiming;
+	struct flexcan_regs __iomem *regs = priv->regs;
+	u32 prop_seg, phase_seg1, tdcoff;
+	u32 reg_cbt, reg_fdcbt, reg_fdctrl;
+
+	/* can_calc_bittiming() splits tseg1 evenly between prop_seg and
+	 * phase_seg1, move the part that does not fit into EPSEG1 over
+	 * to EPROPSEG.
+	 */
+	prop_seg = bt->prop_seg;
+	phase_seg1 = bt->phase_seg1;
+	if (phase_seg1 > 0x20) {
+		prop_seg += phase_seg1 - 0x20;
+		phase_seg1 = 0x20;
+	}
+
+	reg_cbt = FLEXCAN_CBT_BTF |
+		FLEXCAN_CBT_EPRESDIV(bt->brp - 1) |
+		FLEXCAN_CBT_ERJW(bt->sjw - 1) |
+		FLEXCAN_CBT_EPROPSEG(prop_seg - 1) |
+		FLEXCAN_CBT_EPSEG1(phase_seg1 - 1) |
+		FLEXCAN_CBT_EPSEG2(bt->phase_seg2 - 1);
+	netdev_dbg(dev, "writing cbt=0x%08x\n", reg_cbt);
+	flexcan_write(reg_cbt, &regs->cbt);
+
+	reg_fdctrl = flexcan_read(&regs->fdctrl);
+	reg_fdctrl &= ~(FLEXCAN_FDCTRL_FDRATE | FLEXCAN_FDCTRL_TDCEN |
+			FLEXCAN_FDCTRL_TDCOFF(0x1f) |
+			FLEXCAN_FDCTRL_MBDSR0(0x3) |
+			FLEXCAN_FDCTRL_MBDSR1(0x3));
+
+	if (priv->can.ctrlmode & CAN_CTRLMODE_FD) {
+		/* same for FPSEG1 (3 bit) and FPROPSEG (5 bit, no offset) */
+		prop_seg = dbt->prop_seg;
+		phase_seg1 = dbt->phase_seg1;
+		if (phase_seg1 > 0x8) {
+			prop_seg += phase_seg1 - 0x8;
+			phase_seg1 = 0x8;
+		}
+
+		reg_fdcbt = FLEXCAN_FDCBT_FPRESDIV(dbt->brp - 1) |
+			FLEXCAN_FDCBT_FRJW(dbt->sjw - 1) |
+			FLEXCAN_FDCBT_FPROPSEG(prop_seg) |
+			FLEXCAN_FDCBT_FPSEG1(phase_seg1 - 1) |
+			FLEXCAN_FDCBT_FPSEG2(dbt->phase_seg2 - 1);
+		netdev_dbg(dev, "writing fdcbt=0x%08x\n", reg_fdcbt);
+		flexcan_write(reg_fdcbt, &regs->fdcbt);
+
+		/* bit rate switching, 64 byte payload in both MB blocks */
+		reg_fdctrl |= FLEXCAN_FDCTRL_FDRATE |
+			FLEXCAN_FDCTRL_MBDSR0(FLEXCAN_FDCTRL_MBDSR_64) |
+			FLEXCAN_FDCTRL_MBDSR1(FLEXCAN_FDCTRL_MBDSR_64);
+
+		/* Transceiver delay compensation, measure at the data
+		 * phase sample point. TDC must be off in loop back mode.
+		 */
+		tdcoff = (1 + dbt->prop_seg + dbt->phase_seg1) * dbt->brp;
+		if (!(priv->can.ctrlmode & CAN_CTRLMODE_LOOPBACK) &&
+		    tdcoff <= 0x1f)
+			reg_fdctrl |= FLEXCAN_FDCTRL_TDCEN |
+				FLEXCAN_FDCTRL_TDCOFF(tdcoff);
+	}
+
+	netdev_dbg(dev, "writing fdctrl=0x%08x\n", reg_fdctrl);
+	flexcan_write(reg_fdctrl, &regs->fdctrl);
+}
+
 static void flexcan_set_bittiming(struct net_device *dev)
 {
 	const struct flexcan_priv *priv = netdev_priv(dev);
@@ -857,6 +1273,9 @@ static void flexcan_set_bittiming(struct net_device *dev)
 	netdev_dbg(dev, "writing ctrl=0x%08x\n", reg);
 	flexcan_write(reg, &regs->ctrl);
 
+	if (priv->devtype_data->quirks & FLEXCAN_QUIRK_SUPPORT_FD)
+		flexcan_set_bittiming_cbt(dev);
+
 	/* print chip status */
 	netdev_dbg(dev, "%s: mcr=0x%08x ctrl=0x%08x\n", __func__,
 		   flexcan_read(&regs->mcr), flexcan_read(&regs->ctrl));
@@ -889,7 +1308,7 @@ static int flexcan_chip_start(struct net_device *dev)
 	/* MCR
 	 *
 	 * enable freeze
-	 * enable fifo
+	 * enable fifo (not when offloading by timestamp)
 	 * halt now
 	 * only supervisor access
 	 * enable warning int
@@ -900,11 +1319,19 @@ static int flexcan_chip_start(struct net_device *dev)
 	 */
 	reg_mcr = flexcan_read(&regs->mcr);
 	reg_mcr &= ~FLEXCAN_MCR_MAXMB(0xff);
-	reg_mcr |= FLEXCAN_MCR_FRZ | FLEXCAN_MCR_FEN | FLEXCAN_MCR_HALT |
+	reg_mcr |= FLEXCAN_MCR_FRZ | FLEXCAN_MCR_HALT |
 		FLEXCAN_MCR_SUPV | FLEXCAN_MCR_WRN_EN |
 		FLEXCAN_MCR_IDAM_C | FLEXCAN_MCR_SRX_DIS |
 		FLEXCAN_MCR_WAK_MSK | FLEXCAN_MCR_SLF_WAK |
-		FLEXCAN_MCR_MAXMB(FLEXCAN_TX_BUF_ID);
+		FLEXCAN_MCR_MAXMB(priv->tx_mb_first + priv->tx_mb_num - 1);
+	if (flexcan_use_off_timestamp(priv))
+		reg_mcr &= ~FLEXCAN_MCR_FEN;
+	else
+		reg_mcr |= FLEXCAN_MCR_FEN;
+	if (priv->can.ctrlmode & CAN_CTRLMODE_FD)
+		reg_mcr |= FLEXCAN_MCR_FDEN;
+	else
+		reg_mcr &= ~FLEXCAN_MCR_FDEN;
 	netdev_dbg(dev, "%s: writing mcr=0x%08x", __func__, reg_mcr);
 	flexcan_write(reg_mcr, &regs->mcr);
 
@@ -941,19 +1368,47 @@ static int flexcan_chip_start(struct net_device *dev)
 	netdev_dbg(dev, "%s: writing ctrl=0x%08x", __func__, reg_ctrl);
 	flexcan_write(reg_ctrl, &regs->ctrl);
 
+	/* CTRL2
+	 *
+	 * store remote request frames instead of answering them
+	 * compare IDE and RTR against the (zero) masks, too, so that
+	 * every RX mailbox accepts both standard and extended frames
+	 * ISO CAN FD unless configured as non-ISO
+	 */
+	if (flexcan_use_off_timestamp(priv)) {
+		reg_ctrl2 = flexcan_read(&regs->ctrl2);
+		reg_ctrl2 |= FLEXCAN_CTRL2_RRS | FLEXCAN_CTRL2_EACEN;
+		if (priv->can.ctrlmode & CAN_CTRLMODE_FD_NON_ISO)
+			reg_ctrl2 &= ~FLEXCAN_CTRL2_ISOCANFDEN;
+		else
+			reg_ctrl2 |= FLEXCAN_CTRL2_ISOCANFDEN;
+		flexcan_write(reg_ctrl2, &regs->ctrl2);
+	}
+
 	/* clear and invalidate all mailboxes first */
-	for (i = FLEXCAN_TX_BUF_ID; i < ARRAY_SIZE(regs->mb); i++) {
+	for (i = flexcan_use_off_timestamp(priv) ? 0 : FLEXCAN_TX_BUF_ID;
+	     i < priv->mb_count; i++) {
 		flexcan_write(FLEXCAN_MB_CODE_RX_INACTIVE,
-			      &regs->mb[i].can_ctrl);
+			      &flexcan_get_mb(priv, i)->can_ctrl);
+	}
+
+	/* mark RX mailboxes as EMPTY */
+	if (flexcan_use_off_timestamp(priv)) {
+		for (i = priv->rx_mb_first; i <= priv->rx_mb_last; i++)
+			flexcan_write(FLEXCAN_MB_CODE_RX_EMPTY,
+				      &flexcan_get_mb(priv, i)->can_ctrl);
 	}
 
 	/* Errata ERR005829: mark first TX mailbox as INACTIVE */
 	flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
-		      &regs->mb[FLEXCAN_TX_BUF_RESERVED].can_ctrl);
+		      &flexcan_get_mb(priv, priv->tx_mb_reserved)->can_ctrl);
 
-	/* mark TX mailbox as INACTIVE */
-	flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
-		      &regs->mb[FLEXCAN_TX_BUF_ID].can_ctrl);
+	/* mark TX mailboxes as INACTIVE */
+	for (i = priv->tx_mb_first; i < priv->mb_count; i++)
+		flexcan_write(FLEXCAN_MB_CODE_TX_INACTIVE,
+			      &flexcan_get_mb(priv, i)->can_ctrl);
+	priv->tx_next = 0;
+	priv->tx_echo = 0;
 
 	/* acceptance mask/acceptance code (accept everything) */
 	flexcan_write(0x0, &regs->rxgmask);
@@ -1000,7 +1455,9 @@ static int flexcan_chip_start(struct net_device *dev)
 	/* enable interrupts atomically */
 	disable_irq(dev->irq);
 	flexcan_write(priv->reg_ctrl_default, &regs->ctrl);
-	flexcan_write(FLEXCAN_IFLAG_DEFAULT, &regs->imask1);
+	flexcan_write(priv->reg_imask1_default, &regs->imask1);
+	if (flexcan_use_off_timestamp(priv))
+		flexcan_write(priv->reg_imask2_default, &regs->imask2);
 	enable_irq(dev->irq);
 
 	/* print chip status */
@@ -1031,6 +1488,8 @@ static void flexcan_chip_stop(struct net_device *dev)
 
 	/* Disable all interrupts */
 	flexcan_write(0, &regs->imask1);
+	if (flexcan_use_off_timestamp(priv))
+		flexcan_write(0, &regs->imask2);
 	flexcan_write(priv->reg_ctrl_default & ~FLEXCAN_CTRL_ERR_ALL,
 		      &regs->ctrl);
 
@@ -1038,6 +1497,44 @@ static void flexcan_chip_stop(struct net_device *dev)
 	priv->can.state = CAN_STATE_STOPPED;
 }
 
+/* The mailbox size, and with it the layout, depends on CAN FD being
+ * enabled, so it is set up on every open.
+ */
+static void flexcan_setup_mb_layout(struct flexcan_priv *priv)
+{
+	if (priv->can.ctrlmode & CAN_CTRLMODE_FD)
+		priv->mb_size = sizeof(struct flexcan_mb) + CANFD_MAX_DLEN;
+	else
+		priv->mb_size = sizeof(struct flexcan_mb) + CAN_MAX_DLEN;
+	priv->mb_count = ARRAY_SIZE(priv->regs->mb) *
+		(sizeof(priv->regs->mb[0]) / priv->mb_size);
+
+	if (flexcan_use_off_timestamp(priv)) {
+		priv->tx_mb_reserved = FLEXCAN_TX_BUF_RESERVED_OFF_TIMESTAMP;
+		if (priv->can.ctrlmode & CAN_CTRLMODE_FD)
+			priv->tx_mb_num = FLEXCAN_TX_MB_FD_NUM;
+		else
+			priv->tx_mb_num = FLEXCAN_TX_MB_OFF_TIMESTAMP_NUM;
+		priv->tx_mb_first = priv->mb_count - priv->tx_mb_num;
+		priv->rx_mb_first = FLEXCAN_RX_MB_OFF_TIMESTAMP_FIRST;
+		priv->rx_mb_last = priv->tx_mb_first - 1;
+		priv->rx_mask = GENMASK_ULL(priv->rx_mb_last,
+					    priv->rx_mb_first);
+		priv->tx_mask = GENMASK_ULL(priv->mb_count - 1,
+					    priv->tx_mb_first);
+		priv->reg_imask1_default =
+			lower_32_bits(priv->rx_mask | priv->tx_mask);
+		priv->reg_imask2_default =
+			upper_32_bits(priv->rx_mask | priv->tx_mask);
+	} else {
+		priv->tx_mb_reserved = FLEXCAN_TX_BUF_RESERVED;
+		priv->tx_mb_first = FLEXCAN_TX_BUF_ID;
+		priv->tx_mb_num = 1;
+		priv->tx_mask = FLEXCAN_IFLAG_MB(FLEXCAN_TX_BUF_ID);
+		priv->reg_imask1_default = FLEXCAN_IFLAG_DEFAULT;
+	}
+}
+
 static int flexcan_open(struct net_device *dev)
 {
 	struct flexcan_priv *priv = netdev_priv(dev);
@@ -1059,6 +1556,8 @@ static int flexcan_open(struct net_device *dev)
 	if (err)
 		goto out_close;
 
+	flexcan_setup_mb_layout(priv);
+
 	/* start chip and queuing */
 	err = flexcan_chip_start(dev);
 	if (err)
@@ -1090,6 +1589,7 @@ static int flexcan_close(struct net_device *dev)
 	netif_stop_queue(dev);
 	napi_disable(&priv->napi);
 	flexcan_chip_stop(dev);
+	skb_queue_purge(&priv->rx_queue);
 
 	free_irq(dev->irq, dev);
 	clk_disable_unprepare(priv->clk_per);
@@ -1241,6 +1741,8 @@ static int flexcan_of_parse_stop_mode(struct platform_device *pdev)
 }
 
 static const struct of_device_id flexcan_of_match[] = {
+	{ .compatible = "fsl,imx8qm-flexcan",
+	  .data = &fsl_imx8qm_devtype_data, },
 	{ .compatible = "fsl,imx6q-flexcan", .data = &fsl_imx6q_devtype_data, },
 	{ .compatible = "fsl,imx28-flexcan", .data = &fsl_imx28_devtype_data, },
 	{ .compatible = "fsl,p1010-flexcan", .data = &fsl_p1010_devtype_data, },
@@ -1332,7 +1834,8 @@ static int flexcan_probe(struct platform_device *pdev)
 		return -ENODEV;
 	}
 
-	dev = alloc_candev(sizeof(struct flexcan_priv), 1);
+	dev = alloc_candev(sizeof(struct flexcan_priv),
+			   FLEXCAN_TX_MB_OFF_TIMESTAMP_NUM);
 	if (!dev)
 		return -ENOMEM;
 
@@ -1348,6 +1851,13 @@ static int flexcan_probe(struct platform_device *pdev)
 	priv->can.ctrlmode_supported = CAN_CTRLMODE_LOOPBACK |
 		CAN_CTRLMODE_LISTENONLY	| CAN_CTRLMODE_3_SAMPLES |
 		CAN_CTRLMODE_BERR_REPORTING;
+	if (devtype_data->quirks & FLEXCAN_QUIRK_SUPPORT_FD) {
+		priv->can.ctrlmode_supported |= CAN_CTRLMODE_FD |
+			CAN_CTRLMODE_FD_NON_ISO;
+		priv->can.bittiming_const = &flexcan_fd_bittiming_const;
+		priv->can.data_bittiming_const =
+			&flexcan_fd_data_bittiming_const;
+	}
 	priv->regs = regs;
 	priv->clk_ipg = clk_ipg;
 	priv->clk_per = clk_per;
@@ -1356,7 +1866,11 @@ static int flexcan_probe(struct platform_device *pdev)
 	priv->reg_xceiver = reg_xceiver;
 	flexcan_gpio_init(pdev->dev.of_node,dev);
 
-	netif_napi_add(dev, &priv->napi, flexcan_poll, FLEXCAN_NAPI_WEIGHT);
+	skb_queue_head_init(&priv->rx_queue);
+
+	netif_napi_add(dev, &priv->napi, flexcan_poll,
+		       flexcan_use_off_timestamp(priv) ?
+		       FLEXCAN_NAPI_WEIGHT_OFF_TIMESTAMP : FLEXCAN_NAPI_WEIGHT);
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
@@ -323,6 +323,9 @@ struct bufdesc_ex {
 #define IDLE_SLOPE(X)		(((X) == 1) ?				\
 				(IDLE_SLOPE_1 & IDLE_SLOPE_MASK) :	\
 				(IDLE_SLOPE_2 & IDLE_SLOPE_MASK))
+#define IDLE_SLOPE_FRAC		512 /* BW fraction = IS / (IS + 512) */
+#define IDLE_SLOPE_STEP		128 /* IS above this is a multiple of it */
+#define IDLE_SLOPE_MAX		1536 /* BW fraction: 0.75 */
 #define RCMR_MATCHEN		(0x1 << 16)
 #define RCMR_CMP_CFG(v, n)	(((v) & 0x7) <<  (n << 2))
 #define RCMR_CMP_1		(RCMR_CMP_CFG(0, 0) | RCMR_CMP_CFG(1, 1) | \
@@ -330,6 +333,11 @@ struct bufdesc_ex {
 #define RCMR_CMP_2		(RCMR_CMP_CFG(4, 0) | RCMR_CMP_CFG(5, 1) | \
 				RCMR_CMP_CFG(6, 2) | RCMR_CMP_CFG(7, 3))
 #define RCMR_CMP(X)		(((X) == 1) ? RCMR_CMP_1 : RCMR_CMP_2)
+#define RCMR_CMP_NUM		4 /* VLAN priorities compared per ring */
+#define FEC_ENET_VLAN_PRIOS	8
+
+/* ethtool n-tuple rules, each steers one VLAN priority to a ring */
+#define FEC_ENET_RX_FLOWS	FEC_ENET_VLAN_PRIOS
 #define FEC_TX_BD_FTYPE(X)	(((X) & 0xf) << 20)
 
 /* The number of Tx and Rx buffers.  These are allocated from the page
@@ -347,6 +355,7 @@ struct bufdesc_ex {
 #define FEC_ENET_TX_FRPPG	(PAGE_SIZE / FEC_ENET_TX_FRSIZE)
 #define TX_RING_SIZE		512	/* Must be power of two */
 #define TX_RING_MOD_MASK	511	/*   for this to work */
+#define RX_RING_MIN_SIZE	64
 
 #define BD_ENET_RX_INT		0x00800000
 #define BD_ENET_RX_PTP		((ushort)0x0400)
@@ -375,6 +384,10 @@ struct bufdesc_ex {
 #define FEC_ENET_WAKEUP	((uint)0x00020000)	/* Wakeup request */
 #define FEC_ENET_TXF	(FEC_ENET_TXF_0 | FEC_ENET_TXF_1 | FEC_ENET_TXF_2)
 #define FEC_ENET_RXF	(FEC_ENET_RXF_0 | FEC_ENET_RXF_1 | FEC_ENET_RXF_2)
+#define FEC_ENET_TXF_Q(X)	(((X) == 1) ? FEC_ENET_TXF_1 : \
+				(((X) == 2) ? FEC_ENET_TXF_2 : FEC_ENET_TXF_0))
+#define FEC_ENET_RXF_Q(X)	(((X) == 1) ? FEC_ENET_RXF_1 : \
+				(((X) == 2) ? FEC_ENET_RXF_2 : FEC_ENET_RXF_0))
 #define FEC_ENET_TS_AVAIL       ((uint)0x00010000)
 #define FEC_ENET_TS_TIMER       ((uint)0x00008000)
 
@@ -392,6 +405,15 @@ struct bufdesc_ex {
 #define FEC_ITR_ICFT_DEFAULT	200  /* Set 200 frame count threshold */
 #define FEC_ITR_ICTT_DEFAULT	1000 /* Set 1000us timer threshold */
 
+/* Adaptive interrupt coalescing profiles, picked from the traffic seen
+ * by NAPI over the last sampling interval.
+ */
+enum fec_itr_profile {
+	FEC_ITR_LOWEST_LATENCY,
+	FEC_ITR_LOW_LATENCY,
+	FEC_ITR_BULK_LATENCY,
+};
+
 #define FEC_VLAN_TAG_LEN	0x04
 #define FEC_ETHTYPE_LEN		0x02
 
@@ -458,6 +480,11 @@ struct bufdesc_ex {
  * to wait mode.
  */
 #define FEC_QUIRK_BUG_WAITMODE		(1 << 15)
+/* Controller accepts frames longer than one receive buffer, spreading
+ * them over several descriptors, and has the cut-through TX FIFO that
+ * sending them requires.
+ */
+#define FEC_QUIRK_JUMBO_FRAME		(1 << 16)
 
 /* PHY fixup flag define */
 #define FEC_QUIRK_AR8031_FIXUP		(1 << 0)
@@ -481,10 +508,20 @@ struct fec_enet_stop_mode {
 	u8 req_bit;
 };
 
+struct fec_enet_tx_q_stats {
+	unsigned long tx_packets;
+	unsigned long tx_bytes;
+	unsigned long tx_ring_full;
+};
+
 struct fec_enet_priv_tx_q {
 	struct bufdesc_prop bd;
+	struct fec_enet_tx_q_stats stats;
 	unsigned char *tx_bounce[TX_RING_SIZE];
+	dma_addr_t tx_bounce_dma[TX_RING_SIZE];
 	struct  sk_buff *tx_skbuff[TX_RING_SIZE];
+	/* RX page slices sent back out by XDP_TX */
+	struct page *tx_page[TX_RING_SIZE];
 
 	unsigned short tx_stop_threshold;
 	unsigned short tx_wake_threshold;
@@ -494,9 +531,52 @@ struct fec_enet_priv_tx_q {
 	dma_addr_t tso_hdrs_dma;
 };
 
+/* Each RX descriptor owns one page, mapped once for its whole lifetime,
+ * and receives into one FEC_ENET_RX_FRSIZE slice of it at a time.  Filled
+ * slices are handed to the stack with build_skb() and the descriptor moves
+ * on to the next slice, so the page only has to be replaced if the stack
+ * still holds the slice we want to reuse.
+ */
+struct fec_enet_rx_buffer {
+	struct page *page;
+	dma_addr_t dma;
+	unsigned int page_offset;
+};
+
+struct fec_enet_rx_q_stats {
+	unsigned long rx_packets;
+	unsigned long rx_bytes;
+	unsigned long rx_dropped;
+	unsigned long rx_copybreak;
+	unsigned long napi_exhausted;
+	unsigned long xdp_tx_packets;
+	unsigned long xdp_tx_bytes;
+	unsigned long xdp_tx_dropped;
+};
+
 struct fec_enet_priv_rx_q {
 	struct bufdesc_prop bd;
-	struct  sk_buff *rx_skbuff[RX_RING_SIZE];
+	struct fec_enet_rx_buffer rx_buf[RX_RING_SIZE];
+	struct fec_enet_rx_q_stats stats;
+
+	/* Each RX ring has its own NAPI context, which also reclaims the TX
+	 * rings sharing its index modulo num_rx_queues.  napi_events are the
+	 * interrupt events it is scheduled on and masks while polling.
+	 */
+	struct napi_struct napi;
+	u32 napi_events;
+
+	/* Jumbo frame being assembled from several descriptors, rx_discard
+	 * is set when its remaining buffers are to be dropped.
+	 */
+	struct sk_buff *rx_skb;
+	bool rx_discard;
+};
+
+struct fec_enet_rx_flow {
+	bool valid;
+	u8 vlan_prio;
+	u8 queue;
 };
 
 /* The FEC buffer descriptors track the ring buffers.  The rx_bd_base and
@@ -531,8 +611,13 @@ struct fec_enet_private {
 	unsigned int total_tx_ring_size;
 	unsigned int total_rx_ring_size;
 
-	unsigned long work_tx;
-	unsigned long work_rx;
+	/* CBS idleslope in kbit/s for the AVB class queues, 0 if unset */
+	u32 cbs_idleslope[FEC_ENET_MAX_TX_QS];
+
+	/* RX classification: n-tuple rules and the resulting RCMR values */
+	struct fec_enet_rx_flow rx_flows[FEC_ENET_RX_FLOWS];
+	u32 rcmr[FEC_ENET_MAX_RX_QS];
+
 	unsigned long work_ts;
 	unsigned long work_mdio;
 
@@ -544,6 +629,8 @@ struct fec_enet_private {
 	struct	mii_bus *mii_bus;
 	int	mii_timeout;
 	int	mii_bus_share;
+	/* the other fec using our mii_bus, see fec_enet_mii_init() */
+	struct device *mii_bus_user;
 	bool	active_in_suspend;
 	uint	phy_speed;
 	phy_interface_t	phy_interface;
@@ -563,10 +650,12 @@ struct fec_enet_private {
 	int	phy_reset_gpio;
 	u32	fixups;
 
-	struct	napi_struct napi;
+	/* Serialises the per-queue NAPI masking of FEC_IMASK */
+	spinlock_t imask_lock;
 	int	csum_flags;
 
 	struct work_struct tx_timeout_work;
+	unsigned long tx_timeouts;
 
 	struct ptp_clock *ptp_clock;
 	struct ptp_clock_info ptp_caps;
@@ -593,8 +682,21 @@ struct fec_enet_private {
 	unsigned int tx_time_itr;
 	unsigned int itr_clk_rate;
 
+	/* adaptive interrupt coalescing */
+	bool rx_adaptive_itr;
+	bool tx_adaptive_itr;
+	enum fec_itr_profile rx_itr_profile;
+	enum fec_itr_profile tx_itr_profile;
+	unsigned long itr_sample_time;
+	unsigned long itr_rx_packets;
+	unsigned long itr_rx_bytes;
+	unsigned long itr_tx_packets;
+	unsigned long itr_tx_bytes;
+
 	u32 rx_copybreak;
 
+	struct bpf_prog *xdp_prog;
+
 	/* ptp clock period in ns*/
 	unsigned int ptp_inc;
 
@@ -42,6 +42,8 @@
 #include <linux/tcp.h>
 #include <linux/udp.h>
 #include <linux/icmp.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
 #include <linux/bitops.h>
@@ -72,12 +74,17 @@
 
 #include "fec.h"
 
+#define CREATE_TRACE_POINTS
+#include "fec_trace.h"
+
 static void set_multicast_list(struct net_device *ndev);
 static void fec_enet_itr_coal_init(struct net_device *ndev);
+static void fec_enet_itr_coal_set(struct net_device *ndev);
+static int fec_enet_open(struct net_device *ndev);
+static int fec_enet_close(struct net_device *ndev);
 
 #define DRIVER_NAME	"fec"
 
-#define FEC_ENET_GET_QUQUE(_x) ((_x == 0) ? 1 : ((_x == 1) ? 2 : 0))
 static const u16 fec_enet_vlan_pri_to_queue[8] = {1, 1, 1, 1, 2, 2, 2, 2};
 
 /* Pause frame feild and FIFO threshold */
@@ -119,7 +126,8 @@ static struct platform_device_id fec_devtype[] = {
 				FEC_QUIRK_HAS_BUFDESC_EX | FEC_QUIRK_HAS_CSUM |
 				FEC_QUIRK_HAS_VLAN | FEC_QUIRK_HAS_AVB |
 				FEC_QUIRK_ERR007885 | FEC_QUIRK_BUG_CAPTURE |
-				FEC_QUIRK_HAS_RACC | FEC_QUIRK_HAS_COALESCE,
+				FEC_QUIRK_HAS_RACC | FEC_QUIRK_HAS_COALESCE |
+				FEC_QUIRK_JUMBO_FRAME,
 	}, {
 		.name = "imx6ul-fec",
 		.driver_data = FEC_QUIRK_ENET_MAC | FEC_QUIRK_HAS_GBIT |
@@ -132,7 +140,8 @@ static struct platform_device_id fec_devtype[] = {
 				FEC_QUIRK_HAS_BUFDESC_EX | FEC_QUIRK_HAS_CSUM |
 				FEC_QUIRK_HAS_VLAN | FEC_QUIRK_HAS_AVB |
 				FEC_QUIRK_ERR007885 | FEC_QUIRK_BUG_CAPTURE |
-				FEC_QUIRK_HAS_RACC | FEC_QUIRK_HAS_COALESCE,
+				FEC_QUIRK_HAS_RACC | FEC_QUIRK_HAS_COALESCE |
+				FEC_QUIRK_JUMBO_FRAME,
 	}, {
 		/* sentinel */
 	}
@@ -193,6 +202,24 @@ MODULE_PARM_DESC(macaddr, "FEC Ethernet MAC address");
 #define PKT_MINBUF_SIZE		64
 #define PKT_MAXBLR_SIZE		1536
 
+/* Longest frame taken on FEC_QUIRK_JUMBO_FRAME parts, which receive it in
+ * PKT_MAXBLR_SIZE pieces.  Longer than the TX FIFO, so such frames are
+ * sent cut-through rather than store and forward.
+ */
+#define FEC_JUMBO_MAX_FL	9600
+#define FEC_JUMBO_MAX_MTU	(FEC_JUMBO_MAX_FL - ETH_HLEN - VLAN_HLEN - \
+				 ETH_FCS_LEN)
+#define FEC_TX_WMRK_STRFWD	(1 << 8)
+#define FEC_TX_WMRK_CUT_THROUGH	0xf
+
+/* Receive buffers start this far into their FEC_ENET_RX_FRSIZE slice so
+ * that the skb built around them has some headroom, and the tail of the
+ * slice is left for the skb_shared_info.
+ */
+#define FEC_ENET_RX_HEADROOM	128
+#define FEC_ENET_RX_USED	(FEC_ENET_RX_HEADROOM + PKT_MAXBLR_SIZE + \
+				 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
 /* FEC receive acceleration */
 #define FEC_RACC_IPDIS		(1 << 1)
 #define FEC_RACC_PRODIS		(1 << 2)
@@ -207,9 +234,9 @@ MODULE_PARM_DESC(macaddr, "FEC Ethernet MAC address");
 #if defined(CONFIG_M523x) || defined(CONFIG_M527x) || defined(CONFIG_M528x) || \
     defined(CONFIG_M520x) || defined(CONFIG_M532x) || defined(CONFIG_ARM) || \
     defined(CONFIG_ARM64)
-#define	OPT_FRAME_SIZE	(PKT_MAXBUF_SIZE << 16)
+#define	OPT_FRAME_SIZE(fl)	((fl) << 16)
 #else
-#define	OPT_FRAME_SIZE	0
+#define	OPT_FRAME_SIZE(fl)	0
 #endif
 
 /* FEC MII MMFR bits definition */
@@ -297,6 +324,48 @@ static void swap_buffer2(void *dst_buf, void *src_buf, int len)
 		*dst = swab32p(src);
 }
 
+static bool fec_enet_tx_needs_bounce(struct fec_enet_private *fep,
+				     const void *data)
+{
+	return ((unsigned long)data) & fep->tx_align ||
+		fep->quirks & FEC_QUIRK_SWAP_FRAME;
+}
+
+/* Copy a buffer the controller can't send from into the bounce buffer of
+ * the descriptor, swapping it on the way on FEC_QUIRK_SWAP_FRAME parts so
+ * the frame is only touched once.  The bounce buffers stay mapped for the
+ * lifetime of the ring, so only the written range has to be synced.
+ */
+static dma_addr_t fec_enet_tx_bounce(struct fec_enet_private *fep,
+				     struct fec_enet_priv_tx_q *txq,
+				     unsigned int index, void *data,
+				     unsigned int len)
+{
+	if (fep->quirks & FEC_QUIRK_SWAP_FRAME)
+		swap_buffer2(txq->tx_bounce[index], data, len);
+	else
+		memcpy(txq->tx_bounce[index], data, len);
+
+	dma_sync_single_for_device(&fep->pdev->dev, txq->tx_bounce_dma[index],
+				   ALIGN(len, 4), DMA_TO_DEVICE);
+
+	return txq->tx_bounce_dma[index];
+}
+
+static void fec_enet_tx_unmap(struct fec_enet_private *fep,
+			      struct fec_enet_priv_tx_q *txq,
+			      struct bufdesc *bdp)
+{
+	dma_addr_t addr = fec32_to_cpu(bdp->cbd_bufaddr);
+	unsigned int index = fec_enet_get_bd_index(bdp, &txq->bd);
+
+	if (IS_TSO_HEADER(txq, addr) || addr == txq->tx_bounce_dma[index])
+		return;
+
+	dma_unmap_single(&fep->pdev->dev, addr, fec16_to_cpu(bdp->cbd_datlen),
+			 DMA_TO_DEVICE);
+}
+
 static void fec_dump(struct net_device *ndev)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
@@ -397,21 +466,17 @@ fec_enet_txq_submit_frag_skb(struct fec_enet_priv_tx_q *txq,
 		bufaddr = page_address(this_frag->page.p) + this_frag->page_offset;
 
 		index = fec_enet_get_bd_index(bdp, &txq->bd);
-		if (((unsigned long) bufaddr) & fep->tx_align ||
-			fep->quirks & FEC_QUIRK_SWAP_FRAME) {
-			memcpy(txq->tx_bounce[index], bufaddr, frag_len);
-			bufaddr = txq->tx_bounce[index];
-
-			if (fep->quirks & FEC_QUIRK_SWAP_FRAME)
-				swap_buffer(bufaddr, frag_len);
-		}
-
-		addr = dma_map_single(&fep->pdev->dev, bufaddr, frag_len,
-				      DMA_TO_DEVICE);
-		if (dma_mapping_error(&fep->pdev->dev, addr)) {
-			if (net_ratelimit())
-				netdev_err(ndev, "Tx DMA memory map failed\n");
-			goto dma_mapping_error;
+		if (fec_enet_tx_needs_bounce(fep, bufaddr)) {
+			addr = fec_enet_tx_bounce(fep, txq, index, bufaddr,
+						  frag_len);
+		} else {
+			addr = dma_map_single(&fep->pdev->dev, bufaddr,
+					      frag_len, DMA_TO_DEVICE);
+			if (dma_mapping_error(&fep->pdev->dev, addr)) {
+				if (net_ratelimit())
+					netdev_err(ndev, "Tx DMA memory map failed\n");
+				goto dma_mapping_error;
+			}
 		}
 
 		bdp->cbd_bufaddr = cpu_to_fec32(addr);
@@ -428,8 +493,7 @@ dma_mapping_error:
 	bdp = txq->bd.cur;
 	for (i = 0; i < frag; i++) {
 		bdp = fec_enet_get_nextdesc(bdp, &txq->bd);
-		dma_unmap_single(&fep->pdev->dev, fec32_to_cpu(bdp->cbd_bufaddr),
-				 fec16_to_cpu(bdp->cbd_datlen), DMA_TO_DEVICE);
+		fec_enet_tx_unmap(fep, txq, bdp);
 	}
 	return ERR_PTR(-ENOMEM);
 }
@@ -473,29 +537,28 @@ static int fec_enet_txq_submit_skb(struct fec_enet_priv_tx_q *txq,
 	buflen = skb_headlen(skb);
 
 	index = fec_enet_get_bd_index(bdp, &txq->bd);
-	if (((unsigned long) bufaddr) & fep->tx_align ||
-		fep->quirks & FEC_QUIRK_SWAP_FRAME) {
-		memcpy(txq->tx_bounce[index], skb->data, buflen);
-		bufaddr = txq->tx_bounce[index];
-
-		if (fep->quirks & FEC_QUIRK_SWAP_FRAME)
-			swap_buffer(bufaddr, buflen);
-	}
-
-	/* Push the data cache so the CPM does not get stale memory data. */
-	addr = dma_map_single(&fep->pdev->dev, bufaddr, buflen, DMA_TO_DEVICE);
-	if (dma_mapping_error(&fep->pdev->dev, addr)) {
-		dev_kfree_skb_any(skb);
-		if (net_ratelimit())
-			netdev_err(ndev, "Tx DMA memory map failed\n");
-		return NETDEV_TX_OK;
+	if (fec_enet_tx_needs_bounce(fep, bufaddr)) {
+		addr = fec_enet_tx_bounce(fep, txq, index, bufaddr, buflen);
+	} else {
+		/* Push the data cache so the CPM does not get stale memory
+		 * data.
+		 */
+		addr = dma_map_single(&fep->pdev->dev, bufaddr, buflen,
+				      DMA_TO_DEVICE);
+		if (dma_mapping_error(&fep->pdev->dev, addr)) {
+			dev_kfree_skb_any(skb);
+			if (net_ratelimit())
+				netdev_err(ndev, "Tx DMA memory map failed\n");
+			return NETDEV_TX_OK;
+		}
 	}
 
 	if (nr_frags) {
 		last_bdp = fec_enet_txq_submit_frag_skb(txq, skb, ndev);
 		if (IS_ERR(last_bdp)) {
-			dma_unmap_single(&fep->pdev->dev, addr,
-					 buflen, DMA_TO_DEVICE);
+			if (addr != txq->tx_bounce_dma[index])
+				dma_unmap_single(&fep->pdev->dev, addr,
+						 buflen, DMA_TO_DEVICE);
 			dev_kfree_skb_any(skb);
 			return NETDEV_TX_OK;
 		}
@@ -549,15 +612,15 @@ static int fec_enet_txq_submit_skb(struct fec_enet_priv_tx_q *txq,
 
 	skb_tx_timestamp(skb);
 
+	/* Account the skb to BQL before fec_enet_tx_queue() can see it */
+	netdev_tx_sent_queue(netdev_get_tx_queue(ndev, txq->bd.qid), skb->len);
+
 	/* Make sure the update to bdp and tx_skbuff are performed before
 	 * txq->bd.cur.
 	 */
 	wmb();
 	txq->bd.cur = bdp;
 
-	/* Trigger transmission start */
-	writel(0, txq->bd.reg_desc_active);
-
 	return 0;
 }
 
@@ -578,21 +641,17 @@ fec_enet_txq_put_data_tso(struct fec_enet_priv_tx_q *txq, struct sk_buff *skb,
 
 	status |= (BD_ENET_TX_TC | BD_ENET_TX_READY);
 
-	if (((unsigned long) data) & fep->tx_align ||
-		fep->quirks & FEC_QUIRK_SWAP_FRAME) {
-		memcpy(txq->tx_bounce[index], data, size);
-		data = txq->tx_bounce[index];
-
-		if (fep->quirks & FEC_QUIRK_SWAP_FRAME)
-			swap_buffer(data, size);
-	}
-
-	addr = dma_map_single(&fep->pdev->dev, data, size, DMA_TO_DEVICE);
-	if (dma_mapping_error(&fep->pdev->dev, addr)) {
-		dev_kfree_skb_any(skb);
-		if (net_ratelimit())
-			netdev_err(ndev, "Tx DMA memory map failed\n");
-		return NETDEV_TX_BUSY;
+	if (fec_enet_tx_needs_bounce(fep, data)) {
+		addr = fec_enet_tx_bounce(fep, txq, index, data, size);
+	} else {
+		addr = dma_map_single(&fep->pdev->dev, data, size,
+				      DMA_TO_DEVICE);
+		if (dma_mapping_error(&fep->pdev->dev, addr)) {
+			dev_kfree_skb_any(skb);
+			if (net_ratelimit())
+				netdev_err(ndev, "Tx DMA memory map failed\n");
+			return NETDEV_TX_BUSY;
+		}
 	}
 
 	bdp->cbd_datlen = cpu_to_fec16(size);
@@ -640,23 +699,9 @@ fec_enet_txq_put_hdr_tso(struct fec_enet_priv_tx_q *txq,
 
 	bufaddr = txq->tso_hdrs + index * TSO_HEADER_SIZE;
 	dmabuf = txq->tso_hdrs_dma + index * TSO_HEADER_SIZE;
-	if (((unsigned long)bufaddr) & fep->tx_align ||
-		fep->quirks & FEC_QUIRK_SWAP_FRAME) {
-		memcpy(txq->tx_bounce[index], skb->data, hdr_len);
-		bufaddr = txq->tx_bounce[index];
-
-		if (fep->quirks & FEC_QUIRK_SWAP_FRAME)
-			swap_buffer(bufaddr, hdr_len);
-
-		dmabuf = dma_map_single(&fep->pdev->dev, bufaddr,
-					hdr_len, DMA_TO_DEVICE);
-		if (dma_mapping_error(&fep->pdev->dev, dmabuf)) {
-			dev_kfree_skb_any(skb);
-			if (net_ratelimit())
-				netdev_err(ndev, "Tx DMA memory map failed\n");
-			return NETDEV_TX_BUSY;
-		}
-	}
+	if (fec_enet_tx_needs_bounce(fep, bufaddr))
+		dmabuf = fec_enet_tx_bounce(fep, txq, index, skb->data,
+					    hdr_len);
 
 	bdp->cbd_bufaddr = cpu_to_fec32(dmabuf);
 	bdp->cbd_datlen = cpu_to_fec16(hdr_len);
@@ -743,27 +788,38 @@ static int fec_enet_txq_submit_tso(struct fec_enet_priv_tx_q *txq,
 	txq->tx_skbuff[index] = skb;
 
 	skb_tx_timestamp(skb);
+	netdev_tx_sent_queue(netdev_get_tx_queue(ndev, txq->bd.qid), skb->len);
+
+	/* Make sure the update to bdp and tx_skbuff are performed before
+	 * txq->bd.cur.
+	 */
+	wmb();
 	txq->bd.cur = bdp;
 
-	/* Trigger transmission start */
+	return 0;
+
+err_release:
+	/* TODO: Release all used data descriptors for TSO */
+	return ret;
+}
+
+/* Trigger transmission start */
+static void fec_enet_txq_kick(struct fec_enet_private *fep,
+			      struct fec_enet_priv_tx_q *txq)
+{
 	if (!(fep->quirks & FEC_QUIRK_ERR007885) ||
 	    !readl(txq->bd.reg_desc_active) ||
 	    !readl(txq->bd.reg_desc_active) ||
 	    !readl(txq->bd.reg_desc_active) ||
 	    !readl(txq->bd.reg_desc_active))
 		writel(0, txq->bd.reg_desc_active);
-
-	return 0;
-
-err_release:
-	/* TODO: Release all used data descriptors for TSO */
-	return ret;
 }
 
 static netdev_tx_t
 fec_enet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
+	bool xmit_more = skb->xmit_more;
 	int entries_free;
 	unsigned short queue;
 	struct fec_enet_priv_tx_q *txq;
@@ -774,6 +830,9 @@ fec_enet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 	txq = fep->tx_queue[queue];
 	nq = netdev_get_tx_queue(ndev, queue);
 
+	trace_fec_tx_submit(ndev, queue,
+			    fec_enet_get_bd_index(txq->bd.cur, &txq->bd), skb);
+
 	if (skb_is_gso(skb))
 		ret = fec_enet_txq_submit_tso(txq, skb, ndev);
 	else
@@ -782,8 +841,16 @@ fec_enet_start_xmit(struct sk_buff *skb, struct net_device *ndev)
 		return ret;
 
 	entries_free = fec_enet_get_free_txdesc_num(txq);
-	if (entries_free <= txq->tx_stop_threshold)
+	if (entries_free <= txq->tx_stop_threshold) {
+		txq->stats.tx_ring_full++;
 		netif_tx_stop_queue(nq);
+	}
+
+	/* The stack has more frames for this queue, ring the doorbell once
+	 * for the whole burst.  The skb may already be gone at this point.
+	 */
+	if (!xmit_more || netif_xmit_stopped(nq))
+		fec_enet_txq_kick(fep, txq);
 
 	return NETDEV_TX_OK;
 }
@@ -819,6 +886,13 @@ static void fec_enet_bd_init(struct net_device *dev)
 		bdp->cbd_sc |= cpu_to_fec16(BD_SC_WRAP);
 
 		rxq->bd.cur = rxq->bd.base;
+
+		/* Drop any frame the ring was in the middle of */
+		if (rxq->rx_skb) {
+			dev_kfree_skb_any(rxq->rx_skb);
+			rxq->rx_skb = NULL;
+		}
+		rxq->rx_discard = false;
 	}
 
 	for (q = 0; q < fep->num_tx_queues; q++) {
@@ -834,6 +908,10 @@ static void fec_enet_bd_init(struct net_device *dev)
 				dev_kfree_skb_any(txq->tx_skbuff[i]);
 				txq->tx_skbuff[i] = NULL;
 			}
+			if (txq->tx_page[i]) {
+				put_page(txq->tx_page[i]);
+				txq->tx_page[i] = NULL;
+			}
 			bdp->cbd_bufaddr = cpu_to_fec32(0);
 			bdp = fec_enet_get_nextdesc(bdp, &txq->bd);
 		}
@@ -842,6 +920,8 @@ static void fec_enet_bd_init(struct net_device *dev)
 		bdp = fec_enet_get_prevdesc(bdp, &txq->bd);
 		bdp->cbd_sc |= cpu_to_fec16(BD_SC_WRAP);
 		txq->dirty_tx = bdp;
+
+		netdev_tx_reset_queue(netdev_get_tx_queue(dev, q));
 	}
 }
 
@@ -854,6 +934,42 @@ static void fec_enet_active_rxring(struct net_device *ndev)
 		writel(0, fep->rx_queue[i]->bd.reg_desc_active);
 }
 
+/* Translate a CBS idleslope (kbit/s) into the DMA_CFG IDLE_SLOPE field for
+ * the given link speed.  The controller reserves IS / (IS + 512) of the
+ * link for the class and only accepts powers of two up to 128 and multiples
+ * of 128 above that, so round up to keep at least the requested bandwidth.
+ */
+static int fec_enet_calc_idle_slope(u32 idleslope, int speed)
+{
+	u64 linkrate = (u64)speed * 1000;
+	u64 is;
+
+	if (!idleslope || idleslope >= linkrate)
+		return -EINVAL;
+
+	is = DIV_ROUND_UP_ULL((u64)idleslope * IDLE_SLOPE_FRAC,
+			      linkrate - idleslope);
+	if (is <= IDLE_SLOPE_STEP)
+		is = roundup_pow_of_two(is);
+	else
+		is = roundup(is, IDLE_SLOPE_STEP);
+
+	return is > IDLE_SLOPE_MAX ? -EINVAL : is;
+}
+
+static u32 fec_enet_idle_slope(struct fec_enet_private *fep, int queue)
+{
+	int is;
+
+	if (!fep->cbs_idleslope[queue] || !fep->speed)
+		return IDLE_SLOPE(queue);
+
+	/* The link may have come up slower than when the shaper was set */
+	is = fec_enet_calc_idle_slope(fep->cbs_idleslope[queue], fep->speed);
+
+	return is < 0 ? IDLE_SLOPE_MAX : is;
+}
+
 static void fec_enet_enable_ring(struct net_device *ndev)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
@@ -868,8 +984,7 @@ static void fec_enet_enable_ring(struct net_device *ndev)
 
 		/* enable DMA1/2 */
 		if (i)
-			writel(RCMR_MATCHEN | RCMR_CMP(i),
-			       fep->hwp + FEC_RCMR(i));
+			writel(fep->rcmr[i], fep->hwp + FEC_RCMR(i));
 	}
 
 	for (i = 0; i < fep->num_tx_queues; i++) {
@@ -878,7 +993,7 @@ static void fec_enet_enable_ring(struct net_device *ndev)
 
 		/* enable DMA1/2 */
 		if (i)
-			writel(DMA_CLASS_EN | IDLE_SLOPE(i),
+			writel(DMA_CLASS_EN | fec_enet_idle_slope(fep, i),
 			       fep->hwp + FEC_DMA_CFG(i));
 	}
 }
@@ -897,10 +1012,21 @@ static void fec_enet_reset_skb(struct net_device *ndev)
 				dev_kfree_skb_any(txq->tx_skbuff[j]);
 				txq->tx_skbuff[j] = NULL;
 			}
+			if (txq->tx_page[j]) {
+				put_page(txq->tx_page[j]);
+				txq->tx_page[j] = NULL;
+			}
 		}
 	}
 }
 
+/* Longest frame, FCS and a VLAN tag included, the MTU calls for */
+static u32 fec_enet_max_fl(struct net_device *ndev)
+{
+	return max_t(u32, PKT_MAXBUF_SIZE,
+		     ndev->mtu + ETH_HLEN + VLAN_HLEN + ETH_FCS_LEN);
+}
+
 /*
  * This function is called to start or restart the FEC during a link
  * change, transmit timeout, or to reconfigure the FEC.  The network
@@ -912,7 +1038,8 @@ fec_restart(struct net_device *ndev)
 	struct fec_enet_private *fep = netdev_priv(ndev);
 	u32 val;
 	u32 temp_mac[2];
-	u32 rcntl = OPT_FRAME_SIZE | 0x04;
+	u32 max_fl = fec_enet_max_fl(ndev);
+	u32 rcntl = OPT_FRAME_SIZE(max_fl) | 0x04;
 	u32 ecntl = FEC_ENET_ETHEREN; /* ETHEREN */
 
 	/* Whack a reset.  We should wait for this.
@@ -970,9 +1097,9 @@ fec_restart(struct net_device *ndev)
 		else
 			val &= ~FEC_RACC_OPTIONS;
 		writel(val, fep->hwp + FEC_RACC);
-		writel(PKT_MAXBUF_SIZE, fep->hwp + FEC_FTRL);
+		writel(max_fl, fep->hwp + FEC_FTRL);
 	}
-	writel(PKT_MAXBUF_SIZE, fep->hwp + FEC_FTRL);
+	writel(max_fl, fep->hwp + FEC_FTRL);
 #endif
 
 	/*
@@ -1061,8 +1188,13 @@ fec_restart(struct net_device *ndev)
 	if (fep->quirks & FEC_QUIRK_ENET_MAC) {
 		/* enable ENET endian swap */
 		ecntl |= (1 << 8);
-		/* enable ENET store and forward mode */
-		writel(1 << 8, fep->hwp + FEC_X_WMRK);
+		/* enable ENET store and forward mode, unless frames may not
+		 * fit the TX FIFO
+		 */
+		if (max_fl > PKT_MAXBUF_SIZE)
+			writel(FEC_TX_WMRK_CUT_THROUGH, fep->hwp + FEC_X_WMRK);
+		else
+			writel(FEC_TX_WMRK_STRFWD, fep->hwp + FEC_X_WMRK);
 	}
 
 	if (fep->bufdesc_ex)
@@ -1164,6 +1296,22 @@ fec_stop(struct net_device *ndev)
 }
 
 
+static void fec_enet_napi_enable(struct fec_enet_private *fep)
+{
+	int i;
+
+	for (i = 0; i < fep->num_rx_queues; i++)
+		napi_enable(&fep->rx_queue[i]->napi);
+}
+
+static void fec_enet_napi_disable(struct fec_enet_private *fep)
+{
+	int i;
+
+	for (i = 0; i < fep->num_rx_queues; i++)
+		napi_disable(&fep->rx_queue[i]->napi);
+}
+
 static void
 fec_timeout(struct net_device *ndev)
 {
@@ -1172,6 +1320,7 @@ fec_timeout(struct net_device *ndev)
 	fec_dump(ndev);
 
 	ndev->stats.tx_errors++;
+	fep->tx_timeouts++;
 
 	schedule_work(&fep->tx_timeout_work);
 }
@@ -1184,12 +1333,12 @@ static void fec_enet_timeout_work(struct work_struct *work)
 
 	rtnl_lock();
 	if (netif_device_present(ndev) || netif_running(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(fep);
 		netif_tx_lock_bh(ndev);
 		fec_restart(ndev);
 		netif_wake_queue(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(fep);
 	}
 	rtnl_unlock();
 }
@@ -1210,7 +1359,7 @@ fec_enet_hwtstamp(struct fec_enet_private *fep, unsigned ts,
 }
 
 static void
-fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
+fec_enet_tx_queue(struct net_device *ndev, u16 queue_id, int budget)
 {
 	struct	fec_enet_private *fep;
 	struct bufdesc *bdp;
@@ -1220,11 +1369,11 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 	struct netdev_queue *nq;
 	int	index = 0;
 	int	entries_free;
+	unsigned int pkts_compl = 0;
+	unsigned int bytes_compl = 0;
 
 	fep = netdev_priv(ndev);
 
-	queue_id = FEC_ENET_GET_QUQUE(queue_id);
-
 	txq = fep->tx_queue[queue_id];
 	/* get next bdp of dirty_tx */
 	nq = netdev_get_tx_queue(ndev, queue_id);
@@ -1244,15 +1393,17 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 
 		skb = txq->tx_skbuff[index];
 		txq->tx_skbuff[index] = NULL;
-		if (!IS_TSO_HEADER(txq, fec32_to_cpu(bdp->cbd_bufaddr)))
-			dma_unmap_single(&fep->pdev->dev,
-					 fec32_to_cpu(bdp->cbd_bufaddr),
-					 fec16_to_cpu(bdp->cbd_datlen),
-					 DMA_TO_DEVICE);
+		fec_enet_tx_unmap(fep, txq, bdp);
 		bdp->cbd_bufaddr = cpu_to_fec32(0);
+		if (txq->tx_page[index]) {
+			put_page(txq->tx_page[index]);
+			txq->tx_page[index] = NULL;
+		}
 		if (!skb)
 			goto skb_done;
 
+		trace_fec_tx_reclaim(ndev, queue_id, index, skb);
+
 		/* Check for errors. */
 		if (status & (BD_ENET_TX_HB | BD_ENET_TX_LC |
 				   BD_ENET_TX_RL | BD_ENET_TX_UN |
@@ -1269,8 +1420,8 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 			if (status & BD_ENET_TX_CSL) /* Carrier lost */
 				ndev->stats.tx_carrier_errors++;
 		} else {
-			ndev->stats.tx_packets++;
-			ndev->stats.tx_bytes += skb->len;
+			txq->stats.tx_packets++;
+			txq->stats.tx_bytes += skb->len;
 		}
 
 		if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_IN_PROGRESS) &&
@@ -1288,8 +1439,11 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 		if (status & BD_ENET_TX_DEF)
 			ndev->stats.collisions++;
 
+		pkts_compl++;
+		bytes_compl += skb->len;
+
 		/* Free the sk buffer associated with this last transmit */
-		dev_kfree_skb_any(skb);
+		napi_consume_skb(skb, budget);
 skb_done:
 		/* Make sure the update to bdp and tx_skbuff are performed
 		 * before dirty_tx
@@ -1309,47 +1463,232 @@ skb_done:
 		}
 	}
 
+	netdev_tx_completed_queue(nq, pkts_compl, bytes_compl);
+
 	/* ERR006538: Keep the transmitter going */
 	if (bdp != txq->bd.cur &&
 	    readl(txq->bd.reg_desc_active) == 0)
 		writel(0, txq->bd.reg_desc_active);
 }
 
-static void
-fec_enet_tx(struct net_device *ndev)
+static int fec_enet_alloc_rx_page(struct fec_enet_private *fep,
+				  struct fec_enet_rx_buffer *rx_buf, gfp_t gfp)
 {
-	struct fec_enet_private *fep = netdev_priv(ndev);
-	u16 queue_id;
-	/* First process class A queue, then Class B and Best Effort queue */
-	for_each_set_bit(queue_id, &fep->work_tx, FEC_ENET_MAX_TX_QS) {
-		clear_bit(queue_id, &fep->work_tx);
-		fec_enet_tx_queue(ndev, queue_id);
+	struct page *page;
+	dma_addr_t dma;
+
+	page = __dev_alloc_page(gfp | __GFP_NOWARN);
+	if (unlikely(!page))
+		return -ENOMEM;
+
+	/* The page stays mapped for as long as the descriptor owns it, the
+	 * individual slices are handed back and forth with dma_sync_*.
+	 */
+	dma = dma_map_single(&fep->pdev->dev, page_address(page), PAGE_SIZE,
+			     DMA_FROM_DEVICE);
+	if (dma_mapping_error(&fep->pdev->dev, dma)) {
+		__free_page(page);
+		if (net_ratelimit())
+			netdev_err(fep->netdev, "Rx DMA memory map failed\n");
+		return -ENOMEM;
 	}
-	return;
+
+	rx_buf->page = page;
+	rx_buf->dma = dma;
+	rx_buf->page_offset = 0;
+
+	return 0;
 }
 
-static int
-fec_enet_new_rxbdp(struct net_device *ndev, struct bufdesc *bdp, struct sk_buff *skb)
+static void fec_enet_free_rx_page(struct fec_enet_private *fep,
+				  struct fec_enet_rx_buffer *rx_buf)
 {
-	struct  fec_enet_private *fep = netdev_priv(ndev);
-	int off;
+	if (!rx_buf->page)
+		return;
 
-	off = ((unsigned long)skb->data) & fep->rx_align;
-	if (off)
-		skb_reserve(skb, fep->rx_align + 1 - off);
+	/* Other slices may still be in use by the stack, so don't let the
+	 * unmap invalidate the cache over them.
+	 */
+	dma_unmap_single_attrs(&fep->pdev->dev, rx_buf->dma, PAGE_SIZE,
+			       DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+	put_page(rx_buf->page);
+	rx_buf->page = NULL;
+}
 
-	bdp->cbd_bufaddr = cpu_to_fec32(dma_map_single(&fep->pdev->dev, skb->data, FEC_ENET_RX_FRSIZE - fep->rx_align, DMA_FROM_DEVICE));
-	if (dma_mapping_error(&fep->pdev->dev, fec32_to_cpu(bdp->cbd_bufaddr))) {
-		if (net_ratelimit())
-			netdev_err(ndev, "Rx DMA memory map failed\n");
+static inline void fec_enet_set_rxbdp(struct bufdesc *bdp,
+				      struct fec_enet_rx_buffer *rx_buf)
+{
+	bdp->cbd_bufaddr = cpu_to_fec32(rx_buf->dma + rx_buf->page_offset +
+					FEC_ENET_RX_HEADROOM);
+}
+
+static inline void fec_enet_rx_buf_for_device(struct fec_enet_private *fep,
+					      struct fec_enet_rx_buffer *rx_buf)
+{
+	dma_sync_single_range_for_device(&fep->pdev->dev, rx_buf->dma,
+					 rx_buf->page_offset +
+					 FEC_ENET_RX_HEADROOM,
+					 PKT_MAXBLR_SIZE, DMA_FROM_DEVICE);
+}
+
+static bool fec_enet_rx_page_reusable(struct fec_enet_rx_buffer *rx_buf)
+{
+	struct page *page = rx_buf->page;
+
+	/* Don't hold on to pages from the emergency reserves */
+	if (unlikely(page_is_pfmemalloc(page)))
+		return false;
+
+#if (PAGE_SIZE < 8192)
+	/* The other half must have been released by the stack */
+	return page_count(page) == 1;
+#else
+	return rx_buf->page_offset + 2 * FEC_ENET_RX_FRSIZE <= PAGE_SIZE;
+#endif
+}
+
+/* Take the slice that just received a frame away from the descriptor,
+ * leaving the caller with one page reference to it, and set the descriptor
+ * up with its next buffer: the next slice of the same page if the stack is
+ * done with it, a freshly mapped page otherwise.  If no new page can be
+ * had the slice stays with the descriptor and -ENOMEM is returned.
+ */
+static int fec_enet_rx_buf_detach(struct fec_enet_private *fep,
+				  struct fec_enet_rx_buffer *rx_buf)
+{
+	struct fec_enet_rx_buffer old = *rx_buf;
+
+	if (likely(fec_enet_rx_page_reusable(rx_buf))) {
+		/* The caller took over our reference, get one for the ring */
+		page_ref_inc(old.page);
+#if (PAGE_SIZE < 8192)
+		rx_buf->page_offset ^= FEC_ENET_RX_FRSIZE;
+#else
+		rx_buf->page_offset += FEC_ENET_RX_FRSIZE;
+#endif
+		return 0;
+	}
+
+	if (fec_enet_alloc_rx_page(fep, rx_buf, GFP_ATOMIC))
 		return -ENOMEM;
+
+	dma_unmap_single_attrs(&fep->pdev->dev, old.dma, PAGE_SIZE,
+			       DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+	return 0;
+}
+
+static struct sk_buff *fec_enet_build_rx_skb(struct fec_enet_private *fep,
+					     struct fec_enet_rx_buffer *rx_buf)
+{
+	struct page *page = rx_buf->page;
+	void *va = page_address(page) + rx_buf->page_offset;
+	struct sk_buff *skb;
+
+	if (fec_enet_rx_buf_detach(fep, rx_buf))
+		return NULL;
+
+	skb = build_skb(va, FEC_ENET_RX_FRSIZE);
+	if (unlikely(!skb)) {
+		put_page(page);
+		return NULL;
 	}
 
+	skb_reserve(skb, FEC_ENET_RX_HEADROOM);
+
+	return skb;
+}
+
+/* Hand a slice holding part of a jumbo frame over to its skb */
+static int fec_enet_rx_add_frag(struct fec_enet_private *fep,
+				struct sk_buff *skb,
+				struct fec_enet_rx_buffer *rx_buf,
+				unsigned int len)
+{
+	struct page *page = rx_buf->page;
+	unsigned int offset = rx_buf->page_offset + FEC_ENET_RX_HEADROOM;
+
+	if (skb_shinfo(skb)->nr_frags >= MAX_SKB_FRAGS)
+		return -EMSGSIZE;
+
+	if (fec_enet_rx_buf_detach(fep, rx_buf))
+		return -ENOMEM;
+
+	skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, page, offset, len,
+			FEC_ENET_RX_FRSIZE);
 	return 0;
 }
 
+/* Take in a descriptor that isn't the last of its frame.  These are always
+ * full: the first one becomes the head of the skb, the next ones its
+ * fragments.  If any of this fails the rest of the frame is discarded.
+ */
+static void fec_enet_rx_chain(struct fec_enet_private *fep,
+			      struct fec_enet_priv_rx_q *rxq,
+			      struct fec_enet_rx_buffer *rx_buf)
+{
+	struct sk_buff *skb = rxq->rx_skb;
+
+	if (rxq->rx_discard)
+		return;
+
+	dma_sync_single_range_for_cpu(&fep->pdev->dev, rx_buf->dma,
+				      rx_buf->page_offset +
+				      FEC_ENET_RX_HEADROOM,
+				      PKT_MAXBLR_SIZE, DMA_FROM_DEVICE);
+
+	if (!skb) {
+		skb = fec_enet_build_rx_skb(fep, rx_buf);
+		if (skb)
+			skb_put(skb, PKT_MAXBLR_SIZE);
+	} else if (fec_enet_rx_add_frag(fep, skb, rx_buf, PKT_MAXBLR_SIZE)) {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+
+	rxq->rx_skb = skb;
+	rxq->rx_discard = !skb;
+}
+
+/* Complete the jumbo frame with its last descriptor, whose length is the
+ * one of the whole frame.  Returns NULL if the frame had to be dropped.
+ */
+static struct sk_buff *fec_enet_rx_chain_last(struct fec_enet_private *fep,
+					      struct fec_enet_priv_rx_q *rxq,
+					      struct fec_enet_rx_buffer *rx_buf,
+					      unsigned int pkt_len)
+{
+	struct sk_buff *skb = rxq->rx_skb;
+	unsigned int len;
+
+	rxq->rx_skb = NULL;
+	if (rxq->rx_discard) {
+		rxq->rx_discard = false;
+		return NULL;
+	}
+
+	if (pkt_len > skb->len) {
+		len = pkt_len - skb->len;
+		dma_sync_single_range_for_cpu(&fep->pdev->dev, rx_buf->dma,
+					      rx_buf->page_offset +
+					      FEC_ENET_RX_HEADROOM,
+					      len, DMA_FROM_DEVICE);
+		if (fec_enet_rx_add_frag(fep, skb, rx_buf, len)) {
+			dev_kfree_skb_any(skb);
+			return NULL;
+		}
+	}
+
+	/* Strip the FCS, which may straddle the last two buffers */
+	if (pskb_trim(skb, pkt_len - 4)) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+
+	return skb;
+}
+
 static bool fec_enet_copybreak(struct net_device *ndev, struct sk_buff **skb,
-			       struct bufdesc *bdp, u32 length, bool swap)
+			       void *data, u32 length, bool swap)
 {
 	struct  fec_enet_private *fep = netdev_priv(ndev);
 	struct sk_buff *new_skb;
@@ -1361,19 +1700,163 @@ static bool fec_enet_copybreak(struct net_device *ndev, struct sk_buff **skb,
 	if (!new_skb)
 		return false;
 
-	dma_sync_single_for_cpu(&fep->pdev->dev,
-				fec32_to_cpu(bdp->cbd_bufaddr),
-				FEC_ENET_RX_FRSIZE - fep->rx_align,
-				DMA_FROM_DEVICE);
 	if (!swap)
-		memcpy(new_skb->data, (*skb)->data, length);
+		memcpy(new_skb->data, data, length);
 	else
-		swap_buffer2(new_skb->data, (*skb)->data, length);
+		swap_buffer2(new_skb->data, data, length);
 	*skb = new_skb;
 
 	return true;
 }
 
+/* Queue an XDP_TX frame on the TX ring matching the RX queue it came in
+ * on.  The frame is sent straight out of its RX page slice when the
+ * controller can DMA from it, otherwise it goes through the bounce buffer
+ * like any other unaligned frame and the slice stays in the RX ring.
+ */
+static int fec_enet_txq_submit_xdp(struct fec_enet_priv_tx_q *txq,
+				   struct fec_enet_rx_buffer *rx_buf,
+				   void *data, int len,
+				   struct net_device *ndev)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct bufdesc *bdp = txq->bd.cur;
+	struct page *page = NULL;
+	unsigned short status;
+	unsigned int index;
+	dma_addr_t addr;
+
+	/* Leave room for the stack, fec_enet_start_xmit() needs it */
+	if (fec_enet_get_free_txdesc_num(txq) <= txq->tx_stop_threshold)
+		return -EBUSY;
+
+	index = fec_enet_get_bd_index(bdp, &txq->bd);
+	if (fec_enet_tx_needs_bounce(fep, data)) {
+		addr = fec_enet_tx_bounce(fep, txq, index, data, len);
+	} else {
+		page = rx_buf->page;
+		if (fec_enet_rx_buf_detach(fep, rx_buf))
+			return -ENOMEM;
+
+		addr = dma_map_single(&fep->pdev->dev, data, len,
+				      DMA_TO_DEVICE);
+		if (dma_mapping_error(&fep->pdev->dev, addr)) {
+			put_page(page);
+			if (net_ratelimit())
+				netdev_err(ndev, "Tx DMA memory map failed\n");
+			return -ENOMEM;
+		}
+	}
+
+	status = fec16_to_cpu(bdp->cbd_sc);
+	status &= ~BD_ENET_TX_STATS;
+	status |= (BD_ENET_TX_INTR | BD_ENET_TX_LAST);
+
+	bdp->cbd_bufaddr = cpu_to_fec32(addr);
+	bdp->cbd_datlen = cpu_to_fec16(len);
+
+	if (fep->bufdesc_ex) {
+		struct bufdesc_ex *ebdp = (struct bufdesc_ex *)bdp;
+		unsigned int estatus = BD_ENET_TX_INT;
+
+		if (fep->quirks & FEC_QUIRK_HAS_AVB)
+			estatus |= FEC_TX_BD_FTYPE(txq->bd.qid);
+
+		ebdp->cbd_bdu = 0;
+		ebdp->cbd_esc = cpu_to_fec32(estatus);
+	}
+
+	txq->tx_page[index] = page;
+
+	/* Make sure the updates to rest of the descriptor are performed before
+	 * transferring ownership.
+	 */
+	wmb();
+
+	status |= (BD_ENET_TX_READY | BD_ENET_TX_TC);
+	bdp->cbd_sc = cpu_to_fec16(status);
+
+	bdp = fec_enet_get_nextdesc(bdp, &txq->bd);
+
+	/* Make sure the update to bdp and tx_page are performed before
+	 * txq->bd.cur.
+	 */
+	wmb();
+	txq->bd.cur = bdp;
+
+	/* Trigger transmission start */
+	writel(0, txq->bd.reg_desc_active);
+
+	return 0;
+}
+
+static int fec_enet_xdp_tx(struct net_device *ndev, u16 queue_id,
+			   struct fec_enet_rx_buffer *rx_buf,
+			   struct xdp_buff *xdp)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_priv_tx_q *txq;
+	struct netdev_queue *nq;
+	int ret;
+
+	if (queue_id >= fep->num_tx_queues)
+		queue_id = 0;
+	txq = fep->tx_queue[queue_id];
+	nq = netdev_get_tx_queue(ndev, queue_id);
+
+	/* The ring is shared with fec_enet_start_xmit() */
+	__netif_tx_lock(nq, smp_processor_id());
+	ret = fec_enet_txq_submit_xdp(txq, rx_buf, xdp->data,
+				      xdp->data_end - xdp->data, ndev);
+	__netif_tx_unlock(nq);
+
+	return ret;
+}
+
+/* Run the attached XDP program on a received frame.  Returns true if the
+ * program consumed the frame, in which case the caller only has to give
+ * the RX descriptor back to the hardware.
+ */
+static bool fec_enet_run_xdp(struct net_device *ndev, struct bpf_prog *prog,
+			     u16 queue_id, struct fec_enet_rx_buffer *rx_buf,
+			     void *data, u32 length)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_priv_rx_q *rxq = fep->rx_queue[queue_id];
+	struct xdp_buff xdp;
+	u32 act;
+
+	xdp.data = data;
+	xdp.data_end = data + length;
+#if !defined(CONFIG_M5272)
+	if (fep->quirks & FEC_QUIRK_HAS_RACC)
+		xdp.data += 2;
+#endif
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		return false;
+	case XDP_TX:
+		/* Accounted here, the ring may be reclaimed by another NAPI */
+		if (unlikely(fec_enet_xdp_tx(ndev, queue_id, rx_buf, &xdp))) {
+			rxq->stats.xdp_tx_dropped++;
+		} else {
+			rxq->stats.xdp_tx_packets++;
+			rxq->stats.xdp_tx_bytes += xdp.data_end - xdp.data;
+		}
+		break;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+	case XDP_DROP:
+		break;
+	}
+
+	return true;
+}
+
 /* During a receive, the bd_rx.cur points to the current incoming buffer.
  * When we update through the ring, if the next incoming buffer has
  * not been given to the system, we just set the empty indicator,
@@ -1384,9 +1867,9 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
 	struct fec_enet_priv_rx_q *rxq;
+	struct fec_enet_rx_buffer *rx_buf;
 	struct bufdesc *bdp;
 	unsigned short status;
-	struct  sk_buff *skb_new = NULL;
 	struct  sk_buff *skb;
 	ushort	pkt_len;
 	__u8 *data;
@@ -1396,14 +1879,17 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 	u16	vlan_tag;
 	int	index = 0;
 	bool	is_copybreak;
-	bool	need_swap = fep->quirks & FEC_QUIRK_SWAP_FRAME;
+	bool	need_swap;
+	struct bpf_prog *xdp_prog;
 
 #ifdef CONFIG_M532x
 	flush_cache_all();
 #endif
-	queue_id = FEC_ENET_GET_QUQUE(queue_id);
 	rxq = fep->rx_queue[queue_id];
 
+	rcu_read_lock();
+	xdp_prog = READ_ONCE(fep->xdp_prog);
+
 	/* First, grab all of the stats for the incoming packet.
 	 * These get messed up if we get called due to a busy condition.
 	 */
@@ -1415,14 +1901,34 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 			break;
 		pkt_received++;
 
-		writel(FEC_ENET_RXF, fep->hwp + FEC_IEVENT);
+		writel(FEC_ENET_RXF_Q(queue_id), fep->hwp + FEC_IEVENT);
 
-		/* Check for errors. */
+		index = fec_enet_get_bd_index(bdp, &rxq->bd);
+		rx_buf = &rxq->rx_buf[index];
+
+		trace_fec_rx_desc(ndev, queue_id, index, status,
+				  fec16_to_cpu(bdp->cbd_datlen));
+
+		/* Jumbo frames span several descriptors, only the last one
+		 * has the status and length of the frame.
+		 */
 		status ^= BD_ENET_RX_LAST;
+		if ((status & BD_ENET_RX_LAST) &&
+		    (fep->quirks & FEC_QUIRK_JUMBO_FRAME)) {
+			fec_enet_rx_chain(fep, rxq, rx_buf);
+			goto rx_buf_done;
+		}
+
+		/* Check for errors. */
 		if (status & (BD_ENET_RX_LG | BD_ENET_RX_SH | BD_ENET_RX_NO |
 			   BD_ENET_RX_CR | BD_ENET_RX_OV | BD_ENET_RX_LAST |
 			   BD_ENET_RX_CL)) {
 			ndev->stats.rx_errors++;
+			if (rxq->rx_skb) {
+				dev_kfree_skb_any(rxq->rx_skb);
+				rxq->rx_skb = NULL;
+			}
+			rxq->rx_discard = false;
 			if (status & BD_ENET_RX_OV) {
 				/* FIFO overrun */
 				ndev->stats.rx_fifo_errors++;
@@ -1444,38 +1950,67 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 		}
 
 		/* Process the incoming frame. */
-		ndev->stats.rx_packets++;
+		rxq->stats.rx_packets++;
 		pkt_len = fec16_to_cpu(bdp->cbd_datlen);
-		ndev->stats.rx_bytes += pkt_len;
+		rxq->stats.rx_bytes += pkt_len;
 
-		index = fec_enet_get_bd_index(bdp, &rxq->bd);
-		skb = rxq->rx_skbuff[index];
+		if (rxq->rx_skb || rxq->rx_discard) {
+			skb = fec_enet_rx_chain_last(fep, rxq, rx_buf, pkt_len);
+			if (unlikely(!skb)) {
+				rxq->stats.rx_dropped++;
+				goto rx_buf_done;
+			}
+			data = skb->data;
+			goto rx_skb_ready;
+		}
+
+		data = page_address(rx_buf->page) + rx_buf->page_offset +
+		       FEC_ENET_RX_HEADROOM;
+
+		dma_sync_single_range_for_cpu(&fep->pdev->dev, rx_buf->dma,
+					      rx_buf->page_offset +
+					      FEC_ENET_RX_HEADROOM,
+					      pkt_len, DMA_FROM_DEVICE);
+		prefetch(data);
+
+		need_swap = fep->quirks & FEC_QUIRK_SWAP_FRAME;
+		if (xdp_prog) {
+			/* The program wants to see the frame as it is on
+			 * the wire, so swap it in place up front.
+			 */
+			if (need_swap) {
+				swap_buffer(data, pkt_len);
+				need_swap = false;
+			}
+
+			if (fec_enet_run_xdp(ndev, xdp_prog, queue_id, rx_buf,
+					     data, pkt_len - 4))
+				goto rx_buf_done;
+		}
 
 		/* The packet length includes FCS, but we don't want to
 		 * include that when passing upstream as it messes up
 		 * bridging applications.
 		 */
-		is_copybreak = fec_enet_copybreak(ndev, &skb, bdp, pkt_len - 4,
+		is_copybreak = fec_enet_copybreak(ndev, &skb, data, pkt_len - 4,
 						  need_swap);
-		if (!is_copybreak) {
-			skb_new = netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE);
-			if (unlikely(!skb_new)) {
-				ndev->stats.rx_dropped++;
-				goto rx_processing_done;
+		if (is_copybreak) {
+			rxq->stats.rx_copybreak++;
+		} else {
+			skb = fec_enet_build_rx_skb(fep, rx_buf);
+			if (unlikely(!skb)) {
+				rxq->stats.rx_dropped++;
+				goto rx_buf_done;
 			}
-			dma_unmap_single(&fep->pdev->dev,
-					 fec32_to_cpu(bdp->cbd_bufaddr),
-					 FEC_ENET_RX_FRSIZE - fep->rx_align,
-					 DMA_FROM_DEVICE);
 		}
 
-		prefetch(skb->data - NET_IP_ALIGN);
 		skb_put(skb, pkt_len - 4);
 		data = skb->data;
 
 		if (!is_copybreak && need_swap)
 			swap_buffer(data, pkt_len);
 
+rx_skb_ready:
 #if !defined(CONFIG_M5272)
 		if (fep->quirks & FEC_QUIRK_HAS_RACC)
 			data = skb_pull_inline(skb, 2);
@@ -1525,17 +2060,14 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 					       htons(ETH_P_8021Q),
 					       vlan_tag);
 
-		napi_gro_receive(&fep->napi, skb);
+		napi_gro_receive(&rxq->napi, skb);
 
-		if (is_copybreak) {
-			dma_sync_single_for_device(&fep->pdev->dev,
-						   fec32_to_cpu(bdp->cbd_bufaddr),
-						   FEC_ENET_RX_FRSIZE - fep->rx_align,
-						   DMA_FROM_DEVICE);
-		} else {
-			rxq->rx_skbuff[index] = skb_new;
-			fec_enet_new_rxbdp(ndev, bdp, skb_new);
-		}
+rx_buf_done:
+		/* Give the descriptor its next buffer, which is either the
+		 * slice that was just copied out or a fresh one.
+		 */
+		fec_enet_rx_buf_for_device(fep, rx_buf);
+		fec_enet_set_rxbdp(bdp, rx_buf);
 
 rx_processing_done:
 		/* Clear the status flags for this buffer */
@@ -1566,52 +2098,28 @@ rx_processing_done:
 		 */
 		writel(0, rxq->bd.reg_desc_active);
 	}
+	rcu_read_unlock();
 	rxq->bd.cur = bdp;
 	return pkt_received;
 }
 
-static int
-fec_enet_rx(struct net_device *ndev, int budget)
-{
-	int     pkt_received = 0;
-	u16	queue_id;
-	struct fec_enet_private *fep = netdev_priv(ndev);
-
-	for_each_set_bit(queue_id, &fep->work_rx, FEC_ENET_MAX_RX_QS) {
-		int ret;
-
-		ret = fec_enet_rx_queue(ndev,
-					budget - pkt_received, queue_id);
-
-		if (ret < budget - pkt_received)
-			clear_bit(queue_id, &fep->work_rx);
-
-		pkt_received += ret;
-	}
-	return pkt_received;
-}
-
-static bool
-fec_enet_collect_events(struct fec_enet_private *fep, uint int_events)
+/* Mask or unmask the NAPI events of one queue.  FEC_IMASK is shared by
+ * all the queues, whose NAPI contexts may run concurrently.
+ */
+static void fec_enet_napi_irq(struct fec_enet_private *fep, u32 events,
+			      bool enable)
 {
-	if (int_events == 0)
-		return false;
-
-	if (int_events & FEC_ENET_RXF)
-		fep->work_rx |= (1 << 2);
-	if (int_events & FEC_ENET_RXF_1)
-		fep->work_rx |= (1 << 0);
-	if (int_events & FEC_ENET_RXF_2)
-		fep->work_rx |= (1 << 1);
-
-	if (int_events & FEC_ENET_TXF)
-		fep->work_tx |= (1 << 2);
-	if (int_events & FEC_ENET_TXF_1)
-		fep->work_tx |= (1 << 0);
-	if (int_events & FEC_ENET_TXF_2)
-		fep->work_tx |= (1 << 1);
+	unsigned long flags;
+	u32 imask;
 
-	return true;
+	spin_lock_irqsave(&fep->imask_lock, flags);
+	imask = readl(fep->hwp + FEC_IMASK);
+	if (enable)
+		imask |= events;
+	else
+		imask &= ~events;
+	writel(imask, fep->hwp + FEC_IMASK);
+	spin_unlock_irqrestore(&fep->imask_lock, flags);
 }
 
 static irqreturn_t
@@ -1619,20 +2127,25 @@ fec_enet_interrupt(int irq, void *dev_id)
 {
 	struct net_device *ndev = dev_id;
 	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_priv_rx_q *rxq;
 	uint int_events;
 	irqreturn_t ret = IRQ_NONE;
+	int i;
 
 	int_events = readl(fep->hwp + FEC_IEVENT);
 	writel(int_events, fep->hwp + FEC_IEVENT);
-	fec_enet_collect_events(fep, int_events);
 
-	if ((fep->work_tx || fep->work_rx) && fep->link) {
+	for (i = 0; i < fep->num_rx_queues && fep->link; i++) {
+		rxq = fep->rx_queue[i];
+		if (!(int_events & rxq->napi_events))
+			continue;
+
 		ret = IRQ_HANDLED;
 
-		if (napi_schedule_prep(&fep->napi)) {
-			/* Disable the NAPI interrupts */
-			writel(FEC_NAPI_IMASK, fep->hwp + FEC_IMASK);
-			__napi_schedule(&fep->napi);
+		if (napi_schedule_prep(&rxq->napi)) {
+			/* Disable the NAPI interrupts of this queue */
+			fec_enet_napi_irq(fep, rxq->napi_events, false);
+			__napi_schedule(&rxq->napi);
 		}
 	}
 
@@ -1647,19 +2160,123 @@ fec_enet_interrupt(int irq, void *dev_id)
 	return ret;
 }
 
+static struct net_device_stats *fec_enet_get_stats(struct net_device *ndev)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	unsigned long rx_packets = 0, rx_bytes = 0, rx_dropped = 0;
+	unsigned long tx_packets = 0, tx_bytes = 0, tx_dropped = 0;
+	struct fec_enet_rx_q_stats *rx_stats;
+	int i;
+
+	for (i = 0; i < fep->num_rx_queues; i++) {
+		rx_stats = &fep->rx_queue[i]->stats;
+		rx_packets += rx_stats->rx_packets;
+		rx_bytes += rx_stats->rx_bytes;
+		rx_dropped += rx_stats->rx_dropped;
+		tx_packets += rx_stats->xdp_tx_packets;
+		tx_bytes += rx_stats->xdp_tx_bytes;
+		tx_dropped += rx_stats->xdp_tx_dropped;
+	}
+
+	for (i = 0; i < fep->num_tx_queues; i++) {
+		tx_packets += fep->tx_queue[i]->stats.tx_packets;
+		tx_bytes += fep->tx_queue[i]->stats.tx_bytes;
+	}
+
+	ndev->stats.rx_packets = rx_packets;
+	ndev->stats.rx_bytes = rx_bytes;
+	ndev->stats.rx_dropped = rx_dropped;
+	ndev->stats.tx_packets = tx_packets;
+	ndev->stats.tx_bytes = tx_bytes;
+	ndev->stats.tx_dropped = tx_dropped;
+
+	return &ndev->stats;
+}
+
+/* Adaptive interrupt coalescing samples the traffic seen by NAPI over
+ * FEC_ITR_SAMPLE_TIME: light traffic gets an interrupt per frame, small
+ * frames at a moderate rate get a short timer and bulk transfers the
+ * default thresholds.
+ */
+#define FEC_ITR_SAMPLE_TIME	DIV_ROUND_UP(HZ, 50)
+#define FEC_ITR_LOW_PPS		4000			/* frames per second */
+#define FEC_ITR_BULK_BPS	(8 * 1024 * 1024)	/* bytes per second */
+#define FEC_ITR_BULK_FRAME	512			/* average frame size */
+
+static enum fec_itr_profile
+fec_enet_itr_classify(unsigned long packets, unsigned long bytes,
+		      unsigned long elapsed)
+{
+	if ((u64)packets * HZ < (u64)FEC_ITR_LOW_PPS * elapsed)
+		return FEC_ITR_LOWEST_LATENCY;
+
+	if ((u64)bytes * HZ >= (u64)FEC_ITR_BULK_BPS * elapsed &&
+	    bytes >= packets * FEC_ITR_BULK_FRAME)
+		return FEC_ITR_BULK_LATENCY;
+
+	return FEC_ITR_LOW_LATENCY;
+}
+
+static void fec_enet_adaptive_itr(struct net_device *ndev)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	unsigned long sample_time = READ_ONCE(fep->itr_sample_time);
+	unsigned long elapsed = jiffies - sample_time;
+	enum fec_itr_profile rx_profile, tx_profile;
+	struct net_device_stats *stats;
+
+	if (elapsed < FEC_ITR_SAMPLE_TIME)
+		return;
+
+	/* Only one of the queue NAPI contexts takes each sample */
+	if (cmpxchg(&fep->itr_sample_time, sample_time, jiffies) != sample_time)
+		return;
+
+	stats = fec_enet_get_stats(ndev);
+	rx_profile = fec_enet_itr_classify(stats->rx_packets -
+					   fep->itr_rx_packets,
+					   stats->rx_bytes -
+					   fep->itr_rx_bytes, elapsed);
+	tx_profile = fec_enet_itr_classify(stats->tx_packets -
+					   fep->itr_tx_packets,
+					   stats->tx_bytes -
+					   fep->itr_tx_bytes, elapsed);
+
+	fep->itr_rx_packets = stats->rx_packets;
+	fep->itr_rx_bytes = stats->rx_bytes;
+	fep->itr_tx_packets = stats->tx_packets;
+	fep->itr_tx_bytes = stats->tx_bytes;
+
+	if (rx_profile == fep->rx_itr_profile &&
+	    tx_profile == fep->tx_itr_profile)
+		return;
+
+	fep->rx_itr_profile = rx_profile;
+	fep->tx_itr_profile = tx_profile;
+	fec_enet_itr_coal_set(ndev);
+}
+
 static int fec_enet_rx_napi(struct napi_struct *napi, int budget)
 {
+	struct fec_enet_priv_rx_q *rxq =
+		container_of(napi, struct fec_enet_priv_rx_q, napi);
 	struct net_device *ndev = napi->dev;
 	struct fec_enet_private *fep = netdev_priv(ndev);
-	int pkts;
+	int pkts, i;
+
+	pkts = fec_enet_rx_queue(ndev, budget, rxq->bd.qid);
 
-	pkts = fec_enet_rx(ndev, budget);
+	for (i = rxq->bd.qid; i < fep->num_tx_queues; i += fep->num_rx_queues)
+		fec_enet_tx_queue(ndev, i, budget);
 
-	fec_enet_tx(ndev);
+	if (fep->rx_adaptive_itr || fep->tx_adaptive_itr)
+		fec_enet_adaptive_itr(ndev);
 
 	if (pkts < budget) {
 		napi_complete(napi);
-		writel(FEC_DEFAULT_IMASK, fep->hwp + FEC_IMASK);
+		fec_enet_napi_irq(fep, rxq->napi_events, true);
+	} else {
+		rxq->stats.napi_exhausted++;
 	}
 	return pkts;
 }
@@ -1776,20 +2393,20 @@ static void fec_enet_adjust_link(struct net_device *ndev)
 
 		/* if any of the above changed restart the FEC */
 		if (status_change) {
-			napi_disable(&fep->napi);
+			fec_enet_napi_disable(fep);
 			netif_tx_lock_bh(ndev);
 			fec_restart(ndev);
 			netif_wake_queue(ndev);
 			netif_tx_unlock_bh(ndev);
-			napi_enable(&fep->napi);
+			fec_enet_napi_enable(fep);
 		}
 	} else {
 		if (fep->link) {
-			napi_disable(&fep->napi);
+			fec_enet_napi_disable(fep);
 			netif_tx_lock_bh(ndev);
 			fec_stop(ndev);
 			netif_tx_unlock_bh(ndev);
-			napi_enable(&fep->napi);
+			fec_enet_napi_enable(fep);
 			fep->link = phy_dev->link;
 			status_change = 1;
 		}
@@ -2029,8 +2646,12 @@ static int fec_enet_mii_init(struct platform_device *pdev)
 	if ((fep->quirks & FEC_QUIRK_SINGLE_MDIO) && fep->dev_id > 0) {
 		/* fec1 uses fec0 mii_bus */
 		if (mii_cnt && fec0_mii_bus) {
+			struct fec_enet_private *fep0 = fec0_mii_bus->priv;
+
 			fep->mii_bus = fec0_mii_bus;
 			*fec_mii_bus_share = FEC0_MII_BUS_SHARE_TRUE;
+			/* order the async suspend/resume against fec0 */
+			fep0->mii_bus_user = &pdev->dev;
 			mii_cnt++;
 			return 0;
 		}
@@ -2121,6 +2742,11 @@ err_out:
 
 static void fec_enet_mii_remove(struct fec_enet_private *fep)
 {
+	struct fec_enet_private *fep0 = fep->mii_bus->priv;
+
+	if (fep0 != fep)
+		fep0->mii_bus_user = NULL;
+
 	if (--mii_cnt == 0) {
 		mdiobus_unregister(fep->mii_bus);
 		mdiobus_free(fep->mii_bus);
@@ -2289,12 +2915,12 @@ static int fec_enet_set_pauseparam(struct net_device *ndev,
 		phy_start_aneg(ndev->phydev);
 	}
 	if (netif_running(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(fep);
 		netif_tx_lock_bh(ndev);
 		fec_restart(ndev);
 		netif_wake_queue(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(fep);
 	}
 
 	return 0;
@@ -2368,6 +2994,33 @@ static const struct fec_stat {
 
 #define FEC_STATS_SIZE		(ARRAY_SIZE(fec_stats) * sizeof(u64))
 
+/* Software counters, the per-queue ones are repeated for every queue */
+static const char fec_sw_stats[][ETH_GSTRING_LEN] = {
+	"tx_timeout",
+};
+
+#define FEC_RX_Q_STAT(name, m) \
+	{ name, offsetof(struct fec_enet_rx_q_stats, m) }
+#define FEC_TX_Q_STAT(name, m) \
+	{ name, offsetof(struct fec_enet_tx_q_stats, m) }
+
+static const struct fec_stat fec_rx_queue_stats[] = {
+	FEC_RX_Q_STAT("packets", rx_packets),
+	FEC_RX_Q_STAT("bytes", rx_bytes),
+	FEC_RX_Q_STAT("dropped", rx_dropped),
+	FEC_RX_Q_STAT("copybreak", rx_copybreak),
+	FEC_RX_Q_STAT("napi_exhausted", napi_exhausted),
+	FEC_RX_Q_STAT("xdp_tx", xdp_tx_packets),
+	FEC_RX_Q_STAT("xdp_tx_bytes", xdp_tx_bytes),
+	FEC_RX_Q_STAT("xdp_tx_dropped", xdp_tx_dropped),
+};
+
+static const struct fec_stat fec_tx_queue_stats[] = {
+	FEC_TX_Q_STAT("packets", tx_packets),
+	FEC_TX_Q_STAT("bytes", tx_bytes),
+	FEC_TX_Q_STAT("ring_full", tx_ring_full),
+};
+
 static void fec_enet_update_ethtool_stats(struct net_device *dev)
 {
 	struct fec_enet_private *fep = netdev_priv(dev);
@@ -2382,30 +3035,77 @@ static void fec_enet_get_ethtool_stats(struct net_device *dev,
 {
 	struct fec_enet_private *fep = netdev_priv(dev);
 
+	void *qstats;
+	int q, i;
+
 	if (netif_running(dev))
 		fec_enet_update_ethtool_stats(dev);
 
 	memcpy(data, fep->ethtool_stats, FEC_STATS_SIZE);
+	data += ARRAY_SIZE(fec_stats);
+
+	*data++ = fep->tx_timeouts;
+
+	for (q = 0; q < fep->num_rx_queues; q++) {
+		qstats = &fep->rx_queue[q]->stats;
+		for (i = 0; i < ARRAY_SIZE(fec_rx_queue_stats); i++)
+			*data++ = *(unsigned long *)(qstats +
+					fec_rx_queue_stats[i].offset);
+	}
+
+	for (q = 0; q < fep->num_tx_queues; q++) {
+		qstats = &fep->tx_queue[q]->stats;
+		for (i = 0; i < ARRAY_SIZE(fec_tx_queue_stats); i++)
+			*data++ = *(unsigned long *)(qstats +
+					fec_tx_queue_stats[i].offset);
+	}
 }
 
 static void fec_enet_get_strings(struct net_device *netdev,
 	u32 stringset, u8 *data)
 {
-	int i;
+	struct fec_enet_private *fep = netdev_priv(netdev);
+	int i, q;
 	switch (stringset) {
 	case ETH_SS_STATS:
 		for (i = 0; i < ARRAY_SIZE(fec_stats); i++)
 			memcpy(data + i * ETH_GSTRING_LEN,
 				fec_stats[i].name, ETH_GSTRING_LEN);
+		data += ARRAY_SIZE(fec_stats) * ETH_GSTRING_LEN;
+
+		memcpy(data, fec_sw_stats, sizeof(fec_sw_stats));
+		data += sizeof(fec_sw_stats);
+
+		for (q = 0; q < fep->num_rx_queues; q++) {
+			for (i = 0; i < ARRAY_SIZE(fec_rx_queue_stats); i++) {
+				snprintf(data, ETH_GSTRING_LEN,
+					 "rx_queue_%d_%s", q,
+					 fec_rx_queue_stats[i].name);
+				data += ETH_GSTRING_LEN;
+			}
+		}
+
+		for (q = 0; q < fep->num_tx_queues; q++) {
+			for (i = 0; i < ARRAY_SIZE(fec_tx_queue_stats); i++) {
+				snprintf(data, ETH_GSTRING_LEN,
+					 "tx_queue_%d_%s", q,
+					 fec_tx_queue_stats[i].name);
+				data += ETH_GSTRING_LEN;
+			}
+		}
 		break;
 	}
 }
 
 static int fec_enet_get_sset_count(struct net_device *dev, int sset)
 {
+	struct fec_enet_private *fep = netdev_priv(dev);
+
 	switch (sset) {
 	case ETH_SS_STATS:
-		return ARRAY_SIZE(fec_stats);
+		return ARRAY_SIZE(fec_stats) + ARRAY_SIZE(fec_sw_stats) +
+		       fep->num_rx_queues * ARRAY_SIZE(fec_rx_queue_stats) +
+		       fep->num_tx_queues * ARRAY_SIZE(fec_tx_queue_stats);
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -2439,15 +3139,37 @@ static int fec_enet_us_to_itr_clock(struct net_device *ndev, int us)
 	return us * (fep->itr_clk_rate / 64000) / 1000;
 }
 
+static const struct {
+	unsigned int usecs;
+	unsigned int frames;
+} fec_itr_profiles[] = {
+	[FEC_ITR_LOWEST_LATENCY]	= { 10, 1 },
+	[FEC_ITR_LOW_LATENCY]		= { 100, 16 },
+	[FEC_ITR_BULK_LATENCY]		= { FEC_ITR_ICTT_DEFAULT,
+					    FEC_ITR_ICFT_DEFAULT },
+};
+
 /* Set threshold for interrupt coalescing */
 static void fec_enet_itr_coal_set(struct net_device *ndev)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
+	unsigned int rx_time = fep->rx_time_itr;
+	unsigned int rx_pkts = fep->rx_pkts_itr;
+	unsigned int tx_time = fep->tx_time_itr;
+	unsigned int tx_pkts = fep->tx_pkts_itr;
 	int rx_itr, tx_itr;
 
+	if (fep->rx_adaptive_itr) {
+		rx_time = fec_itr_profiles[fep->rx_itr_profile].usecs;
+		rx_pkts = fec_itr_profiles[fep->rx_itr_profile].frames;
+	}
+	if (fep->tx_adaptive_itr) {
+		tx_time = fec_itr_profiles[fep->tx_itr_profile].usecs;
+		tx_pkts = fec_itr_profiles[fep->tx_itr_profile].frames;
+	}
+
 	/* Must be greater than zero to avoid unpredictable behavior */
-	if (!fep->rx_time_itr || !fep->rx_pkts_itr ||
-	    !fep->tx_time_itr || !fep->tx_pkts_itr)
+	if (!rx_time || !rx_pkts || !tx_time || !tx_pkts)
 		return;
 
 	/* Select enet system clock as Interrupt Coalescing
@@ -2457,10 +3179,10 @@ static void fec_enet_itr_coal_set(struct net_device *ndev)
 	tx_itr = FEC_ITR_CLK_SEL;
 
 	/* set ICFT and ICTT */
-	rx_itr |= FEC_ITR_ICFT(fep->rx_pkts_itr);
-	rx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, fep->rx_time_itr));
-	tx_itr |= FEC_ITR_ICFT(fep->tx_pkts_itr);
-	tx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, fep->tx_time_itr));
+	rx_itr |= FEC_ITR_ICFT(rx_pkts);
+	rx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, rx_time));
+	tx_itr |= FEC_ITR_ICFT(tx_pkts);
+	tx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, tx_time));
 
 	rx_itr |= FEC_ITR_EN;
 	tx_itr |= FEC_ITR_EN;
@@ -2489,6 +3211,9 @@ fec_enet_get_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 	ec->tx_coalesce_usecs = fep->tx_time_itr;
 	ec->tx_max_coalesced_frames = fep->tx_pkts_itr;
 
+	ec->use_adaptive_rx_coalesce = fep->rx_adaptive_itr;
+	ec->use_adaptive_tx_coalesce = fep->tx_adaptive_itr;
+
 	return 0;
 }
 
@@ -2496,6 +3221,7 @@ static int
 fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct net_device_stats *stats;
 	unsigned int cycle;
 
 	if (!(fep->quirks & FEC_QUIRK_HAS_COALESCE))
@@ -2529,6 +3255,19 @@ fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 	fep->tx_time_itr = ec->tx_coalesce_usecs;
 	fep->tx_pkts_itr = ec->tx_max_coalesced_frames;
 
+	fep->rx_adaptive_itr = !!ec->use_adaptive_rx_coalesce;
+	fep->tx_adaptive_itr = !!ec->use_adaptive_tx_coalesce;
+
+	/* Restart adaptive moderation from a fresh sample */
+	fep->rx_itr_profile = FEC_ITR_LOW_LATENCY;
+	fep->tx_itr_profile = FEC_ITR_LOW_LATENCY;
+	stats = fec_enet_get_stats(ndev);
+	fep->itr_sample_time = jiffies;
+	fep->itr_rx_packets = stats->rx_packets;
+	fep->itr_rx_bytes = stats->rx_bytes;
+	fep->itr_tx_packets = stats->tx_packets;
+	fep->itr_tx_bytes = stats->tx_bytes;
+
 	fec_enet_itr_coal_set(ndev);
 
 	return 0;
@@ -2536,8 +3275,14 @@ fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 
 static void fec_enet_itr_coal_init(struct net_device *ndev)
 {
+	struct fec_enet_private *fep = netdev_priv(ndev);
 	struct ethtool_coalesce ec;
 
+	memset(&ec, 0, sizeof(ec));
+
+	ec.use_adaptive_rx_coalesce = fep->rx_adaptive_itr;
+	ec.use_adaptive_tx_coalesce = fep->tx_adaptive_itr;
+
 	ec.rx_coalesce_usecs = FEC_ITR_ICTT_DEFAULT;
 	ec.rx_max_coalesced_frames = FEC_ITR_ICFT_DEFAULT;
 
@@ -2585,6 +3330,55 @@ static int fec_enet_set_tunable(struct net_device *netdev,
 	return ret;
 }
 
+static void fec_enet_get_ringparam(struct net_device *ndev,
+				   struct ethtool_ringparam *ring)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+
+	ring->rx_max_pending = RX_RING_SIZE;
+	ring->tx_max_pending = TX_RING_SIZE;
+	ring->rx_pending = fep->rx_queue[0]->bd.ring_size;
+	ring->tx_pending = fep->tx_queue[0]->bd.ring_size;
+}
+
+/* The descriptor memory is laid out for the largest rings, so only the
+ * number of RX descriptors in use changes.  The TX rings stay at their
+ * size, a shorter one wouldn't hold two maximally fragmented TSO frames.
+ */
+static int fec_enet_set_ringparam(struct net_device *ndev,
+				  struct ethtool_ringparam *ring)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_priv_rx_q *rxq;
+	bool running = netif_running(ndev);
+	unsigned int i;
+
+	if (ring->rx_mini_pending || ring->rx_jumbo_pending)
+		return -EINVAL;
+
+	if (ring->rx_pending < RX_RING_MIN_SIZE ||
+	    ring->rx_pending > RX_RING_SIZE)
+		return -EINVAL;
+
+	if (ring->tx_pending != fep->tx_queue[0]->bd.ring_size)
+		return -EINVAL;
+
+	if (ring->rx_pending == fep->rx_queue[0]->bd.ring_size)
+		return 0;
+
+	if (running)
+		fec_enet_close(ndev);
+
+	for (i = 0; i < fep->num_rx_queues; i++) {
+		rxq = fep->rx_queue[i];
+		rxq->bd.ring_size = ring->rx_pending;
+		rxq->bd.last = (struct bufdesc *)((void *)rxq->bd.base +
+			(rxq->bd.ring_size - 1) * rxq->bd.dsize);
+	}
+
+	return running ? fec_enet_open(ndev) : 0;
+}
+
 static void
 fec_enet_get_wol(struct net_device *ndev, struct ethtool_wolinfo *wol)
 {
@@ -2618,6 +3412,193 @@ fec_enet_set_wol(struct net_device *ndev, struct ethtool_wolinfo *wol)
 	return 0;
 }
 
+/* Build the RCMR values of rings 1 and 2.  Out of reset VLAN priorities
+ * 0-3 go to ring 1 and 4-7 to ring 2, the n-tuple rules override single
+ * priorities with the lowest location taking precedence.  Each ring can
+ * compare against RCMR_CMP_NUM priorities, anything unmatched lands on
+ * ring 0 together with the untagged traffic.
+ */
+static int fec_enet_rx_flow_update(struct fec_enet_private *fep)
+{
+	u32 rcmr[FEC_ENET_MAX_RX_QS] = { 0 };
+	int ncmp[FEC_ENET_MAX_RX_QS] = { 0 };
+	u8 prio_queue[FEC_ENET_VLAN_PRIOS];
+	struct fec_enet_rx_flow *flow;
+	int prio, queue, i;
+
+	for (prio = 0; prio < ARRAY_SIZE(prio_queue); prio++) {
+		queue = prio < RCMR_CMP_NUM ? 1 : 2;
+		prio_queue[prio] = queue < fep->num_rx_queues ? queue : 0;
+	}
+
+	for (i = FEC_ENET_RX_FLOWS - 1; i >= 0; i--) {
+		flow = &fep->rx_flows[i];
+		if (flow->valid)
+			prio_queue[flow->vlan_prio] = flow->queue;
+	}
+
+	for (prio = 0; prio < ARRAY_SIZE(prio_queue); prio++) {
+		queue = prio_queue[prio];
+		if (!queue)
+			continue;
+		if (ncmp[queue] == RCMR_CMP_NUM)
+			return -ENOSPC;
+		rcmr[queue] |= RCMR_CMP_CFG(prio, ncmp[queue]);
+		ncmp[queue]++;
+	}
+
+	for (queue = 1; queue < fep->num_rx_queues; queue++) {
+		if (!ncmp[queue])
+			continue;
+		/* Unused compare fields repeat the first priority */
+		for (i = ncmp[queue]; i < RCMR_CMP_NUM; i++)
+			rcmr[queue] |= RCMR_CMP_CFG(rcmr[queue], i);
+		rcmr[queue] |= RCMR_MATCHEN;
+	}
+
+	memcpy(fep->rcmr, rcmr, sizeof(fep->rcmr));
+
+	return 0;
+}
+
+static int fec_enet_set_rx_flow(struct net_device *ndev, u32 location,
+				const struct fec_enet_rx_flow *flow)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_rx_flow old = fep->rx_flows[location];
+	int ret, i;
+
+	fep->rx_flows[location] = *flow;
+	ret = fec_enet_rx_flow_update(fep);
+	if (ret) {
+		fep->rx_flows[location] = old;
+		fec_enet_rx_flow_update(fep);
+		return ret;
+	}
+
+	/* Otherwise fec_enet_enable_ring() programs it on open */
+	if (netif_running(ndev))
+		for (i = 1; i < fep->num_rx_queues; i++)
+			writel(fep->rcmr[i], fep->hwp + FEC_RCMR(i));
+
+	return 0;
+}
+
+static int fec_enet_add_rx_flow(struct net_device *ndev,
+				struct ethtool_rx_flow_spec *fs)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_rx_flow flow;
+
+	if (fs->location >= FEC_ENET_RX_FLOWS)
+		return -EINVAL;
+
+	/* The classifier only looks at the VLAN priority */
+	if (fs->flow_type != (ETHER_FLOW | FLOW_EXT) ||
+	    memchr_inv(&fs->m_u, 0, sizeof(fs->m_u)) ||
+	    fs->m_ext.vlan_tci != htons(VLAN_PRIO_MASK) ||
+	    fs->m_ext.vlan_etype || fs->m_ext.data[0] || fs->m_ext.data[1])
+		return -EOPNOTSUPP;
+
+	if (fs->ring_cookie >= fep->num_rx_queues)
+		return -EINVAL;
+
+	flow.valid = true;
+	flow.vlan_prio = (ntohs(fs->h_ext.vlan_tci) & VLAN_PRIO_MASK) >>
+			 VLAN_PRIO_SHIFT;
+	flow.queue = fs->ring_cookie;
+
+	return fec_enet_set_rx_flow(ndev, fs->location, &flow);
+}
+
+static int fec_enet_del_rx_flow(struct net_device *ndev, u32 location)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_rx_flow flow = { .valid = false };
+
+	if (location >= FEC_ENET_RX_FLOWS || !fep->rx_flows[location].valid)
+		return -EINVAL;
+
+	return fec_enet_set_rx_flow(ndev, location, &flow);
+}
+
+static int fec_enet_get_rx_flow(struct fec_enet_private *fep,
+				struct ethtool_rx_flow_spec *fs)
+{
+	struct fec_enet_rx_flow *flow;
+
+	if (fs->location >= FEC_ENET_RX_FLOWS)
+		return -EINVAL;
+
+	flow = &fep->rx_flows[fs->location];
+	if (!flow->valid)
+		return -EINVAL;
+
+	memset(&fs->h_u, 0, sizeof(fs->h_u));
+	memset(&fs->m_u, 0, sizeof(fs->m_u));
+	memset(&fs->h_ext, 0, sizeof(fs->h_ext));
+	memset(&fs->m_ext, 0, sizeof(fs->m_ext));
+	fs->flow_type = ETHER_FLOW | FLOW_EXT;
+	fs->h_ext.vlan_tci = htons(flow->vlan_prio << VLAN_PRIO_SHIFT);
+	fs->m_ext.vlan_tci = htons(VLAN_PRIO_MASK);
+	fs->ring_cookie = flow->queue;
+
+	return 0;
+}
+
+static int fec_enet_get_rxnfc(struct net_device *ndev,
+			      struct ethtool_rxnfc *cmd, u32 *rule_locs)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	int i, cnt = 0;
+
+	switch (cmd->cmd) {
+	case ETHTOOL_GRXRINGS:
+		cmd->data = fep->num_rx_queues;
+		return 0;
+	case ETHTOOL_GRXCLSRLCNT:
+		for (i = 0; i < FEC_ENET_RX_FLOWS; i++)
+			cnt += fep->rx_flows[i].valid;
+		cmd->rule_cnt = cnt;
+		cmd->data = FEC_ENET_RX_FLOWS;
+		return 0;
+	case ETHTOOL_GRXCLSRULE:
+		return fec_enet_get_rx_flow(fep, &cmd->fs);
+	case ETHTOOL_GRXCLSRLALL:
+		for (i = 0; i < FEC_ENET_RX_FLOWS; i++) {
+			if (!fep->rx_flows[i].valid)
+				continue;
+			if (cnt == cmd->rule_cnt)
+				return -EMSGSIZE;
+			rule_locs[cnt++] = i;
+		}
+		cmd->rule_cnt = cnt;
+		cmd->data = FEC_ENET_RX_FLOWS;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int fec_enet_set_rxnfc(struct net_device *ndev,
+			      struct ethtool_rxnfc *cmd)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+
+	/* Only the AVB capable ENET has the RCMR classifier */
+	if (!(fep->quirks & FEC_QUIRK_HAS_AVB) || fep->num_rx_queues < 2)
+		return -EOPNOTSUPP;
+
+	switch (cmd->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		return fec_enet_add_rx_flow(ndev, &cmd->fs);
+	case ETHTOOL_SRXCLSRLDEL:
+		return fec_enet_del_rx_flow(ndev, cmd->fs.location);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static const struct ethtool_ops fec_enet_ethtool_ops = {
 	.get_drvinfo		= fec_enet_get_drvinfo,
 	.get_regs_len		= fec_enet_get_regs_len,
@@ -2626,6 +3607,8 @@ static const struct ethtool_ops fec_enet_ethtool_ops = {
 	.get_link		= ethtool_op_get_link,
 	.get_coalesce		= fec_enet_get_coalesce,
 	.set_coalesce		= fec_enet_set_coalesce,
+	.get_ringparam		= fec_enet_get_ringparam,
+	.set_ringparam		= fec_enet_set_ringparam,
 #ifndef CONFIG_M5272
 	.get_pauseparam		= fec_enet_get_pauseparam,
 	.set_pauseparam		= fec_enet_set_pauseparam,
@@ -2640,6 +3623,8 @@ static const struct ethtool_ops fec_enet_ethtool_ops = {
 	.set_wol		= fec_enet_set_wol,
 	.get_link_ksettings	= phy_ethtool_get_link_ksettings,
 	.set_link_ksettings	= phy_ethtool_set_link_ksettings,
+	.get_rxnfc		= fec_enet_get_rxnfc,
+	.set_rxnfc		= fec_enet_set_rxnfc,
 };
 
 static int fec_enet_ioctl(struct net_device *ndev, struct ifreq *rq, int cmd)
@@ -2677,15 +3662,8 @@ static void fec_enet_free_buffers(struct net_device *ndev)
 		rxq = fep->rx_queue[q];
 		bdp = rxq->bd.base;
 		for (i = 0; i < rxq->bd.ring_size; i++) {
-			skb = rxq->rx_skbuff[i];
-			rxq->rx_skbuff[i] = NULL;
-			if (skb) {
-				dma_unmap_single(&fep->pdev->dev,
-						 fec32_to_cpu(bdp->cbd_bufaddr),
-						 FEC_ENET_RX_FRSIZE - fep->rx_align,
-						 DMA_FROM_DEVICE);
-				dev_kfree_skb(skb);
-			}
+			fec_enet_free_rx_page(fep, &rxq->rx_buf[i]);
+			bdp->cbd_bufaddr = cpu_to_fec32(0);
 			bdp = fec_enet_get_nextdesc(bdp, &rxq->bd);
 		}
 	}
@@ -2694,11 +3672,20 @@ static void fec_enet_free_buffers(struct net_device *ndev)
 		txq = fep->tx_queue[q];
 		bdp = txq->bd.base;
 		for (i = 0; i < txq->bd.ring_size; i++) {
+			if (txq->tx_bounce[i])
+				dma_unmap_single(&fep->pdev->dev,
+						 txq->tx_bounce_dma[i],
+						 FEC_ENET_TX_FRSIZE,
+						 DMA_TO_DEVICE);
 			kfree(txq->tx_bounce[i]);
 			txq->tx_bounce[i] = NULL;
 			skb = txq->tx_skbuff[i];
 			txq->tx_skbuff[i] = NULL;
 			dev_kfree_skb(skb);
+			if (txq->tx_page[i]) {
+				put_page(txq->tx_page[i]);
+				txq->tx_page[i] = NULL;
+			}
 		}
 	}
 }
@@ -2731,6 +3718,8 @@ static int fec_enet_alloc_queue(struct net_device *ndev)
 	int ret = 0;
 	struct fec_enet_priv_tx_q *txq;
 
+	BUILD_BUG_ON(FEC_ENET_RX_USED > FEC_ENET_RX_FRSIZE);
+
 	for (i = 0; i < fep->num_tx_queues; i++) {
 		txq = kzalloc(sizeof(*txq), GFP_KERNEL);
 		if (!txq) {
@@ -2779,23 +3768,16 @@ fec_enet_alloc_rxq_buffers(struct net_device *ndev, unsigned int queue)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
 	unsigned int i;
-	struct sk_buff *skb;
 	struct bufdesc	*bdp;
 	struct fec_enet_priv_rx_q *rxq;
 
 	rxq = fep->rx_queue[queue];
 	bdp = rxq->bd.base;
 	for (i = 0; i < rxq->bd.ring_size; i++) {
-		skb = netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE);
-		if (!skb)
-			goto err_alloc;
-
-		if (fec_enet_new_rxbdp(ndev, bdp, skb)) {
-			dev_kfree_skb(skb);
+		if (fec_enet_alloc_rx_page(fep, &rxq->rx_buf[i], GFP_KERNEL))
 			goto err_alloc;
-		}
 
-		rxq->rx_skbuff[i] = skb;
+		fec_enet_set_rxbdp(bdp, &rxq->rx_buf[i]);
 		bdp->cbd_sc = cpu_to_fec16(BD_ENET_RX_EMPTY);
 
 		if (fep->bufdesc_ex) {
@@ -2831,6 +3813,16 @@ fec_enet_alloc_txq_buffers(struct net_device *ndev, unsigned int queue)
 		if (!txq->tx_bounce[i])
 			goto err_alloc;
 
+		txq->tx_bounce_dma[i] = dma_map_single(&fep->pdev->dev,
+						       txq->tx_bounce[i],
+						       FEC_ENET_TX_FRSIZE,
+						       DMA_TO_DEVICE);
+		if (dma_mapping_error(&fep->pdev->dev, txq->tx_bounce_dma[i])) {
+			kfree(txq->tx_bounce[i]);
+			txq->tx_bounce[i] = NULL;
+			goto err_alloc;
+		}
+
 		bdp->cbd_sc = cpu_to_fec16(0);
 		bdp->cbd_bufaddr = cpu_to_fec32(0);
 
@@ -2921,7 +3913,7 @@ fec_enet_open(struct net_device *ndev)
 	if (fep->quirks & FEC_QUIRK_ERR006687)
 		imx6q_cpuidle_fec_irqs_used();
 
-	napi_enable(&fep->napi);
+	fec_enet_napi_enable(fep);
 	phy_start(ndev->phydev);
 	netif_tx_start_all_queues(ndev);
 
@@ -2960,7 +3952,7 @@ fec_enet_close(struct net_device *ndev)
 	phy_stop(ndev->phydev);
 
 	if (netif_device_present(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(fep);
 		netif_tx_disable(ndev);
 		fec_stop(ndev);
 	}
@@ -3112,6 +4104,18 @@ static void fec_poll_controller(struct net_device *dev)
 }
 #endif
 
+static netdev_features_t fec_fix_features(struct net_device *netdev,
+	netdev_features_t features)
+{
+	/* The checksums are inserted in the TX FIFO, which only works for
+	 * frames stored there whole, not the cut-through jumbo ones.
+	 */
+	if (netdev->mtu > ETH_DATA_LEN)
+		features &= ~(NETIF_F_CSUM_MASK | NETIF_F_TSO);
+
+	return features;
+}
+
 static inline void fec_enet_set_netdev_features(struct net_device *netdev,
 	netdev_features_t features)
 {
@@ -3136,14 +4140,14 @@ static int fec_set_features(struct net_device *netdev,
 	netdev_features_t changed = features ^ netdev->features;
 
 	if (netif_running(netdev) && changed & NETIF_F_RXCSUM) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(fep);
 		netif_tx_lock_bh(netdev);
 		fec_stop(netdev);
 		fec_enet_set_netdev_features(netdev, features);
 		fec_restart(netdev);
 		netif_tx_wake_all_queues(netdev);
 		netif_tx_unlock_bh(netdev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(fep);
 	} else {
 		fec_enet_set_netdev_features(netdev, features);
 	}
@@ -3151,6 +4155,37 @@ static int fec_set_features(struct net_device *netdev,
 	return 0;
 }
 
+static int fec_enet_change_mtu(struct net_device *ndev, int new_mtu)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	int max_mtu = ETH_DATA_LEN;
+
+	if (fep->quirks & FEC_QUIRK_JUMBO_FRAME)
+		max_mtu = FEC_JUMBO_MAX_MTU;
+
+	if (new_mtu < 68 || new_mtu > max_mtu)
+		return -EINVAL;
+
+	/* XDP programs are only given single buffer frames */
+	if (fep->xdp_prog && new_mtu > ETH_DATA_LEN)
+		return -EOPNOTSUPP;
+
+	ndev->mtu = new_mtu;
+	netdev_update_features(ndev);
+
+	if (netif_running(ndev)) {
+		fec_enet_napi_disable(fep);
+		netif_tx_lock_bh(ndev);
+		fec_stop(ndev);
+		fec_restart(ndev);
+		netif_tx_wake_all_queues(ndev);
+		netif_tx_unlock_bh(ndev);
+		fec_enet_napi_enable(fep);
+	}
+
+	return 0;
+}
+
 u16 fec_enet_get_raw_vlan_tci(struct sk_buff *skb)
 {
 	struct vlan_ethhdr *vhdr;
@@ -3175,6 +4210,16 @@ u16 fec_enet_select_queue(struct net_device *ndev, struct sk_buff *skb,
 	if (!(id_entry->driver_data & FEC_QUIRK_HAS_AVB))
 		return skb_tx_hash(ndev, skb);
 
+	/* A DSA slave selected the queue through us on the untagged frame,
+	 * the switch tag now hides the VLAN header.
+	 */
+	if (netdev_uses_dsa(ndev) && skb->dev == ndev)
+		return skb_get_queue_mapping(skb);
+
+	/* mqprio owns the priority to queue mapping once configured */
+	if (netdev_get_num_tc(ndev))
+		return fallback(ndev, skb);
+
 	vlan_tag = fec_enet_get_raw_vlan_tci(skb);
 	if (!vlan_tag)
 		return vlan_tag;
@@ -3182,13 +4227,121 @@ u16 fec_enet_select_queue(struct net_device *ndev, struct sk_buff *skb,
 	return  fec_enet_vlan_pri_to_queue[vlan_tag >> 13];
 }
 
+static int fec_enet_xdp_setup(struct net_device *ndev, struct bpf_prog *prog)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct bpf_prog *old_prog;
+
+	if (prog && ndev->mtu > ETH_DATA_LEN)
+		return -EOPNOTSUPP;
+
+	/* The RX ring is always page based, so the program can simply be
+	 * swapped in, fec_enet_rx_queue() picks it up on its next run.
+	 */
+	old_prog = xchg(&fep->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int fec_enet_xdp(struct net_device *ndev, struct netdev_xdp *xdp)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return fec_enet_xdp_setup(ndev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!fep->xdp_prog;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int fec_enet_setup_mqprio(struct net_device *ndev, u8 num_tc)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	int i;
+
+	if (!num_tc) {
+		netdev_reset_tc(ndev);
+		return 0;
+	}
+
+	if (num_tc > fep->num_tx_queues)
+		return -EINVAL;
+
+	/* One hardware ring per traffic class, TC n on ring n */
+	netdev_set_num_tc(ndev, num_tc);
+	for (i = 0; i < num_tc; i++)
+		netdev_set_tc_queue(ndev, i, 1, i);
+
+	return 0;
+}
+
+static int fec_enet_setup_cbs(struct net_device *ndev,
+			      struct tc_cbs_qopt_offload *cbs)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	const struct platform_device_id *id_entry =
+			platform_get_device_id(fep->pdev);
+	int queue = cbs->queue;
+	int is;
+
+	/* Only the AVB class rings 1 and 2 have a credit based shaper */
+	if (!(id_entry->driver_data & FEC_QUIRK_HAS_AVB))
+		return -EOPNOTSUPP;
+
+	if (queue < 1 || queue >= fep->num_tx_queues)
+		return -EINVAL;
+
+	if (cbs->enable) {
+		if (cbs->idleslope <= 0)
+			return -EINVAL;
+
+		if (fep->speed) {
+			is = fec_enet_calc_idle_slope(cbs->idleslope,
+						      fep->speed);
+			if (is < 0)
+				return is;
+		}
+
+		fep->cbs_idleslope[queue] = cbs->idleslope;
+	} else {
+		fep->cbs_idleslope[queue] = 0;
+	}
+
+	/* Otherwise fec_enet_enable_ring() programs it on the next restart */
+	if (netif_running(ndev) && fep->link)
+		writel(DMA_CLASS_EN | fec_enet_idle_slope(fep, queue),
+		       fep->hwp + FEC_DMA_CFG(queue));
+
+	return 0;
+}
+
+static int fec_enet_setup_tc(struct net_device *ndev, u32 handle,
+			     __be16 proto, struct tc_to_netdev *tc)
+{
+	switch (tc->type) {
+	case TC_SETUP_MQPRIO:
+		return fec_enet_setup_mqprio(ndev, tc->tc);
+	case TC_SETUP_CBS:
+		return fec_enet_setup_cbs(ndev, tc->cbs);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static const struct net_device_ops fec_netdev_ops = {
 	.ndo_open		= fec_enet_open,
 	.ndo_stop		= fec_enet_close,
 	.ndo_start_xmit		= fec_enet_start_xmit,
 	.ndo_select_queue       = fec_enet_select_queue,
+	.ndo_get_stats		= fec_enet_get_stats,
 	.ndo_set_rx_mode	= set_multicast_list,
-	.ndo_change_mtu		= eth_change_mtu,
+	.ndo_change_mtu		= fec_enet_change_mtu,
 	.ndo_validate_addr	= eth_validate_addr,
 	.ndo_tx_timeout		= fec_timeout,
 	.ndo_set_mac_address	= fec_set_mac_address,
@@ -3196,7 +4349,10 @@ static const struct net_device_ops fec_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= fec_poll_controller,
 #endif
+	.ndo_fix_features	= fec_fix_features,
 	.ndo_set_features	= fec_set_features,
+	.ndo_xdp		= fec_enet_xdp,
+	.ndo_setup_tc		= fec_enet_setup_tc,
 };
 
 static const unsigned short offset_des_active_rxq[] = {
@@ -3217,7 +4373,7 @@ static int fec_enet_init(struct net_device *ndev)
 	struct bufdesc *cbd_base;
 	dma_addr_t bd_dma;
 	int bd_size;
-	unsigned int i;
+	unsigned int i, j;
 	unsigned dsize = fep->bufdesc_ex ? sizeof(struct bufdesc_ex) :
 			sizeof(struct bufdesc);
 	unsigned dsize_log2 = __fls(dsize);
@@ -3288,8 +4444,20 @@ static int fec_enet_init(struct net_device *ndev)
 	ndev->netdev_ops = &fec_netdev_ops;
 	ndev->ethtool_ops = &fec_enet_ethtool_ops;
 
+	spin_lock_init(&fep->imask_lock);
 	writel(FEC_RX_DISABLED_IMASK, fep->hwp + FEC_IMASK);
-	netif_napi_add(ndev, &fep->napi, fec_enet_rx_napi, NAPI_POLL_WEIGHT);
+	for (i = 0; i < fep->num_rx_queues; i++) {
+		struct fec_enet_priv_rx_q *rxq = fep->rx_queue[i];
+
+		rxq->napi_events = FEC_ENET_RXF_Q(i);
+		for (j = i; j < fep->num_tx_queues; j += fep->num_rx_queues)
+			rxq->napi_events |= FEC_ENET_TXF_Q(j);
+
+		netif_napi_add(ndev, &rxq->napi, fec_enet_rx_napi,
+			       NAPI_POLL_WEIGHT);
+	}
+
+	fec_enet_rx_flow_update(fep);
 
 	if (fep->quirks & FEC_QUIRK_HAS_VLAN)
 		/* enable hw VLAN support */
@@ -3676,6 +4844,13 @@ fec_probe(struct platform_device *pdev)
 	device_init_wakeup(&ndev->dev, fep->wol_flag &
 			   FEC_WOL_HAS_MAGIC_PACKET);
 
+	/*
+	 * Bringing the PHY back up dominates the resume time, let it run
+	 * alongside the other devices. A shared mii_bus is ordered in
+	 * fec_suspend() and fec_resume().
+	 */
+	device_enable_async_suspend(&pdev->dev);
+
 	if (fep->bufdesc_ex && fep->ptp_clock)
 		netdev_info(ndev, "registered PHC device %d\n", fep->dev_id);
 
@@ -3727,6 +4902,8 @@ fec_drv_remove(struct platform_device *pdev)
 	cancel_work_sync(&fep->tx_timeout_work);
 	fec_ptp_stop(pdev);
 	unregister_netdev(ndev);
+	if (fep->xdp_prog)
+		bpf_prog_put(fep->xdp_prog);
 	fec_enet_mii_remove(fep);
 	if (fep->reg_phy)
 		regulator_disable(fep->reg_phy);
@@ -3744,12 +4921,16 @@ static int __maybe_unused fec_suspend(struct device *dev)
 	struct fec_enet_private *fep = netdev_priv(ndev);
 	int ret = 0;
 
+	/* the mii_bus must stay up until its other user is done with it */
+	if (fep->mii_bus_user)
+		device_pm_wait_for_dev(dev, fep->mii_bus_user);
+
 	rtnl_lock();
 	if (netif_running(ndev)) {
 		if (fep->wol_flag & FEC_WOL_FLAG_ENABLE)
 			fep->wol_flag |= FEC_WOL_FLAG_SLEEP_ON;
 		phy_stop(ndev->phydev);
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(fep);
 		netif_tx_lock_bh(ndev);
 		netif_device_detach(ndev);
 		netif_tx_unlock_bh(ndev);
@@ -3795,6 +4976,10 @@ static int __maybe_unused fec_resume(struct device *dev)
 	int ret = 0;
 	int val;
 
+	/* the phy may sit on the mii_bus of the other fec */
+	if (fep->mii_bus && fep->mii_bus->parent != dev)
+		device_pm_wait_for_dev(dev, fep->mii_bus->parent);
+
 	if (fep->reg_phy && !(fep->wol_flag & FEC_WOL_FLAG_ENABLE)) {
 		ret = regulator_enable(fep->reg_phy);
 		if (ret)
@@ -3828,7 +5013,7 @@ static int __maybe_unused fec_resume(struct device *dev)
 		netif_tx_lock_bh(ndev);
 		netif_device_attach(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(fep);
 		phy_start(ndev->phydev);
 	} else if (fep->mii_bus_share && !ndev->phydev) {
 		pinctrl_pm_select_default_state(&fep->pdev->dev);
@@ -0,0 +1,85 @@
+/*
+ * Fast Ethernet Controller (FEC) driver tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ */
+
+#if !defined(__FEC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __FEC_TRACE_H
+
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM fec
+
+TRACE_EVENT(fec_rx_desc,
+	TP_PROTO(struct net_device *ndev, u16 queue, int index,
+		 unsigned short status, unsigned short len),
+	TP_ARGS(ndev, queue, index, status, len),
+	TP_STRUCT__entry(
+		__string(name, ndev->name)
+		__field(u16, queue)
+		__field(int, index)
+		__field(unsigned short, status)
+		__field(unsigned short, len)
+	),
+	TP_fast_assign(
+		__assign_str(name, ndev->name);
+		__entry->queue = queue;
+		__entry->index = index;
+		__entry->status = status;
+		__entry->len = len;
+	),
+	TP_printk("%s: queue=%u index=%d status=0x%04x len=%u",
+		  __get_str(name), __entry->queue, __entry->index,
+		  __entry->status, __entry->len)
+);
+
+DECLARE_EVENT_CLASS(fec_tx_skb,
+	TP_PROTO(struct net_device *ndev, u16 queue, int index,
+		 struct sk_buff *skb),
+	TP_ARGS(ndev, queue, index, skb),
+	TP_STRUCT__entry(
+		__string(name, ndev->name)
+		__field(u16, queue)
+		__field(int, index)
+		__field(const void *, skbaddr)
+		__field(unsigned int, len)
+	),
+	TP_fast_assign(
+		__assign_str(name, ndev->name);
+		__entry->queue = queue;
+		__entry->index = index;
+		__entry->skbaddr = skb;
+		__entry->len = skb->len;
+	),
+	TP_printk("%s: queue=%u index=%d skbaddr=%p len=%u",
+		  __get_str(name), __entry->queue, __entry->index,
+		  __entry->skbaddr, __entry->len)
+);
+
+DEFINE_EVENT(fec_tx_skb, fec_tx_submit,
+	TP_PROTO(struct net_device *ndev, u16 queue, int index,
+		 struct sk_buff *skb),
+	TP_ARGS(ndev, queue, index, skb)
+);
+
+DEFINE_EVENT(fec_tx_skb, fec_tx_reclaim,
+	TP_PROTO(struct net_device *ndev, u16 queue, int index,
+		 struct sk_buff *skb),
+	TP_ARGS(ndev, queue, index, skb)
+);
+
+#endif /* __FEC_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE fec_trace
+#include <trace/define_trace.h>
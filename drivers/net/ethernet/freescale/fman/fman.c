@@ -34,6 +34,7 @@
 
 #include "fman.h"
 #include "fman_muram.h"
+#include "fman_keygen.h"
 
 #include <linux/fsl/guts.h>
 #include <linux/slab.h>
@@ -56,6 +57,7 @@
 /* Modules registers offsets */
 #define BMI_OFFSET		0x00080000
 #define QMI_OFFSET		0x00080400
+#define KG_OFFSET		0x000C1000
 #define DMA_OFFSET		0x000C2000
 #define FPM_OFFSET		0x000C3000
 #define IMEM_OFFSET		0x000C4000
@@ -606,6 +608,7 @@ struct fman {
 	struct fman_bmi_regs __iomem *bmi_regs;
 	struct fman_qmi_regs __iomem *qmi_regs;
 	struct fman_dma_regs __iomem *dma_regs;
+	struct fman_kg_regs __iomem *kg_regs;
 	fman_exceptions_cb *exception_cb;
 	fman_bus_error_cb *bus_error_cb;
 	/* Spinlock for FMan use */
@@ -625,6 +628,9 @@ struct fman {
 	u32 liodn_offset[64];
 
 	struct fman_dts_params dts_params;
+
+	/* KeyGen, for hash distribution of Rx frames */
+	struct fman_keygen *keygen;
 };
 
 static irqreturn_t fman_exceptions(struct fman *fman,
@@ -1793,6 +1799,7 @@ static int fman_config(struct fman *fman)
 	fman->bmi_regs = base_addr + BMI_OFFSET;
 	fman->qmi_regs = base_addr + QMI_OFFSET;
 	fman->dma_regs = base_addr + DMA_OFFSET;
+	fman->kg_regs = base_addr + KG_OFFSET;
 	fman->base_addr = base_addr;
 
 	spin_lock_init(&fman->spinlock);
@@ -2054,6 +2061,13 @@ static int fman_init(struct fman *fman)
 	/* Init QMI Registers */
 	qmi_init(fman->qmi_regs, fman->cfg);
 
+	/* Init KeyGen, no port is bound to a scheme yet */
+	fman->keygen = keygen_init(fman->kg_regs);
+	if (!fman->keygen) {
+		free_init_resources(fman);
+		return -ENOMEM;
+	}
+
 	err = enable(fman, cfg);
 	if (err != 0)
 		return err;
@@ -2245,6 +2259,33 @@ return_err:
 }
 EXPORT_SYMBOL(fman_set_port_params);
 
+/**
+ * fman_set_port_hashing
+ * @fman:		A Pointer to FMan device
+ * @port_id:		HW port id of an Rx port
+ * @hash_base_fqid:	First FQ of the distribution range
+ * @hash_size:		Number of FQs in the range, a power of 2
+ *
+ * Used by FMan Port to have the KeyGen spread its frames over a range
+ * of FQs by a hash of the IP addresses and L4 ports.
+ *
+ * Return: 0 on success; Error code otherwise.
+ */
+int fman_set_port_hashing(struct fman *fman, u8 port_id, u32 hash_base_fqid,
+			  u32 hash_size)
+{
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&fman->spinlock, flags);
+	err = keygen_port_hashing_init(fman->keygen, port_id, hash_base_fqid,
+				       hash_size);
+	spin_unlock_irqrestore(&fman->spinlock, flags);
+
+	return err;
+}
+EXPORT_SYMBOL(fman_set_port_hashing);
+
 /**
  * fman_reset_mac
  * @fman:	A Pointer to FMan device
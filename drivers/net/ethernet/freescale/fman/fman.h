@@ -304,6 +304,9 @@ void fman_unregister_intr(struct fman *fman, enum fman_event_modules mod,
 int fman_set_port_params(struct fman *fman,
 			 struct fman_port_init_params *port_params);
 
+int fman_set_port_hashing(struct fman *fman, u8 port_id, u32 hash_base_fqid,
+			  u32 hash_size);
+
 int fman_reset_mac(struct fman *fman, u8 mac_id);
 
 u16 fman_get_clock_freq(struct fman *fman);
@@ -62,6 +62,7 @@
 
 #define BMI_PORT_REGS_OFFSET				0
 #define QMI_PORT_REGS_OFFSET				0x400
+#define HWP_PORT_REGS_OFFSET				0x800
 
 /* Default values */
 #define DFLT_PORT_BUFFER_PREFIX_CONTEXT_DATA_ALIGN		\
@@ -182,6 +183,8 @@
 #define NIA_ENG_BMI					0x00500000
 #define NIA_ENG_QMI_ENQ					0x00540000
 #define NIA_ENG_QMI_DEQ					0x00580000
+#define NIA_ENG_HWP					0x00440000
+#define NIA_ENG_HWK					0x00480000
 
 #define NIA_BMI_AC_ENQ_FRAME				0x00000002
 #define NIA_BMI_AC_TX_RELEASE				0x000002C0
@@ -189,6 +192,14 @@
 #define NIA_BMI_AC_TX					0x00000274
 #define NIA_BMI_AC_FETCH_ALL_FRAME			0x0000020c
 
+/* HW parser */
+#define HWP_HXS_COUNT					16
+#define HWP_HXS_TCP_OFFSET				0xA
+#define HWP_HXS_UDP_OFFSET				0xB
+#define HWP_HXS_SH_PAD_REM				0x80000000
+#define HWP_HXS_PCAC_PSTAT				0x00000100
+#define HWP_HXS_PCAC_PSTOP				0x00000001
+
 /* Port IDs */
 #define TX_10G_PORT_BASE		0x30
 #define RX_10G_PORT_BASE		0x10
@@ -346,6 +357,16 @@ enum fman_port_color {
 	FMAN_PORT_COLOR_OVERRIDE	/* Ignore color */
 };
 
+/* HW parser port registers */
+struct fman_port_hwp_regs {
+	struct {
+		u32 ssa;	/* Soft Sequence Attachment */
+		u32 lcv;	/* Line-up Enable Confirmation Mask */
+	} pmda[HWP_HXS_COUNT];	/* Parse Memory Direct Access Registers */
+	u32 reserved080[(0x3f8 - 0x080) / 4];	/* (0x080-0x3f7) */
+	u32 fmpr_pcac;		/* Configuration Access Control */
+};
+
 /* QMI dequeue from the SP channel - types */
 enum fman_port_deq_type {
 	FMAN_PORT_DEQ_BY_PRI,
@@ -409,12 +430,19 @@ struct fman_port_cfg {
 
 	enum fman_port_dma_swap dma_swap_data;
 	enum fman_port_color color;
+
+	/* FQ range the KeyGen hashes frames over, no hashing if 0 */
+	u32 pcd_base_fqid;
+	u32 pcd_fqs_count;
 };
 
 struct fman_port_rx_pools_params {
 	u8 num_of_pools;
 	u16 second_largest_buf_size;
 	u16 largest_buf_size;
+	/* the pools in ascending order of buffer size, as in fmbm_ebmpi */
+	u8 bpid[FMAN_PORT_MAX_EXT_POOLS_NUM];
+	u16 size[FMAN_PORT_MAX_EXT_POOLS_NUM];
 };
 
 struct fman_port_dts_params {
@@ -436,6 +464,7 @@ struct fman_port {
 
 	union fman_port_bmi_regs __iomem *bmi_regs;
 	struct fman_port_qmi_regs __iomem *qmi_regs;
+	struct fman_port_hwp_regs __iomem *hwp_regs;
 
 	struct fman_sp_buffer_offsets buffer_offsets;
 
@@ -521,8 +550,15 @@ static int init_bmi_rx(struct fman_port *port)
 	/* NIA */
 	tmp = (u32)cfg->rx_fd_bits << BMI_NEXT_ENG_FD_BITS_SHIFT;
 
-	tmp |= NIA_ENG_BMI | NIA_BMI_AC_ENQ_FRAME;
-	iowrite32be(tmp, &regs->fmbm_rfne);
+	if (cfg->pcd_fqs_count) {
+		/* Parse the frames and hash them in the KeyGen */
+		tmp |= NIA_ENG_HWP;
+		iowrite32be(tmp, &regs->fmbm_rfne);
+		iowrite32be(NIA_ENG_HWK, &regs->fmbm_rfpne);
+	} else {
+		tmp |= NIA_ENG_BMI | NIA_BMI_AC_ENQ_FRAME;
+		iowrite32be(tmp, &regs->fmbm_rfne);
+	}
 
 	/* Enqueue NIA */
 	iowrite32be(NIA_ENG_QMI_ENQ | NIA_ORDER_RESTOR, &regs->fmbm_rfene);
@@ -665,10 +701,60 @@ static int init_qmi(struct fman_port *port)
 	return 0;
 }
 
+static int hwp_stop(struct fman_port_hwp_regs __iomem *regs)
+{
+	int count = 1000;
+
+	iowrite32be(HWP_HXS_PCAC_PSTOP, &regs->fmpr_pcac);
+
+	while ((ioread32be(&regs->fmpr_pcac) & HWP_HXS_PCAC_PSTAT) && --count)
+		udelay(10);
+	if (!count)
+		return -EBUSY;
+
+	return 0;
+}
+
+static void hwp_start(struct fman_port_hwp_regs __iomem *regs)
+{
+	iowrite32be(0, &regs->fmpr_pcac);
+}
+
+static int init_hwp(struct fman_port *port)
+{
+	struct fman_port_hwp_regs __iomem *regs = port->hwp_regs;
+	int err, i;
+
+	err = hwp_stop(regs);
+	if (err)
+		return err;
+
+	for (i = 0; i < HWP_HXS_COUNT; i++) {
+		/* enable HXS error reporting into FD[STATUS] PHE */
+		iowrite32be(0x00000000, &regs->pmda[i].ssa);
+		iowrite32be(0xffffffff, &regs->pmda[i].lcv);
+	}
+
+	/* Short packet padding removal from checksum calculation */
+	iowrite32be(HWP_HXS_SH_PAD_REM, &regs->pmda[HWP_HXS_TCP_OFFSET].ssa);
+	iowrite32be(HWP_HXS_SH_PAD_REM, &regs->pmda[HWP_HXS_UDP_OFFSET].ssa);
+
+	hwp_start(regs);
+
+	return 0;
+}
+
 static int init(struct fman_port *port)
 {
 	int err;
 
+	/* Init the parser before frames are sent to it */
+	if (port->port_type == FMAN_PORT_TYPE_RX && port->cfg->pcd_fqs_count) {
+		err = init_hwp(port);
+		if (err)
+			return err;
+	}
+
 	/* Init BMI registers */
 	switch (port->port_type) {
 	case FMAN_PORT_TYPE_RX:
@@ -863,6 +949,8 @@ static int set_ext_buffer_pools(struct fman_port *port)
 	for (i = 0; i < ext_buf_pools->num_of_pools_used; i++) {
 		bpools.bpool[i].bpid = ordered_array[i];
 		bpools.bpool[i].size = sizes_array[ordered_array[i]];
+		port->rx_pools_params.bpid[i] = bpools.bpool[i].bpid;
+		port->rx_pools_params.size[i] = bpools.bpool[i].size;
 	}
 
 	/* save pools parameters for later use */
@@ -1206,6 +1294,10 @@ static void set_rx_dflt_cfg(struct fman_port *port,
 		port_params->specific_params.rx_params.err_fqid;
 	port->cfg->dflt_fqid =
 		port_params->specific_params.rx_params.dflt_fqid;
+	port->cfg->pcd_base_fqid =
+		port_params->specific_params.rx_params.pcd_base_fqid;
+	port->cfg->pcd_fqs_count =
+		port_params->specific_params.rx_params.pcd_fqs_count;
 }
 
 static void set_tx_dflt_cfg(struct fman_port *port,
@@ -1276,6 +1368,7 @@ int fman_port_config(struct fman_port *port, struct fman_port_params *params)
 	/* set memory map pointers */
 	port->bmi_regs = base_addr + BMI_PORT_REGS_OFFSET;
 	port->qmi_regs = base_addr + QMI_PORT_REGS_OFFSET;
+	port->hwp_regs = base_addr + HWP_PORT_REGS_OFFSET;
 
 	port->max_frame_length = DFLT_PORT_MAX_FRAME_LENGTH;
 	/* resource distribution. */
@@ -1404,6 +1497,17 @@ int fman_port_init(struct fman_port *port)
 	if (err)
 		return err;
 
+	if (port->port_type == FMAN_PORT_TYPE_RX && cfg->pcd_fqs_count) {
+		err = fman_set_port_hashing(port->fm, port->port_id,
+					    cfg->pcd_base_fqid,
+					    cfg->pcd_fqs_count);
+		if (err) {
+			dev_err(port->dev, "%s: KeyGen hashing setup failed\n",
+				__func__);
+			return err;
+		}
+	}
+
 	err = init_low_level_driver(port);
 	if (err)
 		return err;
@@ -1588,6 +1692,123 @@ int fman_port_enable(struct fman_port *port)
 }
 EXPORT_SYMBOL(fman_port_enable);
 
+/**
+ * fman_port_use_kg_hash
+ * port:	A pointer to a FM Port module.
+ * enable:	true to spread the frames over the hash FQs
+ *
+ * Switch an Rx port configured with a PCD FQ range between the KeyGen hash
+ * distribution and the default FQ, e.g. when Rx hashing is turned off.
+ *
+ * Allowed only following fman_port_init().
+ *
+ * Return: 0 on success; Error code otherwise.
+ */
+int fman_port_use_kg_hash(struct fman_port *port, bool enable)
+{
+	if (!is_init_done(port->cfg))
+		return -EINVAL;
+
+	if (port->port_type != FMAN_PORT_TYPE_RX)
+		return -EINVAL;
+
+	if (enable)
+		/* After the Parser frames go to KeyGen */
+		iowrite32be(NIA_ENG_HWK, &port->bmi_regs->rx.fmbm_rfpne);
+	else
+		/* After the Parser frames go to BMI */
+		iowrite32be(NIA_ENG_BMI | NIA_BMI_AC_ENQ_FRAME,
+			    &port->bmi_regs->rx.fmbm_rfpne);
+
+	return 0;
+}
+EXPORT_SYMBOL(fman_port_use_kg_hash);
+
+/**
+ * fman_port_get_hash_result_offset
+ * port:	A pointer to a FM Port module.
+ * offset:	hash result offset in the buffer
+ *
+ * Get the offset of the KeyGen hash result in the Rx buffers, so the
+ * hash can be handed to the stack with the frame.
+ *
+ * Allowed only following fman_port_init().
+ *
+ * Return: 0 on success; Error code otherwise.
+ */
+int fman_port_get_hash_result_offset(struct fman_port *port, u32 *offset)
+{
+	if (port->buffer_offsets.hash_result_offset == ILLEGAL_BASE)
+		return -EINVAL;
+
+	*offset = port->buffer_offsets.hash_result_offset;
+
+	return 0;
+}
+EXPORT_SYMBOL(fman_port_get_hash_result_offset);
+
+/**
+ * fman_port_get_recycle_bpid
+ * port:	A pointer to a FM Rx Port module.
+ * buf_size:	Size of the buffer to recycle
+ * bpid:	Out parameter, pool the buffer can be released to
+ *
+ * Find the largest of the port's Rx external pools whose buffer size a buffer
+ * of buf_size bytes covers, so a buffer done with (e.g. at Tx confirmation)
+ * can be released to the BMan pool instead of freeing it and allocating a new
+ * one to refill the pool.
+ *
+ * Allowed only following fman_port_init().
+ *
+ * Return: 0 on success; -ENOENT if the buffer is too small for any pool.
+ */
+int fman_port_get_recycle_bpid(struct fman_port *port, u32 buf_size, u8 *bpid)
+{
+	struct fman_port_rx_pools_params *pools = &port->rx_pools_params;
+	int i;
+
+	if (!is_init_done(port->cfg) || port->port_type != FMAN_PORT_TYPE_RX)
+		return -EINVAL;
+
+	for (i = pools->num_of_pools - 1; i >= 0; i--) {
+		if (buf_size >= pools->size[i]) {
+			*bpid = pools->bpid[i];
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+EXPORT_SYMBOL(fman_port_get_recycle_bpid);
+
+/**
+ * fman_port_get_bpool_alloc_count
+ * port:	A pointer to a FM Rx Port module.
+ * bpid:	One of the port's external pools
+ *
+ * Read the free running count of buffers the port has taken from the pool,
+ * so the pool can be refilled by what was actually consumed.
+ *
+ * Allowed only following fman_port_init().
+ *
+ * Return: the allocate counter, 0 if the pool is not used by the port.
+ */
+u32 fman_port_get_bpool_alloc_count(struct fman_port *port, u8 bpid)
+{
+	struct fman_port_rx_pools_params *pools = &port->rx_pools_params;
+	int i;
+
+	if (!is_init_done(port->cfg) || port->port_type != FMAN_PORT_TYPE_RX)
+		return 0;
+
+	for (i = 0; i < pools->num_of_pools; i++)
+		if (pools->bpid[i] == bpid)
+			return ioread32be(&port->bmi_regs->rx.fmbm_acnt[i]);
+
+	return 0;
+}
+EXPORT_SYMBOL(fman_port_get_bpool_alloc_count);
+
 /**
  * fman_port_bind
  * dev:		FMan Port OF device pointer
@@ -104,6 +104,12 @@ struct fman_port_rx_params {
 	 * (up to FMAN_PORT_MAX_EXT_POOLS_NUM), and their sizes.
 	 */
 	struct fman_ext_pools ext_buf_pools;
+	/* FQ range the KeyGen spreads the frames over by a hash of the IP
+	 * addresses and L4 ports. pcd_fqs_count must be a power of 2 and
+	 * pcd_base_fqid aligned to it; 0 keeps all frames on dflt_fqid.
+	 */
+	u32 pcd_base_fqid;
+	u32 pcd_fqs_count;
 };
 
 /* A structure for additional non-Rx port parameters */
@@ -146,6 +152,14 @@ int fman_port_enable(struct fman_port *port);
 
 u32 fman_port_get_qman_channel_id(struct fman_port *port);
 
+int fman_port_use_kg_hash(struct fman_port *port, bool enable);
+
+int fman_port_get_hash_result_offset(struct fman_port *port, u32 *offset);
+
+int fman_port_get_recycle_bpid(struct fman_port *port, u32 buf_size, u8 *bpid);
+
+u32 fman_port_get_bpool_alloc_count(struct fman_port *port, u8 bpid);
+
 struct fman_port *fman_port_bind(struct device *dev);
 
 #endif /* __FMAN_PORT_H */
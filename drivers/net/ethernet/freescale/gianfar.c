@@ -86,6 +86,8 @@
 #include <linux/udp.h>
 #include <linux/in.h>
 #include <linux/net_tstamp.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
 
 #include <asm/io.h>
 #ifdef CONFIG_PPC
@@ -120,6 +122,7 @@ static void gfar_alloc_rx_buffs(struct gfar_priv_rx_q *rx_queue,
 				int alloc_cnt);
 static int gfar_set_mac_address(struct net_device *dev);
 static int gfar_change_mtu(struct net_device *dev, int new_mtu);
+static int gfar_xdp(struct net_device *dev, struct netdev_xdp *xdp);
 static irqreturn_t gfar_error(int irq, void *dev_id);
 static irqreturn_t gfar_transmit(int irq, void *dev_id);
 static irqreturn_t gfar_interrupt(int irq, void *dev_id);
@@ -504,6 +507,7 @@ static const struct net_device_ops gfar_netdev_ops = {
 	.ndo_get_stats = gfar_get_stats,
 	.ndo_set_mac_address = gfar_set_mac_addr,
 	.ndo_validate_addr = eth_validate_addr,
+	.ndo_xdp = gfar_xdp,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller = gfar_netpoll,
 #endif
@@ -1490,6 +1494,8 @@ static int gfar_remove(struct platform_device *ofdev)
 	unmap_group_regs(priv);
 	gfar_free_rx_queues(priv);
 	gfar_free_tx_queues(priv);
+	if (priv->xdp_prog)
+		bpf_prog_put(priv->xdp_prog);
 	free_gfar_dev(priv);
 
 	return 0;
@@ -2607,6 +2613,12 @@ static int gfar_change_mtu(struct net_device *dev, int new_mtu)
 		return -EINVAL;
 	}
 
+	/* XDP needs every frame in a single Rx buffer */
+	if (priv->xdp_prog && new_mtu > GFAR_XDP_MAX_MTU) {
+		netif_err(priv, drv, dev, "MTU too large for XDP\n");
+		return -EINVAL;
+	}
+
 	while (test_and_set_bit_lock(GFAR_RESETTING, &priv->state))
 		cpu_relax();
 
@@ -3020,6 +3032,89 @@ static struct sk_buff *gfar_get_next_rxbuff(struct gfar_priv_rx_q *rx_queue,
 	return skb;
 }
 
+/* Send an XDP_TX frame back out on the Tx queue with the index of the Rx
+ * queue it came in on.  The frame already sits in an skb built around its
+ * Rx buffer, so it goes through the regular xmit and Tx cleanup paths and
+ * its half page is recycled or freed with the skb.
+ */
+static void gfar_xdp_tx(struct net_device *ndev, struct sk_buff *skb,
+			u16 qindex)
+{
+	struct gfar_private *priv = netdev_priv(ndev);
+	struct netdev_queue *txq;
+
+	if (qindex >= priv->num_tx_queues)
+		qindex = 0;
+
+	skb_set_queue_mapping(skb, qindex);
+	txq = netdev_get_tx_queue(ndev, qindex);
+
+	/* the ring is shared with the stack */
+	__netif_tx_lock(txq, smp_processor_id());
+	if (netif_xmit_stopped(txq) ||
+	    gfar_start_xmit(skb, ndev) != NETDEV_TX_OK) {
+		dev_kfree_skb_any(skb);
+		ndev->stats.tx_dropped++;
+	}
+	__netif_tx_unlock(txq);
+}
+
+/* Run the XDP program on the single buffer frame at next_to_clean.
+ * Returns true if the program consumed the frame, with its buffer either
+ * given straight back to the ring or sent out with XDP_TX.
+ */
+static bool gfar_run_xdp(struct gfar_priv_rx_q *rx_queue,
+			 struct bpf_prog *prog, u32 lstatus)
+{
+	struct gfar_rx_buff *rxb = &rx_queue->rx_buff[rx_queue->next_to_clean];
+	struct net_device *ndev = rx_queue->ndev;
+	struct gfar_private *priv = netdev_priv(ndev);
+	unsigned int size = (lstatus & BD_LENGTH_MASK) - ETH_FCS_LEN;
+	unsigned int hlen = priv->padding;
+	struct sk_buff *skb;
+	struct xdp_buff xdp;
+	void *va;
+	u32 act;
+
+	if (priv->uses_rxfcb)
+		hlen += GMAC_FCB_LEN;
+
+	dma_sync_single_range_for_cpu(rx_queue->dev, rxb->dma, rxb->page_offset,
+				      GFAR_RXB_TRUESIZE, DMA_FROM_DEVICE);
+
+	/* skip the FCB and the time stamp, the program sees the frame */
+	va = page_address(rxb->page) + rxb->page_offset + RXBUF_ALIGNMENT;
+	xdp.data = va + hlen;
+	xdp.data_end = va + size;
+
+	act = bpf_prog_run_xdp(prog, &xdp);
+	switch (act) {
+	case XDP_PASS:
+		return false;
+	case XDP_TX:
+		skb = gfar_get_next_rxbuff(rx_queue, lstatus, NULL);
+		if (unlikely(!skb)) {
+			ndev->stats.tx_dropped++;
+			break;
+		}
+		skb_pull(skb, hlen);
+		gfar_xdp_tx(ndev, skb, rx_queue->qindex);
+		return true;
+	default:
+		bpf_warn_invalid_xdp_action(act);
+		/* fall through */
+	case XDP_ABORTED:
+	case XDP_DROP:
+		break;
+	}
+
+	/* the buffer was not handed on, give it back to the ring as is */
+	gfar_reuse_rx_page(rx_queue, rxb);
+	rxb->page = NULL;
+
+	return true;
+}
+
 static inline void gfar_rx_checksum(struct sk_buff *skb, struct rxfcb *fcb)
 {
 	/* If valid headers were found, and valid sums
@@ -3089,11 +3184,16 @@ int gfar_clean_rx_ring(struct gfar_priv_rx_q *rx_queue, int rx_work_limit)
 	struct sk_buff *skb = rx_queue->skb;
 	int cleaned_cnt = gfar_rxbd_unused(rx_queue);
 	unsigned int total_bytes = 0, total_pkts = 0;
+	struct bpf_prog *xdp_prog;
+
+	rcu_read_lock();
+	xdp_prog = READ_ONCE(priv->xdp_prog);
 
 	/* Get the first full descriptor */
 	i = rx_queue->next_to_clean;
 
 	while (rx_work_limit--) {
+		bool xdp_done = false;
 		u32 lstatus;
 
 		if (cleaned_cnt >= GFAR_RX_BUFF_ALLOC) {
@@ -3109,10 +3209,23 @@ int gfar_clean_rx_ring(struct gfar_priv_rx_q *rx_queue, int rx_work_limit)
 		/* order rx buffer descriptor reads */
 		rmb();
 
+		if (xdp_prog && !skb &&
+		    (lstatus & BD_LFLAG(RXBD_LAST)) &&
+		    !(lstatus & BD_LFLAG(RXBD_ERR))) {
+			xdp_done = gfar_run_xdp(rx_queue, xdp_prog, lstatus);
+			if (xdp_done) {
+				total_pkts++;
+				total_bytes += (lstatus & BD_LENGTH_MASK) -
+					       ETH_FCS_LEN;
+			}
+		}
+
 		/* fetch next to clean buffer from the ring */
-		skb = gfar_get_next_rxbuff(rx_queue, lstatus, skb);
-		if (unlikely(!skb))
-			break;
+		if (!xdp_done) {
+			skb = gfar_get_next_rxbuff(rx_queue, lstatus, skb);
+			if (unlikely(!skb))
+				break;
+		}
 
 		cleaned_cnt++;
 		howmany++;
@@ -3122,6 +3235,9 @@ int gfar_clean_rx_ring(struct gfar_priv_rx_q *rx_queue, int rx_work_limit)
 
 		rx_queue->next_to_clean = i;
 
+		if (xdp_done)
+			continue;
+
 		/* fetch next buffer if not the last in frame */
 		if (!(lstatus & BD_LFLAG(RXBD_LAST)))
 			continue;
@@ -3150,6 +3266,8 @@ int gfar_clean_rx_ring(struct gfar_priv_rx_q *rx_queue, int rx_work_limit)
 		skb = NULL;
 	}
 
+	rcu_read_unlock();
+
 	/* Store incomplete frames for completion */
 	rx_queue->skb = skb;
 
@@ -3169,6 +3287,42 @@ int gfar_clean_rx_ring(struct gfar_priv_rx_q *rx_queue, int rx_work_limit)
 	return howmany;
 }
 
+static int gfar_xdp_setup(struct net_device *ndev, struct bpf_prog *prog)
+{
+	struct gfar_private *priv = netdev_priv(ndev);
+	struct bpf_prog *old_prog;
+
+	if (prog && ndev->mtu > GFAR_XDP_MAX_MTU) {
+		netdev_warn(ndev, "MTU too large for XDP, %d max\n",
+			    GFAR_XDP_MAX_MTU);
+		return -EOPNOTSUPP;
+	}
+
+	/* The Rx ring is page based already, gfar_clean_rx_ring() picks
+	 * the program up on its next run.
+	 */
+	old_prog = xchg(&priv->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int gfar_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct gfar_private *priv = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return gfar_xdp_setup(dev, xdp->prog);
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!priv->xdp_prog;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static int gfar_poll_rx_sq(struct napi_struct *napi, int budget)
 {
 	struct gfar_priv_grp *gfargrp =
@@ -106,6 +106,10 @@ extern const char gfar_driver_version[];
 			  + SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
 #define GFAR_RXB_TRUESIZE 2048
 
+/* largest MTU whose frames, with FCB and time stamp, fit one Rx buffer */
+#define GFAR_XDP_MAX_MTU (GFAR_RXB_SIZE - ETH_HLEN - VLAN_HLEN - \
+			  ETH_FCS_LEN - GMAC_FCB_LEN - 8)
+
 #define TX_RING_MOD_MASK(size) (size-1)
 #define RX_RING_MOD_MASK(size) (size-1)
 #define GFAR_JUMBO_FRAME_SIZE 9600
@@ -1130,6 +1134,9 @@ struct gfar_private {
 	u16 padding;
 	u32 device_flags;
 
+	/* XDP program run on every Rx queue */
+	struct bpf_prog *xdp_prog;
+
 	/* HW time stamping enabled flag */
 	int hwts_rx_en;
 	int hwts_tx_en;
@@ -417,7 +417,8 @@ enum {
 	IOV_HCIREGS,
 	IOV_POWER,
 	IOV_CLOCK,
-	IOV_RXCHAIN
+	IOV_RXCHAIN,
+	IOV_GLOMCMDS
 };
 
 const bcm_iovar_t sdioh_iovars[] = {
@@ -436,6 +437,7 @@ const bcm_iovar_t sdioh_iovars[] = {
 	{"sd_mode", 	IOV_SDMODE, 	0,	IOVT_UINT32,	100},
 	{"sd_highspeed", IOV_HISPEED,	0,	IOVT_UINT32,	0 },
 	{"sd_rxchain",  IOV_RXCHAIN,    0, 	IOVT_BOOL,	0 },
+	{"sd_glomcmds", IOV_GLOMCMDS,	0,	IOVT_UINT32,	0 },
 	{NULL, 0, 0, 0, 0 }
 };
 
@@ -552,6 +554,15 @@ sdioh_iovar_op(sdioh_info_t *si, const char *name,
 		bcopy(&int_val, arg, val_size);
 		break;
 
+	case IOV_GVAL(IOV_GLOMCMDS):
+		int_val = (int32)si->glom_cmds;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_GLOMCMDS):
+		si->glom_cmds = (uint32)int_val;
+		break;
+
 	case IOV_GVAL(IOV_DMA):
 		int_val = (int32)si->sd_use_dma;
 		bcopy(&int_val, arg, val_size);
@@ -981,6 +992,8 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 	uint blk_size;
 	uint max_blk_count;
 	uint max_req_size;
+	uint max_segs;
+	uint tail;
 	struct mmc_request mmc_req;
 	struct mmc_command mmc_cmd;
 	struct mmc_data mmc_dat;
@@ -996,6 +1009,7 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 	blk_size = sd->client_block_size[func];
 	max_blk_count = min(host->max_blk_count, (uint)MAX_IO_RW_EXTENDED_BLK);
 	max_req_size = min(max_blk_count * blk_size, host->max_req_size);
+	max_segs = min((uint)host->max_segs, (uint)ARRAYSIZE(sd->sg_list));
 
 	pkt_offset = 0;
 	pnext = pkt;
@@ -1014,7 +1028,7 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 		 * packet chain is bigger than max_req_size, use multiple SD_IO_RW_EXTENDED
 		 * commands (each transfer is still block aligned)
 		 */
-		while (pnext != NULL && ttl_len < max_req_size) {
+		while (pnext != NULL && ttl_len < max_req_size && sg_count < max_segs) {
 			int pkt_len;
 			int sg_data_size;
 			uint8 *pdata = (uint8*)PKTDATA(sd->osh, pnext);
@@ -1022,14 +1036,8 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 			ASSERT(pdata != NULL);
 			pkt_len = PKTLEN(sd->osh, pnext);
 			sd_trace(("%s[%d] data=%p, len=%d\n", __FUNCTION__, write, pdata, pkt_len));
-			/* sg_count is unlikely larger than the array size, and this is
-			 * NOT something we can handle here, but in case it happens, PLEASE put
-			 * a restriction on max tx/glom count (based on host->max_segs).
-			 */
-			if (sg_count >= ARRAYSIZE(sd->sg_list)) {
-				sd_err(("%s: sg list entries exceed limit\n", __FUNCTION__));
-				return (SDIOH_API_RC_FAIL);
-			}
+			sd->sg_pkt[sg_count] = pnext;
+			sd->sg_off[sg_count] = pkt_offset;
 			pdata += pkt_offset;
 
 			sg_data_size = pkt_len - pkt_offset;
@@ -1051,7 +1059,23 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 			}
 		}
 
-		if (ttl_len % blk_size != 0) {
+		/* out of sg entries or request size in the middle of the chain: end
+		 * this command on a block boundary and carry the rest over to the next
+		 */
+		tail = ttl_len % blk_size;
+		if (pnext != NULL && tail != 0) {
+			ttl_len -= tail;
+			while (sg_count && sd->sg_list[sg_count - 1].length <= tail)
+				tail -= sd->sg_list[--sg_count].length;
+			if (sg_count) {
+				sd->sg_list[sg_count - 1].length -= tail;
+				pnext = sd->sg_pkt[sg_count - 1];
+				pkt_offset = sd->sg_off[sg_count - 1] +
+					sd->sg_list[sg_count - 1].length;
+			}
+		}
+
+		if (ttl_len == 0 || ttl_len % blk_size != 0) {
 			sd_err(("%s, data length %d not aligned to block size %d\n",
 				__FUNCTION__,  ttl_len, blk_size));
 			return SDIOH_API_RC_FAIL;
@@ -1086,6 +1110,7 @@ sdioh_request_packet_chain(sdioh_info_t *sd, uint fix_inc, uint write, uint func
 				__FUNCTION__, write ? "write" : "read", err_ret));
 			return SDIOH_API_RC_FAIL;
 		}
+		sd->glom_cmds++;
 	}
 
 	sd_trace(("%s: Exit\n", __FUNCTION__));
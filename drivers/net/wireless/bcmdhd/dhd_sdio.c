@@ -353,6 +353,10 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		/* Failed deglom attempts */
 	uint		rxglomframes;		/* Number of glom frames (superframes) */
 	uint		rxglompkts;		/* Number of packets from glom frames */
+	uint		rxglombytes;		/* Bytes read as glom frames */
+	uint		txglomframes;		/* Number of glommed f2 writes */
+	uint		txglompkts;		/* Number of packets sent in glommed writes */
+	uint		txglombytes;		/* Bytes sent in glommed writes */
 	uint		f2rxhdrs;		/* Number of header reads */
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
@@ -2101,8 +2105,14 @@ static int dhdsdio_txpkt(dhd_bus_t *bus, uint chan, void** pkts, int num_pkt, bo
 	pkt_chain = PKTNEXT(osh, head_pkt) ? head_pkt : NULL;
 	ret = dhd_bcmsdh_send_buf(bus, bcmsdh_cur_sbwad(sdh), SDIO_FUNC_2, F2SYNC,
 		PKTDATA(osh, head_pkt), total_len, pkt_chain, NULL, NULL, TXRETRIES);
-	if (ret == BCME_OK)
+	if (ret == BCME_OK) {
 		bus->tx_seq = (bus->tx_seq + num_pkt) % SDPCM_SEQUENCE_WRAP;
+		if (pkt_chain) {
+			bus->txglomframes++;
+			bus->txglompkts += num_pkt;
+			bus->txglombytes += total_len;
+		}
+	}
 
 	/* if a padding packet was needed, remove it from the link list as it not a data pkt */
 	if (pad_pkt_len && pkt)
@@ -2614,6 +2624,7 @@ void
 dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 {
 	dhd_bus_t *bus = dhdp->bus;
+	uint32 glomcmds = 0;
 
 	bcm_bprintf(strbuf, "Bus SDIO structure:\n");
 	bcm_bprintf(strbuf, "hostintmask 0x%08x intstatus 0x%08x sdpcm_ver %d\n",
@@ -2638,8 +2649,10 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->rx_hdrfail, bus->rx_badhdr, bus->rx_badseq);
 	bcm_bprintf(strbuf, "fc_rcvd %u, fc_xoff %u, fc_xon %u\n",
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
-	bcm_bprintf(strbuf, "rxglomfail %u, rxglomframes %u, rxglompkts %u\n",
-	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglomfail %u, rxglomframes %u, rxglompkts %u, rxglombytes %u\n",
+	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts, bus->rxglombytes);
+	bcm_bprintf(strbuf, "txglomframes %u, txglompkts %u, txglombytes %u\n",
+	            bus->txglomframes, bus->txglompkts, bus->txglombytes);
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %u (%u/%u), f2tx %u f1regs %u\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -2655,6 +2668,15 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhd_dump_pct(strbuf, "Rx: glom pct", (100 * bus->rxglompkts),
 		             bus->dhd->rx_packets);
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
+		dhd_dump_pct(strbuf, ", bytes/glom", bus->rxglombytes, bus->rxglomframes);
+		bcm_bprintf(strbuf, "\n");
+
+		dhd_dump_pct(strbuf, "Tx: pkts/glom", bus->txglompkts, bus->txglomframes);
+		dhd_dump_pct(strbuf, ", bytes/glom", bus->txglombytes, bus->txglomframes);
+		if (bcmsdh_iovar_op(bus->sdh, "sd_glomcmds", NULL, 0,
+		                    &glomcmds, sizeof(glomcmds), FALSE) == BCME_OK)
+			dhd_dump_pct(strbuf, ", cmd53/glom", glomcmds,
+			             bus->txglomframes + bus->rxglomframes);
 		bcm_bprintf(strbuf, "\n");
 
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
@@ -2700,6 +2722,7 @@ void
 dhd_bus_clearcounts(dhd_pub_t *dhdp)
 {
 	dhd_bus_t *bus = (dhd_bus_t *)dhdp->bus;
+	uint32 glomcmds = 0;
 
 	bus->intrcount = bus->lastintrs = bus->spurious = bus->regfails = 0;
 	bus->rxrtx = bus->rx_toolong = bus->rxc_errors = 0;
@@ -2708,8 +2731,10 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->tx_tailpad_chain = bus->tx_tailpad_pktget = 0;
 #endif
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
-	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = bus->rxglombytes = 0;
+	bus->txglomframes = bus->txglompkts = bus->txglombytes = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
+	bcmsdh_iovar_op(bus->sdh, "sd_glomcmds", NULL, 0, &glomcmds, sizeof(glomcmds), TRUE);
 }
 
 #ifdef SDTEST
@@ -4825,6 +4850,8 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 		}
 		bus->f2rxdata++;
 		ASSERT(errcode != BCME_PENDING);
+		if (errcode >= 0)
+			bus->rxglombytes += dlen;
 
 		/* On failure, kill the superframe, allow a couple retries */
 		if (errcode < 0) {
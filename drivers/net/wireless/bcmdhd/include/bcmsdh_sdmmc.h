@@ -80,6 +80,9 @@ struct sdioh_info {
 	uint32		func_cis_ptr[SDIOD_MAX_IOFUNCS];
 	bool		use_rxchain;
 	struct scatterlist	sg_list[SDIOH_SDMMC_MAX_SG_ENTRIES];
+	void		*sg_pkt[SDIOH_SDMMC_MAX_SG_ENTRIES];	/* packet of each sg entry */
+	uint		sg_off[SDIOH_SDMMC_MAX_SG_ENTRIES];	/* offset in that packet */
+	uint32		glom_cmds;		/* CMD53s issued for packet chains */
 	struct sdio_func	fake_func0;
 	struct sdio_func	*func[SDIOD_MAX_IOFUNCS];
 
@@ -14,10 +14,13 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/gpio.h>
+#include <linux/iopoll.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/mfd/syscon.h>
 #include <linux/mfd/syscon/imx6q-iomuxc-gpr.h>
 #include <linux/mfd/syscon/imx7-iomuxc-gpr.h>
+#include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/of_address.h>
 #include <linux/of_device.h>
@@ -30,6 +33,7 @@
 #include <linux/resource.h>
 #include <linux/signal.h>
 #include <linux/types.h>
+#include <linux/uaccess.h>
 #include <linux/interrupt.h>
 #include <linux/busfreq-imx.h>
 #include <linux/regulator/consumer.h>
@@ -82,6 +86,17 @@ struct imx6_pcie {
 	void __iomem		*phy_base;
 	struct regulator	*pcie_phy_regulator;
 	struct regulator	*pcie_bus_regulator;
+	bool			supports_clkreq;
+	bool			l1ss_enabled;
+	bool			link_kept;
+	/* EP mode eDMA channel, see imx_pcie_edma_init() */
+	struct miscdevice	edma_miscdev;
+	struct mutex		edma_lock;
+	void			*edma_buf;
+	dma_addr_t		edma_buf_phys;
+	u32			edma_wr_mbps;
+	u32			edma_rd_mbps;
+	u32			edma_lat_ns;
 };
 
 /* PCIe Root Complex registers (memory-mapped) */
@@ -115,6 +130,36 @@ struct imx6_pcie {
 #define PCIE_LINK_WIDTH_SPEED_CONTROL	0x80C
 #define PORT_LOGIC_SPEED_CHANGE		(0x1 << 17)
 
+/* DesignWare eDMA registers, viewport mode (memory-mapped) */
+#define DMA_CTRL			0x978
+#define DMA_CTRL_NUM_WR_CH_MASK		0xf
+#define DMA_CTRL_NUM_RD_CH_MASK		(0xf << 16)
+#define DMA_WRITE_ENGINE_EN		0x97C
+#define DMA_WRITE_DOORBELL		0x980
+#define DMA_READ_ENGINE_EN		0x99C
+#define DMA_READ_DOORBELL		0x9A0
+#define DMA_WRITE_INT_STATUS		0x9BC
+#define DMA_WRITE_INT_MASK		0x9C4
+#define DMA_WRITE_INT_CLEAR		0x9C8
+#define DMA_READ_INT_STATUS		0xA10
+#define DMA_READ_INT_MASK		0xA18
+#define DMA_READ_INT_CLEAR		0xA1C
+#define DMA_INT_DONE_CH0		(1 << 0)
+#define DMA_INT_ABORT_CH0		(1 << 16)
+#define DMA_VIEWPORT_SEL		0xA6C
+#define DMA_VIEWPORT_SEL_READ		(1 << 31)
+#define DMA_CH_CONTROL1			0xA70
+#define DMA_CH_CONTROL1_LIE		(1 << 3)
+#define DMA_TRANSFER_SIZE		0xA78
+#define DMA_SAR_LOW			0xA7C
+#define DMA_SAR_HIGH			0xA80
+#define DMA_DAR_LOW			0xA84
+#define DMA_DAR_HIGH			0xA88
+
+/* bounce buffer of the EP eDMA character device */
+#define EDMA_BUF_SIZE			SZ_1M
+#define EDMA_TIMEOUT_US			1000000
+
 /* PHY registers (not memory-mapped) */
 #define PCIE_PHY_RX_ASIC_OUT 0x100D
 #define PCIE_PHY_RX_ASIC_OUT_VALID	(1 << 0)
@@ -798,6 +843,125 @@ static int imx6_pcie_host_init(struct pcie_port *pp)
 	return 0;
 }
 
+/*
+ * L1 PM substates need CLKREQ# routed between the RC and the endpoint,
+ * which the board declares with "supports-clkreq".  The ASPM core of
+ * this kernel doesn't handle them, so the link is programmed here once
+ * the bus has been scanned; they apply whenever ASPM or PCI-PM puts the
+ * link into L1.
+ */
+static void imx6_pcie_clrset_dword(struct pci_dev *pdev, int pos,
+				   u32 clear, u32 set)
+{
+	u32 val;
+
+	pci_read_config_dword(pdev, pos, &val);
+	val &= ~clear;
+	val |= set;
+	pci_write_config_dword(pdev, pos, val);
+}
+
+/* T_POWER_ON advertised in an L1SS capability, in us */
+static u32 imx6_pcie_l1ss_pwr_on_us(u32 cap)
+{
+	static const u32 scale_us[] = { 2, 10, 100, 0 };
+
+	return ((cap & PCI_L1SS_CAP_P_PWR_ON_VALUE) >> 19) *
+		scale_us[(cap & PCI_L1SS_CAP_P_PWR_ON_SCALE) >> 16];
+}
+
+static void imx6_pcie_enable_l1ss(struct imx6_pcie *imx6_pcie)
+{
+	struct pcie_port *pp = &imx6_pcie->pp;
+	struct device *dev = pp->dev;
+	struct pci_bus *bus = NULL;
+	struct pci_dev *rp, *ep;
+	int rp_pos, ep_pos;
+	u32 rp_cap, ep_cap, cap, pwr_on, ctl1, ctl2, val;
+	u32 rp_devcap2, ep_devcap2;
+	u32 t_cmrt, t_pwr_on, scale;
+
+	while ((bus = pci_find_next_bus(bus)) != NULL)
+		if (bus->sysdata == pp)
+			break;
+	if (!bus)
+		return;
+
+	rp = pci_get_slot(bus, PCI_DEVFN(0, 0));
+	if (!rp)
+		return;
+	if (!rp->subordinate || list_empty(&rp->subordinate->devices))
+		goto out;
+	ep = list_first_entry(&rp->subordinate->devices, struct pci_dev,
+			      bus_list);
+
+	rp_pos = pci_find_ext_capability(rp, PCI_EXT_CAP_ID_L1SS);
+	ep_pos = pci_find_ext_capability(ep, PCI_EXT_CAP_ID_L1SS);
+	if (!rp_pos || !ep_pos)
+		goto out;
+
+	pci_read_config_dword(rp, rp_pos + PCI_L1SS_CAP, &rp_cap);
+	pci_read_config_dword(ep, ep_pos + PCI_L1SS_CAP, &ep_cap);
+	if (!(rp_cap & ep_cap & PCI_L1SS_CAP_L1_PM_SS))
+		goto out;
+	cap = rp_cap & ep_cap & PCI_L1SS_CTL1_L1SS_MASK;
+
+	/* ASPM L1.2 is entered on the LTR values reported by the EP */
+	pcie_capability_read_dword(rp, PCI_EXP_DEVCAP2, &rp_devcap2);
+	pcie_capability_read_dword(ep, PCI_EXP_DEVCAP2, &ep_devcap2);
+	if (rp_devcap2 & ep_devcap2 & PCI_EXP_DEVCAP2_LTR) {
+		pcie_capability_set_word(rp, PCI_EXP_DEVCTL2,
+					 PCI_EXP_DEVCTL2_LTR_EN);
+		pcie_capability_set_word(ep, PCI_EXP_DEVCTL2,
+					 PCI_EXP_DEVCTL2_LTR_EN);
+	} else {
+		cap &= ~PCI_L1SS_CTL1_ASPM_L1_2;
+	}
+	if (!cap)
+		goto out;
+
+	/* both ends use the slower of the two ports */
+	t_cmrt = max((rp_cap & PCI_L1SS_CAP_CM_RESTORE_TIME) >> 8,
+		     (ep_cap & PCI_L1SS_CAP_CM_RESTORE_TIME) >> 8);
+	if (imx6_pcie_l1ss_pwr_on_us(rp_cap) >=
+	    imx6_pcie_l1ss_pwr_on_us(ep_cap))
+		pwr_on = rp_cap;
+	else
+		pwr_on = ep_cap;
+	t_pwr_on = imx6_pcie_l1ss_pwr_on_us(pwr_on);
+	ctl2 = (pwr_on & (PCI_L1SS_CAP_P_PWR_ON_SCALE |
+			  PCI_L1SS_CAP_P_PWR_ON_VALUE)) >> 16;
+
+	/* LTR_L1.2_THRESHOLD in ns, encoded as value * 32^scale */
+	val = (2 + 4 + t_cmrt + t_pwr_on) * 1000;
+	for (scale = 0; val > 0x3ff; scale++)
+		val = DIV_ROUND_UP(val, 32);
+	ctl1 = (t_cmrt << 8) | (val << 16) | (scale << 29);
+
+	/* Program both ends with L1SS disabled, then enable upstream first */
+	imx6_pcie_clrset_dword(rp, rp_pos + PCI_L1SS_CTL1,
+			       PCI_L1SS_CTL1_L1SS_MASK, 0);
+	imx6_pcie_clrset_dword(ep, ep_pos + PCI_L1SS_CTL1,
+			       PCI_L1SS_CTL1_L1SS_MASK, 0);
+	pci_write_config_dword(rp, rp_pos + PCI_L1SS_CTL2, ctl2);
+	pci_write_config_dword(ep, ep_pos + PCI_L1SS_CTL2, ctl2);
+	imx6_pcie_clrset_dword(rp, rp_pos + PCI_L1SS_CTL1,
+			       PCI_L1SS_CTL1_CM_RESTORE_TIME |
+			       PCI_L1SS_CTL1_LTR_L12_TH_VALUE |
+			       PCI_L1SS_CTL1_LTR_L12_TH_SCALE, ctl1);
+	imx6_pcie_clrset_dword(ep, ep_pos + PCI_L1SS_CTL1,
+			       PCI_L1SS_CTL1_LTR_L12_TH_VALUE |
+			       PCI_L1SS_CTL1_LTR_L12_TH_SCALE,
+			       ctl1 & ~PCI_L1SS_CTL1_CM_RESTORE_TIME);
+	imx6_pcie_clrset_dword(rp, rp_pos + PCI_L1SS_CTL1, 0, cap);
+	imx6_pcie_clrset_dword(ep, ep_pos + PCI_L1SS_CTL1, 0, cap);
+
+	imx6_pcie->l1ss_enabled = true;
+	dev_info(dev, "L1 substates enabled: 0x%x\n", cap);
+out:
+	pci_dev_put(rp);
+}
+
 static int imx6_pcie_link_up(struct pcie_port *pp)
 {
 	return dw_pcie_readl_rc(pp, PCIE_PHY_DEBUG_R1) &
@@ -955,11 +1119,275 @@ imx_pcie_memw_size(struct device *dev, struct device_attribute *attr,
 	return count;
 }
 
+/*
+ * Move @size bytes between local memory and the PCIe outbound window
+ * with eDMA channel 0; @to_remote selects the write channel.  The
+ * remote address goes through the outbound iATU like CPU accesses do.
+ */
+static int imx_pcie_edma_xfer(struct imx6_pcie *imx6_pcie, bool to_remote,
+			      dma_addr_t local, u64 remote, u32 size)
+{
+	struct pcie_port *pp = &imx6_pcie->pp;
+	u32 status_reg, clear_reg, status;
+	u64 sar, dar;
+	int ret;
+
+	if (to_remote) {
+		dw_pcie_writel_rc(pp, DMA_WRITE_ENGINE_EN, 1);
+		dw_pcie_writel_rc(pp, DMA_WRITE_INT_MASK, 0);
+		dw_pcie_writel_rc(pp, DMA_VIEWPORT_SEL, 0);
+		status_reg = DMA_WRITE_INT_STATUS;
+		clear_reg = DMA_WRITE_INT_CLEAR;
+		sar = local;
+		dar = remote;
+	} else {
+		dw_pcie_writel_rc(pp, DMA_READ_ENGINE_EN, 1);
+		dw_pcie_writel_rc(pp, DMA_READ_INT_MASK, 0);
+		dw_pcie_writel_rc(pp, DMA_VIEWPORT_SEL, DMA_VIEWPORT_SEL_READ);
+		status_reg = DMA_READ_INT_STATUS;
+		clear_reg = DMA_READ_INT_CLEAR;
+		sar = remote;
+		dar = local;
+	}
+
+	dw_pcie_writel_rc(pp, clear_reg, DMA_INT_DONE_CH0 | DMA_INT_ABORT_CH0);
+	dw_pcie_writel_rc(pp, DMA_CH_CONTROL1, DMA_CH_CONTROL1_LIE);
+	dw_pcie_writel_rc(pp, DMA_TRANSFER_SIZE, size);
+	dw_pcie_writel_rc(pp, DMA_SAR_LOW, lower_32_bits(sar));
+	dw_pcie_writel_rc(pp, DMA_SAR_HIGH, upper_32_bits(sar));
+	dw_pcie_writel_rc(pp, DMA_DAR_LOW, lower_32_bits(dar));
+	dw_pcie_writel_rc(pp, DMA_DAR_HIGH, upper_32_bits(dar));
+	dw_pcie_writel_rc(pp, to_remote ? DMA_WRITE_DOORBELL :
+			  DMA_READ_DOORBELL, 0);
+
+	ret = readl_poll_timeout(pp->dbi_base + status_reg, status,
+				 status & (DMA_INT_DONE_CH0 |
+					   DMA_INT_ABORT_CH0),
+				 1, EDMA_TIMEOUT_US);
+	dw_pcie_writel_rc(pp, clear_reg, DMA_INT_DONE_CH0 | DMA_INT_ABORT_CH0);
+	if (ret)
+		return ret;
+
+	return (status & DMA_INT_ABORT_CH0) ? -EIO : 0;
+}
+
+static u32 imx_pcie_edma_mbps(u32 size, s64 ns)
+{
+	return ns ? div64_s64((s64)size * NSEC_PER_SEC, ns) >> 20 : 0;
+}
+
+/*
+ * Throughput and latency test: push @size bytes to the RC window,
+ * read them back, and time a minimal transfer for the latency.
+ */
+static int imx_pcie_edma_test(struct imx6_pcie *imx6_pcie, u32 size)
+{
+	struct pcie_port *pp = &imx6_pcie->pp;
+	struct device *dev = pp->dev;
+	u32 *buf = imx6_pcie->edma_buf;
+	ktime_t start;
+	s64 ns;
+	int i, ret;
+
+	size = min_t(u32, size, min_t(u32, test_region_size, EDMA_BUF_SIZE));
+	size &= ~3;
+	if (!size)
+		return -EINVAL;
+
+	mutex_lock(&imx6_pcie->edma_lock);
+	for (i = 0; i < size / 4; i++)
+		buf[i] = 0xE6600D00 + i * 4;
+
+	start = ktime_get();
+	ret = imx_pcie_edma_xfer(imx6_pcie, true, imx6_pcie->edma_buf_phys,
+				 pp->mem_base, size);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret)
+		goto out;
+	imx6_pcie->edma_wr_mbps = imx_pcie_edma_mbps(size, ns);
+
+	memset(buf, 0, size);
+	start = ktime_get();
+	ret = imx_pcie_edma_xfer(imx6_pcie, false, imx6_pcie->edma_buf_phys,
+				 pp->mem_base, size);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret)
+		goto out;
+	imx6_pcie->edma_rd_mbps = imx_pcie_edma_mbps(size, ns);
+
+	for (i = 0; i < size / 4; i++) {
+		if (buf[i] != 0xE6600D00 + i * 4) {
+			dev_err(dev, "eDMA data mismatch at 0x%x\n", i * 4);
+			ret = -EIO;
+			goto out;
+		}
+	}
+
+	start = ktime_get();
+	for (i = 0; i < 16; i++) {
+		ret = imx_pcie_edma_xfer(imx6_pcie, false,
+					 imx6_pcie->edma_buf_phys,
+					 pp->mem_base, 4);
+		if (ret)
+			goto out;
+	}
+	imx6_pcie->edma_lat_ns = ktime_to_ns(ktime_sub(ktime_get(), start))
+				 / 16;
+
+	dev_info(dev, "eDMA %u bytes: write %uMB/s, read %uMB/s, latency %uns\n",
+		 size, imx6_pcie->edma_wr_mbps, imx6_pcie->edma_rd_mbps,
+		 imx6_pcie->edma_lat_ns);
+out:
+	mutex_unlock(&imx6_pcie->edma_lock);
+	if (ret)
+		dev_err(dev, "eDMA test failed: %d\n", ret);
+	return ret;
+}
+
+/*
+ * The character device maps file offsets onto the RC memory window;
+ * data is staged in a coherent bounce buffer so each chunk becomes a
+ * single eDMA block.
+ */
+static ssize_t imx_pcie_edma_rw(struct file *file, char __user *ubuf,
+				const char __user *cubuf, size_t count,
+				loff_t *ppos)
+{
+	struct imx6_pcie *imx6_pcie = container_of(file->private_data,
+					struct imx6_pcie, edma_miscdev);
+	struct pcie_port *pp = &imx6_pcie->pp;
+	size_t done = 0, len;
+	int ret = 0;
+
+	if (*ppos >= test_region_size)
+		return 0;
+	count = min_t(size_t, count, test_region_size - *ppos);
+
+	if (mutex_lock_interruptible(&imx6_pcie->edma_lock))
+		return -ERESTARTSYS;
+
+	while (done < count) {
+		len = min_t(size_t, count - done, EDMA_BUF_SIZE);
+
+		if (cubuf && copy_from_user(imx6_pcie->edma_buf,
+					    cubuf + done, len)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = imx_pcie_edma_xfer(imx6_pcie, cubuf != NULL,
+					 imx6_pcie->edma_buf_phys,
+					 pp->mem_base + *ppos, len);
+		if (ret)
+			break;
+
+		if (ubuf && copy_to_user(ubuf + done, imx6_pcie->edma_buf,
+					 len)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		done += len;
+		*ppos += len;
+	}
+
+	mutex_unlock(&imx6_pcie->edma_lock);
+
+	return done ? done : ret;
+}
+
+static ssize_t imx_pcie_edma_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	return imx_pcie_edma_rw(file, buf, NULL, count, ppos);
+}
+
+static ssize_t imx_pcie_edma_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	return imx_pcie_edma_rw(file, NULL, buf, count, ppos);
+}
+
+static loff_t imx_pcie_edma_llseek(struct file *file, loff_t off, int whence)
+{
+	return fixed_size_llseek(file, off, whence, test_region_size);
+}
+
+static const struct file_operations imx_pcie_edma_fops = {
+	.owner		= THIS_MODULE,
+	.read		= imx_pcie_edma_read,
+	.write		= imx_pcie_edma_write,
+	.llseek		= imx_pcie_edma_llseek,
+};
+
+static void imx_pcie_edma_init(struct imx6_pcie *imx6_pcie)
+{
+	struct pcie_port *pp = &imx6_pcie->pp;
+	struct device *dev = pp->dev;
+	u32 ctrl;
+
+	ctrl = dw_pcie_readl_rc(pp, DMA_CTRL);
+	if (ctrl == 0xffffffff || !(ctrl & DMA_CTRL_NUM_WR_CH_MASK) ||
+	    !(ctrl & DMA_CTRL_NUM_RD_CH_MASK)) {
+		dev_info(dev, "no eDMA channels, CPU copies only\n");
+		return;
+	}
+
+	imx6_pcie->edma_buf = dmam_alloc_coherent(dev, EDMA_BUF_SIZE,
+						  &imx6_pcie->edma_buf_phys,
+						  GFP_KERNEL);
+	if (!imx6_pcie->edma_buf)
+		return;
+
+	mutex_init(&imx6_pcie->edma_lock);
+	imx6_pcie->edma_miscdev.minor = MISC_DYNAMIC_MINOR;
+	imx6_pcie->edma_miscdev.name = "imx_pcie_ep_dma";
+	imx6_pcie->edma_miscdev.fops = &imx_pcie_edma_fops;
+	imx6_pcie->edma_miscdev.parent = dev;
+	if (misc_register(&imx6_pcie->edma_miscdev)) {
+		dev_err(dev, "failed to register eDMA device\n");
+		return;
+	}
+
+	imx_pcie_edma_test(imx6_pcie, test_region_size);
+}
+
+static ssize_t imx_pcie_dma_test_show(struct device *dev,
+		struct device_attribute *devattr, char *buf)
+{
+	struct imx6_pcie *imx6_pcie = dev_get_drvdata(dev);
+
+	return sprintf(buf, "write %uMB/s read %uMB/s latency %uns\n",
+			imx6_pcie->edma_wr_mbps, imx6_pcie->edma_rd_mbps,
+			imx6_pcie->edma_lat_ns);
+}
+
+static ssize_t imx_pcie_dma_test_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct imx6_pcie *imx6_pcie = dev_get_drvdata(dev);
+	u32 size;
+	int ret;
+
+	if (!imx6_pcie || !imx6_pcie->edma_buf)
+		return -ENODEV;
+
+	ret = kstrtou32(buf, 0, &size);
+	if (ret)
+		return ret;
+
+	ret = imx_pcie_edma_test(imx6_pcie, size);
+
+	return ret ? ret : count;
+}
+
 static DEVICE_ATTR(memw_info, S_IRUGO, imx_pcie_memw_info, NULL);
 static DEVICE_ATTR(memw_start_set, S_IWUSR, NULL, imx_pcie_memw_start);
 static DEVICE_ATTR(memw_size_set, S_IWUSR, NULL, imx_pcie_memw_size);
 static DEVICE_ATTR(ep_bar0_addr, S_IWUSR | S_IRUGO, imx_pcie_bar0_addr_info,
 		imx_pcie_bar0_addr_start);
+static DEVICE_ATTR(dma_test, S_IWUSR | S_IRUGO, imx_pcie_dma_test_show,
+		imx_pcie_dma_test_store);
 
 static struct attribute *imx_pcie_attrs[] = {
 	/*
@@ -971,6 +1399,8 @@ static struct attribute *imx_pcie_attrs[] = {
 	&dev_attr_memw_start_set.attr,
 	&dev_attr_memw_size_set.attr,
 	&dev_attr_ep_bar0_addr.attr,
+	/* write a size to run the eDMA throughput/latency test */
+	&dev_attr_dma_test.attr,
 	NULL
 };
 
@@ -1063,6 +1493,37 @@ static void pci_imx_pm_turn_off(struct imx6_pcie *imx6_pcie)
 		gpio_set_value_cansleep(imx6_pcie->reset_gpio, 0);
 }
 
+static void pci_imx_power_down(struct imx6_pcie *imx6_pcie)
+{
+	/* Disable clks */
+	clk_disable_unprepare(imx6_pcie->pcie);
+	clk_disable_unprepare(imx6_pcie->pcie_phy);
+	if (!imx6_pcie->ext_osc)
+		clk_disable_unprepare(imx6_pcie->pcie_bus);
+	if (imx6_pcie->variant == IMX6SX)
+		clk_disable_unprepare(imx6_pcie->pcie_inbound_axi);
+	else if (imx6_pcie->variant == IMX7D)
+		/* turn off external osc input */
+		regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR12,
+				BIT(5), BIT(5));
+	else if (imx6_pcie->variant == IMX6QP) {
+		regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR1,
+				IMX6Q_GPR1_PCIE_REF_CLK_EN, 0);
+		regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR1,
+				IMX6Q_GPR1_PCIE_TEST_PD,
+				IMX6Q_GPR1_PCIE_TEST_PD);
+	}
+	release_bus_freq(BUS_FREQ_HIGH);
+
+	/* Power down PCIe PHY. */
+	if (imx6_pcie->pcie_phy_regulator != NULL)
+		regulator_disable(imx6_pcie->pcie_phy_regulator);
+	if (imx6_pcie->pcie_bus_regulator != NULL)
+		regulator_disable(imx6_pcie->pcie_bus_regulator);
+	if (gpio_is_valid(imx6_pcie->power_on_gpio))
+		gpio_set_value_cansleep(imx6_pcie->power_on_gpio, 0);
+}
+
 static int pci_imx_suspend_noirq(struct device *dev)
 {
 	struct imx6_pcie *imx6_pcie = dev_get_drvdata(dev);
@@ -1071,37 +1532,21 @@ static int pci_imx_suspend_noirq(struct device *dev)
 	if (IS_ENABLED(CONFIG_PCI_MSI))
 		dw_pcie_msi_cfg_store(pp);
 
+	/*
+	 * With L1 substates the idle link costs next to nothing, so leave
+	 * it in L1 with the PHY configured and skip PHY init and link
+	 * training on resume.
+	 */
+	if (imx6_pcie->l1ss_enabled) {
+		imx6_pcie->link_kept = true;
+		return 0;
+	}
+
 	pci_imx_pm_turn_off(imx6_pcie);
 
 	if (imx6_pcie->variant == IMX7D || imx6_pcie->variant == IMX6SX
 	    || imx6_pcie->variant == IMX6QP) {
-		/* Disable clks */
-		clk_disable_unprepare(imx6_pcie->pcie);
-		clk_disable_unprepare(imx6_pcie->pcie_phy);
-		if (!imx6_pcie->ext_osc)
-			clk_disable_unprepare(imx6_pcie->pcie_bus);
-		if (imx6_pcie->variant == IMX6SX)
-			clk_disable_unprepare(imx6_pcie->pcie_inbound_axi);
-		else if (imx6_pcie->variant == IMX7D)
-			/* turn off external osc input */
-			regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR12,
-					BIT(5), BIT(5));
-		else if (imx6_pcie->variant == IMX6QP) {
-			regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR1,
-					IMX6Q_GPR1_PCIE_REF_CLK_EN, 0);
-			regmap_update_bits(imx6_pcie->iomuxc_gpr, IOMUXC_GPR1,
-					IMX6Q_GPR1_PCIE_TEST_PD,
-					IMX6Q_GPR1_PCIE_TEST_PD);
-		}
-		release_bus_freq(BUS_FREQ_HIGH);
-
-		/* Power down PCIe PHY. */
-		if (imx6_pcie->pcie_phy_regulator != NULL)
-			regulator_disable(imx6_pcie->pcie_phy_regulator);
-		if (imx6_pcie->pcie_bus_regulator != NULL)
-			regulator_disable(imx6_pcie->pcie_bus_regulator);
-		if (gpio_is_valid(imx6_pcie->power_on_gpio))
-			gpio_set_value_cansleep(imx6_pcie->power_on_gpio, 0);
+		pci_imx_power_down(imx6_pcie);
 	} else {
 		/*
 		 * L2 can exit by 'reset' or Inband beacon (from remote EP)
@@ -1123,6 +1568,19 @@ static int pci_imx_resume_noirq(struct device *dev)
 	struct imx6_pcie *imx6_pcie = dev_get_drvdata(dev);
 	struct pcie_port *pp = &imx6_pcie->pp;
 
+	if (imx6_pcie->link_kept) {
+		imx6_pcie->link_kept = false;
+		if (dw_pcie_link_up(pp)) {
+			if (IS_ENABLED(CONFIG_PCI_MSI))
+				dw_pcie_msi_cfg_restore(pp);
+			return 0;
+		}
+
+		/* the power domain went down anyway, start from scratch */
+		dev_info(dev, "link lost in suspend, re-initializing\n");
+		pci_imx_power_down(imx6_pcie);
+	}
+
 	if (imx6_pcie->variant == IMX7D || imx6_pcie->variant == IMX6SX ||
 	    imx6_pcie->variant == IMX6QP) {
 		if (imx6_pcie->variant == IMX7D)
@@ -1398,6 +1856,9 @@ static int imx6_pcie_probe(struct platform_device *pdev)
 	if (ret)
 		imx6_pcie->link_gen = 1;
 
+	imx6_pcie->supports_clkreq = of_property_read_bool(node,
+						"supports-clkreq");
+
 	if (IS_ENABLED(CONFIG_EP_MODE_IN_EP_RC_SYS)) {
 		int i;
 		void *test_reg1, *test_reg2;
@@ -1557,6 +2018,8 @@ static int imx6_pcie_probe(struct platform_device *pdev)
 		} else {
 			pr_info("pcie ep: Data transfer is failed.\n");
 		} /* end of self io test. */
+
+		imx_pcie_edma_init(imx6_pcie);
 	} else {
 		ret = imx6_add_pcie_port(imx6_pcie, pdev);
 		if (ret < 0)
@@ -1564,6 +2027,9 @@ static int imx6_pcie_probe(struct platform_device *pdev)
 
 		platform_set_drvdata(pdev, imx6_pcie);
 
+		if (imx6_pcie->variant == IMX7D && imx6_pcie->supports_clkreq)
+			imx6_pcie_enable_l1ss(imx6_pcie);
+
 		if (IS_ENABLED(CONFIG_RC_MODE_IN_EP_RC_SYS))
 			imx_pcie_regions_setup(&pdev->dev);
 	}
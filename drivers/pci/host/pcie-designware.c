@@ -20,6 +20,7 @@
 #include <linux/pci.h>
 #include <linux/pci_regs.h>
 #include <linux/platform_device.h>
+#include <linux/smp.h>
 #include <linux/types.h>
 #include <linux/delay.h>
 
@@ -247,12 +248,67 @@ static void dw_pcie_prog_outbound_atu(struct pcie_port *pp, int index,
 	dev_err(pp->dev, "iATU is not being enabled\n");
 }
 
+#ifdef CONFIG_SMP
+/*
+ * A vector is steered to the first online CPU of its affinity mask,
+ * unless the mask spans all online CPUs, in which case it stays on
+ * whichever CPU runs the demux handler.
+ */
+static int dw_msi_set_affinity(struct irq_data *d,
+			       const struct cpumask *mask, bool force)
+{
+	struct msi_desc *msi = irq_data_get_msi_desc(d);
+	struct pcie_port *pp = msi_desc_to_pci_sysdata(msi);
+	struct dw_msi_vector *vec = &pp->msi_vec[d->hwirq];
+	unsigned int cpu;
+
+	cpu = cpumask_first_and(mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	vec->irq = d->irq;
+	if (cpumask_subset(cpu_online_mask, mask))
+		WRITE_ONCE(vec->cpu, -1);
+	else
+		WRITE_ONCE(vec->cpu, cpu);
+
+	return IRQ_SET_MASK_OK;
+}
+#endif
+
+static void dw_msi_vector_ipi(void *info)
+{
+	struct dw_msi_vector *vec = info;
+
+	clear_bit(0, &vec->pending);
+	generic_handle_irq(vec->irq);
+}
+
+static void dw_handle_msi_vector(struct pcie_port *pp, int hwirq, int irq)
+{
+#ifdef CONFIG_SMP
+	struct dw_msi_vector *vec = &pp->msi_vec[hwirq];
+	int cpu = READ_ONCE(vec->cpu);
+
+	if (cpu >= 0 && cpu != smp_processor_id() && cpu_online(cpu)) {
+		/* one IPI in flight covers any number of edges */
+		if (!test_and_set_bit(0, &vec->pending))
+			smp_call_function_single_async(cpu, &vec->csd);
+		return;
+	}
+#endif
+	generic_handle_irq(irq);
+}
+
 static struct irq_chip dw_msi_irq_chip = {
 	.name = "PCI-MSI",
 	.irq_enable = pci_msi_unmask_irq,
 	.irq_disable = pci_msi_mask_irq,
 	.irq_mask = pci_msi_mask_irq,
 	.irq_unmask = pci_msi_unmask_irq,
+#ifdef CONFIG_SMP
+	.irq_set_affinity = dw_msi_set_affinity,
+#endif
 };
 
 /* MSI int handler */
@@ -274,7 +330,7 @@ irqreturn_t dw_handle_msi_irq(struct pcie_port *pp)
 				dw_pcie_wr_own_conf(pp,
 						PCIE_MSI_INTR0_STATUS + i * 12,
 						4, 1 << pos);
-				generic_handle_irq(irq);
+				dw_handle_msi_vector(pp, i * 32 + pos, irq);
 				pos++;
 			}
 		}
@@ -640,6 +696,12 @@ int dw_pcie_host_init(struct pcie_port *pp)
 	if (ret)
 		pp->num_viewport = 2;
 
+	for (i = 0; i < MAX_MSI_IRQS; i++) {
+		pp->msi_vec[i].cpu = -1;
+		pp->msi_vec[i].csd.func = dw_msi_vector_ipi;
+		pp->msi_vec[i].csd.info = &pp->msi_vec[i];
+	}
+
 	if (IS_ENABLED(CONFIG_PCI_MSI)) {
 		if (!pp->ops->msi_host_init) {
 			pp->irq_domain = irq_domain_add_linear(pp->dev->of_node,
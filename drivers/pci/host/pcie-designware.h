@@ -22,6 +22,18 @@
 #define MAX_MSI_IRQS			32
 #define MAX_MSI_CTRLS			(MAX_MSI_IRQS / 32)
 
+/*
+ * All MSI groups share one output line on most integrations, so vector
+ * affinity is honoured by handing the vector over to its target CPU
+ * from the demux handler.
+ */
+struct dw_msi_vector {
+	struct call_single_data	csd;
+	unsigned long		pending;
+	unsigned int		irq;
+	int			cpu;
+};
+
 struct pcie_port {
 	struct device		*dev;
 	u8			root_bus_nr;
@@ -52,6 +64,7 @@ struct pcie_port {
 	u8			iatu_unroll_enabled;
 	unsigned int		msi_enable[MAX_MSI_CTRLS];
 	DECLARE_BITMAP(msi_irq_in_use, MAX_MSI_IRQS);
+	struct dw_msi_vector	msi_vec[MAX_MSI_IRQS];
 };
 
 struct pcie_host_ops {
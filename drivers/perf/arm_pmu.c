@@ -15,7 +15,9 @@
 #include <linux/cpumask.h>
 #include <linux/cpu_pm.h>
 #include <linux/export.h>
+#include <linux/hrtimer.h>
 #include <linux/kernel.h>
+#include <linux/moduleparam.h>
 #include <linux/of_device.h>
 #include <linux/perf/arm_pmu.h>
 #include <linux/platform_device.h>
@@ -27,6 +29,15 @@
 #include <asm/cputype.h>
 #include <asm/irq_regs.h>
 
+/*
+ * Overflows of CPUs without a usable PMU interrupt are picked up by a per
+ * CPU timer. The default matches the 4 kHz perf record samples at.
+ */
+static unsigned int poll_period_us = 250;
+module_param(poll_period_us, uint, 0644);
+MODULE_PARM_DESC(poll_period_us,
+		 "Overflow polling period in us for CPUs without PMU interrupt, 0 disables polling");
+
 static int
 armpmu_map_cache_event(const unsigned (*cache_map)
 				      [PERF_COUNT_HW_CACHE_MAX]
@@ -322,6 +333,26 @@ validate_group(struct perf_event *event)
 	return 0;
 }
 
+/*
+ * Some SoCs, i.MX6 among them, OR the PMU interrupts of all cores into a
+ * single SPI. If this CPU had no overflow pending, another core raised it:
+ * steer the line there so that the still asserted interrupt is taken by
+ * the CPU owning the counter.
+ */
+static void armpmu_rotate_irq(int irq, struct arm_pmu *armpmu)
+{
+	int cpu;
+
+	cpu = cpumask_next_and(smp_processor_id(), &armpmu->supported_cpus,
+			       cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first_and(&armpmu->supported_cpus,
+					cpu_online_mask);
+
+	if (cpu < nr_cpu_ids && cpu != smp_processor_id())
+		irq_set_affinity(irq, cpumask_of(cpu));
+}
+
 static irqreturn_t armpmu_dispatch_irq(int irq, void *dev)
 {
 	struct arm_pmu *armpmu;
@@ -347,10 +378,54 @@ static irqreturn_t armpmu_dispatch_irq(int irq, void *dev)
 		ret = armpmu->handle_irq(irq, armpmu);
 	finish_clock = sched_clock();
 
+	if (ret == IRQ_NONE && armpmu->irq_rotate)
+		armpmu_rotate_irq(irq, armpmu);
+
 	perf_sample_event_took(finish_clock - start_clock);
 	return ret;
 }
 
+static enum hrtimer_restart armpmu_poll(struct hrtimer *timer)
+{
+	struct pmu_hw_events *hw_events;
+	struct arm_pmu *armpmu;
+	unsigned int period = READ_ONCE(poll_period_us);
+	u64 start_clock, finish_clock;
+
+	hw_events = container_of(timer, struct pmu_hw_events, poll_timer);
+	armpmu = hw_events->percpu_pmu;
+
+	/*
+	 * Stop once the last event is gone, or if the timer was migrated
+	 * away from an offlined CPU: the counters are those of this CPU.
+	 */
+	if (!period || hw_events != this_cpu_ptr(armpmu->hw_events) ||
+	    bitmap_empty(hw_events->used_mask, armpmu->num_events))
+		return HRTIMER_NORESTART;
+
+	/* we run in hard interrupt context, get_irq_regs() is valid */
+	start_clock = sched_clock();
+	armpmu->handle_irq(0, armpmu);
+	finish_clock = sched_clock();
+
+	perf_sample_event_took(finish_clock - start_clock);
+
+	hrtimer_forward_now(timer, ns_to_ktime((u64)period * NSEC_PER_USEC));
+	return HRTIMER_RESTART;
+}
+
+static void armpmu_poll_start(struct pmu_hw_events *hw_events)
+{
+	unsigned int period = READ_ONCE(poll_period_us);
+
+	if (!period || hrtimer_active(&hw_events->poll_timer))
+		return;
+
+	hrtimer_start(&hw_events->poll_timer,
+		      ns_to_ktime((u64)period * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL_PINNED);
+}
+
 static void
 armpmu_release_hardware(struct arm_pmu *armpmu)
 {
@@ -507,8 +582,13 @@ static void armpmu_enable(struct pmu *pmu)
 	if (!cpumask_test_cpu(smp_processor_id(), &armpmu->supported_cpus))
 		return;
 
-	if (enabled)
-		armpmu->start(armpmu);
+	if (!enabled)
+		return;
+
+	armpmu->start(armpmu);
+
+	if (cpumask_test_cpu(smp_processor_id(), &armpmu->poll_cpus))
+		armpmu_poll_start(hw_events);
 }
 
 static void armpmu_disable(struct pmu *pmu)
@@ -619,6 +699,12 @@ static void cpu_pmu_free_irq(struct arm_pmu *cpu_pmu)
 	int i, irq, irqs;
 	struct platform_device *pmu_device = cpu_pmu->plat_device;
 	struct pmu_hw_events __percpu *hw_events = cpu_pmu->hw_events;
+	int cpu;
+
+	for_each_cpu(cpu, &cpu_pmu->poll_cpus)
+		hrtimer_cancel(&per_cpu_ptr(hw_events, cpu)->poll_timer);
+	cpumask_clear(&cpu_pmu->poll_cpus);
+	cpu_pmu->irq_rotate = false;
 
 	irqs = min(pmu_device->num_resources, num_possible_cpus());
 
@@ -629,7 +715,7 @@ static void cpu_pmu_free_irq(struct arm_pmu *cpu_pmu)
 		free_percpu_irq(irq, &hw_events->percpu_pmu);
 	} else {
 		for (i = 0; i < irqs; ++i) {
-			int cpu = i;
+			cpu = i;
 
 			if (cpu_pmu->irq_affinity)
 				cpu = cpu_pmu->irq_affinity[i];
@@ -652,9 +738,16 @@ static int cpu_pmu_request_irq(struct arm_pmu *cpu_pmu, irq_handler_t handler)
 	if (!pmu_device)
 		return -ENODEV;
 
+	/* CPUs left without an interrupt below get their overflows polled */
+	if (poll_period_us)
+		cpumask_copy(&cpu_pmu->poll_cpus, &cpu_pmu->supported_cpus);
+
 	irqs = min(pmu_device->num_resources, num_possible_cpus());
 	if (irqs < 1) {
-		pr_warn_once("perf/ARM: No irqs for PMU defined, sampling events not supported\n");
+		if (poll_period_us)
+			pr_warn_once("perf/ARM: No irqs for PMU defined, polling for counter overflows\n");
+		else
+			pr_warn_once("perf/ARM: No irqs for PMU defined, sampling events not supported\n");
 		return 0;
 	}
 
@@ -670,6 +763,7 @@ static int cpu_pmu_request_irq(struct arm_pmu *cpu_pmu, irq_handler_t handler)
 
 		on_each_cpu_mask(&cpu_pmu->supported_cpus,
 				 cpu_pmu_enable_percpu_irq, &irq, 1);
+		cpumask_clear(&cpu_pmu->poll_cpus);
 	} else {
 		for (i = 0; i < irqs; ++i) {
 			int cpu = i;
@@ -703,6 +797,15 @@ static int cpu_pmu_request_irq(struct arm_pmu *cpu_pmu, irq_handler_t handler)
 			}
 
 			cpumask_set_cpu(cpu, &cpu_pmu->active_irqs);
+			cpumask_clear_cpu(cpu, &cpu_pmu->poll_cpus);
+		}
+
+		/* one SPI for several cores, see armpmu_rotate_irq() */
+		if (irqs == 1 && !cpu_pmu->irq_affinity &&
+		    !cpumask_empty(&cpu_pmu->active_irqs) &&
+		    cpumask_weight(&cpu_pmu->supported_cpus) > 1) {
+			cpu_pmu->irq_rotate = true;
+			cpumask_clear(&cpu_pmu->poll_cpus);
 		}
 	}
 
@@ -847,6 +950,9 @@ static int cpu_pmu_init(struct arm_pmu *cpu_pmu)
 		struct pmu_hw_events *events = per_cpu_ptr(cpu_hw_events, cpu);
 		raw_spin_lock_init(&events->pmu_lock);
 		events->percpu_pmu = cpu_pmu;
+		hrtimer_init(&events->poll_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL_PINNED);
+		events->poll_timer.function = armpmu_poll;
 	}
 
 	cpu_pmu->hw_events	= cpu_hw_events;
@@ -858,8 +964,11 @@ static int cpu_pmu_init(struct arm_pmu *cpu_pmu)
 		on_each_cpu_mask(&cpu_pmu->supported_cpus, cpu_pmu->reset,
 			 cpu_pmu, 1);
 
-	/* If no interrupts available, set the corresponding capability flag */
-	if (!platform_get_irq(cpu_pmu->plat_device, 0))
+	/*
+	 * If no interrupts available and overflows are not polled either,
+	 * set the corresponding capability flag
+	 */
+	if (!platform_get_irq(cpu_pmu->plat_device, 0) && !poll_period_us)
 		cpu_pmu->pmu.capabilities |= PERF_PMU_CAP_NO_INTERRUPT;
 
 	/*
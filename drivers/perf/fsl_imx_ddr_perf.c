@@ -0,0 +1,575 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * Perf PMU for the performance monitor of the i.MX DDR controller (DDRC),
+ * modelled on the i.MX6 MMDC PMU in arch/arm/mach-imx/mmdc.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/bitfield.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/of_device.h>
+#include <linux/of_irq.h>
+#include <linux/perf_event.h>
+#include <linux/slab.h>
+
+#define COUNTER_CNTL		0x0
+#define COUNTER_READ		0x20
+#define COUNTER_DPCR1		0x30
+
+#define CNTL_OVER		BIT(0)
+#define CNTL_CLEAR		BIT(1)
+#define CNTL_EN			BIT(2)
+#define CNTL_CSV_MASK		GENMASK(31, 24)
+
+#define EVENT_CYCLES_ID		0x00
+#define EVENT_AXID_READ		0x41
+#define EVENT_AXID_WRITE	0x42
+#define EVENT_MAX		0xff
+
+#define CYCLES_COUNTER		0
+#define NUM_COUNTERS		4
+
+#define AXI_ID_MASK		GENMASK(15, 0)
+#define AXI_MASK_SHIFT		16
+
+#define DRIVER_NAME		"imx-ddr-pmu"
+
+#define to_ddr_pmu(p) container_of(p, struct ddr_pmu, pmu)
+
+static enum cpuhp_state cpuhp_ddr_state;
+static DEFINE_IDA(ddr_ida);
+
+PMU_EVENT_ATTR_STRING(cycles, ddr_pmu_cycles, "event=0x00")
+PMU_EVENT_ATTR_STRING(selfresh, ddr_pmu_selfresh, "event=0x01")
+PMU_EVENT_ATTR_STRING(read-accesses, ddr_pmu_read_accesses, "event=0x04")
+PMU_EVENT_ATTR_STRING(write-accesses, ddr_pmu_write_accesses, "event=0x05")
+PMU_EVENT_ATTR_STRING(read-queue-depth, ddr_pmu_read_queue_depth, "event=0x08")
+PMU_EVENT_ATTR_STRING(write-queue-depth, ddr_pmu_write_queue_depth, "event=0x09")
+PMU_EVENT_ATTR_STRING(read-command, ddr_pmu_read_command, "event=0x20")
+PMU_EVENT_ATTR_STRING(write-command, ddr_pmu_write_command, "event=0x21")
+PMU_EVENT_ATTR_STRING(read-modify-write-command, ddr_pmu_rmw_command, "event=0x22")
+PMU_EVENT_ATTR_STRING(read-cycles, ddr_pmu_read_cycles, "event=0x2a")
+PMU_EVENT_ATTR_STRING(write-cycles, ddr_pmu_write_cycles, "event=0x2b")
+PMU_EVENT_ATTR_STRING(read-write-transition, ddr_pmu_rw_transition, "event=0x30")
+PMU_EVENT_ATTR_STRING(precharge, ddr_pmu_precharge, "event=0x31")
+PMU_EVENT_ATTR_STRING(activate, ddr_pmu_activate, "event=0x32")
+PMU_EVENT_ATTR_STRING(refresh, ddr_pmu_refresh, "event=0x37")
+PMU_EVENT_ATTR_STRING(raw-hazard, ddr_pmu_raw_hazard, "event=0x39")
+PMU_EVENT_ATTR_STRING(axid-read, ddr_pmu_axid_read, "event=0x41")
+PMU_EVENT_ATTR_STRING(axid-write, ddr_pmu_axid_write, "event=0x42")
+PMU_EVENT_ATTR_STRING(read-bytes, ddr_pmu_read_bytes, "event=0x41,axi_mask=0xffff")
+PMU_EVENT_ATTR_STRING(read-bytes.unit, ddr_pmu_read_bytes_unit, "MB");
+PMU_EVENT_ATTR_STRING(read-bytes.scale, ddr_pmu_read_bytes_scale, "0.000001");
+PMU_EVENT_ATTR_STRING(write-bytes, ddr_pmu_write_bytes, "event=0x42,axi_mask=0xffff")
+PMU_EVENT_ATTR_STRING(write-bytes.unit, ddr_pmu_write_bytes_unit, "MB");
+PMU_EVENT_ATTR_STRING(write-bytes.scale, ddr_pmu_write_bytes_scale, "0.000001");
+
+struct ddr_pmu {
+	struct pmu pmu;
+	void __iomem *base;
+	cpumask_t cpu;
+	struct hlist_node node;
+	struct device *dev;
+	struct perf_event *events[NUM_COUNTERS];
+	unsigned int active_events;
+	/* DPCR1 is shared by the axid-read and axid-write counters */
+	unsigned int axi_users;
+	u64 axi_filter;
+	int irq;
+	int id;
+};
+
+static ssize_t ddr_pmu_cpumask_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ddr_pmu *pmu = dev_get_drvdata(dev);
+
+	return cpumap_print_to_pagebuf(true, buf, &pmu->cpu);
+}
+
+static struct device_attribute ddr_pmu_cpumask_attr =
+	__ATTR(cpumask, S_IRUGO, ddr_pmu_cpumask_show, NULL);
+
+static struct attribute *ddr_pmu_cpumask_attrs[] = {
+	&ddr_pmu_cpumask_attr.attr,
+	NULL,
+};
+
+static struct attribute_group ddr_pmu_cpumask_attr_group = {
+	.attrs = ddr_pmu_cpumask_attrs,
+};
+
+static struct attribute *ddr_pmu_events_attrs[] = {
+	&ddr_pmu_cycles.attr.attr,
+	&ddr_pmu_selfresh.attr.attr,
+	&ddr_pmu_read_accesses.attr.attr,
+	&ddr_pmu_write_accesses.attr.attr,
+	&ddr_pmu_read_queue_depth.attr.attr,
+	&ddr_pmu_write_queue_depth.attr.attr,
+	&ddr_pmu_read_command.attr.attr,
+	&ddr_pmu_write_command.attr.attr,
+	&ddr_pmu_rmw_command.attr.attr,
+	&ddr_pmu_read_cycles.attr.attr,
+	&ddr_pmu_write_cycles.attr.attr,
+	&ddr_pmu_rw_transition.attr.attr,
+	&ddr_pmu_precharge.attr.attr,
+	&ddr_pmu_activate.attr.attr,
+	&ddr_pmu_refresh.attr.attr,
+	&ddr_pmu_raw_hazard.attr.attr,
+	&ddr_pmu_axid_read.attr.attr,
+	&ddr_pmu_axid_write.attr.attr,
+	&ddr_pmu_read_bytes.attr.attr,
+	&ddr_pmu_read_bytes_unit.attr.attr,
+	&ddr_pmu_read_bytes_scale.attr.attr,
+	&ddr_pmu_write_bytes.attr.attr,
+	&ddr_pmu_write_bytes_unit.attr.attr,
+	&ddr_pmu_write_bytes_scale.attr.attr,
+	NULL,
+};
+
+static struct attribute_group ddr_pmu_events_attr_group = {
+	.name = "events",
+	.attrs = ddr_pmu_events_attrs,
+};
+
+/* axi_mask bits set to one are ignored when matching axi_id */
+PMU_FORMAT_ATTR(event, "config:0-7");
+PMU_FORMAT_ATTR(axi_id, "config1:0-15");
+PMU_FORMAT_ATTR(axi_mask, "config1:16-31");
+
+static struct attribute *ddr_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	&format_attr_axi_id.attr,
+	&format_attr_axi_mask.attr,
+	NULL,
+};
+
+static struct attribute_group ddr_pmu_format_attr_group = {
+	.name = "format",
+	.attrs = ddr_pmu_format_attrs,
+};
+
+static const struct attribute_group *attr_groups[] = {
+	&ddr_pmu_events_attr_group,
+	&ddr_pmu_format_attr_group,
+	&ddr_pmu_cpumask_attr_group,
+	NULL,
+};
+
+static bool ddr_perf_is_axid(struct perf_event *event)
+{
+	return event->attr.config == EVENT_AXID_READ ||
+	       event->attr.config == EVENT_AXID_WRITE;
+}
+
+static u32 ddr_perf_read_counter(struct ddr_pmu *pmu, int counter)
+{
+	return readl(pmu->base + COUNTER_READ + counter * 4);
+}
+
+/*
+ * The cycle counter gates all the others: they only count while it is
+ * enabled and they all stop when it overflows. Enabling a counter also
+ * clears it.
+ */
+static void ddr_perf_counter_enable(struct ddr_pmu *pmu, int config,
+				    int counter, bool enable)
+{
+	void __iomem *reg = pmu->base + COUNTER_CNTL + counter * 4;
+	u32 val;
+
+	if (enable) {
+		/* the cycle counter only clears on a 0 to 1 CLEAR edge */
+		writel(0, reg);
+		val = CNTL_EN | CNTL_CLEAR | FIELD_PREP(CNTL_CSV_MASK, config);
+		writel(val, reg);
+	} else {
+		val = readl(reg) & ~CNTL_EN;
+		writel(val, reg);
+	}
+}
+
+static void ddr_perf_write_axi_filter(struct ddr_pmu *pmu, u64 config1)
+{
+	u32 id = config1 & AXI_ID_MASK;
+	u32 mask = (config1 >> AXI_MASK_SHIFT) & AXI_ID_MASK;
+
+	/* the hardware compares the bits which are set in its mask */
+	writel(id | (~mask & AXI_ID_MASK) << AXI_MASK_SHIFT,
+	       pmu->base + COUNTER_DPCR1);
+}
+
+static int ddr_perf_offline_cpu(unsigned int cpu, struct hlist_node *node)
+{
+	struct ddr_pmu *pmu = hlist_entry_safe(node, struct ddr_pmu, node);
+	int target;
+
+	if (!cpumask_test_and_clear_cpu(cpu, &pmu->cpu))
+		return 0;
+
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	if (target >= nr_cpu_ids)
+		return 0;
+
+	perf_pmu_migrate_context(&pmu->pmu, cpu, target);
+	cpumask_set_cpu(target, &pmu->cpu);
+	WARN_ON(irq_set_affinity_hint(pmu->irq, &pmu->cpu));
+
+	return 0;
+}
+
+static bool ddr_perf_group_event_is_valid(struct perf_event *e,
+					 struct pmu *pmu, int *cycles,
+					 int *others, struct perf_event **axid)
+{
+	if (is_software_event(e))
+		return true;
+
+	if (e->pmu != pmu)
+		return false;
+
+	if (e->attr.config == EVENT_CYCLES_ID)
+		(*cycles)++;
+	else
+		(*others)++;
+
+	if (ddr_perf_is_axid(e)) {
+		if (*axid && (*axid)->attr.config1 != e->attr.config1)
+			return false;
+		*axid = e;
+	}
+
+	return true;
+}
+
+/*
+ * Counter 0 only counts cycles, the other three take any event but
+ * cycles. The axid events of a group must agree on the AXI filter.
+ */
+static bool ddr_perf_group_is_valid(struct perf_event *event)
+{
+	struct pmu *pmu = event->pmu;
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	struct perf_event *axid = NULL;
+	int cycles = 0, others = 0;
+
+	if (!ddr_perf_group_event_is_valid(leader, pmu, &cycles, &others,
+					   &axid))
+		return false;
+
+	if (event != leader) {
+		if (!ddr_perf_group_event_is_valid(event, pmu, &cycles,
+						   &others, &axid))
+			return false;
+	}
+
+	list_for_each_entry(sibling, &leader->sibling_list, group_entry) {
+		if (!ddr_perf_group_event_is_valid(sibling, pmu, &cycles,
+						   &others, &axid))
+			return false;
+	}
+
+	return cycles <= 1 && others <= NUM_COUNTERS - 1;
+}
+
+static int ddr_perf_event_init(struct perf_event *event)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	u64 cfg = event->attr.config;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+
+	if (event->cpu < 0) {
+		dev_warn(pmu->dev, "Can't provide per-task data!\n");
+		return -EOPNOTSUPP;
+	}
+
+	if (event->attr.exclude_user		||
+			event->attr.exclude_kernel	||
+			event->attr.exclude_hv		||
+			event->attr.exclude_idle	||
+			event->attr.exclude_host	||
+			event->attr.exclude_guest	||
+			event->attr.sample_period)
+		return -EINVAL;
+
+	if (cfg > EVENT_MAX)
+		return -EINVAL;
+
+	if (!ddr_perf_group_is_valid(event))
+		return -EINVAL;
+
+	event->cpu = cpumask_first(&pmu->cpu);
+	event->hw.idx = -1;
+	return 0;
+}
+
+static void ddr_perf_event_update(struct perf_event *event)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 delta, prev_raw_count, new_raw_count;
+
+	do {
+		prev_raw_count = local64_read(&hwc->prev_count);
+		new_raw_count = ddr_perf_read_counter(pmu, hwc->idx);
+	} while (local64_cmpxchg(&hwc->prev_count, prev_raw_count,
+		new_raw_count) != prev_raw_count);
+
+	delta = (new_raw_count - prev_raw_count) & 0xFFFFFFFF;
+
+	local64_add(delta, &event->count);
+}
+
+static void ddr_perf_event_start(struct perf_event *event, int flags)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	/* the cycle counter keeps running, the others restart from zero */
+	if (hwc->idx == CYCLES_COUNTER) {
+		local64_set(&hwc->prev_count,
+			    ddr_perf_read_counter(pmu, CYCLES_COUNTER));
+	} else {
+		local64_set(&hwc->prev_count, 0);
+		ddr_perf_counter_enable(pmu, event->attr.config, hwc->idx,
+					true);
+	}
+	hwc->state = 0;
+}
+
+static int ddr_perf_event_add(struct perf_event *event, int flags)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	int counter;
+
+	if (event->attr.config == EVENT_CYCLES_ID) {
+		counter = CYCLES_COUNTER;
+		if (pmu->events[counter])
+			return -EAGAIN;
+	} else {
+		for (counter = 1; counter < NUM_COUNTERS; counter++)
+			if (!pmu->events[counter])
+				break;
+		if (counter == NUM_COUNTERS)
+			return -EAGAIN;
+	}
+
+	if (ddr_perf_is_axid(event)) {
+		if (pmu->axi_users && pmu->axi_filter != event->attr.config1)
+			return -EAGAIN;
+		if (!pmu->axi_users++) {
+			pmu->axi_filter = event->attr.config1;
+			ddr_perf_write_axi_filter(pmu, pmu->axi_filter);
+		}
+	}
+
+	pmu->events[counter] = event;
+	hwc->idx = counter;
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	/* the cycle counter runs while anything counts, it gates the others */
+	if (!pmu->active_events++)
+		ddr_perf_counter_enable(pmu, EVENT_CYCLES_ID, CYCLES_COUNTER,
+					true);
+
+	if (flags & PERF_EF_START)
+		ddr_perf_event_start(event, flags);
+
+	return 0;
+}
+
+static void ddr_perf_event_stop(struct perf_event *event, int flags)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	if (hwc->idx != CYCLES_COUNTER)
+		ddr_perf_counter_enable(pmu, event->attr.config, hwc->idx,
+					false);
+	ddr_perf_event_update(event);
+	hwc->state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static void ddr_perf_event_del(struct perf_event *event, int flags)
+{
+	struct ddr_pmu *pmu = to_ddr_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+
+	ddr_perf_event_stop(event, PERF_EF_UPDATE);
+
+	if (ddr_perf_is_axid(event))
+		pmu->axi_users--;
+
+	pmu->events[hwc->idx] = NULL;
+	hwc->idx = -1;
+
+	if (!--pmu->active_events)
+		ddr_perf_counter_enable(pmu, EVENT_CYCLES_ID, CYCLES_COUNTER,
+					false);
+}
+
+static irqreturn_t ddr_perf_irq_handler(int irq, void *p)
+{
+	struct ddr_pmu *pmu = p;
+	struct perf_event *event;
+	int i;
+
+	/*
+	 * Only the cycle counter interrupts on overflow and that stops all
+	 * the counters. Cycles occur at least as often as any other event,
+	 * so no other counter can have wrapped since the previous overflow.
+	 */
+	for (i = 0; i < NUM_COUNTERS; i++) {
+		event = pmu->events[i];
+		if (event && !(event->hw.state & PERF_HES_STOPPED))
+			ddr_perf_event_update(event);
+	}
+
+	/* restarting the cycle counter clears it */
+	ddr_perf_counter_enable(pmu, EVENT_CYCLES_ID, CYCLES_COUNTER, true);
+	event = pmu->events[CYCLES_COUNTER];
+	if (event)
+		local64_set(&event->hw.prev_count, 0);
+
+	return IRQ_HANDLED;
+}
+
+static int ddr_perf_probe(struct platform_device *pdev)
+{
+	struct ddr_pmu *pmu;
+	struct resource *res;
+	void __iomem *base;
+	char *name;
+	int ret;
+
+	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	base = devm_ioremap_resource(&pdev->dev, res);
+	if (IS_ERR(base))
+		return PTR_ERR(base);
+
+	pmu = devm_kzalloc(&pdev->dev, sizeof(*pmu), GFP_KERNEL);
+	if (!pmu)
+		return -ENOMEM;
+
+	*pmu = (struct ddr_pmu) {
+		.pmu = (struct pmu) {
+			.task_ctx_nr    = perf_invalid_context,
+			.attr_groups    = attr_groups,
+			.event_init     = ddr_perf_event_init,
+			.add            = ddr_perf_event_add,
+			.del            = ddr_perf_event_del,
+			.start          = ddr_perf_event_start,
+			.stop           = ddr_perf_event_stop,
+			.read           = ddr_perf_event_update,
+		},
+		.base = base,
+		.dev = &pdev->dev,
+	};
+
+	pmu->id = ida_simple_get(&ddr_ida, 0, 0, GFP_KERNEL);
+	if (pmu->id < 0)
+		return pmu->id;
+
+	name = devm_kasprintf(&pdev->dev, GFP_KERNEL, "imx_ddr%d", pmu->id);
+	if (!name) {
+		ret = -ENOMEM;
+		goto ida_free;
+	}
+
+	/* The first instance registers the hotplug state */
+	if (!cpuhp_ddr_state) {
+		ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN,
+					      "perf/imx/ddr:online", NULL,
+					      ddr_perf_offline_cpu);
+		if (ret < 0) {
+			dev_err(&pdev->dev, "cpuhp_setup_state_multi failed\n");
+			goto ida_free;
+		}
+		cpuhp_ddr_state = ret;
+	}
+
+	cpumask_set_cpu(raw_smp_processor_id(), &pmu->cpu);
+
+	pmu->irq = platform_get_irq(pdev, 0);
+	if (pmu->irq < 0) {
+		dev_err(&pdev->dev, "failed to get irq: %d\n", pmu->irq);
+		ret = pmu->irq;
+		goto ida_free;
+	}
+
+	ret = devm_request_irq(&pdev->dev, pmu->irq, ddr_perf_irq_handler,
+			       IRQF_NOBALANCING | IRQF_NO_THREAD,
+			       DRIVER_NAME, pmu);
+	if (ret < 0) {
+		dev_err(&pdev->dev, "request irq failed: %d\n", ret);
+		goto ida_free;
+	}
+	WARN_ON(irq_set_affinity_hint(pmu->irq, &pmu->cpu));
+
+	/* Register the pmu instance for cpu hotplug */
+	cpuhp_state_add_instance_nocalls(cpuhp_ddr_state, &pmu->node);
+
+	ret = perf_pmu_register(&pmu->pmu, name, -1);
+	if (ret)
+		goto pmu_register_err;
+
+	platform_set_drvdata(pdev, pmu);
+	return 0;
+
+pmu_register_err:
+	dev_warn(&pdev->dev, "DDR Perf PMU failed (%d), disabled\n", ret);
+	cpuhp_state_remove_instance_nocalls(cpuhp_ddr_state, &pmu->node);
+	irq_set_affinity_hint(pmu->irq, NULL);
+ida_free:
+	ida_simple_remove(&ddr_ida, pmu->id);
+	return ret;
+}
+
+static int ddr_perf_remove(struct platform_device *pdev)
+{
+	struct ddr_pmu *pmu = platform_get_drvdata(pdev);
+
+	cpuhp_state_remove_instance_nocalls(cpuhp_ddr_state, &pmu->node);
+	irq_set_affinity_hint(pmu->irq, NULL);
+	perf_pmu_unregister(&pmu->pmu);
+	ida_simple_remove(&ddr_ida, pmu->id);
+	return 0;
+}
+
+static const struct of_device_id imx_ddr_pmu_dt_ids[] = {
+	{ .compatible = "fsl,imx8-ddr-pmu", },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, imx_ddr_pmu_dt_ids);
+
+static struct platform_driver imx_ddr_pmu_driver = {
+	.driver		= {
+		.name	= DRIVER_NAME,
+		.of_match_table = imx_ddr_pmu_dt_ids,
+	},
+	.probe		= ddr_perf_probe,
+	.remove		= ddr_perf_remove,
+};
+
+module_platform_driver(imx_ddr_pmu_driver);
+MODULE_DESCRIPTION("i.MX DDR controller perf PMU");
+MODULE_LICENSE("GPL v2");
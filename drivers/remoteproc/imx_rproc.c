@@ -0,0 +1,527 @@
+/*
+ * i.MX6SX/i.MX7D Cortex-M4 remote processor driver
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/imx_mu.h>
+#include <linux/imx_src.h>
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/io.h>
+#include <linux/of_address.h>
+#include <linux/of_device.h>
+#include <linux/of_irq.h>
+#include <linux/platform_device.h>
+#include <linux/remoteproc.h>
+#include <linux/uaccess.h>
+
+#include "remoteproc_internal.h"
+
+/* MU channel used for the vring kicks, the same as imx_rpmsg */
+#define IMX_RPROC_MU_CHANNEL	1
+#define IMX_RPROC_MU_RF		(MU_SR_RF0_MASK1 >> IMX_RPROC_MU_CHANNEL)
+
+#define IMX_RPROC_MEM_MAX	8
+
+/* memory private to the M4, mapped at probe and included in coredumps */
+#define ATT_OWN			BIT(0)
+
+/**
+ * struct imx_rproc_att - M4 to A core address translation
+ * @da: address in the M4 view
+ * @sa: address in the A core view
+ * @size: size of the window
+ * @flags: ATT_OWN for the M4 tightly coupled memories
+ */
+struct imx_rproc_att {
+	u32 da;
+	u32 sa;
+	u32 size;
+	int flags;
+};
+
+struct imx_rproc_dcfg {
+	const struct imx_rproc_att *att;
+	size_t att_size;
+};
+
+/**
+ * struct imx_rproc_mem - memory region mapped for the firmware loader
+ * @cpu_addr: A core virtual address
+ * @sys_addr: A core physical address
+ * @size: size of the region
+ */
+struct imx_rproc_mem {
+	void __iomem *cpu_addr;
+	phys_addr_t sys_addr;
+	size_t size;
+};
+
+/**
+ * struct imx_rproc - i.MX M4 remote processor state
+ * @dev: platform device
+ * @rproc: rproc handle
+ * @dcfg: SoC specific address translation
+ * @mem: regions the firmware may be loaded to
+ * @mem_num: number of entries in @mem
+ * @own_num: number of M4 private memories at the start of @mem
+ * @mu_base: MU registers
+ * @mu_irq: MU interrupt
+ * @pending_vqs: vq ids kicked by the M4 and not handled yet
+ */
+struct imx_rproc {
+	struct device *dev;
+	struct rproc *rproc;
+	const struct imx_rproc_dcfg *dcfg;
+	struct imx_rproc_mem mem[IMX_RPROC_MEM_MAX];
+	int mem_num;
+	int own_num;
+	void __iomem *mu_base;
+	int mu_irq;
+	unsigned long pending_vqs;
+};
+
+static const struct imx_rproc_att imx_rproc_att_imx7d[] = {
+	/* dev addr , sys addr  , size	    , flags */
+	/* OCRAM_S (M4 Boot code) - alias */
+	{ 0x00000000, 0x00180000, 0x00008000, 0 },
+	/* OCRAM_S (Code) */
+	{ 0x00180000, 0x00180000, 0x00008000, 0 },
+	/* OCRAM (Code) - alias */
+	{ 0x00900000, 0x00900000, 0x00020000, 0 },
+	/* TCML (Code) */
+	{ 0x1FFF8000, 0x007F8000, 0x00008000, ATT_OWN },
+	/* DDR (Code) - alias, first part of DDR (Data) */
+	{ 0x10000000, 0x80000000, 0x0FFF0000, 0 },
+
+	/* TCMU (Data) */
+	{ 0x20000000, 0x00800000, 0x00008000, ATT_OWN },
+	/* OCRAM (Data) */
+	{ 0x20200000, 0x00900000, 0x00020000, 0 },
+	/* DDR (Data) */
+	{ 0x80000000, 0x80000000, 0x60000000, 0 },
+};
+
+static const struct imx_rproc_att imx_rproc_att_imx6sx[] = {
+	/* dev addr , sys addr  , size	    , flags */
+	/* TCML (M4 Boot Code) - alias */
+	{ 0x00000000, 0x007F8000, 0x00008000, 0 },
+	/* OCRAM_S (Code) */
+	{ 0x00180000, 0x008F8000, 0x00004000, 0 },
+	/* TCML (Code) */
+	{ 0x1FFF8000, 0x007F8000, 0x00008000, ATT_OWN },
+	/* DDR (Code) - alias, first part of DDR (Data) */
+	{ 0x10000000, 0x80000000, 0x0FFF8000, 0 },
+
+	/* TCMU (Data) */
+	{ 0x20000000, 0x00800000, 0x00008000, ATT_OWN },
+	/* OCRAM_S (Data) */
+	{ 0x208F8000, 0x008F8000, 0x00004000, 0 },
+	/* DDR (Data) */
+	{ 0x80000000, 0x80000000, 0x60000000, 0 },
+};
+
+static const struct imx_rproc_dcfg imx_rproc_cfg_imx7d = {
+	.att		= imx_rproc_att_imx7d,
+	.att_size	= ARRAY_SIZE(imx_rproc_att_imx7d),
+};
+
+static const struct imx_rproc_dcfg imx_rproc_cfg_imx6sx = {
+	.att		= imx_rproc_att_imx6sx,
+	.att_size	= ARRAY_SIZE(imx_rproc_att_imx6sx),
+};
+
+static int imx_rproc_start(struct rproc *rproc)
+{
+	struct imx_rproc *priv = rproc->priv;
+	int ret;
+
+	ret = imx_src_m4_run(true);
+	if (ret)
+		dev_err(priv->dev, "failed to start the M4: %d\n", ret);
+
+	return ret;
+}
+
+static int imx_rproc_stop(struct rproc *rproc)
+{
+	struct imx_rproc *priv = rproc->priv;
+	int ret;
+
+	ret = imx_src_m4_run(false);
+	if (ret)
+		dev_err(priv->dev, "failed to stop the M4: %d\n", ret);
+
+	return ret;
+}
+
+static void imx_rproc_kick(struct rproc *rproc, int vqid)
+{
+	struct imx_rproc *priv = rproc->priv;
+
+	/* send the index of the triggered virtqueue as the mu payload */
+	MU_SendMessage(priv->mu_base, IMX_RPROC_MU_CHANNEL, vqid << 16);
+}
+
+static int imx_rproc_da_to_sys(struct imx_rproc *priv, u64 da, int len,
+			       u64 *sys)
+{
+	const struct imx_rproc_dcfg *dcfg = priv->dcfg;
+	int i;
+
+	/* parse address translation table */
+	for (i = 0; i < dcfg->att_size; i++) {
+		const struct imx_rproc_att *att = &dcfg->att[i];
+
+		if (da >= att->da && da + len <= att->da + att->size) {
+			*sys = att->sa + da - att->da;
+			return 0;
+		}
+	}
+
+	dev_warn(priv->dev, "translation failed: da = 0x%llx len = 0x%x\n",
+		 da, len);
+	return -ENOENT;
+}
+
+static void *imx_rproc_da_to_va(struct rproc *rproc, u64 da, int len)
+{
+	struct imx_rproc *priv = rproc->priv;
+	u64 sys;
+	int i;
+
+	if (len <= 0)
+		return NULL;
+
+	if (imx_rproc_da_to_sys(priv, da, len, &sys))
+		return NULL;
+
+	for (i = 0; i < priv->mem_num; i++) {
+		if (sys >= priv->mem[i].sys_addr && sys + len <=
+		    priv->mem[i].sys_addr + priv->mem[i].size) {
+			/* __force to make sparse happy with type conversion */
+			return (__force void *)(priv->mem[i].cpu_addr +
+						sys - priv->mem[i].sys_addr);
+		}
+	}
+
+	return NULL;
+}
+
+static const struct rproc_ops imx_rproc_ops = {
+	.start		= imx_rproc_start,
+	.stop		= imx_rproc_stop,
+	.kick		= imx_rproc_kick,
+	.da_to_va	= imx_rproc_da_to_va,
+};
+
+/*
+ * Map the M4 tightly coupled memories, plus the regions given in the
+ * device tree for firmware placed in OCRAM or DDR.
+ */
+static int imx_rproc_addr_init(struct imx_rproc *priv,
+			       struct platform_device *pdev)
+{
+	const struct imx_rproc_dcfg *dcfg = priv->dcfg;
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	int a, b = 0, err, nph;
+
+	for (a = 0; a < dcfg->att_size; a++) {
+		const struct imx_rproc_att *att = &dcfg->att[a];
+
+		if (!(att->flags & ATT_OWN))
+			continue;
+
+		if (b >= IMX_RPROC_MEM_MAX)
+			break;
+
+		priv->mem[b].cpu_addr = devm_ioremap_wc(dev, att->sa,
+							att->size);
+		if (!priv->mem[b].cpu_addr) {
+			dev_err(dev, "failed to remap %#x bytes from %#x\n",
+				att->size, att->sa);
+			return -ENOMEM;
+		}
+		priv->mem[b].sys_addr = att->sa;
+		priv->mem[b].size = att->size;
+		b++;
+	}
+	priv->own_num = b;
+
+	nph = of_count_phandle_with_args(np, "memory-region", NULL);
+	for (a = 0; a < nph; a++) {
+		struct device_node *node;
+		struct resource res;
+
+		if (b >= IMX_RPROC_MEM_MAX)
+			break;
+
+		node = of_parse_phandle(np, "memory-region", a);
+		err = of_address_to_resource(node, 0, &res);
+		of_node_put(node);
+		if (err) {
+			dev_err(dev, "unable to resolve memory region\n");
+			return err;
+		}
+
+		priv->mem[b].cpu_addr = devm_ioremap_wc(dev, res.start,
+							resource_size(&res));
+		if (!priv->mem[b].cpu_addr) {
+			dev_err(dev, "failed to remap %pr\n", &res);
+			return -ENOMEM;
+		}
+		priv->mem[b].sys_addr = res.start;
+		priv->mem[b].size = resource_size(&res);
+		b++;
+	}
+
+	priv->mem_num = b;
+
+	return 0;
+}
+
+static irqreturn_t imx_rproc_mu_thread(int irq, void *param)
+{
+	struct imx_rproc *priv = param;
+	unsigned long pending;
+	unsigned int vq_id;
+
+	while ((pending = xchg(&priv->pending_vqs, 0))) {
+		for_each_set_bit(vq_id, &pending, BITS_PER_LONG)
+			rproc_vq_interrupt(priv->rproc, vq_id);
+	}
+
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t imx_rproc_mu_isr(int irq, void *param)
+{
+	struct imx_rproc *priv = param;
+	u32 message, vq_id;
+
+	if (!(MU_ReadStatus(priv->mu_base) & IMX_RPROC_MU_RF))
+		return IRQ_NONE;
+
+	/* get message from receive buffer */
+	MU_ReceiveMsg(priv->mu_base, IMX_RPROC_MU_CHANNEL, &message);
+
+	vq_id = message >> 16;
+	if (vq_id >= BITS_PER_LONG) {
+		dev_err(priv->dev, "invalid mu message 0x%x\n", message);
+		return IRQ_HANDLED;
+	}
+	set_bit(vq_id, &priv->pending_vqs);
+
+	return IRQ_WAKE_THREAD;
+}
+
+static int imx_rproc_mu_init(struct imx_rproc *priv)
+{
+	struct device *dev = priv->dev;
+	struct device_node *np_mu;
+	struct resource res;
+	struct clk *clk;
+	int ret;
+
+	np_mu = of_find_compatible_node(NULL, NULL, "fsl,imx6sx-mu");
+	if (!np_mu) {
+		dev_err(dev, "Cannot find MU entry in device tree\n");
+		return -ENODEV;
+	}
+
+	ret = of_address_to_resource(np_mu, 0, &res);
+	priv->mu_irq = of_irq_get(np_mu, 0);
+	clk = of_clk_get(np_mu, 0);
+	of_node_put(np_mu);
+	if (ret)
+		return ret;
+
+	/* the MU is shared with the low power mode handshake */
+	priv->mu_base = devm_ioremap(dev, res.start, resource_size(&res));
+	if (!priv->mu_base)
+		return -ENOMEM;
+
+	if (!IS_ERR(clk)) {
+		ret = clk_prepare_enable(clk);
+		if (ret) {
+			dev_err(dev, "unable to enable mu clock\n");
+			return ret;
+		}
+	}
+
+	ret = request_threaded_irq(priv->mu_irq, imx_rproc_mu_isr,
+				   imx_rproc_mu_thread,
+				   IRQF_EARLY_RESUME | IRQF_SHARED,
+				   "imx-rproc-mu", priv);
+	if (ret) {
+		dev_err(dev, "register interrupt %d failed, rc %d\n",
+			priv->mu_irq, ret);
+		return ret;
+	}
+
+	MU_EnableRxFullInt(priv->mu_base, IMX_RPROC_MU_CHANNEL);
+
+	return 0;
+}
+
+/*
+ * Raw image of the M4 private memories, in the order of the address
+ * translation table. Best read once the M4 was stopped or crashed, to
+ * get its stacks and data for post-mortem analysis.
+ */
+static ssize_t imx_rproc_coredump_read(struct file *filp,
+				       char __user *userbuf,
+				       size_t count, loff_t *ppos)
+{
+	struct imx_rproc *priv = filp->private_data;
+	loff_t pos = *ppos, base = 0;
+	size_t done = 0;
+	void *buf;
+	int i;
+
+	buf = (void *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0; i < priv->own_num && done < count; i++) {
+		struct imx_rproc_mem *mem = &priv->mem[i];
+		size_t off, len;
+
+		if (pos >= base + mem->size) {
+			base += mem->size;
+			continue;
+		}
+
+		while (done < count && pos < base + mem->size) {
+			off = pos - base;
+			len = min_t(size_t, min(count - done, mem->size - off),
+				    PAGE_SIZE);
+			memcpy_fromio(buf, mem->cpu_addr + off, len);
+			if (copy_to_user(userbuf + done, buf, len)) {
+				free_page((unsigned long)buf);
+				return -EFAULT;
+			}
+			done += len;
+			pos += len;
+		}
+		base += mem->size;
+	}
+
+	free_page((unsigned long)buf);
+	*ppos = pos;
+
+	return done;
+}
+
+static const struct file_operations imx_rproc_coredump_ops = {
+	.read = imx_rproc_coredump_read,
+	.open = simple_open,
+	.llseek	= generic_file_llseek,
+};
+
+static const struct of_device_id imx_rproc_of_match[] = {
+	{ .compatible = "fsl,imx7d-cm4", .data = &imx_rproc_cfg_imx7d },
+	{ .compatible = "fsl,imx6sx-cm4", .data = &imx_rproc_cfg_imx6sx },
+	{},
+};
+MODULE_DEVICE_TABLE(of, imx_rproc_of_match);
+
+static int imx_rproc_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	const char *fw_name = NULL;
+	struct imx_rproc *priv;
+	struct rproc *rproc;
+	int ret;
+
+	of_property_read_string(np, "firmware-name", &fw_name);
+
+	rproc = rproc_alloc(dev, "imx-rproc", &imx_rproc_ops,
+			    fw_name, sizeof(*priv));
+	if (!rproc)
+		return -ENOMEM;
+
+	priv = rproc->priv;
+	priv->rproc = rproc;
+	priv->dev = dev;
+	priv->dcfg = of_device_get_match_data(dev);
+
+	dev_set_drvdata(dev, rproc);
+
+	ret = imx_rproc_addr_init(priv, pdev);
+	if (ret)
+		goto err_put_rproc;
+
+	ret = imx_rproc_mu_init(priv);
+	if (ret)
+		goto err_put_rproc;
+
+	/*
+	 * From here on the kernel owns the M4: a firmware started by the
+	 * bootloader is stopped, the one from /lib/firmware is loaded.
+	 */
+	if (imx_src_is_m4_enabled()) {
+		dev_info(dev, "stopping the M4 started by the bootloader\n");
+		imx_src_m4_run(false);
+	}
+
+	ret = rproc_add(rproc);
+	if (ret) {
+		dev_err(dev, "rproc_add failed\n");
+		goto err_free_irq;
+	}
+
+	if (rproc->dbg_dir)
+		debugfs_create_file("coredump", 0400, rproc->dbg_dir, priv,
+				    &imx_rproc_coredump_ops);
+
+	return 0;
+
+err_free_irq:
+	free_irq(priv->mu_irq, priv);
+err_put_rproc:
+	rproc_free(rproc);
+	return ret;
+}
+
+static int imx_rproc_remove(struct platform_device *pdev)
+{
+	struct rproc *rproc = platform_get_drvdata(pdev);
+	struct imx_rproc *priv = rproc->priv;
+
+	rproc_del(rproc);
+	free_irq(priv->mu_irq, priv);
+	rproc_free(rproc);
+
+	return 0;
+}
+
+static struct platform_driver imx_rproc_driver = {
+	.probe = imx_rproc_probe,
+	.remove = imx_rproc_remove,
+	.driver = {
+		.name = "imx-rproc",
+		.of_match_table = imx_rproc_of_match,
+	},
+};
+
+module_platform_driver(imx_rproc_driver);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("i.MX6SX/i.MX7D Cortex-M4 remote processor control driver");
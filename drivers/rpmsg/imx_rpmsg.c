@@ -12,23 +12,25 @@
  * http://www.gnu.org/copyleft/gpl.html
  */
 
-#include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/init.h>
-#include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/mailbox_client.h>
 #include <linux/module.h>
 #include <linux/notifier.h>
 #include <linux/of.h>
-#include <linux/of_address.h>
 #include <linux/of_device.h>
-#include <linux/of_irq.h>
 #include <linux/platform_device.h>
 #include <linux/rpmsg.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/virtio.h>
 #include <linux/virtio_config.h>
 #include <linux/virtio_ids.h>
 #include <linux/virtio_ring.h>
+#include <linux/virtio_rpmsg.h>
 #include <linux/imx_rpmsg.h>
 #include <linux/imx_mu.h>
 
@@ -46,6 +48,8 @@ struct imx_virdev {
 	int base_vq_id;
 	int num_of_vqs;
 	struct notifier_block nb;
+	struct virtio_rpmsg_config config;
+	bool event_idx;
 };
 
 struct imx_rpmsg_vproc {
@@ -65,13 +69,23 @@ static struct imx_mu_rpmsg_box mu_rpmsg_box = {
 	.name	= "m4",
 };
 
-#define MAX_NUM 10	/* enlarge it if overflow happen */
-
-static void __iomem *mu_base;
-static u32 m4_message[MAX_NUM];
-static u32 in_idx, out_idx;
-static DEFINE_SPINLOCK(mu_lock);
-static struct delayed_work rpmsg_work;
+/* MU channel used for the vring kicks, in both directions */
+#define RPMSG_MU_CHANNEL	1
+
+static struct mbox_client rpmsg_mbox_cl;
+static struct mbox_chan *rpmsg_chan;
+/* the kick words, which must stay put until the mailbox sent them */
+static u32 vq_kicks[MAX_VDEV_NUMS * 2];
+/* vq ids kicked by the remote and not handled yet, one bit per vq */
+static unsigned long pending_vqs;
+/* set while a caller of imx_rpmsg_poll() takes the kicks itself */
+static bool rx_polling;
+/* runs the virtqueue callbacks of the remote kicks, one context at a time */
+static DEFINE_MUTEX(rx_lock);
+static struct kthread_worker *rx_worker;
+static struct kthread_work rx_work;
+/* last kick written to the MU, protected by the vproc lock */
+static u32 last_kick = ~0;
 
 /*
  * For now, allocate 256 buffers of 512 bytes for each side. each buffer
@@ -92,8 +106,12 @@ static struct delayed_work rpmsg_work;
 #define RPMSG_VRING_ALIGN	(4096)
 
 /* With 256 buffers, our vring will occupy 3 pages */
-#define RPMSG_RING_SIZE	((DIV_ROUND_UP(vring_size(RPMSG_NUM_BUFS / 2, \
-				RPMSG_VRING_ALIGN), PAGE_SIZE)) * PAGE_SIZE)
+#define RPMSG_RING_SIZE(num_bufs)	\
+	(DIV_ROUND_UP(vring_size((num_bufs) / 2, RPMSG_VRING_ALIGN),	\
+		      PAGE_SIZE) * PAGE_SIZE)
+
+/* Each vring gets 32KB of the shared memory, see set_vring_phy_buf() */
+#define RPMSG_VRING_SPACE	(0x8000)
 
 #define to_imx_virdev(vd) container_of(vd, struct imx_virdev, vdev)
 #define to_imx_rpdev(vd, id) container_of(vd, struct imx_rpmsg_vproc, ivdev[id])
@@ -107,8 +125,35 @@ struct imx_rpmsg_vq_info {
 
 static u64 imx_rpmsg_get_features(struct virtio_device *vdev)
 {
+	struct imx_virdev *virdev = to_imx_virdev(vdev);
+	u64 features;
+
 	/* VIRTIO_RPMSG_F_NS has been made private */
-	return 1 << 0;
+	features = 1 << 0;
+
+	if (virdev->config.num_bufs != RPMSG_NUM_BUFS ||
+	    virdev->config.buf_size != RPMSG_BUF_SIZE)
+		features |= BIT_ULL(VIRTIO_RPMSG_F_BUFSZ);
+
+	/* the firmware honours used_event/avail_event */
+	if (virdev->event_idx)
+		features |= BIT_ULL(VIRTIO_RING_F_EVENT_IDX);
+
+	return features;
+}
+
+static void imx_rpmsg_get(struct virtio_device *vdev, unsigned int offset,
+			  void *buf, unsigned int len)
+{
+	struct imx_virdev *virdev = to_imx_virdev(vdev);
+
+	if (offset + len > sizeof(virdev->config)) {
+		dev_err(&vdev->dev, "invalid config access %u+%u\n",
+			offset, len);
+		return;
+	}
+
+	memcpy(buf, (u8 *)&virdev->config + offset, len);
 }
 
 static int imx_rpmsg_finalize_features(struct virtio_device *vdev)
@@ -123,11 +168,28 @@ static bool imx_rpmsg_notify(struct virtqueue *vq)
 {
 	unsigned int mu_rpmsg = 0;
 	struct imx_rpmsg_vq_info *rpvq = vq->priv;
+	int ret;
 
 	mu_rpmsg = rpvq->vq_id << 16;
 	mutex_lock(&rpvq->rpdev->lock);
+	/*
+	 * During bursts the previous kick for this virtqueue may not have
+	 * been read by the remote yet. It will drain every available buffer
+	 * once it reads it, so a second kick would only cost an interrupt.
+	 */
+	if (last_kick == mu_rpmsg && imx_mu_mbox_tx_pending(rpmsg_chan)) {
+		mutex_unlock(&rpvq->rpdev->lock);
+		return true;
+	}
 	/* send the index of the triggered virtqueue as the mu payload */
-	MU_SendMessage(mu_base, 1, mu_rpmsg);
+	vq_kicks[rpvq->vq_id] = mu_rpmsg;
+	ret = mbox_send_message(rpmsg_chan, &vq_kicks[rpvq->vq_id]);
+	if (ret < 0) {
+		mutex_unlock(&rpvq->rpdev->lock);
+		pr_err("failed to kick vq %d: %d\n", rpvq->vq_id, ret);
+		return false;
+	}
+	last_kick = mu_rpmsg;
 	mutex_unlock(&rpvq->rpdev->lock);
 
 	return true;
@@ -199,6 +261,7 @@ static struct virtqueue *rp_find_vq(struct virtio_device *vdev,
 	struct imx_rpmsg_vproc *rpdev = to_imx_rpdev(virdev,
 						     virdev->base_vq_id / 2);
 	struct imx_rpmsg_vq_info *rpvq;
+	unsigned int num_bufs = virdev->config.num_bufs;
 	struct virtqueue *vq;
 	int err;
 
@@ -208,18 +271,18 @@ static struct virtqueue *rp_find_vq(struct virtio_device *vdev,
 
 	/* ioremap'ing normal memory, so we cast away sparse's complaints */
 	rpvq->addr = (__force void *) ioremap_nocache(virdev->vring[index],
-							RPMSG_RING_SIZE);
+					RPMSG_RING_SIZE(num_bufs));
 	if (!rpvq->addr) {
 		err = -ENOMEM;
 		goto free_rpvq;
 	}
 
-	memset(rpvq->addr, 0, RPMSG_RING_SIZE);
+	memset(rpvq->addr, 0, RPMSG_RING_SIZE(num_bufs));
 
 	pr_debug("vring%d: phys 0x%x, virt 0x%p\n", index, virdev->vring[index],
 					rpvq->addr);
 
-	vq = vring_new_virtqueue(index, RPMSG_NUM_BUFS / 2, RPMSG_VRING_ALIGN,
+	vq = vring_new_virtqueue(index, num_bufs / 2, RPMSG_VRING_ALIGN,
 			vdev, true, rpvq->addr, imx_rpmsg_notify, callback,
 			name);
 	if (!vq) {
@@ -320,6 +383,7 @@ static void imx_rpmsg_vproc_release(struct device *dev)
 }
 
 static struct virtio_config_ops imx_rpmsg_config_ops = {
+	.get		= imx_rpmsg_get,
 	.get_features	= imx_rpmsg_get_features,
 	.finalize_features = imx_rpmsg_finalize_features,
 	.find_vqs	= imx_rpmsg_find_vqs,
@@ -359,7 +423,7 @@ static int set_vring_phy_buf(struct platform_device *pdev,
 		for (i = 0; i < vdev_nums; i++) {
 			rpdev->ivdev[i].vring[0] = start;
 			rpdev->ivdev[i].vring[1] = start +
-						   0x8000;
+						   RPMSG_VRING_SPACE;
 			start += 0x10000;
 			if (start > end) {
 				pr_err("Too small memory size %x!\n",
@@ -375,116 +439,166 @@ static int set_vring_phy_buf(struct platform_device *pdev,
 	return ret;
 }
 
-static void rpmsg_work_handler(struct work_struct *work)
+/*
+ * The remote firmware may use bigger or more buffers than the 512 x 512
+ * default. Both sides have to agree, so the geometry comes from the DT.
+ */
+static int imx_rpmsg_get_buf_geometry(struct device_node *np,
+				      struct virtio_rpmsg_config *config)
 {
-	u32 message;
-	unsigned long flags;
+	u32 num_bufs = RPMSG_NUM_BUFS, buf_size = RPMSG_BUF_SIZE;
 
-	spin_lock_irqsave(&mu_lock, flags);
-	/* handle all incoming mu message */
-	while (in_idx != out_idx) {
-		message = m4_message[out_idx % MAX_NUM];
-		spin_unlock_irqrestore(&mu_lock, flags);
+	of_property_read_u32(np, "rpmsg-num-bufs", &num_bufs);
+	of_property_read_u32(np, "rpmsg-buf-size", &buf_size);
 
-		blocking_notifier_call_chain(&(mu_rpmsg_box.notifier), 4,
-						(void *)(phys_addr_t)message);
+	/* vrings hold a power of two entries and must fit their window */
+	if (num_bufs < 2 || !is_power_of_2(num_bufs) ||
+	    vring_size(num_bufs / 2, RPMSG_VRING_ALIGN) > RPMSG_VRING_SPACE) {
+		pr_err("invalid rpmsg-num-bufs %u\n", num_bufs);
+		return -EINVAL;
+	}
+
+	config->num_bufs = num_bufs;
+	config->buf_size = buf_size;
+
+	return 0;
+}
 
-		spin_lock_irqsave(&mu_lock, flags);
-		m4_message[out_idx % MAX_NUM] = 0;
-		out_idx++;
+static void imx_rpmsg_handle_kicks(void)
+{
+	unsigned long pending;
+	unsigned int vq_id;
+
+	mutex_lock(&rx_lock);
+	/*
+	 * Kicks for the same virtqueue that arrived meanwhile were merged
+	 * by the rx callback. vring_interrupt() consumes every used
+	 * buffer, so one call per virtqueue is enough.
+	 */
+	while ((pending = xchg(&pending_vqs, 0))) {
+		for_each_set_bit(vq_id, &pending, BITS_PER_LONG)
+			blocking_notifier_call_chain(&(mu_rpmsg_box.notifier),
+					4, (void *)(phys_addr_t)(vq_id << 16));
 	}
-	spin_unlock_irqrestore(&mu_lock, flags);
+	mutex_unlock(&rx_lock);
 }
 
-static irqreturn_t imx_mu_rpmsg_isr(int irq, void *param)
+static void imx_rpmsg_rx_work(struct kthread_work *work)
 {
-	u32 irqs, message;
-	unsigned long flags;
-
-	irqs = MU_ReadStatus(mu_base);
-
-	/* RPMSG */
-	if (irqs & (1 << 26)) {
-		spin_lock_irqsave(&mu_lock, flags);
-		/* get message from receive buffer */
-		MU_ReceiveMsg(mu_base, 1, &message);
-		m4_message[in_idx % MAX_NUM] = message;
-		in_idx++;
-		/*
-		 * Too many mu message not be handled in timely, can enlarge
-		 * MAX_NUM
-		 */
-		if (in_idx == out_idx) {
-			spin_unlock_irqrestore(&mu_lock, flags);
-			pr_err("MU overflow!\n");
-			return IRQ_HANDLED;
-		}
-		spin_unlock_irqrestore(&mu_lock, flags);
+	imx_rpmsg_handle_kicks();
+}
+
+/* called from the MU interrupt, or from imx_rpmsg_poll() */
+static void imx_rpmsg_rx_callback(struct mbox_client *cl, void *msg)
+{
+	u32 message = *(u32 *)msg;
+	u32 vq_id = message >> 16;
 
-		schedule_delayed_work(&rpmsg_work, 0);
+	if (vq_id >= MAX_VDEV_NUMS * 2) {
+		pr_err("invalid mu message 0x%x\n", message);
+		return;
 	}
+	set_bit(vq_id, &pending_vqs);
 
-	return IRQ_HANDLED;
+	if (!READ_ONCE(rx_polling))
+		kthread_queue_work(rx_worker, &rx_work);
 }
 
+/**
+ * imx_rpmsg_poll_begin - take the vring kicks without interrupts
+ *
+ * Until imx_rpmsg_poll_end(), kicks to the remote spin on the MU instead
+ * of waiting for its transmit interrupt, and kicks from the remote are
+ * only seen by imx_rpmsg_poll(). Meant for short request/response
+ * exchanges, callers serialize among themselves.
+ */
+void imx_rpmsg_poll_begin(void)
+{
+	if (!rpmsg_chan)
+		return;
+
+	WRITE_ONCE(rx_polling, true);
+	imx_mu_mbox_set_poll(rpmsg_chan, true);
+}
+EXPORT_SYMBOL_GPL(imx_rpmsg_poll_begin);
+
+/**
+ * imx_rpmsg_poll - busy-wait for the remote
+ * @done: completed by the endpoint callback once the awaited reply is in
+ * @timeout_us: how long to spin
+ *
+ * Runs the virtqueue callbacks of the kicks that arrive meanwhile in the
+ * caller's context.
+ *
+ * Return: 0 once @done completed, -ETIMEDOUT if it did not in time.
+ */
+int imx_rpmsg_poll(struct completion *done, unsigned int timeout_us)
+{
+	ktime_t timeout = ktime_add_us(ktime_get(), timeout_us);
+
+	if (!rpmsg_chan)
+		return -ENODEV;
+
+	do {
+		if (mbox_client_peek_data(rpmsg_chan))
+			imx_rpmsg_handle_kicks();
+		if (completion_done(done))
+			return 0;
+		cpu_relax();
+	} while (ktime_before(ktime_get(), timeout));
+
+	return -ETIMEDOUT;
+}
+EXPORT_SYMBOL_GPL(imx_rpmsg_poll);
+
+/**
+ * imx_rpmsg_poll_end - go back to interrupt driven kicks
+ */
+void imx_rpmsg_poll_end(void)
+{
+	if (!rpmsg_chan)
+		return;
+
+	imx_mu_mbox_set_poll(rpmsg_chan, false);
+	WRITE_ONCE(rx_polling, false);
+	/* for kicks the interrupt latched while switching back */
+	kthread_queue_work(rx_worker, &rx_work);
+}
+EXPORT_SYMBOL_GPL(imx_rpmsg_poll_end);
+
 static int imx_rpmsg_probe(struct platform_device *pdev)
 {
 	int i, j, ret = 0;
-	u32 irq;
-	struct clk *clk;
-	struct device_node *np_mu;
 	struct device *dev = &pdev->dev;
 	struct device_node *np = pdev->dev.of_node;
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
 
 	variant = (enum imx_rpmsg_variants)of_device_get_match_data(dev);
 
-	/* Initialize the mu unit used by rpmsg */
-	np_mu = of_find_compatible_node(NULL, NULL, "fsl,imx6sx-mu");
-	if (!np_mu)
-		pr_info("Cannot find MU-RPMSG entry in device tree\n");
-	mu_base = of_iomap(np_mu, 0);
-	WARN_ON(!mu_base);
+	BLOCKING_INIT_NOTIFIER_HEAD(&(mu_rpmsg_box.notifier));
 
-	if (variant == IMX7ULP)
-		irq = of_irq_get(np_mu, 1);
-	else
-		irq = of_irq_get(np_mu, 0);
-
-	ret = request_irq(irq, imx_mu_rpmsg_isr,
-			  IRQF_EARLY_RESUME | IRQF_SHARED,
-			  "imx-mu-rpmsg", dev);
-	if (ret) {
-		pr_err("%s: register interrupt %d failed, rc %d\n",
-			__func__, irq, ret);
+	/* the kicks used to run in an irq thread, keep the same priority */
+	rx_worker = kthread_create_worker(0, "imx-rpmsg");
+	if (IS_ERR(rx_worker))
+		return PTR_ERR(rx_worker);
+	sched_setscheduler(rx_worker->task, SCHED_FIFO, &param);
+	kthread_init_work(&rx_work, imx_rpmsg_rx_work);
+
+	/* The MU driver enables its clock and tells the M4 it is ready */
+	rpmsg_mbox_cl.dev = dev;
+	rpmsg_mbox_cl.rx_callback = imx_rpmsg_rx_callback;
+	rpmsg_chan = imx_mu_mbox_request_channel(&rpmsg_mbox_cl,
+						 IMX_MU_TYPE_TXRX,
+						 RPMSG_MU_CHANNEL);
+	if (IS_ERR(rpmsg_chan)) {
+		ret = PTR_ERR(rpmsg_chan);
+		rpmsg_chan = NULL;
+		kthread_destroy_worker(rx_worker);
+		if (ret != -EPROBE_DEFER)
+			pr_err("no MU channel for rpmsg: %d\n", ret);
 		return ret;
 	}
 
-	if (variant == IMX7D) {
-		clk = of_clk_get(np_mu, 0);
-		if (IS_ERR(clk)) {
-			pr_err("mu clock source missing or invalid\n");
-			return PTR_ERR(clk);
-		}
-		ret = clk_prepare_enable(clk);
-		if (ret) {
-			pr_err("unable to enable mu clock\n");
-			return ret;
-		}
-	}
-
-	INIT_DELAYED_WORK(&rpmsg_work, rpmsg_work_handler);
-	/*
-	 * bit26 is used by rpmsg channels.
-	 * bit0 of MX7ULP_MU_CR used to let m4 to know MU is ready now
-	 */
-	if (variant == IMX7ULP) {
-		MU_EnableRxFullInt(mu_base, 1);
-		MU_SetFn(mu_base, 1);
-	} else {
-		MU_EnableRxFullInt(mu_base, 1);
-	}
-	BLOCKING_INIT_NOTIFIER_HEAD(&(mu_rpmsg_box.notifier));
-
 	pr_info("MU is ready for cross core communication!\n");
 
 	for (i = 0; i < ARRAY_SIZE(imx_rpmsg_vprocs); i++) {
@@ -512,6 +626,13 @@ static int imx_rpmsg_probe(struct platform_device *pdev)
 		}
 
 		for (j = 0; j < rpdev->vdev_nums; j++) {
+			ret = imx_rpmsg_get_buf_geometry(np,
+						&rpdev->ivdev[j].config);
+			if (ret)
+				return ret;
+			rpdev->ivdev[j].event_idx =
+				of_property_read_bool(np, "rpmsg-event-idx");
+
 			pr_debug("%s rpdev%d vdev%d: vring0 0x%x, vring1 0x%x\n",
 				 __func__, i, rpdev->vdev_nums,
 				 rpdev->ivdev[j].vring[0],
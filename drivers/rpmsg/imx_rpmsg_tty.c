@@ -15,28 +15,129 @@
 
 #include <linux/delay.h>
 #include <linux/kernel.h>
+#include <linux/kfifo.h>
 #include <linux/module.h>
 #include <linux/rpmsg.h>
+#include <linux/serial.h>
 #include <linux/tty.h>
 #include <linux/tty_driver.h>
 #include <linux/tty_flip.h>
 #include <linux/virtio.h>
+#include <linux/workqueue.h>
+
+/* this needs to be less then (RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) */
+#define RPMSG_MAX_SIZE		256
+#define MSG		"hello world!"
+
+#define RPMSGTTY_TX_FIFO_SIZE	4096
+
+/*
+ * Credit based flow control, off unless the firmware implements it too.
+ * Each side may have at most flow_window bytes in flight towards the
+ * other one. Every message then starts with a struct rpmsgtty_hdr giving
+ * back the credits for the bytes its sender consumed.
+ */
+static unsigned int flow_window;
+module_param(flow_window, uint, 0444);
+MODULE_PARM_DESC(flow_window, "flow control window in bytes, 0 to disable");
+
+struct rpmsgtty_hdr {
+	u32 credits;
+} __packed;
 
 /*
  * struct rpmsgtty_port - Wrapper struct for imx rpmsg tty port.
  * @port:		TTY port data
+ * @rx_lock:		serializes the flip buffer and the rx credits
+ * @rpdev:		rpmsg channel
+ * @tx_lock:		protects @tx_fifo and @tx_credits
+ * @tx_fifo:		bytes written to the tty and not sent yet
+ * @tx_work:		sends @tx_fifo in messages as large as possible
+ * @tx_buf:		message being sent, only used by @tx_work
+ * @tx_len:		bytes of @tx_fifo moved to @tx_buf and not sent yet
+ * @tx_credits:		bytes the remote can still take
+ * @rx_credits:		bytes consumed and not credited to the remote yet
+ * @throttled:		tty asked us to stop crediting the remote
  */
 struct rpmsgtty_port {
 	struct tty_port		port;
 	spinlock_t		rx_lock;
 	struct rpmsg_device	*rpdev;
+
+	spinlock_t		tx_lock;
+	DECLARE_KFIFO(tx_fifo, unsigned char, RPMSGTTY_TX_FIFO_SIZE);
+	struct work_struct	tx_work;
+	unsigned char		tx_buf[RPMSG_MAX_SIZE];
+	unsigned int		tx_len;
+	unsigned int		tx_credits;
+
+	unsigned int		rx_credits;
+	bool			throttled;
 };
 
 static struct rpmsgtty_port rpmsg_tty_port;
 
-/* this needs to be less then (RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) */
-#define RPMSG_MAX_SIZE		256
-#define MSG		"hello world!"
+static void rpmsgtty_tx_work(struct work_struct *work)
+{
+	struct rpmsgtty_port *cport = container_of(work, struct rpmsgtty_port,
+						   tx_work);
+	struct rpmsg_device *rpdev = cport->rpdev;
+	struct rpmsgtty_hdr *hdr = (struct rpmsgtty_hdr *)cport->tx_buf;
+	size_t hlen = flow_window ? sizeof(*hdr) : 0;
+	unsigned int count, credits;
+	int ret;
+
+	for (;;) {
+		credits = 0;
+
+		spin_lock_bh(&cport->rx_lock);
+		if (flow_window && !cport->throttled) {
+			credits = cport->rx_credits;
+			cport->rx_credits = 0;
+		}
+		spin_unlock_bh(&cport->rx_lock);
+
+		spin_lock_bh(&cport->tx_lock);
+		/* a message that failed to go out is retried first */
+		if (!cport->tx_len) {
+			count = min_t(unsigned int,
+				      kfifo_len(&cport->tx_fifo),
+				      RPMSG_MAX_SIZE - hlen);
+			if (flow_window)
+				count = min(count, cport->tx_credits);
+			cport->tx_len = kfifo_out(&cport->tx_fifo,
+						  cport->tx_buf + hlen, count);
+		}
+		count = cport->tx_len;
+		spin_unlock_bh(&cport->tx_lock);
+
+		if (!count && !credits)
+			break;
+
+		if (flow_window)
+			hdr->credits = credits;
+
+		/* send a message to our remote processor */
+		ret = rpmsg_send(rpdev->ept, cport->tx_buf, hlen + count);
+		if (ret) {
+			dev_err(&rpdev->dev, "rpmsg_send failed: %d\n", ret);
+			/* tx_buf is kept and resent on the next write */
+			spin_lock_bh(&cport->rx_lock);
+			cport->rx_credits += credits;
+			spin_unlock_bh(&cport->rx_lock);
+			break;
+		}
+
+		spin_lock_bh(&cport->tx_lock);
+		cport->tx_len = 0;
+		cport->tx_credits -= flow_window ? count : 0;
+		cport->port.icount.tx += count;
+		spin_unlock_bh(&cport->tx_lock);
+
+		if (count)
+			tty_port_tty_wakeup(&cport->port);
+	}
+}
 
 static int rpmsg_tty_cb(struct rpmsg_device *rpdev, void *data, int len,
 						void *priv, u32 src)
@@ -44,6 +145,26 @@ static int rpmsg_tty_cb(struct rpmsg_device *rpdev, void *data, int len,
 	int space;
 	unsigned char *cbuf;
 	struct rpmsgtty_port *cport = &rpmsg_tty_port;
+	bool kick = false;
+
+	if (flow_window) {
+		struct rpmsgtty_hdr *hdr = data;
+
+		if (len < sizeof(*hdr)) {
+			dev_err(&rpdev->dev, "short message: %d\n", len);
+			return -EINVAL;
+		}
+
+		if (hdr->credits) {
+			spin_lock_bh(&cport->tx_lock);
+			cport->tx_credits += hdr->credits;
+			spin_unlock_bh(&cport->tx_lock);
+			schedule_work(&cport->tx_work);
+		}
+
+		data += sizeof(*hdr);
+		len -= sizeof(*hdr);
+	}
 
 	/* flush the recv-ed none-zero data to tty node */
 	if (len == 0)
@@ -56,16 +177,36 @@ static int rpmsg_tty_cb(struct rpmsg_device *rpdev, void *data, int len,
 
 	spin_lock_bh(&cport->rx_lock);
 	space = tty_prepare_flip_string(&cport->port, &cbuf, len);
-	if (space <= 0) {
-		dev_err(&rpdev->dev, "No memory for tty_prepare_flip_string\n");
-		spin_unlock_bh(&cport->rx_lock);
-		return -ENOMEM;
+	if (space < len) {
+		dev_err_ratelimited(&rpdev->dev,
+				    "tty buffer full, %d bytes dropped\n",
+				    len - max(space, 0));
+		cport->port.icount.buf_overrun += len - max(space, 0);
+		if (space <= 0) {
+			spin_unlock_bh(&cport->rx_lock);
+			return -ENOMEM;
+		}
 	}
 
-	memcpy(cbuf, data, len);
+	memcpy(cbuf, data, space);
+	cport->port.icount.rx += space;
 	tty_flip_buffer_push(&cport->port);
+
+	/*
+	 * The bytes are out of the remote's window once in the flip buffer.
+	 * Hand the credits back in batches, unless the line discipline is
+	 * full in which case they are held until it unthrottles.
+	 */
+	if (flow_window) {
+		cport->rx_credits += len;
+		kick = !cport->throttled &&
+		       cport->rx_credits >= flow_window / 2;
+	}
 	spin_unlock_bh(&cport->rx_lock);
 
+	if (kick)
+		schedule_work(&cport->tx_work);
+
 	return 0;
 }
 
@@ -89,43 +230,91 @@ static void rpmsgtty_close(struct tty_struct *tty, struct file *filp)
 static int rpmsgtty_write(struct tty_struct *tty, const unsigned char *buf,
 			 int total)
 {
-	int count, ret = 0;
-	const unsigned char *tbuf;
-	struct rpmsgtty_port *rptty_port = container_of(tty->port,
+	struct rpmsgtty_port *cport = container_of(tty->port,
 			struct rpmsgtty_port, port);
-	struct rpmsg_device *rpdev = rptty_port->rpdev;
+	int count;
 
 	if (NULL == buf) {
 		pr_err("buf shouldn't be null.\n");
 		return -ENOMEM;
 	}
 
-	count = total;
-	tbuf = buf;
-	do {
-		/* send a message to our remote processor */
-		ret = rpmsg_send(rpdev->ept, (void *)tbuf,
-			count > RPMSG_MAX_SIZE ? RPMSG_MAX_SIZE : count);
-		if (ret) {
-			dev_err(&rpdev->dev, "rpmsg_send failed: %d\n", ret);
-			return ret;
-		}
+	/* small writes are merged into full size messages by the tx work */
+	spin_lock_bh(&cport->tx_lock);
+	count = kfifo_in(&cport->tx_fifo, buf, total);
+	spin_unlock_bh(&cport->tx_lock);
 
-		if (count > RPMSG_MAX_SIZE) {
-			count -= RPMSG_MAX_SIZE;
-			tbuf += RPMSG_MAX_SIZE;
-		} else {
-			count = 0;
-		}
-	} while (count > 0);
+	if (count)
+		schedule_work(&cport->tx_work);
 
-	return total;
+	return count;
 }
 
 static int rpmsgtty_write_room(struct tty_struct *tty)
 {
-	/* report the space in the rpmsg buffer */
-	return RPMSG_MAX_SIZE;
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	/* report the space in the tx fifo */
+	return kfifo_avail(&cport->tx_fifo);
+}
+
+static int rpmsgtty_chars_in_buffer(struct tty_struct *tty)
+{
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	return kfifo_len(&cport->tx_fifo) + cport->tx_len;
+}
+
+static void rpmsgtty_flush_buffer(struct tty_struct *tty)
+{
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	spin_lock_bh(&cport->tx_lock);
+	kfifo_reset_out(&cport->tx_fifo);
+	spin_unlock_bh(&cport->tx_lock);
+
+	tty_wakeup(tty);
+}
+
+static void rpmsgtty_throttle(struct tty_struct *tty)
+{
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	spin_lock_bh(&cport->rx_lock);
+	cport->throttled = true;
+	spin_unlock_bh(&cport->rx_lock);
+}
+
+static void rpmsgtty_unthrottle(struct tty_struct *tty)
+{
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	spin_lock_bh(&cport->rx_lock);
+	cport->throttled = false;
+	spin_unlock_bh(&cport->rx_lock);
+
+	/* give back the credits held while throttled */
+	if (flow_window)
+		schedule_work(&cport->tx_work);
+}
+
+static int rpmsgtty_get_icount(struct tty_struct *tty,
+			       struct serial_icounter_struct *icount)
+{
+	struct rpmsgtty_port *cport = container_of(tty->port,
+			struct rpmsgtty_port, port);
+
+	memset(icount, 0, sizeof(*icount));
+	icount->rx = cport->port.icount.rx;
+	icount->tx = cport->port.icount.tx;
+	icount->buf_overrun = cport->port.icount.buf_overrun;
+
+	return 0;
 }
 
 static const struct tty_operations imxrpmsgtty_ops = {
@@ -134,6 +323,11 @@ static const struct tty_operations imxrpmsgtty_ops = {
 	.close			= rpmsgtty_close,
 	.write			= rpmsgtty_write,
 	.write_room		= rpmsgtty_write_room,
+	.chars_in_buffer	= rpmsgtty_chars_in_buffer,
+	.flush_buffer		= rpmsgtty_flush_buffer,
+	.throttle		= rpmsgtty_throttle,
+	.unthrottle		= rpmsgtty_unthrottle,
+	.get_icount		= rpmsgtty_get_icount,
 };
 
 static struct tty_driver *rpmsgtty_driver;
@@ -172,6 +366,12 @@ static int rpmsg_tty_probe(struct rpmsg_device *rpdev)
 	tty_port_init(&cport->port);
 	cport->port.ops = &rpmsgtty_port_ops;
 	spin_lock_init(&cport->rx_lock);
+	spin_lock_init(&cport->tx_lock);
+	INIT_KFIFO(cport->tx_fifo);
+	INIT_WORK(&cport->tx_work, rpmsgtty_tx_work);
+	cport->tx_credits = flow_window;
+	cport->rx_credits = 0;
+	cport->throttled = false;
 	cport->port.low_latency = cport->port.flags | ASYNC_LOW_LATENCY;
 
 	err = tty_register_driver(rpmsgtty_driver);
@@ -199,6 +399,7 @@ static void rpmsg_tty_remove(struct rpmsg_device *rpdev)
 
 	dev_info(&rpdev->dev, "rpmsg tty driver is removed\n");
 
+	cancel_work_sync(&cport->tx_work);
 	tty_unregister_driver(rpmsgtty_driver);
 	put_tty_driver(rpmsgtty_driver);
 	tty_port_destroy(&cport->port);
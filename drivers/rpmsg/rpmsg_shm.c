@@ -0,0 +1,338 @@
+/*
+ * rpmsg bulk transfers through shared memory buffer descriptors
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Bulk payloads (camera frames, audio periods) are written once into a
+ * buffer from a coherent pool shared with the remote processor. Only a
+ * small descriptor travels through the vring, so the data is never
+ * copied into or out of the rpmsg buffers.
+ */
+
+#define pr_fmt(fmt) "%s: " fmt, __func__
+
+#include <linux/bitmap.h>
+#include <linux/dma-mapping.h>
+#include <linux/genalloc.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/rpmsg.h>
+#include <linux/rpmsg_shm.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+/* cache line aligned, the remote may not be coherent with the A core */
+#define RPMSG_SHM_ORDER		6
+
+/**
+ * struct rpmsg_shm_pool - coherent memory shared with the remote
+ * @dev:	device the memory was allocated for
+ * @va:		kernel virtual address of the pool
+ * @dma:	bus address of the pool
+ * @size:	size of the pool
+ * @gen:	allocator for the buffers
+ * @lock:	protects @bufs and @ids
+ * @max_bufs:	number of buffers that may be allocated at once
+ * @bufs:	buffers indexed by id
+ * @ids:	bitmap of the ids in use
+ */
+struct rpmsg_shm_pool {
+	struct device *dev;
+	void *va;
+	dma_addr_t dma;
+	size_t size;
+	struct gen_pool *gen;
+	spinlock_t lock;
+	unsigned int max_bufs;
+	struct rpmsg_shm_buf **bufs;
+	unsigned long *ids;
+};
+
+/**
+ * rpmsg_shm_pool_create() - allocate a pool of memory shared with the remote
+ * @dma_dev: device the memory is allocated for, e.g. the rpmsg transport
+ * @size: size of the pool
+ * @max_bufs: maximum number of buffers allocated at once
+ *
+ * Returns the pool on success, or an ERR_PTR() on failure.
+ */
+struct rpmsg_shm_pool *rpmsg_shm_pool_create(struct device *dma_dev,
+					     size_t size, unsigned int max_bufs)
+{
+	struct rpmsg_shm_pool *pool;
+	int ret = -ENOMEM;
+
+	if (!size || !max_bufs || max_bufs > U16_MAX + 1)
+		return ERR_PTR(-EINVAL);
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	pool->dev = dma_dev;
+	pool->size = PAGE_ALIGN(size);
+	pool->max_bufs = max_bufs;
+	spin_lock_init(&pool->lock);
+
+	pool->bufs = kcalloc(max_bufs, sizeof(*pool->bufs), GFP_KERNEL);
+	pool->ids = kcalloc(BITS_TO_LONGS(max_bufs), sizeof(long), GFP_KERNEL);
+	if (!pool->bufs || !pool->ids)
+		goto free_pool;
+
+	pool->va = dma_alloc_coherent(dma_dev, pool->size, &pool->dma,
+				      GFP_KERNEL);
+	if (!pool->va)
+		goto free_pool;
+
+	pool->gen = gen_pool_create(RPMSG_SHM_ORDER, -1);
+	if (!pool->gen)
+		goto free_mem;
+
+	ret = gen_pool_add_virt(pool->gen, (unsigned long)pool->va, pool->dma,
+				pool->size, -1);
+	if (ret)
+		goto free_gen;
+
+	dev_dbg(dma_dev, "rpmsg shm pool: %zu bytes at %pad\n",
+		pool->size, &pool->dma);
+
+	return pool;
+
+free_gen:
+	gen_pool_destroy(pool->gen);
+free_mem:
+	dma_free_coherent(dma_dev, pool->size, pool->va, pool->dma);
+free_pool:
+	kfree(pool->ids);
+	kfree(pool->bufs);
+	kfree(pool);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL(rpmsg_shm_pool_create);
+
+/**
+ * rpmsg_shm_pool_destroy() - release a shared memory pool
+ * @pool: the pool
+ *
+ * All buffers must have been freed, and thus returned by the remote.
+ */
+void rpmsg_shm_pool_destroy(struct rpmsg_shm_pool *pool)
+{
+	if (IS_ERR_OR_NULL(pool))
+		return;
+
+	WARN_ON(!bitmap_empty(pool->ids, pool->max_bufs));
+
+	gen_pool_destroy(pool->gen);
+	dma_free_coherent(pool->dev, pool->size, pool->va, pool->dma);
+	kfree(pool->ids);
+	kfree(pool->bufs);
+	kfree(pool);
+}
+EXPORT_SYMBOL(rpmsg_shm_pool_destroy);
+
+/**
+ * rpmsg_shm_alloc() - allocate a bulk buffer
+ * @pool: the pool to allocate from
+ * @size: size of the buffer
+ *
+ * Returns the buffer, owned by the caller, or NULL if the pool is
+ * exhausted.
+ */
+struct rpmsg_shm_buf *rpmsg_shm_alloc(struct rpmsg_shm_pool *pool,
+				      size_t size)
+{
+	struct rpmsg_shm_buf *buf;
+	unsigned long flags;
+	unsigned int id;
+
+	if (!size || size > U32_MAX)
+		return NULL;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return NULL;
+
+	buf->va = gen_pool_dma_alloc(pool->gen, size, &buf->dma);
+	if (!buf->va)
+		goto free_buf;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	id = find_first_zero_bit(pool->ids, pool->max_bufs);
+	if (id < pool->max_bufs) {
+		set_bit(id, pool->ids);
+		pool->bufs[id] = buf;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (id >= pool->max_bufs)
+		goto free_mem;
+
+	buf->pool = pool;
+	buf->size = size;
+	buf->id = id;
+
+	return buf;
+
+free_mem:
+	gen_pool_free(pool->gen, (unsigned long)buf->va, size);
+free_buf:
+	kfree(buf);
+	return NULL;
+}
+EXPORT_SYMBOL(rpmsg_shm_alloc);
+
+/**
+ * rpmsg_shm_free() - free a bulk buffer
+ * @buf: the buffer, which must not be owned by the remote
+ */
+void rpmsg_shm_free(struct rpmsg_shm_buf *buf)
+{
+	struct rpmsg_shm_pool *pool;
+	unsigned long flags;
+
+	if (!buf)
+		return;
+
+	/* the remote may still be writing to it, leak it rather */
+	if (WARN_ON(buf->remote))
+		return;
+
+	pool = buf->pool;
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->bufs[buf->id] = NULL;
+	clear_bit(buf->id, pool->ids);
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	gen_pool_free(pool->gen, (unsigned long)buf->va, buf->size);
+	kfree(buf);
+}
+EXPORT_SYMBOL(rpmsg_shm_free);
+
+static int rpmsg_shm_hand_over(struct rpmsg_endpoint *ept,
+			       struct rpmsg_shm_buf *buf, u16 type, size_t len)
+{
+	struct rpmsg_shm_desc desc = {
+		.magic = RPMSG_SHM_MAGIC,
+		.type = type,
+		.id = buf->id,
+		.addr = buf->dma,
+		.size = buf->size,
+		.len = len,
+	};
+	int ret;
+
+	if (WARN_ON(buf->remote) || len > buf->size)
+		return -EINVAL;
+
+	buf->len = len;
+	buf->remote = true;
+	/* the data must be visible before the remote sees the descriptor */
+	wmb();
+
+	ret = rpmsg_send(ept, &desc, sizeof(desc));
+	if (ret)
+		buf->remote = false;
+
+	return ret;
+}
+
+/**
+ * rpmsg_shm_send() - hand a filled bulk buffer over to the remote
+ * @ept: the rpmsg endpoint
+ * @buf: the buffer
+ * @len: bytes of valid data in @buf
+ *
+ * On success the remote owns @buf until it returns it, see
+ * rpmsg_shm_recv().
+ */
+int rpmsg_shm_send(struct rpmsg_endpoint *ept, struct rpmsg_shm_buf *buf,
+		   size_t len)
+{
+	return rpmsg_shm_hand_over(ept, buf, RPMSG_SHM_DATA, len);
+}
+EXPORT_SYMBOL(rpmsg_shm_send);
+
+/**
+ * rpmsg_shm_post() - hand an empty bulk buffer over to the remote
+ * @ept: the rpmsg endpoint
+ * @buf: the buffer
+ *
+ * The remote fills @buf and returns it with the number of bytes
+ * written, see rpmsg_shm_recv().
+ */
+int rpmsg_shm_post(struct rpmsg_endpoint *ept, struct rpmsg_shm_buf *buf)
+{
+	return rpmsg_shm_hand_over(ept, buf, RPMSG_SHM_EMPTY, 0);
+}
+EXPORT_SYMBOL(rpmsg_shm_post);
+
+/**
+ * rpmsg_shm_is_desc() - check whether a message is a bulk buffer descriptor
+ * @data: the received message
+ * @len: length of @data
+ *
+ * Lets an endpoint mix descriptors and plain messages.
+ */
+bool rpmsg_shm_is_desc(const void *data, int len)
+{
+	const struct rpmsg_shm_desc *desc = data;
+
+	return len == sizeof(*desc) && desc->magic == RPMSG_SHM_MAGIC;
+}
+EXPORT_SYMBOL(rpmsg_shm_is_desc);
+
+/**
+ * rpmsg_shm_recv() - take a bulk buffer back from the remote
+ * @pool: the pool the buffer was allocated from
+ * @data: the received descriptor
+ * @len: length of @data
+ *
+ * To be called from the endpoint rx callback. Ownership of the returned
+ * buffer goes back to the caller, and @len of the buffer is set to the
+ * number of bytes the remote reports having written to it.
+ *
+ * Returns the buffer, or an ERR_PTR() if the descriptor is bogus.
+ */
+struct rpmsg_shm_buf *rpmsg_shm_recv(struct rpmsg_shm_pool *pool,
+				     const void *data, int len)
+{
+	const struct rpmsg_shm_desc *desc = data;
+	struct rpmsg_shm_buf *buf = NULL;
+	unsigned long flags;
+
+	if (!rpmsg_shm_is_desc(data, len) || desc->type != RPMSG_SHM_RETURN)
+		return ERR_PTR(-EINVAL);
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (desc->id < pool->max_bufs)
+		buf = pool->bufs[desc->id];
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (!buf || !buf->remote || desc->addr != buf->dma) {
+		dev_err(pool->dev, "bogus shm descriptor id %u addr 0x%llx\n",
+			desc->id, desc->addr);
+		return ERR_PTR(-EINVAL);
+	}
+
+	if (desc->len > buf->size) {
+		dev_err(pool->dev, "shm buffer %u overrun: %u > %zu\n",
+			desc->id, desc->len, buf->size);
+		return ERR_PTR(-EOVERFLOW);
+	}
+
+	/* don't read the payload before the descriptor */
+	rmb();
+	buf->len = desc->len;
+	buf->remote = false;
+
+	return buf;
+}
+EXPORT_SYMBOL(rpmsg_shm_recv);
+
+MODULE_DESCRIPTION("rpmsg shared memory bulk transfers");
+MODULE_LICENSE("GPL v2");
@@ -24,8 +24,10 @@
 #include <linux/virtio.h>
 #include <linux/virtio_ids.h>
 #include <linux/virtio_config.h>
+#include <linux/virtio_rpmsg.h>
 #include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/idr.h>
 #include <linux/jiffies.h>
@@ -45,6 +47,7 @@
  * @rbufs:	kernel address of rx buffers
  * @sbufs:	kernel address of tx buffers
  * @num_bufs:	total number of buffers for rx and tx
+ * @buf_size:	size of one rx/tx buffer, including the rpmsg header
  * @last_sbuf:	index of last tx buffer used
  * @bufs_dma:	dma base addr of the buffers
  * @tx_lock:	protects svq, sbufs and sleepers, to allow concurrent senders.
@@ -65,6 +68,7 @@ struct virtproc_info {
 	struct virtqueue *rvq, *svq;
 	void *rbufs, *sbufs;
 	unsigned int num_bufs;
+	unsigned int buf_size;
 	int last_sbuf;
 	dma_addr_t bufs_dma;
 	struct mutex tx_lock;
@@ -156,9 +160,13 @@ struct virtio_rpmsg_channel {
  * Note that these numbers are purely a decision of this driver - we
  * can change this without changing anything in the firmware of the remote
  * processor.
+ *
+ * A transport offering VIRTIO_RPMSG_F_BUFSZ overrides both numbers from
+ * its config space, within the limits below.
  */
 #define MAX_RPMSG_NUM_BUFS	(512)
 #define RPMSG_BUF_SIZE		(512)
+#define RPMSG_MAX_BUF_SIZE	(SZ_64K)
 
 /*
  * Local addresses are dynamically allocated on-demand.
@@ -429,7 +437,7 @@ static void *get_a_tx_buf(struct virtproc_info *vrp)
 	 * (half of our buffers are used for sending messages)
 	 */
 	if (vrp->last_sbuf < vrp->num_bufs / 2)
-		ret = vrp->sbufs + RPMSG_BUF_SIZE * vrp->last_sbuf++;
+		ret = vrp->sbufs + vrp->buf_size * vrp->last_sbuf++;
 	/* or recycle a used one */
 	else
 		ret = virtqueue_get_buf(vrp->svq, &len);
@@ -508,8 +516,7 @@ static int sg_init_one_full(struct scatterlist *sg, const void *buf,
 			return -ENOMEM;
 
 		sg_init_table(sg, 1);
-		sg_set_page(sg, vm_page, RPMSG_BUF_SIZE,
-				offset_in_page(buf));
+		sg_set_page(sg, vm_page, buflen, offset_in_page(buf));
 	} else
 		sg_init_one(sg, buf, buflen);
 
@@ -576,7 +583,7 @@ static int rpmsg_send_offchannel_raw(struct rpmsg_device *rpdev,
 	 * messaging), or to improve the buffer allocator, to support
 	 * variable-length buffer sizes.
 	 */
-	if (len > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) {
+	if (len > vrp->buf_size - sizeof(struct rpmsg_hdr)) {
 		dev_err(dev, "message is too big (%d)\n", len);
 		return -EMSGSIZE;
 	}
@@ -721,7 +728,7 @@ static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
 	 * We currently use fixed-sized buffers, so trivially sanitize
 	 * the reported payload length.
 	 */
-	if (len > RPMSG_BUF_SIZE ||
+	if (len > vrp->buf_size ||
 	    msg->len > (len - sizeof(struct rpmsg_hdr))) {
 		dev_warn(dev, "inbound msg too big: (%d, %d)\n", len, msg->len);
 		return -EINVAL;
@@ -754,7 +761,7 @@ static int rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
 		dev_warn(dev, "msg received with no recipient\n");
 
 	/* publish the real size of the buffer */
-	err = sg_init_one_full(&sg, msg, RPMSG_BUF_SIZE);
+	err = sg_init_one_full(&sg, msg, vrp->buf_size);
 	if (err) {
 		dev_err(dev, "rpmsg_recv_done sg_init failed: %d\n", err);
 		return err;
@@ -875,6 +882,37 @@ static int rpmsg_ns_cb(struct rpmsg_device *rpdev, void *data, int len,
 	return 0;
 }
 
+/*
+ * Pick the buffer size and the maximum number of buffers, either the
+ * defaults or what the transport advertises in its config space.
+ */
+static void rpmsg_get_buf_geometry(struct virtproc_info *vrp,
+				   unsigned int *max_bufs)
+{
+	struct virtio_device *vdev = vrp->vdev;
+	u32 num_bufs, buf_size;
+
+	vrp->buf_size = RPMSG_BUF_SIZE;
+	*max_bufs = MAX_RPMSG_NUM_BUFS;
+
+	if (!virtio_has_feature(vdev, VIRTIO_RPMSG_F_BUFSZ))
+		return;
+
+	virtio_cread(vdev, struct virtio_rpmsg_config, num_bufs, &num_bufs);
+	virtio_cread(vdev, struct virtio_rpmsg_config, buf_size, &buf_size);
+
+	if (buf_size <= sizeof(struct rpmsg_hdr) ||
+	    buf_size > RPMSG_MAX_BUF_SIZE || !IS_ALIGNED(buf_size, 8) ||
+	    num_bufs < 2 || num_bufs % 2) {
+		dev_warn(&vdev->dev, "invalid buffer geometry %u x %u, using defaults\n",
+			 num_bufs, buf_size);
+		return;
+	}
+
+	vrp->buf_size = buf_size;
+	*max_bufs = num_bufs;
+}
+
 static int rpmsg_probe(struct virtio_device *vdev)
 {
 	vq_callback_t *vq_cbs[] = { rpmsg_recv_done, rpmsg_xmit_done };
@@ -884,6 +922,7 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	void *bufs_va;
 	int err = 0, i;
 	size_t total_buf_space;
+	unsigned int max_bufs;
 	bool notify;
 
 	vrp = kzalloc(sizeof(*vrp), GFP_KERNEL);
@@ -909,13 +948,15 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	WARN_ON(virtqueue_get_vring_size(vrp->rvq) !=
 		virtqueue_get_vring_size(vrp->svq));
 
+	rpmsg_get_buf_geometry(vrp, &max_bufs);
+
 	/* we need less buffers if vrings are small */
-	if (virtqueue_get_vring_size(vrp->rvq) < MAX_RPMSG_NUM_BUFS / 2)
+	if (virtqueue_get_vring_size(vrp->rvq) < max_bufs / 2)
 		vrp->num_bufs = virtqueue_get_vring_size(vrp->rvq) * 2;
 	else
-		vrp->num_bufs = MAX_RPMSG_NUM_BUFS;
+		vrp->num_bufs = max_bufs;
 
-	total_buf_space = vrp->num_bufs * RPMSG_BUF_SIZE;
+	total_buf_space = vrp->num_bufs * vrp->buf_size;
 
 	/* allocate coherent memory for the buffers */
 	bufs_va = dma_alloc_coherent(vdev->dev.parent->parent,
@@ -938,9 +979,9 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	/* set up the receive buffers */
 	for (i = 0; i < vrp->num_bufs / 2; i++) {
 		struct scatterlist sg;
-		void *cpu_addr = vrp->rbufs + i * RPMSG_BUF_SIZE;
+		void *cpu_addr = vrp->rbufs + i * vrp->buf_size;
 
-		err = sg_init_one_full(&sg, cpu_addr, RPMSG_BUF_SIZE);
+		err = sg_init_one_full(&sg, cpu_addr, vrp->buf_size);
 		if (err) {
 			dev_err(&vdev->dev, "rpmsg_probe sg_init failed.\n");
 			return err;
@@ -985,7 +1026,8 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	if (notify)
 		virtqueue_notify(vrp->rvq);
 
-	dev_info(&vdev->dev, "rpmsg host is online\n");
+	dev_info(&vdev->dev, "rpmsg host is online, %u buffers of %u bytes\n",
+		 vrp->num_bufs, vrp->buf_size);
 
 	return 0;
 
@@ -1009,7 +1051,7 @@ static int rpmsg_remove_device(struct device *dev, void *data)
 static void rpmsg_remove(struct virtio_device *vdev)
 {
 	struct virtproc_info *vrp = vdev->priv;
-	size_t total_buf_space = vrp->num_bufs * RPMSG_BUF_SIZE;
+	size_t total_buf_space = vrp->num_bufs * vrp->buf_size;
 	int ret;
 
 	vdev->config->reset(vdev);
@@ -1038,6 +1080,7 @@ static struct virtio_device_id id_table[] = {
 
 static unsigned int features[] = {
 	VIRTIO_RPMSG_F_NS,
+	VIRTIO_RPMSG_F_BUFSZ,
 };
 
 static struct virtio_driver virtio_ipc_driver = {
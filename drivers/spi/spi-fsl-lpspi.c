@@ -18,6 +18,8 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
@@ -34,6 +36,9 @@
 
 #define DRIVER_NAME "fsl_lpspi"
 
+/* The maximum bytes that an eDMA transfer can move in one go */
+#define FSL_LPSPI_MAX_EDMA_BYTES	((1 << 15) - 1)
+
 /* i.MX7ULP LPSPI registers */
 #define IMX7ULP_VERID	0x0
 #define IMX7ULP_PARAM	0x4
@@ -64,6 +69,8 @@
 #define IER_TCIE	(1 << 10)
 #define IER_RDIE	(1 << 1)
 #define IER_TDIE	(1 << 0)
+#define DER_RDDE	(1 << 1)
+#define DER_TDDE	(1 << 0)
 #define CFGR1_PCSCFG	(1 << 27)	/* PCS[3:2] disabled */
 #define CFGR1_PCSPOL	(1 << 8)	/* PCS active high */
 #define CFGR1_NOSTALL   (1 << 3)	/* NO STALL */
@@ -92,6 +99,7 @@ struct fsl_lpspi_data {
 
 	struct completion xfer_done;
 	void __iomem *base;
+	unsigned long base_phys;
 	struct clk *clk;
 
 	void *rx_buf;
@@ -103,6 +111,14 @@ struct fsl_lpspi_data {
 	u8 txfifosize;
 	u8 rxfifosize;
 	unsigned remain;
+	bool configured;
+	bool cont_frame; /* PCS held from the previous transfer */
+
+	/* DMA */
+	bool usedma;
+	unsigned int dma_bytes_per_word;
+	struct completion dma_rx_completion;
+	struct completion dma_tx_completion;
 };
 
 static const struct of_device_id fsl_lpspi_dt_ids[] = {
@@ -183,7 +199,14 @@ static void fsl_lpspi_set_cmd(struct fsl_lpspi_data *fsl_lpspi)
 {
 	u32 temp = 0;
 
+	/*
+	 * Continue the frame of the previous transfer, so that PCS stays
+	 * asserted through the whole message unless cs_change asks to drop
+	 * it.
+	 */
 	temp |= TCR_CONT;
+	if (fsl_lpspi->cont_frame)
+		temp |= TCR_CONTC;
 	temp |= fsl_lpspi->config.bpw - 1;
 	temp |= fsl_lpspi->config.prescale << 27;
 	temp |= (fsl_lpspi->config.mode & 0x11) << 30;
@@ -206,6 +229,11 @@ static void fsl_lpspi_set_watermark(struct fsl_lpspi_data *fsl_lpspi)
 
 	rxwatermark = fsl_lpspi->txfifosize >> 1;
 	txwatermark = fsl_lpspi->rxfifosize >> 1;
+
+	/* The eDMA moves one word per RX request, including the tail */
+	if (fsl_lpspi->usedma)
+		rxwatermark = 0;
+
 	temp = txwatermark | rxwatermark << 16;
 
 	writel(temp, fsl_lpspi->base + IMX7ULP_FCR);
@@ -293,10 +321,95 @@ static irqreturn_t fsl_lpspi_isr(int irq, void *dev_id)
 	return IRQ_NONE;
 }
 
+static int fsl_lpspi_bytes_per_word(const int bpw)
+{
+	return DIV_ROUND_UP(bpw, BITS_PER_BYTE);
+}
+
+static bool fsl_lpspi_can_dma(struct spi_master *master,
+			      struct spi_device *spi,
+			      struct spi_transfer *transfer)
+{
+	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
+	unsigned int bpw;
+
+	if (!master->dma_rx || !transfer)
+		return false;
+
+	bpw = transfer->bits_per_word;
+	if (!bpw)
+		bpw = spi->bits_per_word;
+
+	bpw = fsl_lpspi_bytes_per_word(bpw);
+	if (bpw != 1 && bpw != 2 && bpw != 4)
+		return false;
+
+	/* Short messages are cheaper to push through the FIFO directly */
+	if (transfer->len < fsl_lpspi->txfifosize * bpw)
+		return false;
+
+	return !(transfer->len % bpw);
+}
+
+static int fsl_lpspi_dma_configure(struct spi_master *master,
+				   unsigned int bytes_per_word)
+{
+	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
+	struct dma_slave_config rx = {}, tx = {};
+	enum dma_slave_buswidth buswidth;
+	int ret;
+
+	if (bytes_per_word == fsl_lpspi->dma_bytes_per_word)
+		return 0;
+
+	switch (bytes_per_word) {
+	case 4:
+		buswidth = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		break;
+	case 2:
+		buswidth = DMA_SLAVE_BUSWIDTH_2_BYTES;
+		break;
+	case 1:
+		buswidth = DMA_SLAVE_BUSWIDTH_1_BYTE;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	tx.direction = DMA_MEM_TO_DEV;
+	tx.dst_addr = fsl_lpspi->base_phys + IMX7ULP_TDR;
+	tx.dst_addr_width = buswidth;
+	tx.dst_maxburst = 1;
+	ret = dmaengine_slave_config(master->dma_tx, &tx);
+	if (ret) {
+		dev_err(fsl_lpspi->dev, "TX dma configuration failed with %d\n",
+			ret);
+		return ret;
+	}
+
+	rx.direction = DMA_DEV_TO_MEM;
+	rx.src_addr = fsl_lpspi->base_phys + IMX7ULP_RDR;
+	rx.src_addr_width = buswidth;
+	rx.src_maxburst = 1;
+	ret = dmaengine_slave_config(master->dma_rx, &rx);
+	if (ret) {
+		dev_err(fsl_lpspi->dev, "RX dma configuration failed with %d\n",
+			ret);
+		return ret;
+	}
+
+	fsl_lpspi->dma_bytes_per_word = bytes_per_word;
+
+	return 0;
+}
+
 static int fsl_lpspi_setupxfer(struct spi_device *spi,
 				 struct spi_transfer *t)
 {
 	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(spi->master);
+	struct lpspi_config old = fsl_lpspi->config;
+	bool usedma = fsl_lpspi->usedma;
+	int ret;
 
 	fsl_lpspi->config.mode = spi->mode;
 	fsl_lpspi->config.bpw = t ? t->bits_per_word : spi->bits_per_word;
@@ -308,6 +421,14 @@ static int fsl_lpspi_setupxfer(struct spi_device *spi,
 	if (!fsl_lpspi->config.bpw)
 		fsl_lpspi->config.bpw = spi->bits_per_word;
 
+	fsl_lpspi->usedma = fsl_lpspi_can_dma(spi->master, spi, t);
+	if (fsl_lpspi->usedma) {
+		ret = fsl_lpspi_dma_configure(spi->master,
+			fsl_lpspi_bytes_per_word(fsl_lpspi->config.bpw));
+		if (ret)
+			return ret;
+	}
+
 	/* Initialize the functions for transfer */
 	if (fsl_lpspi->config.bpw <= 8) {
 		fsl_lpspi->rx = fsl_lpspi_buf_rx_u8;
@@ -320,26 +441,147 @@ static int fsl_lpspi_setupxfer(struct spi_device *spi,
 		fsl_lpspi->tx = fsl_lpspi_buf_tx_u32;
 	}
 
-	fsl_lpspi_config(fsl_lpspi);
+	/*
+	 * Resetting the module ends the frame, so only do it when the
+	 * transfer actually needs a different setup.
+	 */
+	if (fsl_lpspi->configured && usedma == fsl_lpspi->usedma &&
+	    old.mode == fsl_lpspi->config.mode &&
+	    old.bpw == fsl_lpspi->config.bpw &&
+	    old.speed_hz == fsl_lpspi->config.speed_hz &&
+	    old.chip_select == fsl_lpspi->config.chip_select)
+		return 0;
+
+	fsl_lpspi->cont_frame = false;
+	ret = fsl_lpspi_config(fsl_lpspi);
+	fsl_lpspi->configured = !ret;
 
-	return 0;
+	return ret;
+}
+
+static void fsl_lpspi_dma_rx_callback(void *cookie)
+{
+	struct fsl_lpspi_data *fsl_lpspi = cookie;
+
+	complete(&fsl_lpspi->dma_rx_completion);
+}
+
+static void fsl_lpspi_dma_tx_callback(void *cookie)
+{
+	struct fsl_lpspi_data *fsl_lpspi = cookie;
+
+	complete(&fsl_lpspi->dma_tx_completion);
+}
+
+static unsigned long
+fsl_lpspi_calculate_timeout(struct fsl_lpspi_data *fsl_lpspi, int size)
+{
+	unsigned long timeout;
+
+	/* Time with actual data transfer and CS change delay related to HW */
+	timeout = (8 + 4) * size / fsl_lpspi->config.speed_hz;
+
+	/* Add extra second for scheduler related activities */
+	timeout += 1;
+
+	/* Double calculated timeout */
+	return msecs_to_jiffies(2 * timeout * MSEC_PER_SEC);
+}
+
+static int fsl_lpspi_dma_transfer(struct spi_master *master,
+				  struct fsl_lpspi_data *fsl_lpspi,
+				  struct spi_transfer *transfer)
+{
+	struct dma_async_tx_descriptor *desc_tx, *desc_rx;
+	struct sg_table *tx = &transfer->tx_sg, *rx = &transfer->rx_sg;
+	unsigned long transfer_timeout;
+	unsigned long timeout;
+	int ret = transfer->len;
+
+	/*
+	 * The whole scatterlist goes out as one command, so PCS stays
+	 * asserted across the sg entries.
+	 */
+	desc_rx = dmaengine_prep_slave_sg(master->dma_rx,
+				rx->sgl, rx->nents, DMA_DEV_TO_MEM,
+				DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc_rx)
+		return -EINVAL;
+
+	desc_rx->callback = fsl_lpspi_dma_rx_callback;
+	desc_rx->callback_param = fsl_lpspi;
+	dmaengine_submit(desc_rx);
+	reinit_completion(&fsl_lpspi->dma_rx_completion);
+	dma_async_issue_pending(master->dma_rx);
+
+	desc_tx = dmaengine_prep_slave_sg(master->dma_tx,
+				tx->sgl, tx->nents, DMA_MEM_TO_DEV,
+				DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc_tx) {
+		dmaengine_terminate_all(master->dma_rx);
+		return -EINVAL;
+	}
+
+	desc_tx->callback = fsl_lpspi_dma_tx_callback;
+	desc_tx->callback_param = fsl_lpspi;
+	dmaengine_submit(desc_tx);
+	reinit_completion(&fsl_lpspi->dma_tx_completion);
+	dma_async_issue_pending(master->dma_tx);
+
+	fsl_lpspi_set_cmd(fsl_lpspi);
+	writel(DER_TDDE | DER_RDDE, fsl_lpspi->base + IMX7ULP_DER);
+
+	transfer_timeout = fsl_lpspi_calculate_timeout(fsl_lpspi,
+						       transfer->len);
+
+	timeout = wait_for_completion_timeout(&fsl_lpspi->dma_tx_completion,
+					      transfer_timeout);
+	if (!timeout) {
+		dev_err(fsl_lpspi->dev, "I/O Error in DMA TX\n");
+		dmaengine_terminate_all(master->dma_tx);
+		dmaengine_terminate_all(master->dma_rx);
+		ret = -ETIMEDOUT;
+		goto out;
+	}
+
+	timeout = wait_for_completion_timeout(&fsl_lpspi->dma_rx_completion,
+					      transfer_timeout);
+	if (!timeout) {
+		dev_err(fsl_lpspi->dev, "I/O Error in DMA RX\n");
+		dmaengine_terminate_all(master->dma_rx);
+		ret = -ETIMEDOUT;
+	}
+
+out:
+	writel(0, fsl_lpspi->base + IMX7ULP_DER);
+	if (ret < 0)
+		fsl_lpspi->configured = false;
+
+	return ret;
 }
 
 static int fsl_lpspi_transfer(struct spi_device *spi,
 				struct spi_transfer *transfer)
 {
 	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(spi->master);
+	int ret = transfer->len;
 
-	fsl_lpspi->tx_buf = transfer->tx_buf;
-	fsl_lpspi->rx_buf = transfer->rx_buf;
-	fsl_lpspi->remain = transfer->len;
+	if (fsl_lpspi->usedma) {
+		ret = fsl_lpspi_dma_transfer(spi->master, fsl_lpspi, transfer);
+	} else {
+		fsl_lpspi->tx_buf = transfer->tx_buf;
+		fsl_lpspi->rx_buf = transfer->rx_buf;
+		fsl_lpspi->remain = transfer->len;
 
-	reinit_completion(&fsl_lpspi->xfer_done);
-	fsl_lpspi_set_cmd(fsl_lpspi);
-	fsl_lpspi_write_tx_fifo(fsl_lpspi);
-	wait_for_completion(&fsl_lpspi->xfer_done);
+		reinit_completion(&fsl_lpspi->xfer_done);
+		fsl_lpspi_set_cmd(fsl_lpspi);
+		fsl_lpspi_write_tx_fifo(fsl_lpspi);
+		wait_for_completion(&fsl_lpspi->xfer_done);
+	}
 
-	return transfer->len;
+	fsl_lpspi->cont_frame = ret >= 0 && !transfer->cs_change;
+
+	return ret;
 }
 
 /* The following funs are decided by spi framework */
@@ -361,6 +603,9 @@ fsl_lpspi_prepare_message(struct spi_master *master, struct spi_message *msg)
 {
 	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
 
+	/* Each message starts a new frame */
+	fsl_lpspi->cont_frame = false;
+
 	return clk_enable(fsl_lpspi->clk);
 }
 
@@ -368,18 +613,71 @@ static int
 fsl_lpspi_unprepare_message(struct spi_master *master, struct spi_message *msg)
 {
 	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
+	u32 temp;
+
+	/* Close the frame so that PCS is released at the end of the message */
+	temp = readl(fsl_lpspi->base + IMX7ULP_TCR);
+	writel(temp & ~(TCR_CONT | TCR_CONTC), fsl_lpspi->base + IMX7ULP_TCR);
+	fsl_lpspi->cont_frame = false;
 
 	clk_disable(fsl_lpspi->clk);
 
 	return 0;
 }
 
+static void fsl_lpspi_dma_exit(struct spi_master *master)
+{
+	if (master->dma_rx) {
+		dma_release_channel(master->dma_rx);
+		master->dma_rx = NULL;
+	}
+
+	if (master->dma_tx) {
+		dma_release_channel(master->dma_tx);
+		master->dma_tx = NULL;
+	}
+}
+
+static int fsl_lpspi_dma_init(struct device *dev,
+			      struct fsl_lpspi_data *fsl_lpspi,
+			      struct spi_master *master)
+{
+	int ret;
+
+	master->dma_tx = dma_request_slave_channel_reason(dev, "tx");
+	if (IS_ERR(master->dma_tx)) {
+		ret = PTR_ERR(master->dma_tx);
+		dev_dbg(dev, "can't get the TX DMA channel, error %d!\n", ret);
+		master->dma_tx = NULL;
+		goto err;
+	}
+
+	master->dma_rx = dma_request_slave_channel_reason(dev, "rx");
+	if (IS_ERR(master->dma_rx)) {
+		ret = PTR_ERR(master->dma_rx);
+		dev_dbg(dev, "can't get the RX DMA channel, error %d\n", ret);
+		master->dma_rx = NULL;
+		goto err;
+	}
+
+	init_completion(&fsl_lpspi->dma_rx_completion);
+	init_completion(&fsl_lpspi->dma_tx_completion);
+	master->can_dma = fsl_lpspi_can_dma;
+	master->max_dma_len = FSL_LPSPI_MAX_EDMA_BYTES;
+
+	return 0;
+err:
+	fsl_lpspi_dma_exit(master);
+	return ret;
+}
+
 static int fsl_lpspi_probe(struct platform_device *pdev)
 {
 	struct spi_master *master;
 	struct fsl_lpspi_data *fsl_lpspi;
 	struct resource *res;
 	int ret, irq;
+	u32 temp;
 
 	master = spi_alloc_master(&pdev->dev, sizeof(struct fsl_lpspi_data));
 	if (!master)
@@ -412,6 +710,7 @@ static int fsl_lpspi_probe(struct platform_device *pdev)
 		ret = PTR_ERR(fsl_lpspi->base);
 		goto out_master_put;
 	}
+	fsl_lpspi->base_phys = res->start;
 
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0) {
@@ -425,26 +724,43 @@ static int fsl_lpspi_probe(struct platform_device *pdev)
 		goto out_master_put;
 	}
 
+	/* The FIFO sizes are needed by can_dma before the first transfer */
+	ret = clk_prepare_enable(fsl_lpspi->clk);
+	if (ret)
+		goto out_master_put;
+	temp = readl(fsl_lpspi->base + IMX7ULP_PARAM);
+	fsl_lpspi->txfifosize = 1 << (temp & 0x0f);
+	fsl_lpspi->rxfifosize = 1 << ((temp >> 8) & 0x0f);
+	clk_disable_unprepare(fsl_lpspi->clk);
+
+	ret = fsl_lpspi_dma_init(&pdev->dev, fsl_lpspi, master);
+	if (ret == -EPROBE_DEFER)
+		goto out_master_put;
+	if (ret < 0)
+		dev_info(&pdev->dev, "dma setup error %d, use pio\n", ret);
+
 	master->dev.of_node = pdev->dev.of_node;
 	ret = spi_bitbang_start(&fsl_lpspi->bitbang);
 	if (ret) {
 		dev_err(&pdev->dev, "bitbang start failed with %d\n", ret);
-		goto out_master_put;
+		goto out_dma_exit;
 	}
 
 	ret = devm_request_irq(&pdev->dev, irq, fsl_lpspi_isr, 0,
 			       dev_name(&pdev->dev), fsl_lpspi);
 	if (ret) {
 		dev_err(&pdev->dev, "can't get irq%d: %d\n", irq, ret);
-		goto out_master_put;
+		goto out_dma_exit;
 	}
 
 	ret = clk_prepare(fsl_lpspi->clk);
 	if (ret)
-		goto out_master_put;
+		goto out_dma_exit;
 
 	return ret;
 
+out_dma_exit:
+	fsl_lpspi_dma_exit(master);
 out_master_put:
 	spi_master_put(master);
 
@@ -457,6 +773,7 @@ static int fsl_lpspi_remove(struct platform_device *pdev)
 	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
 
 	spi_bitbang_stop(&fsl_lpspi->bitbang);
+	fsl_lpspi_dma_exit(master);
 
 	clk_unprepare(fsl_lpspi->clk);
 	spi_master_put(master);
@@ -473,6 +790,11 @@ static int fsl_lpspi_suspend(struct device *dev)
 
 static int fsl_lpspi_resume(struct device *dev)
 {
+	struct spi_master *master = dev_get_drvdata(dev);
+	struct fsl_lpspi_data *fsl_lpspi = spi_master_get_devdata(master);
+
+	/* The register state may be lost, reprogram on the next transfer */
+	fsl_lpspi->configured = false;
 	pinctrl_pm_select_default_state(dev);
 	return 0;
 }
@@ -42,6 +42,8 @@
 #include <linux/platform_data/dma-imx.h>
 #include <linux/platform_data/spi-imx.h>
 
+#include <asm/unaligned.h>
+
 #define DRIVER_NAME "spi_imx"
 
 #define MXC_CSPIRXDATA		0x00
@@ -103,10 +105,15 @@ struct spi_imx_data {
 	void *rx_buf;
 	const void *tx_buf;
 	unsigned int txfifo; /* number of words pushed in tx FIFO */
+	bool dynamic_burst;
+	unsigned int remainder; /* bytes left to receive in current burst */
+
+	bool slave_mode;
 
 	/* DMA */
 	bool usedma;
 	u32 wml;
+	u32 dma_wml; /* watermark the DMA channels are configured for */
 	struct completion dma_rx_completion;
 	struct completion dma_tx_completion;
 
@@ -212,7 +219,7 @@ static bool spi_imx_can_dma(struct spi_master *master, struct spi_device *spi,
 			 struct spi_transfer *transfer)
 {
 	struct spi_imx_data *spi_imx = spi_master_get_devdata(master);
-	unsigned int bpw;
+	unsigned int bpw, i;
 
 	if (!master->dma_rx)
 		return false;
@@ -229,12 +236,23 @@ static bool spi_imx_can_dma(struct spi_master *master, struct spi_device *spi,
 	if (bpw != 1 && bpw != 2 && bpw != 4)
 		return false;
 
-	if (transfer->len < spi_imx->wml * bpw)
+	if (transfer->len < spi_imx_get_fifosize(spi_imx))
 		return false;
 
-	if (transfer->len % (spi_imx->wml * bpw))
+	if (transfer->len % bpw)
 		return false;
 
+	/*
+	 * Pick the largest watermark that divides the transfer, so that any
+	 * length ends on a whole DMA burst instead of falling back to PIO.
+	 */
+	for (i = spi_imx_get_fifosize(spi_imx) / 2; i > 1; i--) {
+		if (!(transfer->len % (i * bpw)))
+			break;
+	}
+
+	spi_imx->wml = i;
+
 	return true;
 }
 
@@ -247,6 +265,8 @@ static bool spi_imx_can_dma(struct spi_master *master, struct spi_device *spi,
 #define MX51_ECSPI_CTRL_PREDIV_OFFSET	12
 #define MX51_ECSPI_CTRL_CS(cs)		((cs) << 18)
 #define MX51_ECSPI_CTRL_BL_OFFSET	20
+#define MX51_ECSPI_CTRL_BL_MASK		(0xfff << 20)
+#define MX51_ECSPI_CTRL_MAX_BURST	512	/* bytes, 4096 bits */
 
 #define MX51_ECSPI_CONFIG	0x0c
 #define MX51_ECSPI_CONFIG_SCLKPHA(cs)	(1 << ((cs) +  0))
@@ -356,9 +376,11 @@ static int mx51_ecspi_config(struct spi_device *spi,
 	 * current assumption is that the selection of the channel arrives
 	 * earlier in the hardware than the mode bits when they are written at
 	 * the same time.
-	 * So set master mode for all channels as we do not support slave mode.
+	 * So set the same mode for all channels: master, or slave when the
+	 * controller is clocked by a remote master.
 	 */
-	ctrl |= MX51_ECSPI_CTRL_MODE_MASK;
+	if (!spi_imx->slave_mode)
+		ctrl |= MX51_ECSPI_CTRL_MODE_MASK;
 
 	/* set clock speed */
 	ctrl |= mx51_ecspi_clkdiv(spi_imx, config->speed_hz, &clk);
@@ -427,7 +449,8 @@ static int mx51_ecspi_config(struct spi_device *spi,
 	if (spi_imx->devtype_data->devtype == IMX6UL_ECSPI)
 		tx_wml = spi_imx->wml / 2;
 
-	writel(MX51_ECSPI_DMA_RX_WML(spi_imx->wml) |
+	/* RX DMA is requested once the FIFO holds more than RX_WML words */
+	writel(MX51_ECSPI_DMA_RX_WML(spi_imx->wml - 1) |
 		MX51_ECSPI_DMA_TX_WML(tx_wml) |
 		MX51_ECSPI_DMA_RXT_WML(spi_imx->wml) |
 		MX51_ECSPI_DMA_TEDEN | MX51_ECSPI_DMA_RXDEN |
@@ -794,11 +817,97 @@ static void spi_imx_chipselect(struct spi_device *spi, int is_active)
 	gpio_set_value(spi->cs_gpio, dev_is_lowactive ^ active);
 }
 
+/*
+ * Dynamic burst: for 8-bit words on the eCSPI the burst length is raised
+ * to up to 4096 bits, and the FIFO carries four bytes per 32-bit entry.
+ * The controller shifts each entry MSB first and puts the odd bytes of a
+ * burst in the first entry, so the unaligned head goes out first and the
+ * rest is packed big-endian.
+ */
+static void spi_imx_buf_rx_swap(struct spi_imx_data *spi_imx)
+{
+	unsigned int val = readl(spi_imx->base + MXC_CSPIRXDATA);
+	unsigned int unaligned = spi_imx->remainder % sizeof(u32);
+
+	if (!unaligned) {
+		if (spi_imx->rx_buf) {
+			put_unaligned_be32(val, spi_imx->rx_buf);
+			spi_imx->rx_buf += sizeof(u32);
+		}
+		spi_imx->remainder -= sizeof(u32);
+		return;
+	}
+
+	while (unaligned--) {
+		if (spi_imx->rx_buf) {
+			*(u8 *)spi_imx->rx_buf = val >> (8 * unaligned);
+			spi_imx->rx_buf++;
+		}
+		spi_imx->remainder--;
+	}
+}
+
+static void spi_imx_buf_tx_swap(struct spi_imx_data *spi_imx)
+{
+	unsigned int unaligned = spi_imx->count % sizeof(u32);
+	u32 val = 0;
+
+	if (!unaligned) {
+		if (spi_imx->tx_buf) {
+			val = get_unaligned_be32(spi_imx->tx_buf);
+			spi_imx->tx_buf += sizeof(u32);
+		}
+		spi_imx->count -= sizeof(u32);
+		writel(val, spi_imx->base + MXC_CSPITXDATA);
+		return;
+	}
+
+	spi_imx->count -= unaligned;
+	while (unaligned--) {
+		val <<= 8;
+		if (spi_imx->tx_buf) {
+			val |= *(u8 *)spi_imx->tx_buf;
+			spi_imx->tx_buf++;
+		}
+	}
+
+	writel(val, spi_imx->base + MXC_CSPITXDATA);
+}
+
+static void spi_imx_set_burst_len(struct spi_imx_data *spi_imx, int len)
+{
+	u32 ctrl = readl(spi_imx->base + MX51_ECSPI_CTRL);
+
+	ctrl &= ~MX51_ECSPI_CTRL_BL_MASK;
+	ctrl |= (len * BITS_PER_BYTE - 1) << MX51_ECSPI_CTRL_BL_OFFSET;
+	writel(ctrl, spi_imx->base + MX51_ECSPI_CTRL);
+}
+
 static void spi_imx_push(struct spi_imx_data *spi_imx)
 {
+	unsigned int burst_len;
+
+	/*
+	 * A new burst length may only be set once the previous burst has
+	 * been received completely. The odd-sized burst goes first so that
+	 * every following one is a full 512 bytes.
+	 */
+	if (spi_imx->dynamic_burst && !spi_imx->remainder) {
+		burst_len = spi_imx->count % MX51_ECSPI_CTRL_MAX_BURST;
+		if (!burst_len)
+			burst_len = MX51_ECSPI_CTRL_MAX_BURST;
+
+		spi_imx_set_burst_len(spi_imx, burst_len);
+		spi_imx->remainder = burst_len;
+	}
+
 	while (spi_imx->txfifo < spi_imx_get_fifosize(spi_imx)) {
 		if (!spi_imx->count)
 			break;
+		if (spi_imx->dynamic_burst &&
+		    spi_imx->txfifo >= DIV_ROUND_UP(spi_imx->remainder,
+						     sizeof(u32)))
+			break;
 		spi_imx->tx(spi_imx);
 		spi_imx->txfifo++;
 	}
@@ -843,7 +952,8 @@ static int spi_imx_dma_configure(struct spi_master *master,
 	struct dma_slave_config rx = {}, tx = {};
 	struct spi_imx_data *spi_imx = spi_master_get_devdata(master);
 
-	if (bytes_per_word == spi_imx->bytes_per_word)
+	if (bytes_per_word == spi_imx->bytes_per_word &&
+	    spi_imx->wml == spi_imx->dma_wml)
 		/* Same as last time */
 		return 0;
 
@@ -864,7 +974,7 @@ static int spi_imx_dma_configure(struct spi_master *master,
 	tx.direction = DMA_MEM_TO_DEV;
 	tx.dst_addr = spi_imx->base_phys + MXC_CSPITXDATA;
 	tx.dst_addr_width = buswidth;
-	tx.dst_maxburst = spi_imx->wml / 2;
+	tx.dst_maxburst = max_t(u32, spi_imx->wml / 2, 1);
 	ret = dmaengine_slave_config(master->dma_tx, &tx);
 	if (ret) {
 		dev_err(spi_imx->dev, "TX dma configuration failed with %d\n", ret);
@@ -882,6 +992,7 @@ static int spi_imx_dma_configure(struct spi_master *master,
 	}
 
 	spi_imx->bytes_per_word = bytes_per_word;
+	spi_imx->dma_wml = spi_imx->wml;
 
 	return 0;
 }
@@ -918,6 +1029,14 @@ static int spi_imx_setupxfer(struct spi_device *spi,
 	else
 		spi_imx->usedma = 0;
 
+	/* In slave mode the remote master defines the bursts */
+	spi_imx->dynamic_burst = !spi_imx->usedma && is_imx51_ecspi(spi_imx) &&
+				 !spi_imx->slave_mode && config.bpw == 8;
+	if (spi_imx->dynamic_burst) {
+		spi_imx->rx = spi_imx_buf_rx_swap;
+		spi_imx->tx = spi_imx_buf_tx_swap;
+	}
+
 	if (spi_imx->usedma) {
 		ret = spi_imx_dma_configure(spi->master,
 					    spi_imx_bytes_per_word(config.bpw));
@@ -1003,6 +1122,10 @@ static int spi_imx_calculate_timeout(struct spi_imx_data *spi_imx, int size)
 {
 	unsigned long timeout = 0;
 
+	/* A slave has no bus clock of its own to derive a timeout from */
+	if (spi_imx->slave_mode)
+		return MAX_SCHEDULE_TIMEOUT;
+
 	/* Time with actual data transfer and CS change delay related to HW */
 	timeout = (8 + 4) * size / spi_imx->spi_bus_clk;
 
@@ -1013,12 +1136,26 @@ static int spi_imx_calculate_timeout(struct spi_imx_data *spi_imx, int size)
 	return msecs_to_jiffies(2 * timeout * MSEC_PER_SEC);
 }
 
+/*
+ * As a slave the transfer only progresses when the remote master clocks
+ * it, so there is no meaningful timeout; wait until it completes or the
+ * caller is interrupted.
+ */
+static long spi_imx_wait(struct spi_imx_data *spi_imx,
+			 struct completion *done, unsigned long timeout)
+{
+	if (spi_imx->slave_mode)
+		return wait_for_completion_interruptible(done) ? -EINTR : 1;
+
+	return wait_for_completion_timeout(done, timeout) ? 1 : -ETIMEDOUT;
+}
+
 static int spi_imx_dma_transfer(struct spi_imx_data *spi_imx,
 				struct spi_transfer *transfer)
 {
 	struct dma_async_tx_descriptor *desc_tx, *desc_rx;
 	unsigned long transfer_timeout;
-	unsigned long timeout;
+	long ret;
 	struct spi_master *master = spi_imx->bitbang.master;
 	struct sg_table *tx = &transfer->tx_sg, *rx = &transfer->rx_sg;
 
@@ -1057,22 +1194,24 @@ static int spi_imx_dma_transfer(struct spi_imx_data *spi_imx,
 	spi_imx->devtype_data->trigger(spi_imx);
 
 	/* Wait SDMA to finish the data transfer.*/
-	timeout = wait_for_completion_timeout(&spi_imx->dma_tx_completion,
-						transfer_timeout);
-	if (!timeout) {
+	ret = spi_imx_wait(spi_imx, &spi_imx->dma_tx_completion,
+			   transfer_timeout);
+	if (ret < 0) {
 		dev_err(spi_imx->dev, "I/O Error in DMA TX\n");
 		dmaengine_terminate_all(master->dma_tx);
 		dmaengine_terminate_all(master->dma_rx);
-		return -ETIMEDOUT;
+		if (spi_imx->slave_mode)
+			spi_imx->devtype_data->reset(spi_imx);
+		return ret;
 	}
 
-	timeout = wait_for_completion_timeout(&spi_imx->dma_rx_completion,
-					      transfer_timeout);
-	if (!timeout) {
+	ret = spi_imx_wait(spi_imx, &spi_imx->dma_rx_completion,
+			   transfer_timeout);
+	if (ret < 0) {
 		dev_err(&master->dev, "I/O Error in DMA RX\n");
 		spi_imx->devtype_data->reset(spi_imx);
 		dmaengine_terminate_all(master->dma_rx);
-		return -ETIMEDOUT;
+		return ret;
 	}
 
 	return transfer->len;
@@ -1083,12 +1222,13 @@ static int spi_imx_pio_transfer(struct spi_device *spi,
 {
 	struct spi_imx_data *spi_imx = spi_master_get_devdata(spi->master);
 	unsigned long transfer_timeout;
-	unsigned long timeout;
+	long ret;
 
 	spi_imx->tx_buf = transfer->tx_buf;
 	spi_imx->rx_buf = transfer->rx_buf;
 	spi_imx->count = transfer->len;
 	spi_imx->txfifo = 0;
+	spi_imx->remainder = 0;
 
 	reinit_completion(&spi_imx->xfer_done);
 
@@ -1098,12 +1238,12 @@ static int spi_imx_pio_transfer(struct spi_device *spi,
 
 	transfer_timeout = spi_imx_calculate_timeout(spi_imx, transfer->len);
 
-	timeout = wait_for_completion_timeout(&spi_imx->xfer_done,
-					      transfer_timeout);
-	if (!timeout) {
+	ret = spi_imx_wait(spi_imx, &spi_imx->xfer_done, transfer_timeout);
+	if (ret < 0) {
 		dev_err(&spi->dev, "I/O Error in PIO\n");
+		spi_imx->devtype_data->intctrl(spi_imx, 0);
 		spi_imx->devtype_data->reset(spi_imx);
-		return -ETIMEDOUT;
+		return ret;
 	}
 
 	return transfer->len;
@@ -1200,6 +1340,13 @@ static int spi_imx_probe(struct platform_device *pdev)
 	spi_imx->devtype_data = of_id ? of_id->data :
 		(struct spi_imx_devtype_data *)pdev->id_entry->driver_data;
 
+	/*
+	 * "spi-slave": the eCSPI is clocked and selected by a remote master
+	 * on SS0; transfers queued by the client wait for it to clock them.
+	 */
+	spi_imx->slave_mode = is_imx51_ecspi(spi_imx) &&
+			      of_property_read_bool(np, "spi-slave");
+
 	if (mxc_platform_info) {
 		master->num_chipselect = mxc_platform_info->num_chipselect;
 		master->cs_gpios = devm_kzalloc(&master->dev,
@@ -1291,13 +1438,13 @@ static int spi_imx_probe(struct platform_device *pdev)
 		goto out_clk_put;
 	}
 
-	if (!master->cs_gpios) {
+	if (!master->cs_gpios && !spi_imx->slave_mode) {
 		dev_err(&pdev->dev, "No CS GPIOs available\n");
 		ret = -EINVAL;
 		goto out_clk_put;
 	}
 
-	for (i = 0; i < master->num_chipselect; i++) {
+	for (i = 0; master->cs_gpios && i < master->num_chipselect; i++) {
 		if (!gpio_is_valid(master->cs_gpios[i]))
 			continue;
 
@@ -874,6 +874,15 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 		return;
 
 	mutex_lock(&buffer->lock);
+	/*
+	 * Nothing was touched by the CPU since the last sync, the cache is
+	 * clean for the device and the user mappings hold no pages.
+	 */
+	if (!buffer->dirty) {
+		mutex_unlock(&buffer->lock);
+		return;
+	}
+
 	for (i = 0; i < pages; i++) {
 		struct page *page = buffer->pages[i];
 
@@ -889,6 +898,7 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 		zap_page_range(vma, vma->vm_start, vma->vm_end - vma->vm_start,
 			       NULL);
 	}
+	buffer->dirty = false;
 	mutex_unlock(&buffer->lock);
 }
 
@@ -900,6 +910,7 @@ static int ion_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 
 	mutex_lock(&buffer->lock);
 	ion_buffer_page_dirty(buffer->pages + vmf->pgoff);
+	buffer->dirty = true;
 	BUG_ON(!buffer->pages || !buffer->pages[vmf->pgoff]);
 
 	pfn = page_to_pfn(ion_buffer_page(buffer->pages[vmf->pgoff]));
@@ -1004,8 +1015,54 @@ static void ion_dma_buf_kunmap(struct dma_buf *dmabuf, unsigned long offset,
 {
 }
 
-static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
-					enum dma_data_direction direction)
+/*
+ * Cache maintenance for cached buffers, limited to [offset, offset + len).
+ * ION pages are not dma mapped for a device, use the physical address the
+ * same way ion_pages_sync_for_device() does.
+ */
+static void ion_buffer_sync_range(struct ion_buffer *buffer,
+				  unsigned int offset, unsigned int len,
+				  enum dma_data_direction direction,
+				  bool for_cpu)
+{
+	struct sg_table *table = buffer->sg_table;
+	unsigned int start = 0, end = offset + len;
+	struct scatterlist *sg, tmp;
+	int i;
+
+	if (!ion_buffer_cached(buffer) || direction == DMA_NONE)
+		return;
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		unsigned int from = max(start, offset);
+		unsigned int to = min(start + sg->length, end);
+		unsigned int pos = sg->offset + from - start;
+		struct page *page;
+
+		start += sg->length;
+		if (from >= to)
+			continue;
+
+		page = nth_page(sg_page(sg), pos >> PAGE_SHIFT);
+		sg_init_table(&tmp, 1);
+		sg_set_page(&tmp, page, to - from, pos & ~PAGE_MASK);
+		sg_dma_address(&tmp) = page_to_phys(page) +
+				       (pos & ~PAGE_MASK);
+
+		if (for_cpu)
+			dma_sync_sg_for_cpu(NULL, &tmp, 1, direction);
+		else
+			dma_sync_sg_for_device(NULL, &tmp, 1, direction);
+
+		if (start >= end)
+			break;
+	}
+}
+
+static int ion_dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+						enum dma_data_direction dir,
+						unsigned int offset,
+						unsigned int len)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
 	void *vaddr;
@@ -1018,22 +1075,41 @@ static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
 
 	mutex_lock(&buffer->lock);
 	vaddr = ion_buffer_kmap_get(buffer);
+	if (!IS_ERR(vaddr))
+		ion_buffer_sync_range(buffer, offset, len, dir, true);
 	mutex_unlock(&buffer->lock);
 	return PTR_ERR_OR_ZERO(vaddr);
 }
 
-static int ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
-				      enum dma_data_direction direction)
+static int ion_dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+					      enum dma_data_direction direction,
+					      unsigned int offset,
+					      unsigned int len)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
 
 	mutex_lock(&buffer->lock);
+	ion_buffer_sync_range(buffer, offset, len, direction, false);
 	ion_buffer_kmap_put(buffer);
 	mutex_unlock(&buffer->lock);
 
 	return 0;
 }
 
+static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
+					enum dma_data_direction direction)
+{
+	return ion_dma_buf_begin_cpu_access_partial(dmabuf, direction, 0,
+						    dmabuf->size);
+}
+
+static int ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
+				      enum dma_data_direction direction)
+{
+	return ion_dma_buf_end_cpu_access_partial(dmabuf, direction, 0,
+						  dmabuf->size);
+}
+
 static void *ion_dma_buf_vmap(struct dma_buf *dmabuf)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
@@ -1056,6 +1132,8 @@ static struct dma_buf_ops dma_buf_ops = {
 	.release = ion_dma_buf_release,
 	.begin_cpu_access = ion_dma_buf_begin_cpu_access,
 	.end_cpu_access = ion_dma_buf_end_cpu_access,
+	.begin_cpu_access_partial = ion_dma_buf_begin_cpu_access_partial,
+	.end_cpu_access_partial = ion_dma_buf_end_cpu_access_partial,
 	.kmap_atomic = ion_dma_buf_kmap,
 	.kunmap_atomic = ion_dma_buf_kunmap,
 	.kmap = ion_dma_buf_kmap,
@@ -29,7 +29,7 @@
 #include "../ion_priv.h"
 
 static struct ion_device *idev;
-static int num_heaps = 1;
+static int num_heaps = 2;
 static struct ion_heap **heaps;
 static int cacheable;
 
@@ -46,7 +46,7 @@ mxc_ion_parse_of(struct platform_device *pdev)
 	if (!pdata)
 		return ERR_PTR(-ENOMEM);
 
-	heap = kzalloc(sizeof(struct ion_platform_heap), GFP_KERNEL);
+	heap = kcalloc(num_heaps, sizeof(struct ion_platform_heap), GFP_KERNEL);
 	if (!heap) {
 		kfree(pdata);
 		return ERR_PTR(-ENOMEM);
@@ -70,6 +70,21 @@ mxc_ion_parse_of(struct platform_device *pdev)
 	else
 		heap->id = 0;
 
+	/*
+	 * Page pool backed heap for buffers that do not need to be
+	 * contiguous, e.g. for the GPU MMU. The pools hand out 1M and 64K
+	 * chunks first, so the sg tables stay short, and recycle freed
+	 * pages without going through CMA migration.
+	 */
+	heap[1].type = ION_HEAP_TYPE_SYSTEM;
+	heap[1].name = "mxc_system";
+
+	ret = of_property_read_u32(node, "fsl,system-heap-id", &val);
+	if (!ret)
+		heap[1].id = val;
+	else
+		heap[1].id = heap->id + 1;
+
 	return pdata;
 }
 
@@ -7,6 +7,7 @@
  *
  */
 
+#include <linux/device_cooling.h>
 #include <linux/module.h>
 #include <linux/thermal.h>
 #include <linux/err.h>
@@ -16,12 +17,13 @@ struct devfreq_cooling_device {
 	int id;
 	struct thermal_cooling_device *cool_dev;
 	unsigned int devfreq_state;
+	u32 max_power;
 };
 
 static DEFINE_IDR(devfreq_idr);
 static DEFINE_MUTEX(devfreq_cooling_lock);
 
-#define	MAX_STATE	1
+#define	MAX_STATE	DEVICE_COOLING_MAX_STATE
 
 static BLOCKING_NOTIFIER_HEAD(devfreq_cooling_chain_head);
 
@@ -84,6 +86,61 @@ static struct thermal_cooling_device_ops const devfreq_cooling_ops = {
 	.set_cur_state = devfreq_set_cur_state,
 };
 
+/*
+ * Simple power model for the power allocator governor: the consumers scale
+ * their clock linearly with the state, so does their power, from max_power
+ * at state 0 down to nearly nothing at MAX_STATE. The device load is
+ * unknown, assume it is busy at its current state.
+ */
+static int devfreq_state2power(struct thermal_cooling_device *cdev,
+			       struct thermal_zone_device *tz,
+			       unsigned long state, u32 *power)
+{
+	struct devfreq_cooling_device *devfreq_device = cdev->devdata;
+
+	if (state > MAX_STATE)
+		return -EINVAL;
+
+	*power = devfreq_device->max_power * (MAX_STATE - state) / MAX_STATE;
+
+	return 0;
+}
+
+static int devfreq_get_requested_power(struct thermal_cooling_device *cdev,
+				       struct thermal_zone_device *tz,
+				       u32 *power)
+{
+	struct devfreq_cooling_device *devfreq_device = cdev->devdata;
+
+	return devfreq_state2power(cdev, tz, devfreq_device->devfreq_state,
+				   power);
+}
+
+static int devfreq_power2state(struct thermal_cooling_device *cdev,
+			       struct thermal_zone_device *tz, u32 power,
+			       unsigned long *state)
+{
+	struct devfreq_cooling_device *devfreq_device = cdev->devdata;
+	u32 max_power = devfreq_device->max_power;
+
+	/* the shallowest state which does not exceed the granted power */
+	if (power >= max_power)
+		*state = 0;
+	else
+		*state = MAX_STATE - power * MAX_STATE / max_power;
+
+	return 0;
+}
+
+static struct thermal_cooling_device_ops const devfreq_cooling_power_ops = {
+	.get_max_state = devfreq_get_max_state,
+	.get_cur_state = devfreq_get_cur_state,
+	.set_cur_state = devfreq_set_cur_state,
+	.get_requested_power = devfreq_get_requested_power,
+	.state2power = devfreq_state2power,
+	.power2state = devfreq_power2state,
+};
+
 static int get_idr(struct idr *idr, int *id)
 {
 	int ret;
@@ -105,7 +162,15 @@ static void release_idr(struct idr *idr, int id)
 	mutex_unlock(&devfreq_cooling_lock);
 }
 
-struct thermal_cooling_device *devfreq_cooling_register(void)
+/**
+ * devfreq_cooling_register_power() - register a device cooling device
+ * @max_power: power in mW the device takes unthrottled, 0 if unknown
+ *
+ * With a non zero @max_power the cooling device implements the power
+ * actor API, so that the power allocator governor can share the power
+ * budget of the zone between it and the other cooling devices.
+ */
+struct thermal_cooling_device *devfreq_cooling_register_power(u32 max_power)
 {
 	struct thermal_cooling_device *cool_dev;
 	struct devfreq_cooling_device *devfreq_dev = NULL;
@@ -126,7 +191,11 @@ struct thermal_cooling_device *devfreq_cooling_register(void)
 	snprintf(dev_name, sizeof(dev_name), "thermal-devfreq-%d",
 		 devfreq_dev->id);
 
+	devfreq_dev->max_power = max_power;
+
 	cool_dev = thermal_cooling_device_register(dev_name, devfreq_dev,
+						   max_power ?
+						   &devfreq_cooling_power_ops :
 						   &devfreq_cooling_ops);
 	if (!cool_dev) {
 		release_idr(&devfreq_idr, devfreq_dev->id);
@@ -138,6 +207,12 @@ struct thermal_cooling_device *devfreq_cooling_register(void)
 
 	return cool_dev;
 }
+EXPORT_SYMBOL_GPL(devfreq_cooling_register_power);
+
+struct thermal_cooling_device *devfreq_cooling_register(void)
+{
+	return devfreq_cooling_register_power(0);
+}
 EXPORT_SYMBOL_GPL(devfreq_cooling_register);
 
 void devfreq_cooling_unregister(struct thermal_cooling_device *cdev)
@@ -95,6 +95,10 @@ enum imx_thermal_trip {
 
 #define IMX_TEMP_PASSIVE_COOL_DELTA	10000
 
+/*
+ * While the temperature is well below the passive trip the zone is not
+ * polled, the high alarm interrupt reports the trip being crossed.
+ */
 #define IMX_POLLING_DELAY		2000 /* millisecond */
 #define IMX_PASSIVE_DELAY		1000
 
@@ -381,7 +385,21 @@ static int imx_get_temp_internal(struct imx_thermal_data *data, int *temp)
 static int imx_get_temp(struct thermal_zone_device *tz, int *temp)
 {
 	struct imx_thermal_data *data = tz->devdata;
-	return imx_get_temp_internal(data, temp);
+	int ret;
+
+	ret = imx_get_temp_internal(data, temp);
+	if (ret)
+		return ret;
+
+	/*
+	 * Stop polling once the cooling devices are released again and the
+	 * alarm is armed, until then keep sampling for the governor.
+	 */
+	if (data->mode == THERMAL_DEVICE_ENABLED && data->irq_enabled)
+		tz->polling_delay = *temp < data->temp_passive -
+			IMX_TEMP_PASSIVE_COOL_DELTA ? 0 : IMX_POLLING_DELAY;
+
+	return 0;
 }
 
 static int imx_get_mode(struct thermal_zone_device *tz,
@@ -687,11 +705,34 @@ static irqreturn_t imx_thermal_alarm_irq_thread(int irq, void *dev)
 	dev_dbg(&data->tz->device, "THERMAL ALARM: T > %d\n",
 		data->alarm_temp / 1000);
 
+	data->tz->polling_delay = IMX_POLLING_DELAY;
 	thermal_zone_device_update(data->tz, THERMAL_EVENT_UNSPECIFIED);
 
 	return IRQ_HANDLED;
 }
 
+/*
+ * Give the power allocator governor a power model of the CPUs if the DT
+ * provides their dynamic power coefficient.
+ */
+static struct thermal_cooling_device *imx_cpufreq_cooling_register(void)
+{
+	struct device_node *np = of_get_cpu_node(0, NULL);
+	u32 capacitance = 0;
+
+	if (np) {
+		of_property_read_u32(np, "dynamic-power-coefficient",
+				     &capacitance);
+		of_node_put(np);
+	}
+
+	if (capacitance)
+		return cpufreq_power_cooling_register(cpu_present_mask,
+						      capacitance, NULL);
+
+	return cpufreq_cooling_register(cpu_present_mask);
+}
+
 static const struct of_device_id of_imx_thermal_match[] = {
 	{ .compatible = "fsl,imx6q-tempmon", .data = &thermal_imx6q_data, },
 	{ .compatible = "fsl,imx6sx-tempmon", .data = &thermal_imx6sx_data, },
@@ -750,6 +791,7 @@ static int imx_thermal_probe(struct platform_device *pdev)
 {
 	struct imx_thermal_data *data;
 	struct regmap *map;
+	u32 gpu_power = 0;
 	int measure_freq;
 	int ret, revision;
 	int temp;
@@ -813,7 +855,7 @@ static int imx_thermal_probe(struct platform_device *pdev)
 	regmap_write(map, data->socdata->sensor_ctrl + REG_SET,
 		     data->socdata->power_down_mask);
 
-	data->cdev[0] = cpufreq_cooling_register(cpu_present_mask);
+	data->cdev[0] = imx_cpufreq_cooling_register();
 	if (IS_ERR(data->cdev[0])) {
 		ret = PTR_ERR(data->cdev[0]);
 		if (ret != -EPROBE_DEFER)
@@ -823,7 +865,9 @@ static int imx_thermal_probe(struct platform_device *pdev)
 		return ret;
 	}
 
-	data->cdev[1] = devfreq_cooling_register();
+	/* the GPU is throttled gradually along with the CPUs */
+	of_property_read_u32(pdev->dev.of_node, "fsl,gpu-power-mw", &gpu_power);
+	data->cdev[1] = devfreq_cooling_register_power(gpu_power);
 	if (IS_ERR(data->cdev[1])) {
 		ret = PTR_ERR(data->cdev[1]);
 		if (ret != -EPROBE_DEFER) {
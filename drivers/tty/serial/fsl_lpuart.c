@@ -14,18 +14,22 @@
 #define SUPPORT_SYSRQ
 #endif
 
+#include <linux/circ_buf.h>
 #include <linux/clk.h>
 #include <linux/console.h>
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 #include <linux/dmapool.h>
 #include <linux/io.h>
 #include <linux/irq.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/of_dma.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 #include <linux/serial_core.h>
 #include <linux/slab.h>
 #include <linux/tty_flip.h>
@@ -236,12 +240,29 @@
 
 #define UARTFIFO_RXIDEN_RDRF	0x3
 #define UARTCTRL_IDLECFG	0x7
-#define FSL_UART_RX_DMA_BUFFER_SIZE	64
+/* 4 idle characters end a DMA burst, the FIFO mode waits for 128 */
+#define UARTCTRL_IDLECFG_DMA	0x2
+#define FSL_UART_RX_DMA_RING_SIZE	4096
+#define FSL_UART_RX_DMA_RING_MIN	64
+/* a period is half the ring and must fit one eDMA major loop */
+#define FSL_UART_RX_DMA_RING_MAX	32768
+#define DMA_RX_TIMEOUT			10	/* ms */
 
 #define DRIVER_NAME	"fsl-lpuart"
 #define DEV_NAME	"ttyLP"
 #define UART_NR		6
 
+/* how often, and with how much data, each source flushed the RX ring */
+struct lpuart_rx_stats {
+	unsigned long		period;
+	unsigned long		period_bytes;
+	unsigned long		idle;
+	unsigned long		idle_bytes;
+	unsigned long		timer;
+	unsigned long		timer_bytes;
+	unsigned int		max_pending;
+};
+
 struct lpuart_port {
 	struct uart_port	port;
 	struct clk		*ipg_clk;
@@ -254,25 +275,23 @@ struct lpuart_port {
 
 	bool			lpuart_dma_tx_use;
 	bool			lpuart_dma_rx_use;
-	bool			dma_rx_chan_active;
 	struct dma_chan		*dma_tx_chan;
 	struct dma_chan		*dma_rx_chan;
 	struct dma_async_tx_descriptor  *dma_tx_desc;
-	struct dma_async_tx_descriptor  *dma_rx_desc;
 	dma_addr_t		dma_rx_buf_bus;
 	dma_cookie_t		dma_tx_cookie;
 	dma_cookie_t		dma_rx_cookie;
-	unsigned char		*dma_rx_buf_virt;
 	unsigned int		dma_tx_bytes;
-	unsigned int		dma_rx_bytes;
 	size_t			rxdma_len;
+	struct circ_buf		rx_ring;
+	struct lpuart_rx_stats	rx_stats;
 	bool			dma_tx_in_progress;
-	bool			dma_rx_in_progress;
 	unsigned int		dma_rx_timeout;
 	struct timer_list	lpuart_timer;
-	struct scatterlist	rx_sgl, tx_sgl[2];
+	struct scatterlist	tx_sgl[2];
 	unsigned int		dma_tx_nents;
 	wait_queue_head_t	dma_wait;
+	struct dentry		*debugfs;
 };
 
 static const struct of_device_id lpuart_dt_ids[] = {
@@ -290,9 +309,9 @@ static const struct of_device_id lpuart_dt_ids[] = {
 MODULE_DEVICE_TABLE(of, lpuart_dt_ids);
 
 /* Forward declare this for the dma callbacks*/
-static int lpuart_dma_rx(struct lpuart_port *sport);
 static void lpuart_dma_tx_complete(void *arg);
-static inline void lpuart_prepare_rx(struct lpuart_port *sport);
+static void lpuart_copy_rx_to_tty(struct lpuart_port *sport,
+				  unsigned long *bytes);
 
 static u32 lpuart32_read(void __iomem *addr)
 {
@@ -747,11 +766,11 @@ static irqreturn_t lpuart_int(int irq, void *dev_id)
 	sts = readb(sport->port.membase + UARTSR1);
 	crdma = readb(sport->port.membase + UARTCR5);
 
-	if (sts & UARTSR1_RDRF && !(crdma & UARTCR5_RDMAS)) {
-		if (sport->lpuart_dma_rx_use)
-			lpuart_prepare_rx(sport);
-		else
-			lpuart_rxint(irq, dev_id);
+	if (sport->lpuart_dma_rx_use) {
+		if (sts & UARTSR1_OR)
+			sport->port.icount.overrun++;
+	} else if (sts & UARTSR1_RDRF && !(crdma & UARTCR5_RDMAS)) {
+		lpuart_rxint(irq, dev_id);
 	}
 
 	if (sts & UARTSR1_TDRE && !sport->lpuart_dma_tx_use)
@@ -773,12 +792,22 @@ static irqreturn_t lpuart32_int(int irq, void *dev_id)
 	if (!sts)
 		return IRQ_NONE;
 
-	if (!(crdma & UARTBAUD_RDMAE) && rxcount > 0) {
-		if (!sport->lpuart_dma_rx_use ||
-			(sts & (UARTSTAT_PE | UARTSTAT_NF | UARTSTAT_FE)))
-			lpuart32_rxint(irq, dev_id);
-		else if (sport->lpuart_dma_rx_use && sport->dma_rx_chan_active)
-			lpuart_prepare_rx(sport);
+	if (sport->lpuart_dma_rx_use) {
+		/* the DMA moves the data, only the error flags are left */
+		if (sts & UARTSTAT_PE)
+			sport->port.icount.parity++;
+		else if (sts & UARTSTAT_FE)
+			sport->port.icount.frame++;
+		if (sts & UARTSTAT_OR)
+			sport->port.icount.overrun++;
+
+		if (sts & UARTSTAT_IDLE) {
+			sport->rx_stats.idle++;
+			lpuart_copy_rx_to_tty(sport,
+					      &sport->rx_stats.idle_bytes);
+		}
+	} else if (!(crdma & UARTBAUD_RDMAE) && rxcount > 0) {
+		lpuart32_rxint(irq, dev_id);
 	}
 
 	if (sts & UARTSTAT_TDRE && !sport->lpuart_dma_tx_use)
@@ -788,119 +817,145 @@ static irqreturn_t lpuart32_int(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/*
+ * The RX DMA runs one cyclic transfer over the whole ring, so reception
+ * never pauses. The residue gives the write position of the engine, the
+ * ring tail is what has already been handed to the tty layer. Any flush
+ * source (end of period, idle line, timer) calls in here.
+ */
 static void lpuart_copy_rx_to_tty(struct lpuart_port *sport,
-		struct tty_port *tty, int count)
+				  unsigned long *bytes)
 {
-	int copied;
+	struct tty_port *port = &sport->port.state->port;
+	struct circ_buf *ring = &sport->rx_ring;
+	struct dma_tx_state state;
+	enum dma_status status;
+	unsigned long flags;
+	unsigned int count, copied;
 
-	sport->port.icount.rx += count;
+	spin_lock_irqsave(&sport->port.lock, flags);
 
-	if (!tty) {
-		dev_err(sport->port.dev, "No tty port\n");
+	status = dmaengine_tx_status(sport->dma_rx_chan,
+				     sport->dma_rx_cookie, &state);
+	if (status == DMA_ERROR) {
+		dev_err(sport->port.dev, "Rx DMA transfer failed!\n");
+		spin_unlock_irqrestore(&sport->port.lock, flags);
 		return;
 	}
 
-	dma_sync_single_for_cpu(sport->port.dev, sport->dma_rx_buf_bus,
-			sport->rxdma_len, DMA_FROM_DEVICE);
-	copied = tty_insert_flip_string(tty,
-			((unsigned char *)(sport->dma_rx_buf_virt)), count);
+	ring->head = sport->rxdma_len - state.residue;
+	if (ring->head == sport->rxdma_len)
+		ring->head = 0;
 
-	if (copied != count)
-		sport->port.icount.buf_overrun += count - copied;
-	sport->port.icount.rx += copied;
-}
+	count = CIRC_CNT(ring->head, ring->tail, sport->rxdma_len);
+	if (count > sport->rx_stats.max_pending)
+		sport->rx_stats.max_pending = count;
 
-static void lpuart_dma_stop(struct lpuart_port *sport, bool enable_pio)
-{
-	unsigned int temp;
-	unsigned int crdma;
+	while (count) {
+		unsigned int len = CIRC_CNT_TO_END(ring->head, ring->tail,
+						   sport->rxdma_len);
 
-	if (sport->lpuart32) {
-		lpuart32_write(UARTSTAT_IDLE, sport->port.membase + UARTSTAT);
-		crdma = lpuart32_read(sport->port.membase + UARTBAUD);
-		lpuart32_write(crdma & ~(UARTBAUD_RDMAE),
-				sport->port.membase + UARTBAUD);
-		if (enable_pio) {
-			temp = lpuart32_read(sport->port.membase + UARTCTRL);
-			temp |= (UARTCTRL_RIE | UARTCTRL_ILIE);
-			lpuart32_write(temp, sport->port.membase + UARTCTRL);
-		}
-	} else {
-		temp = readb(sport->port.membase + UARTCR5);
-		writeb(temp & ~UARTCR5_RDMAS, sport->port.membase + UARTCR5);
+		dma_sync_single_for_cpu(sport->port.dev,
+					sport->dma_rx_buf_bus + ring->tail,
+					len, DMA_FROM_DEVICE);
+		copied = tty_insert_flip_string(port, ring->buf + ring->tail,
+						len);
+		dma_sync_single_for_device(sport->port.dev,
+					   sport->dma_rx_buf_bus + ring->tail,
+					   len, DMA_FROM_DEVICE);
+
+		if (copied != len)
+			sport->port.icount.buf_overrun += len - copied;
+		sport->port.icount.rx += copied;
+		*bytes += len;
+
+		ring->tail = (ring->tail + len) & (sport->rxdma_len - 1);
+		count -= len;
 	}
+
+	spin_unlock_irqrestore(&sport->port.lock, flags);
+
+	tty_flip_buffer_push(port);
 }
 
 static void lpuart_dma_rx_complete(void *arg)
 {
 	struct lpuart_port *sport = arg;
-	struct tty_port *port = &sport->port.state->port;
-	unsigned long flags;
-	struct dma_tx_state state;
-	int count;
-
-	async_tx_ack(sport->dma_rx_desc);
-	mod_timer(&sport->lpuart_timer, jiffies + sport->dma_rx_timeout);
 
-	spin_lock_irqsave(&sport->port.lock, flags);
-	sport->dma_rx_in_progress = false;
-	dmaengine_tx_status(sport->dma_rx_chan, sport->dma_rx_cookie, &state);
-	count = sport->rxfifo_watermark - state.residue;
-	lpuart_copy_rx_to_tty(sport, port, count);
-	tty_flip_buffer_push(port);
-
-	if (count < sport->rxfifo_watermark)
-		lpuart_dma_stop(sport, true);
-	else
-		lpuart_dma_rx(sport);
-
-	spin_unlock_irqrestore(&sport->port.lock, flags);
+	sport->rx_stats.period++;
+	lpuart_copy_rx_to_tty(sport, &sport->rx_stats.period_bytes);
 }
 
+/*
+ * The LPUART without IDLE detection under DMA only gets partial periods
+ * out of the ring by polling.
+ */
 static void lpuart_timer_func(unsigned long data)
 {
 	struct lpuart_port *sport = (struct lpuart_port *)data;
-	struct tty_port *port = &sport->port.state->port;
-	struct dma_tx_state state;
-	unsigned long flags;
-	int count;
 
-	del_timer(&sport->lpuart_timer);
-	dmaengine_pause(sport->dma_rx_chan);
-	dmaengine_tx_status(sport->dma_rx_chan, sport->dma_rx_cookie, &state);
-	dmaengine_terminate_all(sport->dma_rx_chan);
-	count = sport->rxdma_len - state.residue;
-	async_tx_ack(sport->dma_rx_desc);
+	sport->rx_stats.timer++;
+	lpuart_copy_rx_to_tty(sport, &sport->rx_stats.timer_bytes);
+	mod_timer(&sport->lpuart_timer, jiffies + sport->dma_rx_timeout);
+}
 
-	spin_lock_irqsave(&sport->port.lock, flags);
+static unsigned long lpuart32_idlecfg(struct lpuart_port *sport)
+{
+	return sport->lpuart_dma_rx_use ? UARTCTRL_IDLECFG_DMA :
+					  UARTCTRL_IDLECFG;
+}
 
-	sport->dma_rx_in_progress = false;
-	lpuart_copy_rx_to_tty(sport, port, count);
-	tty_flip_buffer_push(port);
-	lpuart_dma_stop(sport, true);
+static void lpuart_dma_rx_enable(struct lpuart_port *sport, bool enable)
+{
+	unsigned long temp;
 
-	spin_unlock_irqrestore(&sport->port.lock, flags);
+	if (sport->lpuart32) {
+		temp = lpuart32_read(sport->port.membase + UARTBAUD);
+		if (enable)
+			temp |= UARTBAUD_RDMAE;
+		else
+			temp &= ~UARTBAUD_RDMAE;
+		lpuart32_write(temp, sport->port.membase + UARTBAUD);
+	} else {
+		temp = readb(sport->port.membase + UARTCR5);
+		if (enable)
+			temp |= UARTCR5_RDMAS;
+		else
+			temp &= ~UARTCR5_RDMAS;
+		writeb(temp, sport->port.membase + UARTCR5);
+	}
 }
 
-static int lpuart_dma_rx(struct lpuart_port *sport)
+static int lpuart_start_rx_dma(struct lpuart_port *sport)
 {
-	dma_sync_single_for_device(sport->port.dev, sport->dma_rx_buf_bus,
-			sport->rxdma_len, DMA_FROM_DEVICE);
-	sport->dma_rx_desc = dmaengine_prep_slave_single(sport->dma_rx_chan,
-			sport->dma_rx_buf_bus, sport->rxdma_len,
-			DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	struct dma_async_tx_descriptor *desc;
 
-	if (!sport->dma_rx_desc) {
+	sport->rx_ring.head = 0;
+	sport->rx_ring.tail = 0;
+
+	desc = dmaengine_prep_dma_cyclic(sport->dma_rx_chan,
+					 sport->dma_rx_buf_bus,
+					 sport->rxdma_len,
+					 sport->rxdma_len / 2,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc) {
 		dev_err(sport->port.dev, "Not able to get desc for rx\n");
 		return -EIO;
 	}
 
-	sport->dma_rx_desc->callback = lpuart_dma_rx_complete;
-	sport->dma_rx_desc->callback_param = sport;
-	sport->dma_rx_in_progress = true;
-	sport->dma_rx_cookie = dmaengine_submit(sport->dma_rx_desc);
+	desc->callback = lpuart_dma_rx_complete;
+	desc->callback_param = sport;
+	sport->dma_rx_cookie = dmaengine_submit(desc);
 	dma_async_issue_pending(sport->dma_rx_chan);
 
+	lpuart_dma_rx_enable(sport, true);
+
+	if (!sport->lpuart32) {
+		sport->dma_rx_timeout = msecs_to_jiffies(DMA_RX_TIMEOUT);
+		mod_timer(&sport->lpuart_timer,
+			  jiffies + sport->dma_rx_timeout);
+	}
+
 	return 0;
 }
 
@@ -908,40 +963,21 @@ static void lpuart_dma_rx_free(struct uart_port *port)
 {
 	struct lpuart_port *sport = container_of(port,
 					struct lpuart_port, port);
-
-	sport->dma_rx_chan_active = false;
-	dma_unmap_single(sport->port.dev, sport->dma_rx_buf_bus,
-			sport->rxdma_len, DMA_FROM_DEVICE);
-
-	sport->dma_rx_buf_bus = 0;
-	sport->dma_rx_buf_virt = NULL;
-}
-
-static inline void lpuart_prepare_rx(struct lpuart_port *sport)
-{
 	unsigned long flags;
-	unsigned int temp;
-	unsigned int crdma;
 
 	spin_lock_irqsave(&sport->port.lock, flags);
+	lpuart_dma_rx_enable(sport, false);
+	spin_unlock_irqrestore(&sport->port.lock, flags);
 
-	sport->lpuart_timer.expires = jiffies + sport->dma_rx_timeout;
-	add_timer(&sport->lpuart_timer);
+	dmaengine_terminate_all(sport->dma_rx_chan);
+	del_timer_sync(&sport->lpuart_timer);
 
-	lpuart_dma_rx(sport);
-	if (sport->lpuart32) {
-		temp = lpuart32_read(sport->port.membase + UARTCTRL);
-		temp &= ~(UARTCTRL_RIE | UARTCTRL_ILIE);
-		lpuart32_write(temp, sport->port.membase + UARTCTRL);
-		crdma = lpuart32_read(sport->port.membase + UARTBAUD);
-		lpuart32_write(crdma | UARTBAUD_RDMAE,
-			sport->port.membase + UARTBAUD);
-	} else {
-		temp = readb(sport->port.membase + UARTCR5);
-		writeb(temp | UARTCR5_RDMAS, sport->port.membase + UARTCR5);
-	}
+	dma_unmap_single(sport->port.dev, sport->dma_rx_buf_bus,
+			sport->rxdma_len, DMA_FROM_DEVICE);
+	kfree(sport->rx_ring.buf);
 
-	spin_unlock_irqrestore(&sport->port.lock, flags);
+	sport->rx_ring.buf = NULL;
+	sport->dma_rx_buf_bus = 0;
 }
 
 static int lpuart_config_rs485(struct uart_port *port,
@@ -1157,8 +1193,7 @@ static int lpuart_dma_rx_request(struct uart_port *port)
 	unsigned char *dma_buf;
 	int ret;
 
-	dma_buf = devm_kzalloc(sport->port.dev,
-				FSL_UART_RX_DMA_BUFFER_SIZE, GFP_KERNEL);
+	dma_buf = kzalloc(sport->rxdma_len, GFP_KERNEL);
 
 	if (!dma_buf) {
 		dev_err(sport->port.dev, "Dma rx alloc failed\n");
@@ -1166,10 +1201,11 @@ static int lpuart_dma_rx_request(struct uart_port *port)
 	}
 
 	dma_bus = dma_map_single(sport->port.dev, dma_buf,
-				FSL_UART_RX_DMA_BUFFER_SIZE, DMA_FROM_DEVICE);
+				sport->rxdma_len, DMA_FROM_DEVICE);
 
 	if (dma_mapping_error(sport->port.dev, dma_bus)) {
 		dev_err(sport->port.dev, "dma_map_single rx failed\n");
+		kfree(dma_buf);
 		return -ENOMEM;
 	}
 
@@ -1186,13 +1222,14 @@ static int lpuart_dma_rx_request(struct uart_port *port)
 	if (ret < 0) {
 		dev_err(sport->port.dev,
 				"Dma slave config failed, err = %d\n", ret);
+		dma_unmap_single(sport->port.dev, dma_bus, sport->rxdma_len,
+				 DMA_FROM_DEVICE);
+		kfree(dma_buf);
 		return ret;
 	}
 
-	sport->dma_rx_buf_virt = dma_buf;
+	sport->rx_ring.buf = dma_buf;
 	sport->dma_rx_buf_bus = dma_bus;
-	sport->dma_rx_in_progress = false;
-	sport->dma_rx_chan_active = true;
 
 	return 0;
 }
@@ -1223,13 +1260,10 @@ static int lpuart_startup(struct uart_port *port)
 
 	sport->rxfifo_size = 0x1 << (((temp >> UARTPFIFO_RXSIZE_OFF) &
 		UARTPFIFO_FIFOSIZE_MASK) + 1);
-	sport->rxdma_len = FSL_UART_RX_DMA_BUFFER_SIZE;
 
-	if (sport->dma_rx_chan && !lpuart_dma_rx_request(port)) {
+	if (sport->dma_rx_chan && !lpuart_dma_rx_request(port))
 		sport->lpuart_dma_rx_use = true;
-		setup_timer(&sport->lpuart_timer, lpuart_timer_func,
-			    (unsigned long)sport);
-	} else
+	else
 		sport->lpuart_dma_rx_use = false;
 
 
@@ -1256,6 +1290,12 @@ static int lpuart_startup(struct uart_port *port)
 	writeb(temp, sport->port.membase + UARTCR2);
 
 	spin_unlock_irqrestore(&sport->port.lock, flags);
+
+	if (sport->lpuart_dma_rx_use && lpuart_start_rx_dma(sport)) {
+		lpuart_dma_rx_free(port);
+		sport->lpuart_dma_rx_use = false;
+	}
+
 	return 0;
 }
 
@@ -1296,13 +1336,10 @@ static int lpuart32_startup(struct uart_port *port)
 
 	sport->txfifo_watermark = sport->txfifo_size >> 1;
 	sport->rxfifo_watermark = sport->rxfifo_size >> 1;
-	sport->rxdma_len = sport->rxfifo_watermark;
 
-	if (sport->dma_rx_chan && !lpuart_dma_rx_request(port)) {
+	if (sport->dma_rx_chan && !lpuart_dma_rx_request(port))
 		sport->lpuart_dma_rx_use = true;
-		setup_timer(&sport->lpuart_timer, lpuart_timer_func,
-			    (unsigned long)sport);
-	} else
+	else
 		sport->lpuart_dma_rx_use = false;
 
 
@@ -1327,10 +1364,17 @@ static int lpuart32_startup(struct uart_port *port)
 	temp = lpuart32_read(sport->port.membase + UARTCTRL);
 	temp |= (UARTCTRL_RIE | UARTCTRL_RE | UARTCTRL_TE);
 	temp |= UARTCTRL_ILIE;
-	temp |= UARTCTRL_IDLECFG << UARTCTRL_IDLECFG_OFF;
+	temp &= ~(UARTCTRL_IDLECFG << UARTCTRL_IDLECFG_OFF);
+	temp |= lpuart32_idlecfg(sport) << UARTCTRL_IDLECFG_OFF;
 	lpuart32_write(temp, sport->port.membase + UARTCTRL);
 
 	spin_unlock_irqrestore(&sport->port.lock, flags);
+
+	if (sport->lpuart_dma_rx_use && lpuart_start_rx_dma(sport)) {
+		lpuart_dma_rx_free(port);
+		sport->lpuart_dma_rx_use = false;
+	}
+
 	return 0;
 }
 
@@ -1353,16 +1397,8 @@ static void lpuart_shutdown(struct uart_port *port)
 
 	devm_free_irq(port->dev, port->irq, sport);
 
-	if (sport->lpuart_dma_rx_use) {
-		ret = wait_event_interruptible_timeout(sport->dma_wait,
-			!sport->dma_rx_in_progress, msecs_to_jiffies(1));
-		if (ret <= 0) {
-			sport->dma_rx_in_progress = false;
-			dmaengine_terminate_all(sport->dma_rx_chan);
-		}
+	if (sport->lpuart_dma_rx_use)
 		lpuart_dma_rx_free(&sport->port);
-		del_timer_sync(&sport->lpuart_timer);
-	}
 
 	if (sport->lpuart_dma_tx_use) {
 		ret = wait_event_interruptible_timeout(sport->dma_wait,
@@ -1402,16 +1438,8 @@ static void lpuart32_shutdown(struct uart_port *port)
 
 	devm_free_irq(port->dev, port->irq, sport);
 
-	if (sport->lpuart_dma_rx_use) {
-		ret = wait_event_interruptible_timeout(sport->dma_wait,
-			!sport->dma_rx_in_progress, msecs_to_jiffies(1));
-		if (ret <= 0) {
-			sport->dma_rx_in_progress = false;
-			dmaengine_terminate_all(sport->dma_rx_chan);
-		}
+	if (sport->lpuart_dma_rx_use)
 		lpuart_dma_rx_free(&sport->port);
-		del_timer_sync(&sport->lpuart_timer);
-	}
 
 	if (sport->lpuart_dma_tx_use) {
 		ret = wait_event_interruptible_timeout(sport->dma_wait,
@@ -1536,17 +1564,6 @@ lpuart_set_termios(struct uart_port *port, struct ktermios *termios,
 	/* update the per-port timeout */
 	uart_update_timeout(port, termios->c_cflag, baud);
 
-	if (sport->lpuart_dma_rx_use) {
-		/* Calculate delay for 1.5 DMA buffers */
-		sport->dma_rx_timeout = (sport->port.timeout - HZ / 50) *
-					FSL_UART_RX_DMA_BUFFER_SIZE * 3 /
-					sport->rxfifo_size / 2;
-		dev_dbg(port->dev, "DMA Rx t-out %ums, tty t-out %u jiffies\n",
-			sport->dma_rx_timeout * 1000 / HZ, sport->port.timeout);
-		if (sport->dma_rx_timeout < msecs_to_jiffies(20))
-			sport->dma_rx_timeout = msecs_to_jiffies(20);
-	}
-
 	/* wait transmit engin complete */
 	while (!(readb(sport->port.membase + UARTSR1) & UARTSR1_TC))
 		barrier();
@@ -1726,17 +1743,6 @@ lpuart32_set_termios(struct uart_port *port, struct ktermios *termios,
 	/* update the per-port timeout */
 	uart_update_timeout(port, termios->c_cflag, baud);
 
-	if (sport->lpuart_dma_rx_use) {
-		/* Calculate delay for 1.5 DMA buffers */
-		sport->dma_rx_timeout = (sport->port.timeout - HZ / 50) *
-					sport->rxdma_len * 3 /
-					sport->rxfifo_size / 2;
-		dev_dbg(port->dev, "DMA Rx t-out %ums, tty t-out %u jiffies\n",
-			sport->dma_rx_timeout * 1000 / HZ, sport->port.timeout);
-		if (sport->dma_rx_timeout < msecs_to_jiffies(20))
-			sport->dma_rx_timeout = msecs_to_jiffies(20);
-	}
-
 	/* wait transmit engin complete, there disable flow control */
 	lpuart32_write(0, sport->port.membase + UARTMODIR);
 	while (!(lpuart32_read(sport->port.membase + UARTSTAT) & UARTSTAT_TC))
@@ -2122,11 +2128,57 @@ static struct uart_driver lpuart_reg = {
 	.cons		= LPUART_CONSOLE,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int lpuart_debugfs_show(struct seq_file *s, void *data)
+{
+	struct lpuart_port *sport = s->private;
+	struct lpuart_rx_stats *stats = &sport->rx_stats;
+
+	seq_printf(s, "rx dma %s, ring %zu bytes\n",
+		   sport->lpuart_dma_rx_use ? "on" : "off", sport->rxdma_len);
+	seq_printf(s, "period flushes: %lu, %lu bytes\n",
+		   stats->period, stats->period_bytes);
+	seq_printf(s, "idle flushes: %lu, %lu bytes\n",
+		   stats->idle, stats->idle_bytes);
+	seq_printf(s, "timer flushes: %lu, %lu bytes\n",
+		   stats->timer, stats->timer_bytes);
+	seq_printf(s, "max pending: %u bytes\n", stats->max_pending);
+	seq_printf(s, "overrun: %u, buf_overrun: %u\n",
+		   sport->port.icount.overrun, sport->port.icount.buf_overrun);
+
+	return 0;
+}
+
+static int lpuart_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpuart_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations lpuart_debugfs_operations = {
+	.open		= lpuart_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lpuart_init_debugfs(struct lpuart_port *sport)
+{
+	sport->debugfs = debugfs_create_file(dev_name(sport->port.dev), 0444,
+					     NULL, sport,
+					     &lpuart_debugfs_operations);
+}
+#else
+static inline void lpuart_init_debugfs(struct lpuart_port *sport)
+{
+}
+#endif
+
 static int lpuart_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
 	struct lpuart_port *sport;
 	struct resource *res;
+	u32 ring_size;
 	int ret;
 
 	sport = devm_kzalloc(&pdev->dev, sizeof(*sport), GFP_KERNEL);
@@ -2167,6 +2219,14 @@ static int lpuart_probe(struct platform_device *pdev)
 	if (!sport->lpuart32)
 		sport->port.rs485_config = lpuart_config_rs485;
 
+	if (of_property_read_u32(np, "fsl,dma-rx-ring-size", &ring_size))
+		ring_size = FSL_UART_RX_DMA_RING_SIZE;
+	ring_size = clamp_t(u32, ring_size, FSL_UART_RX_DMA_RING_MIN,
+			    FSL_UART_RX_DMA_RING_MAX);
+	sport->rxdma_len = roundup_pow_of_two(ring_size);
+	setup_timer(&sport->lpuart_timer, lpuart_timer_func,
+		    (unsigned long)sport);
+
 	sport->ipg_clk = devm_clk_get(&pdev->dev, "ipg");
 	if (IS_ERR(sport->ipg_clk)) {
 		ret = PTR_ERR(sport->per_clk);
@@ -2217,6 +2277,8 @@ static int lpuart_probe(struct platform_device *pdev)
 	if (!sport->dma_rx_chan)
 		dev_info(sport->port.dev, "NO DMA rx channel, run at cpu mode\n");
 
+	lpuart_init_debugfs(sport);
+
 	if (!sport->lpuart32 &&
 		of_property_read_bool(np, "linux,rs485-enabled-at-boot-time")) {
 		sport->port.rs485.flags |= SER_RS485_ENABLED;
@@ -2235,6 +2297,8 @@ static int lpuart_remove(struct platform_device *pdev)
 
 	uart_remove_one_port(&lpuart_reg, &sport->port);
 
+	debugfs_remove(sport->debugfs);
+
 	if (sport->dma_tx_chan)
 		dma_release_channel(sport->dma_tx_chan);
 
@@ -2307,7 +2371,6 @@ static int lpuart_suspend(struct device *dev)
 	struct lpuart_port *sport = dev_get_drvdata(dev);
 	struct tty_port *port = &sport->port.state->port;
 	unsigned long temp;
-	unsigned long flags;
 	int ret;
 
 	ret = clk_prepare_enable(sport->ipg_clk);
@@ -2328,12 +2391,6 @@ static int lpuart_suspend(struct device *dev)
 
 	if (sport->lpuart_dma_rx_use && sport->port.irq_wake &&
 		tty_port_initialized(port)) {
-		spin_lock_irqsave(&sport->port.lock, flags);
-		lpuart_dma_stop(sport, false);
-		spin_unlock_irqrestore(&sport->port.lock, flags);
-
-		dmaengine_terminate_all(sport->dma_rx_chan);
-		del_timer_sync(&sport->lpuart_timer);
 		lpuart_dma_rx_free(&sport->port);
 	}
 
@@ -2379,18 +2436,21 @@ static inline void lpuart32_resume_init(struct lpuart_port *sport)
 
 	if (sport->lpuart_dma_rx_use && sport->port.irq_wake &&
 		tty_port_initialized(port)) {
-		if (!lpuart_dma_rx_request(&sport->port)) {
+		if (!lpuart_dma_rx_request(&sport->port))
 			sport->lpuart_dma_rx_use = true;
-			setup_timer(&sport->lpuart_timer, lpuart_timer_func,
-				(unsigned long)sport);
-		} else {
+		else
 			sport->lpuart_dma_rx_use = false;
-		}
 
 		temp = lpuart32_read(sport->port.membase + UARTCTRL);
 		temp |= (UARTCTRL_RIE | UARTCTRL_ILIE | UARTCTRL_RE);
-		temp |= UARTCTRL_IDLECFG << UARTCTRL_IDLECFG_OFF;
+		temp &= ~(UARTCTRL_IDLECFG << UARTCTRL_IDLECFG_OFF);
+		temp |= lpuart32_idlecfg(sport) << UARTCTRL_IDLECFG_OFF;
 		lpuart32_write(temp, sport->port.membase + UARTCTRL);
+
+		if (sport->lpuart_dma_rx_use && lpuart_start_rx_dma(sport)) {
+			lpuart_dma_rx_free(&sport->port);
+			sport->lpuart_dma_rx_use = false;
+		}
 	}
 
 	if (sport->lpuart_dma_tx_use && sport->port.irq_wake &&
@@ -2432,18 +2492,19 @@ static inline void lpuart_resume_init(struct lpuart_port *sport)
 
 	if (sport->lpuart_dma_rx_use && sport->port.irq_wake &&
 		tty_port_initialized(port)) {
-		if (!lpuart_dma_rx_request(&sport->port)) {
+		if (!lpuart_dma_rx_request(&sport->port))
 			sport->lpuart_dma_rx_use = true;
-			setup_timer(&sport->lpuart_timer,
-				lpuart_timer_func,
-				(unsigned long)sport);
-		} else {
+		else
 			sport->lpuart_dma_rx_use = false;
-		}
 
 		temp = readb(sport->port.membase + UARTCR2);
 		temp |= (UARTCR2_RIE | UARTCR2_RE);
 		writeb(temp, sport->port.membase + UARTCR2);
+
+		if (sport->lpuart_dma_rx_use && lpuart_start_rx_dma(sport)) {
+			lpuart_dma_rx_free(&sport->port);
+			sport->lpuart_dma_rx_use = false;
+		}
 	}
 
 	if (sport->lpuart_dma_tx_use && sport->port.irq_wake &&
@@ -65,6 +65,9 @@
 #define RX_BURST_MASK		0xff
 #define TX_BURST_MASK		0xff00
 
+/* TXFILLTUNING */
+#define TXFIFOTHRES_MASK	(0x3fUL << 16)
+
 /* PORTSC */
 #define PORTSC_CCS            BIT(0)
 #define PORTSC_CSC            BIT(1)
@@ -24,6 +24,7 @@
  *****************************************************************************/
 #define TD_PAGE_COUNT      5
 #define CI_HDRC_PAGE_SIZE  4096ul /* page size for TD's */
+#define CI_MAX_BUF_SIZE    (TD_PAGE_COUNT * CI_HDRC_PAGE_SIZE)
 #define ENDPT_MAX          32
 
 /******************************************************************************
@@ -52,6 +53,7 @@ enum ci_hw_regs {
 	OP_ENDPTLISTADDR,
 	OP_TTCTRL,
 	OP_BURSTSIZE,
+	OP_TXFILLTUNING,
 	OP_PORTSC,
 	OP_DEVLC,
 	OP_OTGSC,
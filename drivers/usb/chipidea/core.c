@@ -86,6 +86,7 @@ static const u8 ci_regs_nolpm[] = {
 	[OP_ENDPTLISTADDR]	= 0x18U,
 	[OP_TTCTRL]		= 0x1CU,
 	[OP_BURSTSIZE]		= 0x20U,
+	[OP_TXFILLTUNING]	= 0x24U,
 	[OP_PORTSC]		= 0x44U,
 	[OP_DEVLC]		= 0x84U,
 	[OP_OTGSC]		= 0x64U,
@@ -110,6 +111,7 @@ static const u8 ci_regs_lpm[] = {
 	[OP_ENDPTLISTADDR]	= 0x18U,
 	[OP_TTCTRL]		= 0x1CU,
 	[OP_BURSTSIZE]		= 0x20U,
+	[OP_TXFILLTUNING]	= 0x24U,
 	[OP_PORTSC]		= 0x44U,
 	[OP_DEVLC]		= 0x84U,
 	[OP_OTGSC]		= 0xC4U,
@@ -453,6 +455,11 @@ void ci_platform_configure(struct ci_hdrc *ci)
 			hw_write(ci, OP_BURSTSIZE, RX_BURST_MASK,
 				ci->platdata->rx_burst_size);
 	}
+
+	if (is_host_mode &&
+		(ci->platdata->flags & CI_HDRC_OVERRIDE_TXFIFO_THRES))
+		hw_write(ci, OP_TXFILLTUNING, TXFIFOTHRES_MASK,
+			ci->platdata->txfifo_thres << __ffs(TXFIFOTHRES_MASK));
 }
 
 /**
@@ -675,6 +682,20 @@ static int ci_get_platdata(struct device *dev,
 		return ret;
 	}
 
+	ret = of_property_read_u32(dev->of_node, "tx-fifo-fill-threshold",
+				&platdata->txfifo_thres);
+	if (!ret) {
+		if (platdata->txfifo_thres >
+				TXFIFOTHRES_MASK >> __ffs(TXFIFOTHRES_MASK)) {
+			dev_err(dev, "invalid tx-fifo-fill-threshold\n");
+			return -EINVAL;
+		}
+		platdata->flags |= CI_HDRC_OVERRIDE_TXFIFO_THRES;
+	} else if (ret != -EINVAL) {
+		dev_err(dev, "failed to get tx-fifo-fill-threshold\n");
+		return ret;
+	}
+
 	if (of_find_property(dev->of_node, "non-zero-ttctrl-ttha", NULL))
 		platdata->flags |= CI_HDRC_SET_NON_ZERO_TTHA;
 
@@ -24,6 +24,7 @@
 #include <linux/hid.h>
 #include <linux/module.h>
 #include <linux/uio.h>
+#include <linux/scatterlist.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -222,6 +223,12 @@ struct ffs_io_data {
 	struct usb_ep *ep;
 	struct usb_request *req;
 
+	/* pinned user pages, when queued without a bounce buffer */
+	bool use_sg;
+	struct sg_table sgt;
+	struct page **pages;
+	int n_pages;
+
 	struct ffs_data *ffs;
 };
 
@@ -750,6 +757,95 @@ static ssize_t ffs_copy_to_iter(void *data, int data_len, struct iov_iter *iter)
 	return ret;
 }
 
+/*
+ * Zero copy: with the "zerocopy=1" mount option and an SG capable UDC,
+ * a page aligned single segment buffer is pinned and queued as an sg
+ * list instead of being copied into a kernel buffer.  OUT requests
+ * have to be a multiple of the max packet size already, there is no
+ * room for the excess data otherwise (see ffs_copy_to_iter).
+ */
+static bool ffs_epfile_can_zerocopy(struct ffs_data *ffs,
+				    struct usb_gadget *gadget,
+				    struct ffs_io_data *io_data,
+				    ssize_t data_len)
+{
+	struct iov_iter *iter = &io_data->data;
+
+	if (!ffs->zerocopy || !gadget->sg_supported || !data_len)
+		return false;
+
+	if (!iter_is_iovec(iter) || iter->nr_segs != 1 ||
+	    data_len != iov_iter_count(iter))
+		return false;
+
+	return !(((unsigned long)iter->iov->iov_base + iter->iov_offset) %
+		 PAGE_SIZE);
+}
+
+static void ffs_free_sg(struct ffs_io_data *io_data)
+{
+	int i;
+
+	for (i = 0; i < io_data->n_pages; i++) {
+		if (io_data->read)
+			set_page_dirty_lock(io_data->pages[i]);
+		put_page(io_data->pages[i]);
+	}
+	kvfree(io_data->pages);
+	sg_free_table(&io_data->sgt);
+	io_data->use_sg = false;
+}
+
+static int ffs_build_sg(struct ffs_io_data *io_data, size_t data_len)
+{
+	struct page **pages;
+	size_t start;
+	ssize_t len;
+	int n_pages, i, ret;
+
+	len = iov_iter_get_pages_alloc(&io_data->data, &pages, data_len,
+				       &start);
+	if (len < 0)
+		return len;
+
+	n_pages = DIV_ROUND_UP(start + len, PAGE_SIZE);
+	if (len != data_len) {
+		ret = -EFAULT;
+		goto error;
+	}
+
+	ret = sg_alloc_table_from_pages(&io_data->sgt, pages, n_pages,
+					start, len, GFP_KERNEL);
+	if (ret)
+		goto error;
+
+	io_data->pages = pages;
+	io_data->n_pages = n_pages;
+	io_data->use_sg = true;
+	return 0;
+
+error:
+	for (i = 0; i < n_pages; i++)
+		put_page(pages[i]);
+	kvfree(pages);
+	return ret;
+}
+
+static void ffs_epfile_set_req_buf(struct usb_request *req,
+				   struct ffs_io_data *io_data,
+				   char *data, ssize_t data_len)
+{
+	req->buf = data;
+	req->length = data_len;
+	if (io_data->use_sg) {
+		req->sg = io_data->sgt.sgl;
+		req->num_sgs = io_data->sgt.nents;
+	} else {
+		req->sg = NULL;
+		req->num_sgs = 0;
+	}
+}
+
 static void ffs_user_copy_worker(struct work_struct *work)
 {
 	struct ffs_io_data *io_data = container_of(work, struct ffs_io_data,
@@ -758,7 +854,7 @@ static void ffs_user_copy_worker(struct work_struct *work)
 					 io_data->req->actual;
 	bool kiocb_has_eventfd = io_data->kiocb->ki_flags & IOCB_EVENTFD;
 
-	if (io_data->read && ret > 0) {
+	if (io_data->read && ret > 0 && !io_data->use_sg) {
 		use_mm(io_data->mm);
 		ret = ffs_copy_to_iter(io_data->buf, ret, &io_data->data);
 		unuse_mm(io_data->mm);
@@ -771,6 +867,8 @@ static void ffs_user_copy_worker(struct work_struct *work)
 
 	usb_ep_free_request(io_data->ep, io_data->req);
 
+	if (io_data->use_sg)
+		ffs_free_sg(io_data);
 	if (io_data->read)
 		kfree(io_data->to_free);
 	kfree(io_data->buf);
@@ -943,15 +1041,23 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
-		data = kmalloc(data_len, GFP_KERNEL);
-		if (unlikely(!data)) {
-			ret = -ENOMEM;
-			goto error_mutex;
-		}
-		if (!io_data->read &&
-		    copy_from_iter(data, data_len, &io_data->data) != data_len) {
-			ret = -EFAULT;
-			goto error_mutex;
+		/* fall back to the bounce buffer if pinning fails */
+		if (ffs_epfile_can_zerocopy(epfile->ffs, gadget, io_data,
+					    data_len))
+			ffs_build_sg(io_data, data_len);
+
+		if (!io_data->use_sg) {
+			data = kmalloc(data_len, GFP_KERNEL);
+			if (unlikely(!data)) {
+				ret = -ENOMEM;
+				goto error_mutex;
+			}
+			if (!io_data->read &&
+			    copy_from_iter(data, data_len,
+					   &io_data->data) != data_len) {
+				ret = -EFAULT;
+				goto error_mutex;
+			}
 		}
 	}
 
@@ -984,8 +1090,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		bool interrupted = false;
 
 		req = ep->req;
-		req->buf      = data;
-		req->length   = data_len;
+		ffs_epfile_set_req_buf(req, io_data, data, data_len);
 
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
@@ -1007,19 +1112,23 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			interrupted = ep->status < 0;
 		}
 
-		if (interrupted)
+		if (interrupted) {
 			ret = -EINTR;
-		else if (io_data->read && ep->status > 0)
+		} else if (io_data->use_sg) {
+			ret = ep->status;
+			if (ret > 0)
+				iov_iter_advance(&io_data->data, ret);
+		} else if (io_data->read && ep->status > 0) {
 			ret = __ffs_epfile_read_data(epfile, data, ep->status,
 						     &io_data->data);
-		else
+		} else {
 			ret = ep->status;
+		}
 		goto error_mutex;
 	} else if (!(req = usb_ep_alloc_request(ep->ep, GFP_KERNEL))) {
 		ret = -ENOMEM;
 	} else {
-		req->buf      = data;
-		req->length   = data_len;
+		ffs_epfile_set_req_buf(req, io_data, data, data_len);
 
 		io_data->buf = data;
 		io_data->ep = ep->ep;
@@ -1048,6 +1157,9 @@ error_lock:
 error_mutex:
 	mutex_unlock(&epfile->mutex);
 error:
+	/* a queued AIO request owns io_data, it may be gone already */
+	if (ret != -EIOCBQUEUED && io_data->use_sg)
+		ffs_free_sg(io_data);
 	kfree(data);
 	return ret;
 }
@@ -1105,6 +1217,7 @@ static ssize_t ffs_epfile_write_iter(struct kiocb *kiocb, struct iov_iter *from)
 	}
 
 	p->read = false;
+	p->use_sg = false;
 	p->kiocb = kiocb;
 	p->data = *from;
 	p->mm = current->mm;
@@ -1141,6 +1254,7 @@ static ssize_t ffs_epfile_read_iter(struct kiocb *kiocb, struct iov_iter *to)
 	}
 
 	p->read = true;
+	p->use_sg = false;
 	p->kiocb = kiocb;
 	if (p->aio) {
 		p->to_free = dup_iter(&p->data, to, GFP_KERNEL);
@@ -1332,6 +1446,7 @@ struct ffs_sb_fill_data {
 	umode_t root_mode;
 	const char *dev_name;
 	bool no_disconnect;
+	bool zerocopy;
 	struct ffs_data *ffs_data;
 };
 
@@ -1408,6 +1523,12 @@ static int ffs_fs_parse_opts(struct ffs_sb_fill_data *data, char *opts)
 			else
 				goto invalid;
 			break;
+		case 8:
+			if (!memcmp(opts, "zerocopy", 8))
+				data->zerocopy = !!value;
+			else
+				goto invalid;
+			break;
 		case 5:
 			if (!memcmp(opts, "rmode", 5))
 				data->root_mode  = (value & 0555) | S_IFDIR;
@@ -1473,6 +1594,7 @@ ffs_fs_mount(struct file_system_type *t, int flags,
 		},
 		.root_mode = S_IFDIR | 0500,
 		.no_disconnect = false,
+		.zerocopy = false,
 	};
 	struct dentry *rv;
 	int ret;
@@ -1490,6 +1612,7 @@ ffs_fs_mount(struct file_system_type *t, int flags,
 		return ERR_PTR(-ENOMEM);
 	ffs->file_perms = data.perms;
 	ffs->no_disconnect = data.no_disconnect;
+	ffs->zerocopy = data.zerocopy;
 
 	ffs->dev_name = kstrdup(dev_name, GFP_KERNEL);
 	if (unlikely(!ffs->dev_name)) {
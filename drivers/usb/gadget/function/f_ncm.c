@@ -71,6 +71,10 @@ struct f_ncm {
 
 	struct net_device		*netdev;
 
+	/* NTB limits, taken from the instance options at allocation */
+	struct usb_cdc_ncm_ntb_parameters ntb_params;
+	u16				tx_max_dgrams;
+
 	/* For multi-frame NDP TX */
 	struct sk_buff			*skb_tx_data;
 	struct sk_buff			*skb_tx_ndp;
@@ -109,22 +113,43 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 #define NTB_DEFAULT_IN_SIZE	16384
 #define NTB_OUT_SIZE		16384
 
+/*
+ * Both NTB sizes may be raised through configfs up to the NTB16 limit,
+ * since the host is free to select either NTB format.
+ */
+#define NTB_MAX_SIZE		65535
+
 /* Allocation for storing the NDP, 32 should suffice for a
  * 16k packet. This allows a maximum of 32 * 507 Byte packets to
  * be transmitted in a single 16kB skb, though when sending full size
  * packets this limit will be plenty.
  * Smaller packets are not likely to be trying to maximize the
  * throughput and will be mstly sending smaller infrequent frames.
+ * Larger NTBs want a larger limit, so it is tunable via configfs.
  */
 #define TX_MAX_NUM_DPE		32
+#define TX_MAX_NUM_DPE_LIMIT	1024
 
-/* Delay for the transmit to wait before sending an unfilled NTB frame. */
+/*
+ * Delay for the transmit to wait before sending an unfilled NTB frame.
+ * It only applies while earlier NTBs are still queued to the UDC; an
+ * idle IN pipe gets the NTB right away, so light traffic sees no
+ * added latency and aggregation grows with the queue depth.
+ */
 #define TX_TIMEOUT_NSECS	300000
 
+/*
+ * Received datagrams up to this size are copied out of the NTB, bigger
+ * ones only get their headers copied and reference the rest of the
+ * NTB page as a fragment.
+ */
+#define RX_COPYBREAK		256
+#define RX_HDR_LEN		128
+
 #define FORMATS_SUPPORTED	(USB_CDC_NCM_NTB16_SUPPORTED |	\
 				 USB_CDC_NCM_NTB32_SUPPORTED)
 
-static struct usb_cdc_ncm_ntb_parameters ntb_parameters = {
+static const struct usb_cdc_ncm_ntb_parameters ntb_parameters = {
 	.wLength = cpu_to_le16(sizeof(ntb_parameters)),
 	.bmNtbFormatsSupported = cpu_to_le16(FORMATS_SUPPORTED),
 	.dwNtbInMaxSize = cpu_to_le32(NTB_DEFAULT_IN_SIZE),
@@ -536,8 +561,8 @@ static inline void ncm_reset_values(struct f_ncm *ncm)
 	/* doesn't make sense for ncm, fixed size used */
 	ncm->port.header_len = 0;
 
-	ncm->port.fixed_out_len = le32_to_cpu(ntb_parameters.dwNtbOutMaxSize);
-	ncm->port.fixed_in_len = NTB_DEFAULT_IN_SIZE;
+	ncm->port.fixed_out_len = le32_to_cpu(ncm->ntb_params.dwNtbOutMaxSize);
+	ncm->port.fixed_in_len = le32_to_cpu(ncm->ntb_params.dwNtbInMaxSize);
 }
 
 /*
@@ -668,7 +693,7 @@ static void ncm_ep0out_complete(struct usb_ep *ep, struct usb_request *req)
 
 	in_size = get_unaligned_le32(req->buf);
 	if (in_size < USB_CDC_NCM_NTB_MIN_IN_SIZE ||
-	    in_size > le32_to_cpu(ntb_parameters.dwNtbInMaxSize)) {
+	    in_size > le32_to_cpu(ncm->ntb_params.dwNtbInMaxSize)) {
 		DBG(cdev, "Got wrong INPUT SIZE (%d) from host\n", in_size);
 		goto invalid;
 	}
@@ -729,9 +754,9 @@ static int ncm_setup(struct usb_function *f, const struct usb_ctrlrequest *ctrl)
 
 		if (w_length == 0 || w_value != 0 || w_index != ncm->ctrl_id)
 			goto invalid;
-		value = w_length > sizeof ntb_parameters ?
-			sizeof ntb_parameters : w_length;
-		memcpy(req->buf, &ntb_parameters, value);
+		value = w_length > sizeof(ncm->ntb_params) ?
+			sizeof(ncm->ntb_params) : w_length;
+		memcpy(req->buf, &ncm->ntb_params, value);
 		VDBG(cdev, "Host asked NTB parameters\n");
 		break;
 
@@ -968,7 +993,7 @@ static struct sk_buff *package_for_tx(struct f_ncm *ncm)
 	unsigned	new_len;
 
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
-	const int ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	const int ndp_align = le16_to_cpu(ncm->ntb_params.wNdpInAlignment);
 	const int dgram_idx_len = 2 * 2 * opts->dgram_item_len;
 
 	/* Stop the timer */
@@ -1031,9 +1056,9 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 
 	unsigned	max_size = ncm->port.fixed_in_len;
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
-	const int ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
-	const int div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
-	const int rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
+	const int ndp_align = le16_to_cpu(ncm->ntb_params.wNdpInAlignment);
+	const int div = le16_to_cpu(ncm->ntb_params.wNdpInDivisor);
+	const int rem = le16_to_cpu(ncm->ntb_params.wNdpInPayloadRemainder);
 	const int dgram_idx_len = 2 * 2 * opts->dgram_item_len;
 
 	if (!skb && !ncm->skb_tx_data)
@@ -1058,7 +1083,7 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		 * NOTE: Assume maximum align for speed of calculation.
 		 */
 		if (ncm->skb_tx_data
-		    && (ncm->ndp_dgram_count >= TX_MAX_NUM_DPE
+		    && (ncm->ndp_dgram_count > ncm->tx_max_dgrams
 		    || (ncm->skb_tx_data->len +
 		    div + rem + skb->len +
 		    ncm->skb_tx_ndp->len + ndp_align + (2 * dgram_idx_len))
@@ -1086,13 +1111,12 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 			/* wHeaderLength */
 			put_unaligned_le16(opts->nth_size, ntb_data++);
 
-			/* Allocate an skb for storing the NDP,
-			 * TX_MAX_NUM_DPE should easily suffice for a
-			 * 16k packet.
+			/* Allocate an skb for storing the NDP, with room
+			 * for the zeroed entry after the last datagram.
 			 */
 			ncm->skb_tx_ndp = alloc_skb((int)(opts->ndp_size
 						    + opts->dpe_size
-						    * TX_MAX_NUM_DPE),
+						    * (ncm->tx_max_dgrams + 1)),
 						    GFP_ATOMIC);
 			if (!ncm->skb_tx_ndp)
 				goto err;
@@ -1109,11 +1133,6 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 			/* Note: we skip opts->next_ndp_index */
 		}
 
-		/* Delay the timer. */
-		hrtimer_start(&ncm->task_timer,
-			      ktime_set(0, TX_TIMEOUT_NSECS),
-			      HRTIMER_MODE_REL);
-
 		/* Add the datagram position entries */
 		ntb_ndp = (void *) skb_put(ncm->skb_tx_ndp, dgram_idx_len);
 		memset(ntb_ndp, 0, dgram_idx_len);
@@ -1136,6 +1155,21 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		dev_kfree_skb_any(skb);
 		skb = NULL;
 
+		/*
+		 * Nothing to aggregate behind if the IN pipe is idle, so
+		 * send the NTB now; otherwise keep filling it while the
+		 * queued ones drain and let the timer flush a partial NTB.
+		 */
+		if (!skb2 && !gether_tx_in_flight(port)) {
+			skb2 = package_for_tx(ncm);
+			if (!skb2)
+				goto err;
+		} else {
+			hrtimer_start(&ncm->task_timer,
+				      ktime_set(0, TX_TIMEOUT_NSECS),
+				      HRTIMER_MODE_REL);
+		}
+
 	} else if (ncm->skb_tx_data && ncm->timer_force_tx) {
 		/* If the tx was requested because of a timeout then send */
 		skb2 = package_for_tx(ncm);
@@ -1150,10 +1184,15 @@ err:
 
 	if (skb)
 		dev_kfree_skb_any(skb);
-	if (ncm->skb_tx_data)
+	if (ncm->skb_tx_data) {
 		dev_kfree_skb_any(ncm->skb_tx_data);
-	if (ncm->skb_tx_ndp)
+		ncm->skb_tx_data = NULL;
+	}
+	if (ncm->skb_tx_ndp) {
 		dev_kfree_skb_any(ncm->skb_tx_ndp);
+		ncm->skb_tx_ndp = NULL;
+	}
+	ncm->ndp_dgram_count = 0;
 
 	return NULL;
 }
@@ -1195,6 +1234,38 @@ static enum hrtimer_restart ncm_tx_timeout(struct hrtimer *data)
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * Small datagrams are copied into a new skb, which keeps the truesize
+ * right.  Bigger ones copy only the headers and take a reference on the
+ * page holding the NTB for the payload, accounting just the payload.
+ */
+static struct sk_buff *ncm_rx_dgram(struct f_ncm *ncm, struct sk_buff *skb,
+				    unsigned int index, unsigned int len)
+{
+	struct sk_buff	*skb2;
+	struct page	*page;
+	unsigned int	offset;
+	unsigned int	copy = len;
+
+	if (len > RX_COPYBREAK && skb->head_frag)
+		copy = RX_HDR_LEN;
+
+	skb2 = netdev_alloc_skb_ip_align(ncm->netdev, copy);
+	if (skb2 == NULL)
+		return NULL;
+	memcpy(skb_put(skb2, copy), skb->data + index, copy);
+
+	if (copy < len) {
+		page = virt_to_head_page(skb->head);
+		offset = skb->data + index + copy -
+			 (unsigned char *)page_address(page);
+		get_page(page);
+		skb_add_rx_frag(skb2, 0, page, offset, len - copy, len - copy);
+	}
+
+	return skb2;
+}
+
 static int ncm_unwrap_ntb(struct gether *port,
 			  struct sk_buff *skb,
 			  struct sk_buff_head *list)
@@ -1207,7 +1278,7 @@ static int ncm_unwrap_ntb(struct gether *port,
 	unsigned	ndp_len;
 	struct sk_buff	*skb2;
 	int		ret = -EINVAL;
-	unsigned	max_size = le32_to_cpu(ntb_parameters.dwNtbOutMaxSize);
+	unsigned	max_size = le32_to_cpu(ncm->ntb_params.dwNtbOutMaxSize);
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
 	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
 	int		dgram_counter;
@@ -1288,6 +1359,11 @@ static int ncm_unwrap_ntb(struct gether *port,
 				     "Bad dgram length: %#X\n", dg_len);
 				goto err;
 			}
+			if (index > skb->len || dg_len > skb->len - index) {
+				INFO(port->func.config->cdev,
+				     "Bad dgram index: %#X\n", index);
+				goto err;
+			}
 			if (ncm->is_crc) {
 				uint32_t crc, crc2;
 
@@ -1307,16 +1383,9 @@ static int ncm_unwrap_ntb(struct gether *port,
 			index2 = get_ncm(&tmp, opts->dgram_item_len);
 			dg_len2 = get_ncm(&tmp, opts->dgram_item_len);
 
-			/*
-			 * Copy the data into a new skb.
-			 * This ensures the truesize is correct
-			 */
-			skb2 = netdev_alloc_skb_ip_align(ncm->netdev,
-							 dg_len - crc_len);
+			skb2 = ncm_rx_dgram(ncm, skb, index, dg_len - crc_len);
 			if (skb2 == NULL)
 				goto err;
-			memcpy(skb_put(skb2, dg_len - crc_len),
-			       skb->data + index, dg_len - crc_len);
 
 			skb_queue_tail(list, skb2);
 
@@ -1567,11 +1636,62 @@ USB_ETHERNET_CONFIGFS_ITEM_ATTR_QMULT(ncm);
 /* f_ncm_opts_ifname */
 USB_ETHERNET_CONFIGFS_ITEM_ATTR_IFNAME(ncm);
 
+#define F_NCM_OPT(name, prec, min, max)					\
+static ssize_t ncm_opts_##name##_show(struct config_item *item, char *page)\
+{									\
+	struct f_ncm_opts *opts = to_f_ncm_opts(item);			\
+	int result;							\
+									\
+	mutex_lock(&opts->lock);					\
+	result = sprintf(page, "%u\n", opts->name);			\
+	mutex_unlock(&opts->lock);					\
+									\
+	return result;							\
+}									\
+									\
+static ssize_t ncm_opts_##name##_store(struct config_item *item,	\
+				       const char *page, size_t len)	\
+{									\
+	struct f_ncm_opts *opts = to_f_ncm_opts(item);			\
+	int ret;							\
+	u##prec num;							\
+									\
+	mutex_lock(&opts->lock);					\
+	if (opts->refcnt) {						\
+		ret = -EBUSY;						\
+		goto end;						\
+	}								\
+									\
+	ret = kstrtou##prec(page, 0, &num);				\
+	if (ret)							\
+		goto end;						\
+									\
+	if (num < min || num > max) {					\
+		ret = -EINVAL;						\
+		goto end;						\
+	}								\
+	opts->name = num;						\
+	ret = len;							\
+									\
+end:									\
+	mutex_unlock(&opts->lock);					\
+	return ret;							\
+}									\
+									\
+CONFIGFS_ATTR(ncm_opts_, name)
+
+F_NCM_OPT(ntb_in_max_size, 32, USB_CDC_NCM_NTB_MIN_IN_SIZE, NTB_MAX_SIZE);
+F_NCM_OPT(ntb_out_max_size, 32, USB_CDC_NCM_NTB_MIN_OUT_SIZE, NTB_MAX_SIZE);
+F_NCM_OPT(tx_max_datagrams, 16, 1, TX_MAX_NUM_DPE_LIMIT);
+
 static struct configfs_attribute *ncm_attrs[] = {
 	&ncm_opts_attr_dev_addr,
 	&ncm_opts_attr_host_addr,
 	&ncm_opts_attr_qmult,
 	&ncm_opts_attr_ifname,
+	&ncm_opts_attr_ntb_in_max_size,
+	&ncm_opts_attr_ntb_out_max_size,
+	&ncm_opts_attr_tx_max_datagrams,
 	NULL,
 };
 
@@ -1602,6 +1722,9 @@ static struct usb_function_instance *ncm_alloc_inst(void)
 		return ERR_PTR(-ENOMEM);
 	mutex_init(&opts->lock);
 	opts->func_inst.free_func_inst = ncm_free_inst;
+	opts->ntb_in_max_size = NTB_DEFAULT_IN_SIZE;
+	opts->ntb_out_max_size = NTB_OUT_SIZE;
+	opts->tx_max_datagrams = TX_MAX_NUM_DPE;
 	opts->net = gether_setup_default();
 	if (IS_ERR(opts->net)) {
 		struct net_device *net = opts->net;
@@ -1669,6 +1792,10 @@ static struct usb_function *ncm_alloc(struct usb_function_instance *fi)
 	ncm_string_defs[STRING_MAC_IDX].s = ncm->ethaddr;
 
 	spin_lock_init(&ncm->lock);
+	ncm->ntb_params = ntb_parameters;
+	ncm->ntb_params.dwNtbInMaxSize = cpu_to_le32(opts->ntb_in_max_size);
+	ncm->ntb_params.dwNtbOutMaxSize = cpu_to_le32(opts->ntb_out_max_size);
+	ncm->tx_max_dgrams = opts->tx_max_datagrams;
 	ncm_reset_values(ncm);
 	ncm->port.ioport = netdev_priv(opts->net);
 	mutex_unlock(&opts->lock);
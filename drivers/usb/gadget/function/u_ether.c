@@ -184,6 +184,34 @@ static void defer_kevent(struct eth_dev *dev, int flag)
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req);
 
+/*
+ * Multi frame protocols get their RX buffer from the page allocator, so
+ * the unwrap code can hand out fragments of it instead of copying each
+ * datagram; the head is released with the last fragment reference.
+ */
+static struct sk_buff *rx_alloc_skb(struct eth_dev *dev, size_t size,
+				    gfp_t gfp_flags)
+{
+	struct sk_buff	*skb;
+	struct page	*page;
+	unsigned int	order;
+
+	if (!dev->port_usb || !dev->port_usb->supports_multi_frame)
+		return alloc_skb(size, gfp_flags);
+
+	size = SKB_DATA_ALIGN(size) +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	order = get_order(size);
+	page = alloc_pages(gfp_flags | __GFP_COMP | __GFP_NOWARN, order);
+	if (!page)
+		return NULL;
+
+	skb = build_skb(page_address(page), PAGE_SIZE << order);
+	if (!skb)
+		__free_pages(page, order);
+	return skb;
+}
+
 static int
 rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 {
@@ -224,7 +252,7 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	if (dev->port_usb->is_fixed)
 		size = max_t(size_t, size, dev->port_usb->fixed_out_len);
 
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+	skb = rx_alloc_skb(dev, size + NET_IP_ALIGN, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -987,6 +1015,12 @@ unsigned gether_get_qmult(struct net_device *net)
 }
 EXPORT_SYMBOL_GPL(gether_get_qmult);
 
+int gether_tx_in_flight(struct gether *link)
+{
+	return atomic_read(&link->ioport->tx_qlen);
+}
+EXPORT_SYMBOL_GPL(gether_tx_in_flight);
+
 int gether_get_ifname(struct net_device *net, char *name, int len)
 {
 	rtnl_lock();
@@ -238,6 +238,15 @@ void gether_set_qmult(struct net_device *net, unsigned qmult);
  */
 unsigned gether_get_qmult(struct net_device *net);
 
+/**
+ * gether_tx_in_flight - count IN transfers queued to the controller
+ * @link: the USB link, set up with gether_connect()
+ *
+ * Multi frame functions use this from their wrap() hook to decide
+ * between sending a partial transfer now and aggregating more frames.
+ */
+int gether_tx_in_flight(struct gether *link);
+
 /**
  * gether_get_ifname - get an ethernet-over-usb link interface name
  * @net: device representing this link
@@ -274,6 +274,8 @@ struct ffs_data {
 
 	struct eventfd_ctx *ffs_eventfd;
 	bool no_disconnect;
+	/* pin user buffers and queue them as sg lists, "zerocopy=1" */
+	bool zerocopy;
 	struct work_struct reset_work;
 
 	/*
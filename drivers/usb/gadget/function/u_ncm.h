@@ -23,6 +23,10 @@ struct f_ncm_opts {
 	struct net_device		*net;
 	bool				bound;
 
+	u32				ntb_in_max_size;
+	u32				ntb_out_max_size;
+	u16				tx_max_datagrams;
+
 	/*
 	 * Read/write access to configfs attributes is handled by configfs.
 	 *
@@ -0,0 +1,82 @@
+/*
+ * EPDC v2 framebuffer driver tracepoints
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation
+ */
+
+#if !defined(__MXC_EPDC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __MXC_EPDC_TRACE_H
+
+#include <linux/mxcfb.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mxc_epdc
+
+DECLARE_EVENT_CLASS(epdc_update,
+	TP_PROTO(u32 order, int lut, struct mxcfb_update_data *upd),
+	TP_ARGS(order, lut, upd),
+	TP_STRUCT__entry(
+		__field(u32, order)
+		__field(int, lut)
+		__field(u32, left)
+		__field(u32, top)
+		__field(u32, width)
+		__field(u32, height)
+		__field(u32, waveform)
+		__field(u32, mode)
+		__field(unsigned int, flags)
+	),
+	TP_fast_assign(
+		__entry->order = order;
+		__entry->lut = lut;
+		__entry->left = upd->update_region.left;
+		__entry->top = upd->update_region.top;
+		__entry->width = upd->update_region.width;
+		__entry->height = upd->update_region.height;
+		__entry->waveform = upd->waveform_mode;
+		__entry->mode = upd->update_mode;
+		__entry->flags = upd->flags;
+	),
+	TP_printk("order=%u lut=%d region=%ux%u+%u+%u waveform=%u mode=%u flags=0x%x",
+		  __entry->order, __entry->lut, __entry->width,
+		  __entry->height, __entry->left, __entry->top,
+		  __entry->waveform, __entry->mode, __entry->flags)
+);
+
+DEFINE_EVENT(epdc_update, epdc_update_queue,
+	TP_PROTO(u32 order, int lut, struct mxcfb_update_data *upd),
+	TP_ARGS(order, lut, upd)
+);
+
+DEFINE_EVENT(epdc_update, epdc_update_submit,
+	TP_PROTO(u32 order, int lut, struct mxcfb_update_data *upd),
+	TP_ARGS(order, lut, upd)
+);
+
+/* order is that of the latest update merged into the LUT */
+TRACE_EVENT(epdc_update_done,
+	TP_PROTO(u32 order, int lut),
+	TP_ARGS(order, lut),
+	TP_STRUCT__entry(
+		__field(u32, order)
+		__field(int, lut)
+	),
+	TP_fast_assign(
+		__entry->order = order;
+		__entry->lut = lut;
+	),
+	TP_printk("order=%u lut=%d", __entry->order, __entry->lut)
+);
+
+#endif /* __MXC_EPDC_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mxc_epdc_trace
+#include <trace/define_trace.h>
@@ -35,6 +35,7 @@
 #include <linux/fb.h>
 #include <linux/init.h>
 #include <linux/list.h>
+#include <linux/interval_tree.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
@@ -63,6 +64,9 @@
 
 #include "epdc_v2_regs.h"
 
+#define CREATE_TRACE_POINTS
+#include "mxc_epdc_trace.h"
+
 #define EPDC_STANDARD_MODE
 
 #define USE_PS_AS_OUTPUT
@@ -121,6 +125,7 @@ struct update_desc_list {
 	u32 epdc_stride;	/* Depends on rotation & whether we skip PxP */
 	struct list_head upd_marker_list; /* List of markers for this update */
 	u32 update_order;	/* Numeric ordering value for update */
+	struct interval_tree_node upd_node; /* Rows covered while pending */
 };
 
 /* This structure represents a list node containing both
@@ -178,6 +183,8 @@ struct mxc_epdc_fb_data {
 	u32 auto_mode;
 	u32 upd_scheme;
 	struct list_head upd_pending_list;
+	struct rb_root upd_pending_tree; /* pending updates by row span */
+	int upd_pending_flagged;	/* pending updates with any flag set */
 	struct list_head upd_buf_queue;
 	struct list_head upd_buf_free_list;
 	struct list_head upd_buf_collision_list;
@@ -2665,6 +2672,100 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	return 0;
 }
 
+static void epdc_pending_add(struct mxc_epdc_fb_data *fb_data,
+			     struct update_desc_list *upd_desc)
+{
+	struct mxcfb_rect *rect = &upd_desc->upd_data.update_region;
+
+	list_add_tail(&upd_desc->list, &fb_data->upd_pending_list);
+
+	/* Rows are inclusive on both ends, as in epdc_submit_merge() */
+	upd_desc->upd_node.start = rect->top;
+	upd_desc->upd_node.last = rect->top + rect->height;
+	interval_tree_insert(&upd_desc->upd_node, &fb_data->upd_pending_tree);
+
+	if (upd_desc->upd_data.flags)
+		fb_data->upd_pending_flagged++;
+}
+
+static void epdc_pending_del(struct mxc_epdc_fb_data *fb_data,
+			     struct update_desc_list *upd_desc)
+{
+	list_del_init(&upd_desc->list);
+	interval_tree_remove(&upd_desc->upd_node, &fb_data->upd_pending_tree);
+
+	if (upd_desc->upd_data.flags)
+		fb_data->upd_pending_flagged--;
+}
+
+/*
+ * Find the oldest pending update queued after 'after' that touches
+ * 'rect'. This is the next update the in-order merge walk would merge.
+ */
+static struct update_desc_list *
+epdc_pending_next_overlap(struct mxc_epdc_fb_data *fb_data,
+			  struct mxcfb_rect *rect, u32 after)
+{
+	struct update_desc_list *upd_desc, *next = NULL;
+	struct interval_tree_node *node;
+	struct mxcfb_rect *brect;
+	unsigned long last = rect->top + rect->height;
+
+	for (node = interval_tree_iter_first(&fb_data->upd_pending_tree,
+					     rect->top, last);
+	     node; node = interval_tree_iter_next(node, rect->top, last)) {
+		upd_desc = container_of(node, struct update_desc_list,
+					upd_node);
+		brect = &upd_desc->upd_data.update_region;
+
+		if (upd_desc->update_order <= after ||
+			rect->left > (brect->left + brect->width) ||
+			brect->left > (rect->left + rect->width))
+			continue;
+
+		if (!next || upd_desc->update_order < next->update_order)
+			next = upd_desc;
+	}
+
+	return next;
+}
+
+static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
+				struct update_desc_list *update_to_merge,
+				struct mxc_epdc_fb_data *fb_data);
+
+/*
+ * Merge pending updates into the selected one using the region tree.
+ * Updates without flags never block each other, so when neither the
+ * selected update nor any pending one has flags set, only those that
+ * touch the (growing) update region matter. They are visited in queue
+ * order, which gives the same result as the full walk of the pending
+ * list. Returns false if the full walk is needed.
+ */
+static bool epdc_merge_pending_tree(struct mxc_epdc_fb_data *fb_data,
+				    struct update_data_list *upd_data_list)
+{
+	struct update_desc_list *upd_desc = upd_data_list->update_desc;
+	struct update_desc_list *next_desc;
+	u32 after = upd_desc->update_order;
+
+	if (fb_data->upd_pending_flagged || upd_desc->upd_data.flags)
+		return false;
+
+	while ((next_desc = epdc_pending_next_overlap(fb_data,
+				&upd_desc->upd_data.update_region, after))) {
+		after = next_desc->update_order;
+		if (epdc_submit_merge(upd_desc, next_desc, fb_data) != MERGE_OK)
+			continue;
+
+		dev_dbg(fb_data->dev, "Update merged [tree]\n");
+		epdc_pending_del(fb_data, next_desc);
+		kfree(next_desc);
+	}
+
+	return true;
+}
+
 static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 				struct update_desc_list *update_to_merge,
 				struct mxc_epdc_fb_data *fb_data)
@@ -2679,9 +2780,12 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 	arect = &upd_desc_list->upd_data.update_region;
 	brect = &update_to_merge->upd_data.update_region;
 
-	/* Do not merge a dry-run collision test update */
-	if ((a->flags & EPDC_FLAG_TEST_COLLISION) ||
-		(b->flags & EPDC_FLAG_TEST_COLLISION))
+	/*
+	 * Do not merge a dry-run collision test update, nor a pen update
+	 * that must reach the panel as soon as possible
+	 */
+	if ((a->flags & (EPDC_FLAG_TEST_COLLISION | EPDC_FLAG_PEN_UPDATE)) ||
+		(b->flags & (EPDC_FLAG_TEST_COLLISION | EPDC_FLAG_PEN_UPDATE)))
 		return MERGE_BLOCK;
 
 	/*
@@ -2702,12 +2806,6 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 		use_flags = true;
 	}
 
-	if (a->update_mode != b->update_mode)
-		a->update_mode = UPDATE_MODE_FULL;
-
-	if (a->waveform_mode != b->waveform_mode)
-		a->waveform_mode = WAVEFORM_MODE_AUTO;
-
 	if (arect->left > (brect->left + brect->width) ||
 		brect->left > (arect->left + arect->width) ||
 		arect->top > (brect->top + brect->height) ||
@@ -2738,6 +2836,12 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 			return MERGE_FAIL;
 	}
 
+	if (a->update_mode != b->update_mode)
+		a->update_mode = UPDATE_MODE_FULL;
+
+	if (a->waveform_mode != b->waveform_mode)
+		a->waveform_mode = WAVEFORM_MODE_AUTO;
+
 	*arect = combine;
 
 	/* Use flags of the later update */
@@ -2858,6 +2962,11 @@ static void epdc_submit_work_func(struct work_struct *work)
 			return;
 		}
 
+		/* A collision update may take the fast merge path too */
+		if (upd_data_list && epdc_merge_pending_tree(fb_data,
+							     upd_data_list))
+			goto merge_done;
+
 		list_for_each_entry_safe(next_desc, temp_desc,
 				&fb_data->upd_pending_list, list) {
 
@@ -2871,17 +2980,20 @@ static void epdc_submit_work_func(struct work_struct *work)
 						struct update_data_list, list);
 				list_del_init(&upd_data_list->list);
 				upd_data_list->update_desc = next_desc;
-				list_del_init(&next_desc->list);
+				epdc_pending_del(fb_data, next_desc);
 				if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE)
 					/* If not merging, we have an update */
 					break;
+				if (epdc_merge_pending_tree(fb_data,
+							    upd_data_list))
+					break;
 			} else {
 				switch (epdc_submit_merge(upd_data_list->update_desc,
 						next_desc, fb_data)) {
 				case MERGE_OK:
 					dev_dbg(fb_data->dev,
 						"Update merged [queue]\n");
-					list_del_init(&next_desc->list);
+					epdc_pending_del(fb_data, next_desc);
 					kfree(next_desc);
 					break;
 				case MERGE_FAIL:
@@ -2901,6 +3013,7 @@ static void epdc_submit_work_func(struct work_struct *work)
 		}
 	}
 
+merge_done:
 	/* Is update list empty? */
 	if (!upd_data_list) {
 		mutex_unlock(&fb_data->queue_mutex);
@@ -3167,6 +3280,9 @@ static void epdc_submit_work_func(struct work_struct *work)
 		fb_data->wv_modes_update = false;
 	}
 
+	trace_epdc_update_submit(upd_data_list->update_desc->update_order,
+				 upd_data_list->lut_num,
+				 &upd_data_list->update_desc->upd_data);
 	epdc_submit_update(upd_data_list->lut_num,
 			   upd_data_list->update_desc->upd_data.waveform_mode,
 			   upd_data_list->update_desc->upd_data.update_mode,
@@ -3226,6 +3342,16 @@ static int mxc_epdc_fb_send_single_update(struct mxcfb_update_data *upd_data,
 			"Aborting update.\n");
 		return -EINVAL;
 	}
+	/* Pen updates skip waveform selection and always use DU */
+	if (upd_data->flags & EPDC_FLAG_PEN_UPDATE) {
+		if (upd_data->flags & EPDC_FLAG_TEST_COLLISION) {
+			dev_err(fb_data->dev,
+				"Pen update can't be a collision test.\n");
+			return -EINVAL;
+		}
+		upd_data->waveform_mode = fb_data->wv_modes.mode_du;
+		upd_data->update_mode = UPDATE_MODE_PARTIAL;
+	}
 	if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
 		if ((upd_data->update_region.width !=
 			upd_data->alt_buffer_data.alt_update_region.width) ||
@@ -3320,7 +3446,9 @@ static int mxc_epdc_fb_send_single_update(struct mxcfb_update_data *upd_data,
 	INIT_LIST_HEAD(&upd_desc->upd_marker_list);
 	upd_desc->upd_data = *upd_data;
 	upd_desc->update_order = fb_data->order_cnt++;
-	list_add_tail(&upd_desc->list, &fb_data->upd_pending_list);
+	epdc_pending_add(fb_data, upd_desc);
+	trace_epdc_update_queue(upd_desc->update_order, INVALID_LUT,
+				&upd_desc->upd_data);
 
 	/* If marker specified, associate it with a completion */
 	if (upd_data->update_marker != 0) {
@@ -3361,7 +3489,7 @@ static int mxc_epdc_fb_send_single_update(struct mxcfb_update_data *upd_data,
 
 	/* Set descriptor for current update, delete from pending list */
 	upd_data_list->update_desc = upd_desc;
-	list_del_init(&upd_desc->list);
+	epdc_pending_del(fb_data, upd_desc);
 
 	mutex_unlock(&fb_data->queue_mutex);
 
@@ -3478,6 +3606,8 @@ static int mxc_epdc_fb_send_single_update(struct mxcfb_update_data *upd_data,
 		fb_data->wv_modes_update = false;
 	}
 
+	trace_epdc_update_submit(upd_desc->update_order,
+				 upd_data_list->lut_num, &upd_desc->upd_data);
 	epdc_submit_update(upd_data_list->lut_num,
 			   upd_desc->upd_data.waveform_mode,
 			   upd_desc->upd_data.update_mode,
@@ -4141,6 +4271,7 @@ static void epdc_intr_work_func(struct work_struct *work)
 		if (i != 0)
 			fb_data->luts_complete |= 1ULL << i;
 
+		trace_epdc_update_done(fb_data->lut_update_order[i], i);
 		fb_data->lut_update_order[i] = 0;
 
 		/* Signal completion if submit workqueue needs a LUT */
@@ -5259,6 +5390,7 @@ static int mxc_epdc_fb_probe(struct platform_device *pdev)
 	 * and freely available updates.
 	 */
 	INIT_LIST_HEAD(&fb_data->upd_pending_list);
+	fb_data->upd_pending_tree = RB_ROOT;
 	INIT_LIST_HEAD(&fb_data->upd_buf_queue);
 	INIT_LIST_HEAD(&fb_data->upd_buf_free_list);
 	INIT_LIST_HEAD(&fb_data->upd_buf_collision_list);
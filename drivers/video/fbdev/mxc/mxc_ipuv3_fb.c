@@ -32,6 +32,8 @@
 #include <linux/dma-mapping.h>
 #include <linux/errno.h>
 #include <linux/fb.h>
+#include <linux/fence.h>
+#include <linux/file.h>
 #include <linux/fsl_devices.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
@@ -49,6 +51,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/sync_file.h>
 #include <linux/time.h>
 #include <linux/uaccess.h>
 
@@ -61,6 +64,22 @@
 
 /* Display port number */
 #define MXCFB_PORT_NUM	2
+
+/*
+ * Non-blocking pans not yet on screen. Together with the buffer being
+ * scanned out this gives triple buffering.
+ */
+#define MXCFB_PAN_QUEUE_LEN	2
+
+struct mxcfb_pan_req {
+	unsigned long base;
+	unsigned int fr_xoff;
+	unsigned int fr_yoff;
+	unsigned int fr_w;
+	unsigned int fr_h;
+	struct fence *fence;	/* signalled once no longer scanned out */
+};
+
 /*!
  * Structure containing the MXC specific framebuffer information.
  */
@@ -119,6 +138,20 @@ struct mxcfb_info {
 	bool cur_prefetch;
 	spinlock_t spin_lock;	/* for PRE small yres cases */
 	struct ipu_pre_context *pre_config;
+
+	/* MXCFB_PAN_DISPLAY_ASYNC queue, protected by pan_lock */
+	spinlock_t pan_lock;
+	spinlock_t pan_fence_lock;
+	wait_queue_head_t pan_wq;
+	struct mxcfb_pan_req pan_q[MXCFB_PAN_QUEUE_LEN];
+	unsigned int pan_head;
+	unsigned int pan_count;
+	bool pan_busy;		/* pan_q[pan_head] is programmed */
+	struct fence *pan_shown;
+	u64 pan_context;
+	unsigned int pan_seqno;
+	ktime_t pan_last;
+	struct mxcfb_pan_stats pan_stats;
 };
 
 struct mxcfb_pfmt {
@@ -421,6 +454,8 @@ static int mxcfb_map_video_memory(struct fb_info *fbi);
 static int mxcfb_unmap_video_memory(struct fb_info *fbi);
 static int mxcfb_ioctl(struct fb_info *fbi, unsigned int cmd,
 			unsigned long arg);
+static int mxcfb_pan_display_async(struct fb_info *info, void __user *argp);
+static void mxcfb_pan_flush(struct mxcfb_info *mxc_fbi);
 
 /*
  * Set fixed framebuffer parameters based on variable settings.
@@ -533,6 +568,7 @@ static int _setup_disp_channel2(struct fb_info *fbi)
 			bytes_per_pixel(fbi_to_pixfmt(fbi, true));
 	}
 
+	mxcfb_pan_flush(mxc_fbi);
 	if (!mxc_fbi->on_the_fly)
 		mxc_fbi->cur_ipu_buf = 2;
 	init_completion(&mxc_fbi->flip_complete);
@@ -2078,6 +2114,23 @@ static int mxcfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 				return -EFAULT;
 			break;
 		}
+	case MXCFB_PAN_DISPLAY_ASYNC:
+		retval = mxcfb_pan_display_async(fbi, argp);
+		break;
+	case MXCFB_GET_PAN_STATS:
+		{
+			struct mxcfb_pan_stats stats;
+			unsigned long lock_flags;
+
+			spin_lock_irqsave(&mxc_fbi->pan_lock, lock_flags);
+			stats = mxc_fbi->pan_stats;
+			stats.queued = mxc_fbi->pan_count;
+			spin_unlock_irqrestore(&mxc_fbi->pan_lock, lock_flags);
+
+			if (copy_to_user(argp, &stats, sizeof(stats)))
+				retval = -EFAULT;
+			break;
+		}
 	case MXCFB_WAIT_FOR_VSYNC:
 		{
 			if (mxc_fbi->ipu_ch == MEM_FG_SYNC) {
@@ -2332,6 +2385,7 @@ static int mxcfb_blank(int blank, struct fb_info *info)
 		if (mxc_fbi->dispdrv && mxc_fbi->dispdrv->drv->disable)
 			mxc_fbi->dispdrv->drv->disable(mxc_fbi->dispdrv, info);
 		ipu_disable_channel(mxc_fbi->ipu, mxc_fbi->ipu_ch, true);
+		mxcfb_pan_flush(mxc_fbi);
 		if (mxc_fbi->ipu_di >= 0)
 			ipu_uninit_sync_panel(mxc_fbi->ipu, mxc_fbi->ipu_di);
 		ipu_uninit_channel(mxc_fbi->ipu, mxc_fbi->ipu_ch);
@@ -2346,6 +2400,66 @@ static int mxcfb_blank(int blank, struct fb_info *info)
 	return ret;
 }
 
+/*
+ * Work out the scan-out address and frame of a pan to var's offsets.
+ */
+static unsigned long mxcfb_pan_base(struct fb_var_screeninfo *var,
+				    struct fb_info *info,
+				    unsigned int *fr_xoff,
+				    unsigned int *fr_yoff,
+				    unsigned int *fr_w, unsigned int *fr_h)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)info->par;
+	unsigned long base;
+	int fb_stride;
+
+	switch (fbi_to_pixfmt(info, true)) {
+	case IPU_PIX_FMT_YUV420P2:
+	case IPU_PIX_FMT_YVU420P:
+	case IPU_PIX_FMT_NV12:
+	case PRE_PIX_FMT_NV21:
+	case IPU_PIX_FMT_NV16:
+	case PRE_PIX_FMT_NV61:
+	case IPU_PIX_FMT_YUV422P:
+	case IPU_PIX_FMT_YVU422P:
+	case IPU_PIX_FMT_YUV420P:
+	case IPU_PIX_FMT_YUV444P:
+		fb_stride = info->var.xres_virtual;
+		break;
+	default:
+		fb_stride = info->fix.line_length;
+	}
+
+	base = info->fix.smem_start;
+	*fr_xoff = var->xoffset;
+	*fr_w = info->var.xres_virtual;
+	if (!(var->vmode & FB_VMODE_YWRAP)) {
+		dev_dbg(info->device, "Y wrap disabled\n");
+		*fr_yoff = var->yoffset % info->var.yres;
+		*fr_h = info->var.yres;
+		base += info->fix.line_length * info->var.yres *
+			(var->yoffset / info->var.yres);
+		if (ipu_pixel_format_is_split_gpu_tile(var->nonstd))
+			base += (mxc_fbi->gpu_sec_buf_off -
+				 info->fix.line_length * info->var.yres / 2) *
+				(var->yoffset / info->var.yres);
+	} else {
+		dev_dbg(info->device, "Y wrap enabled\n");
+		*fr_yoff = var->yoffset;
+		*fr_h = info->var.yres_virtual;
+	}
+	if (!mxc_fbi->resolve) {
+		base += *fr_yoff * fb_stride + *fr_xoff *
+			bytes_per_pixel(fbi_to_pixfmt(info, true));
+
+		if (mxc_fbi->cur_prefetch && (info->var.vmode & FB_VMODE_INTERLACED))
+			base += info->var.rotate ?
+				*fr_w * bytes_per_pixel(fbi_to_pixfmt(info, true)) : 0;
+	}
+
+	return base;
+}
+
 /*
  * Pan or Wrap the Display
  *
@@ -2363,7 +2477,6 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 	unsigned int fr_xoff, fr_yoff, fr_w, fr_h;
 	unsigned long base, ipu_base = 0, active_alpha_phy_addr = 0;
 	bool loc_alpha_en = false;
-	int fb_stride;
 	int bw = 0, bh = 0;
 	int i;
 	int ret;
@@ -2384,6 +2497,12 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 	if (mxc_fbi->cur_blank != FB_BLANK_UNBLANK)
 		return -EINVAL;
 
+	/* Let queued non-blocking pans reach the screen first */
+	if (!wait_event_timeout(mxc_fbi->pan_wq, !mxc_fbi->pan_count, HZ/2)) {
+		dev_err(info->device, "timeout when waiting for queued pans\n");
+		return -ETIMEDOUT;
+	}
+
 	if (mxc_fbi->resolve) {
 		fmt_to_tile_block(info->var.nonstd, &bw, &bh);
 
@@ -2400,49 +2519,7 @@ mxcfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
 	if (y_bottom > info->var.yres_virtual)
 		return -EINVAL;
 
-	switch (fbi_to_pixfmt(info, true)) {
-	case IPU_PIX_FMT_YUV420P2:
-	case IPU_PIX_FMT_YVU420P:
-	case IPU_PIX_FMT_NV12:
-	case PRE_PIX_FMT_NV21:
-	case IPU_PIX_FMT_NV16:
-	case PRE_PIX_FMT_NV61:
-	case IPU_PIX_FMT_YUV422P:
-	case IPU_PIX_FMT_YVU422P:
-	case IPU_PIX_FMT_YUV420P:
-	case IPU_PIX_FMT_YUV444P:
-		fb_stride = info->var.xres_virtual;
-		break;
-	default:
-		fb_stride = info->fix.line_length;
-	}
-
-	base = info->fix.smem_start;
-	fr_xoff = var->xoffset;
-	fr_w = info->var.xres_virtual;
-	if (!(var->vmode & FB_VMODE_YWRAP)) {
-		dev_dbg(info->device, "Y wrap disabled\n");
-		fr_yoff = var->yoffset % info->var.yres;
-		fr_h = info->var.yres;
-		base += info->fix.line_length * info->var.yres *
-			(var->yoffset / info->var.yres);
-		if (ipu_pixel_format_is_split_gpu_tile(var->nonstd))
-			base += (mxc_fbi->gpu_sec_buf_off -
-				 info->fix.line_length * info->var.yres / 2) *
-				(var->yoffset / info->var.yres);
-	} else {
-		dev_dbg(info->device, "Y wrap enabled\n");
-		fr_yoff = var->yoffset;
-		fr_h = info->var.yres_virtual;
-	}
-	if (!mxc_fbi->resolve) {
-		base += fr_yoff * fb_stride + fr_xoff *
-			bytes_per_pixel(fbi_to_pixfmt(info, true));
-
-		if (mxc_fbi->cur_prefetch && (info->var.vmode & FB_VMODE_INTERLACED))
-			base += info->var.rotate ?
-				fr_w * bytes_per_pixel(fbi_to_pixfmt(info, true)) : 0;
-	}
+	base = mxcfb_pan_base(var, info, &fr_xoff, &fr_yoff, &fr_w, &fr_h);
 
 	if (mxc_fbi->cur_prefetch) {
 		unsigned long lock_flags = 0;
@@ -2616,6 +2693,276 @@ next:
 	return 0;
 }
 
+static const char *mxcfb_fence_get_driver_name(struct fence *fence)
+{
+	return MXCFB_NAME;
+}
+
+static const char *mxcfb_fence_get_timeline_name(struct fence *fence)
+{
+	return "pan";
+}
+
+static bool mxcfb_fence_enable_signaling(struct fence *fence)
+{
+	return true;
+}
+
+static const struct fence_ops mxcfb_fence_ops = {
+	.get_driver_name = mxcfb_fence_get_driver_name,
+	.get_timeline_name = mxcfb_fence_get_timeline_name,
+	.enable_signaling = mxcfb_fence_enable_signaling,
+	.wait = fence_default_wait,
+};
+
+static void mxcfb_pan_init(struct mxcfb_info *mxc_fbi)
+{
+	spin_lock_init(&mxc_fbi->pan_lock);
+	spin_lock_init(&mxc_fbi->pan_fence_lock);
+	init_waitqueue_head(&mxc_fbi->pan_wq);
+	mxc_fbi->pan_context = fence_context_alloc(1);
+}
+
+static void mxcfb_pan_release(struct fence **fence, int status)
+{
+	if (!*fence)
+		return;
+
+	if (status)
+		(*fence)->status = status;
+	fence_signal(*fence);
+	fence_put(*fence);
+	*fence = NULL;
+}
+
+/*
+ * Program the oldest queued pan into the next IPU buffer. It is latched
+ * at the next frame start and the following EOF irq retires it.
+ * Called with pan_lock held.
+ */
+static int mxcfb_pan_program(struct fb_info *info)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)info->par;
+	struct mxcfb_pan_req *req = &mxc_fbi->pan_q[mxc_fbi->pan_head];
+	uint32_t buf = (mxc_fbi->cur_ipu_buf + 1) % 3;
+
+	if (ipu_update_channel_buffer(mxc_fbi->ipu, mxc_fbi->ipu_ch,
+				      IPU_INPUT_BUFFER, buf, req->base)) {
+		dev_err(info->device,
+			"Error updating SDC buf %d to address=0x%08lX\n",
+			buf, req->base);
+		return -EBUSY;
+	}
+	mxc_fbi->cur_ipu_buf = buf;
+
+	ipu_update_channel_offset(mxc_fbi->ipu, mxc_fbi->ipu_ch,
+				  IPU_INPUT_BUFFER,
+				  fbi_to_pixfmt(info, true),
+				  req->fr_w, req->fr_h, req->fr_w,
+				  0, 0, req->fr_yoff, req->fr_xoff);
+	ipu_select_buffer(mxc_fbi->ipu, mxc_fbi->ipu_ch,
+			  IPU_INPUT_BUFFER, mxc_fbi->cur_ipu_buf);
+	mxc_fbi->pan_busy = true;
+
+	ipu_clear_irq(mxc_fbi->ipu, mxc_fbi->ipu_ch_irq);
+	ipu_enable_irq(mxc_fbi->ipu, mxc_fbi->ipu_ch_irq);
+	return 0;
+}
+
+/* Drop the oldest queued pan. Called with pan_lock held. */
+static void mxcfb_pan_pop(struct mxcfb_info *mxc_fbi)
+{
+	mxc_fbi->pan_head = (mxc_fbi->pan_head + 1) % MXCFB_PAN_QUEUE_LEN;
+	mxc_fbi->pan_count--;
+}
+
+/* Program queued pans until one sticks. Called with pan_lock held. */
+static void mxcfb_pan_kick(struct fb_info *info)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)info->par;
+
+	while (mxc_fbi->pan_count && mxcfb_pan_program(info)) {
+		mxcfb_pan_release(&mxc_fbi->pan_q[mxc_fbi->pan_head].fence,
+				  -EBUSY);
+		mxcfb_pan_pop(mxc_fbi);
+	}
+
+	/* No flip in flight any more, let blocking pans go ahead */
+	if (!mxc_fbi->pan_busy && !completion_done(&mxc_fbi->flip_complete))
+		complete(&mxc_fbi->flip_complete);
+	wake_up(&mxc_fbi->pan_wq);
+}
+
+/*
+ * EOF irq after a non-blocking pan was programmed: it is on screen now,
+ * so the buffer it replaced is free.  Called with pan_lock held.
+ */
+static void mxcfb_pan_latched(struct fb_info *info)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)info->par;
+	struct fb_var_screeninfo *var = &info->var;
+	ktime_t now = ktime_get();
+	s64 delta = ktime_to_ns(ktime_sub(now, mxc_fbi->pan_last));
+	u64 frame_ns;
+
+	frame_ns = (u64)(var->xres + var->left_margin + var->right_margin +
+			 var->hsync_len) *
+		   (var->yres + var->upper_margin + var->lower_margin +
+		    var->vsync_len) * var->pixclock;
+	frame_ns = div_u64(frame_ns, 1000);
+	if (frame_ns && ktime_to_ns(mxc_fbi->pan_last) &&
+	    delta < NSEC_PER_SEC) {
+		u64 frames = div64_u64(delta + frame_ns / 2, frame_ns);
+
+		if (frames > 1)
+			mxc_fbi->pan_stats.missed_vblanks += frames - 1;
+	}
+	mxc_fbi->pan_last = now;
+	mxc_fbi->pan_stats.flips++;
+
+	mxcfb_pan_release(&mxc_fbi->pan_shown, 0);
+	mxc_fbi->pan_shown = mxc_fbi->pan_q[mxc_fbi->pan_head].fence;
+	mxc_fbi->pan_q[mxc_fbi->pan_head].fence = NULL;
+	mxcfb_pan_pop(mxc_fbi);
+	mxc_fbi->pan_busy = false;
+
+	mxcfb_pan_kick(info);
+}
+
+/*
+ * Drop all non-blocking pans before the channel is reconfigured or
+ * disabled. Their fences are signalled as nothing scans them out.
+ */
+static void mxcfb_pan_flush(struct mxcfb_info *mxc_fbi)
+{
+	unsigned long lock_flags;
+
+	spin_lock_irqsave(&mxc_fbi->pan_lock, lock_flags);
+	while (mxc_fbi->pan_count) {
+		mxcfb_pan_release(&mxc_fbi->pan_q[mxc_fbi->pan_head].fence,
+				  -ECANCELED);
+		mxcfb_pan_pop(mxc_fbi);
+	}
+	mxcfb_pan_release(&mxc_fbi->pan_shown, 0);
+	mxc_fbi->pan_busy = false;
+	mxc_fbi->pan_last = ktime_set(0, 0);
+	spin_unlock_irqrestore(&mxc_fbi->pan_lock, lock_flags);
+
+	wake_up(&mxc_fbi->pan_wq);
+}
+
+/*
+ * Queue a pan without waiting for it to be displayed. The returned
+ * fence tells when the buffer panned to is no longer scanned out.
+ */
+static int mxcfb_pan_display_async(struct fb_info *info, void __user *argp)
+{
+	struct mxcfb_info *mxc_fbi = (struct mxcfb_info *)info->par;
+	struct fb_var_screeninfo var = info->var;
+	struct mxcfb_pan_async pan;
+	struct mxcfb_pan_req *req;
+	struct sync_file *sync_file;
+	struct fence *fence;
+	unsigned long lock_flags;
+	int fd, ret;
+
+	if (copy_from_user(&pan, argp, sizeof(pan)))
+		return -EFAULT;
+
+	if (mxc_fbi->cur_blank != FB_BLANK_UNBLANK)
+		return -EINVAL;
+
+	/* PRE and local alpha buffers are flipped by the blocking path only */
+	if (mxc_fbi->cur_prefetch || mxc_fbi->alpha_chan_en)
+		return -EINVAL;
+
+	if (pan.xoffset + var.xres > var.xres_virtual)
+		return -EINVAL;
+	if (var.vmode & FB_VMODE_YWRAP) {
+		if (pan.yoffset >= var.yres_virtual)
+			return -EINVAL;
+	} else if (pan.yoffset + var.yres > var.yres_virtual) {
+		return -EINVAL;
+	}
+	var.xoffset = pan.xoffset;
+	var.yoffset = pan.yoffset;
+
+	if (mxc_fbi->pan_count == MXCFB_PAN_QUEUE_LEN) {
+		mxc_fbi->pan_stats.queue_full++;
+		if (!wait_event_timeout(mxc_fbi->pan_wq,
+				mxc_fbi->pan_count < MXCFB_PAN_QUEUE_LEN,
+				HZ/2)) {
+			dev_err(info->device,
+				"timeout when waiting for a pan slot\n");
+			return -ETIMEDOUT;
+		}
+	}
+
+	/* Take over from a blocking pan still waiting to be latched */
+	if (!mxc_fbi->pan_busy && !mxc_fbi->pan_count &&
+	    !wait_for_completion_timeout(&mxc_fbi->flip_complete, HZ/2)) {
+		dev_err(info->device, "timeout when waiting for flip irq\n");
+		return -ETIMEDOUT;
+	}
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence) {
+		ret = -ENOMEM;
+		goto err_complete;
+	}
+	fence_init(fence, &mxcfb_fence_ops, &mxc_fbi->pan_fence_lock,
+		   mxc_fbi->pan_context, ++mxc_fbi->pan_seqno);
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto err_fence;
+	}
+
+	sync_file = sync_file_create(fence);
+	if (!sync_file) {
+		ret = -ENOMEM;
+		goto err_fd;
+	}
+
+	pan.release_fence = fd;
+	if (copy_to_user(argp, &pan, sizeof(pan))) {
+		ret = -EFAULT;
+		goto err_sync_file;
+	}
+
+	spin_lock_irqsave(&mxc_fbi->pan_lock, lock_flags);
+	req = &mxc_fbi->pan_q[(mxc_fbi->pan_head + mxc_fbi->pan_count) %
+			      MXCFB_PAN_QUEUE_LEN];
+	req->base = mxcfb_pan_base(&var, info, &req->fr_xoff, &req->fr_yoff,
+				   &req->fr_w, &req->fr_h);
+	req->fence = fence;
+	mxc_fbi->pan_count++;
+	if (!mxc_fbi->pan_busy)
+		mxcfb_pan_kick(info);
+	spin_unlock_irqrestore(&mxc_fbi->pan_lock, lock_flags);
+
+	fd_install(fd, sync_file->file);
+
+	info->var.xoffset = var.xoffset;
+	info->var.yoffset = var.yoffset;
+	mxc_fbi->cur_var.xoffset = var.xoffset;
+	mxc_fbi->cur_var.yoffset = var.yoffset;
+
+	return 0;
+
+err_sync_file:
+	fput(sync_file->file);
+err_fd:
+	put_unused_fd(fd);
+err_fence:
+	fence_put(fence);
+err_complete:
+	if (!mxc_fbi->pan_busy && !mxc_fbi->pan_count)
+		complete(&mxc_fbi->flip_complete);
+	return ret;
+}
+
 /*
  * Function to handle custom mmap for MXC framebuffer.
  *
@@ -2701,6 +3048,16 @@ static irqreturn_t mxcfb_irq_handler(int irq, void *dev_id)
 		return IRQ_HANDLED;
 	}
 
+	spin_lock(&mxc_fbi->pan_lock);
+	if (mxc_fbi->pan_busy) {
+		mxcfb_pan_latched(fbi);
+		spin_unlock(&mxc_fbi->pan_lock);
+		return IRQ_HANDLED;
+	}
+	/* A blocking pan has replaced the last non-blocking one */
+	mxcfb_pan_release(&mxc_fbi->pan_shown, 0);
+	spin_unlock(&mxc_fbi->pan_lock);
+
 	if (mxc_fbi->cur_prefetch && ipu_pre_yres_is_small(fbi->var.yres)) {
 		spin_lock(&mxc_fbi->spin_lock);
 		ipu_pre_set_fb_buffer(mxc_fbi->pre_num,
@@ -2895,6 +3252,7 @@ static struct fb_info *mxcfb_init_fbinfo(struct device *dev, struct fb_ops *ops)
 	fbi->fbops = ops;
 	fbi->flags = FBINFO_FLAG_DEFAULT;
 	fbi->pseudo_palette = mxcfbi->pseudo_palette;
+	mxcfb_pan_init(mxcfbi);
 
 	/*
 	 * Allocate colormap
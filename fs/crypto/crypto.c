@@ -50,6 +50,8 @@ static DEFINE_MUTEX(fscrypt_init_mutex);
 static struct kmem_cache *fscrypt_ctx_cachep;
 struct kmem_cache *fscrypt_info_cachep;
 
+static int wait_page_encryption(struct fscrypt_ctx *ctx);
+
 /**
  * fscrypt_release_ctx() - Releases an encryption context
  * @ctx: The encryption context to release.
@@ -63,6 +65,9 @@ void fscrypt_release_ctx(struct fscrypt_ctx *ctx)
 {
 	unsigned long flags;
 
+	/* Only error paths can get here before the encryption finished */
+	if (ctx->flags & FS_WRITE_PATH_FL)
+		wait_page_encryption(ctx);
 	if (ctx->flags & FS_WRITE_PATH_FL && ctx->w.bounce_page) {
 		mempool_free(ctx->w.bounce_page, fscrypt_bounce_page_pool);
 		ctx->w.bounce_page = NULL;
@@ -146,60 +151,178 @@ typedef enum {
 	FS_ENCRYPT,
 } fscrypt_direction_t;
 
-static int do_page_crypto(struct inode *inode,
-			fscrypt_direction_t rw, pgoff_t index,
-			struct page *src_page, struct page *dest_page,
-			gfp_t gfp_flags)
-{
+/*
+ * The crypto of one page, which may complete asynchronously. The skcipher
+ * request has to come last, the tfm's request context follows it.
+ */
+struct fscrypt_page_req {
+	struct fscrypt_page_req *next;		/* Next request of a batch */
+	struct fscrypt_batch *batch;
+	struct page *page;
+	struct fscrypt_completion_result ecr;
+	struct scatterlist dst, src;
 	struct {
 		__le64 index;
 		u8 padding[FS_XTS_TWEAK_SIZE - sizeof(__le64)];
 	} xts_tweak;
-	struct skcipher_request *req = NULL;
-	DECLARE_FS_COMPLETION_RESULT(ecr);
-	struct scatterlist dst, src;
-	struct fscrypt_info *ci = inode->i_crypt_info;
-	struct crypto_skcipher *tfm = ci->ci_ctfm;
-	int res = 0;
+	struct skcipher_request req;
+};
 
-	req = skcipher_request_alloc(tfm, gfp_flags);
-	if (!req) {
+/* Requests in flight at the same time, e.g. for all pages of a bio */
+struct fscrypt_batch {
+	atomic_t pending;
+	struct completion done;
+};
+
+static struct fscrypt_page_req *alloc_page_req(struct inode *inode,
+					       gfp_t gfp_flags)
+{
+	struct crypto_skcipher *tfm = inode->i_crypt_info->ci_ctfm;
+	struct fscrypt_page_req *preq;
+
+	preq = kmalloc(sizeof(*preq) + crypto_skcipher_reqsize(tfm),
+		       gfp_flags);
+	if (!preq) {
 		printk_ratelimited(KERN_ERR
 				"%s: crypto_request_alloc() failed\n",
 				__func__);
-		return -ENOMEM;
+		return NULL;
 	}
 
+	preq->next = NULL;
+	preq->batch = NULL;
+	init_completion(&preq->ecr.completion);
+	preq->ecr.res = 0;
+	skcipher_request_set_tfm(&preq->req, tfm);
 	skcipher_request_set_callback(
-		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-		page_crypt_complete, &ecr);
-
-	BUILD_BUG_ON(sizeof(xts_tweak) != FS_XTS_TWEAK_SIZE);
-	xts_tweak.index = cpu_to_le64(index);
-	memset(xts_tweak.padding, 0, sizeof(xts_tweak.padding));
-
-	sg_init_table(&dst, 1);
-	sg_set_page(&dst, dest_page, PAGE_SIZE, 0);
-	sg_init_table(&src, 1);
-	sg_set_page(&src, src_page, PAGE_SIZE, 0);
-	skcipher_request_set_crypt(req, &src, &dst, PAGE_SIZE, &xts_tweak);
+		&preq->req,
+		CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+		page_crypt_complete, &preq->ecr);
+	return preq;
+}
+
+/*
+ * Start the crypto of a page. Returns -EINPROGRESS if the request
+ * completes through its callback, else the result.
+ */
+static int start_page_req(struct fscrypt_page_req *preq,
+			  fscrypt_direction_t rw, pgoff_t index,
+			  struct page *src_page, struct page *dest_page)
+{
+	int res;
+
+	BUILD_BUG_ON(sizeof(preq->xts_tweak) != FS_XTS_TWEAK_SIZE);
+	preq->xts_tweak.index = cpu_to_le64(index);
+	memset(preq->xts_tweak.padding, 0, sizeof(preq->xts_tweak.padding));
+
+	sg_init_table(&preq->dst, 1);
+	sg_set_page(&preq->dst, dest_page, PAGE_SIZE, 0);
+	sg_init_table(&preq->src, 1);
+	sg_set_page(&preq->src, src_page, PAGE_SIZE, 0);
+	skcipher_request_set_crypt(&preq->req, &preq->src, &preq->dst,
+				   PAGE_SIZE, &preq->xts_tweak);
 	if (rw == FS_DECRYPT)
-		res = crypto_skcipher_decrypt(req);
+		res = crypto_skcipher_decrypt(&preq->req);
 	else
-		res = crypto_skcipher_encrypt(req);
-	if (res == -EINPROGRESS || res == -EBUSY) {
-		BUG_ON(req->base.data != &ecr);
-		wait_for_completion(&ecr.completion);
-		res = ecr.res;
+		res = crypto_skcipher_encrypt(&preq->req);
+
+	/* With CRYPTO_TFM_REQ_MAY_BACKLOG this means it was backlogged */
+	if (res == -EBUSY)
+		res = -EINPROGRESS;
+	return res;
+}
+
+static int wait_page_req(struct fscrypt_page_req *preq, int res)
+{
+	if (res == -EINPROGRESS) {
+		wait_for_completion(&preq->ecr.completion);
+		res = preq->ecr.res;
 	}
-	skcipher_request_free(req);
-	if (res) {
+	if (res)
 		printk_ratelimited(KERN_ERR
 			"%s: crypto_skcipher_encrypt() returned %d\n",
 			__func__, res);
-		return res;
+	return res;
+}
+
+static int do_page_crypto(struct inode *inode,
+			fscrypt_direction_t rw, pgoff_t index,
+			struct page *src_page, struct page *dest_page,
+			gfp_t gfp_flags)
+{
+	struct fscrypt_page_req *preq;
+	int res;
+
+	preq = alloc_page_req(inode, gfp_flags);
+	if (!preq)
+		return -ENOMEM;
+
+	res = start_page_req(preq, rw, index, src_page, dest_page);
+	res = wait_page_req(preq, res);
+	kfree(preq);
+	return res;
+}
+
+static void batch_put(struct fscrypt_batch *batch)
+{
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static void batch_crypt_complete(struct crypto_async_request *req, int res)
+{
+	struct fscrypt_page_req *preq = req->data;
+
+	if (res == -EINPROGRESS)
+		return;
+	preq->ecr.res = res;
+	batch_put(preq->batch);
+}
+
+/*
+ * Decrypt all pages of a bio in place, with all requests in flight at
+ * once so that an asynchronous cipher engine gets to work on them back
+ * to back. Returns the requests, each one holding the result for its
+ * page. Pages for which no request could be allocated are left out.
+ */
+static struct fscrypt_page_req *decrypt_bio_pages(struct bio *bio)
+{
+	struct fscrypt_page_req *head = NULL, **tail = &head;
+	struct fscrypt_batch batch;
+	struct bio_vec *bv;
+	int i, res;
+
+	atomic_set(&batch.pending, 1);
+	init_completion(&batch.done);
+
+	bio_for_each_segment_all(bv, bio, i) {
+		struct page *page = bv->bv_page;
+		struct fscrypt_page_req *preq;
+
+		preq = alloc_page_req(page->mapping->host, GFP_NOFS);
+		if (!preq)
+			continue;
+
+		preq->page = page;
+		preq->batch = &batch;
+		skcipher_request_set_callback(
+			&preq->req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+			batch_crypt_complete, preq);
+		*tail = preq;
+		tail = &preq->next;
+
+		atomic_inc(&batch.pending);
+		res = start_page_req(preq, FS_DECRYPT, page->index, page, page);
+		if (res != -EINPROGRESS) {
+			preq->ecr.res = res;
+			batch_put(&batch);
+		}
 	}
-	return 0;
+
+	batch_put(&batch);
+	wait_for_completion(&batch.done);
+	return head;
 }
 
 static struct page *alloc_bounce_page(struct fscrypt_ctx *ctx, gfp_t gfp_flags)
@@ -207,28 +330,50 @@ static struct page *alloc_bounce_page(struct fscrypt_ctx *ctx, gfp_t gfp_flags)
 	ctx->w.bounce_page = mempool_alloc(fscrypt_bounce_page_pool, gfp_flags);
 	if (ctx->w.bounce_page == NULL)
 		return ERR_PTR(-ENOMEM);
+	ctx->w.req = NULL;
 	ctx->flags |= FS_WRITE_PATH_FL;
 	return ctx->w.bounce_page;
 }
 
-/**
- * fscypt_encrypt_page() - Encrypts a page
- * @inode:          The inode for which the encryption should take place
- * @plaintext_page: The page to encrypt. Must be locked.
- * @gfp_flags:      The gfp flag for memory allocation
- *
- * Allocates a ciphertext page and encrypts plaintext_page into it using the ctx
- * encryption context.
- *
- * Called on the page write path.  The caller must call
- * fscrypt_restore_control_page() on the returned ciphertext page to
- * release the bounce buffer and the encryption context.
- *
- * Return: An allocated page with the encrypted content on success. Else, an
- * error value or NULL.
- */
-struct page *fscrypt_encrypt_page(struct inode *inode,
-				struct page *plaintext_page, gfp_t gfp_flags)
+static int start_page_encryption(struct fscrypt_ctx *ctx,
+				 struct inode *inode, gfp_t gfp_flags)
+{
+	struct fscrypt_page_req *preq;
+	int res;
+
+	preq = alloc_page_req(inode, gfp_flags);
+	if (!preq)
+		return -ENOMEM;
+
+	res = start_page_req(preq, FS_ENCRYPT, ctx->w.control_page->index,
+			     ctx->w.control_page, ctx->w.bounce_page);
+	if (res == -EINPROGRESS) {
+		ctx->w.req = preq;
+		return 0;
+	}
+
+	res = wait_page_req(preq, res);
+	kfree(preq);
+	return res;
+}
+
+static int wait_page_encryption(struct fscrypt_ctx *ctx)
+{
+	struct fscrypt_page_req *preq = ctx->w.req;
+	int res;
+
+	if (!preq)
+		return 0;
+
+	res = wait_page_req(preq, -EINPROGRESS);
+	ctx->w.req = NULL;
+	kfree(preq);
+	return res;
+}
+
+static struct page *__fscrypt_encrypt_page(struct inode *inode,
+				struct page *plaintext_page, gfp_t gfp_flags,
+				bool async)
 {
 	struct fscrypt_ctx *ctx;
 	struct page *ciphertext_page = NULL;
@@ -246,7 +391,10 @@ struct page *fscrypt_encrypt_page(struct inode *inode,
 		goto errout;
 
 	ctx->w.control_page = plaintext_page;
-	err = do_page_crypto(inode, FS_ENCRYPT, plaintext_page->index,
+	if (async)
+		err = start_page_encryption(ctx, inode, gfp_flags);
+	else
+		err = do_page_crypto(inode, FS_ENCRYPT, plaintext_page->index,
 					plaintext_page, ciphertext_page,
 					gfp_flags);
 	if (err) {
@@ -262,8 +410,79 @@ errout:
 	fscrypt_release_ctx(ctx);
 	return ciphertext_page;
 }
+
+/**
+ * fscypt_encrypt_page() - Encrypts a page
+ * @inode:          The inode for which the encryption should take place
+ * @plaintext_page: The page to encrypt. Must be locked.
+ * @gfp_flags:      The gfp flag for memory allocation
+ *
+ * Allocates a ciphertext page and encrypts plaintext_page into it using the ctx
+ * encryption context.
+ *
+ * Called on the page write path.  The caller must call
+ * fscrypt_restore_control_page() on the returned ciphertext page to
+ * release the bounce buffer and the encryption context.
+ *
+ * Return: An allocated page with the encrypted content on success. Else, an
+ * error value or NULL.
+ */
+struct page *fscrypt_encrypt_page(struct inode *inode,
+				struct page *plaintext_page, gfp_t gfp_flags)
+{
+	return __fscrypt_encrypt_page(inode, plaintext_page, gfp_flags, false);
+}
 EXPORT_SYMBOL(fscrypt_encrypt_page);
 
+/**
+ * fscrypt_encrypt_page_async() - Starts encrypting a page
+ * @inode:          The inode for which the encryption should take place
+ * @plaintext_page: The page to encrypt. Must be locked.
+ * @gfp_flags:      The gfp flag for memory allocation
+ *
+ * Like fscrypt_encrypt_page(), but the encryption may still be running on
+ * return, so that the pages of a whole bio can be encrypted at the same
+ * time. The plaintext page must stay around until the encryption is done,
+ * and the bio holding the ciphertext page must go through
+ * fscrypt_wait_bio_encryption() before being submitted.
+ *
+ * Return: An allocated page which will hold the encrypted content on
+ * success. Else, an error value or NULL.
+ */
+struct page *fscrypt_encrypt_page_async(struct inode *inode,
+				struct page *plaintext_page, gfp_t gfp_flags)
+{
+	return __fscrypt_encrypt_page(inode, plaintext_page, gfp_flags, true);
+}
+EXPORT_SYMBOL(fscrypt_encrypt_page_async);
+
+/**
+ * fscrypt_wait_bio_encryption() - Waits for the encryption of a bio
+ * @bio: The write bio, holding pages from fscrypt_encrypt_page_async()
+ *
+ * Return: Zero if all pages of the bio got encrypted, else an error.
+ */
+int fscrypt_wait_bio_encryption(struct bio *bio)
+{
+	struct bio_vec *bv;
+	int i, ret, err = 0;
+
+	bio_for_each_segment_all(bv, bio, i) {
+		struct page *page = bv->bv_page;
+
+		/* The bounce data pages are unmapped. */
+		if (page->mapping || !PagePrivate(page))
+			continue;
+
+		ret = wait_page_encryption(
+				(struct fscrypt_ctx *)page_private(page));
+		if (ret && !err)
+			err = ret;
+	}
+	return err;
+}
+EXPORT_SYMBOL(fscrypt_wait_bio_encryption);
+
 /**
  * f2crypt_decrypt_page() - Decrypts a page in-place
  * @page: The page to decrypt. Must be locked.
@@ -393,20 +612,30 @@ const struct dentry_operations fscrypt_d_ops = {
 EXPORT_SYMBOL(fscrypt_d_ops);
 
 /*
- * Call fscrypt_decrypt_page on every single page, reusing the encryption
- * context.
+ * Decrypt every single page of the bio in one batch, reusing the
+ * encryption context.
  */
 static void completion_pages(struct work_struct *work)
 {
 	struct fscrypt_ctx *ctx =
 		container_of(work, struct fscrypt_ctx, r.work);
 	struct bio *bio = ctx->r.bio;
+	struct fscrypt_page_req *preq, *next;
 	struct bio_vec *bv;
 	int i;
 
+	preq = decrypt_bio_pages(bio);
+
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
-		int ret = fscrypt_decrypt_page(page);
+		int ret = -ENOMEM;
+
+		if (preq && preq->page == page) {
+			ret = wait_page_req(preq, preq->ecr.res);
+			next = preq->next;
+			kfree(preq);
+			preq = next;
+		}
 
 		if (ret) {
 			WARN_ON_ONCE(1);
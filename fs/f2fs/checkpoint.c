@@ -1248,7 +1248,7 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		f2fs_bug_on(sbi, prefree_segments(sbi));
 		flush_sit_entries(sbi, cpc);
 		clear_prefree_segments(sbi, cpc);
-		f2fs_wait_all_discard_bio(sbi);
+		f2fs_flush_discard_cmds(sbi);
 		unblock_operations(sbi);
 		goto out;
 	}
@@ -1268,7 +1268,9 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	/* unlock all the fs_lock[] in do_checkpoint() */
 	err = do_checkpoint(sbi, cpc);
 
-	f2fs_wait_all_discard_bio(sbi);
+	/* other discards are left to the discard thread */
+	if (cpc->reason == CP_DISCARD)
+		f2fs_flush_discard_cmds(sbi);
 
 	unblock_operations(sbi);
 	stat_inc_cp_count(sbi->stat_info);
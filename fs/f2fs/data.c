@@ -113,6 +113,15 @@ static inline void __submit_bio(struct f2fs_sb_info *sbi,
 		if (f2fs_sb_mounted_hmsmr(sbi->sb) &&
 			current->plug && (type == DATA || type == NODE))
 			blk_finish_plug(current->plug);
+
+		/* data pages are encrypted asynchronously */
+		if (type == DATA && f2fs_sb_has_crypto(sbi->sb)) {
+			bio->bi_error = fscrypt_wait_bio_encryption(bio);
+			if (bio->bi_error) {
+				bio_endio(bio);
+				return;
+			}
+		}
 	}
 	submit_bio(bio);
 }
@@ -1194,8 +1203,8 @@ int do_write_data_page(struct f2fs_io_info *fio)
 		f2fs_wait_on_encrypted_page_writeback(F2FS_I_SB(inode),
 							fio->old_blkaddr);
 retry_encrypt:
-		fio->encrypted_page = fscrypt_encrypt_page(inode, fio->page,
-								gfp_flags);
+		fio->encrypted_page = fscrypt_encrypt_page_async(inode,
+							fio->page, gfp_flags);
 		if (IS_ERR(fio->encrypted_page)) {
 			err = PTR_ERR(fio->encrypted_page);
 			if (err == -ENOMEM) {
@@ -51,6 +51,13 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->ndirty_all = sbi->ndirty_inode[DIRTY_META];
 	si->inmem_pages = get_pages(sbi, F2FS_INMEM_PAGES);
 	si->wb_bios = atomic_read(&sbi->nr_wb_bios);
+	if (SM_I(sbi) && SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		si->nr_discard_cmd = atomic_read(&dcc->discard_cmd_cnt);
+		si->inflight_discard = atomic_read(&dcc->issued_blocks);
+		si->undiscard_blks = dcc->undiscard_blks;
+	}
 	si->total_count = (int)sbi->user_block_count / sbi->blocks_per_seg;
 	si->rsvd_segs = reserved_segments(sbi);
 	si->overp_segs = overprovision_segments(sbi);
@@ -193,6 +200,15 @@ get_cache:
 	if (SM_I(sbi)->cmd_control_info)
 		si->cache_mem += sizeof(struct flush_cmd_control);
 
+	/* build discard thread */
+	if (SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		si->cache_mem += sizeof(struct discard_cmd_control);
+		si->cache_mem += atomic_read(&dcc->discard_cmd_cnt) *
+						sizeof(struct discard_cmd);
+	}
+
 	/* free nids */
 	si->cache_mem += NM_I(sbi)->fcnt * sizeof(struct free_nid);
 	si->cache_mem += NM_I(sbi)->nat_cnt * sizeof(struct nat_entry);
@@ -312,6 +328,9 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - inmem: %4d, wb_bios: %4d\n",
 			   si->inmem_pages, si->wb_bios);
+		seq_printf(s, "  - discard: %4d cmds, %4u pending, %4d issued blks\n",
+			   si->nr_discard_cmd, si->undiscard_blks,
+			   si->inflight_discard);
 		seq_printf(s, "  - nodes: %4d in %4d\n",
 			   si->ndirty_node, si->node_pages);
 		seq_printf(s, "  - dents: %4d in dirs:%4d (%4d)\n",
@@ -181,11 +181,31 @@ struct discard_entry {
 	int len;		/* # of consecutive blocks of the discard */
 };
 
-struct bio_entry {
-	struct list_head list;
-	struct bio *bio;
-	struct completion event;
-	int error;
+/* max pending discard lists, indexed by discard length in blocks */
+#define MAX_PLIST_NUM		512
+#define plist_idx(blk_num)	((blk_num) >= MAX_PLIST_NUM ?		\
+					(MAX_PLIST_NUM - 1) : ((blk_num) - 1))
+
+#define DEF_DISCARD_GRANULARITY		1	/* issue discards of any size */
+#define DEF_MAX_DISCARD_ISSUE_BLOCKS	4096	/* 16MB of discards in flight */
+#define DEF_MIN_DISCARD_ISSUE_TIME	50	/* 50 ms, if there is pending */
+#define DEF_MAX_DISCARD_ISSUE_TIME	60000	/* 60 s, if nothing to issue */
+
+enum {
+	D_PREP,			/* queued, not submitted yet */
+	D_SUBMIT,		/* bio submitted to the device */
+};
+
+/* for a discard command, built by merging adjacent discard candidates */
+struct discard_cmd {
+	struct rb_node rb_node;		/* rb node located in rb-tree */
+	struct list_head list;		/* pending or wait list */
+	struct completion wait;		/* completion of the submitted bio */
+	block_t lstart;			/* start block address */
+	block_t len;			/* # of blocks to be discarded */
+	struct bio *bio;		/* last bio of the command */
+	unsigned char state;		/* D_PREP or D_SUBMIT */
+	int error;			/* bio error */
 };
 
 /* for the list of fsync inodes, used only during recovery */
@@ -603,6 +623,21 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	struct list_head pend_list[MAX_PLIST_NUM];/* pending, by length */
+	struct list_head wait_list;		/* submitted commands */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	struct mutex cmd_lock;			/* for the tree and lists */
+	struct rb_root root;			/* commands sorted by address */
+	int discard_wake;			/* to wake up discard thread */
+	unsigned int discard_granularity;	/* min. blocks of a discard */
+	unsigned int max_issue_blocks;		/* max. blocks in flight */
+	unsigned int undiscard_blks;		/* # of blocks not issued yet */
+	atomic_t issued_blocks;			/* # of blocks in flight */
+	atomic_t discard_cmd_cnt;		/* # of cached commands */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -623,7 +658,6 @@ struct f2fs_sm_info {
 
 	/* for small discard management */
 	struct list_head discard_list;		/* 4KB discard list */
-	struct list_head wait_list;		/* linked with issued discard bio */
 	int nr_discards;			/* # of discards in the list */
 	int max_discards;			/* max. discards to be issued */
 
@@ -639,6 +673,9 @@ struct f2fs_sm_info {
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+
 };
 
 /*
@@ -931,10 +968,12 @@ static inline bool f2fs_time_over(struct f2fs_sb_info *sbi, int type)
 static inline bool is_idle(struct f2fs_sb_info *sbi)
 {
 	struct block_device *bdev = sbi->sb->s_bdev;
-	struct request_queue *q = bdev_get_queue(bdev);
-	struct request_list *rl = &q->root_rl;
 
-	if (rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC])
+	/*
+	 * Requests in flight anywhere on the disk, which also covers blk-mq
+	 * queues that have no request list to look at.
+	 */
+	if (part_in_flight(&bdev->bd_disk->part0))
 		return 0;
 
 	return f2fs_time_over(sbi, REQ_TIME);
@@ -2078,7 +2117,10 @@ void destroy_flush_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 bool is_checkpointed_data(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
-void f2fs_wait_all_discard_bio(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
+void f2fs_wait_discard_bio(struct f2fs_sb_info *, block_t);
+void f2fs_flush_discard_cmds(struct f2fs_sb_info *);
 void clear_prefree_segments(struct f2fs_sb_info *, struct cp_control *);
 void release_discard_addrs(struct f2fs_sb_info *);
 int npages_for_summary_flush(struct f2fs_sb_info *, bool);
@@ -2201,6 +2243,8 @@ struct f2fs_stat_info {
 	int nats, dirty_nats, sits, dirty_sits, fnids;
 	int total_count, utilization;
 	int bg_gc, wb_bios;
+	int nr_discard_cmd, inflight_discard;
+	unsigned int undiscard_blks;
 	int inline_xattr, inline_inode, inline_dir, orphans;
 	unsigned int valid_count, valid_node_count, valid_inode_count, discard_blks;
 	unsigned int bimodal, avg_vblocks;
@@ -2462,6 +2506,8 @@ static inline bool f2fs_may_encrypt(struct inode *inode)
 #define fscrypt_get_ctx			fscrypt_notsupp_get_ctx
 #define fscrypt_release_ctx		fscrypt_notsupp_release_ctx
 #define fscrypt_encrypt_page		fscrypt_notsupp_encrypt_page
+#define fscrypt_encrypt_page_async	fscrypt_notsupp_encrypt_page_async
+#define fscrypt_wait_bio_encryption	fscrypt_notsupp_wait_bio_encryption
 #define fscrypt_decrypt_page		fscrypt_notsupp_decrypt_page
 #define fscrypt_decrypt_bio_pages	fscrypt_notsupp_decrypt_bio_pages
 #define fscrypt_pullback_bio_page	fscrypt_notsupp_pullback_bio_page
@@ -28,6 +28,7 @@ static int gc_thread_func(void *data)
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
+	unsigned int urgency;
 	long wait_ms;
 
 	wait_ms = gc_th->min_sleep_time;
@@ -68,13 +69,22 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		/*
+		 * As free space runs out, GC runs more and more often so that
+		 * foreground GC is not needed.  Close to the end, it runs even
+		 * if the device is busy.
+		 */
+		urgency = gc_urgency(sbi);
+
+		if (!is_idle(sbi) && urgency < GC_URGENCY_BUSY) {
 			increase_sleep_time(gc_th, &wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
 		}
 
-		if (has_enough_invalid_blocks(sbi))
+		if (urgency)
+			urgent_sleep_time(gc_th, urgency, &wait_ms);
+		else if (has_enough_invalid_blocks(sbi))
 			decrease_sleep_time(gc_th, &wait_ms);
 		else
 			increase_sleep_time(gc_th, &wait_ms);
@@ -110,6 +120,7 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->min_sleep_time = DEF_GC_THREAD_MIN_SLEEP_TIME;
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
+	gc_th->urgent_sleep_time = DEF_GC_THREAD_URGENT_SLEEP_TIME;
 
 	gc_th->gc_idle = 0;
 
@@ -136,10 +147,15 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	sbi->gc_thread = NULL;
 }
 
-static int select_gc_type(struct f2fs_gc_kthread *gc_th, int gc_type)
+static int select_gc_type(struct f2fs_sb_info *sbi, int gc_type)
 {
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	int gc_mode = (gc_type == BG_GC) ? GC_CB : GC_GREEDY;
 
+	/* when short of space, reclaim the most blocks per section moved */
+	if (gc_mode == GC_CB && gc_urgency(sbi) >= GC_URGENCY_BUSY)
+		gc_mode = GC_GREEDY;
+
 	if (gc_th && gc_th->gc_idle) {
 		if (gc_th->gc_idle == 1)
 			gc_mode = GC_CB;
@@ -160,7 +176,7 @@ static void select_policy(struct f2fs_sb_info *sbi, int gc_type,
 		p->max_search = dirty_i->nr_dirty[type];
 		p->ofs_unit = 1;
 	} else {
-		p->gc_mode = select_gc_type(sbi->gc_thread, gc_type);
+		p->gc_mode = select_gc_type(sbi, gc_type);
 		p->dirty_segmap = dirty_i->dirty_segmap[DIRTY];
 		p->max_search = dirty_i->nr_dirty[DIRTY];
 		p->ofs_unit = sbi->segs_per_sec;
@@ -216,16 +232,20 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 	unsigned int secno = GET_SECNO(sbi, segno);
 	unsigned int start = secno * sbi->segs_per_sec;
 	unsigned long long mtime = 0;
-	unsigned int vblocks;
+	unsigned int vblocks = 0;
 	unsigned char age = 0;
 	unsigned char u;
 	unsigned int i;
 
-	for (i = 0; i < sbi->segs_per_sec; i++)
-		mtime += get_seg_entry(sbi, start + i)->mtime;
-	vblocks = get_valid_blocks(sbi, segno, sbi->segs_per_sec);
+	/* the age of a section is the one of the valid blocks left in it */
+	for (i = 0; i < sbi->segs_per_sec; i++) {
+		struct seg_entry *se = get_seg_entry(sbi, start + i);
+
+		mtime += se->mtime * se->valid_blocks;
+		vblocks += se->valid_blocks;
+	}
 
-	mtime = div_u64(mtime, sbi->segs_per_sec);
+	mtime = vblocks ? div_u64(mtime, vblocks) : sit_i->min_mtime;
 	vblocks = div_u64(vblocks, sbi->segs_per_sec);
 
 	u = (vblocks * 100) >> sbi->log_blocks_per_seg;
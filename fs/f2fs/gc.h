@@ -16,8 +16,11 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_URGENT_SLEEP_TIME	500	/* 500 ms when out of space */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
+#define LIMIT_URGENT_FREE_BLOCK	10 /* percentage over total user space */
+#define GC_URGENCY_BUSY		50 /* from this urgency, GC even if busy */
 
 /* Search max. number of dirty segments to select a victim segment */
 #define DEF_MAX_VICTIM_SEARCH 4096 /* covers 8GB */
@@ -30,6 +33,7 @@ struct f2fs_gc_kthread {
 	unsigned int min_sleep_time;
 	unsigned int max_sleep_time;
 	unsigned int no_gc_sleep_time;
+	unsigned int urgent_sleep_time;
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
@@ -86,6 +90,36 @@ static inline void decrease_sleep_time(struct f2fs_gc_kthread *gc_th,
 		*wait = gc_th->min_sleep_time;
 }
 
+/*
+ * How close free space is to running out, from 0 while more than
+ * LIMIT_URGENT_FREE_BLOCK of the user space is free, to 100 when the
+ * next allocation needs foreground GC.  Without dirty segments there is
+ * nothing GC could do about it.
+ */
+static inline unsigned int gc_urgency(struct f2fs_sb_info *sbi)
+{
+	block_t limit = (long)(sbi->user_block_count *
+					LIMIT_URGENT_FREE_BLOCK) / 100;
+	block_t free = free_user_blocks(sbi);
+
+	if (!limit || free >= limit || !dirty_segments(sbi))
+		return 0;
+	return 100 - div_u64((u64)free * 100, limit);
+}
+
+/* scale the sleep time from min_sleep_time down to urgent_sleep_time */
+static inline void urgent_sleep_time(struct f2fs_gc_kthread *gc_th,
+					unsigned int urgency, long *wait)
+{
+	long range = (long)gc_th->min_sleep_time - gc_th->urgent_sleep_time;
+
+	if (range <= 0) {
+		*wait = gc_th->urgent_sleep_time;
+		return;
+	}
+	*wait = gc_th->min_sleep_time - range * urgency / 100;
+}
+
 static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 {
 	block_t invalid_user_blocks = sbi->user_block_count -
@@ -14,6 +14,7 @@
 #include <linux/blkdev.h>
 #include <linux/prefetch.h>
 #include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <linux/swap.h>
 #include <linux/timer.h>
 
@@ -26,7 +27,7 @@
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
-static struct kmem_cache *bio_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
 static struct kmem_cache *sit_entry_set_slab;
 static struct kmem_cache *inmem_entry_slab;
 
@@ -586,83 +587,425 @@ static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
-static struct bio_entry *__add_bio_entry(struct f2fs_sb_info *sbi,
-							struct bio *bio)
+static struct discard_cmd *__create_discard_cmd(struct f2fs_sb_info *sbi,
+				block_t lstart, block_t len)
 {
-	struct list_head *wait_list = &(SM_I(sbi)->wait_list);
-	struct bio_entry *be = f2fs_kmem_cache_alloc(bio_entry_slab, GFP_NOFS);
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct rb_node **p = &dcc->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct discard_cmd *dc;
 
-	INIT_LIST_HEAD(&be->list);
-	be->bio = bio;
-	init_completion(&be->event);
-	list_add_tail(&be->list, wait_list);
+	while (*p) {
+		parent = *p;
+		dc = rb_entry(parent, struct discard_cmd, rb_node);
+		if (lstart < dc->lstart)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	dc = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+	INIT_LIST_HEAD(&dc->list);
+	dc->lstart = lstart;
+	dc->len = len;
+	dc->bio = NULL;
+	dc->state = D_PREP;
+	dc->error = 0;
+	init_completion(&dc->wait);
+	list_add_tail(&dc->list, &dcc->pend_list[plist_idx(len)]);
 
-	return be;
+	rb_link_node(&dc->rb_node, parent, p);
+	rb_insert_color(&dc->rb_node, &dcc->root);
+	atomic_inc(&dcc->discard_cmd_cnt);
+
+	return dc;
 }
 
-void f2fs_wait_all_discard_bio(struct f2fs_sb_info *sbi)
+static void __remove_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc)
 {
-	struct list_head *wait_list = &(SM_I(sbi)->wait_list);
-	struct bio_entry *be, *tmp;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
 
-	list_for_each_entry_safe(be, tmp, wait_list, list) {
-		struct bio *bio = be->bio;
-		int err;
+	if (dc->bio) {
+		if (dc->error && dc->error != -EOPNOTSUPP)
+			f2fs_msg(sbi->sb, KERN_INFO,
+				"Issue discard failed, ret: %d", dc->error);
+		atomic_sub(dc->len, &dcc->issued_blocks);
+		bio_put(dc->bio);
+	}
 
-		wait_for_completion_io(&be->event);
-		err = be->error;
-		if (err == -EOPNOTSUPP)
-			err = 0;
+	list_del(&dc->list);
+	rb_erase(&dc->rb_node, &dcc->root);
+	kmem_cache_free(discard_cmd_slab, dc);
+	atomic_dec(&dcc->discard_cmd_cnt);
+}
 
-		if (err)
-			f2fs_msg(sbi->sb, KERN_INFO,
-				"Issue discard failed, ret: %d", err);
+/*
+ * Return the command covering @blkaddr, or NULL with the commands right
+ * before and after it.
+ */
+static struct discard_cmd *__lookup_discard_cmd(struct discard_cmd_control *dcc,
+				block_t blkaddr, struct discard_cmd **prev_dc,
+				struct discard_cmd **next_dc)
+{
+	struct rb_node *node = dcc->root.rb_node;
+	struct discard_cmd *prev = NULL, *next = NULL;
+
+	while (node) {
+		struct discard_cmd *dc;
+
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (blkaddr < dc->lstart) {
+			next = dc;
+			node = node->rb_left;
+		} else if (blkaddr >= dc->lstart + dc->len) {
+			prev = dc;
+			node = node->rb_right;
+		} else {
+			return dc;
+		}
+	}
 
-		bio_put(bio);
-		list_del(&be->list);
-		kmem_cache_free(bio_entry_slab, be);
+	if (prev_dc)
+		*prev_dc = prev;
+	if (next_dc)
+		*next_dc = next;
+	return NULL;
+}
+
+static unsigned int __max_discard_blocks(struct f2fs_sb_info *sbi)
+{
+	struct request_queue *q = bdev_get_queue(sbi->sb->s_bdev);
+
+	return max_t(unsigned int, 1,
+		SECTOR_TO_BLOCK(q->limits.max_discard_sectors));
+}
+
+/* queue [lstart, lstart + len), which is not covered by any command yet */
+static void __insert_discard_range(struct f2fs_sb_info *sbi,
+				block_t lstart, block_t len,
+				struct discard_cmd *prev_dc,
+				struct discard_cmd *next_dc)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	unsigned int max_len = __max_discard_blocks(sbi);
+	struct discard_cmd *dc = NULL;
+
+	if (prev_dc && prev_dc->state == D_PREP &&
+			prev_dc->lstart + prev_dc->len == lstart &&
+			prev_dc->len + len <= max_len) {
+		prev_dc->len += len;
+		dc = prev_dc;
+	}
+
+	if (next_dc && next_dc->state == D_PREP &&
+			lstart + len == next_dc->lstart) {
+		if (dc && dc->len + next_dc->len <= max_len) {
+			dc->len += next_dc->len;
+			__remove_discard_cmd(sbi, next_dc);
+		} else if (!dc && len + next_dc->len <= max_len) {
+			next_dc->lstart = lstart;
+			next_dc->len += len;
+			dc = next_dc;
+		}
+	}
+
+	if (dc)
+		list_move_tail(&dc->list, &dcc->pend_list[plist_idx(dc->len)]);
+	else
+		__create_discard_cmd(sbi, lstart, len);
+}
+
+static void __queue_discard_cmd(struct f2fs_sb_info *sbi,
+				block_t lstart, block_t len)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t end = lstart + len;
+
+	mutex_lock(&dcc->cmd_lock);
+	while (lstart < end) {
+		struct discard_cmd *dc, *prev_dc, *next_dc;
+		block_t piece_end;
+
+		/* parts already queued, e.g. as small discards, are skipped */
+		dc = __lookup_discard_cmd(dcc, lstart, &prev_dc, &next_dc);
+		if (dc) {
+			lstart = dc->lstart + dc->len;
+			continue;
+		}
+
+		piece_end = end;
+		if (next_dc && next_dc->lstart < end)
+			piece_end = next_dc->lstart;
+
+		__insert_discard_range(sbi, lstart, piece_end - lstart,
+							prev_dc, next_dc);
+		dcc->undiscard_blks += piece_end - lstart;
+		lstart = piece_end;
 	}
+	mutex_unlock(&dcc->cmd_lock);
 }
 
-static void f2fs_submit_bio_wait_endio(struct bio *bio)
+static void f2fs_submit_discard_endio(struct bio *bio)
 {
-	struct bio_entry *be = (struct bio_entry *)bio->bi_private;
+	struct discard_cmd *dc = (struct discard_cmd *)bio->bi_private;
 
-	be->error = bio->bi_error;
-	complete(&be->event);
+	dc->error = bio->bi_error;
+	complete(&dc->wait);
 }
 
-/* this function is copied from blkdev_issue_discard from block/blk-lib.c */
-int __f2fs_issue_discard_async(struct f2fs_sb_info *sbi, sector_t sector,
-		sector_t nr_sects, gfp_t gfp_mask, unsigned long flags)
+static void __submit_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc)
 {
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
 	struct block_device *bdev = sbi->sb->s_bdev;
 	struct bio *bio = NULL;
 	int err;
 
-	err = __blkdev_issue_discard(bdev, sector, nr_sects, gfp_mask, flags,
-			&bio);
-	if (!err && bio) {
-		struct bio_entry *be = __add_bio_entry(sbi, bio);
+	trace_f2fs_issue_discard(sbi->sb, dc->lstart, dc->len);
+
+	dcc->undiscard_blks -= dc->len;
+	err = __blkdev_issue_discard(bdev, SECTOR_FROM_BLOCK(dc->lstart),
+			SECTOR_FROM_BLOCK(dc->len), GFP_NOFS, 0, &bio);
+	if (err || !bio) {
+		if (err)
+			f2fs_msg(sbi->sb, KERN_INFO,
+				"Issue discard failed, ret: %d", err);
+		__remove_discard_cmd(sbi, dc);
+		return;
+	}
+
+	bio->bi_private = dc;
+	bio->bi_end_io = f2fs_submit_discard_endio;
+	dc->bio = bio;
+	dc->state = D_SUBMIT;
+	atomic_add(dc->len, &dcc->issued_blocks);
+	list_move_tail(&dc->list, &dcc->wait_list);
+	submit_bio(bio);
+}
+
+/*
+ * Issue pending commands of at least @granularity blocks, largest first.
+ * Unless @force is set, stop once the in-flight limit is reached.
+ */
+static void __issue_discard_cmds(struct f2fs_sb_info *sbi,
+				unsigned int granularity, bool force)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *tmp;
+	struct blk_plug plug;
+	int i;
+
+	granularity = clamp_t(unsigned int, granularity, 1, MAX_PLIST_NUM);
+
+	blk_start_plug(&plug);
+	for (i = MAX_PLIST_NUM - 1; i >= plist_idx(granularity); i--) {
+		list_for_each_entry_safe(dc, tmp, &dcc->pend_list[i], list) {
+			if (!force && atomic_read(&dcc->issued_blocks) >=
+						dcc->max_issue_blocks)
+				goto out;
+			__submit_discard_cmd(sbi, dc);
+		}
+	}
+out:
+	blk_finish_plug(&plug);
+}
+
+/* free completed commands, waiting for all of them if @wait is set */
+static void __reap_discard_cmds(struct f2fs_sb_info *sbi, bool wait)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *tmp;
+
+	list_for_each_entry_safe(dc, tmp, &dcc->wait_list, list) {
+		if (!wait && !completion_done(&dc->wait))
+			continue;
+		wait_for_completion_io(&dc->wait);
+		__remove_discard_cmd(sbi, dc);
+	}
+}
+
+static bool __has_discard_work(struct discard_cmd_control *dcc)
+{
+	unsigned int granularity;
+	int i;
+
+	if (!list_empty(&dcc->wait_list))
+		return true;
+
+	granularity = clamp_t(unsigned int, dcc->discard_granularity,
+						1, MAX_PLIST_NUM);
+	for (i = MAX_PLIST_NUM - 1; i >= plist_idx(granularity); i--)
+		if (!list_empty(&dcc->pend_list[i]))
+			return true;
+	return false;
+}
+
+/*
+ * @blkaddr is about to be written: drop it from a pending discard, or wait
+ * for the discard covering it to complete.
+ */
+void f2fs_wait_discard_bio(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc;
+
+	if (!dcc || !atomic_read(&dcc->discard_cmd_cnt))
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	dc = __lookup_discard_cmd(dcc, blkaddr, NULL, NULL);
+	if (!dc)
+		goto out;
+
+	if (dc->state == D_SUBMIT) {
+		wait_for_completion_io(&dc->wait);
+		__remove_discard_cmd(sbi, dc);
+		goto out;
+	}
+
+	dcc->undiscard_blks--;
+	if (dc->len == 1) {
+		__remove_discard_cmd(sbi, dc);
+		goto out;
+	}
+
+	if (blkaddr == dc->lstart) {
+		dc->lstart++;
+		dc->len--;
+	} else {
+		block_t end = dc->lstart + dc->len;
+
+		dc->len = blkaddr - dc->lstart;
+		if (blkaddr + 1 < end)
+			__create_discard_cmd(sbi, blkaddr + 1,
+						end - blkaddr - 1);
+	}
+	list_move_tail(&dc->list, &dcc->pend_list[plist_idx(dc->len)]);
+out:
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+/* issue every queued discard and wait for them, e.g. for FITRIM */
+void f2fs_flush_discard_cmds(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	__issue_discard_cmds(sbi, 1, true);
+	__reap_discard_cmds(sbi, true);
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+static void wake_up_discard_thread(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc || !dcc->f2fs_issue_discard)
+		return;
+
+	dcc->discard_wake = 1;
+	wake_up_interruptible_all(&dcc->discard_wait_queue);
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	unsigned int wait_ms = DEF_MIN_DISCARD_ISSUE_TIME;
+
+	set_freezable();
+
+	do {
+		wait_event_interruptible_timeout(*q,
+				kthread_should_stop() || freezing(current) ||
+				dcc->discard_wake,
+				msecs_to_jiffies(wait_ms));
+		if (try_to_freeze())
+			continue;
+		if (kthread_should_stop())
+			break;
+
+		dcc->discard_wake = 0;
+
+		mutex_lock(&dcc->cmd_lock);
+		__reap_discard_cmds(sbi, false);
+		/* slow TRIMs must not get in the way of regular I/O */
+		if (is_idle(sbi))
+			__issue_discard_cmds(sbi, dcc->discard_granularity,
+									false);
+		wait_ms = __has_discard_work(dcc) ? DEF_MIN_DISCARD_ISSUE_TIME :
+						DEF_MAX_DISCARD_ISSUE_TIME;
+		mutex_unlock(&dcc->cmd_lock);
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0, i;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
 
-		bio->bi_private = be;
-		bio->bi_end_io = f2fs_submit_bio_wait_endio;
-		bio->bi_opf |= REQ_SYNC;
-		submit_bio(bio);
+	for (i = 0; i < MAX_PLIST_NUM; i++)
+		INIT_LIST_HEAD(&dcc->pend_list[i]);
+	INIT_LIST_HEAD(&dcc->wait_list);
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	mutex_init(&dcc->cmd_lock);
+	dcc->root = RB_ROOT;
+	dcc->discard_granularity = DEF_DISCARD_GRANULARITY;
+	dcc->max_issue_blocks = DEF_MAX_DISCARD_ISSUE_BLOCKS;
+	atomic_set(&dcc->issued_blocks, 0);
+	atomic_set(&dcc->discard_cmd_cnt, 0);
+
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
 	}
 
 	return err;
 }
 
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+
+	if (dcc->f2fs_issue_discard)
+		kthread_stop(dcc->f2fs_issue_discard);
+
+	/* what is still queued is issued now rather than dropped */
+	f2fs_flush_discard_cmds(sbi);
+
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 				block_t blkstart, block_t blklen)
 {
-	sector_t start = SECTOR_FROM_BLOCK(blkstart);
-	sector_t len = SECTOR_FROM_BLOCK(blklen);
 	struct seg_entry *se;
 	unsigned int offset;
 	block_t i;
 
+	if (!SM_I(sbi)->dcc_info)
+		return 0;
+
 	for (i = blkstart; i < blkstart + blklen; i++) {
 		se = get_seg_entry(sbi, GET_SEGNO(sbi, i));
 		offset = GET_BLKOFF_FROM_SEG0(sbi, i);
@@ -670,8 +1013,8 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 		if (!f2fs_test_and_set_bit(offset, se->discard_map))
 			sbi->discard_blks--;
 	}
-	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
-	return __f2fs_issue_discard_async(sbi, start, len, GFP_NOFS, 0);
+	__queue_discard_cmd(sbi, blkstart, blklen);
+	return 0;
 }
 
 static void __add_discard_entry(struct f2fs_sb_info *sbi,
@@ -831,6 +1174,8 @@ skip:
 	}
 
 	blk_finish_plug(&plug);
+
+	wake_up_discard_thread(sbi);
 }
 
 static bool __mark_sit_entry_dirty(struct f2fs_sb_info *sbi, unsigned int segno)
@@ -870,8 +1215,6 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 				(new_vblocks > sbi->blocks_per_seg)));
 
 	se->valid_blocks = new_vblocks;
-	se->mtime = get_mtime(sbi);
-	SIT_I(sbi)->max_mtime = se->mtime;
 
 	/* Update valid block bitmap */
 	if (del > 0) {
@@ -899,6 +1242,36 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 		get_sec_entry(sbi, segno)->valid_blocks += del;
 }
 
+/*
+ * Keep the mtime of a segment as the average age of its valid blocks, so
+ * that cost-benefit GC sees how cold the data left in it is.  A block
+ * moved by GC keeps the age of its old segment.
+ */
+static void update_segment_mtime(struct f2fs_sb_info *sbi, block_t blkaddr,
+						unsigned long long old_mtime)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	unsigned long long ctime = get_mtime(sbi);
+	unsigned long long mtime = old_mtime ? old_mtime : ctime;
+	unsigned int segno = GET_SEGNO(sbi, blkaddr);
+	struct seg_entry *se;
+
+	if (segno == NULL_SEGNO)
+		return;
+
+	se = get_seg_entry(sbi, segno);
+
+	/* valid_blocks already counts the new block */
+	if (!se->mtime || se->valid_blocks <= 1)
+		se->mtime = mtime;
+	else
+		se->mtime = div_u64(se->mtime * (se->valid_blocks - 1) + mtime,
+							se->valid_blocks);
+
+	if (ctime > sit_i->max_mtime)
+		sit_i->max_mtime = ctime;
+}
+
 void refresh_sit_entry(struct f2fs_sb_info *sbi, block_t old, block_t new)
 {
 	update_sit_entry(sbi, new, 1);
@@ -1452,6 +1825,8 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	struct sit_info *sit_i = SIT_I(sbi);
 	struct curseg_info *curseg;
 	bool direct_io = (type == CURSEG_DIRECT_IO);
+	unsigned long long old_mtime = 0;
+	unsigned int old_segno = GET_SEGNO(sbi, old_blkaddr);
 
 	type = direct_io ? CURSEG_WARM_DATA : type;
 
@@ -1460,6 +1835,12 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	mutex_lock(&curseg->curseg_mutex);
 	mutex_lock(&sit_i->sentry_lock);
 
+	/* blocks moved by GC are not any younger than they were */
+	if (old_segno != NULL_SEGNO &&
+		(GET_SECNO(sbi, old_segno) == sbi->cur_victim_sec ||
+		(page && !IS_NODESEG(type) && is_cold_data(page))))
+		old_mtime = get_seg_entry(sbi, old_segno)->mtime;
+
 	/* direct_io'ed data is aligned to the segment for better performance */
 	if (direct_io && curseg->next_blkoff &&
 				!has_not_enough_free_secs(sbi, 0, 0))
@@ -1485,6 +1866,7 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	 * since SSR needs latest valid block information.
 	 */
 	refresh_sit_entry(sbi, old_blkaddr, *new_blkaddr);
+	update_segment_mtime(sbi, *new_blkaddr, old_mtime);
 
 	mutex_unlock(&sit_i->sentry_lock);
 
@@ -1492,6 +1874,9 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		fill_node_footer_blkaddr(page, NEXT_FREE_BLKADDR(sbi, curseg));
 
 	mutex_unlock(&curseg->curseg_mutex);
+
+	/* a discard still queued for the block must not land after the data */
+	f2fs_wait_discard_bio(sbi, *new_blkaddr);
 }
 
 static void do_write_page(struct f2fs_summary *sum, struct f2fs_io_info *fio)
@@ -2526,7 +2911,6 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	sm_info->min_fsync_blocks = DEF_MIN_FSYNC_BLOCKS;
 
 	INIT_LIST_HEAD(&sm_info->discard_list);
-	INIT_LIST_HEAD(&sm_info->wait_list);
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
 
@@ -2540,6 +2924,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (f2fs_discard_en(sbi)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2655,6 +3045,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -2670,15 +3061,15 @@ int __init create_segment_manager_caches(void)
 	if (!discard_entry_slab)
 		goto fail;
 
-	bio_entry_slab = f2fs_kmem_cache_create("bio_entry",
-			sizeof(struct bio_entry));
-	if (!bio_entry_slab)
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab)
 		goto destroy_discard_entry;
 
 	sit_entry_set_slab = f2fs_kmem_cache_create("sit_entry_set",
 			sizeof(struct sit_entry_set));
 	if (!sit_entry_set_slab)
-		goto destroy_bio_entry;
+		goto destroy_discard_cmd;
 
 	inmem_entry_slab = f2fs_kmem_cache_create("inmem_page_entry",
 			sizeof(struct inmem_pages));
@@ -2688,8 +3079,8 @@ int __init create_segment_manager_caches(void)
 
 destroy_sit_entry_set:
 	kmem_cache_destroy(sit_entry_set_slab);
-destroy_bio_entry:
-	kmem_cache_destroy(bio_entry_slab);
+destroy_discard_cmd:
+	kmem_cache_destroy(discard_cmd_slab);
 destroy_discard_entry:
 	kmem_cache_destroy(discard_entry_slab);
 fail:
@@ -2699,7 +3090,7 @@ fail:
 void destroy_segment_manager_caches(void)
 {
 	kmem_cache_destroy(sit_entry_set_slab);
-	kmem_cache_destroy(bio_entry_slab);
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 	kmem_cache_destroy(inmem_entry_slab);
 }
@@ -0,0 +1,556 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright 2017 NXP
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+/*
+ * A checkpoint is written at clean unmount and records what each
+ * eraseblock held at that point: nothing but a cleanmarker, only dirt
+ * waiting for erase, or nodes described by the summary node at its end.
+ * The next mount takes free and dirty blocks from the checkpoint without
+ * reading them, reads the summary of the others straight from where the
+ * checkpoint says it is, and only scans the blocks the checkpoint can't
+ * describe (nextblock, gcblock, blocks without a summary).
+ *
+ * The checkpoint is split into parts of one free eraseblock each, written
+ * right behind the cleanmarker. The highest free blocks are used so that
+ * mount finds part 0 quickly, and part 0 is written last so that a valid
+ * part 0 means the whole checkpoint made it to the flash.
+ *
+ * As soon as the filesystem is mounted read-write the checkpoint is
+ * stale, so every checkpoint node found on the flash is obsoleted before
+ * anything else gets written. The node type is ROCOMPAT, so kernels which
+ * don't know about checkpoints refuse to write while one is valid.
+ * Obsoleting a node in place needs NOR flash, so that's the only place
+ * checkpoints are used.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/mtd/mtd.h>
+#include <linux/crc32.h>
+#include <linux/vmalloc.h>
+#include "nodelist.h"
+#include "debug.h"
+
+#define JFFS2_CKPT_SCAN		0	/* scan the block */
+#define JFFS2_CKPT_FREE		1	/* erased, with a cleanmarker */
+#define JFFS2_CKPT_ERASE	2	/* nothing valid, needs erasing */
+#define JFFS2_CKPT_SUM		3	/* described by its summary node */
+
+#define JFFS2_CKPT_NO_NEXT	0xFFFFFFFF
+
+struct jffs2_ckpt_header {
+	jint32_t nr_blocks;
+	jint32_t sector_size;
+	jint32_t cleanmarker_size;
+};
+
+struct jffs2_ckpt_entry {
+	jint32_t state;
+	jint32_t sum_len;	/* length of the summary node, JFFS2_CKPT_SUM */
+};
+
+struct jffs2_ckpt {
+	void *data;
+	struct jffs2_ckpt_entry *entries;
+};
+
+/* A checkpoint node seen on the flash, to be obsoleted */
+struct jffs2_ckpt_ref {
+	struct jffs2_ckpt_ref *next;
+	uint32_t ofs;
+};
+
+static inline int jffs2_ckpt_usable(struct jffs2_sb_info *c)
+{
+	return jffs2_can_mark_obsolete(c) && !jffs2_is_writebuffered(c) &&
+	       !jffs2_cleanmarker_oob(c);
+}
+
+static inline uint32_t jffs2_ckpt_node_ofs(struct jffs2_sb_info *c,
+					   struct jffs2_eraseblock *jeb)
+{
+	return jeb->offset + PAD(c->cleanmarker_size);
+}
+
+/* How much checkpoint data fits in one eraseblock */
+static inline uint32_t jffs2_ckpt_part_size(struct jffs2_sb_info *c)
+{
+	return (c->sector_size - PAD(c->cleanmarker_size) -
+		sizeof(struct jffs2_raw_checkpoint)) & ~3;
+}
+
+static int jffs2_ckpt_read_node(struct jffs2_sb_info *c, uint32_t ofs,
+				struct jffs2_raw_checkpoint *rc)
+{
+	size_t retlen;
+	uint32_t crc;
+	int ret;
+
+	ret = mtd_read(c->mtd, ofs, sizeof(*rc), &retlen, (u_char *)rc);
+	if (ret || retlen != sizeof(*rc))
+		return -EIO;
+
+	if (je16_to_cpu(rc->magic) != JFFS2_MAGIC_BITMASK ||
+	    je16_to_cpu(rc->nodetype) != JFFS2_NODETYPE_CHECKPOINT)
+		return -ENOENT;
+
+	crc = crc32(0, rc, sizeof(struct jffs2_unknown_node) - 4);
+	if (je32_to_cpu(rc->hdr_crc) != crc)
+		return -ENOENT;
+
+	crc = crc32(0, rc, sizeof(*rc) - 4);
+	if (je32_to_cpu(rc->node_crc) != crc)
+		return -ENOENT;
+
+	if (je32_to_cpu(rc->data_len) > jffs2_ckpt_part_size(c) ||
+	    je32_to_cpu(rc->totlen) != sizeof(*rc) + je32_to_cpu(rc->data_len))
+		return -ENOENT;
+
+	return 0;
+}
+
+static int jffs2_ckpt_check(struct jffs2_sb_info *c, void *data, uint32_t len)
+{
+	struct jffs2_ckpt_header *hdr = data;
+	struct jffs2_ckpt_entry *ent = data + sizeof(*hdr);
+	uint32_t max_sum = min_t(uint32_t, c->sector_size, MAX_SUMMARY_SIZE);
+	uint32_t i, sum_len;
+
+	if (len != sizeof(*hdr) + c->nr_blocks * sizeof(*ent) ||
+	    je32_to_cpu(hdr->nr_blocks) != c->nr_blocks ||
+	    je32_to_cpu(hdr->sector_size) != c->sector_size ||
+	    je32_to_cpu(hdr->cleanmarker_size) != c->cleanmarker_size)
+		return -EINVAL;
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		switch (je32_to_cpu(ent[i].state)) {
+		case JFFS2_CKPT_SCAN:
+		case JFFS2_CKPT_FREE:
+		case JFFS2_CKPT_ERASE:
+			break;
+		case JFFS2_CKPT_SUM:
+			sum_len = je32_to_cpu(ent[i].sum_len);
+			if (sum_len < sizeof(struct jffs2_raw_summary) ||
+			    sum_len > max_sum)
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Look for a valid checkpoint and read it in. Returns NULL if there's
+ * none, in which case the medium is scanned as usual.
+ */
+struct jffs2_ckpt *jffs2_ckpt_load(struct jffs2_sb_info *c)
+{
+	struct jffs2_raw_checkpoint rc;
+	struct jffs2_ckpt *ckpt;
+	uint32_t ofs, len, pos, nr_parts, data_len, part;
+	size_t retlen;
+	void *data;
+	int i, ret;
+
+	if (!jffs2_ckpt_usable(c))
+		return NULL;
+
+	/*
+	 * Part 0 went to the highest free block, so look from the top. This
+	 * reads one node header per block if there is no checkpoint.
+	 */
+	for (i = c->nr_blocks - 1; i >= 0; i--) {
+		ofs = jffs2_ckpt_node_ofs(c, &c->blocks[i]);
+		ret = jffs2_ckpt_read_node(c, ofs, &rc);
+		if (ret == -EIO)
+			return NULL;
+		if (!ret && !je32_to_cpu(rc.part))
+			break;
+	}
+	if (i < 0)
+		return NULL;
+
+	len = je32_to_cpu(rc.total_len);
+	nr_parts = je32_to_cpu(rc.nr_parts);
+	if (!nr_parts || nr_parts > c->nr_blocks ||
+	    len > nr_parts * jffs2_ckpt_part_size(c))
+		goto bad;
+
+	data = vmalloc(len);
+	if (!data)
+		return NULL;
+
+	for (pos = 0, part = 0; ; ) {
+		data_len = je32_to_cpu(rc.data_len);
+		if (data_len > len - pos)
+			goto bad_free;
+
+		ret = mtd_read(c->mtd, ofs + sizeof(rc), data_len, &retlen,
+			       data + pos);
+		if (ret || retlen != data_len)
+			goto bad_free;
+		if (crc32(0, data + pos, data_len) != je32_to_cpu(rc.data_crc))
+			goto bad_free;
+		pos += data_len;
+
+		ofs = je32_to_cpu(rc.next);
+		if (++part == nr_parts)
+			break;
+
+		if (ofs >= c->flash_size ||
+		    ofs % c->sector_size != PAD(c->cleanmarker_size))
+			goto bad_free;
+		if (jffs2_ckpt_read_node(c, ofs, &rc) ||
+		    je32_to_cpu(rc.part) != part ||
+		    je32_to_cpu(rc.nr_parts) != nr_parts ||
+		    je32_to_cpu(rc.total_len) != len)
+			goto bad_free;
+	}
+
+	if (pos != len || ofs != JFFS2_CKPT_NO_NEXT ||
+	    jffs2_ckpt_check(c, data, len))
+		goto bad_free;
+
+	ckpt = kmalloc(sizeof(*ckpt), GFP_KERNEL);
+	if (!ckpt) {
+		vfree(data);
+		return NULL;
+	}
+	ckpt->data = data;
+	ckpt->entries = data + sizeof(struct jffs2_ckpt_header);
+
+	jffs2_dbg(1, "%s(): using checkpoint at 0x%08x (%u parts)\n",
+		  __func__, c->blocks[i].offset, nr_parts);
+	return ckpt;
+
+ bad_free:
+	vfree(data);
+ bad:
+	JFFS2_WARNING("Checkpoint at 0x%08x is corrupt, ignoring it.\n",
+		      c->blocks[i].offset);
+	return NULL;
+}
+
+void jffs2_ckpt_free(struct jffs2_ckpt *ckpt)
+{
+	if (!ckpt)
+		return;
+
+	vfree(ckpt->data);
+	kfree(ckpt);
+}
+
+static int jffs2_ckpt_scan_sum(struct jffs2_sb_info *c,
+			       struct jffs2_eraseblock *jeb, uint32_t sum_len,
+			       uint32_t *pseudo_random)
+{
+	struct jffs2_raw_summary *summary;
+	size_t retlen;
+	int ret;
+
+	summary = kmalloc(sum_len, GFP_KERNEL);
+	if (!summary)
+		return -ENOMEM;
+
+	ret = mtd_read(c->mtd, jeb->offset + c->sector_size - sum_len, sum_len,
+		       &retlen, (u_char *)summary);
+	if (ret || retlen != sum_len)
+		ret = 0;
+	else
+		ret = jffs2_sum_scan_sumnode(c, jeb, summary, sum_len,
+					     pseudo_random);
+
+	kfree(summary);
+
+	/* Let the normal scan deal with whatever went wrong */
+	return ret ? ret : -EAGAIN;
+}
+
+/*
+ * Set up an eraseblock from the checkpoint. Returns the BLK_STATE_xxx
+ * classification, or -EAGAIN if the block has to be scanned.
+ */
+int jffs2_ckpt_scan_eraseblock(struct jffs2_sb_info *c, struct jffs2_ckpt *ckpt,
+			       struct jffs2_eraseblock *jeb,
+			       uint32_t *pseudo_random)
+{
+	struct jffs2_ckpt_entry *ent;
+	int ret;
+
+	if (!ckpt)
+		return -EAGAIN;
+
+	ent = &ckpt->entries[jeb->offset / c->sector_size];
+
+	switch (je32_to_cpu(ent->state)) {
+	case JFFS2_CKPT_FREE:
+		if (!c->cleanmarker_size)
+			return BLK_STATE_CLEANMARKER;
+
+		ret = jffs2_prealloc_raw_node_refs(c, jeb, 1);
+		if (ret)
+			return ret;
+		jffs2_link_node_ref(c, jeb, jeb->offset | REF_NORMAL,
+				    c->cleanmarker_size, NULL);
+		return BLK_STATE_CLEANMARKER;
+
+	case JFFS2_CKPT_ERASE:
+		return BLK_STATE_ALLDIRTY;
+
+	case JFFS2_CKPT_SUM:
+		return jffs2_ckpt_scan_sum(c, jeb, je32_to_cpu(ent->sum_len),
+					   pseudo_random);
+	}
+
+	return -EAGAIN;
+}
+
+/* Called by the scan for every valid checkpoint node it comes across */
+int jffs2_ckpt_add_node(struct jffs2_sb_info *c, uint32_t ofs)
+{
+	struct jffs2_ckpt_ref *ref;
+
+	ref = kmalloc(sizeof(*ref), GFP_KERNEL);
+	if (!ref)
+		return -ENOMEM;
+
+	ref->ofs = ofs;
+	ref->next = c->ckpt_refs;
+	c->ckpt_refs = ref;
+	return 0;
+}
+
+/*
+ * Obsolete all checkpoint nodes on the flash. Must be done before the
+ * first write, as that makes the checkpoint stale.
+ */
+int jffs2_ckpt_invalidate(struct jffs2_sb_info *c)
+{
+	struct jffs2_ckpt_ref *ref;
+	struct jffs2_unknown_node n;
+	size_t retlen;
+	int ret;
+
+	while ((ref = c->ckpt_refs)) {
+		ret = mtd_read(c->mtd, ref->ofs, sizeof(n), &retlen,
+			       (u_char *)&n);
+		if (ret || retlen != sizeof(n))
+			goto err;
+
+		if (je16_to_cpu(n.nodetype) & JFFS2_NODE_ACCURATE) {
+			n.nodetype = cpu_to_je16(je16_to_cpu(n.nodetype) &
+						 ~JFFS2_NODE_ACCURATE);
+			ret = mtd_write(c->mtd, ref->ofs, sizeof(n), &retlen,
+					(u_char *)&n);
+			if (ret || retlen != sizeof(n))
+				goto err;
+		}
+
+		c->ckpt_refs = ref->next;
+		kfree(ref);
+	}
+
+	return 0;
+
+ err:
+	pr_warn("Failed to obsolete checkpoint node at 0x%08x: %d\n",
+		ref->ofs, ret);
+	return -EIO;
+}
+
+void jffs2_ckpt_exit(struct jffs2_sb_info *c)
+{
+	struct jffs2_ckpt_ref *ref;
+
+	while ((ref = c->ckpt_refs)) {
+		c->ckpt_refs = ref->next;
+		kfree(ref);
+	}
+}
+
+static void jffs2_ckpt_mark_list(struct jffs2_sb_info *c,
+				 struct jffs2_ckpt_entry *ent,
+				 struct list_head *head, uint32_t state)
+{
+	struct jffs2_eraseblock *jeb;
+
+	list_for_each_entry(jeb, head, list)
+		ent[jeb->offset / c->sector_size].state = cpu_to_je32(state);
+}
+
+/* Find the summary node at the end of a block which has been filled */
+static uint32_t jffs2_ckpt_sum_len(struct jffs2_sb_info *c,
+				   struct jffs2_eraseblock *jeb)
+{
+	struct jffs2_sum_marker sm;
+	uint32_t sum_len;
+	size_t retlen;
+	int ret;
+
+	ret = mtd_read(c->mtd, jeb->offset + c->sector_size - sizeof(sm),
+		       sizeof(sm), &retlen, (u_char *)&sm);
+	if (ret || retlen != sizeof(sm) ||
+	    je32_to_cpu(sm.magic) != JFFS2_SUM_MAGIC ||
+	    je32_to_cpu(sm.offset) >= c->sector_size)
+		return 0;
+
+	sum_len = c->sector_size - je32_to_cpu(sm.offset);
+	if (sum_len < sizeof(struct jffs2_raw_summary) ||
+	    sum_len > MAX_SUMMARY_SIZE)
+		return 0;
+
+	return sum_len;
+}
+
+static int jffs2_ckpt_write_part(struct jffs2_sb_info *c, uint32_t ofs,
+				 uint32_t part, uint32_t nr_parts,
+				 uint32_t next, void *data, uint32_t len,
+				 uint32_t total_len)
+{
+	struct jffs2_raw_checkpoint rc;
+	struct kvec vecs[2];
+	size_t retlen;
+	int ret;
+
+	rc.magic = cpu_to_je16(JFFS2_MAGIC_BITMASK);
+	rc.nodetype = cpu_to_je16(JFFS2_NODETYPE_CHECKPOINT);
+	rc.totlen = cpu_to_je32(sizeof(rc) + len);
+	rc.hdr_crc = cpu_to_je32(crc32(0, &rc,
+				       sizeof(struct jffs2_unknown_node) - 4));
+	rc.part = cpu_to_je32(part);
+	rc.nr_parts = cpu_to_je32(nr_parts);
+	rc.next = cpu_to_je32(next);
+	rc.total_len = cpu_to_je32(total_len);
+	rc.data_len = cpu_to_je32(len);
+	rc.data_crc = cpu_to_je32(crc32(0, data, len));
+	rc.node_crc = cpu_to_je32(crc32(0, &rc, sizeof(rc) - 4));
+
+	vecs[0].iov_base = &rc;
+	vecs[0].iov_len = sizeof(rc);
+	vecs[1].iov_base = data;
+	vecs[1].iov_len = len;
+
+	ret = mtd_writev(c->mtd, vecs, 2, ofs, &retlen);
+	if (ret || retlen != sizeof(rc) + len) {
+		pr_warn("Write of checkpoint at 0x%08x failed: %d, retlen %zd\n",
+			ofs, ret, retlen);
+		return ret ? ret : -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Write a checkpoint of the block states at clean unmount. Nothing may
+ * be written to the flash after this. Failing to write one only costs
+ * a full scan on the next mount.
+ */
+void jffs2_ckpt_write(struct jffs2_sb_info *c)
+{
+	struct jffs2_ckpt_header *hdr;
+	struct jffs2_ckpt_entry *ent;
+	struct jffs2_eraseblock *jeb;
+	uint32_t len, part_size, nr_parts, pos, next, sum_len;
+	uint32_t *parts;
+	void *data;
+	int i, n;
+
+	if (!jffs2_ckpt_usable(c) || jffs2_is_readonly(c) ||
+	    (c->flags & JFFS2_SB_FLAG_RO))
+		return;
+
+	len = sizeof(*hdr) + c->nr_blocks * sizeof(*ent);
+	part_size = jffs2_ckpt_part_size(c);
+	nr_parts = DIV_ROUND_UP(len, part_size);
+
+	/*
+	 * The checkpoint blocks have to be erased again after the next
+	 * mount, so don't dig into the reserved blocks for them.
+	 */
+	if (nr_parts + c->resv_blocks_write > c->nr_free_blocks) {
+		jffs2_dbg(1, "%s(): not enough free blocks for a checkpoint\n",
+			  __func__);
+		return;
+	}
+
+	data = vzalloc(len);
+	parts = kmalloc_array(nr_parts, sizeof(*parts), GFP_KERNEL);
+	if (!data || !parts)
+		goto out;
+
+	hdr = data;
+	hdr->nr_blocks = cpu_to_je32(c->nr_blocks);
+	hdr->sector_size = cpu_to_je32(c->sector_size);
+	hdr->cleanmarker_size = cpu_to_je32(c->cleanmarker_size);
+	ent = data + sizeof(*hdr);
+
+	/*
+	 * Blocks not on any of these lists (nextblock, gcblock, bad
+	 * blocks) stay at JFFS2_CKPT_SCAN.
+	 */
+	spin_lock(&c->erase_completion_lock);
+	jffs2_ckpt_mark_list(c, ent, &c->free_list, JFFS2_CKPT_FREE);
+	jffs2_ckpt_mark_list(c, ent, &c->erasable_list, JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->erasable_pending_wbuf_list,
+			     JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->erasing_list, JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->erase_checking_list, JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->erase_pending_list, JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->erase_complete_list, JFFS2_CKPT_ERASE);
+	jffs2_ckpt_mark_list(c, ent, &c->clean_list, JFFS2_CKPT_SUM);
+	jffs2_ckpt_mark_list(c, ent, &c->dirty_list, JFFS2_CKPT_SUM);
+	jffs2_ckpt_mark_list(c, ent, &c->very_dirty_list, JFFS2_CKPT_SUM);
+	spin_unlock(&c->erase_completion_lock);
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		if (je32_to_cpu(ent[i].state) != JFFS2_CKPT_SUM)
+			continue;
+
+		sum_len = jffs2_ckpt_sum_len(c, &c->blocks[i]);
+		if (sum_len)
+			ent[i].sum_len = cpu_to_je32(sum_len);
+		else
+			ent[i].state = cpu_to_je32(JFFS2_CKPT_SCAN);
+	}
+
+	/* The blocks holding the checkpoint must be scanned next time */
+	for (i = c->nr_blocks - 1, n = 0; i >= 0 && n < nr_parts; i--) {
+		if (je32_to_cpu(ent[i].state) != JFFS2_CKPT_FREE)
+			continue;
+
+		ent[i].state = cpu_to_je32(JFFS2_CKPT_SCAN);
+		parts[n++] = i;
+	}
+	if (n < nr_parts)
+		goto out;
+
+	/* Part 0 last, it makes the checkpoint valid */
+	for (n = nr_parts - 1, next = JFFS2_CKPT_NO_NEXT; n >= 0; n--) {
+		jeb = &c->blocks[parts[n]];
+		pos = n * part_size;
+
+		if (jffs2_ckpt_write_part(c, jffs2_ckpt_node_ofs(c, jeb), n,
+					  nr_parts, next, data + pos,
+					  min(part_size, len - pos), len))
+			goto out;
+
+		next = jffs2_ckpt_node_ofs(c, jeb);
+	}
+
+	jffs2_dbg(1, "%s(): wrote checkpoint at 0x%08x\n",
+		  __func__, c->blocks[parts[0]].offset);
+ out:
+	kfree(parts);
+	vfree(data);
+}
@@ -0,0 +1,38 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright 2017 NXP
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+#ifndef JFFS2_CHECKPOINT_H
+#define JFFS2_CHECKPOINT_H
+
+struct jffs2_ckpt;
+
+#ifdef CONFIG_JFFS2_CHECKPOINT	/* CHECKPOINT SUPPORT ENABLED */
+
+struct jffs2_ckpt *jffs2_ckpt_load(struct jffs2_sb_info *c);
+void jffs2_ckpt_free(struct jffs2_ckpt *ckpt);
+int jffs2_ckpt_scan_eraseblock(struct jffs2_sb_info *c, struct jffs2_ckpt *ckpt,
+			       struct jffs2_eraseblock *jeb,
+			       uint32_t *pseudo_random);
+int jffs2_ckpt_add_node(struct jffs2_sb_info *c, uint32_t ofs);
+int jffs2_ckpt_invalidate(struct jffs2_sb_info *c);
+void jffs2_ckpt_write(struct jffs2_sb_info *c);
+void jffs2_ckpt_exit(struct jffs2_sb_info *c);
+
+#else				/* CHECKPOINT DISABLED */
+
+#define jffs2_ckpt_load(a) (NULL)
+#define jffs2_ckpt_free(a)
+#define jffs2_ckpt_scan_eraseblock(a, b, c, d) (-EAGAIN)
+#define jffs2_ckpt_invalidate(a) (0)
+#define jffs2_ckpt_write(a)
+#define jffs2_ckpt_exit(a)
+
+#endif /* CONFIG_JFFS2_CHECKPOINT */
+
+#endif /* JFFS2_CHECKPOINT_H */
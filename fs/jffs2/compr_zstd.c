@@ -0,0 +1,122 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright 2017 NXP
+ *
+ * Based on compr_lzo.c by Richard Purdie.
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/init.h>
+#include <linux/zstd.h>
+#include "compr.h"
+
+static void *zstd_comp_mem;
+static void *zstd_decomp_mem;
+static void *zstd_compress_buf;
+/* one for zstd_comp_mem and zstd_compress_buf, one for zstd_decomp_mem */
+static DEFINE_MUTEX(zstd_comp_mutex);
+static DEFINE_MUTEX(zstd_decomp_mutex);
+
+static void free_workspace(void)
+{
+	vfree(zstd_comp_mem);
+	vfree(zstd_decomp_mem);
+	vfree(zstd_compress_buf);
+}
+
+static int __init alloc_workspace(void)
+{
+	zstd_comp_mem = vmalloc(ZSTD_MEM_COMPRESS);
+	zstd_decomp_mem = vmalloc(ZSTD_MEM_DECOMPRESS);
+	zstd_compress_buf = vmalloc(zstd_compressbound(PAGE_SIZE));
+
+	if (!zstd_comp_mem || !zstd_decomp_mem || !zstd_compress_buf) {
+		free_workspace();
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int jffs2_zstd_compress(unsigned char *data_in, unsigned char *cpage_out,
+			       uint32_t *sourcelen, uint32_t *dstlen)
+{
+	size_t compress_size = zstd_compressbound(PAGE_SIZE);
+	int ret;
+
+	if (*sourcelen > PAGE_SIZE)
+		return -1;
+
+	mutex_lock(&zstd_comp_mutex);
+	ret = zstd_compress(data_in, *sourcelen, zstd_compress_buf,
+			    &compress_size, zstd_comp_mem);
+	if (ret)
+		goto fail;
+
+	if (compress_size > *dstlen)
+		goto fail;
+
+	memcpy(cpage_out, zstd_compress_buf, compress_size);
+	mutex_unlock(&zstd_comp_mutex);
+
+	*dstlen = compress_size;
+	return 0;
+
+ fail:
+	mutex_unlock(&zstd_comp_mutex);
+	return -1;
+}
+
+static int jffs2_zstd_decompress(unsigned char *data_in,
+				 unsigned char *cpage_out,
+				 uint32_t srclen, uint32_t destlen)
+{
+	size_t dl = destlen;
+	int ret;
+
+	mutex_lock(&zstd_decomp_mutex);
+	ret = zstd_decompress(data_in, srclen, cpage_out, &dl,
+			      zstd_decomp_mem);
+	mutex_unlock(&zstd_decomp_mutex);
+
+	if (ret || dl != destlen)
+		return -1;
+
+	return 0;
+}
+
+static struct jffs2_compressor jffs2_zstd_comp = {
+	.priority = JFFS2_ZSTD_PRIORITY,
+	.name = "zstd",
+	.compr = JFFS2_COMPR_ZSTD,
+	.compress = &jffs2_zstd_compress,
+	.decompress = &jffs2_zstd_decompress,
+	.disabled = 0,
+};
+
+int __init jffs2_zstd_init(void)
+{
+	int ret;
+
+	ret = alloc_workspace();
+	if (ret < 0)
+		return ret;
+
+	ret = jffs2_register_compressor(&jffs2_zstd_comp);
+	if (ret)
+		free_workspace();
+
+	return ret;
+}
+
+void jffs2_zstd_exit(void)
+{
+	jffs2_unregister_compressor(&jffs2_zstd_comp);
+	free_workspace();
+}
@@ -393,10 +393,18 @@ void jffs2_dirty_inode(struct inode *inode, int flags)
 int jffs2_do_remount_fs(struct super_block *sb, int *flags, char *data)
 {
 	struct jffs2_sb_info *c = JFFS2_SB_INFO(sb);
+	int ret;
 
 	if (c->flags & JFFS2_SB_FLAG_RO && !(sb->s_flags & MS_RDONLY))
 		return -EROFS;
 
+	/* A checkpoint kept by the read-only mount goes stale now */
+	if ((sb->s_flags & MS_RDONLY) && !(*flags & MS_RDONLY)) {
+		ret = jffs2_ckpt_invalidate(c);
+		if (ret)
+			return ret;
+	}
+
 	/* We stop if it was running, then restart if it needs to.
 	   This also catches the case where it was stopped and this
 	   is just a remount to restart it.
@@ -598,6 +606,7 @@ out_root:
 	jffs2_free_raw_node_refs(c);
 	kvfree(c->blocks);
  out_inohash:
+	jffs2_ckpt_exit(c);
 	jffs2_clear_xattr_subsystem(c);
 	kfree(c->inocache_list);
  out_wbuf:
@@ -28,6 +28,7 @@
 #define JFFS2_SB_FLAG_BUILDING 4 /* File system building is in progress */
 
 struct jffs2_inodirty;
+struct jffs2_ckpt_ref;
 
 struct jffs2_mount_opts {
 	bool override_compr;
@@ -142,6 +143,10 @@ struct jffs2_sb_info {
 	struct jffs2_summary *summary;		/* Summary information */
 	struct jffs2_mount_opts mount_opts;
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	struct jffs2_ckpt_ref *ckpt_refs;	/* Checkpoint nodes on flash */
+#endif
+
 #ifdef CONFIG_JFFS2_FS_XATTR
 #define XATTRINDEX_HASHSIZE	(57)
 	uint32_t highest_xid;
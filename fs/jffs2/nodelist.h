@@ -20,6 +20,7 @@
 #include "xattr.h"
 #include "acl.h"
 #include "summary.h"
+#include "checkpoint.h"
 
 #ifdef __ECOS
 #include "os-ecos.h"
@@ -95,6 +95,7 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 	unsigned char *flashbuf = NULL;
 	uint32_t buf_size = 0;
 	struct jffs2_summary *s = NULL; /* summary info collected by the scan process */
+	struct jffs2_ckpt *ckpt = NULL;
 #ifndef __ECOS
 	size_t pointlen, try_size;
 
@@ -140,6 +141,8 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		}
 	}
 
+	ckpt = jffs2_ckpt_load(c);
+
 	for (i=0; i<c->nr_blocks; i++) {
 		struct jffs2_eraseblock *jeb = &c->blocks[i];
 
@@ -148,8 +151,10 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		/* reset summary info for next eraseblock scan */
 		jffs2_sum_reset_collected(s);
 
-		ret = jffs2_scan_eraseblock(c, jeb, buf_size?flashbuf:(flashbuf+jeb->offset),
-						buf_size, s);
+		ret = jffs2_ckpt_scan_eraseblock(c, ckpt, jeb, &pseudo_random);
+		if (ret == -EAGAIN)
+			ret = jffs2_scan_eraseblock(c, jeb, buf_size?flashbuf:(flashbuf+jeb->offset),
+							buf_size, s);
 
 		if (ret < 0)
 			goto out;
@@ -272,7 +277,10 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		jffs2_garbage_collect_trigger(c);
 		spin_unlock(&c->erase_completion_lock);
 	}
+	/* Any checkpoint goes stale with the first write */
 	ret = 0;
+	if (!jffs2_is_readonly(c))
+		ret = jffs2_ckpt_invalidate(c);
  out:
 	if (buf_size)
 		kfree(flashbuf);
@@ -281,6 +289,7 @@ int jffs2_scan_medium(struct jffs2_sb_info *c)
 		mtd_unpoint(c->mtd, 0, c->mtd->size);
 #endif
 	kfree(s);
+	jffs2_ckpt_free(ckpt);
 	return ret;
 }
 
@@ -884,6 +893,17 @@ scan_more:
 			}
 			break;
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+		case JFFS2_NODETYPE_CHECKPOINT:
+			jffs2_dbg(1, "Checkpoint node found at 0x%08x\n", ofs);
+			if ((err = jffs2_ckpt_add_node(c, ofs)))
+				return err;
+			if ((err = jffs2_scan_dirty_space(c, jeb, PAD(je32_to_cpu(node->totlen)))))
+				return err;
+			ofs += PAD(je32_to_cpu(node->totlen));
+			break;
+#endif	/* CONFIG_JFFS2_CHECKPOINT */
+
 		case JFFS2_NODETYPE_PADDING:
 			if (jffs2_sum_active())
 				jffs2_sum_add_padding_mem(s, je32_to_cpu(node->totlen));
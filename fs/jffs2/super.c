@@ -325,8 +325,10 @@ static void jffs2_put_super (struct super_block *sb)
 
 	mutex_lock(&c->alloc_sem);
 	jffs2_flush_wbuf_pad(c);
+	jffs2_ckpt_write(c);
 	mutex_unlock(&c->alloc_sem);
 
+	jffs2_ckpt_exit(c);
 	jffs2_sum_exit(c);
 
 	jffs2_free_ino_caches(c);
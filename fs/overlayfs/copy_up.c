@@ -225,7 +225,8 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
-			      struct kstat *stat, const char *link)
+			      struct kstat *stat, const char *link,
+			      bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -267,7 +268,12 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (metacopy) {
+		/* The data stays on lower until the file is opened for write */
+		err = ovl_do_setxattr(newdentry, OVL_XATTR_METACOPY, "y", 1, 0);
+		if (err)
+			goto out_cleanup;
+	} else if (S_ISREG(stat->mode)) {
 		struct path upperpath;
 
 		ovl_path_upper(dentry, &upperpath);
@@ -293,6 +299,8 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	/* Must be seen no later than the upper dentry by ovl_d_real() */
+	ovl_dentry_set_metacopy(dentry, metacopy);
 	ovl_dentry_update(dentry, newdentry);
 	ovl_inode_update(d_inode(dentry), d_inode(newdentry));
 	newdentry = NULL;
@@ -328,9 +336,13 @@ out_cleanup:
  * up uses upper parent i_mutex for exclusion.  Since rename can change
  * d_parent it is possible that the copy up will lock the old parent.  At
  * that point the file will have already been copied up anyway.
+ *
+ * With @metacopy a non-empty regular file only gets its inode and xattrs
+ * copied up, marked with OVL_XATTR_METACOPY.  Reads keep going to the lower
+ * file until ovl_copy_up_pending_data() fills in the data.
  */
 int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
-		    struct path *lowerpath, struct kstat *stat)
+		    struct path *lowerpath, struct kstat *stat, bool metacopy)
 {
 	DEFINE_DELAYED_CALL(done);
 	struct dentry *workdir = ovl_workdir(dentry);
@@ -372,8 +384,9 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 		goto out_unlock;
 	}
 
+	metacopy = metacopy && S_ISREG(stat->mode) && stat->size;
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, link);
+				 stat, link, metacopy);
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -385,7 +398,7 @@ out_unlock:
 	return err;
 }
 
-int ovl_copy_up(struct dentry *dentry)
+static int __ovl_copy_up(struct dentry *dentry, bool metacopy)
 {
 	int err = 0;
 	const struct cred *old_cred = ovl_override_creds(dentry->d_sb);
@@ -416,12 +429,81 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(&lowerpath, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      metacopy);
 
 		dput(parent);
 		dput(next);
 	}
 	revert_creds(old_cred);
 
+	if (!err && !metacopy)
+		err = ovl_copy_up_pending_data(dentry, false);
+
+	return err;
+}
+
+/*
+ * Fill in the data of a file that was copied up metadata only.  With
+ * @truncate the caller is about to throw the data away, so the upper file
+ * is left empty and only the metacopy marker is dropped.
+ */
+int ovl_copy_up_pending_data(struct dentry *dentry, bool truncate)
+{
+	struct dentry *parent;
+	struct dentry *upperdir;
+	struct path lowerpath;
+	struct path upperpath;
+	struct kstat stat;
+	const struct cred *old_cred;
+	int err = 0;
+
+	if (!ovl_dentry_is_metacopy(dentry))
+		return 0;
+
+	old_cred = ovl_override_creds(dentry->d_sb);
+	parent = dget_parent(dentry);
+	upperdir = ovl_dentry_upper(parent);
+
+	inode_lock_nested(upperdir->d_inode, I_MUTEX_PARENT);
+	/* Raced with another data copy-up?  Nothing to do, then... */
+	if (!ovl_dentry_is_metacopy(dentry))
+		goto out_unlock;
+
+	ovl_path_upper(dentry, &upperpath);
+	if (!truncate) {
+		ovl_path_lower(dentry, &lowerpath);
+		ovl_do_check_copy_up(lowerpath.dentry);
+
+		err = vfs_getattr(&lowerpath, &stat);
+		if (!err)
+			err = ovl_copy_up_data(&lowerpath, &upperpath,
+					       stat.size);
+		if (err)
+			goto out_unlock;
+	}
+
+	err = ovl_do_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (!err)
+		ovl_dentry_set_metacopy(dentry, false);
+out_unlock:
+	inode_unlock(upperdir->d_inode);
+	dput(parent);
+	revert_creds(old_cred);
+
 	return err;
 }
+
+int ovl_copy_up(struct dentry *dentry)
+{
+	return __ovl_copy_up(dentry, false);
+}
+
+/*
+ * Copy up for a change that only touches metadata (attributes, xattrs),
+ * leaving the data of a regular file on lower if the mount allows it.
+ */
+int ovl_copy_up_meta(struct dentry *dentry)
+{
+	return __ovl_copy_up(dentry, ovl_metacopy_enabled(dentry));
+}
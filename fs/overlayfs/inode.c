@@ -32,9 +32,12 @@ static int ovl_copy_up_truncate(struct dentry *dentry)
 	err = vfs_getattr(&lowerpath, &stat);
 	if (!err) {
 		stat.size = 0;
-		err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat);
+		err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat,
+				      false);
 	}
 	revert_creds(old_cred);
+	if (!err)
+		err = ovl_copy_up_pending_data(dentry, true);
 
 out_dput_parent:
 	dput(parent);
@@ -70,9 +73,11 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 		err = -ETXTBSY;
 		if (atomic_read(&realinode->i_writecount) < 0)
 			goto out_drop_write;
-	}
 
-	err = ovl_copy_up(dentry);
+		err = ovl_copy_up(dentry);
+	} else {
+		err = ovl_copy_up_meta(dentry);
+	}
 	if (!err) {
 		struct inode *winode = NULL;
 
@@ -109,12 +114,24 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	enum ovl_path_type type;
 	const struct cred *old_cred;
 	int err;
 
-	ovl_path_real(dentry, &realpath);
+	type = ovl_path_real(dentry, &realpath);
 	old_cred = ovl_override_creds(dentry->d_sb);
 	err = vfs_getattr(&realpath, stat);
+	if (!err && OVL_TYPE_UPPER(type) && ovl_dentry_is_metacopy(dentry)) {
+		struct kstat lowerstat;
+
+		/* Size and allocation still come from the lower data */
+		ovl_path_lower(dentry, &realpath);
+		err = vfs_getattr(&realpath, &lowerstat);
+		if (!err) {
+			stat->size = lowerstat.size;
+			stat->blocks = lowerstat.blocks;
+		}
+	}
 	revert_creds(old_cred);
 	return err;
 }
@@ -192,7 +209,7 @@ int ovl_xattr_set(struct dentry *dentry, const char *name, const void *value,
 			goto out_drop_write;
 	}
 
-	err = ovl_copy_up(dentry);
+	err = ovl_copy_up_meta(dentry);
 	if (err)
 		goto out_drop_write;
 
@@ -277,10 +294,12 @@ struct posix_acl *ovl_get_acl(struct inode *inode, int type)
 	return acl;
 }
 
-static bool ovl_open_need_copy_up(int flags, enum ovl_path_type type,
+static bool ovl_open_need_copy_up(struct dentry *dentry, int flags,
+				  enum ovl_path_type type,
 				  struct dentry *realdentry)
 {
-	if (OVL_TYPE_UPPER(type))
+	/* A metacopy upper still needs its data before it can be written */
+	if (OVL_TYPE_UPPER(type) && !ovl_dentry_is_metacopy(dentry))
 		return false;
 
 	if (special_file(realdentry->d_inode->i_mode))
@@ -299,7 +318,7 @@ int ovl_open_maybe_copy_up(struct dentry *dentry, unsigned int file_flags)
 	enum ovl_path_type type;
 
 	type = ovl_path_real(dentry, &realpath);
-	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
+	if (ovl_open_need_copy_up(dentry, file_flags, type, realpath.dentry)) {
 		err = ovl_want_write(dentry);
 		if (!err) {
 			if (file_flags & O_TRUNC)
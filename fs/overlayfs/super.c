@@ -26,11 +26,17 @@ MODULE_AUTHOR("Miklos Szeredi <miklos@szeredi.hu>");
 MODULE_DESCRIPTION("Overlay filesystem");
 MODULE_LICENSE("GPL");
 
+static bool ovl_metacopy_def;
+module_param_named(metacopy, ovl_metacopy_def, bool, S_IWUSR | S_IRUGO);
+MODULE_PARM_DESC(ovl_metacopy_def,
+		 "Default to on or off for the metadata only copy up feature");
+
 struct ovl_config {
 	char *lowerdir;
 	char *upperdir;
 	char *workdir;
 	bool default_permissions;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -56,6 +62,7 @@ struct ovl_entry {
 		struct {
 			u64 version;
 			bool opaque;
+			bool metacopy;
 		};
 		struct rcu_head rcu;
 	};
@@ -215,6 +222,24 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	return READ_ONCE(oe->metacopy);
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	WRITE_ONCE(oe->metacopy, metacopy);
+}
+
+bool ovl_metacopy_enabled(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -284,6 +309,21 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+static bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	char val;
+
+	if (!d_is_reg(dentry))
+		return false;
+
+	res = vfs_getxattr(dentry, OVL_XATTR_METACOPY, &val, 1);
+	if (res == 1 && val == 'y')
+		return true;
+
+	return false;
+}
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -320,8 +360,10 @@ static struct dentry *ovl_d_real(struct dentry *dentry,
 			return ERR_PTR(err);
 	}
 
+	/* Until its data is copied up, a metacopy file is read from lower */
 	real = ovl_dentry_upper(dentry);
-	if (real && (!inode || inode == d_inode(real)))
+	if (real && (inode ? inode == d_inode(real) :
+		     !ovl_dentry_is_metacopy(dentry)))
 		return real;
 
 	real = ovl_dentry_lower(dentry);
@@ -471,6 +513,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	struct dentry *this, *prev = NULL;
 	unsigned int i;
 	int err;
@@ -495,6 +538,8 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 				upperopaque = true;
 			} else if (poe->numlower && ovl_is_opaquedir(this)) {
 				upperopaque = true;
+			} else if (poe->numlower && ovl_is_metacopy(this)) {
+				metacopy = true;
 			}
 		}
 		upperdentry = prev = this;
@@ -527,6 +572,20 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			dput(this);
 			break;
 		}
+		/*
+		 * A metacopy upper takes its data from the topmost lower,
+		 * which has to be a regular file as well.
+		 */
+		if (metacopy) {
+			if (!d_is_reg(this)) {
+				dput(this);
+				break;
+			}
+			stack[ctr].dentry = this;
+			stack[ctr].mnt = lowerpath.mnt;
+			ctr++;
+			break;
+		}
 		/*
 		 * Only makes sense to check opaque dir if this is not the
 		 * lowermost layer.
@@ -559,6 +618,13 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			break;
 	}
 
+	if (metacopy && !ctr) {
+		pr_warn_ratelimited("overlayfs: no lower data for metacopy file %pd2\n",
+				    upperdentry);
+		err = -EIO;
+		goto out_put;
+	}
+
 	oe = ovl_alloc_entry(ctr);
 	err = -ENOMEM;
 	if (!oe)
@@ -585,7 +651,9 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	}
 
 	revert_creds(old_cred);
-	oe->opaque = upperopaque;
+	/* Like a fresh copy-up, a metacopy file covers its lower */
+	oe->opaque = upperopaque || metacopy;
+	oe->metacopy = metacopy;
 	oe->__upperdentry = upperdentry;
 	memcpy(oe->lowerstack, stack, sizeof(struct path) * ctr);
 	kfree(stack);
@@ -674,6 +742,9 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 	}
 	if (ufs->config.default_permissions)
 		seq_puts(m, ",default_permissions");
+	if (ufs->config.metacopy != ovl_metacopy_def)
+		seq_printf(m, ",metacopy=%s",
+			   ufs->config.metacopy ? "on" : "off");
 	return 0;
 }
 
@@ -700,6 +771,8 @@ enum {
 	OPT_UPPERDIR,
 	OPT_WORKDIR,
 	OPT_DEFAULT_PERMISSIONS,
+	OPT_METACOPY_ON,
+	OPT_METACOPY_OFF,
 	OPT_ERR,
 };
 
@@ -708,6 +781,8 @@ static const match_table_t ovl_tokens = {
 	{OPT_UPPERDIR,			"upperdir=%s"},
 	{OPT_WORKDIR,			"workdir=%s"},
 	{OPT_DEFAULT_PERMISSIONS,	"default_permissions"},
+	{OPT_METACOPY_ON,		"metacopy=on"},
+	{OPT_METACOPY_OFF,		"metacopy=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -772,6 +847,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 			config->default_permissions = true;
 			break;
 
+		case OPT_METACOPY_ON:
+			config->metacopy = true;
+			break;
+
+		case OPT_METACOPY_OFF:
+			config->metacopy = false;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
@@ -1154,6 +1237,7 @@ static int ovl_fill_super(struct super_block *sb, void *data, int silent)
 	if (!ufs)
 		goto out;
 
+	ufs->config.metacopy = ovl_metacopy_def;
 	err = ovl_parse_opt((char *) data, &ufs->config);
 	if (err)
 		goto out_free_config;
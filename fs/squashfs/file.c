@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/mm_inline.h>
 #include <linux/mutex.h>
 
 #include "squashfs_fs.h"
@@ -497,7 +498,87 @@ out:
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+/*
+ * Read the locked readahead pages @page[0..nr) of datablock @index.  Whole
+ * datablocks are decompressed in one go, while sparse blocks, fragments and
+ * anything the direct path could not handle go through readpage.
+ */
+static void squashfs_readahead_pages(struct inode *inode, int index,
+	struct page **page, int nr)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int i;
+
+	if (index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK) {
+		u64 block = 0;
+		int bsize = read_blocklist(inode, index, &block);
+
+		if (bsize > 0 && !squashfs_readahead_block(page, nr, block,
+								bsize))
+			return;
+	}
+
+	for (i = 0; i < nr; i++) {
+		squashfs_readpage(NULL, page[i]);
+		put_page(page[i]);
+	}
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned int nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	pgoff_t last = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct page **page;
+
+	TRACE("Entered squashfs_readpages, %u pages, start block %llx\n",
+				nr_pages, squashfs_i(inode)->start);
+
+	/* Returning leaves the remaining pages to be read by readpage */
+	page = kmalloc_array(1 << shift, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return 0;
+
+	/* The pages come in ascending index order, gather them per block */
+	while (!list_empty(pages)) {
+		struct page *first = lru_to_page(pages);
+		int index = first->index >> shift;
+		int nr = 0;
+
+		while (!list_empty(pages)) {
+			struct page *next = lru_to_page(pages);
+
+			if (next->index >> shift != index)
+				break;
+
+			list_del(&next->lru);
+			if (next->index > last ||
+			    add_to_page_cache_lru(next, mapping, next->index,
+						  gfp)) {
+				put_page(next);
+				continue;
+			}
+			page[nr++] = next;
+		}
+
+		if (nr)
+			squashfs_readahead_pages(inode, index, page, nr);
+	}
+
+	kfree(page);
+	return 0;
+}
+#endif
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+	.readpages = squashfs_readpages,
+#endif
 };
@@ -20,33 +20,36 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
+/*
+ * Grab the pages of the block not already filled in by the caller. Pages
+ * that are uptodate, or locked by someone else (likely a concurrent reader
+ * of the same block), are left NULL and skipped by the page actor.
+ */
+static void squashfs_grab_block_pages(struct address_space *mapping,
+	int start_index, int pages, struct page **page)
+{
+	int i;
 
-/* Read separately compressed datablock directly into page cache */
-int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+	for (i = 0; i < pages; i++) {
+		if (page[i])
+			continue;
 
-{
-	struct inode *inode = target_page->mapping->host;
-	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+		page[i] = grab_cache_page_nowait(mapping, start_index + i);
+		if (page[i] && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			put_page(page[i]);
+			page[i] = NULL;
+		}
+	}
+}
 
-	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
-	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
-	int start_index = target_page->index & ~mask;
-	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
-	struct page **page;
+/* Decompress the datablock straight into the (partial) set of pages */
+static int squashfs_read_direct(struct super_block *sb, u64 block, int bsize,
+	int pages, struct page **page)
+{
 	struct squashfs_page_actor *actor;
 	void *pageaddr;
-
-	if (end_index > file_end)
-		end_index = file_end;
-
-	pages = end_index - start_index + 1;
-
-	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
-	if (page == NULL)
-		return res;
+	int res, bytes;
 
 	/*
 	 * Create a "page actor" which will kmap and kunmap the
@@ -54,123 +57,127 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	 */
 	actor = squashfs_page_actor_init_special(page, pages, 0);
 	if (actor == NULL)
-		goto out;
-
-	/* Try to grab all the pages covered by the Squashfs block */
-	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
-		page[i] = (n == target_page->index) ? target_page :
-			grab_cache_page_nowait(target_page->mapping, n);
-
-		if (page[i] == NULL) {
-			missing_pages++;
-			continue;
-		}
+		return -ENOMEM;
 
-		if (PageUptodate(page[i])) {
-			unlock_page(page[i]);
-			put_page(page[i]);
-			page[i] = NULL;
-			missing_pages++;
-		}
-	}
-
-	if (missing_pages) {
-		/*
-		 * Couldn't get one or more pages, this page has either
-		 * been VM reclaimed, but others are still in the page cache
-		 * and uptodate, or we're racing with another thread in
-		 * squashfs_readpage also trying to grab them.  Fall back to
-		 * using an intermediate buffer.
-		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-								page);
-		if (res < 0)
-			goto mark_errored;
-
-		goto out;
-	}
-
-	/* Decompress directly into the page cache buffers */
-	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	res = squashfs_read_data(sb, block, bsize, NULL, actor);
+	squashfs_page_actor_free(actor);
 	if (res < 0)
-		goto mark_errored;
+		return res;
 
 	/* Last page may have trailing bytes not filled */
 	bytes = res % PAGE_SIZE;
-	if (bytes) {
+	if (bytes && page[pages - 1]) {
 		pageaddr = kmap_atomic(page[pages - 1]);
 		memset(pageaddr + bytes, 0, PAGE_SIZE - bytes);
 		kunmap_atomic(pageaddr);
 	}
 
-	/* Mark pages as uptodate, unlock and release */
+	return 0;
+}
+
+/*
+ * Mark the pages uptodate (or errored if @res is an error), unlock and
+ * release them.  @target_page, if any, is dealt with by the caller on error
+ * and keeps the reference it came with.
+ */
+static void squashfs_finish_block_pages(struct page *target_page, int pages,
+	struct page **page, int res)
+{
+	int i;
+
 	for (i = 0; i < pages; i++) {
-		flush_dcache_page(page[i]);
-		SetPageUptodate(page[i]);
+		if (page[i] == NULL)
+			continue;
+
+		if (res < 0) {
+			if (page[i] == target_page)
+				continue;
+			flush_dcache_page(page[i]);
+			SetPageError(page[i]);
+		} else {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+
 		unlock_page(page[i]);
 		if (page[i] != target_page)
 			put_page(page[i]);
 	}
+}
 
-	kfree(actor);
-	kfree(page);
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 
-	return 0;
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
 
-mark_errored:
-	/* Decompression failed, mark pages as errored.  Target_page is
-	 * dealt with by the caller
-	 */
-	for (i = 0; i < pages; i++) {
-		if (page[i] == NULL || page[i] == target_page)
-			continue;
-		flush_dcache_page(page[i]);
-		SetPageError(page[i]);
-		unlock_page(page[i]);
-		put_page(page[i]);
-	}
+	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int pages, res;
+	struct page **page;
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
+
+	page[target_page->index - start_index] = target_page;
+	squashfs_grab_block_pages(target_page->mapping, start_index, pages,
+									page);
+
+	res = squashfs_read_direct(inode->i_sb, block, bsize, pages, page);
+	squashfs_finish_block_pages(target_page, pages, page, res);
 
-out:
-	kfree(actor);
 	kfree(page);
 	return res;
 }
 
-
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+/*
+ * Readahead: decompress a whole datablock into the @nr locked readahead
+ * pages belonging to it (plus whatever other pages of the block can be
+ * grabbed) in one go.  Returns 0 once the pages have been dealt with, or a
+ * negative error if they were left untouched for the caller to read.
+ */
+int squashfs_readahead_block(struct page **ra_page, int nr, u64 block,
+	int bsize)
 {
-	struct inode *i = target_page->mapping->host;
-	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
-						 block, bsize);
-	int bytes = buffer->length, res = buffer->error, n, offset = 0;
-	void *pageaddr;
+	struct address_space *mapping = ra_page[0]->mapping;
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
 
-	if (res) {
-		ERROR("Unable to read page, block %llx, size %x\n", block,
-			bsize);
-		goto out;
-	}
+	int file_end = (i_size_read(inode) - 1) >> PAGE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
+	int start_index = ra_page[0]->index & ~mask;
+	int end_index = start_index | mask;
+	int i, pages, res;
+	struct page **page;
 
-	for (n = 0; n < pages && bytes > 0; n++,
-			bytes -= PAGE_SIZE, offset += PAGE_SIZE) {
-		int avail = min_t(int, bytes, PAGE_SIZE);
+	if (end_index > file_end)
+		end_index = file_end;
 
-		if (page[n] == NULL)
-			continue;
+	pages = end_index - start_index + 1;
 
-		pageaddr = kmap_atomic(page[n]);
-		squashfs_copy_data(pageaddr, buffer, offset, avail);
-		memset(pageaddr + avail, 0, PAGE_SIZE - avail);
-		kunmap_atomic(pageaddr);
-		flush_dcache_page(page[n]);
-		SetPageUptodate(page[n]);
-		unlock_page(page[n]);
-		if (page[n] != target_page)
-			put_page(page[n]);
-	}
+	page = kcalloc(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return -ENOMEM;
 
-out:
-	squashfs_cache_put(buffer);
-	return res;
+	for (i = 0; i < nr; i++)
+		page[ra_page[i]->index - start_index] = ra_page[i];
+	squashfs_grab_block_pages(mapping, start_index, pages, page);
+
+	res = squashfs_read_direct(inode->i_sb, block, bsize, pages, page);
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+	squashfs_finish_block_pages(NULL, pages, page, res);
+
+	kfree(page);
+	return 0;
 }
@@ -58,32 +58,51 @@ struct squashfs_page_actor *squashfs_page_actor_init(void **buffer,
 	return actor;
 }
 
-/* Implementation of page_actor for decompressing directly into page cache. */
-static void *direct_first_page(struct squashfs_page_actor *actor)
+/*
+ * Implementation of page_actor for decompressing directly into page cache.
+ *
+ * Pages of the block the caller could not get (already uptodate, or locked
+ * by a concurrent reader decompressing the same block) are left NULL and
+ * their data is decompressed into a scratch page and dropped, so the block
+ * is still decompressed in one go without an intermediate buffer.
+ */
+static void direct_unmap_page(struct squashfs_page_actor *actor)
 {
-	actor->next_page = 1;
-	return actor->pageaddr = kmap_atomic(actor->page[0]);
+	if (actor->pageaddr && actor->pageaddr != actor->tmp_buffer)
+		kunmap_atomic(actor->pageaddr);
 }
 
 static void *direct_next_page(struct squashfs_page_actor *actor)
 {
-	if (actor->pageaddr)
-		kunmap_atomic(actor->pageaddr);
+	struct page *page;
 
-	return actor->pageaddr = actor->next_page == actor->pages ? NULL :
-		kmap_atomic(actor->page[actor->next_page++]);
+	direct_unmap_page(actor);
+
+	if (actor->next_page == actor->pages)
+		return actor->pageaddr = NULL;
+
+	page = actor->page[actor->next_page++];
+	return actor->pageaddr = page ? kmap_atomic(page) : actor->tmp_buffer;
+}
+
+static void *direct_first_page(struct squashfs_page_actor *actor)
+{
+	actor->next_page = 0;
+	actor->pageaddr = NULL;
+	return direct_next_page(actor);
 }
 
 static void direct_finish_page(struct squashfs_page_actor *actor)
 {
-	if (actor->pageaddr)
-		kunmap_atomic(actor->pageaddr);
+	direct_unmap_page(actor);
+	actor->pageaddr = NULL;
 }
 
 struct squashfs_page_actor *squashfs_page_actor_init_special(struct page **page,
 	int pages, int length)
 {
 	struct squashfs_page_actor *actor = kmalloc(sizeof(*actor), GFP_KERNEL);
+	int i;
 
 	if (actor == NULL)
 		return NULL;
@@ -93,8 +112,31 @@ struct squashfs_page_actor *squashfs_page_actor_init_special(struct page **page,
 	actor->pages = pages;
 	actor->next_page = 0;
 	actor->pageaddr = NULL;
+	actor->tmp_buffer = NULL;
 	actor->squashfs_first_page = direct_first_page;
 	actor->squashfs_next_page = direct_next_page;
 	actor->squashfs_finish_page = direct_finish_page;
+
+	for (i = 0; i < pages; i++) {
+		if (page[i])
+			continue;
+
+		actor->tmp_buffer = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (actor->tmp_buffer == NULL) {
+			kfree(actor);
+			return NULL;
+		}
+		break;
+	}
+
 	return actor;
 }
+
+void squashfs_page_actor_free(struct squashfs_page_actor *actor)
+{
+	if (actor == NULL)
+		return;
+
+	kfree(actor->tmp_buffer);
+	kfree(actor);
+}
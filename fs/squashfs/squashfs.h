@@ -72,6 +72,7 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
+extern int squashfs_readahead_block(struct page **, int, u64, int);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -59,6 +59,12 @@ struct bio {
 	 */
 	struct io_context	*bi_ioc;
 	struct cgroup_subsys_state *bi_css;
+#ifdef CONFIG_BLK_DEV_THROTTLING_LOW
+	/* throtl_grp timing this bio, issue time in ns and size */
+	void			*bi_cg_private;
+	u64			bi_issue_time;
+	unsigned int		bi_issue_sectors;
+#endif
 #endif
 	union {
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -18,6 +18,7 @@
 enum busfreq_event {
 	LOW_BUSFREQ_ENTER,
 	LOW_BUSFREQ_EXIT,
+	HIGH_BUSFREQ_ENTER,
 };
 
 /*
@@ -47,6 +48,8 @@ extern struct regulator *arm_reg;
 extern struct regulator *soc_reg;
 void request_bus_freq(enum bus_freq_mode mode);
 void release_bus_freq(enum bus_freq_mode mode);
+void request_bus_freq_nowait(enum bus_freq_mode mode);
+int wait_for_bus_freq(enum bus_freq_mode mode, unsigned long timeout);
 int register_busfreq_notifier(struct notifier_block *nb);
 int unregister_busfreq_notifier(struct notifier_block *nb);
 int get_bus_freq_mode(void);
@@ -57,6 +60,14 @@ static inline void request_bus_freq(enum bus_freq_mode mode)
 static inline void release_bus_freq(enum bus_freq_mode mode)
 {
 }
+static inline void request_bus_freq_nowait(enum bus_freq_mode mode)
+{
+}
+static inline int wait_for_bus_freq(enum bus_freq_mode mode,
+				    unsigned long timeout)
+{
+	return 0;
+}
 static inline int register_busfreq_notifier(struct notifier_block *nb)
 {
 	return 0;
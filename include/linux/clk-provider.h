@@ -35,6 +35,8 @@
 #define CLK_IS_CRITICAL		BIT(11) /* do not gate, ever */
 /* parents need enable during gate/ungate, set rate and re-parent */
 #define CLK_OPS_PARENT_ENABLE	BIT(12)
+/* rate is a fixed function of the parent's, whatever the ops say */
+#define CLK_FIXED_RATIO		BIT(13)
 
 struct clk;
 struct clk_hw;
@@ -12,10 +12,17 @@
 
 #include <linux/thermal.h>
 
+/*
+ * Cooling states passed to the notifier chain range from 0 (no throttling)
+ * to DEVICE_COOLING_MAX_STATE (the device runs at its lowest speed).
+ */
+#define DEVICE_COOLING_MAX_STATE	4
+
 #ifdef CONFIG_DEVICE_THERMAL
 int register_devfreq_cooling_notifier(struct notifier_block *nb);
 int unregister_devfreq_cooling_notifier(struct notifier_block *nb);
 struct thermal_cooling_device *devfreq_cooling_register(void);
+struct thermal_cooling_device *devfreq_cooling_register_power(u32 max_power);
 void devfreq_cooling_unregister(struct thermal_cooling_device *cdev);
 #else
 static inline
@@ -36,6 +43,12 @@ struct thermal_cooling_device *devfreq_cooling_register(void)
 	return NULL;
 }
 
+static inline
+struct thermal_cooling_device *devfreq_cooling_register_power(u32 max_power)
+{
+	return NULL;
+}
+
 static inline
 void devfreq_cooling_unregister(struct thermal_cooling_device *cdev)
 {
@@ -0,0 +1,27 @@
+/*
+ * Freescale eDMA engine driver support header file
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute  it and/or modify it
+ * under  the terms of  the GNU General  Public License as published by the
+ * Free Software Foundation;  either version 2 of the  License, or (at your
+ * option) any later version.
+ */
+
+#ifndef __DMA_FSL_EDMA_H
+#define __DMA_FSL_EDMA_H
+
+#include <linux/dmaengine.h>
+
+#if IS_ENABLED(CONFIG_FSL_EDMA)
+int fsl_edma_link_channel(struct dma_chan *chan, struct dma_chan *link);
+#else
+static inline int fsl_edma_link_channel(struct dma_chan *chan,
+					struct dma_chan *link)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
@@ -8,6 +8,7 @@
 
 struct io_cq;
 struct elevator_type;
+struct blk_mq_hw_ctx;
 
 typedef int (elevator_merge_fn) (struct request_queue *, struct request **,
 				 struct bio *);
@@ -77,6 +78,22 @@ struct elevator_ops
 	elevator_registered_fn *elevator_registered_fn;
 };
 
+/*
+ * Scheduler hooks for blk-mq queues. Requests reach the scheduler with
+ * their tag already assigned and leave it one at a time, when the
+ * hardware queue is run and the driver can take more work.
+ */
+struct elevator_mq_ops {
+	int (*init_sched)(struct request_queue *, struct elevator_type *);
+	void (*exit_sched)(struct elevator_queue *);
+
+	bool (*bio_merge)(struct blk_mq_hw_ctx *, struct bio *);
+	void (*insert_requests)(struct blk_mq_hw_ctx *, struct list_head *,
+				bool);
+	struct request *(*dispatch_request)(struct blk_mq_hw_ctx *);
+	bool (*has_work)(struct blk_mq_hw_ctx *);
+};
+
 #define ELV_NAME_MAX	(16)
 
 struct elv_fs_entry {
@@ -95,6 +112,8 @@ struct elevator_type
 
 	/* fields provided by elevator implementation */
 	struct elevator_ops ops;
+	struct elevator_mq_ops mq_ops;
+	bool uses_mq;
 	size_t icq_size;	/* see iocontext.h */
 	size_t icq_align;	/* ditto */
 	struct elv_fs_entry *elevator_attrs;
@@ -85,11 +85,14 @@ struct fscrypt_info {
 #define FS_CTX_REQUIRES_FREE_ENCRYPT_FL		0x00000001
 #define FS_WRITE_PATH_FL			0x00000002
 
+struct fscrypt_page_req;
+
 struct fscrypt_ctx {
 	union {
 		struct {
 			struct page *bounce_page;	/* Ciphertext page */
 			struct page *control_page;	/* Original page  */
+			struct fscrypt_page_req *req;	/* Encryption running */
 		} w;
 		struct {
 			struct bio *bio;
@@ -242,6 +245,9 @@ int fscrypt_initialize(void);
 extern struct fscrypt_ctx *fscrypt_get_ctx(struct inode *, gfp_t);
 extern void fscrypt_release_ctx(struct fscrypt_ctx *);
 extern struct page *fscrypt_encrypt_page(struct inode *, struct page *, gfp_t);
+extern struct page *fscrypt_encrypt_page_async(struct inode *, struct page *,
+						gfp_t);
+extern int fscrypt_wait_bio_encryption(struct bio *);
 extern int fscrypt_decrypt_page(struct page *);
 extern void fscrypt_decrypt_bio_pages(struct fscrypt_ctx *, struct bio *);
 extern void fscrypt_pullback_bio_page(struct page **, bool);
@@ -290,6 +296,17 @@ static inline struct page *fscrypt_notsupp_encrypt_page(struct inode *i,
 	return ERR_PTR(-EOPNOTSUPP);
 }
 
+static inline struct page *fscrypt_notsupp_encrypt_page_async(struct inode *i,
+						struct page *p, gfp_t f)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static inline int fscrypt_notsupp_wait_bio_encryption(struct bio *b)
+{
+	return 0;
+}
+
 static inline int fscrypt_notsupp_decrypt_page(struct page *p)
 {
 	return -EOPNOTSUPP;
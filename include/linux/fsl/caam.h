@@ -0,0 +1,26 @@
+/*
+ * Freescale CAAM services for other kernel subsystems
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __FSL_CAAM_H__
+#define __FSL_CAAM_H__
+
+#include <crypto/hash.h>
+
+#if IS_ENABLED(CONFIG_CRYPTO_DEV_FSL_CAAM_AHASH_API)
+int caam_ahash_digest_batch(struct ahash_request **reqs, unsigned int nreqs);
+#else
+static inline int caam_ahash_digest_batch(struct ahash_request **reqs,
+					  unsigned int nreqs)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __FSL_CAAM_H__ */
@@ -21,5 +21,15 @@
 #ifndef __LINUX_IMX_GPC_H__
 #define __LINUX_IMX_GPC_H__
 
+struct device;
+struct notifier_block;
+
+/* Events sent to GPC power domain notifiers */
+#define IMX_GPC_PD_PRE_POWER_OFF	0
+#define IMX_GPC_PD_POST_POWER_ON	1
+
 int imx_gpc_mf_request_on(unsigned int irq, unsigned int on);
+int imx_gpc_pd_register_notifier(struct device *dev, struct notifier_block *nb);
+int imx_gpc_pd_unregister_notifier(struct device *dev,
+				   struct notifier_block *nb);
 #endif /* __LINUX_IMX_GPC_H__ */
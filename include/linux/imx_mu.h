@@ -5,6 +5,11 @@
  * SPDX-License-Identifier:     GPL-2.0+
  */
 
+#ifndef __LINUX_IMX_MU_H
+#define __LINUX_IMX_MU_H
+
+#include <linux/types.h>
+
 #define MU_ATR0_OFFSET1		0x0
 #define MU_ARR0_OFFSET1		0x10
 #define MU_ASR_OFFSET1		0x20
@@ -30,6 +35,9 @@
 
 #define MU_SR_TE0_MASK1		(1 << 23)
 #define MU_SR_RF0_MASK1		(1 << 27)
+#define MU_SR_GIP0_MASK1	(1 << 31)
+#define MU_CR_GIR0_MASK1	(1 << 19)
+#define MU_CR_TIE0_MASK1	(1 << 23)
 #define MU_CR_RIE0_MASK1	(1 << 27)
 #define MU_CR_GIE0_MASK1	(1 << 31)
 
@@ -45,3 +53,35 @@ void MU_EnableRxFullInt(void __iomem *base, uint32_t index);
 uint32_t MU_ReadStatus(void __iomem *base);
 int32_t MU_SetFn(void __iomem *base, uint32_t Fn);
 
+struct device;
+struct mbox_chan;
+struct mbox_client;
+
+/*
+ * Mailbox channel types. A TXRX channel carries one 32-bit word per message
+ * through a transmit/receive register pair, a GP channel is a doorbell on a
+ * general purpose interrupt and carries no data.
+ */
+#define IMX_MU_TYPE_TXRX	0
+#define IMX_MU_TYPE_GP		1
+
+#ifdef CONFIG_IMX_MU_MBOX
+int imx_mu_mbox_register(struct device *dev, void __iomem *base, int irq);
+void imx_mu_mbox_resume(void);
+struct mbox_chan *imx_mu_mbox_request_channel(struct mbox_client *cl,
+					      unsigned int type,
+					      unsigned int idx);
+void imx_mu_mbox_free_channel(struct mbox_chan *chan);
+void imx_mu_mbox_set_poll(struct mbox_chan *chan, bool poll);
+bool imx_mu_mbox_tx_pending(struct mbox_chan *chan);
+#else
+static inline int imx_mu_mbox_register(struct device *dev,
+				       void __iomem *base, int irq)
+{
+	return 0;
+}
+
+static inline void imx_mu_mbox_resume(void) {}
+#endif
+
+#endif /* __LINUX_IMX_MU_H */
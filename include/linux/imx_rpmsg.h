@@ -42,4 +42,22 @@ struct imx_rpmsg_head {
 
 int imx_mu_rpmsg_register_nb(const char *name, struct notifier_block *nb);
 int imx_mu_rpmsg_unregister_nb(const char *name, struct notifier_block *nb);
+
+struct completion;
+
+#ifdef CONFIG_HAVE_IMX_RPMSG
+void imx_rpmsg_poll_begin(void);
+int imx_rpmsg_poll(struct completion *done, unsigned int timeout_us);
+void imx_rpmsg_poll_end(void);
+#else
+static inline void imx_rpmsg_poll_begin(void) {}
+
+static inline int imx_rpmsg_poll(struct completion *done,
+				 unsigned int timeout_us)
+{
+	return -ENODEV;
+}
+
+static inline void imx_rpmsg_poll_end(void) {}
+#endif
 #endif /* __LINUX_IMX_RPMSG_H__ */
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef __LINUX_IMX_SRC_H__
+#define __LINUX_IMX_SRC_H__
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_HAVE_IMX_SRC
+bool imx_src_is_m4_enabled(void);
+int imx_src_m4_run(bool run);
+#else
+static inline bool imx_src_is_m4_enabled(void)
+{
+	return false;
+}
+
+static inline int imx_src_m4_run(bool run)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __LINUX_IMX_SRC_H__ */
@@ -35,6 +35,8 @@ struct pt_regs;
  * @affinity_hint:	hint to user space for preferred irq affinity
  * @affinity_notify:	context for notification of affinity changes
  * @pending_mask:	pending rebalanced interrupts
+ * @balance_count:	interrupt count at the last rate based balancing pass
+ * @balance_cpu:	CPU the rate based balancer placed the irq on, or -1
  * @threads_oneshot:	bitfield to handle shared oneshot threads
  * @threads_active:	number of irqaction threads currently running
  * @wait_for_threads:	wait queue for sync_irq to wait for threaded handlers
@@ -75,6 +77,10 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#ifdef CONFIG_IRQ_RATE_BALANCE
+	unsigned int		balance_count;
+	int			balance_cpu;
+#endif
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
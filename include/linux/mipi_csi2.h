@@ -54,6 +54,8 @@
 #define MIPI_DT_RAW12		0x2c
 #define MIPI_DT_RAW14		0x2d
 
+#define MIPI_CSI2_MAX_VC	4
+
 
 struct mipi_csi2_info;
 /* mipi csi2 API */
@@ -78,6 +80,15 @@ unsigned int mipi_csi2_set_datatype(struct mipi_csi2_info *info,
 
 unsigned int mipi_csi2_get_datatype(struct mipi_csi2_info *info);
 
+int mipi_csi2_get_vc_bind(struct mipi_csi2_info *info,
+				int ipu_id, unsigned int csi_id);
+
+unsigned int mipi_csi2_set_vc_datatype(struct mipi_csi2_info *info,
+				unsigned int vc, unsigned int datatype);
+
+unsigned int mipi_csi2_get_vc_datatype(struct mipi_csi2_info *info,
+				unsigned int vc);
+
 unsigned int mipi_csi2_dphy_status(struct mipi_csi2_info *info);
 
 unsigned int mipi_csi2_get_error1(struct mipi_csi2_info *info);
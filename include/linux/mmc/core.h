@@ -116,8 +116,15 @@ struct mmc_data {
 
 #define MMC_DATA_WRITE	(1 << 8)
 #define MMC_DATA_READ	(1 << 9)
+/* Extra flags used by CQE */
+#define MMC_DATA_QBR		BIT(10)		/* CQE queue barrier*/
+#define MMC_DATA_PRIO		BIT(11)		/* CQE high priority */
+#define MMC_DATA_REL_WR		BIT(12)		/* Reliable write */
+#define MMC_DATA_DAT_TAG	BIT(13)		/* Tag request */
+#define MMC_DATA_FORCED_PRG	BIT(14)		/* Forced programming */
 
 	unsigned int		bytes_xfered;
+	u32			blk_addr;	/* CQE block address */
 
 	struct mmc_command	*stop;		/* stop command */
 	struct mmc_request	*mrq;		/* associated request */
@@ -142,6 +149,10 @@ struct mmc_request {
 
 	/* Allow other commands during this ongoing data transfer or busy wait */
 	bool			cap_cmd_during_tfr;
+
+	int			tag;		/* CQE task id */
+	/* CQE host tells the issuer that it needs to run recovery */
+	void			(*recovery_notifier)(struct mmc_request *);
 };
 
 struct mmc_card;
@@ -165,6 +176,14 @@ extern int mmc_switch(struct mmc_card *, u8, u8, u8, unsigned int);
 extern int mmc_send_tuning(struct mmc_host *host, u32 opcode, int *cmd_error);
 extern int mmc_get_ext_csd(struct mmc_card *card, u8 **new_ext_csd);
 
+extern int mmc_cqe_start_req(struct mmc_host *host, struct mmc_request *mrq);
+extern void mmc_cqe_post_req(struct mmc_host *host, struct mmc_request *mrq);
+extern void mmc_cqe_request_done(struct mmc_host *host,
+				 struct mmc_request *mrq);
+extern int mmc_cqe_recovery(struct mmc_host *host);
+extern int mmc_cmdq_enable(struct mmc_card *card);
+extern int mmc_cmdq_disable(struct mmc_card *card);
+
 #define MMC_ERASE_ARG		0x00000000
 #define MMC_SECURE_ERASE_ARG	0x80000000
 #define MMC_TRIM_ARG		0x00000001
@@ -195,13 +214,17 @@ extern int mmc_can_reset(struct mmc_card *card);
 extern void mmc_set_data_timeout(struct mmc_data *, const struct mmc_card *);
 extern unsigned int mmc_align_data_size(struct mmc_card *, unsigned int);
 
+extern int __mmc_claim_host_ctx(struct mmc_host *host, struct mmc_ctx *ctx,
+				atomic_t *abort);
 extern int __mmc_claim_host(struct mmc_host *host, atomic_t *abort);
 extern void mmc_release_host(struct mmc_host *host);
 
+extern void mmc_get_card_ctx(struct mmc_card *card, struct mmc_ctx *ctx);
 extern void mmc_get_card(struct mmc_card *card);
 extern void mmc_put_card(struct mmc_card *card);
 
 extern int mmc_flush_cache(struct mmc_card *);
+extern int mmc_barrier_cache(struct mmc_card *);
 
 extern int mmc_detect_card_removed(struct mmc_host *host);
 
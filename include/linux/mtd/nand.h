@@ -95,6 +95,8 @@ int nand_unlock(struct mtd_info *mtd, loff_t ofs, uint64_t len);
 
 /* Extended commands for large page devices */
 #define NAND_CMD_READSTART	0x30
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
 
@@ -180,12 +182,21 @@ enum nand_ecc_algo {
  */
 #define NAND_NEED_SCRAMBLING	0x00002000
 
+/*
+ * Controller can pipeline sequential page reads with the read cache
+ * commands: its ecc.read_page() must only transfer data and change the
+ * read column. nand_scan_tail() drops the flag for chips which do not
+ * advertise read cache support.
+ */
+#define NAND_CACHE_READ		0x00004000
+
 /* Options valid for Samsung large page devices */
 #define NAND_SAMSUNG_LP_OPTIONS NAND_CACHEPRG
 
 /* Macros to identify the above */
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_SUBPAGE_READ(chip) ((chip->options & NAND_SUBPAGE_READ))
+#define NAND_HAS_CACHE_READ(chip) ((chip->options & NAND_CACHE_READ))
 
 /* Non chip related options */
 /* This option skips the bbt scan during initialization. */
@@ -244,6 +255,9 @@ struct nand_chip;
 /* ONFI subfeature parameters length */
 #define ONFI_SUBFEATURE_PARAM_LEN	4
 
+/* ONFI optional commands READ CACHE supported? */
+#define ONFI_OPT_CMD_READ_CACHE		(1 << 1)
+
 /* ONFI optional commands SET/GET FEATURES supported? */
 #define ONFI_OPT_CMD_SET_GET_FEATURES	(1 << 2)
 
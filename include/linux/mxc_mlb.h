@@ -16,6 +16,8 @@
 #ifndef _MXC_MLB_H
 #define _MXC_MLB_H
 
+#include <linux/types.h>
+
 /* define IOCTL command */
 #define MLB_DBG_RUNTIME		_IO('S', 0x09)
 #define MLB_SET_FPS		_IOW('S', 0x10, unsigned int)
@@ -37,6 +39,36 @@
 #define MLB_IRQ_ENABLE		_IO('S', 0x20)
 #define MLB_IRQ_DISABLE		_IO('S', 0x21)
 
+/*!
+ * Zero-copy access to the channel rings, mapped with mmap() at offset 0.
+ * Buffer i of the rx ring is at rx_offset + i * unit_size, likewise for
+ * tx, and holds buf_len bytes on the bus.
+ */
+struct mlb_ring_info {
+	__u32 nodes;
+	__u32 unit_size;
+	__u32 buf_len;
+	__u32 rx_offset;
+	__u32 tx_offset;
+	__u32 map_size;
+};
+
+/*!
+ * count buffers starting at index: filled ones for rx, free ones for tx
+ */
+struct mlb_ring_span {
+	__u32 index;
+	__u32 count;
+};
+
+#define MLB_GET_RING_INFO	_IOR('S', 0x22, struct mlb_ring_info)
+/* poll() and blocking read/write wait for this many buffers, default 1 */
+#define MLB_SET_BATCH		_IOW('S', 0x23, unsigned int)
+#define MLB_RX_ACQUIRE		_IOR('S', 0x24, struct mlb_ring_span)
+#define MLB_RX_RELEASE		_IOW('S', 0x25, unsigned int)
+#define MLB_TX_ACQUIRE		_IOR('S', 0x26, struct mlb_ring_span)
+#define MLB_TX_COMMIT		_IOW('S', 0x27, unsigned int)
+
 /*!
  * MLB event define
  */
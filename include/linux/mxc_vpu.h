@@ -42,6 +42,17 @@ struct vpu_mem_desc {
 	u32 virt_uaddr;		/* virtual user space address */
 };
 
+/*
+ * Export: phy_addr of a VPU_IOC_PHYMEM_ALLOC buffer in, dma-buf fd out.
+ * Import: dma-buf fd in, physical address and size out, stays valid
+ * until VPU_IOC_DMABUF_RELEASE with the same phy_addr or device close.
+ */
+struct vpu_dmabuf_desc {
+	s32 fd;
+	u32 size;
+	dma_addr_t phy_addr;
+};
+
 #define VPU_IOC_MAGIC  'V'
 
 #define VPU_IOC_PHYMEM_ALLOC	_IO(VPU_IOC_MAGIC, 0)
@@ -59,6 +70,9 @@ struct vpu_mem_desc {
 #define VPU_IOC_SET_BITWORK_MEM    _IO(VPU_IOC_MAGIC, 14)
 #define VPU_IOC_PHYMEM_CHECK	_IO(VPU_IOC_MAGIC, 15)
 #define VPU_IOC_LOCK_DEV	_IO(VPU_IOC_MAGIC, 16)
+#define VPU_IOC_PHYMEM_EXPORT	_IO(VPU_IOC_MAGIC, 17)
+#define VPU_IOC_DMABUF_IMPORT	_IO(VPU_IOC_MAGIC, 18)
+#define VPU_IOC_DMABUF_RELEASE	_IO(VPU_IOC_MAGIC, 19)
 
 #define BIT_CODE_RUN			0x000
 #define BIT_CODE_DOWN			0x004
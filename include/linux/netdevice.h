@@ -790,10 +790,52 @@ enum {
 	TC_SETUP_CLSFLOWER,
 	TC_SETUP_MATCHALL,
 	TC_SETUP_CLSBPF,
+	TC_SETUP_CBS,
+	TC_SETUP_TAPRIO,
+	TC_SETUP_ETF,
 };
 
 struct tc_cls_u32_offload;
 
+/* Credit based shaper parameters for one TX queue, slopes in kbit/s and
+ * credits in bytes as configured on the cbs qdisc.
+ */
+struct tc_cbs_qopt_offload {
+	u8 enable;
+	s32 queue;
+	s32 hicredit;
+	s32 locredit;
+	s32 idleslope;
+	s32 sendslope;
+};
+
+/* Gate control list of the taprio qdisc, intervals in nanoseconds and one
+ * gate_mask bit per traffic class. The list repeats every cycle_time
+ * starting at base_time, both on the qdisc clock.
+ */
+struct tc_taprio_sched_entry {
+	u8 command;
+	u32 gate_mask;
+	u32 interval;
+};
+
+struct tc_taprio_qopt_offload {
+	u8 enable;
+	clockid_t clockid;
+	s64 base_time;
+	u64 cycle_time;
+	size_t num_entries;
+	struct tc_taprio_sched_entry entries[0];
+};
+
+/* Launch time transmission on one TX queue, the frames carry their
+ * transmit time in skb->tstamp.
+ */
+struct tc_etf_qopt_offload {
+	u8 enable;
+	s32 queue;
+};
+
 struct tc_to_netdev {
 	unsigned int type;
 	union {
@@ -802,6 +844,9 @@ struct tc_to_netdev {
 		struct tc_cls_flower_offload *cls_flower;
 		struct tc_cls_matchall_offload *cls_mall;
 		struct tc_cls_bpf_offload *cls_bpf;
+		struct tc_cbs_qopt_offload *cbs;
+		struct tc_taprio_qopt_offload *taprio;
+		struct tc_etf_qopt_offload *etf;
 	};
 };
 
@@ -75,6 +75,11 @@ struct pmu_hw_events {
 	 * already have to allocate this struct per cpu.
 	 */
 	struct arm_pmu		*percpu_pmu;
+
+	/*
+	 * Polls the overflow flags of a CPU whose PMU interrupt is unusable.
+	 */
+	struct hrtimer		poll_timer;
 };
 
 enum armpmu_attr_groups {
@@ -88,7 +93,9 @@ struct arm_pmu {
 	struct pmu	pmu;
 	cpumask_t	active_irqs;
 	cpumask_t	supported_cpus;
+	cpumask_t	poll_cpus;
 	int		*irq_affinity;
+	bool		irq_rotate;
 	char		*name;
 	irqreturn_t	(*handle_irq)(int irq_num, void *dev);
 	void		(*enable)(struct perf_event *event);
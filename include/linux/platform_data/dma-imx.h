@@ -58,6 +58,7 @@ struct imx_dma_data {
 	int priority;
 	bool src_dualfifo;
 	bool dst_dualfifo;
+	bool direct_complete; /* complete descriptors in hard IRQ context */
 };
 
 static inline int imx_dma_is_ipu(struct dma_chan *chan)
@@ -76,4 +77,14 @@ static inline int imx_dma_is_general_purpose(struct dma_chan *chan)
 		!strcmp(chan->device->dev->driver->name, "imx-dma");
 }
 
+#if IS_ENABLED(CONFIG_IMX_SDMA)
+int imx_sdma_set_priority(struct dma_chan *chan, unsigned int priority);
+#else
+static inline int imx_sdma_set_priority(struct dma_chan *chan,
+					unsigned int priority)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif
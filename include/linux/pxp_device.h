@@ -44,12 +44,19 @@ struct pxp_buf_obj {
 	unsigned long offset;
 	void *virtual;
 
+	/* set for buffers imported through PXP_IOC_IMPORT_DMABUF */
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+
 	struct hlist_node item;
 };
 
 struct pxp_chan_obj {
 	uint32_t handle;
 	struct dma_chan *chan;
+	/* work queued and its completion not yet collected */
+	atomic_t submitted;
 };
 
 /* File private data */
@@ -64,10 +64,10 @@ void pxp_txd_ack(struct dma_async_tx_descriptor *txd,
 		 struct pxp_channel *pxp_chan);
 
 #ifdef CONFIG_MXC_PXP_CLIENT_DEVICE
-int register_pxp_device(void);
+int register_pxp_device(struct device *dev);
 void unregister_pxp_device(void);
 #else
-static int register_pxp_device(void) { return 0; }
+static int register_pxp_device(struct device *dev) { return 0; }
 static void unregister_pxp_device(void) {}
 #endif
 void pxp_fill(
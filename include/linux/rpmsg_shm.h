@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_RPMSG_SHM_H
+#define _LINUX_RPMSG_SHM_H
+
+#include <linux/err.h>
+#include <linux/types.h>
+
+struct device;
+struct rpmsg_endpoint;
+struct rpmsg_shm_pool;
+
+#define RPMSG_SHM_MAGIC		0x53484d42	/* "SHMB" */
+
+/* descriptor types, see struct rpmsg_shm_desc */
+#define RPMSG_SHM_DATA		0	/* local -> remote, @len bytes valid */
+#define RPMSG_SHM_EMPTY		1	/* local -> remote, to be filled */
+#define RPMSG_SHM_RETURN	2	/* remote -> local, buffer given back */
+
+/**
+ * struct rpmsg_shm_desc - bulk buffer descriptor carried in an rpmsg
+ * @magic:	RPMSG_SHM_MAGIC, tells descriptors from plain messages
+ * @type:	one of RPMSG_SHM_DATA, RPMSG_SHM_EMPTY or RPMSG_SHM_RETURN
+ * @id:		buffer index in the pool, echoed back by the remote
+ * @addr:	bus address of the buffer
+ * @size:	size of the buffer
+ * @len:	bytes of valid data in the buffer
+ *
+ * Sending a descriptor hands the buffer over to the remote, which must
+ * not touch it after sending the RPMSG_SHM_RETURN descriptor with the
+ * same @id. For a returned RPMSG_SHM_EMPTY buffer @len is the number of
+ * bytes the remote wrote.
+ */
+struct rpmsg_shm_desc {
+	u32 magic;
+	u16 type;
+	u16 id;
+	u64 addr;
+	u32 size;
+	u32 len;
+} __packed;
+
+/**
+ * struct rpmsg_shm_buf - bulk buffer allocated from a shared memory pool
+ * @pool:	owning pool
+ * @va:		kernel virtual address
+ * @dma:	bus address, as seen by the remote
+ * @size:	size of the buffer
+ * @len:	bytes of valid data
+ * @id:		index in the pool
+ * @remote:	set while the remote owns the buffer
+ */
+struct rpmsg_shm_buf {
+	struct rpmsg_shm_pool *pool;
+	void *va;
+	dma_addr_t dma;
+	size_t size;
+	size_t len;
+	u16 id;
+	bool remote;
+};
+
+#if IS_ENABLED(CONFIG_RPMSG_SHM)
+
+struct rpmsg_shm_pool *rpmsg_shm_pool_create(struct device *dma_dev,
+					     size_t size,
+					     unsigned int max_bufs);
+void rpmsg_shm_pool_destroy(struct rpmsg_shm_pool *pool);
+
+struct rpmsg_shm_buf *rpmsg_shm_alloc(struct rpmsg_shm_pool *pool,
+				      size_t size);
+void rpmsg_shm_free(struct rpmsg_shm_buf *buf);
+
+int rpmsg_shm_send(struct rpmsg_endpoint *ept, struct rpmsg_shm_buf *buf,
+		   size_t len);
+int rpmsg_shm_post(struct rpmsg_endpoint *ept, struct rpmsg_shm_buf *buf);
+bool rpmsg_shm_is_desc(const void *data, int len);
+struct rpmsg_shm_buf *rpmsg_shm_recv(struct rpmsg_shm_pool *pool,
+				     const void *data, int len);
+
+#else
+
+static inline struct rpmsg_shm_pool *
+rpmsg_shm_pool_create(struct device *dma_dev, size_t size,
+		      unsigned int max_bufs)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void rpmsg_shm_pool_destroy(struct rpmsg_shm_pool *pool)
+{
+}
+
+static inline struct rpmsg_shm_buf *
+rpmsg_shm_alloc(struct rpmsg_shm_pool *pool, size_t size)
+{
+	return NULL;
+}
+
+static inline void rpmsg_shm_free(struct rpmsg_shm_buf *buf)
+{
+}
+
+static inline int rpmsg_shm_send(struct rpmsg_endpoint *ept,
+				 struct rpmsg_shm_buf *buf, size_t len)
+{
+	return -ENODEV;
+}
+
+static inline int rpmsg_shm_post(struct rpmsg_endpoint *ept,
+				 struct rpmsg_shm_buf *buf)
+{
+	return -ENODEV;
+}
+
+static inline bool rpmsg_shm_is_desc(const void *data, int len)
+{
+	return false;
+}
+
+static inline struct rpmsg_shm_buf *
+rpmsg_shm_recv(struct rpmsg_shm_pool *pool, const void *data, int len)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+#endif /* CONFIG_RPMSG_SHM */
+
+#endif /* _LINUX_RPMSG_SHM_H */
@@ -61,6 +61,7 @@ struct ci_hdrc_platform_data {
 #define CI_HDRC_IMX_IS_HSIC		BIT(13)
 /* need request pmqos during low power */
 #define CI_HDRC_PMQOS			BIT(14)
+#define CI_HDRC_OVERRIDE_TXFIFO_THRES	BIT(15)
 	enum usb_dr_mode	dr_mode;
 #define CI_HDRC_CONTROLLER_RESET_EVENT		0
 #define CI_HDRC_CONTROLLER_STOPPED_EVENT	1
@@ -80,6 +81,8 @@ struct ci_hdrc_platform_data {
 	u32			ahb_burst_config;
 	u32			tx_burst_size;
 	u32			rx_burst_size;
+	/* host TX FIFO fill level before a transfer starts, in bursts */
+	u32			txfifo_thres;
 
 	/* VBUS and ID signal state tracking, using extcon framework */
 	struct ci_hdrc_cable		vbus_extcon;
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_VIRTIO_RPMSG_H
+#define _LINUX_VIRTIO_RPMSG_H
+
+#include <linux/types.h>
+
+/* The transport provides buffer geometry in struct virtio_rpmsg_config */
+#define VIRTIO_RPMSG_F_BUFSZ	1
+
+/**
+ * struct virtio_rpmsg_config - rpmsg virtio device configuration space
+ * @num_bufs:	total number of buffers, half of which are used for rx
+ * @buf_size:	size of each buffer, including the rpmsg header
+ *
+ * Only valid if VIRTIO_RPMSG_F_BUFSZ was negotiated, otherwise the bus
+ * uses 512 buffers of 512 bytes.
+ */
+struct virtio_rpmsg_config {
+	__u32 num_bufs;
+	__u32 buf_size;
+} __packed;
+
+#endif /* _LINUX_VIRTIO_RPMSG_H */
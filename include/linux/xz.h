@@ -233,6 +233,57 @@ XZ_EXTERN void xz_dec_reset(struct xz_dec *s);
  */
 XZ_EXTERN void xz_dec_end(struct xz_dec *s);
 
+#if defined(__KERNEL__) && !defined(XZ_PREBOOT)
+/**
+ * struct xz_dec_mt - Opaque type to hold the parallel XZ decoder state
+ */
+struct xz_dec_mt;
+
+/**
+ * xz_dec_mt_init() - Allocate a decoder that decodes Blocks in parallel
+ * @threads:    Number of Blocks to decode at the same time, or zero for
+ *              one per online CPU
+ *
+ * A Stream written in several Blocks with their sizes in the Block Headers,
+ * as xz --threads and xz --block-size do, can be decoded one Block per CPU.
+ * Other Streams are decoded sequentially. Decoding is always single-call,
+ * see XZ_SINGLE. Returns NULL if memory allocation fails.
+ */
+XZ_EXTERN struct xz_dec_mt *xz_dec_mt_init(unsigned int threads);
+
+/**
+ * xz_dec_mt_size() - Get the uncompressed size of a Stream
+ * @s:          Decoder state allocated using xz_dec_mt_init()
+ * @in:         Beginning of the Stream
+ * @in_size:    Size of the input buffer, which may go beyond the Stream
+ *
+ * Returns the uncompressed size recorded in the Block Headers, or zero if
+ * the Stream cannot be decoded in parallel. Only the headers are looked at,
+ * so a non-zero result doesn't guarantee that decoding will succeed.
+ */
+XZ_EXTERN uint64_t xz_dec_mt_size(struct xz_dec_mt *s, const uint8_t *in,
+				  size_t in_size);
+
+/**
+ * xz_dec_mt_run() - Decode one Stream, in parallel if possible
+ * @s:          Decoder state allocated using xz_dec_mt_init()
+ * @b:          Input and output buffers
+ *
+ * This works like xz_dec_run() in single-call mode: on XZ_STREAM_END,
+ * b->in_pos points right after the Stream and b->out_pos after its data.
+ * On other return values they are not modified. Must not be called from
+ * atomic context.
+ */
+XZ_EXTERN enum xz_ret xz_dec_mt_run(struct xz_dec_mt *s, struct xz_buf *b);
+
+/**
+ * xz_dec_mt_end() - Free the memory allocated for the decoder state
+ * @s:          Decoder state allocated using xz_dec_mt_init(). If s is NULL,
+ *              this function does nothing.
+ */
+XZ_EXTERN void xz_dec_mt_end(struct xz_dec_mt *s);
+#endif
+
 /*
  * Standalone build (userspace build or in-kernel build for boot time use)
  * needs a CRC32 implementation. For normal in-kernel use, kernel's own
@@ -0,0 +1,59 @@
+#ifndef __ZSTD_H__
+#define __ZSTD_H__
+/*
+ * Zstandard compression for the kernel
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+
+/* working memory needed by zstd_compress() and zstd_decompress() */
+#define ZSTD_MEM_COMPRESS	(256 * 1024)
+#define ZSTD_MEM_DECOMPRESS	(12 * 1024)
+
+/*
+ * zstd_compressbound()
+ *	Provides the maximum size that zstd may output in a "worst case"
+ *	scenario (input data not compressible)
+ */
+static inline size_t zstd_compressbound(size_t isize)
+{
+	return isize + (isize >> 8) + 32;
+}
+
+/*
+ * zstd_compress()
+ *	src	: source address of the original data
+ *	src_len : size of the original data
+ *	dst	: output buffer address of the compressed data
+ *	dst_len : is the size of dst on entry and the size of the
+ *		  compressed data, a single zstd frame, on return
+ *	wrkmem	: address of the working memory.
+ *		  This requires 'wrkmem' of size ZSTD_MEM_COMPRESS.
+ *	return	: 0 on success, -ENOSPC if dst is too small for the frame
+ *	note	: The output fits whenever dst has zstd_compressbound(src_len)
+ *		  bytes.
+ */
+int zstd_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * zstd_decompress()
+ *	src	: source address of the compressed data, one or more frames
+ *	src_len : is the input size, all of it is decoded
+ *	dst	: output buffer address of the decompressed data
+ *	dst_len : is the size of dst on entry and the decompressed size on
+ *		  return
+ *	wrkmem	: address of the working memory.
+ *		  This requires 'wrkmem' of size ZSTD_MEM_DECOMPRESS.
+ *	return	: 0 on success, -EINVAL on malformed input, -ENOSPC if dst is
+ *		  too small, -EOPNOTSUPP for frames that need a dictionary
+ */
+int zstd_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+#endif
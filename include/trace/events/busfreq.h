@@ -0,0 +1,62 @@
+/*
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM busfreq
+
+#if !defined(_TRACE_BUSFREQ_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BUSFREQ_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(busfreq_transition,
+
+	TP_PROTO(int from, int to, u64 latency_ns),
+
+	TP_ARGS(from, to, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(int, from)
+		__field(int, to)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->from = from;
+		__entry->to = to;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("mode %d -> %d latency_ns=%llu",
+		  __entry->from, __entry->to, __entry->latency_ns)
+);
+
+/* Time the other CPUs spent parked in WFE while the DDR rate changed */
+TRACE_EVENT(busfreq_ddr_update,
+
+	TP_PROTO(int rate, u64 parked_ns),
+
+	TP_ARGS(rate, parked_ns),
+
+	TP_STRUCT__entry(
+		__field(int, rate)
+		__field(u64, parked_ns)
+	),
+
+	TP_fast_assign(
+		__entry->rate = rate;
+		__entry->parked_ns = parked_ns;
+	),
+
+	TP_printk("rate=%d parked_ns=%llu",
+		  __entry->rate, __entry->parked_ns)
+);
+
+#endif /* _TRACE_BUSFREQ_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -126,6 +126,48 @@ DEFINE_EVENT(clk_rate, clk_set_rate_complete,
 	TP_ARGS(core, rate)
 );
 
+/* time from the call to the return, waiting for the locks included */
+DECLARE_EVENT_CLASS(clk_latency,
+
+	TP_PROTO(struct clk_core *core, u64 ns),
+
+	TP_ARGS(core, ns),
+
+	TP_STRUCT__entry(
+		__string(        name,           core->name                )
+		__field(u64,                     ns                        )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, core->name);
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s %llu ns", __get_str(name),
+		  (unsigned long long)__entry->ns)
+);
+
+DEFINE_EVENT(clk_latency, clk_prepare_latency,
+
+	TP_PROTO(struct clk_core *core, u64 ns),
+
+	TP_ARGS(core, ns)
+);
+
+DEFINE_EVENT(clk_latency, clk_enable_latency,
+
+	TP_PROTO(struct clk_core *core, u64 ns),
+
+	TP_ARGS(core, ns)
+);
+
+DEFINE_EVENT(clk_latency, clk_set_rate_latency,
+
+	TP_PROTO(struct clk_core *core, u64 ns),
+
+	TP_ARGS(core, ns)
+);
+
 DECLARE_EVENT_CLASS(clk_parent,
 
 	TP_PROTO(struct clk_core *core, struct clk_core *parent),
@@ -34,7 +34,19 @@ struct dma_buf_sync {
 #define DMA_BUF_SYNC_VALID_FLAGS_MASK \
 	(DMA_BUF_SYNC_RW | DMA_BUF_SYNC_END)
 
+/*
+ * Same as struct dma_buf_sync, limited to len bytes from offset. The
+ * exporter may round the range out to its cache maintenance granularity.
+ */
+struct dma_buf_sync_partial {
+	__u64 flags;
+	__u64 offset;
+	__u64 len;
+};
+
 #define DMA_BUF_BASE		'b'
 #define DMA_BUF_IOCTL_SYNC	_IOW(DMA_BUF_BASE, 0, struct dma_buf_sync)
+#define DMA_BUF_IOCTL_SYNC_PARTIAL \
+	_IOW(DMA_BUF_BASE, 8, struct dma_buf_sync_partial)
 
 #endif
@@ -56,6 +56,7 @@ struct sockaddr_ll {
 #define PACKET_QDISC_BYPASS		20
 #define PACKET_ROLLOVER_STATS		21
 #define PACKET_FANOUT_DATA		22
+#define PACKET_TX_STATS			23
 
 #define PACKET_FANOUT_HASH		0
 #define PACKET_FANOUT_LB		1
@@ -85,6 +86,16 @@ struct tpacket_rollover_stats {
 	__aligned_u64	tp_failed;
 };
 
+/* Tx-ring frames handed to the driver, and how many times it was told
+ * to start transmitting
+ */
+struct tpacket_tx_stats {
+	__aligned_u64	tp_packets;
+	__aligned_u64	tp_bytes;
+	__aligned_u64	tp_errors;
+	__aligned_u64	tp_flushes;
+};
+
 union tpacket_stats_u {
 	struct tpacket_stats stats1;
 	struct tpacket_stats_v3 stats3;
@@ -39,6 +39,7 @@ typedef unsigned char bool;
 #define uint8_t unsigned char
 #define u32 unsigned int
 #define u8 unsigned char
+#define u64 unsigned long long
 #define __u32 u32
 #endif
 
@@ -260,6 +261,30 @@ struct ipu_task {
 	int	timeout;
 };
 
+/*
+ * dma-buf sharing:
+ * IPU_EXPORT_DMABUF - paddr of an IPU_ALLOC buffer in, dma-buf fd out
+ * IPU_IMPORT_DMABUF - dma-buf fd in, address to use in ipu_task out; the
+ *                     buffer stays mapped until IPU_RELEASE_DMABUF or close
+ */
+struct ipu_dmabuf {
+	int		fd;
+	u32		flags;	/* must be 0 */
+	dma_addr_t	paddr;
+};
+
+/*
+ * Up to IPU_TASK_BATCH_MAX tasks queued in one go. The ioctl returns once
+ * all of them are done, with the error of the first one that failed.
+ */
+#define IPU_TASK_BATCH_MAX	16
+
+struct ipu_task_batch {
+	u32	num;
+	u32	reserved;
+	u64	tasks;	/* user pointer to an array of struct ipu_task */
+};
+
 enum {
 	IPU_CHECK_OK = 0,
 	IPU_CHECK_WARN_INPUT_OFFS_NOT8ALIGN = 0x1,
@@ -289,5 +314,9 @@ enum {
 #define IPU_QUEUE_TASK		_IOW('I', 0x2, struct ipu_task)
 #define IPU_ALLOC		_IOWR('I', 0x3, int)
 #define IPU_FREE		_IOW('I', 0x4, int)
+#define IPU_QUEUE_TASK_BATCH	_IOW('I', 0x5, struct ipu_task_batch)
+#define IPU_EXPORT_DMABUF	_IOWR('I', 0x6, struct ipu_dmabuf)
+#define IPU_IMPORT_DMABUF	_IOWR('I', 0x7, struct ipu_dmabuf)
+#define IPU_RELEASE_DMABUF	_IOW('I', 0x8, struct ipu_dmabuf)
 
 #endif
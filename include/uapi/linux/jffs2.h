@@ -46,6 +46,7 @@
 #define JFFS2_COMPR_DYNRUBIN	0x05
 #define JFFS2_COMPR_ZLIB	0x06
 #define JFFS2_COMPR_LZO		0x07
+#define JFFS2_COMPR_ZSTD	0x08
 /* Compatibility flags. */
 #define JFFS2_COMPAT_MASK 0xc000      /* What do to if an unknown nodetype is found */
 #define JFFS2_NODE_ACCURATE 0x2000
@@ -68,6 +69,9 @@
 #define JFFS2_NODETYPE_XATTR (JFFS2_FEATURE_INCOMPAT | JFFS2_NODE_ACCURATE | 8)
 #define JFFS2_NODETYPE_XREF (JFFS2_FEATURE_INCOMPAT | JFFS2_NODE_ACCURATE | 9)
 
+/* Read-only compatible, as the checkpoint has to be obsoleted on write */
+#define JFFS2_NODETYPE_CHECKPOINT (JFFS2_FEATURE_ROCOMPAT | JFFS2_NODE_ACCURATE | 10)
+
 /* XATTR Related */
 #define JFFS2_XPREFIX_USER		1	/* for "user." */
 #define JFFS2_XPREFIX_SECURITY		2	/* for "security." */
@@ -78,7 +82,6 @@
 #define JFFS2_ACL_VERSION		0x0001
 
 // Maybe later...
-//#define JFFS2_NODETYPE_CHECKPOINT (JFFS2_FEATURE_RWCOMPAT_DELETE | JFFS2_NODE_ACCURATE | 3)
 //#define JFFS2_NODETYPE_OPTIONS (JFFS2_FEATURE_RWCOMPAT_COPY | JFFS2_NODE_ACCURATE | 4)
 
 
@@ -204,6 +207,22 @@ struct jffs2_raw_summary
 	jint32_t sum[0]; 	/* inode summary info */
 };
 
+struct jffs2_raw_checkpoint
+{
+	jint16_t magic;
+	jint16_t nodetype;	/* = JFFS2_NODETYPE_CHECKPOINT */
+	jint32_t totlen;
+	jint32_t hdr_crc;
+	jint32_t part;		/* index of this part of the checkpoint */
+	jint32_t nr_parts;	/* number of parts */
+	jint32_t next;		/* offset of the next part, 0xFFFFFFFF = last */
+	jint32_t total_len;	/* length of the data of all parts */
+	jint32_t data_len;	/* length of the data in this part */
+	jint32_t data_crc;	/* crc of the data in this part */
+	jint32_t node_crc;	/* node crc */
+	uint8_t data[0];
+};
+
 union jffs2_node_union
 {
 	struct jffs2_raw_inode i;
@@ -28,6 +28,9 @@
 #define ASRC_STOP_CONV		_IOW(ASRC_IOC_MAGIC, 5, enum asrc_pair_index)
 #define ASRC_STATUS		_IOW(ASRC_IOC_MAGIC, 6, struct asrc_status_flags)
 #define ASRC_FLUSH		_IOW(ASRC_IOC_MAGIC, 7, enum asrc_pair_index)
+#define ASRC_QUERYBUF		_IOWR(ASRC_IOC_MAGIC, 8, struct asrc_querybuf)
+#define ASRC_CONVERT_MAPPED	\
+	_IOWR(ASRC_IOC_MAGIC, 9, struct asrc_convert_buffer)
 
 enum asrc_pair_index {
 	ASRC_INVALID_PAIR = -1,
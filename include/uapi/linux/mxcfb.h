@@ -109,6 +109,7 @@ struct mxcfb_rect {
 #define EPDC_FLAG_USE_DITHERING_Y1		0x2000
 #define EPDC_FLAG_USE_DITHERING_Y4		0x4000
 #define EPDC_FLAG_USE_REGAL				0x8000
+#define EPDC_FLAG_PEN_UPDATE			0x10000
 
 enum mxcfb_dithering_mode {
 	EPDC_FLAG_USE_DITHERING_PASSTHROUGH = 0x0,
@@ -166,6 +167,32 @@ struct mxcfb_csc_matrix {
 	int param[5][3];
 };
 
+/*
+ * Non-blocking pan. xoffset/yoffset are those of FBIOPAN_DISPLAY. Up to
+ * two pans may be queued ahead of the buffer on screen; a further one
+ * waits for the oldest to be scanned out. On return release_fence is a
+ * sync_file fd signalled once the panned buffer is no longer scanned out,
+ * i.e. when a later pan has replaced it on screen.
+ */
+struct mxcfb_pan_async {
+	__u32 xoffset;
+	__u32 yoffset;
+	__s32 release_fence;
+	__u32 reserved;
+};
+
+/*
+ * missed_vblanks counts the refresh periods between two consecutive
+ * non-blocking flips, less one, which showed the previous buffer again.
+ * Gaps over one second are taken as the client being idle.
+ */
+struct mxcfb_pan_stats {
+	__u32 flips;
+	__u32 missed_vblanks;
+	__u32 queue_full;
+	__u32 queued;
+};
+
 #define MXCFB_WAIT_FOR_VSYNC	_IOW('F', 0x20, u_int32_t)
 #define MXCFB_SET_GBL_ALPHA     _IOW('F', 0x21, struct mxcfb_gbl_alpha)
 #define MXCFB_SET_CLR_KEY       _IOW('F', 0x22, struct mxcfb_color_key)
@@ -182,6 +209,8 @@ struct mxcfb_csc_matrix {
 #define MXCFB_SET_GPU_SPLIT_FMT	_IOW('F', 0x2F, struct mxcfb_gpu_split_fmt)
 #define MXCFB_SET_PREFETCH	_IOW('F', 0x30, int)
 #define MXCFB_GET_PREFETCH	_IOR('F', 0x31, int)
+#define MXCFB_PAN_DISPLAY_ASYNC	_IOWR('F', 0x37, struct mxcfb_pan_async)
+#define MXCFB_GET_PAN_STATS	_IOR('F', 0x38, struct mxcfb_pan_stats)
 
 /* IOCTLs for E-ink panel updates */
 #define MXCFB_SET_WAVEFORM_MODES	_IOW('F', 0x2B, struct mxcfb_waveform_modes)
@@ -39,6 +39,31 @@ struct pxp_mem_flush {
 	unsigned int type;
 };
 
+/*
+ * Queue num configurations on one channel and start it. Each entry of
+ * the user array at configs is a struct pxp_config_data; the handle in
+ * the entries is ignored. The whole batch completes at once, which is
+ * reported through WAIT4CMPLT or poll() on the device.
+ */
+#define PXP_BATCH_MAX	64
+
+struct pxp_batch_data {
+	unsigned int handle;
+	unsigned int num;
+	unsigned long long configs;
+};
+
+/*
+ * Import a physically contiguous dma-buf. The returned handle is
+ * released with PUT_PHYMEM and phys_addr goes into the layer paddr.
+ */
+struct pxp_dmabuf_desc {
+	int fd;
+	unsigned int handle;
+	unsigned int size;
+	dma_addr_t phys_addr;
+};
+
 #define PXP_IOC_MAGIC  'P'
 
 #define PXP_IOC_GET_CHAN      _IOR(PXP_IOC_MAGIC, 0, struct pxp_mem_desc)
@@ -49,6 +74,8 @@ struct pxp_mem_flush {
 #define PXP_IOC_PUT_PHYMEM    _IOW(PXP_IOC_MAGIC, 5, struct pxp_mem_desc)
 #define PXP_IOC_WAIT4CMPLT    _IOWR(PXP_IOC_MAGIC, 6, struct pxp_mem_desc)
 #define PXP_IOC_FLUSH_PHYMEM   _IOR(PXP_IOC_MAGIC, 7, struct pxp_mem_flush)
+#define PXP_IOC_SUBMIT_BATCH  _IOW(PXP_IOC_MAGIC, 8, struct pxp_batch_data)
+#define PXP_IOC_IMPORT_DMABUF _IOWR(PXP_IOC_MAGIC, 9, struct pxp_dmabuf_desc)
 
 /* Memory types supported*/
 #define MEMORY_TYPE_UNCACHED 0x0
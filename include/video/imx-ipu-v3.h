@@ -389,6 +389,26 @@ int ipu_smfc_map_channel(struct ipu_smfc *smfc, int csi_id, int mipi_id);
 int ipu_smfc_set_burstsize(struct ipu_smfc *smfc, int burstsize);
 int ipu_smfc_set_watermark(struct ipu_smfc *smfc, u32 set_level, u32 clr_level);
 
+/*
+ * IPU Prefetch Resolve Gasket (PRG) and Engine (PRE) functions, i.MX6QP only
+ */
+#define IPU_PRE_MAX_WIDTH	1920
+#define IPU_PRE_BLOCK_WIDTH	16
+#define IPU_PRE_BLOCK_HEIGHT	4
+
+bool ipu_prg_present(struct ipu_soc *ipu);
+bool ipu_prg_format_supported(struct ipu_soc *ipu, u32 format, u64 modifier);
+int ipu_prg_channel_configure(struct ipuv3_channel *ipu_chan,
+			      unsigned int axi_id, unsigned int width,
+			      unsigned int height, unsigned int x,
+			      unsigned int y, unsigned int stride,
+			      unsigned int cpp, u64 modifier,
+			      unsigned long bufaddr, unsigned long *eba,
+			      unsigned int *ipu_stride);
+void ipu_prg_channel_update(struct ipuv3_channel *ipu_chan,
+			    unsigned long bufaddr);
+void ipu_prg_channel_disable(struct ipuv3_channel *ipu_chan);
+
 enum ipu_color_space ipu_drm_fourcc_to_colorspace(u32 drm_fourcc);
 enum ipu_color_space ipu_pixelformat_to_colorspace(u32 pixelformat);
 enum ipu_color_space ipu_mbus_code_to_colorspace(u32 mbus_code);
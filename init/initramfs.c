@@ -447,6 +447,59 @@ static unsigned long my_inptr; /* index of next byte to be processed in inbuf */
 
 #include <linux/decompress/generic.h>
 
+#if defined(CONFIG_XZ_DEC_MT) && IS_BUILTIN(CONFIG_XZ_DEC)
+#include <linux/vmalloc.h>
+#include <linux/xz.h>
+
+/*
+ * An xz archive written in several Blocks, by xz --threads for example,
+ * is decoded on all CPUs into one buffer which is then unpacked. Returns
+ * false to leave the archive to the streaming decompressor.
+ */
+static bool __init unpack_xz_mt(char *buf, unsigned long len)
+{
+	struct xz_dec_mt *s;
+	struct xz_buf b;
+	u64 size;
+	bool done = false;
+
+	if (len < 6 || memcmp(buf, "\3757zXZ", 6))
+		return false;
+
+	s = xz_dec_mt_init(0);
+	if (!s)
+		return false;
+
+	size = xz_dec_mt_size(s, buf, len);
+	if (!size || size > ULONG_MAX)
+		goto out;
+
+	b.out = vmalloc(size);
+	if (!b.out)
+		goto out;
+
+	b.in = buf;
+	b.in_pos = 0;
+	b.in_size = len;
+	b.out_pos = 0;
+	b.out_size = size;
+	if (xz_dec_mt_run(s, &b) == XZ_STREAM_END) {
+		flush_buffer(b.out, b.out_pos);
+		my_inptr = b.in_pos;
+		done = true;
+	}
+	vfree(b.out);
+out:
+	xz_dec_mt_end(s);
+	return done;
+}
+#else
+static inline bool unpack_xz_mt(char *buf, unsigned long len)
+{
+	return false;
+}
+#endif
+
 static char * __init unpack_to_rootfs(char *buf, unsigned long len)
 {
 	long written;
@@ -482,7 +535,9 @@ static char * __init unpack_to_rootfs(char *buf, unsigned long len)
 		this_header = 0;
 		decompress = decompress_method(buf, len, &compress_name);
 		pr_debug("Detected %s compressed data\n", compress_name);
-		if (decompress) {
+		if (unpack_xz_mt(buf, len)) {
+			pr_debug("Decoded it in parallel\n");
+		} else if (decompress) {
 			int res = decompress(buf, len, NULL, flush_buffer, NULL,
 				   &my_inptr, error);
 			if (res)
@@ -0,0 +1,216 @@
+/*
+ * linux/kernel/irq/balance.c
+ *
+ * Copyright 2017 NXP
+ *
+ * Rate based balancing of device interrupts.
+ *
+ * Interrupts which are left to the default affinity end up on the first
+ * online CPU. Every interval the interrupt rates are sampled from kstat
+ * and those above the threshold are pinned, the busiest first, to the
+ * CPU which has the lowest interrupt load so far. An interrupt stays where
+ * it is unless that saves at least half of its rate.
+ *
+ * Interrupts whose affinity was restricted by user space or by a driver,
+ * per CPU interrupts and kernel managed ones are left alone.
+ */
+
+#define pr_fmt(fmt) "genirq/balance: " fmt
+
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "irq_balance."
+
+struct irq_balance_entry {
+	unsigned int	irq;
+	unsigned int	rate;
+	unsigned int	cpu;
+};
+
+static unsigned int irq_balance_interval_ms = 2000;
+static unsigned int irq_balance_threshold = 1000;
+
+static struct delayed_work irq_balance_work;
+static cpumask_var_t irq_balance_cpus;
+static unsigned long irq_balance_last;
+static bool irq_balance_ready;
+static DEFINE_PER_CPU(unsigned long, irq_balance_load);
+
+static void irq_balance_schedule(void)
+{
+	unsigned int ms = READ_ONCE(irq_balance_interval_ms);
+
+	if (ms)
+		mod_delayed_work(system_wq, &irq_balance_work,
+				 msecs_to_jiffies(ms));
+}
+
+static int irq_balance_set_interval(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && irq_balance_ready)
+		irq_balance_schedule();
+
+	return ret;
+}
+
+static const struct kernel_param_ops irq_balance_interval_ops = {
+	.set	= irq_balance_set_interval,
+	.get	= param_get_uint,
+};
+
+module_param_cb(interval_ms, &irq_balance_interval_ops,
+		&irq_balance_interval_ms, 0644);
+MODULE_PARM_DESC(interval_ms, "Sampling interval in ms, 0 stops balancing");
+module_param_named(threshold, irq_balance_threshold, uint, 0644);
+MODULE_PARM_DESC(threshold, "Interrupts per second above which an irq is moved");
+
+/*
+ * Samples the rate of @desc and tells whether the balancer may place it.
+ * Called with desc->lock held.
+ */
+static bool irq_balance_sample(struct irq_desc *desc, unsigned int irq,
+			       unsigned long elapsed,
+			       struct irq_balance_entry *e)
+{
+	struct irq_data *d = irq_desc_get_irq_data(desc);
+	const struct cpumask *mask = desc->irq_common_data.affinity;
+	unsigned int count = kstat_irqs(irq);
+	unsigned int delta = count - desc->balance_count;
+
+	desc->balance_count = count;
+
+	if (!desc->action || !irqd_can_balance(d) ||
+	    irqd_affinity_is_managed(d) ||
+	    !d->chip || !d->chip->irq_set_affinity)
+		return false;
+
+	/* somebody else changed the affinity of an irq we placed */
+	if (desc->balance_cpu >= 0 &&
+	    !cpumask_equal(mask, cpumask_of(desc->balance_cpu)))
+		desc->balance_cpu = -1;
+
+	if (desc->balance_cpu < 0 && !cpumask_subset(irq_balance_cpus, mask))
+		return false;
+
+	e->irq = irq;
+	e->rate = div_u64((u64)delta * MSEC_PER_SEC, elapsed);
+	e->cpu = cpumask_any_and(mask, irq_balance_cpus);
+
+	return e->cpu < nr_cpu_ids;
+}
+
+static int irq_balance_cmp(const void *a, const void *b)
+{
+	const struct irq_balance_entry *ea = a, *eb = b;
+
+	if (ea->rate == eb->rate)
+		return 0;
+
+	return ea->rate > eb->rate ? -1 : 1;
+}
+
+static unsigned int irq_balance_pick(unsigned int cur, unsigned int rate)
+{
+	unsigned int cpu, best = cur;
+
+	for_each_cpu(cpu, irq_balance_cpus)
+		if (per_cpu(irq_balance_load, cpu) <
+		    per_cpu(irq_balance_load, best))
+			best = cpu;
+
+	if (per_cpu(irq_balance_load, cur) <=
+	    per_cpu(irq_balance_load, best) + rate / 2)
+		best = cur;
+
+	return best;
+}
+
+static void irq_balance_fn(struct work_struct *work)
+{
+	struct irq_balance_entry *entries;
+	unsigned long now = jiffies;
+	unsigned long elapsed;
+	unsigned int i, n = 0;
+	struct irq_desc *desc;
+	int irq, cpu;
+
+	elapsed = jiffies_to_msecs(now - irq_balance_last) ? : 1;
+	irq_balance_last = now;
+
+	irq_lock_sparse();
+
+	entries = kmalloc_array(nr_irqs, sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		goto out;
+
+	cpumask_and(irq_balance_cpus, irq_default_affinity, cpu_online_mask);
+
+	for_each_irq_desc(irq, desc) {
+		raw_spin_lock_irq(&desc->lock);
+		if (irq_balance_sample(desc, irq, elapsed, &entries[n]))
+			n++;
+		raw_spin_unlock_irq(&desc->lock);
+	}
+
+	sort(entries, n, sizeof(*entries), irq_balance_cmp, NULL);
+
+	/* quiet interrupts stay where they are, only their load counts */
+	for_each_possible_cpu(cpu)
+		per_cpu(irq_balance_load, cpu) = 0;
+	for (i = 0; i < n; i++)
+		if (entries[i].rate < irq_balance_threshold)
+			per_cpu(irq_balance_load, entries[i].cpu) +=
+				entries[i].rate;
+
+	for (i = 0; i < n && entries[i].rate >= irq_balance_threshold; i++) {
+		struct irq_balance_entry *e = &entries[i];
+
+		desc = irq_to_desc(e->irq);
+		cpu = irq_balance_pick(e->cpu, e->rate);
+		per_cpu(irq_balance_load, cpu) += e->rate;
+
+		if (cpu == desc->balance_cpu)
+			continue;
+
+		if (irq_set_affinity(e->irq, cpumask_of(cpu)))
+			continue;
+
+		desc->balance_cpu = cpu;
+		pr_debug("irq %u (%u/s) moved to CPU%d\n",
+			 e->irq, e->rate, cpu);
+	}
+
+	kfree(entries);
+out:
+	irq_unlock_sparse();
+
+	irq_balance_schedule();
+}
+
+static int __init irq_balance_init(void)
+{
+	if (!zalloc_cpumask_var(&irq_balance_cpus, GFP_KERNEL))
+		return -ENOMEM;
+
+	INIT_DELAYED_WORK(&irq_balance_work, irq_balance_fn);
+	irq_balance_last = jiffies;
+	irq_balance_ready = true;
+	irq_balance_schedule();
+
+	return 0;
+}
+late_initcall(irq_balance_init);
@@ -12,6 +12,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/cpufreq.h>
+#include <linux/pm_qos.h>
 #include <linux/slab.h>
 #include <trace/events/power.h>
 
@@ -20,6 +21,7 @@
 struct sugov_tunables {
 	struct gov_attr_set attr_set;
 	unsigned int rate_limit_us;
+	unsigned int bus_bw_mbps;
 };
 
 struct sugov_policy {
@@ -41,6 +43,10 @@ struct sugov_policy {
 	bool work_in_progress;
 
 	bool need_freq_update;
+
+	/* Memory bandwidth vote following next_freq, in MB/s. */
+	struct pm_qos_request bus_qos;
+	unsigned int bus_vote;
 };
 
 struct sugov_cpu {
@@ -61,6 +67,48 @@ static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
 
 /************************ Governor internals ***********************/
 
+#define SUGOV_BUS_VOTE_STEPS	8
+
+/*
+ * The bus vote scales with the requested frequency and is rounded up to a
+ * few steps so that small frequency changes do not touch PM QoS.  An IO-wait
+ * boost or an RT/DL task request cpuinfo.max_freq and so the whole
+ * bandwidth.
+ */
+static unsigned int sugov_bus_vote(struct sugov_policy *sg_policy,
+				   unsigned int freq)
+{
+	unsigned int max_f = sg_policy->policy->cpuinfo.max_freq;
+	unsigned int step;
+
+	freq = min(freq, max_f);
+	step = DIV_ROUND_UP(freq * SUGOV_BUS_VOTE_STEPS, max_f);
+
+	return sg_policy->tunables->bus_bw_mbps * step / SUGOV_BUS_VOTE_STEPS;
+}
+
+static bool sugov_bus_vote_changed(struct sugov_policy *sg_policy)
+{
+	return sg_policy->tunables->bus_bw_mbps &&
+	       sugov_bus_vote(sg_policy, sg_policy->next_freq) !=
+			sg_policy->bus_vote;
+}
+
+/* pm_qos_update_request() runs blocking notifiers, process context only. */
+static void sugov_update_bus_vote(struct sugov_policy *sg_policy)
+{
+	unsigned int vote = 0;
+
+	if (sg_policy->tunables->bus_bw_mbps)
+		vote = sugov_bus_vote(sg_policy, sg_policy->next_freq);
+
+	if (vote == sg_policy->bus_vote)
+		return;
+
+	sg_policy->bus_vote = vote;
+	pm_qos_update_request(&sg_policy->bus_qos, vote);
+}
+
 static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 {
 	s64 delta_ns;
@@ -101,6 +149,12 @@ static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
 
 		policy->cur = next_freq;
 		trace_cpu_frequency(next_freq, smp_processor_id());
+
+		/* The bus vote still has to go through the worker. */
+		if (sugov_bus_vote_changed(sg_policy)) {
+			sg_policy->work_in_progress = true;
+			irq_work_queue(&sg_policy->irq_work);
+		}
 	} else if (sg_policy->next_freq != next_freq) {
 		sg_policy->next_freq = next_freq;
 		sg_policy->work_in_progress = true;
@@ -296,8 +350,10 @@ static void sugov_work(struct work_struct *work)
 	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy, work);
 
 	mutex_lock(&sg_policy->work_lock);
-	__cpufreq_driver_target(sg_policy->policy, sg_policy->next_freq,
-				CPUFREQ_RELATION_L);
+	if (!sg_policy->policy->fast_switch_enabled)
+		__cpufreq_driver_target(sg_policy->policy, sg_policy->next_freq,
+					CPUFREQ_RELATION_L);
+	sugov_update_bus_vote(sg_policy);
 	mutex_unlock(&sg_policy->work_lock);
 
 	sg_policy->work_in_progress = false;
@@ -346,10 +402,41 @@ static ssize_t store_rate_limit_us(struct gov_attr_set *attr_set,
 	return count;
 }
 
+static ssize_t show_bus_bw_mbps(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->bus_bw_mbps);
+}
+
+static ssize_t store_bus_bw_mbps(struct gov_attr_set *attr_set,
+				 const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	struct sugov_policy *sg_policy;
+	unsigned int bus_bw_mbps;
+
+	if (kstrtouint(buf, 10, &bus_bw_mbps))
+		return -EINVAL;
+
+	tunables->bus_bw_mbps = bus_bw_mbps;
+
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook) {
+		mutex_lock(&sg_policy->work_lock);
+		if (pm_qos_request_active(&sg_policy->bus_qos))
+			sugov_update_bus_vote(sg_policy);
+		mutex_unlock(&sg_policy->work_lock);
+	}
+
+	return count;
+}
+
 gov_attr_rw(rate_limit_us);
+gov_attr_rw(bus_bw_mbps);
 
 static struct attribute *sugov_attributes[] = {
 	&rate_limit_us.attr,
+	&bus_bw_mbps.attr,
 	NULL
 };
 
@@ -444,6 +531,7 @@ static int sugov_init(struct cpufreq_policy *policy)
 	lat = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
 	if (lat)
 		tunables->rate_limit_us *= lat;
+	tunables->bus_bw_mbps = CONFIG_CPU_FREQ_GOV_SCHEDUTIL_BUS_BW;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
@@ -503,6 +591,8 @@ static int sugov_start(struct cpufreq_policy *policy)
 	sg_policy->work_in_progress = false;
 	sg_policy->need_freq_update = false;
 	sg_policy->cached_raw_freq = 0;
+	sg_policy->bus_vote = 0;
+	pm_qos_add_request(&sg_policy->bus_qos, PM_QOS_MEMORY_BANDWIDTH, 0);
 
 	for_each_cpu(cpu, policy->cpus) {
 		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
@@ -531,6 +621,8 @@ static void sugov_stop(struct cpufreq_policy *policy)
 
 	irq_work_sync(&sg_policy->irq_work);
 	cancel_work_sync(&sg_policy->work);
+
+	pm_qos_remove_request(&sg_policy->bus_qos);
 }
 
 static void sugov_limits(struct cpufreq_policy *policy)
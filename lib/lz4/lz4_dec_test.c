@@ -0,0 +1,163 @@
+/*
+ * LZ4 decompressor benchmark
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/lz4.h>
+#include <linux/math64.h>
+#include <linux/preempt.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+/* the largest block is a squashfs block, the smallest a zram page */
+#define BLOCK_MAX	(128 * 1024)
+
+static unsigned int loops = 64;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Number of times each block is decompressed");
+
+static const unsigned int block_sizes[] = { 4096, 65536, BLOCK_MAX };
+
+/*
+ * Roughly how far back matches reach and how long literal runs get, from
+ * mostly literals to long repeats.
+ */
+static const struct {
+	const char *name;
+	unsigned int match_pct;
+	unsigned int max_offset;
+	unsigned int max_len;
+} patterns[] = {
+	{ "text",	60,	4096,	24 },
+	{ "binary",	85,	65535,	64 },
+	{ "sparse",	97,	16,	512 },
+};
+
+/* printable literals and back references, like a mix of text and code */
+static void lz4_dec_test_fill(u8 *buf, size_t len, unsigned int p)
+{
+	size_t i = 0, n, off;
+
+	while (i < len) {
+		n = 1 + prandom_u32() % patterns[p].max_len;
+		n = min(n, len - i);
+
+		if (i && prandom_u32() % 100 < patterns[p].match_pct) {
+			off = 1 + prandom_u32() % min_t(size_t, i,
+						      patterns[p].max_offset);
+			for (; n; n--, i++)
+				buf[i] = buf[i - off];
+		} else {
+			for (; n; n--, i++)
+				buf[i] = ' ' + prandom_u32() % 64;
+		}
+	}
+}
+
+static int lz4_dec_test_run(const u8 *orig, u8 *comp, size_t comp_len,
+			    u8 *out, size_t len, unsigned int p)
+{
+	u64 t_known, t_unknown;
+	size_t src_len, dest_len;
+	unsigned int i;
+	int ret = 0;
+
+	preempt_disable();
+
+	t_known = local_clock();
+	for (i = 0; i < loops && !ret; i++)
+		ret = lz4_decompress(comp, &src_len, out, len);
+	t_known = local_clock() - t_known;
+
+	if (!ret && (src_len != comp_len || memcmp(out, orig, len)))
+		ret = -EINVAL;
+
+	t_unknown = local_clock();
+	for (i = 0; i < loops && !ret; i++) {
+		dest_len = len;
+		ret = lz4_decompress_unknownoutputsize(comp, comp_len, out,
+						       &dest_len);
+	}
+	t_unknown = local_clock() - t_unknown;
+
+	preempt_enable();
+
+	if (!ret && (dest_len != len || memcmp(out, orig, len)))
+		ret = -EINVAL;
+	if (ret) {
+		pr_err("%s, %zu bytes: decompression failed\n",
+		       patterns[p].name, len);
+		return ret;
+	}
+
+	pr_info("%-6s %6zu -> %6zu bytes: %5llu MB/s, unknown size %5llu MB/s\n",
+		patterns[p].name, len, comp_len,
+		div64_u64((u64)len * loops * 1000, max_t(u64, t_known, 1)),
+		div64_u64((u64)len * loops * 1000, max_t(u64, t_unknown, 1)));
+	return 0;
+}
+
+static int __init lz4_dec_test_init(void)
+{
+	u8 *orig, *comp, *out;
+	void *wrkmem;
+	size_t comp_len;
+	unsigned int p, b;
+	int ret = -ENOMEM;
+
+	orig = vmalloc(BLOCK_MAX);
+	comp = vmalloc(lz4_compressbound(BLOCK_MAX));
+	out = vmalloc(BLOCK_MAX);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!orig || !comp || !out || !wrkmem)
+		goto out;
+
+	pr_info("decompressing each block %u times on CPU %d\n", loops,
+		raw_smp_processor_id());
+
+	for (p = 0; p < ARRAY_SIZE(patterns); p++) {
+		lz4_dec_test_fill(orig, BLOCK_MAX, p);
+
+		for (b = 0; b < ARRAY_SIZE(block_sizes); b++) {
+			ret = lz4_compress(orig, block_sizes[b], comp,
+					   &comp_len, wrkmem);
+			if (ret) {
+				pr_err("%s, %u bytes: compression failed\n",
+				       patterns[p].name, block_sizes[b]);
+				goto out;
+			}
+
+			ret = lz4_dec_test_run(orig, comp, comp_len, out,
+					       block_sizes[b], p);
+			if (ret)
+				goto out;
+			cond_resched();
+		}
+	}
+
+	/* like tcrypt, nothing to keep loaded, the results are in the log */
+	ret = -EAGAIN;
+out:
+	vfree(wrkmem);
+	vfree(out);
+	vfree(comp);
+	vfree(orig);
+	return ret;
+}
+
+module_init(lz4_dec_test_init);
+
+MODULE_DESCRIPTION("LZ4 decompressor benchmark");
+MODULE_LICENSE("GPL v2");
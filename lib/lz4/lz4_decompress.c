@@ -47,257 +47,228 @@
 
 #include "lz4defs.h"
 
-static const int dec32table[] = {0, 3, 2, 3, 0, 0, 0, 0};
-#if LZ4_ARCH64
-static const int dec64table[] = {0, 0, 0, -1, 0, 1, 2, 3};
-#endif
+/*
+ * For overlapping matches (offset < 8) the first four bytes are copied one
+ * at a time, then match is moved so that the next 4 and 8 byte copies keep
+ * repeating the pattern.
+ */
+static const int inc32table[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+static const int dec64table[8] = {0, 0, 0, -1, -4, 1, 2, 3};
 
-static int lz4_uncompress(const char *source, char *dest, int osize)
+/*
+ * The longest literal run and match the fast path copies blindly, 16 and
+ * 18 bytes, minus the 4 byte minimum match. When the input end is not
+ * known only the 8 bytes that are certainly part of the stream can be
+ * read ahead.
+ */
+#define LZ4_FAST_LITERALS(endoninput)	((endoninput) ? 14 : 8)
+#define LZ4_FAST_MATCH			18
+
+/*
+ * lz4_decompress_generic() :
+ * ------------------------
+ * Decode a block either knowing the compressed size (endoninput, the
+ * input is never read beyond iend and the output size is returned) or
+ * only the decompressed size (the stream is trusted to stay inside
+ * source, the number of bytes read is returned). -1 on malformed input.
+ *
+ * The fast path handles the common short literal run plus short match
+ * with two wild copies and no per byte checks, as long as both buffers
+ * have room for it. Everything else drops to the checked copies.
+ */
+static __always_inline int lz4_decompress_generic(const char *source,
+		char *dest, int isize, int osize, const int endoninput)
 {
 	const BYTE *ip = (const BYTE *) source;
-	const BYTE *ref;
+	const BYTE *const iend = ip + isize;
 	BYTE *op = (BYTE *) dest;
-	BYTE * const oend = op + osize;
-	BYTE *cpy;
-	unsigned token;
+	BYTE *const oend = op + osize;
+	const BYTE *const shortiend = iend -
+		LZ4_FAST_LITERALS(endoninput) - 2;
+	const BYTE *const shortoend = oend -
+		LZ4_FAST_LITERALS(endoninput) - LZ4_FAST_MATCH;
+	const BYTE *match;
+	size_t offset;
+	unsigned int token;
 	size_t length;
+	BYTE *cpy;
+
+	/* a lone zero token is the only valid way to encode nothing */
+	if (unlikely(osize == 0)) {
+		if (endoninput)
+			return (isize == 1 && *ip == 0) ? 0 : -1;
+		return *ip == 0 ? 1 : -1;
+	}
+	if (endoninput && unlikely(isize == 0))
+		return -1;
 
 	while (1) {
+		token = *ip++;
+		length = token >> ML_BITS;
+
+		/*
+		 * Fast path: copy 16 (or 8) bytes on behalf of the literals,
+		 * then 18 bytes on behalf of a non overlapping match of at
+		 * most 18 bytes. shortoend covers both copies.
+		 */
+		if ((endoninput ? length != RUN_MASK : length <= 8) &&
+		    likely((endoninput ? ip < shortiend : 1) &&
+			   op <= shortoend)) {
+			cpy = op + length;
+			LZ4_COPYPACKET(ip, op);
+			if (endoninput)
+				LZ4_COPYPACKET(ip, op);
+			ip -= (op - cpy);
+			op = cpy;
+
+			length = token & ML_MASK;
+			offset = get_unaligned_le16(ip);
+			ip += 2;
+			match = op - offset;
+
+			if (length != ML_MASK && offset >= 8 &&
+			    match >= (BYTE *) dest) {
+				PUT8(match, op);
+				PUT8(match + 8, op + 8);
+				op[16] = match[16];
+				op[17] = match[17];
+				op += length + MINMATCH;
+				continue;
+			}
+
+			/* the match info is decoded, go copy it the slow way */
+			goto _copy_match;
+		}
 
 		/* get runlength */
-		token = *ip++;
-		length = (token >> ML_BITS);
 		if (length == RUN_MASK) {
-			size_t len;
+			unsigned int s;
 
-			len = *ip++;
-			for (; len == 255; length += 255)
-				len = *ip++;
-			if (unlikely(length > (size_t)(length + len)))
+			if (endoninput && unlikely(ip >= iend - RUN_MASK))
+				goto _output_error;
+			do {
+				s = *ip++;
+				length += s;
+			} while ((endoninput ? ip < iend - RUN_MASK : 1) &&
+				 s == 255);
+			if (unlikely((size_t)op + length < (size_t)op))
+				goto _output_error;
+			if (unlikely((size_t)ip + length < (size_t)ip))
 				goto _output_error;
-			length += len;
 		}
 
 		/* copy literals */
 		cpy = op + length;
-		if (unlikely(cpy > oend - COPYLENGTH)) {
+		if (endoninput ? (cpy > oend - MFLIMIT ||
+				  ip + length > iend - (2 + 1 + LASTLITERALS)) :
+				 cpy > oend - COPYLENGTH) {
 			/*
-			 * Error: not enough place for another match
-			 * (min 4) + 5 literals
+			 * Necessarily the last literals: the block has to end
+			 * exactly here, on both sides if the sizes are known.
 			 */
-			if (cpy != oend)
+			if (!endoninput && cpy != oend)
+				goto _output_error;
+			if (endoninput && (ip + length != iend || cpy > oend))
 				goto _output_error;
-
 			memcpy(op, ip, length);
 			ip += length;
-			break; /* EOF */
+			op += length;
+			break;
 		}
 		LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
 
 		/* get offset */
-		LZ4_READ_LITTLEENDIAN_16(ref, cpy, ip);
+		offset = get_unaligned_le16(ip);
 		ip += 2;
-
-		/* Error: offset create reference outside destination buffer */
-		if (unlikely(ref < (BYTE *const) dest))
-			goto _output_error;
+		match = op - offset;
 
 		/* get matchlength */
 		length = token & ML_MASK;
+
+_copy_match:
+		/* Error: offset creates reference outside destination buffer */
+		if (unlikely(match < (BYTE *) dest))
+			goto _output_error;
+
 		if (length == ML_MASK) {
-			for (; *ip == 255; length += 255)
-				ip++;
-			if (unlikely(length > (size_t)(length + *ip)))
+			unsigned int s;
+
+			do {
+				s = *ip++;
+				if (endoninput && ip > iend - LASTLITERALS)
+					goto _output_error;
+				length += s;
+			} while (s == 255);
+			if (unlikely((size_t)op + length < (size_t)op))
 				goto _output_error;
-			length += *ip++;
 		}
+		length += MINMATCH;
 
 		/* copy repeated sequence */
-		if (unlikely((op - ref) < STEPSIZE)) {
-#if LZ4_ARCH64
-			int dec64 = dec64table[op - ref];
-#else
-			const int dec64 = 0;
-#endif
-			op[0] = ref[0];
-			op[1] = ref[1];
-			op[2] = ref[2];
-			op[3] = ref[3];
-			op += 4;
-			ref += 4;
-			ref -= dec32table[op-ref];
-			PUT4(ref, op);
-			op += STEPSIZE - 4;
-			ref -= dec64;
+		cpy = op + length;
+		if (unlikely(offset < 8)) {
+			op[0] = match[0];
+			op[1] = match[1];
+			op[2] = match[2];
+			op[3] = match[3];
+			match += inc32table[offset];
+			PUT4(match, op + 4);
+			match -= dec64table[offset];
 		} else {
-			LZ4_COPYSTEP(ref, op);
+			PUT8(match, op);
+			match += 8;
 		}
-		cpy = op + length - (STEPSIZE - 4);
-		if (cpy > (oend - COPYLENGTH)) {
+		op += 8;
 
-			/* Error: request to write beyond destination buffer */
-			if (cpy > oend)
-				goto _output_error;
-#if LZ4_ARCH64
-			if ((ref + COPYLENGTH) > oend)
-#else
-			if ((ref + COPYLENGTH) > oend ||
-					(op + COPYLENGTH) > oend)
-#endif
+		if (unlikely(cpy > oend - MFLIMIT)) {
+			BYTE *const olimit = oend - (COPYLENGTH - 1);
+
+			/* the last LASTLITERALS bytes must be literals */
+			if (cpy > oend - LASTLITERALS)
 				goto _output_error;
-			LZ4_SECURECOPY(ref, op, (oend - COPYLENGTH));
+			if (op < olimit) {
+				const BYTE *mcpy = match;
+				BYTE *ocpy = op;
+
+				LZ4_WILDCOPY(mcpy, ocpy, olimit);
+				match += olimit - op;
+				op = olimit;
+			}
 			while (op < cpy)
-				*op++ = *ref++;
-			op = cpy;
-			/*
-			 * Check EOF (should never happen, since last 5 bytes
-			 * are supposed to be literals)
-			 */
-			if (op == oend)
-				goto _output_error;
-			continue;
+				*op++ = *match++;
+		} else {
+			PUT8(match, op);
+			if (length > 16) {
+				const BYTE *mcpy = match + 8;
+				BYTE *ocpy = op + 8;
+
+				LZ4_WILDCOPY(mcpy, ocpy, cpy);
+			}
 		}
-		LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
+
 	/* end of decoding */
-	return (int) (((char *)ip) - source);
+	if (endoninput)
+		return (int) (((char *) op) - dest);
+	return (int) (((char *) ip) - source);
 
 	/* write overflow error detected */
 _output_error:
 	return -1;
 }
 
+static int lz4_uncompress(const char *source, char *dest, int osize)
+{
+	return lz4_decompress_generic(source, dest, 0, osize, 0);
+}
+
 static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				int isize, size_t maxoutputsize)
 {
-	const BYTE *ip = (const BYTE *) source;
-	const BYTE *const iend = ip + isize;
-	const BYTE *ref;
-
-
-	BYTE *op = (BYTE *) dest;
-	BYTE * const oend = op + maxoutputsize;
-	BYTE *cpy;
-
-	/* Main Loop */
-	while (ip < iend) {
-
-		unsigned token;
-		size_t length;
-
-		/* get runlength */
-		token = *ip++;
-		length = (token >> ML_BITS);
-		if (length == RUN_MASK) {
-			int s = 255;
-			while ((ip < iend) && (s == 255)) {
-				s = *ip++;
-				if (unlikely(length > (size_t)(length + s)))
-					goto _output_error;
-				length += s;
-			}
-		}
-		/* copy literals */
-		cpy = op + length;
-		if ((cpy > oend - COPYLENGTH) ||
-			(ip + length > iend - COPYLENGTH)) {
-
-			if (cpy > oend)
-				goto _output_error;/* writes beyond buffer */
-
-			if (ip + length != iend)
-				goto _output_error;/*
-						    * Error: LZ4 format requires
-						    * to consume all input
-						    * at this stage
-						    */
-			memcpy(op, ip, length);
-			op += length;
-			break;/* Necessarily EOF, due to parsing restrictions */
-		}
-		LZ4_WILDCOPY(ip, op, cpy);
-		ip -= (op - cpy);
-		op = cpy;
-
-		/* get offset */
-		LZ4_READ_LITTLEENDIAN_16(ref, cpy, ip);
-		ip += 2;
-		if (ref < (BYTE * const) dest)
-			goto _output_error;
-			/*
-			 * Error : offset creates reference
-			 * outside of destination buffer
-			 */
-
-		/* get matchlength */
-		length = (token & ML_MASK);
-		if (length == ML_MASK) {
-			while (ip < iend) {
-				int s = *ip++;
-				if (unlikely(length > (size_t)(length + s)))
-					goto _output_error;
-				length += s;
-				if (s == 255)
-					continue;
-				break;
-			}
-		}
-
-		/* copy repeated sequence */
-		if (unlikely((op - ref) < STEPSIZE)) {
-#if LZ4_ARCH64
-			int dec64 = dec64table[op - ref];
-#else
-			const int dec64 = 0;
-#endif
-				op[0] = ref[0];
-				op[1] = ref[1];
-				op[2] = ref[2];
-				op[3] = ref[3];
-				op += 4;
-				ref += 4;
-				ref -= dec32table[op - ref];
-				PUT4(ref, op);
-				op += STEPSIZE - 4;
-				ref -= dec64;
-		} else {
-			LZ4_COPYSTEP(ref, op);
-		}
-		cpy = op + length - (STEPSIZE-4);
-		if (cpy > oend - COPYLENGTH) {
-			if (cpy > oend)
-				goto _output_error; /* write outside of buf */
-#if LZ4_ARCH64
-			if ((ref + COPYLENGTH) > oend)
-#else
-			if ((ref + COPYLENGTH) > oend ||
-					(op + COPYLENGTH) > oend)
-#endif
-				goto _output_error;
-			LZ4_SECURECOPY(ref, op, (oend - COPYLENGTH));
-			while (op < cpy)
-				*op++ = *ref++;
-			op = cpy;
-			/*
-			 * Check EOF (should never happen, since last 5 bytes
-			 * are supposed to be literals)
-			 */
-			if (op == oend)
-				goto _output_error;
-			continue;
-		}
-		LZ4_SECURECOPY(ref, op, cpy);
-		op = cpy; /* correction */
-	}
-	/* end of decoding */
-	return (int) (((char *) op) - dest);
-
-	/* write overflow error detected */
-_output_error:
-	return -1;
+	return lz4_decompress_generic(source, dest, isize, maxoutputsize, 1);
 }
 
 int lz4_decompress(const unsigned char *src, size_t *src_len,
@@ -48,9 +48,9 @@ typedef struct _U64_S { u64 v; } U64_S;
 #define A16(x) get_unaligned((u16 *)&(((U16_S *)(x))->v))
 
 #define PUT4(s, d) \
-	put_unaligned(get_unaligned((const u32 *) s), (u32 *) d)
+	put_unaligned(get_unaligned((const u32 *)(s)), (u32 *)(d))
 #define PUT8(s, d) \
-	put_unaligned(get_unaligned((const u64 *) s), (u64 *) d)
+	put_unaligned(get_unaligned((const u64 *)(s)), (u64 *)(d))
 
 #define LZ4_READ_LITTLEENDIAN_16(d, s, p)	\
 	(d = s - get_unaligned_le16(p))
@@ -0,0 +1,115 @@
+/*
+ * linux/lib/raid6/recov_neon_inner.c - NEON inner loops of RAID6 recovery
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <arm_neon.h>
+
+static const uint8x16_t x0f = {
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+	0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+};
+
+#ifdef CONFIG_ARM
+/*
+ * AArch32 only has the 64-bit wide vtbl.8, a 16 entry lookup on a full
+ * q register takes two of them with the table as a d register pair.
+ */
+static uint8x16_t vqtbl1q_u8(uint8x16_t a, uint8x16_t b)
+{
+	union {
+		uint8x16_t	val;
+		uint8x8x2_t	pair;
+	} __a = { a };
+
+	return vcombine_u8(vtbl2_u8(__a.pair, vget_low_u8(b)),
+			   vtbl2_u8(__a.pair, vget_high_u8(b)));
+}
+#endif
+
+/*
+ * A GF(2^8) multiplication by a constant is the XOR of two 16 entry
+ * lookups, one per nibble, in the raid6_vgfmul[] row of the constant.
+ */
+static uint8x16_t raid6_neon_gfmul(uint8x16_t lo, uint8x16_t hi,
+				   uint8x16_t x)
+{
+	uint8x16_t vy = vshrq_n_u8(x, 4);
+
+	return veorq_u8(vqtbl1q_u8(lo, vandq_u8(x, x0f)),
+			vqtbl1q_u8(hi, vy));
+}
+
+void __raid6_2data_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dp,
+			      uint8_t *dq, const uint8_t *pbmul,
+			      const uint8_t *qmul)
+{
+	uint8x16_t pm0 = vld1q_u8(pbmul);
+	uint8x16_t pm1 = vld1q_u8(pbmul + 16);
+	uint8x16_t qm0 = vld1q_u8(qmul);
+	uint8x16_t qm1 = vld1q_u8(qmul + 16);
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+
+	while (bytes) {
+		uint8x16_t px, qx, db;
+
+		px = veorq_u8(vld1q_u8(p), vld1q_u8(dp));
+		qx = raid6_neon_gfmul(qm0, qm1,
+				      veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+		db = veorq_u8(raid6_neon_gfmul(pm0, pm1, px), qx);
+
+		vst1q_u8(dq, db);
+		vst1q_u8(dp, veorq_u8(db, px));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dp += 16;
+		dq += 16;
+	}
+}
+
+void __raid6_datap_recov_neon(int bytes, uint8_t *p, uint8_t *q, uint8_t *dq,
+			      const uint8_t *qmul)
+{
+	uint8x16_t qm0 = vld1q_u8(qmul);
+	uint8x16_t qm1 = vld1q_u8(qmul + 16);
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+
+	while (bytes) {
+		uint8x16_t vx;
+
+		vx = raid6_neon_gfmul(qm0, qm1,
+				      veorq_u8(vld1q_u8(q), vld1q_u8(dq)));
+
+		vst1q_u8(dq, vx);
+		vst1q_u8(p, veorq_u8(vx, vld1q_u8(p)));
+
+		bytes -= 16;
+		p += 16;
+		q += 16;
+		dq += 16;
+	}
+}
@@ -0,0 +1,348 @@
+/*
+ * Parallel .xz Block decoder
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Blocks of a Stream are independent of each other, and xz --threads
+ * stores the sizes of every Block in its Block Header. With those the
+ * position of each Block in both the input and the output is known up
+ * front, so the Blocks can be handed out to one single-call decoder per
+ * CPU. The Index is still checked against the Block Headers before any
+ * decoding starts; everything else is validated by xz_dec_block_run().
+ */
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/workqueue.h>
+#include "xz_private.h"
+#include "xz_stream.h"
+
+struct xz_dec_mt_block {
+	/* Block Header through Check, relative to the Stream Header */
+	size_t in_pos;
+	size_t in_size;
+
+	/* Uncompressed data, relative to the start of the output */
+	size_t out_pos;
+	size_t out_size;
+
+	/* Unpadded Size as the Index records it */
+	vli_type unpadded;
+};
+
+struct xz_dec_mt_worker {
+	struct work_struct work;
+	struct xz_dec_mt *mt;
+	struct xz_dec *dec;
+};
+
+struct xz_dec_mt {
+	unsigned int threads;
+	struct xz_dec_mt_worker *workers;
+
+	/* Found by xz_dec_mt_scan() */
+	struct xz_dec_mt_block *blocks;
+	size_t block_count;
+	size_t block_max;
+	uint32_t check_type;
+	size_t stream_size;
+	uint64_t uncompressed;
+
+	/* Shared by the workers during xz_dec_mt_run() */
+	const uint8_t *in;
+	uint8_t *out;
+	atomic_t next;
+	atomic_t pending;
+	atomic_t ret;
+	struct completion done;
+};
+
+/* Like dec_vli() in xz_dec_stream.c, for a buffer that is all there */
+static bool xz_dec_mt_vli(const uint8_t *in, size_t *pos, size_t size,
+			  vli_type *vli)
+{
+	unsigned int shift = 0;
+	uint8_t byte;
+
+	*vli = 0;
+	while (*pos < size && shift < 7 * VLI_BYTES_MAX) {
+		byte = in[(*pos)++];
+		*vli |= (vli_type)(byte & 0x7F) << shift;
+
+		/* Don't allow non-minimal encodings. */
+		if ((byte & 0x80) == 0)
+			return byte != 0 || shift == 0;
+
+		shift += 7;
+	}
+
+	return false;
+}
+
+static bool xz_dec_mt_add(struct xz_dec_mt *s, size_t in_pos, size_t in_size,
+			  uint64_t out_pos, vli_type out_size,
+			  vli_type unpadded)
+{
+	struct xz_dec_mt_block *blocks;
+	struct xz_dec_mt_block *blk;
+
+	if (out_size > SIZE_MAX - out_pos)
+		return false;
+
+	if (s->block_count == s->block_max) {
+		blocks = krealloc(s->blocks, sizeof(*blocks) *
+				  (s->block_max + 16), GFP_KERNEL);
+		if (blocks == NULL)
+			return false;
+
+		s->blocks = blocks;
+		s->block_max += 16;
+	}
+
+	blk = &s->blocks[s->block_count++];
+	blk->in_pos = in_pos;
+	blk->in_size = in_size;
+	blk->out_pos = out_pos;
+	blk->out_size = out_size;
+	blk->unpadded = unpadded;
+
+	return true;
+}
+
+/*
+ * Walk the Block Headers and the Index of the Stream at the start of in.
+ * Return true if every Block Header has both sizes and they agree with
+ * the Index, so that the Blocks can be decoded in any order. Anything
+ * else is left to the sequential decoder, which reports it properly.
+ */
+static bool xz_dec_mt_scan(struct xz_dec_mt *s, const uint8_t *in,
+			   size_t in_size)
+{
+	size_t pos, hsize, index_start, i, j;
+	vli_type comp, uncomp, count, unpadded;
+	uint32_t check_size;
+	uint64_t out = 0;
+	const uint8_t *h;
+
+	s->block_count = 0;
+
+	if (in_size < 2 * STREAM_HEADER_SIZE
+			|| !memeq(in, HEADER_MAGIC, HEADER_MAGIC_SIZE)
+			|| xz_crc32(in + HEADER_MAGIC_SIZE, 2, 0)
+				!= get_le32(in + HEADER_MAGIC_SIZE + 2)
+			|| in[HEADER_MAGIC_SIZE] != 0
+			|| in[HEADER_MAGIC_SIZE + 1] > XZ_CHECK_CRC32)
+		return false;
+
+	s->check_type = in[HEADER_MAGIC_SIZE + 1];
+	check_size = s->check_type == XZ_CHECK_CRC32 ? 4 : 0;
+
+	/* Blocks, until the Index Indicator */
+	pos = STREAM_HEADER_SIZE;
+	while (pos < in_size && in[pos] != 0) {
+		h = in + pos;
+		hsize = ((size_t)h[0] + 1) * 4;
+
+		if (in_size - pos < hsize || (h[1] & 0xC0) != 0xC0
+				|| xz_crc32(h, hsize - 4, 0)
+					!= get_le32(h + hsize - 4))
+			return false;
+
+		j = 2;
+		if (!xz_dec_mt_vli(h, &j, hsize - 4, &comp)
+				|| !xz_dec_mt_vli(h, &j, hsize - 4, &uncomp))
+			return false;
+
+		if (comp == 0 || comp > in_size - pos - hsize
+				|| ((comp + 3) & ~(vli_type)3) + check_size
+					> in_size - pos - hsize)
+			return false;
+
+		unpadded = hsize + comp + check_size;
+		i = hsize + ((comp + 3) & ~(vli_type)3) + check_size;
+		if (!xz_dec_mt_add(s, pos, i, out, uncomp, unpadded))
+			return false;
+
+		out += uncomp;
+		pos += i;
+	}
+
+	/* Index */
+	if (pos >= in_size)
+		return false;
+
+	index_start = pos++;
+	if (!xz_dec_mt_vli(in, &pos, in_size, &count)
+			|| count != s->block_count)
+		return false;
+
+	for (i = 0; i < s->block_count; ++i) {
+		if (!xz_dec_mt_vli(in, &pos, in_size, &unpadded)
+				|| !xz_dec_mt_vli(in, &pos, in_size, &uncomp)
+				|| unpadded != s->blocks[i].unpadded
+				|| uncomp != s->blocks[i].out_size)
+			return false;
+	}
+
+	while ((pos - index_start) & 3) {
+		if (pos >= in_size || in[pos] != 0)
+			return false;
+
+		++pos;
+	}
+
+	if (in_size - pos < 4 + STREAM_HEADER_SIZE
+			|| xz_crc32(in + index_start, pos - index_start, 0)
+				!= get_le32(in + pos))
+		return false;
+
+	/* Stream Footer, Backward Size doesn't count the Index CRC32 */
+	h = in + pos + 4;
+	if (!memeq(h + 10, FOOTER_MAGIC, FOOTER_MAGIC_SIZE)
+			|| xz_crc32(h + 4, 6, 0) != get_le32(h)
+			|| get_le32(h + 4) != (pos - index_start) / 4
+			|| h[8] != 0 || h[9] != s->check_type)
+		return false;
+
+	s->stream_size = pos + 4 + STREAM_HEADER_SIZE;
+	s->uncompressed = out;
+
+	return true;
+}
+
+static void xz_dec_mt_decode(struct xz_dec_mt_worker *w)
+{
+	struct xz_dec_mt *s = w->mt;
+	const struct xz_dec_mt_block *blk;
+	struct xz_buf b;
+	enum xz_ret ret;
+	size_t i;
+
+	while (atomic_read(&s->ret) == XZ_STREAM_END) {
+		i = atomic_inc_return(&s->next) - 1;
+		if (i >= s->block_count)
+			break;
+
+		blk = &s->blocks[i];
+		b.in = s->in + blk->in_pos;
+		b.in_pos = 0;
+		b.in_size = blk->in_size;
+		b.out = s->out + blk->out_pos;
+		b.out_pos = 0;
+		b.out_size = blk->out_size;
+
+		ret = xz_dec_block_run(w->dec, s->check_type, &b);
+		if (ret == XZ_STREAM_END && (b.in_pos != b.in_size
+				|| b.out_pos != b.out_size))
+			ret = XZ_DATA_ERROR;
+
+		if (ret != XZ_STREAM_END)
+			atomic_cmpxchg(&s->ret, XZ_STREAM_END, ret);
+	}
+
+	if (atomic_dec_and_test(&s->pending))
+		complete(&s->done);
+}
+
+static void xz_dec_mt_work(struct work_struct *work)
+{
+	xz_dec_mt_decode(container_of(work, struct xz_dec_mt_worker, work));
+}
+
+XZ_EXTERN uint64_t xz_dec_mt_size(struct xz_dec_mt *s, const uint8_t *in,
+				  size_t in_size)
+{
+	if (s->threads < 2 || !xz_dec_mt_scan(s, in, in_size)
+			|| s->block_count < 2)
+		return 0;
+
+	return s->uncompressed;
+}
+
+XZ_EXTERN enum xz_ret xz_dec_mt_run(struct xz_dec_mt *s, struct xz_buf *b)
+{
+	unsigned int i, n;
+
+	if (xz_dec_mt_size(s, b->in + b->in_pos, b->in_size - b->in_pos) == 0)
+		return xz_dec_run(s->workers[0].dec, b);
+
+	if (s->uncompressed > b->out_size - b->out_pos)
+		return XZ_BUF_ERROR;
+
+	s->in = b->in + b->in_pos;
+	s->out = b->out + b->out_pos;
+	n = min_t(size_t, s->threads, s->block_count);
+	atomic_set(&s->next, 0);
+	atomic_set(&s->pending, n);
+	atomic_set(&s->ret, XZ_STREAM_END);
+	reinit_completion(&s->done);
+
+	for (i = 1; i < n; ++i)
+		queue_work(system_unbound_wq, &s->workers[i].work);
+
+	/* The caller takes a share of the Blocks too. */
+	xz_dec_mt_decode(&s->workers[0]);
+	wait_for_completion(&s->done);
+
+	if (atomic_read(&s->ret) != XZ_STREAM_END)
+		return atomic_read(&s->ret);
+
+	b->in_pos += s->stream_size;
+	b->out_pos += s->uncompressed;
+
+	return XZ_STREAM_END;
+}
+
+XZ_EXTERN struct xz_dec_mt *xz_dec_mt_init(unsigned int threads)
+{
+	struct xz_dec_mt *s;
+	unsigned int i;
+
+	if (threads == 0)
+		threads = num_online_cpus();
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (s == NULL)
+		return NULL;
+
+	s->workers = kcalloc(threads, sizeof(*s->workers), GFP_KERNEL);
+	if (s->workers == NULL)
+		goto error;
+
+	s->threads = threads;
+	init_completion(&s->done);
+
+	for (i = 0; i < threads; ++i) {
+		s->workers[i].mt = s;
+		INIT_WORK(&s->workers[i].work, xz_dec_mt_work);
+		s->workers[i].dec = xz_dec_init(XZ_SINGLE, 0);
+		if (s->workers[i].dec == NULL)
+			goto error;
+	}
+
+	return s;
+
+error:
+	xz_dec_mt_end(s);
+	return NULL;
+}
+
+XZ_EXTERN void xz_dec_mt_end(struct xz_dec_mt *s)
+{
+	unsigned int i;
+
+	if (s != NULL) {
+		if (s->workers != NULL)
+			for (i = 0; i < s->threads; ++i)
+				xz_dec_end(s->workers[i].dec);
+
+		kfree(s->workers);
+		kfree(s->blocks);
+		kfree(s);
+	}
+}
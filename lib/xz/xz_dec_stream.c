@@ -57,6 +57,9 @@ struct xz_dec {
 	 */
 	bool allow_buf_error;
 
+	/* True if decoding stops after one Block, see xz_dec_block_run() */
+	bool single_block;
+
 	/* Information stored in Block Header */
 	struct {
 		/*
@@ -590,6 +593,9 @@ static enum xz_ret dec_main(struct xz_dec *s, struct xz_buf *b)
 
 			/* See if this is the beginning of the Index field. */
 			if (b->in[b->in_pos] == 0) {
+				if (s->single_block)
+					return XZ_DATA_ERROR;
+
 				s->in_start = b->in_pos++;
 				s->sequence = SEQ_INDEX;
 				break;
@@ -655,6 +661,9 @@ static enum xz_ret dec_main(struct xz_dec *s, struct xz_buf *b)
 			}
 #endif
 
+			if (s->single_block)
+				return XZ_STREAM_END;
+
 			s->sequence = SEQ_BLOCK_START;
 			break;
 
@@ -767,6 +776,42 @@ XZ_EXTERN enum xz_ret xz_dec_run(struct xz_dec *s, struct xz_buf *b)
 	return ret;
 }
 
+#ifdef XZ_DEC_SINGLE
+/*
+ * Decode one Block, from its Block Header up to and including its Check
+ * field, in single-call mode. The Stream Header is not seen, so the caller
+ * passes the Check ID from it. Blocks in a Stream don't depend on each
+ * other, which is what makes decoding them in parallel possible.
+ */
+XZ_EXTERN enum xz_ret xz_dec_block_run(struct xz_dec *s, uint32_t check_type,
+				       struct xz_buf *b)
+{
+	size_t in_start = b->in_pos;
+	size_t out_start = b->out_pos;
+	enum xz_ret ret;
+
+	if (!DEC_IS_SINGLE(s->mode) || check_type > XZ_CHECK_CRC32)
+		return XZ_OPTIONS_ERROR;
+
+	xz_dec_reset(s);
+	s->check_type = check_type;
+	s->sequence = SEQ_BLOCK_START;
+	s->single_block = true;
+	ret = dec_main(s, b);
+	s->single_block = false;
+
+	if (ret == XZ_OK)
+		ret = b->in_pos == b->in_size ? XZ_DATA_ERROR : XZ_BUF_ERROR;
+
+	if (ret != XZ_STREAM_END) {
+		b->in_pos = in_start;
+		b->out_pos = out_start;
+	}
+
+	return ret;
+}
+#endif
+
 XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max)
 {
 	struct xz_dec *s = kmalloc(sizeof(*s), GFP_KERNEL);
@@ -774,6 +819,7 @@ XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max)
 		return NULL;
 
 	s->mode = mode;
+	s->single_block = false;
 
 #ifdef XZ_DEC_BCJ
 	s->bcj = xz_dec_bcj_create(DEC_IS_SINGLE(mode));
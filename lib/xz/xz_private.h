@@ -102,6 +102,15 @@
 #	endif
 #endif
 
+#ifdef XZ_DEC_SINGLE
+/*
+ * Decode a single Block of a Stream whose Stream Header had the given
+ * Check ID. Only single-call mode is supported. Used by xz_dec_mt.c.
+ */
+XZ_EXTERN enum xz_ret xz_dec_block_run(struct xz_dec *s, uint32_t check_type,
+				       struct xz_buf *b);
+#endif
+
 /*
  * Allocate memory for LZMA2 decoder. xz_dec_lzma2_reset() must be used
  * before calling xz_dec_lzma2_run().
@@ -0,0 +1,992 @@
+/*
+ * Zstandard compressor for Linux kernel
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A single pass greedy match finder in the spirit of the reference fast
+ * strategy, with Huffman coded literals and FSE coded sequences. Each
+ * call produces one single segment frame, so the decoder needs no more
+ * window than the data itself.
+ */
+
+#include <linux/bug.h>
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/zstd.h>
+
+#include "zstd_internal.h"
+
+#define ZSTD_C_BLOCK_LOG	15
+#define ZSTD_C_BLOCK_SIZE	(1 << ZSTD_C_BLOCK_LOG)
+#define ZSTD_C_HASH_LOG		14
+#define ZSTD_C_MIN_MATCH	4
+#define ZSTD_C_MAX_SEQ		(ZSTD_C_BLOCK_SIZE / ZSTD_C_MIN_MATCH)
+/* keeps offset codes within the predefined distribution */
+#define ZSTD_C_MAX_OFFSET	((1U << 27) - 4)
+/* literal runs shorter than this are not worth a Huffman table */
+#define ZSTD_C_MIN_HUF		64
+
+struct zstd_seq {
+	u32 ofv;
+	u16 ll;
+	u16 ml;
+};
+
+struct zstd_fse_ctable {
+	u16 states[1 << ZSTD_LL_LOG_MAX];
+	struct {
+		u32 delta_nbits;
+		s32 find;
+	} sym[ZSTD_ML_SYMBOLS];
+	unsigned int log;
+};
+
+struct zstd_cctx {
+	u32 hash[1 << ZSTD_C_HASH_LOG];
+	u8 lits[ZSTD_C_BLOCK_SIZE];
+	struct zstd_seq seqs[ZSTD_C_MAX_SEQ];
+	u8 llc[ZSTD_C_MAX_SEQ];
+	u8 mlc[ZSTD_C_MAX_SEQ];
+	u8 ofc[ZSTD_C_MAX_SEQ];
+	struct zstd_fse_ctable ll, ml, of;
+	u32 huf_count[2 * ZSTD_HUF_SYMBOLS];
+	u16 huf_parent[2 * ZSTD_HUF_SYMBOLS];
+	u16 huf_sym[ZSTD_HUF_SYMBOLS];
+	u16 huf_code[ZSTD_HUF_SYMBOLS];
+	u8 huf_len[ZSTD_HUF_SYMBOLS];
+	u8 fse_symbols[1 << ZSTD_LL_LOG_MAX];
+	u32 rep[3];
+	unsigned int hash_log;
+	unsigned int nseq;
+	unsigned int nlits;
+};
+
+static inline u32 zstd_hash(const u8 *p, unsigned int log)
+{
+	return (get_unaligned_le32(p) * 2654435761U) >> (32 - log);
+}
+
+static inline unsigned int zstd_count(const u8 *p, const u8 *m,
+				      const u8 *end)
+{
+	const u8 *const start = p;
+	u64 diff;
+
+	while (end - p >= 8) {
+		diff = get_unaligned_le64(p) ^ get_unaligned_le64(m);
+		if (diff)
+			return p - start + (__ffs64(diff) >> 3);
+		p += 8;
+		m += 8;
+	}
+	while (p < end && *p == *m) {
+		p++;
+		m++;
+	}
+	return p - start;
+}
+
+static inline unsigned int zstd_ll_code(u32 ll)
+{
+	unsigned int c;
+
+	if (ll < 16)
+		return ll;
+	if (ll >= 64)
+		return zstd_highbit(ll) + 19;
+	for (c = 24; zstd_ll_base[c] > ll; c--)
+		;
+	return c;
+}
+
+static inline unsigned int zstd_ml_code(u32 ml)
+{
+	unsigned int c;
+
+	ml -= 3;
+	if (ml < 32)
+		return ml;
+	if (ml >= 128)
+		return zstd_highbit(ml) + 36;
+	for (c = 42; zstd_ml_base[c] - 3 > ml; c--)
+		;
+	return c;
+}
+
+/*
+ * Picks the offset value as the decoder will see it, repeat offsets
+ * included, and keeps the history in step with zstd_rep_offset().
+ */
+static void zstd_store_seq(struct zstd_cctx *cctx, const u8 *anchor,
+			   u32 ll, u32 off, u32 ml)
+{
+	struct zstd_seq *seq = &cctx->seqs[cctx->nseq];
+	u32 *rep = cctx->rep;
+	u32 ofv;
+
+	if (ll) {
+		if (off == rep[0])
+			ofv = 1;
+		else if (off == rep[1])
+			ofv = 2;
+		else if (off == rep[2])
+			ofv = 3;
+		else
+			ofv = off + 3;
+	} else {
+		if (off == rep[1])
+			ofv = 1;
+		else if (off == rep[2])
+			ofv = 2;
+		else if (off == rep[0] - 1)
+			ofv = 3;
+		else
+			ofv = off + 3;
+	}
+	zstd_rep_offset(rep, ofv, ll);
+
+	memcpy(cctx->lits + cctx->nlits, anchor, ll);
+	cctx->nlits += ll;
+
+	seq->ofv = ofv;
+	seq->ll = ll;
+	seq->ml = ml;
+	cctx->llc[cctx->nseq] = zstd_ll_code(ll);
+	cctx->mlc[cctx->nseq] = zstd_ml_code(ml);
+	cctx->ofc[cctx->nseq] = zstd_highbit(ofv);
+	cctx->nseq++;
+}
+
+/* greedy parse of [bs, be), matches may reach back to base */
+static void zstd_find_sequences(struct zstd_cctx *cctx, const u8 *base,
+				const u8 *bs, const u8 *be)
+{
+	const unsigned int log = cctx->hash_log;
+	const u8 *ip = bs, *anchor = bs, *match;
+	const u8 *const ilimit = be - 8;
+	u32 h, rep0, len;
+
+	cctx->nseq = 0;
+	cctx->nlits = 0;
+
+	while (ip < ilimit) {
+		/* a repeat of the last offset one byte on is the cheapest */
+		rep0 = cctx->rep[0];
+		if (ip + 1 - base >= rep0 &&
+		    get_unaligned_le32(ip + 1) ==
+		    get_unaligned_le32(ip + 1 - rep0)) {
+			ip++;
+			len = ZSTD_C_MIN_MATCH +
+			      zstd_count(ip + ZSTD_C_MIN_MATCH,
+					 ip - rep0 + ZSTD_C_MIN_MATCH, be);
+			zstd_store_seq(cctx, anchor, ip - anchor, rep0, len);
+			ip += len;
+			anchor = ip;
+			continue;
+		}
+
+		h = zstd_hash(ip, log);
+		match = base + cctx->hash[h];
+		cctx->hash[h] = ip - base;
+
+		if (match >= ip || ip - match > ZSTD_C_MAX_OFFSET ||
+		    get_unaligned_le32(match) != get_unaligned_le32(ip)) {
+			/* move faster through data that does not compress */
+			ip += 1 + ((ip - anchor) >> 8);
+			continue;
+		}
+
+		while (ip > anchor && match > base && ip[-1] == match[-1]) {
+			ip--;
+			match--;
+		}
+		len = ZSTD_C_MIN_MATCH +
+		      zstd_count(ip + ZSTD_C_MIN_MATCH,
+				 match + ZSTD_C_MIN_MATCH, be);
+		zstd_store_seq(cctx, anchor, ip - anchor, ip - match, len);
+		ip += len;
+		anchor = ip;
+
+		if (ip < ilimit)
+			cctx->hash[zstd_hash(ip - 2, log)] = ip - 2 - base;
+	}
+
+	memcpy(cctx->lits + cctx->nlits, anchor, be - anchor);
+	cctx->nlits += be - anchor;
+}
+
+/* log2(x) in 1/256 bit units, close enough for cost estimates */
+static u32 zstd_log2_q8(u32 x)
+{
+	unsigned int hb = zstd_highbit(x);
+
+	return (hb << 8) + (u32)((((u64)x << 8) >> hb) & 255);
+}
+
+static unsigned int zstd_fse_log(u32 total, unsigned int maxsym,
+				 unsigned int log_max)
+{
+	unsigned int log = log_max;
+	unsigned int src_bits = total > 1 ? zstd_highbit(total - 1) : 0;
+	unsigned int min_bits = min(zstd_highbit(total) + 1,
+				    zstd_highbit(maxsym | 1) + 2);
+
+	if (src_bits >= 2 && src_bits - 2 < log)
+		log = src_bits - 2;
+	if (min_bits > log)
+		log = min_bits;
+	return clamp_t(unsigned int, log, ZSTD_FSE_LOG_MIN, log_max);
+}
+
+/*
+ * Scales the counts to 1 << log, every present symbol keeps at least one
+ * state and rounding goes to the largest remainders.
+ */
+static void zstd_fse_normalize(s16 *norm, const u32 *count,
+			       unsigned int nsym, u32 total, unsigned int log)
+{
+	u32 rem[ZSTD_ML_SYMBOLS];
+	int diff = 1 << log;
+	unsigned int s, best;
+	u64 scaled;
+
+	for (s = 0; s < nsym; s++) {
+		norm[s] = 0;
+		rem[s] = 0;
+		if (!count[s])
+			continue;
+		scaled = (u64)count[s] << log;
+		norm[s] = div_u64(scaled, total);
+		rem[s] = scaled - (u64)norm[s] * total;
+		if (!norm[s]) {
+			norm[s] = 1;
+			rem[s] = 0;
+		}
+		diff -= norm[s];
+	}
+
+	while (diff > 0) {
+		for (best = 0, s = 1; s < nsym; s++)
+			if (rem[s] > rem[best] ||
+			    (rem[s] == rem[best] && count[s] > count[best]))
+				best = s;
+		norm[best]++;
+		rem[best] = 0;
+		diff--;
+	}
+
+	while (diff < 0) {
+		for (best = 0, s = 1; s < nsym; s++)
+			if (norm[s] > norm[best])
+				best = s;
+		norm[best]--;
+		diff++;
+	}
+}
+
+/* the inverse of zstd_read_ncount(), returns the size or 0 if too small */
+static size_t zstd_write_ncount(u8 *dst, size_t size, const s16 *norm,
+				unsigned int nsym, unsigned int log)
+{
+	int remaining = (1 << log) + 1;
+	int threshold = 1 << log;
+	unsigned int nbits = log + 1;
+	unsigned int s = 0, zeros;
+	struct zstd_bitw bw;
+	int count, max;
+	bool prev0 = false;
+
+	zstd_bitw_init(&bw, dst, dst + size);
+	zstd_bitw_add(&bw, log - ZSTD_FSE_LOG_MIN, 4);
+
+	while (remaining > 1) {
+		if (prev0) {
+			for (zeros = 0; s < nsym && !norm[s]; s++)
+				zeros++;
+			for (; zeros >= 3; zeros -= 3) {
+				zstd_bitw_add(&bw, 3, 2);
+				zstd_bitw_flush(&bw);
+			}
+			zstd_bitw_add(&bw, zeros, 2);
+		}
+
+		count = norm[s++];
+		max = (2 * threshold - 1) - remaining;
+		remaining -= count < 0 ? -count : count;
+		count++;
+		if (count >= threshold)
+			count += max;
+		zstd_bitw_add(&bw, count, nbits - (count < max));
+		zstd_bitw_flush(&bw);
+		prev0 = count == 1;
+
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+	}
+
+	/* pad to whole bytes, without the end marker of a bitstream */
+	zstd_bitw_add(&bw, 0, -bw.nbits & 7);
+	zstd_bitw_flush(&bw);
+	return bw.overflow ? 0 : bw.ptr - bw.start;
+}
+
+static void zstd_fse_ctable_build(struct zstd_cctx *cctx,
+				  struct zstd_fse_ctable *ct, const s16 *norm,
+				  unsigned int nsym, unsigned int log)
+{
+	unsigned int size = 1U << log;
+	unsigned int cumul[ZSTD_ML_SYMBOLS + 1];
+	unsigned int s, u, maxbits;
+	int p;
+
+	zstd_fse_spread(cctx->fse_symbols, norm, nsym, log);
+
+	cumul[0] = 0;
+	for (s = 0; s < nsym; s++)
+		cumul[s + 1] = cumul[s] + (norm[s] == -1 ? 1 : norm[s]);
+
+	for (s = 0; s < nsym; s++) {
+		p = norm[s];
+		if (p == -1 || p == 1) {
+			ct->sym[s].delta_nbits = (log << 16) - size;
+			ct->sym[s].find = cumul[s] - 1;
+		} else if (p > 1) {
+			maxbits = log - zstd_highbit(p - 1);
+			ct->sym[s].delta_nbits = (maxbits << 16) -
+						 (p << maxbits);
+			ct->sym[s].find = cumul[s] - p;
+		}
+	}
+
+	/* the k-th state of s in table order, as zstd_fse_build() counts */
+	for (u = 0; u < size; u++)
+		ct->states[cumul[cctx->fse_symbols[u]]++] = size + u;
+
+	ct->log = log;
+}
+
+/* the states are kept offset by the table size, as the reference does */
+static inline u32 zstd_fse_first(const struct zstd_fse_ctable *ct,
+				 unsigned int s)
+{
+	u32 nbits = (ct->sym[s].delta_nbits + (1 << 15)) >> 16;
+	u32 state = (nbits << 16) - ct->sym[s].delta_nbits;
+
+	return ct->states[(state >> nbits) + ct->sym[s].find];
+}
+
+static inline void zstd_fse_encode(struct zstd_bitw *bw,
+				   const struct zstd_fse_ctable *ct,
+				   u32 *state, unsigned int s)
+{
+	u32 nbits = (*state + ct->sym[s].delta_nbits) >> 16;
+
+	zstd_bitw_add(bw, *state, nbits);
+	*state = ct->states[(*state >> nbits) + ct->sym[s].find];
+}
+
+static inline void zstd_fse_flush(struct zstd_bitw *bw,
+				  const struct zstd_fse_ctable *ct, u32 state)
+{
+	zstd_bitw_add(bw, state, ct->log);
+}
+
+/*
+ * FSE compressed Huffman weights, returns the size of the description
+ * without the header byte or 0 if not possible.
+ */
+static size_t zstd_write_weights_fse(struct zstd_cctx *cctx, u8 *dst,
+				     size_t size, const u8 *weights,
+				     unsigned int n)
+{
+	u32 count[ZSTD_HUF_LOG_MAX + 1] = { 0 };
+	s16 norm[ZSTD_HUF_LOG_MAX + 1];
+	struct zstd_fse_ctable *ct = &cctx->of;
+	unsigned int i, log, maxw = 0;
+	struct zstd_bitw bw;
+	u32 st1, st2;
+	size_t hsize, ssize;
+
+	for (i = 0; i < n; i++) {
+		count[weights[i]]++;
+		maxw = max_t(unsigned int, maxw, weights[i]);
+	}
+	for (i = 0; i <= maxw; i++)
+		if (count[i] == n)
+			return 0;
+
+	log = zstd_fse_log(n, maxw, ZSTD_HUF_WEIGHT_LOG_MAX);
+	zstd_fse_normalize(norm, count, maxw + 1, n, log);
+	hsize = zstd_write_ncount(dst, size, norm, maxw + 1, log);
+	if (!hsize)
+		return 0;
+	zstd_fse_ctable_build(cctx, ct, norm, maxw + 1, log);
+
+	/* weights[0] comes out of the first state, see zstd_read_weights_fse */
+	zstd_bitw_init(&bw, dst + hsize, dst + size);
+	i = n;
+	if (n & 1) {
+		st1 = zstd_fse_first(ct, weights[--i]);
+		st2 = zstd_fse_first(ct, weights[--i]);
+		zstd_fse_encode(&bw, ct, &st1, weights[--i]);
+	} else {
+		st2 = zstd_fse_first(ct, weights[--i]);
+		st1 = zstd_fse_first(ct, weights[--i]);
+	}
+	while (i) {
+		zstd_fse_encode(&bw, ct, &st2, weights[--i]);
+		zstd_fse_encode(&bw, ct, &st1, weights[--i]);
+		zstd_bitw_flush(&bw);
+	}
+	zstd_fse_flush(&bw, ct, st2);
+	zstd_fse_flush(&bw, ct, st1);
+	ssize = zstd_bitw_close(&bw);
+
+	return ssize ? hsize + ssize : 0;
+}
+
+/*
+ * Huffman code lengths limited to ZSTD_HUF_LOG_MAX, returns the longest.
+ * The code has to be complete, the decoder derives the last weight.
+ */
+static unsigned int zstd_huf_lengths(struct zstd_cctx *cctx, const u32 *count,
+				     unsigned int maxsym)
+{
+	u32 *cnt = cctx->huf_count;
+	u16 *parent = cctx->huf_parent;
+	u16 *sym = cctx->huf_sym;
+	u8 *len = cctx->huf_len;
+	unsigned int n = 0, i, j, k, a, b, s, maxbits = 0;
+	int kraft;
+
+	/* present symbols by increasing count */
+	for (s = 0; s <= maxsym; s++) {
+		len[s] = 0;
+		if (!count[s])
+			continue;
+		for (i = n; i && cnt[i - 1] > count[s]; i--) {
+			cnt[i] = cnt[i - 1];
+			sym[i] = sym[i - 1];
+		}
+		cnt[i] = count[s];
+		sym[i] = s;
+		n++;
+	}
+
+	/* two queue construction, leaves then internal nodes from n up */
+	for (i = 0, j = n, k = n; k < 2 * n - 1; k++) {
+		a = (i < n && (j >= k || cnt[i] <= cnt[j])) ? i++ : j++;
+		b = (i < n && (j >= k || cnt[i] <= cnt[j])) ? i++ : j++;
+		cnt[k] = cnt[a] + cnt[b];
+		parent[a] = k;
+		parent[b] = k;
+	}
+
+	/* depths, reusing cnt */
+	cnt[2 * n - 2] = 0;
+	for (k = 2 * n - 2; k-- > 0;)
+		cnt[k] = cnt[parent[k]] + 1;
+
+	kraft = 0;
+	for (i = 0; i < n; i++) {
+		len[sym[i]] = min_t(u32, cnt[i], ZSTD_HUF_LOG_MAX);
+		kraft += 1 << (ZSTD_HUF_LOG_MAX - len[sym[i]]);
+	}
+
+	/* clamping made it overfull, lengthen the rarest codes */
+	while (kraft > 1 << ZSTD_HUF_LOG_MAX) {
+		for (i = 0; i < n && kraft > 1 << ZSTD_HUF_LOG_MAX; i++) {
+			s = sym[i];
+			if (len[s] < ZSTD_HUF_LOG_MAX) {
+				kraft -= 1 << (ZSTD_HUF_LOG_MAX - len[s] - 1);
+				len[s]++;
+			}
+		}
+	}
+
+	/* then give any slack back to the most frequent ones */
+	for (i = n; i-- > 0 && kraft < 1 << ZSTD_HUF_LOG_MAX;) {
+		s = sym[i];
+		while (len[s] > 1 &&
+		       kraft + (1 << (ZSTD_HUF_LOG_MAX - len[s])) <=
+		       1 << ZSTD_HUF_LOG_MAX) {
+			kraft += 1 << (ZSTD_HUF_LOG_MAX - len[s]);
+			len[s]--;
+		}
+	}
+
+	for (s = 0; s <= maxsym; s++)
+		maxbits = max_t(unsigned int, maxbits, len[s]);
+	return maxbits;
+}
+
+/* the canonical codes zstd_read_huf() rebuilds from the weights */
+static void zstd_huf_codes(struct zstd_cctx *cctx, const u8 *weights,
+			   unsigned int maxsym, unsigned int maxbits)
+{
+	unsigned int rank[ZSTD_HUF_LOG_MAX + 2] = { 0 };
+	unsigned int next[ZSTD_HUF_LOG_MAX + 2];
+	unsigned int s, w, pos = 0;
+
+	for (s = 0; s <= maxsym; s++)
+		rank[weights[s]]++;
+	for (w = 1; w <= maxbits; w++) {
+		next[w] = pos;
+		pos += rank[w] << (w - 1);
+	}
+	for (s = 0; s <= maxsym; s++) {
+		w = weights[s];
+		if (!w)
+			continue;
+		cctx->huf_code[s] = next[w] >> (w - 1);
+		next[w] += 1 << (w - 1);
+	}
+}
+
+static size_t zstd_huf_stream(const struct zstd_cctx *cctx, u8 *dst,
+			      size_t size, const u8 *src, size_t n)
+{
+	struct zstd_bitw bw;
+
+	zstd_bitw_init(&bw, dst, dst + size);
+
+	/* backwards, so that the decoder gets the first literal first */
+	while (n & 3) {
+		n--;
+		zstd_bitw_add(&bw, cctx->huf_code[src[n]],
+			      cctx->huf_len[src[n]]);
+	}
+	zstd_bitw_flush(&bw);
+	while (n) {
+		n -= 4;
+		zstd_bitw_add(&bw, cctx->huf_code[src[n + 3]],
+			      cctx->huf_len[src[n + 3]]);
+		zstd_bitw_add(&bw, cctx->huf_code[src[n + 2]],
+			      cctx->huf_len[src[n + 2]]);
+		zstd_bitw_add(&bw, cctx->huf_code[src[n + 1]],
+			      cctx->huf_len[src[n + 1]]);
+		zstd_bitw_add(&bw, cctx->huf_code[src[n]],
+			      cctx->huf_len[src[n]]);
+		zstd_bitw_flush(&bw);
+	}
+	return zstd_bitw_close(&bw);
+}
+
+/* Huffman coded literals without the section header, 0 if not smaller */
+static size_t zstd_huf_literals(struct zstd_cctx *cctx, u8 *dst, size_t size,
+				const u32 *count, unsigned int maxsym,
+				bool four)
+{
+	const u8 *src = cctx->lits;
+	size_t n = cctx->nlits;
+	u8 weights[ZSTD_HUF_SYMBOLS];
+	unsigned int s, maxbits;
+	size_t pos, seg, ret, i;
+	u8 *jump;
+
+	maxbits = zstd_huf_lengths(cctx, count, maxsym);
+	for (s = 0; s <= maxsym; s++)
+		weights[s] = cctx->huf_len[s] ?
+			     maxbits + 1 - cctx->huf_len[s] : 0;
+
+	/* the tree, the last weight is implied */
+	if (size < 1)
+		return 0;
+	ret = zstd_write_weights_fse(cctx, dst + 1,
+				     min_t(size_t, size - 1, 127), weights,
+				     maxsym);
+	if (ret && (maxsym > 128 || ret < (maxsym + 1) / 2)) {
+		dst[0] = ret;
+		pos = 1 + ret;
+	} else if (maxsym <= 128) {
+		pos = 1 + (maxsym + 1) / 2;
+		if (pos > size)
+			return 0;
+		dst[0] = 127 + maxsym;
+		for (s = 0; s < maxsym; s += 2)
+			dst[1 + s / 2] = (weights[s] << 4) |
+					 (s + 1 < maxsym ? weights[s + 1] : 0);
+	} else {
+		return 0;
+	}
+	zstd_huf_codes(cctx, weights, maxsym, maxbits);
+
+	if (!four) {
+		ret = zstd_huf_stream(cctx, dst + pos, size - pos, src, n);
+		return ret ? pos + ret : 0;
+	}
+
+	/* jump table with the sizes of the first three streams */
+	if (size - pos < 6)
+		return 0;
+	jump = dst + pos;
+	pos += 6;
+	seg = (n + 3) / 4;
+	for (i = 0; i < 4; i++) {
+		ret = zstd_huf_stream(cctx, dst + pos, size - pos,
+				      src + i * seg, i < 3 ? seg : n - 3 * seg);
+		if (!ret || ret > 0xffff)
+			return 0;
+		if (i < 3)
+			put_unaligned_le16(ret, jump + 2 * i);
+		pos += ret;
+	}
+	return pos;
+}
+
+static size_t zstd_raw_literals(u8 *dst, size_t size, const u8 *lits,
+				size_t n, enum zstd_literals_type type)
+{
+	size_t hsize = n < 32 ? 1 : n < 4096 ? 2 : 3;
+	size_t len = type == ZSTD_LITERALS_RLE ? 1 : n;
+
+	if (size < hsize + len)
+		return 0;
+
+	switch (hsize) {
+	case 1:
+		dst[0] = type | (n << 3);
+		break;
+	case 2:
+		put_unaligned_le16(type | (1 << 2) | (n << 4), dst);
+		break;
+	default:
+		put_unaligned_le16(type | (3 << 2) | (n << 4), dst);
+		dst[2] = n >> 12;
+		break;
+	}
+	memcpy(dst + hsize, lits, len);
+	return hsize + len;
+}
+
+static size_t zstd_write_literals(struct zstd_cctx *cctx, u8 *dst,
+				  size_t size)
+{
+	u32 count[ZSTD_HUF_SYMBOLS] = { 0 };
+	const size_t n = cctx->nlits;
+	unsigned int s, maxsym = 0;
+	size_t raw, hsize, csize, i;
+	bool four;
+	u64 h;
+
+	for (i = 0; i < n; i++)
+		count[cctx->lits[i]]++;
+	for (s = 0; s < ZSTD_HUF_SYMBOLS; s++) {
+		if (count[s] == n && n > 1)
+			return zstd_raw_literals(dst, size, cctx->lits, n,
+						 ZSTD_LITERALS_RLE);
+		if (count[s])
+			maxsym = s;
+	}
+
+	raw = (n < 32 ? 1 : n < 4096 ? 2 : 3) + n;
+	if (n < ZSTD_C_MIN_HUF)
+		goto raw;
+
+	four = n >= 256;
+	hsize = n < 1024 ? 3 : n < 16384 ? 4 : 5;
+	if (size < raw || raw <= hsize)
+		goto raw;
+	csize = zstd_huf_literals(cctx, dst + hsize, raw - hsize - 1, count,
+				  maxsym, four);
+	if (!csize)
+		goto raw;
+
+	h = ZSTD_LITERALS_COMPRESSED;
+	switch (hsize) {
+	case 3:
+		h |= four << 2 | n << 4 | (u64)csize << 14;
+		break;
+	case 4:
+		h |= 2 << 2 | n << 4 | (u64)csize << 18;
+		break;
+	default:
+		h |= 3 << 2 | n << 4 | (u64)csize << 22;
+		break;
+	}
+	for (i = 0; i < hsize; i++)
+		dst[i] = h >> (8 * i);
+	return hsize + csize;
+
+raw:
+	return zstd_raw_literals(dst, size, cctx->lits, n, ZSTD_LITERALS_RAW);
+}
+
+/* the bits needed for count symbols of probability norm / (1 << log) */
+static u64 zstd_fse_cost(const u32 *count, const s16 *norm,
+			 unsigned int nsym, unsigned int log)
+{
+	u64 cost = 0;
+	unsigned int s;
+
+	for (s = 0; s < nsym; s++) {
+		if (!count[s])
+			continue;
+		if (!norm[s])
+			return U64_MAX;
+		cost += (u64)count[s] * ((log << 8) -
+			zstd_log2_q8(norm[s] < 0 ? 1 : norm[s]));
+	}
+	return cost >> 8;
+}
+
+/*
+ * Writes the table of one sequence field and sets up its encoder, either
+ * the predefined distribution, a single symbol or a table of its own.
+ * Returns the mode, or a negative value if the table did not fit.
+ */
+static int zstd_write_seq_table(struct zstd_cctx *cctx,
+				struct zstd_fse_ctable *ct, const u8 *codes,
+				unsigned int nseq, const s16 *def,
+				unsigned int def_log, unsigned int nsym,
+				unsigned int log_max, u8 **opp, u8 *oend)
+{
+	u32 count[ZSTD_ML_SYMBOLS] = { 0 };
+	s16 norm[ZSTD_ML_SYMBOLS];
+	unsigned int i, maxsym = 0, log;
+	u64 def_cost, cost;
+	size_t hsize;
+
+	for (i = 0; i < nseq; i++)
+		count[codes[i]]++;
+	for (i = 0; i < nsym; i++)
+		if (count[i])
+			maxsym = i;
+
+	if (count[maxsym] == nseq && nseq > 2) {
+		if (*opp >= oend)
+			return -1;
+		*(*opp)++ = maxsym;
+		/* a single state of nbits 0 that always comes back */
+		for (i = 0; i < nsym; i++)
+			norm[i] = i == maxsym;
+		zstd_fse_ctable_build(cctx, ct, norm, nsym, 0);
+		return ZSTD_TABLE_RLE;
+	}
+
+	def_cost = zstd_fse_cost(count, def, nsym, def_log);
+	if (nseq > 32) {
+		log = zstd_fse_log(nseq, maxsym, log_max);
+		zstd_fse_normalize(norm, count, maxsym + 1, nseq, log);
+		hsize = zstd_write_ncount(*opp, oend - *opp, norm, maxsym + 1,
+					  log);
+		cost = zstd_fse_cost(count, norm, maxsym + 1, log) + 8 * hsize;
+		if (hsize && cost < def_cost) {
+			*opp += hsize;
+			zstd_fse_ctable_build(cctx, ct, norm, maxsym + 1, log);
+			return ZSTD_TABLE_FSE;
+		}
+	}
+
+	if (def_cost == U64_MAX)
+		return -1;
+	zstd_fse_ctable_build(cctx, ct, def, nsym, def_log);
+	return ZSTD_TABLE_PREDEFINED;
+}
+
+static size_t zstd_write_sequences(struct zstd_cctx *cctx, u8 *dst,
+				   size_t size)
+{
+	const unsigned int nseq = cctx->nseq;
+	const struct zstd_seq *seq;
+	u8 *op = dst, *const oend = dst + size, *modes;
+	int ll_mode, of_mode, ml_mode;
+	u32 ll_st, of_st, ml_st;
+	struct zstd_bitw bw;
+	unsigned int llc, mlc, ofc, n;
+	size_t ret;
+
+	if (size < 4)
+		return 0;
+	if (nseq < 128) {
+		*op++ = nseq;
+	} else {
+		*op++ = (nseq >> 8) + 128;
+		*op++ = nseq;
+	}
+	if (!nseq)
+		return op - dst;
+
+	modes = op++;
+	ll_mode = zstd_write_seq_table(cctx, &cctx->ll, cctx->llc, nseq,
+				       zstd_ll_default, ZSTD_LL_DEFAULT_LOG,
+				       ZSTD_LL_SYMBOLS, ZSTD_LL_LOG_MAX,
+				       &op, oend);
+	of_mode = zstd_write_seq_table(cctx, &cctx->of, cctx->ofc, nseq,
+				       zstd_of_default, ZSTD_OF_DEFAULT_LOG,
+				       ZSTD_OF_SYMBOLS, ZSTD_OF_LOG_MAX,
+				       &op, oend);
+	ml_mode = zstd_write_seq_table(cctx, &cctx->ml, cctx->mlc, nseq,
+				       zstd_ml_default, ZSTD_ML_DEFAULT_LOG,
+				       ZSTD_ML_SYMBOLS, ZSTD_ML_LOG_MAX,
+				       &op, oend);
+	if (ll_mode < 0 || of_mode < 0 || ml_mode < 0)
+		return 0;
+	*modes = ll_mode << 6 | of_mode << 4 | ml_mode << 2;
+
+	/*
+	 * Backwards again, the decoder reads the extra bits of a sequence
+	 * in the order offset, match length, literal length and then moves
+	 * the states in the order literal length, match length, offset.
+	 */
+	zstd_bitw_init(&bw, op, oend);
+	n = nseq - 1;
+	seq = &cctx->seqs[n];
+	llc = cctx->llc[n];
+	mlc = cctx->mlc[n];
+	ofc = cctx->ofc[n];
+	ml_st = zstd_fse_first(&cctx->ml, mlc);
+	of_st = zstd_fse_first(&cctx->of, ofc);
+	ll_st = zstd_fse_first(&cctx->ll, llc);
+	zstd_bitw_add(&bw, seq->ll, zstd_ll_bits[llc]);
+	zstd_bitw_add(&bw, seq->ml - 3, zstd_ml_bits[mlc]);
+	zstd_bitw_flush(&bw);
+	zstd_bitw_add(&bw, seq->ofv, ofc);
+	zstd_bitw_flush(&bw);
+
+	while (n--) {
+		seq = &cctx->seqs[n];
+		llc = cctx->llc[n];
+		mlc = cctx->mlc[n];
+		ofc = cctx->ofc[n];
+		zstd_fse_encode(&bw, &cctx->of, &of_st, ofc);
+		zstd_fse_encode(&bw, &cctx->ml, &ml_st, mlc);
+		zstd_fse_encode(&bw, &cctx->ll, &ll_st, llc);
+		zstd_bitw_flush(&bw);
+		zstd_bitw_add(&bw, seq->ll, zstd_ll_bits[llc]);
+		zstd_bitw_add(&bw, seq->ml - 3, zstd_ml_bits[mlc]);
+		zstd_bitw_flush(&bw);
+		zstd_bitw_add(&bw, seq->ofv, ofc);
+		zstd_bitw_flush(&bw);
+	}
+	zstd_fse_flush(&bw, &cctx->ml, ml_st);
+	zstd_fse_flush(&bw, &cctx->of, of_st);
+	zstd_fse_flush(&bw, &cctx->ll, ll_st);
+
+	ret = zstd_bitw_close(&bw);
+	return ret ? op - dst + ret : 0;
+}
+
+/* one compressed block without its header, 0 if not worth it */
+static size_t zstd_compress_block(struct zstd_cctx *cctx, u8 *dst,
+				  size_t size, const u8 *base, const u8 *bs,
+				  size_t bsize)
+{
+	size_t lsize, ssize;
+	u32 rep[3];
+
+	/* the repeat offsets only move on if the block is really used */
+	memcpy(rep, cctx->rep, sizeof(rep));
+	zstd_find_sequences(cctx, base, bs, bs + bsize);
+
+	size = min(size, bsize - 1);
+	lsize = zstd_write_literals(cctx, dst, size);
+	if (!lsize)
+		goto fail;
+	ssize = zstd_write_sequences(cctx, dst + lsize, size - lsize);
+	if (!ssize)
+		goto fail;
+	return lsize + ssize;
+
+fail:
+	memcpy(cctx->rep, rep, sizeof(rep));
+	return 0;
+}
+
+int zstd_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	struct zstd_cctx *cctx = wrkmem;
+	u8 *op = dst, *const oend = dst + *dst_len;
+	const u8 *ip = src, *const iend = src + src_len;
+	unsigned int fcs_code;
+	size_t bsize, csize;
+	u32 bh;
+
+	BUILD_BUG_ON(sizeof(*cctx) > ZSTD_MEM_COMPRESS);
+
+	/* a single segment frame with the content size, no checksum */
+	if (src_len < 256)
+		fcs_code = 0;
+	else if (src_len < 65536 + 256)
+		fcs_code = 1;
+	else if (src_len <= U32_MAX)
+		fcs_code = 2;
+	else
+		fcs_code = 3;
+
+	if (oend - op < 5 + (fcs_code ? 1 << fcs_code : 1))
+		return -ENOSPC;
+	put_unaligned_le32(ZSTD_MAGIC, op);
+	op[4] = fcs_code << 6 | 0x20;
+	op += 5;
+	switch (fcs_code) {
+	case 0:
+		*op++ = src_len;
+		break;
+	case 1:
+		put_unaligned_le16(src_len - 256, op);
+		op += 2;
+		break;
+	case 2:
+		put_unaligned_le32(src_len, op);
+		op += 4;
+		break;
+	default:
+		put_unaligned_le64(src_len, op);
+		op += 8;
+		break;
+	}
+
+	cctx->hash_log = src_len > 512 ?
+		min_t(unsigned int, zstd_highbit(src_len) - 1,
+		      ZSTD_C_HASH_LOG) : 8;
+	memset(cctx->hash, 0, sizeof(*cctx->hash) << cctx->hash_log);
+	cctx->rep[0] = 1;
+	cctx->rep[1] = 4;
+	cctx->rep[2] = 8;
+
+	do {
+		bsize = min_t(size_t, iend - ip, ZSTD_C_BLOCK_SIZE);
+		if (oend - op < ZSTD_BLOCK_HEADER_SIZE)
+			return -ENOSPC;
+
+		csize = 0;
+		if (bsize > 16)
+			csize = zstd_compress_block(cctx,
+						    op + ZSTD_BLOCK_HEADER_SIZE,
+						    oend - op -
+						    ZSTD_BLOCK_HEADER_SIZE,
+						    src, ip, bsize);
+		if (csize) {
+			bh = ZSTD_BLOCK_COMPRESSED << 1 | csize << 3;
+		} else {
+			if (oend - op - ZSTD_BLOCK_HEADER_SIZE < bsize)
+				return -ENOSPC;
+			memcpy(op + ZSTD_BLOCK_HEADER_SIZE, ip, bsize);
+			bh = ZSTD_BLOCK_RAW << 1 | bsize << 3;
+			csize = bsize;
+		}
+		ip += bsize;
+		bh |= ip == iend;
+
+		op[0] = bh;
+		op[1] = bh >> 8;
+		op[2] = bh >> 16;
+		op += ZSTD_BLOCK_HEADER_SIZE + csize;
+	} while (ip < iend);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(zstd_compress);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Zstandard Compressor");
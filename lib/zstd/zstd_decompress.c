@@ -0,0 +1,946 @@
+/*
+ * Zstandard decoder for Linux kernel
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Decodes complete frames from one flat buffer into another, so the
+ * window is the output buffer itself. Dictionaries are not supported.
+ */
+
+#include <linux/bug.h>
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/zstd.h>
+
+#include "zstd_internal.h"
+
+struct zstd_fse_dentry {
+	u16 base;
+	u8 symbol;
+	u8 nbits;
+};
+
+struct zstd_huf_dentry {
+	u8 symbol;
+	u8 nbits;
+};
+
+struct zstd_fse_dtable {
+	struct zstd_fse_dentry *entries;
+	unsigned int log;
+	bool valid;
+};
+
+struct zstd_dctx {
+	struct zstd_fse_dentry ll_entries[1 << ZSTD_LL_LOG_MAX];
+	struct zstd_fse_dentry ml_entries[1 << ZSTD_ML_LOG_MAX];
+	struct zstd_fse_dentry of_entries[1 << ZSTD_OF_LOG_MAX];
+	struct zstd_huf_dentry huf[1 << ZSTD_HUF_LOG_MAX];
+	struct zstd_fse_dtable ll, ml, of;
+	unsigned int huf_log;
+	bool huf_valid;
+	u32 rep[3];
+	const u8 *frame_start;
+};
+
+struct zstd_fse_state {
+	const struct zstd_fse_dentry *entries;
+	u32 state;
+};
+
+static void zstd_fse_build(struct zstd_fse_dentry *entries, const s16 *norm,
+			   unsigned int nsym, unsigned int log)
+{
+	unsigned int size = 1U << log;
+	u8 symbols[1 << ZSTD_LL_LOG_MAX];
+	u16 next[ZSTD_ML_SYMBOLS];
+	unsigned int s, u, n;
+
+	zstd_fse_spread(symbols, norm, nsym, log);
+
+	for (s = 0; s < nsym; s++)
+		next[s] = norm[s] == -1 ? 1 : norm[s];
+
+	for (u = 0; u < size; u++) {
+		s = symbols[u];
+		n = next[s]++;
+		entries[u].symbol = s;
+		entries[u].nbits = log - zstd_highbit(n);
+		entries[u].base = (n << entries[u].nbits) - size;
+	}
+}
+
+/* a forward LSB first bit reader for the table descriptions */
+struct zstd_hdr_bits {
+	const u8 *src;
+	size_t size;
+	size_t pos;
+};
+
+static u32 zstd_hdr_peek(const struct zstd_hdr_bits *hb, unsigned int n)
+{
+	size_t byte = hb->pos >> 3;
+	u32 v = 0;
+	unsigned int i;
+
+	for (i = 0; i < 4 && byte + i < hb->size; i++)
+		v |= (u32)hb->src[byte + i] << (8 * i);
+	v >>= hb->pos & 7;
+
+	return v & ((1U << n) - 1);
+}
+
+static u32 zstd_hdr_read(struct zstd_hdr_bits *hb, unsigned int n)
+{
+	u32 v = zstd_hdr_peek(hb, n);
+
+	hb->pos += n;
+	return v;
+}
+
+/*
+ * Reads an FSE table description into norm[0..nsym), returns the number
+ * of bytes it took.
+ */
+static int zstd_read_ncount(s16 *norm, unsigned int nsym, unsigned int *log,
+			    unsigned int log_max, const u8 *src, size_t size)
+{
+	struct zstd_hdr_bits hb = { src, size, 0 };
+	int remaining, threshold, count;
+	unsigned int nbits, s = 0;
+	u32 v, max, repeat;
+
+	*log = zstd_hdr_read(&hb, 4) + ZSTD_FSE_LOG_MIN;
+	if (*log > log_max)
+		return -EINVAL;
+
+	remaining = (1 << *log) + 1;
+	threshold = 1 << *log;
+	nbits = *log + 1;
+
+	while (remaining > 1) {
+		if (s >= nsym)
+			return -EINVAL;
+
+		/* values below max take one bit less */
+		max = (2 * threshold - 1) - remaining;
+		v = zstd_hdr_peek(&hb, nbits - 1);
+		if (v < max) {
+			hb.pos += nbits - 1;
+		} else {
+			v = zstd_hdr_read(&hb, nbits);
+			if (v >= threshold)
+				v -= max;
+		}
+
+		count = (int)v - 1;
+		remaining -= count < 0 ? -count : count;
+		norm[s++] = count;
+		if (remaining < 1)
+			return -EINVAL;
+
+		/* a zero is followed by 2-bit repeat counts of more zeroes */
+		if (!count) {
+			do {
+				repeat = zstd_hdr_read(&hb, 2);
+				if (s + repeat > nsym)
+					return -EINVAL;
+				for (v = 0; v < repeat; v++)
+					norm[s++] = 0;
+			} while (repeat == 3);
+		}
+
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+	}
+
+	if ((hb.pos + 7) / 8 > size)
+		return -EINVAL;
+
+	while (s < nsym)
+		norm[s++] = 0;
+	return (hb.pos + 7) / 8;
+}
+
+static int zstd_read_fse_table(struct zstd_fse_dtable *t,
+			       enum zstd_table_mode mode,
+			       const s16 *def, unsigned int def_log,
+			       unsigned int nsym, unsigned int log_max,
+			       const u8 *src, size_t size)
+{
+	s16 norm[ZSTD_ML_SYMBOLS];
+	int ret = 0;
+
+	switch (mode) {
+	case ZSTD_TABLE_PREDEFINED:
+		zstd_fse_build(t->entries, def, nsym, def_log);
+		t->log = def_log;
+		break;
+	case ZSTD_TABLE_RLE:
+		if (!size || src[0] >= nsym)
+			return -EINVAL;
+		t->entries[0].symbol = src[0];
+		t->entries[0].nbits = 0;
+		t->entries[0].base = 0;
+		t->log = 0;
+		ret = 1;
+		break;
+	case ZSTD_TABLE_FSE:
+		ret = zstd_read_ncount(norm, nsym, &t->log, log_max, src, size);
+		if (ret < 0)
+			return ret;
+		zstd_fse_build(t->entries, norm, nsym, t->log);
+		break;
+	case ZSTD_TABLE_REPEAT:
+		if (!t->valid)
+			return -EINVAL;
+		break;
+	}
+
+	t->valid = true;
+	return ret;
+}
+
+static inline void zstd_fse_init(struct zstd_fse_state *st,
+				 const struct zstd_fse_dtable *t,
+				 struct zstd_bitr *br)
+{
+	st->entries = t->entries;
+	st->state = zstd_bitr_read(br, t->log);
+}
+
+static inline u8 zstd_fse_symbol(const struct zstd_fse_state *st)
+{
+	return st->entries[st->state].symbol;
+}
+
+static inline void zstd_fse_update(struct zstd_fse_state *st,
+				   struct zstd_bitr *br)
+{
+	const struct zstd_fse_dentry *e = &st->entries[st->state];
+
+	st->state = e->base + zstd_bitr_read(br, e->nbits);
+}
+
+/*
+ * The Huffman weights are FSE compressed with two interleaved states,
+ * their number is given by where the bitstream runs out.
+ */
+static int zstd_read_weights_fse(u8 *weights, const u8 *src, size_t size)
+{
+	struct zstd_fse_dentry entries[1 << ZSTD_HUF_WEIGHT_LOG_MAX];
+	struct zstd_fse_dtable t = { entries };
+	struct zstd_fse_state st1, st2;
+	s16 norm[ZSTD_HUF_LOG_MAX + 1];
+	struct zstd_bitr br;
+	unsigned int n = 0;
+	int ret;
+
+	ret = zstd_read_ncount(norm, ARRAY_SIZE(norm), &t.log,
+			       ZSTD_HUF_WEIGHT_LOG_MAX, src, size);
+	if (ret < 0)
+		return ret;
+	zstd_fse_build(entries, norm, ARRAY_SIZE(norm), t.log);
+
+	if (zstd_bitr_init(&br, src + ret, size - ret))
+		return -EINVAL;
+	zstd_fse_init(&st1, &t, &br);
+	zstd_fse_init(&st2, &t, &br);
+	zstd_bitr_reload(&br);
+	if (zstd_bitr_overflow(&br))
+		return -EINVAL;
+
+	while (1) {
+		if (n + 2 > ZSTD_HUF_SYMBOLS - 1)
+			return -EINVAL;
+
+		weights[n++] = zstd_fse_symbol(&st1);
+		zstd_fse_update(&st1, &br);
+		zstd_bitr_reload(&br);
+		if (zstd_bitr_overflow(&br)) {
+			weights[n++] = zstd_fse_symbol(&st2);
+			break;
+		}
+
+		weights[n++] = zstd_fse_symbol(&st2);
+		zstd_fse_update(&st2, &br);
+		zstd_bitr_reload(&br);
+		if (zstd_bitr_overflow(&br)) {
+			weights[n++] = zstd_fse_symbol(&st1);
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* reads the Huffman tree description, returns the number of bytes taken */
+static int zstd_read_huf(struct zstd_dctx *dctx, const u8 *src, size_t size)
+{
+	unsigned int rank[ZSTD_HUF_LOG_MAX + 1] = { 0 };
+	unsigned int next[ZSTD_HUF_LOG_MAX + 1];
+	u8 weights[ZSTD_HUF_SYMBOLS];
+	unsigned int i, n, w, len, maxbits, pos;
+	u32 total = 0, left;
+	size_t hsize;
+	int ret;
+
+	if (!size)
+		return -EINVAL;
+
+	if (src[0] >= 128) {
+		n = src[0] - 127;
+		hsize = 1 + (n + 1) / 2;
+		if (hsize > size)
+			return -EINVAL;
+		for (i = 0; i < n; i++)
+			weights[i] = i & 1 ? src[1 + i / 2] & 15 :
+					     src[1 + i / 2] >> 4;
+	} else {
+		hsize = 1 + src[0];
+		if (hsize > size)
+			return -EINVAL;
+		ret = zstd_read_weights_fse(weights, src + 1, src[0]);
+		if (ret < 0)
+			return ret;
+		n = ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		w = weights[i];
+		if (w > ZSTD_HUF_LOG_MAX)
+			return -EINVAL;
+		rank[w]++;
+		if (w)
+			total += 1U << (w - 1);
+	}
+	if (!total)
+		return -EINVAL;
+
+	/* the last weight completes the sum to a power of two */
+	maxbits = zstd_highbit(total) + 1;
+	if (maxbits > ZSTD_HUF_LOG_MAX)
+		return -EINVAL;
+	left = (1U << maxbits) - total;
+	if (left & (left - 1))
+		return -EINVAL;
+	w = zstd_highbit(left) + 1;
+	weights[n++] = w;
+	rank[w]++;
+
+	/* the longest codes come first, in symbol order for equal lengths */
+	pos = 0;
+	for (w = 1; w <= maxbits; w++) {
+		next[w] = pos;
+		pos += rank[w] << (w - 1);
+	}
+
+	for (i = 0; i < n; i++) {
+		w = weights[i];
+		if (!w)
+			continue;
+		len = 1U << (w - 1);
+		while (len--) {
+			dctx->huf[next[w]].symbol = i;
+			dctx->huf[next[w]].nbits = maxbits + 1 - w;
+			next[w]++;
+		}
+	}
+
+	dctx->huf_log = maxbits;
+	dctx->huf_valid = true;
+	return hsize;
+}
+
+static int zstd_huf_stream(const struct zstd_dctx *dctx, u8 *dst, size_t n,
+			   const u8 *src, size_t size)
+{
+	const struct zstd_huf_dentry *e;
+	unsigned int log = dctx->huf_log;
+	struct zstd_bitr br;
+	size_t i = 0;
+
+	if (zstd_bitr_init(&br, src, size))
+		return -EINVAL;
+
+	/* four 11 bit codes fit in what a reload provides */
+	for (; i + 4 <= n; i += 4) {
+		zstd_bitr_reload(&br);
+		e = &dctx->huf[zstd_bitr_peek(&br, log)];
+		dst[i] = e->symbol;
+		br.consumed += e->nbits;
+		e = &dctx->huf[zstd_bitr_peek(&br, log)];
+		dst[i + 1] = e->symbol;
+		br.consumed += e->nbits;
+		e = &dctx->huf[zstd_bitr_peek(&br, log)];
+		dst[i + 2] = e->symbol;
+		br.consumed += e->nbits;
+		e = &dctx->huf[zstd_bitr_peek(&br, log)];
+		dst[i + 3] = e->symbol;
+		br.consumed += e->nbits;
+	}
+	zstd_bitr_reload(&br);
+	for (; i < n; i++) {
+		e = &dctx->huf[zstd_bitr_peek(&br, log)];
+		dst[i] = e->symbol;
+		br.consumed += e->nbits;
+	}
+
+	zstd_bitr_reload(&br);
+	return zstd_bitr_done(&br) ? 0 : -EINVAL;
+}
+
+static int zstd_huf_literals(const struct zstd_dctx *dctx, u8 *dst, size_t n,
+			     const u8 *src, size_t size, bool four)
+{
+	size_t seg, sizes[4];
+	unsigned int i;
+	int ret;
+
+	if (!four)
+		return zstd_huf_stream(dctx, dst, n, src, size);
+
+	if (size < 6)
+		return -EINVAL;
+	sizes[0] = get_unaligned_le16(src);
+	sizes[1] = get_unaligned_le16(src + 2);
+	sizes[2] = get_unaligned_le16(src + 4);
+	src += 6;
+	size -= 6;
+	if (sizes[0] + sizes[1] + sizes[2] > size)
+		return -EINVAL;
+	sizes[3] = size - sizes[0] - sizes[1] - sizes[2];
+
+	seg = (n + 3) / 4;
+	if (3 * seg > n)
+		return -EINVAL;
+
+	for (i = 0; i < 4; i++) {
+		ret = zstd_huf_stream(dctx, dst, i < 3 ? seg : n - 3 * seg,
+				      src, sizes[i]);
+		if (ret)
+			return ret;
+		dst += seg;
+		src += sizes[i];
+	}
+	return 0;
+}
+
+/*
+ * Decodes the literals section. Raw literals are used in place, others
+ * are decoded to the end of the output buffer: the sequences only ever
+ * write below the literals they have not consumed yet, as long as the
+ * block fits.
+ */
+static int zstd_read_literals(struct zstd_dctx *dctx, const u8 *src,
+			      size_t size, u8 *op, u8 *oend,
+			      const u8 **lit, size_t *lit_size)
+{
+	enum zstd_literals_type type;
+	unsigned int sf;
+	size_t hsize, regen, csize;
+	u32 h;
+	u8 *dst;
+	int ret;
+
+	if (!size)
+		return -EINVAL;
+	type = src[0] & 3;
+	sf = (src[0] >> 2) & 3;
+
+	if (type == ZSTD_LITERALS_RAW || type == ZSTD_LITERALS_RLE) {
+		switch (sf) {
+		case 1:
+			hsize = 2;
+			break;
+		case 3:
+			hsize = 3;
+			break;
+		default:
+			hsize = 1;
+			break;
+		}
+		if (size < hsize)
+			return -EINVAL;
+		if (hsize == 1)
+			regen = src[0] >> 3;
+		else if (hsize == 2)
+			regen = (src[0] >> 4) + (src[1] << 4);
+		else
+			regen = (src[0] >> 4) + (src[1] << 4) + (src[2] << 12);
+		if (regen > ZSTD_BLOCK_MAX)
+			return -EINVAL;
+
+		*lit_size = regen;
+		if (type == ZSTD_LITERALS_RAW) {
+			if (size - hsize < regen)
+				return -EINVAL;
+			*lit = src + hsize;
+			return hsize + regen;
+		}
+
+		if (size - hsize < 1)
+			return -EINVAL;
+		if (oend - op < regen)
+			return -ENOSPC;
+		dst = oend - regen;
+		memset(dst, src[hsize], regen);
+		*lit = dst;
+		return hsize + 1;
+	}
+
+	hsize = sf < 2 ? 3 : sf + 2;
+	if (size < hsize)
+		return -EINVAL;
+	h = (src[0] | src[1] << 8 | src[2] << 16 |
+	     (hsize > 3 ? (u32)src[3] << 24 : 0)) >> 4;
+	if (sf < 2) {
+		h &= 0xfffff;
+		regen = h & 0x3ff;
+		csize = h >> 10;
+	} else if (sf == 2) {
+		regen = h & 0x3fff;
+		csize = h >> 14;
+	} else {
+		regen = h & 0x3ffff;
+		csize = (h >> 18) + (src[4] << 10);
+	}
+	if (regen > ZSTD_BLOCK_MAX || size - hsize < csize)
+		return -EINVAL;
+	size = hsize + csize;
+	src += hsize;
+
+	if (type == ZSTD_LITERALS_COMPRESSED) {
+		ret = zstd_read_huf(dctx, src, csize);
+		if (ret < 0)
+			return ret;
+		src += ret;
+		csize -= ret;
+	} else if (!dctx->huf_valid) {
+		return -EINVAL;
+	}
+
+	if (oend - op < regen)
+		return -ENOSPC;
+	dst = oend - regen;
+	ret = zstd_huf_literals(dctx, dst, regen, src, csize, sf != 0);
+	if (ret)
+		return ret;
+
+	*lit = dst;
+	*lit_size = regen;
+	return size;
+}
+
+static int zstd_decode_sequences(struct zstd_dctx *dctx, const u8 *src,
+				 size_t size, u8 **opp, u8 *oend,
+				 const u8 *lit, size_t lit_size)
+{
+	const u8 *const lit_end = lit + lit_size;
+	struct zstd_fse_state ll_st, of_st, ml_st;
+	u32 nseq, i, ll, ml, off, llc, mlc, ofc;
+	enum zstd_table_mode ll_mode, of_mode, ml_mode;
+	struct zstd_bitr br;
+	u8 *op = *opp;
+	const u8 *match;
+	int ret;
+
+	if (!size)
+		return -EINVAL;
+	nseq = src[0];
+	if (nseq < 128) {
+		src++;
+		size--;
+	} else if (nseq < 255) {
+		if (size < 2)
+			return -EINVAL;
+		nseq = ((nseq - 128) << 8) + src[1];
+		src += 2;
+		size -= 2;
+	} else {
+		if (size < 3)
+			return -EINVAL;
+		nseq = get_unaligned_le16(src + 1) + 0x7f00;
+		src += 3;
+		size -= 3;
+	}
+
+	if (!nseq) {
+		if (size)
+			return -EINVAL;
+		goto last_literals;
+	}
+
+	if (!size || (src[0] & 3))
+		return -EINVAL;
+	ll_mode = src[0] >> 6;
+	of_mode = (src[0] >> 4) & 3;
+	ml_mode = (src[0] >> 2) & 3;
+	src++;
+	size--;
+
+	ret = zstd_read_fse_table(&dctx->ll, ll_mode, zstd_ll_default,
+				  ZSTD_LL_DEFAULT_LOG, ZSTD_LL_SYMBOLS,
+				  ZSTD_LL_LOG_MAX, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	ret = zstd_read_fse_table(&dctx->of, of_mode, zstd_of_default,
+				  ZSTD_OF_DEFAULT_LOG, ZSTD_OF_SYMBOLS,
+				  ZSTD_OF_LOG_MAX, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	ret = zstd_read_fse_table(&dctx->ml, ml_mode, zstd_ml_default,
+				  ZSTD_ML_DEFAULT_LOG, ZSTD_ML_SYMBOLS,
+				  ZSTD_ML_LOG_MAX, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	if (zstd_bitr_init(&br, src, size))
+		return -EINVAL;
+	zstd_fse_init(&ll_st, &dctx->ll, &br);
+	zstd_fse_init(&of_st, &dctx->of, &br);
+	zstd_fse_init(&ml_st, &dctx->ml, &br);
+	zstd_bitr_reload(&br);
+
+	for (i = 0; i < nseq; i++) {
+		llc = zstd_fse_symbol(&ll_st);
+		mlc = zstd_fse_symbol(&ml_st);
+		ofc = zstd_fse_symbol(&of_st);
+
+		off = (1U << ofc) + zstd_bitr_read(&br, ofc);
+		zstd_bitr_reload(&br);
+		ml = zstd_ml_base[mlc] + zstd_bitr_read(&br, zstd_ml_bits[mlc]);
+		ll = zstd_ll_base[llc] + zstd_bitr_read(&br, zstd_ll_bits[llc]);
+		zstd_bitr_reload(&br);
+
+		if (i + 1 < nseq) {
+			zstd_fse_update(&ll_st, &br);
+			zstd_fse_update(&ml_st, &br);
+			zstd_fse_update(&of_st, &br);
+			zstd_bitr_reload(&br);
+		}
+		if (zstd_bitr_overflow(&br))
+			return -EINVAL;
+
+		off = zstd_rep_offset(dctx->rep, off, ll);
+
+		if (ll > lit_end - lit)
+			return -EINVAL;
+		if (ll + ml > oend - op)
+			return -ENOSPC;
+		memmove(op, lit, ll);
+		op += ll;
+		lit += ll;
+
+		if (!off || off > op - dctx->frame_start)
+			return -EINVAL;
+		match = op - off;
+		if (off >= ml) {
+			memcpy(op, match, ml);
+			op += ml;
+		} else {
+			while (ml--)
+				*op++ = *match++;
+		}
+	}
+
+	if (!zstd_bitr_done(&br))
+		return -EINVAL;
+
+last_literals:
+	ll = lit_end - lit;
+	if (ll > oend - op)
+		return -ENOSPC;
+	memmove(op, lit, ll);
+	*opp = op + ll;
+	return 0;
+}
+
+static int zstd_decode_block(struct zstd_dctx *dctx, const u8 *src,
+			     size_t size, u8 **opp, u8 *oend)
+{
+	const u8 *lit;
+	size_t lit_size;
+	int ret;
+
+	ret = zstd_read_literals(dctx, src, size, *opp, oend, &lit, &lit_size);
+	if (ret < 0)
+		return ret;
+
+	return zstd_decode_sequences(dctx, src + ret, size - ret, opp, oend,
+				     lit, lit_size);
+}
+
+#define XXH_PRIME64_1	11400714785074694791ULL
+#define XXH_PRIME64_2	14029467366897019727ULL
+#define XXH_PRIME64_3	1609587929392839161ULL
+#define XXH_PRIME64_4	9650029242287828579ULL
+#define XXH_PRIME64_5	2870177450012600261ULL
+
+static inline u64 zstd_xxh64_round(u64 acc, u64 input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = rol64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline u64 zstd_xxh64_merge(u64 acc, u64 val)
+{
+	acc ^= zstd_xxh64_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* the frame checksum is the low half of XXH64 with a zero seed */
+static u64 zstd_xxh64(const u8 *p, size_t len)
+{
+	const u8 *const end = p + len;
+	u64 v1, v2, v3, v4, h;
+
+	if (len >= 32) {
+		v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+		v2 = XXH_PRIME64_2;
+		v3 = 0;
+		v4 = -XXH_PRIME64_1;
+		do {
+			v1 = zstd_xxh64_round(v1, get_unaligned_le64(p));
+			v2 = zstd_xxh64_round(v2, get_unaligned_le64(p + 8));
+			v3 = zstd_xxh64_round(v3, get_unaligned_le64(p + 16));
+			v4 = zstd_xxh64_round(v4, get_unaligned_le64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+
+		h = rol64(v1, 1) + rol64(v2, 7) + rol64(v3, 12) +
+		    rol64(v4, 18);
+		h = zstd_xxh64_merge(h, v1);
+		h = zstd_xxh64_merge(h, v2);
+		h = zstd_xxh64_merge(h, v3);
+		h = zstd_xxh64_merge(h, v4);
+	} else {
+		h = XXH_PRIME64_5;
+	}
+
+	h += len;
+	for (; end - p >= 8; p += 8) {
+		h ^= zstd_xxh64_round(0, get_unaligned_le64(p));
+		h = rol64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+	if (end - p >= 4) {
+		h ^= (u64)get_unaligned_le32(p) * XXH_PRIME64_1;
+		h = rol64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * XXH_PRIME64_5;
+		h = rol64(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static int zstd_decode_frame(struct zstd_dctx *dctx, const u8 **srcp,
+			     size_t *sizep, u8 **opp, u8 *oend)
+{
+	static const u8 dict_id_size[4] = { 0, 1, 2, 4 };
+	static const u8 fcs_size[4] = { 0, 2, 4, 8 };
+	const u8 *src = *srcp;
+	size_t size = *sizep;
+	unsigned int fhd, did_size, fcs_bytes;
+	u64 fcs = 0;
+	u32 did = 0, bh, bsize;
+	u8 *op = *opp;
+	bool single, last;
+	size_t hsize;
+	int ret;
+
+	/* magic number and frame header descriptor */
+	if (size < 5)
+		return -EINVAL;
+	fhd = src[4];
+	if (fhd & 0x08)
+		return -EINVAL;
+	single = fhd & 0x20;
+	did_size = dict_id_size[fhd & 3];
+	fcs_bytes = fcs_size[fhd >> 6];
+	if (single && !fcs_bytes)
+		fcs_bytes = 1;
+
+	hsize = 5 + !single + did_size + fcs_bytes;
+	if (size < hsize)
+		return -EINVAL;
+	src += 5;
+
+	/* the window is all of dst, its descriptor is of no interest */
+	src += !single;
+
+	switch (did_size) {
+	case 1:
+		did = *src;
+		break;
+	case 2:
+		did = get_unaligned_le16(src);
+		break;
+	case 4:
+		did = get_unaligned_le32(src);
+		break;
+	}
+	if (did)
+		return -EOPNOTSUPP;
+	src += did_size;
+
+	switch (fcs_bytes) {
+	case 1:
+		fcs = *src;
+		break;
+	case 2:
+		fcs = get_unaligned_le16(src) + 256;
+		break;
+	case 4:
+		fcs = get_unaligned_le32(src);
+		break;
+	case 8:
+		fcs = get_unaligned_le64(src);
+		break;
+	}
+	src += fcs_bytes;
+	size -= hsize;
+	if (fcs_bytes && fcs > oend - op)
+		return -ENOSPC;
+
+	/* fresh state for each frame */
+	dctx->ll.valid = false;
+	dctx->ml.valid = false;
+	dctx->of.valid = false;
+	dctx->huf_valid = false;
+	dctx->rep[0] = 1;
+	dctx->rep[1] = 4;
+	dctx->rep[2] = 8;
+	dctx->frame_start = op;
+
+	do {
+		if (size < ZSTD_BLOCK_HEADER_SIZE)
+			return -EINVAL;
+		bh = src[0] | (src[1] << 8) | (src[2] << 16);
+		last = bh & 1;
+		bsize = bh >> 3;
+		src += ZSTD_BLOCK_HEADER_SIZE;
+		size -= ZSTD_BLOCK_HEADER_SIZE;
+		if (bsize > ZSTD_BLOCK_MAX)
+			return -EINVAL;
+
+		switch ((bh >> 1) & 3) {
+		case ZSTD_BLOCK_RAW:
+			if (size < bsize)
+				return -EINVAL;
+			if (oend - op < bsize)
+				return -ENOSPC;
+			memcpy(op, src, bsize);
+			op += bsize;
+			break;
+		case ZSTD_BLOCK_RLE:
+			if (size < 1)
+				return -EINVAL;
+			if (oend - op < bsize)
+				return -ENOSPC;
+			memset(op, *src, bsize);
+			op += bsize;
+			bsize = 1;
+			break;
+		case ZSTD_BLOCK_COMPRESSED:
+			if (size < bsize)
+				return -EINVAL;
+			ret = zstd_decode_block(dctx, src, bsize, &op, oend);
+			if (ret)
+				return ret;
+			break;
+		default:
+			return -EINVAL;
+		}
+		src += bsize;
+		size -= bsize;
+	} while (!last);
+
+	if (fcs_bytes && op - dctx->frame_start != fcs)
+		return -EINVAL;
+
+	if (fhd & 0x04) {
+		if (size < 4)
+			return -EINVAL;
+		if ((u32)zstd_xxh64(dctx->frame_start,
+				    op - dctx->frame_start) !=
+		    get_unaligned_le32(src))
+			return -EINVAL;
+		src += 4;
+		size -= 4;
+	}
+
+	*srcp = src;
+	*sizep = size;
+	*opp = op;
+	return 0;
+}
+
+int zstd_decompress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	struct zstd_dctx *dctx = wrkmem;
+	u8 *op = dst, *const oend = dst + *dst_len;
+	u32 magic, skip;
+	int ret;
+
+	BUILD_BUG_ON(sizeof(*dctx) > ZSTD_MEM_DECOMPRESS);
+
+	dctx->ll.entries = dctx->ll_entries;
+	dctx->ml.entries = dctx->ml_entries;
+	dctx->of.entries = dctx->of_entries;
+
+	do {
+		if (src_len < 4)
+			return -EINVAL;
+		magic = get_unaligned_le32(src);
+
+		if ((magic & ZSTD_MAGIC_SKIPPABLE_MASK) ==
+		    ZSTD_MAGIC_SKIPPABLE) {
+			if (src_len < 8)
+				return -EINVAL;
+			skip = get_unaligned_le32(src + 4);
+			if (src_len - 8 < skip)
+				return -EINVAL;
+			src += 8 + skip;
+			src_len -= 8 + skip;
+			continue;
+		}
+
+		if (magic != ZSTD_MAGIC)
+			return -EINVAL;
+		ret = zstd_decode_frame(dctx, &src, &src_len, &op, oend);
+		if (ret)
+			return ret;
+	} while (src_len);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(zstd_decompress);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Zstandard Decompressor");
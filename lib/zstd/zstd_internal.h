@@ -0,0 +1,317 @@
+/*
+ * zstd_internal.h -- definitions shared by the zstd compressor and decoder
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The names of the fields and tables follow the Zstandard format
+ * description, doc/zstd_compression_format.md in the reference sources.
+ */
+
+#ifndef __ZSTD_INTERNAL_H__
+#define __ZSTD_INTERNAL_H__
+
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <asm/unaligned.h>
+
+#define ZSTD_MAGIC		0xFD2FB528U
+#define ZSTD_MAGIC_SKIPPABLE	0x184D2A50U
+#define ZSTD_MAGIC_SKIPPABLE_MASK 0xFFFFFFF0U
+
+#define ZSTD_BLOCK_MAX		(128 * 1024)
+#define ZSTD_BLOCK_HEADER_SIZE	3
+
+enum zstd_block_type {
+	ZSTD_BLOCK_RAW,
+	ZSTD_BLOCK_RLE,
+	ZSTD_BLOCK_COMPRESSED,
+	ZSTD_BLOCK_RESERVED,
+};
+
+enum zstd_literals_type {
+	ZSTD_LITERALS_RAW,
+	ZSTD_LITERALS_RLE,
+	ZSTD_LITERALS_COMPRESSED,
+	ZSTD_LITERALS_TREELESS,
+};
+
+enum zstd_table_mode {
+	ZSTD_TABLE_PREDEFINED,
+	ZSTD_TABLE_RLE,
+	ZSTD_TABLE_FSE,
+	ZSTD_TABLE_REPEAT,
+};
+
+#define ZSTD_HUF_LOG_MAX	11
+#define ZSTD_HUF_WEIGHT_LOG_MAX	6
+#define ZSTD_HUF_SYMBOLS	256
+
+#define ZSTD_LL_SYMBOLS		36
+#define ZSTD_ML_SYMBOLS		53
+#define ZSTD_OF_SYMBOLS		32
+#define ZSTD_LL_LOG_MAX		9
+#define ZSTD_ML_LOG_MAX		9
+#define ZSTD_OF_LOG_MAX		8
+#define ZSTD_FSE_LOG_MIN	5
+
+#define ZSTD_LL_DEFAULT_LOG	6
+#define ZSTD_ML_DEFAULT_LOG	6
+#define ZSTD_OF_DEFAULT_LOG	5
+
+static const u32 zstd_ll_base[ZSTD_LL_SYMBOLS] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048,
+	4096, 8192, 16384, 32768, 65536,
+};
+
+static const u8 zstd_ll_bits[ZSTD_LL_SYMBOLS] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16,
+};
+
+static const u32 zstd_ml_base[ZSTD_ML_SYMBOLS] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539,
+};
+
+static const u8 zstd_ml_bits[ZSTD_ML_SYMBOLS] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16,
+};
+
+/*
+ * An offset code is its number of extra bits, the offset value is
+ * (1 << code) + extra. Values 1 to 3 refer to the repeat offsets.
+ */
+
+static const s16 zstd_ll_default[ZSTD_LL_SYMBOLS] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+
+static const s16 zstd_ml_default[ZSTD_ML_SYMBOLS] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+/* offset codes above 28 do not occur with the predefined distribution */
+static const s16 zstd_of_default[ZSTD_OF_SYMBOLS] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, 0, 0, 0,
+};
+
+static inline unsigned int zstd_highbit(u32 v)
+{
+	return fls(v) - 1;
+}
+
+/*
+ * FSE symbol spread, common to both directions: the symbols with a "less
+ * than 1" probability of -1 go to the end of the table, the others are
+ * scattered with a fixed step that visits every cell once.
+ */
+static inline void zstd_fse_spread(u8 *symbols, const s16 *norm,
+				   unsigned int nsym, unsigned int log)
+{
+	unsigned int size = 1U << log;
+	unsigned int high = size - 1;
+	unsigned int step = (size >> 1) + (size >> 3) + 3;
+	unsigned int pos = 0;
+	unsigned int s;
+	int i;
+
+	for (s = 0; s < nsym; s++)
+		if (norm[s] == -1)
+			symbols[high--] = s;
+
+	for (s = 0; s < nsym; s++) {
+		for (i = 0; i < norm[s]; i++) {
+			symbols[pos] = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+}
+
+/*
+ * Turns an offset value from a sequence into the match offset and updates
+ * the repeat offsets the way a decoder does.
+ */
+static inline u32 zstd_rep_offset(u32 *rep, u32 value, u32 ll)
+{
+	u32 idx, off;
+
+	if (value > 3) {
+		off = value - 3;
+		rep[2] = rep[1];
+		rep[1] = rep[0];
+		rep[0] = off;
+		return off;
+	}
+
+	/* without literals repeat 1 is pointless, the codes shift by one */
+	idx = value - 1 + !ll;
+	if (!idx)
+		return rep[0];
+
+	off = idx == 3 ? rep[0] - 1 : rep[idx];
+	if (idx != 1)
+		rep[2] = rep[1];
+	rep[1] = rep[0];
+	rep[0] = off;
+	return off;
+}
+
+/*
+ * Sequences and Huffman coded literals are stored as bitstreams that are
+ * written forwards and read backwards, starting below the highest set
+ * bit of the last byte.
+ */
+struct zstd_bitw {
+	u64 bits;
+	unsigned int nbits;
+	u8 *start;
+	u8 *ptr;
+	u8 *end;
+	bool overflow;
+};
+
+static inline void zstd_bitw_init(struct zstd_bitw *bw, u8 *start, u8 *end)
+{
+	bw->bits = 0;
+	bw->nbits = 0;
+	bw->start = start;
+	bw->ptr = start;
+	bw->end = end;
+	bw->overflow = false;
+}
+
+/* at most 56 bits between two flushes */
+static inline void zstd_bitw_add(struct zstd_bitw *bw, u32 val,
+				 unsigned int n)
+{
+	bw->bits |= (u64)(val & ((1ULL << n) - 1)) << bw->nbits;
+	bw->nbits += n;
+}
+
+static inline void zstd_bitw_flush(struct zstd_bitw *bw)
+{
+	while (bw->nbits >= 8) {
+		if (bw->ptr < bw->end)
+			*bw->ptr++ = bw->bits;
+		else
+			bw->overflow = true;
+		bw->bits >>= 8;
+		bw->nbits -= 8;
+	}
+}
+
+/* add the end marker, returns the stream size or 0 if it did not fit */
+static inline size_t zstd_bitw_close(struct zstd_bitw *bw)
+{
+	zstd_bitw_add(bw, 1, 1);
+	zstd_bitw_flush(bw);
+	if (bw->nbits)
+		zstd_bitw_add(bw, 0, 8 - bw->nbits);
+	zstd_bitw_flush(bw);
+
+	return bw->overflow ? 0 : bw->ptr - bw->start;
+}
+
+struct zstd_bitr {
+	u64 bits;
+	unsigned int consumed;	/* from the top of bits */
+	const u8 *start;
+	const u8 *ptr;
+};
+
+static inline int zstd_bitr_init(struct zstd_bitr *br, const u8 *start,
+				 size_t size)
+{
+	u8 last;
+	size_t i;
+
+	if (!size || !start[size - 1])
+		return -EINVAL;
+	last = start[size - 1];
+
+	br->start = start;
+	if (size >= sizeof(br->bits)) {
+		br->ptr = start + size - sizeof(br->bits);
+		br->bits = get_unaligned_le64(br->ptr);
+		br->consumed = 8 - zstd_highbit(last);
+	} else {
+		/* the missing high bytes count as already consumed */
+		br->ptr = start;
+		br->bits = 0;
+		for (i = 0; i < size; i++)
+			br->bits |= (u64)start[i] << (8 * i);
+		br->consumed = 8 - zstd_highbit(last) +
+			       8 * (sizeof(br->bits) - size);
+	}
+	return 0;
+}
+
+static inline u32 zstd_bitr_peek(const struct zstd_bitr *br, unsigned int n)
+{
+	return ((br->bits << (br->consumed & 63)) >> 1) >> ((63 - n) & 63);
+}
+
+static inline u32 zstd_bitr_read(struct zstd_bitr *br, unsigned int n)
+{
+	u32 v = zstd_bitr_peek(br, n);
+
+	br->consumed += n;
+	return v;
+}
+
+/*
+ * Makes at least 57 bits available unless the start of the buffer is
+ * near. Reading past the start shows up as consumed > 64.
+ */
+static inline void zstd_bitr_reload(struct zstd_bitr *br)
+{
+	unsigned int n;
+
+	if (br->consumed > 64)
+		return;
+
+	if (br->ptr == br->start)
+		return;
+
+	if (br->ptr >= br->start + sizeof(br->bits)) {
+		br->ptr -= br->consumed >> 3;
+		br->consumed &= 7;
+	} else {
+		n = min_t(size_t, br->consumed >> 3, br->ptr - br->start);
+		br->ptr -= n;
+		br->consumed -= n * 8;
+	}
+	br->bits = get_unaligned_le64(br->ptr);
+}
+
+static inline bool zstd_bitr_overflow(const struct zstd_bitr *br)
+{
+	return br->consumed > 64;
+}
+
+static inline bool zstd_bitr_done(const struct zstd_bitr *br)
+{
+	return br->ptr == br->start && br->consumed == 64;
+}
+
+#endif
@@ -106,14 +106,22 @@ static int br_dev_init(struct net_device *dev)
 	if (!br->stats)
 		return -ENOMEM;
 
+	err = br_fwd_cache_init(br);
+	if (err) {
+		free_percpu(br->stats);
+		return err;
+	}
+
 	err = br_vlan_init(br);
 	if (err) {
+		br_fwd_cache_free(br);
 		free_percpu(br->stats);
 		return err;
 	}
 
 	err = br_multicast_init_stats(br);
 	if (err) {
+		br_fwd_cache_free(br);
 		free_percpu(br->stats);
 		br_vlan_flush(br);
 	}
@@ -367,6 +375,7 @@ static void br_dev_free(struct net_device *dev)
 {
 	struct net_bridge *br = netdev_priv(dev);
 
+	br_fwd_cache_free(br);
 	free_percpu(br->stats);
 	free_netdev(dev);
 }
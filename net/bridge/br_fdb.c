@@ -22,6 +22,8 @@
 #include <linux/random.h>
 #include <linux/slab.h>
 #include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
 #include <asm/unaligned.h>
 #include <linux/if_vlan.h>
 #include <net/switchdev.h>
@@ -79,6 +81,19 @@ static inline int br_mac_hash(const unsigned char *mac, __u16 vid)
 	return jhash_2words(key, vid, fdb_salt) & (BR_HASH_SIZE - 1);
 }
 
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+static void br_fwd_cache_invalidate(struct net_bridge *br)
+{
+	/* the FDB change must be visible before the new generation */
+	smp_mb__before_atomic();
+	atomic_inc(&br->fwd_cache_gen);
+}
+#else
+static inline void br_fwd_cache_invalidate(struct net_bridge *br)
+{
+}
+#endif
+
 static void fdb_rcu_free(struct rcu_head *head)
 {
 	struct net_bridge_fdb_entry *ent
@@ -177,6 +192,7 @@ static void fdb_delete_local(struct net_bridge *br,
 		    (!vid || br_vlan_find(vg, vid))) {
 			f->dst = op;
 			f->added_by_user = 0;
+			br_fwd_cache_invalidate(br);
 			return;
 		}
 	}
@@ -188,6 +204,7 @@ static void fdb_delete_local(struct net_bridge *br,
 	    (!vid || (v && br_vlan_should_use(v)))) {
 		f->dst = NULL;
 		f->added_by_user = 0;
+		br_fwd_cache_invalidate(br);
 		return;
 	}
 
@@ -688,6 +705,9 @@ static void fdb_notify(struct net_bridge *br,
 	struct sk_buff *skb;
 	int err = -ENOBUFS;
 
+	/* every change of an entry is notified */
+	br_fwd_cache_invalidate(br);
+
 	skb = nlmsg_new(fdb_nlmsg_size(), GFP_ATOMIC);
 	if (skb == NULL)
 		goto errout;
@@ -1155,3 +1175,170 @@ int br_fdb_external_learn_del(struct net_bridge *br, struct net_bridge_port *p,
 
 	return err;
 }
+
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+/* Per CPU cache of the two FDB lookups done for every forwarded unicast
+ * frame, keyed by ingress port, source, destination and VLAN. An entry is
+ * only trusted while the generation it was filled in is current, any
+ * notified FDB change starts a new one. FDB entries are freed by RCU
+ * after that, so the cached pointers stay valid during the rx path.
+ * VLAN filtering and the port state are still checked for every frame.
+ */
+#define BR_FWD_CACHE_SIZE	128
+
+struct br_fwd_cache_entry {
+	const struct net_bridge_port	*port;
+	struct net_bridge_fdb_entry	*src;
+	struct net_bridge_fdb_entry	*dst;
+	unsigned int			gen;
+	u16				vid;
+	unsigned char			saddr[ETH_ALEN];
+	unsigned char			daddr[ETH_ALEN];
+};
+
+struct br_fwd_cache {
+	struct br_fwd_cache_entry	entries[BR_FWD_CACHE_SIZE];
+	u64				hits;
+	u64				misses;
+	struct u64_stats_sync		syncp;
+};
+
+int br_fwd_cache_init(struct net_bridge *br)
+{
+	int cpu;
+
+	br->fwd_cache = alloc_percpu(struct br_fwd_cache);
+	if (!br->fwd_cache)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(br->fwd_cache, cpu)->syncp);
+
+	/* The zeroed entries are not part of the first generation */
+	atomic_set(&br->fwd_cache_gen, 1);
+
+	return 0;
+}
+
+void br_fwd_cache_free(struct net_bridge *br)
+{
+	free_percpu(br->fwd_cache);
+}
+
+static struct br_fwd_cache_entry *
+br_fwd_cache_slot(struct br_fwd_cache *fc, const struct net_bridge_port *p,
+		  const struct ethhdr *eth, u16 vid)
+{
+	u32 s = get_unaligned((u32 *)(eth->h_source + 2));
+	u32 d = get_unaligned((u32 *)(eth->h_dest + 2));
+	u32 key = jhash_3words(s, d, vid | (u32)p->port_no << 16, fdb_salt);
+
+	return &fc->entries[key & (BR_FWD_CACHE_SIZE - 1)];
+}
+
+/* Returns the destination of a unicast frame if it was cached, the source
+ * entry is refreshed as br_fdb_update() would. Called with rcu_read_lock.
+ */
+struct net_bridge_fdb_entry *br_fwd_cache_get(struct net_bridge *br,
+					      const struct net_bridge_port *p,
+					      const struct sk_buff *skb,
+					      u16 vid)
+{
+	struct br_fwd_cache *fc = this_cpu_ptr(br->fwd_cache);
+	const struct ethhdr *eth = eth_hdr(skb);
+	unsigned long now = jiffies;
+	struct br_fwd_cache_entry *e;
+	bool learn;
+
+	e = br_fwd_cache_slot(fc, p, eth, vid);
+	learn = (p->flags & BR_LEARNING) && hold_time(br);
+
+	if (e->gen != atomic_read(&br->fwd_cache_gen) || e->port != p ||
+	    e->vid != vid || !ether_addr_equal(e->daddr, eth->h_dest) ||
+	    !ether_addr_equal(e->saddr, eth->h_source) ||
+	    has_expired(br, e->dst) || learn != !!e->src ||
+	    (e->src && e->src->dst != p))
+		goto miss;
+
+	if (e->src && e->src->updated != now)
+		e->src->updated = now;
+
+	u64_stats_update_begin(&fc->syncp);
+	fc->hits++;
+	u64_stats_update_end(&fc->syncp);
+
+	return e->dst;
+
+miss:
+	u64_stats_update_begin(&fc->syncp);
+	fc->misses++;
+	u64_stats_update_end(&fc->syncp);
+
+	return NULL;
+}
+
+/* Caches the result of __br_fdb_get() for a forwarded unicast frame.
+ * Called with rcu_read_lock after br_fdb_update() learned the source.
+ */
+void br_fwd_cache_add(struct net_bridge *br, const struct net_bridge_port *p,
+		      const struct sk_buff *skb, u16 vid,
+		      struct net_bridge_fdb_entry *dst)
+{
+	struct br_fwd_cache *fc = this_cpu_ptr(br->fwd_cache);
+	const struct ethhdr *eth = eth_hdr(skb);
+	struct net_bridge_fdb_entry *src = NULL;
+	struct br_fwd_cache_entry *e;
+	unsigned int gen;
+
+	if (dst->is_local)
+		return;
+
+	gen = atomic_read(&br->fwd_cache_gen);
+	/* pairs with the barrier in br_fwd_cache_invalidate() */
+	smp_rmb();
+
+	/* the entries have to be looked up in this generation */
+	if (dst != fdb_find_rcu(&br->hash[br_mac_hash(eth->h_dest, vid)],
+				eth->h_dest, vid))
+		return;
+
+	if ((p->flags & BR_LEARNING) && hold_time(br)) {
+		src = fdb_find_rcu(&br->hash[br_mac_hash(eth->h_source, vid)],
+				   eth->h_source, vid);
+		if (!src || src->is_local || src->dst != p)
+			return;
+	}
+
+	e = br_fwd_cache_slot(fc, p, eth, vid);
+	e->port = p;
+	e->src = src;
+	e->dst = dst;
+	e->vid = vid;
+	ether_addr_copy(e->saddr, eth->h_source);
+	ether_addr_copy(e->daddr, eth->h_dest);
+	e->gen = gen;
+}
+
+void br_fwd_cache_stats(struct net_bridge *br, u64 *hits, u64 *misses)
+{
+	int cpu;
+
+	*hits = 0;
+	*misses = 0;
+
+	for_each_possible_cpu(cpu) {
+		const struct br_fwd_cache *fc = per_cpu_ptr(br->fwd_cache, cpu);
+		unsigned int start;
+		u64 h, m;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&fc->syncp);
+			h = fc->hits;
+			m = fc->misses;
+		} while (u64_stats_fetch_retry_irq(&fc->syncp, start));
+
+		*hits += h;
+		*misses += m;
+	}
+}
+#endif
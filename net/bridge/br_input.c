@@ -148,7 +148,9 @@ int br_handle_frame_finish(struct net *net, struct sock *sk, struct sk_buff *skb
 
 	/* insert into forwarding database after filtering to avoid spoofing */
 	br = p->br;
-	if (p->flags & BR_LEARNING)
+	if (!is_multicast_ether_addr(dest))
+		dst = br_fwd_cache_get(br, p, skb, vid);
+	if (!dst && p->flags & BR_LEARNING)
 		br_fdb_update(br, p, eth_hdr(skb)->h_source, vid, false);
 
 	local_rcv = !!(br->dev->flags & IFF_PROMISC);
@@ -189,16 +191,24 @@ int br_handle_frame_finish(struct net *net, struct sock *sk, struct sk_buff *skb
 		}
 		break;
 	case BR_PKT_UNICAST:
-		dst = __br_fdb_get(br, dest, vid);
+		if (!dst) {
+			dst = __br_fdb_get(br, dest, vid);
+			if (dst)
+				br_fwd_cache_add(br, p, skb, vid, dst);
+		}
 	default:
 		break;
 	}
 
 	if (dst) {
+		unsigned long now = jiffies;
+
 		if (dst->is_local)
 			return br_pass_frame_up(skb);
 
-		dst->used = jiffies;
+		/* avoid dirtying the entry for every frame */
+		if (dst->used != now)
+			dst->used = now;
 		br_forward(dst->dst, skb, local_rcv, false);
 	} else {
 		if (!mcast_hit)
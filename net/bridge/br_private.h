@@ -281,6 +281,10 @@ struct net_bridge
 	struct pcpu_sw_netstats		__percpu *stats;
 	spinlock_t			hash_lock;
 	struct hlist_head		hash[BR_HASH_SIZE];
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+	struct br_fwd_cache		__percpu *fwd_cache;
+	atomic_t			fwd_cache_gen;
+#endif
 #if IS_ENABLED(CONFIG_BRIDGE_NETFILTER)
 	union {
 		struct rtable		fake_rtable;
@@ -516,6 +520,42 @@ int br_fdb_external_learn_add(struct net_bridge *br, struct net_bridge_port *p,
 int br_fdb_external_learn_del(struct net_bridge *br, struct net_bridge_port *p,
 			      const unsigned char *addr, u16 vid);
 
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+int br_fwd_cache_init(struct net_bridge *br);
+void br_fwd_cache_free(struct net_bridge *br);
+struct net_bridge_fdb_entry *br_fwd_cache_get(struct net_bridge *br,
+					      const struct net_bridge_port *p,
+					      const struct sk_buff *skb,
+					      u16 vid);
+void br_fwd_cache_add(struct net_bridge *br, const struct net_bridge_port *p,
+		      const struct sk_buff *skb, u16 vid,
+		      struct net_bridge_fdb_entry *dst);
+void br_fwd_cache_stats(struct net_bridge *br, u64 *hits, u64 *misses);
+#else
+static inline int br_fwd_cache_init(struct net_bridge *br)
+{
+	return 0;
+}
+
+static inline void br_fwd_cache_free(struct net_bridge *br)
+{
+}
+
+static inline struct net_bridge_fdb_entry *
+br_fwd_cache_get(struct net_bridge *br, const struct net_bridge_port *p,
+		 const struct sk_buff *skb, u16 vid)
+{
+	return NULL;
+}
+
+static inline void br_fwd_cache_add(struct net_bridge *br,
+				    const struct net_bridge_port *p,
+				    const struct sk_buff *skb, u16 vid,
+				    struct net_bridge_fdb_entry *dst)
+{
+}
+#endif
+
 /* br_forward.c */
 enum br_pkt_type {
 	BR_PKT_UNICAST,
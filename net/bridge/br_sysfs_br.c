@@ -773,6 +773,30 @@ static ssize_t vlan_stats_enabled_store(struct device *d,
 static DEVICE_ATTR_RW(vlan_stats_enabled);
 #endif
 
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+static ssize_t fwd_cache_hits_show(struct device *d,
+				   struct device_attribute *attr, char *buf)
+{
+	struct net_bridge *br = to_bridge(d);
+	u64 hits, misses;
+
+	br_fwd_cache_stats(br, &hits, &misses);
+	return sprintf(buf, "%llu\n", hits);
+}
+static DEVICE_ATTR_RO(fwd_cache_hits);
+
+static ssize_t fwd_cache_misses_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	struct net_bridge *br = to_bridge(d);
+	u64 hits, misses;
+
+	br_fwd_cache_stats(br, &hits, &misses);
+	return sprintf(buf, "%llu\n", misses);
+}
+static DEVICE_ATTR_RO(fwd_cache_misses);
+#endif
+
 static struct attribute *bridge_attrs[] = {
 	&dev_attr_forward_delay.attr,
 	&dev_attr_hello_time.attr,
@@ -820,6 +844,10 @@ static struct attribute *bridge_attrs[] = {
 	&dev_attr_vlan_protocol.attr,
 	&dev_attr_default_pvid.attr,
 	&dev_attr_vlan_stats_enabled.attr,
+#endif
+#ifdef CONFIG_BRIDGE_FWD_CACHE
+	&dev_attr_fwd_cache_hits.attr,
+	&dev_attr_fwd_cache_misses.attr,
 #endif
 	NULL
 };
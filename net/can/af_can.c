@@ -46,6 +46,7 @@
 #include <linux/kmod.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/hash.h>
 #include <linux/spinlock.h>
 #include <linux/rcupdate.h>
 #include <linux/uaccess.h>
@@ -362,6 +363,54 @@ static unsigned int effhash(canid_t can_id)
 	return hash & ((1 << CAN_EFF_RCV_HASH_BITS) - 1);
 }
 
+static unsigned int filhash(canid_t can_id)
+{
+	return hash_32(can_id, CAN_FIL_RCV_HASH_BITS);
+}
+
+/**
+ * find_mask_group - find the mask group of plain can_id/mask filters
+ * @mask: CAN mask of the filter, as reduced by find_rcv_list()
+ * @d: pointer to the device filter struct
+ * @create: add a mask group if there is none for @mask yet
+ *
+ * Description:
+ *  Filters with the same mask are hashed by their can_id into a mask
+ *  group, so the receive path does one lookup per distinct mask instead
+ *  of comparing against every filter. Called with can_rcvlists_lock held.
+ *
+ * Return:
+ *  Pointer to the mask group, or NULL if there is none and none could be
+ *  created. The filter then goes to the linear RX_FIL list.
+ */
+static struct rcv_mask_group *find_mask_group(canid_t mask,
+					      struct dev_rcv_lists *d,
+					      bool create)
+{
+	struct rcv_mask_group *g;
+	unsigned int i;
+
+	hlist_for_each_entry(g, &d->rx_fil_groups, list) {
+		if (g->mask == mask)
+			return g;
+	}
+
+	if (!create)
+		return NULL;
+
+	g = kmalloc(sizeof(*g), GFP_ATOMIC);
+	if (!g)
+		return NULL;
+
+	g->mask = mask;
+	g->entries = 0;
+	for (i = 0; i < CAN_FIL_RCV_ARRAY_SZ; i++)
+		INIT_HLIST_HEAD(&g->rx[i]);
+	hlist_add_head_rcu(&g->list, &d->rx_fil_groups);
+
+	return g;
+}
+
 /**
  * find_rcv_list - determine optimal filterlist inside device filter struct
  * @can_id: pointer to CAN identifier of a given can_filter
@@ -472,6 +521,7 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 		    char *ident, struct sock *sk)
 {
 	struct receiver *r;
+	struct rcv_mask_group *g;
 	struct hlist_head *rl;
 	struct dev_rcv_lists *d;
 	int err = 0;
@@ -490,6 +540,13 @@ int can_rx_register(struct net_device *dev, canid_t can_id, canid_t mask,
 	d = find_dev_rcv_lists(dev);
 	if (d) {
 		rl = find_rcv_list(&can_id, &mask, d);
+		if (rl == &d->rx[RX_FIL]) {
+			g = find_mask_group(mask, d, true);
+			if (g) {
+				rl = &g->rx[filhash(can_id)];
+				g->entries++;
+			}
+		}
 
 		r->can_id  = can_id;
 		r->mask    = mask;
@@ -544,6 +601,7 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 		       void (*func)(struct sk_buff *, void *), void *data)
 {
 	struct receiver *r = NULL;
+	struct rcv_mask_group *g = NULL;
 	struct hlist_head *rl;
 	struct dev_rcv_lists *d;
 
@@ -568,10 +626,26 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 	 * been registered before.
 	 */
 
-	hlist_for_each_entry_rcu(r, rl, list) {
-		if (r->can_id == can_id && r->mask == mask &&
-		    r->func == func && r->data == data)
-			break;
+	if (rl == &d->rx[RX_FIL]) {
+		g = find_mask_group(mask, d, false);
+		if (g) {
+			hlist_for_each_entry(r, &g->rx[filhash(can_id)], list) {
+				if (r->can_id == can_id && r->func == func &&
+				    r->data == data)
+					break;
+			}
+			/* registered while the group could not be created */
+			if (!r)
+				g = NULL;
+		}
+	}
+
+	if (!r) {
+		hlist_for_each_entry_rcu(r, rl, list) {
+			if (r->can_id == can_id && r->mask == mask &&
+			    r->func == func && r->data == data)
+				break;
+		}
 	}
 
 	/*
@@ -588,6 +662,11 @@ void can_rx_unregister(struct net_device *dev, canid_t can_id, canid_t mask,
 	hlist_del_rcu(&r->list);
 	d->entries--;
 
+	if (g && !--g->entries) {
+		hlist_del_rcu(&g->list);
+		kfree_rcu(g, rcu);
+	}
+
 	if (can_pstats.rcv_entries > 0)
 		can_pstats.rcv_entries--;
 
@@ -617,6 +696,7 @@ static inline void deliver(struct sk_buff *skb, struct receiver *r)
 
 static int can_rcv_filter(struct dev_rcv_lists *d, struct sk_buff *skb)
 {
+	struct rcv_mask_group *g;
 	struct receiver *r;
 	int matches = 0;
 	struct can_frame *cf = (struct can_frame *)skb->data;
@@ -650,6 +730,18 @@ static int can_rcv_filter(struct dev_rcv_lists *d, struct sk_buff *skb)
 		}
 	}
 
+	/* check for can_id/mask entries hashed by their mask group */
+	hlist_for_each_entry_rcu(g, &d->rx_fil_groups, list) {
+		canid_t id = can_id & g->mask;
+
+		hlist_for_each_entry_rcu(r, &g->rx[filhash(id)], list) {
+			if (r->can_id == id) {
+				deliver(skb, r);
+				matches++;
+			}
+		}
+	}
+
 	/* check for inverted can_id/mask entries */
 	hlist_for_each_entry_rcu(r, &d->rx[RX_INV], list) {
 		if ((can_id & r->mask) != r->can_id) {
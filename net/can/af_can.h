@@ -63,6 +63,17 @@ struct receiver {
 #define CAN_SFF_RCV_ARRAY_SZ (1 << CAN_SFF_ID_BITS)
 #define CAN_EFF_RCV_HASH_BITS 10
 #define CAN_EFF_RCV_ARRAY_SZ (1 << CAN_EFF_RCV_HASH_BITS)
+#define CAN_FIL_RCV_HASH_BITS 6
+#define CAN_FIL_RCV_ARRAY_SZ (1 << CAN_FIL_RCV_HASH_BITS)
+
+/* can_id/mask filters sharing the same mask, hashed by their can_id */
+struct rcv_mask_group {
+	struct hlist_node list;
+	canid_t mask;
+	int entries;
+	struct hlist_head rx[CAN_FIL_RCV_ARRAY_SZ];
+	struct rcu_head rcu;
+};
 
 enum { RX_ERR, RX_ALL, RX_FIL, RX_INV, RX_MAX };
 
@@ -71,6 +82,7 @@ struct dev_rcv_lists {
 	struct hlist_head rx[RX_MAX];
 	struct hlist_head rx_sff[CAN_SFF_RCV_ARRAY_SZ];
 	struct hlist_head rx_eff[CAN_EFF_RCV_ARRAY_SZ];
+	struct hlist_head rx_fil_groups;
 	int remove_on_zero_entries;
 	int entries;
 };
@@ -340,7 +340,17 @@ static inline void can_rcvlist_proc_show_one(struct seq_file *m, int idx,
 					     struct net_device *dev,
 					     struct dev_rcv_lists *d)
 {
-	if (!hlist_empty(&d->rx[idx])) {
+	struct rcv_mask_group *g;
+	unsigned int i;
+
+	/* can_id/mask filters mostly live in their mask groups */
+	if (idx == RX_FIL && !hlist_empty(&d->rx_fil_groups)) {
+		can_print_recv_banner(m);
+		can_print_rcvlist(m, &d->rx[idx], dev);
+		hlist_for_each_entry_rcu(g, &d->rx_fil_groups, list)
+			for (i = 0; i < CAN_FIL_RCV_ARRAY_SZ; i++)
+				can_print_rcvlist(m, &g->rx[i], dev);
+	} else if (!hlist_empty(&d->rx[idx])) {
 		can_print_recv_banner(m);
 		can_print_rcvlist(m, &d->rx[idx], dev);
 	} else
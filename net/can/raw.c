@@ -89,6 +89,7 @@ struct raw_sock {
 	int recv_own_msgs;
 	int fd_frames;
 	int join_filters;
+	int recv_batch;
 	int count;                 /* number of active filters */
 	struct can_filter dfilter; /* default/single filter */
 	struct can_filter *filter; /* pointer to filter(s) */
@@ -325,6 +326,7 @@ static int raw_init(struct sock *sk)
 	ro->recv_own_msgs    = 0;
 	ro->fd_frames        = 0;
 	ro->join_filters     = 0;
+	ro->recv_batch       = 0;
 
 	/* alloc_percpu provides zero'ed memory */
 	ro->uniq = alloc_percpu(struct uniqframe);
@@ -630,6 +632,15 @@ static int raw_setsockopt(struct socket *sock, int level, int optname,
 
 		break;
 
+	case CAN_RAW_RECV_BATCH:
+		if (optlen != sizeof(ro->recv_batch))
+			return -EINVAL;
+
+		if (copy_from_user(&ro->recv_batch, optval, optlen))
+			return -EFAULT;
+
+		break;
+
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -700,6 +711,12 @@ static int raw_getsockopt(struct socket *sock, int level, int optname,
 		val = &ro->join_filters;
 		break;
 
+	case CAN_RAW_RECV_BATCH:
+		if (len > sizeof(int))
+			len = sizeof(int);
+		val = &ro->recv_batch;
+		break;
+
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -781,11 +798,55 @@ send_failed:
 	return err;
 }
 
+/*
+ * With CAN_RAW_RECV_BATCH a single read also takes the frames queued behind
+ * @first, as long as they fit into the buffer and look the same to the
+ * reader: same size, same interface and same msg flags. Timestamps and the
+ * address describe the first frame of the batch.
+ */
+static size_t raw_recv_batch(struct sock *sk, struct msghdr *msg,
+			     size_t room, struct sk_buff *first)
+{
+	struct sk_buff_head *queue = &sk->sk_receive_queue;
+	struct sk_buff *skb;
+	size_t copied = 0;
+
+	while (room >= first->len) {
+		spin_lock_bh(&queue->lock);
+		skb = skb_peek(queue);
+		if (skb && (skb->len != first->len ||
+			    *raw_flags(skb) != *raw_flags(first) ||
+			    memcmp(skb->cb, first->cb,
+				   sizeof(struct sockaddr_can))))
+			skb = NULL;
+		if (skb)
+			__skb_unlink(skb, queue);
+		spin_unlock_bh(&queue->lock);
+
+		if (!skb)
+			break;
+
+		if (memcpy_to_msg(msg, skb->data, skb->len) < 0) {
+			/* the frame is lost, like a frame that did not fit */
+			atomic_inc(&sk->sk_drops);
+			kfree_skb(skb);
+			break;
+		}
+
+		copied += skb->len;
+		room -= skb->len;
+		consume_skb(skb);
+	}
+
+	return copied;
+}
+
 static int raw_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
 		       int flags)
 {
 	struct sock *sk = sock->sk;
 	struct sk_buff *skb;
+	size_t total;
 	int err = 0;
 	int noblock;
 
@@ -796,6 +857,8 @@ static int raw_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
 	if (!skb)
 		return err;
 
+	total = size;
+
 	if (size < skb->len)
 		msg->msg_flags |= MSG_TRUNC;
 	else
@@ -818,6 +881,10 @@ static int raw_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
 	/* assign the flags that have been recorded in raw_rcv() */
 	msg->msg_flags |= *(raw_flags(skb));
 
+	if (raw_sk(sk)->recv_batch && !(flags & MSG_PEEK) &&
+	    !(msg->msg_flags & MSG_TRUNC))
+		size += raw_recv_batch(sk, msg, total - size, skb);
+
 	skb_free_datagram(sk, skb);
 
 	return size;
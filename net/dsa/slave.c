@@ -611,9 +611,54 @@ static inline netdev_tx_t dsa_netpoll_send_skb(struct dsa_slave_priv *p,
 	return NETDEV_TX_OK;
 }
 
+/* Fallback for the master's queue selection: the traffic class of the
+ * frame on the master if it has any, each port on its own queue within it.
+ */
+static u16 dsa_slave_master_pick_tx(struct net_device *master,
+				    struct sk_buff *skb)
+{
+	struct dsa_slave_priv *p = netdev_priv(skb->dev);
+	u16 qoffset = 0, qcount = master->real_num_tx_queues;
+
+	if (netdev_get_num_tc(master)) {
+		u8 tc = netdev_get_prio_tc_map(master, skb->priority);
+
+		qoffset = master->tc_to_txq[tc].offset;
+		qcount = master->tc_to_txq[tc].count;
+	}
+
+	return qoffset + p->port % qcount;
+}
+
+/* The slave TX queues mirror the master's. The queue is picked here, on
+ * the untagged frame, as the master could no longer parse it once the
+ * switch tag is in place.
+ */
+static u16 dsa_slave_select_queue(struct net_device *dev, struct sk_buff *skb,
+				  void *accel_priv,
+				  select_queue_fallback_t fallback)
+{
+	struct dsa_slave_priv *p = netdev_priv(dev);
+	struct net_device *master = p->parent->dst->master_netdev;
+	const struct net_device_ops *ops = master->netdev_ops;
+	u16 queue;
+
+	if (master->real_num_tx_queues == 1)
+		return 0;
+
+	if (ops->ndo_select_queue)
+		queue = ops->ndo_select_queue(master, skb, NULL,
+					      dsa_slave_master_pick_tx);
+	else
+		queue = dsa_slave_master_pick_tx(master, skb);
+
+	return queue < dev->real_num_tx_queues ? queue : 0;
+}
+
 static netdev_tx_t dsa_slave_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct dsa_slave_priv *p = netdev_priv(dev);
+	u16 queue = skb_get_queue_mapping(skb);
 	struct sk_buff *nskb;
 
 	dev->stats.tx_packets++;
@@ -624,6 +669,9 @@ static netdev_tx_t dsa_slave_xmit(struct sk_buff *skb, struct net_device *dev)
 	if (!nskb)
 		return NETDEV_TX_OK;
 
+	/* Masters using DSA keep the queue picked for the slave */
+	skb_set_queue_mapping(nskb, queue);
+
 	/* SKB for netpoll still need to be mangled with the protocol-specific
 	 * tag to be successfully transmitted
 	 */
@@ -1013,6 +1061,7 @@ static const struct net_device_ops dsa_slave_netdev_ops = {
 	.ndo_open	 	= dsa_slave_open,
 	.ndo_stop		= dsa_slave_close,
 	.ndo_start_xmit		= dsa_slave_xmit,
+	.ndo_select_queue	= dsa_slave_select_queue,
 	.ndo_change_rx_flags	= dsa_slave_change_rx_flags,
 	.ndo_set_rx_mode	= dsa_slave_set_rx_mode,
 	.ndo_set_mac_address	= dsa_slave_set_mac_address,
@@ -1239,8 +1288,12 @@ int dsa_slave_create(struct dsa_switch *ds, struct device *parent,
 	if (ds->master_netdev)
 		master = ds->master_netdev;
 
-	slave_dev = alloc_netdev(sizeof(struct dsa_slave_priv), name,
-				 NET_NAME_UNKNOWN, ether_setup);
+	/* one TX queue per master queue, so that the ports do not all
+	 * contend for a single queue lock
+	 */
+	slave_dev = alloc_netdev_mqs(sizeof(struct dsa_slave_priv), name,
+				     NET_NAME_UNKNOWN, ether_setup,
+				     master->real_num_tx_queues, 1);
 	if (slave_dev == NULL)
 		return -ENOMEM;
 
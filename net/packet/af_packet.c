@@ -247,7 +247,10 @@ struct packet_skb_cb {
 static void __fanout_unlink(struct sock *sk, struct packet_sock *po);
 static void __fanout_link(struct sock *sk, struct packet_sock *po);
 
-static int packet_direct_xmit(struct sk_buff *skb)
+/* @more tells the driver another frame follows right away, it may then
+ * defer kicking the hardware until the last one of the batch.
+ */
+static int __packet_direct_xmit(struct sk_buff *skb, bool more)
 {
 	struct net_device *dev = skb->dev;
 	struct sk_buff *orig_skb = skb;
@@ -268,7 +271,7 @@ static int packet_direct_xmit(struct sk_buff *skb)
 
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_drv_stopped(txq))
-		ret = netdev_start_xmit(skb, dev, txq, false);
+		ret = netdev_start_xmit(skb, dev, txq, more);
 	HARD_TX_UNLOCK(dev, txq);
 
 	local_bh_enable();
@@ -283,6 +286,11 @@ drop:
 	return NET_XMIT_DROP;
 }
 
+static int packet_direct_xmit(struct sk_buff *skb)
+{
+	return __packet_direct_xmit(skb, false);
+}
+
 static struct net_device *packet_cached_dev_get(struct packet_sock *po)
 {
 	struct net_device *dev;
@@ -409,6 +417,9 @@ static void __packet_set_status(struct packet_sock *po, void *frame, int status)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		break;
 	case TPACKET_V3:
+		h.h3->tp_status = status;
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -432,6 +443,8 @@ static int __packet_get_status(struct packet_sock *po, void *frame)
 		flush_dcache_page(pgv_to_page(&h.h2->tp_status));
 		return h.h2->tp_status;
 	case TPACKET_V3:
+		flush_dcache_page(pgv_to_page(&h.h3->tp_status));
+		return h.h3->tp_status;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -476,6 +489,9 @@ static __u32 __packet_set_timestamp(struct packet_sock *po, void *frame,
 		h.h2->tp_nsec = ts.tv_nsec;
 		break;
 	case TPACKET_V3:
+		h.h3->tp_sec = ts.tv_sec;
+		h.h3->tp_nsec = ts.tv_nsec;
+		break;
 	default:
 		WARN(1, "TPACKET version not supported.\n");
 		BUG();
@@ -1189,6 +1205,11 @@ static void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+static void packet_decrement_head(struct packet_ring_buffer *buff)
+{
+	buff->head = buff->head ? buff->head - 1 : buff->frame_max;
+}
+
 static void packet_inc_pending(struct packet_ring_buffer *rb)
 {
 	this_cpu_inc(*rb->pending_refcnt);
@@ -2583,6 +2604,13 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 	ph.raw = frame;
 
 	switch (po->tp_version) {
+	case TPACKET_V3:
+		if (unlikely(ph.h3->tp_next_offset != 0)) {
+			pr_warn_once("variable sized slot not supported\n");
+			return -EINVAL;
+		}
+		tp_len = ph.h3->tp_len;
+		break;
 	case TPACKET_V2:
 		tp_len = ph.h2->tp_len;
 		break;
@@ -2602,6 +2630,9 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 		off_max = po->tx_ring.frame_size - tp_len;
 		if (po->sk.sk_type == SOCK_DGRAM) {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_net;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_net;
 				break;
@@ -2611,6 +2642,9 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 			}
 		} else {
 			switch (po->tp_version) {
+			case TPACKET_V3:
+				off = ph.h3->tp_mac;
+				break;
 			case TPACKET_V2:
 				off = ph.h2->tp_mac;
 				break;
@@ -2629,6 +2663,45 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 	return tp_len;
 }
 
+/* Hands the frame held back for batching to the driver. On error the
+ * frame, right behind the ring head, is given back to user space.
+ */
+static int tpacket_xmit_held(struct packet_sock *po, struct sk_buff **held,
+			     bool more)
+{
+	struct sk_buff *skb = *held;
+	unsigned int len;
+	void *ph;
+	int err;
+
+	if (!skb)
+		return 0;
+
+	*held = NULL;
+	ph = skb_shinfo(skb)->destructor_arg;
+	len = skb->len;
+
+	err = __packet_direct_xmit(skb, more);
+	if (unlikely(err > 0)) {
+		err = net_xmit_errno(err);
+		if (err && __packet_get_status(po, ph) == TP_STATUS_AVAILABLE) {
+			/* skb was destructed already */
+			__packet_set_status(po, ph, TP_STATUS_SEND_REQUEST);
+			packet_decrement_head(&po->tx_ring);
+			po->tx_stats.tp_errors++;
+			return err;
+		}
+		err = 0;
+	}
+
+	po->tx_stats.tp_packets++;
+	po->tx_stats.tp_bytes += len;
+	if (!more)
+		po->tx_stats.tp_flushes++;
+
+	return err;
+}
+
 static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 {
 	struct sk_buff *skb;
@@ -2646,6 +2719,13 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 	int len_sum = 0;
 	int status = TP_STATUS_AVAILABLE;
 	int hlen, tlen, copylen = 0;
+	/* With the qdisc bypassed, consecutive frames go to the driver with
+	 * xmit_more set, at most one ring block per doorbell. The last frame
+	 * is held back until we know whether another one follows.
+	 */
+	bool batch = packet_use_direct_xmit(po);
+	struct sk_buff *held = NULL;
+	unsigned int batched = 0;
 
 	mutex_lock(&po->pg_vec_lock);
 
@@ -2692,6 +2772,13 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		ph = packet_current_frame(po, &po->tx_ring,
 					  TP_STATUS_SEND_REQUEST);
 		if (unlikely(ph == NULL)) {
+			/* nothing follows, let the driver start */
+			if (held) {
+				batched = 0;
+				err = tpacket_xmit_held(po, &held, false);
+				if (unlikely(err))
+					goto out_put;
+			}
 			if (need_wait && need_resched())
 				schedule();
 			continue;
@@ -2721,9 +2808,20 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		skb = sock_alloc_send_skb(&po->sk,
 				hlen + tlen + sizeof(struct sockaddr_ll) +
 				(copylen - dev->hard_header_len),
-				!need_wait, &err);
+				!need_wait || held, &err);
 
 		if (unlikely(skb == NULL)) {
+			/* the send buffer may only drain once the held
+			 * frame is out, flush it before waiting
+			 */
+			if (held && need_wait && err == -EAGAIN) {
+				batched = 0;
+				err = tpacket_xmit_held(po, &held, false);
+				if (unlikely(err))
+					goto out_put;
+				continue;
+			}
+
 			/* we assume the socket was initially writeable ... */
 			if (likely(len_sum > 0))
 				err = len_sum;
@@ -2739,6 +2837,14 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 
 		if (unlikely(tp_len < 0)) {
 tpacket_error:
+			po->tx_stats.tp_errors++;
+			/* the held frame has to stay right behind the head */
+			if (held) {
+				batched = 0;
+				err = tpacket_xmit_held(po, &held, false);
+				if (unlikely(err))
+					goto out_status;
+			}
 			if (po->tp_loss) {
 				__packet_set_status(po, ph,
 						TP_STATUS_AVAILABLE);
@@ -2759,17 +2865,37 @@ tpacket_error:
 
 		packet_pick_tx_queue(dev, skb);
 
+		if (held) {
+			bool more = ++batched < po->tx_ring.frames_per_block &&
+				    skb_get_queue_mapping(held) ==
+				    skb_get_queue_mapping(skb);
+
+			if (!more)
+				batched = 0;
+			err = tpacket_xmit_held(po, &held, more);
+			if (unlikely(err))
+				goto out_status;
+		}
+
 		skb->destructor = tpacket_destruct_skb;
 		__packet_set_status(po, ph, TP_STATUS_SENDING);
 		packet_inc_pending(&po->tx_ring);
 
 		status = TP_STATUS_SEND_REQUEST;
+		if (batch) {
+			held = skb;
+			packet_increment_head(&po->tx_ring);
+			len_sum += tp_len;
+			continue;
+		}
+
 		err = po->xmit(skb);
 		if (unlikely(err > 0)) {
 			err = net_xmit_errno(err);
 			if (err && __packet_get_status(po, ph) ==
 				   TP_STATUS_AVAILABLE) {
 				/* skb was destructed already */
+				po->tx_stats.tp_errors++;
 				skb = NULL;
 				goto out_status;
 			}
@@ -2779,6 +2905,9 @@ tpacket_error:
 			 */
 			err = 0;
 		}
+		po->tx_stats.tp_packets++;
+		po->tx_stats.tp_bytes += tp_len;
+		po->tx_stats.tp_flushes++;
 		packet_increment_head(&po->tx_ring);
 		len_sum += tp_len;
 	} while (likely((ph != NULL) ||
@@ -2794,6 +2923,7 @@ tpacket_error:
 	goto out_put;
 
 out_status:
+	tpacket_xmit_held(po, &held, false);
 	__packet_set_status(po, ph, status);
 	kfree_skb(skb);
 out_put:
@@ -3853,6 +3983,7 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	void *data = &val;
 	union tpacket_stats_u st;
 	struct tpacket_rollover_stats rstats;
+	struct tpacket_tx_stats tx_stats;
 	struct packet_rollover *rollover;
 
 	if (level != SOL_PACKET)
@@ -3931,6 +4062,15 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 			((u32)po->fanout->flags << 24)) :
 		       0);
 		break;
+	case PACKET_TX_STATS:
+		mutex_lock(&po->pg_vec_lock);
+		memcpy(&tx_stats, &po->tx_stats, sizeof(tx_stats));
+		memset(&po->tx_stats, 0, sizeof(po->tx_stats));
+		mutex_unlock(&po->pg_vec_lock);
+
+		data = &tx_stats;
+		lv = sizeof(tx_stats);
+		break;
 	case PACKET_ROLLOVER_STATS:
 		rcu_read_lock();
 		rollover = rcu_dereference(po->rollover);
@@ -4227,9 +4367,14 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	struct tpacket_req *req = &req_u->req;
 
 	lock_sock(sk);
-	/* Opening a Tx-ring is NOT supported in TPACKET_V3 */
-	if (!closing && tx_ring && (po->tp_version > TPACKET_V2)) {
-		net_warn_ratelimited("Tx-ring is not supported.\n");
+	/* A TPACKET_V3 Tx-ring is made of fixed size frames, a user space
+	 * block is flushed to the driver as one batch but has no block
+	 * descriptor, retire timer or private area.
+	 */
+	if (!closing && tx_ring && (po->tp_version > TPACKET_V2) &&
+	    (req_u->req3.tp_retire_blk_tov || req_u->req3.tp_sizeof_priv ||
+	     req_u->req3.tp_feature_req_word)) {
+		net_warn_ratelimited("Tx-ring block options are not supported.\n");
 		goto out;
 	}
 
@@ -4293,9 +4438,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-		/* Transmit path is not supported. We checked
-		 * it above but just being paranoid
-		 */
+			/* Block-based V3 is only used for receiving */
 			if (!tx_ring)
 				init_prb_bdqc(po, rb, pg_vec, req_u);
 			break;
@@ -0,0 +1,456 @@
+/*
+ * net/sched/sch_etf.c	Earliest TxTime First queueing discipline.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ */
+
+/* Earliest TxTime First (ETF)
+ * ===========================
+ *
+ * A per TX queue qdisc for frames that have to leave at a given time.
+ * Every frame carries its transmit time in skb->tstamp, on the clock
+ * selected by 'clockid'. Frames are kept sorted by transmit time and each
+ * one is handed to the device 'delta' nanoseconds before it is due, the
+ * time the driver and the controller need to get it on the wire.
+ *
+ * Frames without a transmit time, or whose time has already passed when
+ * they are enqueued or dequeued, are dropped.
+ *
+ *	'deadline_mode': the transmit time is a deadline rather than a
+ *	launch time, frames are dequeued as soon as possible in deadline
+ *	order and skb->tstamp is rewritten with the dequeue time.
+ *
+ *	'offload': the controller holds each frame until skb->tstamp, the
+ *	qdisc only keeps them in order. Enabled through
+ *	ndo_setup_tc(TC_SETUP_ETF).
+ *
+ * hrtimers cannot run on a PTP hardware clock, use CLOCK_TAI kept in sync
+ * with the controller's clock by phc2sys.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/rbtree.h>
+#include <linux/skbuff.h>
+#include <linux/hrtimer.h>
+#include <net/netlink.h>
+#include <net/sch_generic.h>
+#include <net/pkt_sched.h>
+
+#define DEADLINE_MODE_IS_ON(x) ((x)->flags & TC_ETF_DEADLINE_MODE_ON)
+#define OFFLOAD_IS_ON(x) ((x)->flags & TC_ETF_OFFLOAD_ON)
+
+struct etf_sched_data {
+	bool offload;
+	bool deadline_mode;
+	int clockid;
+	int queue;
+	s32 delta; /* in ns */
+	s64 last; /* txtime of the last frame sent to the device */
+	struct rb_root head;
+	struct Qdisc *sch;
+	struct hrtimer timer;
+};
+
+/* skb->tstamp shares its storage with the rbnode */
+struct etf_skb_cb {
+	s64 txtime;
+};
+
+static inline struct etf_skb_cb *etf_skb_cb(struct sk_buff *skb)
+{
+	qdisc_cb_private_validate(skb, sizeof(struct etf_skb_cb));
+	return (struct etf_skb_cb *)qdisc_skb_cb(skb)->data;
+}
+
+static inline struct sk_buff *etf_rb_to_skb(struct rb_node *rb)
+{
+	return rb_entry(rb, struct sk_buff, rbnode);
+}
+
+static const struct nla_policy etf_policy[TCA_ETF_MAX + 1] = {
+	[TCA_ETF_PARMS]	= { .len = sizeof(struct tc_etf_qopt) },
+};
+
+static s64 etf_get_time(struct etf_sched_data *q)
+{
+	switch (q->clockid) {
+	case CLOCK_REALTIME:
+		return ktime_to_ns(ktime_get_real());
+	case CLOCK_MONOTONIC:
+		return ktime_to_ns(ktime_get());
+	case CLOCK_BOOTTIME:
+		return ktime_to_ns(ktime_get_boottime());
+	case CLOCK_TAI:
+		return ktime_to_ns(ktime_get_clocktai());
+	}
+
+	return 0;
+}
+
+static int validate_input_params(struct tc_etf_qopt *qopt)
+{
+	/* Check if params comply to the following rules:
+	 *	* Clockid is one the hrtimers can run on.
+	 *	* Delta must be a positive integer.
+	 */
+	switch (qopt->clockid) {
+	case CLOCK_REALTIME:
+	case CLOCK_MONOTONIC:
+	case CLOCK_BOOTTIME:
+	case CLOCK_TAI:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (qopt->delta < 0)
+		return -EINVAL;
+
+	return 0;
+}
+
+static bool is_packet_valid(struct Qdisc *sch, s64 txtime)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+
+	if (!txtime)
+		return false;
+
+	/* too late, or out of order with what the device already has */
+	if (txtime < etf_get_time(q) || txtime < q->last)
+		return false;
+
+	return true;
+}
+
+static struct sk_buff *etf_peek_timesortedlist(struct Qdisc *sch)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct rb_node *p;
+
+	p = rb_first(&q->head);
+	if (!p)
+		return NULL;
+
+	return etf_rb_to_skb(p);
+}
+
+static void reset_watchdog(struct Qdisc *sch)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb = etf_peek_timesortedlist(sch);
+	s64 next;
+
+	if (!skb) {
+		hrtimer_try_to_cancel(&q->timer);
+		return;
+	}
+
+	next = etf_skb_cb(skb)->txtime - q->delta;
+	hrtimer_start(&q->timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
+}
+
+static enum hrtimer_restart etf_watchdog(struct hrtimer *timer)
+{
+	struct etf_sched_data *q = container_of(timer, struct etf_sched_data,
+						timer);
+
+	rcu_read_lock();
+	__netif_schedule(qdisc_root(q->sch));
+	rcu_read_unlock();
+
+	return HRTIMER_NORESTART;
+}
+
+static int etf_enqueue_timesortedlist(struct sk_buff *nskb, struct Qdisc *sch,
+				      struct sk_buff **to_free)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct rb_node **p = &q->head.rb_node, *parent = NULL;
+	s64 txtime = ktime_to_ns(nskb->tstamp);
+
+	if (!is_packet_valid(sch, txtime))
+		return qdisc_drop(nskb, sch, to_free);
+
+	if (unlikely(sch->q.qlen >= sch->limit))
+		return qdisc_drop(nskb, sch, to_free);
+
+	etf_skb_cb(nskb)->txtime = txtime;
+
+	while (*p) {
+		struct sk_buff *skb;
+
+		parent = *p;
+		skb = etf_rb_to_skb(parent);
+		if (txtime >= etf_skb_cb(skb)->txtime)
+			p = &parent->rb_right;
+		else
+			p = &parent->rb_left;
+	}
+	rb_link_node(&nskb->rbnode, parent, p);
+	rb_insert_color(&nskb->rbnode, &q->head);
+
+	qdisc_qstats_backlog_inc(sch, nskb);
+	sch->q.qlen++;
+
+	/* Now we may need to re-arm the qdisc watchdog for the next packet. */
+	reset_watchdog(sch);
+
+	return NET_XMIT_SUCCESS;
+}
+
+static void timesortedlist_erase(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+
+	rb_erase(&skb->rbnode, &q->head);
+
+	/* The rbnode field in the skb re-uses these fields, now that
+	 * we are done with the rbnode, reset them.
+	 */
+	skb->next = NULL;
+	skb->prev = NULL;
+	skb->tstamp = ns_to_ktime(etf_skb_cb(skb)->txtime);
+
+	qdisc_qstats_backlog_dec(sch, skb);
+	sch->q.qlen--;
+}
+
+static void timesortedlist_drop(struct Qdisc *sch, s64 now)
+{
+	struct sk_buff *skb;
+
+	while ((skb = etf_peek_timesortedlist(sch))) {
+		if (etf_skb_cb(skb)->txtime >= now)
+			break;
+
+		timesortedlist_erase(sch, skb);
+		qdisc_qstats_overlimit(sch);
+		qdisc_qstats_drop(sch);
+		kfree_skb(skb);
+	}
+}
+
+static struct sk_buff *etf_dequeue_timesortedlist(struct Qdisc *sch)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *skb;
+	s64 now, txtime;
+
+	skb = etf_peek_timesortedlist(sch);
+	if (!skb)
+		return NULL;
+
+	now = etf_get_time(q);
+	txtime = etf_skb_cb(skb)->txtime;
+
+	/* Drop if packet has expired while in queue. */
+	if (txtime < now) {
+		timesortedlist_drop(sch, now);
+		skb = NULL;
+		goto out;
+	}
+
+	/* When in deadline mode, dequeue as soon as possible and change the
+	 * txtime from deadline to (now + delta).
+	 */
+	if (q->deadline_mode) {
+		timesortedlist_erase(sch, skb);
+		skb->tstamp = ns_to_ktime(now);
+		goto out;
+	}
+
+	/* Dequeue only if now is within the [txtime - delta, txtime] range. */
+	if (now <= txtime - q->delta) {
+		skb = NULL;
+		goto out;
+	}
+
+	timesortedlist_erase(sch, skb);
+
+out:
+	if (skb) {
+		q->last = txtime;
+		qdisc_bstats_update(sch, skb);
+	}
+
+	/* Now we may need to re-arm the qdisc watchdog for the next packet. */
+	reset_watchdog(sch);
+
+	return skb;
+}
+
+static void etf_disable_offload(struct net_device *dev,
+				struct etf_sched_data *q)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct tc_etf_qopt_offload etf = { };
+	struct tc_to_netdev tc = { .type = TC_SETUP_ETF };
+
+	if (!q->offload)
+		return;
+
+	etf.queue = q->queue;
+	etf.enable = 0;
+	tc.etf = &etf;
+
+	if (ops->ndo_setup_tc(dev, 0, 0, &tc) < 0)
+		pr_warn("Couldn't disable ETF offload for queue %d\n",
+			etf.queue);
+}
+
+static int etf_enable_offload(struct net_device *dev, struct etf_sched_data *q)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct tc_etf_qopt_offload etf = { };
+	struct tc_to_netdev tc = { .type = TC_SETUP_ETF };
+
+	if (!ops->ndo_setup_tc)
+		return -EOPNOTSUPP;
+
+	etf.queue = q->queue;
+	etf.enable = 1;
+	tc.etf = &etf;
+
+	return ops->ndo_setup_tc(dev, 0, 0, &tc);
+}
+
+static int etf_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct nlattr *tb[TCA_ETF_MAX + 1];
+	struct tc_etf_qopt *qopt;
+	int err;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_ETF_MAX, opt, etf_policy);
+	if (err < 0)
+		return err;
+
+	if (!tb[TCA_ETF_PARMS])
+		return -EINVAL;
+
+	qopt = nla_data(tb[TCA_ETF_PARMS]);
+
+	err = validate_input_params(qopt);
+	if (err < 0)
+		return err;
+
+	q->queue = sch->dev_queue - netdev_get_tx_queue(dev, 0);
+
+	if (OFFLOAD_IS_ON(qopt)) {
+		err = etf_enable_offload(dev, q);
+		if (err < 0)
+			return err;
+	}
+
+	/* Everything went OK, save the parameters used. */
+	q->delta = qopt->delta;
+	q->clockid = qopt->clockid;
+	q->offload = OFFLOAD_IS_ON(qopt);
+	q->deadline_mode = DEADLINE_MODE_IS_ON(qopt);
+
+	sch->limit = max_t(u32, dev->tx_queue_len, 1);
+	q->head = RB_ROOT;
+	q->sch = sch;
+
+	hrtimer_init(&q->timer, q->clockid, HRTIMER_MODE_ABS);
+	q->timer.function = etf_watchdog;
+
+	return 0;
+}
+
+static void etf_reset(struct Qdisc *sch)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct rb_node *p;
+
+	hrtimer_cancel(&q->timer);
+
+	while ((p = rb_first(&q->head))) {
+		struct sk_buff *skb = etf_rb_to_skb(p);
+
+		rb_erase(p, &q->head);
+		rtnl_kfree_skbs(skb, skb);
+	}
+
+	sch->qstats.backlog = 0;
+	sch->q.qlen = 0;
+	q->last = 0;
+}
+
+static void etf_destroy(struct Qdisc *sch)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+
+	hrtimer_cancel(&q->timer);
+
+	etf_disable_offload(dev, q);
+}
+
+static int etf_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct etf_sched_data *q = qdisc_priv(sch);
+	struct tc_etf_qopt opt = { };
+	struct nlattr *nest;
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		goto nla_put_failure;
+
+	opt.delta = q->delta;
+	opt.clockid = q->clockid;
+	if (q->offload)
+		opt.flags |= TC_ETF_OFFLOAD_ON;
+
+	if (q->deadline_mode)
+		opt.flags |= TC_ETF_DEADLINE_MODE_ON;
+
+	if (nla_put(skb, TCA_ETF_PARMS, sizeof(opt), &opt))
+		goto nla_put_failure;
+
+	return nla_nest_end(skb, nest);
+
+nla_put_failure:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static struct Qdisc_ops etf_qdisc_ops __read_mostly = {
+	.next		=	NULL,
+	.id		=	"etf",
+	.priv_size	=	sizeof(struct etf_sched_data),
+	.enqueue	=	etf_enqueue_timesortedlist,
+	.dequeue	=	etf_dequeue_timesortedlist,
+	.peek		=	etf_peek_timesortedlist,
+	.init		=	etf_init,
+	.reset		=	etf_reset,
+	.destroy	=	etf_destroy,
+	.dump		=	etf_dump,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init etf_module_init(void)
+{
+	return register_qdisc(&etf_qdisc_ops);
+}
+
+static void __exit etf_module_exit(void)
+{
+	unregister_qdisc(&etf_qdisc_ops);
+}
+module_init(etf_module_init)
+module_exit(etf_module_exit)
+MODULE_LICENSE("GPL");
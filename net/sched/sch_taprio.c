@@ -0,0 +1,776 @@
+/*
+ * net/sched/sch_taprio.c	Time Aware Priority Scheduler
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ */
+
+/* Time Aware Priority Scheduler (taprio)
+ * ======================================
+ *
+ * A software implementation of the IEEE 802.1Q-2018 Section 8.6.8.4
+ * enhancements for scheduled traffic (formerly 802.1Qbv).
+ *
+ * The root qdisc keeps one FIFO per TX queue and a gate control list.
+ * Every entry of the list opens the gates of the traffic classes in its
+ * gate_mask for 'interval' nanoseconds, the list restarts every cycle
+ * (the sum of the intervals) counting from 'base_time'. A frame is only
+ * dequeued if its gate is open and it can be sent before the gate closes,
+ * which keeps best-effort bursts out of the windows reserved for cyclic
+ * traffic.
+ *
+ * The gates are advanced by an hrtimer on 'clockid'. hrtimers cannot run
+ * on a PTP hardware clock, to follow the network time use CLOCK_TAI and
+ * keep it synchronised to the controller's clock (e.g. the FEC PHC) with
+ * phc2sys.
+ *
+ * With 'offload' set the gate control list is handed to the driver through
+ * ndo_setup_tc(TC_SETUP_TAPRIO) and the qdisc only feeds the queues.
+ */
+
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/list.h>
+#include <linux/errno.h>
+#include <linux/skbuff.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/ethtool.h>
+#include <linux/hrtimer.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/sch_generic.h>
+
+static LIST_HEAD(taprio_list);
+static DEFINE_SPINLOCK(taprio_list_lock);
+
+struct sched_entry {
+	struct list_head list;
+
+	/* The instant the gates of this entry close, set by the timer
+	 * when the entry becomes the current one.
+	 */
+	s64 close_time;
+	int index;
+	u32 gate_mask;
+	u32 interval;
+	u8 command;
+};
+
+struct taprio_sched {
+	struct Qdisc **qdiscs;
+	struct Qdisc *root;
+	bool offload;
+	int clockid;
+	u32 picos_per_byte; /* sub nanosecond at gigabit speeds */
+	s64 base_time;
+	s64 cycle_time;
+	struct list_head entries;
+	int num_entries;
+	struct sched_entry *current_entry;
+	struct hrtimer advance_timer;
+	struct list_head taprio_list;
+};
+
+static s64 taprio_get_time(struct taprio_sched *q)
+{
+	switch (q->clockid) {
+	case CLOCK_REALTIME:
+		return ktime_to_ns(ktime_get_real());
+	case CLOCK_MONOTONIC:
+		return ktime_to_ns(ktime_get());
+	case CLOCK_BOOTTIME:
+		return ktime_to_ns(ktime_get_boottime());
+	case CLOCK_TAI:
+		return ktime_to_ns(ktime_get_clocktai());
+	}
+
+	return 0;
+}
+
+static s64 length_to_duration(struct taprio_sched *q, unsigned int len)
+{
+	return div_u64((u64)len * q->picos_per_byte, 1000);
+}
+
+static int taprio_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			  struct sk_buff **to_free)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct Qdisc *child;
+	int queue, ret;
+
+	queue = skb_get_queue_mapping(skb);
+	child = q->qdiscs[queue];
+	if (unlikely(!child))
+		return qdisc_drop(skb, sch, to_free);
+
+	ret = qdisc_enqueue(skb, child, to_free);
+	if (ret == NET_XMIT_SUCCESS) {
+		qdisc_qstats_backlog_inc(sch, skb);
+		sch->q.qlen++;
+		return NET_XMIT_SUCCESS;
+	}
+
+	if (net_xmit_drop_count(ret))
+		qdisc_qstats_drop(sch);
+	return ret;
+}
+
+/* Returns the child holding the next frame allowed through the gates */
+static struct Qdisc *taprio_select(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct sched_entry *entry;
+	u32 gate_mask = ~0;
+	s64 close = 0, now = 0;
+	int i;
+
+	if (!q->offload) {
+		entry = READ_ONCE(q->current_entry);
+		/* all gates stay closed until base_time */
+		if (!entry)
+			return NULL;
+
+		/* pairs with the smp_wmb() in advance_sched() */
+		smp_rmb();
+		gate_mask = entry->gate_mask;
+		close = entry->close_time;
+		now = taprio_get_time(q);
+	}
+
+	for (i = 0; i < dev->num_tx_queues; i++) {
+		struct Qdisc *child = q->qdiscs[i];
+		struct sk_buff *skb;
+		int tc;
+
+		if (netif_xmit_stopped(netdev_get_tx_queue(dev, i)))
+			continue;
+
+		skb = child->ops->peek(child);
+		if (!skb)
+			continue;
+
+		if (q->offload)
+			return child;
+
+		tc = netdev_get_prio_tc_map(dev, skb->priority);
+		if (!(gate_mask & BIT(tc)))
+			continue;
+
+		/* the frame has to be out before its gate closes */
+		if (now + length_to_duration(q, qdisc_pkt_len(skb)) > close)
+			continue;
+
+		return child;
+	}
+
+	return NULL;
+}
+
+static struct sk_buff *taprio_peek(struct Qdisc *sch)
+{
+	struct Qdisc *child = taprio_select(sch);
+
+	return child ? child->ops->peek(child) : NULL;
+}
+
+static struct sk_buff *taprio_dequeue(struct Qdisc *sch)
+{
+	struct Qdisc *child = taprio_select(sch);
+	struct sk_buff *skb;
+
+	if (!child)
+		return NULL;
+
+	skb = qdisc_dequeue_peeked(child);
+	if (!skb)
+		return NULL;
+
+	qdisc_bstats_update(sch, skb);
+	qdisc_qstats_backlog_dec(sch, skb);
+	sch->q.qlen--;
+
+	return skb;
+}
+
+/* The first cycle start at or after now */
+static s64 taprio_cycle_start(struct taprio_sched *q)
+{
+	s64 now = taprio_get_time(q);
+	s64 n;
+
+	if (q->base_time >= now)
+		return q->base_time;
+
+	n = div64_s64(now - q->base_time, q->cycle_time);
+	return q->base_time + (n + 1) * q->cycle_time;
+}
+
+static enum hrtimer_restart advance_sched(struct hrtimer *timer)
+{
+	struct taprio_sched *q = container_of(timer, struct taprio_sched,
+					      advance_timer);
+	struct sched_entry *entry = q->current_entry;
+	struct sched_entry *next;
+	s64 close;
+
+	if (!entry || list_is_last(&entry->list, &q->entries))
+		next = list_first_entry(&q->entries, struct sched_entry, list);
+	else
+		next = list_next_entry(entry, list);
+
+	close = ktime_to_ns(hrtimer_get_expires(timer)) + next->interval;
+
+	/* The clock jumped or we were suspended, wait for the next cycle
+	 * instead of running through the missed entries.
+	 */
+	if (close + q->cycle_time < taprio_get_time(q)) {
+		WRITE_ONCE(q->current_entry, NULL);
+		hrtimer_set_expires(timer, ns_to_ktime(taprio_cycle_start(q)));
+		return HRTIMER_RESTART;
+	}
+
+	next->close_time = close;
+	/* close_time must be visible before the entry is published */
+	smp_wmb();
+	WRITE_ONCE(q->current_entry, next);
+
+	hrtimer_set_expires(timer, ns_to_ktime(close));
+
+	/* the gates changed, let the queued frames through */
+	__netif_schedule(q->root);
+
+	return HRTIMER_RESTART;
+}
+
+static const struct nla_policy entry_policy[TCA_TAPRIO_SCHED_ENTRY_MAX + 1] = {
+	[TCA_TAPRIO_SCHED_ENTRY_INDEX]	   = { .type = NLA_U32 },
+	[TCA_TAPRIO_SCHED_ENTRY_CMD]	   = { .type = NLA_U8 },
+	[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK] = { .type = NLA_U32 },
+	[TCA_TAPRIO_SCHED_ENTRY_INTERVAL]  = { .type = NLA_U32 },
+};
+
+static const struct nla_policy taprio_policy[TCA_TAPRIO_ATTR_MAX + 1] = {
+	[TCA_TAPRIO_ATTR_PRIOMAP]	    = {
+		.len = sizeof(struct tc_mqprio_qopt)
+	},
+	[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST]   = { .type = NLA_NESTED },
+	[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]    = { .type = NLA_S64 },
+	[TCA_TAPRIO_ATTR_SCHED_SINGLE_ENTRY] = { .type = NLA_NESTED },
+	[TCA_TAPRIO_ATTR_SCHED_CLOCKID]      = { .type = NLA_S32 },
+	[TCA_TAPRIO_ATTR_OFFLOAD]	     = { .type = NLA_U8 },
+};
+
+static int parse_sched_entry(struct nlattr *n, struct sched_entry *entry,
+			     int index)
+{
+	struct nlattr *tb[TCA_TAPRIO_SCHED_ENTRY_MAX + 1];
+	int err;
+
+	err = nla_parse_nested(tb, TCA_TAPRIO_SCHED_ENTRY_MAX, n,
+			       entry_policy);
+	if (err < 0)
+		return err;
+
+	if (!tb[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK] ||
+	    !tb[TCA_TAPRIO_SCHED_ENTRY_INTERVAL])
+		return -EINVAL;
+
+	entry->command = TC_TAPRIO_CMD_SET_GATES;
+	if (tb[TCA_TAPRIO_SCHED_ENTRY_CMD])
+		entry->command = nla_get_u8(tb[TCA_TAPRIO_SCHED_ENTRY_CMD]);
+
+	/* hold and release only make sense with frame preemption */
+	if (entry->command != TC_TAPRIO_CMD_SET_GATES)
+		return -EOPNOTSUPP;
+
+	entry->gate_mask = nla_get_u32(tb[TCA_TAPRIO_SCHED_ENTRY_GATE_MASK]);
+	entry->interval = nla_get_u32(tb[TCA_TAPRIO_SCHED_ENTRY_INTERVAL]);
+	if (!entry->interval)
+		return -EINVAL;
+
+	entry->index = index;
+
+	return 0;
+}
+
+static void taprio_free_entries(struct taprio_sched *q)
+{
+	struct sched_entry *entry, *n;
+
+	list_for_each_entry_safe(entry, n, &q->entries, list) {
+		list_del(&entry->list);
+		kfree(entry);
+	}
+	q->num_entries = 0;
+	q->cycle_time = 0;
+}
+
+static int parse_sched_list(struct nlattr *list, struct taprio_sched *q)
+{
+	struct nlattr *n;
+	int rem, err;
+	int i = 0;
+
+	nla_for_each_nested(n, list, rem) {
+		struct sched_entry *entry;
+
+		if (nla_type(n) != TCA_TAPRIO_SCHED_ENTRY)
+			continue;
+
+		entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+		if (!entry)
+			return -ENOMEM;
+
+		err = parse_sched_entry(n, entry, i);
+		if (err < 0) {
+			kfree(entry);
+			return err;
+		}
+
+		list_add_tail(&entry->list, &q->entries);
+		q->cycle_time += entry->interval;
+		i++;
+	}
+
+	q->num_entries = i;
+
+	return i ? 0 : -EINVAL;
+}
+
+static int taprio_parse_mqprio_opt(struct net_device *dev,
+				   struct tc_mqprio_qopt *qopt)
+{
+	int i, j;
+
+	if (!qopt->num_tc || qopt->num_tc > TC_MAX_QUEUE)
+		return -EINVAL;
+
+	/* the gate mask has one bit per traffic class */
+	if (qopt->num_tc > 32)
+		return -EINVAL;
+
+	for (i = 0; i < TC_BITMASK + 1; i++) {
+		if (qopt->prio_tc_map[i] >= qopt->num_tc)
+			return -EINVAL;
+	}
+
+	for (i = 0; i < qopt->num_tc; i++) {
+		unsigned int last = qopt->offset[i] + qopt->count[i];
+
+		if (!qopt->count[i] ||
+		    qopt->offset[i] >= dev->real_num_tx_queues ||
+		    last > dev->real_num_tx_queues)
+			return -EINVAL;
+
+		/* Verify that the offset and counts do not overlap */
+		for (j = i + 1; j < qopt->num_tc; j++) {
+			if (last > qopt->offset[j])
+				return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void taprio_set_picos_per_byte(struct net_device *dev,
+				      struct taprio_sched *q)
+{
+	struct ethtool_link_ksettings ecmd;
+	int speed = SPEED_100;
+
+	if (!__ethtool_get_link_ksettings(dev, &ecmd) &&
+	    ecmd.base.speed != SPEED_UNKNOWN)
+		speed = ecmd.base.speed;
+
+	q->picos_per_byte = div_u64(USEC_PER_SEC * 8ULL, speed);
+}
+
+static int taprio_dev_notifier(struct notifier_block *nb, unsigned long event,
+			       void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	struct taprio_sched *q, *found = NULL;
+
+	ASSERT_RTNL();
+
+	if (event != NETDEV_UP && event != NETDEV_CHANGE)
+		return NOTIFY_DONE;
+
+	spin_lock(&taprio_list_lock);
+	list_for_each_entry(q, &taprio_list, taprio_list) {
+		if (dev == qdisc_dev(q->root)) {
+			found = q;
+			break;
+		}
+	}
+	spin_unlock(&taprio_list_lock);
+
+	if (found)
+		taprio_set_picos_per_byte(dev, found);
+
+	return NOTIFY_DONE;
+}
+
+static int taprio_enable_offload(struct net_device *dev, struct Qdisc *sch)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct tc_to_netdev tc = { .type = TC_SETUP_TAPRIO };
+	struct tc_taprio_qopt_offload *offload;
+	struct sched_entry *entry;
+	int i = 0, err;
+
+	if (!ops->ndo_setup_tc)
+		return -EOPNOTSUPP;
+
+	offload = kzalloc(sizeof(*offload) +
+			  q->num_entries * sizeof(offload->entries[0]),
+			  GFP_KERNEL);
+	if (!offload)
+		return -ENOMEM;
+
+	offload->enable = 1;
+	offload->clockid = q->clockid;
+	offload->base_time = q->base_time;
+	offload->cycle_time = q->cycle_time;
+	offload->num_entries = q->num_entries;
+
+	list_for_each_entry(entry, &q->entries, list) {
+		offload->entries[i].command = entry->command;
+		offload->entries[i].gate_mask = entry->gate_mask;
+		offload->entries[i].interval = entry->interval;
+		i++;
+	}
+
+	tc.taprio = offload;
+	err = ops->ndo_setup_tc(dev, sch->handle, 0, &tc);
+	kfree(offload);
+
+	return err;
+}
+
+static void taprio_disable_offload(struct net_device *dev, struct Qdisc *sch)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct tc_taprio_qopt_offload offload = { };
+	struct tc_to_netdev tc = { .type = TC_SETUP_TAPRIO };
+
+	tc.taprio = &offload;
+	if (ops->ndo_setup_tc(dev, sch->handle, 0, &tc) < 0)
+		pr_warn("Couldn't disable taprio offload\n");
+}
+
+static int taprio_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct nlattr *tb[TCA_TAPRIO_ATTR_MAX + 1] = { };
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct tc_mqprio_qopt *mqprio;
+	int clockid, i, err;
+
+	err = nla_parse_nested(tb, TCA_TAPRIO_ATTR_MAX, opt, taprio_policy);
+	if (err < 0)
+		return err;
+
+	/* Changing the schedule of a running qdisc is not supported */
+	if (!list_empty(&q->entries))
+		return -EBUSY;
+
+	if (tb[TCA_TAPRIO_ATTR_SCHED_SINGLE_ENTRY])
+		return -EOPNOTSUPP;
+
+	if (!tb[TCA_TAPRIO_ATTR_PRIOMAP] ||
+	    !tb[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST] ||
+	    !tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME] ||
+	    !tb[TCA_TAPRIO_ATTR_SCHED_CLOCKID])
+		return -EINVAL;
+
+	mqprio = nla_data(tb[TCA_TAPRIO_ATTR_PRIOMAP]);
+	err = taprio_parse_mqprio_opt(dev, mqprio);
+	if (err < 0)
+		return err;
+
+	clockid = nla_get_s32(tb[TCA_TAPRIO_ATTR_SCHED_CLOCKID]);
+	switch (clockid) {
+	case CLOCK_REALTIME:
+	case CLOCK_MONOTONIC:
+	case CLOCK_BOOTTIME:
+	case CLOCK_TAI:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	err = parse_sched_list(tb[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST], q);
+	if (err < 0)
+		goto free_entries;
+
+	q->clockid = clockid;
+	q->base_time = nla_get_s64(tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]);
+	if (tb[TCA_TAPRIO_ATTR_OFFLOAD])
+		q->offload = !!nla_get_u8(tb[TCA_TAPRIO_ATTR_OFFLOAD]);
+
+	netdev_set_num_tc(dev, mqprio->num_tc);
+	for (i = 0; i < mqprio->num_tc; i++)
+		netdev_set_tc_queue(dev, i, mqprio->count[i],
+				    mqprio->offset[i]);
+	for (i = 0; i < TC_BITMASK + 1; i++)
+		netdev_set_prio_tc_map(dev, i, mqprio->prio_tc_map[i]);
+
+	if (q->offload) {
+		err = taprio_enable_offload(dev, sch);
+		if (err < 0) {
+			q->offload = false;
+			netdev_reset_tc(dev);
+			goto free_entries;
+		}
+		return 0;
+	}
+
+	taprio_set_picos_per_byte(dev, q);
+
+	hrtimer_init(&q->advance_timer, q->clockid, HRTIMER_MODE_ABS);
+	q->advance_timer.function = advance_sched;
+	q->current_entry = NULL;
+	hrtimer_start(&q->advance_timer, ns_to_ktime(taprio_cycle_start(q)),
+		      HRTIMER_MODE_ABS);
+
+	return 0;
+
+free_entries:
+	taprio_free_entries(q);
+	return err;
+}
+
+static void taprio_reset(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	int i;
+
+	for (i = 0; i < dev->num_tx_queues; i++)
+		if (q->qdiscs[i])
+			qdisc_reset(q->qdiscs[i]);
+
+	sch->qstats.backlog = 0;
+	sch->q.qlen = 0;
+}
+
+static void taprio_destroy(struct Qdisc *sch)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	int i;
+
+	spin_lock(&taprio_list_lock);
+	list_del(&q->taprio_list);
+	spin_unlock(&taprio_list_lock);
+
+	hrtimer_cancel(&q->advance_timer);
+
+	if (q->offload)
+		taprio_disable_offload(dev, sch);
+
+	if (!list_empty(&q->entries))
+		netdev_reset_tc(dev);
+
+	if (q->qdiscs) {
+		for (i = 0; i < dev->num_tx_queues && q->qdiscs[i]; i++)
+			qdisc_destroy(q->qdiscs[i]);
+
+		kfree(q->qdiscs);
+	}
+	q->qdiscs = NULL;
+
+	taprio_free_entries(q);
+}
+
+static int taprio_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	int i, err;
+
+	INIT_LIST_HEAD(&q->entries);
+	hrtimer_init(&q->advance_timer, CLOCK_TAI, HRTIMER_MODE_ABS);
+	q->root = sch;
+
+	spin_lock(&taprio_list_lock);
+	list_add(&q->taprio_list, &taprio_list);
+	spin_unlock(&taprio_list_lock);
+
+	/* The gates span all the TX queues, only a root qdisc can do that */
+	if (sch->parent != TC_H_ROOT) {
+		err = -EOPNOTSUPP;
+		goto err;
+	}
+
+	if (!netif_is_multiqueue(dev) || !opt) {
+		err = -EOPNOTSUPP;
+		goto err;
+	}
+
+	q->qdiscs = kcalloc(dev->num_tx_queues, sizeof(q->qdiscs[0]),
+			    GFP_KERNEL);
+	if (!q->qdiscs) {
+		err = -ENOMEM;
+		goto err;
+	}
+
+	for (i = 0; i < dev->num_tx_queues; i++) {
+		struct netdev_queue *dev_queue = netdev_get_tx_queue(dev, i);
+		struct Qdisc *qdisc;
+
+		qdisc = qdisc_create_dflt(dev_queue, &pfifo_qdisc_ops,
+					  TC_H_MAKE(TC_H_MAJ(sch->handle),
+						    TC_H_MIN(i + 1)));
+		if (!qdisc) {
+			err = -ENOMEM;
+			goto err;
+		}
+
+		q->qdiscs[i] = qdisc;
+	}
+
+	err = taprio_change(sch, opt);
+	if (err < 0)
+		goto err;
+
+	return 0;
+
+err:
+	/* the core does not call ->destroy() when ->init() fails */
+	taprio_destroy(sch);
+	return err;
+}
+
+static int dump_entry(struct sk_buff *msg, const struct sched_entry *entry)
+{
+	struct nlattr *item;
+
+	item = nla_nest_start(msg, TCA_TAPRIO_SCHED_ENTRY);
+	if (!item)
+		return -ENOSPC;
+
+	if (nla_put_u32(msg, TCA_TAPRIO_SCHED_ENTRY_INDEX, entry->index))
+		goto nla_put_failure;
+
+	if (nla_put_u8(msg, TCA_TAPRIO_SCHED_ENTRY_CMD, entry->command))
+		goto nla_put_failure;
+
+	if (nla_put_u32(msg, TCA_TAPRIO_SCHED_ENTRY_GATE_MASK,
+			entry->gate_mask))
+		goto nla_put_failure;
+
+	if (nla_put_u32(msg, TCA_TAPRIO_SCHED_ENTRY_INTERVAL,
+			entry->interval))
+		goto nla_put_failure;
+
+	return nla_nest_end(msg, item);
+
+nla_put_failure:
+	nla_nest_cancel(msg, item);
+	return -1;
+}
+
+static int taprio_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct tc_mqprio_qopt opt = { 0 };
+	struct nlattr *nest, *entry_list;
+	struct sched_entry *entry;
+	int i;
+
+	opt.num_tc = netdev_get_num_tc(dev);
+	memcpy(opt.prio_tc_map, dev->prio_tc_map, sizeof(opt.prio_tc_map));
+
+	for (i = 0; i < netdev_get_num_tc(dev); i++) {
+		opt.count[i] = dev->tc_to_txq[i].count;
+		opt.offset[i] = dev->tc_to_txq[i].offset;
+	}
+
+	nest = nla_nest_start(skb, TCA_OPTIONS);
+	if (!nest)
+		return -ENOSPC;
+
+	if (nla_put(skb, TCA_TAPRIO_ATTR_PRIOMAP, sizeof(opt), &opt))
+		goto options_error;
+
+	if (nla_put_s64(skb, TCA_TAPRIO_ATTR_SCHED_BASE_TIME,
+			q->base_time, TCA_TAPRIO_PAD))
+		goto options_error;
+
+	if (nla_put_s32(skb, TCA_TAPRIO_ATTR_SCHED_CLOCKID, q->clockid))
+		goto options_error;
+
+	if (nla_put_u8(skb, TCA_TAPRIO_ATTR_OFFLOAD, q->offload))
+		goto options_error;
+
+	entry_list = nla_nest_start(skb, TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST);
+	if (!entry_list)
+		goto options_error;
+
+	list_for_each_entry(entry, &q->entries, list) {
+		if (dump_entry(skb, entry) < 0)
+			goto options_error;
+	}
+
+	nla_nest_end(skb, entry_list);
+
+	return nla_nest_end(skb, nest);
+
+options_error:
+	nla_nest_cancel(skb, nest);
+	return -1;
+}
+
+static struct Qdisc_ops taprio_qdisc_ops __read_mostly = {
+	.id		= "taprio",
+	.priv_size	= sizeof(struct taprio_sched),
+	.init		= taprio_init,
+	.change		= taprio_change,
+	.destroy	= taprio_destroy,
+	.reset		= taprio_reset,
+	.peek		= taprio_peek,
+	.dequeue	= taprio_dequeue,
+	.enqueue	= taprio_enqueue,
+	.dump		= taprio_dump,
+	.owner		= THIS_MODULE,
+};
+
+static struct notifier_block taprio_device_notifier = {
+	.notifier_call = taprio_dev_notifier,
+};
+
+static int __init taprio_module_init(void)
+{
+	int err = register_netdevice_notifier(&taprio_device_notifier);
+
+	if (err)
+		return err;
+
+	err = register_qdisc(&taprio_qdisc_ops);
+	if (err)
+		unregister_netdevice_notifier(&taprio_device_notifier);
+
+	return err;
+}
+
+static void __exit taprio_module_exit(void)
+{
+	unregister_qdisc(&taprio_qdisc_ops);
+	unregister_netdevice_notifier(&taprio_device_notifier);
+}
+
+module_init(taprio_module_init);
+module_exit(taprio_module_exit);
+MODULE_LICENSE("GPL");
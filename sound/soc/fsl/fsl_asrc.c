@@ -41,11 +41,6 @@ static unsigned int supported_asrc_rate[] = {
 	64000, 88200, 96000, 128000, 176400, 192000,
 };
 
-static struct snd_pcm_hw_constraint_list fsl_asrc_rate_constraints = {
-	.count = ARRAY_SIZE(supported_asrc_rate),
-	.list = supported_asrc_rate,
-};
-
 /**
  * The following tables map the relationship between asrc_inclk/asrc_outclk in
  * fsl_asrc.h and the registers of ASRCSR
@@ -299,23 +294,44 @@ static int fsl_asrc_config_pair(struct fsl_asrc_pair *pair, bool p2p_in, bool p2
 	outrate = config->output_sample_rate;
 	ideal = config->inclk == INCLK_NONE;
 
-	/* Validate input and output sample rates */
-	for (in = 0; in < ARRAY_SIZE(supported_asrc_rate); in++)
-		if (inrate == supported_asrc_rate[in])
-			break;
+	/*
+	 * Validate input and output sample rates. The ideal ratio is
+	 * computed from the two rates, so any rate within the converter
+	 * range works there; only clock driven conversions need a rate
+	 * that the divisors are known to hit.
+	 */
+	if (ideal) {
+		if (inrate < ASRC_RATE_MIN || inrate > ASRC_RATE_MAX) {
+			pair_err("unsupported input sample rate: %dHz\n",
+				 inrate);
+			return -EINVAL;
+		}
 
-	if (in == ARRAY_SIZE(supported_asrc_rate)) {
-		pair_err("unsupported input sample rate: %dHz\n", inrate);
-		return -EINVAL;
-	}
+		if (outrate < ASRC_RATE_MIN || outrate > ASRC_RATE_MAX) {
+			pair_err("unsupported output sample rate: %dHz\n",
+				 outrate);
+			return -EINVAL;
+		}
+	} else {
+		for (in = 0; in < ARRAY_SIZE(supported_asrc_rate); in++)
+			if (inrate == supported_asrc_rate[in])
+				break;
+
+		if (in == ARRAY_SIZE(supported_asrc_rate)) {
+			pair_err("unsupported input sample rate: %dHz\n",
+				 inrate);
+			return -EINVAL;
+		}
 
-	for (out = 0; out < ARRAY_SIZE(supported_asrc_rate); out++)
-		if (outrate == supported_asrc_rate[out])
-			break;
+		for (out = 0; out < ARRAY_SIZE(supported_asrc_rate); out++)
+			if (outrate == supported_asrc_rate[out])
+				break;
 
-	if (out == ARRAY_SIZE(supported_asrc_rate)) {
-		pair_err("unsupported output sample rate: %dHz\n", outrate);
-		return -EINVAL;
+		if (out == ARRAY_SIZE(supported_asrc_rate)) {
+			pair_err("unsupported output sample rate: %dHz\n",
+				 outrate);
+			return -EINVAL;
+		}
 	}
 
 	if ((outrate > 8000 && outrate < 30000) &&
@@ -615,11 +631,29 @@ static int fsl_asrc_dai_startup(struct snd_pcm_substream *substream,
 			    struct snd_soc_dai *cpu_dai)
 {
 	struct fsl_asrc *asrc_priv   = snd_soc_dai_get_drvdata(cpu_dai);
+	unsigned int rate = asrc_priv->asrc_rate;
+	unsigned int min, max;
 
 	asrc_priv->substream[substream->stream] = substream;
 
-	return snd_pcm_hw_constraint_list(substream->runtime, 0,
-			SNDRV_PCM_HW_PARAM_RATE, &fsl_asrc_rate_constraints);
+	/*
+	 * The front end always runs in Ideal Ratio mode against the fixed
+	 * back end rate, so offer every rate the pre- and post-processing
+	 * stages can reach from there and leave no conversion to plug.
+	 */
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		min = DIV_ROUND_UP(rate, 24);
+		max = rate * 8;
+	} else {
+		min = DIV_ROUND_UP(rate, 8);
+		max = rate * 24;
+	}
+
+	min = max_t(unsigned int, min, ASRC_RATE_MIN);
+	max = min_t(unsigned int, max, ASRC_RATE_MAX);
+
+	return snd_pcm_hw_constraint_minmax(substream->runtime,
+			SNDRV_PCM_HW_PARAM_RATE, min, max);
 }
 
 static void fsl_asrc_dai_shutdown(struct snd_pcm_substream *substream,
@@ -659,18 +693,18 @@ static struct snd_soc_dai_driver fsl_asrc_dai = {
 		.stream_name = "ASRC-Playback",
 		.channels_min = 1,
 		.channels_max = 10,
-		.rate_min = 5512,
-		.rate_max = 192000,
-		.rates = SNDRV_PCM_RATE_KNOT,
+		.rate_min = ASRC_RATE_MIN,
+		.rate_max = ASRC_RATE_MAX,
+		.rates = SNDRV_PCM_RATE_CONTINUOUS,
 		.formats = FSL_ASRC_FORMATS,
 	},
 	.capture = {
 		.stream_name = "ASRC-Capture",
 		.channels_min = 1,
 		.channels_max = 10,
-		.rate_min = 5512,
-		.rate_max = 192000,
-		.rates = SNDRV_PCM_RATE_KNOT,
+		.rate_min = ASRC_RATE_MIN,
+		.rate_max = ASRC_RATE_MAX,
+		.rates = SNDRV_PCM_RATE_CONTINUOUS,
 		.formats = FSL_ASRC_FORMATS,
 	},
 	.ops = &fsl_asrc_dai_ops,
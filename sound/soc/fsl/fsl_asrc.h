@@ -29,6 +29,8 @@
 #define ASRC_OUTPUT_LAST_SAMPLE		16
 
 #define IDEAL_RATIO_RATE		1000000
+#define ASRC_RATE_MIN			5512
+#define ASRC_RATE_MAX			192000
 
 #define REG_ASRCTR			0x00
 #define REG_ASRIER			0x04
@@ -13,6 +13,10 @@
 
 #define DIR_STR(dir) dir == IN ? "in" : "out"
 
+/* mmap offsets of the input and output DMA buffers of a pair */
+#define FSL_ASRC_MMAP_OFFSET(dir) \
+	((dir) == IN ? 0 : PAGE_ALIGN(ASRC_DMA_BUFFER_SIZE))
+
 struct fsl_asrc_m2m {
 	struct fsl_asrc_pair *pair;
 	struct completion complete[2];
@@ -129,14 +133,17 @@ static int fsl_allocate_dma_buf(struct fsl_asrc_pair *pair)
 	struct dma_block *output = &m2m->dma_block[OUT];
 	enum asrc_pair_index index = pair->index;
 
-	input->dma_vaddr = kzalloc(input->length, GFP_KERNEL);
+	/* Page backed so that the buffers can be mapped to user space */
+	input->dma_vaddr = alloc_pages_exact(input->length,
+					     GFP_KERNEL | __GFP_ZERO);
 	if (!input->dma_vaddr) {
 		pair_err("failed to allocate input DMA buffer\n");
 		return -ENOMEM;
 	}
 	input->dma_paddr = virt_to_dma(NULL, input->dma_vaddr);
 
-	output->dma_vaddr = kzalloc(output->length, GFP_KERNEL);
+	output->dma_vaddr = alloc_pages_exact(output->length,
+					      GFP_KERNEL | __GFP_ZERO);
 	if (!output->dma_vaddr) {
 		pair_err("failed to allocate output DMA buffer\n");
 		goto exit;
@@ -146,11 +153,26 @@ static int fsl_allocate_dma_buf(struct fsl_asrc_pair *pair)
 	return 0;
 
 exit:
-	kfree(input->dma_vaddr);
+	free_pages_exact(input->dma_vaddr, input->length);
+	input->dma_vaddr = NULL;
 
 	return -ENOMEM;
 }
 
+static void fsl_free_dma_buf(struct fsl_asrc_pair *pair)
+{
+	struct fsl_asrc_m2m *m2m = pair->private;
+	int dir;
+
+	/* length changes per conversion, the allocation size does not */
+	for (dir = IN; dir <= OUT; dir++) {
+		if (m2m->dma_block[dir].dma_vaddr)
+			free_pages_exact(m2m->dma_block[dir].dma_vaddr,
+					 ASRC_DMA_BUFFER_SIZE);
+		m2m->dma_block[dir].dma_vaddr = NULL;
+	}
+}
+
 static int fsl_asrc_dmaconfig(struct fsl_asrc_pair *pair, struct dma_chan *chan,
 			      u32 dma_addr, void *buf_addr, u32 buf_len,
 			      bool dir, enum asrc_word_width word_width)
@@ -242,7 +264,8 @@ static int fsl_asrc_dmaconfig(struct fsl_asrc_pair *pair, struct dma_chan *chan,
 }
 
 static int fsl_asrc_prepare_io_buffer(struct fsl_asrc_pair *pair,
-				      struct asrc_convert_buffer *pbuf, bool dir)
+				      struct asrc_convert_buffer *pbuf,
+				      bool dir, bool mapped)
 {
 	struct fsl_asrc_m2m *m2m = pair->private;
 	struct fsl_asrc *asrc_priv = pair->asrc_priv;
@@ -257,9 +280,6 @@ static int fsl_asrc_prepare_io_buffer(struct fsl_asrc_pair *pair,
 	u32 word_size, fifo_addr;
 	void __user *buf_vaddr;
 
-	/* Clean the DMA buffer */
-	memset(dma_vaddr, 0, ASRC_DMA_BUFFER_SIZE);
-
 	if (dir == IN) {
 		buf_vaddr = (void __user *)pbuf->input_buffer_vaddr;
 		buf_len = pbuf->input_buffer_length;
@@ -281,8 +301,9 @@ static int fsl_asrc_prepare_io_buffer(struct fsl_asrc_pair *pair,
 		return -EINVAL;
 	}
 
-	/* Copy origin data into input buffer */
-	if (dir == IN && copy_from_user(dma_vaddr, buf_vaddr, buf_len))
+	/* Copy origin data into input buffer, unless user space wrote it */
+	if (dir == IN && !mapped &&
+	    copy_from_user(dma_vaddr, buf_vaddr, buf_len))
 		return -EFAULT;
 
 	*dma_len = buf_len;
@@ -298,19 +319,20 @@ static int fsl_asrc_prepare_io_buffer(struct fsl_asrc_pair *pair,
 }
 
 static int fsl_asrc_prepare_buffer(struct fsl_asrc_pair *pair,
-				   struct asrc_convert_buffer *pbuf)
+				   struct asrc_convert_buffer *pbuf,
+				   bool mapped)
 {
 	struct fsl_asrc *asrc_priv = pair->asrc_priv;
 	enum asrc_pair_index index = pair->index;
 	int ret;
 
-	ret = fsl_asrc_prepare_io_buffer(pair, pbuf, IN);
+	ret = fsl_asrc_prepare_io_buffer(pair, pbuf, IN, mapped);
 	if (ret) {
 		pair_err("failed to prepare input buffer: %d\n", ret);
 		return ret;
 	}
 
-	ret = fsl_asrc_prepare_io_buffer(pair, pbuf, OUT);
+	ret = fsl_asrc_prepare_io_buffer(pair, pbuf, OUT, mapped);
 	if (ret) {
 		pair_err("failed to prepare output buffer: %d\n", ret);
 		return ret;
@@ -342,7 +364,7 @@ int fsl_asrc_process_buffer_pre(struct completion *complete,
 	} while (0)
 
 int fsl_asrc_process_buffer(struct fsl_asrc_pair *pair,
-			    struct asrc_convert_buffer *pbuf)
+			    struct asrc_convert_buffer *pbuf, bool mapped)
 {
 	struct fsl_asrc_m2m *m2m = pair->private;
 	enum asrc_pair_index index = pair->index;
@@ -379,9 +401,9 @@ int fsl_asrc_process_buffer(struct fsl_asrc_pair *pair,
 	pbuf->input_buffer_length = m2m->dma_block[IN].length;
 	pbuf->output_buffer_length = m2m->dma_block[OUT].length;
 
-	if (copy_to_user((void __user *)pbuf->output_buffer_vaddr,
-			 m2m->dma_block[OUT].dma_vaddr,
-			 m2m->dma_block[OUT].length))
+	if (!mapped && copy_to_user((void __user *)pbuf->output_buffer_vaddr,
+				    m2m->dma_block[OUT].dma_vaddr,
+				    m2m->dma_block[OUT].length))
 		return -EFAULT;
 
 	return 0;
@@ -565,6 +587,7 @@ static long fsl_asrc_ioctl_config_pair(struct fsl_asrc_pair *pair,
 	else
 		m2m->last_period_size = ASRC_OUTPUT_LAST_SAMPLE;
 
+	fsl_free_dma_buf(pair);
 	ret = fsl_allocate_dma_buf(pair);
 	if (ret) {
 		pair_err("failed to allocate DMA buffer: %ld\n", ret);
@@ -622,15 +645,19 @@ static long fsl_asrc_ioctl_release_pair(struct fsl_asrc_pair *pair,
 		dma_release_channel(pair->dma_chan[IN]);
 	if (pair->dma_chan[OUT])
 		dma_release_channel(pair->dma_chan[OUT]);
-	kfree(m2m->dma_block[IN].dma_vaddr);
-	kfree(m2m->dma_block[OUT].dma_vaddr);
+	fsl_free_dma_buf(pair);
 	fsl_asrc_release_pair(pair);
 
 	return 0;
 }
 
+/*
+ * With mapped set the input is taken from, and the output is left in,
+ * the pair's DMA buffers that user space mapped via ASRC_QUERYBUF and
+ * mmap(); the buffer addresses in struct asrc_convert_buffer are ignored.
+ */
 static long fsl_asrc_ioctl_convert(struct fsl_asrc_pair *pair,
-				   void __user *user)
+				   void __user *user, bool mapped)
 {
 	struct fsl_asrc_m2m *m2m = pair->private;
 	struct fsl_asrc *asrc_priv = pair->asrc_priv;
@@ -644,7 +671,10 @@ static long fsl_asrc_ioctl_convert(struct fsl_asrc_pair *pair,
 		return ret;
 	}
 
-	ret = fsl_asrc_prepare_buffer(pair, &buf);
+	if (!m2m->dma_block[IN].dma_vaddr || !m2m->dma_block[OUT].dma_vaddr)
+		return -EINVAL;
+
+	ret = fsl_asrc_prepare_buffer(pair, &buf, mapped);
 	if (ret) {
 		pair_err("failed to prepare buffer: %ld\n", ret);
 		return ret;
@@ -659,7 +689,7 @@ static long fsl_asrc_ioctl_convert(struct fsl_asrc_pair *pair,
 	fsl_asrc_submit_dma(pair);
 #endif
 
-	ret = fsl_asrc_process_buffer(pair, &buf);
+	ret = fsl_asrc_process_buffer(pair, &buf, mapped);
 	if (ret) {
 		pair_err("failed to process buffer: %ld\n", ret);
 		return ret;
@@ -674,6 +704,40 @@ static long fsl_asrc_ioctl_convert(struct fsl_asrc_pair *pair,
 	return 0;
 }
 
+static long fsl_asrc_ioctl_querybuf(struct fsl_asrc_pair *pair,
+				    void __user *user)
+{
+	struct fsl_asrc_m2m *m2m = pair->private;
+	struct fsl_asrc *asrc_priv = pair->asrc_priv;
+	enum asrc_pair_index index = pair->index;
+	struct asrc_querybuf buffer;
+	long ret;
+
+	ret = copy_from_user(&buffer, user, sizeof(buffer));
+	if (ret) {
+		pair_err("failed to get querybuf from user space: %ld\n", ret);
+		return ret;
+	}
+
+	/* One input and one output buffer per pair, set up by CONFIG_PAIR */
+	if (buffer.buffer_index != 0 || !m2m->dma_block[IN].dma_vaddr ||
+	    !m2m->dma_block[OUT].dma_vaddr)
+		return -EINVAL;
+
+	buffer.input_length = ASRC_DMA_BUFFER_SIZE;
+	buffer.output_length = ASRC_DMA_BUFFER_SIZE;
+	buffer.input_offset = FSL_ASRC_MMAP_OFFSET(IN);
+	buffer.output_offset = FSL_ASRC_MMAP_OFFSET(OUT);
+
+	ret = copy_to_user(user, &buffer, sizeof(buffer));
+	if (ret) {
+		pair_err("failed to send querybuf to user space: %ld\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
 static long fsl_asrc_ioctl_start_conv(struct fsl_asrc_pair *pair,
 				      void __user *user)
 {
@@ -783,7 +847,13 @@ static long fsl_asrc_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 		ret = fsl_asrc_ioctl_release_pair(pair, user);
 		break;
 	case ASRC_CONVERT:
-		ret = fsl_asrc_ioctl_convert(pair, user);
+		ret = fsl_asrc_ioctl_convert(pair, user, false);
+		break;
+	case ASRC_CONVERT_MAPPED:
+		ret = fsl_asrc_ioctl_convert(pair, user, true);
+		break;
+	case ASRC_QUERYBUF:
+		ret = fsl_asrc_ioctl_querybuf(pair, user);
 		break;
 	case ASRC_START_CONV:
 		ret = fsl_asrc_ioctl_start_conv(pair, user);
@@ -805,6 +875,41 @@ static long fsl_asrc_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 	return ret;
 }
 
+/*
+ * Map the input or output DMA buffer of the pair. The pages are
+ * refcounted by the mapping, so a RELEASE_PAIR or a new CONFIG_PAIR
+ * while mapped leaves user space with stale but valid memory.
+ */
+static int fsl_asrc_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fsl_asrc_pair *pair = file->private_data;
+	struct fsl_asrc_m2m *m2m = pair->private;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	unsigned long i;
+	void *vaddr;
+	int ret;
+
+	if (offset == FSL_ASRC_MMAP_OFFSET(IN))
+		vaddr = m2m->dma_block[IN].dma_vaddr;
+	else if (offset == FSL_ASRC_MMAP_OFFSET(OUT))
+		vaddr = m2m->dma_block[OUT].dma_vaddr;
+	else
+		return -EINVAL;
+
+	if (!vaddr || size > ASRC_DMA_BUFFER_SIZE)
+		return -EINVAL;
+
+	for (i = 0; i < size; i += PAGE_SIZE) {
+		ret = vm_insert_page(vma, vma->vm_start + i,
+				     virt_to_page(vaddr + i));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int fsl_asrc_open(struct inode *inode, struct file *file)
 {
 	struct fsl_asrc *asrc_priv = dev_get_drvdata(asrc_miscdev.this_device);
@@ -877,8 +982,7 @@ static int fsl_asrc_close(struct inode *inode, struct file *file)
 		if (pair->dma_chan[OUT])
 			dma_release_channel(pair->dma_chan[OUT]);
 
-		kfree(m2m->dma_block[IN].dma_vaddr);
-		kfree(m2m->dma_block[OUT].dma_vaddr);
+		fsl_free_dma_buf(pair);
 
 		fsl_asrc_release_pair(pair);
 	} else
@@ -898,6 +1002,7 @@ static int fsl_asrc_close(struct inode *inode, struct file *file)
 static const struct file_operations asrc_fops = {
 	.owner		= THIS_MODULE,
 	.unlocked_ioctl	= fsl_asrc_ioctl,
+	.mmap		= fsl_asrc_mmap,
 	.open		= fsl_asrc_open,
 	.release	= fsl_asrc_close,
 };
@@ -529,6 +529,28 @@ err_spbaclk:
 	return ret;
 }
 
+/*
+ * Derive the DMA burst, and the FIFO watermark that raises the request,
+ * from the period geometry: whole frames so that a burst never splits the
+ * channel order, as many as fit in half of the FIFO, and a divisor of the
+ * period so that each period ends on a burst boundary.
+ */
+static u32 fsl_esai_calc_burst(struct fsl_esai *esai_priv,
+			       struct snd_pcm_hw_params *params)
+{
+	u32 channels = params_channels(params);
+	u32 frames = params_period_size(params);
+	u32 k = esai_priv->fifo_depth / 2 / channels;
+
+	if (!k)
+		return channels;
+
+	while (k > 1 && frames % k)
+		k--;
+
+	return k * channels;
+}
+
 static int fsl_esai_hw_params(struct snd_pcm_substream *substream,
 			      struct snd_pcm_hw_params *params,
 			      struct snd_soc_dai *dai)
@@ -539,6 +561,7 @@ static int fsl_esai_hw_params(struct snd_pcm_substream *substream,
 	u32 channels = params_channels(params);
 	u32 pins = DIV_ROUND_UP(channels, esai_priv->slots);
 	u32 slot_width = width;
+	u32 burst = fsl_esai_calc_burst(esai_priv, params);
 	u32 bclk, mask, val;
 	int ret;
 
@@ -573,11 +596,16 @@ static int fsl_esai_hw_params(struct snd_pcm_substream *substream,
 
 	mask = ESAI_xFCR_xFR_MASK | ESAI_xFCR_xWA_MASK | ESAI_xFCR_xFWM_MASK |
 	      (tx ? ESAI_xFCR_TE_MASK | ESAI_xFCR_TIEN : ESAI_xFCR_RE_MASK);
-	val = ESAI_xFCR_xWA(width) | ESAI_xFCR_xFWM(esai_priv->fifo_depth) |
+	val = ESAI_xFCR_xWA(width) | ESAI_xFCR_xFWM(burst) |
 	     (tx ? ESAI_xFCR_TE(pins) | ESAI_xFCR_TIEN : ESAI_xFCR_RE(pins));
 
 	regmap_update_bits(esai_priv->regmap, REG_ESAI_xFCR(tx), mask, val);
 
+	if (tx)
+		esai_priv->dma_params_tx.maxburst = burst;
+	else
+		esai_priv->dma_params_rx.maxburst = burst;
+
 	mask = ESAI_xCR_xSWS_MASK | (tx ? ESAI_xCR_PADC : 0);
 	val = ESAI_xCR_xSWS(slot_width, width) | (tx ? ESAI_xCR_PADC : 0);
 
@@ -345,9 +345,13 @@ static int fsl_hdmi_update_constraints(struct snd_pcm_substream *substream)
 	if (ret)
 		return ret;
 
-	fsl_hdmi_get_playback_sample_size();
-	ret = snd_pcm_hw_constraint_list(runtime, 0, SNDRV_PCM_HW_PARAM_SAMPLE_BITS,
-			&playback_constraint_bits);
+	/*
+	 * IEC958 subframes carry whatever the channel status says, PCM of any
+	 * width the sink takes or compressed audio. S24_LE has no mmap path.
+	 */
+	ret = snd_pcm_hw_constraint_mask64(runtime, SNDRV_PCM_HW_PARAM_FORMAT,
+			SNDRV_PCM_FMTBIT_S16_LE |
+			SNDRV_PCM_FMTBIT_IEC958_SUBFRAME_LE);
 	if (ret)
 		return ret;
 
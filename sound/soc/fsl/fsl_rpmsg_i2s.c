@@ -129,6 +129,17 @@ static int fsl_rpmsg_i2s_probe(struct platform_device *pdev)
 	if (ret)
 		audioindex = 0;
 
+	/*
+	 * In low power audio mode the M4 is handed a large buffer and only
+	 * reports back once per (application sized) period, so the A core
+	 * can stay suspended while the M4 keeps playing.
+	 */
+	rpmsg_i2s->buffer_size = IMX_SAI_DMABUF_SIZE;
+	if (of_property_read_bool(np, "fsl,enable-lpa")) {
+		rpmsg_i2s->enable_lpa = 1;
+		rpmsg_i2s->buffer_size = IMX_RPMSG_LPA_BUFSIZE;
+	}
+
 	/* Setup work queue */
 	i2s_info->rpmsg_wq = create_singlethread_workqueue("rpmsg_i2s");
 	if (i2s_info->rpmsg_wq == NULL) {
@@ -180,7 +191,9 @@ static int fsl_rpmsg_i2s_runtime_resume(struct device *dev)
 {
 	struct fsl_rpmsg_i2s *rpmsg_i2s = dev_get_drvdata(dev);
 
-	pm_qos_add_request(&rpmsg_i2s->pm_qos_req, PM_QOS_CPU_DMA_LATENCY, 0);
+	if (!rpmsg_i2s->enable_lpa)
+		pm_qos_add_request(&rpmsg_i2s->pm_qos_req,
+				   PM_QOS_CPU_DMA_LATENCY, 0);
 	return 0;
 }
 
@@ -188,7 +201,8 @@ static int fsl_rpmsg_i2s_runtime_suspend(struct device *dev)
 {
 	struct fsl_rpmsg_i2s *rpmsg_i2s = dev_get_drvdata(dev);
 
-	pm_qos_remove_request(&rpmsg_i2s->pm_qos_req);
+	if (!rpmsg_i2s->enable_lpa)
+		pm_qos_remove_request(&rpmsg_i2s->pm_qos_req);
 	return 0;
 }
 #endif
@@ -205,8 +219,11 @@ static int fsl_rpmsg_i2s_suspend(struct device *dev)
 	rpmsg_tx = &i2s_info->send_msg[SNDRV_PCM_STREAM_PLAYBACK];
 	rpmsg_rx = &i2s_info->send_msg[SNDRV_PCM_STREAM_CAPTURE];
 
-	rpmsg_tx->header.cmd = I2S_TX_SUSPEND;
-	i2s_send_message(rpmsg_tx, i2s_info);
+	/* Playback carries on from the M4 while we are suspended */
+	if (!rpmsg_i2s->enable_lpa) {
+		rpmsg_tx->header.cmd = I2S_TX_SUSPEND;
+		i2s_send_message(rpmsg_tx, i2s_info);
+	}
 
 	rpmsg_rx->header.cmd = I2S_RX_SUSPEND;
 	i2s_send_message(rpmsg_rx, i2s_info);
@@ -224,8 +241,10 @@ static int fsl_rpmsg_i2s_resume(struct device *dev)
 	rpmsg_tx = &i2s_info->send_msg[SNDRV_PCM_STREAM_PLAYBACK];
 	rpmsg_rx = &i2s_info->send_msg[SNDRV_PCM_STREAM_CAPTURE];
 
-	rpmsg_tx->header.cmd = I2S_TX_RESUME;
-	i2s_send_message(rpmsg_tx, i2s_info);
+	if (!rpmsg_i2s->enable_lpa) {
+		rpmsg_tx->header.cmd = I2S_TX_RESUME;
+		i2s_send_message(rpmsg_tx, i2s_info);
+	}
 
 	rpmsg_rx->header.cmd = I2S_RX_RESUME;
 	i2s_send_message(rpmsg_rx, i2s_info);
@@ -208,6 +208,9 @@
 
 #define RPMSG_TIMEOUT 1000
 
+/* Low power audio: the M4 plays from a buffer of several seconds */
+#define IMX_RPMSG_LPA_BUFSIZE	(1024 * 1024)
+
 #define		I2S_TX_OPEN		0x0
 #define		I2S_TX_START		0x1
 #define		I2S_TX_PAUSE		0x2
@@ -310,6 +313,8 @@ struct fsl_rpmsg_i2s {
 	struct platform_device *pdev;
 	struct i2s_info        i2s_info;
 	struct pm_qos_request pm_qos_req;
+	int                    enable_lpa;
+	size_t                 buffer_size;
 };
 
 #endif /* __FSL_RPMSG_I2S_H */
@@ -456,11 +456,30 @@ static int fsl_sai_hw_params(struct snd_pcm_substream *substream,
 	bool tx = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
 	unsigned int channels = params_channels(params);
 	u32 word_width = params_width(params);
+	unsigned int lines = hweight32(sai->dataline[tx]);
 	u32 val_cr4 = 0, val_cr5 = 0;
-	u32 slots = (channels == 1) ? 2 : channels;
-	u32 slot_width = word_width;
+	u32 slots, slot_width = word_width;
 	int ret;
 
+	/*
+	 * With more than one data line enabled the FIFO combine mode spreads
+	 * consecutive words of the single DMA stream across the enabled
+	 * lines, so each line only carries channels / lines slots per frame
+	 * and the bit clock drops by the same factor.
+	 */
+	if (lines > 1) {
+		if (channels % lines) {
+			dev_err(cpu_dai->dev, "%u channels not a multiple of %u data lines\n",
+				channels, lines);
+			return -EINVAL;
+		}
+		channels /= lines;
+	} else {
+		lines = 1;
+	}
+
+	slots = (channels == 1) ? 2 : channels;
+
 	if (sai->slots)
 		slots = sai->slots;
 
@@ -552,6 +571,12 @@ static int fsl_sai_hw_params(struct snd_pcm_substream *substream,
 			   FSL_SAI_CR5_FBT_MASK, val_cr5);
 	regmap_write(sai->regmap, FSL_SAI_xMR(tx), ~0UL - ((1 << channels) - 1));
 
+	/* Every DMA request moves one burst per enabled FIFO */
+	if (tx)
+		sai->dma_params_tx.maxburst = FSL_SAI_MAXBURST_TX * lines;
+	else
+		sai->dma_params_rx.maxburst = FSL_SAI_MAXBURST_RX * lines;
+
 	return 0;
 }
 
@@ -700,6 +725,14 @@ static int fsl_sai_startup(struct snd_pcm_substream *substream,
 
 	ret = snd_pcm_hw_constraint_list(substream->runtime, 0,
 			SNDRV_PCM_HW_PARAM_RATE, &fsl_sai_rate_constraints);
+	if (ret)
+		return ret;
+
+	/* Combined FIFO mode needs the same slot count on every data line */
+	if (hweight32(sai->dataline[tx]) > 1)
+		ret = snd_pcm_hw_constraint_step(substream->runtime, 0,
+				SNDRV_PCM_HW_PARAM_CHANNELS,
+				hweight32(sai->dataline[tx]));
 
 	return ret;
 }
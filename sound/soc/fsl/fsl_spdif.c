@@ -593,8 +593,10 @@ static int fsl_spdif_trigger(struct snd_pcm_substream *substream,
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct fsl_spdif_priv *spdif_priv = snd_soc_dai_get_drvdata(rtd->cpu_dai);
+	struct spdif_mixer_control *ctrl = &spdif_priv->fsl_spdif_control;
 	struct regmap *regmap = spdif_priv->regmap;
 	bool tx = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
+	bool nonaudio = tx && (ctrl->ch_status[0] & IEC958_AES0_NONAUDIO);
 	u32 intr = SIE_INTR_FOR(tx);
 	u32 dmaen = SCR_DMA_xX_EN(tx);
 
@@ -602,6 +604,10 @@ static int fsl_spdif_trigger(struct snd_pcm_substream *substream,
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		if (nonaudio)
+			regmap_update_bits(regmap, REG_SPDIF_SCR,
+					   SCR_TXFIFO_CTRL_MASK,
+					   SCR_TXFIFO_CTRL_NORMAL);
 		regmap_update_bits(regmap, REG_SPDIF_SIE, intr, intr);
 		regmap_update_bits(regmap, REG_SPDIF_SCR, dmaen, dmaen);
 		break;
@@ -610,6 +616,15 @@ static int fsl_spdif_trigger(struct snd_pcm_substream *substream,
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
 		regmap_update_bits(regmap, REG_SPDIF_SCR, dmaen, 0);
 		regmap_update_bits(regmap, REG_SPDIF_SIE, intr, 0);
+		/*
+		 * An IEC61937 receiver takes whatever is left in the FIFO
+		 * for the start of a damaged burst. Send zero stuffing,
+		 * which it treats as a gap between bursts, instead.
+		 */
+		if (nonaudio)
+			regmap_update_bits(regmap, REG_SPDIF_SCR,
+					   SCR_TXFIFO_CTRL_MASK,
+					   SCR_TXFIFO_CTRL_ZERO);
 		break;
 	default:
 		return -EINVAL;
@@ -60,6 +60,9 @@ struct hdmi_dma_priv {
 	int sample_bits;
 	int channels;
 	int rate;
+	/* pre-packed IEC958 subframes, and sent as high bit rate audio */
+	bool iec958;
+	bool hbr;
 
 	int frame_idx;
 
@@ -109,8 +112,12 @@ EXPORT_SYMBOL(iec_header);
  *     16         16          32          2          SNDRV_PCM_FORMAT_S16_LE
  *     24         24          32          1.33       SNDRV_PCM_FORMAT_S24_3LE*
  *     24         32          32          1          SNDRV_PCM_FORMAT_S24_LE
+ *     32         32          32          1          SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE
  *
  * *so SNDRV_PCM_FORMAT_S24_3LE is not supported.
+ *
+ * IEC958 subframes come with their frame info already, it is only moved to
+ * where the HDMI DMA wants it, see hdmi_dma_copy_iec958().
  */
 
 /*
@@ -418,6 +425,23 @@ static void hdmi_dma_copy_16(u16 *src, u32 *dst, int framecount, int channelcoun
 }
 #endif
 
+/*
+ * ALSA IEC958 subframes have the preamble in bits 0-3 (bit 3 set on a block
+ * start), the 24 bit sample in bits 4-27 and V, U, C, P in 28-31.  The HDMI
+ * DMA wants the sample in bits 0-23, V, U, C, P in 24-27 and the start of
+ * block in 28: one shift and one bit, parity and channel status are kept.
+ * Works in place.
+ */
+static void hdmi_dma_copy_iec958(u32 *src, u32 *dst, int samples)
+{
+	u32 sample;
+
+	while (samples--) {
+		sample = *src++;
+		*dst++ = (sample >> 4) | ((sample & 0x8) << 25);
+	}
+}
+
 static void hdmi_dma_mmap_copy(struct snd_pcm_substream *substream,
 				int offset, int count)
 {
@@ -439,6 +463,10 @@ static void hdmi_dma_mmap_copy(struct snd_pcm_substream *substream,
 		src16 = (u16 *)(runtime->dma_area + offset);
 		hdmi_dma_copy_16(src16, dst, framecount, priv->channels);
 		break;
+	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
+		hdmi_dma_copy_iec958((u32 *)(runtime->dma_area + offset), dst,
+				     framecount * priv->channels);
+		break;
 	default:
 		dev_err(dev, "unsupported sample format %s\n",
 				snd_pcm_format_name(priv->format));
@@ -498,7 +526,8 @@ static void hdmi_sdma_callback(void *data)
 		/* Copy data by period_bytes */
 		hdmi_dma_data_copy(substream, priv, 'p');
 
-		snd_pcm_period_elapsed(substream);
+		if (!runtime->no_period_wakeup)
+			snd_pcm_period_elapsed(substream);
 	}
 
 	spin_unlock_irqrestore(&priv->irq_lock, flags);
@@ -557,7 +586,7 @@ static int hdmi_dma_set_thrsld_incrtype(struct device *dev, int channels)
 	return 0;
 }
 
-static int hdmi_dma_configure_dma(struct device *dev, int channels)
+static int hdmi_dma_configure_dma(struct device *dev, int channels, bool hbr)
 {
 	u8 i, val = 0;
 	int ret;
@@ -578,6 +607,14 @@ static int hdmi_dma_configure_dma(struct device *dev, int channels)
 
 	hdmi_writeb(val, HDMI_AHB_DMA_CONF1);
 
+	/* 8 channels of IEC61937 frames sent in HBR audio packets */
+	val = hdmi_readb(HDMI_AHB_DMA_CONF0);
+	if (hbr)
+		val |= HDMI_AHB_DMA_CONF0_HBR;
+	else
+		val &= (u8)~HDMI_AHB_DMA_CONF0_HBR;
+	hdmi_writeb(val, HDMI_AHB_DMA_CONF0);
+
 	return 0;
 }
 
@@ -655,6 +692,9 @@ static int hdmi_dma_update_iec_header(struct snd_pcm_substream *substream)
 	case SNDRV_PCM_FORMAT_S24_LE:
 		iec_header.B.word_length = 0x0b;
 		break;
+	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
+		/* the stream carries its own channel status */
+		break;
 	default:
 		return -EFAULT;
 	}
@@ -682,6 +722,15 @@ static int hdmi_dma_copy(struct snd_pcm_substream *substream, int channel,
 	/* Adding frame info to pcm data from userspace and copy to hw_buffer */
 	hw_buf = (u32 *)(priv->hw_buffer.area + (pos_bytes * priv->buffer_ratio));
 
+	if (priv->iec958) {
+		if (copy_from_user(hw_buf, buf, count))
+			return -EFAULT;
+
+		hdmi_dma_copy_iec958(hw_buf, hw_buf, count / 4);
+
+		return 0;
+	}
+
 	while (count > 0) {
 		for (subframe_idx = 1 ; subframe_idx <= priv->channels ; subframe_idx++) {
 			if (copy_from_user(&pcm_data, buf, priv->sample_align))
@@ -801,11 +850,24 @@ static int hdmi_dma_hw_params(struct snd_pcm_substream *substream,
 		priv->sample_align = 4;
 		priv->sample_bits = 24;
 		break;
+	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
+		priv->buffer_ratio = 1;
+		priv->sample_align = 4;
+		priv->sample_bits = 32;
+		break;
 	default:
 		dev_err(dev, "unsupported sample format: %d\n", priv->format);
 		return -EINVAL;
 	}
 
+	/*
+	 * Compressed 8 channel streams are Dolby TrueHD or DTS-HD MA, which
+	 * only fit in HBR audio packets.
+	 */
+	priv->iec958 = priv->format == SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE;
+	priv->hbr = priv->iec958 && priv->channels == 8 &&
+		    iec_header.B.linear_pcm;
+
 	priv->dma_period_bytes = priv->period_bytes * priv->buffer_ratio;
 	priv->sdma_params.buffer_num = priv->periods;
 	priv->sdma_params.phyaddr = priv->phy_hdmi_sdma_t;
@@ -820,7 +882,7 @@ static int hdmi_dma_hw_params(struct snd_pcm_substream *substream,
 
 	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
 
-	ret = hdmi_dma_configure_dma(dev, priv->channels);
+	ret = hdmi_dma_configure_dma(dev, priv->channels, priv->hbr);
 	if (ret)
 		return ret;
 
@@ -935,7 +997,8 @@ static struct snd_pcm_hardware snd_imx_hardware = {
 		SNDRV_PCM_INFO_MMAP |
 		SNDRV_PCM_INFO_MMAP_VALID |
 		SNDRV_PCM_INFO_PAUSE |
-		SNDRV_PCM_INFO_RESUME,
+		SNDRV_PCM_INFO_RESUME |
+		SNDRV_PCM_INFO_NO_PERIOD_WAKEUP,
 	.formats = MXC_HDMI_FORMATS_PLAYBACK,
 	.rate_min = 32000,
 	.channels_min = 2,
@@ -45,7 +45,8 @@ struct imx_hdmi {
 	 SNDRV_PCM_RATE_176400 | SNDRV_PCM_RATE_192000)
 
 #define MXC_HDMI_FORMATS_PLAYBACK \
-	(SNDRV_PCM_FMTBIT_S16_LE | SNDRV_PCM_FMTBIT_S24_LE)
+	(SNDRV_PCM_FMTBIT_S16_LE | SNDRV_PCM_FMTBIT_S24_LE | \
+	 SNDRV_PCM_FMTBIT_IEC958_SUBFRAME_LE)
 
 union hdmi_audio_header_t {
 	uint64_t  U;
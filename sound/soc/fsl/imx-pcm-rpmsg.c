@@ -125,8 +125,19 @@ static int imx_rpmsg_pcm_open(struct snd_pcm_substream *substream)
 	struct i2s_info      *i2s_info =  &rpmsg_i2s->i2s_info;
 	struct i2s_rpmsg_s   *rpmsg = &i2s_info->send_msg[substream->stream];
 	struct dmaengine_pcm_runtime_data *prtd;
+	struct snd_pcm_hardware hw = imx_rpmsg_pcm_hardware;
+
+	/*
+	 * The M4 notifies once per period, so in low power audio mode let
+	 * the application pick periods of up to half the large buffer; the
+	 * period size is then the wakeup threshold of the A core.
+	 */
+	if (rpmsg_i2s->enable_lpa) {
+		hw.buffer_bytes_max = rpmsg_i2s->buffer_size;
+		hw.period_bytes_max = rpmsg_i2s->buffer_size / 2;
+	}
 
-	snd_soc_set_runtime_hwparams(substream, &imx_rpmsg_pcm_hardware);
+	snd_soc_set_runtime_hwparams(substream, &hw);
 
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 		rpmsg->header.cmd = I2S_TX_OPEN;
@@ -368,9 +379,11 @@ static struct snd_pcm_ops imx_rpmsg_pcm_ops = {
 static int imx_rpmsg_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
 	int stream)
 {
+	struct snd_soc_pcm_runtime *rtd = pcm->private_data;
+	struct fsl_rpmsg_i2s *rpmsg_i2s = dev_get_drvdata(rtd->cpu_dai->dev);
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size = imx_rpmsg_pcm_hardware.buffer_bytes_max;
+	size_t size = rpmsg_i2s->buffer_size;
 
 	buf->dev.type = SNDRV_DMA_TYPE_DEV;
 	buf->dev.dev = pcm->card->dev;
@@ -67,6 +67,9 @@ static int imx_rpmsg_probe(struct platform_device *pdev)
 	data->dai[0].dai_fmt = SND_SOC_DAIFMT_I2S |
 			    SND_SOC_DAIFMT_NB_NF |
 			    SND_SOC_DAIFMT_CBM_CFM;
+	/* Keep low power audio playing from the M4 across system suspend */
+	if (of_property_read_bool(cpu_np, "fsl,enable-lpa"))
+		data->dai[0].ignore_suspend = 1;
 	data->card.num_links = 1;
 	data->card.dai_link = data->dai;
 
@@ -0,0 +1,209 @@
+/*
+ * AES-CBC and AES-GCM throughput through AF_ALG
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Whichever driver has the highest priority for the algorithm serves the
+ * requests, CAAM when it is loaded, so the numbers include the syscall and
+ * the copies in and out of the kernel, as a user-space crypto library
+ * using AF_ALG would see them.
+ *
+ *	af_alg_bench -m cbc|gcm [-s 16,256,4096,65536] [-t seconds]
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <linux/if_alg.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "imx_perf.h"
+
+#ifndef SOL_ALG
+#define SOL_ALG		279
+#endif
+
+#define AES_KEY_LEN	16
+#define GCM_IV_LEN	12
+#define GCM_TAG_LEN	16
+#define CBC_IV_LEN	16
+#define MAX_SIZES	16
+
+static int alg_open(const char *type, const char *name, int gcm)
+{
+	struct sockaddr_alg sa = { .salg_family = AF_ALG };
+	unsigned char key[AES_KEY_LEN] = { 0 };
+	int tfm, op;
+
+	strncpy((char *)sa.salg_type, type, sizeof(sa.salg_type) - 1);
+	strncpy((char *)sa.salg_name, name, sizeof(sa.salg_name) - 1);
+
+	tfm = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (tfm < 0)
+		return -1;
+
+	if (bind(tfm, (struct sockaddr *)&sa, sizeof(sa)) ||
+	    setsockopt(tfm, SOL_ALG, ALG_SET_KEY, key, sizeof(key)) ||
+	    (gcm && setsockopt(tfm, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL,
+			       GCM_TAG_LEN))) {
+		close(tfm);
+		return -1;
+	}
+
+	op = accept(tfm, NULL, 0);
+	close(tfm);
+	return op;
+}
+
+/* One encryption of len bytes, with a fresh IV and no associated data */
+static int alg_encrypt(int op, int gcm, void *in, void *out, size_t len)
+{
+	unsigned int ivlen = gcm ? GCM_IV_LEN : CBC_IV_LEN;
+	char cbuf[CMSG_SPACE(sizeof(__u32)) +
+		  CMSG_SPACE(sizeof(struct af_alg_iv) + CBC_IV_LEN) +
+		  CMSG_SPACE(sizeof(__u32))] = { 0 };
+	struct iovec iov = { .iov_base = in, .iov_len = len };
+	struct msghdr msg = {
+		.msg_control = cbuf,
+		.msg_controllen = CMSG_SPACE(sizeof(__u32)) +
+				  CMSG_SPACE(sizeof(struct af_alg_iv) + ivlen),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	struct af_alg_iv *iv;
+	struct cmsghdr *cmsg;
+	size_t outlen = len + (gcm ? GCM_TAG_LEN : 0);
+
+	if (gcm)
+		msg.msg_controllen += CMSG_SPACE(sizeof(__u32));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+	*(__u32 *)CMSG_DATA(cmsg) = ALG_OP_ENCRYPT;
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_IV;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(*iv) + ivlen);
+	iv = (struct af_alg_iv *)CMSG_DATA(cmsg);
+	iv->ivlen = ivlen;
+	memset(iv->iv, 0xa5, ivlen);
+
+	if (gcm) {
+		cmsg = CMSG_NXTHDR(&msg, cmsg);
+		cmsg->cmsg_level = SOL_ALG;
+		cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
+		*(__u32 *)CMSG_DATA(cmsg) = 0;
+	}
+
+	if (sendmsg(op, &msg, 0) != (ssize_t)len)
+		return -1;
+
+	if (read(op, out, outlen) != (ssize_t)outlen)
+		return -1;
+
+	return 0;
+}
+
+static int run(const char *mode, unsigned long size, unsigned int secs)
+{
+	int gcm = !strcmp(mode, "gcm");
+	uint64_t *lat, start, end, t;
+	size_t nlat = 0, maxlat = 1 << 20;
+	unsigned long ops = 0;
+	void *in, *out;
+	int op;
+
+	op = alg_open(gcm ? "aead" : "skcipher",
+		      gcm ? "gcm(aes)" : "cbc(aes)", gcm);
+	if (op < 0) {
+		fprintf(stderr, "%s(aes) not available: %s\n", mode,
+			strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	in = calloc(1, size);
+	out = calloc(1, size + GCM_TAG_LEN);
+	lat = calloc(maxlat, sizeof(*lat));
+	if (!in || !out || !lat) {
+		close(op);
+		return KSFT_FAIL;
+	}
+
+	start = now_ns();
+	end = start + secs * 1000000000ULL;
+	do {
+		t = now_ns();
+		if (alg_encrypt(op, gcm, in, out, size)) {
+			perror("AF_ALG encrypt");
+			close(op);
+			return KSFT_FAIL;
+		}
+		t = now_ns() - t;
+		if (nlat < maxlat)
+			lat[nlat++] = t;
+		ops++;
+	} while (now_ns() < end);
+	end = now_ns();
+
+	sort_samples(lat, nlat);
+	perf_result("af_alg", "alg=%s(aes) size=%lu ops=%lu MBps=%.2f lat_p50_ns=%llu lat_p99_ns=%llu",
+		    mode, size, ops,
+		    mb_per_s((uint64_t)ops * size, end - start),
+		    (unsigned long long)percentile(lat, nlat, 50),
+		    (unsigned long long)percentile(lat, nlat, 99));
+
+	free(lat);
+	free(out);
+	free(in);
+	close(op);
+
+	return KSFT_PASS;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long sizes[MAX_SIZES] = { 16, 256, 1024, 4096, 16384, 65536 };
+	int nsizes = 6, i, ret = KSFT_PASS, c;
+	const char *mode = "cbc";
+	unsigned int secs = 1;
+
+	while ((c = getopt(argc, argv, "m:s:t:")) != -1) {
+		switch (c) {
+		case 'm':
+			mode = optarg;
+			break;
+		case 's':
+			nsizes = parse_sizes(optarg, sizes, MAX_SIZES);
+			break;
+		case 't':
+			secs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s -m cbc|gcm [-s sizes] [-t seconds]\n",
+				argv[0]);
+			return KSFT_FAIL;
+		}
+	}
+
+	if (strcmp(mode, "cbc") && strcmp(mode, "gcm")) {
+		fprintf(stderr, "unknown mode %s\n", mode);
+		return KSFT_FAIL;
+	}
+
+	for (i = 0; i < nsizes && ret == KSFT_PASS; i++) {
+		/* CBC works on whole blocks */
+		if (!strcmp(mode, "cbc") && sizes[i] % 16)
+			continue;
+		ret = run(mode, sizes[i], secs);
+	}
+
+	return ret;
+}
@@ -0,0 +1,154 @@
+/*
+ * Memory to memory sample rate conversion speed of the ASRC
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Converts silence through /dev/mxc_asrc as fast as the pair allows and
+ * reports how many times faster than real time that is, the figure that
+ * says how many streams one ASRC can serve.
+ *
+ *	asrc_bench [-c channels] [-r in_rate:out_rate] [-t seconds]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/mxc_asrc.h>
+
+#include "imx_perf.h"
+
+/* the m2m driver rejects anything larger than its DMA buffer */
+#define ASRC_BENCH_BUF_SIZE	(1024 * 48 * 4)
+#define ASRC_BENCH_IN_FRAMES	8192
+#define ASRC_SAMPLE_SIZE	2
+
+int main(int argc, char **argv)
+{
+	unsigned int channels = 2, in_rate = 44100, out_rate = 48000, secs = 2;
+	unsigned int in_len, out_len, frame;
+	struct asrc_convert_buffer buf;
+	struct asrc_config config;
+	struct asrc_req req;
+	uint64_t start, end, in_frames = 0;
+	void *in, *out;
+	int fd, c, ret = KSFT_PASS;
+
+	while ((c = getopt(argc, argv, "c:r:t:")) != -1) {
+		switch (c) {
+		case 'c':
+			channels = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			if (sscanf(optarg, "%u:%u", &in_rate, &out_rate) != 2)
+				goto usage;
+			break;
+		case 't':
+			secs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (!channels || !in_rate || !out_rate)
+		goto usage;
+
+	frame = channels * ASRC_SAMPLE_SIZE;
+	in_len = ASRC_BENCH_IN_FRAMES * frame;
+	out_len = (uint64_t)ASRC_BENCH_IN_FRAMES * out_rate / in_rate * frame;
+	if (in_len > ASRC_BENCH_BUF_SIZE || out_len > ASRC_BENCH_BUF_SIZE) {
+		fprintf(stderr, "%u channels at %u:%u do not fit a buffer\n",
+			channels, in_rate, out_rate);
+		return KSFT_FAIL;
+	}
+
+	fd = open("/dev/mxc_asrc", O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "/dev/mxc_asrc: %s\n", strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	req.chn_num = channels;
+	if (ioctl(fd, ASRC_REQ_PAIR, &req)) {
+		fprintf(stderr, "no pair for %u channels: %s\n", channels,
+			strerror(errno));
+		close(fd);
+		return KSFT_SKIP;
+	}
+
+	memset(&config, 0, sizeof(config));
+	config.pair = req.index;
+	config.channel_num = channels;
+	config.buffer_num = 1;
+	config.dma_buffer_size = ASRC_BENCH_BUF_SIZE;
+	config.input_sample_rate = in_rate;
+	config.output_sample_rate = out_rate;
+	config.input_word_width = ASRC_WIDTH_16_BIT;
+	config.output_word_width = ASRC_WIDTH_16_BIT;
+	config.inclk = INCLK_NONE;
+	config.outclk = OUTCLK_ASRCK1_CLK;
+
+	in = calloc(1, in_len);
+	out = calloc(1, out_len);
+	if (!in || !out) {
+		ret = KSFT_FAIL;
+		goto release;
+	}
+
+	if (ioctl(fd, ASRC_CONFIG_PAIR, &config)) {
+		fprintf(stderr, "%u to %u Hz not supported: %s\n", in_rate,
+			out_rate, strerror(errno));
+		ret = KSFT_SKIP;
+		goto release;
+	}
+
+	if (ioctl(fd, ASRC_START_CONV, &req.index)) {
+		perror("ASRC_START_CONV");
+		ret = KSFT_FAIL;
+		goto release;
+	}
+
+	start = now_ns();
+	end = start + secs * 1000000000ULL;
+	do {
+		buf.input_buffer_vaddr = in;
+		buf.input_buffer_length = in_len;
+		buf.output_buffer_vaddr = out;
+		buf.output_buffer_length = out_len;
+
+		if (ioctl(fd, ASRC_CONVERT, &buf)) {
+			perror("ASRC_CONVERT");
+			ret = KSFT_FAIL;
+			break;
+		}
+		in_frames += ASRC_BENCH_IN_FRAMES;
+	} while (now_ns() < end);
+	end = now_ns();
+
+	ioctl(fd, ASRC_STOP_CONV, &req.index);
+
+	if (ret == KSFT_PASS)
+		perf_result("asrc", "channels=%u in_rate=%u out_rate=%u realtime_x=%.1f MBps=%.2f",
+			    channels, in_rate, out_rate,
+			    (double)in_frames * 1e9 / in_rate / (end - start),
+			    mb_per_s(in_frames * frame, end - start));
+
+release:
+	ioctl(fd, ASRC_RELEASE_PAIR, &req.index);
+	free(out);
+	free(in);
+	close(fd);
+
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s [-c channels] [-r in_rate:out_rate] [-t seconds]\n",
+		argv[0]);
+	return KSFT_FAIL;
+}
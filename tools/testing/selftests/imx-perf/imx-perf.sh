@@ -0,0 +1,189 @@
+#!/bin/sh
+# Runs the i.MX accelerator benchmarks and prints one "imx-perf:" line per
+# result. SDMA and servers of the in-kernel crypto API are measured by the
+# dmatest and tcrypt modules, everything else from user space.
+#
+# Nothing is written to storage. Block and MTD devices are only read when
+# named in the environment:
+#	IMX_PERF_MMC=/dev/mmcblk2 IMX_PERF_MTD=/dev/mtd4 ./imx-perf.sh
+# IMX_PERF_SECS sets the run time of each test, default 1.
+
+ksft_skip=4
+secs=${IMX_PERF_SECS:-1}
+ret=0
+
+if ! grep -qs "i.MX" /sys/devices/soc0/family; then
+	echo "imx-perf: not an i.MX SoC [SKIP]"
+	exit $ksft_skip
+fi
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "imx-perf: must be run as root [SKIP]"
+	exit $ksft_skip
+fi
+
+fail()
+{
+	echo "imx-perf: $1 [FAIL]"
+	ret=1
+}
+
+# Kernel log lines printed since the last call with the same tag
+mark()
+{
+	echo "imx-perf: mark $1" > /dev/kmsg
+}
+
+since_mark()
+{
+	dmesg | sed -n "/imx-perf: mark $1\$/,\$p"
+}
+
+dma_bench()
+{
+	sdma=$(ls /sys/bus/platform/drivers/imx-sdma 2>/dev/null | grep sdma | head -n 1)
+	params=/sys/module/dmatest/parameters
+
+	if [ -z "$sdma" ] || ! modprobe -q dmatest; then
+		echo "imx-perf: dma_memcpy needs SDMA and dmatest [SKIP]"
+		return
+	fi
+
+	echo "$sdma" > $params/device
+	echo 1 > $params/max_channels
+	echo 1 > $params/threads_per_chan
+	echo 1 > $params/noverify
+	echo 0 > $params/dmatest
+
+	for size in 4096 65536 1048576; do
+		echo $size > $params/test_buf_size
+		echo $((secs * 2000)) > $params/iterations
+		mark dma$size
+		echo 1 > $params/run
+		cat $params/wait > /dev/null
+
+		since_mark dma$size | awk -v size=$size '
+			/summary/ {
+				sub(/.*dmatest: /, "")
+				sub(/:/, "")
+				printf "imx-perf: bench=dma_memcpy chan=%s size=%s tests=%s failures=%s iops=%s KBps=%s\n",
+					$1, size, $3, $5, $7, $9
+			}'
+	done
+
+	modprobe -q -r dmatest
+}
+
+tcrypt_bench()
+{
+	mode=$1
+
+	mark tcrypt$mode
+	# tcrypt always fails to load so it can be run again
+	modprobe -q tcrypt mode=$mode sec=$secs 2>/dev/null
+	if ! since_mark tcrypt$mode | grep -q "testing speed"; then
+		echo "imx-perf: tcrypt mode $mode needs CONFIG_CRYPTO_TEST [SKIP]"
+		return
+	fi
+
+	since_mark tcrypt$mode | awk -v secs=$secs '
+		/testing speed of/ {
+			alg = $0; sub(/.*testing speed of (async )?/, "", alg)
+			split(alg, f, " ")
+			name = f[1]; drv = f[2]; dir = f[3]
+			gsub(/[()]/, "", drv)
+			keep = name == "cbc(aes)" || name == "gcm(aes)"
+		}
+		keep && match($0, /[0-9]+ bit key, [0-9]+ byte blocks/) {
+			split(substr($0, RSTART, RLENGTH), f, " ")
+			key = f[1]; blk = f[4]
+		}
+		keep && match($0, /\([0-9]+ bytes\)/) {
+			bytes = substr($0, RSTART + 1, RLENGTH - 8)
+			printf "imx-perf: bench=tcrypt alg=%s driver=%s dir=%s key=%s size=%s MBps=%.2f\n",
+				name, drv, dir, key, blk, bytes / secs / 1000000
+		}'
+}
+
+# The driver AF_ALG picks for an algorithm, the one with the highest priority
+crypto_driver()
+{
+	awk -v alg="$1" '
+		$1 == "name" { name = $3 }
+		$1 == "driver" { drv = $3 }
+		$1 == "priority" && name == alg && $3 > best { best = $3; pick = drv }
+		END { print pick }' /proc/crypto
+}
+
+af_alg_bench()
+{
+	for mode in cbc gcm; do
+		echo "imx-perf: af_alg $mode(aes) served by $(crypto_driver "$mode(aes)")"
+		./af_alg_bench -m $mode -t $secs
+		case $? in
+		0|$ksft_skip) ;;
+		*) fail "af_alg $mode" ;;
+		esac
+	done
+}
+
+m2m_bench()
+{
+	found=0
+
+	for name in /sys/class/video4linux/video*/name; do
+		case "$(cat $name 2>/dev/null)" in
+		mxc-ipu-m2m|mxc-pxp-m2m) ;;
+		*) continue ;;
+		esac
+
+		found=1
+		dev=/dev/$(basename $(dirname $name))
+		# 1080p colour conversion alone, and with a downscale
+		./m2m_bench -d $dev -i 1920x1080:YUYV -o 1920x1080:RGBP || fail "m2m $dev"
+		./m2m_bench -d $dev -i 1920x1080:YUYV -o 1280x720:RGBP || fail "m2m $dev"
+	done
+
+	[ $found -eq 1 ] || echo "imx-perf: no IPU or PXP mem2mem device [SKIP]"
+}
+
+asrc_bench()
+{
+	if [ ! -c /dev/mxc_asrc ]; then
+		echo "imx-perf: no /dev/mxc_asrc [SKIP]"
+		return
+	fi
+
+	./asrc_bench -c 2 -r 44100:48000 -t $secs || fail "asrc 44100:48000"
+	./asrc_bench -c 2 -r 48000:44100 -t $secs || fail "asrc 48000:44100"
+}
+
+io_bench()
+{
+	if [ -n "$IMX_PERF_MMC" ]; then
+		for qd in 1 4 8; do
+			./io_bench -b "$IMX_PERF_MMC" -s 4096 -q $qd -t $secs ||
+				fail "io $IMX_PERF_MMC"
+		done
+	else
+		echo "imx-perf: set IMX_PERF_MMC to a block device to read [SKIP]"
+	fi
+
+	if [ -n "$IMX_PERF_MTD" ]; then
+		./io_bench -m "$IMX_PERF_MTD" -t $secs || fail "io $IMX_PERF_MTD"
+	else
+		echo "imx-perf: set IMX_PERF_MTD to an MTD device to read [SKIP]"
+	fi
+}
+
+dma_bench
+tcrypt_bench 500
+tcrypt_bench 211
+af_alg_bench
+m2m_bench
+asrc_bench
+io_bench
+# The VPU is only reachable through the vendor codec library
+echo "imx-perf: vpu needs the imx-vpu library [SKIP]"
+
+exit $ret
@@ -0,0 +1,87 @@
+/*
+ * Helpers shared by the i.MX accelerator benchmarks
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Every benchmark prints its results as single lines of the form
+ *
+ *	imx-perf: bench=<name> key=value key=value ...
+ *
+ * so a run can be collected with grep and compared across kernels.
+ */
+
+#ifndef __IMX_PERF_H
+#define __IMX_PERF_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KSFT_PASS	0
+#define KSFT_FAIL	1
+#define KSFT_SKIP	4
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void perf_result(const char *bench, const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("imx-perf: bench=%s ", bench);
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n");
+	fflush(stdout);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static inline void sort_samples(uint64_t *lat, size_t n)
+{
+	qsort(lat, n, sizeof(*lat), cmp_u64);
+}
+
+/* lat[] must be sorted; pct is 0..100 */
+static inline uint64_t percentile(const uint64_t *lat, size_t n,
+				  unsigned int pct)
+{
+	return n ? lat[(n - 1) * pct / 100] : 0;
+}
+
+static inline double mb_per_s(uint64_t bytes, uint64_t ns)
+{
+	return ns ? (double)bytes * 1000.0 / ns : 0.0;
+}
+
+/* Parse "4096,65536" into sizes[], returns the count */
+static inline int parse_sizes(char *arg, unsigned long *sizes, int max)
+{
+	int n = 0;
+	char *tok;
+
+	for (tok = strtok(arg, ","); tok && n < max; tok = strtok(NULL, ","))
+		sizes[n++] = strtoul(tok, NULL, 0);
+
+	return n;
+}
+
+#endif /* __IMX_PERF_H */
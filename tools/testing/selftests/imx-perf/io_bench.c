@@ -0,0 +1,250 @@
+/*
+ * Read speed of the eMMC/SD (uSDHC) and raw NAND (GPMI) controllers
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Nothing is written. A block device gets random reads with O_DIRECT, one
+ * thread per outstanding request, which is what an application doing
+ * small random reads sees. An MTD character device gets sequential page
+ * reads, which go through the GPMI, BCH and APBH DMA for every page.
+ *
+ *	io_bench -b /dev/mmcblkN [-s 4096] [-q depth] [-t seconds]
+ *	io_bench -m /dev/mtdN [-t seconds]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <mtd/mtd-user.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+#include "imx_perf.h"
+
+#define IO_BENCH_MAX_QD		32
+#define IO_BENCH_MAX_LAT	(1 << 18)
+
+struct io_worker {
+	pthread_t thread;
+	int fd;
+	unsigned int bs;
+	uint64_t nblocks;
+	uint64_t end;
+	unsigned int seed;
+	uint64_t *lat;
+	size_t nlat;
+	uint64_t ops;
+	int err;
+};
+
+static void *io_worker_fn(void *arg)
+{
+	struct io_worker *w = arg;
+	uint64_t t, blk;
+	void *buf;
+
+	if (posix_memalign(&buf, 4096, w->bs)) {
+		w->err = ENOMEM;
+		return NULL;
+	}
+
+	do {
+		blk = ((uint64_t)rand_r(&w->seed) << 31 | rand_r(&w->seed)) %
+		      w->nblocks;
+		t = now_ns();
+		if (pread(w->fd, buf, w->bs, blk * w->bs) != w->bs) {
+			w->err = errno ? errno : EIO;
+			break;
+		}
+		t = now_ns() - t;
+		if (w->nlat < IO_BENCH_MAX_LAT)
+			w->lat[w->nlat++] = t;
+		w->ops++;
+	} while (now_ns() < w->end);
+
+	free(buf);
+	return NULL;
+}
+
+static int blk_bench(const char *dev, unsigned int bs, unsigned int qd,
+		     unsigned int secs)
+{
+	struct io_worker w[IO_BENCH_MAX_QD];
+	uint64_t size, start, end, ops = 0, *lat;
+	size_t nlat = 0;
+	unsigned int i;
+	int fd, ret = KSFT_PASS;
+
+	fd = open(dev, O_RDONLY | O_DIRECT);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	if (ioctl(fd, BLKGETSIZE64, &size) || size < bs) {
+		fprintf(stderr, "%s: cannot get the size\n", dev);
+		close(fd);
+		return KSFT_FAIL;
+	}
+
+	lat = calloc((size_t)qd * IO_BENCH_MAX_LAT, sizeof(*lat));
+	if (!lat) {
+		close(fd);
+		return KSFT_FAIL;
+	}
+
+	start = now_ns();
+	for (i = 0; i < qd; i++) {
+		memset(&w[i], 0, sizeof(w[i]));
+		w[i].fd = fd;
+		w[i].bs = bs;
+		w[i].nblocks = size / bs;
+		w[i].end = start + secs * 1000000000ULL;
+		w[i].seed = start + i;
+		w[i].lat = lat + (size_t)i * IO_BENCH_MAX_LAT;
+		if (pthread_create(&w[i].thread, NULL, io_worker_fn, &w[i])) {
+			qd = i;
+			ret = KSFT_FAIL;
+			break;
+		}
+	}
+
+	for (i = 0; i < qd; i++) {
+		pthread_join(w[i].thread, NULL);
+		if (w[i].err) {
+			fprintf(stderr, "%s: %s\n", dev, strerror(w[i].err));
+			ret = KSFT_FAIL;
+		}
+		/* gather the samples at the front for one sort */
+		memmove(lat + nlat, w[i].lat, w[i].nlat * sizeof(*lat));
+		nlat += w[i].nlat;
+		ops += w[i].ops;
+	}
+	end = now_ns();
+
+	if (ret == KSFT_PASS) {
+		sort_samples(lat, nlat);
+		perf_result("blk_randread", "dev=%s bs=%u qd=%u iops=%.0f MBps=%.2f lat_p50_us=%llu lat_p99_us=%llu lat_max_us=%llu",
+			    dev, bs, qd, ops * 1e9 / (end - start),
+			    mb_per_s(ops * bs, end - start),
+			    (unsigned long long)percentile(lat, nlat, 50) / 1000,
+			    (unsigned long long)percentile(lat, nlat, 99) / 1000,
+			    (unsigned long long)percentile(lat, nlat, 100) / 1000);
+	}
+
+	free(lat);
+	close(fd);
+	return ret;
+}
+
+static int mtd_bench(const char *dev, unsigned int secs)
+{
+	uint64_t start, end, bytes = 0, t, *lat;
+	size_t nlat = 0;
+	struct mtd_info_user info;
+	off_t off = 0;
+	int fd, ret = KSFT_PASS;
+	ssize_t len;
+	void *buf;
+
+	fd = open(dev, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	if (ioctl(fd, MEMGETINFO, &info) || !info.writesize) {
+		fprintf(stderr, "%s is not an MTD device\n", dev);
+		close(fd);
+		return KSFT_SKIP;
+	}
+
+	buf = malloc(info.writesize);
+	lat = calloc(IO_BENCH_MAX_LAT, sizeof(*lat));
+	if (!buf || !lat) {
+		close(fd);
+		return KSFT_FAIL;
+	}
+
+	start = now_ns();
+	end = start + secs * 1000000000ULL;
+	do {
+		t = now_ns();
+		len = pread(fd, buf, info.writesize, off);
+		t = now_ns() - t;
+		/* bad blocks and uncorrectable pages are skipped, not fatal */
+		if (len < 0 && errno != EBADMSG && errno != EIO) {
+			perror(dev);
+			ret = KSFT_FAIL;
+			break;
+		}
+		if (len > 0) {
+			bytes += len;
+			if (nlat < IO_BENCH_MAX_LAT)
+				lat[nlat++] = t;
+		}
+		off += info.writesize;
+		if (off + info.writesize > info.size)
+			off = 0;
+	} while (now_ns() < end);
+	end = now_ns();
+
+	if (ret == KSFT_PASS) {
+		sort_samples(lat, nlat);
+		perf_result("mtd_read", "dev=%s page=%u MBps=%.2f lat_p50_us=%llu lat_p99_us=%llu",
+			    dev, info.writesize, mb_per_s(bytes, end - start),
+			    (unsigned long long)percentile(lat, nlat, 50) / 1000,
+			    (unsigned long long)percentile(lat, nlat, 99) / 1000);
+	}
+
+	free(lat);
+	free(buf);
+	close(fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int bs = 4096, qd = 1, secs = 5;
+	const char *blk = NULL, *mtd = NULL;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:m:s:q:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			blk = optarg;
+			break;
+		case 'm':
+			mtd = optarg;
+			break;
+		case 's':
+			bs = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			qd = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			secs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (!blk == !mtd || !qd || qd > IO_BENCH_MAX_QD || !bs || bs % 512)
+		goto usage;
+
+	return blk ? blk_bench(blk, bs, qd, secs) : mtd_bench(mtd, secs);
+
+usage:
+	fprintf(stderr, "usage: %s -b /dev/mmcblkN [-s bs] [-q depth] [-t seconds]\n"
+			"       %s -m /dev/mtdN [-t seconds]\n", argv[0], argv[0]);
+	return KSFT_FAIL;
+}
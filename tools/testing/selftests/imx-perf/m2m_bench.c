@@ -0,0 +1,239 @@
+/*
+ * Colour conversion and scaling throughput of a V4L2 mem2mem device
+ *
+ * Copyright 2017 NXP
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Runs frames through one of the mxc-ipu-m2m or mxc-pxp-m2m devices, by
+ * default 1080p YUYV in and 720p RGB565 out, and reports frames per second
+ * and the time from queuing a frame to getting the converted one back.
+ *
+ *	m2m_bench -d /dev/videoN [-i 1920x1080:YUYV] [-o 1280x720:RGBP]
+ *		  [-n frames]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "imx_perf.h"
+
+struct m2m_fmt {
+	unsigned int width;
+	unsigned int height;
+	__u32 fourcc;
+};
+
+static int parse_fmt(const char *arg, struct m2m_fmt *fmt)
+{
+	char fcc[5] = { 0 };
+
+	if (sscanf(arg, "%ux%u:%4s", &fmt->width, &fmt->height, fcc) != 3)
+		return -1;
+
+	fmt->fourcc = v4l2_fourcc(fcc[0], fcc[1], fcc[2], fcc[3]);
+	return 0;
+}
+
+static int set_fmt(int fd, enum v4l2_buf_type type, struct m2m_fmt *m2m_fmt,
+		   unsigned int *sizeimage)
+{
+	struct v4l2_format fmt = { .type = type };
+
+	fmt.fmt.pix.width = m2m_fmt->width;
+	fmt.fmt.pix.height = m2m_fmt->height;
+	fmt.fmt.pix.pixelformat = m2m_fmt->fourcc;
+	fmt.fmt.pix.field = V4L2_FIELD_NONE;
+
+	if (ioctl(fd, VIDIOC_S_FMT, &fmt))
+		return -1;
+
+	if (fmt.fmt.pix.pixelformat != m2m_fmt->fourcc) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	m2m_fmt->width = fmt.fmt.pix.width;
+	m2m_fmt->height = fmt.fmt.pix.height;
+	*sizeimage = fmt.fmt.pix.sizeimage;
+
+	return 0;
+}
+
+/* One MMAP buffer on the queue, touched so it is populated */
+static void *setup_buf(int fd, enum v4l2_buf_type type)
+{
+	struct v4l2_requestbuffers req = {
+		.count = 1,
+		.type = type,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	struct v4l2_buffer buf = {
+		.type = type,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	void *p;
+
+	if (ioctl(fd, VIDIOC_REQBUFS, &req) || !req.count)
+		return NULL;
+
+	if (ioctl(fd, VIDIOC_QUERYBUF, &buf))
+		return NULL;
+
+	p = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		 buf.m.offset);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	memset(p, 0x80, buf.length);
+	return p;
+}
+
+static int queue(int fd, enum v4l2_buf_type type, unsigned int bytesused)
+{
+	struct v4l2_buffer buf = {
+		.type = type,
+		.memory = V4L2_MEMORY_MMAP,
+		.index = 0,
+		.bytesused = bytesused,
+	};
+
+	return ioctl(fd, VIDIOC_QBUF, &buf);
+}
+
+static int dequeue(int fd, enum v4l2_buf_type type)
+{
+	struct v4l2_buffer buf = {
+		.type = type,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+
+	return ioctl(fd, VIDIOC_DQBUF, &buf);
+}
+
+int main(int argc, char **argv)
+{
+	struct m2m_fmt in = { 1920, 1080, V4L2_PIX_FMT_YUYV };
+	struct m2m_fmt out = { 1280, 720, V4L2_PIX_FMT_RGB565 };
+	enum v4l2_buf_type out_type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	enum v4l2_buf_type cap_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	const char *dev = "/dev/video0";
+	struct v4l2_capability cap;
+	unsigned int frames = 300, i, in_size, out_size;
+	uint64_t *lat, start, t;
+	struct pollfd pfd;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "d:i:o:n:")) != -1) {
+		switch (c) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'i':
+			if (parse_fmt(optarg, &in))
+				goto usage;
+			break;
+		case 'o':
+			if (parse_fmt(optarg, &out))
+				goto usage;
+			break;
+		case 'n':
+			frames = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (!frames)
+		goto usage;
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	if (ioctl(fd, VIDIOC_QUERYCAP, &cap) ||
+	    !(cap.device_caps & V4L2_CAP_VIDEO_M2M)) {
+		fprintf(stderr, "%s is not a mem2mem device\n", dev);
+		return KSFT_SKIP;
+	}
+
+	if (set_fmt(fd, out_type, &in, &in_size) ||
+	    set_fmt(fd, cap_type, &out, &out_size)) {
+		fprintf(stderr, "%s: %ux%u to %ux%u not supported: %s\n",
+			(char *)cap.card, in.width, in.height, out.width,
+			out.height, strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	if (!setup_buf(fd, out_type) || !setup_buf(fd, cap_type)) {
+		perror("buffer setup");
+		return KSFT_FAIL;
+	}
+
+	lat = calloc(frames, sizeof(*lat));
+	if (!lat)
+		return KSFT_FAIL;
+
+	if (ioctl(fd, VIDIOC_STREAMON, &out_type) ||
+	    ioctl(fd, VIDIOC_STREAMON, &cap_type)) {
+		perror("VIDIOC_STREAMON");
+		return KSFT_FAIL;
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	start = now_ns();
+	for (i = 0; i < frames; i++) {
+		t = now_ns();
+
+		if (queue(fd, cap_type, 0) || queue(fd, out_type, in_size)) {
+			perror("VIDIOC_QBUF");
+			return KSFT_FAIL;
+		}
+
+		if (poll(&pfd, 1, 1000) != 1) {
+			fprintf(stderr, "frame %u timed out\n", i);
+			return KSFT_FAIL;
+		}
+
+		if (dequeue(fd, cap_type) || dequeue(fd, out_type)) {
+			perror("VIDIOC_DQBUF");
+			return KSFT_FAIL;
+		}
+
+		lat[i] = now_ns() - t;
+	}
+	t = now_ns() - start;
+
+	ioctl(fd, VIDIOC_STREAMOFF, &cap_type);
+	ioctl(fd, VIDIOC_STREAMOFF, &out_type);
+
+	sort_samples(lat, frames);
+	perf_result("m2m", "card=%s in=%ux%u:%.4s out=%ux%u:%.4s frames=%u fps=%.1f MBps=%.2f lat_p50_us=%llu lat_p99_us=%llu",
+		    (char *)cap.card, in.width, in.height, (char *)&in.fourcc,
+		    out.width, out.height, (char *)&out.fourcc, frames,
+		    frames * 1e9 / t,
+		    mb_per_s((uint64_t)frames * (in_size + out_size), t),
+		    (unsigned long long)percentile(lat, frames, 50) / 1000,
+		    (unsigned long long)percentile(lat, frames, 99) / 1000);
+
+	close(fd);
+	return KSFT_PASS;
+
+usage:
+	fprintf(stderr, "usage: %s -d /dev/videoN [-i WxH:FOURCC] [-o WxH:FOURCC] [-n frames]\n",
+		argv[0]);
+	return KSFT_FAIL;
+}
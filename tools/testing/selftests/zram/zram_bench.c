@@ -0,0 +1,361 @@
+/*
+ * Throughput and compression ratio of a zram device
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Fills an initialised /dev/zramN with pages of one kind of content, then
+ * reads it all back, both with O_DIRECT from a number of threads so every
+ * request goes through the compressor. Prints one line with the write and
+ * read speed and what mm_stat says the data costs in memory. ratio is the
+ * data written over the memory zsmalloc holds for it, overhead_pct what
+ * zsmalloc holds beyond the compressed size:
+ *
+ *	zram_bench: content=text threads=2 bs=65536 write_MBps=... ratio=...
+ *
+ * Content kinds:
+ *	zero	all zero pages
+ *	pattern	pages filled with one repeated word, as memset() leaves them
+ *	text	English-like words and punctuation
+ *	binary	a mix of small integers, pointers and random bytes, like
+ *		program data
+ * Text and binary pages are all different, so dedup does not skew them.
+ *
+ *	zram_bench -d /dev/zramN [-c zero|pattern|text|binary] [-j threads]
+ *		   [-b bytes per request]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+#define KSFT_PASS	0
+#define KSFT_FAIL	1
+#define KSFT_SKIP	4
+
+#define ZRAM_PAGE_SIZE	4096
+/* Distinct pages each thread cycles through, stamped to keep them unique */
+#define POOL_PAGES	256
+#define MAX_THREADS	32
+
+enum content { ZERO, PATTERN, TEXT, BINARY };
+
+static const char * const content_names[] = { "zero", "pattern", "text",
+					       "binary" };
+
+static const char * const words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"with", "was", "on", "be", "at", "by", "this", "from", "or", "have",
+	"an", "which", "one", "you", "were", "all", "their", "there", "been",
+	"memory", "device", "page", "kernel", "would", "about", "other",
+	"buffer", "compression", "between", "through", "because", "system",
+};
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	enum content content;
+	unsigned int bs;
+	uint64_t first;
+	uint64_t npages;
+	unsigned char *pool;
+	int write;
+	int err;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t rnd(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void fill_text(unsigned char *p, uint32_t *seed)
+{
+	unsigned int n = 0, len, r;
+	const char *w;
+
+	while (n < ZRAM_PAGE_SIZE) {
+		w = words[rnd(seed) % ARRAY_SIZE(words)];
+		len = strlen(w);
+		if (len > ZRAM_PAGE_SIZE - n)
+			len = ZRAM_PAGE_SIZE - n;
+		memcpy(p + n, w, len);
+		n += len;
+
+		r = rnd(seed) % 16;
+		if (r < 2 && n < ZRAM_PAGE_SIZE)
+			p[n++] = r ? ',' : '.';
+		if (n < ZRAM_PAGE_SIZE)
+			p[n++] = r == 2 ? '\n' : ' ';
+	}
+}
+
+static void fill_binary(unsigned char *p, uint32_t *seed)
+{
+	uint32_t *w = (uint32_t *)p, r;
+	unsigned int i;
+
+	for (i = 0; i < ZRAM_PAGE_SIZE / sizeof(*w); i++) {
+		r = rnd(seed);
+		switch (r & 3) {
+		case 0:
+		case 1:
+			w[i] = (r >> 2) & 0xff;
+			break;
+		case 2:
+			w[i] = 0xc0000000 | ((r >> 2) & 0x00fffffc);
+			break;
+		default:
+			w[i] = rnd(seed) << 8 | r >> 24;
+			break;
+		}
+	}
+}
+
+/* Make the page at index idx out of its pool page */
+static unsigned char *make_page(struct worker *w, uint64_t idx)
+{
+	unsigned char *p = w->pool + (idx % POOL_PAGES) * ZRAM_PAGE_SIZE;
+	unsigned long *word = (unsigned long *)p;
+	unsigned int i;
+
+	switch (w->content) {
+	case ZERO:
+		break;
+	case PATTERN:
+		for (i = 0; i < ZRAM_PAGE_SIZE / sizeof(*word); i++)
+			word[i] = (unsigned long)idx * 0x0101010101010101ULL;
+		break;
+	default:
+		memcpy(p, &idx, sizeof(idx));
+		break;
+	}
+
+	return p;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned int per_io = w->bs / ZRAM_PAGE_SIZE, i;
+	uint64_t idx, end = w->first + w->npages;
+	unsigned char *buf;
+	ssize_t ret;
+
+	if (posix_memalign((void **)&buf, ZRAM_PAGE_SIZE, w->bs)) {
+		w->err = ENOMEM;
+		return NULL;
+	}
+
+	for (idx = w->first; idx < end; idx += per_io) {
+		if (idx + per_io > end)
+			per_io = end - idx;
+
+		if (w->write) {
+			for (i = 0; i < per_io; i++)
+				memcpy(buf + i * ZRAM_PAGE_SIZE,
+				       make_page(w, idx + i), ZRAM_PAGE_SIZE);
+			ret = pwrite(w->fd, buf, per_io * ZRAM_PAGE_SIZE,
+				     idx * ZRAM_PAGE_SIZE);
+		} else {
+			ret = pread(w->fd, buf, per_io * ZRAM_PAGE_SIZE,
+				    idx * ZRAM_PAGE_SIZE);
+		}
+
+		if (ret != per_io * ZRAM_PAGE_SIZE) {
+			w->err = ret < 0 ? errno : EIO;
+			break;
+		}
+	}
+
+	free(buf);
+	return NULL;
+}
+
+/* Runs one pass over the device, returns its time in ns or 0 on error */
+static uint64_t run_pass(struct worker *w, unsigned int threads, int write)
+{
+	uint64_t start;
+	unsigned int i;
+	int err = 0;
+
+	start = now_ns();
+	for (i = 0; i < threads; i++) {
+		w[i].write = write;
+		w[i].err = 0;
+		if (pthread_create(&w[i].thread, NULL, worker_fn, &w[i])) {
+			threads = i;
+			err = EAGAIN;
+			break;
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(w[i].thread, NULL);
+		if (w[i].err)
+			err = w[i].err;
+	}
+
+	if (err) {
+		fprintf(stderr, "%s: %s\n", write ? "write" : "read",
+			strerror(err));
+		return 0;
+	}
+
+	return now_ns() - start;
+}
+
+/* The fields of mm_stat up to and including same_pages */
+static int read_mm_stat(const char *dev, unsigned long long *stat)
+{
+	char path[256], *name = strdupa(dev);
+	FILE *f;
+	int n;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/mm_stat", basename(name));
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	n = fscanf(f, "%llu %llu %llu %llu %llu %llu", &stat[0], &stat[1],
+		   &stat[2], &stat[3], &stat[4], &stat[5]);
+	fclose(f);
+
+	return n == 6 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int threads = 1, bs = 65536, i, j;
+	enum content content = TEXT;
+	struct worker w[MAX_THREADS];
+	unsigned long long st[6];
+	uint64_t size, npages, wr_ns, rd_ns;
+	const char *dev = NULL;
+	char ratio[16];
+	uint32_t seed;
+	int fd, c, ret = KSFT_PASS;
+
+	while ((c = getopt(argc, argv, "d:c:j:b:")) != -1) {
+		switch (c) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'c':
+			for (i = 0; i < 4; i++)
+				if (!strcmp(optarg, content_names[i]))
+					break;
+			if (i == 4)
+				goto usage;
+			content = i;
+			break;
+		case 'j':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (!dev || !threads || threads > MAX_THREADS || !bs ||
+	    bs % ZRAM_PAGE_SIZE)
+		goto usage;
+
+	fd = open(dev, O_RDWR | O_DIRECT);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	if (ioctl(fd, BLKGETSIZE64, &size) || size < ZRAM_PAGE_SIZE) {
+		fprintf(stderr, "%s: not initialised\n", dev);
+		close(fd);
+		return KSFT_FAIL;
+	}
+	npages = size / ZRAM_PAGE_SIZE;
+
+	memset(w, 0, sizeof(w));
+	for (i = 0; i < threads; i++) {
+		w[i].fd = fd;
+		w[i].content = content;
+		w[i].bs = bs;
+		w[i].first = npages * i / threads;
+		w[i].npages = npages * (i + 1) / threads - w[i].first;
+		w[i].pool = calloc(POOL_PAGES, ZRAM_PAGE_SIZE);
+		if (!w[i].pool) {
+			ret = KSFT_FAIL;
+			goto out;
+		}
+
+		seed = i + 1;
+		for (j = 0; j < POOL_PAGES; j++) {
+			if (content == TEXT)
+				fill_text(w[i].pool + j * ZRAM_PAGE_SIZE,
+					  &seed);
+			else if (content == BINARY)
+				fill_binary(w[i].pool + j * ZRAM_PAGE_SIZE,
+					    &seed);
+		}
+	}
+
+	wr_ns = run_pass(w, threads, 1);
+	rd_ns = wr_ns ? run_pass(w, threads, 0) : 0;
+	if (!rd_ns || read_mm_stat(dev, st)) {
+		ret = KSFT_FAIL;
+		goto out;
+	}
+
+	/*
+	 * orig_data_size, compr_data_size, mem_used_total and same_pages.
+	 * Same-filled pages take no memory beyond their table entry.
+	 */
+	if (st[2])
+		snprintf(ratio, sizeof(ratio), "%.2f", (double)st[0] / st[2]);
+	else
+		strcpy(ratio, "inf");
+
+	printf("zram_bench: content=%s threads=%u bs=%u size_MB=%llu "
+	       "write_MBps=%.2f read_MBps=%.2f orig_MB=%.2f compr_MB=%.2f "
+	       "mem_used_MB=%.2f same_pages=%llu ratio=%s overhead_pct=%.1f\n",
+	       content_names[content], threads, bs,
+	       (unsigned long long)size >> 20, size * 1000.0 / wr_ns,
+	       size * 1000.0 / rd_ns, st[0] / 1048576.0, st[1] / 1048576.0,
+	       st[2] / 1048576.0, st[5], ratio,
+	       st[1] ? (st[2] - (double)st[1]) * 100.0 / st[1] : 0.0);
+
+out:
+	for (i = 0; i < threads; i++)
+		free(w[i].pool);
+	close(fd);
+	return ret;
+
+usage:
+	fprintf(stderr, "usage: %s -d /dev/zramN [-c zero|pattern|text|binary] [-j threads] [-b bytes]\n",
+		argv[0]);
+	return KSFT_FAIL;
+}
@@ -0,0 +1,85 @@
+#!/bin/sh
+# Benchmarks zram for every compression backend: one zram_bench line per
+# backend, max_comp_streams value, async_write setting, content kind and
+# writer thread count, each on a freshly initialised device.
+#
+# The device is hot-added for the run and removed afterwards, so zram swap
+# already set up is left alone. Settings come from the environment:
+#	ZRAM_BENCH_SIZE_MB	device size, default 64
+#	ZRAM_BENCH_ALGS		backends, default all of comp_algorithm
+#	ZRAM_BENCH_STREAMS	max_comp_streams values, default the current
+#	ZRAM_BENCH_THREADS	writer threads, default "1 <online cpus>"
+#	ZRAM_BENCH_CONTENT	default "zero pattern text binary"
+#
+# zram compresses with one stream per CPU and accepts but ignores
+# max_comp_streams; the number of writers and async_write are what spread
+# compression over the CPUs.
+
+ksft_skip=4
+size_mb=${ZRAM_BENCH_SIZE_MB:-64}
+ncpu=$(getconf _NPROCESSORS_ONLN)
+threads=${ZRAM_BENCH_THREADS:-"1 $ncpu"}
+contents=${ZRAM_BENCH_CONTENT:-"zero pattern text binary"}
+ret=0
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "zram_bench: must be run as root [SKIP]"
+	exit $ksft_skip
+fi
+
+[ -d /sys/class/zram-control ] || modprobe -q zram num_devices=0
+if [ ! -d /sys/class/zram-control ]; then
+	echo "zram_bench: CONFIG_ZRAM is not set [SKIP]"
+	exit $ksft_skip
+fi
+
+id=$(cat /sys/class/zram-control/hot_add) || exit 1
+sys=/sys/block/zram$id
+dev=/dev/zram$id
+trap 'echo 1 > $sys/reset; echo $id > /sys/class/zram-control/hot_remove' EXIT
+
+algs=${ZRAM_BENCH_ALGS:-$(tr -d '[]' < $sys/comp_algorithm)}
+streams=${ZRAM_BENCH_STREAMS:-$(cat $sys/max_comp_streams)}
+if [ -f $sys/async_write ]; then
+	async="0 1"
+else
+	async=0
+fi
+
+# Resets the device and sets it up with alg, streams and async_write
+setup()
+{
+	echo 1 > $sys/reset
+	echo $1 > $sys/comp_algorithm || return 1
+	echo $2 > $sys/max_comp_streams
+	[ -f $sys/async_write ] && echo $3 > $sys/async_write
+	echo ${size_mb}M > $sys/disksize
+}
+
+# One run, with the device settings added to the result line
+bench()
+{
+	setup $alg $st $as || return 1
+	out=$(./zram_bench -d $dev -c $1 -j $2) || return 1
+	echo "$out" | sed "s/^zram_bench: /&alg=$alg streams=$st async_write=$as /"
+}
+
+for alg in $algs; do
+	echo 1 > $sys/reset
+	if ! echo $alg > $sys/comp_algorithm 2>/dev/null; then
+		echo "zram_bench: no $alg backend [SKIP]"
+		continue
+	fi
+
+	for st in $streams; do
+		for as in $async; do
+			for content in $contents; do
+				for j in $threads; do
+					bench $content $j || ret=1
+				done
+			done
+		done
+	done
+done
+
+exit $ret